@@ -0,0 +1,23 @@
+;;
+;; Bignums
+;;
+
+(define *big-a* (- (expt 3 2000) 1))
+(define *big-b* (+ (expt 7 1500) 12345))
+
+(define-benchmark "bignum/add" (dotimes [i 100] (+ *big-a* *big-b*)))
+
+(define-benchmark "bignum/mul" (* *big-a* *big-b*))
+
+(define-benchmark "bignum/div" (quotient&remainder *big-a* *big-b*))
+
+(define-benchmark "bignum/factorial-1000"
+  (let loop ([i 1] [r 1]) (if (> i 1000) r (loop (+ i 1) (* r i)))))
+
+(define-benchmark "bignum/expt-mod"
+  (expt-mod 3 *big-b* (+ *big-a* 2)))
+
+(define-benchmark "bignum/number->string" (number->string *big-a*))
+
+(define-benchmark "bignum/string->number"
+  (string->number "123456789012345678901234567890123456789012345678901234567890"))
@@ -0,0 +1,31 @@
+;;
+;; Hash tables
+;;
+
+(define *hash-keys* (list->vector (iota 10000)))
+(define *hash-string-keys* (vector-map number->string *hash-keys*))
+
+(define (fill-table type keys)
+  (rlet1 h (make-hash-table type)
+    (vector-for-each (^k (hash-table-put! h k k)) keys)))
+
+(define *eqv-table* (fill-table 'eqv? *hash-keys*))
+(define *string-table* (fill-table 'string=? *hash-string-keys*))
+
+(define-benchmark "hash/eqv-insert" (fill-table 'eqv? *hash-keys*))
+
+(define-benchmark "hash/eqv-lookup"
+  (vector-for-each (^k (hash-table-get *eqv-table* k #f)) *hash-keys*))
+
+(define-benchmark "hash/string-insert"
+  (fill-table 'string=? *hash-string-keys*))
+
+(define-benchmark "hash/string-lookup"
+  (vector-for-each (^k (hash-table-get *string-table* k #f))
+                   *hash-string-keys*))
+
+(define-benchmark "hash/update"
+  (let1 h (make-hash-table 'eqv?)
+    (dotimes [i 10000] (hash-table-update! h (modulo i 97) (cut + <> 1) 0))))
+
+(define-benchmark "hash/fold" (hash-table-fold *eqv-table* (^[k v s] (+ s v)) 0))
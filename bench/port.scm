@@ -0,0 +1,33 @@
+;;
+;; Ports
+;;
+
+(define *port-data*
+  (string-join (map (^i (format "line ~d of the text" i)) (iota 5000)) "\n"))
+
+(define-benchmark "port/read-char"
+  (with-input-from-string *port-data*
+    (^[] (let loop ([c (read-char)] [n 0])
+           (if (eof-object? c) n (loop (read-char) (+ n 1)))))))
+
+(define-benchmark "port/read-line"
+  (with-input-from-string *port-data*
+    (^[] (let loop ([l (read-line)] [n 0])
+           (if (eof-object? l) n (loop (read-line) (+ n 1)))))))
+
+(define-benchmark "port/read-byte"
+  (with-input-from-string *port-data*
+    (^[] (let loop ([b (read-byte)] [n 0])
+           (if (eof-object? b) n (loop (read-byte) (+ n 1)))))))
+
+(define-benchmark "port/write-string"
+  (call-with-output-string
+    (^p (dotimes [i 5000] (write-string "line of the text\n" p)))))
+
+(define-benchmark ("port/file-write-read" :runs 5)
+  (let1 file (build-path (temporary-directory) "gauche-bench.o")
+    (unwind-protect
+        (begin
+          (with-output-to-file file (^[] (display *port-data*)))
+          (string-length (call-with-input-file file port->string)))
+      (sys-unlink file))))
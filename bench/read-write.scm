@@ -0,0 +1,23 @@
+;;
+;; Reader and writer
+;;
+
+(define *sexp*
+  (map (^i `(define (f ,i x) (if (< x ,i) "small" (list 'big ,(* i 1.5) #\c))))
+       (iota 300)))
+(define *sexp-string* (write-to-string *sexp*))
+
+(define-benchmark "read-write/read"
+  (read-from-string *sexp-string*))
+
+(define-benchmark "read-write/write"
+  (write-to-string *sexp*))
+
+(define-benchmark "read-write/write-shared"
+  (with-output-to-string (^[] (write-shared *sexp*))))
+
+(define-benchmark "read-write/display"
+  (with-output-to-string (^[] (display *sexp*))))
+
+(define-benchmark "read-write/flonum-roundtrip"
+  (dotimes [i 1000] (string->number (number->string (/ i 7.0)))))
@@ -0,0 +1,26 @@
+;;
+;; Regular expressions
+;;
+
+(define *regexp-text*
+  (string-join (map (^i (format "user~d@host~d.example.com" i (modulo i 7)))
+                    (iota 500))
+               " "))
+
+(define-benchmark "regexp/literal-search"
+  (rxmatch #/host6\.example\.com/ *regexp-text*))
+
+(define-benchmark "regexp/match-all"
+  (let loop ([s *regexp-text*] [c 0])
+    (if-let1 m (rxmatch #/(\w+)@([\w.]+)/ s)
+      (loop (rxmatch-after m) (+ c 1))
+      c)))
+
+(define-benchmark "regexp/anchored-fail"
+  (dotimes [i 1000] (rxmatch #/^\d+$/ "12345a")))
+
+(define-benchmark "regexp/replace-all"
+  (regexp-replace-all #/\d+/ *regexp-text* "N"))
+
+(define-benchmark "regexp/compile"
+  (string->regexp "([a-z]+)-([0-9]+)|foo(bar)*baz"))
@@ -0,0 +1,57 @@
+;;
+;; Runs the in-tree benchmark suite.  Invoked by 'make bench'.
+;;
+;;   gosh bench/run.scm [options] [suite ...]
+;;
+;;   -s, --select=REGEXP    run only the benchmarks whose name matches
+;;   -r, --runs=N           number of samples per benchmark (default 10)
+;;   -w, --warmup=N         number of discarded warm-up samples (default 3)
+;;   -j, --json=FILE        write the results in JSON to FILE
+;;   -c, --compare=FILE     compare with the results saved by --json;
+;;                          exits with 1 if any benchmark regressed
+;;   -t, --threshold=RATIO  slowdown tolerated by --compare (default 0.05)
+;;
+;; SUITE is a file name in this directory without ".scm", e.g. "vm".
+;; All suites are run if none is given.
+;;
+
+(use gauche.bench)
+(use gauche.parseopt)
+(use file.util)
+
+(define *bench-dir* (sys-dirname (current-load-path)))
+
+(define *suites*
+  '("vm" "hash" "string" "regexp" "port" "read-write" "bignum" "thread"))
+
+(define (usage)
+  (print "Usage: gosh run.scm [-s regexp][-r runs][-w warmup]"
+         "[-j json][-c json][-t ratio] [suite ...]")
+  (exit 1))
+
+(define (main args)
+  (let-args (cdr args) ([select "s|select=s" #f]
+                        [runs "r|runs=i" 10]
+                        [warmup "w|warmup=i" 3]
+                        [json "j|json=s" #f]
+                        [compare "c|compare=s" #f]
+                        [threshold "t|threshold=f" 0.05]
+                        [else (opt . _) (print "Unknown option: " opt) (usage)]
+                        . suites)
+    (dolist [s (if (null? suites) *suites* suites)]
+      (load (build-path *bench-dir* (string-append s ".scm"))))
+    (format #t "Gauche ~a, ~a\n" (gauche-version) (gauche-architecture))
+    (let1 rs (run-benchmarks :select (and select (string->regexp select))
+                             :runs runs :warmup warmup)
+      (when json
+        (call-with-output-file json (cut write-bench-results-json rs <>)))
+      (if compare
+        (let1 regressed
+            (compare-bench-results rs (call-with-input-file compare
+                                        read-bench-results-json)
+                                   :threshold threshold)
+          (dolist [r regressed]
+            (format #t "REGRESSED: ~a: ~a -> ~a ns\n"
+                    (car r) (round->exact (cadr r)) (round->exact (caddr r))))
+          (if (null? regressed) 0 1))
+        0))))
@@ -0,0 +1,33 @@
+;;
+;; Strings
+;;
+
+(define *long-string*
+  (string-join (map (^i (format "word~d" i)) (iota 2000)) " "))
+
+(define-benchmark "string/append"
+  (let loop ([i 0] [r '()])
+    (if (= i 1000) (apply string-append r) (loop (+ i 1) (cons "abc" r)))))
+
+(define-benchmark "string/output-port-build"
+  (with-output-to-string
+    (^[] (dotimes [i 1000] (display "abc") (write-char #\x)))))
+
+(define-benchmark "string/ref-scan"
+  (let1 n (string-length *long-string*)
+    (let loop ([i 0] [c 0])
+      (if (= i n)
+        c
+        (loop (+ i 1)
+              (if (char=? (string-ref *long-string* i) #\space) (+ c 1) c))))))
+
+(define-benchmark "string/split-join"
+  (string-join (string-split *long-string* #\space) ","))
+
+(define-benchmark "string/scan" (string-scan *long-string* "word1999"))
+
+(define-benchmark "string/number->string"
+  (dotimes [i 1000] (number->string i)))
+
+(define-benchmark "string/string->number"
+  (dotimes [i 1000] (string->number "123456")))
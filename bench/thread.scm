@@ -0,0 +1,40 @@
+;;
+;; Threads and synchronization
+;;
+
+(use gauche.threads)
+(use data.queue)
+
+(define-benchmark ("thread/spawn-join" :runs 5)
+  (for-each thread-join!
+            (map (^i (thread-start! (make-thread (^[] i)))) (iota 10))))
+
+(define-benchmark "thread/mutex-lock-unlock"
+  (let1 m (make-mutex)
+    (dotimes [i 1000] (mutex-lock! m) (mutex-unlock! m))))
+
+(define-benchmark "thread/atom-update"
+  (let1 a (atom 0)
+    (dotimes [i 1000] (atomic-update! a (cut + <> 1)))))
+
+(define-benchmark ("thread/mtqueue-ping-pong" :runs 5)
+  (let* ([q (make-mtqueue)]
+         [r (make-mtqueue)]
+         [t (thread-start!
+             (make-thread (^[] (let loop ()
+                                 (let1 x (dequeue/wait! q)
+                                   (enqueue! r x)
+                                   (unless (eof-object? x) (loop)))))))])
+    (dotimes [i 1000] (enqueue! q i) (dequeue/wait! r))
+    (enqueue! q (eof-object))
+    (thread-join! t)))
+
+(define-benchmark ("thread/contended-counter" :runs 5)
+  (let ([m (make-mutex)] [c 0])
+    (for-each thread-join!
+              (map (^_ (thread-start!
+                        (make-thread (^[] (dotimes [i 1000]
+                                            (with-locking-mutex m
+                                              (^[] (set! c (+ c 1)))))))))
+                   (iota 4)))
+    c))
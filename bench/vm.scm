@@ -0,0 +1,49 @@
+;;
+;; VM dispatch: calls, closures, tail loops, apply, call/cc, dynamic-wind
+;;
+
+(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))
+
+(define (tak x y z)
+  (if (not (< y x))
+    z
+    (tak (tak (- x 1) y z) (tak (- y 1) z x) (tak (- z 1) x y))))
+
+(define-benchmark "vm/fib-20" (fib 20))
+
+(define-benchmark "vm/tak-18-12-6" (tak 18 12 6))
+
+(define-benchmark "vm/named-let-loop"
+  (let loop ([i 0] [s 0])
+    (if (= i 10000) s (loop (+ i 1) (+ s i)))))
+
+(define-benchmark "vm/closure-call"
+  (let1 adders (map (^k (^x (+ x k))) (iota 10))
+    (let loop ([i 0] [s 0])
+      (if (= i 1000)
+        s
+        (loop (+ i 1) (fold (^[f s] (f s)) s adders))))))
+
+(define-benchmark "vm/apply"
+  (let loop ([i 0])
+    (when (< i 1000)
+      (apply + 1 2 '(3 4 5))
+      (loop (+ i 1)))))
+
+(define-benchmark "vm/call/cc-escape"
+  (let loop ([i 0])
+    (when (< i 1000)
+      (call/cc (^k (k i)))
+      (loop (+ i 1)))))
+
+(define-benchmark "vm/dynamic-wind"
+  (let loop ([i 0])
+    (when (< i 1000)
+      (dynamic-wind (^[] #f) (^[] i) (^[] #f))
+      (loop (+ i 1)))))
+
+(define-benchmark "vm/guard"
+  (let loop ([i 0])
+    (when (< i 100)
+      (guard (e [#t e]) (raise i))
+      (loop (+ i 1)))))
@@ -527,3 +527,191 @@ void Scm_PutBinaryF64(ScmUVector *uv, int off, ScmObj val, ScmSymbol *e)
     SWAP_D(e, v);
     inject(uv, v.buf, off, 8);
 }
+
+/*===========================================================
+ * Record layouts
+ */
+
+/* A record layout describes a fixed-size record of binary fields,
+   so that binary.pack can compile a template once and then unpack or
+   pack each record with a single call.  It is an s32vector; the first
+   element is the total size in bytes, followed by a triplet
+   (type, endian, size) per field. */
+
+enum {
+    FIELD_U8, FIELD_S8, FIELD_U16, FIELD_S16, FIELD_U32, FIELD_S32,
+    FIELD_U64, FIELD_S64, FIELD_F32, FIELD_F64, FIELD_STRING, FIELD_PAD,
+    FIELD_NTYPES
+};
+
+static const struct {
+    const char *name;
+    int size;                   /* 0 for variable */
+} field_types[] = {
+    { "u8", 1 }, { "s8", 1 }, { "u16", 2 }, { "s16", 2 },
+    { "u32", 4 }, { "s32", 4 }, { "u64", 8 }, { "s64", 8 },
+    { "f32", 4 }, { "f64", 8 }, { "string", 0 }, { "pad", 0 }
+};
+
+enum { FIELD_DEFAULT_ENDIAN, FIELD_BIG_ENDIAN, FIELD_LITTLE_ENDIAN };
+
+/* FIELDS is a list of (type endian size), where TYPE is one of the
+   names above, ENDIAN is #f (default-endian at the time of packing or
+   unpacking), big-endian or little-endian, and SIZE is the number of
+   bytes of string and pad fields. */
+ScmObj Scm_MakeBinaryLayout(ScmObj fields)
+{
+    ScmSmallInt nfields = Scm_Length(fields);
+    if (nfields < 0) Scm_Error("proper list required, but got: %S", fields);
+    ScmObj layout = Scm_MakeS32Vector(nfields*3 + 1, 0);
+    ScmInt32 *d = SCM_S32VECTOR_ELEMENTS(layout);
+    ScmSmallInt total = 0;
+    ScmObj fp;
+
+    d++;
+    SCM_FOR_EACH(fp, fields) {
+        ScmObj f = SCM_CAR(fp);
+        if (Scm_Length(f) != 3 || !SCM_SYMBOLP(SCM_CAR(f))) {
+            Scm_Error("bad field spec: %S", f);
+        }
+        const char *name =
+            Scm_GetStringConst(SCM_SYMBOL_NAME(SCM_CAR(f)));
+        int type = 0;
+        for (; type < FIELD_NTYPES; type++) {
+            if (strcmp(field_types[type].name, name) == 0) break;
+        }
+        if (type == FIELD_NTYPES) Scm_Error("bad field type: %S", f);
+
+        ScmObj e = SCM_CADR(f);
+        int endian;
+        if (SCM_FALSEP(e))                      endian = FIELD_DEFAULT_ENDIAN;
+        else if (SCM_EQ(e, SCM_SYM_BIG_ENDIAN)) endian = FIELD_BIG_ENDIAN;
+        else if (SCM_EQ(e, SCM_SYM_LITTLE_ENDIAN)) endian = FIELD_LITTLE_ENDIAN;
+        else Scm_Error("bad endian in field spec: %S", f);
+
+        int size = field_types[type].size;
+        if (size == 0) {
+            ScmObj s = SCM_CAR(SCM_CDDR(f));
+            if (!SCM_INTP(s) || SCM_INT_VALUE(s) < 0) {
+                Scm_Error("bad size in field spec: %S", f);
+            }
+            size = (int)SCM_INT_VALUE(s);
+        }
+        total += size;
+        if (total > INT32_MAX) {
+            Scm_Error("record layout too large");
+        }
+        *d++ = type;
+        *d++ = endian;
+        *d++ = size;
+    }
+    SCM_S32VECTOR_ELEMENTS(layout)[0] = (ScmInt32)total;
+    return layout;
+}
+
+static ScmSymbol *field_endian(int code, ScmSymbol *dflt)
+{
+    switch (code) {
+    case FIELD_BIG_ENDIAN:    return SCM_SYMBOL(SCM_SYM_BIG_ENDIAN);
+    case FIELD_LITTLE_ENDIAN: return SCM_SYMBOL(SCM_SYM_LITTLE_ENDIAN);
+    default:                  return dflt;
+    }
+}
+
+static void check_layout_range(ScmUVector *layout, ScmUVector *uv, int off)
+{
+    ScmSmallInt size = SCM_S32VECTOR_ELEMENTS(layout)[0];
+    if (off < 0 || off + size > Scm_UVectorSizeInBytes(uv)) {
+        Scm_Error("record of %ld bytes at offset %d is out of bound "
+                  "of the uvector.", (long)size, off);
+    }
+}
+
+/* Returns a list of the field values of the record at OFF of UV.
+   Pad fields don't produce values. */
+ScmObj Scm_UnpackBinaryRecord(ScmUVector *layout, ScmUVector *uv, int off)
+{
+    check_layout_range(layout, uv, off);
+    const ScmInt32 *d = SCM_S32VECTOR_ELEMENTS(layout);
+    ScmSmallInt n = SCM_S32VECTOR_SIZE(layout);
+    ScmSymbol *dflt = SCM_SYMBOL(Scm_DefaultEndian());
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+
+    for (ScmSmallInt i = 1; i < n; i += 3) {
+        ScmSymbol *e = field_endian(d[i+1], dflt);
+        ScmObj v = SCM_UNDEFINED;
+        switch (d[i]) {
+        case FIELD_U8:  v = Scm_GetBinaryU8(uv, off, e); break;
+        case FIELD_S8:  v = Scm_GetBinaryS8(uv, off, e); break;
+        case FIELD_U16: v = Scm_GetBinaryU16(uv, off, e); break;
+        case FIELD_S16: v = Scm_GetBinaryS16(uv, off, e); break;
+        case FIELD_U32: v = Scm_GetBinaryU32(uv, off, e); break;
+        case FIELD_S32: v = Scm_GetBinaryS32(uv, off, e); break;
+        case FIELD_U64: v = Scm_GetBinaryU64(uv, off, e); break;
+        case FIELD_S64: v = Scm_GetBinaryS64(uv, off, e); break;
+        case FIELD_F32: v = Scm_GetBinaryF32(uv, off, e); break;
+        case FIELD_F64: v = Scm_GetBinaryF64(uv, off, e); break;
+        case FIELD_STRING:
+            /* becomes an incomplete string if it isn't valid */
+            v = Scm_MakeString((char*)SCM_UVECTOR_ELEMENTS(uv) + off,
+                               d[i+2], -1, SCM_STRING_COPYING);
+            break;
+        case FIELD_PAD:
+            break;
+        }
+        if (d[i] != FIELD_PAD) SCM_APPEND1(h, t, v);
+        off += d[i+2];
+    }
+    return h;
+}
+
+/* Stores the values in the list VALS to the record at OFF of UV, and
+   returns the remaining values.  Pad fields are filled with zeros.
+   String fields take the bytes of a string, truncated or padded with
+   zeros to the field size. */
+ScmObj Scm_PackBinaryRecord(ScmUVector *layout, ScmUVector *uv, int off,
+                            ScmObj vals)
+{
+    SCM_UVECTOR_CHECK_MUTABLE(SCM_OBJ(uv));
+    check_layout_range(layout, uv, off);
+    const ScmInt32 *d = SCM_S32VECTOR_ELEMENTS(layout);
+    ScmSmallInt n = SCM_S32VECTOR_SIZE(layout);
+    ScmSymbol *dflt = SCM_SYMBOL(Scm_DefaultEndian());
+    unsigned char *p = (unsigned char*)SCM_UVECTOR_ELEMENTS(uv);
+
+    for (ScmSmallInt i = 1; i < n; i += 3) {
+        ScmSymbol *e = field_endian(d[i+1], dflt);
+        int size = d[i+2];
+        if (d[i] == FIELD_PAD) {
+            memset(p + off, 0, size);
+            off += size;
+            continue;
+        }
+        if (!SCM_PAIRP(vals)) Scm_Error("too few values to pack");
+        ScmObj v = SCM_CAR(vals);
+        vals = SCM_CDR(vals);
+        switch (d[i]) {
+        case FIELD_U8:  Scm_PutBinaryU8(uv, off, v, e); break;
+        case FIELD_S8:  Scm_PutBinaryS8(uv, off, v, e); break;
+        case FIELD_U16: Scm_PutBinaryU16(uv, off, v, e); break;
+        case FIELD_S16: Scm_PutBinaryS16(uv, off, v, e); break;
+        case FIELD_U32: Scm_PutBinaryU32(uv, off, v, e); break;
+        case FIELD_S32: Scm_PutBinaryS32(uv, off, v, e); break;
+        case FIELD_U64: Scm_PutBinaryU64(uv, off, v, e); break;
+        case FIELD_S64: Scm_PutBinaryS64(uv, off, v, e); break;
+        case FIELD_F32: Scm_PutBinaryF32(uv, off, v, e); break;
+        case FIELD_F64: Scm_PutBinaryF64(uv, off, v, e); break;
+        case FIELD_STRING: {
+            if (!SCM_STRINGP(v)) SCM_TYPE_ERROR(v, "string");
+            const ScmStringBody *b = SCM_STRING_BODY(v);
+            ScmSmallInt len = SCM_STRING_BODY_SIZE(b);
+            if (len > size) len = size;
+            memcpy(p + off, SCM_STRING_BODY_START(b), len);
+            memset(p + off + len, 0, size - len);
+            break;
+        }
+        }
+        off += size;
+    }
+    return vals;
+}
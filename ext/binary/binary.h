@@ -81,3 +81,9 @@ extern void Scm_PutBinaryS64(ScmUVector *uv, int off, ScmObj v, ScmSymbol *e);
 extern void Scm_PutBinaryF16(ScmUVector *uv, int off, ScmObj v, ScmSymbol *e);
 extern void Scm_PutBinaryF32(ScmUVector *uv, int off, ScmObj v, ScmSymbol *e);
 extern void Scm_PutBinaryF64(ScmUVector *uv, int off, ScmObj v, ScmSymbol *e);
+
+extern ScmObj Scm_MakeBinaryLayout(ScmObj fields);
+extern ScmObj Scm_UnpackBinaryRecord(ScmUVector *layout, ScmUVector *uv,
+                                     int off);
+extern ScmObj Scm_PackBinaryRecord(ScmUVector *layout, ScmUVector *uv,
+                                   int off, ScmObj vals);
@@ -23,6 +23,9 @@
           write-uint write-u8 write-u16 write-u32 write-u64
           write-sint write-s8 write-s16 write-s32 write-s64
           write-ber-integer write-f16 write-f32 write-f64
+          read-u8vector! read-u16vector! read-u32vector! read-u64vector!
+          read-s8vector! read-s16vector! read-s32vector! read-s64vector!
+          read-f16vector! read-f32vector! read-f64vector!
           get-u8 get-u16 get-u32 get-u64 get-s8 get-s16 get-s32 get-s64
           get-f16 get-f32 get-f64
           get-u16be get-u16le get-u32be get-u32le get-u64be get-u64le
@@ -55,6 +58,7 @@
           write-binary-float  write-binary-double
           ))
 (select-module binary.io)
+(use gauche.uvector)
 
 ;;;
 ;;; config
@@ -146,6 +150,34 @@
     [(8) (write-s64 int port endian)]
     [else (write-uint size (sint->uint int size) port endian)]))
 
+;;;
+;;; bulk reading
+;;;
+
+;; These fill a uvector of the specific type from a port with a
+;; single read, swapping the bytes in place afterwards if needed.
+;; Returns the number of elements read, or EOF if no data is available.
+
+(define-syntax define-uvector-reader
+  (syntax-rules ()
+    [(_ name class)
+     (define (name v :optional (port #f) (start 0) (end -1) (endian #f))
+       (unless (is-a? v class)
+         (errorf "~a required, but got: ~s" (class-name class) v))
+       (read-uvector! v (or port (current-input-port)) start end endian))]))
+
+(define-uvector-reader read-u8vector!  <u8vector>)
+(define-uvector-reader read-u16vector! <u16vector>)
+(define-uvector-reader read-u32vector! <u32vector>)
+(define-uvector-reader read-u64vector! <u64vector>)
+(define-uvector-reader read-s8vector!  <s8vector>)
+(define-uvector-reader read-s16vector! <s16vector>)
+(define-uvector-reader read-s32vector! <s32vector>)
+(define-uvector-reader read-s64vector! <s64vector>)
+(define-uvector-reader read-f16vector! <f16vector>)
+(define-uvector-reader read-f32vector! <f32vector>)
+(define-uvector-reader read-f64vector! <f64vector>)
+
 ;;;
 ;;; compatibility
 ;;;
@@ -452,6 +484,15 @@
    (Scm_PutBinaryF64 v off val (SCM_SYMBOL SCM_SYM_BIG_ENDIAN)))
  (define-cproc put-f64le! (v::<uvector> off::<uint> val) ::<void>
    (Scm_PutBinaryF64 v off val (SCM_SYMBOL SCM_SYM_LITTLE_ENDIAN)))
+
+ ;; Record layouts for binary.pack.  Not exported.
+ (define-cproc %make-binary-layout (fields) Scm_MakeBinaryLayout)
+ (define-cproc %unpack-binary-record (layout::<s32vector> v::<uvector>
+                                      off::<int>)
+   Scm_UnpackBinaryRecord)
+ (define-cproc %pack-binary-record! (layout::<s32vector> v::<uvector>
+                                     off::<int> vals)
+   Scm_PackBinaryRecord)
  )
 
 ;;;
@@ -291,6 +291,45 @@
          (cut read-f64 #f 'arm-little-endian)))
 
 
+;; bulk readers
+
+(test* "read-u16vector! (be)" '(2 #u16(#x0102 #x0304))
+       (let1 v (make-u16vector 2)
+         (with-input-from-string #*"\x01\x02\x03\x04"
+           (^[] (list (read-u16vector! v #f 0 -1 'big-endian) v)))))
+(test* "read-u32vector! (le, range)" '(1 #u32(0 #x04030201 0))
+       (let1 v (make-u32vector 3 0)
+         (with-input-from-string #*"\x01\x02\x03\x04"
+           (^[] (list (read-u32vector! v #f 1 3 'little-endian) v)))))
+(test* "read-s32vector! (be, leaves rest intact)" '(1 #s32(7 -2 7))
+       (let1 v (make-s32vector 3 7)
+         (with-input-from-string #*"\xff\xff\xff\xfe"
+           (^[] (list (read-s32vector! v #f 1 -1 'big-endian) v)))))
+(test* "read-f64vector! (be)" '(2 #f64(1.0 -2.0))
+       (let1 v (make-f64vector 2)
+         (with-input-from-string
+             #*"\x3f\xf0\x00\x00\x00\x00\x00\x00\xc0\x00\x00\x00\x00\x00\x00\x00"
+           (^[] (list (read-f64vector! v #f 0 -1 'big-endian) v)))))
+(test* "read-f64vector! (arm)" '(1 #f64(1.0))
+       (let1 v (make-f64vector 1)
+         (with-input-from-string #*"\x00\x00\xf0\x3f\x00\x00\x00\x00"
+           (^[] (list (read-f64vector! v #f 0 -1 'arm-little-endian) v)))))
+(test* "read-u64vector! (eof)" (eof-object)
+       (with-input-from-string ""
+         (cut read-u64vector! (make-u64vector 2))))
+(test* "read-u32vector! (type check)" 'error
+       (guard (e [else 'error])
+         (with-input-from-string #*"\x01\x02\x03\x04"
+           (cut read-u32vector! (make-s32vector 1)))))
+(test* "read-f32vector! vs read-f32" '(1.0 -0.5 2.5)
+       (let* ([data (call-with-output-string
+                      (^p (for-each (cut write-f32 <> p 'big-endian)
+                                    '(1.0 -0.5 2.5))))]
+              [v (make-f32vector 3)])
+         (with-input-from-string data
+           (cut read-f32vector! v #f 0 -1 'big-endian))
+         (f32vector->list v)))
+
 ;; uvector reader
 
 (test* "get-u8" '(1 2 254 255)
@@ -322,6 +361,15 @@
                  '#u8(#x01 #x02 #xfe #xff #x03 #x04 #xfc #xfd)
                  <> 'big-endian)
             (iota 5)))
+(test* "get-u32 be (slice)"
+       '(#xfeff0304 #xff0304fc #x0304fcfd)
+       (map (cut get-u32
+                 (uvector-slice '#u8(#x01 #x02 #xfe #xff #x03 #x04 #xfc #xfd) 2)
+                 <> 'big-endian)
+            (iota 3)))
+(test* "get-u32 be (slice, out of range)" (test-error)
+       (get-u32 (uvector-slice '#u8(#x01 #x02 #xfe #xff #x03 #x04 #xfc #xfd) 2 5)
+                0 'big-endian))
 (test* "get-u32 le"
        '(#xfffe0201 #x03fffe02 #x0403fffe #xfc0403ff #xfdfc0403)
        (map (cut get-u32
@@ -943,4 +991,49 @@
                   \x01\x01\x01\x01\
                   \x01\x01\x01\x01"))
 
+;; compiled fixed-layout templates
+(let ([fmt "n N! v2 x2 (C c)2 a3 q d"]
+      [vals '(513 -2 3 4 1 -1 255 -128 "abc" -5 1.5)])
+  (test* "make-packer to u8vector" 37
+         (let1 buf (make-u8vector 40 0)
+           ((make-packer fmt) vals buf 2)))
+  (test* "make-packer is compatible with pack"
+         (string->u8vector (pack fmt vals :to-string? #t))
+         (string->u8vector
+          (call-with-output-string (cut (make-packer fmt) vals <>))))
+  (test* "make-unpacker from u8vector" vals
+         (let1 buf (make-u8vector 40 0)
+           ((make-packer fmt) vals buf 3)
+           ((make-unpacker fmt) buf 3)))
+  (test* "make-unpacker from port" (list vals vals (eof-object))
+         (let1 u (make-unpacker fmt)
+           (with-input-from-string
+               (string-append (pack fmt vals :to-string? #t)
+                              (pack fmt vals :to-string? #t))
+             (^[] (let* ([a (u)] [b (u)]) (list a b (u)))))))
+  (test* "make-unpacker default endian" '(#x0102 #x0201)
+         (let1 buf (u8vector 1 2)
+           (list (parameterize ([default-endian 'big-endian])
+                   (car ((make-unpacker "S") buf)))
+                 (parameterize ([default-endian 'little-endian])
+                   (car ((make-unpacker "S") buf))))))
+  (test* "make-unpacker premature end" 'error
+         (guard (e [else 'error])
+           ((make-unpacker "N2") (open-input-string "abcde"))))
+  (test* "make-packer extra values" 'error
+         (guard (e [else 'error])
+           ((make-packer "C") '(1 2) (make-u8vector 1))))
+  (test* "make-packer out of range" 'error
+         (guard (e [else 'error])
+           ((make-packer "N") '(1) (make-u8vector 4) 1)))
+  (test* "make-packer keeps dispatch commands" '(4 #f)
+         (let1 p (make-packer "N")
+           (list (p 'length) (p 'variable-length?)))))
+
+;; templates that aren't fixed layouts fall back to the interpreter
+(test* "make-unpacker (variable length)" '("hello" 7)
+       ((make-unpacker "C/a* C") (string->u8vector "\x05hello\x07")))
+(test* "make-packer (variable length)" 7
+       ((make-packer "C/a*") '("hello") (make-u8vector 10) 1))
+
 (test-end)
@@ -41,6 +41,11 @@
 #define DEFAULT_CONVERSION_BUFFER_SIZE 1024
 #define MINIMUM_CONVERSION_BUFFER_SIZE 16
 
+/* The buffer size used when the caller doesn't specify one, including
+   the conversion ports inserted by coding-aware ports.  Larger buffer
+   lets the ASCII span copying in jconv() run longer. */
+static int default_conversion_buffer_size = DEFAULT_CONVERSION_BUFFER_SIZE;
+
 typedef struct conv_guess_rec {
     const char *codeName;
     ScmCodeGuessingProc proc;
@@ -84,6 +89,20 @@ const char* Scm_GetCESName(ScmObj code, const char *argname)
     return c;
 }
 
+int Scm_ConversionDefaultBufferSize(void)
+{
+    return default_conversion_buffer_size;
+}
+
+void Scm_SetConversionDefaultBufferSize(int size)
+{
+    if (size < MINIMUM_CONVERSION_BUFFER_SIZE) {
+        Scm_Error("conversion buffer size must be at least %d, but got %d",
+                  MINIMUM_CONVERSION_BUFFER_SIZE, size);
+    }
+    default_conversion_buffer_size = size;
+}
+
 int Scm_ConversionSupportedP(const char *from, const char *to)
 {
     ScmConvInfo *info = jconv_open(to, from);
@@ -251,7 +270,7 @@ ScmObj Scm_MakeInputConversionPort(ScmPort *fromPort,
     if (!SCM_IPORTP(fromPort))
         Scm_Error("input port required, but got %S", fromPort);
 
-    if (bufsiz <= 0) bufsiz = DEFAULT_CONVERSION_BUFFER_SIZE;
+    if (bufsiz <= 0) bufsiz = default_conversion_buffer_size;
     if (bufsiz <= MINIMUM_CONVERSION_BUFFER_SIZE) {
         bufsiz = MINIMUM_CONVERSION_BUFFER_SIZE;
     }
@@ -441,7 +460,7 @@ ScmObj Scm_MakeOutputConversionPort(ScmPort *toPort,
     if (!SCM_OPORTP(toPort))
         Scm_Error("output port required, but got %S", toPort);
 
-    if (bufsiz <= 0) bufsiz = DEFAULT_CONVERSION_BUFFER_SIZE;
+    if (bufsiz <= 0) bufsiz = default_conversion_buffer_size;
     if (bufsiz <= MINIMUM_CONVERSION_BUFFER_SIZE) {
         bufsiz = MINIMUM_CONVERSION_BUFFER_SIZE;
     }
@@ -453,7 +472,7 @@ ScmObj Scm_MakeOutputConversionPort(ScmPort *toPort,
     }
     cinfo->remote = toPort;
     cinfo->ownerp = ownerp;
-    cinfo->bufsiz = (bufsiz > 0)? bufsiz : DEFAULT_CONVERSION_BUFFER_SIZE;
+    cinfo->bufsiz = bufsiz;
     cinfo->remoteClosed = FALSE;
     cinfo->buf = SCM_NEW_ATOMIC2(char *, cinfo->bufsiz);
     cinfo->ptr = cinfo->buf;
@@ -474,6 +493,156 @@ ScmObj Scm_MakeOutputConversionPort(ScmPort *toPort,
     return Scm_MakeBufferedPort(SCM_CLASS_PORT, name, SCM_PORT_OUTPUT, TRUE, &bufrec);
 }
 
+/*------------------------------------------------------------
+ * Buffer-to-buffer conversion
+ *
+ *  Each call converts the given input as a complete text; the
+ *  context is restarted before, and the finishing sequence is emitted
+ *  after the conversion.
+ */
+
+static void ces_converter_print(ScmObj obj, ScmPort *port,
+                                ScmWriteContext *ctx)
+{
+    ScmCESConverter *c = SCM_CES_CONVERTER(obj);
+    Scm_Printf(port, "#<ces-converter %s -> %s>", c->fromCode, c->toCode);
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_CESConverterClass, ces_converter_print);
+
+static void ces_converter_finalize(ScmObj obj, void *data)
+{
+    ScmCESConverter *c = SCM_CES_CONVERTER(obj);
+    if (c->info) {
+        jconv_close(c->info);
+        c->info = NULL;
+    }
+}
+
+ScmObj Scm_MakeCESConverter(const char *fromCode, const char *toCode)
+{
+    ScmCESConverter *c = SCM_NEW(ScmCESConverter);
+    SCM_SET_CLASS(c, SCM_CLASS_CES_CONVERTER);
+    c->fromCode = fromCode;
+    c->toCode = toCode;
+    c->guess = findGuessingProc(fromCode);
+    c->info = NULL;
+    if (c->guess == NULL) {
+        c->info = jconv_open(toCode, fromCode);
+        if (c->info == NULL) {
+            Scm_Error("conversion from code %s to code %s is not supported",
+                      fromCode, toCode);
+        }
+    }
+    Scm_RegisterFinalizer(SCM_OBJ(c), ces_converter_finalize, NULL);
+    return SCM_OBJ(c);
+}
+
+/* Returns the context to convert IN, guessing its encoding if needed.
+   The context of the last guessed encoding is reused. */
+static ScmConvInfo *ces_converter_info(ScmCESConverter *c,
+                                       const char *in, int insize)
+{
+    if (c->guess) {
+        const char *guessed = c->guess->proc(in, insize, c->guess->data);
+        if (guessed == NULL)
+            Scm_Error("%s: failed to guess input encoding", c->fromCode);
+        if (c->info == NULL || strcmp(c->info->fromCode, guessed) != 0) {
+            if (c->info) jconv_close(c->info);
+            c->info = jconv_open(c->toCode, guessed);
+            if (c->info == NULL) {
+                Scm_Error("conversion from code %s to code %s is not supported",
+                          guessed, c->toCode);
+            }
+        }
+    }
+    jconv_restart(c->info);
+    return c->info;
+}
+
+static void ces_convert_error(ScmConvInfo *info, size_t r,
+                              const char *in, size_t inroom)
+{
+    if (r == ILLEGAL_SEQUENCE) {
+        int cnt = inroom >= 6 ? 6 : (int)inroom;
+        ScmObj s = Scm_MakeString(in, cnt, cnt,
+                                  SCM_STRING_COPYING|SCM_STRING_INCOMPLETE);
+        Scm_Error("invalid character sequence in the input: %S ...", s);
+    } else {
+        Scm_Error("incomplete character sequence at the end of the input "
+                  "(%s -> %s)", info->fromCode, info->toCode);
+    }
+}
+
+/* Converts INSIZE bytes at IN into OUT.  Returns the number of bytes
+   written, or -1 if OUTSIZE bytes aren't enough to hold the result. */
+int Scm_CESConvertBuffer(ScmCESConverter *c,
+                         const char *in, int insize,
+                         char *out, int outsize)
+{
+    if (insize == 0) return 0;
+    ScmConvInfo *info = ces_converter_info(c, in, insize);
+    const char *ip = in;
+    char *op = out;
+    size_t inroom = insize, outroom = outsize;
+
+    while (inroom > 0) {
+        size_t inroom_prev = inroom;
+        size_t r = jconv(info, &ip, &inroom, &op, &outroom);
+        if (r == OUTPUT_NOT_ENOUGH) return -1;
+        if (r == ILLEGAL_SEQUENCE || r == INPUT_NOT_ENOUGH) {
+            ces_convert_error(info, r, ip, inroom);
+        }
+        if (inroom == inroom_prev) {
+            /* No progress; the output is full. */
+            if (outroom == 0) return -1;
+            ces_convert_error(info, INPUT_NOT_ENOUGH, ip, inroom);
+        }
+    }
+    size_t r = jconv_reset(info, op, outroom);
+    if (r == OUTPUT_NOT_ENOUGH) return -1;
+    return (int)(op - out + r);
+}
+
+#define CES_CONVERT_CHUNK 1024
+
+/* Converts the content of S and returns a new string. */
+ScmObj Scm_CESConvertString(ScmCESConverter *c, ScmString *s)
+{
+    u_int size;
+    const char *in = Scm_GetStringContent(s, &size, NULL, NULL);
+    if (size == 0) return SCM_MAKE_STR("");
+
+    ScmConvInfo *info = ces_converter_info(c, in, size);
+    char buf[CES_CONVERT_CHUNK];
+    const char *ip = in;
+    size_t inroom = size;
+    ScmDString ds;
+    Scm_DStringInit(&ds);
+
+    while (inroom > 0) {
+        char *op = buf;
+        size_t outroom = CES_CONVERT_CHUNK, inroom_prev = inroom;
+        size_t r = jconv(info, &ip, &inroom, &op, &outroom);
+        if (r == ILLEGAL_SEQUENCE || r == INPUT_NOT_ENOUGH) {
+            ces_convert_error(info, r, ip, inroom);
+        }
+        if (op == buf && inroom == inroom_prev) {
+            ces_convert_error(info, INPUT_NOT_ENOUGH, ip, inroom);
+        }
+        Scm_DStringPutz(&ds, buf, (int)(op - buf));
+    }
+    size_t r = jconv_reset(info, buf, CES_CONVERT_CHUNK);
+    if (r == OUTPUT_NOT_ENOUGH) {
+        /* The finishing sequence is just a few bytes. */
+        Scm_Error("couldn't flush the ending escape sequence (%s -> %s).  "
+                  "possibly an implementation error",
+                  info->fromCode, info->toCode);
+    }
+    Scm_DStringPutz(&ds, buf, (int)r);
+    return Scm_DStringGet(&ds, 0);
+}
+
 /*------------------------------------------------------------
  * Direct interface for code guessing
  */
@@ -609,6 +778,8 @@ SCM_EXTENSION_ENTRY void Scm_Init_gauche__charconv(void)
     ucsconv.ucs2char = ucsconv.char2ucs = NULL;
 #endif
     (void)SCM_INTERNAL_MUTEX_INIT(ucsconv.mutex);
+    Scm_InitStaticClass(&Scm_CESConverterClass, "<ces-converter>",
+                        mod, NULL, 0);
     Scm_Init_convguess();
     Scm_Init_convaux();
     Scm__InstallCharconvHooks(ucstochar, chartoucs);
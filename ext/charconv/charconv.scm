@@ -40,6 +40,8 @@
           ces-guess-from-string
           ces-equivalent? ces-upper-compatible?
           ces-convert
+          make-ces-converter ces-convert-string ces-convert-u8vector!
+          conversion-buffer-size
           wrap-with-input-conversion
           wrap-with-output-conversion
           call-with-input-conversion
@@ -226,6 +226,48 @@
      (return (Scm_MakeOutputConversionPort sink tc fc buffer_size
                                            (not (SCM_FALSEP ownerP))))))
 
+ ;; Buffer-to-buffer conversion.
+ (define-type <ces-converter> "ScmCESConverter*")
+
+ (define-cproc make-ces-converter (from-code :optional (to-code #f))
+   (let* ([fc::(const char*) (Scm_GetCESName from_code "from-code")]
+          [tc::(const char*) (Scm_GetCESName to_code "to-code")])
+     (return (Scm_MakeCESConverter fc tc))))
+
+ (define-cproc ces-convert-string (conv::<ces-converter> string::<string>)
+   Scm_CESConvertString)
+
+ ;; Returns the number of bytes written into TARGET, or #f if TARGET
+ ;; doesn't have enough room after TSTART.
+ (define-cproc ces-convert-u8vector! (conv::<ces-converter>
+                                      target::<u8vector>
+                                      tstart::<fixnum>
+                                      source::<u8vector>
+                                      :optional (sstart::<fixnum> 0)
+                                                (send::<fixnum> -1))
+   (let* ([tlen::int (SCM_U8VECTOR_SIZE target)]
+          [slen::int (SCM_U8VECTOR_SIZE source)])
+     (SCM_UVECTOR_CHECK_MUTABLE target)
+     (unless (and (<= 0 tstart) (<= tstart tlen))
+       (Scm_Error "target start out of range: %ld" (cast long tstart)))
+     (SCM_CHECK_START_END sstart send slen)
+     (let* ([r::int (Scm_CESConvertBuffer
+                     conv
+                     (+ (cast (const char*) (SCM_U8VECTOR_ELEMENTS source))
+                        sstart)
+                     (- send sstart)
+                     (+ (cast char* (SCM_U8VECTOR_ELEMENTS target)) tstart)
+                     (- tlen tstart))])
+       (if (< r 0)
+         (return '#f)
+         (return (SCM_MAKE_INT r))))))
+
+ ;; The default of buffer-size arguments.
+ (define-cproc conversion-buffer-size () ::<int>
+   (setter (size::<int>) ::<void>
+           (Scm_SetConversionDefaultBufferSize size))
+   Scm_ConversionDefaultBufferSize)
+
  (define-cproc ces-guess-from-string (string::<string> scheme::<string>)
    (let* ([size::u_int]
           [s::(const char*) (Scm_GetStringContent string (& size) NULL NULL)]
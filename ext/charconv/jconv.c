@@ -1110,6 +1110,9 @@ enum {
 #endif
 };
 
+#define ASCII_COMPATIBLE_P(code) \
+    ((code) == JCODE_EUCJ || (code) == JCODE_SJIS || (code) == JCODE_UTF8)
+
 /* map canonical code designator to inconv and outconv.  the order of
    entry must match with the above designators. */
 static struct conv_converter_rec {
@@ -1216,6 +1219,41 @@ static size_t jconv_ident(ScmConvInfo *info, const char **iptr,
     }
 }
 
+/* For the ascii-compatible conversions, returns the length of the
+   ASCII span (bytes below 0x7f) at the beginning of INPTR, up to
+   MAXLEN bytes.  Such bytes convert to themselves, so the callers can
+   copy them directly.  We check a word at a time; all bytes in W are
+   below 0x7f iff none of W's bytes nor W+0x01..01's bytes has the high
+   bit set (a carry only arises from 0xff, which is caught in W itself). */
+static inline size_t ascii_span(const char *inptr, size_t maxlen)
+{
+    const unsigned char *p = (const unsigned char*)inptr;
+    size_t i = 0;
+    for (; i + sizeof(u_long) <= maxlen; i += sizeof(u_long)) {
+        u_long w;
+        memcpy(&w, p + i, sizeof(u_long));
+        if ((w | (w + (~0UL/255))) & ((~0UL/255) << 7)) break;
+    }
+    while (i < maxlen && p[i] < 0x7f) i++;
+    return i;
+}
+
+/* Copies the ASCII span at the beginning of the input, if any.  Returns
+   the number of bytes copied. */
+static inline size_t jconv_ascii(const char **inp, int *inr,
+                                 char **outp, int *outr)
+{
+    size_t n = ascii_span(*inp, (size_t)((*inr < *outr)? *inr : *outr));
+    if (n > 0) {
+        memcpy(*outp, *inp, n);
+        *inp += n;
+        *inr -= (int)n;
+        *outp += n;
+        *outr -= (int)n;
+    }
+    return n;
+}
+
 /* case (2) or (3) */
 static size_t jconv_1tier(ScmConvInfo *info, const char **iptr,
                           size_t *iroom, char **optr, size_t *oroom)
@@ -1232,6 +1270,10 @@ static size_t jconv_1tier(ScmConvInfo *info, const char **iptr,
     SCM_ASSERT(cvt != NULL);
     while (inr > 0 && outr > 0) {
         size_t outchars;
+        if (info->asciip && (unsigned char)*inp < 0x7f) {
+            converted += jconv_ascii(&inp, &inr, &outp, &outr);
+            continue;
+        }
         size_t inchars = cvt(info, inp, inr, outp, outr, &outchars);
         if (ERRP(inchars)) {
             converted = inchars;
@@ -1269,6 +1311,10 @@ static size_t jconv_2tier(ScmConvInfo *info, const char **iptr, size_t *iroom,
 #endif
     while (inr > 0 && outr > 0) {
         size_t outchars, bufchars;
+        if (info->asciip && (unsigned char)*inp < 0x7f) {
+            converted += jconv_ascii(&inp, &inr, &outp, &outr);
+            continue;
+        }
         size_t inchars = icvt(info, inp, inr, buf, INTBUFSIZ, &bufchars);
         if (ERRP(inchars)) {
             converted = inchars;
@@ -1401,6 +1447,9 @@ ScmConvInfo *jconv_open(const char *toCode, const char *fromCode)
     info->toCode = toCode;
     info->istate = info->ostate = JIS_ASCII;
     info->fromCode = fromCode;
+    /* ISO2022JP is excluded, for the meaning of the bytes depends on the
+       state.  (We don't bother iconv; we don't know its encodings.) */
+    info->asciip = (ASCII_COMPATIBLE_P(incode) && ASCII_COMPATIBLE_P(outcode));
     return info;
 }
 
@@ -1419,6 +1468,21 @@ int jconv_close(ScmConvInfo *info)
     return r;
 }
 
+/*------------------------------------------------------------------
+ * JCONV_RESTART
+ *  Puts the context back to the initial state, discarding the shift
+ *  state left by the previous conversion.
+ */
+void jconv_restart(ScmConvInfo *info)
+{
+#ifdef HAVE_ICONV_H
+    if (info->handle != (iconv_t)-1) {
+        iconv(info->handle, NULL, NULL, NULL, NULL);
+    }
+#endif /*HAVE_ICONV_H*/
+    info->istate = info->ostate = JIS_ASCII;
+}
+
 /*------------------------------------------------------------------
  * JCONV - main conversion routine
  */
@@ -286,6 +286,97 @@
           '("EUCJP" "UTF-8" "SJIS" "ISO2022JP")
           '("EUCJP" "UTF-8" "SJIS" "ISO2022JP"))
 
+;;--------------------------------------------------------------------
+(test-section "converter")
+
+(use gauche.uvector)
+
+(define (test-converter file from to)
+  (let ([infostr (format #f "converter(~a) ~a => ~a" file from to)]
+        [instr   (file->string (format #f "~a.~a" file from))]
+        [outstr  (file->string (format #f "~a.~a" file to))])
+    (when (ces-conversion-supported? from to)
+      (let1 conv (make-ces-converter from to)
+        ;; convert twice, to see the state is restarted
+        (test* infostr (list outstr outstr)
+               (list (string-complete->incomplete
+                      (ces-convert-string conv instr))
+                     (string-complete->incomplete
+                      (ces-convert-string conv instr))))
+        (test* #"~infostr (u8vector)" (string->u8vector outstr)
+               (let* ([src (string->u8vector instr)]
+                      [dst (make-u8vector (+ 10 (* 3 (u8vector-length src))))]
+                      [n (ces-convert-u8vector! conv dst 3 src)])
+                 (and n (u8vector-copy dst 3 (+ 3 n)))))))))
+
+(map-test test-converter "data/jp1"
+          '("EUCJP" "UTF-8" "SJIS" "ISO2022JP")
+          '("EUCJP" "UTF-8" "SJIS" "ISO2022JP"))
+(map-test test-converter "data/jp4"
+          '("EUCJP" "UTF-8" "SJIS" "ISO2022JP")
+          '("EUCJP" "UTF-8" "SJIS" "ISO2022JP"))
+
+(let ([srcdir (sys-dirname (current-load-path))]
+      [conv (make-ces-converter "*JP" "EUCJP")])
+  (dolist [code '("EUCJP" "UTF-8" "SJIS" "ISO2022JP")]
+    (test* #"converter guessing ~code"
+           (file->string #"~|srcdir|/data/jp1.EUCJP")
+           (string-complete->incomplete
+            (ces-convert-string conv
+                                (file->string #"~|srcdir|/data/jp1.~code"))))))
+
+(test* "converter u8vector range" '(3 #u8(0 #x61 #x62 #x63 0))
+       (let ([conv (make-ces-converter "UTF-8" "EUCJP")]
+             [dst (make-u8vector 5 0)])
+         (list (ces-convert-u8vector! conv dst 1 '#u8(#x78 #x61 #x62 #x63 #x78)
+                                      1 4)
+               dst)))
+(test* "converter u8vector overflow" #f
+       (ces-convert-u8vector! (make-ces-converter "EUCJP" "UTF-8")
+                              (make-u8vector 3) 0
+                              '#u8(#x61 #xa4 #xa2 #x62)))
+(test* "converter empty input" ""
+       (ces-convert-string (make-ces-converter "EUCJP" "UTF-8") ""))
+(test* "converter incomplete input" (test-error)
+       (ces-convert-string (make-ces-converter "UTF-8" "EUCJP")
+                           (u8vector->string '#u8(#x61 #xe3 #x81))))
+(test* "converter unsupported" (test-error)
+       (make-ces-converter "no-such-encoding" "UTF-8"))
+
+;;--------------------------------------------------------------------
+(test-section "ASCII runs")
+
+;; Long ASCII runs are copied directly between ASCII compatible CESs.
+;; Check that they are interleaved correctly with multibyte characters,
+;; with the buffer boundaries falling at various places.
+(define (test-ascii-runs file from to bufsiz)
+  (let* ([run (make-string 37 #\a)]
+         [body (file->string #"~|file|.~|from|")]
+         [in (string-append run body run run body "xyz")]
+         [out (string-append run (file->string #"~|file|.~|to|")
+                             run run (file->string #"~|file|.~|to|") "xyz")])
+    (test* #"ascii runs ~|from| => ~|to| (~bufsiz)"
+           (string-complete->incomplete out)
+           (string-complete->incomplete
+            (port->byte-string
+             (open-input-conversion-port (open-input-string in) from
+                                         :to-code to
+                                         :buffer-size bufsiz))))))
+
+(dolist [bufsiz '(16 17 100)]
+  (map-test (cut test-ascii-runs <> <> <> bufsiz) "data/jp1"
+            '("EUCJP" "UTF-8" "SJIS")
+            '("EUCJP" "UTF-8" "SJIS")))
+
+(test* "conversion-buffer-size" '(1024 4096 1024)
+       (let* ([a (conversion-buffer-size)]
+              [b (begin (set! (conversion-buffer-size) 4096)
+                        (conversion-buffer-size))])
+         (set! (conversion-buffer-size) a)
+         (list a b (conversion-buffer-size))))
+(test* "conversion-buffer-size (too small)" (test-error)
+       (set! (conversion-buffer-size) 8))
+
 ;;--------------------------------------------------------------------
 (test-section "wrapping conversion")
 
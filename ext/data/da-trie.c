@@ -0,0 +1,453 @@
+/*
+ * da-trie.c - Double-array trie
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "da-trie.h"
+
+static void datrie_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
+{
+    DATrie *t = DA_TRIE(obj);
+    Scm_Printf(port, "#<da-trie %ld keys, %ld cells>", t->numKeys, t->size);
+}
+
+SCM_DEFINE_BUILTIN_CLASS(Scm_DATrieClass, datrie_print, NULL, NULL, NULL,
+                         SCM_CLASS_DICTIONARY_CPL);
+
+/* Returns the byte sequence of KEY.  If TYPE isn't NULL, the key type
+   is stored. */
+static const u_char *key_bytes(ScmObj key, ScmSmallInt *len, int *type)
+{
+    if (SCM_STRINGP(key)) {
+        u_int size;
+        const char *s = Scm_GetStringContent(SCM_STRING(key), &size,
+                                             NULL, NULL);
+        *len = size;
+        if (type) *type = DATRIE_KEY_STRING;
+        return (const u_char*)s;
+    } else if (SCM_U8VECTORP(key)) {
+        *len = SCM_U8VECTOR_SIZE(key);
+        if (type) *type = DATRIE_KEY_U8VECTOR;
+        return (const u_char*)SCM_U8VECTOR_ELEMENTS(key);
+    } else {
+        Scm_Error("string or u8vector required, but got %S", key);
+        return NULL;            /* dummy */
+    }
+}
+
+static ScmObj make_key(DATrie *t, const u_char *bytes, ScmSmallInt len)
+{
+    if (t->keyType == DATRIE_KEY_STRING) {
+        return Scm_MakeString((const char*)bytes, len, -1, SCM_STRING_COPYING);
+    } else {
+        return Scm_MakeU8VectorFromArray(len, (const uint8_t*)bytes);
+    }
+}
+
+static inline ScmObj id_to_value(DATrie *t, ScmInt32 id)
+{
+    if (SCM_VECTORP(t->values)) return SCM_VECTOR_ELEMENT(t->values, id);
+    return SCM_MAKE_INT(id);
+}
+
+/* Returns the cell reached from S by CODE, or -1. */
+static inline ScmInt32 transit(DATrie *t, ScmInt32 s, int code)
+{
+    ScmSmallInt n = (ScmSmallInt)t->base[s] + code;
+    if (t->base[s] <= 0 || n >= t->size || t->check[n] != s) return -1;
+    return (ScmInt32)n;
+}
+
+/* Returns the id if S has a terminal, -1 otherwise. */
+static inline ScmInt32 terminal_id(DATrie *t, ScmInt32 s)
+{
+    ScmInt32 n = transit(t, s, 0);
+    return (n < 0) ? -1 : -t->base[n] - 1;
+}
+
+/*===================================================================
+ * Construction
+ */
+
+typedef struct {
+    const u_char *bytes;
+    ScmSmallInt len;
+    ScmInt32 id;
+} KeyEntry;
+
+static int key_entry_cmp(const void *a, const void *b)
+{
+    const KeyEntry *x = a, *y = b;
+    ScmSmallInt n = (x->len < y->len) ? x->len : y->len;
+    int r = memcmp(x->bytes, y->bytes, n);
+    if (r != 0) return r;
+    return (x->len < y->len) ? -1 : (x->len > y->len) ? 1 : 0;
+}
+
+typedef struct {
+    KeyEntry *keys;
+    ScmInt32 *base;
+    ScmInt32 *check;
+    ScmSmallInt alloc;          /* allocated # of cells */
+    ScmSmallInt maxUsed;
+    ScmSmallInt nextCheckPos;   /* cells before this are mostly used */
+} Builder;
+
+static void builder_extend(Builder *b, ScmSmallInt need)
+{
+    if (need <= b->alloc) return;
+    ScmSmallInt n = b->alloc;
+    while (n < need) n *= 2;
+    if (n > 0x7fffffff) Scm_Error("double-array trie becomes too large");
+    ScmInt32 *nb = SCM_NEW_ATOMIC_ARRAY(ScmInt32, n);
+    ScmInt32 *nc = SCM_NEW_ATOMIC_ARRAY(ScmInt32, n);
+    memcpy(nb, b->base, b->alloc * sizeof(ScmInt32));
+    memcpy(nc, b->check, b->alloc * sizeof(ScmInt32));
+    for (ScmSmallInt i = b->alloc; i < n; i++) { nb[i] = 0; nc[i] = -1; }
+    b->base = nb;
+    b->check = nc;
+    b->alloc = n;
+}
+
+/* Finds a base value where all of CODES[0..N) fit. */
+static ScmSmallInt find_base(Builder *b, const int *codes, int n)
+{
+    ScmSmallInt pos = b->nextCheckPos;
+    if (pos < codes[0] + 1) pos = codes[0] + 1;
+    ScmSmallInt used = 0, first = pos;
+
+    for (;; pos++) {
+        builder_extend(b, pos + 257);
+        if (b->check[pos] != -1) { used++; continue; }
+        ScmSmallInt base = pos - codes[0];
+        int i;
+        for (i = 1; i < n; i++) {
+            if (b->check[base + codes[i]] != -1) break;
+        }
+        if (i == n) {
+            /* If the region we've scanned is mostly occupied, we skip it
+               next time. */
+            if (used * 20 >= (pos - first + 1) * 19) b->nextCheckPos = pos;
+            return base;
+        }
+    }
+}
+
+/* Places the children of node S, which are keys [LO, HI) sharing the
+   first DEPTH bytes, and recurses. */
+static void build_node(Builder *b, ScmInt32 s, ScmSmallInt lo, ScmSmallInt hi,
+                       ScmSmallInt depth)
+{
+    int codes[257];
+    ScmSmallInt starts[258];
+    int n = 0;
+
+    for (ScmSmallInt i = lo; i < hi; i++) {
+        const KeyEntry *k = &b->keys[i];
+        int c = (k->len > depth) ? k->bytes[depth] + 1 : 0;
+        if (n == 0 || codes[n-1] != c) {
+            codes[n] = c;
+            starts[n] = i;
+            n++;
+        }
+    }
+    starts[n] = hi;
+
+    ScmSmallInt base = find_base(b, codes, n);
+    b->base[s] = (ScmInt32)base;
+    for (int i = 0; i < n; i++) {
+        ScmSmallInt cell = base + codes[i];
+        b->check[cell] = s;
+        if (cell > b->maxUsed) b->maxUsed = cell;
+    }
+    for (int i = 0; i < n; i++) {
+        ScmInt32 cell = (ScmInt32)(base + codes[i]);
+        if (codes[i] == 0) {
+            b->base[cell] = -b->keys[starts[i]].id - 1;
+        } else {
+            build_node(b, cell, starts[i], starts[i+1], depth + 1);
+        }
+    }
+}
+
+static ScmObj keys_to_list(ScmObj keys)
+{
+    if (SCM_VECTORP(keys)) return Scm_VectorToList(SCM_VECTOR(keys), 0, -1);
+    if (!SCM_LISTP(keys)) {
+        Scm_Error("list or vector of keys required, but got %S", keys);
+    }
+    return keys;
+}
+
+ScmObj MakeDATrie(ScmObj keys, ScmObj values)
+{
+    ScmObj lis = keys_to_list(keys), cp;
+    ScmSmallInt n = Scm_Length(lis), i = 0;
+    int type = DATRIE_KEY_STRING;
+
+    if (n > 0x7ffffffe) Scm_Error("too many keys for a double-array trie");
+    if (!SCM_FALSEP(values)
+        && !(SCM_VECTORP(values) && SCM_VECTOR_SIZE(values) == n)) {
+        Scm_Error("values must be #f or a vector of the same length as "
+                  "keys, but got %S", values);
+    }
+
+    KeyEntry *ents = SCM_NEW_ARRAY(KeyEntry, n);
+    SCM_FOR_EACH(cp, lis) {
+        int ktype;
+        ents[i].bytes = key_bytes(SCM_CAR(cp), &ents[i].len, &ktype);
+        ents[i].id = (ScmInt32)i;
+        if (i == 0) type = ktype;
+        else if (type != ktype) {
+            Scm_Error("keys must be all strings or all u8vectors, "
+                      "but got %S", SCM_CAR(cp));
+        }
+        i++;
+    }
+    qsort(ents, n, sizeof(KeyEntry), key_entry_cmp);
+    for (i = 1; i < n; i++) {
+        if (key_entry_cmp(&ents[i-1], &ents[i]) == 0) {
+            Scm_Error("duplicate key in double-array trie: %S",
+                      Scm_ListRef(lis, ents[i].id, SCM_UNBOUND));
+        }
+    }
+
+    Builder b;
+    b.keys = ents;
+    b.alloc = 0;
+    b.base = b.check = NULL;
+    b.alloc = 1024;
+    b.base = SCM_NEW_ATOMIC_ARRAY(ScmInt32, b.alloc);
+    b.check = SCM_NEW_ATOMIC_ARRAY(ScmInt32, b.alloc);
+    for (i = 0; i < b.alloc; i++) { b.base[i] = 0; b.check[i] = -1; }
+    b.check[1] = 0;             /* root */
+    b.maxUsed = 1;
+    b.nextCheckPos = 2;
+    if (n > 0) build_node(&b, 1, 0, n, 0);
+
+    ScmSmallInt size = b.maxUsed + 1;
+    ScmObj data = Scm_MakeUVector(SCM_CLASS_S32VECTOR,
+                                  DATRIE_HEADER_SIZE + 2*size, NULL);
+    ScmInt32 *d = SCM_S32VECTOR_ELEMENTS(data);
+    memset(d, 0, DATRIE_HEADER_SIZE * sizeof(ScmInt32));
+    d[0] = DATRIE_MAGIC;
+    d[1] = DATRIE_VERSION;
+    d[2] = (ScmInt32)size;
+    d[3] = (ScmInt32)n;
+    d[4] = type;
+    memcpy(d + DATRIE_HEADER_SIZE, b.base, size * sizeof(ScmInt32));
+    memcpy(d + DATRIE_HEADER_SIZE + size, b.check, size * sizeof(ScmInt32));
+    return DATrieFromImage(SCM_UVECTOR(data), values);
+}
+
+ScmObj DATrieFromImage(ScmUVector *data, ScmObj values)
+{
+    if (!SCM_S32VECTORP(data)) {
+        Scm_Error("s32vector required, but got %S", SCM_OBJ(data));
+    }
+    ScmSmallInt len = SCM_S32VECTOR_SIZE(data);
+    const ScmInt32 *d = SCM_S32VECTOR_ELEMENTS(data);
+    if (len < DATRIE_HEADER_SIZE) {
+        Scm_Error("invalid double-array trie image (too short): %S",
+                  SCM_OBJ(data));
+    }
+    if (d[0] != DATRIE_MAGIC) {
+        Scm_Error("invalid double-array trie image (bad magic number; "
+                  "maybe written with a different byte order): %S",
+                  SCM_OBJ(data));
+    }
+    if (d[1] != DATRIE_VERSION) {
+        Scm_Error("unsupported double-array trie image version: %d", d[1]);
+    }
+    ScmSmallInt size = d[2];
+    if (size < 2 || len != DATRIE_HEADER_SIZE + 2*size
+        || (d[4] != DATRIE_KEY_STRING && d[4] != DATRIE_KEY_U8VECTOR)) {
+        Scm_Error("invalid double-array trie image (corrupted header): %S",
+                  SCM_OBJ(data));
+    }
+    if (!SCM_FALSEP(values)
+        && !(SCM_VECTORP(values) && SCM_VECTOR_SIZE(values) == d[3])) {
+        Scm_Error("values must be #f or a vector of length %d, but got %S",
+                  d[3], values);
+    }
+
+    DATrie *t = SCM_NEW(DATrie);
+    SCM_SET_CLASS(t, SCM_CLASS_DA_TRIE);
+    t->data = data;
+    t->base = d + DATRIE_HEADER_SIZE;
+    t->check = d + DATRIE_HEADER_SIZE + size;
+    t->size = size;
+    t->numKeys = d[3];
+    t->keyType = d[4];
+    t->values = values;
+    return SCM_OBJ(t);
+}
+
+/*===================================================================
+ * Lookup
+ */
+
+ScmObj DATrieRef(DATrie *t, ScmObj key, ScmObj fallback)
+{
+    ScmSmallInt len;
+    const u_char *p = key_bytes(key, &len, NULL);
+    ScmInt32 s = 1;
+    for (ScmSmallInt i = 0; i < len; i++) {
+        s = transit(t, s, p[i] + 1);
+        if (s < 0) return fallback;
+    }
+    ScmInt32 id = terminal_id(t, s);
+    return (id < 0) ? fallback : id_to_value(t, id);
+}
+
+ScmObj DATrieLongestMatch(DATrie *t, ScmObj seq, ScmObj fallback)
+{
+    ScmSmallInt len, mlen = -1;
+    const u_char *p = key_bytes(seq, &len, NULL);
+    ScmInt32 s = 1, mid = terminal_id(t, 1);
+    if (mid >= 0) mlen = 0;
+    for (ScmSmallInt i = 0; i < len; i++) {
+        s = transit(t, s, p[i] + 1);
+        if (s < 0) break;
+        ScmInt32 id = terminal_id(t, s);
+        if (id >= 0) { mid = id; mlen = i + 1; }
+    }
+    if (mlen < 0) return fallback;
+    return Scm_Cons(make_key(t, p, mlen), id_to_value(t, mid));
+}
+
+ScmObj DATriePrefixes(DATrie *t, ScmObj seq)
+{
+    ScmSmallInt len;
+    const u_char *p = key_bytes(seq, &len, NULL);
+    ScmObj h = SCM_NIL, tail = SCM_NIL;
+    ScmInt32 s = 1;
+    for (ScmSmallInt i = 0; ; i++) {
+        ScmInt32 id = terminal_id(t, s);
+        if (id >= 0) {
+            SCM_APPEND1(h, tail, Scm_Cons(make_key(t, p, i),
+                                          id_to_value(t, id)));
+        }
+        if (i == len) break;
+        s = transit(t, s, p[i] + 1);
+        if (s < 0) break;
+    }
+    return h;
+}
+
+/*===================================================================
+ * Iterator
+ */
+
+static void iter_push(DATrieIter *it, ScmInt32 node)
+{
+    if (it->depth == it->stackSize) {
+        ScmSmallInt n = it->stackSize * 2;
+        ScmInt32 *nodes = SCM_NEW_ATOMIC_ARRAY(ScmInt32, n);
+        int *codes = SCM_NEW_ATOMIC_ARRAY(int, n);
+        memcpy(nodes, it->nodes, it->depth * sizeof(ScmInt32));
+        memcpy(codes, it->codes, it->depth * sizeof(int));
+        it->nodes = nodes;
+        it->codes = codes;
+        it->stackSize = n;
+    }
+    it->nodes[it->depth] = node;
+    it->codes[it->depth] = 0;
+    it->depth++;
+}
+
+static void iter_add_byte(DATrieIter *it, u_char byte)
+{
+    if (it->keyLen == it->keySize) {
+        ScmSmallInt n = it->keySize * 2;
+        u_char *key = SCM_NEW_ATOMIC_ARRAY(u_char, n);
+        memcpy(key, it->key, it->keyLen);
+        it->key = key;
+        it->keySize = n;
+    }
+    it->key[it->keyLen++] = byte;
+}
+
+void DATrieIterInit(DATrieIter *it, DATrie *t, ScmObj prefix)
+{
+    ScmSmallInt len;
+    const u_char *p = key_bytes(prefix, &len, NULL);
+    it->t = t;
+    it->depth = 0;
+    it->stackSize = 16;
+    it->nodes = SCM_NEW_ATOMIC_ARRAY(ScmInt32, it->stackSize);
+    it->codes = SCM_NEW_ATOMIC_ARRAY(int, it->stackSize);
+    it->keySize = len + 16;
+    it->key = SCM_NEW_ATOMIC_ARRAY(u_char, it->keySize);
+    memcpy(it->key, p, len);
+    it->prefixLen = it->keyLen = len;
+
+    ScmInt32 s = 1;
+    for (ScmSmallInt i = 0; i < len && s >= 0; i++) {
+        s = transit(t, s, p[i] + 1);
+    }
+    if (s >= 0) iter_push(it, s);
+}
+
+ScmObj DATrieIterNext(DATrieIter *it)
+{
+    DATrie *t = it->t;
+    while (it->depth > 0) {
+        ScmSmallInt top = it->depth - 1;
+        ScmInt32 s = it->nodes[top], n = -1;
+        int c = it->codes[top];
+        for (; c <= 256; c++) {
+            if ((n = transit(t, s, c)) >= 0) break;
+        }
+        if (c > 256) {
+            it->depth--;
+            if (it->keyLen > it->prefixLen) it->keyLen--;
+            continue;
+        }
+        it->codes[top] = c + 1;
+        if (c == 0) {
+            return Scm_Cons(make_key(t, it->key, it->keyLen),
+                            id_to_value(t, -t->base[n] - 1));
+        }
+        iter_add_byte(it, (u_char)(c - 1));
+        iter_push(it, n);
+    }
+    return SCM_FALSE;
+}
+
+/*===================================================================
+ * Initialization
+ */
+
+void Scm_Init_da_trie(ScmModule *mod)
+{
+    Scm_InitStaticClass(&Scm_DATrieClass, "<da-trie>", mod, NULL, 0);
+}
@@ -0,0 +1,123 @@
+/*
+ * da-trie.h - Double-array trie
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_DA_TRIE_H
+#define GAUCHE_DA_TRIE_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+
+#if defined(EXTDATA_EXPORTS)
+#define LIBGAUCHE_EXT_BODY
+#endif
+#include <gauche/extern.h>      /* redefine SCM_EXTERN */
+
+/*
+ * Double-array trie
+ *
+ *   A static trie of byte sequences, represented by two int32
+ *   arrays BASE and CHECK.  A transition from node S by code C goes
+ *   to T = BASE[S] + C, which is valid iff CHECK[T] == S.  A byte B
+ *   has the code B+1; the code 0 marks the end of a key, and the
+ *   BASE of such a terminal cell is -(ID+1), where ID is the index of
+ *   the key in the original key list.  The root is cell 1.
+ *
+ *   Both arrays are kept in a single s32vector with a small header,
+ *   so that it can be written out and memory-mapped back as is:
+ *
+ *     [0] DATRIE_MAGIC   [1] DATRIE_VERSION   [2] # of cells
+ *     [3] # of keys      [4] key type         [5-7] reserved
+ *     [8..]  BASE        [8+#cells..]  CHECK
+ *
+ *   Numbers are in the native byte order; the magic number tells
+ *   if the file is written on a machine with a different one.
+ */
+
+#define DATRIE_MAGIC        0x54414447 /* "GDAT" in little endian */
+#define DATRIE_VERSION      1
+#define DATRIE_HEADER_SIZE  8
+
+enum {
+    DATRIE_KEY_STRING,          /* keys are strings */
+    DATRIE_KEY_U8VECTOR         /* keys are u8vectors */
+};
+
+typedef struct DATrieRec {
+    SCM_HEADER;
+    ScmUVector *data;           /* s32vector of the whole image */
+    const ScmInt32 *base;
+    const ScmInt32 *check;
+    ScmSmallInt size;           /* # of cells */
+    ScmSmallInt numKeys;
+    int keyType;
+    ScmObj values;              /* vector indexed by id, or #f */
+} DATrie;
+
+SCM_CLASS_DECL(Scm_DATrieClass);
+#define SCM_CLASS_DA_TRIE       (&Scm_DATrieClass)
+#define DA_TRIE(obj)            ((DATrie*)(obj))
+#define DA_TRIE_P(obj)          SCM_XTYPEP(obj, SCM_CLASS_DA_TRIE)
+
+/* KEYS is a list or a vector of strings or u8vectors. */
+extern ScmObj MakeDATrie(ScmObj keys, ScmObj values);
+/* DATA is an image created by MakeDATrie. */
+extern ScmObj DATrieFromImage(ScmUVector *data, ScmObj values);
+
+/* Returns the value of KEY, or FALLBACK. */
+extern ScmObj DATrieRef(DATrie *t, ScmObj key, ScmObj fallback);
+/* Returns (key . value) of the longest key that is a prefix of SEQ,
+   or FALLBACK. */
+extern ScmObj DATrieLongestMatch(DATrie *t, ScmObj seq, ScmObj fallback);
+/* Returns a list of (key . value) of the keys that are prefixes of SEQ,
+   from shorter to longer. */
+extern ScmObj DATriePrefixes(DATrie *t, ScmObj seq);
+
+/* Iterator over the keys that start with a prefix, in the byte order. */
+typedef struct DATrieIterRec {
+    DATrie       *t;
+    ScmSmallInt   depth;        /* # of entries in the stack */
+    ScmSmallInt   stackSize;
+    ScmInt32     *nodes;
+    int          *codes;        /* next code to try at each level */
+    ScmSmallInt   prefixLen;
+    ScmSmallInt   keyLen;
+    ScmSmallInt   keySize;
+    u_char       *key;
+} DATrieIter;
+
+extern void   DATrieIterInit(DATrieIter *it, DATrie *t, ScmObj prefix);
+extern ScmObj DATrieIterNext(DATrieIter *it); /* (key . value) or #f */
+
+extern void   Scm_Init_da_trie(ScmModule *mod);
+
+#endif /*GAUCHE_DA_TRIE_H*/
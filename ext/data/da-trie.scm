@@ -0,0 +1,163 @@
+;;;
+;;; data.da-trie - static double-array trie
+;;;
+;;;
+;;;   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; A compact, static trie for string or u8vector keys in the double-array
+;; representation.  It is built once from a set of keys and can't be
+;; modified, but every lookup is a couple of array references per byte,
+;; and the whole trie is a single s32vector that can be saved to a file
+;; and memory-mapped back.  The core is in da-trie.c.
+
+(define-module data.da-trie
+  (use gauche.uvector)
+  (use gauche.dictionary)
+  (export <da-trie> make-da-trie da-trie? da-trie-num-entries
+          da-trie-exists? da-trie-get da-trie-longest-match
+          da-trie-prefixes da-trie-common-prefix-fold
+          da-trie-common-prefix-keys da-trie-common-prefix-values
+          da-trie-fold da-trie-keys da-trie-values da-trie->alist
+          da-trie-image save-da-trie load-da-trie)
+  )
+(select-module data.da-trie)
+
+(inline-stub
+ (declcode "#include \"da-trie.h\"")
+ (initcode "Scm_Init_da_trie(Scm_CurrentModule());")
+
+ (define-type <da-trie> "DATrie*" "da-trie" "DA_TRIE_P" "DA_TRIE")
+
+ (define-cproc make-da-trie (keys :optional (values #f)) MakeDATrie)
+
+ (define-cproc %image->da-trie (image::<s32vector> values)
+   (return (DATrieFromImage image values)))
+
+ (define-cproc da-trie-image (t::<da-trie>)
+   (return (SCM_OBJ (-> t data))))
+
+ (define-cproc %da-trie-string-keys? (t::<da-trie>) ::<boolean>
+   (return (== (-> t keyType) DATRIE_KEY_STRING)))
+
+ (define-cproc da-trie-num-entries (t::<da-trie>) ::<long>
+   (return (-> t numKeys)))
+
+ (define-cproc da-trie-exists? (t::<da-trie> key) ::<boolean>
+   (return (not (SCM_UNBOUNDP (DATrieRef t key SCM_UNBOUND)))))
+
+ (define-cproc da-trie-get (t::<da-trie> key :optional fallback)
+   (let* ([r (DATrieRef t key fallback)])
+     (when (SCM_UNBOUNDP r)
+       (Scm_Error "%S doesn't have an entry for key %S" (SCM_OBJ t) key))
+     (return r)))
+
+ (define-cproc da-trie-longest-match (t::<da-trie> seq :optional fallback)
+   (let* ([r (DATrieLongestMatch t seq fallback)])
+     (when (SCM_UNBOUNDP r)
+       (Scm_Error "%S doesn't have a key that is a prefix of %S"
+                  (SCM_OBJ t) seq))
+     (return r)))
+
+ (define-cproc da-trie-prefixes (t::<da-trie> seq) DATriePrefixes)
+
+ (define-cfn da-trie-iter (args::ScmObj* nargs::int data::void*) :static
+   (let* ([iter::DATrieIter* (cast DATrieIter* data)]
+          [r (DATrieIterNext iter)]
+          [eofval (aref args 0)])
+     (if (SCM_FALSEP r)
+       (return (values eofval eofval))
+       (return (values (SCM_CAR r) (SCM_CDR r))))))
+
+ ;; Iterates over the keys that begin with PREFIX, in lexicographic
+ ;; order of their bytes.
+ (define-cproc %da-trie-iter (t::<da-trie> prefix)
+   (let* ([iter::DATrieIter* (SCM_NEW DATrieIter)])
+     (DATrieIterInit iter t prefix)
+     (return (Scm_MakeSubr da-trie-iter iter 1 0 '"da-trie-iterator"))))
+ )
+
+(define (da-trie? obj) (is-a? obj <da-trie>))
+
+(define (%empty-key t)
+  (if (%da-trie-string-keys? t) "" '#u8()))
+
+;; PROC is called with each key in T that begins with PREFIX, its value
+;; and the seed, in lexicographic order of the keys; the last one is
+;; the outermost call.
+(define (da-trie-common-prefix-fold t prefix proc seed)
+  (let ([iter (%da-trie-iter t prefix)]
+        [end  (list #f)])
+    (let loop ([seed seed])
+      (receive (key val) (iter end)
+        (if (eq? key end)
+          seed
+          (loop (proc key val seed)))))))
+
+(define (da-trie-common-prefix-keys t prefix)
+  (reverse! (da-trie-common-prefix-fold t prefix (^[k v s] (cons k s)) '())))
+(define (da-trie-common-prefix-values t prefix)
+  (reverse! (da-trie-common-prefix-fold t prefix (^[k v s] (cons v s)) '())))
+
+(define (da-trie-fold t proc seed)
+  (da-trie-common-prefix-fold t (%empty-key t) proc seed))
+(define (da-trie-keys t)
+  (da-trie-common-prefix-keys t (%empty-key t)))
+(define (da-trie-values t)
+  (da-trie-common-prefix-values t (%empty-key t)))
+(define (da-trie->alist t)
+  (reverse! (da-trie-fold t acons '())))
+
+;; Serialization.  The image is written in the native byte order; load-da-trie
+;; rejects an image with a foreign byte order.  Values aren't saved---a trie
+;; loaded without VALUES maps each key to its index in the original key list.
+(define (save-da-trie t path)
+  (call-with-output-file path
+    (cut write-uvector (da-trie-image t) <>)))
+
+(define (load-da-trie path :key (values #f) (mmap #t))
+  (%image->da-trie
+   (cond-expand
+    [gauche.os.windows (%read-image path)]
+    [else (if mmap (mmap-uvector <s32vector> path) (%read-image path))])
+   values))
+
+(define (%read-image path)
+  (call-with-input-file path
+    (cut port->uvector <> <s32vector>)))
+
+;; Dictionary interface
+(define-method dict-put! ((t <da-trie>) key value)
+  (errorf "da-trie is immutable: ~s" t))
+
+(define-dict-interface <da-trie>
+  :get     da-trie-get
+  :exists? da-trie-exists?
+  :fold    da-trie-fold)
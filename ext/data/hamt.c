@@ -0,0 +1,700 @@
+/*
+ * hamt.c - Persistent hash array mapped trie
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "hamt.h"
+#include <gauche/bits_inline.h>
+#include <string.h>
+
+#define HAMT_BITS   5
+#define HAMT_MASK   ((1UL<<HAMT_BITS)-1)
+
+struct HamtLeafRec {
+    u_long    hash;             /* 32-bit hash value */
+    ScmObj    key;
+    ScmObj    value;
+    HamtLeaf *next;             /* other leaves with the same hash value */
+};
+
+/* A node with a single leaf is never stored below the root; the leaf
+   is kept in the parent's slot instead.  This makes the shape of the
+   trie depend only on the set of hash values, so that two hamts with
+   the same keys can be compared node by node. */
+struct HamtNodeRec {
+    u_long emap;                /* bit i is set iff slot i is occupied */
+    u_long lmap;                /* bit i is set iff slot i holds a leaf */
+    void  *edit;                /* token of the transient that owns this */
+    void  *entries[1];          /* variable length */
+};
+
+#define NODE_SIZE(n)        ((int)Scm__CountBitsInWord((n)->emap))
+#define NODE_INDEX(n, bit)  ((int)Scm__CountBitsInWord((n)->emap&((bit)-1)))
+#define SLOT_BIT(hv, shift) ((hv >> shift) & HAMT_MASK)
+
+SCM_DEFINE_BUILTIN_CLASS(Scm_HamtClass,
+                         NULL, NULL, NULL, NULL,
+                         SCM_CLASS_DICTIONARY_CPL);
+SCM_DEFINE_BUILTIN_CLASS(Scm_TransientHamtClass,
+                         NULL, NULL, NULL, NULL,
+                         SCM_CLASS_DICTIONARY_CPL);
+
+/*===================================================================
+ * Hash and equality
+ */
+
+static u_long string_hash(ScmObj key)
+{
+    if (!SCM_STRINGP(key)) {
+        Scm_Error("string hamt got non-string key: %S", key);
+    }
+    return Scm_HashString(SCM_STRING(key), 0);
+}
+
+static int string_cmp(ScmObj a, ScmObj b)
+{
+    if (!SCM_STRINGP(a)) {
+        Scm_Error("string hamt got non-string key: %S", a);
+    }
+    if (!SCM_STRINGP(b)) {
+        Scm_Error("string hamt got non-string key: %S", b);
+    }
+    return Scm_StringEqual(SCM_STRING(a), SCM_STRING(b));
+}
+
+static u_long equal_hash(ScmObj key)
+{
+    return (u_long)Scm_DefaultHash(key);
+}
+
+static u_long hamt_hash(Hamt *h, ScmObj key)
+{
+    u_long hv;
+    if (h->hashfn) {
+        hv = h->hashfn(key);
+    } else {
+        ScmObj f = h->comparator->hashFn;
+        ScmObj r = Scm_ApplyRec1(f, key);
+        if (!SCM_INTEGERP(r)) {
+            Scm_Error("hash function %S returns non-integer: %S", f, r);
+        }
+        hv = Scm_GetIntegerU(r);
+    }
+    /* We only use 32 bits. */
+#if SIZEOF_LONG > 4
+    hv ^= hv >> 32;
+#endif
+    return hv & 0xffffffffUL;
+}
+
+static int hamt_eq(Hamt *h, ScmObj a, ScmObj b)
+{
+    if (h->cmpfn) return h->cmpfn(a, b);
+    ScmObj e = h->comparator->eqFn;
+    ScmObj r = Scm_ApplyRec2(e, a, b);
+    return !SCM_FALSEP(r);
+}
+
+/*===================================================================
+ * Constructor
+ */
+
+static Hamt *hamt_allocate(ScmClass *klass, const Hamt *proto,
+                           HamtNode *root, u_long numEntries)
+{
+    Hamt *h = SCM_NEW(Hamt);
+    SCM_SET_CLASS(h, klass);
+    h->root = root;
+    h->numEntries = numEntries;
+    h->edit = NULL;
+    h->hashfn = proto->hashfn;
+    h->cmpfn = proto->cmpfn;
+    h->comparator = proto->comparator;
+    return h;
+}
+
+static HamtNode *node_allocate(int size, void *edit)
+{
+    HamtNode *n = SCM_NEW2(HamtNode*,
+                           sizeof(HamtNode)+sizeof(void*)*(size>0?size-1:0));
+    n->emap = n->lmap = 0;
+    n->edit = edit;
+    return n;
+}
+
+ScmObj MakeHamt(ScmHashType type, ScmComparator *comparator)
+{
+    Hamt proto;
+    switch (type) {
+    case SCM_HASH_EQ:
+        proto.hashfn = Scm_EqHash;
+        proto.cmpfn = Scm_EqP;
+        break;
+    case SCM_HASH_EQV:
+        proto.hashfn = Scm_EqvHash;
+        proto.cmpfn = Scm_EqvP;
+        break;
+    case SCM_HASH_EQUAL:
+        proto.hashfn = equal_hash;
+        proto.cmpfn = Scm_EqualP;
+        break;
+    case SCM_HASH_STRING:
+        proto.hashfn = string_hash;
+        proto.cmpfn = string_cmp;
+        break;
+    case SCM_HASH_GENERAL:
+        SCM_ASSERT(comparator != NULL);
+        proto.hashfn = NULL;
+        proto.cmpfn = NULL;
+        break;
+    default:
+        Scm_Error("invalid hash type (%d) for a hamt", type);
+    }
+    proto.comparator = comparator;
+    return SCM_OBJ(hamt_allocate(SCM_CLASS_HAMT, &proto,
+                                 node_allocate(0, NULL), 0));
+}
+
+/*===================================================================
+ * Leaves
+ */
+
+static HamtLeaf *leaf_new(u_long hv, ScmObj key, ScmObj value,
+                          HamtLeaf *next)
+{
+    HamtLeaf *z = SCM_NEW(HamtLeaf);
+    z->hash = hv;
+    z->key = key;
+    z->value = value;
+    z->next = next;
+    return z;
+}
+
+static HamtLeaf *chain_find(Hamt *h, HamtLeaf *chain, ScmObj key)
+{
+    for (; chain; chain = chain->next) {
+        if (hamt_eq(h, key, chain->key)) return chain;
+    }
+    return NULL;
+}
+
+/* Returns a chain where OLD is replaced by NEW.  NEW must already be
+   linked to the rest of the chain after OLD (or be OLD->next itself,
+   for deletion).  The leaves before OLD are copied. */
+static HamtLeaf *chain_replace(HamtLeaf *chain, HamtLeaf *old, HamtLeaf *new)
+{
+    if (chain == old) return new;
+    return leaf_new(chain->hash, chain->key, chain->value,
+                    chain_replace(chain->next, old, new));
+}
+
+/*===================================================================
+ * Node manipulation
+ *
+ *  These return the modified node.  A node owned by the transient H
+ *  is modified in place if possible; otherwise a copy is returned.
+ */
+
+static inline int node_editable(Hamt *h, HamtNode *n)
+{
+    return (h->edit != NULL && n->edit == h->edit);
+}
+
+/* Replace the entry of the occupied slot BIT. */
+static HamtNode *node_replace(Hamt *h, HamtNode *n, u_long bit,
+                              void *entry, int leafp)
+{
+    if (!node_editable(h, n)) {
+        int size = NODE_SIZE(n);
+        HamtNode *m = node_allocate(size, h->edit);
+        m->emap = n->emap;
+        m->lmap = n->lmap;
+        memcpy(m->entries, n->entries, sizeof(void*)*size);
+        n = m;
+    }
+    n->entries[NODE_INDEX(n, bit)] = entry;
+    if (leafp) n->lmap |= bit;
+    else       n->lmap &= ~bit;
+    return n;
+}
+
+/* Put a leaf in the empty slot BIT.  Always allocates. */
+static HamtNode *node_insert(Hamt *h, HamtNode *n, u_long bit, HamtLeaf *z)
+{
+    int size = NODE_SIZE(n);
+    int pos = NODE_INDEX(n, bit);
+    HamtNode *m = node_allocate(size+1, h->edit);
+    m->emap = n->emap | bit;
+    m->lmap = n->lmap | bit;
+    memcpy(m->entries, n->entries, sizeof(void*)*pos);
+    m->entries[pos] = z;
+    memcpy(m->entries+pos+1, n->entries+pos, sizeof(void*)*(size-pos));
+    return m;
+}
+
+/* Empty the slot BIT. */
+static HamtNode *node_remove(Hamt *h, HamtNode *n, u_long bit)
+{
+    int size = NODE_SIZE(n);
+    int pos = NODE_INDEX(n, bit);
+    if (node_editable(h, n)) {
+        memmove(n->entries+pos, n->entries+pos+1,
+                sizeof(void*)*(size-pos-1));
+        n->entries[size-1] = NULL;
+        n->emap &= ~bit;
+        n->lmap &= ~bit;
+        return n;
+    }
+    HamtNode *m = node_allocate(size-1, h->edit);
+    m->emap = n->emap & ~bit;
+    m->lmap = n->lmap & ~bit;
+    memcpy(m->entries, n->entries, sizeof(void*)*pos);
+    memcpy(m->entries+pos, n->entries+pos+1, sizeof(void*)*(size-pos-1));
+    return m;
+}
+
+/* Create a subtree at level SHIFT that holds two leaves with different
+   hash values. */
+static HamtNode *node_pair(Hamt *h, HamtLeaf *a, HamtLeaf *b, int shift)
+{
+    u_long ia = SLOT_BIT(a->hash, shift);
+    u_long ib = SLOT_BIT(b->hash, shift);
+
+    if (ia == ib) {
+        HamtNode *n = node_allocate(1, h->edit);
+        n->emap = 1UL<<ia;
+        n->entries[0] = node_pair(h, a, b, shift+HAMT_BITS);
+        return n;
+    }
+    HamtNode *n = node_allocate(2, h->edit);
+    n->emap = n->lmap = (1UL<<ia) | (1UL<<ib);
+    n->entries[0] = (ia < ib)? a : b;
+    n->entries[1] = (ia < ib)? b : a;
+    return n;
+}
+
+/*===================================================================
+ * Lookup
+ */
+
+static HamtLeaf *hamt_find(Hamt *h, ScmObj key, u_long hv)
+{
+    HamtNode *n = h->root;
+    for (int shift = 0; ; shift += HAMT_BITS) {
+        u_long bit = 1UL<<SLOT_BIT(hv, shift);
+        if (!(n->emap & bit)) return NULL;
+        void *e = n->entries[NODE_INDEX(n, bit)];
+        if (n->lmap & bit) {
+            HamtLeaf *z = (HamtLeaf*)e;
+            if (z->hash != hv) return NULL;
+            return chain_find(h, z, key);
+        }
+        n = (HamtNode*)e;
+    }
+}
+
+ScmObj HamtRef(Hamt *h, ScmObj key, ScmObj fallback)
+{
+    HamtLeaf *z = hamt_find(h, key, hamt_hash(h, key));
+    return z? z->value : fallback;
+}
+
+/*===================================================================
+ * Insertion
+ */
+
+/* Returns the node that should take N's place.  It is N itself if
+   nothing has changed or N is modified in place. */
+static HamtNode *node_put(Hamt *h, HamtNode *n, int shift, u_long hv,
+                          ScmObj key, ScmObj value, int *added)
+{
+    u_long bit = 1UL<<SLOT_BIT(hv, shift);
+
+    if (!(n->emap & bit)) {
+        *added = TRUE;
+        return node_insert(h, n, bit, leaf_new(hv, key, value, NULL));
+    }
+
+    void *e = n->entries[NODE_INDEX(n, bit)];
+    if (n->lmap & bit) {
+        HamtLeaf *z = (HamtLeaf*)e;
+        if (z->hash == hv) {
+            HamtLeaf *p = chain_find(h, z, key);
+            HamtLeaf *c;
+            if (p == NULL) {
+                *added = TRUE;
+                c = leaf_new(hv, key, value, z);
+            } else if (p->value == value) {
+                return n;
+            } else {
+                c = chain_replace(z, p, leaf_new(hv, p->key, value, p->next));
+            }
+            return node_replace(h, n, bit, c, TRUE);
+        } else {
+            *added = TRUE;
+            HamtNode *s = node_pair(h, z, leaf_new(hv, key, value, NULL),
+                                    shift+HAMT_BITS);
+            return node_replace(h, n, bit, s, FALSE);
+        }
+    } else {
+        HamtNode *s = (HamtNode*)e;
+        HamtNode *r = node_put(h, s, shift+HAMT_BITS, hv, key, value, added);
+        if (r == s) return n;
+        return node_replace(h, n, bit, r, FALSE);
+    }
+}
+
+ScmObj HamtPut(Hamt *h, ScmObj key, ScmObj value)
+{
+    int added = FALSE;
+    HamtNode *r = node_put(h, h->root, 0, hamt_hash(h, key), key, value,
+                           &added);
+    if (r == h->root) return SCM_OBJ(h);
+    return SCM_OBJ(hamt_allocate(SCM_CLASS_HAMT, h, r,
+                                 h->numEntries + (added?1:0)));
+}
+
+/*===================================================================
+ * Deletion
+ */
+
+/* Returns the entry that should take N's place.  It is N itself if
+   KEY isn't found or N is modified in place, and NULL if N becomes
+   empty.  If a non-root node is left with just one leaf, the leaf
+   is returned with *leafp set, so that the parent holds it directly. */
+static void *node_delete(Hamt *h, HamtNode *n, int shift, u_long hv,
+                         ScmObj key, int *leafp, int *removed)
+{
+    u_long bit = 1UL<<SLOT_BIT(hv, shift);
+    HamtNode *m;
+
+    *leafp = FALSE;
+    if (!(n->emap & bit)) return n;
+
+    void *e = n->entries[NODE_INDEX(n, bit)];
+    if (n->lmap & bit) {
+        HamtLeaf *z = (HamtLeaf*)e;
+        if (z->hash != hv) return n;
+        HamtLeaf *p = chain_find(h, z, key);
+        if (p == NULL) return n;
+        *removed = TRUE;
+        HamtLeaf *c = chain_replace(z, p, p->next);
+        if (c) m = node_replace(h, n, bit, c, TRUE);
+        else   m = node_remove(h, n, bit);
+    } else {
+        HamtNode *s = (HamtNode*)e;
+        int sleafp;
+        void *r = node_delete(h, s, shift+HAMT_BITS, hv, key,
+                              &sleafp, removed);
+        if (r == s) return n;
+        if (r == NULL) m = node_remove(h, n, bit);
+        else           m = node_replace(h, n, bit, r, sleafp);
+    }
+
+    if (shift > 0) {
+        if (m->emap == 0) return NULL;
+        if (m->emap == m->lmap && NODE_SIZE(m) == 1) {
+            *leafp = TRUE;
+            return m->entries[0];
+        }
+    }
+    return m;
+}
+
+ScmObj HamtDelete(Hamt *h, ScmObj key)
+{
+    int leafp, removed = FALSE;
+    HamtNode *r = (HamtNode*)node_delete(h, h->root, 0, hamt_hash(h, key),
+                                         key, &leafp, &removed);
+    if (!removed) return SCM_OBJ(h);
+    return SCM_OBJ(hamt_allocate(SCM_CLASS_HAMT, h, r, h->numEntries - 1));
+}
+
+/*===================================================================
+ * Transients
+ */
+
+ScmObj HamtTransient(Hamt *h)
+{
+    Hamt *t = hamt_allocate(SCM_CLASS_TRANSIENT_HAMT, h,
+                            h->root, h->numEntries);
+    /* The token must be a fresh object.  Nodes created by T keep
+       a reference to it, so it won't be reused by another transient
+       while any of them is alive. */
+    t->edit = SCM_NEW_ATOMIC(char);
+    return SCM_OBJ(t);
+}
+
+static void check_transient(Hamt *t)
+{
+    if (t->edit == NULL) {
+        Scm_Error("transient hamt is already made persistent: %S",
+                  SCM_OBJ(t));
+    }
+}
+
+void HamtTransientPut(Hamt *t, ScmObj key, ScmObj value)
+{
+    int added = FALSE;
+    check_transient(t);
+    t->root = node_put(t, t->root, 0, hamt_hash(t, key), key, value, &added);
+    if (added) t->numEntries++;
+}
+
+int HamtTransientDelete(Hamt *t, ScmObj key)
+{
+    int leafp, removed = FALSE;
+    check_transient(t);
+    t->root = (HamtNode*)node_delete(t, t->root, 0, hamt_hash(t, key),
+                                     key, &leafp, &removed);
+    if (removed) t->numEntries--;
+    return removed;
+}
+
+/* The nodes owned by T become immutable, since nobody has T's token
+   any longer.  T itself can still be read. */
+ScmObj HamtPersistent(Hamt *t)
+{
+    check_transient(t);
+    t->edit = NULL;
+    return SCM_OBJ(hamt_allocate(SCM_CLASS_HAMT, t, t->root, t->numEntries));
+}
+
+/*===================================================================
+ * Equality
+ */
+
+static int value_equal(ScmObj value_eq, ScmObj a, ScmObj b)
+{
+    if (SCM_FALSEP(value_eq)) return Scm_EqualP(a, b);
+    return !SCM_FALSEP(Scm_ApplyRec2(value_eq, a, b));
+}
+
+static int chain_equal(Hamt *h, HamtLeaf *a, HamtLeaf *b, ScmObj value_eq)
+{
+    if (a == b) return TRUE;
+    if (a->hash != b->hash) return FALSE;
+
+    int na = 0, nb = 0;
+    for (HamtLeaf *p = a; p; p = p->next) na++;
+    for (HamtLeaf *p = b; p; p = p->next) nb++;
+    if (na != nb) return FALSE;
+
+    for (; a; a = a->next) {
+        HamtLeaf *p = chain_find(h, b, a->key);
+        if (p == NULL) return FALSE;
+        if (!value_equal(value_eq, a->value, p->value)) return FALSE;
+    }
+    return TRUE;
+}
+
+/* Since the shape is determined by the set of hash values, equal
+   hamts have nodes with the same bitmaps at the same places.
+   A subtree shared by both is skipped without looking into it. */
+static int node_equal(Hamt *h, HamtNode *a, HamtNode *b, ScmObj value_eq)
+{
+    if (a == b) return TRUE;
+    if (a->emap != b->emap || a->lmap != b->lmap) return FALSE;
+
+    int size = NODE_SIZE(a);
+    u_long rest = a->emap;
+    for (int i = 0; i < size; i++) {
+        u_long bit = rest & -rest;
+        rest &= ~bit;
+        if (a->lmap & bit) {
+            if (!chain_equal(h, (HamtLeaf*)a->entries[i],
+                             (HamtLeaf*)b->entries[i], value_eq)) {
+                return FALSE;
+            }
+        } else {
+            if (!node_equal(h, (HamtNode*)a->entries[i],
+                            (HamtNode*)b->entries[i], value_eq)) {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+int HamtEqual(Hamt *a, Hamt *b, ScmObj value_eq)
+{
+    if (a->numEntries != b->numEntries) return FALSE;
+    if (a->comparator == b->comparator) {
+        return node_equal(a, a->root, b->root, value_eq);
+    }
+    /* Different hash functions; look up each key. */
+    HamtIter iter;
+    HamtIterInit(&iter, a);
+    for (;;) {
+        ScmObj p = HamtIterNext(&iter);
+        if (SCM_FALSEP(p)) break;
+        ScmObj v = HamtRef(b, SCM_CAR(p), SCM_UNBOUND);
+        if (SCM_UNBOUNDP(v)) return FALSE;
+        if (!value_equal(value_eq, SCM_CDR(p), v)) return FALSE;
+    }
+    return TRUE;
+}
+
+/*===================================================================
+ * Iterator
+ */
+
+void HamtIterInit(HamtIter *it, Hamt *h)
+{
+    it->h = h;
+    it->depth = 0;
+    it->nodes[0] = h->root;
+    it->rest[0] = h->root->emap;
+    it->chain = NULL;
+}
+
+ScmObj HamtIterNext(HamtIter *it)
+{
+    if (it->chain && it->chain->next) {
+        it->chain = it->chain->next;
+        return Scm_Cons(it->chain->key, it->chain->value);
+    }
+    while (it->depth >= 0) {
+        u_long rest = it->rest[it->depth];
+        if (rest == 0) {
+            it->depth--;
+            continue;
+        }
+        HamtNode *n = it->nodes[it->depth];
+        int b = Scm__LowestBitNumber(rest);
+        it->rest[it->depth] = rest & ~(1UL<<b);
+        void *e = n->entries[NODE_INDEX(n, 1UL<<b)];
+        if (n->lmap & (1UL<<b)) {
+            it->chain = (HamtLeaf*)e;
+            return Scm_Cons(it->chain->key, it->chain->value);
+        }
+        SCM_ASSERT(it->depth < HAMT_MAX_DEPTH-1);
+        it->depth++;
+        it->nodes[it->depth] = (HamtNode*)e;
+        it->rest[it->depth] = ((HamtNode*)e)->emap;
+    }
+    it->chain = NULL;
+    return SCM_FALSE;
+}
+
+/*===================================================================
+ * Debugging aid
+ */
+
+static void node_dump(ScmPort *out, HamtNode *n, int level)
+{
+    u_long rest = n->emap;
+    while (rest) {
+        int b = Scm__LowestBitNumber(rest);
+        rest &= ~(1UL<<b);
+        void *e = n->entries[NODE_INDEX(n, 1UL<<b)];
+        Scm_Printf(out, "%*s%2d: ", level*2, "", b);
+        if (n->lmap & (1UL<<b)) {
+            for (HamtLeaf *z = (HamtLeaf*)e; z; z = z->next) {
+                Scm_Printf(out, "[%08lx] %S => %S ", z->hash,
+                           z->key, z->value);
+            }
+            Scm_Putc('\n', out);
+        } else {
+            Scm_Printf(out, "%p\n", e);
+            node_dump(out, (HamtNode*)e, level+1);
+        }
+    }
+}
+
+void HamtDump(Hamt *h)
+{
+    ScmPort *out = SCM_CUROUT;
+    Scm_Printf(out, "%S (%lu entries)\n", SCM_OBJ(h), h->numEntries);
+    node_dump(out, h->root, 0);
+}
+
+/* Checks the invariants, and returns the number of entries. */
+static u_long node_check(Hamt *h, HamtNode *n, int shift, u_long prefix)
+{
+    u_long count = 0;
+    int size = NODE_SIZE(n);
+
+    if ((n->lmap & ~n->emap) != 0) {
+        Scm_Error("%S: lmap has a bit not in emap", SCM_OBJ(h));
+    }
+    if (shift > 0) {
+        if (size == 0) Scm_Error("%S: empty non-root node", SCM_OBJ(h));
+        if (size == 1 && n->lmap) {
+            Scm_Error("%S: non-root node with only one leaf", SCM_OBJ(h));
+        }
+    }
+    u_long rest = n->emap;
+    while (rest) {
+        int b = Scm__LowestBitNumber(rest);
+        rest &= ~(1UL<<b);
+        void *e = n->entries[NODE_INDEX(n, 1UL<<b)];
+        u_long p = prefix | ((u_long)b << shift);
+        if (n->lmap & (1UL<<b)) {
+            HamtLeaf *z = (HamtLeaf*)e;
+            u_long mask = (shift+HAMT_BITS >= 32)
+                ? 0xffffffffUL : ((1UL<<(shift+HAMT_BITS))-1);
+            if ((z->hash & mask) != p) {
+                Scm_Error("%S: leaf %S in a wrong slot", SCM_OBJ(h), z->key);
+            }
+            for (; z; z = z->next) {
+                if (z->next && z->next->hash != z->hash) {
+                    Scm_Error("%S: chained leaf %S has a different hash",
+                              SCM_OBJ(h), z->next->key);
+                }
+                count++;
+            }
+        } else {
+            count += node_check(h, (HamtNode*)e, shift+HAMT_BITS, p);
+        }
+    }
+    return count;
+}
+
+void HamtCheck(Hamt *h)
+{
+    u_long count = node_check(h, h->root, 0, 0);
+    if (count != h->numEntries) {
+        Scm_Error("%S: numEntries (%lu) doesn't match the actual count (%lu)",
+                  SCM_OBJ(h), h->numEntries, count);
+    }
+}
+
+/*===================================================================
+ * Initialization
+ */
+
+void Scm_Init_hamt(ScmModule *mod)
+{
+    Scm_InitStaticClass(&Scm_HamtClass, "<hamt>", mod, NULL, 0);
+    Scm_InitStaticClass(&Scm_TransientHamtClass, "<transient-hamt>",
+                        mod, NULL, 0);
+}
@@ -0,0 +1,115 @@
+/*
+ * hamt.h - Persistent hash array mapped trie
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_HAMT_H
+#define GAUCHE_HAMT_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+
+#if defined(EXTDATA_EXPORTS)
+#define LIBGAUCHE_EXT_BODY
+#endif
+#include <gauche/extern.h>      /* redefine SCM_EXTERN */
+
+/*
+ * Hash array mapped trie (HAMT)
+ *
+ *   A persistent map.  Each node has 32 slots indexed by 5 bits
+ *   of the key's hash value.  Only occupied slots are allocated; a
+ *   bitmap tells which slots are used, and another bitmap tells
+ *   which of them holds a leaf rather than a subnode (the same
+ *   scheme as ctrie in ext/sparse).
+ *
+ *   Updates copy the nodes on the path from the root to the
+ *   modified slot, and share everything else with the original.
+ *   A transient hamt can modify the nodes it has created itself in
+ *   place, which makes batch updates cheaper.
+ */
+
+typedef struct HamtNodeRec HamtNode;
+
+typedef struct HamtRec {
+    SCM_HEADER;
+    HamtNode   *root;
+    u_long      numEntries;
+    void       *edit;           /* owner token if transient, NULL otherwise */
+    u_long      (*hashfn)(ScmObj key);
+    int         (*cmpfn)(ScmObj a, ScmObj b);
+    ScmComparator *comparator;
+} Hamt;
+
+SCM_CLASS_DECL(Scm_HamtClass);
+#define SCM_CLASS_HAMT          (&Scm_HamtClass)
+#define HAMT(obj)               ((Hamt*)(obj))
+#define HAMT_P(obj)             SCM_XTYPEP(obj, SCM_CLASS_HAMT)
+
+SCM_CLASS_DECL(Scm_TransientHamtClass);
+#define SCM_CLASS_TRANSIENT_HAMT (&Scm_TransientHamtClass)
+#define TRANSIENT_HAMT(obj)     ((Hamt*)(obj))
+#define TRANSIENT_HAMT_P(obj)   SCM_XTYPEP(obj, SCM_CLASS_TRANSIENT_HAMT)
+
+extern ScmObj MakeHamt(ScmHashType type, ScmComparator *comparator);
+extern ScmObj HamtRef(Hamt *h, ScmObj key, ScmObj fallback);
+extern ScmObj HamtPut(Hamt *h, ScmObj key, ScmObj value);
+extern ScmObj HamtDelete(Hamt *h, ScmObj key);
+extern int    HamtEqual(Hamt *a, Hamt *b, ScmObj value_eq);
+
+/* Transients */
+extern ScmObj HamtTransient(Hamt *h);
+extern void   HamtTransientPut(Hamt *t, ScmObj key, ScmObj value);
+extern int    HamtTransientDelete(Hamt *t, ScmObj key);
+extern ScmObj HamtPersistent(Hamt *t);
+
+extern void   HamtDump(Hamt *h);
+extern void   HamtCheck(Hamt *h);
+
+/* Iterator */
+#define HAMT_MAX_DEPTH 7        /* ceil(32/5) */
+
+typedef struct HamtLeafRec HamtLeaf;
+
+typedef struct HamtIterRec {
+    Hamt     *h;
+    int       depth;
+    HamtNode *nodes[HAMT_MAX_DEPTH];
+    u_long    rest[HAMT_MAX_DEPTH]; /* slots not visited yet */
+    HamtLeaf *chain;
+} HamtIter;
+
+extern void   HamtIterInit(HamtIter *it, Hamt *h);
+extern ScmObj HamtIterNext(HamtIter *it); /* (key . value) or #f */
+
+extern void   Scm_Init_hamt(ScmModule *mod);
+
+#endif /*GAUCHE_HAMT_H*/
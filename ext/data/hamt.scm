@@ -0,0 +1,220 @@
+;;;
+;;; data.hamt - persistent hash array mapped trie
+;;;
+;;;
+;;;   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; A persistent (immutable) map based on the hash array mapped trie.
+;; Unlike data.imap, keys don't need to be ordered; they only need to
+;; be hashable.  The core is in hamt.c.
+
+(define-module data.hamt
+  (use gauche.dictionary)
+  (export <hamt> <transient-hamt>
+          make-hamt alist->hamt hamt? hamt-empty? hamt-num-entries
+          hamt-comparator hamt-exists? hamt-get hamt-put hamt-delete
+          hamt-fold hamt-for-each hamt-map hamt-keys hamt-values
+          hamt->alist hamt=?
+
+          transient-hamt? hamt-transient hamt-persistent!
+          transient-hamt-num-entries transient-hamt-exists?
+          transient-hamt-get transient-hamt-put! transient-hamt-delete!
+
+          %hamt-dump %hamt-check)
+  )
+(select-module data.hamt)
+
+(inline-stub
+ (declcode "#include \"hamt.h\"")
+ (initcode "Scm_Init_hamt(Scm_CurrentModule());")
+
+ (define-type <hamt> "Hamt*" "hamt" "HAMT_P" "HAMT")
+ (define-type <transient-hamt> "Hamt*" "transient hamt"
+   "TRANSIENT_HAMT_P" "TRANSIENT_HAMT")
+
+ (define-cproc %make-hamt (type cmpr::<comparator>)
+   (let* ([t::ScmHashType SCM_HASH_EQ])
+     (cond
+      [(SCM_EQ type 'eq?)      (set! t SCM_HASH_EQ)]
+      [(SCM_EQ type 'eqv?)     (set! t SCM_HASH_EQV)]
+      [(SCM_EQ type 'equal?)   (set! t SCM_HASH_EQUAL)]
+      [(SCM_EQ type 'string=?) (set! t SCM_HASH_STRING)]
+      [else                    (set! t SCM_HASH_GENERAL)])
+     (return (MakeHamt t cmpr))))
+
+ (define-cproc hamt-comparator (h::<hamt>)
+   (return (SCM_OBJ (-> h comparator))))
+
+ (define-cproc hamt-num-entries (h::<hamt>) ::<ulong>
+   (return (-> h numEntries)))
+
+ (define-cproc hamt-empty? (h::<hamt>) ::<boolean>
+   (return (== (-> h numEntries) 0)))
+
+ (define-cproc hamt-exists? (h::<hamt> key) ::<boolean>
+   (return (not (SCM_UNBOUNDP (HamtRef h key SCM_UNBOUND)))))
+
+ (define-cproc hamt-get (h::<hamt> key :optional fallback)
+   (let* ([r (HamtRef h key fallback)])
+     (when (SCM_UNBOUNDP r)
+       (Scm_Error "%S doesn't have an entry for key %S" (SCM_OBJ h) key))
+     (return r)))
+
+ (define-cproc hamt-put (h::<hamt> key value) HamtPut)
+
+ (define-cproc hamt-delete (h::<hamt> key) HamtDelete)
+
+ (define-cproc %hamt=? (a::<hamt> b::<hamt> value-eq) ::<boolean>
+   (return (HamtEqual a b value-eq)))
+
+ (define-cproc hamt-transient (h::<hamt>) HamtTransient)
+
+ (define-cproc hamt-persistent! (t::<transient-hamt>) HamtPersistent)
+
+ (define-cproc transient-hamt-num-entries (t::<transient-hamt>) ::<ulong>
+   (return (-> t numEntries)))
+
+ (define-cproc transient-hamt-exists? (t::<transient-hamt> key) ::<boolean>
+   (return (not (SCM_UNBOUNDP (HamtRef t key SCM_UNBOUND)))))
+
+ (define-cproc transient-hamt-get (t::<transient-hamt> key :optional fallback)
+   (let* ([r (HamtRef t key fallback)])
+     (when (SCM_UNBOUNDP r)
+       (Scm_Error "%S doesn't have an entry for key %S" (SCM_OBJ t) key))
+     (return r)))
+
+ (define-cproc transient-hamt-put! (t::<transient-hamt> key value) ::<void>
+   HamtTransientPut)
+
+ (define-cproc transient-hamt-delete! (t::<transient-hamt> key) ::<boolean>
+   HamtTransientDelete)
+
+ (define-cfn hamt-iter (args::ScmObj* nargs::int data::void*) :static
+   (let* ([iter::HamtIter* (cast HamtIter* data)]
+          [r (HamtIterNext iter)]
+          [eofval (aref args 0)])
+     (if (SCM_FALSEP r)
+       (return (values eofval eofval))
+       (return (values (SCM_CAR r) (SCM_CDR r))))))
+
+ ;; Works on both persistent and transient hamts.
+ (define-cproc %hamt-iter (h)
+   (unless (or (HAMT_P h) (TRANSIENT_HAMT_P h))
+     (SCM_TYPE_ERROR h "<hamt> or <transient-hamt>"))
+   (let* ([iter::HamtIter* (SCM_NEW HamtIter)])
+     (HamtIterInit iter (HAMT h))
+     (return (Scm_MakeSubr hamt-iter iter 1 0 '"hamt-iterator"))))
+
+ (define-cproc %hamt-dump (h::<hamt>) ::<void> HamtDump)
+
+ (define-cproc %hamt-check (h::<hamt>) ::<void> HamtCheck)
+ )
+
+(define (hamt? obj) (is-a? obj <hamt>))
+(define (transient-hamt? obj) (is-a? obj <transient-hamt>))
+
+;; Recognize common comparators to use the C-level hash functions, as
+;; in data.sparse.
+(define *shortcut-comparators*
+  `((eq? . ,eq-comparator)
+    (eqv? . ,eqv-comparator)
+    (equal? . ,equal-comparator)
+    (string=? . ,string-comparator)))
+
+(define (make-hamt :optional (comparator default-comparator))
+  (define (bad)
+    (error "make-hamt needs a hashable comparator or one of the symbols \
+            eq?, eqv?, equal? or string=?, as an argument, but got:"
+           comparator))
+  (receive (type cmpr)
+      (cond [(symbol? comparator)
+             (if-let1 cmpr (assq-ref *shortcut-comparators* comparator)
+               (values comparator cmpr)
+               (bad))]
+            [(and (comparator? comparator) (comparator-hashable? comparator))
+             (if-let1 type (rassq-ref *shortcut-comparators* comparator)
+               (values type comparator)
+               (values #f comparator))]
+            [else (bad)])
+    (%make-hamt type cmpr)))
+
+;; Builds the map with a transient, so that the intermediate nodes
+;; aren't copied for every entry.
+(define (alist->hamt alist :optional (comparator default-comparator))
+  (let1 t (hamt-transient (make-hamt comparator))
+    (dolist [p alist]
+      (unless (transient-hamt-exists? t (car p))
+        (transient-hamt-put! t (car p) (cdr p))))
+    (hamt-persistent! t)))
+
+(define (hamt=? a b :optional (value=? #f))
+  (%hamt=? a b value=?))
+
+(define (hamt-fold h proc seed)
+  (let ([iter (%hamt-iter h)]
+        [end  (list #f)])
+    (let loop ([seed seed])
+      (receive (key val) (iter end)
+        (if (eq? key end)
+          seed
+          (loop (proc key val seed)))))))
+
+(define (hamt-map h proc)
+  (hamt-fold h (^[k v s] (cons (proc k v) s)) '()))
+(define (hamt-for-each h proc)
+  (hamt-fold h (^[k v _] (proc k v)) #f))
+(define (hamt-keys h)
+  (hamt-fold h (^[k v s] (cons k s)) '()))
+(define (hamt-values h)
+  (hamt-fold h (^[k v s] (cons v s)) '()))
+(define (hamt->alist h)
+  (hamt-fold h acons '()))
+
+;; Dictionary interface
+;; A hamt behaves as an immutable dictionary, while a transient hamt
+;; is a mutable one.
+(define-method dict-get ((h <hamt>) key :optional default)
+  (if (undefined? default)
+    (hamt-get h key)
+    (hamt-get h key default)))
+(define-method dict-put! ((h <hamt>) key value)
+  (errorf "hamt is immutable: ~s" h))
+(define-method dict-comparator ((h <hamt>))
+  (hamt-comparator h))
+(define-method dict-fold ((h <hamt>) proc seed)
+  (hamt-fold h proc seed))
+
+(define-dict-interface <transient-hamt>
+  :get       transient-hamt-get
+  :put!      transient-hamt-put!
+  :delete!   transient-hamt-delete!
+  :exists?   transient-hamt-exists?
+  :fold      hamt-fold)
@@ -0,0 +1,385 @@
+/*
+ * heap.c - Native parts of data.heap
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "heap.h"
+
+/*===================================================================
+ * Min-max heap on uvectors
+ */
+
+/* An index at an odd level (1-origin) is a min node.  Same as
+   min-node? in heap.scm. */
+static inline int min_node_p(ScmSmallInt i)
+{
+    int n = 0;
+    for (; i; i >>= 1) n++;
+    return n & 1;
+}
+
+/* Defines bubble_up_NAME, trickle_down_NAME and heapify_NAME for
+   an element type T.  MIN is TRUE for the '<' direction.  Indexes are
+   1-based; S[i] is s[i-1].  These follow the Scheme routines step by
+   step, so that the resulting layout is the same. */
+#define DEFINE_MINMAX_OPS(T, NAME)                                      \
+static inline int cmp_##NAME(int min, T a, T b)                         \
+{                                                                       \
+    return min ? (a < b) : (a > b);                                     \
+}                                                                       \
+static inline void swap_##NAME(T *s, ScmSmallInt i, ScmSmallInt j)      \
+{                                                                       \
+    T t = s[i-1]; s[i-1] = s[j-1]; s[j-1] = t;                          \
+}                                                                       \
+static void bubble_up_rec_##NAME(T *s, int min, ScmSmallInt index)      \
+{                                                                       \
+    while (index > 3) {                                                 \
+        ScmSmallInt gp = index >> 2;                                    \
+        if (cmp_##NAME(min, s[gp-1], s[index-1])) break;                \
+        swap_##NAME(s, gp, index);                                      \
+        index = gp;                                                     \
+    }                                                                   \
+}                                                                       \
+static void bubble_up_##NAME(T *s, ScmSmallInt index)                   \
+{                                                                       \
+    ScmSmallInt parent = index >> 1;                                    \
+    int min = min_node_p(parent);                                       \
+    if (cmp_##NAME(min, s[parent-1], s[index-1])) {                     \
+        bubble_up_rec_##NAME(s, !min, index);                           \
+    } else {                                                            \
+        swap_##NAME(s, parent, index);                                  \
+        bubble_up_rec_##NAME(s, min, parent);                           \
+    }                                                                   \
+}                                                                       \
+static ScmSmallInt find_extreme_##NAME(T *s, int min, ScmSmallInt index, \
+                                       ScmSmallInt size)                \
+{                                                                       \
+    ScmSmallInt idx = index;                                            \
+    T val = s[index-1];                                                 \
+    for (int n = 0; n < 6; n++) {                                       \
+        ScmSmallInt i = (n < 2)? (index<<1)+n : (index<<2)+n-2;         \
+        if (i >= size) break;                                           \
+        if (cmp_##NAME(min, s[i-1], val)) { val = s[i-1]; idx = i; }    \
+    }                                                                   \
+    return idx;                                                         \
+}                                                                       \
+static void trickle_down_##NAME(T *s, ScmSmallInt index, ScmSmallInt size) \
+{                                                                       \
+    int min = min_node_p(index);                                        \
+    for (;;) {                                                          \
+        ScmSmallInt pick = find_extreme_##NAME(s, min, index, size);    \
+        if (pick == index) break;                                       \
+        swap_##NAME(s, pick, index);                                    \
+        if (pick < (index << 2)) break; /* child */                     \
+        if (!cmp_##NAME(min, s[pick-1], s[(pick>>1)-1])) {              \
+            swap_##NAME(s, pick>>1, pick);                              \
+        }                                                               \
+        index = pick;                                                   \
+    }                                                                   \
+}                                                                       \
+static void heapify_##NAME(T *s, ScmSmallInt size)                      \
+{                                                                       \
+    for (ScmSmallInt i = 2; i <= size; i++) bubble_up_##NAME(s, i);     \
+}
+
+DEFINE_MINMAX_OPS(int8_t,   s8)
+DEFINE_MINMAX_OPS(uint8_t,  u8)
+DEFINE_MINMAX_OPS(int16_t,  s16)
+DEFINE_MINMAX_OPS(uint16_t, u16)
+DEFINE_MINMAX_OPS(int32_t,  s32)
+DEFINE_MINMAX_OPS(uint32_t, u32)
+DEFINE_MINMAX_OPS(int64_t,  s64)
+DEFINE_MINMAX_OPS(uint64_t, u64)
+DEFINE_MINMAX_OPS(float,    f32)
+DEFINE_MINMAX_OPS(double,   f64)
+
+#define DISPATCH_MINMAX(v, OP, ...)                                     \
+    do {                                                                \
+        void *e_ = SCM_UVECTOR_ELEMENTS(v);                             \
+        switch (Scm_UVectorType(SCM_CLASS_OF(v))) {                     \
+        case SCM_UVECTOR_S8:  OP##_s8((int8_t*)e_, __VA_ARGS__); break; \
+        case SCM_UVECTOR_U8:  OP##_u8((uint8_t*)e_, __VA_ARGS__); break; \
+        case SCM_UVECTOR_S16: OP##_s16((int16_t*)e_, __VA_ARGS__); break; \
+        case SCM_UVECTOR_U16: OP##_u16((uint16_t*)e_, __VA_ARGS__); break; \
+        case SCM_UVECTOR_S32: OP##_s32((int32_t*)e_, __VA_ARGS__); break; \
+        case SCM_UVECTOR_U32: OP##_u32((uint32_t*)e_, __VA_ARGS__); break; \
+        case SCM_UVECTOR_S64: OP##_s64((int64_t*)e_, __VA_ARGS__); break; \
+        case SCM_UVECTOR_U64: OP##_u64((uint64_t*)e_, __VA_ARGS__); break; \
+        case SCM_UVECTOR_F32: OP##_f32((float*)e_, __VA_ARGS__); break; \
+        case SCM_UVECTOR_F64: OP##_f64((double*)e_, __VA_ARGS__); break; \
+        default: return FALSE;                                          \
+        }                                                               \
+    } while (0)
+
+int Scm_MinMaxHeapBubbleUp(ScmUVector *v, ScmSmallInt index)
+{
+    SCM_ASSERT(index > 1 && index <= SCM_UVECTOR_SIZE(v));
+    DISPATCH_MINMAX(v, bubble_up, index);
+    return TRUE;
+}
+
+int Scm_MinMaxHeapTrickleDown(ScmUVector *v, ScmSmallInt index,
+                              ScmSmallInt size)
+{
+    SCM_ASSERT(index >= 1 && size <= SCM_UVECTOR_SIZE(v) + 1);
+    DISPATCH_MINMAX(v, trickle_down, index, size);
+    return TRUE;
+}
+
+int Scm_MinMaxHeapHeapify(ScmUVector *v, ScmSmallInt size)
+{
+    SCM_ASSERT(size <= SCM_UVECTOR_SIZE(v));
+    DISPATCH_MINMAX(v, heapify, size);
+    return TRUE;
+}
+
+/*===================================================================
+ * Indexed heap
+ */
+
+static void iheap_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
+{
+    ScmIndexedHeap *h = SCM_INDEXED_HEAP(obj);
+    Scm_Printf(port, "#<indexed-heap %s %ld/%ld>",
+               h->fixnump? "fixnum" : "flonum", h->size, h->capacity);
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_IndexedHeapClass, iheap_print);
+
+#define PRIO_LESS(h, a, b)                              \
+    ((h)->fixnump                                       \
+     ? ((h)->prio.i[a] < (h)->prio.i[b])                \
+     : ((h)->prio.f[a] < (h)->prio.f[b]))
+
+static inline void iheap_set(ScmIndexedHeap *h, ScmSmallInt i,
+                             ScmSmallInt id)
+{
+    h->heap[i] = id;
+    h->pos[id] = i;
+}
+
+static void sift_up(ScmIndexedHeap *h, ScmSmallInt i)
+{
+    ScmSmallInt id = h->heap[i];
+    while (i > 0) {
+        ScmSmallInt p = (i-1)/2;
+        if (!PRIO_LESS(h, id, h->heap[p])) break;
+        iheap_set(h, i, h->heap[p]);
+        i = p;
+    }
+    iheap_set(h, i, id);
+}
+
+static void sift_down(ScmIndexedHeap *h, ScmSmallInt i)
+{
+    ScmSmallInt id = h->heap[i];
+    for (;;) {
+        ScmSmallInt c = 2*i + 1;
+        if (c >= h->size) break;
+        if (c+1 < h->size && PRIO_LESS(h, h->heap[c+1], h->heap[c])) c++;
+        if (!PRIO_LESS(h, h->heap[c], id)) break;
+        iheap_set(h, i, h->heap[c]);
+        i = c;
+    }
+    iheap_set(h, i, id);
+}
+
+static void check_id(ScmIndexedHeap *h, ScmSmallInt id)
+{
+    if (id < 0 || id >= h->capacity) {
+        Scm_Error("id out of range for %S: %ld", SCM_OBJ(h), id);
+    }
+}
+
+/* Stores PRIORITY as the priority of ID. */
+static void set_priority(ScmIndexedHeap *h, ScmSmallInt id, ScmObj priority)
+{
+    if (h->fixnump) {
+        if (!SCM_INTP(priority)) {
+            Scm_Error("fixnum priority required, but got %S", priority);
+        }
+        h->prio.i[id] = SCM_INT_VALUE(priority);
+    } else {
+        if (!SCM_REALP(priority)) {
+            Scm_Error("real number priority required, but got %S", priority);
+        }
+        h->prio.f[id] = Scm_GetDouble(priority);
+    }
+}
+
+static ScmIndexedHeap *make_iheap(ScmSmallInt capacity, int fixnump)
+{
+    if (capacity < 0) Scm_Error("invalid capacity: %ld", capacity);
+    ScmIndexedHeap *h = SCM_NEW(ScmIndexedHeap);
+    SCM_SET_CLASS(h, SCM_CLASS_INDEXED_HEAP);
+    h->fixnump = fixnump;
+    h->capacity = capacity;
+    h->size = 0;
+    h->heap = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, capacity);
+    h->pos = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, capacity);
+    if (fixnump) {
+        h->prio.i = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, capacity);
+    } else {
+        h->prio.f = SCM_NEW_ATOMIC_ARRAY(double, capacity);
+    }
+    for (ScmSmallInt i = 0; i < capacity; i++) h->pos[i] = -1;
+    return h;
+}
+
+ScmObj Scm_MakeIndexedHeap(ScmSmallInt capacity, int fixnump)
+{
+    return SCM_OBJ(make_iheap(capacity, fixnump));
+}
+
+/* Bulk construction.  Id i gets the i-th element of PRIORITIES, which
+   is a vector or a uvector.  Uses Floyd's bottom-up method, O(n). */
+ScmObj Scm_BuildIndexedHeap(ScmObj priorities, int fixnump)
+{
+    ScmSmallInt n;
+    ScmIndexedHeap *h;
+
+    if (SCM_VECTORP(priorities)) {
+        n = SCM_VECTOR_SIZE(priorities);
+        h = make_iheap(n, fixnump);
+        for (ScmSmallInt i = 0; i < n; i++) {
+            set_priority(h, i, SCM_VECTOR_ELEMENT(priorities, i));
+        }
+    } else if (SCM_UVECTORP(priorities)) {
+        ScmUVector *v = SCM_UVECTOR(priorities);
+        int t = Scm_UVectorType(SCM_CLASS_OF(v));
+        n = SCM_UVECTOR_SIZE(v);
+        h = make_iheap(n, fixnump);
+        if (t == SCM_UVECTOR_F64 && !fixnump) {
+            memcpy(h->prio.f, SCM_UVECTOR_ELEMENTS(v), n * sizeof(double));
+        } else {
+            for (ScmSmallInt i = 0; i < n; i++) {
+                set_priority(h, i, Scm_VMUVectorRef(v, t, i, SCM_UNBOUND));
+            }
+        }
+    } else {
+        Scm_Error("vector or uvector required, but got %S", priorities);
+        return SCM_UNDEFINED;   /* dummy */
+    }
+    for (ScmSmallInt i = 0; i < n; i++) iheap_set(h, i, i);
+    h->size = n;
+    for (ScmSmallInt i = n/2 - 1; i >= 0; i--) sift_down(h, i);
+    return SCM_OBJ(h);
+}
+
+/* Inserts ID, or changes its priority if it's already in the heap. */
+void Scm_IndexedHeapPush(ScmIndexedHeap *h, ScmSmallInt id, ScmObj priority)
+{
+    check_id(h, id);
+    ScmSmallInt i = h->pos[id];
+    set_priority(h, id, priority);
+    if (i < 0) {
+        i = h->size++;
+        iheap_set(h, i, id);
+        sift_up(h, i);
+    } else {
+        sift_up(h, i);
+        sift_down(h, h->pos[id]);
+    }
+}
+
+void Scm_IndexedHeapDecreaseKey(ScmIndexedHeap *h, ScmSmallInt id,
+                                ScmObj priority)
+{
+    check_id(h, id);
+    ScmSmallInt i = h->pos[id];
+    if (i < 0) Scm_Error("id %ld isn't in the heap %S", id, SCM_OBJ(h));
+    int larger = (h->fixnump
+                  ? (SCM_INTP(priority)
+                     && SCM_INT_VALUE(priority) > h->prio.i[id])
+                  : (SCM_REALP(priority)
+                     && Scm_GetDouble(priority) > h->prio.f[id]));
+    if (larger) {
+        Scm_Error("new priority %S is larger than the current one of id %ld"
+                  " in %S", priority, id, SCM_OBJ(h));
+    }
+    set_priority(h, id, priority);
+    sift_up(h, i);
+}
+
+static void remove_at(ScmIndexedHeap *h, ScmSmallInt i)
+{
+    ScmSmallInt last = --h->size;
+    h->pos[h->heap[i]] = -1;
+    if (i != last) {
+        ScmSmallInt moved = h->heap[last];
+        iheap_set(h, i, moved);
+        sift_down(h, i);
+        if (h->pos[moved] == i) sift_up(h, i);
+    }
+}
+
+/* Removes the entry with the minimum priority and returns its id.
+   The priority can still be retrieved by Scm_IndexedHeapPriority
+   until the id is pushed again. */
+ScmSmallInt Scm_IndexedHeapPopMin(ScmIndexedHeap *h)
+{
+    if (h->size == 0) Scm_Error("indexed heap is empty: %S", SCM_OBJ(h));
+    ScmSmallInt id = h->heap[0];
+    remove_at(h, 0);
+    return id;
+}
+
+int Scm_IndexedHeapDelete(ScmIndexedHeap *h, ScmSmallInt id)
+{
+    check_id(h, id);
+    if (h->pos[id] < 0) return FALSE;
+    remove_at(h, h->pos[id]);
+    return TRUE;
+}
+
+/* Returns SCM_UNBOUND if ID isn't in the heap. */
+ScmObj Scm_IndexedHeapPriority(ScmIndexedHeap *h, ScmSmallInt id)
+{
+    check_id(h, id);
+    if (h->pos[id] < 0) return SCM_UNBOUND;
+    if (h->fixnump) return SCM_MAKE_INT(h->prio.i[id]);
+    else return Scm_MakeFlonum(h->prio.f[id]);
+}
+
+void Scm_IndexedHeapClear(ScmIndexedHeap *h)
+{
+    for (ScmSmallInt i = 0; i < h->size; i++) h->pos[h->heap[i]] = -1;
+    h->size = 0;
+}
+
+/*===================================================================
+ * Initialization
+ */
+
+void Scm_Init_heap(ScmModule *mod)
+{
+    Scm_InitStaticClass(&Scm_IndexedHeapClass, "<indexed-heap>", mod, NULL, 0);
+}
@@ -0,0 +1,100 @@
+/*
+ * heap.h - Native parts of data.heap
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_DATA_HEAP_H
+#define GAUCHE_DATA_HEAP_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+
+#if defined(EXTDATA_EXPORTS)
+#define LIBGAUCHE_EXT_BODY
+#endif
+#include <gauche/extern.h>      /* redefine SCM_EXTERN */
+
+/*
+ * Min-max heap operations on a numeric uvector
+ *
+ *   The same algorithm as bh-bubble-up, bh-trickle-down and
+ *   bh-heapify! in heap.scm, specialized for uvectors compared with
+ *   the default comparator.  Indexes are 1-based, as in heap.scm.
+ *   Returns FALSE if the uvector type isn't supported (f16vector), in
+ *   which case the caller should fall back to the generic routine.
+ */
+
+extern int    Scm_MinMaxHeapBubbleUp(ScmUVector *v, ScmSmallInt index);
+extern int    Scm_MinMaxHeapTrickleDown(ScmUVector *v, ScmSmallInt index,
+                                        ScmSmallInt size);
+extern int    Scm_MinMaxHeapHeapify(ScmUVector *v, ScmSmallInt size);
+
+/*
+ * Indexed heap
+ *
+ *   A binary min-heap of integer ids in [0, capacity), each of which
+ *   has a fixnum or flonum priority.  POS maps an id to its position
+ *   in HEAP, so that the priority of an entry can be changed in
+ *   O(log n).
+ */
+
+typedef struct ScmIndexedHeapRec {
+    SCM_HEADER;
+    int fixnump;                /* TRUE if priorities are fixnums */
+    ScmSmallInt capacity;
+    ScmSmallInt size;
+    ScmSmallInt *heap;          /* heap[i] = id, 0-based */
+    ScmSmallInt *pos;           /* pos[id] = i, or -1 if not in the heap */
+    union {
+        ScmSmallInt *i;
+        double *f;
+    } prio;                     /* prio[id] */
+} ScmIndexedHeap;
+
+SCM_CLASS_DECL(Scm_IndexedHeapClass);
+#define SCM_CLASS_INDEXED_HEAP     (&Scm_IndexedHeapClass)
+#define SCM_INDEXED_HEAP(obj)      ((ScmIndexedHeap*)(obj))
+#define SCM_INDEXED_HEAP_P(obj)    SCM_XTYPEP(obj, SCM_CLASS_INDEXED_HEAP)
+
+extern ScmObj Scm_MakeIndexedHeap(ScmSmallInt capacity, int fixnump);
+extern ScmObj Scm_BuildIndexedHeap(ScmObj priorities, int fixnump);
+extern void   Scm_IndexedHeapPush(ScmIndexedHeap *h, ScmSmallInt id,
+                                  ScmObj priority);
+extern void   Scm_IndexedHeapDecreaseKey(ScmIndexedHeap *h, ScmSmallInt id,
+                                         ScmObj priority);
+extern ScmSmallInt Scm_IndexedHeapPopMin(ScmIndexedHeap *h);
+extern int    Scm_IndexedHeapDelete(ScmIndexedHeap *h, ScmSmallInt id);
+extern ScmObj Scm_IndexedHeapPriority(ScmIndexedHeap *h, ScmSmallInt id);
+extern void   Scm_IndexedHeapClear(ScmIndexedHeap *h);
+
+extern void   Scm_Init_heap(ScmModule *mod);
+
+#endif /*GAUCHE_DATA_HEAP_H*/
@@ -46,9 +46,85 @@
           binary-heap-pop-min! binary-heap-pop-max!
           binary-heap-swap-min! binary-heap-swap-max!
           binary-heap-find binary-heap-remove! binary-heap-delete!
+
+          <indexed-heap> make-indexed-heap build-indexed-heap
+          indexed-heap? indexed-heap-capacity indexed-heap-num-entries
+          indexed-heap-empty? indexed-heap-exists? indexed-heap-priority
+          indexed-heap-push! indexed-heap-decrease-key!
+          indexed-heap-find-min indexed-heap-pop-min!
+          indexed-heap-delete! indexed-heap-clear!
           ))
 (select-module data.heap)
 
+;; Heap operations on numeric uvectors and the indexed heap are in heap.c.
+(inline-stub
+ (declcode "#include \"heap.h\"")
+ (initcode "Scm_Init_heap(Scm_CurrentModule());")
+
+ (define-type <indexed-heap> "ScmIndexedHeap*" "indexed heap"
+   "SCM_INDEXED_HEAP_P" "SCM_INDEXED_HEAP")
+
+ ;; These return #f if the uvector type isn't supported natively.
+ (define-cproc %minmax-bubble-up! (v::<uvector> index::<fixnum>) ::<boolean>
+   (return (Scm_MinMaxHeapBubbleUp v index)))
+ (define-cproc %minmax-trickle-down! (v::<uvector> index::<fixnum>
+                                      size::<fixnum>) ::<boolean>
+   (return (Scm_MinMaxHeapTrickleDown v index size)))
+ (define-cproc %minmax-heapify! (v::<uvector> size::<fixnum>) ::<boolean>
+   (return (Scm_MinMaxHeapHeapify v size)))
+
+ (define-cproc %make-indexed-heap (capacity::<fixnum> fixnum?::<boolean>)
+   (return (Scm_MakeIndexedHeap capacity fixnum?)))
+ (define-cproc %build-indexed-heap (priorities fixnum?::<boolean>)
+   (return (Scm_BuildIndexedHeap priorities fixnum?)))
+
+ (define-cproc indexed-heap? (obj) ::<boolean> SCM_INDEXED_HEAP_P)
+ (define-cproc indexed-heap-capacity (h::<indexed-heap>) ::<fixnum>
+   (return (-> h capacity)))
+ (define-cproc indexed-heap-num-entries (h::<indexed-heap>) ::<fixnum>
+   (return (-> h size)))
+ (define-cproc indexed-heap-empty? (h::<indexed-heap>) ::<boolean>
+   (return (== (-> h size) 0)))
+ (define-cproc indexed-heap-exists? (h::<indexed-heap> id::<fixnum>)
+   ::<boolean>
+   (return (and (>= id 0) (< id (-> h capacity))
+                (>= (aref (-> h pos) id) 0))))
+ (define-cproc indexed-heap-priority (h::<indexed-heap> id::<fixnum>
+                                      :optional fallback)
+   (let* ([r (Scm_IndexedHeapPriority h id)])
+     (when (SCM_UNBOUNDP r)
+       (if (SCM_UNBOUNDP fallback)
+         (Scm_Error "id %ld isn't in the heap %S" id h)
+         (set! r fallback)))
+     (return r)))
+ (define-cproc indexed-heap-push! (h::<indexed-heap> id::<fixnum> priority)
+   ::<void>
+   (Scm_IndexedHeapPush h id priority))
+ (define-cproc indexed-heap-decrease-key! (h::<indexed-heap> id::<fixnum>
+                                           priority) ::<void>
+   (Scm_IndexedHeapDecreaseKey h id priority))
+ (define-cproc indexed-heap-find-min (h::<indexed-heap> :optional fallback)
+   ::(<top> <top>)
+   (cond [(> (-> h size) 0)
+          (let* ([id::ScmSmallInt (aref (-> h heap) 0)])
+            (return (SCM_MAKE_INT id) (Scm_IndexedHeapPriority h id)))]
+         [(SCM_UNBOUNDP fallback)
+          (Scm_Error "indexed heap is empty: %S" h)
+          (return SCM_UNDEFINED SCM_UNDEFINED)]
+         [else (return fallback SCM_FALSE)]))
+ (define-cproc indexed-heap-pop-min! (h::<indexed-heap>) ::(<top> <top>)
+   (when (== (-> h size) 0)
+     (Scm_Error "indexed heap is empty: %S" h))
+   (let* ([p (Scm_IndexedHeapPriority h (aref (-> h heap) 0))]
+          [id::ScmSmallInt (Scm_IndexedHeapPopMin h)])
+     (return (SCM_MAKE_INT id) p)))
+ (define-cproc indexed-heap-delete! (h::<indexed-heap> id::<fixnum>)
+   ::<boolean>
+   (return (Scm_IndexedHeapDelete h id)))
+ (define-cproc indexed-heap-clear! (h::<indexed-heap>) ::<void>
+   (Scm_IndexedHeapClear h))
+ )
+
 ;; we use sparse-vector by default; we just make it autoload
 ;; so that the tests won't depend on data.sparse.
 (autoload data.sparse make-sparse-vector <sparse-vector-base>
@@ -103,8 +179,14 @@
    (>:         :init-keyword :>:) ; cached greater-than proc
    (storage    :init-keyword :storage)
    (next-leaf  :init-keyword :next-leaf :init-value 1)  ; next leaf index
+   (native     :init-keyword :native :init-value #f) ; use heap.c routines
    ))
 
+;; If the storage is a uvector and we use the default comparator, we can
+;; compare elements natively.
+(define (native-storage? storage comparator)
+  (and (uvector? storage) (eq? comparator default-comparator)))
+
 (define (make-binary-heap :key (comparator default-comparator)
                                (storage (make-sparse-vector))
                                (key identity))
@@ -128,6 +210,7 @@
           :capacity (cond [(vector? storage) (vector-length storage)]
                           [(uvector? storage) (uvector-length storage)]
                           [else +inf.0])
+          :native (native-storage? storage comparator)
           :<: <:
           :>: >:)))
 
@@ -158,9 +241,11 @@
                               (^[a b] (>? comparator a b)))]
           [(comparison) (values (^[a b] (<? comparator a b))
                                 (^[a b] (>? comparator a b)))])        
-      (bh-heapify! storage <: >: size)
+      (define native (native-storage? storage comparator))
+      (unless (and native (%minmax-heapify! storage size))
+        (bh-heapify! storage <: >: size))
       (make <binary-heap> :comparator comparator :storage storage :key key
-            :<: <: :>: >: :next-leaf (+ size 1)
+            :<: <: :>: >: :next-leaf (+ size 1) :native native
             :capacity (cond [(vector? storage) (vector-length storage)]
                             [(uvector? storage) (uvector-length storage)]
                             [else +inf.0])))))
@@ -174,10 +259,11 @@
                      [(is-a? s <sparse-vector-base>) (sparse-vector-copy s)]
                      [else (error "[internal] binary-heap-copy: invalid storage:" s)]))
     :key (~ hp'key)
-    :capaticy (~ hp'capacity)
+    :capacity (~ hp'capacity)
     :<: (~ hp'<:)
     :>: (~ hp'>:)
-    :next-leaf (~ hp'next-leaf)))
+    :next-leaf (~ hp'next-leaf)
+    :native (~ hp'native)))
 
 (define (binary-heap-comparator hp) (~ hp'comparator))
 (define (binary-heap-key-procedure hp) (~ hp'key))
@@ -194,11 +280,13 @@
   (let1 next (~ hp'next-leaf)
     (when (>= (- next 1) (~ hp'capacity))
       (errorf "binary heap ~s is full: couldn't insert ~s" hp item))
-    (comparator-check-type (~ hp'comparator) ((~ hp'key) item))
+    ;; uvector-set! does the type check for the native storage
+    (unless (~ hp'native)
+      (comparator-check-type (~ hp'comparator) ((~ hp'key) item)))
     (set! (~ hp'storage (Ix next)) item)
     (set! (~ hp'next-leaf) (+ next 1))
     (when (> next 1)
-      (bh-bubble-up (~ hp'storage) (~ hp'<:) (~ hp'>:) next))))
+      (heap-bubble-up hp next))))
 
 (define (binary-heap-num-entries hp) (- (~ hp'next-leaf) 1))
 
@@ -230,7 +318,7 @@
       (set! (~ storage (Ix 1)) (~ storage (Ix nelts)))
       (set! (~ storage (Ix nelts)) *filler*)
       (set! (~ hp'next-leaf) nelts)
-      (bh-trickle-down storage (~ hp'<:) (~ hp'>:) 1 nelts))))
+      (heap-trickle-down hp 1 nelts))))
 
 (define (binary-heap-pop-max! hp)
   (let ([nelts (binary-heap-num-entries hp)]
@@ -239,7 +327,7 @@
       (set! (~ storage (Ix index)) (~ storage (Ix nelts)))
       (set! (~ storage (Ix nelts)) *filler*)
       (set! (~ hp'next-leaf) nelts)
-      (bh-trickle-down storage (~ hp'<:) (~ hp'>:) index nelts))
+      (heap-trickle-down hp index nelts))
     (case nelts
       [(0) (error "binary heap is empty:" hp)]
       [(1 2) (set! (~ hp'next-leaf) nelts) (~ storage (Ix nelts))]
@@ -260,7 +348,7 @@
       (set! (~ storage (Ix 1)) item)
       (let1 n (binary-heap-num-entries hp)
         (when (> n 1)
-          (bh-trickle-down storage (~ hp'<:) (~ hp'>:) 1 (+ n 1)))))))
+          (heap-trickle-down hp 1 (+ n 1)))))))
 
 (define (binary-heap-swap-max! hp item)
   (let ([storage (~ hp'storage)]
@@ -270,7 +358,7 @@
         (set! (~ storage (Ix index)) item)
         (when ((~ hp'>:) a item)
           (swap! storage 1 index))
-        (bh-trickle-down storage (~ hp'<:) (~ hp'>:) index (+ nelts 1))))
+        (heap-trickle-down hp index (+ nelts 1))))
     (case nelts
       [(0) (error "binary heap is empty:" hp)]
       [(1) (rlet1 r (~ storage (Ix 1))
@@ -301,7 +389,7 @@
 
     (define (finish-up next)
       (unless (= next (~ hp'next-leaf)) ;; some keys are removed
-        (bh-heapify! storage (~ hp'<:) (~ hp'>:) (- next 1))
+        (heap-heapify! hp (- next 1))
         (do ([i next (+ i 1)]
              [lim (~ hp'next-leaf)])
             [(>= i lim)]
@@ -357,6 +445,20 @@
 ;; if (integer-length i) is odd, we have min node
 ;; else we have max node
 
+;; Dispatch to the native routines when we can.
+(define (heap-bubble-up hp index)
+  (unless (and (~ hp'native) (%minmax-bubble-up! (~ hp'storage) index))
+    (bh-bubble-up (~ hp'storage) (~ hp'<:) (~ hp'>:) index)))
+
+(define (heap-trickle-down hp index size)
+  (unless (and (~ hp'native)
+               (%minmax-trickle-down! (~ hp'storage) index size))
+    (bh-trickle-down (~ hp'storage) (~ hp'<:) (~ hp'>:) index size)))
+
+(define (heap-heapify! hp size)
+  (unless (and (~ hp'native) (%minmax-heapify! (~ hp'storage) size))
+    (bh-heapify! (~ hp'storage) (~ hp'<:) (~ hp'>:) size)))
+
 ;; called with index > 1
 (define (bh-bubble-up storage <: >: index)
 
@@ -431,3 +533,23 @@
 
   (trickle-down-rec (if (min-node? index) <: >:) index))
 
+;;;
+;;; Indexed heap
+;;;
+
+;; A min-heap of integer ids in [0, capacity), each with a numeric
+;; priority.  Unlike <binary-heap>, the priority of an entry can be
+;; changed in place, which is what Dijkstra-like algorithms need.
+;; Priorities are kept unboxed in C, either as fixnums or as doubles.
+
+(define (%priority-type->fixnum? type)
+  (ecase type
+    [(fixnum) #t]
+    [(flonum) #f]))
+
+(define (make-indexed-heap capacity :optional (priority-type 'flonum))
+  (%make-indexed-heap capacity (%priority-type->fixnum? priority-type)))
+
+;; PRIORITIES is a vector or a uvector; id i gets (~ priorities i).
+(define (build-indexed-heap priorities :optional (priority-type 'flonum))
+  (%build-indexed-heap priorities (%priority-type->fixnum? priority-type)))
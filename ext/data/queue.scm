@@ -45,10 +45,19 @@
 ;; to do so with holding C-level mutex, since Scheme procedure may
 ;; take indefinitely long.  So we use Scheme-level slot to keep the
 ;; thread that is working on the queue.
+;;
+;; <mpmc-queue> is a bounded subclass of <mtqueue> backed by a ring
+;; buffer (Dmitry Vyukov's bounded MPMC queue).  Enqueue and dequeue
+;; don't take a lock at all; each slot carries a sequence number that
+;; tells whether it's ready to be written or read.  The mutex and
+;; condition variables of <mtqueue> are only used when a thread has to
+;; block in enqueue/wait! or dequeue/wait!, after spinning a while.
+;; Operations that need to modify the queue as a list (queue-push!,
+;; remove-from-queue! etc.) are not supported on it.
 
 (define-module data.queue
-  (export <queue> <mtqueue>
-          make-queue make-mtqueue queue? mtqueue?
+  (export <queue> <mtqueue> <mpmc-queue>
+          make-queue make-mtqueue make-mpmc-queue queue? mtqueue? mpmc-queue?
           queue-length mtqueue-max-length mtqueue-room
           mtqueue-num-waiting-readers
           queue-empty? copy-queue
@@ -68,6 +77,7 @@
 ;;;
 (inline-stub
  "#include <gauche/class.h>"
+ "#include \"atomic_ops.h\""
 
  ;;
  ;; <queue>
@@ -130,6 +140,35 @@
  "#define MTQ_CV(q, kind) (MTQ(q)->kind)"
  "#define MTQ_READER_SEM(q) (MTQ(q)->readerSem)"
 
+ ;;
+ ;; <mpmc-queue>
+ ;;
+ "typedef struct RingCellRec {"
+ "  volatile AO_t seq;"
+ "  ScmObj data;"
+ "} RingCell;"
+
+ ;; The padding keeps the positions updated by producers and consumers
+ ;; in different cache lines.
+ "typedef struct RingQueueRec {"
+ "  MtQueue mtq;"
+ "  AO_t size;"
+ "  RingCell *cells;"
+ "  char pad0[64];"
+ "  volatile AO_t enqPos;"
+ "  char pad1[64];"
+ "  volatile AO_t deqPos;"
+ "  char pad2[64];"
+ "  volatile AO_t readersWaiting;"
+ "  volatile AO_t writersWaiting;"
+ "} RingQueue;"
+
+ "SCM_CLASS_DECL(RingQueueClass);"
+ "#define RINGQP(obj)     SCM_ISA(obj, &RingQueueClass)"
+ "#define RINGQ(obj)      ((RingQueue*)(obj))"
+ ;; How many times we retry before blocking in */wait! operations.
+ "#define RINGQ_SPIN_COUNT 100"
+
 
  (define-cfn makemtq (klass::ScmClass* maxlen::int)
    (let* ([z::MtQueue* (SCM_NEW_INSTANCE MtQueue klass)])
@@ -148,6 +187,10 @@
      (if (< ml 0) (return '#f) (return (SCM_MAKE_INT ml)))))
 
  (define-cfn mtq-maxlen-set (mtq::MtQueue* maxlen) ::void
+   (when (and (RINGQP mtq) (not (and (SCM_INTP maxlen)
+                                     (== (SCM_INT_VALUE maxlen)
+                                         (MTQ_MAXLEN mtq)))))
+     (Scm_Error "can't change max-length of %S" mtq))
    (cond [(SCM_UINTP maxlen) (set! (MTQ_MAXLEN mtq) (SCM_INT_VALUE maxlen))]
          [(SCM_FALSEP maxlen) (set! (MTQ_MAXLEN mtq) -1)]
          [else (SCM_TYPE_ERROR maxlen "non-negative fixnum or #f")]))
@@ -253,6 +296,167 @@
  (define-cproc %unlock-mtq (q::<mtqueue>) ::<void> (release-mtq-big-lock q))
  (define-cproc %notify-writers (q::<mtqueue>) ::<void> (notify-writers q))
  (define-cproc %notify-readers (q::<mtqueue>) ::<void> (notify-readers q))
+
+ ;;
+ ;; <mpmc-queue> operations
+ ;;
+ (define-cfn makeringq (klass::ScmClass* size::int)
+   (when (<= size 0)
+     (Scm_Error "mpmc-queue requires positive max-length, but got %d" size))
+   (let* ([z::RingQueue* (SCM_NEW_INSTANCE RingQueue klass)]
+          [cells::RingCell* (SCM_NEW_ARRAY RingCell size)])
+     (set! (Q_LENGTH z) 0 (Q_HEAD z) SCM_NIL (Q_TAIL z) SCM_NIL
+           (MTQ_MAXLEN z) size
+           (MTQ_LOCKER z) SCM_FALSE
+           (MTQ_READER_SEM z) 0)
+     (SCM_INTERNAL_MUTEX_INIT (MTQ_MUTEX z))
+     (SCM_INTERNAL_COND_INIT (MTQ_CV z lockWait))
+     (SCM_INTERNAL_COND_INIT (MTQ_CV z readerWait))
+     (SCM_INTERNAL_COND_INIT (MTQ_CV z writerWait))
+     (dotimes [i size]
+       (set! (ref (aref cells i) seq) i
+             (ref (aref cells i) data) SCM_FALSE))
+     (set! (-> z size) size
+           (-> z cells) cells
+           (-> z enqPos) 0
+           (-> z deqPos) 0
+           (-> z readersWaiting) 0
+           (-> z writersWaiting) 0)
+     (return (SCM_OBJ z))))
+
+ (define-cfn ringq-length (q::RingQueue*) ::u_long
+   (let* ([d::AO_t (AO_load (& (-> q deqPos)))]
+          [e::AO_t (AO_load (& (-> q enqPos)))])
+     (cond [(<= e d) (return 0)]    ; can be transiently reversed
+           [(> (- e d) (-> q size)) (return (-> q size))]
+           [else (return (- e d))])))
+
+ ;; Returns FALSE if the queue is full.
+ (define-cfn ringq-enqueue (q::RingQueue* obj) ::int
+   (let* ([pos::AO_t (AO_load (& (-> q enqPos)))])
+     (while TRUE
+       (let* ([c::RingCell* (+ (-> q cells) (% pos (-> q size)))]
+              [seq::AO_t (AO_load_acquire (& (-> c seq)))]
+              [diff::long (- (cast long seq) (cast long pos))])
+         (cond [(== diff 0)
+                (if (AO_compare_and_swap_full (& (-> q enqPos)) pos (+ pos 1))
+                  (begin
+                    (set! (-> c data) obj)
+                    (AO_store_release (& (-> c seq)) (+ pos 1))
+                    (return TRUE))
+                  (set! pos (AO_load (& (-> q enqPos)))))]
+               [(< diff 0) (return FALSE)]
+               [else (set! pos (AO_load (& (-> q enqPos))))])))
+     (return FALSE)))
+
+ ;; Returns FALSE if the queue is empty.
+ (define-cfn ringq-dequeue (q::RingQueue* result::ScmObj*) ::int
+   (let* ([pos::AO_t (AO_load (& (-> q deqPos)))])
+     (while TRUE
+       (let* ([c::RingCell* (+ (-> q cells) (% pos (-> q size)))]
+              [seq::AO_t (AO_load_acquire (& (-> c seq)))]
+              [diff::long (- (cast long seq) (cast long (+ pos 1)))])
+         (cond [(== diff 0)
+                (if (AO_compare_and_swap_full (& (-> q deqPos)) pos (+ pos 1))
+                  (begin
+                    (set! (* result) (-> c data)
+                          (-> c data) SCM_FALSE) ; to be friendly to GC
+                    (AO_store_release (& (-> c seq)) (+ pos (-> q size)))
+                    (return TRUE))
+                  (set! pos (AO_load (& (-> q deqPos)))))]
+               [(< diff 0) (return FALSE)]
+               [else (set! pos (AO_load (& (-> q deqPos))))])))
+     (return FALSE)))
+
+ ;; Returns a list of the elements at the moment.  Elements that are
+ ;; being written or read concurrently may or may not be included.
+ (define-cfn ringq-snapshot (q::RingQueue*)
+   (let* ([h SCM_NIL] [t SCM_NIL]
+          [pos::AO_t (AO_load_acquire (& (-> q deqPos)))]
+          [end::AO_t (AO_load_acquire (& (-> q enqPos)))])
+     (for [() (< pos end) (post++ pos)]
+       (let* ([c::RingCell* (+ (-> q cells) (% pos (-> q size)))]
+              [obj (-> c data)])
+         (when (== (AO_load_acquire (& (-> c seq))) (+ pos 1))
+           (SCM_APPEND1 h t obj))))
+     (return h)))
+
+ ;; (ringq-wake Q COUNTER CV)
+ ;;   Wakes up a thread waiting on CV, if COUNTER says there's any.
+ ;;   The full barrier pairs with the one in ringq-wait, so that either
+ ;;   the waiter sees our update, or we see the waiter's counter.
+ (define-cise-stmt ringq-wake
+   [(_ q counter cv)
+    `(begin
+       (AO_nop_full)
+       (when (> (AO_load (& (-> ,q ,counter))) 0)
+         (MTQ_LOCK ,q)
+         (SCM_INTERNAL_COND_SIGNAL (MTQ_CV ,q ,cv))
+         (MTQ_UNLOCK ,q)))])
+
+ ;; (ringq-wait Q TRY COUNTER CV PTIMESPEC STATUS)
+ ;;   Repeats TRY until it returns true, spinning RINGQ_SPIN_COUNT times
+ ;;   and then blocking on CV.  STATUS is set to 0 on success or
+ ;;   CW_TIMEDOUT when timed out.
+ (define-cise-stmt ringq-wait
+   [(_ q try counter cv pts status)
+    (let ([spin (gensym)] [ok (gensym)])
+      `(let* ([,spin :: int 0])
+         (set! ,status 0)
+         (while TRUE
+           (when ,try (break))
+           (when (< (post++ ,spin) RINGQ_SPIN_COUNT) (continue))
+           (let* ([,ok :: int FALSE])
+             (with-mtq-mutex-lock ,q
+               (AO_fetch_and_add1_full (& (-> ,q ,counter)))
+               (set! ,ok ,try)
+               (unless ,ok (wait-cv (MTQ ,q) ,cv ,pts ,status))
+               (AO_fetch_and_sub1_full (& (-> ,q ,counter))))
+             (when ,ok (set! ,status 0) (break))
+             (cond [(== ,status CW_TIMEDOUT)
+                    (when ,try (set! ,status 0))
+                    (break)]
+                   [(== ,status CW_INTR) (Scm_SigCheck (Scm_VM))])))))])
+
+ (define-cfn ringq-dequeue-wait (q::RingQueue* timeout timeout-val)
+   (let* ([ts::ScmTimeSpec] [status::int 0] [r SCM_UNDEFINED]
+          [pts::ScmTimeSpec* (Scm_GetTimeSpec timeout (& ts))])
+     (.if "defined(GAUCHE_HAS_THREADS)"
+          (ringq-wait q (ringq-dequeue q (& r)) readersWaiting readerWait
+                      pts status)
+          (unless (ringq-dequeue q (& r)) (set! status CW_TIMEDOUT)))
+     (when (== status CW_TIMEDOUT) (return timeout-val))
+     (ringq-wake q writersWaiting writerWait)
+     (return r)))
+
+ (define-cfn ringq-enqueue-wait (q::RingQueue* obj timeout timeout-val)
+   (let* ([ts::ScmTimeSpec] [status::int 0]
+          [pts::ScmTimeSpec* (Scm_GetTimeSpec timeout (& ts))])
+     (.if "defined(GAUCHE_HAS_THREADS)"
+          (ringq-wait q (ringq-enqueue q obj) writersWaiting writerWait
+                      pts status)
+          (unless (ringq-enqueue q obj) (set! status CW_TIMEDOUT)))
+     (when (== status CW_TIMEDOUT) (return timeout-val))
+     (ringq-wake q readersWaiting readerWait)
+     (return SCM_TRUE)))
+
+ (define-cise-stmt reject-ringq
+   [(_ q) `(when (RINGQP ,q)
+             (Scm_Error "operation not supported on mpmc-queue: %S" ,q))])
+
+ (define-type <mpmc-queue> "RingQueue*" "mpmc-queue" "RINGQP" "RINGQ")
+ (define-cclass <mpmc-queue>
+   "RingQueue*" "RingQueueClass" ("MtQueueClass" "QueueClass")
+   ((max-length :getter "return mtq_maxlen_get(MTQ(obj));"
+                :setter "mtq_maxlen_set(MTQ(obj), value);"))
+   (allocator
+    (let* ([ml (Scm_GetKeyword ':max-length initargs SCM_FALSE)])
+      (unless (SCM_INTP ml)
+        (Scm_Error "mpmc-queue requires :max-length, but got %S" ml))
+      (return (makeringq klass (SCM_INT_VALUE ml)))))
+   (printer
+    (Scm_Printf port "#<mpmc-queue %lu/%d @%p>"
+                (ringq-length (RINGQ obj)) (MTQ_MAXLEN obj) obj)))
  )
 
 ;; A common pattern
@@ -275,9 +479,15 @@
                     (?: (SCM_UINTP max-length)
                         (SCM_INT_VALUE max-length)
                         -1))))
+ (define-cproc make-mpmc-queue (max-length::<fixnum>)
+   (when (or (<= max-length 0) (> max-length INT_MAX))
+     (Scm_Error "max-length must be a positive fixnum, but got %ld"
+                max-length))
+   (return (makeringq (& RingQueueClass) (cast int max-length))))
 
  ;; caller must hold lock
  (define-cproc %queue-set-content! (q::<queue> list last-pair) ::<void>
+   (reject-ringq q)
    (if (SCM_PAIRP list)
      (let* ([tail (?: (SCM_PAIRP last-pair) last-pair (Scm_LastPair list))])
        (set! (Q_TAIL q) tail
@@ -290,7 +500,9 @@
 
 (define (list->queue lis :optional (class <queue>) :rest initargs)
   (rlet1 q (apply make class initargs)
-    (%queue-set-content! q (list-copy lis) #f)))
+    (if (mpmc-queue? q)
+      (for-each (cut enqueue! q <>) lis)
+      (%queue-set-content! q (list-copy lis) #f))))
 
 (define-method copy-queue ((q <queue>))
   (list->queue (queue->list q) (class-of q)))
@@ -304,6 +516,7 @@
 ;;;
 (inline-stub
  (define-cproc queue-empty? (q::<queue>) ::<boolean>
+   (when (RINGQP q) (return (== (ringq-length (RINGQ q)) 0)))
    (if (MTQP q)
      (let* ([r::int FALSE])
        (with-mtq-light-lock q (set! r (Q_EMPTY_P q)))
@@ -313,6 +526,7 @@
 
 (define-inline (queue? q)   (is-a? q <queue>))
 (define-inline (mtqueue? q) (is-a? q <mtqueue>))
+(define-inline (mpmc-queue? q) (is-a? q <mpmc-queue>))
 
 ;;;
 ;;; Queries
@@ -324,7 +538,10 @@
           (> (+ ,cnt (%qlength (Q ,q))) (MTQ_MAXLEN ,q)))])
 
  ;; API
- (define-cproc queue-length (q::<queue>) ::<int> %qlength)
+ (define-cproc queue-length (q::<queue>) ::<int>
+   (if (RINGQP q)
+     (return (ringq-length (RINGQ q)))
+     (return (%qlength q))))
  (define-cproc mtqueue-max-length (q::<mtqueue>)
    (return (?: (>= (MTQ_MAXLEN q) 0) (SCM_MAKE_INT (MTQ_MAXLEN q)) '#f)))
 
@@ -337,14 +554,21 @@
    (let* ([room::int -1])
      (with-mtq-light-lock q
        (when (>= (MTQ_MAXLEN q) 0)
-         (set! room (- (MTQ_MAXLEN q) (%qlength (Q q))))))
+         (set! room (- (MTQ_MAXLEN q)
+                       (?: (RINGQP q)
+                           (ringq-length (RINGQ q))
+                           (%qlength (Q q)))))))
      (if (>= room 0)
        (return (SCM_MAKE_INT room))
        (return SCM_POSITIVE_INFINITY))))
 
  ;; caller must hold big lock
  ;; %qtail isn't used in data.queue, but used by srfi-117
- (define-cproc %qhead (q::<queue>) (return (Q_HEAD q)))
+ ;; For mpmc-queue, %qhead returns a fresh snapshot list.
+ (define-cproc %qhead (q::<queue>)
+   (if (RINGQP q)
+     (return (ringq-snapshot (RINGQ q)))
+     (return (Q_HEAD q))))
  (define-cproc %qtail (q::<queue>) (return (Q_TAIL q)))
 
  (define-cfn queue-peek-both-int (q::Queue* ph::ScmObj* pt::ScmObj*) ::int
@@ -355,9 +579,17 @@
 
  (define-cproc %queue-peek (q::<queue> :optional fallback) ::(<top> <top>)
    (let* ([ok::int FALSE] [h] [t])
-     (if (not (MTQP q))
-       (set! ok (queue-peek-both-int q (& h) (& t)))
-       (with-mtq-light-lock q (set! ok (queue-peek-both-int q (& h) (& t)))))
+     (cond [(RINGQP q)
+            (let* ([lis (ringq-snapshot (RINGQ q))])
+              (when (SCM_PAIRP lis)
+                (set! h (SCM_CAR lis)
+                      t (SCM_CAR (Scm_LastPair lis))
+                      ok TRUE)))]
+           [(not (MTQP q))
+            (set! ok (queue-peek-both-int q (& h) (& t)))]
+           [else
+            (with-mtq-light-lock q
+              (set! ok (queue-peek-both-int q (& h) (& t))))])
      (cond [ok (return h t)]
            [(SCM_UNBOUNDP fallback) (Scm_Error "queue is empty: %S" q)]
            [else (return fallback fallback)])))
@@ -401,6 +633,7 @@
 
  ;; to call internal enqueue from Scheme.  lock must be held.
  (define-cproc %enqueue! (q::<queue> cnt::<uint> head tail) ::<void>
+   (reject-ringq q)
    (enqueue_int q cnt head tail))
 
  ;; (q-write-op OP Q CNT HEAD TAIL)
@@ -420,6 +653,14 @@
 
  ;; API
  (define-cproc enqueue! (q::<queue> obj :rest more-objs)
+   (when (RINGQP q)
+     (unless (ringq-enqueue (RINGQ q) obj)
+       (Scm_Error "queue is full: %S" q))
+     (dolist [x more-objs]
+       (unless (ringq-enqueue (RINGQ q) x)
+         (Scm_Error "queue is full: %S" q)))
+     (ringq-wake (RINGQ q) readersWaiting readerWait)
+     (return (SCM_OBJ q)))
    (let* ([head (Scm_Cons obj more-objs)] [tail] [cnt::u_int])
      (if (SCM_NULLP more-objs)
        (set! tail head cnt 1)
@@ -430,6 +671,8 @@
  ;; API
  (define-cproc enqueue/wait! (q::<mtqueue> obj :optional (timeout #f)
                                                          (timeout-val #f))
+   (when (RINGQP q)
+     (return (ringq-enqueue-wait (RINGQ q) obj timeout timeout-val)))
    (let* ([cell (SCM_LIST1 obj)] [retval (SCM_OBJ q)])
      (.if "defined(GAUCHE_HAS_THREADS)"
           (do-with-timeout q retval timeout timeout-val writerWait
@@ -470,6 +713,7 @@
      (set! (Q_LENGTH q) (+ (Q_LENGTH q) cnt))))
 
  (define-cproc queue-push! (q::<queue> obj :rest more-objs)
+   (reject-ringq q)
    (let* ([objs (Scm_Cons obj more-objs)] [head] [tail] [cnt::u_int])
      (if (SCM_NULLP more-objs)
        (set! head objs tail objs cnt 1)
@@ -481,6 +725,7 @@
 
  (define-cproc queue-push/wait! (q::<mtqueue> obj :optional (timeout #f)
                                                             (timeout-val #f))
+   (reject-ringq q)
    (let* ([cell (SCM_LIST1 obj)] [retval (SCM_OBJ q)])
      (.if "defined(GAUCHE_HAS_THREADS)"
           (do-with-timeout q retval timeout timeout-val writerWait
@@ -524,18 +769,21 @@
 
  (define-cproc dequeue! (q::<queue> :optional fallback)
    (let* ([empty::int FALSE] [r SCM_UNDEFINED])
-     (if (not (MTQP q))
-       (set! empty (dequeue-int q (& r)))
-       (with-mtq-light-lock q (set! empty (dequeue-int q (& r)))))
+     (cond [(RINGQP q) (set! empty (not (ringq-dequeue (RINGQ q) (& r))))]
+           [(not (MTQP q)) (set! empty (dequeue-int q (& r)))]
+           [else (with-mtq-light-lock q (set! empty (dequeue-int q (& r))))])
      (if empty
        (if (SCM_UNBOUNDP fallback)
          (Scm_Error "queue is empty: %S" q)
          (set! r fallback))
-       (when (MTQP q) (notify-writers q)))
+       (cond [(RINGQP q) (ringq-wake (RINGQ q) writersWaiting writerWait)]
+             [(MTQP q) (notify-writers q)]))
      (return r)))
 
  (define-cproc dequeue/wait! (q::<mtqueue> :optional (timeout #f)
                                                      (timeout-val #f))
+   (when (RINGQP q)
+     (return (ringq-dequeue-wait (RINGQ q) timeout timeout-val)))
    (let* ([retval SCM_UNDEFINED])
      (.if "defined(GAUCHE_HAS_THREADS)"
           (do-with-timeout q retval timeout timeout-val readerWait
@@ -555,6 +803,12 @@
      (return lis)))
 
  (define-cproc dequeue-all! (q::<queue>)
+   (when (RINGQP q)
+     (let* ([h SCM_NIL] [t SCM_NIL] [r])
+       (while (ringq-dequeue (RINGQ q) (& r))
+         (SCM_APPEND1 h t r))
+       (ringq-wake (RINGQ q) writersWaiting writerWait)
+       (return h)))
    (if (not (MTQP q))
      (return (dequeue-all-int q))
      (let* ([r])
@@ -572,7 +826,9 @@
 ;; from being inserted into the mtq.
 (define-cproc mtqueue-num-waiting-readers (q::<mtqueue>) ::<int>
   (let* ([n::int 0])
-    (with-mtq-light-lock q (set! n (MTQ_READER_SEM q)))
+    (if (RINGQP q)
+      (set! n (AO_load (& (-> (RINGQ q) readersWaiting))))
+      (with-mtq-light-lock q (set! n (MTQ_READER_SEM q))))
     (return n)))
 
 (define (remove-from-queue! pred q)
@@ -0,0 +1,518 @@
+;;;
+;;;  data.ring-buffer - Ring buffers
+;;;
+;;;   Copyright (c) 2015-2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+(define-module data.ring-buffer
+  (use gauche.sequence)
+  (use gauche.uvector)
+  (use gauche.record)
+  (use srfi-43)
+  (export make-ring-buffer
+          make-overflow-doubler
+          ring-buffer?
+          ring-buffer-empty? ring-buffer-num-entries ring-buffer-capacity
+          ring-buffer-full?
+          ring-buffer-front ring-buffer-back
+          ring-buffer-add-front! ring-buffer-add-back!
+          ring-buffer-remove-front! ring-buffer-remove-back!
+          ring-buffer-ref ring-buffer-set!
+          ring-buffer-add-back!/multi ring-buffer-remove-front!/into
+
+          <spsc-ring-buffer> make-spsc-ring-buffer spsc-ring-buffer?
+          spsc-ring-buffer-capacity spsc-ring-buffer-num-entries
+          spsc-ring-buffer-empty? spsc-ring-buffer-full?
+          spsc-ring-buffer-add-back! spsc-ring-buffer-remove-front!
+          spsc-ring-buffer-add-back!/multi
+          spsc-ring-buffer-remove-front!/into))
+(select-module data.ring-buffer)
+
+;;
+;;          +-----------+            +-----------+
+;;          |  (vacant) |            |///////////|
+;;          |           |            |///////////|
+;;          +-----------+            |///////////|
+;;    head >|///////////|            +-----------+
+;;          |///////////|      tail >|  (vacant) |
+;;          |///////////|            |           |
+;;          |///////////|            |           |
+;;          +-----------+            |           |
+;;    tail >|  (vacant) |            +-----------+
+;;          |           |      head >|///////////|
+;;          +-----------+            +-----------+
+
+;; Although we define ring-buffer as a record-type, we don't export
+;; accessors/constructors.  Users of this module should use exported
+;; public APIs.
+(define-record-type ring-buffer %make-ring-buffer ring-buffer?
+  (storage)
+  overflow-handler
+  (head)
+  (tail)
+  (capacity)
+  (num-entries))
+
+;; ref/set! dispatcher
+;; We avoid using generic dispatch of '~', for ring buffers
+;; may be used in speed-conscious/allocation-conscious situation.
+;; It is kind of dumb that we have to roll our own dispatcher, though;
+;; there should be a built-in support.
+(define-constant *dispatch-table*
+  ($ hash-table 'eq?
+     `(,<vector>    ,vector-length  ,vector-ref    ,vector-set!
+                    ,make-vector    . ,vector-copy!)
+     `(,<u8vector>  ,uvector-length ,u8vector-ref  ,u8vector-set!
+                    ,make-u8vector  . ,uvector-copy!)
+     `(,<s8vector>  ,uvector-length ,s8vector-ref  ,s8vector-set!
+                    ,make-s8vector  . ,uvector-copy!)
+     `(,<u16vector> ,uvector-length ,u16vector-ref ,u16vector-set!
+                    ,make-u16vector . ,uvector-copy!)
+     `(,<s16vector> ,uvector-length ,s16vector-ref ,s16vector-set!
+                    ,make-s16vector . ,uvector-copy!)
+     `(,<u32vector> ,uvector-length ,u32vector-ref ,u32vector-set!
+                    ,make-u32vector . ,uvector-copy!)
+     `(,<s32vector> ,uvector-length ,s32vector-ref ,s32vector-set!
+                    ,make-s32vector . ,uvector-copy!)
+     `(,<u64vector> ,uvector-length ,u64vector-ref ,u64vector-set!
+                    ,make-u64vector . ,uvector-copy!)
+     `(,<s64vector> ,uvector-length ,s64vector-ref ,s64vector-set!
+                    ,make-s64vector . ,uvector-copy!)
+     `(,<f16vector> ,uvector-length ,f16vector-ref ,f16vector-set!
+                    ,make-f16vector . ,uvector-copy!)
+     `(,<f32vector> ,uvector-length ,f32vector-ref ,f32vector-set!
+                    ,make-f32vector . ,uvector-copy!) 
+     `(,<f64vector> ,uvector-length ,f64vector-ref ,f64vector-set!
+                    ,make-f64vector . ,uvector-copy!)
+     ))
+
+;; dprocs is (<length> <ref> <set!> <alloc> . <copy!>)
+(define-inline (%dprocs storage)
+  (hash-table-get *dispatch-table* (class-of storage)))
+
+(define-inline (%rb-size dprocs storage)
+  ((car dprocs) storage))
+
+(define-inline (%rb-mod-index dprocs storage index)
+  (modulo index (%rb-size dprocs storage)))
+
+(define-inline (%rb-ref dprocs storage index)
+  ((cadr dprocs) storage index))
+
+(define-inline (%rb-ref-1 dprocs storage index)
+  ((cadr dprocs) storage (%rb-mod-index dprocs storage (- index 1))))
+  
+(define-inline (%rb-set! dprocs storage index val)
+  ((caddr dprocs) storage index val))
+
+(define-inline (%rb-alloc dprocs size)
+  ((cadddr dprocs) size))
+
+(define-inline (%rb-copy! dprocs dest dstart src sstart send)
+  ((cddddr dprocs) dest dstart src sstart send))
+
+(define (%rb-copy-contents! rb newvec oldvec)
+  (let1 dprocs (%dprocs oldvec)
+    (let ([h (ring-buffer-head rb)]
+          [t (ring-buffer-tail rb)])
+      (if (<= t h)
+        (let1 c (ring-buffer-capacity rb)
+          (%rb-copy! dprocs newvec 0 oldvec h c)
+          (%rb-copy! dprocs newvec (- c h) oldvec 0 t))
+        (%rb-copy! dprocs newvec 0 oldvec h t)))))
+
+(define-inline (%rb-head-inc! rb dprocs storage delta)
+  ($ ring-buffer-head-set! rb
+     (%rb-mod-index dprocs (ring-buffer-storage rb)
+                    (+ (ring-buffer-head rb) delta))))
+
+(define-inline (%rb-tail-inc! rb dprocs storage delta)
+  ($ ring-buffer-tail-set! rb
+     (%rb-mod-index dprocs (ring-buffer-storage rb)
+                    (+ (ring-buffer-tail rb) delta))))
+
+;; predefined overflow handlers
+(define (overflow-error rb v) 'error)
+(define (overflow-overwrite rb v) 'overwrite)
+
+;; API
+(define (make-overflow-doubler :key (max-increase +inf.0)
+                                    (max-capacity +inf.0))
+  (^[rb v]
+    (let1 size (ring-buffer-capacity rb)
+      (cond [(>= size max-capacity) 'error]
+            [(>= size max-increase)
+             (%rb-alloc (%dprocs v) (+ size max-increase))]
+            [else
+             (%rb-alloc (%dprocs v) (* size 2))]))))
+
+;; API
+;; make-ring-buffer
+;;  Returns a ring buffer.
+;;  STORAGE can be vector-like objects.
+;;  OVERFLOW-HANDLER must be a procedure that takes ring buffer instance
+;;    and the current backing storage.  It can perform one of the following
+;;    ops.
+;;
+;;    Returns 'error      - causes the API to throws an error
+;;    Returns 'overwrite  - overwrite existing entries.
+;;    Allocates larger backing storage
+(define (make-ring-buffer :optional (storage (make-vector 4))
+                          :key (overflow-handler (make-overflow-doubler)))
+  (unless (or (vector? storage) (uvector? storage))
+    (error "Ring buffer storage must be a vector-like object, but got:" storage))
+  (let1 h (case overflow-handler
+            [(error) overflow-error]
+            [(overwrite) overflow-overwrite]
+            [else (unless (applicable? overflow-handler ring-buffer <top>)
+                    (error "overflow-handler must be a procedure, or a symbol error of overwrite, but got" overflow-handler))
+                  overflow-handler])
+    (%make-ring-buffer storage h 0 0 (size-of storage) 0)))
+
+;; API
+(define (ring-buffer-empty? rb) (zero? (ring-buffer-num-entries rb)))
+
+;; API
+(define (ring-buffer-full? rb)
+  (= (ring-buffer-num-entries rb) (ring-buffer-capacity rb)))
+
+(define (%ensure-nonempty rb)
+  (when (ring-buffer-empty? rb)
+    (error "Ring buffer is empty:" rb)))
+
+;; Makes room for N more entries.  Returns the number of entries that
+;; still don't fit, which can be positive only when the overflow handler
+;; says 'overwrite and N is greater than the capacity.
+(define (%ensure-room! rb :optional (n 1))
+  (let loop ()
+    (let1 excess (- (+ (ring-buffer-num-entries rb) n)
+                    (ring-buffer-capacity rb))
+      (if (<= excess 0)
+        0
+        (let1 v ((ring-buffer-overflow-handler rb) rb (ring-buffer-storage rb))
+          (case v
+            [(error) (error "Ring buffer overflow:" rb)]
+            [(overwrite)
+             ;; pop the oldest items so that we can fill them
+             (let ([s (ring-buffer-storage rb)]
+                   [k (min excess (ring-buffer-num-entries rb))])
+               (%rb-head-inc! rb (%dprocs s) s k)
+               (ring-buffer-num-entries-set! rb
+                                             (- (ring-buffer-num-entries rb) k))
+               (- excess k))]
+            [else
+             (unless (or (vector? v) (uvector? v))
+               (error "Ring buffer overflow handler returned invalid object:" v))
+             (unless (> (size-of v) (ring-buffer-capacity rb))
+               (error "Ring buffer overflow handler didn't extend the storage:"
+                      v))
+             (%rb-copy-contents! rb v (ring-buffer-storage rb))
+             (ring-buffer-head-set! rb 0)
+             (ring-buffer-tail-set! rb (ring-buffer-num-entries rb))
+             (ring-buffer-capacity-set! rb (size-of v))
+             (ring-buffer-storage-set! rb v)
+             (loop)]))))))
+
+;; API
+(define (ring-buffer-front rb)
+  (%ensure-nonempty rb)
+  (let1 s (ring-buffer-storage rb)
+    (%rb-ref (%dprocs s) s (ring-buffer-head rb))))
+
+;; API
+(define (ring-buffer-back rb)
+  (%ensure-nonempty rb)
+  (let1 s (ring-buffer-storage rb)
+    (%rb-ref-1 (%dprocs s) s (ring-buffer-tail rb))))
+
+;; API
+(define (ring-buffer-add-front! rb elt)
+  (%ensure-room! rb)
+  (let* ([s (ring-buffer-storage rb)]
+         [dprocs (%dprocs s)])
+    (%rb-head-inc! rb dprocs s -1)
+    (%rb-set! dprocs s (ring-buffer-head rb) elt)
+    (inc! (ring-buffer-num-entries rb))
+    (undefined)))
+
+;; API
+(define (ring-buffer-add-back! rb elt)
+  (%ensure-room! rb)
+  (let* ([s (ring-buffer-storage rb)]
+         [dprocs (%dprocs s)])
+    (%rb-set! dprocs s (ring-buffer-tail rb) elt)
+    (%rb-tail-inc! rb dprocs s 1)
+    (inc! (ring-buffer-num-entries rb))
+    (undefined)))
+
+;; API
+(define (ring-buffer-remove-front! rb)
+  (%ensure-nonempty rb)
+  (let* ([s (ring-buffer-storage rb)]
+         [dprocs (%dprocs s)])
+    (rlet1 v (%rb-ref dprocs s (ring-buffer-head rb))
+      (%rb-head-inc! rb dprocs s 1)
+      (dec! (ring-buffer-num-entries rb)))))
+
+;; API
+(define (ring-buffer-remove-back! rb)
+  (%ensure-nonempty rb)
+  (let* ([s (ring-buffer-storage rb)]
+         [dprocs (%dprocs s)])
+    (%rb-tail-inc! rb dprocs s -1)
+    (dec! (ring-buffer-num-entries rb))
+    (%rb-ref dprocs s (ring-buffer-tail rb))))
+
+;; API
+(define (ring-buffer-ref rb n :optional fallback)
+  (if (<= 0 n (- (ring-buffer-num-entries rb) 1))
+    (let* ([s (ring-buffer-storage rb)]
+           [dprocs (%dprocs s)])
+      (%rb-ref dprocs s (%rb-mod-index dprocs s (+ (ring-buffer-head rb) n))))
+    (if (undefined? fallback)
+      (errorf "index out of range (~s) for a ring buffer ~s" n rb)
+      fallback)))
+
+;; API
+(define (ring-buffer-set! rb n val)
+  (unless (<= 0 n (- (ring-buffer-num-entries rb) 1))
+    (errorf "index out of range (~s) for a ring buffer ~s" n rb))
+  (let* ([s (ring-buffer-storage rb)]
+         [dprocs (%dprocs s)])
+    (%rb-set! dprocs s (%rb-mod-index dprocs s (+ (ring-buffer-head rb) n))
+              val)))
+
+;; Bulk operations.  If the other vector is of the same type as the
+;; backing storage, the elements are copied by at most two calls of
+;; vector-copy! or uvector-copy!, the latter of which is a memmove.
+
+(define (%check-range who vec start end)
+  (unless (<= 0 start end (size-of vec))
+    (errorf "~a: start/end out of range (~s, ~s) for ~s" who start end vec)))
+
+;; API
+(define (ring-buffer-add-back!/multi rb src :optional (start 0)
+                                                      (end (size-of src)))
+  (%check-range 'ring-buffer-add-back!/multi src start end)
+  (if (eq? (class-of src) (class-of (ring-buffer-storage rb)))
+    (let* ([skip (%ensure-room! rb (- end start))]
+           [start (+ start skip)]
+           [m (- end start)])
+      (when (> m 0)
+        (let* ([s (ring-buffer-storage rb)]
+               [dprocs (%dprocs s)]
+               [t (ring-buffer-tail rb)]
+               [r1 (min m (- (ring-buffer-capacity rb) t))])
+          (%rb-copy! dprocs s t src start (+ start r1))
+          (when (< r1 m)
+            (%rb-copy! dprocs s 0 src (+ start r1) end))
+          (%rb-tail-inc! rb dprocs s m)
+          (ring-buffer-num-entries-set! rb (+ (ring-buffer-num-entries rb) m)))))
+    (do ([i start (+ i 1)])
+        [(= i end)]
+      (ring-buffer-add-back! rb (~ src i))))
+  (undefined))
+
+;; API
+;; Returns the number of entries moved.
+(define (ring-buffer-remove-front!/into rb dest :optional (start 0)
+                                                          (end (size-of dest)))
+  (%check-range 'ring-buffer-remove-front!/into dest start end)
+  (let1 m (min (- end start) (ring-buffer-num-entries rb))
+    (if (eq? (class-of dest) (class-of (ring-buffer-storage rb)))
+      (when (> m 0)
+        (let* ([s (ring-buffer-storage rb)]
+               [dprocs (%dprocs s)]
+               [h (ring-buffer-head rb)]
+               [r1 (min m (- (ring-buffer-capacity rb) h))])
+          (%rb-copy! dprocs dest start s h (+ h r1))
+          (when (< r1 m)
+            (%rb-copy! dprocs dest (+ start r1) s 0 (- m r1)))
+          (%rb-head-inc! rb dprocs s m)
+          (ring-buffer-num-entries-set! rb (- (ring-buffer-num-entries rb) m))))
+      (dotimes [i m]
+        (set! (~ dest (+ start i)) (ring-buffer-remove-front! rb))))
+    m))
+
+;;;
+;;; Single-producer single-consumer ring buffer
+;;;
+
+;; <spsc-ring-buffer> has a fixed uvector storage, and is safe to be
+;; used by one producer thread and one consumer thread at the same time
+;; without locking.  Head and tail are running counters; only the
+;; consumer updates head and only the producer updates tail, each with
+;; a release store after copying the elements, and the other side reads
+;; it with an acquire load.  So the elements between them are always
+;; fully written when seen.  Operations don't block; they return
+;; how many elements they could transfer.
+
+(inline-stub
+ "#include \"atomic_ops.h\""
+
+ ;; The padding keeps the counters updated by the producer and the
+ ;; consumer in different cache lines.
+ "typedef struct SpscRingRec {"
+ "  SCM_HEADER;"
+ "  ScmUVector *storage;"
+ "  AO_t capacity;"
+ "  int eltSize;"
+ "  char pad0[64];"
+ "  volatile AO_t head;"           ;; # of elements ever removed
+ "  char pad1[64];"
+ "  volatile AO_t tail;"           ;; # of elements ever added
+ "  char pad2[64];"
+ "} SpscRing;"
+
+ "SCM_CLASS_DECL(SpscRingClass);"
+ "#define SPSCP(obj)  SCM_XTYPEP(obj, &SpscRingClass)"
+ "#define SPSC(obj)   ((SpscRing*)(obj))"
+
+ (define-type <spsc-ring-buffer> "SpscRing*" "spsc-ring-buffer"
+   "SPSCP" "SPSC")
+
+ (define-cfn spsc-num-entries (r::SpscRing*) ::AO_t
+   (let* ([h::AO_t (AO_load_acquire (& (-> r head)))]
+          [t::AO_t (AO_load_acquire (& (-> r tail)))])
+     (return (?: (< t h) 0 (- t h))))) ; can be transiently reversed
+
+ (define-cclass <spsc-ring-buffer>
+   "SpscRing*" "SpscRingClass" ()
+   ((capacity :type <ulong> :setter #f))
+   (printer
+    (Scm_Printf port "#<spsc-ring-buffer %lu/%lu @%p>"
+                (spsc-num-entries (SPSC obj)) (-> (SPSC obj) capacity) obj)))
+
+ (define-cproc make-spsc-ring-buffer (storage::<uvector>)
+   (SCM_UVECTOR_CHECK_MUTABLE storage)
+   (when (== (SCM_UVECTOR_SIZE storage) 0)
+     (Scm_Error "spsc-ring-buffer requires nonempty storage"))
+   (let* ([z::SpscRing* (SCM_NEW SpscRing)])
+     (SCM_SET_CLASS z (& SpscRingClass))
+     (set! (-> z storage) storage
+           (-> z capacity) (SCM_UVECTOR_SIZE storage)
+           (-> z eltSize) (Scm_UVectorElementSize (Scm_ClassOf (SCM_OBJ storage)))
+           (-> z head) 0
+           (-> z tail) 0)
+     (return (SCM_OBJ z))))
+
+ (define-cproc spsc-ring-buffer? (obj) ::<boolean> SPSCP)
+ (define-cproc spsc-ring-buffer-capacity (r::<spsc-ring-buffer>) ::<ulong>
+   (return (-> r capacity)))
+ (define-cproc spsc-ring-buffer-num-entries (r::<spsc-ring-buffer>) ::<ulong>
+   (return (spsc-num-entries r)))
+ (define-cproc spsc-ring-buffer-empty? (r::<spsc-ring-buffer>) ::<boolean>
+   (return (== (spsc-num-entries r) 0)))
+ (define-cproc spsc-ring-buffer-full? (r::<spsc-ring-buffer>) ::<boolean>
+   (return (== (spsc-num-entries r) (-> r capacity))))
+
+ ;; Copies COUNT elements between the ring at running position POS and
+ ;; the buffer P, in two pieces if it wraps around.
+ (define-cfn spsc-copy (r::SpscRing* pos::AO_t p::char* count::AO_t
+                        into-ring::int) ::void
+   (let* ([cap::AO_t (-> r capacity)]
+          [i::AO_t (% pos cap)]
+          [r1::AO_t (?: (< count (- cap i)) count (- cap i))]
+          [es::int (-> r eltSize)]
+          [base::char* (cast char* (SCM_UVECTOR_ELEMENTS (-> r storage)))])
+     (if into-ring
+       (begin
+         (memcpy (+ base (* i es)) p (* r1 es))
+         (memcpy base (+ p (* r1 es)) (* (- count r1) es)))
+       (begin
+         (memcpy p (+ base (* i es)) (* r1 es))
+         (memcpy (+ p (* r1 es)) base (* (- count r1) es))))))
+
+ (define-cfn spsc-check-vec (r::SpscRing* v::ScmUVector* start::ScmSmallInt*
+                             end::ScmSmallInt*) ::void
+   (unless (SCM_EQ (Scm_ClassOf (SCM_OBJ v))
+                   (Scm_ClassOf (SCM_OBJ (-> r storage))))
+     (Scm_Error "uvector of the same type as the storage of %S required, \
+                 but got %S" r v))
+   (let* ([s::ScmSmallInt (* start)] [e::ScmSmallInt (* end)])
+     (SCM_CHECK_START_END s e (SCM_UVECTOR_SIZE v))
+     (set! (* start) s (* end) e)))
+
+ ;; Producer side.  Returns the number of elements added.
+ (define-cproc spsc-ring-buffer-add-back!/multi (r::<spsc-ring-buffer>
+                                                 src::<uvector>
+                                                 :optional (start::<fixnum> 0)
+                                                           (end::<fixnum> -1))
+   ::<ulong>
+   (spsc-check-vec r src (& start) (& end))
+   (let* ([t::AO_t (-> r tail)]
+          [h::AO_t (AO_load_acquire (& (-> r head)))]
+          [room::AO_t (- (-> r capacity) (- t h))]
+          [n::AO_t (- end start)])
+     (when (< room n) (set! n room))
+     (spsc-copy r t (+ (cast char* (SCM_UVECTOR_ELEMENTS src))
+                       (* start (-> r eltSize)))
+                n TRUE)
+     (AO_store_release (& (-> r tail)) (+ t n))
+     (return n)))
+
+ ;; Consumer side.  Returns the number of elements removed.
+ (define-cproc spsc-ring-buffer-remove-front!/into (r::<spsc-ring-buffer>
+                                                    dest::<uvector>
+                                                    :optional (start::<fixnum> 0)
+                                                              (end::<fixnum> -1))
+   ::<ulong>
+   (SCM_UVECTOR_CHECK_MUTABLE dest)
+   (spsc-check-vec r dest (& start) (& end))
+   (let* ([h::AO_t (-> r head)]
+          [t::AO_t (AO_load_acquire (& (-> r tail)))]
+          [n::AO_t (- end start)])
+     (when (< (- t h) n) (set! n (- t h)))
+     (spsc-copy r h (+ (cast char* (SCM_UVECTOR_ELEMENTS dest))
+                       (* start (-> r eltSize)))
+                n FALSE)
+     (AO_store_release (& (-> r head)) (+ h n))
+     (return n)))
+
+ (define-cproc %spsc-storage-class (r::<spsc-ring-buffer>)
+   (return (SCM_OBJ (Scm_ClassOf (SCM_OBJ (-> r storage))))))
+ )
+
+;; Single element operations go through a one-element uvector.  Each
+;; side allocates its own, so that they don't share anything.
+
+;; API
+;; Returns #t if ELT is added, #f if the buffer is full.
+(define (spsc-ring-buffer-add-back! r elt)
+  (let1 v (make-uvector (%spsc-storage-class r) 1)
+    (uvector-set! v 0 elt)
+    (= (spsc-ring-buffer-add-back!/multi r v) 1)))
+
+;; API
+(define (spsc-ring-buffer-remove-front! r :optional fallback)
+  (let1 v (make-uvector (%spsc-storage-class r) 1)
+    (cond [(= (spsc-ring-buffer-remove-front!/into r v) 1) (uvector-ref v 0)]
+          [(undefined? fallback) (error "Ring buffer is empty:" r)]
+          [else fallback])))
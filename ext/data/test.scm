@@ -202,7 +202,116 @@
 
 (test* "mtqueue room" +inf.0 (mtqueue-room (make-mtqueue)))
 
+(let1 q (make-mpmc-queue 3)
+  (test* "mpmc-queue" '(#t #t 3 0 3)
+         (list (mpmc-queue? q) (mtqueue? q) (mtqueue-max-length q)
+               (queue-length q) (mtqueue-room q)))
+  (test* "mpmc-queue enqueue!" '(a b c)
+         (begin (enqueue! q 'a 'b) (enqueue! q 'c) (queue->list q)))
+  (test* "mpmc-queue full" (test-error) (enqueue! q 'd))
+  (test* "mpmc-queue room" 0 (mtqueue-room q))
+  (test* "mpmc-queue front/rear" '(a c) (list (queue-front q) (queue-rear q)))
+  (test* "mpmc-queue dequeue!" '(a b) (list (dequeue! q) (dequeue! q)))
+  (test* "mpmc-queue wrap around" '(c d e f)
+         (begin (enqueue! q 'd 'e) (list (dequeue! q) (dequeue! q)
+                                         (dequeue! q)
+                                         (begin (enqueue! q 'f) (dequeue! q)))))
+  (test* "mpmc-queue empty" '(#t none) (list (queue-empty? q) (dequeue! q 'none)))
+  (test* "mpmc-queue dequeue-all!" '(1 2 3)
+         (begin (enqueue! q 1 2 3) (dequeue-all! q)))
+  (test* "mpmc-queue queue-push!" (test-error) (queue-push! q 'x))
+  (test* "mpmc-queue max-length" (test-error)
+         (set! (~ q 'max-length) 10))
+  (test* "mpmc-queue copy" '(x y)
+         (let1 q2 (copy-queue (list->queue '(x y) <mpmc-queue> :max-length 2))
+           (and (mpmc-queue? q2) (queue->list q2))))
+  (test* "mpmc-queue zero length" (test-error) (make-mpmc-queue 0))
+  )
+
 ;; Note: */wait! APIs are tested in ext/threads/test.scm instead of here,
 ;; since we need threads working.
 
+;;-----------------------------------------------
+(test-section "data.hamt")
+(use data.hamt)
+(test-module 'data.hamt)
+
+(define (hamt-basic-test what cmpr keygen)
+  (define keys (map keygen (iota 1000)))
+  (define h0 (make-hamt cmpr))
+  (define h1 (fold (^[k h] (hamt-put h k (list k))) h0 keys))
+
+  (test* #"~what empty" '(#t 0) (list (hamt-empty? h0) (hamt-num-entries h0)))
+  (test* #"~what put" 1000 (hamt-num-entries h1))
+  (test* #"~what get" #t
+         (every (^k (equal? (hamt-get h1 k) (list k))) keys))
+  (test* #"~what get (fallback)" 'none (hamt-get h0 (car keys) 'none))
+  (test* #"~what get (error)" (test-error) (hamt-get h0 (car keys)))
+  (test* #"~what check" #t (begin (%hamt-check h1) #t))
+
+  (let1 h2 (fold (^[k h] (hamt-delete h k)) h1 (take keys 500))
+    (test* #"~what delete" 500 (hamt-num-entries h2))
+    (test* #"~what delete" '(#f #t)
+           (list (hamt-exists? h2 (car keys)) (hamt-exists? h2 (last keys))))
+    (test* #"~what original intact" 1000 (hamt-num-entries h1))
+    (test* #"~what original intact" #t
+           (every (^k (hamt-exists? h1 k)) keys))
+    (test* #"~what check" #t (begin (%hamt-check h2) #t))
+    (test* #"~what delete all" #t
+           (hamt-empty? (fold (^[k h] (hamt-delete h k)) h2 keys))))
+
+  (test* #"~what put (same value)" #t
+         (let1 v (hamt-get h1 (car keys))
+           (eq? h1 (hamt-put h1 (car keys) v))))
+  (test* #"~what delete (nonexistent)" #t
+         (eq? h0 (hamt-delete h0 (car keys))))
+
+  ;; The shape doesn't depend on the order of insertions.
+  (let1 h3 (fold (^[k h] (hamt-put h k (list k))) h0 (reverse keys))
+    (test* #"~what hamt=?" #t (hamt=? h1 h3))
+    (test* #"~what hamt=?" #f
+           (hamt=? h1 (hamt-put h3 (car keys) 'x)))
+    (test* #"~what hamt=?" #f
+           (hamt=? h1 (hamt-delete h3 (car keys))))
+    (test* #"~what hamt=? (value=?)" #f (hamt=? h1 h3 eq?)))
+
+  (test* #"~what fold" (length keys)
+         (hamt-fold h1 (^[k v n] (+ n 1)) 0))
+  (test* #"~what ->alist" #t
+         (lset= equal? (map (^k (cons k (list k))) keys) (hamt->alist h1)))
+  )
+
+(hamt-basic-test "eq" 'eq? (^i (string->symbol #"s~i")))
+(hamt-basic-test "eqv" 'eqv? (^i (* i 1/3)))
+(hamt-basic-test "equal" 'equal? (^i (list i (* i 2))))
+(hamt-basic-test "string" 'string=? (^i (number->string i)))
+(hamt-basic-test "general" default-comparator (^i (- i 500)))
+;; A hash function that makes many collisions
+(hamt-basic-test "collision"
+                 (make-comparator integer? = #f (^x (modulo x 7)))
+                 identity)
+
+(let* ([h (alist->hamt '((a . 1) (b . 2) (c . 3)) 'eq?)]
+       [t (hamt-transient h)])
+  (test* "alist->hamt" '(1 2 3) (map (cut hamt-get h <>) '(a b c)))
+  (test* "transient put!" 2
+         (begin (transient-hamt-put! t 'd 4)
+                (transient-hamt-put! t 'a 10)
+                (transient-hamt-delete! t 'b)
+                (transient-hamt-delete! t 'c)
+                (transient-hamt-num-entries t)))
+  (test* "transient get" '(10 none 4)
+         (map (cut transient-hamt-get t <> 'none) '(a b d)))
+  (test* "transient doesn't affect original" '(1 2 3)
+         (map (cut hamt-get h <>) '(a b c)))
+  (let1 h2 (hamt-persistent! t)
+    (test* "persistent!" '((a . 10) (d . 4))
+           (sort (hamt->alist h2) (^[x y] (string<? (x->string (car x))
+                                                      (x->string (car y))))))
+    (test* "persistent! (done)" (test-error) (transient-hamt-put! t 'e 5))
+    (test* "persistent! (done)" (test-error) (hamt-persistent! t))
+    (test* "persistent! (can read)" 10 (transient-hamt-get t 'a))
+    (test* "dict interface" 4 (dict-get h2 'd))
+    (test* "dict interface" (test-error) (dict-put! h2 'd 5))))
+
 (test-end)
@@ -61,6 +61,7 @@
    (sync      :init-keyword :sync   :initform #f)
    (nolock    :init-keyword :nolock :initform #f)
    (bsize     :init-keyword :bsize  :initform 0)
+   (txn-depth :initform 0)
    )
   :metaclass <gdbm-meta>)
 
@@ -130,6 +131,28 @@
   (when (positive? (gdbm-delete (gdbm-file-of self) (%dbm-k2s self key)))
     (errorf "dbm-delete!: deleteting key ~s from ~s failed" key self)))
 
+;; Within a transaction, we turn off the per-store sync of a :sync
+;; database, and sync once at the end.
+(define-method dbm-with-transaction ((self <gdbm>) thunk)
+  (next-method self
+               (^[]
+                 (let ([gdbm (gdbm-file-of self)]
+                       [depth (slot-ref self 'txn-depth)]
+                       [nosync? (and (slot-ref self 'sync)
+                                     (not (eq? (slot-ref self 'rw-mode) :read))
+                                     (not (zero? GDBM_SYNCMODE)))])
+                   (dynamic-wind
+                    (^[] (when (and nosync? (zero? depth))
+                           (gdbm-setopt gdbm GDBM_SYNCMODE #f))
+                         (slot-set! self 'txn-depth (+ depth 1)))
+                    thunk
+                    (^[] (slot-set! self 'txn-depth depth)
+                         (when (and (zero? depth) (not (gdbm-closed? gdbm)))
+                           (when nosync?
+                             (gdbm-setopt gdbm GDBM_SYNCMODE #t))
+                           (unless (eq? (slot-ref self 'rw-mode) :read)
+                             (gdbm-sync gdbm)))))))))
+
 ;;
 ;; Iterations
 ;;
@@ -0,0 +1,544 @@
+;;;
+;;; lmdb - LMDB interface
+;;;
+;;;   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; LMDB is a memory-mapped B+tree.  A database is kept in one file
+;; (we always open the environment with MDB_NOSUBDIR) plus its lock file
+;; "<path>-lock".  Readers never block the writer nor each other; there
+;; can be one write transaction at a time.
+
+(define-module dbm.lmdb
+  (extend dbm)
+  (use gauche.uvector)
+  (export <lmdb>
+          call-with-lmdb-transaction lmdb-fold-range
+          ;; low-level functions
+          lmdb-env-open      lmdb-env-close      lmdb-env-closed?
+          lmdb-env-sync      lmdb-env-copy       lmdb-env-path
+          lmdb-txn-begin     lmdb-txn-commit     lmdb-txn-abort
+          lmdb-txn-active?   lmdb-txn-read-only?
+          lmdb-get           lmdb-get-u8vector   lmdb-put!
+          lmdb-delete!       lmdb-exists?
+          lmdb-cursor-open   lmdb-cursor-close   lmdb-cursor-get
+          lmdb-version
+          MDB_RDONLY         MDB_NOSYNC          MDB_NOMETASYNC
+          MDB_NORDAHEAD      MDB_WRITEMAP        MDB_MAPASYNC
+          MDB_NOOVERWRITE    MDB_APPEND
+          MDB_FIRST          MDB_LAST            MDB_NEXT
+          MDB_PREV           MDB_SET_KEY         MDB_SET_RANGE
+          MDB_GET_CURRENT)
+  )
+(select-module dbm.lmdb)
+
+;;;
+;;; High-level dbm interface
+;;;
+
+(define-class <lmdb-meta> (<dbm-meta>)
+  ())
+
+(define-class <lmdb> (<dbm>)
+  ((lmdb-env    :accessor lmdb-env-of :initform #f)
+   (sync        :init-keyword :sync        :initform #t)
+   (map-size    :init-keyword :map-size    :initform (* 256 1024 1024))
+   (max-readers :init-keyword :max-readers :initform 126)
+   ;; the transaction established by call-with-lmdb-transaction.
+   ;; it's a parameter so that each thread sees its own.
+   (txn         :initform (make-parameter #f))
+   )
+  :metaclass <lmdb-meta>)
+
+(define-method dbm-open ((self <lmdb>))
+  (next-method)
+  (unless (slot-bound? self 'path)
+    (error "path must be set to open lmdb database"))
+  (when (lmdb-env-of self)
+    (errorf "lmdb ~S already opened" self))
+  (let* ([path   (slot-ref self 'path)]
+         [rwmode (slot-ref self 'rw-mode)]
+         [flags  (+ (if (eq? rwmode :read) MDB_RDONLY 0)
+                    (if (slot-ref self 'sync) 0 MDB_NOSYNC))])
+    (when (eq? rwmode :create)
+      (%lmdb-remove-files path))
+    (slot-set! self 'lmdb-env
+               (lmdb-env-open path flags (slot-ref self 'file-mode)
+                              (slot-ref self 'map-size)
+                              (slot-ref self 'max-readers)))
+    self))
+
+;; Calls PROC with a transaction.  If we're inside
+;; call-with-lmdb-transaction, its transaction is used.  Otherwise
+;; a transaction is created just for PROC.
+(define (%with-txn self read-only? proc)
+  (if-let1 txn ((slot-ref self 'txn))
+    (begin
+      (when (and (not read-only?) (lmdb-txn-read-only? txn))
+        (errorf "lmdb: can't write in a read-only transaction: ~s" self))
+      (proc txn))
+    (%call-with-new-txn self read-only? proc)))
+
+(define (%call-with-new-txn self read-only? proc)
+  (let1 txn (lmdb-txn-begin (lmdb-env-of self) read-only?)
+    (receive r (guard (e [else (lmdb-txn-abort txn) (raise e)])
+                 (proc txn))
+      (lmdb-txn-commit txn)
+      (apply values r))))
+
+(define (call-with-lmdb-transaction db proc :key (read-only #f))
+  (when (dbm-closed? db)
+    (errorf "call-with-lmdb-transaction: dbm already closed: ~s" db))
+  (when ((slot-ref db 'txn))
+    (errorf "call-with-lmdb-transaction: transaction already active: ~s" db))
+  (%call-with-new-txn db (or read-only (eq? (slot-ref db 'rw-mode) :read))
+                      (^[txn]
+                        (parameterize ([(slot-ref db 'txn) txn])
+                          (proc txn)))))
+
+(define-method dbm-with-transaction ((self <lmdb>) thunk)
+  (next-method self
+               (^[]
+                 (if ((slot-ref self 'txn))
+                   (thunk)
+                   (call-with-lmdb-transaction self (^_ (thunk)))))))
+
+;;
+;; close operation
+;;
+
+(define-method dbm-close ((self <lmdb>))
+  (let1 env (lmdb-env-of self)
+    (and env (lmdb-env-close env))))
+
+(define-method dbm-closed? ((self <lmdb>))
+  (let1 env (lmdb-env-of self)
+    (or (not env) (lmdb-env-closed? env))))
+
+;;
+;; accessors
+;;
+
+(define-method dbm-put! ((self <lmdb>) key value)
+  (next-method)
+  (%with-txn self #f
+             (cut lmdb-put! <> (%dbm-k2s self key) (%dbm-v2s self value))))
+
+(define-method dbm-get ((self <lmdb>) key . args)
+  (next-method)
+  (cond [(%with-txn self #t (cut lmdb-get <> (%dbm-k2s self key)))
+         => (cut %dbm-s2v self <>)]
+        [(pair? args) (car args)]     ;fall-back value
+        [else  (errorf "lmdb: no data for key ~s in database ~s"
+                       key self)]))
+
+(define-method dbm-exists? ((self <lmdb>) key)
+  (next-method)
+  (%with-txn self #t (cut lmdb-exists? <> (%dbm-k2s self key))))
+
+(define-method dbm-delete! ((self <lmdb>) key)
+  (next-method)
+  (%with-txn self #f (cut lmdb-delete! <> (%dbm-k2s self key)))
+  (undefined))
+
+;;
+;; Iterations
+;;
+;; Keys are visited in the byte order of their serialized form.
+;;
+
+(define-method dbm-fold ((self <lmdb>) proc knil)
+  (lmdb-fold-range self proc knil))
+
+;; Folds over the entries whose serialized keys are in [START, END).
+;; START and END are keys before conversion; #f means unbounded.
+(define (lmdb-fold-range db proc knil :key (start #f) (end #f))
+  (when (dbm-closed? db) (errorf "lmdb-fold-range: dbm already closed: ~s" db))
+  (let ([skey (and start (%dbm-k2s db start))]
+        [ekey (and end (%dbm-k2s db end))])
+    (%with-txn db #t
+      (^[txn]
+        (let1 cur (lmdb-cursor-open txn)
+          (unwind-protect
+              (let loop ([kv (if skey
+                               (lmdb-cursor-get cur MDB_SET_RANGE skey)
+                               (lmdb-cursor-get cur MDB_FIRST))]
+                         [r knil])
+                (if (and kv (or (not ekey) (string<? (car kv) ekey)))
+                  (let1 r (proc (%dbm-s2k db (car kv)) (%dbm-s2v db (cdr kv)) r)
+                    (loop (lmdb-cursor-get cur MDB_NEXT) r))
+                  r))
+            (lmdb-cursor-close cur)))))))
+
+;;
+;; Metaoperations
+;;
+
+(autoload file.util move-file)
+
+(define (%lmdb-lock-file path) #"~|path|-lock")
+
+(define (%lmdb-remove-files path)
+  (sys-unlink path)
+  (sys-unlink (%lmdb-lock-file path)))
+
+(define-method dbm-db-exists? ((class <lmdb-meta>) name)
+  (file-exists? name))
+
+(define-method dbm-db-remove ((class <lmdb-meta>) name)
+  (%lmdb-remove-files name))
+
+;; mdb_env_copy takes a consistent snapshot in a read transaction,
+;; so we don't need to lock out writers.
+(define-method dbm-db-copy ((class <lmdb-meta>) from to . keys)
+  (let1 env (lmdb-env-open from MDB_RDONLY #o664 0 126)
+    (unwind-protect
+        (begin (%lmdb-remove-files to)
+               (lmdb-env-copy env to))
+      (lmdb-env-close env))))
+
+(define-method dbm-db-move ((class <lmdb-meta>) from to . keys)
+  (apply move-file from to keys)
+  (sys-unlink (%lmdb-lock-file from)))
+
+;;;
+;;; Low-level bindings
+;;;
+
+(inline-stub
+ "#include <lmdb.h>"
+
+ "typedef struct ScmLmdbEnvRec {
+    SCM_HEADER;
+    ScmObj name;
+    MDB_env *env;               /* NULL if closed */
+    MDB_dbi dbi;
+  } ScmLmdbEnv;"
+
+ ;; Read-only cursors have to be closed explicitly, but cursors of a
+ ;; write transaction are freed by LMDB when the transaction ends.
+ ;; So a transaction keeps track of its cursors, and invalidates them
+ ;; when it ends.
+ "typedef struct ScmLmdbTxnRec {
+    SCM_HEADER;
+    ScmLmdbEnv *env;
+    MDB_txn *txn;               /* NULL if committed or aborted */
+    int readonly;
+    ScmObj cursors;             /* list of live cursors */
+  } ScmLmdbTxn;"
+
+ "typedef struct ScmLmdbCursorRec {
+    SCM_HEADER;
+    ScmLmdbTxn *txn;
+    MDB_cursor *cursor;         /* NULL if closed */
+  } ScmLmdbCursor;"
+
+ (define-cclass <lmdb-env> :private ScmLmdbEnv* "Scm_LmdbEnvClass" ()
+   ()
+   [printer
+    (Scm_Printf port "#<lmdb-env %S>" (-> (SCM_LMDB_ENV obj) name))])
+
+ (define-cclass <lmdb-txn> :private ScmLmdbTxn* "Scm_LmdbTxnClass" ()
+   ()
+   [printer
+    (Scm_Printf port "#<lmdb-txn %S%s>"
+                (-> (-> (SCM_LMDB_TXN obj) env) name)
+                (?: (-> (SCM_LMDB_TXN obj) readonly) " read-only" ""))])
+
+ (define-cclass <lmdb-cursor> :private ScmLmdbCursor* "Scm_LmdbCursorClass" ()
+   ()
+   [printer
+    (Scm_Printf port "#<lmdb-cursor %S>"
+                (-> (-> (-> (SCM_LMDB_CURSOR obj) txn) env) name))])
+
+ (define-cise-stmt CHECK_RC
+   [(_ rc what obj)
+    `(unless (== ,rc 0)
+       (Scm_Error "lmdb: %s failed on %S: %s" ,what ,obj (mdb_strerror ,rc)))])
+
+ (define-cise-stmt CHECK_ENV
+   [(_ e)
+    `(unless (-> ,e env) (Scm_Error "lmdb env already closed: %S" ,e))])
+
+ (define-cise-stmt CHECK_TXN
+   [(_ t)
+    `(unless (-> ,t txn) (Scm_Error "lmdb transaction already finished: %S" ,t))])
+
+ (define-cise-stmt CHECK_WRITABLE
+   [(_ t)
+    `(begin
+       (CHECK_TXN ,t)
+       (when (-> ,t readonly)
+         (Scm_Error "lmdb transaction is read-only: %S" ,t)))])
+
+ (define-cfn env_finalize (obj data::void*) ::void :static
+   (let* ([e::ScmLmdbEnv* (SCM_LMDB_ENV obj)])
+     (when (-> e env)
+       (mdb_env_close (-> e env))
+       (set! (-> e env) NULL))))
+
+ ;; Closes cursors of T, and ends T.  Cursors of a write transaction
+ ;; are freed by LMDB itself.
+ (define-cfn txn_end (t::ScmLmdbTxn* commit::int) ::int :static
+   (let* ([rc::int 0])
+     (dolist [c (-> t cursors)]
+       (when (and (-> (SCM_LMDB_CURSOR c) cursor) (-> t readonly))
+         (mdb_cursor_close (-> (SCM_LMDB_CURSOR c) cursor)))
+       (set! (-> (SCM_LMDB_CURSOR c) cursor) NULL))
+     (set! (-> t cursors) SCM_NIL)
+     (cond [commit (set! rc (mdb_txn_commit (-> t txn)))]
+           [else (mdb_txn_abort (-> t txn))])
+     (set! (-> t txn) NULL)
+     (return rc)))
+
+ ;; A transaction refers to its environment, so it is finalized first.
+ (define-cfn txn_finalize (obj data::void*) ::void :static
+   (let* ([t::ScmLmdbTxn* (SCM_LMDB_TXN obj)])
+     (when (and (-> t txn) (-> t env env))
+       (txn_end t FALSE))))
+
+ (define-cfn obj_to_val (obj v::MDB_val*) ::void :static
+   (cond [(SCM_STRINGP obj)
+          (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY obj)])
+            (set! (-> v mv_data) (cast void* (SCM_STRING_BODY_START b)))
+            (set! (-> v mv_size) (SCM_STRING_BODY_SIZE b)))]
+         [(SCM_U8VECTORP obj)
+          (set! (-> v mv_data) (cast void* (SCM_U8VECTOR_ELEMENTS obj)))
+          (set! (-> v mv_size) (SCM_U8VECTOR_SIZE obj))]
+         [else
+          (Scm_Error "string or u8vector required, but got %S" obj)]))
+
+ (define-cfn val_to_string (v::MDB_val*) :static
+   (return (Scm_MakeString (cast (const char*) (-> v mv_data))
+                           (-> v mv_size) -1 SCM_STRING_COPYING)))
+
+ (define-cproc lmdb-env-open (name::<string>
+                              :optional (flags::<fixnum> 0)
+                                        (fmode::<fixnum> (c "SCM_MAKE_INT(0664)"))
+                                        (mapsize::<ulong> 0)
+                                        (maxreaders::<fixnum> 0))
+   (let* ([z::ScmLmdbEnv* (SCM_NEW ScmLmdbEnv)]
+          [env::MDB_env* NULL]
+          [txn::MDB_txn* NULL]
+          [rc::int (mdb_env_create (& env))])
+     (CHECK_RC rc "mdb_env_create" name)
+     (when (> mapsize 0) (mdb_env_set_mapsize env mapsize))
+     (when (> maxreaders 0) (mdb_env_set_maxreaders env maxreaders))
+     ;; MDB_NOTLS, since a Scheme thread may hold more than one read
+     ;; transaction (e.g. nested dbm-fold).
+     (set! rc (mdb_env_open env (Scm_GetStringConst name)
+                            (logior flags MDB_NOSUBDIR MDB_NOTLS) fmode))
+     (unless (== rc 0)
+       (mdb_env_close env)
+       (Scm_Error "couldn't open lmdb file %S: %s" name (mdb_strerror rc)))
+     (set! rc (mdb_txn_begin env NULL (logand flags MDB_RDONLY) (& txn)))
+     (when (== rc 0)
+       (set! rc (mdb_dbi_open txn NULL
+                              (?: (logand flags MDB_RDONLY) 0 MDB_CREATE)
+                              (& (-> z dbi))))
+       (if (== rc 0)
+         (set! rc (mdb_txn_commit txn))
+         (mdb_txn_abort txn)))
+     (unless (== rc 0)
+       (mdb_env_close env)
+       (Scm_Error "couldn't open lmdb database in %S: %s"
+                  name (mdb_strerror rc)))
+     (SCM_SET_CLASS z (& Scm_LmdbEnvClass))
+     (set! (-> z name) (SCM_OBJ name))
+     (set! (-> z env) env)
+     (Scm_RegisterFinalizer (SCM_OBJ z) env_finalize NULL)
+     (return (SCM_OBJ z))))
+
+ (define-cproc lmdb-env-close (env::<lmdb-env>) ::<void>
+   (when (-> env env)
+     (mdb_env_close (-> env env))
+     (set! (-> env env) NULL)))
+
+ (define-cproc lmdb-env-closed? (env::<lmdb-env>) ::<boolean>
+   (return (== (-> env env) NULL)))
+
+ (define-cproc lmdb-env-path (env::<lmdb-env>)
+   (return (-> env name)))
+
+ (define-cproc lmdb-env-sync (env::<lmdb-env> :optional (force::<boolean> #t))
+   ::<void>
+   (CHECK_ENV env)
+   (let* ([rc::int (mdb_env_sync (-> env env) force)])
+     (CHECK_RC rc "mdb_env_sync" env)))
+
+ (define-cproc lmdb-env-copy (env::<lmdb-env> path::<string>) ::<void>
+   (CHECK_ENV env)
+   (let* ([rc::int (mdb_env_copy (-> env env) (Scm_GetStringConst path))])
+     (CHECK_RC rc "mdb_env_copy" env)))
+
+ (define-cproc lmdb-txn-begin (env::<lmdb-env> :optional (readonly::<boolean> #f))
+   (CHECK_ENV env)
+   (let* ([z::ScmLmdbTxn* (SCM_NEW ScmLmdbTxn)]
+          [txn::MDB_txn* NULL]
+          [rc::int (mdb_txn_begin (-> env env) NULL
+                                  (?: readonly MDB_RDONLY 0) (& txn))])
+     (CHECK_RC rc "mdb_txn_begin" env)
+     (SCM_SET_CLASS z (& Scm_LmdbTxnClass))
+     (set! (-> z env) env
+           (-> z txn) txn
+           (-> z readonly) readonly
+           (-> z cursors) SCM_NIL)
+     (Scm_RegisterFinalizer (SCM_OBJ z) txn_finalize NULL)
+     (return (SCM_OBJ z))))
+
+ (define-cproc lmdb-txn-commit (txn::<lmdb-txn>) ::<void>
+   (CHECK_TXN txn)
+   (let* ([rc::int (txn_end txn TRUE)])
+     (CHECK_RC rc "mdb_txn_commit" txn)))
+
+ (define-cproc lmdb-txn-abort (txn::<lmdb-txn>) ::<void>
+   (when (-> txn txn) (txn_end txn FALSE)))
+
+ (define-cproc lmdb-txn-active? (txn::<lmdb-txn>) ::<boolean>
+   (return (!= (-> txn txn) NULL)))
+
+ (define-cproc lmdb-txn-read-only? (txn::<lmdb-txn>) ::<boolean>
+   (return (-> txn readonly)))
+
+ ;; Returns the value as a string, or #f if KEY isn't found.
+ (define-cproc lmdb-get (txn::<lmdb-txn> key)
+   (let* ([k::MDB_val] [v::MDB_val] [rc::int 0])
+     (CHECK_TXN txn)
+     (obj_to_val key (& k))
+     (set! rc (mdb_get (-> txn txn) (-> txn env dbi) (& k) (& v)))
+     (cond [(== rc MDB_NOTFOUND) (return SCM_FALSE)]
+           [else (CHECK_RC rc "mdb_get" txn)
+                 (return (val_to_string (& v)))])))
+
+ ;; Returns the value as an immutable u8vector that directly points into
+ ;; the memory-mapped database.  It is valid only while TXN is active.
+ (define-cproc lmdb-get-u8vector (txn::<lmdb-txn> key)
+   (let* ([k::MDB_val] [v::MDB_val] [rc::int 0])
+     (CHECK_TXN txn)
+     (obj_to_val key (& k))
+     (set! rc (mdb_get (-> txn txn) (-> txn env dbi) (& k) (& v)))
+     (cond [(== rc MDB_NOTFOUND) (return SCM_FALSE)]
+           [else (CHECK_RC rc "mdb_get" txn)
+                 (return (Scm_MakeUVectorFull SCM_CLASS_U8VECTOR
+                                              (-> v mv_size) (-> v mv_data)
+                                              TRUE txn))])))
+
+ (define-cproc lmdb-exists? (txn::<lmdb-txn> key) ::<boolean>
+   (let* ([k::MDB_val] [v::MDB_val] [rc::int 0])
+     (CHECK_TXN txn)
+     (obj_to_val key (& k))
+     (set! rc (mdb_get (-> txn txn) (-> txn env dbi) (& k) (& v)))
+     (when (== rc MDB_NOTFOUND) (return FALSE))
+     (CHECK_RC rc "mdb_get" txn)
+     (return TRUE)))
+
+ ;; Returns #f if FLAGS has MDB_NOOVERWRITE and KEY already exists.
+ (define-cproc lmdb-put! (txn::<lmdb-txn> key val :optional (flags::<fixnum> 0))
+   ::<boolean>
+   (let* ([k::MDB_val] [v::MDB_val] [rc::int 0])
+     (CHECK_WRITABLE txn)
+     (obj_to_val key (& k))
+     (obj_to_val val (& v))
+     (set! rc (mdb_put (-> txn txn) (-> txn env dbi) (& k) (& v) flags))
+     (when (== rc MDB_KEYEXIST) (return FALSE))
+     (CHECK_RC rc "mdb_put" txn)
+     (return TRUE)))
+
+ ;; Returns #f if KEY isn't found.
+ (define-cproc lmdb-delete! (txn::<lmdb-txn> key) ::<boolean>
+   (let* ([k::MDB_val] [rc::int 0])
+     (CHECK_WRITABLE txn)
+     (obj_to_val key (& k))
+     (set! rc (mdb_del (-> txn txn) (-> txn env dbi) (& k) NULL))
+     (when (== rc MDB_NOTFOUND) (return FALSE))
+     (CHECK_RC rc "mdb_del" txn)
+     (return TRUE)))
+
+ (define-cproc lmdb-cursor-open (txn::<lmdb-txn>)
+   (let* ([z::ScmLmdbCursor* (SCM_NEW ScmLmdbCursor)]
+          [cur::MDB_cursor* NULL]
+          [rc::int 0])
+     (CHECK_TXN txn)
+     (set! rc (mdb_cursor_open (-> txn txn) (-> txn env dbi) (& cur)))
+     (CHECK_RC rc "mdb_cursor_open" txn)
+     (SCM_SET_CLASS z (& Scm_LmdbCursorClass))
+     (set! (-> z txn) txn
+           (-> z cursor) cur)
+     (set! (-> txn cursors) (Scm_Cons (SCM_OBJ z) (-> txn cursors)))
+     (return (SCM_OBJ z))))
+
+ (define-cproc lmdb-cursor-close (cur::<lmdb-cursor>) ::<void>
+   (when (-> cur cursor)
+     (mdb_cursor_close (-> cur cursor))
+     (set! (-> cur cursor) NULL)
+     (set! (-> cur txn cursors)
+           (Scm_DeleteX (SCM_OBJ cur) (-> cur txn cursors) SCM_CMP_EQ))))
+
+ ;; Moves the cursor by OP and returns (key . value) of the entry there,
+ ;; or #f if there's no such entry.  KEY is used by MDB_SET_KEY and
+ ;; MDB_SET_RANGE.  If AS-UVECTOR is true, the value is returned as an
+ ;; immutable u8vector as lmdb-get-u8vector.
+ (define-cproc lmdb-cursor-get (cur::<lmdb-cursor> op::<fixnum>
+                                :optional (key #f) (as-uvector::<boolean> #f))
+   (let* ([k::MDB_val] [v::MDB_val] [rc::int 0])
+     (unless (-> cur cursor)
+       (Scm_Error "lmdb cursor already closed: %S" cur))
+     (if (SCM_FALSEP key)
+       (set! (ref k mv_data) NULL (ref k mv_size) 0)
+       (obj_to_val key (& k)))
+     (set! rc (mdb_cursor_get (-> cur cursor) (& k) (& v) op))
+     (when (== rc MDB_NOTFOUND) (return SCM_FALSE))
+     (CHECK_RC rc "mdb_cursor_get" cur)
+     (return (Scm_Cons (val_to_string (& k))
+                       (?: as-uvector
+                           (Scm_MakeUVectorFull SCM_CLASS_U8VECTOR
+                                                (ref v mv_size) (ref v mv_data)
+                                                TRUE (-> cur txn))
+                           (val_to_string (& v)))))))
+
+ (define-cproc lmdb-version ()
+   (return (SCM_MAKE_STR_IMMUTABLE (mdb_version NULL NULL NULL))))
+
+ (define-enum MDB_RDONLY)
+ (define-enum MDB_NOSYNC)
+ (define-enum MDB_NOMETASYNC)
+ (define-enum MDB_NORDAHEAD)
+ (define-enum MDB_WRITEMAP)
+ (define-enum MDB_MAPASYNC)
+ (define-enum MDB_NOOVERWRITE)
+ (define-enum MDB_APPEND)
+ (define-enum MDB_FIRST)
+ (define-enum MDB_LAST)
+ (define-enum MDB_NEXT)
+ (define-enum MDB_PREV)
+ (define-enum MDB_SET_KEY)
+ (define-enum MDB_SET_RANGE)
+ (define-enum MDB_GET_CURRENT)
+ )
@@ -7,6 +7,7 @@
 (use file.util)
 (use gauche.collection)
 (use gauche.dictionary)
+(use gauche.uvector)
 
 (test-start "dbm")
 
@@ -157,6 +158,27 @@
               (dict-keys tab))
        (dbm-close t)))))
 
+;; do batch updates and transactions work?
+(define (test:put-batch dataset)
+  (dbm-put-batch! *current-dbm* (hash-table->alist dataset))
+  (test:get dataset))
+
+(define (test:transaction)
+  (and (dbm-with-transaction *current-dbm*
+         (^[]
+           (dbm-put! *current-dbm* "txn-key" "1")
+           (dbm-put! *current-dbm* "txn-key" "2")
+           (and (equal? (dbm-get *current-dbm* "txn-key") "2")
+                (begin (dbm-delete! *current-dbm* "txn-key")
+                       (not (dbm-exists? *current-dbm* "txn-key")))
+                (begin (dbm-put! *current-dbm* "txn-key" "3")
+                       (and (member "txn-key"
+                                    (dbm-map *current-dbm* (^[k v] k)))
+                            #t)))))
+       (equal? (dbm-get *current-dbm* "txn-key") "3")
+       (begin (dbm-delete! *current-dbm* "txn-key")
+              (not (dbm-exists? *current-dbm* "txn-key")))))
+
 ;; does close work?
 (define (test:close)
   (dbm-close *current-dbm*)
@@ -179,7 +201,7 @@
 (define (clean-up)
   (define (remover f)
     (remove-files (list f (string-append f ".dir") (string-append f ".pag")
-                        (string-append f ".db"))))
+                        (string-append f ".db") (string-append f "-lock"))))
   (remover *test-dbm*)
   (remover *test2-dbm*))
 
@@ -197,6 +219,7 @@
      (test* (tag "put!") #t (test:put! dataset))
      ;; get stuffs
      (test* (tag "get") #t (test:get dataset))
+     (test* (tag "put-batch!") #t (test:put-batch dataset))
      (test* (tag "get-exceptional") #t (test:get-exceptional))
      ;; traverse
      (test* (tag "for-each") #t (test:for-each dataset))
@@ -223,6 +246,8 @@
               (test:make class :write serializer)))
      ;; delete stuffs
      (test* (tag "delete") #t (test:delete dataset))
+     (test* (tag "with-transaction") #t
+            (if (eq? serializer #f) (test:transaction) #t))
      ;; close again
      (test* (tag "close again") #t (test:close))
      ;; copy
@@ -275,4 +300,52 @@
 
 (test-if-exists "dbm--odbm" dbm.odbm <odbm>)
 
+;;
+;; LMDB test
+;;
+
+(test-if-exists "dbm--lmdb" dbm.lmdb <lmdb>)
+
+(when (file-exists? (string-append "dbm--lmdb." (gauche-dso-suffix)))
+  (test-section "lmdb specific")
+  (dynamic-wind
+   clean-up
+   (^[]
+     (let1 db (dbm-open <lmdb> :path *test-dbm* :rw-mode :create)
+       (test* "lmdb transaction" '("a" "b" "c" "d")
+              (begin
+                (call-with-lmdb-transaction db
+                  (^_ (for-each (^k (dbm-put! db k (string-upcase k)))
+                                '("d" "b" "a" "c"))))
+                (dbm-map db (^[k v] k))))
+       (test* "lmdb transaction abort" '(#f "A")
+              (begin
+                (guard (e [else #f])
+                  (call-with-lmdb-transaction db
+                    (^_ (dbm-put! db "e" "E")
+                        (dbm-put! db "a" "X")
+                        (error "abort"))))
+                (list (dbm-get db "e" #f) (dbm-get db "a"))))
+       (test* "lmdb read-only transaction" (test-error)
+              (call-with-lmdb-transaction db
+                (^_ (dbm-put! db "e" "E"))
+                :read-only #t))
+       (test* "lmdb-fold-range" '("c" "b")
+              (lmdb-fold-range db (^[k v r] (cons k r)) '()
+                               :start "b" :end "d"))
+       (test* "lmdb-get-u8vector" '#u8(66)
+              (call-with-lmdb-transaction db
+                (^[txn] (u8vector-copy (lmdb-get-u8vector txn "b")))
+                :read-only #t))
+       (test* "lmdb cursor" '(("d" . "D") ("c" . "C") #f)
+              (call-with-lmdb-transaction db
+                (^[txn]
+                  (let1 c (lmdb-cursor-open txn)
+                    (list (lmdb-cursor-get c MDB_LAST)
+                          (lmdb-cursor-get c MDB_PREV)
+                          (lmdb-cursor-get c MDB_SET_KEY "x"))))
+                :read-only #t))
+       (dbm-close db)))
+   clean-up))
+
 (test-end)
@@ -0,0 +1,712 @@
+/*
+ * fasthash.c - fast non-cryptographic hash functions
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * These are clean-room implementations following the published
+ * specifications of xxHash (https://github.com/Cyan4973/xxHash,
+ * doc/xxhash_spec.md), MurmurHash3 and CRC32C (RFC 3720).
+ *
+ * The bulk loop of XXH3 and CRC32C use SIMD or dedicated instructions
+ * when the running CPU has them (AVX2 or SSE2 for XXH3, SSE4.2 or the
+ * ARMv8 CRC extension for CRC32C); the choice is made once at runtime.
+ */
+
+#include <gauche/config.h>
+#include <string.h>
+#include "fasthash.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define FASTHASH_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define FASTHASH_ARM_CRC 1
+#include <arm_acle.h>
+#endif
+
+/*================================================================
+ * Utilities
+ */
+
+static inline uint32_t bswap32(uint32_t x)
+{
+    return ((x >> 24) | ((x >> 8) & 0xff00)
+            | ((x << 8) & 0xff0000) | (x << 24));
+}
+
+static inline uint64_t bswap64(uint64_t x)
+{
+    return ((uint64_t)bswap32((uint32_t)x) << 32) | bswap32((uint32_t)(x>>32));
+}
+
+static inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+#if defined(WORDS_BIGENDIAN)
+    v = bswap32(v);
+#endif
+    return v;
+}
+
+static inline uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+#if defined(WORDS_BIGENDIAN)
+    v = bswap64(v);
+#endif
+    return v;
+}
+
+static inline void write64(unsigned char *p, uint64_t v)
+{
+#if defined(WORDS_BIGENDIAN)
+    v = bswap64(v);
+#endif
+    memcpy(p, &v, 8);
+}
+
+static inline uint32_t rotl32(uint32_t x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/* Low 64bit xor high 64bit of the 128bit product. */
+static inline uint64_t mul128_fold64(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t p = (__uint128_t)a * b;
+    return (uint64_t)p ^ (uint64_t)(p >> 64);
+#else
+    uint64_t lo_lo = (a & 0xffffffff) * (b & 0xffffffff);
+    uint64_t hi_lo = (a >> 32) * (b & 0xffffffff);
+    uint64_t lo_hi = (a & 0xffffffff) * (b >> 32);
+    uint64_t hi_hi = (a >> 32) * (b >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    uint64_t lower = (cross << 32) | (lo_lo & 0xffffffff);
+    return lower ^ upper;
+#endif
+}
+
+#if defined(FASTHASH_X86)
+/* Returns bits: 1 = SSE4.2, 2 = AVX2 (with OS support) */
+static int x86_features(void)
+{
+    unsigned int a, b, c, d;
+    int r = 0;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return 0;
+    if (c & (1U<<20)) r |= 1;
+    if ((c & (1U<<27)) && __get_cpuid_max(0, NULL) >= 7) { /* OSXSAVE */
+        unsigned int lo, hi;
+        __asm__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        if ((lo & 6) == 6) {                /* XMM and YMM state */
+            __cpuid_count(7, 0, a, b, c, d);
+            if (b & (1U<<5)) r |= 2;
+        }
+    }
+    return r;
+}
+#endif
+
+/*================================================================
+ * XXH64
+ */
+
+#define P64_1 0x9E3779B185EBCA87ULL
+#define P64_2 0xC2B2AE3D27D4EB4FULL
+#define P64_3 0x165667B19E3779F9ULL
+#define P64_4 0x85EBCA77C2B2AE63ULL
+#define P64_5 0x27D4EB2F165667C5ULL
+
+#define P32_1 0x9E3779B1U
+#define P32_2 0x85EBCA77U
+#define P32_3 0xC2B2AE3DU
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+    acc += input * P64_2;
+    acc = rotl64(acc, 31);
+    return acc * P64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t val)
+{
+    acc ^= xxh64_round(0, val);
+    return acc * P64_1 + P64_4;
+}
+
+static inline uint64_t xxh64_avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= P64_2;
+    h ^= h >> 29;
+    h *= P64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+/* Process the tail (< 32 bytes) and finalize. */
+static uint64_t xxh64_finish(uint64_t h, const unsigned char *p, size_t len)
+{
+    while (len >= 8) {
+        h ^= xxh64_round(0, read64(p));
+        h = rotl64(h, 27) * P64_1 + P64_4;
+        p += 8; len -= 8;
+    }
+    if (len >= 4) {
+        h ^= (uint64_t)read32(p) * P64_1;
+        h = rotl64(h, 23) * P64_2 + P64_3;
+        p += 4; len -= 4;
+    }
+    while (len > 0) {
+        h ^= (*p) * P64_5;
+        h = rotl64(h, 11) * P64_1;
+        p++; len--;
+    }
+    return xxh64_avalanche(h);
+}
+
+static inline uint64_t xxh64_converge(const uint64_t v[4])
+{
+    uint64_t h = rotl64(v[0], 1) + rotl64(v[1], 7)
+        + rotl64(v[2], 12) + rotl64(v[3], 18);
+    for (int i=0; i<4; i++) h = xxh64_merge(h, v[i]);
+    return h;
+}
+
+static const unsigned char *xxh64_stripes(uint64_t v[4],
+                                          const unsigned char *p,
+                                          size_t nstripes)
+{
+    uint64_t v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+    while (nstripes-- > 0) {
+        v0 = xxh64_round(v0, read64(p));
+        v1 = xxh64_round(v1, read64(p+8));
+        v2 = xxh64_round(v2, read64(p+16));
+        v3 = xxh64_round(v3, read64(p+24));
+        p += 32;
+    }
+    v[0] = v0; v[1] = v1; v[2] = v2; v[3] = v3;
+    return p;
+}
+
+uint64_t Scm_XXH64(const void *data, size_t len, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char*)data;
+    uint64_t h;
+
+    if (len >= 32) {
+        uint64_t v[4] = { seed + P64_1 + P64_2, seed + P64_2,
+                          seed, seed - P64_1 };
+        p = xxh64_stripes(v, p, len / 32);
+        h = xxh64_converge(v);
+    } else {
+        h = seed + P64_5;
+    }
+    h += (uint64_t)len;
+    return xxh64_finish(h, p, len % 32);
+}
+
+void Scm_XXH64Init(ScmXXH64State *st, uint64_t seed)
+{
+    memset(st, 0, sizeof(*st));
+    st->seed = seed;
+    st->v[0] = seed + P64_1 + P64_2;
+    st->v[1] = seed + P64_2;
+    st->v[2] = seed;
+    st->v[3] = seed - P64_1;
+}
+
+void Scm_XXH64Update(ScmXXH64State *st, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char*)data;
+
+    st->total += len;
+    if (st->memsize + len < 32) {
+        memcpy(st->mem + st->memsize, p, len);
+        st->memsize += (unsigned int)len;
+        return;
+    }
+    if (st->memsize > 0) {
+        size_t fill = 32 - st->memsize;
+        memcpy(st->mem + st->memsize, p, fill);
+        xxh64_stripes(st->v, st->mem, 1);
+        p += fill; len -= fill;
+        st->memsize = 0;
+    }
+    p = xxh64_stripes(st->v, p, len / 32);
+    len %= 32;
+    memcpy(st->mem, p, len);
+    st->memsize = (unsigned int)len;
+}
+
+uint64_t Scm_XXH64Digest(const ScmXXH64State *st)
+{
+    uint64_t h;
+    if (st->total >= 32) h = xxh64_converge(st->v);
+    else                 h = st->seed + P64_5;
+    h += st->total;
+    return xxh64_finish(h, st->mem, st->memsize);
+}
+
+/*================================================================
+ * XXH3 (64bit)
+ */
+
+#define XXH3_SECRET_SIZE   192
+#define XXH3_STRIPE_LEN    64
+#define XXH3_SECRET_RATE   8
+#define XXH3_MIDSIZE_MAX   240
+
+static const unsigned char xxh3_secret[XXH3_SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe,
+    0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+    0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78,
+    0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e,
+    0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+    0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e,
+    0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f,
+    0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+    0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3,
+    0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49,
+    0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+    0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28,
+    0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+#define PRIME_MX1 0x165667919E3779F9ULL
+#define PRIME_MX2 0x9FB21C651E98DF25ULL
+
+static inline uint64_t xxh3_avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline uint64_t xxh3_rrmxmx(uint64_t h, uint64_t len)
+{
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= PRIME_MX2;
+    h ^= h >> 28;
+    return h;
+}
+
+static inline uint64_t xxh3_mix16(const unsigned char *p,
+                                  const unsigned char *s, uint64_t seed)
+{
+    return mul128_fold64(read64(p) ^ (read64(s) + seed),
+                         read64(p+8) ^ (read64(s+8) - seed));
+}
+
+static uint64_t xxh3_0to16(const unsigned char *p, size_t len,
+                           const unsigned char *s, uint64_t seed)
+{
+    if (len > 8) {
+        uint64_t flip1 = (read64(s+24) ^ read64(s+32)) + seed;
+        uint64_t flip2 = (read64(s+40) ^ read64(s+48)) - seed;
+        uint64_t lo = read64(p) ^ flip1;
+        uint64_t hi = read64(p + len - 8) ^ flip2;
+        uint64_t acc = len + bswap64(lo) + hi + mul128_fold64(lo, hi);
+        return xxh3_avalanche(acc);
+    }
+    if (len >= 4) {
+        seed ^= (uint64_t)bswap32((uint32_t)seed) << 32;
+        uint64_t flip = (read64(s+8) ^ read64(s+16)) - seed;
+        uint64_t in64 = read32(p + len - 4) + ((uint64_t)read32(p) << 32);
+        return xxh3_rrmxmx(in64 ^ flip, len);
+    }
+    if (len > 0) {
+        uint32_t combined = ((uint32_t)p[0] << 16) | ((uint32_t)p[len>>1] << 24)
+            | (uint32_t)p[len-1] | ((uint32_t)len << 8);
+        uint64_t flip = (read32(s) ^ read32(s+4)) + seed;
+        return xxh64_avalanche((uint64_t)combined ^ flip);
+    }
+    return xxh64_avalanche(seed ^ (read64(s+56) ^ read64(s+64)));
+}
+
+static uint64_t xxh3_17to128(const unsigned char *p, size_t len,
+                             const unsigned char *s, uint64_t seed)
+{
+    uint64_t acc = len * P64_1;
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) {
+                acc += xxh3_mix16(p+48, s+96, seed);
+                acc += xxh3_mix16(p+len-64, s+112, seed);
+            }
+            acc += xxh3_mix16(p+32, s+64, seed);
+            acc += xxh3_mix16(p+len-48, s+80, seed);
+        }
+        acc += xxh3_mix16(p+16, s+32, seed);
+        acc += xxh3_mix16(p+len-32, s+48, seed);
+    }
+    acc += xxh3_mix16(p, s, seed);
+    acc += xxh3_mix16(p+len-16, s+16, seed);
+    return xxh3_avalanche(acc);
+}
+
+static uint64_t xxh3_129to240(const unsigned char *p, size_t len,
+                              const unsigned char *s, uint64_t seed)
+{
+    uint64_t acc = len * P64_1;
+    int nrounds = (int)len / 16;
+    for (int i=0; i<8; i++) acc += xxh3_mix16(p+16*i, s+16*i, seed);
+    acc = xxh3_avalanche(acc);
+    for (int i=8; i<nrounds; i++) {
+        acc += xxh3_mix16(p+16*i, s+16*(i-8)+3, seed);
+    }
+    acc += xxh3_mix16(p+len-16, s+136-17, seed);
+    return xxh3_avalanche(acc);
+}
+
+/* The long-input loop.  ACC has 8 lanes; each stripe of 64 bytes is
+   mixed with an 8-byte-shifted window of the secret. */
+
+typedef void (*xxh3_accum_proc)(uint64_t *acc, const unsigned char *p,
+                                const unsigned char *s, size_t nstripes);
+typedef void (*xxh3_scramble_proc)(uint64_t *acc, const unsigned char *s);
+
+static void xxh3_accum_scalar(uint64_t *acc, const unsigned char *p,
+                              const unsigned char *s, size_t nstripes)
+{
+    for (size_t n=0; n<nstripes; n++, p+=XXH3_STRIPE_LEN, s+=XXH3_SECRET_RATE) {
+        for (int i=0; i<8; i++) {
+            uint64_t v = read64(p + 8*i);
+            uint64_t k = v ^ read64(s + 8*i);
+            acc[i^1] += v;
+            acc[i] += (k & 0xffffffff) * (k >> 32);
+        }
+    }
+}
+
+static void xxh3_scramble_scalar(uint64_t *acc, const unsigned char *s)
+{
+    for (int i=0; i<8; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= read64(s + 8*i);
+        acc[i] = a * P32_1;
+    }
+}
+
+#if defined(FASTHASH_X86) && !defined(WORDS_BIGENDIAN)
+
+__attribute__((target("sse2")))
+static void xxh3_accum_sse2(uint64_t *acc, const unsigned char *p,
+                            const unsigned char *s, size_t nstripes)
+{
+    __m128i a[4];
+    for (int i=0; i<4; i++) a[i] = _mm_loadu_si128((__m128i*)acc + i);
+    for (size_t n=0; n<nstripes; n++, p+=XXH3_STRIPE_LEN, s+=XXH3_SECRET_RATE) {
+        for (int i=0; i<4; i++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)p + i);
+            __m128i k = _mm_xor_si128(v,
+                                      _mm_loadu_si128((const __m128i*)s + i));
+            __m128i prod = _mm_mul_epu32(k, _mm_shuffle_epi32(k, 0x31));
+            a[i] = _mm_add_epi64(a[i], _mm_shuffle_epi32(v, 0x4e));
+            a[i] = _mm_add_epi64(a[i], prod);
+        }
+    }
+    for (int i=0; i<4; i++) _mm_storeu_si128((__m128i*)acc + i, a[i]);
+}
+
+__attribute__((target("sse2")))
+static void xxh3_scramble_sse2(uint64_t *acc, const unsigned char *s)
+{
+    const __m128i prime = _mm_set1_epi32((int)P32_1);
+    for (int i=0; i<4; i++) {
+        __m128i a = _mm_loadu_si128((__m128i*)acc + i);
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i*)s + i));
+        __m128i lo = _mm_mul_epu32(a, prime);
+        __m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(a, 0x31), prime);
+        a = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+        _mm_storeu_si128((__m128i*)acc + i, a);
+    }
+}
+
+__attribute__((target("avx2")))
+static void xxh3_accum_avx2(uint64_t *acc, const unsigned char *p,
+                            const unsigned char *s, size_t nstripes)
+{
+    __m256i a0 = _mm256_loadu_si256((__m256i*)acc);
+    __m256i a1 = _mm256_loadu_si256((__m256i*)acc + 1);
+    for (size_t n=0; n<nstripes; n++, p+=XXH3_STRIPE_LEN, s+=XXH3_SECRET_RATE) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)p);
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)p + 1);
+        __m256i s0 = _mm256_loadu_si256((const __m256i*)s);
+        __m256i s1 = _mm256_loadu_si256((const __m256i*)s + 1);
+        __m256i k0 = _mm256_xor_si256(v0, s0);
+        __m256i k1 = _mm256_xor_si256(v1, s1);
+        a0 = _mm256_add_epi64(a0, _mm256_shuffle_epi32(v0, 0x4e));
+        a1 = _mm256_add_epi64(a1, _mm256_shuffle_epi32(v1, 0x4e));
+        a0 = _mm256_add_epi64(a0,
+                              _mm256_mul_epu32(k0, _mm256_srli_epi64(k0, 32)));
+        a1 = _mm256_add_epi64(a1,
+                              _mm256_mul_epu32(k1, _mm256_srli_epi64(k1, 32)));
+    }
+    _mm256_storeu_si256((__m256i*)acc, a0);
+    _mm256_storeu_si256((__m256i*)acc + 1, a1);
+}
+
+#endif /* FASTHASH_X86 && !WORDS_BIGENDIAN */
+
+static xxh3_accum_proc xxh3_accum = NULL;
+static xxh3_scramble_proc xxh3_scramble = NULL;
+
+static void xxh3_select(void)
+{
+    xxh3_accum_proc a = xxh3_accum_scalar;
+    xxh3_scramble_proc s = xxh3_scramble_scalar;
+#if defined(FASTHASH_X86) && !defined(WORDS_BIGENDIAN)
+#if defined(__x86_64__) || defined(__SSE2__)
+    a = xxh3_accum_sse2;
+    s = xxh3_scramble_sse2;
+#endif
+    if (x86_features() & 2) a = xxh3_accum_avx2;
+#endif
+    /* Setting them more than once from different threads is harmless. */
+    xxh3_scramble = s;
+    xxh3_accum = a;
+}
+
+static uint64_t xxh3_long(const unsigned char *p, size_t len,
+                          const unsigned char *s)
+{
+    uint64_t acc[8] = { P32_3, P64_1, P64_2, P64_3,
+                        P64_4, P32_2, P64_5, P32_1 };
+    const size_t nstripes_per_block =
+        (XXH3_SECRET_SIZE - XXH3_STRIPE_LEN) / XXH3_SECRET_RATE;
+    const size_t block_len = XXH3_STRIPE_LEN * nstripes_per_block;
+    const size_t nblocks = (len - 1) / block_len;
+
+    if (xxh3_accum == NULL) xxh3_select();
+
+    for (size_t n=0; n<nblocks; n++) {
+        xxh3_accum(acc, p + n*block_len, s, nstripes_per_block);
+        xxh3_scramble(acc, s + XXH3_SECRET_SIZE - XXH3_STRIPE_LEN);
+    }
+    size_t nstripes = ((len - 1) - block_len*nblocks) / XXH3_STRIPE_LEN;
+    xxh3_accum(acc, p + nblocks*block_len, s, nstripes);
+    /* last stripe */
+    xxh3_accum(acc, p + len - XXH3_STRIPE_LEN,
+               s + XXH3_SECRET_SIZE - XXH3_STRIPE_LEN - 7, 1);
+
+    uint64_t r = len * P64_1;
+    for (int i=0; i<4; i++) {
+        r += mul128_fold64(acc[2*i]   ^ read64(s + 11 + 16*i),
+                           acc[2*i+1] ^ read64(s + 11 + 16*i + 8));
+    }
+    return xxh3_avalanche(r);
+}
+
+uint64_t Scm_XXH3_64(const void *data, size_t len, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char*)data;
+    const unsigned char *s = xxh3_secret;
+
+    if (len <= 16)  return xxh3_0to16(p, len, s, seed);
+    if (len <= 128) return xxh3_17to128(p, len, s, seed);
+    if (len <= XXH3_MIDSIZE_MAX) return xxh3_129to240(p, len, s, seed);
+    if (seed == 0)  return xxh3_long(p, len, s);
+
+    /* A seeded long hash uses a secret derived from the seed. */
+    unsigned char custom[XXH3_SECRET_SIZE];
+    for (int i=0; i<XXH3_SECRET_SIZE/16; i++) {
+        write64(custom + 16*i,     read64(s + 16*i) + seed);
+        write64(custom + 16*i + 8, read64(s + 16*i + 8) - seed);
+    }
+    return xxh3_long(p, len, custom);
+}
+
+/*================================================================
+ * CRC32C
+ */
+
+/* Slicing-by-8 tables for the reflected polynomial 0x82F63B78 */
+static uint32_t crc32c_table[8][256];
+static int crc32c_table_ready = 0;
+
+static void crc32c_init_table(void)
+{
+    for (int i=0; i<256; i++) {
+        uint32_t c = (uint32_t)i;
+        for (int k=0; k<8; k++) c = (c >> 1) ^ ((c & 1) ? 0x82F63B78U : 0);
+        crc32c_table[0][i] = c;
+    }
+    for (int i=0; i<256; i++) {
+        for (int t=1; t<8; t++) {
+            uint32_t c = crc32c_table[t-1][i];
+            crc32c_table[t][i] = (c >> 8) ^ crc32c_table[0][c & 0xff];
+        }
+    }
+}
+
+static uint32_t crc32c_sw(uint32_t c, const unsigned char *p, size_t len)
+{
+    while (len >= 8) {
+        uint32_t lo = read32(p) ^ c, hi = read32(p+4);
+        c = crc32c_table[7][lo & 0xff] ^ crc32c_table[6][(lo >> 8) & 0xff]
+            ^ crc32c_table[5][(lo >> 16) & 0xff] ^ crc32c_table[4][lo >> 24]
+            ^ crc32c_table[3][hi & 0xff] ^ crc32c_table[2][(hi >> 8) & 0xff]
+            ^ crc32c_table[1][(hi >> 16) & 0xff] ^ crc32c_table[0][hi >> 24];
+        p += 8; len -= 8;
+    }
+    while (len-- > 0) c = (c >> 8) ^ crc32c_table[0][(c ^ *p++) & 0xff];
+    return c;
+}
+
+#if defined(FASTHASH_X86)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t c, const unsigned char *p, size_t len)
+{
+#if defined(__x86_64__)
+    uint64_t c64 = c;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c64 = _mm_crc32_u64(c64, v);
+        p += 8; len -= 8;
+    }
+    c = (uint32_t)c64;
+#endif
+    while (len >= 4) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        c = _mm_crc32_u32(c, v);
+        p += 4; len -= 4;
+    }
+    while (len-- > 0) c = _mm_crc32_u8(c, *p++);
+    return c;
+}
+#elif defined(FASTHASH_ARM_CRC)
+static uint32_t crc32c_hw(uint32_t c, const unsigned char *p, size_t len)
+{
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = __crc32cd(c, v);
+        p += 8; len -= 8;
+    }
+    while (len-- > 0) c = __crc32cb(c, *p++);
+    return c;
+}
+#endif
+
+/* -1: not checked yet, 0: software, 1: hardware */
+static int crc32c_mode = -1;
+
+static void crc32c_select(void)
+{
+    int mode = 0;
+#if defined(FASTHASH_X86)
+    mode = (x86_features() & 1) ? 1 : 0;
+#elif defined(FASTHASH_ARM_CRC)
+    mode = 1;
+#endif
+    if (mode == 0 && !crc32c_table_ready) {
+        crc32c_init_table();
+        crc32c_table_ready = 1;
+    }
+    crc32c_mode = mode;
+}
+
+uint32_t Scm_CRC32C(uint32_t crc, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char*)data;
+    if (crc32c_mode < 0) crc32c_select();
+#if defined(FASTHASH_X86) || defined(FASTHASH_ARM_CRC)
+    if (crc32c_mode) return ~crc32c_hw(~crc, p, len);
+#endif
+    return ~crc32c_sw(~crc, p, len);
+}
+
+/*================================================================
+ * MurmurHash3 (x86, 32bit)
+ */
+
+uint32_t Scm_Murmur3_32(const void *data, size_t len, uint32_t seed)
+{
+    const unsigned char *p = (const unsigned char*)data;
+    const uint32_t c1 = 0xcc9e2d51U, c2 = 0x1b873593U;
+    uint32_t h = seed, k;
+    size_t nblocks = len / 4;
+
+    for (size_t i=0; i<nblocks; i++, p+=4) {
+        k = read32(p);
+        k *= c1; k = rotl32(k, 15); k *= c2;
+        h ^= k;
+        h = rotl32(h, 13);
+        h = h * 5 + 0xe6546b64U;
+    }
+    k = 0;
+    switch (len & 3) {
+    case 3: k ^= (uint32_t)p[2] << 16; /* FALLTHROUGH */
+    case 2: k ^= (uint32_t)p[1] << 8;  /* FALLTHROUGH */
+    case 1: k ^= p[0];
+        k *= c1; k = rotl32(k, 15); k *= c2;
+        h ^= k;
+    }
+    h ^= (uint32_t)len;
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
+}
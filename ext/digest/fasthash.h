@@ -0,0 +1,67 @@
+/*
+ * fasthash.h - fast non-cryptographic hash functions
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_FASTHASH_H
+#define GAUCHE_FASTHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * xxHash (XXH64 and XXH3 64bit variant), CRC32C (Castagnoli) and
+ * MurmurHash3 (x86 32bit variant).  The results match the reference
+ * implementations bit by bit.
+ *
+ * Scm_CRC32C follows zlib's convention: pass 0 as CRC for the first
+ * chunk, then the previous result to continue.
+ */
+
+uint64_t Scm_XXH64(const void *data, size_t len, uint64_t seed);
+uint64_t Scm_XXH3_64(const void *data, size_t len, uint64_t seed);
+uint32_t Scm_CRC32C(uint32_t crc, const void *data, size_t len);
+uint32_t Scm_Murmur3_32(const void *data, size_t len, uint32_t seed);
+
+/* Incremental XXH64, for hashing ports. */
+typedef struct ScmXXH64StateRec {
+    uint64_t total;
+    uint64_t v[4];
+    uint64_t seed;
+    unsigned char mem[32];
+    unsigned int memsize;
+} ScmXXH64State;
+
+void     Scm_XXH64Init(ScmXXH64State *st, uint64_t seed);
+void     Scm_XXH64Update(ScmXXH64State *st, const void *data, size_t len);
+uint64_t Scm_XXH64Digest(const ScmXXH64State *st);
+
+#endif /* GAUCHE_FASTHASH_H */
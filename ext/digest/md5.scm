@@ -75,8 +75,8 @@
 ;;;
 ;;; Digest framework
 ;;;
-(define-method digest-update! ((self <md5>) data)
-  (%md5-update (context-of self) data))
+(define-method digest-update! ((self <md5>) data :optional (start 0) (end -1))
+  (%md5-update (context-of self) data start end))
 (define-method digest-final! ((self <md5>))
   (%md5-final (context-of self)))
 (define-method digest ((class <md5-meta>))
@@ -106,18 +106,28 @@
       (MD5_Init (& (-> md5 ctx)))
       (return (SCM_OBJ md5)))])
 
- (define-cproc %md5-update (md5::<md5-context> data) ::<void>
-   (cond
-    [(SCM_U8VECTORP data)
-     (MD5_Update (& (-> md5 ctx))
-                (SCM_UVECTOR_ELEMENTS (SCM_U8VECTOR data))
-                (SCM_U8VECTOR_SIZE (SCM_U8VECTOR data)))]
-    [(SCM_STRINGP data)
-     (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY data)])
-       (MD5_Update (& (-> md5 ctx))
-                  (cast (const unsigned char*) (SCM_STRING_BODY_START b))
-                  (SCM_STRING_BODY_SIZE b)))]
-    [else (SCM_TYPE_ERROR data "u8vector or string")]))
+ ;; DATA may be any uvector (hashed as raw bytes in the native byte order)
+ ;; or a string.  START and END count elements for a uvector, and bytes
+ ;; for a string.
+ (define-cproc %md5-update (md5::<md5-context> data
+                            :optional (start::<int> 0) (end::<int> -1))
+   ::<void>
+   (let* ([p::(const unsigned char*) NULL]
+          [len::int 0]
+          [unit::int 1])
+     (cond
+      [(SCM_UVECTORP data)
+       (set! p (cast (const unsigned char*) (SCM_UVECTOR_ELEMENTS data))
+             len (SCM_UVECTOR_SIZE data)
+             unit (Scm_UVectorElementSize (Scm_ClassOf data)))]
+      [(SCM_STRINGP data)
+       (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY data)])
+         (set! p (cast (const unsigned char*) (SCM_STRING_BODY_START b))
+               len (SCM_STRING_BODY_SIZE b)))]
+      [else (SCM_TYPE_ERROR data "uvector or string")])
+     (SCM_CHECK_START_END start end len)
+     (MD5_Update (& (-> md5 ctx)) (+ p (* start unit))
+                 (* (- end start) unit))))
 
  (define-cproc %md5-final (md5::<md5-context>)
    (let* ([digest::(.array (unsigned char) [16])])
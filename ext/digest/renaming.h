@@ -20,6 +20,7 @@
 #define SHA1_Final      Scm_SHA1_Final
 #define SHA1_End        Scm_SHA1_End
 #define SHA1_Data       Scm_SHA1_Data
+#define SHA1_HW_Blocks  Scm_SHA1_HW_Blocks
 
 #define SHA224_Init     Scm_SHA224_Init
 #define SHA224_Update   Scm_SHA224_Update
@@ -32,6 +33,7 @@
 #define SHA256_Final    Scm_SHA256_Final
 #define SHA256_End      Scm_SHA256_End
 #define SHA256_Data     Scm_SHA256_Data
+#define SHA256_HW_Blocks Scm_SHA256_HW_Blocks
 
 #define SHA384_Init     Scm_SHA384_Init
 #define SHA384_Update   Scm_SHA384_Update
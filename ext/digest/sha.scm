@@ -98,8 +98,9 @@
          (let1 ctx (make <sha-context>)
            (,init ctx)
            (slot-set! self 'context ctx)))
-       (define-method digest-update! ((self ,cls) data)
-         (,update (slot-ref self'context) data))
+       (define-method digest-update! ((self ,cls) data :optional (start 0)
+                                                                 (end -1))
+         (,update (slot-ref self'context) data start end))
        (define-method digest-final! ((self ,cls))
          (,final (slot-ref self'context)))
        (define-method digest ((class ,meta))
@@ -147,31 +148,48 @@
  (define-cproc %sha512-init (ctx::<sha-context>) ::<void>
    (SHA512_Init (& (-> ctx ctx))))
 
+ ;; DATA may be any uvector, whose content is hashed as raw bytes in
+ ;; the native byte order, or a string.  START and END count elements
+ ;; for a uvector, and bytes for a string.
  (define-cise-stmt common-update
-   [(_ update ctx data)
-    `(cond
-      [(SCM_U8VECTORP ,data)
-       (,update (& (-> ,ctx ctx))
-                (cast (const unsigned char*)
-                      (SCM_UVECTOR_ELEMENTS (SCM_U8VECTOR ,data)))
-                (SCM_U8VECTOR_SIZE (SCM_U8VECTOR ,data)))]
-      [(SCM_STRINGP ,data)
-       (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY ,data)])
-         (,update (& (-> ,ctx ctx))
-                  (cast (const unsigned char*) (SCM_STRING_BODY_START b))
-                  (SCM_STRING_BODY_SIZE b)))]
-      [else (SCM_TYPE_ERROR ,data "u8vector or string")])])
-
- (define-cproc %sha1-update (ctx::<sha-context> data) ::<void>
-   (common-update SHA1_Update ctx data))
- (define-cproc %sha224-update (ctx::<sha-context> data) ::<void>
-   (common-update SHA224_Update ctx data))
- (define-cproc %sha256-update (ctx::<sha-context> data) ::<void>
-   (common-update SHA256_Update ctx data))
- (define-cproc %sha384-update (ctx::<sha-context> data) ::<void>
-   (common-update SHA384_Update ctx data))
- (define-cproc %sha512-update (ctx::<sha-context> data) ::<void>
-   (common-update SHA512_Update ctx data))
+   [(_ update ctx data start end)
+    `(let* ([p::(const unsigned char*) NULL]
+            [len::int 0]
+            [unit::int 1])
+       (cond
+        [(SCM_UVECTORP ,data)
+         (set! p (cast (const unsigned char*) (SCM_UVECTOR_ELEMENTS ,data))
+               len (SCM_UVECTOR_SIZE ,data)
+               unit (Scm_UVectorElementSize (Scm_ClassOf ,data)))]
+        [(SCM_STRINGP ,data)
+         (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY ,data)])
+           (set! p (cast (const unsigned char*) (SCM_STRING_BODY_START b))
+                 len (SCM_STRING_BODY_SIZE b)))]
+        [else (SCM_TYPE_ERROR ,data "uvector or string")])
+       (SCM_CHECK_START_END ,start ,end len)
+       (,update (& (-> ,ctx ctx)) (+ p (* ,start unit))
+                (* (- ,end ,start) unit)))])
+
+ (define-cproc %sha1-update (ctx::<sha-context> data
+                               :optional (start::<int> 0) (end::<int> -1))
+   ::<void>
+   (common-update SHA1_Update ctx data start end))
+ (define-cproc %sha224-update (ctx::<sha-context> data
+                               :optional (start::<int> 0) (end::<int> -1))
+   ::<void>
+   (common-update SHA224_Update ctx data start end))
+ (define-cproc %sha256-update (ctx::<sha-context> data
+                               :optional (start::<int> 0) (end::<int> -1))
+   ::<void>
+   (common-update SHA256_Update ctx data start end))
+ (define-cproc %sha384-update (ctx::<sha-context> data
+                               :optional (start::<int> 0) (end::<int> -1))
+   ::<void>
+   (common-update SHA384_Update ctx data start end))
+ (define-cproc %sha512-update (ctx::<sha-context> data
+                               :optional (start::<int> 0) (end::<int> -1))
+   ::<void>
+   (common-update SHA512_Update ctx data start end))
 
  (define-cise-stmt common-final
    [(_ final ctx size)
@@ -36,6 +36,7 @@
 #include <string.h>	/* memcpy()/memset() or bcopy()/bzero() */
 #include <assert.h>	/* assert() */
 #include "sha2.h"
+#include "sha2hw.h"
 
 /*
  * ASSERT NOTE:
@@ -660,7 +661,8 @@ void SHA1_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 			context->s1.bitcount += freespace << 3;
 			len -= freespace;
 			data += freespace;
-			SHA1_Internal_Transform(context, (sha_word32*)context->s1.buffer);
+			if (SHA1_HW_Blocks(context, context->s1.buffer, 1) == 0)
+				SHA1_Internal_Transform(context, (sha_word32*)context->s1.buffer);
 		} else {
 			/* The buffer is not yet full */
 			MEMCPY_BCOPY(&context->s1.buffer[usedspace], data, len);
@@ -670,6 +672,14 @@ void SHA1_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 			return;
 		}
 	}
+	if (len >= 64) {
+		/* Let the CPU's SHA instructions take all complete blocks
+		   at once, if available (see sha2hw.c) */
+		size_t nblocks = SHA1_HW_Blocks(context, data, len / 64);
+		context->s1.bitcount += (sha_word64)nblocks << 9;
+		len -= nblocks * 64;
+		data += nblocks * 64;
+	}
 	while (len >= 64) {
 		/* Process as many complete blocks as we can */
 		SHA1_Internal_Transform(context, (sha_word32*)data);
@@ -1000,7 +1010,8 @@ void SHA256_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 			context->s256.bitcount += freespace << 3;
 			len -= freespace;
 			data += freespace;
-			SHA256_Internal_Transform(context, (sha_word32*)context->s256.buffer);
+			if (SHA256_HW_Blocks(context, context->s256.buffer, 1) == 0)
+				SHA256_Internal_Transform(context, (sha_word32*)context->s256.buffer);
 		} else {
 			/* The buffer is not yet full */
 			MEMCPY_BCOPY(&context->s256.buffer[usedspace], data, len);
@@ -1010,6 +1021,14 @@ void SHA256_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 			return;
 		}
 	}
+	if (len >= 64) {
+		/* Let the CPU's SHA instructions take all complete blocks
+		   at once, if available (see sha2hw.c) */
+		size_t nblocks = SHA256_HW_Blocks(context, data, len / 64);
+		context->s256.bitcount += (sha_word64)nblocks << 9;
+		len -= nblocks * 64;
+		data += nblocks * 64;
+	}
 	while (len >= 64) {
 		/* Process as many complete blocks as we can */
 		SHA256_Internal_Transform(context, (sha_word32*)data);
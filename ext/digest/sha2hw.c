@@ -0,0 +1,323 @@
+/*
+ * sha2hw.c - hardware-assisted SHA-1 and SHA-256 block transforms
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The portable transforms in sha2.c process one block at a time and
+ * dominate the cost of hashing large inputs.  Most recent CPUs have
+ * dedicated instructions for SHA-1 and SHA-256, which are several times
+ * faster.  We pick them at runtime, so that the same binary runs on
+ * older CPUs as well.
+ *
+ *  - x86/x86_64: SHA extensions (SHA-NI), which also requires SSSE3 and
+ *    SSE4.1.  Compiled in with function-level target attributes, so
+ *    no special compiler flags are needed; the availability is checked
+ *    with CPUID.
+ *  - AArch64: ARMv8 cryptography extensions.  arm_neon.h only provides
+ *    the intrinsics when the compiler targets them, so this path is
+ *    compiled in only with -march=armv8-a+crypto (or the like).  On Linux
+ *    we further check the hwcaps.
+ */
+
+#include <stdint.h>
+#include "sha2hw.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define SHA2HW_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+#elif defined(__aarch64__) \
+    && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+#define SHA2HW_ARM 1
+#include <arm_neon.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+#if defined(SHA2HW_X86) || defined(SHA2HW_ARM)
+
+static const uint32_t K256[64] = {
+    0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL,
+    0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
+    0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL,
+    0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL,
+    0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL,
+    0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
+    0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL,
+    0xc6e00bf3UL, 0xd5a79147UL, 0x06ca6351UL, 0x14292967UL,
+    0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL,
+    0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
+    0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL,
+    0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
+    0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL,
+    0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL, 0x682e6ff3UL,
+    0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL,
+    0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL
+};
+
+/* -1: not checked yet, 0: unavailable, 1: available.
+   Checking twice from different threads is harmless. */
+static int sha_hw_available = -1;
+
+#endif /* SHA2HW_X86 || SHA2HW_ARM */
+
+/*================================================================
+ * x86 SHA extensions
+ */
+#if defined(SHA2HW_X86)
+
+static int sha_hw_check(void)
+{
+    unsigned int a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return 0;
+    if (!(c & (1U<<9)) || !(c & (1U<<19))) return 0;   /* SSSE3, SSE4.1 */
+    if (__get_cpuid_max(0, NULL) < 7) return 0;
+    __cpuid_count(7, 0, a, b, c, d);
+    return (b & (1U<<29)) != 0;                         /* SHA */
+}
+
+#define SHA2HW_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+
+/* In both transforms, W[i&3] holds 4 words of the message schedule in
+   a ring; when we're about to compute group i, W[i&3] holds group i-4,
+   W[(i+1)&3] group i-3, and so on. */
+
+SHA2HW_TARGET
+static void sha1_x86(uint32_t *state, const unsigned char *data, size_t n)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+                                        0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state),
+                                     0x1b);
+    __m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+    while (n-- > 0) {
+        __m128i abcd_save = abcd, e0_save = e0, prev = abcd, e, w[4];
+        for (int i=0; i<4; i++) {
+            w[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i*)(data + 16*i)), mask);
+        }
+        for (int i=0; i<20; i++) {
+            if (i >= 4) {
+                __m128i t = _mm_sha1msg1_epu32(w[i&3], w[(i+1)&3]);
+                t = _mm_xor_si128(t, w[(i+2)&3]);
+                w[i&3] = _mm_sha1msg2_epu32(t, w[(i+3)&3]);
+            }
+            if (i == 0) e = _mm_add_epi32(e0, w[0]);
+            else        e = _mm_sha1nexte_epu32(prev, w[i&3]);
+            prev = abcd;
+            /* The round function selector must be an immediate. */
+            switch (i/5) {
+            case 0: abcd = _mm_sha1rnds4_epu32(abcd, e, 0); break;
+            case 1: abcd = _mm_sha1rnds4_epu32(abcd, e, 1); break;
+            case 2: abcd = _mm_sha1rnds4_epu32(abcd, e, 2); break;
+            default:abcd = _mm_sha1rnds4_epu32(abcd, e, 3); break;
+            }
+        }
+        e0 = _mm_sha1nexte_epu32(prev, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+        data += 64;
+    }
+
+    _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1b));
+    state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+SHA2HW_TARGET
+static void sha256_x86(uint32_t *state, const unsigned char *data, size_t n)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                        0x0405060700010203ULL);
+    __m128i t  = _mm_loadu_si128((const __m128i*)&state[0]);  /* DCBA */
+    __m128i s1 = _mm_loadu_si128((const __m128i*)&state[4]);  /* HGFE */
+    t  = _mm_shuffle_epi32(t, 0xb1);                          /* CDAB */
+    s1 = _mm_shuffle_epi32(s1, 0x1b);                         /* EFGH */
+    __m128i s0 = _mm_alignr_epi8(t, s1, 8);                   /* ABEF */
+    s1 = _mm_blend_epi16(s1, t, 0xf0);                        /* CDGH */
+
+    while (n-- > 0) {
+        __m128i s0_save = s0, s1_save = s1, w[4];
+        for (int i=0; i<4; i++) {
+            w[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i*)(data + 16*i)), mask);
+        }
+        for (int i=0; i<16; i++) {
+            if (i >= 4) {
+                __m128i u = _mm_sha256msg1_epu32(w[i&3], w[(i+1)&3]);
+                u = _mm_add_epi32(u, _mm_alignr_epi8(w[(i+3)&3],
+                                                     w[(i+2)&3], 4));
+                w[i&3] = _mm_sha256msg2_epu32(u, w[(i+3)&3]);
+            }
+            __m128i k = _mm_loadu_si128((const __m128i*)&K256[4*i]);
+            __m128i m = _mm_add_epi32(w[i&3], k);
+            s1 = _mm_sha256rnds2_epu32(s1, s0, m);
+            s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(m, 0x0e));
+        }
+        s0 = _mm_add_epi32(s0, s0_save);
+        s1 = _mm_add_epi32(s1, s1_save);
+        data += 64;
+    }
+
+    t  = _mm_shuffle_epi32(s0, 0x1b);                         /* FEBA */
+    s1 = _mm_shuffle_epi32(s1, 0xb1);                         /* DCHG */
+    s0 = _mm_blend_epi16(t, s1, 0xf0);                        /* DCBA */
+    s1 = _mm_alignr_epi8(s1, t, 8);                           /* HGFE */
+    _mm_storeu_si128((__m128i*)&state[0], s0);
+    _mm_storeu_si128((__m128i*)&state[4], s1);
+}
+
+#define SHA1_BLOCKS    sha1_x86
+#define SHA256_BLOCKS  sha256_x86
+
+#endif /* SHA2HW_X86 */
+
+/*================================================================
+ * ARMv8 cryptography extensions
+ */
+#if defined(SHA2HW_ARM)
+
+static int sha_hw_check(void)
+{
+#if defined(__linux__) && defined(HWCAP_SHA1) && defined(HWCAP_SHA2)
+    unsigned long caps = getauxval(AT_HWCAP);
+    return (caps & HWCAP_SHA1) && (caps & HWCAP_SHA2);
+#else
+    /* The compiler is told the extensions are there; trust it. */
+    return 1;
+#endif
+}
+
+static const uint32_t K1[4] = {
+    0x5a827999UL, 0x6ed9eba1UL, 0x8f1bbcdcUL, 0xca62c1d6UL
+};
+
+static void sha1_arm(uint32_t *state, const unsigned char *data, size_t n)
+{
+    uint32x4_t abcd = vld1q_u32(state);
+    uint32_t e = state[4];
+
+    while (n-- > 0) {
+        uint32x4_t abcd_save = abcd, w[4];
+        uint32_t e_save = e;
+        for (int i=0; i<4; i++) {
+            w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16*i)));
+        }
+        for (int i=0; i<20; i++) {
+            if (i >= 4) {
+                w[i&3] = vsha1su1q_u32(vsha1su0q_u32(w[i&3], w[(i+1)&3],
+                                                     w[(i+2)&3]),
+                                       w[(i+3)&3]);
+            }
+            uint32x4_t wk = vaddq_u32(w[i&3], vdupq_n_u32(K1[i/5]));
+            uint32_t e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+            switch (i/5) {
+            case 0:  abcd = vsha1cq_u32(abcd, e, wk); break;
+            case 2:  abcd = vsha1mq_u32(abcd, e, wk); break;
+            default: abcd = vsha1pq_u32(abcd, e, wk); break;
+            }
+            e = e_next;
+        }
+        abcd = vaddq_u32(abcd, abcd_save);
+        e += e_save;
+        data += 64;
+    }
+
+    vst1q_u32(state, abcd);
+    state[4] = e;
+}
+
+static void sha256_arm(uint32_t *state, const unsigned char *data, size_t n)
+{
+    uint32x4_t s0 = vld1q_u32(&state[0]);
+    uint32x4_t s1 = vld1q_u32(&state[4]);
+
+    while (n-- > 0) {
+        uint32x4_t s0_save = s0, s1_save = s1, w[4];
+        for (int i=0; i<4; i++) {
+            w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16*i)));
+        }
+        for (int i=0; i<16; i++) {
+            if (i >= 4) {
+                w[i&3] = vsha256su1q_u32(vsha256su0q_u32(w[i&3], w[(i+1)&3]),
+                                         w[(i+2)&3], w[(i+3)&3]);
+            }
+            uint32x4_t wk = vaddq_u32(w[i&3], vld1q_u32(&K256[4*i]));
+            uint32x4_t t = s0;
+            s0 = vsha256hq_u32(s0, s1, wk);
+            s1 = vsha256h2q_u32(s1, t, wk);
+        }
+        s0 = vaddq_u32(s0, s0_save);
+        s1 = vaddq_u32(s1, s1_save);
+        data += 64;
+    }
+
+    vst1q_u32(&state[0], s0);
+    vst1q_u32(&state[4], s1);
+}
+
+#define SHA1_BLOCKS    sha1_arm
+#define SHA256_BLOCKS  sha256_arm
+
+#endif /* SHA2HW_ARM */
+
+/*================================================================
+ * Entry points
+ */
+
+size_t SHA1_HW_Blocks(SHA_CTX *context, const unsigned char *data,
+                      size_t nblocks)
+{
+#if defined(SHA1_BLOCKS)
+    if (sha_hw_available < 0) sha_hw_available = sha_hw_check();
+    if (sha_hw_available && nblocks > 0) {
+        SHA1_BLOCKS((uint32_t*)context->s1.state, data, nblocks);
+        return nblocks;
+    }
+#endif
+    return 0;
+}
+
+size_t SHA256_HW_Blocks(SHA_CTX *context, const unsigned char *data,
+                        size_t nblocks)
+{
+#if defined(SHA256_BLOCKS)
+    if (sha_hw_available < 0) sha_hw_available = sha_hw_check();
+    if (sha_hw_available && nblocks > 0) {
+        SHA256_BLOCKS((uint32_t*)context->s256.state, data, nblocks);
+        return nblocks;
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * sha2hw.h - hardware-assisted SHA-1 and SHA-256 block transforms
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_SHA2HW_H
+#define GAUCHE_SHA2HW_H
+
+#include "sha2.h"
+
+/*
+ * These process NBLOCKS consecutive 64-byte blocks at DATA into the
+ * state of CONTEXT, using the CPU's SHA instructions (x86 SHA extensions
+ * or ARMv8 cryptography extensions).  The bit count and the buffer of
+ * CONTEXT are not touched.
+ *
+ * They return the number of blocks processed, which is either NBLOCKS,
+ * or 0 if the running CPU doesn't support the instructions (or the
+ * support isn't compiled in).  In the latter case the caller should
+ * fall back to the portable transform.
+ */
+size_t SHA1_HW_Blocks(SHA_CTX *context, const unsigned char *data,
+                      size_t nblocks);
+size_t SHA256_HW_Blocks(SHA_CTX *context, const unsigned char *data,
+                        size_t nblocks);
+
+#endif /* GAUCHE_SHA2HW_H */
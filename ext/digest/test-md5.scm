@@ -5,6 +5,7 @@
 (test-section "md5")
 
 (use rfc.md5)
+(use gauche.uvector)
 (test-module 'rfc.md5)
 
 (for-each
@@ -21,3 +22,14 @@
    ("d174ab98d277d9f5a5611c2c9f419d9f" "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789")
    ("57edf4a22be3c955ac49da2e2107b67a" "12345678901234567890123456789012345678901234567890123456789012345678901234567890")))
 
+
+(test* "md5 u8vector slices" "900150983cd24fb0d6963f7d28e17f72"
+       (let ([ctx (make <md5>)]
+             [vec (string->u8vector "xxabcxx")])
+         (digest-update! ctx vec 2 3)
+         (digest-update! ctx vec 3 5)
+         (digest-hexify (digest-final! ctx))))
+(test* "md5 string slice" "900150983cd24fb0d6963f7d28e17f72"
+       (let1 ctx (make <md5>)
+         (digest-update! ctx "xxabcxx" 2 5)
+         (digest-hexify (digest-final! ctx))))
@@ -7,6 +7,7 @@
 (use srfi-42)
 (use file.util)
 (use util.match)
+(use gauche.uvector)
 
 (use rfc.sha1)
 (test-module 'rfc.sha1)
@@ -99,3 +100,32 @@
 
 (for-each test-from-file (glob "data/*.info"))
 
+
+;; incremental update with uvector slices
+(let* ([src (with-output-to-string
+              (^[] (dotimes [i 1000] (write-byte (modulo (* i 7) 256)))))]
+       [vec (string->u8vector src)])
+  (define (by-slices class step)
+    (let1 ctx (make class)
+      (let loop ([i 0])
+        (when (< i (u8vector-length vec))
+          (digest-update! ctx vec i (min (+ i step) (u8vector-length vec)))
+          (loop (+ i step))))
+      (digest-hexify (digest-final! ctx))))
+  (dolist [class (list <sha1> <sha224> <sha256> <sha384> <sha512>)]
+    (let1 expected (digest-hexify (digest-string class src))
+      (dolist [step '(1 63 64 65 200)]
+        (test* #"~(class-name class) u8vector slices by ~step" expected
+               (by-slices class step)))))
+  (test* "sha256 string slice"
+         (digest-hexify (sha256-digest-string (substring src 100 300)))
+         (let1 ctx (make <sha256>)
+           (digest-update! ctx src 100 300)
+           (digest-hexify (digest-final! ctx))))
+  (test* "sha1 u32vector" (digest-hexify (sha1-digest-string src))
+         (let1 ctx (make <sha1>)
+           (digest-update! ctx (uvector-alias <u32vector> vec 0 400))
+           (digest-update! ctx vec 400)
+           (digest-hexify (digest-final! ctx))))
+  (test* "sha1 slice out of range" (test-error)
+         (digest-update! (make <sha1>) vec 0 1001)))
@@ -0,0 +1,40 @@
+;;
+;; test for rfc.xxhash module
+;;
+
+(test-section "xxhash")
+
+(use rfc.xxhash)
+(use gauche.uvector)
+(test-module 'rfc.xxhash)
+
+;; Reference values are from the reference implementations.
+(test* "xxh64 empty" #xef46db3751d8e999 (xxh64 ""))
+(test* "xxh64 abc" #x44bc2cf5ad770999 (xxh64 "abc"))
+(test* "xxh64 seed" #xbea9ca8199328908 (xxh64 "abc" 1))
+(test* "xxh3-64 empty" #x2d06800538d394c2 (xxh3-64 ""))
+(test* "xxh3-64 abc" #x78af5f94892f3950 (xxh3-64 "abc"))
+(test* "crc32c" #xe3069283 (crc32c "123456789"))
+(test* "crc32c continued" #xe3069283 (crc32c "56789" (crc32c "1234")))
+(test* "murmur3-32 empty" 0 (murmur3-32 ""))
+(test* "murmur3-32 seed" #xfaf6cdb3 (murmur3-32 "Hello, world!" 1234))
+(test* "murmur3-32 fox" #x2fa826cd
+       (murmur3-32 "The quick brown fox jumps over the lazy dog" #x9747b28c))
+
+;; All length classes of XXH3 (0-16, 17-128, 129-240, and long input)
+;; must agree between strings, u8vectors and ports.
+(let1 src (with-output-to-string
+            (^[] (dotimes [i 200000] (write-byte (modulo (* i 13) 127)))))
+  (dolist [len '(0 3 8 16 17 100 128 200 240 241 1024 1025 200000)]
+    (let* ([s (string-copy src 0 len)]
+           [v (string->u8vector s)])
+      (dolist [f (list xxh64 xxh3-64 crc32c murmur3-32)]
+        (test* #"u8vector/string/port (~len)" #t
+               (let1 h (f s)
+                 (and (= h (f v))
+                      (= h (call-with-input-string s f)))))))))
+
+(test* "seeded long xxh3-64 differs" #f
+       (let1 v (make-u8vector 1000 7)
+         (= (xxh3-64 v) (xxh3-64 v 1))))
+(test* "bad input" (test-error) (xxh64 'abc))
@@ -4,5 +4,6 @@
 (include "test-md5")
 (include "test-sha")
 (include "test-hmac")
+(include "test-xxhash")
 
 (test-end)
@@ -0,0 +1,156 @@
+;;;
+;;; xxhash.scm - fast non-cryptographic hash functions
+;;;
+;;;   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+
+;; xxHash (XXH64, XXH3), CRC32C and MurmurHash3.  These aren't for
+;; security; they're for checksums, hash tables and sharding, where
+;; the speed matters.  The C part is in fasthash.c.
+
+(define-module rfc.xxhash
+  (use gauche.uvector)
+  (export xxh64 xxh3-64 crc32c murmur3-32))
+(select-module rfc.xxhash)
+
+(define-constant *unit-len* 65536)
+
+;; Calls PROC on each chunk read from PORT.  The chunk shares the buffer.
+(define (for-each-chunk proc port)
+  (let1 buf (make-u8vector *unit-len*)
+    (let loop ()
+      (let1 n (read-uvector! buf port)
+        (unless (eof-object? n)
+          (proc (if (< n *unit-len*) (uvector-alias <u8vector> buf 0 n) buf))
+          (loop))))))
+
+(define (xxh64 data :optional (seed 0))
+  (if (input-port? data)
+    (let1 ctx (make <xxh64-context>)
+      (%xxh64-init ctx seed)
+      (for-each-chunk (cut %xxh64-update ctx <>) data)
+      (%xxh64-final ctx))
+    (%xxh64 data seed)))
+
+(define (crc32c data :optional (crc 0))
+  (if (input-port? data)
+    (rlet1 c crc
+      (for-each-chunk (^[chunk] (set! c (%crc32c chunk c))) data))
+    (%crc32c data crc)))
+
+;; XXH3 and MurmurHash3 hash the whole input at once; a port is read
+;; up to EOF first.
+(define (xxh3-64 data :optional (seed 0))
+  (%xxh3-64 (if (input-port? data) (port->uvector data) data) seed))
+
+(define (murmur3-32 data :optional (seed 0))
+  (%murmur3-32 (if (input-port? data) (port->uvector data) data) seed))
+
+;;;
+;;; Low-level bindings
+;;;
+
+(inline-stub
+ "#include <gauche/class.h>"
+ "#include \"fasthash.h\""
+
+ "#define LIBGAUCHE_EXT_BODY"
+ "#include <gauche/extern.h>  /* fix SCM_EXTERN in SCM_CLASS_DECL */"
+
+ "typedef struct ScmXXH64ContextRec {"
+ " SCM_HEADER;"
+ " ScmXXH64State st;"
+ "} ScmXXH64Context;"
+
+ (define-cclass <xxh64-context> :private
+   ScmXXH64Context* "Scm_XXH64ContextClass" ()
+   ()
+   [allocator
+    (let* ([ctx :: ScmXXH64Context* (SCM_NEW_INSTANCE ScmXXH64Context klass)])
+      (Scm_XXH64Init (& (-> ctx st)) 0)
+      (return (SCM_OBJ ctx)))])
+
+ ;; DATA may be any uvector, whose content is hashed as raw bytes in
+ ;; the native byte order, or a string.
+ (define-cfn data_element (data::ScmObj
+                           start::(const unsigned char**)
+                           siz::size_t*)
+   ::void :static
+   (cond [(SCM_UVECTORP data)
+          (set! (* start) (cast (const unsigned char*)
+                                (SCM_UVECTOR_ELEMENTS data))
+                (* siz)   (Scm_UVectorSizeInBytes (SCM_UVECTOR data)))]
+         [(SCM_STRINGP data)
+          (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY data)])
+            (set! (* start) (cast (const unsigned char*)
+                                  (SCM_STRING_BODY_START b))
+                  (* siz)   (SCM_STRING_BODY_SIZE b)))]
+         [else
+          (Scm_Error "uvector or string required, but got: %S" data)]))
+
+ (define-cproc %xxh64 (data seed::<integer>)
+   (let* ([start::(const unsigned char*)]
+          [siz::size_t])
+     (data_element data (& start) (& siz))
+     (return (Scm_MakeIntegerU64 (Scm_XXH64 start siz
+                                            (Scm_GetIntegerU64 seed))))))
+
+ (define-cproc %xxh3-64 (data seed::<integer>)
+   (let* ([start::(const unsigned char*)]
+          [siz::size_t])
+     (data_element data (& start) (& siz))
+     (return (Scm_MakeIntegerU64 (Scm_XXH3_64 start siz
+                                              (Scm_GetIntegerU64 seed))))))
+
+ (define-cproc %crc32c (data crc::<uint32>) ::<uint32>
+   (let* ([start::(const unsigned char*)]
+          [siz::size_t])
+     (data_element data (& start) (& siz))
+     (return (Scm_CRC32C crc start siz))))
+
+ (define-cproc %murmur3-32 (data seed::<uint32>) ::<uint32>
+   (let* ([start::(const unsigned char*)]
+          [siz::size_t])
+     (data_element data (& start) (& siz))
+     (return (Scm_Murmur3_32 start siz seed))))
+
+ (define-cproc %xxh64-init (ctx::<xxh64-context> seed::<integer>) ::<void>
+   (Scm_XXH64Init (& (-> ctx st)) (Scm_GetIntegerU64 seed)))
+
+ (define-cproc %xxh64-update (ctx::<xxh64-context> data) ::<void>
+   (let* ([start::(const unsigned char*)]
+          [siz::size_t])
+     (data_element data (& start) (& siz))
+     (Scm_XXH64Update (& (-> ctx st)) start siz)))
+
+ (define-cproc %xxh64-final (ctx::<xxh64-context>)
+   (return (Scm_MakeIntegerU64 (Scm_XXH64Digest (& (-> ctx st))))))
+ )
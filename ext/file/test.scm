@@ -6,6 +6,7 @@
 (use srfi-1)
 (use srfi-13)
 (use gauche.uvector)
+(use gauche.generator)
 
 (test-start "file.util")
 (use file.util)
@@ -255,6 +256,35 @@
                         '()))
        )
 
+(test* "directory-fold :parallel"
+       (n "test.out/test.d/test10.o" "test.out/test.d/test11.o"
+          "test.out/test1.o"
+          "test.out/test2.d/test10.o" "test.out/test2.d/test11.o"
+          "test.out/test2.o" "test.out/test3.o"
+          "test.out/test6.o" "test.out/test7.o")
+       (sort
+        (directory-fold "test.out"
+                        (^[path result]
+                          (if (= (file-size path) 100)
+                            (cons path result)
+                            result))
+                        '()
+                        :parallel 3)))
+
+(test* "directory-generator"
+       (reverse (directory-fold "test.out" cons '()))
+       (generator->list (directory-generator "test.out")))
+
+(test* "directory-generator :parallel"
+       (sort (directory-fold "test.out" cons '()))
+       (sort (generator->list (directory-generator "test.out" :parallel #t))))
+
+(test* "directory-generator (non-directory)" '("test.out/test1.o")
+       (generator->list (directory-generator "test.out/test1.o")))
+
+(test* "directory-fold (non-directory)" '("test.out/test1.o")
+       (directory-fold "test.out/test1.o" cons '()))
+
 (test* "directory-fold"
        (n "test.out"
           "test.out/test.d"
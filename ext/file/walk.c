@@ -0,0 +1,507 @@
+/*
+ * walk.c - directory walker for file.util
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "walk.h"
+
+#if !defined(GAUCHE_WINDOWS)
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+/* The walker reads each directory with readdir(), and uses d_type of
+ * the entries to tell directories from the others, so that it doesn't
+ * need to stat(2) every entry as the generic directory-fold does.  It
+ * falls back to stat/lstat only when d_type is unknown, or the entry is
+ * a symlink and we follow links.
+ *
+ * Only the entries of the directories being visited are kept in memory;
+ * the files found are handed to Scheme one by one.
+ *
+ * All the memory used by the walker is malloc'ed, since the worker
+ * threads of the parallel walker can't allocate in the GC heap.
+ */
+
+typedef struct dw_ent_rec {
+    char *name;
+    unsigned char type;         /* d_type, or 0 if unknown */
+} dw_ent;
+
+#if defined(DT_UNKNOWN)
+#define DW_DTYPE(d)   ((d)->d_type)
+#else
+#define DW_DTYPE(d)   0
+#endif
+
+static char *dw_join(const char *dir, const char *name)
+{
+    size_t dlen = strlen(dir), nlen = strlen(name);
+    int sep = (dlen > 0 && dir[dlen-1] != '/');
+    char *p = malloc(dlen + sep + nlen + 1);
+    if (p == NULL) return NULL;
+    memcpy(p, dir, dlen);
+    if (sep) p[dlen] = '/';
+    memcpy(p + dlen + sep, name, nlen + 1);
+    return p;
+}
+
+static int dw_ent_cmp(const void *x, const void *y)
+{
+    return strcmp(((const dw_ent*)x)->name, ((const dw_ent*)y)->name);
+}
+
+static void dw_free_ents(dw_ent *ents, int n)
+{
+    for (int i = 0; i < n; i++) free(ents[i].name);
+    free(ents);
+}
+
+/* Reads all the entries of DIR except "." and "..".  Returns 0 on
+   success, or errno. */
+static int dw_read_dir(const char *dir, int sorted, dw_ent **pents, int *pn)
+{
+    DIR *dirp = opendir(dir);
+    if (dirp == NULL) return errno;
+
+    int n = 0, size = 16, e = 0;
+    dw_ent *ents = malloc(sizeof(dw_ent) * size);
+    struct dirent *d;
+    if (ents == NULL) { closedir(dirp); return ENOMEM; }
+    for (;;) {
+        errno = 0;
+        if ((d = readdir(dirp)) == NULL) { e = errno; break; }
+        if (d->d_name[0] == '.'
+            && (d->d_name[1] == '\0'
+                || (d->d_name[1] == '.' && d->d_name[2] == '\0'))) {
+            continue;
+        }
+        if (n == size) {
+            dw_ent *ne = realloc(ents, sizeof(dw_ent) * size * 2);
+            if (ne == NULL) { e = ENOMEM; break; }
+            ents = ne;
+            size *= 2;
+        }
+        if ((ents[n].name = strdup(d->d_name)) == NULL) { e = ENOMEM; break; }
+        ents[n].type = DW_DTYPE(d);
+        n++;
+    }
+    closedir(dirp);
+    if (e != 0) { dw_free_ents(ents, n); return e; }
+    if (sorted) qsort(ents, n, sizeof(dw_ent), dw_ent_cmp);
+    *pents = ents;
+    *pn = n;
+    return 0;
+}
+
+/* Returns TRUE if PATH should be descended into. */
+static int dw_directory_p(const char *path, unsigned char type, int follow)
+{
+#if defined(DT_UNKNOWN)
+    if (type == DT_DIR) return TRUE;
+    if (type != DT_UNKNOWN && !(type == DT_LNK && follow)) return FALSE;
+#endif
+    struct stat st;
+    int r = follow ? stat(path, &st) : lstat(path, &st);
+    return (r == 0 && S_ISDIR(st.st_mode));
+}
+
+/*================================================================
+ * Sequential walker
+ *
+ *   Keeps a stack of the directories being visited, which gives the
+ *   same depth-first order as directory-fold.
+ */
+
+typedef struct dw_frame_rec {
+    struct dw_frame_rec *up;
+    char *dir;
+    dw_ent *ents;
+    int n;
+    int i;
+} dw_frame;
+
+typedef struct dw_walker_rec {
+    int follow;
+    int sorted;
+    int done;
+    dw_frame *top;              /* sequential walker */
+#if defined(GAUCHE_USE_PTHREADS)
+    struct dw_par_rec *par;     /* parallel walker */
+#endif
+} dw_walker;
+
+static void dw_pop(dw_walker *w)
+{
+    dw_frame *f = w->top;
+    w->top = f->up;
+    dw_free_ents(f->ents, f->n);
+    free(f->dir);
+    free(f);
+}
+
+/* Pushes the directory DIR, taking the ownership of it.  Returns errno
+   on failure. */
+static int dw_push(dw_walker *w, char *dir)
+{
+    dw_frame *f = malloc(sizeof(dw_frame));
+    if (f == NULL) { free(dir); return ENOMEM; }
+    int e = dw_read_dir(dir, w->sorted, &f->ents, &f->n);
+    if (e != 0) { free(dir); free(f); return e; }
+    f->dir = dir;
+    f->i = 0;
+    f->up = w->top;
+    w->top = f;
+    return 0;
+}
+
+static ScmObj dw_seq_next(dw_walker *w)
+{
+    for (;;) {
+        dw_frame *f = w->top;
+        if (f == NULL) return SCM_EOF;
+        if (f->i >= f->n) { dw_pop(w); continue; }
+        dw_ent *ent = &f->ents[f->i++];
+        char *path = dw_join(f->dir, ent->name);
+        if (path == NULL) Scm_Error("out of memory during directory walk");
+        if (dw_directory_p(path, ent->type, w->follow)) {
+            int e = dw_push(w, path);
+            if (e != 0) {
+                errno = e;
+                Scm_SysError("couldn't open directory %s",
+                             f->dir);   /* f is still valid */
+            }
+            continue;
+        }
+        ScmObj r = SCM_MAKE_STR_COPYING(path);
+        free(path);
+        return r;
+    }
+}
+
+/*================================================================
+ * Parallel walker
+ *
+ *   Worker threads take directories from DIRQ, read them, and put the
+ *   subdirectories back to DIRQ and the other entries to OUTQ.  The
+ *   Scheme thread takes the entries from OUTQ.  The workers pause while
+ *   OUTQ has more than DW_OUTQ_MAX entries, so that the entries don't
+ *   pile up when the consumer is slower.
+ */
+
+#if defined(GAUCHE_USE_PTHREADS)
+
+#define DW_OUTQ_MAX  65536
+
+typedef struct dw_node_rec {
+    struct dw_node_rec *next;
+    char *path;
+} dw_node;
+
+typedef struct dw_par_rec {
+    pthread_mutex_t mutex;
+    pthread_cond_t work;        /* DIRQ got a directory, room in OUTQ,
+                                   or shutdown */
+    pthread_cond_t out;         /* OUTQ got an entry, or walk finished */
+    dw_node *dirq;              /* LIFO, to keep the DIRQ small */
+    dw_node *outq, *outq_tail;
+    long outlen;
+    int active;                 /* # of workers reading a directory */
+    int shutdown;
+    int err;                    /* errno of the first failure */
+    char *errpath;
+    int follow;
+    int nthreads;
+    pthread_t *threads;
+} dw_par;
+
+#define DW_FINISHED_P(par) ((par)->dirq == NULL && (par)->active == 0)
+
+static void *dw_worker(void *data)
+{
+    dw_par *par = (dw_par*)data;
+    pthread_mutex_lock(&par->mutex);
+    for (;;) {
+        while (!par->shutdown
+               && (par->dirq == NULL || par->outlen > DW_OUTQ_MAX)
+               && !DW_FINISHED_P(par)) {
+            pthread_cond_wait(&par->work, &par->mutex);
+        }
+        if (par->shutdown || DW_FINISHED_P(par)) break;
+
+        dw_node *job = par->dirq;
+        par->dirq = job->next;
+        par->active++;
+        pthread_mutex_unlock(&par->mutex);
+
+        /* Read the directory without holding the lock. */
+        dw_node *dirs = NULL, *outs = NULL, *outs_tail = NULL;
+        long nouts = 0;
+        dw_ent *ents = NULL;
+        int n = 0;
+        int e = dw_read_dir(job->path, FALSE, &ents, &n);
+        for (int i = 0; e == 0 && i < n; i++) {
+            dw_node *node = malloc(sizeof(dw_node));
+            char *path = dw_join(job->path, ents[i].name);
+            if (node == NULL || path == NULL) {
+                free(node); free(path);
+                e = ENOMEM;
+                break;
+            }
+            node->path = path;
+            if (dw_directory_p(path, ents[i].type, par->follow)) {
+                node->next = dirs;
+                dirs = node;
+            } else {
+                node->next = NULL;
+                if (outs_tail) outs_tail->next = node;
+                else outs = node;
+                outs_tail = node;
+                nouts++;
+            }
+        }
+        if (ents) dw_free_ents(ents, n);
+
+        pthread_mutex_lock(&par->mutex);
+        if (e != 0 && par->err == 0) {
+            par->err = e;
+            par->errpath = job->path;
+            job->path = NULL;
+        }
+        free(job->path);
+        free(job);
+        while (dirs) {
+            dw_node *next = dirs->next;
+            dirs->next = par->dirq;
+            par->dirq = dirs;
+            dirs = next;
+        }
+        if (outs) {
+            if (par->outq_tail) par->outq_tail->next = outs;
+            else par->outq = outs;
+            par->outq_tail = outs_tail;
+            par->outlen += nouts;
+        }
+        par->active--;
+        pthread_cond_broadcast(&par->work);
+        pthread_cond_broadcast(&par->out);
+    }
+    pthread_mutex_unlock(&par->mutex);
+    return NULL;
+}
+
+static void dw_free_nodes(dw_node *n)
+{
+    while (n) {
+        dw_node *next = n->next;
+        free(n->path);
+        free(n);
+        n = next;
+    }
+}
+
+/* Stops the workers and frees everything. */
+static void dw_par_shutdown(dw_par *par)
+{
+    pthread_mutex_lock(&par->mutex);
+    par->shutdown = TRUE;
+    pthread_cond_broadcast(&par->work);
+    pthread_mutex_unlock(&par->mutex);
+    for (int i = 0; i < par->nthreads; i++) {
+        pthread_join(par->threads[i], NULL);
+    }
+    dw_free_nodes(par->dirq);
+    dw_free_nodes(par->outq);
+    free(par->errpath);
+    free(par->threads);
+    pthread_cond_destroy(&par->out);
+    pthread_cond_destroy(&par->work);
+    pthread_mutex_destroy(&par->mutex);
+    free(par);
+}
+
+static dw_par *dw_par_start(const char *root, int follow, int nthreads)
+{
+    dw_par *par = calloc(1, sizeof(dw_par));
+    dw_node *node = malloc(sizeof(dw_node));
+    pthread_t *threads = malloc(sizeof(pthread_t) * nthreads);
+    char *path = strdup(root);
+    if (!par || !node || !threads || !path) {
+        free(par); free(node); free(threads); free(path);
+        Scm_Error("out of memory during directory walk");
+    }
+    node->next = NULL;
+    node->path = path;
+    par->dirq = node;
+    par->follow = follow;
+    par->threads = threads;
+    pthread_mutex_init(&par->mutex, NULL);
+    pthread_cond_init(&par->work, NULL);
+    pthread_cond_init(&par->out, NULL);
+
+    /* Workers inherit the signal mask; they shouldn't take signals
+       meant for Scheme threads. */
+    sigset_t set, oset;
+    sigfillset(&set);
+    pthread_sigmask(SIG_SETMASK, &set, &oset);
+    for (int i = 0; i < nthreads; i++) {
+        if (pthread_create(&par->threads[i], NULL, dw_worker, par) != 0) {
+            pthread_sigmask(SIG_SETMASK, &oset, NULL);
+            par->nthreads = i;
+            dw_par_shutdown(par);
+            Scm_SysError("couldn't create a directory walker thread");
+        }
+        par->nthreads = i+1;
+    }
+    pthread_sigmask(SIG_SETMASK, &oset, NULL);
+    return par;
+}
+
+static ScmObj dw_par_next(dw_walker *w)
+{
+    dw_par *par = w->par;
+    pthread_mutex_lock(&par->mutex);
+    while (par->outq == NULL && par->err == 0 && !DW_FINISHED_P(par)) {
+        pthread_cond_wait(&par->out, &par->mutex);
+    }
+    dw_node *node = NULL;
+    if (par->err == 0 && par->outq != NULL) {
+        node = par->outq;
+        par->outq = node->next;
+        if (par->outq == NULL) par->outq_tail = NULL;
+        if (par->outlen-- == DW_OUTQ_MAX + 1) {
+            pthread_cond_broadcast(&par->work);
+        }
+    }
+    pthread_mutex_unlock(&par->mutex);
+
+    if (node) {
+        ScmObj r = SCM_MAKE_STR_COPYING(node->path);
+        free(node->path);
+        free(node);
+        return r;
+    }
+    /* Finished or failed. */
+    int err = par->err;
+    ScmObj errpath = err ? SCM_MAKE_STR_COPYING(par->errpath) : SCM_FALSE;
+    w->par = NULL;
+    w->done = TRUE;
+    dw_par_shutdown(par);
+    if (err) {
+        errno = err;
+        Scm_SysError("couldn't open directory %S", errpath);
+    }
+    return SCM_EOF;
+}
+
+#endif /*GAUCHE_USE_PTHREADS*/
+
+/*================================================================
+ * Generator interface
+ */
+
+static void dw_cleanup(dw_walker *w)
+{
+    while (w->top) dw_pop(w);
+#if defined(GAUCHE_USE_PTHREADS)
+    if (w->par) {
+        dw_par *par = w->par;
+        w->par = NULL;
+        dw_par_shutdown(par);
+    }
+#endif
+    w->done = TRUE;
+}
+
+static void dw_finalize(ScmObj obj, void *data)
+{
+    dw_cleanup((dw_walker*)SCM_SUBR_DATA(obj));
+}
+
+static ScmObj dw_next(ScmObj *args, int nargs,
+                      void *data)
+{
+    dw_walker *w = (dw_walker*)data;
+    if (w->done) return SCM_EOF;
+#if defined(GAUCHE_USE_PTHREADS)
+    if (w->par) return dw_par_next(w);
+#endif
+    ScmObj r = dw_seq_next(w);
+    if (SCM_EOFP(r)) dw_cleanup(w);
+    return r;
+}
+
+ScmObj Scm_MakeDirectoryWalker(ScmString *root, int follow_link,
+                               int sorted, int nthreads)
+{
+    const char *rootpath = Scm_GetStringConst(root);
+    dw_walker *w = SCM_NEW(dw_walker);
+    w->follow = follow_link;
+    w->sorted = sorted;
+    w->done = FALSE;
+    w->top = NULL;
+#if defined(GAUCHE_USE_PTHREADS)
+    w->par = NULL;
+    if (nthreads > 0) {
+        w->par = dw_par_start(rootpath, follow_link, nthreads);
+    } else
+#endif
+    {
+        char *dir = strdup(rootpath);
+        int e = dir ? dw_push(w, dir) : ENOMEM;
+        if (e != 0) {
+            errno = e;
+            Scm_SysError("couldn't open directory %S", root);
+        }
+    }
+    ScmObj gen = Scm_MakeSubr(dw_next, w, 0, 0,
+                              SCM_INTERN("directory-walker"));
+    Scm_RegisterFinalizer(gen, dw_finalize, NULL);
+    return gen;
+}
+
+#else  /*GAUCHE_WINDOWS*/
+
+ScmObj Scm_MakeDirectoryWalker(ScmString *root,
+                               int follow_link,
+                               int sorted,
+                               int nthreads)
+{
+    return SCM_FALSE;
+}
+
+#endif /*GAUCHE_WINDOWS*/
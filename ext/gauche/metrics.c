@@ -0,0 +1,671 @@
+/*
+ * metrics.c - Metrics registry
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "metrics.h"
+#include "atomic_ops.h"
+#include <math.h>
+#include <string.h>
+
+/*
+ * Cells
+ *
+ *   Counters have SCM_METRIC_NSHARDS cells, each on its own cache line.
+ *   A gauge has just one, since the value set by metric-set! must
+ *   replace the whole.  A histogram shard has the running sum of
+ *   the observed values followed by the bucket counts.
+ */
+
+#define CACHE_LINE  64
+
+typedef struct cell_rec {
+    AO_t v;
+    char pad[CACHE_LINE - sizeof(AO_t)];
+} cell;
+
+typedef struct hist_shard_rec {
+    AO_t sum;
+    AO_t counts[SCM_METRIC_NBUCKETS];
+    char pad[CACHE_LINE];
+} hist_shard;
+
+#define SUB_COUNT  (1<<SCM_METRIC_SUB_BITS)
+
+static inline int shard_index(int nshards)
+{
+    return (int)(Scm_VM()->vmid % nshards);
+}
+
+static inline int highest_bit(ScmUInt64 v) /* v != 0 */
+{
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(v);
+#else
+    int n = 0;
+    while (v >>= 1) n++;
+    return n;
+#endif
+}
+
+/* The bucket of V.  Bucket 0 is for 0; for the others, we classify V-1,
+   so that each bucket holds the values in (lower, upper] and the powers
+   of two are always bucket boundaries.  That makes the cumulative
+   counts at the exported bounds exact. */
+static inline int bucket_of(ScmUInt64 v)
+{
+    if (v == 0) return 0;
+    v--;
+    if (v < SUB_COUNT) return (int)v + 1;
+    int e = highest_bit(v);
+    return 1 + ((e - SCM_METRIC_SUB_BITS + 1) << SCM_METRIC_SUB_BITS)
+        + (int)((v >> (e - SCM_METRIC_SUB_BITS)) & (SUB_COUNT-1));
+}
+
+/* The largest value that falls in bucket K, as a Scheme integer. */
+static ScmObj bucket_upper(int k)
+{
+    if (k <= SUB_COUNT) return SCM_MAKE_INT(k);
+    int g = (k-1) >> SCM_METRIC_SUB_BITS;
+    int s = (k-1) & (SUB_COUNT-1);
+    return Scm_Ash(SCM_MAKE_INT(SUB_COUNT + s + 1), g - 1);
+}
+
+/*
+ * Metric object
+ */
+
+static ScmObj sym_counter, sym_gauge, sym_histogram;
+
+static ScmObj kind_symbol(int kind)
+{
+    switch (kind) {
+    case SCM_METRIC_COUNTER: return sym_counter;
+    case SCM_METRIC_GAUGE:   return sym_gauge;
+    default:                 return sym_histogram;
+    }
+}
+
+static void metric_print(ScmObj obj, ScmPort *port,
+                         ScmWriteContext *ctx)
+{
+    ScmMetric *m = SCM_METRIC(obj);
+    Scm_Printf(port, "#<metric %A %A", kind_symbol(m->kind), m->name);
+    if (SCM_STRING_LENGTH(m->labelText) > 0) {
+        Scm_Printf(port, "{%A}", m->labelText);
+    }
+    Scm_Printf(port, ">");
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_MetricClass, metric_print);
+
+/*
+ * Validation and rendering
+ */
+
+static int valid_name_p(ScmObj name, int colon_ok)
+{
+    unsigned int size;
+    const char *s = Scm_GetStringContent(SCM_STRING(name), &size, NULL, NULL);
+    if (size == 0) return FALSE;
+    for (unsigned int i=0; i<size; i++) {
+        int c = (unsigned char)s[i];
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'
+            || (c == ':' && colon_ok)) continue;
+        if (c >= '0' && c <= '9' && i > 0) continue;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Escapes backslashes and newlines, and double quotes if QUOTE is true,
+   as the exposition format requires. */
+static ScmObj escape_text(ScmObj str, int quote)
+{
+    unsigned int size;
+    const char *s = Scm_GetStringContent(SCM_STRING(str), &size, NULL, NULL);
+    const char *run = s;
+    ScmDString ds;
+    Scm_DStringInit(&ds);
+    for (unsigned int i=0; i<size; i++) {
+        const char *esc = NULL;
+        switch (s[i]) {
+        case '\\': esc = "\\\\"; break;
+        case '\n': esc = "\\n"; break;
+        case '"':  if (quote) esc = "\\\""; break;
+        }
+        if (esc) {
+            Scm_DStringPutz(&ds, run, s + i - run);
+            Scm_DStringPutz(&ds, esc, -1);
+            run = s + i + 1;
+        }
+    }
+    Scm_DStringPutz(&ds, run, s + size - run);
+    return Scm_DStringGet(&ds, 0);
+}
+
+static ScmObj render_labels(ScmObj labels, int kind)
+{
+    ScmObj cp;
+    ScmDString ds;
+    Scm_DStringInit(&ds);
+    SCM_FOR_EACH(cp, labels) {
+        ScmObj p = SCM_CAR(cp);
+        if (!SCM_PAIRP(p) || !SCM_STRINGP(SCM_CAR(p))
+            || !SCM_STRINGP(SCM_CDR(p))) {
+            Scm_Error("metric label must be a pair of strings, but got: %S", p);
+        }
+        ScmObj k = SCM_CAR(p);
+        const char *ks = Scm_GetStringConst(SCM_STRING(k));
+        if (!valid_name_p(k, FALSE) || strncmp(ks, "__", 2) == 0) {
+            Scm_Error("invalid metric label name: %S", k);
+        }
+        if (kind == SCM_METRIC_HISTOGRAM && strcmp(ks, "le") == 0) {
+            Scm_Error("label name \"le\" can't be used for a histogram");
+        }
+        if (cp != labels) Scm_DStringPutc(&ds, ',');
+        Scm_DStringPutz(&ds, ks, -1);
+        Scm_DStringPutz(&ds, "=\"", 2);
+        Scm_DStringAdd(&ds, SCM_STRING(escape_text(SCM_CDR(p), TRUE)));
+        Scm_DStringPutc(&ds, '"');
+    }
+    return Scm_DStringGet(&ds, 0);
+}
+
+/*
+ * Registry
+ *
+ *   The registry list is never modified in place; it is replaced
+ *   with a new list under the lock, so the exporter can walk a snapshot
+ *   without holding the lock while it calls getters.  Metrics with the
+ *   same name are kept adjacent, for they share HELP and TYPE lines.
+ */
+
+static struct {
+    ScmObj metrics;
+    ScmInternalMutex mutex;
+} registry;
+
+static ScmObj registry_snapshot(void)
+{
+    ScmObj r;
+    SCM_INTERNAL_MUTEX_LOCK(registry.mutex);
+    r = registry.metrics;
+    SCM_INTERNAL_MUTEX_UNLOCK(registry.mutex);
+    return r;
+}
+
+static ScmMetric *make_metric(int kind, ScmObj name, ScmObj help,
+                              ScmObj labels, ScmObj getter,
+                              ScmObj (*cgetter)(void),
+                              ScmUInt64 maxValue, ScmObj scale)
+{
+    ScmMetric *m = SCM_NEW(ScmMetric);
+    SCM_SET_CLASS(m, &Scm_MetricClass);
+    m->kind = kind;
+    m->name = name;
+    m->help = help;
+    m->labels = labels;
+    m->labelText = render_labels(labels, kind);
+    m->getter = getter;
+    m->cgetter = cgetter;
+    m->cells = NULL;
+    m->maxBits = 0;
+    m->scale = scale;
+
+    if (SCM_FALSEP(getter) && cgetter == NULL) {
+        switch (kind) {
+        case SCM_METRIC_COUNTER:
+            m->cells = SCM_NEW_ATOMIC2(cell*,
+                                       sizeof(cell)*SCM_METRIC_NSHARDS);
+            memset(m->cells, 0, sizeof(cell)*SCM_METRIC_NSHARDS);
+            break;
+        case SCM_METRIC_GAUGE:
+            m->cells = SCM_NEW_ATOMIC(cell);
+            memset(m->cells, 0, sizeof(cell));
+            break;
+        case SCM_METRIC_HISTOGRAM:
+            m->cells = SCM_NEW_ATOMIC2(hist_shard*,
+                                       sizeof(hist_shard)*SCM_METRIC_HIST_NSHARDS);
+            memset(m->cells, 0, sizeof(hist_shard)*SCM_METRIC_HIST_NSHARDS);
+            break;
+        }
+    }
+    if (kind == SCM_METRIC_HISTOGRAM) {
+        if (maxValue < 1) maxValue = 1;
+        int b = highest_bit(maxValue);
+        if (maxValue & (maxValue-1)) b++; /* round up */
+        m->maxBits = b;
+    }
+    return m;
+}
+
+static ScmObj register_metric(ScmMetric *m)
+{
+    ScmObj cp, h = SCM_NIL, t = SCM_NIL, last = SCM_FALSE;
+    ScmMetric *found = NULL;
+
+    SCM_INTERNAL_MUTEX_LOCK(registry.mutex);
+    SCM_FOR_EACH(cp, registry.metrics) {
+        ScmMetric *e = SCM_METRIC(SCM_CAR(cp));
+        if (!Scm_StringEqual(SCM_STRING(e->name), SCM_STRING(m->name)))
+            continue;
+        last = cp;
+        if (e->kind != m->kind
+            || Scm_StringEqual(SCM_STRING(e->labelText),
+                               SCM_STRING(m->labelText))) {
+            found = e;
+            break;
+        }
+    }
+    if (found == NULL) {
+        SCM_FOR_EACH(cp, registry.metrics) {
+            SCM_APPEND1(h, t, SCM_CAR(cp));
+            if (cp == last) SCM_APPEND1(h, t, SCM_OBJ(m));
+        }
+        if (SCM_FALSEP(last)) SCM_APPEND1(h, t, SCM_OBJ(m));
+        registry.metrics = h;
+    }
+    SCM_INTERNAL_MUTEX_UNLOCK(registry.mutex);
+
+    if (found == NULL) return SCM_OBJ(m);
+    if (found->kind != m->kind) {
+        Scm_Error("metric %A is already registered as a %S",
+                  m->name, kind_symbol(found->kind));
+    }
+    return SCM_OBJ(found);
+}
+
+ScmObj Scm_MakeMetric(int kind, ScmObj name, ScmObj help, ScmObj labels,
+                      ScmObj getter, ScmUInt64 maxValue, ScmObj scale)
+{
+    if (!SCM_STRINGP(name) || !valid_name_p(name, TRUE)) {
+        Scm_Error("invalid metric name: %S", name);
+    }
+    if (!SCM_STRINGP(help)) {
+        Scm_Error("string required for metric help, but got: %S", help);
+    }
+    if (!SCM_FALSEP(getter) && kind == SCM_METRIC_HISTOGRAM) {
+        Scm_Error("a histogram can't have a getter: %S", name);
+    }
+    if (!SCM_REALP(scale)) {
+        Scm_Error("real number required for metric scale, but got: %S", scale);
+    }
+    return register_metric(make_metric(kind, name, help, labels, getter,
+                                       NULL, maxValue, scale));
+}
+
+void Scm_MetricUnregister(ScmMetric *m)
+{
+    SCM_INTERNAL_MUTEX_LOCK(registry.mutex);
+    registry.metrics = Scm_Delete(SCM_OBJ(m), registry.metrics, SCM_CMP_EQ);
+    SCM_INTERNAL_MUTEX_UNLOCK(registry.mutex);
+}
+
+ScmObj Scm_AllMetrics(void)
+{
+    return registry_snapshot();
+}
+
+/*
+ * Recording
+ */
+
+static void check_recordable(ScmMetric *m, int kind, const char *op)
+{
+    if (m->kind != kind || m->cells == NULL) {
+        Scm_Error("can't %s metric: %S", op, SCM_OBJ(m));
+    }
+}
+
+void Scm_MetricAdd(ScmMetric *m, long delta)
+{
+    if (m->kind == SCM_METRIC_COUNTER) {
+        check_recordable(m, SCM_METRIC_COUNTER, "increment");
+        if (delta < 0) {
+            Scm_Error("counter can't be decremented: %S", SCM_OBJ(m));
+        }
+        cell *c = (cell*)m->cells + shard_index(SCM_METRIC_NSHARDS);
+        AO_fetch_and_add(&c->v, (AO_t)delta);
+    } else {
+        check_recordable(m, SCM_METRIC_GAUGE, "increment");
+        AO_fetch_and_add(&((cell*)m->cells)->v, (AO_t)delta);
+    }
+}
+
+void Scm_MetricSet(ScmMetric *m, long value)
+{
+    check_recordable(m, SCM_METRIC_GAUGE, "set");
+    AO_store(&((cell*)m->cells)->v, (AO_t)value);
+}
+
+void Scm_MetricObserve(ScmMetric *m, ScmUInt64 value)
+{
+    check_recordable(m, SCM_METRIC_HISTOGRAM, "observe");
+    hist_shard *s = (hist_shard*)m->cells
+        + shard_index(SCM_METRIC_HIST_NSHARDS);
+    AO_fetch_and_add1(&s->counts[bucket_of(value)]);
+    AO_fetch_and_add(&s->sum, (AO_t)value);
+}
+
+/*
+ * Reading
+ */
+
+static ScmUInt64 hist_totals(ScmMetric *m, ScmUInt64 *counts)
+{
+    ScmUInt64 sum = 0;
+    memset(counts, 0, sizeof(ScmUInt64)*SCM_METRIC_NBUCKETS);
+    for (int i=0; i<SCM_METRIC_HIST_NSHARDS; i++) {
+        hist_shard *s = (hist_shard*)m->cells + i;
+        for (int k=0; k<SCM_METRIC_NBUCKETS; k++) {
+            counts[k] += AO_load(&s->counts[k]);
+        }
+        sum += AO_load(&s->sum);
+    }
+    return sum;
+}
+
+/* (count sum ((le . cumulative-count) ...)), where the last le is
+   +inf.0.  The sum and the bounds are multiplied by the scale. */
+static ScmObj hist_value(ScmMetric *m)
+{
+    ScmUInt64 counts[SCM_METRIC_NBUCKETS];
+    ScmUInt64 sum = hist_totals(m, counts), cum = 0;
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    int k = 0;
+    for (int b=0; b<=m->maxBits; b++) {
+        int last = bucket_of((ScmUInt64)1 << b);
+        for (; k<=last; k++) cum += counts[k];
+        SCM_APPEND1(h, t, Scm_Cons(Scm_Mul(Scm_Ash(SCM_MAKE_INT(1), b),
+                                           m->scale),
+                                   Scm_MakeIntegerU64(cum)));
+    }
+    for (; k<SCM_METRIC_NBUCKETS; k++) cum += counts[k];
+    SCM_APPEND1(h, t, Scm_Cons(Scm_MakeFlonum(SCM_DBL_POSITIVE_INFINITY),
+                               Scm_MakeIntegerU64(cum)));
+    return SCM_LIST3(Scm_MakeIntegerU64(cum),
+                     Scm_Mul(Scm_MakeIntegerU64(sum), m->scale),
+                     h);
+}
+
+ScmObj Scm_MetricValue(ScmMetric *m)
+{
+    if (!SCM_FALSEP(m->getter)) return Scm_ApplyRec0(m->getter);
+    if (m->cgetter) return m->cgetter();
+
+    switch (m->kind) {
+    case SCM_METRIC_COUNTER: {
+        ScmUInt64 v = 0;
+        for (int i=0; i<SCM_METRIC_NSHARDS; i++) {
+            v += AO_load(&((cell*)m->cells)[i].v);
+        }
+        return Scm_MakeIntegerU64(v);
+    }
+    case SCM_METRIC_GAUGE:
+        return Scm_MakeInteger((long)AO_load(&((cell*)m->cells)->v));
+    default:
+        return hist_value(m);
+    }
+}
+
+/* Estimates the Q-quantile (0 <= Q <= 1) of the observed values from
+   the fine-grained buckets.  Returns the upper bound of the bucket
+   the quantile falls in, multiplied by the scale, or #f if nothing
+   has been observed. */
+ScmObj Scm_MetricQuantile(ScmMetric *m, double q)
+{
+    check_recordable(m, SCM_METRIC_HISTOGRAM, "take quantile of");
+    if (q < 0.0 || q > 1.0) {
+        Scm_Error("quantile must be between 0 and 1, but got: %S",
+                  Scm_MakeFlonum(q));
+    }
+    ScmUInt64 counts[SCM_METRIC_NBUCKETS], total = 0, cum = 0;
+    (void)hist_totals(m, counts);
+    for (int k=0; k<SCM_METRIC_NBUCKETS; k++) total += counts[k];
+    if (total == 0) return SCM_FALSE;
+
+    ScmUInt64 rank = (ScmUInt64)ceil(q * (double)total);
+    if (rank == 0) rank = 1;
+    for (int k=0; k<SCM_METRIC_NBUCKETS; k++) {
+        cum += counts[k];
+        if (cum >= rank) return Scm_Mul(bucket_upper(k), m->scale);
+    }
+    return Scm_Mul(bucket_upper(SCM_METRIC_NBUCKETS-1), m->scale); /* NOTREACHED */
+}
+
+/*
+ * Text exposition
+ */
+
+static void write_number(ScmObj v, ScmPort *port)
+{
+    if (SCM_INTEGERP(v)) {
+        Scm_Printf(port, "%S", v);
+    } else if (SCM_REALP(v)) {
+        double d = Scm_GetDouble(v);
+        if (isnan(d))      Scm_Putz("NaN", -1, port);
+        else if (isinf(d)) Scm_Putz(d > 0 ? "+Inf" : "-Inf", -1, port);
+        else               Scm_Printf(port, "%S", Scm_MakeFlonum(d));
+    } else {
+        Scm_Error("metric value must be a real number, but got: %S", v);
+    }
+}
+
+static void write_sample(ScmMetric *m, const char *suffix, ScmObj le,
+                         ScmObj v, ScmPort *port)
+{
+    int nlabels = SCM_STRING_LENGTH(m->labelText) > 0;
+    Scm_Printf(port, "%A%s", m->name, suffix);
+    if (nlabels || !SCM_FALSEP(le)) {
+        Scm_Putc('{', port);
+        if (nlabels) Scm_Printf(port, "%A", m->labelText);
+        if (!SCM_FALSEP(le)) {
+            Scm_Putz(nlabels ? ",le=\"" : "le=\"", -1, port);
+            write_number(le, port);
+            Scm_Putc('"', port);
+        }
+        Scm_Putc('}', port);
+    }
+    Scm_Putc(' ', port);
+    write_number(v, port);
+    Scm_Putc('\n', port);
+}
+
+static void write_metric(ScmMetric *m, ScmPort *port)
+{
+    ScmObj v = Scm_MetricValue(m);
+    if (m->kind != SCM_METRIC_HISTOGRAM) {
+        write_sample(m, "", SCM_FALSE, v, port);
+        return;
+    }
+    if (Scm_Length(v) != 3) {
+        Scm_Error("bad histogram value of %S: %S", SCM_OBJ(m), v);
+    }
+    ScmObj cp;
+    SCM_FOR_EACH(cp, SCM_CAR(SCM_CDDR(v))) {
+        ScmObj p = SCM_CAR(cp);
+        if (!SCM_PAIRP(p)) {
+            Scm_Error("bad histogram value of %S: %S", SCM_OBJ(m), v);
+        }
+        write_sample(m, "_bucket", SCM_CAR(p), SCM_CDR(p), port);
+    }
+    write_sample(m, "_sum", SCM_FALSE, SCM_CADR(v), port);
+    write_sample(m, "_count", SCM_FALSE, SCM_CAR(v), port);
+}
+
+void Scm_WriteMetricsText(ScmPort *port)
+{
+    ScmObj cp, prev = SCM_FALSE;
+    SCM_FOR_EACH(cp, registry_snapshot()) {
+        ScmMetric *m = SCM_METRIC(SCM_CAR(cp));
+        if (!SCM_STRINGP(prev)
+            || !Scm_StringEqual(SCM_STRING(prev), SCM_STRING(m->name))) {
+            if (SCM_STRING_LENGTH(m->help) > 0) {
+                Scm_Printf(port, "# HELP %A %A\n", m->name,
+                           escape_text(m->help, FALSE));
+            }
+            Scm_Printf(port, "# TYPE %A %S\n", m->name,
+                       kind_symbol(m->kind));
+            prev = m->name;
+        }
+        write_metric(m, port);
+    }
+}
+
+/*
+ * Runtime metrics
+ */
+
+static ScmObj gc_event_stat_ref(const char *key)
+{
+    ScmObj cp, k = SCM_MAKE_KEYWORD(key);
+    SCM_FOR_EACH(cp, Scm_GCEventStat()) {
+        if (SCM_EQ(SCM_CAAR(cp), k)) return SCM_CADR(SCM_CAR(cp));
+    }
+    return SCM_MAKE_INT(0);
+}
+
+static ScmObj us_to_sec(ScmObj us)
+{
+    return Scm_MakeFlonum(Scm_GetDouble(us) / 1.0e6);
+}
+
+static ScmObj rt_gc_count(void)
+{
+    return gc_event_stat_ref("gc-count");
+}
+
+static ScmObj rt_gc_pause_total(void)
+{
+    return us_to_sec(gc_event_stat_ref("total-pause-time"));
+}
+
+static ScmObj rt_gc_pause_max(void)
+{
+    return us_to_sec(gc_event_stat_ref("max-pause-time"));
+}
+
+static ScmObj rt_gc_heap(void)
+{
+    return Scm_MakeIntegerU((u_long)GC_get_heap_size());
+}
+
+static ScmObj rt_gc_free(void)
+{
+    return Scm_MakeIntegerU((u_long)GC_get_free_bytes());
+}
+
+static ScmObj rt_gc_allocated(void)
+{
+    return Scm_MakeIntegerU((u_long)GC_get_total_bytes());
+}
+
+/* Scm_GCPauseHistogram gives non-cumulative counts with the bounds
+   in microseconds. */
+static ScmObj rt_gc_pause_histogram(void)
+{
+    ScmObj cp, h = SCM_NIL, t = SCM_NIL, cum = SCM_MAKE_INT(0);
+    SCM_FOR_EACH(cp, Scm_GCPauseHistogram()) {
+        cum = Scm_Add(cum, SCM_CDAR(cp));
+        SCM_APPEND1(h, t, Scm_Cons(us_to_sec(SCM_CAAR(cp)), cum));
+    }
+    return SCM_LIST3(cum, rt_gc_pause_total(), h);
+}
+
+static ScmObj rt_vm_sov(void)
+{
+    u_long sov;
+    Scm_VMRuntimeStats(NULL, &sov, NULL);
+    return Scm_MakeIntegerU(sov);
+}
+
+static ScmObj rt_threads(void)
+{
+    u_long n;
+    Scm_VMRuntimeStats(&n, NULL, NULL);
+    return Scm_MakeIntegerU(n);
+}
+
+static ScmObj rt_profiler_samples(void)
+{
+    u_long n;
+    Scm_VMRuntimeStats(NULL, NULL, &n);
+    return Scm_MakeIntegerU(n);
+}
+
+static void register_runtime(int kind, const char *name, const char *help,
+                             ScmObj (*getter)(void))
+{
+    register_metric(make_metric(kind, SCM_MAKE_STR_IMMUTABLE(name),
+                                SCM_MAKE_STR_IMMUTABLE(help), SCM_NIL,
+                                SCM_FALSE, getter, 1, SCM_MAKE_INT(1)));
+}
+
+static void register_runtime_metrics(void)
+{
+    register_runtime(SCM_METRIC_COUNTER, "gauche_gc_collections_total",
+                     "Number of garbage collections.", rt_gc_count);
+    register_runtime(SCM_METRIC_COUNTER, "gauche_gc_pause_seconds_total",
+                     "Total time spent in garbage collection.",
+                     rt_gc_pause_total);
+    register_runtime(SCM_METRIC_GAUGE, "gauche_gc_pause_max_seconds",
+                     "Longest garbage collection pause.", rt_gc_pause_max);
+    register_runtime(SCM_METRIC_HISTOGRAM, "gauche_gc_pause_seconds",
+                     "Garbage collection pause time.",
+                     rt_gc_pause_histogram);
+    register_runtime(SCM_METRIC_GAUGE, "gauche_gc_heap_bytes",
+                     "Size of the GC heap.", rt_gc_heap);
+    register_runtime(SCM_METRIC_GAUGE, "gauche_gc_free_bytes",
+                     "Free bytes in the GC heap.", rt_gc_free);
+    register_runtime(SCM_METRIC_COUNTER, "gauche_gc_allocated_bytes_total",
+                     "Total bytes allocated.", rt_gc_allocated);
+    register_runtime(SCM_METRIC_COUNTER, "gauche_vm_stack_overflows_total",
+                     "Number of VM stack overflows.", rt_vm_sov);
+    register_runtime(SCM_METRIC_GAUGE, "gauche_threads",
+                     "Number of threads running Scheme, including the main thread.",
+                     rt_threads);
+    register_runtime(SCM_METRIC_GAUGE, "gauche_profiler_samples",
+                     "Samples taken by the running profilers.",
+                     rt_profiler_samples);
+}
+
+void Scm_Init_metrics(void)
+{
+    ScmModule *mod = SCM_FIND_MODULE("gauche.metrics", SCM_FIND_MODULE_CREATE);
+    Scm_InitStaticClass(&Scm_MetricClass, "<metric>", mod, NULL, 0);
+    registry.metrics = SCM_NIL;
+    (void)SCM_INTERNAL_MUTEX_INIT(registry.mutex);
+    sym_counter   = SCM_INTERN("counter");
+    sym_gauge     = SCM_INTERN("gauge");
+    sym_histogram = SCM_INTERN("histogram");
+    register_runtime_metrics();
+}
@@ -0,0 +1,116 @@
+/*
+ * metrics.h - Metrics registry
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_METRICS_H
+#define GAUCHE_METRICS_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+
+#if defined(EXTGAUCHE_EXPORTS)
+#define LIBGAUCHE_EXT_BODY
+#endif
+#include <gauche/extern.h>      /* redefine SCM_EXTERN */
+
+/*
+ * Metrics
+ *
+ *   A metric is a counter, a gauge or a histogram, identified by its
+ *   name and a set of labels.  Recording doesn't take a lock; counters
+ *   and histograms are split into shards chosen by the VM id, and each
+ *   shard is updated by an atomic add, so threads hitting the same
+ *   metric rarely touch the same cache line.  Shards are summed when
+ *   the value is read.
+ *
+ *   Histograms take non-negative integers (typically nanoseconds) and
+ *   count them in log-linear buckets as in HdrHistogram: each power of
+ *   two range is divided into 2^SCM_METRIC_SUB_BITS buckets, so the
+ *   relative error is at most 1/8.  The exported buckets are at the
+ *   powers of two up to maxValue, multiplied by scale.
+ *
+ *   A metric may have a getter instead, which is called to get the value
+ *   when the metric is read.  Runtime metrics are defined this way.
+ */
+
+enum {
+    SCM_METRIC_COUNTER,
+    SCM_METRIC_GAUGE,
+    SCM_METRIC_HISTOGRAM
+};
+
+#define SCM_METRIC_SUB_BITS     3
+#define SCM_METRIC_NBUCKETS     (((64-SCM_METRIC_SUB_BITS+1)<<SCM_METRIC_SUB_BITS)+1)
+#define SCM_METRIC_NSHARDS      16
+#define SCM_METRIC_HIST_NSHARDS 4
+
+typedef struct ScmMetricRec {
+    SCM_HEADER;
+    int kind;
+    ScmObj name;                /* string */
+    ScmObj help;                /* string */
+    ScmObj labels;              /* ((name . value) ...), both strings */
+    ScmObj labelText;           /* rendered labels, e.g. a="x",b="y" */
+    ScmObj getter;              /* thunk, or #f */
+    ScmObj (*cgetter)(void);    /* used by the runtime metrics */
+    void *cells;                /* counter/gauge cells, or histogram shards */
+    int maxBits;                /* histogram: the last exported bound is
+                                   2^maxBits */
+    ScmObj scale;               /* histogram: multiplier for export */
+} ScmMetric;
+
+SCM_CLASS_DECL(Scm_MetricClass);
+#define SCM_METRIC(obj)     ((ScmMetric*)obj)
+#define SCM_METRICP(obj)    SCM_XTYPEP(obj, &Scm_MetricClass)
+
+/* Creates and registers a metric.  If a metric with the same name and
+   labels is already registered, it is returned if it is of the same
+   kind; otherwise an error is signaled.  MAXVALUE and SCALE are only
+   used for histograms. */
+SCM_EXTERN ScmObj Scm_MakeMetric(int kind, ScmObj name, ScmObj help,
+                                 ScmObj labels, ScmObj getter,
+                                 ScmUInt64 maxValue, ScmObj scale);
+SCM_EXTERN void   Scm_MetricUnregister(ScmMetric *m);
+SCM_EXTERN ScmObj Scm_AllMetrics(void);
+
+SCM_EXTERN void   Scm_MetricAdd(ScmMetric *m, long delta);
+SCM_EXTERN void   Scm_MetricSet(ScmMetric *m, long value);
+SCM_EXTERN void   Scm_MetricObserve(ScmMetric *m, ScmUInt64 value);
+SCM_EXTERN ScmObj Scm_MetricValue(ScmMetric *m);
+SCM_EXTERN ScmObj Scm_MetricQuantile(ScmMetric *m, double q);
+
+/* Writes all registered metrics in Prometheus text exposition format. */
+SCM_EXTERN void   Scm_WriteMetricsText(ScmPort *port);
+
+SCM_EXTERN void   Scm_Init_metrics(void);
+
+#endif /*GAUCHE_METRICS_H*/
@@ -0,0 +1,129 @@
+;;;
+;;; gauche.metrics - metrics registry
+;;;
+;;;
+;;;   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; Counters, gauges and histograms that can be updated from any thread
+;; without locking, and an exporter in the Prometheus text exposition
+;; format.  Runtime metrics (GC, VM and threads) are registered when
+;; this module is loaded.  The core is in metrics.c.
+
+(define-module gauche.metrics
+  (export <metric> metric? make-metric-counter make-metric-gauge
+          make-metric-histogram metric-name metric-kind metric-labels
+          metric-inc! metric-dec! metric-set! metric-observe!
+          with-metric-timer metric-value metric-quantile
+          metric-unregister! all-metrics write-metrics-text metrics-text))
+(select-module gauche.metrics)
+
+(inline-stub
+ (declcode "#include \"metrics.h\"")
+ (initcode (Scm_Init_metrics))
+
+ (define-type <metric> "ScmMetric*")
+
+ (define-enum SCM_METRIC_COUNTER)
+ (define-enum SCM_METRIC_GAUGE)
+ (define-enum SCM_METRIC_HISTOGRAM)
+
+ (define-cproc metric? (obj) ::<boolean> SCM_METRICP)
+
+ (define-cproc %make-metric (kind::<int> name help labels getter
+                             max-value scale)
+   (return (Scm_MakeMetric kind name help labels getter
+                           (Scm_GetIntegerU64 max-value) scale)))
+
+ (define-cproc metric-name (m::<metric>) (return (-> m name)))
+ (define-cproc metric-labels (m::<metric>) (return (-> m labels)))
+ (define-cproc metric-kind (m::<metric>)
+   (case (-> m kind)
+     [(SCM_METRIC_COUNTER) (return 'counter)]
+     [(SCM_METRIC_GAUGE)   (return 'gauge)]
+     [else                 (return 'histogram)]))
+
+ (define-cproc metric-inc! (m::<metric> :optional (n::<long> 1)) ::<void>
+   Scm_MetricAdd)
+ (define-cproc metric-dec! (m::<metric> :optional (n::<long> 1)) ::<void>
+   (when (== (-> m kind) SCM_METRIC_COUNTER)
+     (Scm_Error "counter can't be decremented: %S" m))
+   (Scm_MetricAdd m (- n)))
+ (define-cproc metric-set! (m::<metric> v::<long>) ::<void>
+   Scm_MetricSet)
+ (define-cproc metric-observe! (m::<metric> v) ::<void>
+   (if (and (SCM_INTP v) (>= (SCM_INT_VALUE v) 0))
+     (Scm_MetricObserve m (SCM_INT_VALUE v))
+     (Scm_MetricObserve m (Scm_GetIntegerU64Clamp v SCM_CLAMP_HI NULL))))
+
+ (define-cproc metric-value (m::<metric>) Scm_MetricValue)
+ (define-cproc metric-quantile (m::<metric> q::<double>) Scm_MetricQuantile)
+
+ (define-cproc metric-unregister! (m::<metric>) ::<void>
+   Scm_MetricUnregister)
+ (define-cproc all-metrics () Scm_AllMetrics)
+
+ (define-cproc write-metrics-text (:optional (port::<output-port>
+                                              (current-output-port)))
+   ::<void> Scm_WriteMetricsText)
+ )
+
+;; Labels are given as an alist; keys can be symbols, keywords or
+;; strings, and values are converted with x->string.  We sort them
+;; by key so that the same set of labels always names the same metric.
+(define (%canonical-labels labels)
+  (define (key->string k)
+    (if (keyword? k) (keyword->string k) (x->string k)))
+  (sort (map (^p (cons (key->string (car p)) (x->string (cdr p)))) labels)
+        (^[a b] (string<? (car a) (car b)))))
+
+(define (make-metric-counter name :key (help "") (labels '()) (getter #f))
+  (%make-metric SCM_METRIC_COUNTER name help (%canonical-labels labels)
+                getter 1 1))
+
+(define (make-metric-gauge name :key (help "") (labels '()) (getter #f))
+  (%make-metric SCM_METRIC_GAUGE name help (%canonical-labels labels)
+                getter 1 1))
+
+(define (make-metric-histogram name :key (help "") (labels '())
+                               (max-value (expt 2 32)) (scale 1))
+  (%make-metric SCM_METRIC_HISTOGRAM name help (%canonical-labels labels)
+                #f max-value scale))
+
+;; Observes the elapsed time of BODY in nanoseconds.
+(define-syntax with-metric-timer
+  (syntax-rules ()
+    [(_ m body ...)
+     (let ([t0 (monotonic-ns)])
+       (unwind-protect (begin body ...)
+         (metric-observe! m (- (monotonic-ns) t0))))]))
+
+(define (metrics-text)
+  (call-with-output-string write-metrics-text))
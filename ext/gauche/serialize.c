@@ -0,0 +1,624 @@
+/*
+ * serialize.c - Binary serialization of Scheme data
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "serialize.h"
+#include <gauche/bignum.h>
+#include <string.h>
+
+#define SERIALIZE_VERSION  1
+
+enum {
+    TAG_NIL       = 0x00,
+    TAG_FALSE     = 0x01,
+    TAG_TRUE      = 0x02,
+    TAG_EOF       = 0x03,
+    TAG_UNDEFINED = 0x04,
+    TAG_CHAR      = 0x05,
+
+    TAG_FIXNUM    = 0x10,       /* zigzag varint */
+    TAG_FLONUM    = 0x11,       /* 8 bytes */
+    TAG_BIGNUM    = 0x12,       /* sign, varint nbytes, magnitude */
+    TAG_RATNUM    = 0x13,       /* numerator, denominator */
+    TAG_COMPNUM   = 0x14,       /* 8 bytes real, 8 bytes imag */
+
+    TAG_STRING    = 0x20,       /* varint size, bytes */
+    TAG_ISTRING   = 0x21,       /* incomplete string */
+    TAG_SYMBOL    = 0x22,       /* interned symbol; varint size, bytes */
+    TAG_USYMBOL   = 0x23,       /* uninterned symbol */
+    TAG_KEYWORD   = 0x24,       /* keyword; name without ':' */
+
+    TAG_LIST      = 0x30,       /* varint n, n elements, tail */
+    TAG_VECTOR    = 0x31,       /* varint n, n elements */
+    TAG_UVECTOR   = 0x32,       /* type, varint n, body */
+    TAG_HASHTABLE = 0x33,       /* type, varint n, n key-value pairs */
+
+    TAG_REF       = 0x40        /* varint index */
+};
+
+/* The type of uvector is written as ScmUVectorType */
+static ScmClass *uvector_classes[] = {
+    SCM_CLASS_S8VECTOR,  SCM_CLASS_U8VECTOR,
+    SCM_CLASS_S16VECTOR, SCM_CLASS_U16VECTOR,
+    SCM_CLASS_S32VECTOR, SCM_CLASS_U32VECTOR,
+    SCM_CLASS_S64VECTOR, SCM_CLASS_U64VECTOR,
+    SCM_CLASS_F16VECTOR, SCM_CLASS_F32VECTOR, SCM_CLASS_F64VECTOR,
+};
+#define NUM_UVECTOR_CLASSES \
+    ((int)(sizeof(uvector_classes)/sizeof(uvector_classes[0])))
+
+/* Hashtables are written with one of these types.  Hashtables with
+   general comparators can't be serialized. */
+static int hashtable_type_serializable(ScmHashType type)
+{
+    return (type == SCM_HASH_EQ || type == SCM_HASH_EQV
+            || type == SCM_HASH_EQUAL || type == SCM_HASH_STRING);
+}
+
+/* Reverse the byte order of each element in place; used when the
+   host is big-endian, for the uvector bodies are little-endian. */
+#if defined(WORDS_BIGENDIAN)
+static void swap_elements(unsigned char *p, size_t nelts, int eltsize)
+{
+    if (eltsize == 1) return;
+    for (size_t i = 0; i < nelts; i++, p += eltsize) {
+        for (int j = 0; j < eltsize/2; j++) {
+            unsigned char t = p[j];
+            p[j] = p[eltsize-1-j];
+            p[eltsize-1-j] = t;
+        }
+    }
+}
+#endif /*WORDS_BIGENDIAN*/
+
+/*================================================================
+ * Writer
+ *
+ *   The record is built in a memory buffer and written to the port
+ *   at once.
+ */
+
+typedef struct {
+    unsigned char *buf;
+    size_t size;
+    size_t capacity;
+    ScmHashCore table;          /* object -> index+1 */
+    u_long count;
+} Writer;
+
+static void writer_init(Writer *w)
+{
+    w->capacity = 256;
+    w->buf = SCM_NEW_ATOMIC2(unsigned char*, w->capacity);
+    w->size = 0;
+    Scm_HashCoreInitSimple(&w->table, SCM_HASH_EQ, 0, NULL);
+    w->count = 0;
+}
+
+static void w_ensure(Writer *w, size_t n)
+{
+    if (w->size + n <= w->capacity) return;
+    size_t ncap = w->capacity * 2;
+    while (ncap < w->size + n) ncap *= 2;
+    unsigned char *nbuf = SCM_NEW_ATOMIC2(unsigned char*, ncap);
+    memcpy(nbuf, w->buf, w->size);
+    w->buf = nbuf;
+    w->capacity = ncap;
+}
+
+static inline void w_byte(Writer *w, unsigned char b)
+{
+    w_ensure(w, 1);
+    w->buf[w->size++] = b;
+}
+
+static void w_bytes(Writer *w, const void *p, size_t n)
+{
+    w_ensure(w, n);
+    memcpy(w->buf + w->size, p, n);
+    w->size += n;
+}
+
+static void w_varint(Writer *w, u_long v)
+{
+    w_ensure(w, 10);
+    while (v >= 0x80) {
+        w->buf[w->size++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    w->buf[w->size++] = (unsigned char)v;
+}
+
+static void w_double(Writer *w, double d)
+{
+    union { double d; uint64_t u; } v;
+    v.d = d;
+    w_ensure(w, 8);
+    for (int i = 0; i < 8; i++) {
+        w->buf[w->size++] = (unsigned char)(v.u >> (i*8));
+    }
+}
+
+static void w_string_body(Writer *w, ScmString *s)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(s);
+    w_varint(w, SCM_STRING_BODY_SIZE(b));
+    w_bytes(w, SCM_STRING_BODY_START(b), SCM_STRING_BODY_SIZE(b));
+}
+
+/* If OBJ has already been written, emit a reference and returns TRUE.
+   Otherwise, give it the next index and returns FALSE. */
+static int w_shared(Writer *w, ScmObj obj)
+{
+    ScmDictEntry *e = Scm_HashCoreSearch(&w->table, (intptr_t)obj,
+                                         SCM_DICT_CREATE);
+    if (e->value) {
+        w_byte(w, TAG_REF);
+        w_varint(w, (u_long)e->value - 1);
+        return TRUE;
+    }
+    e->value = (intptr_t)++w->count;
+    return FALSE;
+}
+
+static void write_obj(Writer *w, ScmObj obj)
+{
+    if (SCM_INTP(obj)) {
+        long v = SCM_INT_VALUE(obj);
+        w_byte(w, TAG_FIXNUM);
+        w_varint(w, ((u_long)v << 1) ^ (u_long)(v >> (SCM_WORD_BITS-1)));
+    } else if (SCM_NULLP(obj)) {
+        w_byte(w, TAG_NIL);
+    } else if (SCM_FALSEP(obj)) {
+        w_byte(w, TAG_FALSE);
+    } else if (SCM_TRUEP(obj)) {
+        w_byte(w, TAG_TRUE);
+    } else if (SCM_EOFP(obj)) {
+        w_byte(w, TAG_EOF);
+    } else if (SCM_UNDEFINEDP(obj)) {
+        w_byte(w, TAG_UNDEFINED);
+    } else if (SCM_CHARP(obj)) {
+        w_byte(w, TAG_CHAR);
+        w_varint(w, (u_long)SCM_CHAR_VALUE(obj));
+    } else if (SCM_FLONUMP(obj)) {
+        w_byte(w, TAG_FLONUM);
+        w_double(w, SCM_FLONUM_VALUE(obj));
+    } else if (SCM_PAIRP(obj)) {
+        /* A list is written as a whole, as far as its pairs haven't been
+           written.  We number all of its pairs before writing elements. */
+        if (w_shared(w, obj)) return;
+        u_long n = 1;
+        ScmObj tail = SCM_CDR(obj);
+        while (SCM_PAIRP(tail)) {
+            ScmDictEntry *e = Scm_HashCoreSearch(&w->table, (intptr_t)tail,
+                                                 SCM_DICT_CREATE);
+            if (e->value) break;
+            e->value = (intptr_t)++w->count;
+            n++;
+            tail = SCM_CDR(tail);
+        }
+        w_byte(w, TAG_LIST);
+        w_varint(w, n);
+        ScmObj p = obj;
+        for (u_long i = 0; i < n; i++, p = SCM_CDR(p)) {
+            write_obj(w, SCM_CAR(p));
+        }
+        write_obj(w, tail);
+    } else if (SCM_STRINGP(obj)) {
+        if (w_shared(w, obj)) return;
+        w_byte(w, SCM_STRING_INCOMPLETE_P(obj)? TAG_ISTRING : TAG_STRING);
+        w_string_body(w, SCM_STRING(obj));
+    } else if (SCM_KEYWORDP(obj)) {
+        if (w_shared(w, obj)) return;
+        w_byte(w, TAG_KEYWORD);
+        w_string_body(w, SCM_STRING(Scm_KeywordToString(SCM_KEYWORD(obj))));
+    } else if (SCM_SYMBOLP(obj)) {
+        if (w_shared(w, obj)) return;
+        w_byte(w, SCM_SYMBOL_INTERNED(obj)? TAG_SYMBOL : TAG_USYMBOL);
+        w_string_body(w, SCM_SYMBOL_NAME(obj));
+    } else if (SCM_VECTORP(obj)) {
+        if (w_shared(w, obj)) return;
+        ScmSmallInt n = SCM_VECTOR_SIZE(obj);
+        w_byte(w, TAG_VECTOR);
+        w_varint(w, (u_long)n);
+        for (ScmSmallInt i = 0; i < n; i++) {
+            write_obj(w, SCM_VECTOR_ELEMENT(obj, i));
+        }
+    } else if (SCM_UVECTORP(obj)) {
+        ScmUVectorType type = Scm_UVectorType(SCM_CLASS_OF(obj));
+        if (type == SCM_UVECTOR_INVALID) goto bad;
+        if (w_shared(w, obj)) return;
+        ScmSmallInt n = SCM_UVECTOR_SIZE(obj);
+        size_t nbytes = Scm_UVectorSizeInBytes(SCM_UVECTOR(obj));
+        w_byte(w, TAG_UVECTOR);
+        w_byte(w, (unsigned char)type);
+        w_varint(w, (u_long)n);
+        size_t pos = w->size;
+        w_bytes(w, SCM_UVECTOR_ELEMENTS(obj), nbytes);
+#if defined(WORDS_BIGENDIAN)
+        if (n > 0) swap_elements(w->buf + pos, n, nbytes/n);
+#else
+        (void)pos;
+#endif
+    } else if (SCM_BIGNUMP(obj)) {
+        u_int size = SCM_BIGNUM_SIZE(obj);
+        w_byte(w, TAG_BIGNUM);
+        w_byte(w, SCM_BIGNUM_SIGN(obj) < 0);
+        w_varint(w, (u_long)size * SIZEOF_LONG);
+        w_ensure(w, (size_t)size * SIZEOF_LONG);
+        for (u_int i = 0; i < size; i++) {
+            u_long d = SCM_BIGNUM(obj)->values[i];
+            for (int j = 0; j < SIZEOF_LONG; j++) {
+                w->buf[w->size++] = (unsigned char)(d >> (j*8));
+            }
+        }
+    } else if (SCM_RATNUMP(obj)) {
+        w_byte(w, TAG_RATNUM);
+        write_obj(w, SCM_RATNUM_NUMER(obj));
+        write_obj(w, SCM_RATNUM_DENOM(obj));
+    } else if (SCM_COMPNUMP(obj)) {
+        w_byte(w, TAG_COMPNUM);
+        w_double(w, SCM_COMPNUM_REAL(obj));
+        w_double(w, SCM_COMPNUM_IMAG(obj));
+    } else if (SCM_HASH_TABLE_P(obj)) {
+        ScmHashType type = Scm_HashTableType(SCM_HASH_TABLE(obj));
+        if (!hashtable_type_serializable(type)) goto bad;
+        if (w_shared(w, obj)) return;
+        ScmHashCore *core = SCM_HASH_TABLE_CORE(obj);
+        w_byte(w, TAG_HASHTABLE);
+        w_byte(w, (unsigned char)type);
+        w_varint(w, (u_long)Scm_HashCoreNumEntries(core));
+        ScmHashIter iter;
+        ScmDictEntry *e;
+        Scm_HashIterInit(&iter, core);
+        while ((e = Scm_HashIterNext(&iter)) != NULL) {
+            write_obj(w, SCM_DICT_KEY(e));
+            write_obj(w, SCM_DICT_VALUE(e));
+        }
+    } else {
+        goto bad;
+    }
+    return;
+  bad:
+    Scm_Error("can't serialize object: %S", obj);
+}
+
+/* Returns the whole record, including the length header. */
+static Writer *serialize_record(Writer *w, ScmObj obj)
+{
+    writer_init(w);
+    w_byte(w, SERIALIZE_VERSION);
+    write_obj(w, obj);
+
+    unsigned char header[10];
+    int hlen = 0;
+    u_long len = w->size;
+    while (len >= 0x80) {
+        header[hlen++] = (unsigned char)(len | 0x80);
+        len >>= 7;
+    }
+    header[hlen++] = (unsigned char)len;
+
+    w_ensure(w, hlen);
+    memmove(w->buf + hlen, w->buf, w->size);
+    memcpy(w->buf, header, hlen);
+    w->size += hlen;
+    return w;
+}
+
+ScmObj Scm_SerializeToBytevector(ScmObj obj)
+{
+    Writer w;
+    serialize_record(&w, obj);
+    return Scm_MakeUVectorFull(SCM_CLASS_U8VECTOR, w.size, w.buf,
+                               FALSE, NULL);
+}
+
+void Scm_Serialize(ScmObj obj, ScmPort *port)
+{
+    Writer w;
+    serialize_record(&w, obj);
+    if (w.size > INT_MAX) Scm_Error("serialized data too large");
+    Scm_Putz((const char*)w.buf, (int)w.size, port);
+}
+
+/*================================================================
+ * Reader
+ */
+
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;
+    ScmObj *objs;               /* index -> object */
+    u_long count;
+    u_long capacity;
+} Reader;
+
+static void reader_init(Reader *r, const unsigned char *p, size_t size)
+{
+    r->p = p;
+    r->end = p + size;
+    r->capacity = 16;
+    r->objs = SCM_NEW_ARRAY(ScmObj, r->capacity);
+    r->count = 0;
+}
+
+static void r_premature(void)
+{
+    Scm_Error("premature end of serialized data");
+}
+
+static inline unsigned char r_byte(Reader *r)
+{
+    if (r->p >= r->end) r_premature();
+    return *r->p++;
+}
+
+static u_long r_varint(Reader *r)
+{
+    u_long v = 0;
+    for (int shift = 0; shift < SCM_WORD_BITS; shift += 7) {
+        unsigned char b = r_byte(r);
+        v |= (u_long)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return v;
+    }
+    Scm_Error("malformed serialized data (integer overflow)");
+    return 0;                   /* dummy */
+}
+
+/* Checks there are at least N more bytes; used to reject corrupted
+   counts before allocating objects. */
+static void r_check(Reader *r, u_long n)
+{
+    if ((u_long)(r->end - r->p) < n) r_premature();
+}
+
+static double r_double(Reader *r)
+{
+    union { double d; uint64_t u; } v;
+    r_check(r, 8);
+    v.u = 0;
+    for (int i = 0; i < 8; i++) v.u |= (uint64_t)r->p[i] << (i*8);
+    r->p += 8;
+    return v.d;
+}
+
+static ScmObj r_string(Reader *r, int flags)
+{
+    u_long size = r_varint(r);
+    r_check(r, size);
+    ScmObj s = Scm_MakeString((const char*)r->p, size, -1,
+                              SCM_STRING_COPYING|flags);
+    r->p += size;
+    return s;
+}
+
+static ScmObj r_register(Reader *r, ScmObj obj)
+{
+    if (r->count == r->capacity) {
+        ScmObj *nobjs = SCM_NEW_ARRAY(ScmObj, r->capacity*2);
+        memcpy(nobjs, r->objs, r->count * sizeof(ScmObj));
+        r->objs = nobjs;
+        r->capacity *= 2;
+    }
+    r->objs[r->count++] = obj;
+    return obj;
+}
+
+static ScmObj read_obj(Reader *r)
+{
+    unsigned char tag = r_byte(r);
+    switch (tag) {
+    case TAG_NIL:       return SCM_NIL;
+    case TAG_FALSE:     return SCM_FALSE;
+    case TAG_TRUE:      return SCM_TRUE;
+    case TAG_EOF:       return SCM_EOF;
+    case TAG_UNDEFINED: return SCM_UNDEFINED;
+    case TAG_CHAR: {
+        u_long c = r_varint(r);
+        if (c > 0x10ffff) Scm_Error("invalid character in serialized data");
+        return SCM_MAKE_CHAR(c);
+    }
+    case TAG_FIXNUM: {
+        u_long v = r_varint(r);
+        return Scm_MakeInteger((long)(v >> 1) ^ -(long)(v & 1));
+    }
+    case TAG_FLONUM:
+        return Scm_MakeFlonum(r_double(r));
+    case TAG_BIGNUM: {
+        int neg = r_byte(r);
+        u_long nbytes = r_varint(r);
+        r_check(r, nbytes);
+        u_long nwords = (nbytes + SIZEOF_LONG - 1) / SIZEOF_LONG;
+        if (nwords == 0 || nwords > SCM_BIGNUM_MAX_DIGITS) {
+            Scm_Error("invalid bignum in serialized data");
+        }
+        ScmBignum *b = Scm_MakeBignumWithSize((int)nwords, 0);
+        for (u_long i = 0; i < nbytes; i++) {
+            b->values[i / SIZEOF_LONG] |=
+                (u_long)r->p[i] << ((i % SIZEOF_LONG) * 8);
+        }
+        r->p += nbytes;
+        b->sign = neg? -1 : 1;
+        return Scm_NormalizeBignum(b);
+    }
+    case TAG_RATNUM: {
+        ScmObj n = read_obj(r);
+        ScmObj d = read_obj(r);
+        if (!SCM_INTEGERP(n) || !SCM_EXACTP(n) || !SCM_INTEGERP(d)
+            || !SCM_EXACTP(d) || SCM_EQ(d, SCM_MAKE_INT(0))) {
+            Scm_Error("invalid ratnum in serialized data");
+        }
+        return Scm_MakeRational(n, d);
+    }
+    case TAG_COMPNUM: {
+        double re = r_double(r);
+        double im = r_double(r);
+        return Scm_MakeComplex(re, im);
+    }
+    case TAG_STRING:
+        return r_register(r, r_string(r, 0));
+    case TAG_ISTRING:
+        return r_register(r, r_string(r, SCM_STRING_INCOMPLETE));
+    case TAG_SYMBOL:
+        return r_register(r, Scm_Intern(SCM_STRING(r_string(r, 0))));
+    case TAG_USYMBOL:
+        return r_register(r, Scm_MakeSymbol(SCM_STRING(r_string(r, 0)),
+                                            FALSE));
+    case TAG_KEYWORD:
+        return r_register(r, Scm_MakeKeyword(SCM_STRING(r_string(r, 0))));
+    case TAG_LIST: {
+        u_long n = r_varint(r);
+        if (n == 0) Scm_Error("malformed serialized data (empty list)");
+        r_check(r, n);          /* each element takes at least 1 byte */
+        ScmObj head = SCM_NIL, last = SCM_NIL;
+        for (u_long i = 0; i < n; i++) {
+            SCM_APPEND1(head, last, SCM_UNDEFINED);
+            r_register(r, last);
+        }
+        ScmObj p = head;
+        for (u_long i = 0; i < n; i++, p = SCM_CDR(p)) {
+            SCM_SET_CAR(p, read_obj(r));
+        }
+        SCM_SET_CDR(last, read_obj(r));
+        return head;
+    }
+    case TAG_VECTOR: {
+        u_long n = r_varint(r);
+        r_check(r, n);
+        ScmObj v = r_register(r, Scm_MakeVector((ScmSmallInt)n,
+                                                SCM_UNDEFINED));
+        for (u_long i = 0; i < n; i++) {
+            SCM_VECTOR_ELEMENT(v, i) = read_obj(r);
+        }
+        return v;
+    }
+    case TAG_UVECTOR: {
+        int type = r_byte(r);
+        if (type >= NUM_UVECTOR_CLASSES) {
+            Scm_Error("invalid uvector type in serialized data: %d", type);
+        }
+        ScmClass *klass = uvector_classes[type];
+        u_long n = r_varint(r);
+        int eltsize = Scm_UVectorElementSize(klass);
+        if (n > (u_long)SCM_SMALL_INT_MAX / eltsize) r_premature();
+        r_check(r, n * eltsize);
+        ScmObj v = r_register(r, Scm_MakeUVector(klass, (ScmSmallInt)n,
+                                                 NULL));
+        memcpy(SCM_UVECTOR_ELEMENTS(v), r->p, n * eltsize);
+#if defined(WORDS_BIGENDIAN)
+        swap_elements(SCM_UVECTOR_ELEMENTS(v), n, eltsize);
+#endif
+        r->p += n * eltsize;
+        return v;
+    }
+    case TAG_HASHTABLE: {
+        int type = r_byte(r);
+        if (!hashtable_type_serializable(type)) {
+            Scm_Error("invalid hashtable type in serialized data: %d", type);
+        }
+        u_long n = r_varint(r);
+        r_check(r, n * 2);
+        ScmObj h = r_register(r, Scm_MakeHashTableSimple(type, (int)n));
+        for (u_long i = 0; i < n; i++) {
+            ScmObj k = read_obj(r);
+            ScmObj v = read_obj(r);
+            Scm_HashTableSet(SCM_HASH_TABLE(h), k, v, 0);
+        }
+        return h;
+    }
+    case TAG_REF: {
+        u_long i = r_varint(r);
+        if (i >= r->count) {
+            Scm_Error("invalid reference in serialized data: %lu", i);
+        }
+        return r->objs[i];
+    }
+    default:
+        Scm_Error("invalid tag in serialized data: %d", tag);
+    }
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+static ScmObj deserialize_body(const unsigned char *body, size_t size)
+{
+    Reader r;
+    reader_init(&r, body, size);
+    int version = r_byte(&r);
+    if (version != SERIALIZE_VERSION) {
+        Scm_Error("unsupported serialization format version: %d", version);
+    }
+    ScmObj obj = read_obj(&r);
+    if (r.p != r.end) Scm_Error("extra bytes after serialized data");
+    return obj;
+}
+
+ScmObj Scm_DeserializeFromBytevector(ScmUVector *bv)
+{
+    Reader r;
+    reader_init(&r, (const unsigned char*)SCM_UVECTOR_ELEMENTS(bv),
+                Scm_UVectorSizeInBytes(bv));
+    u_long size = r_varint(&r);
+    r_check(&r, size);
+    if ((u_long)(r.end - r.p) != size) {
+        Scm_Error("extra bytes after serialized data");
+    }
+    return deserialize_body(r.p, size);
+}
+
+/* Returns EOF if the port is at the end. */
+ScmObj Scm_Deserialize(ScmPort *port)
+{
+    u_long size = 0;
+    for (int shift = 0; ; shift += 7) {
+        int b = Scm_Getb(port);
+        if (b == EOF) {
+            if (shift == 0) return SCM_EOF;
+            r_premature();
+        }
+        if (shift >= SCM_WORD_BITS) {
+            Scm_Error("malformed serialized data (integer overflow)");
+        }
+        size |= (u_long)(b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+    }
+    if (size > INT_MAX) Scm_Error("serialized data too large");
+
+    unsigned char *body = SCM_NEW_ATOMIC2(unsigned char*, size > 0? size : 1);
+    u_long nread = 0;
+    while (nread < size) {
+        int n = Scm_Getz((char*)body + nread, (int)(size - nread), port);
+        if (n <= 0) r_premature();
+        nread += n;
+    }
+    return deserialize_body(body, size);
+}
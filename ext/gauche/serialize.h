@@ -0,0 +1,61 @@
+/*
+ * serialize.h - Binary serialization of Scheme data
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_SERIALIZE_H
+#define GAUCHE_SERIALIZE_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+
+#if defined(EXTGAUCHE_EXPORTS)
+#define LIBGAUCHE_EXT_BODY
+#endif
+#include <gauche/extern.h>      /* redefine SCM_EXTERN */
+
+/*
+ * Binary serialization
+ *
+ *   A record is the length of the body (varint) followed by the body,
+ *   which is a format version byte and one encoded object.  Each object
+ *   starts with a tag byte.  Symbols and aggregates are numbered in the
+ *   order they first appear in the record, and later occurrences are
+ *   written as a reference to the number, so shared and circular
+ *   structures are preserved.  Multibyte numbers are little-endian.
+ */
+
+SCM_EXTERN ScmObj Scm_SerializeToBytevector(ScmObj obj);
+SCM_EXTERN void   Scm_Serialize(ScmObj obj, ScmPort *port);
+SCM_EXTERN ScmObj Scm_Deserialize(ScmPort *port);
+SCM_EXTERN ScmObj Scm_DeserializeFromBytevector(ScmUVector *bv);
+
+#endif /*GAUCHE_SERIALIZE_H*/
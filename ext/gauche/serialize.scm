@@ -0,0 +1,64 @@
+;;;
+;;; gauche.serialize - binary serialization
+;;;
+;;;
+;;;   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+
+;; A compact binary encoding of Scheme data, much faster to write and
+;; read than the textual representation.  Booleans, characters, numbers,
+;; strings, symbols, keywords, pairs, vectors, uniform vectors and
+;; hashtables (except the ones with general comparators) can be
+;; serialized.  Shared and circular structures are preserved within
+;; a record.  The core is in serialize.c.
+
+(define-module gauche.serialize
+  (export serialize deserialize
+          serialize-to-bytevector deserialize-from-bytevector))
+(select-module gauche.serialize)
+
+(inline-stub
+ (declcode "#include \"serialize.h\"")
+
+ (define-cproc serialize (obj :optional (port::<output-port>
+                                         (current-output-port)))
+   ::<void>
+   (Scm_Serialize obj port))
+
+ (define-cproc deserialize (:optional (port::<input-port>
+                                       (current-input-port)))
+   Scm_Deserialize)
+
+ (define-cproc serialize-to-bytevector (obj) Scm_SerializeToBytevector)
+
+ (define-cproc deserialize-from-bytevector (bv::<u8vector>)
+   Scm_DeserializeFromBytevector)
+ )
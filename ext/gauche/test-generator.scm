@@ -405,4 +405,48 @@
                                    (giota 20)
                                    :open #t :repeat #t)))
 
+;; generator-pipeline must behave the same as nested combinators
+(define-syntax test-pipeline
+  (syntax-rules ()
+    [(_ name expected src stage ...)
+     (test* (format "generator-pipeline ~a" name) expected
+            (generator->list (generator-pipeline src stage ...)))]))
+
+(test-pipeline "no stage" '(0 1 2) '(0 1 2))
+(test-pipeline "gmap/gfilter" '(1 9 25 49 81)
+               (giota 10) (gfilter odd?) (gmap (^x (* x x))))
+(test-pipeline "gremove/gfilter-map" '(2 4 8 10)
+               '(0 1 2 3 4 5) (gremove (pa$ = 3))
+               (gfilter-map (^x (and (> x 0) (* x 2)))))
+(test-pipeline "gtake" '(0 2 4 6)
+               (giota) (gfilter even?) (gtake 4))
+(test-pipeline "gtake 0" '() (giota) (gtake 0))
+(test-pipeline "gtake more" '(a b) '(a b) (gtake 5))
+(test-pipeline "gdrop" '(6 8) (giota 10) (gfilter even?) (gdrop 3))
+(test-pipeline "gtake-while/gdrop-while" '(3 4 5)
+               (giota 10) (gdrop-while (pa$ > 3)) (gtake-while (pa$ > 6)))
+(test-pipeline "gunfold" (generator->list
+                          (gmap (pa$ + 1)
+                                (gunfold (pa$ < 5) (pa$ * 10) (pa$ + 1) 0)))
+               (gunfold (pa$ < 5) (pa$ * 10) (pa$ + 1) 0) (gmap (pa$ + 1)))
+(test-pipeline "gconcatenate" '(0 1 2 3 0 1 2 3 0 1)
+               (gunfold (^v #f) (^_ (giota 4)) (^_ #f) 0)
+               (gconcatenate) (gtake 10))
+(test-pipeline "gconcatenate after gtake" '(0 1 0 1 0 1)
+               (gunfold (^v #f) (^_ (giota 2)) (^_ #f) 0)
+               (gtake 3) (gconcatenate))
+(test-pipeline "nested gconcatenate" '(a b c d e 0 2)
+               '(((a b) (c)) () ((d e) (0 1 2)))
+               (gconcatenate) (gconcatenate) (gremove (pa$ eqv? 1)))
+(test* "generator-pipeline doesn't pull extra" '((0 1 2) 3)
+       (let* ([g (giota)]
+              [r (generator->list (generator-pipeline g (gtake 3)))])
+         (list r (g))))
+(test* "generator-pipeline evaluation order" '(src a b)
+       (let1 r '()
+         (generator-pipeline (begin (push! r 'src) '())
+                             (gmap (begin (push! r 'a) identity))
+                             (gfilter (begin (push! r 'b) identity)))
+         (reverse r)))
+
 (test-end)
@@ -0,0 +1,129 @@
+;;
+;; testing gauche.metrics
+;;
+
+(use gauche.test)
+(test-start "gauche.metrics")
+
+(use gauche.metrics)
+(test-module 'gauche.metrics)
+
+;; Lines of the exposition text about metrics whose names start with PREFIX.
+(define (text-lines prefix)
+  (filter (^l (or (string-prefix? prefix l)
+                  (string-prefix? #"# HELP ~prefix" l)
+                  (string-prefix? #"# TYPE ~prefix" l)))
+          (string-split (metrics-text) #\newline)))
+
+;;--------------------------------------------------------------------
+(test-section "counters and gauges")
+
+(let ([c (make-metric-counter "test_requests_total"
+                              :help "Requests.\nSecond line"
+                              :labels '((path . "/a\"b") (method . GET)))])
+  (test* "metric?" #t (metric? c))
+  (test* "kind" 'counter (metric-kind c))
+  (test* "labels are sorted" '(("method" . "GET") ("path" . "/a\"b"))
+         (metric-labels c))
+  (metric-inc! c)
+  (metric-inc! c 2)
+  (test* "value" 3 (metric-value c))
+  (test* "re-registration" c
+         (make-metric-counter "test_requests_total"
+                              :labels '((method . "GET") (path . "/a\"b"))))
+  (test* "dec! counter" (test-error) (metric-dec! c))
+  (test* "negative inc! counter" (test-error) (metric-inc! c -1))
+  (test* "same name, other kind" (test-error)
+         (make-metric-gauge "test_requests_total"))
+  (let1 c2 (make-metric-counter "test_requests_total"
+                                :labels '((method . POST)))
+    (metric-inc! c2 5)
+    (test* "text" '("# HELP test_requests_total Requests.\\nSecond line"
+                    "# TYPE test_requests_total counter"
+                    "test_requests_total{method=\"GET\",path=\"/a\\\"b\"} 3"
+                    "test_requests_total{method=\"POST\"} 5")
+           (text-lines "test_requests"))
+    (metric-unregister! c2))
+  (metric-unregister! c)
+  (test* "unregister" '() (text-lines "test_requests")))
+
+(let ([g (make-metric-gauge "test_queue_length")])
+  (metric-set! g 10)
+  (metric-dec! g 3)
+  (metric-inc! g)
+  (test* "gauge" 8 (metric-value g))
+  (metric-set! g -2)
+  (test* "gauge negative" -2 (metric-value g))
+  (test* "gauge text" '("# TYPE test_queue_length gauge"
+                        "test_queue_length -2")
+         (text-lines "test_queue"))
+  (metric-unregister! g))
+
+(let ([g (make-metric-gauge "test_getter" :getter (^[] 2.5))])
+  (test* "getter" 2.5 (metric-value g))
+  (test* "getter set!" (test-error) (metric-set! g 1))
+  (test* "getter text" '("# TYPE test_getter gauge" "test_getter 2.5")
+         (text-lines "test_getter"))
+  (metric-unregister! g))
+
+(test* "invalid name" (test-error) (make-metric-counter "1abc"))
+(test* "invalid label" (test-error)
+       (make-metric-counter "test_x" :labels '((a-b . "c"))))
+
+;;--------------------------------------------------------------------
+(test-section "histograms")
+
+(let ([h (make-metric-histogram "test_size" :max-value 16)])
+  (for-each (cut metric-observe! h <>) '(0 1 3 5 16 100))
+  (test* "value" '(6 125 ((1 . 2) (2 . 2) (4 . 3) (8 . 4) (16 . 5)
+                          (+inf.0 . 6)))
+         (metric-value h))
+  (test* "text" '("# TYPE test_size histogram"
+                  "test_size_bucket{le=\"1\"} 2"
+                  "test_size_bucket{le=\"2\"} 2"
+                  "test_size_bucket{le=\"4\"} 3"
+                  "test_size_bucket{le=\"8\"} 4"
+                  "test_size_bucket{le=\"16\"} 5"
+                  "test_size_bucket{le=\"+Inf\"} 6"
+                  "test_size_sum 125"
+                  "test_size_count 6")
+         (text-lines "test_size"))
+  (test* "negative" (test-error) (metric-observe! h -1))
+  (test* "inc!" (test-error) (metric-inc! h))
+  (metric-unregister! h))
+
+(let ([h (make-metric-histogram "test_q")])
+  (test* "quantile of empty" #f (metric-quantile h 0.5))
+  (dotimes [i 100] (metric-observe! h (+ i 1)))
+  (test* "quantile 0" 1 (metric-quantile h 0))
+  (test* "quantile 0.5" 52 (metric-quantile h 0.5))
+  (test* "quantile 1" 104 (metric-quantile h 1))
+  (test* "quantile out of range" (test-error) (metric-quantile h 1.5))
+  (metric-unregister! h))
+
+(let ([h (make-metric-histogram "test_latency_seconds" :labels '((op . "x"))
+                                :max-value 2 :scale 1/1000)])
+  (metric-observe! h 2)
+  (test* "scaled text" '("# TYPE test_latency_seconds histogram"
+                         "test_latency_seconds_bucket{op=\"x\",le=\"0.001\"} 0"
+                         "test_latency_seconds_bucket{op=\"x\",le=\"0.002\"} 1")
+         (take (text-lines "test_latency") 3))
+  (test* "timer" 2 (begin (with-metric-timer h #t) (car (metric-value h))))
+  (test* "histogram with le label" (test-error)
+         (make-metric-histogram "test_bad" :labels '((le . "1"))))
+  (metric-unregister! h))
+
+;;--------------------------------------------------------------------
+(test-section "runtime metrics")
+
+(gc)
+(test* "gc collections" #t
+       (any (^l (string-prefix? "gauche_gc_collections_total " l))
+            (text-lines "gauche_gc")))
+(test* "gc pause histogram" #t
+       (any (^l (string-prefix? "gauche_gc_pause_seconds_bucket{le=\"+Inf\"}" l))
+            (text-lines "gauche_gc")))
+(test* "threads" #t
+       (any (^l (#/^gauche_threads \d+$/ l)) (text-lines "gauche_threads")))
+
+(test-end)
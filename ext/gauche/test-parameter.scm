@@ -180,6 +180,27 @@
            (when (< (length r) 4) (cc cc))
            (reverse r))))
 
+(test* "Mixing observed and plain parameters"
+       '((10 "20") (1 "2") ((1 10) (10 1)))
+       (let ([a (make-parameter 1)]
+             [b (make-parameter 2 x->string)]
+             [log '()])
+         (parameter-observer-add! a (^[o v] (push! log (list o v))) 'after)
+         (let1 r (parameterize ([a 10] [b 20]) (list (a) (b)))
+           (list r (list (a) (b)) (reverse log)))))
+
+(test* "Nested parameterize and escape"
+       '((3 2) (2 2) 1)
+       (let* ([a (make-parameter 1)]
+              [r '()])
+         (let/cc k
+           (parameterize ([a 2])
+             (parameterize ([a 3])
+               (push! r (list (a) 2))
+               (parameterize ([a 2]) (push! r (list (a) 2)))
+               (k #f))))
+         (append (reverse r) (list (a)))))
+
 ;; Note: ext/threads has extra tests for parameter/thread cooperation.
 
 (test-end)
@@ -0,0 +1,126 @@
+;;
+;; testing gauche.serialize
+;;
+
+(use gauche.test)
+(use gauche.uvector)
+(test-start "gauche.serialize")
+
+(use gauche.serialize)
+(test-module 'gauche.serialize)
+
+(define (roundtrip obj)
+  (deserialize-from-bytevector (serialize-to-bytevector obj)))
+
+;;--------------------------------------------------------------------
+(test-section "atoms")
+
+(let ()
+  (define (t obj)
+    (test* (format "roundtrip ~s" obj) obj (roundtrip obj) equal?))
+  (for-each t `(() #t #f #\a #\x3bb 0 1 -1 ,(greatest-fixnum) ,(least-fixnum)
+                ,(+ (greatest-fixnum) 1) ,(- (least-fixnum) 1)
+                ,(expt 3 500) ,(- (expt 7 300))
+                1/3 -22/7 ,(/ (expt 2 100) 3)
+                0.0 -0.0 1.5 -1e300 +inf.0 -inf.0 3.14159e-310
+                1+2i -0.5-1.5i
+                "" "abc" "日本語" #*"\xff\x00" abc |foo bar| :key))
+  (test* "roundtrip eof" (eof-object) (roundtrip (eof-object)))
+  (test* "roundtrip nan" #t (nan? (roundtrip +nan.0)))
+  (test* "roundtrip -0.0" #t (eqv? -0.0 (roundtrip -0.0)))
+  (test* "incomplete string" #t
+         (string-incomplete? (roundtrip #*"abc")))
+  (test* "interned symbol" #t (eq? 'abc (roundtrip 'abc)))
+  (test* "keyword" #t (eq? :key (roundtrip :key)))
+  (test* "uninterned symbol" #f
+         (let1 s (roundtrip (string->uninterned-symbol "x"))
+           (symbol-interned? s))))
+
+;;--------------------------------------------------------------------
+(test-section "aggregates")
+
+(let ()
+  (define (t obj)
+    (test* (format "roundtrip ~s" obj) obj (roundtrip obj) equal?))
+  (for-each t `((1 2 3) (a . b) (1 (2 (3 (4))) . 5) #() #(1 "a" #(b))
+                ((a . 1) (b . 2))
+                ,(iota 100000)
+                #u8(0 1 255) #s16(-1 2 -32768) #u32(4294967295)
+                #s64(-9223372036854775808 1) #f32(0.5 -1.5) #f64(1e300)
+                #f16(0.5 1.0) #u8())))
+
+(test* "hashtable" '(equal? 3 (1 2 3))
+       (let* ([h (hash-table equal-comparator '((a) . 1) '("b" . 2) '(#(c) . 3))]
+              [h2 (roundtrip h)])
+         (list (hash-table-type h2)
+               (hash-table-num-entries h2)
+               (list (hash-table-get h2 '(a))
+                     (hash-table-get h2 "b")
+                     (hash-table-get h2 #(c))))))
+(test* "hashtable (eq)" '(eq? 1)
+       (let1 h2 (roundtrip (hash-table eq-comparator '(x . 1)))
+         (list (hash-table-type h2) (hash-table-get h2 'x))))
+
+(test* "unserializable" (test-error) (serialize-to-bytevector car))
+(test* "unserializable (general hashtable)" (test-error)
+       (serialize-to-bytevector
+        (make-hash-table (make-comparator #t eq? #f (^x 0)))))
+
+;;--------------------------------------------------------------------
+(test-section "shared structure")
+
+(test* "shared" '(#t #t)
+       (let* ([x (list 1 2)]
+              [s (string-copy "abc")]
+              [y (roundtrip (vector x x s s))])
+         (list (eq? (vector-ref y 0) (vector-ref y 1))
+               (eq? (vector-ref y 2) (vector-ref y 3)))))
+(test* "shared tail" #t
+       (let* ([x (list 1 2)]
+              [y (roundtrip (list (cons 0 x) x))])
+         (eq? (cdar y) (cadr y))))
+(test* "circular list" "#0=(a b c . #0#)"
+       (write-to-string (roundtrip (circular-list 'a 'b 'c))))
+(test* "circular car" "#0=(a (b . #0#))"
+       (let1 x (list 'a (list 'b 'c))
+         (set-cdr! (cadr x) x)
+         (write-to-string (roundtrip x))))
+(test* "circular vector" "#0=#(1 #0#)"
+       (let1 v (vector 1 #f)
+         (vector-set! v 1 v)
+         (write-to-string (roundtrip v))))
+(test* "uninterned symbol identity" #t
+       (let* ([s (string->uninterned-symbol "g")]
+              [y (roundtrip (list s s))])
+         (eq? (car y) (cadr y))))
+
+;;--------------------------------------------------------------------
+(test-section "ports")
+
+(test* "multiple records" '((1 "two" three) #(4) 5.0 #t)
+       (let1 s (call-with-output-string
+                 (^p (serialize '(1 "two" three) p)
+                     (serialize #(4) p)
+                     (serialize 5.0 p)))
+         (call-with-input-string s
+           (^p (let* ([a (deserialize p)]
+                      [b (deserialize p)]
+                      [c (deserialize p)])
+                 (list a b c (eof-object? (deserialize p))))))))
+(test* "large record" (iota 50000)
+       (call-with-input-string
+           (call-with-output-string (^p (serialize (iota 50000) p)))
+         deserialize))
+(test* "truncated record" (test-error)
+       (let1 bv (serialize-to-bytevector '(1 2 3))
+         (deserialize-from-bytevector
+          (u8vector-copy bv 0 (- (u8vector-length bv) 1)))))
+(test* "truncated record (port)" (test-error)
+       (let1 bv (serialize-to-bytevector "abcdef")
+         (call-with-input-string
+             (u8vector->string bv 0 (- (u8vector-length bv) 2))
+           deserialize)))
+(test* "invalid tag" (test-error)
+       (deserialize-from-bytevector #u8(2 1 255)))
+
+(test-end)
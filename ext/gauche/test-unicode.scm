@@ -235,4 +235,15 @@
 (test* "string-titlecase" "Stra\u00dfe" (string-titlecase "stra\u00dfe"))
 (test* "string-foldcase" "strasse" (string-foldcase "stra\u00dfe"))
 
+;; strings that don't change, and changes after non-ascii characters
+(test* "string-upcase (unchanged)" "ABC-\u00c0" (string-upcase "ABC-\u00c0"))
+(test* "string-foldcase (unchanged)" "abc" (string-foldcase "abc"))
+(test* "string-downcase" "\u00e0\u00e0x\u00e0" (string-downcase "\u00e0\u00c0X\u00c0"))
+(test* "string-foldcase" "\u00e0ss\u00e0" (string-foldcase "\u00c0\u00df\u00e0"))
+(test* "string-upcase (fresh result)" '("XBC" "ABC")
+       (let* ([src (string-copy "ABC")]
+              [r (string-upcase src)])
+         (string-set! r 0 #\X)
+         (list r src)))
+
 (test-end)
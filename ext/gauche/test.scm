@@ -6,3 +6,5 @@
 (include "test-generator.scm")
 (include "test-lazy.scm")
 (include "test-unicode.scm")
+(include "test-serialize.scm")
+(include "test-metrics.scm")
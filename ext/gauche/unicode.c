@@ -0,0 +1,187 @@
+/*
+ * unicode.c - String case mapping
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "unicode.h"
+#include <gauche/char_attr.h>
+#include <string.h>
+
+/*
+ * The Scheme version of case mapping reads the string char by char and
+ * calls %char-xcase-extended on each, which is costly when we foldcase
+ * every token of a large text.  Here we do the same mappings directly on
+ * the utf-8 body, using the two-stage casemap tables in src/char.c.
+ *
+ * Most strings passed are already in the target case, so we first scan
+ * the body until we find a character that changes; if there's none, we
+ * return a copy of the input, sharing the body.  Strings consisting of
+ * ASCII characters only are handled with bytes.
+ *
+ * Downcasing capital sigma depends on the word boundaries around it.
+ * We leave such strings, as well as titlecasing, to the Scheme version.
+ */
+
+#define MAX_MAPPED (SCM_CHAR_FULL_CASE_MAPPING_SIZE*SCM_CHAR_FULL_CASE_MAPPING_SIZE)
+#define CAPITAL_SIGMA 0x03a3
+
+#if defined(GAUCHE_CHAR_ENCODING_UTF_8)
+
+/* Maps CH by full mapping of KIND (upcase or downcase) into OUT.
+   Returns the number of characters. */
+static int map_full(ScmChar ch, int kind, ScmChar *out)
+{
+    ScmCharCaseMap cm;
+    const ScmCharCaseMap *pcm = Scm__CharCaseMap(ch, &cm, TRUE);
+    const ScmChar *full;
+    int simple, i;
+
+    if (kind == CHAR_UPCASE) {
+        full = pcm->to_upper_full;
+        simple = pcm->to_upper_simple;
+    } else {
+        full = pcm->to_lower_full;
+        simple = pcm->to_lower_simple;
+    }
+    if (full[0] == -1) {
+        out[0] = ch + simple;
+        return 1;
+    }
+    for (i = 0; i < SCM_CHAR_FULL_CASE_MAPPING_SIZE && full[i] != -1; i++) {
+        out[i] = full[i];
+    }
+    return i;
+}
+
+/* Foldcase is full upcase followed by full downcase of each character,
+   as %foldcase does. */
+static int map_char(ScmChar ch, int kind, ScmChar *out)
+{
+    if (kind != CHAR_FOLDCASE) return map_full(ch, kind, out);
+
+    ScmChar up[SCM_CHAR_FULL_CASE_MAPPING_SIZE];
+    int nup = map_full(ch, CHAR_UPCASE, up), n = 0;
+    for (int i = 0; i < nup; i++) {
+        n += map_full(up[i], CHAR_DOWNCASE, out + n);
+    }
+    return n;
+}
+
+static inline int ascii_changes(u_char c, int kind)
+{
+    if (kind == CHAR_UPCASE) return (c >= 'a' && c <= 'z');
+    else                     return (c >= 'A' && c <= 'Z');
+}
+
+static inline u_char ascii_map(u_char c, int kind)
+{
+    return ascii_changes(c, kind) ? (c ^ 0x20) : c;
+}
+
+static ScmObj map_ascii(ScmString *s, const char *p, ScmSmallInt size,
+                        int kind)
+{
+    ScmSmallInt i;
+    for (i = 0; i < size; i++) {
+        if (ascii_changes((u_char)p[i], kind)) break;
+    }
+    if (i == size) return Scm_CopyString(s);
+
+    char *buf = SCM_NEW_ATOMIC2(char*, size + 1);
+    memcpy(buf, p, i);
+    for (; i < size; i++) buf[i] = (char)ascii_map((u_char)p[i], kind);
+    buf[size] = '\0';
+    return Scm_MakeString(buf, size, size, 0);
+}
+
+ScmObj Scm_StringCaseMap(ScmString *s, int kind)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(s);
+    if (SCM_STRING_BODY_INCOMPLETE_P(b)) return SCM_FALSE;
+    if (kind == CHAR_TITLECASE) return SCM_FALSE;
+
+    const char *start = SCM_STRING_BODY_START(b);
+    ScmSmallInt size = SCM_STRING_BODY_SIZE(b);
+    if (SCM_STRING_BODY_SINGLE_BYTE_P(b)) {
+        return map_ascii(s, start, size, kind);
+    }
+
+    const char *p = start, *end = start + size;
+    ScmChar mapped[MAX_MAPPED];
+    int n = 0;
+
+    /* Quick check */
+    while (p < end) {
+        u_char c = (u_char)*p;
+        if (c < 0x80) {
+            if (ascii_changes(c, kind)) break;
+            p++;
+            continue;
+        }
+        ScmChar ch;
+        SCM_CHAR_GET(p, ch);
+        if (ch == CAPITAL_SIGMA && kind == CHAR_DOWNCASE) return SCM_FALSE;
+        n = map_char(ch, kind, mapped);
+        if (n != 1 || mapped[0] != ch) break;
+        p += SCM_CHAR_NBYTES(ch);
+    }
+    if (p == end) return Scm_CopyString(s);
+
+    ScmDString ds;
+    Scm_DStringInit(&ds);
+    Scm_DStringPutz(&ds, start, p - start);
+    while (p < end) {
+        u_char c = (u_char)*p;
+        if (c < 0x80) {
+            SCM_DSTRING_PUTB(&ds, ascii_map(c, kind));
+            p++;
+            continue;
+        }
+        ScmChar ch;
+        SCM_CHAR_GET(p, ch);
+        if (ch == CAPITAL_SIGMA && kind == CHAR_DOWNCASE) return SCM_FALSE;
+        n = map_char(ch, kind, mapped);
+        for (int i = 0; i < n; i++) Scm_DStringPutc(&ds, mapped[i]);
+        p += SCM_CHAR_NBYTES(ch);
+    }
+    return Scm_DStringGet(&ds, 0);
+}
+
+#else  /*!GAUCHE_CHAR_ENCODING_UTF_8*/
+
+/* Scm__CharCaseMap works on Unicode codepoints, so we'd have to convert
+   each character anyway; the Scheme version does it. */
+ScmObj Scm_StringCaseMap(ScmString *s, int kind)
+{
+    return SCM_FALSE;
+}
+
+#endif /*!GAUCHE_CHAR_ENCODING_UTF_8*/
@@ -832,12 +832,11 @@
 
 (inline-stub
  "#include <gauche/char_attr.h>"
- "#define CHAR_UPCASE 0"
- "#define CHAR_DOWNCASE 1"
- "#define CHAR_TITLECASE 2"
+ (declcode "#include \"unicode.h\"")
  (define-enum CHAR_UPCASE)
  (define-enum CHAR_DOWNCASE)
  (define-enum CHAR_TITLECASE)
+ (define-enum CHAR_FOLDCASE)
 
  (define-cise-stmt fill-result
    [(_ to_x_full to_x_simple)
@@ -876,6 +875,10 @@
        )))
 
  (define-enum SCM_CHAR_FULL_CASE_MAPPING_SIZE)
+
+ ;; Returns #f if the string should be handled by string-xcase below.
+ (define-cproc %string-xcase (str::<string> kind::<int>)
+   (return (Scm_StringCaseMap str kind)))
  )
 
 ;; Common args in the following routines
@@ -974,10 +977,14 @@
     (get)))
 
 ;; APIs
-(define (string-upcase str)    (string-xcase str %upcase))
-(define (string-downcase str)  (string-xcase str %downcase))
+;; Upcase, downcase and foldcase are mostly done in C (unicode.c).
+(define (string-upcase str)
+  (or (%string-xcase str CHAR_UPCASE) (string-xcase str %upcase)))
+(define (string-downcase str)
+  (or (%string-xcase str CHAR_DOWNCASE) (string-xcase str %downcase)))
 (define (string-titlecase str) (string-xcase str %titlecase))
-(define (string-foldcase str)  (string-xcase str %foldcase))
+(define (string-foldcase str)
+  (or (%string-xcase str CHAR_FOLDCASE) (string-xcase str %foldcase)))
 
 (define (codepoints-upcase seq)    (codepoints-xcase seq %upcase))
 (define (codepoints-downcase seq)  (codepoints-xcase seq %downcase))
@@ -0,0 +1,77 @@
+/*
+ * iouring.h - io_uring interface
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef GAUCHE_IOURING_H
+#define GAUCHE_IOURING_H
+
+#include <gauche.h>
+
+#if defined(EXTIOURING_EXPORTS)
+#define LIBGAUCHE_EXT_BODY
+#endif
+#include <gauche/extern.h>      /* redefine SCM_EXTERN */
+
+#if defined(HAVE_LINUX_IO_URING_H)
+#define GAUCHE_IO_URING 1
+#endif
+
+/* <io-uring> is a pair of submission and completion queues shared with
+   the kernel.  The structure is private to iouring.c. */
+typedef struct ScmIoUringRec ScmIoUring;
+
+SCM_CLASS_DECL(Scm_IoUringClass);
+#define SCM_CLASS_IO_URING    (&Scm_IoUringClass)
+#define SCM_IO_URING(obj)     ((ScmIoUring*)(obj))
+#define SCM_IO_URING_P(obj)   (SCM_XTYPEP(obj, SCM_CLASS_IO_URING))
+
+extern ScmObj Scm_MakeIoUring(int entries);
+extern ScmObj Scm_IoUringPrepRead(ScmIoUring *ring, int fd, ScmUVector *buf,
+                                  int start, int end, off_t offset,
+                                  ScmObj entry);
+extern ScmObj Scm_IoUringPrepWrite(ScmIoUring *ring, int fd, ScmUVector *buf,
+                                   int start, int end, off_t offset,
+                                   ScmObj entry);
+extern ScmObj Scm_IoUringPrepAccept(ScmIoUring *ring, int fd,
+                                    ScmUVector *addrbuf, ScmObj entry);
+extern ScmObj Scm_IoUringPrepConnect(ScmIoUring *ring, int fd,
+                                     ScmUVector *addr, ScmObj entry);
+extern ScmObj Scm_IoUringPrepNop(ScmIoUring *ring, ScmObj entry);
+extern int    Scm_IoUringSubmit(ScmIoUring *ring, int wait_nr);
+extern ScmObj Scm_IoUringReap(ScmIoUring *ring, int max);
+extern ScmObj Scm_IoUringMakeAcceptBuffer(void);
+extern int    Scm_IoUringAcceptBufferLength(ScmUVector *buf);
+extern int    Scm_IoUringPendingCount(ScmIoUring *ring);
+extern void   Scm_IoUringClose(ScmIoUring *ring);
+
+#endif /* GAUCHE_IOURING_H */
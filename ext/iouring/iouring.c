@@ -0,0 +1,495 @@
+/*
+ * iouring.c - io_uring interface
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#define _GNU_SOURCE  /* for Linux, this enables additional features */
+
+#include <gauche.h>
+#include <gauche/class.h>
+#include <gauche/extend.h>
+#include <string.h>
+#include <errno.h>
+
+#include "gauche/iouring.h"
+
+#if defined(GAUCHE_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif /*GAUCHE_IO_URING*/
+
+/*
+ * We talk to the kernel directly with io_uring_setup(2) and
+ * io_uring_enter(2), instead of depending on liburing.
+ *
+ * The submission queue (SQ) and the completion queue (CQ) are rings
+ * shared with the kernel.  We're the only producer of SQ and the only
+ * consumer of CQ; the ring's mutex serializes the threads using the
+ * same ring.  The head/tail indexes shared with the kernel are accessed
+ * with acquire/release ordering.
+ *
+ * Each operation is identified by a fixnum id given in user_data.
+ * The Scheme-level entry of the operation (the handler and the buffers
+ * the kernel accesses) is kept in the pending table until the completion
+ * is reaped, so that GC won't reclaim the buffers while the kernel
+ * is still using them.
+ */
+
+struct ScmIoUringRec {
+    SCM_HEADER;
+    int fd;                     /* ring fd; -1 if closed */
+    ScmInternalMutex mutex;
+    ScmHashTable *pending;      /* id -> entry */
+    u_long next_id;
+    unsigned int to_submit;     /* # of prepared but unsubmitted SQEs */
+#if defined(GAUCHE_IO_URING)
+    unsigned int sq_entries;
+    unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+#endif /*GAUCHE_IO_URING*/
+};
+
+static void io_uring_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
+{
+    ScmIoUring *ring = SCM_IO_URING(obj);
+    Scm_Printf(port, "#<io-uring %d (%d pending)>", ring->fd,
+               Scm_IoUringPendingCount(ring));
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_IoUringClass, io_uring_print);
+
+#if defined(GAUCHE_IO_URING)
+
+#define LOAD_ACQUIRE(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static void ring_unmap(ScmIoUring *ring)
+{
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring) munmap(ring->sq_ring, ring->sq_ring_size);
+    ring->sqes = NULL;
+    ring->sq_ring = ring->cq_ring = NULL;
+}
+
+static void io_uring_finalize(ScmObj obj, void *data)
+{
+    ScmIoUring *ring = SCM_IO_URING(obj);
+    if (ring->fd >= 0) {
+        ring_unmap(ring);
+        close(ring->fd);
+        ring->fd = -1;
+    }
+}
+
+ScmObj Scm_MakeIoUring(int entries)
+{
+    struct io_uring_params params;
+    int fd;
+
+    if (entries <= 0) Scm_Error("entries must be positive, but got %d", entries);
+    memset(&params, 0, sizeof(params));
+    SCM_SYSCALL(fd, (int)syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) Scm_SysError("io_uring_setup failed");
+
+    ScmIoUring *ring = SCM_NEW(ScmIoUring);
+    SCM_SET_CLASS(ring, SCM_CLASS_IO_URING);
+    ring->fd = fd;
+    SCM_INTERNAL_MUTEX_INIT(ring->mutex);
+    ring->pending = SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQV, 0));
+    ring->next_id = 0;
+    ring->to_submit = 0;
+    ring->sq_entries = params.sq_entries;
+    ring->sq_ring = ring->cq_ring = NULL;
+    ring->sqes = NULL;
+
+    ring->sq_ring_size = params.sq_off.array
+        + params.sq_entries * sizeof(unsigned int);
+    ring->cq_ring_size = params.cq_off.cqes
+        + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    void *p = mmap(NULL, ring->sq_ring_size, PROT_READ|PROT_WRITE,
+                   MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (p == MAP_FAILED) goto mmap_failed;
+    ring->sq_ring = p;
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = p;
+    } else {
+        p = mmap(NULL, ring->cq_ring_size, PROT_READ|PROT_WRITE,
+                 MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (p == MAP_FAILED) goto mmap_failed;
+        ring->cq_ring = p;
+    }
+    p = mmap(NULL, ring->sqes_size, PROT_READ|PROT_WRITE,
+             MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (p == MAP_FAILED) goto mmap_failed;
+    ring->sqes = p;
+
+    char *sq = ring->sq_ring, *cq = ring->cq_ring;
+    ring->sq_head  = (unsigned int*)(sq + params.sq_off.head);
+    ring->sq_tail  = (unsigned int*)(sq + params.sq_off.tail);
+    ring->sq_mask  = (unsigned int*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned int*)(sq + params.sq_off.array);
+    ring->cq_head  = (unsigned int*)(cq + params.cq_off.head);
+    ring->cq_tail  = (unsigned int*)(cq + params.cq_off.tail);
+    ring->cq_mask  = (unsigned int*)(cq + params.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    Scm_RegisterFinalizer(SCM_OBJ(ring), io_uring_finalize, NULL);
+    return SCM_OBJ(ring);
+
+  mmap_failed:
+    {
+        int e = errno;
+        ring_unmap(ring);
+        close(fd);
+        ring->fd = -1;
+        errno = e;
+        Scm_SysError("mmap failed for io_uring");
+    }
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+/* Passes the prepared SQEs to the kernel, and waits for WAIT_NR
+   completions.  Must be called with the mutex held. */
+static int ring_enter(ScmIoUring *ring, unsigned int wait_nr)
+{
+    int r;
+    unsigned int flags = (wait_nr > 0)? IORING_ENTER_GETEVENTS : 0;
+    SCM_SYSCALL(r, (int)syscall(__NR_io_uring_enter, ring->fd,
+                                ring->to_submit, wait_nr, flags, NULL, 0));
+    if (r < 0) return r;
+    ring->to_submit -= (r < (int)ring->to_submit)? (unsigned int)r
+                                                 : ring->to_submit;
+    return r;
+}
+
+/* Returns a free SQE, submitting the prepared ones if the queue is full.
+   Must be called with the mutex held. */
+static struct io_uring_sqe *ring_get_sqe(ScmIoUring *ring)
+{
+    for (int retry = 0; retry < 2; retry++) {
+        unsigned int head = LOAD_ACQUIRE(ring->sq_head);
+        unsigned int tail = *ring->sq_tail;
+        if (tail - head < ring->sq_entries) {
+            struct io_uring_sqe *sqe = &ring->sqes[tail & *ring->sq_mask];
+            memset(sqe, 0, sizeof(*sqe));
+            return sqe;
+        }
+        if (ring_enter(ring, 0) < 0) return NULL;
+    }
+    errno = EBUSY;
+    return NULL;
+}
+
+/* Publishes the SQE obtained by ring_get_sqe. */
+static void ring_push_sqe(ScmIoUring *ring)
+{
+    unsigned int tail = *ring->sq_tail;
+    unsigned int idx = tail & *ring->sq_mask;
+    ring->sq_array[idx] = idx;
+    STORE_RELEASE(ring->sq_tail, tail + 1);
+    ring->to_submit++;
+}
+
+static void ring_check(ScmIoUring *ring)
+{
+    if (ring->fd < 0) Scm_Error("io_uring already closed: %S", ring);
+}
+
+/* Common part of preparing an operation.  Returns the id. */
+static ScmObj ring_prep(ScmIoUring *ring, int op, int fd,
+                        void *addr, unsigned int len, uint64_t off,
+                        ScmObj entry)
+{
+    ScmObj id = SCM_FALSE;
+    int err = 0;
+
+    ring_check(ring);
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(ring->mutex);
+    struct io_uring_sqe *sqe = ring_get_sqe(ring);
+    if (sqe == NULL) {
+        err = errno;
+    } else {
+        id = SCM_MAKE_INT(ring->next_id);
+        ring->next_id = (ring->next_id + 1) & SCM_SMALL_INT_MAX;
+        sqe->opcode = (uint8_t)op;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)addr;
+        sqe->len = len;
+        sqe->off = off;
+        sqe->user_data = (uint64_t)SCM_INT_VALUE(id);
+        if (op == IORING_OP_ACCEPT) sqe->accept_flags = SOCK_CLOEXEC;
+        Scm_HashTableSet(ring->pending, id, entry, 0);
+        ring_push_sqe(ring);
+    }
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    if (err) {
+        errno = err;
+        Scm_SysError("couldn't queue an operation to %S", ring);
+    }
+    return id;
+}
+
+static void *uvector_range(ScmUVector *buf, int start, int end,
+                           unsigned int *len)
+{
+    int size = Scm_UVectorSizeInBytes(buf);
+    SCM_CHECK_START_END(start, end, size);
+    *len = (unsigned int)(end - start);
+    return (char*)SCM_UVECTOR_ELEMENTS(buf) + start;
+}
+
+ScmObj Scm_IoUringPrepRead(ScmIoUring *ring, int fd, ScmUVector *buf,
+                           int start, int end, off_t offset, ScmObj entry)
+{
+    unsigned int len;
+    SCM_UVECTOR_CHECK_MUTABLE(buf);
+    void *p = uvector_range(buf, start, end, &len);
+    return ring_prep(ring, IORING_OP_READ, fd, p, len,
+                     (uint64_t)offset, entry);
+}
+
+ScmObj Scm_IoUringPrepWrite(ScmIoUring *ring, int fd, ScmUVector *buf,
+                            int start, int end, off_t offset, ScmObj entry)
+{
+    unsigned int len;
+    void *p = uvector_range(buf, start, end, &len);
+    return ring_prep(ring, IORING_OP_WRITE, fd, p, len,
+                     (uint64_t)offset, entry);
+}
+
+/* ADDRBUF receives the peer address, followed by its length as
+   socklen_t, which must be initialized by the caller. */
+ScmObj Scm_IoUringPrepAccept(ScmIoUring *ring, int fd, ScmUVector *addrbuf,
+                             ScmObj entry)
+{
+    int size = Scm_UVectorSizeInBytes(addrbuf);
+    if (size < (int)sizeof(socklen_t)) {
+        Scm_Error("address buffer too small: %S", addrbuf);
+    }
+    SCM_UVECTOR_CHECK_MUTABLE(addrbuf);
+    char *p = (char*)SCM_UVECTOR_ELEMENTS(addrbuf);
+    /* For accept, the address of socklen_t is passed in 'off'. */
+    return ring_prep(ring, IORING_OP_ACCEPT, fd, p, 0,
+                     (uint64_t)(uintptr_t)(p + size - sizeof(socklen_t)),
+                     entry);
+}
+
+ScmObj Scm_IoUringPrepConnect(ScmIoUring *ring, int fd, ScmUVector *addr,
+                              ScmObj entry)
+{
+    /* For connect, the length of the address is passed in 'off'. */
+    return ring_prep(ring, IORING_OP_CONNECT, fd, SCM_UVECTOR_ELEMENTS(addr),
+                     0, (uint64_t)Scm_UVectorSizeInBytes(addr), entry);
+}
+
+ScmObj Scm_IoUringPrepNop(ScmIoUring *ring, ScmObj entry)
+{
+    return ring_prep(ring, IORING_OP_NOP, -1, NULL, 0, 0, entry);
+}
+
+/* Submits the prepared operations with one system call, and waits
+   until at least WAIT_NR operations complete.  Returns the number of
+   submitted operations. */
+int Scm_IoUringSubmit(ScmIoUring *ring, int wait_nr)
+{
+    int r, err = 0;
+    ring_check(ring);
+    if (wait_nr < 0) wait_nr = 0;
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(ring->mutex);
+    /* Don't wait for completions that have already arrived. */
+    unsigned int ready = LOAD_ACQUIRE(ring->cq_tail) - *ring->cq_head;
+    if (ring->to_submit == 0 && (unsigned int)wait_nr <= ready) {
+        r = 0;
+    } else {
+        r = ring_enter(ring, (unsigned int)wait_nr);
+        if (r < 0) err = errno;
+    }
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    if (r < 0) {
+        errno = err;
+        Scm_SysError("io_uring_enter failed on %S", ring);
+    }
+    return r;
+}
+
+/* Takes at most MAX completions out of CQ (all of them if MAX <= 0).
+   Returns a list of (id entry result), where result is the return value
+   of the operation, or -errno. */
+ScmObj Scm_IoUringReap(ScmIoUring *ring, int max)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    int count = 0;
+    ring_check(ring);
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(ring->mutex);
+    unsigned int head = *ring->cq_head;
+    unsigned int tail = LOAD_ACQUIRE(ring->cq_tail);
+    for (; head != tail && (max <= 0 || count < max); head++) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        ScmObj id = SCM_MAKE_INT((ScmSmallInt)cqe->user_data);
+        ScmObj entry = Scm_HashTableRef(ring->pending, id, SCM_UNBOUND);
+        if (!SCM_UNBOUNDP(entry)) {
+            Scm_HashTableDelete(ring->pending, id);
+            SCM_APPEND1(h, t, SCM_LIST3(id, entry, SCM_MAKE_INT(cqe->res)));
+            count++;
+        }
+    }
+    STORE_RELEASE(ring->cq_head, head);
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    return h;
+}
+
+/* The buffer for accept holds sockaddr_storage followed by socklen_t. */
+ScmObj Scm_IoUringMakeAcceptBuffer(void)
+{
+    socklen_t len = sizeof(struct sockaddr_storage);
+    ScmObj buf = Scm_MakeU8Vector(sizeof(struct sockaddr_storage)
+                                  + sizeof(socklen_t), 0);
+    memcpy(SCM_U8VECTOR_ELEMENTS(buf) + sizeof(struct sockaddr_storage),
+           &len, sizeof(socklen_t));
+    return buf;
+}
+
+int Scm_IoUringAcceptBufferLength(ScmUVector *buf)
+{
+    socklen_t len;
+    if (Scm_UVectorSizeInBytes(buf)
+        != sizeof(struct sockaddr_storage) + sizeof(socklen_t)) {
+        Scm_Error("invalid accept buffer: %S", buf);
+    }
+    memcpy(&len, (char*)SCM_UVECTOR_ELEMENTS(buf)
+           + sizeof(struct sockaddr_storage), sizeof(socklen_t));
+    return (int)len;
+}
+
+void Scm_IoUringClose(ScmIoUring *ring)
+{
+    if (ring->fd < 0) return;
+    if (Scm_IoUringPendingCount(ring) > 0) {
+        /* The kernel may still be accessing the buffers. */
+        Scm_Error("can't close %S with operations in flight", ring);
+    }
+    int fd = ring->fd;
+    ring_unmap(ring);
+    ring->fd = -1;
+    Scm_UnregisterFinalizer(SCM_OBJ(ring));
+    if (close(fd) < 0) Scm_SysError("close failed on %S", ring);
+}
+
+#else  /*!GAUCHE_IO_URING*/
+
+static void not_supported(void)
+{
+    Scm_Error("io_uring isn't supported on this platform");
+}
+
+ScmObj Scm_MakeIoUring(int entries)
+{
+    not_supported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+#define DUMMY(decl) decl { not_supported(); return SCM_UNDEFINED; }
+DUMMY(ScmObj Scm_IoUringPrepRead(ScmIoUring *ring, int fd, ScmUVector *buf,
+                                 int start, int end, off_t offset,
+                                 ScmObj entry))
+DUMMY(ScmObj Scm_IoUringPrepWrite(ScmIoUring *ring, int fd, ScmUVector *buf,
+                                  int start, int end, off_t offset,
+                                  ScmObj entry))
+DUMMY(ScmObj Scm_IoUringPrepAccept(ScmIoUring *ring, int fd,
+                                   ScmUVector *addrbuf, ScmObj entry))
+DUMMY(ScmObj Scm_IoUringPrepConnect(ScmIoUring *ring, int fd,
+                                    ScmUVector *addr, ScmObj entry))
+DUMMY(ScmObj Scm_IoUringPrepNop(ScmIoUring *ring, ScmObj entry))
+DUMMY(ScmObj Scm_IoUringReap(ScmIoUring *ring, int max))
+#undef DUMMY
+
+int Scm_IoUringSubmit(ScmIoUring *ring, int wait_nr)
+{
+    not_supported();
+    return 0;                   /* dummy */
+}
+
+ScmObj Scm_IoUringMakeAcceptBuffer(void)
+{
+    not_supported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+int Scm_IoUringAcceptBufferLength(ScmUVector *buf)
+{
+    not_supported();
+    return 0;                   /* dummy */
+}
+
+void Scm_IoUringClose(ScmIoUring *ring)
+{
+}
+
+#endif /*!GAUCHE_IO_URING*/
+
+/* Returns the number of operations whose completions haven't been
+   reaped. */
+int Scm_IoUringPendingCount(ScmIoUring *ring)
+{
+    return Scm_HashCoreNumEntries(SCM_HASH_TABLE_CORE(ring->pending));
+}
+
+/*
+ * Initialization
+ */
+
+void Scm_Init_iouring(void)
+{
+    ScmModule *mod = SCM_FIND_MODULE("gauche.iouring", SCM_FIND_MODULE_CREATE);
+    Scm_InitStaticClass(&Scm_IoUringClass, "<io-uring>", mod, NULL, 0);
+#if defined(GAUCHE_IO_URING)
+    Scm_AddFeature("gauche.sys.io-uring", NULL);
+#endif
+}
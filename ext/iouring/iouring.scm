@@ -0,0 +1,187 @@
+;;;
+;;; iouring - io_uring interface
+;;;
+;;;   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+
+#!no-fold-case
+
+;; Asynchronous i/o with Linux io_uring.  Operations are queued to the
+;; submission queue, handed to the kernel in a batch by io-uring-submit
+;; or io-uring-wait, and their completions are dispatched to the handlers.
+
+(define-module gauche.iouring
+  (use data.queue)
+  (use gauche.net)
+  (export <io-uring> make-io-uring io-uring-close
+          io-uring-read! io-uring-write! io-uring-accept! io-uring-connect!
+          io-uring-nop! io-uring-submit io-uring-wait io-uring-poll
+          io-uring-pending-count)
+  )
+(select-module gauche.iouring)
+
+(inline-stub
+ (declcode "#include \"gauche/iouring.h\"")
+
+ (define-type <io-uring> "ScmIoUring*")
+
+ (define-cproc make-io-uring (:optional (entries::<fixnum> 64))
+   (return (Scm_MakeIoUring entries)))
+ (define-cproc io-uring-close (ring::<io-uring>) ::<void>
+   Scm_IoUringClose)
+
+ (define-cproc %prep-read (ring::<io-uring> port-or-fd buf::<uvector>
+                           start::<fixnum> end::<fixnum> offset::<integer>
+                           entry)
+   (return (Scm_IoUringPrepRead ring (Scm_GetPortFd port-or-fd TRUE)
+                                buf start end (Scm_IntegerToOffset offset)
+                                entry)))
+ (define-cproc %prep-write (ring::<io-uring> port-or-fd buf::<uvector>
+                            start::<fixnum> end::<fixnum> offset::<integer>
+                            entry)
+   (return (Scm_IoUringPrepWrite ring (Scm_GetPortFd port-or-fd TRUE)
+                                 buf start end (Scm_IntegerToOffset offset)
+                                 entry)))
+ (define-cproc %prep-accept (ring::<io-uring> fd::<int> addrbuf::<uvector>
+                             entry)
+   Scm_IoUringPrepAccept)
+ (define-cproc %prep-connect (ring::<io-uring> fd::<int> addr::<uvector>
+                              entry)
+   Scm_IoUringPrepConnect)
+ (define-cproc %prep-nop (ring::<io-uring> entry)
+   Scm_IoUringPrepNop)
+
+ (define-cproc io-uring-submit (ring::<io-uring>) ::<int>
+   (return (Scm_IoUringSubmit ring 0)))
+ (define-cproc %submit-and-wait (ring::<io-uring> wait-nr::<int>) ::<int>
+   Scm_IoUringSubmit)
+ (define-cproc %reap (ring::<io-uring> max::<int>)
+   Scm_IoUringReap)
+
+ (define-cproc io-uring-pending-count (ring::<io-uring>) ::<int>
+   Scm_IoUringPendingCount)
+
+ (define-cproc %make-accept-buffer () Scm_IoUringMakeAcceptBuffer)
+ (define-cproc %accept-buffer-length (buf::<uvector>) ::<int>
+   Scm_IoUringAcceptBufferLength)
+
+ (declcode "extern void Scm_Init_iouring(void);")
+ (initcode (Scm_Init_iouring)))
+
+;; Each queued operation has an entry (handler finisher . keep),
+;; where finisher converts a non-negative result before it is passed
+;; to the handler, and keep holds the objects the kernel accesses
+;; (the entry is retained by the ring until the completion is reaped).
+(define (make-entry handler finisher . keep)
+  (unless (or (applicable? handler <top>) (is-a? handler <mtqueue>))
+    (error "handler must be a procedure or an <mtqueue>, but got:" handler))
+  (list* handler finisher keep))
+
+(define (dispatch id entry result)
+  (let ([handler (car entry)]
+        [r (if (and (cadr entry) (>= result 0))
+             ((cadr entry) result)
+             result)])
+    (if (is-a? handler <mtqueue>)
+      (enqueue! handler (cons id r))
+      (handler r))))
+
+;; Completions are taken out one by one, so that if a handler raises
+;; an error, the rest remain in the ring for the next call.
+(define (dispatch-all ring)
+  (let loop ([n 0])
+    (let1 r (%reap ring 1)
+      (if (null? r)
+        n
+        (begin (apply dispatch (car r)) (loop (+ n 1)))))))
+
+(define (->fd port-or-fd)
+  (cond [(port? port-or-fd)
+         (when (output-port? port-or-fd) (flush port-or-fd))
+         port-or-fd]
+        [(is-a? port-or-fd <socket>)
+         (socket-fd port-or-fd)]
+        [else port-or-fd]))
+
+;; API
+(define (io-uring-read! ring port-or-fd buf handler
+                        :key (offset -1) (start 0) (end -1))
+  (%prep-read ring (->fd port-or-fd) buf start end offset
+              (make-entry handler #f buf)))
+
+;; API
+(define (io-uring-write! ring port-or-fd buf handler
+                         :key (offset -1) (start 0) (end -1))
+  (%prep-write ring (->fd port-or-fd) buf start end offset
+               (make-entry handler #f buf)))
+
+;; API
+;;  If LISTENER is a <socket>, the handler gets a connected <socket>.
+;;  If it is a file descriptor, the handler gets the new file descriptor.
+(define (io-uring-accept! ring listener handler)
+  (let1 addrbuf (%make-accept-buffer)
+    (if (integer? listener)
+      (%prep-accept ring listener addrbuf (make-entry handler #f addrbuf))
+      (%prep-accept ring (->fd listener) addrbuf
+                    (make-entry handler
+                                (^[fd] ((with-module gauche.net
+                                          %socket-accepted)
+                                        listener fd addrbuf
+                                        (%accept-buffer-length addrbuf)))
+                                addrbuf)))))
+
+;; API
+;;  SOCK must be a <socket>; the handler gets SOCK itself on success.
+(define (io-uring-connect! ring sock addr handler)
+  (let1 bytes ((with-module gauche.net %sockaddr-bytes) addr)
+    (%prep-connect ring (->fd sock) bytes
+                   (make-entry handler
+                               (^_ ((with-module gauche.net
+                                      %socket-connected!) sock addr))
+                               bytes))))
+
+;; API
+(define (io-uring-nop! ring handler)
+  (%prep-nop ring (make-entry handler #f)))
+
+;; API
+;;  Submits the queued operations, waits until at least MIN-COMPLETIONS
+;;  of them complete, and dispatches the completions.  Returns the number
+;;  of dispatched completions.
+(define (io-uring-wait ring :optional (min-completions 1))
+  (%submit-and-wait ring min-completions)
+  (dispatch-all ring))
+
+;; API
+;;  Like io-uring-wait, but doesn't block.
+(define (io-uring-poll ring)
+  (%submit-and-wait ring 0)
+  (dispatch-all ring))
@@ -0,0 +1,108 @@
+;;
+;; testing iouring
+;;
+
+#!no-fold-case
+
+(use gauche.test)
+(test-start "iouring")
+
+(use gauche.iouring)
+(test-module 'gauche.iouring)
+
+(use gauche.net)
+(use gauche.uvector)
+(use data.queue)
+
+;; The kernel may refuse io_uring (e.g. inside a container), in which case
+;; make-io-uring raises an error and we skip the rest.
+(define ring
+  (cond-expand
+   [gauche.sys.io-uring (guard (e [else #f]) (make-io-uring 8))]
+   [else #f]))
+
+(when ring
+  (test-section "basic")
+
+  (test* "nop" '(0 1 0)
+         (let* ([r #f]
+                [n (begin (io-uring-nop! ring (^x (set! r x)))
+                          (io-uring-wait ring))])
+           (list r n (io-uring-pending-count ring))))
+
+  (test* "nop to mtqueue" #t
+         (let* ([q (make-mtqueue)]
+                [id (io-uring-nop! ring q)])
+           (io-uring-wait ring)
+           (equal? (dequeue! q) (cons id 0))))
+
+  (test* "batch" '(0 0 0 0 0 0 0 0 0 0 0 0)
+         (let ([rs '()])
+           ;; more than the ring size, to exercise auto-submission
+           (dotimes [i 12] (io-uring-nop! ring (^x (push! rs x))))
+           (let loop ()
+             (when (< (length rs) 12)
+               (io-uring-wait ring)
+               (loop)))
+           rs))
+
+  (test-section "file i/o")
+
+  (sys-unlink "test.o")
+  (test* "write!" 10
+         (let ([r #f])
+           (call-with-output-file "test.o"
+             (^p (io-uring-write! ring p (string->u8vector "abcdefghij")
+                                  (^x (set! r x)))
+                 (io-uring-wait ring)))
+           r))
+  (test* "read! with offset" '(4 "cdef")
+         (let ([r #f] [buf (make-u8vector 4)])
+           (call-with-input-file "test.o"
+             (^p (io-uring-read! ring p buf (^x (set! r x)) :offset 2)
+                 (io-uring-wait ring)))
+           (list r (u8vector->string buf))))
+  (test* "read! error" (- EBADF)
+         (let ([r #f])
+           (io-uring-read! ring 999 (make-u8vector 4) (^x (set! r x)))
+           (io-uring-wait ring)
+           r))
+  (sys-unlink "test.o")
+
+  (test-section "sockets")
+
+  (let* ([server (make-server-socket 'inet 0 :reuse-addr? #t)]
+         [port (sockaddr-port (socket-getsockname server))]
+         [client (make-socket PF_INET SOCK_STREAM)]
+         [accepted #f]
+         [connected #f])
+    (io-uring-accept! ring server (^s (set! accepted s)))
+    (io-uring-connect! ring client
+                       (make <sockaddr-in> :host "127.0.0.1" :port port)
+                       (^s (set! connected s)))
+    (let loop ()
+      (unless (and accepted connected)
+        (io-uring-wait ring)
+        (loop)))
+    (test* "accept!" '(#t connected) (list (is-a? accepted <socket>)
+                                           (socket-status accepted)))
+    (test* "connect!" '(#t connected) (list (eq? connected client)
+                                            (socket-status client)))
+    (test* "write! and read!" "hello"
+           (let ([buf (make-u8vector 5)] [n 0])
+             (io-uring-write! ring client (string->u8vector "hello") (^_ #f))
+             (io-uring-read! ring accepted buf (^x (set! n x)))
+             (let loop ()
+               (when (positive? (io-uring-pending-count ring))
+                 (io-uring-wait ring)
+                 (loop)))
+             (u8vector->string buf 0 n)))
+    (socket-close accepted)
+    (socket-close client)
+    (socket-close server))
+
+  (test* "close" #t
+         (begin (io-uring-close ring) #t))
+  )
+
+(test-end)
@@ -0,0 +1,659 @@
+/*
+ * gauche-lz4.c - lz4 module
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gauche-lz4.h"
+#include <gauche/class.h>
+
+#if defined(GAUCHE_USE_PTHREADS)
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#define DEFAULT_BUFFER_SIZE  (64*1024)
+#define MINIMUM_BUFFER_SIZE  1024
+#define FRAME_CHUNK_SIZE     (1024*1024) /* per thread in parallel mode */
+#define MINIMUM_CHUNK_SIZE   (64*1024)
+
+/*================================================================
+ * Class stuff
+ */
+
+static ScmClass *port_cpl[] = {
+    SCM_CLASS_STATIC_PTR(Scm_PortClass),
+    SCM_CLASS_STATIC_PTR(Scm_TopClass),
+    NULL
+};
+
+SCM_DEFINE_BASE_CLASS(Scm_Lz4CompressingPortClass,
+                      ScmPort, /* instance type */
+                      NULL, NULL, NULL, NULL, port_cpl);
+
+SCM_DEFINE_BASE_CLASS(Scm_Lz4DecompressingPortClass,
+                      ScmPort, /* instance type */
+                      NULL, NULL, NULL, NULL, port_cpl);
+
+static void lz4_dict_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
+{
+    Scm_Printf(port, "#<lz4-dictionary %d bytes>",
+               SCM_U8VECTOR_SIZE(SCM_LZ4_DICT(obj)->data));
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_Lz4DictClass, lz4_dict_print);
+
+/*================================================================
+ * Common
+ */
+
+static void lz4_check(size_t r, const char *what)
+{
+    if (LZ4F_isError(r)) {
+        Scm_Error("%s failed: %s", what, LZ4F_getErrorName(r));
+    }
+}
+
+/* DATA must be a u8vector or a string. */
+static void data_bytes(ScmObj data, const void **start, size_t *size)
+{
+    if (SCM_U8VECTORP(data)) {
+        *start = SCM_UVECTOR_ELEMENTS(data);
+        *size = SCM_U8VECTOR_SIZE(data);
+    } else if (SCM_STRINGP(data)) {
+        const ScmStringBody *b = SCM_STRING_BODY(data);
+        *start = SCM_STRING_BODY_START(b);
+        *size = SCM_STRING_BODY_SIZE(b);
+    } else {
+        Scm_Error("u8vector or string required, but got: %S", data);
+    }
+}
+
+/* DICT may be #f, <lz4-dictionary>, or the dictionary content. */
+static ScmLz4Dict *get_dict(ScmObj dict)
+{
+    if (SCM_FALSEP(dict)) return NULL;
+    if (SCM_LZ4_DICT_P(dict)) return SCM_LZ4_DICT(dict);
+    if (SCM_U8VECTORP(dict) || SCM_STRINGP(dict)) {
+        const void *p; size_t n;
+        data_bytes(dict, &p, &n);
+        return SCM_LZ4_DICT(Scm_Lz4LoadDictionary(p, n));
+    }
+    Scm_Error("<lz4-dictionary>, u8vector or string required, but got: %S",
+              dict);
+    return NULL;                /* dummy */
+}
+
+static void init_prefs(LZ4F_preferences_t *prefs, int level, int checksump)
+{
+    memset(prefs, 0, sizeof(*prefs));
+    prefs->compressionLevel = level;
+    prefs->frameInfo.contentChecksumFlag =
+        checksump ? LZ4F_contentChecksumEnabled : LZ4F_noContentChecksum;
+}
+
+static ScmObj port_name(const char *type, ScmPort *remote)
+{
+    ScmObj out = Scm_MakeOutputStringPort(TRUE);
+    Scm_Printf(SCM_PORT(out), "[%s %A]", type, Scm_PortName(remote));
+    return Scm_GetOutputStringUnsafe(SCM_PORT(out), 0);
+}
+
+static int lz4_fileno(ScmPort *port)
+{
+    return Scm_PortFileNo(SCM_PORT_LZ4_INFO(port)->remote);
+}
+
+/*================================================================
+ * Parallel compression
+ *
+ *  liblz4 doesn't compress a frame with multiple threads.  Instead,
+ *  we split the data into chunks and compress each one into an
+ *  independent frame on its own thread, as lz4 -T does.  Concatenated
+ *  frames are a valid lz4 stream.  Worker threads only touch the
+ *  input data and malloc'ed memory.
+ */
+
+typedef struct FrameJobRec {
+    const char *src;
+    size_t len;
+    const LZ4F_preferences_t *prefs;
+    const LZ4F_CDict *cdict;
+    char *out;
+    size_t outlen;
+    const char *error;          /* non-NULL on failure */
+} FrameJob;
+
+static void compress_frame(FrameJob *job)
+{
+    LZ4F_preferences_t prefs = *job->prefs;
+    LZ4F_cctx *cctx = NULL;
+
+    prefs.frameInfo.contentSize = job->len;
+    size_t cap = LZ4F_compressFrameBound(job->len, &prefs);
+    job->out = malloc(cap);
+    if (job->out == NULL) {
+        job->error = "memory exhausted";
+        return;
+    }
+    size_t r = LZ4F_createCompressionContext(&cctx, LZ4F_VERSION);
+    if (!LZ4F_isError(r)) {
+        r = LZ4F_compressFrame_usingCDict(cctx, job->out, cap,
+                                          job->src, job->len,
+                                          job->cdict, &prefs);
+        LZ4F_freeCompressionContext(cctx);
+    }
+    if (LZ4F_isError(r)) {
+        job->error = LZ4F_getErrorName(r);
+    } else {
+        job->outlen = r;
+    }
+}
+
+#if defined(GAUCHE_USE_PTHREADS)
+static void *frame_worker(void *data)
+{
+    compress_frame((FrameJob*)data);
+    return NULL;
+}
+#endif /*GAUCHE_USE_PTHREADS*/
+
+/* Compresses [SRC, SRC+LEN) into frames with up to NTHREADS threads.
+   Returns a malloc'ed array of jobs and sets *NJOBS; the caller
+   must call free_frames. */
+static FrameJob *compress_frames(const char *src, size_t len, int nthreads,
+                                 const LZ4F_preferences_t *prefs,
+                                 const LZ4F_CDict *cdict, int *njobs)
+{
+    if (nthreads < 1) nthreads = 1;
+    size_t chunk = (len + nthreads - 1) / nthreads;
+    if (chunk < MINIMUM_CHUNK_SIZE) chunk = MINIMUM_CHUNK_SIZE;
+    int n = (len == 0) ? 1 : (int)((len + chunk - 1) / chunk);
+
+    FrameJob *jobs = calloc(n, sizeof(FrameJob));
+    if (jobs == NULL) Scm_Error("couldn't allocate memory for compression");
+    for (int i=0; i<n; i++) {
+        jobs[i].src = src + chunk*i;
+        jobs[i].len = (i == n-1) ? len - chunk*i : chunk;
+        jobs[i].prefs = prefs;
+        jobs[i].cdict = cdict;
+    }
+
+#if defined(GAUCHE_USE_PTHREADS)
+    if (n > 1) {
+        pthread_t *threads = calloc(n, sizeof(pthread_t));
+        char *started = calloc(n, 1);
+        sigset_t set, oset;
+        /* Workers shouldn't take signals meant for Scheme threads. */
+        sigfillset(&set);
+        pthread_sigmask(SIG_SETMASK, &set, &oset);
+        for (int i=1; i<n && threads && started; i++) {
+            started[i] =
+                (pthread_create(&threads[i], NULL, frame_worker, &jobs[i]) == 0);
+        }
+        pthread_sigmask(SIG_SETMASK, &oset, NULL);
+        compress_frame(&jobs[0]);
+        for (int i=1; i<n; i++) {
+            if (threads && started && started[i]) {
+                pthread_join(threads[i], NULL);
+            } else {
+                compress_frame(&jobs[i]); /* couldn't start a thread */
+            }
+        }
+        free(threads);
+        free(started);
+    } else {
+        compress_frame(&jobs[0]);
+    }
+#else  /*!GAUCHE_USE_PTHREADS*/
+    for (int i=0; i<n; i++) compress_frame(&jobs[i]);
+#endif /*!GAUCHE_USE_PTHREADS*/
+
+    *njobs = n;
+    return jobs;
+}
+
+static void free_frames(FrameJob *jobs, int njobs)
+{
+    for (int i=0; i<njobs; i++) free(jobs[i].out);
+    free(jobs);
+}
+
+/* Raises an error if any of the jobs failed.  JOBS are freed then. */
+static void check_frames(FrameJob *jobs, int njobs)
+{
+    for (int i=0; i<njobs; i++) {
+        if (jobs[i].error) {
+            const char *e = jobs[i].error;
+            free_frames(jobs, njobs);
+            Scm_Error("LZ4F_compressFrame failed: %s", e);
+        }
+    }
+}
+
+/*================================================================
+ * Compressing port
+ */
+
+static void put_output(ScmLz4Info *info, const char *data, size_t len)
+{
+    if (len > 0) {
+        Scm_Putz(data, (int)len, info->remote);
+        info->total_out += len;
+    }
+}
+
+/* Parallel mode: writes the buffered data as independent frames. */
+static void compress_parallel(ScmPort *port)
+{
+    ScmLz4Info *info = SCM_PORT_LZ4_INFO(port);
+    int njobs;
+    FrameJob *jobs = compress_frames(port->src.buf.buffer,
+                                     SCM_PORT_BUFFER_AVAIL(port),
+                                     info->nthreads, &info->prefs,
+                                     info->dict ? info->dict->cdict : NULL,
+                                     &njobs);
+    check_frames(jobs, njobs);
+    SCM_UNWIND_PROTECT {
+        for (int i=0; i<njobs; i++) {
+            put_output(info, jobs[i].out, jobs[i].outlen);
+        }
+    }
+    SCM_WHEN_ERROR {
+        free_frames(jobs, njobs);
+        SCM_NEXT_HANDLER;
+    }
+    SCM_END_PROTECT;
+    free_frames(jobs, njobs);
+    info->total_in += SCM_PORT_BUFFER_AVAIL(port);
+    info->started = TRUE;
+}
+
+/* Streaming mode: writes the frame header if it hasn't been. */
+static void compress_begin(ScmLz4Info *info)
+{
+    if (info->started) return;
+    size_t r;
+    if (info->dict) {
+        r = LZ4F_compressBegin_usingCDict(info->cctx, info->buf, info->bufsiz,
+                                          info->dict->cdict, &info->prefs);
+    } else {
+        r = LZ4F_compressBegin(info->cctx, info->buf, info->bufsiz,
+                               &info->prefs);
+    }
+    lz4_check(r, "LZ4F_compressBegin");
+    info->started = TRUE;
+    put_output(info, info->buf, r);
+}
+
+static int compress_flusher(ScmPort *port, int cnt, int forcep)
+{
+    ScmLz4Info *info = SCM_PORT_LZ4_INFO(port);
+    int avail = SCM_PORT_BUFFER_AVAIL(port);
+
+    if (info->nthreads > 1) {
+        if (avail > 0) compress_parallel(port);
+        return avail;
+    }
+    compress_begin(info);
+    size_t r = LZ4F_compressUpdate(info->cctx, info->buf, info->bufsiz,
+                                   port->src.buf.buffer, avail, NULL);
+    lz4_check(r, "LZ4F_compressUpdate");
+    put_output(info, info->buf, r);
+    info->total_in += avail;
+    if (forcep) {
+        r = LZ4F_flush(info->cctx, info->buf, info->bufsiz, NULL);
+        lz4_check(r, "LZ4F_flush");
+        put_output(info, info->buf, r);
+    }
+    return avail;
+}
+
+static void compress_finish(ScmPort *port)
+{
+    ScmLz4Info *info = SCM_PORT_LZ4_INFO(port);
+
+    if (info->nthreads > 1) {
+        /* Make sure we produce at least one frame. */
+        if (SCM_PORT_BUFFER_AVAIL(port) > 0 || !info->started) {
+            compress_parallel(port);
+        }
+        return;
+    }
+    compress_flusher(port, 0, FALSE);
+    size_t r = LZ4F_compressEnd(info->cctx, info->buf, info->bufsiz, NULL);
+    lz4_check(r, "LZ4F_compressEnd");
+    put_output(info, info->buf, r);
+}
+
+static void compress_closer(ScmPort *port)
+{
+    ScmLz4Info *info = SCM_PORT_LZ4_INFO(port);
+
+    if (info->cctx == NULL) return;
+    SCM_UNWIND_PROTECT {
+        compress_finish(port);
+    }
+    SCM_WHEN_ERROR {
+        LZ4F_freeCompressionContext(info->cctx);
+        info->cctx = NULL;
+        SCM_NEXT_HANDLER;
+    }
+    SCM_END_PROTECT;
+    LZ4F_freeCompressionContext(info->cctx);
+    info->cctx = NULL;
+    Scm_Flush(info->remote);
+    if (info->ownerp) {
+        Scm_ClosePort(info->remote);
+    }
+}
+
+ScmObj Scm_MakeLz4CompressingPort(ScmPort *drain, int level, ScmObj dict,
+                                  int nthreads, int checksump,
+                                  int bufsiz, int ownerp)
+{
+    ScmLz4Dict *d = get_dict(dict);
+    ScmLz4Info *info = SCM_NEW(ScmLz4Info);
+
+    if (nthreads < 1) nthreads = 1;
+    if (bufsiz <= 0) {
+        bufsiz = (nthreads > 1) ? FRAME_CHUNK_SIZE*nthreads
+                                : DEFAULT_BUFFER_SIZE;
+    } else if (bufsiz < MINIMUM_BUFFER_SIZE) {
+        bufsiz = MINIMUM_BUFFER_SIZE;
+    }
+
+    init_prefs(&info->prefs, level, checksump);
+    info->dctx = NULL;
+    info->remote = drain;
+    info->dict = d;
+    info->nthreads = nthreads;
+    info->ownerp = ownerp;
+    info->started = FALSE;
+    info->stream_endp = FALSE;
+    info->frame_rest = 0;
+    info->out_full = FALSE;
+    info->start = info->end = 0;
+    info->total_in = info->total_out = 0;
+    if (nthreads > 1) {
+        /* frames are compressed into malloc'ed buffers */
+        info->bufsiz = 0;
+        info->buf = NULL;
+    } else {
+        info->bufsiz = LZ4F_compressBound(bufsiz, &info->prefs)
+            + LZ4F_HEADER_SIZE_MAX;
+        info->buf = SCM_NEW_ATOMIC2(char *, info->bufsiz);
+    }
+    /* In parallel mode, the context only marks the port open. */
+    size_t r = LZ4F_createCompressionContext(&info->cctx, LZ4F_VERSION);
+    lz4_check(r, "LZ4F_createCompressionContext");
+
+    ScmPortBuffer bufrec;
+    memset(&bufrec, 0, sizeof(bufrec));
+    bufrec.size = bufsiz;
+    bufrec.buffer = SCM_NEW_ATOMIC2(char *, bufsiz);
+    bufrec.mode = SCM_PORT_BUFFER_FULL;
+    bufrec.filler = NULL;
+    bufrec.flusher = compress_flusher;
+    bufrec.closer = compress_closer;
+    bufrec.ready = NULL;
+    bufrec.filenum = lz4_fileno;
+    bufrec.data = (void*)info;
+
+    ScmObj name = port_name("lz4-compressing", drain);
+    return Scm_MakeBufferedPort(SCM_CLASS_LZ4_COMPRESSING_PORT, name,
+                                SCM_PORT_OUTPUT, TRUE, &bufrec);
+}
+
+/*================================================================
+ * Decompressing port
+ */
+
+static size_t decompress_step(LZ4F_dctx *dctx, ScmLz4Dict *dict,
+                              void *dst, size_t *dstlen,
+                              const void *src, size_t *srclen)
+{
+    if (dict) {
+        return LZ4F_decompress_usingDict(dctx, dst, dstlen, src, srclen,
+                                         SCM_UVECTOR_ELEMENTS(dict->data),
+                                         SCM_U8VECTOR_SIZE(dict->data),
+                                         NULL);
+    } else {
+        return LZ4F_decompress(dctx, dst, dstlen, src, srclen, NULL);
+    }
+}
+
+static int decompress_filler(ScmPort *port, int mincnt)
+{
+    ScmLz4Info *info = SCM_PORT_LZ4_INFO(port);
+    char *dst = port->src.buf.end;
+    size_t room = SCM_PORT_BUFFER_ROOM(port);
+    size_t produced = 0;
+
+    if (info->stream_endp) return 0;
+    while (produced == 0) {
+        if (info->start == info->end && !info->out_full) {
+            int n = Scm_Getz(info->buf, (int)info->bufsiz, info->remote);
+            if (n <= 0) {
+                info->stream_endp = TRUE;
+                if (info->frame_rest != 0) {
+                    Scm_Error("lz4 data is truncated: %S",
+                              Scm_PortName(info->remote));
+                }
+                break;
+            }
+            info->start = 0;
+            info->end = n;
+            info->total_in += n;
+        }
+        size_t dstlen = room;
+        size_t srclen = info->end - info->start;
+        size_t r = decompress_step(info->dctx, info->dict, dst, &dstlen,
+                                   info->buf + info->start, &srclen);
+        if (LZ4F_isError(r)) {
+            info->stream_endp = TRUE;
+            Scm_Error("lz4 data error in %S: %s",
+                      Scm_PortName(info->remote), LZ4F_getErrorName(r));
+        }
+        info->start += srclen;
+        info->frame_rest = r;
+        info->out_full = (dstlen == room);
+        produced = dstlen;
+    }
+    info->total_out += produced;
+    return (int)produced;
+}
+
+static void decompress_closer(ScmPort *port)
+{
+    ScmLz4Info *info = SCM_PORT_LZ4_INFO(port);
+    if (info->dctx == NULL) return;
+    LZ4F_freeDecompressionContext(info->dctx);
+    info->dctx = NULL;
+    if (info->ownerp) {
+        Scm_ClosePort(info->remote);
+    }
+}
+
+ScmObj Scm_MakeLz4DecompressingPort(ScmPort *source, ScmObj dict,
+                                    int bufsiz, int ownerp)
+{
+    ScmLz4Dict *d = get_dict(dict);
+    ScmLz4Info *info = SCM_NEW(ScmLz4Info);
+
+    if (bufsiz <= 0) bufsiz = DEFAULT_BUFFER_SIZE;
+    else if (bufsiz < MINIMUM_BUFFER_SIZE) bufsiz = MINIMUM_BUFFER_SIZE;
+
+    info->cctx = NULL;
+    info->remote = source;
+    info->dict = d;
+    info->nthreads = 1;
+    info->ownerp = ownerp;
+    info->started = FALSE;
+    info->stream_endp = FALSE;
+    info->frame_rest = 0;
+    info->out_full = FALSE;
+    info->bufsiz = DEFAULT_BUFFER_SIZE;
+    info->buf = SCM_NEW_ATOMIC2(char *, info->bufsiz);
+    info->start = info->end = 0;
+    info->total_in = info->total_out = 0;
+    size_t r = LZ4F_createDecompressionContext(&info->dctx, LZ4F_VERSION);
+    lz4_check(r, "LZ4F_createDecompressionContext");
+
+    ScmPortBuffer bufrec;
+    memset(&bufrec, 0, sizeof(bufrec));
+    bufrec.size = bufsiz;
+    bufrec.buffer = SCM_NEW_ATOMIC2(char *, bufsiz);
+    bufrec.mode = SCM_PORT_BUFFER_FULL;
+    bufrec.filler = decompress_filler;
+    bufrec.flusher = NULL;
+    bufrec.closer = decompress_closer;
+    bufrec.ready = NULL;
+    bufrec.filenum = lz4_fileno;
+    bufrec.data = (void*)info;
+
+    ScmObj name = port_name("lz4-decompressing", source);
+    return Scm_MakeBufferedPort(SCM_CLASS_LZ4_DECOMPRESSING_PORT, name,
+                                SCM_PORT_INPUT, TRUE, &bufrec);
+}
+
+/*================================================================
+ * One-shot compression
+ */
+
+ScmObj Scm_Lz4Compress(const void *data, size_t size, int level,
+                       ScmObj dict, int nthreads)
+{
+    ScmLz4Dict *d = get_dict(dict);
+    LZ4F_preferences_t prefs;
+    int njobs;
+
+    init_prefs(&prefs, level, FALSE);
+    FrameJob *jobs = compress_frames(data, size, nthreads, &prefs,
+                                     d ? d->cdict : NULL, &njobs);
+    check_frames(jobs, njobs);
+    size_t total = 0;
+    for (int i=0; i<njobs; i++) total += jobs[i].outlen;
+    ScmObj v = Scm_MakeU8Vector((ScmSmallInt)total, 0);
+    unsigned char *p = SCM_U8VECTOR_ELEMENTS(v);
+    for (int i=0; i<njobs; i++) {
+        memcpy(p, jobs[i].out, jobs[i].outlen);
+        p += jobs[i].outlen;
+    }
+    free_frames(jobs, njobs);
+    return v;
+}
+
+/* We don't rely on the content size in the frame header, since
+   there may be multiple frames. */
+ScmObj Scm_Lz4Decompress(const void *data, size_t size, ScmObj dict)
+{
+    ScmLz4Dict *d = get_dict(dict);
+    LZ4F_dctx *dctx;
+    size_t r = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+    lz4_check(r, "LZ4F_createDecompressionContext");
+
+    size_t cap = size*4 + 64, ipos = 0, opos = 0;
+    char *dst = malloc(cap);
+    const char *err = NULL;
+
+    while (dst != NULL) {
+        size_t dstlen = cap - opos, srclen = size - ipos;
+        r = decompress_step(dctx, d, dst + opos, &dstlen,
+                            (const char*)data + ipos, &srclen);
+        if (LZ4F_isError(r)) { err = LZ4F_getErrorName(r); break; }
+        ipos += srclen;
+        opos += dstlen;
+        if (ipos == size && opos < cap) {
+            if (r != 0 && size > 0) err = "data is truncated";
+            break;
+        }
+        if (opos == cap) {
+            char *p = realloc(dst, cap*2);
+            if (p == NULL) { free(dst); dst = NULL; break; }
+            dst = p;
+            cap *= 2;
+        }
+    }
+    LZ4F_freeDecompressionContext(dctx);
+    if (dst == NULL) Scm_Error("couldn't allocate memory for decompression");
+    if (err) {
+        free(dst);
+        Scm_Error("lz4 decompression failed: %s", err);
+    }
+    ScmObj v = Scm_MakeU8VectorFromArray((ScmSmallInt)opos,
+                                         (unsigned char*)dst);
+    free(dst);
+    return v;
+}
+
+/*================================================================
+ * Dictionaries
+ */
+
+static void lz4_dict_finalize(ScmObj obj, void *data)
+{
+    ScmLz4Dict *d = SCM_LZ4_DICT(obj);
+    if (d->cdict) {
+        LZ4F_freeCDict(d->cdict);
+        d->cdict = NULL;
+    }
+}
+
+/* Prepares the dictionary content once, so that it can be shared
+   by many compression.  Only the last 64KB of DATA is used. */
+ScmObj Scm_Lz4LoadDictionary(const void *data, size_t size)
+{
+    ScmObj v = Scm_MakeU8VectorFromArray((ScmSmallInt)size, data);
+    LZ4F_CDict *cdict = LZ4F_createCDict(SCM_U8VECTOR_ELEMENTS(v), size);
+    if (cdict == NULL) Scm_Error("couldn't load an lz4 dictionary");
+
+    ScmLz4Dict *d = SCM_NEW(ScmLz4Dict);
+    SCM_SET_CLASS(d, SCM_CLASS_LZ4_DICT);
+    d->cdict = cdict;
+    d->data = v;
+    Scm_RegisterFinalizer(SCM_OBJ(d), lz4_dict_finalize, NULL);
+    return SCM_OBJ(d);
+}
+
+/*
+ * Module initialization function.
+ */
+void Scm_Init_lz4(void)
+{
+    ScmModule *mod = SCM_MODULE(SCM_FIND_MODULE("rfc.lz4", TRUE));
+
+    Scm_InitStaticClass(&Scm_Lz4CompressingPortClass,
+                        "<lz4-compressing-port>", mod, NULL, 0);
+    Scm_InitStaticClass(&Scm_Lz4DecompressingPortClass,
+                        "<lz4-decompressing-port>", mod, NULL, 0);
+    Scm_InitStaticClass(&Scm_Lz4DictClass, "<lz4-dictionary>",
+                        mod, NULL, 0);
+}
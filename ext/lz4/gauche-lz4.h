@@ -0,0 +1,112 @@
+/*
+ * gauche-lz4.h - lz4 module
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Prologue */
+#ifndef GAUCHE_LZ4_H
+#define GAUCHE_LZ4_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+/* for dictionary support (LZ4F_CDict etc.) in lz4 1.9 */
+#define LZ4F_STATIC_LINKING_ONLY
+#include <lz4frame.h>
+
+#if defined(EXTLZ4_EXPORTS)
+#define LIBGAUCHE_EXT_BODY
+#endif
+#include <gauche/extern.h>      /* redefine SCM_EXTERN */
+
+SCM_DECL_BEGIN
+
+/* A dictionary prepared for repeated use.  LZ4 doesn't have a
+   dictionary ID; any data works as a dictionary. */
+typedef struct ScmLz4DictRec {
+    SCM_HEADER;
+    LZ4F_CDict *cdict;
+    ScmObj data;                /* u8vector, for decompression */
+} ScmLz4Dict;
+
+SCM_CLASS_DECL(Scm_Lz4DictClass);
+#define SCM_CLASS_LZ4_DICT       (&Scm_Lz4DictClass)
+#define SCM_LZ4_DICT(obj)        ((ScmLz4Dict*)(obj))
+#define SCM_LZ4_DICT_P(obj)      SCM_XTYPEP(obj, SCM_CLASS_LZ4_DICT)
+
+typedef struct ScmLz4InfoRec {
+    LZ4F_cctx *cctx;            /* for compressing port */
+    LZ4F_dctx *dctx;            /* for decompressing port */
+    ScmPort *remote;            /* source or drain port */
+    ScmLz4Dict *dict;           /* or NULL */
+    LZ4F_preferences_t prefs;
+    int nthreads;
+    int ownerp;
+    int started;                /* compressing: frame(s) written */
+    int stream_endp;
+    size_t frame_rest;          /* nonzero if a frame is incomplete */
+    int out_full;               /* decoder may have pending output */
+    char *buf;                  /* compressed data buffer */
+    size_t bufsiz;
+    size_t start;               /* decompressing: unconsumed data in */
+    size_t end;                 /*   buf[start, end) */
+    unsigned long total_in;
+    unsigned long total_out;
+} ScmLz4Info;
+
+#define SCM_PORT_LZ4_INFO(p) ((ScmLz4Info*)(p)->src.buf.data)
+
+SCM_CLASS_DECL(Scm_Lz4CompressingPortClass);
+#define SCM_CLASS_LZ4_COMPRESSING_PORT  (&Scm_Lz4CompressingPortClass)
+#define SCM_LZ4_COMPRESSING_PORT_P(obj) \
+    SCM_ISA(obj, SCM_CLASS_LZ4_COMPRESSING_PORT)
+SCM_CLASS_DECL(Scm_Lz4DecompressingPortClass);
+#define SCM_CLASS_LZ4_DECOMPRESSING_PORT  (&Scm_Lz4DecompressingPortClass)
+#define SCM_LZ4_DECOMPRESSING_PORT_P(obj) \
+    SCM_ISA(obj, SCM_CLASS_LZ4_DECOMPRESSING_PORT)
+
+extern ScmObj Scm_MakeLz4CompressingPort(ScmPort *drain, int level,
+                                         ScmObj dict, int nthreads,
+                                         int checksump, int bufsiz,
+                                         int ownerp);
+extern ScmObj Scm_MakeLz4DecompressingPort(ScmPort *source, ScmObj dict,
+                                           int bufsiz, int ownerp);
+
+extern ScmObj Scm_Lz4Compress(const void *data, size_t size, int level,
+                              ScmObj dict, int nthreads);
+extern ScmObj Scm_Lz4Decompress(const void *data, size_t size, ScmObj dict);
+extern ScmObj Scm_Lz4LoadDictionary(const void *data, size_t size);
+
+extern void Scm_Init_lz4(void);
+
+/* Epilogue */
+SCM_DECL_END
+
+#endif  /* GAUCHE_LZ4_H */
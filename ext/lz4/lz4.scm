@@ -0,0 +1,123 @@
+;;;
+;;; rfc.lz4 - LZ4 compression
+;;;
+;;;   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+
+#!no-fold-case
+
+(define-module rfc.lz4
+  (use gauche.uvector)
+  (export lz4-version lz4-max-level
+          <lz4-compressing-port> <lz4-decompressing-port>
+          open-lz4-compressing-port open-lz4-decompressing-port
+          lz4-total-in lz4-total-out
+          lz4-compress lz4-decompress
+          <lz4-dictionary> lz4-load-dictionary
+          ))
+(select-module rfc.lz4)
+
+(inline-stub
+ (declcode "#include \"gauche-lz4.h\"")
+ (initcode (Scm_Init_lz4))
+
+ (define-type <lz4-compressing-port> "ScmPort*" "lz4 compressing port"
+   "SCM_LZ4_COMPRESSING_PORT_P" "SCM_PORT")
+ (define-type <lz4-decompressing-port> "ScmPort*" "lz4 decompressing port"
+   "SCM_LZ4_DECOMPRESSING_PORT_P" "SCM_PORT")
+
+ "#define SCM_LZ4_PORT_P(x) (SCM_LZ4_COMPRESSING_PORT_P(x)||SCM_LZ4_DECOMPRESSING_PORT_P(x))"
+ ;; proxy type, like <xflating-port> in rfc.zlib
+ (define-type <lz4-port> "ScmPort*" "lz4 port"
+   "SCM_LZ4_PORT_P" "SCM_PORT")
+
+ (define-cfn data_element (data::ScmObj
+                           start::(const void**)
+                           siz::size_t*)
+   ::void :static
+   (cond [(SCM_U8VECTORP data)
+          (set! (* start) (SCM_UVECTOR_ELEMENTS (SCM_U8VECTOR data))
+                (* siz)   (SCM_U8VECTOR_SIZE (SCM_U8VECTOR data)))]
+         [(SCM_STRINGP data)
+          (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY data)])
+            (set! (* start) (SCM_STRING_BODY_START b)
+                  (* siz)   (SCM_STRING_BODY_SIZE b)))]
+         [else
+          (Scm_Error "u8vector or string required, but got: %S" data)]))
+
+ ;; LZ4F_getVersion returns major*10000 + minor*100 + release
+ (define-cproc lz4-version ()
+   (let* ([v::unsigned (LZ4F_getVersion)])
+     (return (Scm_Sprintf "%d.%d.%d" (/ v 10000) (% (/ v 100) 100)
+                          (% v 100)))))
+ (define-cproc lz4-max-level () ::<int> LZ4F_compressionLevel_max)
+
+ (define-cproc open-lz4-compressing-port (drain::<output-port>
+                                          :key (level::<fixnum> 0)
+                                          (dictionary #f)
+                                          (threads::<fixnum> 1)
+                                          (checksum #f)
+                                          (buffer-size::<fixnum> 0)
+                                          (owner? #f))
+   (return (Scm_MakeLz4CompressingPort drain level dictionary threads
+                                       (not (SCM_FALSEP checksum))
+                                       buffer-size
+                                       (not (SCM_FALSEP owner?)))))
+
+ (define-cproc open-lz4-decompressing-port (source::<input-port>
+                                            :key (dictionary #f)
+                                            (buffer-size::<fixnum> 0)
+                                            (owner? #f))
+   (return (Scm_MakeLz4DecompressingPort source dictionary buffer-size
+                                         (not (SCM_FALSEP owner?)))))
+
+ (define-cproc lz4-total-in (port::<lz4-port>) ::<ulong>
+   (return (-> (SCM_PORT_LZ4_INFO port) total_in)))
+ (define-cproc lz4-total-out (port::<lz4-port>) ::<ulong>
+   (return (-> (SCM_PORT_LZ4_INFO port) total_out)))
+
+ (define-cproc lz4-compress (data :key (level::<fixnum> 0)
+                                  (dictionary #f)
+                                  (threads::<fixnum> 1))
+   (let* ([start::(const void*)] [siz::size_t])
+     (data_element data (& start) (& siz))
+     (return (Scm_Lz4Compress start siz level dictionary threads))))
+
+ (define-cproc lz4-decompress (data :key (dictionary #f))
+   (let* ([start::(const void*)] [siz::size_t])
+     (data_element data (& start) (& siz))
+     (return (Scm_Lz4Decompress start siz dictionary))))
+
+ (define-cproc lz4-load-dictionary (data)
+   (let* ([start::(const void*)] [siz::size_t])
+     (data_element data (& start) (& siz))
+     (return (Scm_Lz4LoadDictionary start siz))))
+ )
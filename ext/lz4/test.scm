@@ -0,0 +1,128 @@
+;;;
+;;; Test lz4
+;;;
+
+#!no-fold-case
+
+(use gauche.test)
+(use gauche.uvector)
+
+(test-start "rfc.lz4")
+
+;; bail out if we aren't configured to build lz4
+(unless (file-exists? (string-append "rfc--lz4." (gauche-dso-suffix)))
+  (test-end)
+  (exit 0))
+
+(load "./lz4")
+(import rfc.lz4)
+(test-module 'rfc.lz4)
+
+(test* "lz4-version" #t (boolean (#/^\d+\.\d+\.\d+$/ (lz4-version))))
+(test* "lz4-max-level" #t (> (lz4-max-level) 0))
+
+(define *data*
+  (with-output-to-string
+    (^[] (dotimes [i 100000] (format #t "~a:~a " i (* i i))))))
+
+;;------------------------------------------------------------------
+(test-section "one-shot")
+
+(test* "lz4-compress" #t
+       (< (u8vector-length (lz4-compress *data*)) (string-size *data*)))
+(test* "lz4-compress/decompress" *data*
+       (u8vector->string (lz4-decompress (lz4-compress *data*))))
+(test* "lz4-compress/decompress (u8vector)" '#u8(1 2 3 0 255)
+       (lz4-decompress (lz4-compress '#u8(1 2 3 0 255))))
+(test* "lz4-compress/decompress (empty)" '#u8()
+       (lz4-decompress (lz4-compress "")))
+(test* "lz4-compress :level" *data*
+       (u8vector->string
+        (lz4-decompress (lz4-compress *data* :level (lz4-max-level)))))
+(test* "lz4-compress :level (acceleration)" *data*
+       (u8vector->string (lz4-decompress (lz4-compress *data* :level -5))))
+(test* "lz4-compress :threads" *data*
+       (u8vector->string (lz4-decompress (lz4-compress *data* :threads 4))))
+(test* "lz4-decompress (truncated)" (test-error)
+       (let1 v (lz4-compress *data*)
+         (lz4-decompress (u8vector-copy v 0 (quotient (u8vector-length v) 2)))))
+(test* "lz4-decompress (garbage)" (test-error)
+       (lz4-decompress "this isn't lz4 data"))
+
+;;------------------------------------------------------------------
+(test-section "ports")
+
+(define (compress-via-port str . args)
+  (call-with-output-string
+    (^p (let1 p2 (apply open-lz4-compressing-port p args)
+          (display str p2)
+          (close-output-port p2)))))
+(define (decompress-via-port str . args)
+  (port->string (apply open-lz4-decompressing-port
+                       (open-input-string str) args)))
+
+(test* "<lz4-compressing-port>" <lz4-compressing-port>
+       (class-of (open-lz4-compressing-port (open-output-string))))
+(test* "port-name" "[lz4-compressing (output string port)]"
+       (port-name (open-lz4-compressing-port (open-output-string))))
+(test* "compressing port" *data*
+       (u8vector->string (lz4-decompress (compress-via-port *data*))))
+(test* "compressing port :checksum" *data*
+       (u8vector->string
+        (lz4-decompress (compress-via-port *data* :checksum #t))))
+(test* "compressing port :threads" *data*
+       (u8vector->string
+        (lz4-decompress (compress-via-port *data* :threads 3
+                                           :buffer-size 300000))))
+(test* "compressing port :threads (empty)" '#u8()
+       (lz4-decompress (compress-via-port "" :threads 2)))
+(test* "decompressing port" *data*
+       (decompress-via-port (u8vector->string (lz4-compress *data*))))
+(test* "decompressing port :buffer-size" *data*
+       (decompress-via-port (compress-via-port *data*) :buffer-size 1024))
+(test* "decompressing port (empty)" ""
+       (decompress-via-port ""))
+(test* "decompressing port (truncated)" (test-error)
+       (let1 s (compress-via-port *data*)
+         (decompress-via-port (string-copy s 0 (quotient (string-size s) 2)))))
+
+(test* "lz4-total-in/out" (list (string-size *data*) #t)
+       (let* ([out (open-output-string)]
+              [p (open-lz4-compressing-port out)])
+         (display *data* p)
+         (close-output-port p)
+         (list (lz4-total-in p)
+               (= (lz4-total-out p) (string-size (get-output-string out))))))
+
+(test* "owner?" '(#f #t)
+       (map (^[owner?]
+              (let1 p (open-output-string)
+                (close-output-port (open-lz4-compressing-port p :owner? owner?))
+                (port-closed? p)))
+            '(#f #t)))
+
+;;------------------------------------------------------------------
+(test-section "dictionary")
+
+(define *dict*
+  (string-join (map (^i (format "{\"id\":~a,\"name\":\"user~a\"}" i i))
+                    (iota 200))))
+
+(let ([msg "{\"id\":12345,\"name\":\"user12345\"}"])
+  (test* "compress with dictionary" msg
+         (u8vector->string
+          (lz4-decompress (lz4-compress msg :dictionary *dict*)
+                          :dictionary *dict*)))
+  (let1 d (lz4-load-dictionary *dict*)
+    (test* "lz4-load-dictionary" #t (is-a? d <lz4-dictionary>))
+    (test* "loaded dictionary" msg
+           (u8vector->string
+            (lz4-decompress (lz4-compress msg :dictionary d) :dictionary d)))
+    (test* "ports with dictionary" msg
+           (decompress-via-port (compress-via-port msg :dictionary d)
+                                :dictionary *dict*))))
+
+(test* "bad dictionary" (test-error)
+       (lz4-compress "abc" :dictionary 'foo))
+
+(test-end)
@@ -42,7 +42,19 @@
           mt-random-integer
           mt-random-fill-u32vector!
           mt-random-fill-f32vector!
-          mt-random-fill-f64vector!)
+          mt-random-fill-f64vector!
+
+          <sfmt>
+          sfmt-random-set-seed!
+          sfmt-random-get-state
+          sfmt-random-set-state!
+          sfmt-random-real
+          sfmt-random-real0
+          sfmt-random-integer
+          sfmt-random-fill-u32vector!
+          sfmt-random-fill-f64vector!
+          sfmt-random-jump!
+          sfmt-random-split)
   )
 (select-module math.mt-random)
 
@@ -106,22 +118,101 @@
      (return (SCM_OBJ v))))
  )
 
-(define (%get-nword-random-int mt n)
-  (let loop ([i 0] [r (%mt-random-uint32 mt)])
+;;
+;; SFMT
+;;
+
+(inline-stub
+ (declcode "#include \"sfmt.h\"")
+ (initcode (Scm_Init_sfmt))
+
+ (define-type <sfmt> "ScmSFMT*")
+
+ (define-cproc sfmt-random-set-seed! (s::<sfmt> init) ::<void>
+   Scm_SFMTSetSeed)
+
+ (define-cproc sfmt-random-get-state (s::<sfmt>)
+   (let* ([v (Scm_MakeU32Vector (+ SCM_SFMT_N32 1) 0)])
+     (dotimes [i SCM_SFMT_N32]
+       (set! (aref (SCM_U32VECTOR_ELEMENTS v) i) (aref (-> s state) i)))
+     (set! (aref (SCM_U32VECTOR_ELEMENTS v) SCM_SFMT_N32) (-> s idx))
+     (return v)))
+
+ (define-cproc sfmt-random-set-state! (s::<sfmt> state::<u32vector>) ::<void>
+   (unless (== (SCM_U32VECTOR_SIZE state) (+ SCM_SFMT_N32 1))
+     (Scm_Error "u32vector of length %d is required, but got length %d"
+                (+ SCM_SFMT_N32 1) (SCM_U32VECTOR_SIZE state)))
+   (unless (<= (aref (SCM_U32VECTOR_ELEMENTS state) SCM_SFMT_N32)
+               SCM_SFMT_N32)
+     (Scm_Error "invalid SFMT state: %S" state))
+   (dotimes [i SCM_SFMT_N32]
+     (set! (aref (-> s state) i) (aref (SCM_U32VECTOR_ELEMENTS state) i)))
+   (set! (-> s idx) (aref (SCM_U32VECTOR_ELEMENTS state) SCM_SFMT_N32)))
+
+ (define-cproc sfmt-random-real (s::<sfmt>) ::<double>
+   (return (Scm_SFMTGenrandF64 s TRUE)))
+
+ (define-cproc sfmt-random-real0 (s::<sfmt>) ::<double>
+   (return (Scm_SFMTGenrandF64 s FALSE)))
+
+ ;; N must be in [1, 2^32].
+ (define-cproc %sfmt-random-integer (s::<sfmt> n) ::<ulong>
+   (return (Scm_SFMTGenrandBelow s (Scm_GetIntegerU64 n))))
+
+ (define-cproc %sfmt-random-uint32 (s::<sfmt>) ::<ulong>
+   Scm_SFMTGenrandU32)
+
+ (define-cproc sfmt-random-fill-u32vector! (s::<sfmt> v::<u32vector>)
+   (Scm_SFMTFillU32 s (SCM_U32VECTOR_ELEMENTS v) (SCM_U32VECTOR_SIZE v))
+   (return (SCM_OBJ v)))
+
+ (define-cproc sfmt-random-fill-f64vector! (s::<sfmt> v::<f64vector>)
+   (Scm_SFMTFillF64 s (SCM_F64VECTOR_ELEMENTS v) (SCM_F64VECTOR_SIZE v) TRUE)
+   (return (SCM_OBJ v)))
+
+ (define-cproc sfmt-random-jump! (s::<sfmt> n) ::<void>
+   Scm_SFMTJumpOutputs)
+ )
+
+(define (%get-nword-random-int next n)
+  (let loop ([i 0] [r (next)])
     (if (= i n)
       r
       (loop (+ i 1)
-            (+ (ash r 32) (%mt-random-uint32 mt))))))
+            (+ (ash r 32) (next))))))
+
+;; Returns a random integer in [0, n-1] for N > 2^32, using NEXT
+;; to get 32-bit random words.
+(define (%large-random-integer next n)
+  (let* ([siz (ash (integer-length n) -5)]
+         [q   (quotient (ash 1 (* 32 (+ siz 1))) n)]
+         [qn  (* q n)])
+    (let loop ([r (%get-nword-random-int next siz)])
+      (if (< r qn)
+        (quotient r q)
+        (loop (%get-nword-random-int next siz))))))
 
 (define (mt-random-integer mt n)
   (when (not (positive? n)) (error "invalid range" n))
   (if (<= n #x100000000)
     (%mt-random-integer mt n)
-    (let* ([siz (ash (integer-length n) -5)]
-           [q   (quotient (ash 1 (* 32 (+ siz 1))) n)]
-           [qn  (* q n)])
-      (let loop ([r (%get-nword-random-int mt siz)])
-        (if (< r qn)
-          (quotient r q)
-          (loop (%get-nword-random-int mt siz)))))))
+    (%large-random-integer (cut %mt-random-uint32 mt) n)))
+
+(define (sfmt-random-integer s n)
+  (when (not (positive? n)) (error "invalid range" n))
+  (if (<= n #x100000000)
+    (%sfmt-random-integer s n)
+    (%large-random-integer (cut %sfmt-random-uint32 s) n)))
 
+;; Returns a list of K generators for parallel streams.  The first one
+;; starts where S is, and each of the rest starts DISTANCE 32-bit words
+;; after the previous one.  S itself is advanced past all of them, so it
+;; can keep being used without overlapping.
+(define (sfmt-random-split s k :optional (distance (expt 2 64)))
+  (let loop ([i 0] [r '()])
+    (if (= i k)
+      (reverse! r)
+      (let1 g (make <sfmt>)
+        (sfmt-random-set-state! g (sfmt-random-get-state s))
+        (sfmt-random-jump! s distance)
+        (loop (+ i 1) (cons g r))))))
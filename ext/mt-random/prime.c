@@ -0,0 +1,452 @@
+/*
+ * prime.c - native prime sieve and primality tests for math.prime
+ *
+ *   Copyright (c) 2013-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "prime.h"
+
+/*================================================================
+ * Segmented sieve
+ *
+ *  Only odd numbers are represented, one bit each.  The range is
+ *  sieved in chunks of CHUNK_BITS bits, so that the part of the
+ *  bitmap being marked stays in the cache.  Each chunk covers a
+ *  disjoint range of bytes, so the chunks can be sieved in parallel
+ *  without locking.
+ *
+ *  The odd primes up to sqrt(end) are needed.  We keep them in a
+ *  global table, which is extended as needed.  The table is a GC'ed
+ *  atomic array which is never modified once published, so a sieve
+ *  can keep using the one it got even if another thread replaces it.
+ */
+
+#define CHUNK_BITS  (32*1024*8)
+
+/* Marks off composites in the chunk of NBITS bits starting at BITS,
+   representing odd numbers from S.  BP[0..NBP-1] are odd primes in
+   ascending order, which must include all the odd primes up to the
+   square root of the last number in the chunk. */
+static void sieve_chunk(unsigned char *bits, ScmUInt64 s, ScmSmallInt nbits,
+                        const ScmUInt32 *bp, ScmSmallInt nbp)
+{
+    ScmUInt64 last = s + 2*(ScmUInt64)(nbits-1);
+
+    memset(bits, 0xff, (nbits+7)/8);
+    if (nbits % 8) bits[nbits/8] &= (unsigned char)((1u << (nbits%8)) - 1);
+    if (s == 1) bits[0] &= ~1u;
+
+    for (ScmSmallInt k = 0; k < nbp; k++) {
+        ScmUInt64 p = bp[k];
+        ScmUInt64 off;
+        if (p*p > last) break;
+        if (p*p >= s) {
+            off = p*p - s;
+        } else {
+            ScmUInt64 r = s % p;
+            off = r ? p - r : 0;
+            if (off & 1) off += p;   /* s+off must be an odd multiple */
+        }
+        for (ScmUInt64 i = off/2; i < (ScmUInt64)nbits; i += p) {
+            bits[i>>3] &= (unsigned char)~(1u << (i&7));
+        }
+    }
+}
+
+/* floor(sqrt(n)) */
+static ScmUInt64 isqrt64(ScmUInt64 n)
+{
+    ScmUInt64 r = (ScmUInt64)sqrt((double)n);
+    while (r > 0xffffffffUL || r*r > n) r--;
+    while (r < 0xffffffffUL && (r+1)*(r+1) <= n) r++;
+    return r;
+}
+
+static struct {
+    ScmUInt32 *primes;          /* odd primes up to limit */
+    ScmSmallInt count;
+    ScmUInt64 limit;
+    ScmInternalMutex mutex;
+} base_primes;
+
+/* Odd primes up to 65536 by the plain sieve; enough to sieve up to
+   2^32. */
+static ScmUInt32 *seed_primes(ScmSmallInt *count)
+{
+    static ScmUInt32 *primes = NULL;
+    static ScmSmallInt nprimes = 0;
+
+    if (primes == NULL) {
+        enum { LIM = 65536 };
+        unsigned char *comp = SCM_NEW_ATOMIC_ARRAY(unsigned char, LIM);
+        ScmUInt32 *ps = SCM_NEW_ATOMIC_ARRAY(ScmUInt32, 6542);
+        ScmSmallInt n = 0;
+        memset(comp, 0, LIM);
+        for (ScmUInt32 i = 3; i < LIM; i += 2) {
+            if (comp[i]) continue;
+            ps[n++] = i;
+            for (ScmUInt32 j = i*i; j < LIM; j += 2*i) comp[j] = 1;
+        }
+        nprimes = n;
+        primes = ps;            /* idempotent; no need to lock */
+    }
+    *count = nprimes;
+    return primes;
+}
+
+/* Returns the odd primes up to at least LIMIT (<= 2^32).  The number
+   of primes is stored in *COUNT. */
+static const ScmUInt32 *get_base_primes(ScmUInt64 limit, ScmSmallInt *count)
+{
+    const ScmUInt32 *r = NULL;
+    ScmUInt64 cur;
+
+    SCM_INTERNAL_MUTEX_LOCK(base_primes.mutex);
+    cur = base_primes.limit;
+    if (cur >= limit) {
+        r = base_primes.primes;
+        *count = base_primes.count;
+    }
+    SCM_INTERNAL_MUTEX_UNLOCK(base_primes.mutex);
+    if (r) return r;
+
+    /* Grow geometrically, so that a sequence of sieves with increasing
+       ranges doesn't redo this every time. */
+    ScmUInt64 lim = cur * 2;
+    if (lim < limit) lim = limit;
+    if (lim < 65536) lim = 65536;
+    if (lim > 0xffffffffUL) lim = 0xffffffffUL;
+
+    ScmSmallInt nseed;
+    const ScmUInt32 *seed = seed_primes(&nseed);
+    /* pi(x) < 1.25506 x / ln x */
+    ScmSmallInt cap = (ScmSmallInt)(1.25506 * (double)lim / log((double)lim)) + 16;
+    ScmUInt32 *ps = SCM_NEW_ATOMIC_ARRAY(ScmUInt32, cap);
+    unsigned char *bits = SCM_NEW_ATOMIC_ARRAY(unsigned char, CHUNK_BITS/8);
+    ScmSmallInt n = 0;
+
+    for (ScmUInt64 s = 3; s <= lim; s += 2*(ScmUInt64)CHUNK_BITS) {
+        ScmSmallInt nbits = CHUNK_BITS;
+        if ((lim - s)/2 + 1 < (ScmUInt64)nbits) nbits = (lim - s)/2 + 1;
+        sieve_chunk(bits, s, nbits, seed, nseed);
+        for (ScmSmallInt i = 0; i < nbits; i++) {
+            if (bits[i>>3] & (1u << (i&7))) ps[n++] = (ScmUInt32)(s + 2*i);
+        }
+    }
+
+    SCM_INTERNAL_MUTEX_LOCK(base_primes.mutex);
+    if (base_primes.limit < lim) {
+        base_primes.primes = ps;
+        base_primes.count = n;
+        base_primes.limit = lim;
+    }
+    r = base_primes.primes;
+    *count = base_primes.count;
+    SCM_INTERNAL_MUTEX_UNLOCK(base_primes.mutex);
+    return r;
+}
+
+typedef struct SieveJobRec {
+    unsigned char *bits;
+    ScmUInt64 start;
+    ScmSmallInt nbits;
+    ScmSmallInt nchunks;
+    const ScmUInt32 *bp;
+    ScmSmallInt nbp;
+#if defined(GAUCHE_USE_PTHREADS)
+    pthread_mutex_t mutex;
+#endif
+    ScmSmallInt next;           /* next chunk to take */
+} SieveJob;
+
+static void sieve_job_chunk(SieveJob *job, ScmSmallInt c)
+{
+    ScmSmallInt i = c * CHUNK_BITS;
+    ScmSmallInt nbits = job->nbits - i;
+    if (nbits > CHUNK_BITS) nbits = CHUNK_BITS;
+    sieve_chunk(job->bits + i/8, job->start + 2*(ScmUInt64)i, nbits,
+                job->bp, job->nbp);
+}
+
+#if defined(GAUCHE_USE_PTHREADS)
+
+#include <signal.h>
+
+/* Runs on a worker thread, as well as the calling thread.  Only
+   touches the memory the calling thread keeps alive. */
+static void *sieve_worker(void *data)
+{
+    SieveJob *job = (SieveJob*)data;
+    for (;;) {
+        pthread_mutex_lock(&job->mutex);
+        ScmSmallInt c = job->next++;
+        pthread_mutex_unlock(&job->mutex);
+        if (c >= job->nchunks) break;
+        sieve_job_chunk(job, c);
+    }
+    return NULL;
+}
+
+static void sieve_parallel(SieveJob *job, int nthreads)
+{
+    pthread_t *threads = SCM_NEW_ATOMIC_ARRAY(pthread_t, nthreads);
+    int nstarted = 0;
+
+    pthread_mutex_init(&job->mutex, NULL);
+    job->next = 0;
+
+    /* Workers inherit the signal mask; they shouldn't take signals
+       meant for Scheme threads. */
+    sigset_t set, oset;
+    sigfillset(&set);
+    pthread_sigmask(SIG_SETMASK, &set, &oset);
+    for (int i=0; i<nthreads-1; i++) {
+        /* If we can't create more threads, we just do with fewer. */
+        if (pthread_create(&threads[i], NULL, sieve_worker, job) != 0) break;
+        nstarted++;
+    }
+    pthread_sigmask(SIG_SETMASK, &oset, NULL);
+
+    sieve_worker(job);
+    for (int i=0; i<nstarted; i++) pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&job->mutex);
+}
+
+#endif /*GAUCHE_USE_PTHREADS*/
+
+ScmObj Scm_PrimeSieve(ScmUInt64 start, ScmUInt64 end, int nthreads)
+{
+    if (!(start & 1)) Scm_Error("start must be odd, but got %S",
+                               Scm_MakeIntegerU64(start));
+    if (end <= start) return Scm_MakeU8Vector(0, 0);
+
+    ScmUInt64 nbits64 = (end - start + 1)/2;
+    if (nbits64 > (ScmUInt64)(SCM_SMALL_INT_MAX - 7)) {
+        Scm_Error("range too large: [%S, %S)",
+                  Scm_MakeIntegerU64(start), Scm_MakeIntegerU64(end));
+    }
+
+    SieveJob job;
+    job.start = start;
+    job.nbits = (ScmSmallInt)nbits64;
+    job.nchunks = (job.nbits + CHUNK_BITS - 1) / CHUNK_BITS;
+    job.bp = get_base_primes(isqrt64(end - 1), &job.nbp);
+
+    ScmObj v = Scm_MakeU8Vector((job.nbits+7)/8, 0);
+    job.bits = SCM_U8VECTOR_ELEMENTS(v);
+
+#if defined(GAUCHE_USE_PTHREADS)
+    if (nthreads > job.nchunks) nthreads = (int)job.nchunks;
+    if (nthreads > 1) {
+        sieve_parallel(&job, nthreads);
+        return v;
+    }
+#endif /*GAUCHE_USE_PTHREADS*/
+    for (ScmSmallInt c = 0; c < job.nchunks; c++) sieve_job_chunk(&job, c);
+    return v;
+}
+
+/*================================================================
+ * Primality tests for N < 2^64
+ *
+ *  These don't allocate; all the arithmetic is done in 64bit words,
+ *  with 128bit intermediate products where the compiler has them.
+ */
+
+static inline ScmUInt64 mulmod(ScmUInt64 a, ScmUInt64 b, ScmUInt64 n)
+{
+#if defined(__SIZEOF_INT128__)
+    return (ScmUInt64)(((unsigned __int128)a * b) % n);
+#else  /*!__SIZEOF_INT128__*/
+    ScmUInt64 r = 0;
+    a %= n;
+    while (b) {
+        if (b & 1) r = (r >= n - a) ? r - (n - a) : r + a;
+        a = (a >= n - a) ? a - (n - a) : a + a;
+        b >>= 1;
+    }
+    return r;
+#endif /*!__SIZEOF_INT128__*/
+}
+
+static inline ScmUInt64 addmod(ScmUInt64 a, ScmUInt64 b, ScmUInt64 n)
+{
+    return (a >= n - b) ? a - (n - b) : a + b;
+}
+
+static inline ScmUInt64 submod(ScmUInt64 a, ScmUInt64 b, ScmUInt64 n)
+{
+    return (a >= b) ? a - b : a + (n - b);
+}
+
+/* x/2 mod n, for odd n */
+static inline ScmUInt64 halfmod(ScmUInt64 x, ScmUInt64 n)
+{
+    return (x & 1) ? (x>>1) + (n>>1) + 1 : x>>1;
+}
+
+static ScmUInt64 powmod(ScmUInt64 a, ScmUInt64 e, ScmUInt64 n)
+{
+    ScmUInt64 r = 1 % n;
+    a %= n;
+    while (e) {
+        if (e & 1) r = mulmod(r, a, n);
+        a = mulmod(a, a, n);
+        e >>= 1;
+    }
+    return r;
+}
+
+/* Same as miller-rabin-test in prime.scm */
+int Scm_PrimeStrongPRP(ScmUInt64 n, ScmUInt64 a)
+{
+    ScmUInt64 d = n - 1;
+    int s = 0;
+    while (!(d & 1)) { d >>= 1; s++; }
+
+    ScmUInt64 x = powmod(a, d, n);
+    if (x == 1) return TRUE;
+    for (int i = 0; i < s; i++) {
+        if (x == n - 1) return TRUE;
+        x = mulmod(x, x, n);
+    }
+    return FALSE;
+}
+
+static const ScmUInt32 mr_bases[] = {
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37
+};
+#define NUM_MR_BASES  (sizeof(mr_bases)/sizeof(mr_bases[0]))
+
+/* The first 12 primes suffice for n < 3.18*10^23 (Sorenson & Webster,
+   doi:10.1090/mcom/3134). */
+int Scm_PrimeMillerRabin64(ScmUInt64 n)
+{
+    if (n < 2) return FALSE;
+    for (unsigned int i = 0; i < NUM_MR_BASES; i++) {
+        if (n == mr_bases[i]) return TRUE;
+        if (n % mr_bases[i] == 0) return FALSE;
+    }
+    for (unsigned int i = 0; i < NUM_MR_BASES; i++) {
+        if (!Scm_PrimeStrongPRP(n, mr_bases[i])) return FALSE;
+    }
+    return TRUE;
+}
+
+/* Jacobi symbol (a/n), for odd n */
+static int jacobi64(ScmUInt64 a, ScmUInt64 n)
+{
+    int s = 1;
+    a %= n;
+    while (a != 0) {
+        while (!(a & 1)) {
+            a >>= 1;
+            if ((n & 7) == 3 || (n & 7) == 5) s = -s;
+        }
+        ScmUInt64 t = a; a = n; n = t;
+        if ((a & 3) == 3 && (n & 3) == 3) s = -s;
+        a %= n;
+    }
+    return (n == 1) ? s : 0;
+}
+
+/* signed x mod n */
+static inline ScmUInt64 smod(long x, ScmUInt64 n)
+{
+    if (x >= 0) return (ScmUInt64)x % n;
+    ScmUInt64 r = ((ScmUInt64)(-x)) % n;
+    return r ? n - r : 0;
+}
+
+/* Strong Lucas probable prime test with Selfridge's parameters.
+   N is odd, not a perfect square, and has no small factors. */
+static int strong_lucas_prp(ScmUInt64 n)
+{
+    long D = 5;
+    for (;;) {
+        int j = jacobi64(smod(D, n), n);
+        if (j == -1) break;
+        if (j == 0 && (ScmUInt64)(D < 0 ? -D : D) != n) return FALSE;
+        D = (D > 0) ? -(D+2) : -D+2;
+    }
+    ScmUInt64 Dm = smod(D, n);
+    ScmUInt64 Qm = smod((1-D)/4, n);
+
+    ScmUInt64 d = n + 1;        /* n < 2^64-1, for it has no factor 3 */
+    int s = 0;
+    while (!(d & 1)) { d >>= 1; s++; }
+
+    /* Left-to-right binary method with P = 1. */
+    ScmUInt64 U = 1, V = 1, Qk = Qm;
+    int top = 63;
+    while (!((d >> top) & 1)) top--;
+    for (int b = top - 1; b >= 0; b--) {
+        U = mulmod(U, V, n);
+        V = submod(mulmod(V, V, n), addmod(Qk, Qk, n), n);
+        Qk = mulmod(Qk, Qk, n);
+        if ((d >> b) & 1) {
+            ScmUInt64 U1 = halfmod(addmod(U, V, n), n);
+            ScmUInt64 V1 = halfmod(addmod(mulmod(Dm, U, n), V, n), n);
+            U = U1; V = V1;
+            Qk = mulmod(Qk, Qm, n);
+        }
+    }
+    if (U == 0 || V == 0) return TRUE;
+    for (int r = 1; r < s; r++) {
+        V = submod(mulmod(V, V, n), addmod(Qk, Qk, n), n);
+        if (V == 0) return TRUE;
+        Qk = mulmod(Qk, Qk, n);
+    }
+    return FALSE;
+}
+
+int Scm_PrimeBPSW64(ScmUInt64 n)
+{
+    if (n < 2) return FALSE;
+    if (n < 4) return TRUE;
+    if (!(n & 1)) return FALSE;
+    for (ScmUInt64 p = 3; p < 1000; p += 2) {
+        if (p*p > n) return TRUE;
+        if (n % p == 0) return FALSE;
+    }
+    if (!Scm_PrimeStrongPRP(n, 2)) return FALSE;
+    ScmUInt64 r = isqrt64(n);
+    if (r*r == n) return FALSE;
+    return strong_lucas_prp(n);
+}
+
+void Scm_Init_prime(void)
+{
+    (void)SCM_INTERNAL_MUTEX_INIT(base_primes.mutex);
+}
@@ -0,0 +1,60 @@
+/*
+ * prime.h - native prime sieve and primality tests for math.prime
+ *
+ *   Copyright (c) 2013-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_MATH_PRIME_H
+#define GAUCHE_MATH_PRIME_H
+
+#include <gauche.h>
+
+SCM_DECL_BEGIN
+
+/* Sieves odd numbers in [START, END).  START must be odd.  Returns a
+   u8vector of bits, where bit K (bit K%8 of byte K/8) is 1 iff
+   START+2K is prime.  The work is split among NTHREADS threads if
+   the system supports them. */
+extern ScmObj Scm_PrimeSieve(ScmUInt64 start, ScmUInt64 end, int nthreads);
+
+/* Strong probable prime test of odd N > 2 to base A. */
+extern int Scm_PrimeStrongPRP(ScmUInt64 n, ScmUInt64 a);
+
+/* Deterministic primality tests for N < 2^64.  The former uses
+   Miller-Rabin with the first 12 primes as the bases, the latter
+   is Baillie-PSW. */
+extern int Scm_PrimeMillerRabin64(ScmUInt64 n);
+extern int Scm_PrimeBPSW64(ScmUInt64 n);
+
+extern void Scm_Init_prime(void);
+
+SCM_DECL_END
+
+#endif /*GAUCHE_MATH_PRIME_H*/
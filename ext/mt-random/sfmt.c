@@ -0,0 +1,664 @@
+/*
+ * sfmt.c - SIMD-oriented Fast Mersenne Twister
+ *
+ * This code is based on Mutsuo Saito & Makoto Matsumoto's SFMT 1.4,
+ * SFMT19937 parameter set.  The generator produces the same sequence
+ * as the reference implementation for the same seed.
+ *
+ * Jump-ahead works as SFMT-jump does, but the jump polynomial is
+ * computed here instead of being precalculated: we find the
+ * characteristic polynomial of the recurrence by Berlekamp-Massey
+ * once, then take x^steps modulo it.
+ *
+ * See sfmt.h for the original copyright notice.
+ */
+
+#include "sfmt.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* SFMT19937 parameters */
+#define N      SCM_SFMT_N
+#define N32    SCM_SFMT_N32
+#define MEXP   19937
+#define POS1   122
+#define SL1    18
+#define SL2    1
+#define SR1    11
+#define SR2    1
+#define MSK1   0xdfffffefU
+#define MSK2   0xddfecb7fU
+#define MSK3   0xbffaffffU
+#define MSK4   0xbffffff6U
+#define PARITY1 0x00000001U
+#define PARITY2 0x00000000U
+#define PARITY3 0x00000000U
+#define PARITY4 0x13c9e684U
+
+/*
+ * Recursion
+ */
+
+#if defined(__SSE2__)
+
+static inline __m128i mm_recursion(__m128i a, __m128i b,
+                                   __m128i c, __m128i d, __m128i mask)
+{
+    __m128i x = _mm_slli_si128(a, SL2);
+    __m128i y = _mm_and_si128(_mm_srli_epi32(b, SR1), mask);
+    __m128i z = _mm_srli_si128(c, SR2);
+    __m128i v = _mm_slli_epi32(d, SL1);
+    z = _mm_xor_si128(z, a);
+    z = _mm_xor_si128(z, v);
+    z = _mm_xor_si128(z, x);
+    return _mm_xor_si128(z, y);
+}
+
+#define MM_MASK   _mm_set_epi32(MSK4, MSK3, MSK2, MSK1)
+
+/* R = recursion(A, B, C, D); each points to four words. */
+static inline void do_recursion(ScmUInt32 *r, const ScmUInt32 *a,
+                                const ScmUInt32 *b, const ScmUInt32 *c,
+                                const ScmUInt32 *d)
+{
+    __m128i z = mm_recursion(_mm_loadu_si128((const __m128i*)a),
+                             _mm_loadu_si128((const __m128i*)b),
+                             _mm_loadu_si128((const __m128i*)c),
+                             _mm_loadu_si128((const __m128i*)d),
+                             MM_MASK);
+    _mm_storeu_si128((__m128i*)r, z);
+}
+
+/* Regenerates the whole state.  The last two rows are kept in
+   registers across iterations. */
+static void gen_rand_all(ScmUInt32 *state)
+{
+    __m128i *st = (__m128i*)state;
+    __m128i mask = MM_MASK;
+    __m128i r1 = _mm_loadu_si128(st + N - 2);
+    __m128i r2 = _mm_loadu_si128(st + N - 1);
+    int i;
+    for (i = 0; i < N - POS1; i++) {
+        __m128i r = mm_recursion(_mm_loadu_si128(st + i),
+                                 _mm_loadu_si128(st + i + POS1),
+                                 r1, r2, mask);
+        _mm_storeu_si128(st + i, r);
+        r1 = r2;
+        r2 = r;
+    }
+    for (; i < N; i++) {
+        __m128i r = mm_recursion(_mm_loadu_si128(st + i),
+                                 _mm_loadu_si128(st + i + POS1 - N),
+                                 r1, r2, mask);
+        _mm_storeu_si128(st + i, r);
+        r1 = r2;
+        r2 = r;
+    }
+}
+
+#else  /*!__SSE2__*/
+
+/* 128-bit shifts by BYTES bytes; word 0 is the least significant. */
+static inline void lshift128(ScmUInt32 *out, const ScmUInt32 *in, int bytes)
+{
+    ScmUInt64 th = ((ScmUInt64)in[3] << 32) | in[2];
+    ScmUInt64 tl = ((ScmUInt64)in[1] << 32) | in[0];
+    ScmUInt64 oh = (th << (bytes*8)) | (tl >> (64 - bytes*8));
+    ScmUInt64 ol = tl << (bytes*8);
+    out[0] = (ScmUInt32)ol; out[1] = (ScmUInt32)(ol >> 32);
+    out[2] = (ScmUInt32)oh; out[3] = (ScmUInt32)(oh >> 32);
+}
+
+static inline void rshift128(ScmUInt32 *out, const ScmUInt32 *in, int bytes)
+{
+    ScmUInt64 th = ((ScmUInt64)in[3] << 32) | in[2];
+    ScmUInt64 tl = ((ScmUInt64)in[1] << 32) | in[0];
+    ScmUInt64 oh = th >> (bytes*8);
+    ScmUInt64 ol = (tl >> (bytes*8)) | (th << (64 - bytes*8));
+    out[0] = (ScmUInt32)ol; out[1] = (ScmUInt32)(ol >> 32);
+    out[2] = (ScmUInt32)oh; out[3] = (ScmUInt32)(oh >> 32);
+}
+
+static inline void do_recursion(ScmUInt32 *r, const ScmUInt32 *a,
+                                const ScmUInt32 *b, const ScmUInt32 *c,
+                                const ScmUInt32 *d)
+{
+    ScmUInt32 x[4], y[4];
+    lshift128(x, a, SL2);
+    rshift128(y, c, SR2);
+    r[0] = a[0] ^ x[0] ^ ((b[0] >> SR1) & MSK1) ^ y[0] ^ (d[0] << SL1);
+    r[1] = a[1] ^ x[1] ^ ((b[1] >> SR1) & MSK2) ^ y[1] ^ (d[1] << SL1);
+    r[2] = a[2] ^ x[2] ^ ((b[2] >> SR1) & MSK3) ^ y[2] ^ (d[2] << SL1);
+    r[3] = a[3] ^ x[3] ^ ((b[3] >> SR1) & MSK4) ^ y[3] ^ (d[3] << SL1);
+}
+
+static void gen_rand_all(ScmUInt32 *state)
+{
+    const ScmUInt32 *r1 = state + (N-2)*4;
+    const ScmUInt32 *r2 = state + (N-1)*4;
+    int i;
+    for (i = 0; i < N - POS1; i++) {
+        do_recursion(state + i*4, state + i*4, state + (i + POS1)*4, r1, r2);
+        r1 = r2;
+        r2 = state + i*4;
+    }
+    for (; i < N; i++) {
+        do_recursion(state + i*4, state + i*4, state + (i + POS1 - N)*4,
+                     r1, r2);
+        r1 = r2;
+        r2 = state + i*4;
+    }
+}
+
+#endif /*!__SSE2__*/
+
+/*
+ * Initialization
+ */
+
+static void period_certification(ScmSFMT *s)
+{
+    static const ScmUInt32 parity[4] = {PARITY1, PARITY2, PARITY3, PARITY4};
+    ScmUInt32 inner = 0;
+    for (int i = 0; i < 4; i++) inner ^= s->state[i] & parity[i];
+    for (int i = 16; i > 0; i >>= 1) inner ^= inner >> i;
+    if (inner & 1) return;
+    /* Period is not 2^MEXP-1; flip a bit to fix it. */
+    for (int i = 0; i < 4; i++) {
+        ScmUInt32 work = 1;
+        for (int j = 0; j < 32; j++, work <<= 1) {
+            if (work & parity[i]) {
+                s->state[i] ^= work;
+                return;
+            }
+        }
+    }
+}
+
+void Scm_SFMTInitByUI(ScmSFMT *s, ScmUInt32 seed)
+{
+    ScmUInt32 *p = s->state;
+    p[0] = seed;
+    for (int i = 1; i < N32; i++) {
+        p[i] = 1812433253U * (p[i-1] ^ (p[i-1] >> 30)) + i;
+    }
+    s->idx = N32;
+    period_certification(s);
+}
+
+static inline ScmUInt32 func1(ScmUInt32 x)
+{
+    return (x ^ (x >> 27)) * 1664525U;
+}
+
+static inline ScmUInt32 func2(ScmUInt32 x)
+{
+    return (x ^ (x >> 27)) * 1566083941U;
+}
+
+void Scm_SFMTInitByArray(ScmSFMT *s, const ScmUInt32 *key, int keylen)
+{
+    ScmUInt32 *p = s->state;
+    const int lag = 11;         /* for N32 >= 623 */
+    const int mid = (N32 - lag) / 2;
+    int i, j, count;
+    ScmUInt32 r;
+
+    memset(p, 0x8b, sizeof(s->state));
+    count = (keylen + 1 > N32)? keylen + 1 : N32;
+    r = func1(p[0] ^ p[mid] ^ p[N32 - 1]);
+    p[mid] += r;
+    r += keylen;
+    p[mid + lag] += r;
+    p[0] = r;
+    count--;
+    for (i = 1, j = 0; j < count && j < keylen; j++) {
+        r = func1(p[i] ^ p[(i + mid) % N32] ^ p[(i + N32 - 1) % N32]);
+        p[(i + mid) % N32] += r;
+        r += key[j] + i;
+        p[(i + mid + lag) % N32] += r;
+        p[i] = r;
+        i = (i + 1) % N32;
+    }
+    for (; j < count; j++) {
+        r = func1(p[i] ^ p[(i + mid) % N32] ^ p[(i + N32 - 1) % N32]);
+        p[(i + mid) % N32] += r;
+        r += i;
+        p[(i + mid + lag) % N32] += r;
+        p[i] = r;
+        i = (i + 1) % N32;
+    }
+    for (j = 0; j < N32; j++) {
+        r = func2(p[i] + p[(i + mid) % N32] + p[(i + N32 - 1) % N32]);
+        p[(i + mid) % N32] ^= r;
+        r -= i;
+        p[(i + mid + lag) % N32] ^= r;
+        p[i] = r;
+        i = (i + 1) % N32;
+    }
+    s->idx = N32;
+    period_certification(s);
+}
+
+/*
+ * Generation
+ */
+
+ScmUInt32 Scm_SFMTGenrandU32(ScmSFMT *s)
+{
+    if (s->idx >= N32) {
+        gen_rand_all(s->state);
+        s->idx = 0;
+    }
+    return s->state[s->idx++];
+}
+
+static inline double u64_to_f64(ScmUInt64 v)
+{
+    /* 53-bit resolution on [0,1) */
+    return (double)(v >> 11) * (1.0/9007199254740992.0);
+}
+
+/* generates a random number on (0,1) or [0,1) with 53-bit resolution */
+double Scm_SFMTGenrandF64(ScmSFMT *s, int exclude0)
+{
+    double r;
+    do {
+        ScmUInt64 lo = Scm_SFMTGenrandU32(s);
+        ScmUInt64 hi = Scm_SFMTGenrandU32(s);
+        r = u64_to_f64((hi << 32) | lo);
+    } while (exclude0 && r == 0.0);
+    return r;
+}
+
+/* generates a random number on [0,n-1], 0 < n <= 2^32. */
+ScmUInt32 Scm_SFMTGenrandBelow(ScmSFMT *s, ScmUInt64 n)
+{
+    if (n >= ((ScmUInt64)1 << 32)) return Scm_SFMTGenrandU32(s);
+    /* Reject the top (2^32 mod n) values to avoid bias. */
+    ScmUInt32 limit = (ScmUInt32)(0xffffffffU - (0x100000000ULL % n) + 1);
+    ScmUInt32 r;
+    do {
+        r = Scm_SFMTGenrandU32(s);
+    } while (limit != 0 && r >= limit);
+    return (ScmUInt32)(r % n);
+}
+
+void Scm_SFMTFillU32(ScmSFMT *s, ScmUInt32 *p, ScmSmallInt n)
+{
+    while (n > 0) {
+        if (s->idx >= N32) {
+            gen_rand_all(s->state);
+            s->idx = 0;
+        }
+        ScmSmallInt k = N32 - s->idx;
+        if (k > n) k = n;
+        memcpy(p, s->state + s->idx, k * sizeof(ScmUInt32));
+        s->idx += (int)k;
+        p += k;
+        n -= k;
+    }
+}
+
+void Scm_SFMTFillF64(ScmSFMT *s, double *p, ScmSmallInt n, int exclude0)
+{
+    while (n > 0) {
+        if (s->idx >= N32) {
+            gen_rand_all(s->state);
+            s->idx = 0;
+        }
+        if (s->idx + 2 > N32) {
+            /* A pair straddles the state boundary. */
+            *p++ = Scm_SFMTGenrandF64(s, exclude0);
+            n--;
+            continue;
+        }
+        const ScmUInt32 *q = s->state + s->idx;
+        const ScmUInt32 *end = s->state + N32 - 1;
+        while (n > 0 && q < end) {
+            double r = u64_to_f64(((ScmUInt64)q[1] << 32) | q[0]);
+            q += 2;
+            if (exclude0 && r == 0.0) continue;
+            *p++ = r;
+            n--;
+        }
+        s->idx = (int)(q - s->state);
+    }
+}
+
+/*
+ * Jump ahead
+ *
+ * The state is a window of N consecutive 128-bit words w[k]..w[k+N-1]
+ * of a linear recurrence, and one step slides the window by one word.
+ * If P is the characteristic polynomial of the step and
+ * q(x) = x^J mod P(x), then the window J steps ahead is the sum of
+ * q_i * (window i steps ahead).
+ *
+ * P has degree 128*N = 19968.  We find it by Berlekamp-Massey
+ * on one bit of the output sequence; the resulting minimal polynomial
+ * has the full degree, so it is the characteristic polynomial and
+ * annihilates any state.
+ */
+
+#define PDEG    (N*128)                 /* degree of P */
+#define PWORDS  (PDEG/64 + 1)           /* words to hold P */
+#define QWORDS  (PDEG/64)               /* words to hold x^k mod P */
+
+static ScmUInt64 *charpoly = NULL;      /* PWORDS words */
+
+/* The jump polynomial for the last distance, since jumps are usually
+   repeated with the same distance to make a series of streams. */
+static ScmUInt64 *last_jump_poly = NULL;
+static u_long *last_jump_steps = NULL;
+static int last_jump_ndigits = 0;
+
+static ScmInternalMutex jump_mutex;
+
+static inline int poly_bit(const ScmUInt64 *p, int i)
+{
+    return (int)((p[i>>6] >> (i&63)) & 1);
+}
+
+/* Returns 64 bits of R beginning at bit position POS.
+   R must have one extra word beyond the last one accessed. */
+static inline ScmUInt64 bits_at(const ScmUInt64 *r, int pos)
+{
+    int w = pos >> 6, b = pos & 63;
+    if (b == 0) return r[w];
+    return (r[w] >> b) | (r[w+1] << (64 - b));
+}
+
+static inline int parity64(ScmUInt64 v)
+{
+    v ^= v >> 32; v ^= v >> 16; v ^= v >> 8;
+    v ^= v >> 4;  v ^= v >> 2;  v ^= v >> 1;
+    return (int)(v & 1);
+}
+
+/* DST ^= SRC * x^SHIFT, where SRC has SWORDS words. */
+static void poly_xor_shifted(ScmUInt64 *dst, const ScmUInt64 *src,
+                             int swords, int shift)
+{
+    int w = shift >> 6, b = shift & 63;
+    if (b == 0) {
+        for (int i = 0; i < swords; i++) dst[w+i] ^= src[i];
+    } else {
+        for (int i = 0; i < swords; i++) {
+            dst[w+i]   ^= src[i] << b;
+            dst[w+i+1] ^= src[i] >> (64 - b);
+        }
+    }
+}
+
+/* Berlekamp-Massey over GF(2).  S holds NBITS bits of the sequence,
+   stored in reverse (bit 0 is the last element) with one word of
+   padding.  Returns the linear complexity L, and C receives the
+   connection polynomial 1 + c_1 x + ... + c_L x^L.  C must have
+   NBITS/64+2 words. */
+static int berlekamp_massey(const ScmUInt64 *s, int nbits, ScmUInt64 *c)
+{
+    int cwords = nbits/64 + 2;
+    size_t csize = cwords * sizeof(ScmUInt64);
+    ScmUInt64 *b = SCM_NEW_ATOMIC2(ScmUInt64*, csize);
+    ScmUInt64 *t = SCM_NEW_ATOMIC2(ScmUInt64*, csize);
+    int L = 0, m = 1, bdeg = 0;
+
+    memset(c, 0, csize);
+    memset(b, 0, csize);
+    c[0] = b[0] = 1;
+    for (int n = 0; n < nbits; n++) {
+        /* d = s_n + sum c_i s_{n-i}, where s_{n-i} is at reverse
+           position nbits-1-n+i.  deg C <= L. */
+        int off = nbits - 1 - n;
+        ScmUInt64 acc = 0;
+        for (int w = 0; w <= (L >> 6); w++) {
+            acc ^= c[w] & bits_at(s, off + w*64);
+        }
+        if (!parity64(acc)) {
+            m++;
+        } else if (2*L <= n) {
+            memcpy(t, c, csize);
+            poly_xor_shifted(c, b, (bdeg >> 6) + 1, m);
+            bdeg = L;
+            L = n + 1 - L;
+            memcpy(b, t, csize);
+            m = 1;
+        } else {
+            poly_xor_shifted(c, b, (bdeg >> 6) + 1, m);
+            m++;
+        }
+    }
+    return L;
+}
+
+/* Computes the characteristic polynomial.  Called with jump_mutex held. */
+static void compute_charpoly(void)
+{
+    int nbits = 2*PDEG;
+    int swords = nbits/64 + 2;
+    int cwords = nbits/64 + 2;
+    ScmUInt64 *seq = SCM_NEW_ATOMIC2(ScmUInt64*, swords * sizeof(ScmUInt64));
+    ScmUInt64 *c = SCM_NEW_ATOMIC2(ScmUInt64*, cwords * sizeof(ScmUInt64));
+    ScmSFMT s;
+
+    /* Bit 0 of each 128-bit word, stored reversed. */
+    memset(seq, 0, swords * sizeof(ScmUInt64));
+    Scm_SFMTInitByUI(&s, 5489U);
+    for (int i = 0; i < nbits; i++) {
+        ScmUInt32 w = Scm_SFMTGenrandU32(&s);
+        (void)Scm_SFMTGenrandU32(&s);
+        (void)Scm_SFMTGenrandU32(&s);
+        (void)Scm_SFMTGenrandU32(&s);
+        int pos = nbits - 1 - i;
+        if (w & 1) seq[pos>>6] |= (ScmUInt64)1 << (pos&63);
+    }
+    int L = berlekamp_massey(seq, nbits, c);
+    if (L != PDEG) {
+        Scm_Error("SFMT jump: unexpected linear complexity %d", L);
+    }
+    /* P(x) = x^L C(1/x) */
+    ScmUInt64 *p = SCM_NEW_ATOMIC2(ScmUInt64*, PWORDS * sizeof(ScmUInt64));
+    memset(p, 0, PWORDS * sizeof(ScmUInt64));
+    for (int i = 0; i <= L; i++) {
+        if (poly_bit(c, i)) {
+            int j = L - i;
+            p[j>>6] |= (ScmUInt64)1 << (j&63);
+        }
+    }
+    charpoly = p;
+}
+
+/* Reduces R, which has 2*QWORDS words, modulo P in place. */
+static void poly_mod(ScmUInt64 *r)
+{
+    for (int i = 2*QWORDS*64 - 1; i >= PDEG; i--) {
+        if (poly_bit(r, i)) poly_xor_shifted(r, charpoly, PWORDS, i - PDEG);
+    }
+}
+
+/* Q = Q^2 mod P, where TMP has 2*QWORDS+1 words. */
+static void poly_square_mod(ScmUInt64 *q, ScmUInt64 *tmp)
+{
+    /* Squaring over GF(2) just spreads the bits. */
+    static ScmUInt32 spread[256];
+    static int spread_ready = FALSE;
+    if (!spread_ready) {
+        for (int i = 0; i < 256; i++) {
+            ScmUInt32 v = 0;
+            for (int j = 0; j < 8; j++) {
+                if (i & (1<<j)) v |= 1U << (2*j);
+            }
+            spread[i] = v;
+        }
+        spread_ready = TRUE;
+    }
+    memset(tmp, 0, (2*QWORDS+1) * sizeof(ScmUInt64));
+    for (int i = 0; i < QWORDS; i++) {
+        ScmUInt64 w = q[i], lo = 0, hi = 0;
+        for (int j = 0; j < 4; j++) {
+            lo |= (ScmUInt64)spread[(w >> (8*j)) & 0xff] << (16*j);
+            hi |= (ScmUInt64)spread[(w >> (8*j + 32)) & 0xff] << (16*j);
+        }
+        tmp[2*i] = lo;
+        tmp[2*i+1] = hi;
+    }
+    poly_mod(tmp);
+    memcpy(q, tmp, QWORDS * sizeof(ScmUInt64));
+}
+
+/* Q = Q * x mod P */
+static void poly_mulx_mod(ScmUInt64 *q)
+{
+    ScmUInt64 carry = 0;
+    for (int i = 0; i < QWORDS; i++) {
+        ScmUInt64 w = q[i];
+        q[i] = (w << 1) | carry;
+        carry = w >> 63;
+    }
+    if (carry) {
+        /* x^PDEG = P - x^PDEG; P's top bit is in the word QWORDS. */
+        for (int i = 0; i < QWORDS; i++) q[i] ^= charpoly[i];
+    }
+}
+
+/* Computes x^STEPS mod P.  Called with jump_mutex held. */
+static ScmUInt64 *jump_poly(const u_long *steps, int ndigits)
+{
+    ScmUInt64 *q = SCM_NEW_ATOMIC2(ScmUInt64*, QWORDS * sizeof(ScmUInt64));
+    ScmUInt64 *tmp = SCM_NEW_ATOMIC2(ScmUInt64*,
+                                     (2*QWORDS+1) * sizeof(ScmUInt64));
+    const int dbits = (int)(sizeof(u_long) * 8);
+
+    memset(q, 0, QWORDS * sizeof(ScmUInt64));
+    q[0] = 1;
+    for (int i = ndigits - 1; i >= 0; i--) {
+        for (int j = dbits - 1; j >= 0; j--) {
+            poly_square_mod(q, tmp);
+            if ((steps[i] >> j) & 1) poly_mulx_mod(q);
+        }
+    }
+    return q;
+}
+
+/* Advances the window RING, whose oldest word is at START, by one step.
+   Returns the new start. */
+static inline int ring_step(ScmUInt32 *ring, int start)
+{
+    do_recursion(ring + start*4,
+                 ring + start*4,
+                 ring + ((start + POS1) % N)*4,
+                 ring + ((start + N - 2) % N)*4,
+                 ring + ((start + N - 1) % N)*4);
+    return (start + 1) % N;
+}
+
+void Scm_SFMTJump(ScmSFMT *s, const u_long *steps, int ndigits)
+{
+    ScmUInt64 *q;
+    ScmUInt32 ring[N32], work[N32];
+
+    while (ndigits > 0 && steps[ndigits-1] == 0) ndigits--;
+    if (ndigits == 0) return;
+
+    SCM_INTERNAL_MUTEX_LOCK(jump_mutex);
+    if (charpoly == NULL) compute_charpoly();
+    if (last_jump_poly != NULL && last_jump_ndigits == ndigits
+        && memcmp(last_jump_steps, steps, ndigits * sizeof(u_long)) == 0) {
+        q = last_jump_poly;
+    } else {
+        q = jump_poly(steps, ndigits);
+        u_long *d = SCM_NEW_ATOMIC2(u_long*, ndigits * sizeof(u_long));
+        memcpy(d, steps, ndigits * sizeof(u_long));
+        last_jump_steps = d;
+        last_jump_ndigits = ndigits;
+        last_jump_poly = q;
+    }
+    SCM_INTERNAL_MUTEX_UNLOCK(jump_mutex);
+
+    memcpy(ring, s->state, sizeof(ring));
+    memset(work, 0, sizeof(work));
+    int start = 0;
+    for (int i = 0; i < PDEG; i++) {
+        if (poly_bit(q, i)) {
+            for (int k = 0; k < N; k++) {
+                const ScmUInt32 *src = ring + ((start + k) % N)*4;
+                work[k*4]   ^= src[0];
+                work[k*4+1] ^= src[1];
+                work[k*4+2] ^= src[2];
+                work[k*4+3] ^= src[3];
+            }
+        }
+        start = ring_step(ring, start);
+    }
+    memcpy(s->state, work, sizeof(work));
+}
+
+/*
+ * Gauche specific stuff
+ */
+
+void Scm_SFMTSetSeed(ScmSFMT *s, ScmObj seed)
+{
+    if (SCM_INTP(seed)) {
+        u_long v = Scm_GetUInteger(seed);
+        Scm_SFMTInitByUI(s, (ScmUInt32)(v ^ (v >> 16 >> 16)));
+    } else if (SCM_BIGNUMP(seed)) {
+        u_long v = 0;
+        for (int i = 0; i < (int)SCM_BIGNUM_SIZE(seed); i++) {
+            v ^= SCM_BIGNUM(seed)->values[i];
+        }
+        Scm_SFMTInitByUI(s, (ScmUInt32)(v ^ (v >> 16 >> 16)));
+    } else if (SCM_U32VECTORP(seed)) {
+        Scm_SFMTInitByArray(s, SCM_U32VECTOR_ELEMENTS(seed),
+                            (int)SCM_U32VECTOR_SIZE(seed));
+    } else {
+        Scm_TypeError("random seed", "an exact integer or u32vector", seed);
+    }
+}
+
+/* Advances S as if N 32-bit words are generated. */
+void Scm_SFMTJumpOutputs(ScmSFMT *s, ScmObj n)
+{
+    if (!SCM_INTEGERP(n) || Scm_Sign(n) < 0) {
+        Scm_TypeError("jump distance", "a nonnegative exact integer", n);
+    }
+    ScmObj steps = Scm_Ash(n, -2);
+    int rem = (int)Scm_GetIntegerU(Scm_LogAnd(n, SCM_MAKE_INT(3)));
+    if (SCM_INTP(steps)) {
+        u_long d = (u_long)SCM_INT_VALUE(steps);
+        Scm_SFMTJump(s, &d, 1);
+    } else {
+        Scm_SFMTJump(s, SCM_BIGNUM(steps)->values,
+                     (int)SCM_BIGNUM_SIZE(steps));
+    }
+    while (rem-- > 0) (void)Scm_SFMTGenrandU32(s);
+}
+
+static ScmObj key_seed;
+static ScmObj sfmt_allocate(ScmClass *klass, ScmObj initargs);
+SCM_DEFINE_BUILTIN_CLASS(Scm_SFMTClass,
+                         NULL, NULL, NULL, sfmt_allocate,
+                         NULL);
+
+static ScmObj sfmt_allocate(ScmClass *klass, ScmObj initargs)
+{
+    ScmObj seed = Scm_GetKeyword(key_seed, initargs, SCM_FALSE);
+    ScmSFMT *s = SCM_NEW(ScmSFMT);
+    SCM_SET_CLASS(s, &Scm_SFMTClass);
+    if (SCM_FALSEP(seed)) {
+        Scm_SFMTInitByUI(s, 5489U); /* the default initial seed */
+    } else {
+        Scm_SFMTSetSeed(s, seed);
+    }
+    return SCM_OBJ(s);
+}
+
+void Scm_Init_sfmt(void)
+{
+    ScmModule *mod = SCM_FIND_MODULE("math.mt-random", SCM_FIND_MODULE_CREATE);
+    Scm_InitStaticClass(&Scm_SFMTClass, "<sfmt>", mod, NULL, 0);
+    key_seed = SCM_MAKE_KEYWORD("seed");
+    (void)SCM_INTERNAL_MUTEX_INIT(jump_mutex);
+}
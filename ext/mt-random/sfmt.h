@@ -0,0 +1,89 @@
+/*
+ * sfmt.h - SIMD-oriented Fast Mersenne Twister
+ * This code is based on Mutsuo Saito & Makoto Matsumoto's SFMT 1.4.
+ * See sfmt.c for details.
+ *
+ * The original copyright notice follows.
+ */
+/*
+   Copyright (c) 2006,2007 Mutsuo Saito, Makoto Matsumoto and Hiroshima
+   University.
+   Copyright (c) 2012 Mutsuo Saito, Makoto Matsumoto, Hiroshima University
+   and The University of Tokyo.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are
+   met:
+
+       * Redistributions of source code must retain the above copyright
+         notice, this list of conditions and the following disclaimer.
+       * Redistributions in binary form must reproduce the above
+         copyright notice, this list of conditions and the following
+         disclaimer in the documentation and/or other materials provided
+         with the distribution.
+       * Neither the names of Hiroshima University, The University of
+         Tokyo nor the names of its contributors may be used to endorse
+         or promote products derived from this software without specific
+         prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef GAUCHE_SFMT_H
+#define GAUCHE_SFMT_H
+
+#include <gauche.h>
+#include <gauche/extend.h>
+
+SCM_DECL_BEGIN
+
+/* SFMT19937: 156 128-bit words of state. */
+#define SCM_SFMT_N    156
+#define SCM_SFMT_N32  (SCM_SFMT_N*4)
+
+typedef struct ScmSFMTRec {
+    SCM_HEADER;
+    ScmUInt32 state[SCM_SFMT_N32];
+    int idx;                    /* next output in state; N32 means the
+                                   state must be regenerated first */
+} ScmSFMT;
+
+SCM_CLASS_DECL(Scm_SFMTClass);
+#define SCM_SFMT(obj)     ((ScmSFMT*)obj)
+#define SCM_SFMTP(obj)    SCM_XTYPEP(obj, &Scm_SFMTClass)
+
+extern void Scm_SFMTInitByUI(ScmSFMT *s, ScmUInt32 seed);
+extern void Scm_SFMTInitByArray(ScmSFMT *s, const ScmUInt32 *key, int keylen);
+
+extern ScmUInt32 Scm_SFMTGenrandU32(ScmSFMT *s);
+extern double    Scm_SFMTGenrandF64(ScmSFMT *s, int exclude0);
+extern ScmUInt32 Scm_SFMTGenrandBelow(ScmSFMT *s, ScmUInt64 n);
+
+/* Bulk fill.  These generate a whole state at a time and copy out of
+   it, instead of going through the one-word interface. */
+extern void Scm_SFMTFillU32(ScmSFMT *s, ScmUInt32 *p, ScmSmallInt n);
+extern void Scm_SFMTFillF64(ScmSFMT *s, double *p, ScmSmallInt n, int exclude0);
+
+/* Advances S as if 4*STEPS 32-bit words are generated.  STEPS is given
+   as NDIGITS words of little-endian magnitude, as in a bignum. */
+extern void Scm_SFMTJump(ScmSFMT *s, const u_long *steps, int ndigits);
+
+extern void Scm_SFMTSetSeed(ScmSFMT *s, ScmObj seed);
+extern void Scm_SFMTJumpOutputs(ScmSFMT *s, ScmObj n);
+
+extern void Scm_Init_sfmt(void);
+
+SCM_DECL_END
+
+#endif /*GAUCHE_SFMT_H*/
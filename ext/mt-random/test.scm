@@ -110,6 +110,83 @@
                      (make-random-sequence <list> 100 (^[] (mt-random-real m2)))
                      ))))
 
+;;-------------------------------------------------------------------
+(test-section "sfmt")
+
+(define (sfmt-words s n)
+  (list-tabulate n (^_ (sfmt-random-integer s (expt 2 32)))))
+
+;; Values from the reference implementation's SFMT.19937.out.txt
+(test* "sfmt reference (integer seed)"
+       '(3440181298 1564997079 1510669302 2930277156 1452439940)
+       (sfmt-words (make <sfmt> :seed 1234) 5))
+(test* "sfmt reference (array seed)"
+       '(2920711183 3885745737 3501893680 856470934 1421864068)
+       (sfmt-words (make <sfmt> :seed '#u32(#x1234 #x5678 #x9abc #xdef0)) 5))
+
+(test* "sfmt-random-integer" #t
+       (let1 s (make <sfmt> :seed 3)
+         (every (value-in-range? 113)
+                (list-tabulate 1000 (^_ (sfmt-random-integer s 113))))))
+(test* "sfmt-random-integer (large)" #t
+       (let1 s (make <sfmt> :seed 3)
+         (every (value-in-range? 78356385638456)
+                (list-tabulate 1000
+                               (^_ (sfmt-random-integer s 78356385638456))))))
+(test* "sfmt-random-real" #t
+       (let1 s (make <sfmt> :seed 3)
+         (every (^n (< 0 n 1))
+                (list-tabulate 1000 (^_ (sfmt-random-real s))))))
+
+(test* "sfmt-random-fill-u32vector!" #t
+       (let ([s0 (make <sfmt> :seed 1)]
+             [s1 (make <sfmt> :seed 1)])
+         (sfmt-random-real s0) (sfmt-random-real s1)
+         (equal? (list->u32vector (sfmt-words s0 2000))
+                 (sfmt-random-fill-u32vector! s1 (make-u32vector 2000)))))
+(test* "sfmt-random-fill-f64vector!" #t
+       (let ([s0 (make <sfmt> :seed 1)]
+             [s1 (make <sfmt> :seed 1)])
+         (sfmt-random-integer s0 10) (sfmt-random-integer s1 10)
+         (equal? (list->f64vector
+                  (list-tabulate 1001 (^_ (sfmt-random-real s0))))
+                 (sfmt-random-fill-f64vector! s1 (make-f64vector 1001)))))
+
+(test* "sfmt state" #t
+       (let ([s0 (make <sfmt> :seed 7)]
+             [s1 (make <sfmt>)])
+         (sfmt-words s0 100)
+         (sfmt-random-set-state! s1 (sfmt-random-get-state s0))
+         (equal? (sfmt-words s0 1000) (sfmt-words s1 1000))))
+
+(let ()
+  (define (jump-test n)
+    (test* #"sfmt-random-jump! ~n" #t
+           (let ([s0 (make <sfmt> :seed 5)]
+                 [s1 (make <sfmt> :seed 5)])
+             (sfmt-words s0 3) (sfmt-words s1 3)
+             (sfmt-random-jump! s0 n)
+             (sfmt-random-fill-u32vector! s1 (make-u32vector n))
+             (equal? (sfmt-words s0 1000) (sfmt-words s1 1000)))))
+  (for-each jump-test '(0 1 4 1000 2497 10003)))
+
+(test* "sfmt-random-split" #t
+       (let* ([s (make <sfmt> :seed 11)]
+              [ref (make <sfmt> :seed 11)]
+              [streams (sfmt-random-split s 3 5000)])
+         (and (= (length streams) 3)
+              (every (^[g]
+                       (rlet1 ok (equal? (sfmt-words g 100) (sfmt-words ref 100))
+                         (sfmt-random-fill-u32vector! ref (make-u32vector 4900))))
+                     streams)
+              (equal? (sfmt-words s 100) (sfmt-words ref 100)))))
+
+(test* "sfmt-random-split (default distance)" 4
+       (let* ([s (make <sfmt> :seed 11)]
+              [streams (sfmt-random-split s 3)])
+         (length (delete-duplicates
+                  (map (^g (sfmt-words g 4)) (cons s streams))))))
+
 ;;-------------------------------------------------------------------
 ;; srfi-27 is built on top of mt-random, so we test it here.
 (test-section "srfi-27")
@@ -250,6 +250,18 @@ extern ScmObj Scm_SocketBind(ScmSocket *s, ScmSockAddr *addr);
 extern ScmObj Scm_SocketConnect(ScmSocket *s, ScmSockAddr *addr);
 extern ScmObj Scm_SocketListen(ScmSocket *s, int backlog);
 extern ScmObj Scm_SocketAccept(ScmSocket *s);
+extern ScmObj Scm_SocketAcceptWithFlags(ScmSocket *s, int flags);
+extern ScmObj Scm_SocketAcceptAll(ScmSocket *s, int flags, int max);
+extern ScmObj Scm_SocketSetNonblocking(ScmSocket *s, int flag);
+
+/* Flags for Scm_SocketAcceptWithFlags, applied to the accepted socket */
+enum {
+    SCM_SOCKET_ACCEPT_NONBLOCK = (1<<0),
+    SCM_SOCKET_ACCEPT_CLOEXEC  = (1<<1)
+};
+extern ScmObj Scm_SocketAccepted(ScmSocket *s, Socket newfd,
+                                 struct sockaddr *addr, socklen_t addrlen);
+extern ScmObj Scm_SocketConnected(ScmSocket *s, ScmSockAddr *addr);
 
 extern ScmObj Scm_SocketGetSockName(ScmSocket *s);
 extern ScmObj Scm_SocketGetPeerName(ScmSocket *s);
@@ -259,10 +271,17 @@ extern ScmObj Scm_SocketSendTo(ScmSocket *s, ScmObj msg, ScmSockAddr *to, int fl
 extern ScmObj Scm_SocketSendMsg(ScmSocket *s, ScmObj msg, int flags);
 extern ScmObj Scm_SocketRecv(ScmSocket *s, int bytes, int flags);
 extern ScmObj Scm_SocketRecvX(ScmSocket *s, ScmUVector *buf, int flags);
+extern ScmObj Scm_SocketRecvXRange(ScmSocket *s, ScmUVector *buf,
+                                   ScmSmallInt start, ScmSmallInt end,
+                                   int flags);
 extern ScmObj Scm_SocketRecvFrom(ScmSocket *s, int bytes, int flags);
 extern ScmObj Scm_SocketRecvFromX(ScmSocket *s, ScmUVector *buf,
                                   ScmObj addrs, int flags);
 
+extern ScmObj Scm_SocketRecvMMsg(ScmSocket *s, ScmVector *bufs,
+                                 ScmUVector *sizes, ScmObj addrs, int flags);
+extern ScmObj Scm_SocketSendMMsg(ScmSocket *s, ScmVector *msgs, ScmObj to,
+                                 int flags);
 extern ScmObj Scm_SocketBuildMsg(ScmSockAddr *name, ScmVector *iov,
                                  ScmObj control, int flags,
                                  ScmUVector *buf);
@@ -31,6 +31,7 @@
  *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define _GNU_SOURCE  /* for accept4, recvmmsg and sendmmsg on Linux */
 #include "gauche-net.h"
 #include <fcntl.h>
 #include <gauche/extend.h>
@@ -276,27 +277,139 @@ ScmObj Scm_SocketListen(ScmSocket *sock, int backlog)
     return SCM_OBJ(sock);
 }
 
-ScmObj Scm_SocketAccept(ScmSocket *sock)
+/* Accepts a connection on FD, with FLAGS (SCM_SOCKET_ACCEPT_*) applied
+   to the new socket.  We use accept4(2) if available, to save the
+   extra system calls and to get close-on-exec set atomically.  On
+   failure, INVALID_SOCKET is returned with errno set. */
+static Socket do_accept(Socket fd, struct sockaddr *addr, socklen_t *addrlen,
+                        int flags)
 {
     Socket newfd;
+#if defined(HAVE_ACCEPT4) && defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+    int f = 0;
+    if (flags & SCM_SOCKET_ACCEPT_NONBLOCK) f |= SOCK_NONBLOCK;
+    if (flags & SCM_SOCKET_ACCEPT_CLOEXEC)  f |= SOCK_CLOEXEC;
+    SCM_SYSCALL(newfd, accept4(fd, addr, addrlen, f));
+#else  /* !HAVE_ACCEPT4 */
+    SCM_SYSCALL(newfd, accept(fd, addr, addrlen));
+    if (SOCKET_INVALID(newfd)) return newfd;
+# if defined(GAUCHE_WINDOWS)
+    /* Winsock handles aren't inherited by child processes unless
+       asked, so we only need to care about non-blocking mode. */
+    if (flags & SCM_SOCKET_ACCEPT_NONBLOCK) {
+        u_long mode = 1;
+        (void)ioctlsocket(newfd, FIONBIO, &mode);
+    }
+# else  /* !GAUCHE_WINDOWS */
+    if (flags & SCM_SOCKET_ACCEPT_NONBLOCK) {
+        int fl = fcntl(newfd, F_GETFL, 0);
+        if (fl >= 0) (void)fcntl(newfd, F_SETFL, fl|O_NONBLOCK);
+    }
+    if (flags & SCM_SOCKET_ACCEPT_CLOEXEC) {
+        (void)fcntl(newfd, F_SETFD, FD_CLOEXEC);
+    }
+# endif /* !GAUCHE_WINDOWS */
+#endif /* !HAVE_ACCEPT4 */
+    return newfd;
+}
+
+static int would_block(void)
+{
+#if defined(EWOULDBLOCK) && (EWOULDBLOCK != EAGAIN)
+    if (errno == EWOULDBLOCK) return TRUE;
+#endif
+    return (errno == EAGAIN);
+}
+
+ScmObj Scm_SocketAccept(ScmSocket *sock)
+{
+    return Scm_SocketAcceptWithFlags(sock, 0);
+}
+
+ScmObj Scm_SocketAcceptWithFlags(ScmSocket *sock, int flags)
+{
     struct sockaddr_storage addrbuf;
     socklen_t addrlen = sizeof(addrbuf);
-    ScmClass *addrClass = Scm_ClassOf(SCM_OBJ(sock->address));
 
     CLOSE_CHECK(sock->fd, "accept from", sock);
-    SCM_SYSCALL(newfd, accept(sock->fd, (struct sockaddr*)&addrbuf, &addrlen));
+    Socket newfd = do_accept(sock->fd, (struct sockaddr*)&addrbuf, &addrlen,
+                             flags);
     if (SOCKET_INVALID(newfd)) {
-        if (errno == EAGAIN) {
+        if (would_block()) {
             return SCM_FALSE;
         } else {
             Scm_SysError("accept(2) failed");
         }
     }
+    return Scm_SocketAccepted(sock, newfd, (struct sockaddr*)&addrbuf,
+                              addrlen);
+}
+
+/* Accepts pending connections on SOCK until there's none left, or
+   MAX connections are accepted if MAX > 0, and returns a list of new
+   sockets.  This amortizes the cost of waking up a server thread over
+   a burst of connections.  SOCK should be in non-blocking mode;
+   if it isn't, we accept just one connection, since we can't tell if
+   another accept(2) would block. */
+ScmObj Scm_SocketAcceptAll(ScmSocket *sock, int flags, int max)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    int nonblocking = FALSE;
+
+    CLOSE_CHECK(sock->fd, "accept from", sock);
+#if !defined(GAUCHE_WINDOWS)
+    {
+        int fl = fcntl(sock->fd, F_GETFL, 0);
+        nonblocking = (fl >= 0 && (fl & O_NONBLOCK));
+    }
+#endif /*!GAUCHE_WINDOWS*/
+    for (int n = 0; max <= 0 || n < max; n++) {
+        struct sockaddr_storage addrbuf;
+        socklen_t addrlen = sizeof(addrbuf);
+        Socket newfd = do_accept(sock->fd, (struct sockaddr*)&addrbuf,
+                                 &addrlen, flags);
+        if (SOCKET_INVALID(newfd)) {
+            if (would_block()) break;
+            /* Don't lose the sockets we've got; the error will show
+               up again at the next call. */
+            if (!SCM_NULLP(h)) break;
+            Scm_SysError("accept(2) failed");
+        }
+        SCM_APPEND1(h, t, Scm_SocketAccepted(sock, newfd,
+                                             (struct sockaddr*)&addrbuf,
+                                             addrlen));
+        if (!nonblocking) break;
+    }
+    return h;
+}
+
+ScmObj Scm_SocketSetNonblocking(ScmSocket *sock, int flag)
+{
+    CLOSE_CHECK(sock->fd, "set blocking mode of", sock);
+#if defined(GAUCHE_WINDOWS)
+    u_long mode = flag? 1 : 0;
+    if (ioctlsocket(sock->fd, FIONBIO, &mode) != 0) {
+        Scm_SysError("ioctlsocket(FIONBIO) failed");
+    }
+#else  /*!GAUCHE_WINDOWS*/
+    int fl, r;
+    SCM_SYSCALL(fl, fcntl(sock->fd, F_GETFL, 0));
+    if (fl < 0) Scm_SysError("fcntl(F_GETFL) failed");
+    fl = flag? (fl | O_NONBLOCK) : (fl & ~O_NONBLOCK);
+    SCM_SYSCALL(r, fcntl(sock->fd, F_SETFL, fl));
+    if (r < 0) Scm_SysError("fcntl(F_SETFL) failed");
+#endif /*!GAUCHE_WINDOWS*/
+    return SCM_OBJ(sock);
+}
+
+/* Wraps NEWFD, accepted on the listening socket SOCK by other means
+   than Scm_SocketAccept (e.g. gauche.iouring), as a socket. */
+ScmObj Scm_SocketAccepted(ScmSocket *sock, Socket newfd,
+                          struct sockaddr *addr, socklen_t addrlen)
+{
+    ScmClass *addrClass = Scm_ClassOf(SCM_OBJ(sock->address));
     ScmSocket *newsock = make_socket(newfd, sock->type);
-    newsock->address =
-        SCM_SOCKADDR(Scm_MakeSockAddr(addrClass,
-                                      (struct sockaddr*)&addrbuf,
-                                      addrlen));
+    newsock->address = SCM_SOCKADDR(Scm_MakeSockAddr(addrClass, addr, addrlen));
     newsock->status = SCM_SOCKET_STATUS_CONNECTED;
     return SCM_OBJ(newsock);
 }
@@ -309,6 +422,13 @@ ScmObj Scm_SocketConnect(ScmSocket *sock, ScmSockAddr *addr)
     if (r < 0) {
         Scm_SysError("connect failed to %S", addr);
     }
+    return Scm_SocketConnected(sock, addr);
+}
+
+/* Records that SOCK is connected to ADDR by other means than
+   Scm_SocketConnect. */
+ScmObj Scm_SocketConnected(ScmSocket *sock, ScmSockAddr *addr)
+{
     sock->address = addr;
     sock->status = SCM_SOCKET_STATUS_CONNECTED;
     return SCM_OBJ(sock);
@@ -418,12 +538,23 @@ static char *get_message_buffer(ScmUVector *v, u_int *size)
 }
 
 ScmObj Scm_SocketRecvX(ScmSocket *sock, ScmUVector *buf, int flags)
+{
+    return Scm_SocketRecvXRange(sock, buf, 0, -1, flags);
+}
+
+/* Receive directly into the byte range [start, end) of BUF.  Offsets are
+   in bytes regardless of the uvector's element type; END < 0 means the
+   end of the buffer.  This lets the caller fill a large buffer
+   piecewise without allocating intermediate strings. */
+ScmObj Scm_SocketRecvXRange(ScmSocket *sock, ScmUVector *buf,
+                            ScmSmallInt start, ScmSmallInt end, int flags)
 {
     int r;
     u_int size;
     CLOSE_CHECK(sock->fd, "recv from", sock);
     char *z = get_message_buffer(buf, &size);
-    SCM_SYSCALL(r, recv(sock->fd, z, size, flags));
+    SCM_CHECK_START_END(start, end, (ScmSmallInt)size);
+    SCM_SYSCALL(r, recv(sock->fd, z + start, end - start, flags));
     if (r < 0) {
         Scm_SysError("recv(2) failed");
     }
@@ -486,6 +617,244 @@ ScmObj Scm_SocketRecvFromX(ScmSocket *sock, ScmUVector *buf,
     return Scm_Values2(Scm_MakeInteger(r), addr);
 }
 
+/*
+ * Batched datagram I/O
+ *
+ *  We use recvmmsg(2)/sendmmsg(2) if available, so that a bunch of
+ *  datagrams can be transferred with one system call.  Otherwise we
+ *  fall back to recvfrom(2)/sendto(2) loops, which at least saves
+ *  the round trips between Scheme and C.
+ *  A batch is processed in chunks of MMSG_CHUNK entries so that the
+ *  headers can be kept on the C stack.
+ */
+#define MMSG_CHUNK 64
+
+#if !GAUCHE_WINDOWS
+
+/* Receives up to COUNT datagrams into IOV.  Fills LENS, FROM and
+   FROMLENS.  Returns the number of datagrams received, or -1 with errno
+   set if none is received. */
+static int recv_chunk(Socket fd, struct iovec *iov,
+                      struct sockaddr_storage *from, socklen_t *fromlens,
+                      int *lens, int count, int flags)
+{
+#if defined(HAVE_RECVMMSG)
+    struct mmsghdr msgs[MMSG_CHUNK];
+    int r;
+    memset(msgs, 0, sizeof(struct mmsghdr)*count);
+    for (int i=0; i<count; i++) {
+        msgs[i].msg_hdr.msg_name = &from[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+#if defined(MSG_WAITFORONE)
+    /* Don't wait for the whole batch; we want whatever is available
+       once the first one arrives. */
+    flags |= MSG_WAITFORONE;
+#endif
+    SCM_SYSCALL(r, recvmmsg(fd, msgs, count, flags, NULL));
+    for (int i=0; i<r; i++) {
+        lens[i] = msgs[i].msg_len;
+        fromlens[i] = msgs[i].msg_hdr.msg_namelen;
+    }
+    return r;
+#else  /*!HAVE_RECVMMSG*/
+    int n;
+    for (n=0; n<count; n++) {
+        int r;
+        fromlens[n] = sizeof(struct sockaddr_storage);
+        SCM_SYSCALL(r, recvfrom(fd, iov[n].iov_base, iov[n].iov_len,
+                                (n > 0)? (flags|MSG_DONTWAIT) : flags,
+                                (struct sockaddr*)&from[n], &fromlens[n]));
+        if (r < 0) {
+            if (n > 0) break;
+            return -1;
+        }
+        lens[n] = r;
+    }
+    return n;
+#endif /*!HAVE_RECVMMSG*/
+}
+
+/* Sends COUNT datagrams.  Returns the number of datagrams sent, or -1
+   with errno set if none is sent. */
+static int send_chunk(Socket fd, struct iovec *iov, ScmSockAddr **to,
+                      int count, int flags)
+{
+#if defined(HAVE_SENDMMSG)
+    struct mmsghdr msgs[MMSG_CHUNK];
+    int r;
+    memset(msgs, 0, sizeof(struct mmsghdr)*count);
+    for (int i=0; i<count; i++) {
+        if (to[i]) {
+            msgs[i].msg_hdr.msg_name = &to[i]->addr;
+            msgs[i].msg_hdr.msg_namelen = to[i]->addrlen;
+        }
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    SCM_SYSCALL(r, sendmmsg(fd, msgs, count, flags));
+    return r;
+#else  /*!HAVE_SENDMMSG*/
+    int n;
+    for (n=0; n<count; n++) {
+        int r;
+        if (to[n]) {
+            SCM_SYSCALL(r, sendto(fd, iov[n].iov_base, iov[n].iov_len, flags,
+                                  &to[n]->addr, to[n]->addrlen));
+        } else {
+            SCM_SYSCALL(r, send(fd, iov[n].iov_base, iov[n].iov_len, flags));
+        }
+        if (r < 0) {
+            if (n > 0) break;
+            return -1;
+        }
+    }
+    return n;
+#endif /*!HAVE_SENDMMSG*/
+}
+
+/* Reuses sockaddr CUR if it has the same family as FROM, as
+   Scm_SocketRecvFromX does. */
+static ScmObj store_sockaddr(ScmObj cur, struct sockaddr *from,
+                             socklen_t fromlen)
+{
+    if (Scm_SockAddrP(cur) && SCM_SOCKADDR_FAMILY(cur) == from->sa_family) {
+        memcpy(&SCM_SOCKADDR(cur)->addr, from, SCM_SOCKADDR(cur)->addrlen);
+        return cur;
+    }
+    return Scm_MakeSockAddr(NULL, from, fromlen);
+}
+#endif /*!GAUCHE_WINDOWS*/
+
+/* Receives as many datagrams as available, up to the number of
+   buffers in BUFS, waiting for at least one.  The size of i-th
+   datagram is stored in the i-th element of SIZES (s32vector or
+   u32vector).  If ADDRS is a vector, the source address is stored in
+   its i-th element; a sockaddr already there is reused if it is of the
+   same family.  Returns the number of datagrams received; it is 0 only
+   if the socket is non-blocking and there's nothing to read. */
+ScmObj Scm_SocketRecvMMsg(ScmSocket *sock, ScmVector *bufs,
+                          ScmUVector *sizes, ScmObj addrs, int flags)
+{
+#if !GAUCHE_WINDOWS
+    CLOSE_CHECK(sock->fd, "recv from", sock);
+    if (!(SCM_S32VECTORP(sizes) || SCM_U32VECTORP(sizes))) {
+        Scm_TypeError("sizes", "s32vector or u32vector", SCM_OBJ(sizes));
+    }
+    if (SCM_UVECTOR_IMMUTABLE_P(sizes)) {
+        Scm_Error("attempted to use an immutable uniform vector to store sizes");
+    }
+    if (!SCM_FALSEP(addrs) && !SCM_VECTORP(addrs)) {
+        Scm_TypeError("addrs", "vector or #f", addrs);
+    }
+
+    int n = SCM_VECTOR_SIZE(bufs);
+    if (SCM_UVECTOR_SIZE(sizes) < n) n = SCM_UVECTOR_SIZE(sizes);
+    if (SCM_VECTORP(addrs) && SCM_VECTOR_SIZE(addrs) < n) {
+        n = SCM_VECTOR_SIZE(addrs);
+    }
+    int32_t *sz = (int32_t*)SCM_UVECTOR_ELEMENTS(sizes);
+    int total = 0;
+
+    while (total < n) {
+        struct iovec iov[MMSG_CHUNK];
+        struct sockaddr_storage from[MMSG_CHUNK];
+        socklen_t fromlens[MMSG_CHUNK];
+        int lens[MMSG_CHUNK];
+        int count = n - total;
+        if (count > MMSG_CHUNK) count = MMSG_CHUNK;
+
+        for (int i=0; i<count; i++) {
+            ScmObj b = SCM_VECTOR_ELEMENT(bufs, total+i);
+            u_int size;
+            if (!SCM_UVECTORP(b)) {
+                Scm_TypeError("buffer", "uniform vector", b);
+            }
+            iov[i].iov_base = get_message_buffer(SCM_UVECTOR(b), &size);
+            iov[i].iov_len = size;
+        }
+        /* After the first chunk, we only take what's already there. */
+        int got = recv_chunk(sock->fd, iov, from, fromlens, lens, count,
+                             (total > 0)? (flags|MSG_DONTWAIT) : flags);
+        if (got < 0) {
+            if (total > 0 || would_block()) break;
+            Scm_SysError("recvmmsg(2) failed");
+        }
+        for (int i=0; i<got; i++) {
+            sz[total+i] = lens[i];
+            if (SCM_VECTORP(addrs)) {
+                ScmObj *a = &SCM_VECTOR_ELEMENT(addrs, total+i);
+                *a = store_sockaddr(*a, (struct sockaddr*)&from[i],
+                                    fromlens[i]);
+            }
+        }
+        total += got;
+        if (got < count) break;
+    }
+    return SCM_MAKE_INT(total);
+#else  /*GAUCHE_WINDOWS*/
+    Scm_Error("recvmmsg is not implemented on this platform.");
+    return SCM_UNDEFINED;       /* dummy */
+#endif /*GAUCHE_WINDOWS*/
+}
+
+/* Sends each element of MSGS (uniform vector or string) as a datagram.
+   TO can be #f for a connected socket, a sockaddr for sending all of
+   them to the same destination, or a vector of sockaddrs.  Returns the
+   number of datagrams sent, which can be less than the number of MSGS
+   if the socket is non-blocking or an error occurs in the middle. */
+ScmObj Scm_SocketSendMMsg(ScmSocket *sock, ScmVector *msgs, ScmObj to,
+                          int flags)
+{
+#if !GAUCHE_WINDOWS
+    CLOSE_CHECK(sock->fd, "send to", sock);
+    if (!(SCM_FALSEP(to) || Scm_SockAddrP(to) || SCM_VECTORP(to))) {
+        Scm_TypeError("to", "socket address, vector or #f", to);
+    }
+
+    int n = SCM_VECTOR_SIZE(msgs);
+    if (SCM_VECTORP(to) && SCM_VECTOR_SIZE(to) < n) n = SCM_VECTOR_SIZE(to);
+    int total = 0;
+
+    while (total < n) {
+        struct iovec iov[MMSG_CHUNK];
+        ScmSockAddr *dest[MMSG_CHUNK];
+        int count = n - total;
+        if (count > MMSG_CHUNK) count = MMSG_CHUNK;
+
+        for (int i=0; i<count; i++) {
+            u_int size;
+            iov[i].iov_base =
+                (char*)get_message_body(SCM_VECTOR_ELEMENT(msgs, total+i),
+                                        &size);
+            iov[i].iov_len = size;
+            if (SCM_VECTORP(to)) {
+                ScmObj a = SCM_VECTOR_ELEMENT(to, total+i);
+                if (!Scm_SockAddrP(a)) {
+                    Scm_TypeError("destination", "socket address", a);
+                }
+                dest[i] = SCM_SOCKADDR(a);
+            } else {
+                dest[i] = SCM_FALSEP(to)? NULL : SCM_SOCKADDR(to);
+            }
+        }
+        int sent = send_chunk(sock->fd, iov, dest, count, flags);
+        if (sent < 0) {
+            if (total > 0 || would_block()) break;
+            Scm_SysError("sendmmsg(2) failed");
+        }
+        total += sent;
+        if (sent < count) break;
+    }
+    return SCM_MAKE_INT(total);
+#else  /*GAUCHE_WINDOWS*/
+    Scm_Error("sendmmsg is not implemented on this platform.");
+    return SCM_UNDEFINED;       /* dummy */
+#endif /*GAUCHE_WINDOWS*/
+}
+
 /* Low level message builder */
 ScmObj Scm_SocketBuildMsg(ScmSockAddr *name, ScmVector *iov,
                           ScmObj control, int flags,
@@ -44,14 +44,20 @@
           SHUT_RD SHUT_WR SHUT_RDWR
           socket-address socket-status socket-input-port socket-output-port
           socket-shutdown socket-close socket-bind socket-connect socket-fd
-          socket-listen socket-accept socket-setsockopt socket-getsockopt
+          socket-listen socket-accept socket-accept-all
+          socket-set-nonblocking! socket-setsockopt socket-getsockopt
           socket-getsockname socket-getpeername socket-ioctl
           socket-send socket-sendto socket-sendmsg socket-buildmsg
           socket-recv socket-recv! socket-recvfrom socket-recvfrom!
+          socket-recvmmsg! socket-sendmmsg
           <sockaddr> <sockaddr-in> <sockaddr-un> make-sockaddrs
           sockaddr-name sockaddr-family sockaddr-addr sockaddr-port
           make-client-socket make-server-socket make-server-sockets
+          make-reuse-port-server-sockets
           call-with-client-socket
+          make-sockaddr-resolver sockaddr-resolver? default-sockaddr-resolver
+          resolve-sockaddrs resolve-sockaddrs-async
+          sockaddr-resolver-flush! sockaddr-resolver-shutdown!
           <sys-hostent> sys-gethostbyname sys-gethostbyaddr
           <sys-protoent> sys-getprotobyname sys-getprotobynumber
           <sys-servent> sys-getservbyname sys-getservbyport
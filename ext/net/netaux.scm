@@ -36,6 +36,9 @@
 (use gauche.sequence)
 (use gauche.lazy)
 (use util.match)
+(use gauche.threads)
+(use gauche.record)
+(use data.queue)
 
 ;; default backlog value for socket-listen
 (define-constant DEFAULT_BACKLOG 5)
@@ -80,6 +83,9 @@
         [(is-a? proto <sockaddr>)
          ;; caller provided sockaddr
          (make-client-socket-from-addr proto)]
+        [(and (pair? proto) (every (cut is-a? <> <sockaddr>) proto))
+         ;; caller provided candidate addresses, e.g. from resolve-sockaddrs
+         (make-client-socket-from-addrs proto)]
         [(and (string? proto)
               (pair? args)
               (integer? (car args)))
@@ -97,13 +103,17 @@
     (socket-connect socket (make <sockaddr-un> :path path))))
 
 (define (make-client-socket-inet host port)
+  (make-client-socket-from-addrs (make-sockaddrs host port)))
+
+;; Try ADDRS in order and returns the first socket that connects.
+(define (make-client-socket-from-addrs addrs)
   (let1 err #f
     (define (try-connect address)
       (guard (e [else (set! err e) #f])
         (rlet1 socket (make-socket (address->protocol-family address)
                                   SOCK_STREAM)
           (socket-connect socket address))))
-    (rlet1 socket (any try-connect (make-sockaddrs host port))
+    (rlet1 socket (any try-connect addrs)
       (unless socket (raise err)))))
 
 ;; API
@@ -134,6 +144,7 @@
          (error "unsupported protocol:" proto)]))
 
 (define (make-server-socket-from-addr addr :key (reuse-addr? #f)
+                                                (reuse-port? #f)
                                                 (sock-init #f)
                                                 (backlog DEFAULT_BACKLOG))
   (rlet1 socket (make-socket (address->protocol-family addr) SOCK_STREAM)
@@ -141,9 +152,40 @@
       (sock-init socket addr))
     (when reuse-addr?
       (socket-setsockopt socket SOL_SOCKET SO_REUSEADDR 1))
+    (when reuse-port?
+      (socket-setsockopt socket SOL_SOCKET (%so-reuseport) 1))
     (socket-bind socket addr)
     (socket-listen socket backlog)))
 
+;; SO_REUSEPORT isn't defined on all platforms, so we look it up at runtime.
+(define (%so-reuseport)
+  (or (global-variable-ref (find-module 'gauche.net) 'SO_REUSEPORT #f)
+      (error "SO_REUSEPORT isn't supported on this platform")))
+
+;; API
+;; Opens COUNT listening sockets bound to the same address with
+;; SO_REUSEPORT, so that the kernel distributes incoming connections
+;; among them.  The intended use is that each worker thread accepts on
+;; its own socket, instead of having a single accepting thread.
+(define (make-reuse-port-server-sockets count port
+                                        :key (host #f)
+                                             (nonblocking? #f)
+                                             (sock-init #f)
+                                             (backlog DEFAULT_BACKLOG))
+  (define socks '())
+  (define (open addr)
+    (rlet1 s (make-server-socket-from-addr addr :reuse-port? #t
+                                           :sock-init sock-init
+                                           :backlog backlog)
+      (push! socks s)
+      (when nonblocking? (socket-set-nonblocking! s #t))))
+  (guard (e [else (for-each socket-close socks) (raise e)])
+    (let1 s0 (open (car (make-sockaddrs host port)))
+      ;; If PORT is 0, the rest must bind to the port chosen for s0.
+      (let1 addr (socket-getsockname s0)
+        (dotimes [(- count 1)] (open addr))
+        (reverse socks)))))
+
 
 (define (make-server-socket-unix path :key (backlog DEFAULT_BACKLOG))
   (rlet1 socket (make-socket PF_UNIX SOCK_STREAM)
@@ -260,6 +302,196 @@
                (slot-ref hh 'addresses)))
         (list (make <sockaddr-in> :host :any :port port))))))
 
+;;;
+;;; Cached and asynchronous address resolution
+;;;
+
+;; Name lookup by make-sockaddrs may take a long time and blocks the
+;; calling thread.  A resolver keeps the results in a table for TTL
+;; seconds (and failures for NEGATIVE-TTL seconds), and runs lookups
+;; on a small pool of threads for the asynchronous interface.
+;; Concurrent requests for the same key share one lookup.
+;;
+;;   cache   - (host port proto) -> (expiry #t . addrs) or
+;;             (expiry #f . condition)
+;;   pending - (host port proto) -> list of delivery procedures waiting
+;;             for an ongoing lookup
+;;   queue   - <mtqueue> of jobs for worker threads
+
+(define-record-type <sockaddr-resolver> %make-sockaddr-resolver
+  sockaddr-resolver?
+  (ttl          resolver-ttl)
+  (negative-ttl resolver-negative-ttl)
+  (max-entries  resolver-max-entries)
+  (num-threads  resolver-num-threads)
+  (cache        resolver-cache)
+  (pending      resolver-pending)
+  (mutex        resolver-mutex)
+  (queue        resolver-queue)
+  (workers      resolver-workers resolver-workers-set!))
+
+;; API
+(define (make-sockaddr-resolver :key (ttl 60) (negative-ttl 5)
+                                     (max-entries 1024) (num-threads 4))
+  (%make-sockaddr-resolver ttl negative-ttl max-entries num-threads
+                           (make-hash-table 'equal?) (make-hash-table 'equal?)
+                           (make-mutex) (make-mtqueue) '()))
+
+(define *default-resolver* #f)
+(define *default-resolver-mutex* (make-mutex))
+
+;; API
+(define (default-sockaddr-resolver)
+  (with-locking-mutex *default-resolver-mutex*
+    (^[] (or *default-resolver*
+             (rlet1 r (make-sockaddr-resolver)
+               (set! *default-resolver* r))))))
+
+(define (%resolver-now) (time->seconds (current-time)))
+
+;; Returns (#t . addrs), (#f . condition), or #f if no valid entry.
+;; Must be called with the resolver mutex held.
+(define (%resolver-lookup r key)
+  (and-let* ([e (hash-table-get (resolver-cache r) key #f)])
+    (if (< (%resolver-now) (car e))
+      (cdr e)
+      (begin (hash-table-delete! (resolver-cache r) key) #f))))
+
+;; Must be called with the resolver mutex held.
+(define (%resolver-store! r key ok? val)
+  (let ([tab (resolver-cache r)]
+        [ttl (if ok? (resolver-ttl r) (resolver-negative-ttl r))])
+    (when (and (> ttl 0) (> (resolver-max-entries r) 0))
+      (when (>= (hash-table-num-entries tab) (resolver-max-entries r))
+        ;; Drop expired entries; if that's not enough, drop the one
+        ;; to expire first.
+        (let1 now (%resolver-now)
+          (hash-table-for-each tab (^[k e] (when (<= (car e) now)
+                                             (hash-table-delete! tab k)))))
+        (when (>= (hash-table-num-entries tab) (resolver-max-entries r))
+          (let1 victim (hash-table-fold tab
+                                        (^[k e acc]
+                                          (if (or (not acc)
+                                                  (< (car e) (cadr acc)))
+                                            (cons k e)
+                                            acc))
+                                        #f)
+            (hash-table-delete! tab (car victim)))))
+      (hash-table-put! tab key `(,(+ (%resolver-now) ttl) ,ok? . ,val)))))
+
+;; Runs the lookup for KEY and delivers the outcome to everyone waiting
+;; for it.  DELIVER is called as (deliver addrs condition).
+(define (%resolver-run! r key)
+  (let* ([val (guard (e [else (cons #f e)])
+                (cons #t (apply make-sockaddrs key)))]
+         [waiters (with-locking-mutex (resolver-mutex r)
+                    (^[] (%resolver-store! r key (car val) (cdr val))
+                         (begin0 (hash-table-get (resolver-pending r) key '())
+                           (hash-table-delete! (resolver-pending r) key))))])
+    (dolist [deliver (reverse waiters)]
+      (if (car val)
+        (deliver (cdr val) #f)
+        (deliver #f (cdr val))))))
+
+(define (%resolver-start-worker! r)
+  (let1 t (make-thread
+           (^[] (let loop ()
+                  (let1 key (dequeue/wait! (resolver-queue r))
+                    (unless (eq? key 'stop)
+                      (guard (e [else #f]) (%resolver-run! r key))
+                      (loop)))))
+           "sockaddr-resolver")
+    (resolver-workers-set! r (cons t (resolver-workers r)))
+    (thread-start! t)))
+
+;; Returns #t if the caller should run the lookup of KEY itself, #f if
+;; DELIVER has been called with a cached value or queued for an ongoing
+;; lookup.  Cached values are delivered outside of the mutex.
+(define (%resolver-request! r key deliver)
+  (let1 hit (with-locking-mutex (resolver-mutex r)
+              (^[] (or (%resolver-lookup r key)
+                       (let1 pending (resolver-pending r)
+                         (if (hash-table-exists? pending key)
+                           (begin (hash-table-push! pending key deliver)
+                                  'pending)
+                           (begin (hash-table-put! pending key (list deliver))
+                                  #f))))))
+    (cond [(not hit) #t]
+          [(eq? hit 'pending) #f]
+          [(car hit) (deliver (cdr hit) #f) #f]
+          [else (deliver #f (cdr hit)) #f])))
+
+(define (%resolver-key host port proto) (list host port proto))
+
+;; API
+;; Like make-sockaddrs, but consults the resolver's cache first.
+(define (resolve-sockaddrs host port
+                           :key (proto 'tcp)
+                                (resolver (default-sockaddr-resolver)))
+  (let* ([key (%resolver-key host port proto)]
+         [result #f]
+         [mutex (make-mutex)]
+         [cv (make-condition-variable)]
+         [deliver (^[addrs err]
+                    (with-locking-mutex mutex
+                      (^[] (set! result (cons addrs err))
+                           (condition-variable-broadcast! cv))))])
+    (when (%resolver-request! resolver key deliver)
+      (%resolver-run! resolver key))
+    ;; If someone else is looking up the same key, wait for it.
+    (let loop ()
+      (mutex-lock! mutex)
+      (if result
+        (mutex-unlock! mutex)
+        (begin (mutex-unlock! mutex cv) (loop))))
+    (if (cdr result) (raise (cdr result)) (car result))))
+
+;; API
+;; TARGET is either a procedure, called as (target addrs condition) when
+;; the lookup is done, or an <mtqueue>, into which (host port addrs
+;; condition) is enqueued.  Exactly one of addrs and condition is #f.
+;; The procedure may be called in the calling thread on a cache hit, or
+;; in a resolver thread otherwise.
+(define (resolve-sockaddrs-async host port target
+                                 :key (proto 'tcp)
+                                      (resolver (default-sockaddr-resolver)))
+  (let* ([key (%resolver-key host port proto)]
+         [deliver (cond [(mtqueue? target)
+                         (^[addrs err]
+                           (enqueue! target (list host port addrs err)))]
+                        [(applicable? target <top> <top>) target]
+                        [else (error "procedure or <mtqueue> required, \
+                                      but got:" target)])])
+    (when (%resolver-request! resolver key deliver)
+      (if (eq? (gauche-thread-type) 'none)
+        (%resolver-run! resolver key)
+        (begin
+          (with-locking-mutex (resolver-mutex resolver)
+            (^[] (when (< (length (resolver-workers resolver))
+                          (resolver-num-threads resolver))
+                   (%resolver-start-worker! resolver))))
+          (enqueue! (resolver-queue resolver) key))))
+    (undefined)))
+
+;; API
+(define (sockaddr-resolver-flush! resolver :optional (host #f))
+  (with-locking-mutex (resolver-mutex resolver)
+    (^[] (if host
+           (let1 tab (resolver-cache resolver)
+             (dolist [k (hash-table-keys tab)]
+               (when (equal? (car k) host) (hash-table-delete! tab k))))
+           (hash-table-clear! (resolver-cache resolver))))))
+
+;; API
+;; Stops the worker threads after the queued lookups are done.  The
+;; resolver can still be used; workers are restarted on demand.
+(define (sockaddr-resolver-shutdown! resolver)
+  (let1 ws (with-locking-mutex (resolver-mutex resolver)
+             (^[] (begin0 (resolver-workers resolver)
+                    (resolver-workers-set! resolver '()))))
+    (dolist [_ ws] (enqueue! (resolver-queue resolver) 'stop))
+    (for-each thread-join! ws)))
+
 ;; API
 (define (call-with-client-socket socket proc
                                  :key (input-buffering #f) (output-buffering #f))
@@ -219,12 +219,49 @@
 (define-cproc socket-listen (sock::<socket> backlog::<fixnum>)
   Scm_SocketListen)
 
-(define-cproc socket-accept (sock::<socket>)
-  Scm_SocketAccept)
+(define-cise-expr accept-flags
+  [(_ nonblocking close-on-exec)
+   `(logior (?: ,nonblocking SCM_SOCKET_ACCEPT_NONBLOCK 0)
+            (?: ,close-on-exec SCM_SOCKET_ACCEPT_CLOEXEC 0))])
+
+(define-cproc socket-accept (sock::<socket>
+                             :key (nonblocking::<boolean> #f)
+                                  (close-on-exec::<boolean> #f))
+  (return (Scm_SocketAcceptWithFlags sock (accept-flags nonblocking
+                                                        close-on-exec))))
+
+(define-cproc socket-accept-all (sock::<socket>
+                                 :key (max::<int> 0)
+                                      (nonblocking::<boolean> #f)
+                                      (close-on-exec::<boolean> #f))
+  (return (Scm_SocketAcceptAll sock (accept-flags nonblocking close-on-exec)
+                               max)))
+
+(define-cproc socket-set-nonblocking! (sock::<socket> flag::<boolean>)
+  Scm_SocketSetNonblocking)
 
 (define-cproc socket-connect (sock::<socket> addr::<socket-address>)
   Scm_SocketConnect)
 
+;; Internal; used by the modules that do accept/connect on their own
+;; (e.g. gauche.iouring), to keep <socket> in sync.
+(define-cproc %socket-accepted (sock::<socket> fd::<int>
+                                addr::<u8vector> addrlen::<int>)
+  (when (or (< addrlen 0) (> addrlen (SCM_U8VECTOR_SIZE addr)))
+    (Scm_Error "address length out of range: %d" addrlen))
+  (return (Scm_SocketAccepted sock fd
+                              (cast (struct sockaddr*)
+                                    (SCM_U8VECTOR_ELEMENTS addr))
+                              addrlen)))
+
+(define-cproc %socket-connected! (sock::<socket> addr::<socket-address>)
+  Scm_SocketConnected)
+
+(define-cproc %sockaddr-bytes (addr::<socket-address>)
+  (return (Scm_MakeU8VectorFromArray (-> addr addrlen)
+                                     (cast (const unsigned char*)
+                                           (& (-> addr addr))))))
+
 (define-cproc socket-getsockname (sock::<socket>)
   Scm_SocketGetSockName)
 
@@ -247,8 +284,10 @@
   Scm_SocketRecv)
 
 (define-cproc socket-recv! (sock::<socket> buf::<uvector>
-                           :optional (flags::<fixnum> 0))
-  Scm_SocketRecvX)
+                           :optional (flags::<fixnum> 0)
+                                     (start::<fixnum> 0)
+                                     (end::<fixnum> -1))
+  Scm_SocketRecvXRange)
 
 (define-cproc socket-recvfrom (sock::<socket> bytes::<fixnum>
                                :optional (flags::<fixnum> 0))
@@ -258,6 +297,15 @@
                                 :optional (flags::<fixnum> 0))
   Scm_SocketRecvFromX)
 
+;; batched datagram I/O
+(define-cproc socket-recvmmsg! (sock::<socket> bufs::<vector> sizes::<uvector>
+                                addrs :optional (flags::<fixnum> 0))
+  Scm_SocketRecvMMsg)
+
+(define-cproc socket-sendmmsg (sock::<socket> msgs::<vector>
+                               :optional (to #f) (flags::<fixnum> 0))
+  Scm_SocketSendMMsg)
+
 ;; struct msghdr builder
 (define-cproc socket-buildmsg (name::<socket-address>?
                                iov::<vector>?
@@ -8,6 +8,8 @@
 (use gauche.uvector)
 (use srfi-1)
 (use srfi-13)
+(use data.queue)
+(use util.match)
 (test-start "net")
 
 (use gauche.net)
@@ -264,6 +266,32 @@
             '(23       21)
             '("tcp"    "tcp")))
 
+(let ([r (make-sockaddr-resolver :ttl 60)]
+      [names (^[addrs] (map sockaddr-name addrs))])
+  (test* "resolve-sockaddrs" (names (make-sockaddrs "127.0.0.1" 80))
+         (names (resolve-sockaddrs "127.0.0.1" 80 :resolver r)))
+  (test* "resolve-sockaddrs (cached)" #t
+         (eq? (resolve-sockaddrs "127.0.0.1" 80 :resolver r)
+              (resolve-sockaddrs "127.0.0.1" 80 :resolver r)))
+  (test* "sockaddr-resolver-flush!" #f
+         (let1 a (resolve-sockaddrs "127.0.0.1" 80 :resolver r)
+           (sockaddr-resolver-flush! r "127.0.0.1")
+           (eq? a (resolve-sockaddrs "127.0.0.1" 80 :resolver r))))
+  (test* "resolve-sockaddrs-async (mtqueue)"
+         `(("127.0.0.1" 81 ,(names (make-sockaddrs "127.0.0.1" 81)) #f))
+         (let1 q (make-mtqueue)
+           (resolve-sockaddrs-async "127.0.0.1" 81 q :resolver r)
+           (match-let1 (h p addrs err) (dequeue/wait! q)
+             (list (list h p (names addrs) err)))))
+  (test* "resolve-sockaddrs-async (procedure)" '(#t #f)
+         (let ([q (make-mtqueue)])
+           (resolve-sockaddrs-async "127.0.0.1" 82
+                                    (^[addrs err]
+                                      (enqueue! q (list (pair? addrs) err)))
+                                    :resolver r)
+           (dequeue/wait! q)))
+  (sockaddr-resolver-shutdown! r))
+
 ;;-----------------------------------------------------------------
 (test-section "Packet utility")
 
@@ -477,6 +505,43 @@
                  (socket-close clnt)
                  (socket-close serv))))
 
+(test* "socket-accept-all" '(() 3 #t ())
+       (let* ([addr (make <sockaddr-in> :host :loopback :port *inet-port*)]
+              [serv (make-server-socket addr :reuse-addr? #t)])
+         (socket-set-nonblocking! serv #t)
+         (let* ([r0 (socket-accept-all serv)]
+                [clnts (map (^_ (make-client-socket addr)) (iota 3))]
+                [r1 (socket-accept-all serv :close-on-exec #t)]
+                [r2 (socket-accept-all serv)])
+           (begin0 (list r0 (length r1)
+                         (every (^s (eq? (socket-status s) 'connected)) r1)
+                         r2)
+             (for-each socket-close (append r1 clnts))
+             (socket-close serv)))))
+
+(test* "socket-accept on non-blocking socket" #f
+       (let1 serv (make-server-socket
+                   (make <sockaddr-in> :host :loopback :port *inet-port*)
+                   :reuse-addr? #t)
+         (socket-set-nonblocking! serv #t)
+         (begin0 (socket-accept serv :nonblocking #t)
+           (socket-close serv))))
+
+(when (global-variable-bound? 'gauche.net 'SO_REUSEPORT)
+  (test* "make-reuse-port-server-sockets" '(4 #t 2)
+         (let* ([socks (make-reuse-port-server-sockets 4 0 :host "127.0.0.1"
+                                                       :nonblocking? #t)]
+                [ports (map (^s (sockaddr-port (socket-getsockname s))) socks)]
+                [clnts (map (^_ (make-client-socket 'inet "127.0.0.1"
+                                                    (car ports)))
+                            (iota 2))]
+                ;; The kernel may dispatch the connections to any of them.
+                [accepted (append-map socket-accept-all socks)])
+           (begin0 (list (length socks)
+                         (every (cut = (car ports) <>) ports)
+                         (length accepted))
+             (for-each socket-close (append accepted clnts socks))))))
+
 (test* "udp server socket" #t
        (begin
          (with-output-to-file "testserv.o"
@@ -542,6 +607,17 @@
                 (list (eq? f-addr from)
                       (equal? buf data))))))))
 
+(with-sr-udp
+ (^[s-sock s-addr r-sock r-addr]
+   (let1 buf (make-u8vector 8 0)
+     (test* "socket-recv! with range" '(3 #u8(0 0 97 98 99 0 0 0))
+            (begin
+              (socket-sendto s-sock "abc" s-addr)
+              (let1 n (socket-recv! r-sock buf 0 2 6)
+                (list n buf))))
+     (test* "socket-recv! with bad range" (test-error)
+            (socket-recv! r-sock buf 0 6 2)))))
+
 (cond-expand
  ;; NB: as of 0.9, sendmsg fails on cygwin.  We don't have time to track
  ;; it down yet.  For now, we skip the tests.
@@ -567,7 +643,23 @@
                             $ vector->list data)))))
 
        (test* "udp sendmsg w/sendbuf" '(#t #t) (xtest sbuf))
-       (test* "udp sendmsg w/o sendbuf" '(#t #t) (xtest #f)))))]
+       (test* "udp sendmsg w/o sendbuf" '(#t #t) (xtest #f)))))
+  (with-sr-udp
+   (^[s-sock s-addr r-sock r-addr]
+     (let ([bufs (vector-tabulate 8 (^_ (make-u8vector 16 0)))]
+           [sizes (make-s32vector 8 -1)]
+           [addrs (vector-tabulate 8 (^_ (make <sockaddr-in>)))]
+           [msgs '#("a" "bb" "ccc" "dddd" "eeeee")])
+       (test* "udp sendmmsg/recvmmsg" '(5 5 #(1 2 3 4 5 -1 -1 -1) #t
+                                        ("a" "bb" "ccc" "dddd" "eeeee"))
+              (let* ([nsent (socket-sendmmsg s-sock msgs s-addr)]
+                     [a0 (vector-ref addrs 0)]
+                     [nrecv (socket-recvmmsg! r-sock bufs sizes addrs)])
+                (list nsent nrecv (list->vector (s32vector->list sizes))
+                      (eq? a0 (vector-ref addrs 0))
+                      (map (^i (u8vector->string (vector-ref bufs i) 0
+                                                 (s32vector-ref sizes i)))
+                           (iota nrecv))))))))]
  [else #f])
 
 ;;-----------------------------------------------------------------
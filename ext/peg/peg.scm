@@ -58,7 +58,7 @@
           $sep-by $end-by $sep-end-by
           $count $between $followed-by
           $not $many-till $chain-left $chain-right
-          $lazy
+          $lazy $memo
 
           $s $c $y
           $string $string-ci
@@ -235,10 +235,15 @@
                                 [else (loop (+ c 1) (cdr s))]))
                         s1))
 
+;; Memo table for $memo.  The driver sets up a fresh table for each
+;; parse, mapping an input position to an alist of (parser . results).
+(define %memo-table (make-parameter #f))
+
 ;; API
 ;;   Default driver.  Returns parsed value and next stream
 (define (peg-run-parser parser s)
-  (receive (r v s1) (parser s)
+  (receive (r v s1) (parameterize ([%memo-table (make-hash-table 'eq?)])
+                      (parser s))
     (if (parse-success? r)
       (values (rope-finalize v) s1)
       (raise (construct-peg-parser-error r v s s1)))))
@@ -270,10 +275,11 @@
 ;; API
 ;;  Returns a generator
 (define (peg-parser->generator parser src)
-  (let1 s (%->lseq src)
+  (let ([s (%->lseq src)]
+        [memo (make-hash-table 'eq?)])
     (^[] (if (null? s)
            (eof-object)
-           (receive (r v s1) (parser s)
+           (receive (r v s1) (parameterize ([%memo-table memo]) (parser s))
              (cond [(not (parse-success? r))
                     (raise (construct-peg-parser-error r v s s1))]
                    [(eof-object? v) (set! s '()) v]
@@ -480,6 +486,26 @@
      (let ((p (delay parse)))
        (lambda (s) ((force p) s)))]))
 
+;; API
+;; $memo parser
+;;   Packrat memoization.  The result of PARSER at each input position
+;;   is remembered during a parse driven by peg-run-parser and its
+;;   friends, so PARSER runs at most once per position even if the
+;;   enclosing alternatives backtrack over it.  Wrap the rules that
+;;   are retried at the same position by $try/$or.  Left recursion is
+;;   not supported.
+;;   If PARSER is called outside of the drivers, no memoization is done.
+(define ($memo parse)
+  (^s (if-let1 tab (%memo-table)
+        (if-let1 e (assq parse (hash-table-get tab s '()))
+          (values (vector-ref (cdr e) 0)
+                  (vector-ref (cdr e) 1)
+                  (vector-ref (cdr e) 2))
+          (receive (r v s1) (parse s)
+            (hash-table-push! tab s (cons parse (vector r v s1)))
+            (values r v s1)))
+        (parse s))))
+
 ;; alternative $lazy possibility (need benchmark!)
 ;(define-syntax $lazy
 ;  (syntax-rules ()
@@ -512,15 +538,17 @@
 ;; $many1 p :optional max
 (define-inline ($many parse :optional (min 0) (max #f))
   (%check-min-max min max)
-  (lambda (s)
-    (let loop ([vs '()] [s s] [count 0])
-      (if (>=? count max)
-        (return-result (reverse! vs) s)
-        (receive (r v s1) (parse s)
-          (cond [(parse-success? r) (loop (cons v vs) s1 (+ count 1))]
-                [(and (eq? s s1) (<= min count))
-                 (return-result (reverse! vs) s1)]
-                [else (values r v s1)]))))))
+  (if-let1 cs (%one-of-parser-charset parse)
+    (%make-many-chars-parser cs min max) ;fast path for ($many ($one-of cs))
+    (lambda (s)
+      (let loop ([vs '()] [s s] [count 0])
+        (if (>=? count max)
+          (return-result (reverse! vs) s)
+          (receive (r v s1) (parse s)
+            (cond [(parse-success? r) (loop (cons v vs) s1 (+ count 1))]
+                  [(and (eq? s s1) (<= min count))
+                   (return-result (reverse! vs) s1)]
+                  [else (values r v s1)])))))))
 
 (define ($many1 parse :optional (max #f))
   (if max
@@ -692,6 +720,107 @@
 ;;; Intermediate structure constructor
 ;;;
 
+;;;============================================================
+;;; Native terminal parsers
+;;;
+
+;; The common terminal parsers are subrs that scan the input directly,
+;; instead of closures built on $satisfy.  They return the same results
+;; as the generic definitions would.
+
+(inline-stub
+ "typedef struct many_chars_packet_rec {
+    ScmCharSet *cs;
+    ScmSmallInt min;
+    ScmSmallInt max;            /* -1 for unlimited */
+ } many_chars_packet;"
+
+ (define-cfn char-parser (args::ScmObj* nargs::int data::void*) :static
+   (let* ([s (aref args 0)]
+          [c (SCM_OBJ data)])
+     (if (and (SCM_PAIRP s) (SCM_EQ (SCM_CAR s) c))
+       (return (Scm_Values3 SCM_FALSE c (SCM_CDR s)))
+       (return (Scm_Values3 'fail-expect c s)))))
+
+ (define-cfn one-of-parser (args::ScmObj* nargs::int data::void*) :static
+   (let* ([s (aref args 0)])
+     (when (SCM_PAIRP s)
+       (let* ([c (SCM_CAR s)])
+         (when (and (SCM_CHARP c)
+                    (Scm_CharSetContains (cast ScmCharSet* data)
+                                         (SCM_CHAR_VALUE c)))
+           (return (Scm_Values3 SCM_FALSE c (SCM_CDR s))))))
+     (return (Scm_Values3 'fail-expect (SCM_OBJ data) s))))
+
+ ;; DATA is (string . list-of-chars)
+ (define-cfn string-parser-int (s data ci::int) :static
+   (let* ([h SCM_NIL] [t SCM_NIL] [p s])
+     (dolist [c (SCM_CDR data)]
+       (unless (SCM_PAIRP p)
+         (return (Scm_Values3 'fail-expect (SCM_CAR data) s)))
+       (let* ([x (SCM_CAR p)])
+         (unless (or (SCM_EQ x c)
+                     (and ci (SCM_CHARP x)
+                          (== (Scm_CharFoldcase (SCM_CHAR_VALUE x))
+                              (Scm_CharFoldcase (SCM_CHAR_VALUE c)))))
+           (return (Scm_Values3 'fail-expect (SCM_CAR data) s)))
+         (SCM_APPEND1 h t x)
+         (set! p (SCM_CDR p))))
+     (return (Scm_Values3 SCM_FALSE (Scm_Cons 'rope h) p))))
+
+ (define-cfn string-parser (args::ScmObj* nargs::int data::void*) :static
+   (return (string-parser-int (aref args 0) (SCM_OBJ data) FALSE)))
+
+ (define-cfn string-ci-parser (args::ScmObj* nargs::int data::void*) :static
+   (return (string-parser-int (aref args 0) (SCM_OBJ data) TRUE)))
+
+ (define-cfn many-chars-parser (args::ScmObj* nargs::int data::void*) :static
+   (let* ([d::many_chars_packet* (cast many_chars_packet* data)]
+          [h SCM_NIL] [t SCM_NIL]
+          [p (aref args 0)]
+          [count::ScmSmallInt 0])
+     (while (or (< (-> d max) 0) (< count (-> d max)))
+       (unless (SCM_PAIRP p) (break))
+       (let* ([c (SCM_CAR p)])
+         (unless (and (SCM_CHARP c)
+                      (Scm_CharSetContains (-> d cs) (SCM_CHAR_VALUE c)))
+           (break))
+         (SCM_APPEND1 h t c)
+         (set! p (SCM_CDR p))
+         (pre++ count)))
+     (if (< count (-> d min))
+       (return (Scm_Values3 'fail-expect (SCM_OBJ (-> d cs)) p))
+       (return (Scm_Values3 SCM_FALSE h p)))))
+
+ (define-cproc %make-char-parser (c::<char>)
+   (return (Scm_MakeSubr char_parser (cast void* (SCM_MAKE_CHAR c))
+                         1 0 '$char)))
+
+ (define-cproc %make-one-of-parser (cs::<char-set>)
+   (return (Scm_MakeSubr one_of_parser cs 1 0 '$one-of)))
+
+ (define-cproc %make-string-parser (str::<string> ci::<boolean>)
+   (let* ([data (Scm_Cons (Scm_CopyStringWithFlags str SCM_STRING_IMMUTABLE
+                                                     SCM_STRING_IMMUTABLE)
+                          (Scm_StringToList str))])
+     (return (Scm_MakeSubr (?: ci string_ci_parser string_parser)
+                           data 1 0 (?: ci '$string-ci '$string)))))
+
+ (define-cproc %make-many-chars-parser (cs::<char-set> min::<fixnum> max)
+   (let* ([d::many_chars_packet* (SCM_NEW many_chars_packet)])
+     (set! (-> d cs) cs
+           (-> d min) min
+           (-> d max) (?: (SCM_INTP max) (SCM_INT_VALUE max) -1))
+     (return (Scm_MakeSubr many_chars_parser d 1 0 '$many-chars))))
+
+ ;; If PARSER is created by $one-of, returns its char-set.  Otherwise #f.
+ (define-cproc %one-of-parser-charset (parser)
+   (if (and (SCM_SUBRP parser)
+            (== (SCM_SUBR_FUNC parser) one_of_parser))
+     (return (SCM_OBJ (SCM_SUBR_DATA parser)))
+     (return SCM_FALSE)))
+ )
+
 ;;;============================================================
 ;;; String parsers
 ;;;
@@ -720,34 +849,17 @@
              (cons ca cd)))]
         [else obj]))
 
-(define-values ($string $string-ci)
-  (let-syntax
-      ([expand
-        (syntax-rules ()
-          ((_ char=)
-           (lambda (str)
-             (let1 lis (string->list str)
-               (lambda (s0)
-                 (let loop ((r '()) (s s0) (lis lis))
-                   (if (null? lis)
-                     (return-result (make-rope (reverse! r)) s)
-                     (if (and (pair? s)
-                              (char= (car s) (car lis)))
-                       (loop (cons (car s) r) (cdr s) (cdr lis))
-                       (return-failure/expect str s0)))))))))])
-    (values (expand char=?)
-            (expand char-ci=?))))
-
-(define ($char c)
-  ($satisfy (cut char=? c <>) c))
+(define ($string str) (%make-string-parser str #f))
+
+(define ($string-ci str) (%make-string-parser str #t))
+
+(define ($char c) (%make-char-parser c))
 
 (define ($char-ci c)
   ($satisfy (cut char-ci=? c <>)
             (list->char-set c (char-upcase c) (char-downcase c))))
 
-(define ($one-of charset)
-  ($satisfy (cut char-set-contains? charset <>)
-            charset))
+(define ($one-of charset) (%make-one-of-parser charset))
 
 (define ($s x) ($string x))
 
@@ -756,12 +868,9 @@
 (define ($y x) ($lift ($ string->symbol $ rope->string $) ($s x)))
 
 ;; ($many-chars charset [min [max]]) == ($many ($one-of charset) [min [max]])
-;;   with possible optimization.
-(define-syntax $many-chars
-  (syntax-rules ()
-    [(_ parser) ($many ($one-of parser))]
-    [(_ parser min) ($many ($one-of parser) min)]
-    [(_ parser min max) ($many ($one-of parser) min max)]))
+(define ($many-chars charset :optional (min 0) (max #f))
+  (%check-min-max min max)
+  (%make-many-chars-parser charset min max))
 
 (define ($none-of charset)
   ($one-of (char-set-complement charset)))
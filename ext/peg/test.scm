@@ -118,6 +118,11 @@
 (test-fail "$none-of" '(0 #[^a-z]) ($none-of #[a-z]) "j")
 (test-succ "$string-ci" "aBC" ($string-ci "abc") "aBCdef")
 (test-fail "$string-ci" '(0 "abc") ($string-ci "abc") "012")
+(test-fail "$string (partial)" '(0 "abc") ($string "abc") "ab")
+(test-succ "$many ($one-of)" '(#\a #\b) ($many ($one-of #[a-z]) 1 2) "abc")
+(test-fail "$many ($one-of)" '(2 #[a-z]) ($many ($one-of #[a-z]) 3) "ab1")
+(test* "$one-of (non-char input)" 'fail-expect
+       (values-ref (($one-of #[a-z]) '(1 2)) 0))
 
 (define-syntax test-char
   (syntax-rules ()
@@ -495,6 +500,34 @@
              "abc+efg")
   )
 
+;;;============================================================
+;;; Memoization
+;;;
+(test-section "memoization")
+
+(let* ([count 0]
+       [item ($do [v ($many-chars #[a-z] 1)]
+                  ($return (begin (inc! count) (list->string v))))]
+       [mitem ($memo item)]
+       [parser (^[it] ($or ($try ($seq it ($char #\;)))
+                           ($try ($seq it ($char #\,)))
+                           it))])
+  (test* "without $memo" '("abc" 3)
+         (let1 v (peg-parse-string (parser item) "abc.")
+           (list v count)))
+  (set! count 0)
+  (test* "$memo" '("abc" 1)
+         (let1 v (peg-parse-string (parser mitem) "abc.")
+           (list v count)))
+  (set! count 0)
+  (test* "$memo (per parse)" '("xyz" 1)
+         (let1 v (peg-parse-string (parser mitem) "xyz.")
+           (list v count)))
+  (test-fail "$memo failure" '(0 #[a-z]) mitem "123"))
+
+(test* "$memo outside driver" '(#f #\a)
+       (receive (r v s) (($memo ($char #\a)) '(#\a)) (list r v)))
+
 ;;;============================================================
 ;;; Token Parsers
 ;;;
@@ -824,6 +857,114 @@
   (t '#(1 2 x))
   (t '(("a" . 2) 9)))
 
+(test* "parse-json repeatedly" '(#(1) (("a" . 2)) "x" 3 eof)
+       (call-with-input-string "[1] {\"a\":2}\n\"x\" 3  "
+         (^p (let loop ([r '()])
+               (let1 v (parse-json p)
+                 (if (eof-object? v)
+                   (reverse (cons 'eof r))
+                   (loop (cons v r))))))))
+(test* "parse-json leaves rest" "]"
+       (call-with-input-string "true ]"
+         (^p (parse-json p) (string (read-char p)))))
+
+(let ()
+  (define (t str)
+    (test* #"parse error ~str" (test-error <json-parse-error>)
+           (parse-json-string str)))
+  (t "[1,]")
+  (t "1.")
+  (t "[1 2]")
+  (t "\"\\q\"")
+  (t "\"abc")
+  (t "tru")
+  (t (string-append (make-string 10001 #\[) (make-string 10001 #\]))))
+
+(let ()
+  (define s1 (make-string 100000 #\a))
+  (define s2 (string-append (make-string 70 #\z) "\u00e9\u00e9"))
+  (test* "long string" s1
+         (parse-json-string (string-append "\"" s1 "\"")))
+  (test* "non-ascii string" s2
+         (parse-json-string (string-append "\"" s2 "\"")))
+  (test* "long string roundtrip" (vector s1 s2)
+         (parse-json-string (construct-json-string (vector s1 s2)))))
+
+(test* "numbers" '#(1234567890123456789012345 -12345678901234567890 100.0 -0.0)
+       (parse-json-string
+        "[1234567890123456789012345, -12345678901234567890, 1E2, -0.0]"))
+
+(test* "custom handlers with defaults" '#(("a" . #(true)) ("b" . 1))
+       (parameterize ([json-array-handler list->vector]
+                      [json-object-handler car])
+         (parse-json-string "[{\"a\":[true]},{\"b\":1}]")))
+
+(test* "writing non-ascii" "[\"\\u00e9\"]"
+       (construct-json-string '#("\u00e9")))
+(test* "writing symbol keys" "{\"a\":1,\"b\":null}"
+       (construct-json-string '((a . 1) (b . null))))
+(test* "writing ratnum" "[0.5]"
+       (construct-json-string '#(1/2)))
+(test* "writing infinity" (test-error <json-construct-error>)
+       (construct-json-string '#(+inf.0)))
+(cond-expand
+ [gauche.ces.utf8
+  (test* "writing surrogate pair" "[\"\\ud867\\ude3d\"]"
+         (construct-json-string '#("\x29e3d;")))]
+ [else])
+
+(let ()
+  (define (events str)
+    (generator->list (call-with-input-string str json-event-generator)))
+  (test* "json-event-generator"
+         '((start-object . #f) (key . "a") (start-array . #f)
+           (value . 1) (start-object . #f) (end-object . #f)
+           (start-array . #f) (end-array . #f) (value . "x")
+           (end-array . #f) (key . "b") (value . null) (end-object . #f)
+           (value . 2))
+         (events "{\"a\": [1, {}, [], \"x\"], \"b\": null} 2"))
+  (test* "json-event-generator special handler" '((value . #f))
+         (parameterize ([json-special-handler (^_ #f)])
+           (events "false")))
+  (dolist [s '("[1,]" "[1 2]" "{\"a\" 1}" "{1:2}" "[1}" "[" "]" "{\"a\":}")]
+    (test* #"json-event-generator error ~s" (test-error <json-parse-error>)
+           (events s))))
+
+(test* "json-fold" '(4 . 2)
+       (call-with-input-string "[1, [2, {\"k\": 3}], \"y\"]"
+         (cut json-fold (^[ev _ seed]
+                          (case ev
+                            [(value) (cons (+ (car seed) 1) (cdr seed))]
+                            [(start-array) (cons (car seed) (+ (cdr seed) 1))]
+                            [else seed]))
+              '(0 . 0) <>)))
+
+(let ()
+  (define (t path str)
+    (generator->list
+     (call-with-input-string str (cut json-path-generator path <>))))
+  (define data
+    "{\"data\": [{\"id\": 1, \"x\": [0]}, {\"id\": 2, \"id2\": 3}, {}],
+      \"id\": 4}")
+  (test* "json-path-generator" '(1 2) (t '("data" * "id") data))
+  (test* "json-path-generator" '((("id" . 2) ("id2" . 3)))
+         (t '("data" 1) data))
+  (test* "json-path-generator" '(#(0)) (t '("data" 0 "x") data))
+  (test* "json-path-generator" '(#((("id" . 1) ("x" . #(0)))
+                                   (("id" . 2) ("id2" . 3))
+                                   ())
+                                 4)
+         (t '(*) data))
+  (test* "json-path-generator toplevel" '(1 #() "a")
+         (t '() "1 [] \"a\""))
+  (test* "json-path-generator array" '(1 2 3)
+         (t '(*) "[1,2,3] [] []"))
+  (test* "json-path-generator nomatch" '() (t '("z") data))
+  (test* "json-path-generator error" (test-error <json-parse-error>)
+         (t '(*) "[1,2"))
+  (test* "json-path-generator bad path" (test-error)
+         (t '(x) data)))
+
 (test* "generalized array" "[1,2,3]"
        (construct-json-string '#u8(1 2 3)))
 (test* "generalized object" (test-one-of "{\"a\":1,\"b\":2}"
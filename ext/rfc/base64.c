@@ -0,0 +1,706 @@
+/*
+ * base64.c - Base64 encoder and decoder for rfc.base64
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The encoder and the decoder work on byte arrays, so that strings and
+ * u8vectors can be handled without going through ports.  The port
+ * versions feed them in chunks.
+ *
+ * The bulk of the work, encoding 3-byte groups and decoding runs of
+ * valid Base64 characters, is done by SIMD kernels when available:
+ * SSSE3 or AVX2 on x86 (chosen at runtime), and NEON on AArch64.
+ * The remaining bytes, as well as the characters to be skipped
+ * (newlines etc.), are handled by the scalar code.
+ */
+
+#include <string.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "gauche/priv/portP.h"
+#include "base64.h"
+
+#if (defined(__x86_64__) || defined(__i386__))                          \
+    && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))     \
+    && !defined(SCM_EMULATE_INT64)
+#define B64_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define B64_NEON 1
+#include <arm_neon.h>
+#endif
+
+static const char standard_encode_table[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char url_safe_encode_table[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+#define B64_INVALID  (-1)
+#define B64_PAD      (-2)
+
+/* Filled by Scm_Init_base64. */
+static signed char standard_decode_table[256];
+static signed char url_safe_decode_table[256];
+
+#define ENCODE_TABLE(url_safe) \
+    ((url_safe) ? url_safe_encode_table : standard_encode_table)
+#define DECODE_TABLE(url_safe) \
+    ((url_safe) ? url_safe_decode_table : standard_decode_table)
+
+/* The characters for the sextets 62 and 63. */
+#define C62(url_safe)  ((url_safe) ? '-' : '+')
+#define C63(url_safe)  ((url_safe) ? '_' : '/')
+
+/* The decode kernels may write this many bytes past the decoded data. */
+#define DECODE_SLACK 16
+
+/*================================================================
+ * x86 kernels
+ *
+ *   The bit shuffling follows the well-known technique by Wojciech Mula
+ *   and Alfred Klomp.  Encoding takes 12 (24) bytes and makes 16 (32)
+ *   characters; decoding takes 16 (32) characters and makes 12 (24)
+ *   bytes, bailing out as soon as a chunk contains anything other than
+ *   the alphabet, which the scalar code takes care of.
+ */
+
+#if defined(B64_X86)
+
+#define FEATURE_SSSE3 1
+#define FEATURE_AVX2  2
+
+/* -1: not checked yet */
+static int x86_features = -1;
+
+static int check_x86_features(void)
+{
+    unsigned int a, b, c, d;
+    int r = 0;
+    if (__get_cpuid(1, &a, &b, &c, &d)) {
+        if (c & (1U<<9)) r |= FEATURE_SSSE3;
+        if ((c & (1U<<27)) && __get_cpuid_max(0, NULL) >= 7) { /* OSXSAVE */
+            unsigned int lo, hi;
+            __asm__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+            if ((lo & 6) == 6) {            /* XMM and YMM state */
+                __cpuid_count(7, 0, a, b, c, d);
+                if (b & (1U<<5)) r |= FEATURE_AVX2;
+            }
+        }
+    }
+    /* Setting it more than once from different threads is harmless. */
+    x86_features = r;
+    return r;
+}
+
+#define FEATURES() \
+    (x86_features >= 0 ? x86_features : check_x86_features())
+
+/* Offsets to add to a sextet to get its character, indexed by
+   0 for 26..51, 1-10 for 52..61, 11 for 62, 12 for 63 and 13 for 0..25. */
+#define ENC_OFFSETS(url_safe)                                           \
+    71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4,                         \
+    (url_safe) ? '-'-62 : '+'-62, (url_safe) ? '_'-63 : '/'-63,         \
+    65, 0, 0
+
+__attribute__((target("ssse3")))
+static ScmSmallInt encode_ssse3(const u_char *src, ScmSmallInt len, char *dst,
+                                int url_safe)
+{
+    const __m128i shuf = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4,
+                                       7, 6, 8, 7, 10, 9, 11, 10);
+    const __m128i lut = _mm_setr_epi8(ENC_OFFSETS(url_safe));
+    ScmSmallInt i = 0;
+    char *p = dst;
+
+    for (; i+16 <= len; i += 12, p += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src+i));
+        in = _mm_shuffle_epi8(in, shuf);
+        __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+        __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+        __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        __m128i idx = _mm_or_si128(t1, t3);
+        __m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+        __m128i lt = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+        r = _mm_or_si128(r, _mm_and_si128(lt, _mm_set1_epi8(13)));
+        _mm_storeu_si128((__m128i*)p,
+                         _mm_add_epi8(idx, _mm_shuffle_epi8(lut, r)));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static ScmSmallInt encode_avx2(const u_char *src, ScmSmallInt len, char *dst,
+                               int url_safe)
+{
+    const __m256i shuf = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4,
+                                          7, 6, 8, 7, 10, 9, 11, 10,
+                                          1, 0, 2, 1, 4, 3, 5, 4,
+                                          7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i lut = _mm256_setr_epi8(ENC_OFFSETS(url_safe),
+                                         ENC_OFFSETS(url_safe));
+    ScmSmallInt i = 0;
+    char *p = dst;
+
+    /* Each lane takes 12 bytes; the upper one is loaded from SRC+12. */
+    for (; i+28 <= len; i += 24, p += 32) {
+        __m256i in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(src+i))),
+            _mm_loadu_si128((const __m128i*)(src+i+12)), 1);
+        in = _mm256_shuffle_epi8(in, shuf);
+        __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+        __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+        __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        __m256i idx = _mm256_or_si256(t1, t3);
+        __m256i r = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+        __m256i lt = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx);
+        r = _mm256_or_si256(r, _mm256_and_si256(lt, _mm256_set1_epi8(13)));
+        _mm256_storeu_si256((__m256i*)p,
+                            _mm256_add_epi8(idx, _mm256_shuffle_epi8(lut, r)));
+    }
+    return i;
+}
+
+/* Sets OUT to the sextets of IN, and OK to the mask of the bytes that
+   are in the alphabet.  Bytes >= 0x80 are negative as signed, so they
+   never fall in the ranges. */
+#define DECODE_TRANSLATE(V, SET1, AND, OR, ADD, CMPGT, CMPEQ,           \
+                         in, out, ok, url_safe)                         \
+    do {                                                                \
+        V upper_ = AND(CMPGT(in, SET1('A'-1)), CMPGT(SET1('Z'+1), in)); \
+        V lower_ = AND(CMPGT(in, SET1('a'-1)), CMPGT(SET1('z'+1), in)); \
+        V digit_ = AND(CMPGT(in, SET1('0'-1)), CMPGT(SET1('9'+1), in)); \
+        V c62_ = CMPEQ(in, SET1(C62(url_safe)));                        \
+        V c63_ = CMPEQ(in, SET1(C63(url_safe)));                        \
+        V valid_ = OR(OR(OR(upper_, lower_), OR(digit_, c62_)), c63_);  \
+        V shift_ = OR(OR(AND(upper_, SET1(-'A')),                       \
+                         AND(lower_, SET1(26-'a'))),                    \
+                      OR(OR(AND(digit_, SET1(52-'0')),                  \
+                            AND(c62_, SET1(62-C62(url_safe)))),         \
+                         AND(c63_, SET1(63-C63(url_safe)))));           \
+        out = ADD(in, shift_);                                          \
+        ok = valid_;                                                    \
+    } while (0)
+
+__attribute__((target("ssse3")))
+static ScmSmallInt decode_ssse3(const u_char *src, ScmSmallInt len,
+                                u_char *dst, int url_safe)
+{
+    const __m128i shuf = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+                                       14, 13, 12, -1, -1, -1, -1);
+    ScmSmallInt i = 0;
+    u_char *p = dst;
+
+    for (; i+16 <= len; i += 16, p += 12) {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src+i)), ok, s;
+        DECODE_TRANSLATE(__m128i, _mm_set1_epi8, _mm_and_si128, _mm_or_si128,
+                         _mm_add_epi8, _mm_cmpgt_epi8, _mm_cmpeq_epi8,
+                         in, s, ok, url_safe);
+        if (_mm_movemask_epi8(ok) != 0xffff) break;
+        /* 00aaaaaa 00bbbbbb 00cccccc 00dddddd -> 24 bits per 32 */
+        s = _mm_maddubs_epi16(s, _mm_set1_epi32(0x01400140));
+        s = _mm_madd_epi16(s, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128((__m128i*)p, _mm_shuffle_epi8(s, shuf));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static ScmSmallInt decode_avx2(const u_char *src, ScmSmallInt len,
+                               u_char *dst, int url_safe)
+{
+    const __m256i shuf = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+                                          14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8,
+                                          14, 13, 12, -1, -1, -1, -1);
+    const __m256i perm = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+    ScmSmallInt i = 0;
+    u_char *p = dst;
+
+    for (; i+32 <= len; i += 32, p += 24) {
+        __m256i in = _mm256_loadu_si256((const __m256i*)(src+i)), ok, s;
+        DECODE_TRANSLATE(__m256i, _mm256_set1_epi8, _mm256_and_si256,
+                         _mm256_or_si256, _mm256_add_epi8, _mm256_cmpgt_epi8,
+                         _mm256_cmpeq_epi8, in, s, ok, url_safe);
+        if (_mm256_movemask_epi8(ok) != -1) break;
+        s = _mm256_maddubs_epi16(s, _mm256_set1_epi32(0x01400140));
+        s = _mm256_madd_epi16(s, _mm256_set1_epi32(0x00011000));
+        s = _mm256_shuffle_epi8(s, shuf);
+        _mm256_storeu_si256((__m256i*)p, _mm256_permutevar8x32_epi32(s, perm));
+    }
+    return i;
+}
+
+#endif /*B64_X86*/
+
+/*================================================================
+ * NEON kernels
+ *
+ *   The interleaving loads and stores do the bit shuffling for us.
+ *   Encoding takes 48 bytes and makes 64 characters; decoding takes
+ *   64 characters and makes 48 bytes.
+ */
+
+#if defined(B64_NEON)
+
+static ScmSmallInt encode_neon(const u_char *src, ScmSmallInt len, char *dst,
+                               int url_safe)
+{
+    const char *table = ENCODE_TABLE(url_safe);
+    uint8x16x4_t lut;
+    const uint8x16_t m = vdupq_n_u8(0x3f);
+    ScmSmallInt i = 0;
+    char *p = dst;
+
+    lut.val[0] = vld1q_u8((const uint8_t*)table);
+    lut.val[1] = vld1q_u8((const uint8_t*)table+16);
+    lut.val[2] = vld1q_u8((const uint8_t*)table+32);
+    lut.val[3] = vld1q_u8((const uint8_t*)table+48);
+
+    for (; i+48 <= len; i += 48, p += 64) {
+        uint8x16x3_t in = vld3q_u8(src+i);
+        uint8x16x4_t out;
+        out.val[0] = vshrq_n_u8(in.val[0], 2);
+        out.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[1], 4),
+                                       vshlq_n_u8(in.val[0], 4)), m);
+        out.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[2], 6),
+                                       vshlq_n_u8(in.val[1], 2)), m);
+        out.val[3] = vandq_u8(in.val[2], m);
+        out.val[0] = vqtbl4q_u8(lut, out.val[0]);
+        out.val[1] = vqtbl4q_u8(lut, out.val[1]);
+        out.val[2] = vqtbl4q_u8(lut, out.val[2]);
+        out.val[3] = vqtbl4q_u8(lut, out.val[3]);
+        vst4q_u8((uint8_t*)p, out);
+    }
+    return i;
+}
+
+/* Returns the sextets of IN; clears *OK if IN contains a character
+   outside of the alphabet. */
+static inline uint8x16_t decode_translate_neon(uint8x16_t in, int url_safe,
+                                               uint8x16_t *ok)
+{
+#define IN_RANGE(lo, hi) \
+    vandq_u8(vcgeq_u8(in, vdupq_n_u8(lo)), vcleq_u8(in, vdupq_n_u8(hi)))
+    uint8x16_t upper = IN_RANGE('A', 'Z');
+    uint8x16_t lower = IN_RANGE('a', 'z');
+    uint8x16_t digit = IN_RANGE('0', '9');
+#undef IN_RANGE
+    uint8x16_t c62 = vceqq_u8(in, vdupq_n_u8(C62(url_safe)));
+    uint8x16_t c63 = vceqq_u8(in, vdupq_n_u8(C63(url_safe)));
+#define SHIFT(mask, delta)  vandq_u8(mask, vdupq_n_u8((uint8_t)(delta)))
+    uint8x16_t shift =
+        vorrq_u8(vorrq_u8(SHIFT(upper, -'A'), SHIFT(lower, 26-'a')),
+                 vorrq_u8(vorrq_u8(SHIFT(digit, 52-'0'),
+                                   SHIFT(c62, 62-C62(url_safe))),
+                          SHIFT(c63, 63-C63(url_safe))));
+#undef SHIFT
+    uint8x16_t valid = vorrq_u8(vorrq_u8(vorrq_u8(upper, lower),
+                                         vorrq_u8(digit, c62)), c63);
+    *ok = vandq_u8(*ok, valid);
+    return vaddq_u8(in, shift);
+}
+
+static ScmSmallInt decode_neon(const u_char *src, ScmSmallInt len,
+                               u_char *dst, int url_safe)
+{
+    ScmSmallInt i = 0;
+    u_char *p = dst;
+
+    for (; i+64 <= len; i += 64, p += 48) {
+        uint8x16x4_t in = vld4q_u8(src+i);
+        uint8x16_t ok = vdupq_n_u8(0xff);
+        uint8x16_t a = decode_translate_neon(in.val[0], url_safe, &ok);
+        uint8x16_t b = decode_translate_neon(in.val[1], url_safe, &ok);
+        uint8x16_t c = decode_translate_neon(in.val[2], url_safe, &ok);
+        uint8x16_t d = decode_translate_neon(in.val[3], url_safe, &ok);
+        if (vminvq_u8(ok) == 0) break;
+        uint8x16x3_t out;
+        out.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+        out.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+        out.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+        vst3q_u8(p, out);
+    }
+    return i;
+}
+
+#endif /*B64_NEON*/
+
+/*================================================================
+ * Encoder
+ */
+
+/* Encodes the complete 3-byte groups at the beginning of SRC into DST.
+   Returns the number of bytes consumed, which is a multiple of 3.
+   DST gets 4/3 times as many characters. */
+static ScmSmallInt encode_groups(const u_char *src, ScmSmallInt len,
+                                 char *dst, int url_safe)
+{
+    const char *table = ENCODE_TABLE(url_safe);
+    ScmSmallInt i = 0;
+
+#if defined(B64_X86)
+    int f = FEATURES();
+    if (f & FEATURE_AVX2) {
+        i = encode_avx2(src, len, dst, url_safe);
+    } else if (f & FEATURE_SSSE3) {
+        i = encode_ssse3(src, len, dst, url_safe);
+    }
+#elif defined(B64_NEON)
+    i = encode_neon(src, len, dst, url_safe);
+#endif
+
+    char *p = dst + i/3*4;
+    for (; i+3 <= len; i += 3, p += 4) {
+        u_long v = ((u_long)src[i]<<16) | ((u_long)src[i+1]<<8) | src[i+2];
+        p[0] = table[v>>18];
+        p[1] = table[(v>>12)&0x3f];
+        p[2] = table[(v>>6)&0x3f];
+        p[3] = table[v&0x3f];
+    }
+    return i;
+}
+
+/* Encodes the last 1 or 2 bytes into 4 characters, with padding. */
+static void encode_tail(const u_char *src, ScmSmallInt len, char *dst,
+                        int url_safe)
+{
+    const char *table = ENCODE_TABLE(url_safe);
+    u_long v = (u_long)src[0]<<16;
+    if (len > 1) v |= (u_long)src[1]<<8;
+    dst[0] = table[v>>18];
+    dst[1] = table[(v>>12)&0x3f];
+    dst[2] = (len > 1) ? table[(v>>6)&0x3f] : '=';
+    dst[3] = '=';
+}
+
+/* Inserts a newline after every WIDTH characters of BUF[0..N), where
+   the first character is at column *COL.  BUF must have room for the
+   newlines.  Returns the new length and updates *COL. */
+static ScmSmallInt insert_newlines(char *buf, ScmSmallInt n,
+                                   int width, int *col)
+{
+    ScmSmallInt nl = (*col + n) / width;
+    ScmSmallInt seg = (*col + n) % width; /* chars after the last newline */
+    ScmSmallInt total = n + nl;
+    char *s = buf + n, *d = buf + total;
+
+    *col = (int)seg;
+    for (; nl > 0; nl--, seg = width) {
+        s -= seg;
+        d -= seg;
+        memmove(d, s, seg);
+        *--d = '\n';
+    }
+    return total;
+}
+
+ScmObj Scm_Base64Encode(const u_char *src, ScmSmallInt len,
+                        int line_width, int url_safe)
+{
+    ScmSmallInt nchars = (len+2)/3*4;
+    ScmSmallInt size = nchars + (line_width > 0 ? nchars/line_width : 0);
+    char *buf = SCM_NEW_ATOMIC2(char*, size+1);
+
+    ScmSmallInt k = encode_groups(src, len, buf, url_safe);
+    if (k < len) encode_tail(src+k, len-k, buf+k/3*4, url_safe);
+    if (line_width > 0) {
+        int col = 0;
+        insert_newlines(buf, nchars, line_width, &col);
+    }
+    buf[size] = '\0';
+    return Scm_MakeString(buf, size, size, 0);
+}
+
+#define ENCODE_CHUNK  3072      /* must be a multiple of 3 */
+
+void Scm_Base64EncodePort(ScmPort *in, ScmPort *out,
+                          int line_width, int url_safe)
+{
+    u_char ibuf[ENCODE_CHUNK];
+    /* Enough even if we have a newline after every character */
+    char obuf[ENCODE_CHUNK/3*4*2];
+    ScmSmallInt carry = 0;
+    int col = 0;
+
+    for (;;) {
+        int r = Scm_Getz((char*)ibuf+carry, (int)(ENCODE_CHUNK-carry), in);
+        if (r <= 0) break;
+        ScmSmallInt n = carry + r;
+        ScmSmallInt k = encode_groups(ibuf, n, obuf, url_safe);
+        ScmSmallInt olen = k/3*4;
+        if (line_width > 0) {
+            olen = insert_newlines(obuf, olen, line_width, &col);
+        }
+        if (olen > 0) Scm_Putz(obuf, (int)olen, out);
+        carry = n - k;
+        memmove(ibuf, ibuf+k, carry);
+    }
+    if (carry > 0) {
+        ScmSmallInt olen = 4;
+        encode_tail(ibuf, carry, obuf, url_safe);
+        if (line_width > 0) {
+            olen = insert_newlines(obuf, olen, line_width, &col);
+        }
+        Scm_Putz(obuf, (int)olen, out);
+    }
+}
+
+/*================================================================
+ * Decoder
+ *
+ *   Like the original Scheme version, characters outside of the
+ *   alphabet are skipped, and the decoding stops at the first '='.
+ *   Trailing bits that don't fill a byte are discarded.
+ */
+
+typedef struct b64_decoder_rec {
+    int url_safe;
+    const signed char *table;
+    u_long bits;                /* pending sextets */
+    int nsextets;               /* # of pending sextets (0-3) */
+    int done;                   /* TRUE if we've seen '=' */
+} b64_decoder;
+
+static void decoder_init(b64_decoder *d, int url_safe)
+{
+    d->url_safe = url_safe;
+    d->table = DECODE_TABLE(url_safe);
+    d->bits = 0;
+    d->nsextets = 0;
+    d->done = FALSE;
+}
+
+/* Decodes runs of 4 valid characters at the beginning of SRC.  Returns
+   the number of characters consumed, which is a multiple of 4.  DST
+   gets 3/4 as many bytes; it may be written up to DECODE_SLACK bytes
+   beyond that. */
+static ScmSmallInt decode_groups(const u_char *src, ScmSmallInt len,
+                                 u_char *dst, int url_safe)
+{
+    const signed char *table = DECODE_TABLE(url_safe);
+    ScmSmallInt i = 0;
+
+#if defined(B64_X86)
+    int f = FEATURES();
+    if (f & FEATURE_AVX2) {
+        i = decode_avx2(src, len, dst, url_safe);
+    } else if (f & FEATURE_SSSE3) {
+        i = decode_ssse3(src, len, dst, url_safe);
+    }
+#elif defined(B64_NEON)
+    i = decode_neon(src, len, dst, url_safe);
+#endif
+
+    u_char *p = dst + i/4*3;
+    for (; i+4 <= len; i += 4, p += 3) {
+        int a = table[src[i]], b = table[src[i+1]];
+        int c = table[src[i+2]], e = table[src[i+3]];
+        if ((a|b|c|e) < 0) break;
+        u_long v = ((u_long)a<<18) | ((u_long)b<<12) | ((u_long)c<<6) | e;
+        p[0] = (u_char)(v>>16);
+        p[1] = (u_char)(v>>8);
+        p[2] = (u_char)v;
+    }
+    return i;
+}
+
+/* Feeds SRC[0..LEN) to the decoder, writing the decoded bytes to DST,
+   which must have room for LEN*3/4+DECODE_SLACK bytes.  Stops right
+   after '='.  Returns the number of bytes written, and sets *CONSUMED
+   to the number of characters consumed. */
+static ScmSmallInt decode_chunk(b64_decoder *d, const u_char *src,
+                                ScmSmallInt len, u_char *dst,
+                                ScmSmallInt *consumed)
+{
+    u_char *p = dst;
+    ScmSmallInt i = 0;
+
+    while (i < len && !d->done) {
+        if (d->nsextets == 0) {
+            ScmSmallInt k = decode_groups(src+i, len-i, p, d->url_safe);
+            i += k;
+            p += k/4*3;
+            if (i >= len) break;
+        }
+        int v = d->table[src[i++]];
+        if (v >= 0) {
+            d->bits = (d->bits<<6) | v;
+            if (++d->nsextets == 4) {
+                *p++ = (u_char)(d->bits>>16);
+                *p++ = (u_char)(d->bits>>8);
+                *p++ = (u_char)d->bits;
+                d->bits = 0;
+                d->nsextets = 0;
+            }
+        } else if (v == B64_PAD) {
+            d->done = TRUE;
+        }
+    }
+    *consumed = i;
+    return p - dst;
+}
+
+/* Flushes the pending sextets.  Returns the number of bytes written
+   to DST (0-2). */
+static ScmSmallInt decode_finish(b64_decoder *d, u_char *dst)
+{
+    switch (d->nsextets) {
+    case 2:
+        dst[0] = (u_char)(d->bits>>4);
+        return 1;
+    case 3:
+        dst[0] = (u_char)(d->bits>>10);
+        dst[1] = (u_char)(d->bits>>2);
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+ScmObj Scm_Base64Decode(const u_char *src, ScmSmallInt len,
+                        int url_safe, int to_u8vector)
+{
+    u_char *buf = SCM_NEW_ATOMIC2(u_char*, len/4*3 + 3 + DECODE_SLACK);
+    b64_decoder d;
+    ScmSmallInt consumed;
+
+    decoder_init(&d, url_safe);
+    ScmSmallInt n = decode_chunk(&d, src, len, buf, &consumed);
+    n += decode_finish(&d, buf+n);
+    if (to_u8vector) {
+        return Scm_MakeU8VectorFromArrayShared(n, buf);
+    } else {
+        buf[n] = '\0';
+        return Scm_MakeString((char*)buf, n, -1, 0);
+    }
+}
+
+/* Like json.c, we look at the port buffer directly when it is
+   available, so that we can stop right after '=' without consuming
+   the rest of the input. */
+static inline int fast_range(ScmPort *port, const char **cur, const char **end)
+{
+    if (port->closed || port->scrcnt > 0
+        || port->ungotten != SCM_CHAR_INVALID) return FALSE;
+    switch (SCM_PORT_TYPE(port)) {
+    case SCM_PORT_FILE:
+        *cur = port->src.buf.current;
+        *end = port->src.buf.end;
+        return (*cur < *end);
+    case SCM_PORT_ISTR:
+        *cur = port->src.istr.current;
+        *end = port->src.istr.end;
+        return (*cur < *end);
+    default:
+        return FALSE;
+    }
+}
+
+static inline void fast_advance(ScmPort *port, const char *newcur)
+{
+    const char *cur = (SCM_PORT_TYPE(port) == SCM_PORT_FILE)
+        ? port->src.buf.current : port->src.istr.current;
+    u_long lines = 0;
+    for (const char *q = cur; (q = memchr(q, '\n', newcur - q)) != NULL; q++) {
+        lines++;
+    }
+    if (SCM_PORT_TYPE(port) == SCM_PORT_FILE) {
+        port->src.buf.current = (char*)newcur;
+    } else {
+        port->src.istr.current = newcur;
+    }
+    port->bytes += newcur - cur;
+    port->line += lines;
+}
+
+#define DECODE_CHUNK  4096
+
+static void decode_port(ScmPort *in, ScmPort *out, int url_safe)
+{
+    u_char obuf[DECODE_CHUNK/4*3 + 3 + DECODE_SLACK];
+    b64_decoder d;
+    ScmSmallInt n, consumed;
+
+    decoder_init(&d, url_safe);
+    while (!d.done) {
+        const char *cur, *end;
+        if (fast_range(in, &cur, &end)) {
+            if (end - cur > DECODE_CHUNK) end = cur + DECODE_CHUNK;
+            n = decode_chunk(&d, (const u_char*)cur, end - cur, obuf,
+                             &consumed);
+            fast_advance(in, cur + consumed);
+        } else {
+            /* This also refills the buffer for the next round. */
+            int b = Scm_GetbUnsafe(in);
+            if (b == EOF) break;
+            u_char c = (u_char)b;
+            n = decode_chunk(&d, &c, 1, obuf, &consumed);
+        }
+        if (n > 0) Scm_Putz((char*)obuf, (int)n, out);
+    }
+    n = decode_finish(&d, obuf);
+    if (n > 0) Scm_Putz((char*)obuf, (int)n, out);
+}
+
+void Scm_Base64DecodePort(ScmPort *in, ScmPort *out, int url_safe)
+{
+    ScmVM *vm = Scm_VM();
+    if (PORT_LOCKED(in, vm)) {
+        decode_port(in, out, url_safe);
+    } else {
+        PORT_LOCK(in, vm);
+        PORT_SAFE_CALL(in, decode_port(in, out, url_safe), /*no cleanup*/);
+        PORT_UNLOCK(in);
+    }
+}
+
+/*================================================================
+ * Initialization
+ */
+
+static void init_decode_table(signed char *table, const char *alphabet)
+{
+    memset(table, B64_INVALID, 256);
+    for (int i = 0; i < 64; i++) table[(u_char)alphabet[i]] = (signed char)i;
+    table['='] = B64_PAD;
+}
+
+void Scm_Init_base64(void)
+{
+    init_decode_table(standard_decode_table, standard_encode_table);
+    init_decode_table(url_safe_decode_table, url_safe_encode_table);
+}
@@ -0,0 +1,61 @@
+/*
+ * base64.h - Base64 encoder and decoder for rfc.base64
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_RFC_BASE64_H
+#define GAUCHE_RFC_BASE64_H
+
+#include <gauche.h>
+
+SCM_DECL_BEGIN
+
+/* Encodes LEN bytes from SRC and returns a string.  A newline is
+   inserted after every LINE_WIDTH characters, unless it is 0. */
+extern ScmObj Scm_Base64Encode(const u_char *src, ScmSmallInt len,
+                               int line_width, int url_safe);
+
+/* Decodes the Base64 characters in SRC and returns the result as
+   a string, or a u8vector if TO_U8VECTOR is true. */
+extern ScmObj Scm_Base64Decode(const u_char *src, ScmSmallInt len,
+                               int url_safe, int to_u8vector);
+
+/* Port versions.  The encoder reads IN up to EOF.  The decoder stops
+   reading IN right after '=', if any. */
+extern void Scm_Base64EncodePort(ScmPort *in, ScmPort *out,
+                                 int line_width, int url_safe);
+extern void Scm_Base64DecodePort(ScmPort *in, ScmPort *out, int url_safe);
+
+extern void Scm_Init_base64(void);
+
+SCM_DECL_END
+
+#endif /*GAUCHE_RFC_BASE64_H*/
@@ -0,0 +1,714 @@
+/*
+ * json.c - native JSON parser and writer for rfc.json
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "gauche/priv/portP.h"
+#include "json.h"
+
+static ScmModule *json_module = NULL;
+static ScmObj sym_true  = SCM_UNBOUND;
+static ScmObj sym_false = SCM_UNBOUND;
+static ScmObj sym_null  = SCM_UNBOUND;
+
+/* Nesting limit of arrays and objects, to keep the C stack bounded. */
+#define JSON_MAX_DEPTH 10000
+
+/*================================================================
+ * Port buffer access
+ *
+ *   Like the reader, we scan the bytes in the port buffer directly
+ *   when they're available (a file port or an input string port,
+ *   with nothing in the scratch or ungotten slots), and fall back
+ *   to Getc otherwise.
+ */
+
+static inline int fast_range(ScmPort *port, const char **cur, const char **end)
+{
+    if (port->closed || port->scrcnt > 0
+        || port->ungotten != SCM_CHAR_INVALID) return FALSE;
+    switch (SCM_PORT_TYPE(port)) {
+    case SCM_PORT_FILE:
+        *cur = port->src.buf.current;
+        *end = port->src.buf.end;
+        return (*cur < *end);
+    case SCM_PORT_ISTR:
+        *cur = port->src.istr.current;
+        *end = port->src.istr.end;
+        return (*cur < *end);
+    default:
+        return FALSE;
+    }
+}
+
+/* Consumes bytes up to NEWCUR, which contain LINES newlines. */
+static inline void fast_advance(ScmPort *port, const char *newcur, u_long lines)
+{
+    if (SCM_PORT_TYPE(port) == SCM_PORT_FILE) {
+        port->bytes += newcur - port->src.buf.current;
+        port->src.buf.current = (char*)newcur;
+    } else {
+        port->bytes += newcur - port->src.istr.current;
+        port->src.istr.current = newcur;
+    }
+    port->line += lines;
+}
+
+/*================================================================
+ * Parser
+ */
+
+typedef struct json_parser_rec {
+    ScmPort *port;
+    ScmObj array_handler;       /* #f for the default (list->vector) */
+    ScmObj object_handler;      /* #f for the default (identity) */
+    ScmObj special_handler;     /* #f for the default (identity) */
+    int depth;
+} json_parser;
+
+#define JGETC(p)        Scm_GetcUnsafe((p)->port)
+
+/* Raises <json-parse-error>.  Never returns. */
+static void parse_error(json_parser *p, ScmObj objs, ScmObj msg)
+{
+    static ScmObj proc = SCM_UNDEFINED;
+    SCM_BIND_PROC(proc, "%json-parse-error", json_module);
+    Scm_ApplyRec3(proc, Scm_MakeIntegerU(p->port->bytes), objs, msg);
+    Scm_Error("%%json-parse-error returned");  /* NOTREACHED */
+}
+
+static void unexpected(json_parser *p, int c)
+{
+    if (c == EOF) {
+        parse_error(p, SCM_NIL, SCM_MAKE_STR("unexpected end of input"));
+    } else {
+        parse_error(p, SCM_LIST1(SCM_MAKE_CHAR(c)),
+                    Scm_Sprintf("unexpected character: %C", c));
+    }
+}
+
+/* Returns the next non-whitespace character, consuming it. */
+static int skip_ws(json_parser *p)
+{
+    const char *cur, *end;
+    if (fast_range(p->port, &cur, &end)) {
+        const char *q = cur;
+        u_long lines = 0;
+        int c = EOF;
+        while (q < end) {
+            unsigned char b = (unsigned char)*q;
+            if (b == '\n') { lines++; q++; continue; }
+            if (b == ' ' || b == '\t' || b == '\r') { q++; continue; }
+            if (b < 0x80) { c = b; q++; }
+            break;
+        }
+        fast_advance(p->port, q, lines);
+        if (c != EOF) return c;
+    }
+    for (;;) {
+        int c = JGETC(p);
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') continue;
+        return c;
+    }
+}
+
+static ScmObj parse_value(json_parser *p, int c);
+
+static ScmObj parse_special(json_parser *p, const char *rest, ScmObj sym)
+{
+    for (; *rest; rest++) {
+        int c = JGETC(p);
+        if (c != *rest) unexpected(p, c);
+    }
+    if (SCM_FALSEP(p->special_handler)) return sym;
+    return Scm_ApplyRec1(p->special_handler, sym);
+}
+
+/*
+ * Numbers
+ *   [+-]? digit+ ('.' digit+)? ([eE] [+-]? digit+)?
+ *   Integers without fraction and exponent are exact.
+ */
+
+#define JSON_NUMBUF 64
+
+/* Integers up to this many digits are computed directly in a long. */
+#if SIZEOF_LONG >= 8
+#define JSON_FAST_DIGITS 18
+#else
+#define JSON_FAST_DIGITS 9
+#endif
+
+static inline int number_char_p(int c)
+{
+    return ((c >= '0' && c <= '9') || c == '+' || c == '-'
+            || c == '.' || c == 'e' || c == 'E');
+}
+
+/* Checks the syntax.  Returns the number of integer digits, or -1
+   if the token isn't a valid number.  *INTP is set to TRUE if the
+   token is an integer. */
+static int scan_number(const char *s, int len, int *intp)
+{
+    int i = 0, ndigits = 0;
+    *intp = TRUE;
+    if (i < len && (s[i] == '+' || s[i] == '-')) i++;
+    while (i < len && s[i] >= '0' && s[i] <= '9') { i++; ndigits++; }
+    if (ndigits == 0) return -1;
+    if (i < len && s[i] == '.') {
+        int n = 0;
+        for (i++; i < len && s[i] >= '0' && s[i] <= '9'; i++) n++;
+        if (n == 0) return -1;
+        *intp = FALSE;
+    }
+    if (i < len && (s[i] == 'e' || s[i] == 'E')) {
+        int n = 0;
+        i++;
+        if (i < len && (s[i] == '+' || s[i] == '-')) i++;
+        for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) n++;
+        if (n == 0) return -1;
+        *intp = FALSE;
+    }
+    return (i == len)? ndigits : -1;
+}
+
+static ScmObj convert_number(json_parser *p, char *s, int len)
+{
+    int intp;
+    int ndigits = scan_number(s, len, &intp);
+    if (ndigits < 0) {
+        ScmObj tok = Scm_MakeString(s, len, len, SCM_STRING_COPYING);
+        parse_error(p, SCM_LIST1(tok), Scm_Sprintf("invalid number: %A", tok));
+    }
+    if (*s == '+') { s++; len--; }
+    if (intp && ndigits <= JSON_FAST_DIGITS) {
+        long v = 0;
+        int neg = (*s == '-');
+        for (int i = neg? 1 : 0; i < len; i++) v = v*10 + (s[i] - '0');
+        return Scm_MakeInteger(neg? -v : v);
+    }
+    for (int i = 0; i < len; i++) if (s[i] == 'E') s[i] = 'e';
+    ScmObj r = Scm_StringToNumber(SCM_STRING(Scm_MakeString(s, len, len,
+                                                             SCM_STRING_COPYING)),
+                                  10, 0);
+    if (SCM_FALSEP(r)) {
+        ScmObj tok = Scm_MakeString(s, len, len, SCM_STRING_COPYING);
+        parse_error(p, SCM_LIST1(tok), Scm_Sprintf("invalid number: %A", tok));
+    }
+    return r;
+}
+
+static ScmObj parse_number(json_parser *p, int c)
+{
+    char buf[JSON_NUMBUF];
+    int len = 0;
+    const char *cur, *end;
+
+    buf[len++] = (char)c;
+    if (fast_range(p->port, &cur, &end)) {
+        const char *q = cur;
+        while (q < end && number_char_p((unsigned char)*q)) q++;
+        if (q < end && len + (q - cur) < JSON_NUMBUF) {
+            memcpy(buf + len, cur, q - cur);
+            len += (int)(q - cur);
+            fast_advance(p->port, q, 0);
+            return convert_number(p, buf, len);
+        }
+    }
+
+    ScmDString ds;
+    int use_ds = FALSE;
+    for (;;) {
+        c = JGETC(p);
+        if (c == EOF || !number_char_p(c)) break;
+        if (!use_ds && len >= JSON_NUMBUF) {
+            Scm_DStringInit(&ds);
+            Scm_DStringPutz(&ds, buf, len);
+            use_ds = TRUE;
+        }
+        if (use_ds) Scm_DStringPutb(&ds, (char)c);
+        else buf[len++] = (char)c;
+    }
+    if (c != EOF) Scm_UngetcUnsafe(c, p->port);
+    if (use_ds) {
+        int size;
+        const char *s = Scm_DStringPeek(&ds, &size, NULL);
+        return convert_number(p, (char*)Scm_StrdupPartial(s, size), size);
+    }
+    return convert_number(p, buf, len);
+}
+
+/*
+ * Strings
+ */
+
+static int read_hex4(json_parser *p)
+{
+    int v = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = JGETC(p);
+        int d = (c == EOF || c >= 0x80)? -1 : Scm_DigitToInt(c, 16, FALSE);
+        if (d < 0) unexpected(p, c);
+        v = v*16 + d;
+    }
+    return v;
+}
+
+static void unpaired_surrogate(json_parser *p, int code)
+{
+    parse_error(p, SCM_LIST1(SCM_MAKE_INT(code)),
+                Scm_Sprintf("unpaired surrogate: \\u%04x", code));
+}
+
+/* Reads XXXX after \u, and the trailing low surrogate if any. */
+static ScmChar parse_unicode(json_parser *p)
+{
+    int code = read_hex4(p);
+    if (code >= 0xd800 && code <= 0xdbff) {
+        if (JGETC(p) != '\\' || JGETC(p) != 'u') unpaired_surrogate(p, code);
+        int lo = read_hex4(p);
+        if (lo < 0xdc00 || lo > 0xdfff) unpaired_surrogate(p, code);
+        code = 0x10000 + ((code - 0xd800) << 10) + (lo - 0xdc00);
+    } else if (code >= 0xdc00 && code <= 0xdfff) {
+        unpaired_surrogate(p, code);
+    }
+    ScmChar ch = Scm_UcsToChar(code);
+    if (ch == SCM_CHAR_INVALID) {
+        parse_error(p, SCM_LIST1(SCM_MAKE_INT(code)),
+                    Scm_Sprintf("unrepresentable character: \\u%04x", code));
+    }
+    return ch;
+}
+
+/* Called after the opening double quote is read.  Runs of plain
+   characters are copied from the port buffer at once. */
+static ScmObj parse_string(json_parser *p)
+{
+    ScmDString ds;
+    int use_ds = FALSE;
+
+    for (;;) {
+        const char *cur, *end;
+        if (fast_range(p->port, &cur, &end)) {
+            const char *q = cur;
+            u_long lines = 0;
+            while (q < end) {
+                unsigned char b = (unsigned char)*q;
+                if (b == '"' || b == '\\') break;
+                if (b >= 0x80) {
+                    /* skip a whole multibyte character, so that its
+                       trailing bytes are never examined */
+                    int n = SCM_CHAR_NFOLLOWS(b);
+                    if (q + n + 1 > end) break;
+                    q += n + 1;
+                    continue;
+                }
+                if (b == '\n') lines++;
+                q++;
+            }
+            int size = (int)(q - cur);
+            if (!use_ds && q < end && *q == '"') {
+                ScmObj s = Scm_MakeString(cur, size, -1, SCM_STRING_COPYING);
+                fast_advance(p->port, q+1, lines);
+                return s;
+            }
+            if (!use_ds) { Scm_DStringInit(&ds); use_ds = TRUE; }
+            Scm_DStringPutz(&ds, cur, size);
+            fast_advance(p->port, q, lines);
+        }
+        if (!use_ds) { Scm_DStringInit(&ds); use_ds = TRUE; }
+
+        int c = JGETC(p);
+        switch (c) {
+        case EOF: unexpected(p, c); break;
+        case '"': return Scm_DStringGet(&ds, 0);
+        case '\\':
+            c = JGETC(p);
+            switch (c) {
+            case '"': case '\\': case '/': break;
+            case 'b': c = 0x08; break;
+            case 'f': c = 0x0c; break;
+            case 'n': c = 0x0a; break;
+            case 'r': c = 0x0d; break;
+            case 't': c = 0x09; break;
+            case 'u': c = parse_unicode(p); break;
+            default: unexpected(p, c);
+            }
+            /*FALLTHROUGH*/
+        default:
+            Scm_DStringPutc(&ds, c);
+        }
+    }
+}
+
+/*
+ * Arrays and objects
+ */
+
+static void enter(json_parser *p)
+{
+    if (++p->depth > JSON_MAX_DEPTH) {
+        parse_error(p, SCM_NIL,
+                    Scm_Sprintf("arrays and objects nested too deeply "
+                                "(more than %d levels)", JSON_MAX_DEPTH));
+    }
+}
+
+static ScmObj parse_array(json_parser *p)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    enter(p);
+    int c = skip_ws(p);
+    if (c != ']') {
+        for (;;) {
+            SCM_APPEND1(h, t, parse_value(p, c));
+            c = skip_ws(p);
+            if (c == ']') break;
+            if (c != ',') unexpected(p, c);
+            c = skip_ws(p);
+        }
+    }
+    p->depth--;
+    if (SCM_FALSEP(p->array_handler)) return Scm_ListToVector(h, 0, -1);
+    return Scm_ApplyRec1(p->array_handler, h);
+}
+
+static ScmObj parse_object(json_parser *p)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    enter(p);
+    int c = skip_ws(p);
+    if (c != '}') {
+        for (;;) {
+            if (c != '"') unexpected(p, c);
+            ScmObj key = parse_string(p);
+            c = skip_ws(p);
+            if (c != ':') unexpected(p, c);
+            ScmObj val = parse_value(p, skip_ws(p));
+            SCM_APPEND1(h, t, Scm_Cons(key, val));
+            c = skip_ws(p);
+            if (c == '}') break;
+            if (c != ',') unexpected(p, c);
+            c = skip_ws(p);
+        }
+    }
+    p->depth--;
+    if (SCM_FALSEP(p->object_handler)) return h;
+    return Scm_ApplyRec1(p->object_handler, h);
+}
+
+/* C is the first character of the value, already consumed. */
+static ScmObj parse_value(json_parser *p, int c)
+{
+    switch (c) {
+    case '{': return parse_object(p);
+    case '[': return parse_array(p);
+    case '"': return parse_string(p);
+    case 't': return parse_special(p, "rue", sym_true);
+    case 'f': return parse_special(p, "alse", sym_false);
+    case 'n': return parse_special(p, "ull", sym_null);
+    case '-': case '+':
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        return parse_number(p, c);
+    default:
+        unexpected(p, c);
+        return SCM_UNDEFINED;   /* dummy */
+    }
+}
+
+static ScmObj parse_toplevel(json_parser *p)
+{
+    int c = skip_ws(p);
+    if (c == EOF) return SCM_EOF;
+    ScmObj v = parse_value(p, c);
+    /* Consume trailing whitespaces, so that the caller can see
+       if there's another value. */
+    c = skip_ws(p);
+    if (c != EOF) Scm_UngetcUnsafe(c, p->port);
+    return v;
+}
+
+ScmObj Scm_JSONParse(ScmPort *port,
+                     ScmObj array_handler,
+                     ScmObj object_handler,
+                     ScmObj special_handler)
+{
+    ScmVM *vm = Scm_VM();
+    volatile ScmObj r = SCM_UNDEFINED;
+    json_parser p;
+
+    if (!SCM_IPORTP(port)) Scm_Error("input port required, but got %S", port);
+    p.port = port;
+    p.array_handler = array_handler;
+    p.object_handler = object_handler;
+    p.special_handler = special_handler;
+    p.depth = 0;
+
+    if (PORT_LOCKED(port, vm)) {
+        r = parse_toplevel(&p);
+    } else {
+        PORT_LOCK(port, vm);
+        PORT_SAFE_CALL(port, r = parse_toplevel(&p), /*no cleanup*/);
+        PORT_UNLOCK(port);
+    }
+    return r;
+}
+
+/*
+ * Tokenizer, for the event parser
+ *
+ *   Returns one of the characters #\[ #\] #\{ #\} #\, #\:, or a scalar
+ *   value (a string, a number, or one of symbols true, false and null;
+ *   json-special-handler is not applied), or EOF.  The grammar is
+ *   handled in Scheme.  If PEEK is TRUE, just skips whitespaces and
+ *   returns the next character without consuming it.
+ */
+
+static ScmObj read_token(json_parser *p, int peek)
+{
+    int c = skip_ws(p);
+    if (peek) {
+        if (c == EOF) return SCM_EOF;
+        Scm_UngetcUnsafe(c, p->port);
+        return SCM_MAKE_CHAR(c);
+    }
+    switch (c) {
+    case EOF: return SCM_EOF;
+    case '[': case ']': case '{': case '}': case ',': case ':':
+        return SCM_MAKE_CHAR(c);
+    default:
+        return parse_value(p, c);
+    }
+}
+
+ScmObj Scm_JSONReadToken(ScmPort *port, int peek)
+{
+    ScmVM *vm = Scm_VM();
+    volatile ScmObj r = SCM_UNDEFINED;
+    json_parser p;
+
+    if (!SCM_IPORTP(port)) Scm_Error("input port required, but got %S", port);
+    p.port = port;
+    p.array_handler = p.object_handler = p.special_handler = SCM_FALSE;
+    p.depth = 0;
+
+    if (PORT_LOCKED(port, vm)) {
+        r = read_token(&p, peek);
+    } else {
+        PORT_LOCK(port, vm);
+        PORT_SAFE_CALL(port, r = read_token(&p, peek), /*no cleanup*/);
+        PORT_UNLOCK(port);
+    }
+    return r;
+}
+
+/*================================================================
+ * Writer
+ */
+
+/* Raises <json-construct-error>.  Never returns. */
+static void construct_error(ScmObj obj, const char *msg)
+{
+    static ScmObj proc = SCM_UNDEFINED;
+    SCM_BIND_PROC(proc, "%json-construct-error", json_module);
+    Scm_ApplyRec2(proc, obj, SCM_MAKE_STR(msg));
+    Scm_Error("%%json-construct-error returned");  /* NOTREACHED */
+}
+
+static void write_value(ScmObj obj, ScmPort *port);
+
+static void write_hex_escape(int code, ScmPort *port)
+{
+    char buf[8];
+    snprintf(buf, sizeof(buf), "\\u%04x", code);
+    Scm_PutzUnsafe(buf, 6, port);
+}
+
+/* Non-ASCII characters and controls are written as \uXXXX. */
+static void write_string(ScmString *str, ScmPort *port)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(str);
+    const char *s = SCM_STRING_BODY_START(b);
+    const char *e = s + SCM_STRING_BODY_SIZE(b);
+
+    Scm_PutcUnsafe('"', port);
+    while (s < e) {
+        const char *q = s;
+        while (q < e) {
+            unsigned char c = (unsigned char)*q;
+            if (c < 0x20 || c >= 0x7f || c == '"' || c == '\\') break;
+            q++;
+        }
+        if (q > s) Scm_PutzUnsafe(s, (int)(q - s), port);
+        if (q == e) break;
+
+        unsigned char c = (unsigned char)*q;
+        s = q + 1;
+        switch (c) {
+        case '"':  Scm_PutzUnsafe("\\\"", 2, port); continue;
+        case '\\': Scm_PutzUnsafe("\\\\", 2, port); continue;
+        case 0x08: Scm_PutzUnsafe("\\b", 2, port); continue;
+        case 0x0c: Scm_PutzUnsafe("\\f", 2, port); continue;
+        case 0x0a: Scm_PutzUnsafe("\\n", 2, port); continue;
+        case 0x0d: Scm_PutzUnsafe("\\r", 2, port); continue;
+        case 0x09: Scm_PutzUnsafe("\\t", 2, port); continue;
+        }
+        if (c < 0x80) {
+            write_hex_escape(c, port);
+            continue;
+        }
+        ScmChar ch;
+        SCM_CHAR_GET(q, ch);
+        s = q + SCM_CHAR_NBYTES(ch);
+        if (s > e) s = e;
+        int code = Scm_CharToUcs(ch);
+        if (code >= 0x10000) {
+            code -= 0x10000;
+            write_hex_escape(0xd800 + (code >> 10), port);
+            write_hex_escape(0xdc00 + (code & 0x3ff), port);
+        } else {
+            write_hex_escape(code, port);
+        }
+    }
+    Scm_PutcUnsafe('"', port);
+}
+
+static void write_number(ScmObj num, ScmPort *port)
+{
+    if (!SCM_REALP(num) || !Scm_FiniteP(num)) {
+        construct_error(num, "json cannot represent a number");
+    }
+    if (SCM_INTP(num)) {
+        char buf[32];
+        int n = snprintf(buf, sizeof(buf), "%ld", SCM_INT_VALUE(num));
+        Scm_PutzUnsafe(buf, n, port);
+        return;
+    }
+    if (SCM_RATNUMP(num)) num = Scm_ExactToInexact(num);
+    Scm_Write(num, SCM_OBJ(port), SCM_WRITE_WRITE);
+}
+
+/* OBJ is a proper list. */
+static void write_alist(ScmObj obj, ScmPort *port)
+{
+    static ScmObj x_to_string = SCM_UNDEFINED;
+    ScmObj cp;
+    int first = TRUE;
+
+    Scm_PutcUnsafe('{', port);
+    SCM_FOR_EACH(cp, obj) {
+        ScmObj attr = SCM_CAR(cp);
+        if (!SCM_PAIRP(attr)) {
+            construct_error(obj, "construct-json needs an assoc list or "
+                            "dictionary, but got:");
+        }
+        if (!first) Scm_PutcUnsafe(',', port);
+        first = FALSE;
+
+        ScmObj key = SCM_CAR(attr);
+        if (SCM_SYMBOLP(key)) {
+            key = SCM_OBJ(SCM_SYMBOL_NAME(key));
+        } else if (!SCM_STRINGP(key)) {
+            SCM_BIND_PROC(x_to_string, "x->string", Scm_GaucheModule());
+            key = Scm_ApplyRec1(x_to_string, key);
+        }
+        write_string(SCM_STRING(key), port);
+        Scm_PutcUnsafe(':', port);
+        write_value(SCM_CDR(attr), port);
+    }
+    Scm_PutcUnsafe('}', port);
+}
+
+static void write_vector(ScmObj obj, ScmPort *port)
+{
+    ScmSmallInt n = SCM_VECTOR_SIZE(obj);
+    Scm_PutcUnsafe('[', port);
+    for (ScmSmallInt i = 0; i < n; i++) {
+        if (i > 0) Scm_PutcUnsafe(',', port);
+        write_value(SCM_VECTOR_ELEMENT(obj, i), port);
+    }
+    Scm_PutcUnsafe(']', port);
+}
+
+static void write_value(ScmObj obj, ScmPort *port)
+{
+    static ScmObj generic = SCM_UNDEFINED;
+
+    if (SCM_FALSEP(obj) || SCM_EQ(obj, sym_false)) {
+        Scm_PutzUnsafe("false", 5, port);
+    } else if (SCM_TRUEP(obj) || SCM_EQ(obj, sym_true)) {
+        Scm_PutzUnsafe("true", 4, port);
+    } else if (SCM_EQ(obj, sym_null)) {
+        Scm_PutzUnsafe("null", 4, port);
+    } else if (SCM_NULLP(obj) || (SCM_PAIRP(obj) && Scm_Length(obj) >= 0)) {
+        write_alist(obj, port);
+    } else if (SCM_STRINGP(obj)) {
+        write_string(SCM_STRING(obj), port);
+    } else if (SCM_NUMBERP(obj)) {
+        write_number(obj, port);
+    } else if (SCM_VECTORP(obj)) {
+        write_vector(obj, port);
+    } else {
+        /* dictionaries, other sequences, and errors */
+        SCM_BIND_PROC(generic, "%print-json-generic", json_module);
+        Scm_ApplyRec2(generic, obj, SCM_OBJ(port));
+    }
+}
+
+void Scm_JSONWrite(ScmObj obj, ScmPort *port)
+{
+    ScmVM *vm = Scm_VM();
+    if (!SCM_OPORTP(port)) Scm_Error("output port required, but got %S", port);
+    if (PORT_LOCKED(port, vm)) {
+        write_value(obj, port);
+    } else {
+        PORT_LOCK(port, vm);
+        PORT_SAFE_CALL(port, write_value(obj, port), /*no cleanup*/);
+        PORT_UNLOCK(port);
+    }
+}
+
+/*================================================================
+ * Initialization
+ */
+
+void Scm_Init_json(void)
+{
+    json_module = SCM_MODULE(SCM_FIND_MODULE("rfc.json", TRUE));
+    sym_true  = SCM_INTERN("true");
+    sym_false = SCM_INTERN("false");
+    sym_null  = SCM_INTERN("null");
+}
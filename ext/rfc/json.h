@@ -0,0 +1,62 @@
+/*
+ * json.h - native JSON parser and writer for rfc.json
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_RFC_JSON_H
+#define GAUCHE_RFC_JSON_H
+
+#include <gauche.h>
+
+SCM_DECL_BEGIN
+
+/* Reads one JSON value from PORT.  Returns EOF if PORT has only
+   whitespaces.  The handlers may be #f to take the default behavior
+   (list->vector for arrays, identity for objects and specials). */
+extern ScmObj Scm_JSONParse(ScmPort *port,
+                            ScmObj array_handler,
+                            ScmObj object_handler,
+                            ScmObj special_handler);
+
+/* Reads one JSON token from PORT, for the event parser.  See json.c
+   for the details. */
+extern ScmObj Scm_JSONReadToken(ScmPort *port, int peek);
+
+/* Writes OBJ as a JSON value to PORT.  Objects other than lists,
+   vectors, strings, numbers and the specials are passed to the Scheme
+   procedure %print-json-generic. */
+extern void Scm_JSONWrite(ScmObj obj, ScmPort *port);
+
+extern void Scm_Init_json(void);
+
+SCM_DECL_END
+
+#endif /*GAUCHE_RFC_JSON_H*/
@@ -0,0 +1,135 @@
+/*
+ * mime.c - MIME boundary scanner for rfc.mime
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The delimiter is "--boundary" at the beginning of a line, and the line
+ * break before it belongs to the delimiter.  We look for LFs with memchr
+ * and compare what follows, instead of examining the data byte by byte.
+ * A lone CR doesn't make a line break, but CR LF does.
+ */
+
+#include <string.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "mime.h"
+
+enum {
+    NO_MATCH,
+    INCOMPLETE,                 /* can't tell until more data comes */
+    PART_MATCH,
+    CLOSE_MATCH
+};
+
+/* Checks if the delimiter starts at P.  On match, *DEND is set. */
+static int match_delimiter(const u_char *p, const u_char *end,
+                           const u_char *delim, ScmSmallInt dlen,
+                           int eof, const u_char **dend)
+{
+    if (end - p < dlen) {
+        if (memcmp(p, delim, end - p) != 0) return NO_MATCH;
+        return eof ? NO_MATCH : INCOMPLETE;
+    }
+    if (memcmp(p, delim, dlen) != 0) return NO_MATCH;
+
+    const u_char *q = p + dlen;
+    if (q == end) return eof ? NO_MATCH : INCOMPLETE;
+    switch (*q) {
+    case '\n':
+        *dend = q + 1;
+        return PART_MATCH;
+    case '\r':
+        if (q + 1 == end) {
+            if (!eof) return INCOMPLETE;
+            *dend = q + 1;
+        } else {
+            *dend = (q[1] == '\n') ? q + 2 : q + 1;
+        }
+        return PART_MATCH;
+    case '-':
+        if (q + 1 == end) return eof ? NO_MATCH : INCOMPLETE;
+        if (q[1] != '-') return NO_MATCH;
+        *dend = q + 2;
+        return CLOSE_MATCH;
+    default:
+        return NO_MATCH;
+    }
+}
+
+int Scm_MimeScanBoundary(const u_char *buf,
+                         ScmSmallInt start, ScmSmallInt end,
+                         const u_char *delim, ScmSmallInt dlen,
+                         int flags,
+                         ScmSmallInt *dstart, ScmSmallInt *dend)
+{
+    const u_char *s = buf + start, *e = buf + end, *p = s, *q = NULL;
+    int eof = (flags & SCM_MIME_SCAN_EOF);
+    int r;
+
+    if (flags & SCM_MIME_SCAN_AT_START) {
+        r = match_delimiter(s, e, delim, dlen, eof, &q);
+        if (r == INCOMPLETE) {
+            *dstart = start;
+            return SCM_MIME_NO_DELIMITER;
+        }
+        if (r != NO_MATCH) {
+            *dstart = start;
+            *dend = q - buf;
+            return (r == PART_MATCH)
+                ? SCM_MIME_PART_DELIMITER : SCM_MIME_CLOSE_DELIMITER;
+        }
+    }
+
+    while (p < e) {
+        const u_char *lf = memchr(p, '\n', e - p);
+        if (lf == NULL) break;
+        const u_char *ds = (lf > s && lf[-1] == '\r') ? lf - 1 : lf;
+        r = match_delimiter(lf + 1, e, delim, dlen, eof, &q);
+        switch (r) {
+        case INCOMPLETE:
+            *dstart = ds - buf;
+            return SCM_MIME_NO_DELIMITER;
+        case PART_MATCH:
+        case CLOSE_MATCH:
+            *dstart = ds - buf;
+            *dend = q - buf;
+            return (r == PART_MATCH)
+                ? SCM_MIME_PART_DELIMITER : SCM_MIME_CLOSE_DELIMITER;
+        }
+        p = lf + 1;
+    }
+
+    /* A trailing CR may be followed by LF and a delimiter. */
+    if (!eof && e > s && e[-1] == '\r') *dstart = end - 1;
+    else *dstart = end;
+    return SCM_MIME_NO_DELIMITER;
+}
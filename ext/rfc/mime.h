@@ -0,0 +1,68 @@
+/*
+ * mime.h - MIME boundary scanner for rfc.mime
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_RFC_MIME_H
+#define GAUCHE_RFC_MIME_H
+
+#include <gauche.h>
+
+SCM_DECL_BEGIN
+
+/* Result of Scm_MimeScanBoundary */
+enum {
+    SCM_MIME_NO_DELIMITER,      /* no delimiter in the range */
+    SCM_MIME_PART_DELIMITER,    /* "--boundary" followed by a line break */
+    SCM_MIME_CLOSE_DELIMITER    /* "--boundary--" */
+};
+
+/* Flags */
+enum {
+    SCM_MIME_SCAN_AT_START = (1L<<0), /* the range begins a line */
+    SCM_MIME_SCAN_EOF      = (1L<<1)  /* no more data follows the range */
+};
+
+/* Looks for the delimiter line of DELIM ("--" + boundary) in
+   BUF[START..END).  If found, sets *DSTART and *DEND to the range of
+   the delimiter, including the line break before it, and the one after
+   it in case of a part delimiter.  If not found, sets *DSTART to the
+   position up to which the bytes are surely part of the body; the rest
+   may turn out to be a delimiter once more data arrives. */
+extern int Scm_MimeScanBoundary(const u_char *buf,
+                                ScmSmallInt start, ScmSmallInt end,
+                                const u_char *delim, ScmSmallInt dlen,
+                                int flags,
+                                ScmSmallInt *dstart, ScmSmallInt *dend);
+
+SCM_DECL_END
+
+#endif /*GAUCHE_RFC_MIME_H*/
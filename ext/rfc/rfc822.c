@@ -0,0 +1,241 @@
+/*
+ * rfc822.c - RFC822 header reader for rfc.822
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * rfc822-read-headers used to read lines with read-line and split them
+ * with string-scan and string-trim, allocating a few strings per line.
+ * Here we take lines with Scm_ReadLineUnsafe, which scans the port
+ * buffer directly, and cut the name and the body out of it.
+ *
+ * The field names of the headers commonly seen in mails and HTTP are
+ * returned as the same string object every time, so that the callers
+ * can dispatch on them with eq?.
+ */
+
+#include <string.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "gauche/priv/portP.h"
+#include "rfc822.h"
+
+/*================================================================
+ * Well-known field names
+ */
+
+static const char *common_field_names[] = {
+    /* RFC2822 and MIME */
+    "bcc", "cc", "content-description", "content-disposition",
+    "content-id", "content-transfer-encoding", "content-type", "date",
+    "from", "in-reply-to", "message-id", "mime-version", "received",
+    "references", "reply-to", "return-path", "sender", "subject", "to",
+    /* HTTP */
+    "accept", "accept-charset", "accept-encoding", "accept-language",
+    "accept-ranges", "age", "allow", "authorization", "cache-control",
+    "connection", "content-encoding", "content-language",
+    "content-length", "content-location", "content-range", "cookie",
+    "etag", "expect", "expires", "host", "if-match", "if-modified-since",
+    "if-none-match", "if-range", "if-unmodified-since", "keep-alive",
+    "last-modified", "location", "origin", "pragma", "proxy-authenticate",
+    "proxy-authorization", "range", "referer", "retry-after", "server",
+    "set-cookie", "te", "trailer", "transfer-encoding", "upgrade",
+    "user-agent", "vary", "via", "warning", "www-authenticate",
+    "x-forwarded-for",
+};
+
+#define NUM_COMMON_FIELD_NAMES \
+    (sizeof(common_field_names)/sizeof(common_field_names[0]))
+#define MAX_COMMON_FIELD_NAME_LEN 32
+
+static ScmObj common_field_strings[NUM_COMMON_FIELD_NAMES];
+static ScmSmallInt common_field_lens[NUM_COMMON_FIELD_NAMES];
+
+/* Returns the shared string for lowercase NAME, or SCM_FALSE. */
+static ScmObj lookup_common(const char *name, ScmSmallInt len)
+{
+    for (size_t i = 0; i < NUM_COMMON_FIELD_NAMES; i++) {
+        if (common_field_lens[i] == len
+            && memcmp(common_field_names[i], name, len) == 0) {
+            return common_field_strings[i];
+        }
+    }
+    return SCM_FALSE;
+}
+
+/* NAME[0..LEN) is already validated to be printable ASCII. */
+static ScmObj field_name(const char *name, ScmSmallInt len)
+{
+    char sbuf[MAX_COMMON_FIELD_NAME_LEN];
+    char *buf = (len <= MAX_COMMON_FIELD_NAME_LEN)
+        ? sbuf : SCM_NEW_ATOMIC2(char*, len + 1);
+
+    for (ScmSmallInt i = 0; i < len; i++) {
+        char c = name[i];
+        buf[i] = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+    }
+    if (buf == sbuf) {
+        ScmObj s = lookup_common(buf, len);
+        if (!SCM_FALSEP(s)) return s;
+        return Scm_MakeString(buf, len, len, SCM_STRING_COPYING);
+    }
+    buf[len] = '\0';
+    return Scm_MakeString(buf, len, len, 0);
+}
+
+ScmObj Scm_RFC822InternFieldName(ScmString *name)
+{
+    u_int size;
+    const char *s = Scm_GetStringContent(name, &size, NULL, NULL);
+    ScmObj r = lookup_common(s, (ScmSmallInt)size);
+    return SCM_FALSEP(r) ? SCM_OBJ(name) : r;
+}
+
+/*================================================================
+ * Reader
+ */
+
+#define IS_WS(c) \
+    ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n' \
+     || (c) == '\v' || (c) == '\f')
+
+/* Splits a header line.  Returns FALSE if it isn't a header field.
+   The body isn't trimmed if the line is an incomplete string, as it
+   isn't RFC2822 compliant anyway. */
+static int split_field(const char *s, ScmSmallInt size, int incomplete,
+                       ScmObj *name, const char **body)
+{
+    const char *colon = memchr(s, ':', size), *e = s + size;
+    if (colon == NULL) return FALSE;
+
+    const char *ns = s, *ne = colon;
+    while (ns < ne && IS_WS(*ns)) ns++;
+    while (ne > ns && IS_WS(ne[-1])) ne--;
+    for (const char *p = ns; p < ne; p++) {
+        if (*p < 0x21 || *p > 0x7e) return FALSE;
+    }
+
+    const char *b = colon + 1;
+    if (!incomplete) {
+        while (b < e && IS_WS(*b)) b++;
+    }
+    *name = field_name(ns, ne - ns);
+    *body = b;
+    return TRUE;
+}
+
+static ScmObj read_headers(ScmPort *in, int strict,
+                           int *error, ScmObj *bad_line)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    ScmObj name = SCM_FALSE;    /* the field being read */
+    int incomplete = FALSE;     /* the field body has an incomplete line */
+    ScmDString ds;
+
+    *error = SCM_RFC822_OK;
+    Scm_DStringInit(&ds);
+    for (;;) {
+        ScmObj line = Scm_ReadLineUnsafe(in);
+        if (SCM_EOFP(line)) {
+            if (!SCM_FALSEP(name) && strict) {
+                *error = SCM_RFC822_PREMATURE_EOF;
+                return SCM_FALSE;
+            }
+            break;
+        }
+
+        const ScmStringBody *b = SCM_STRING_BODY(line);
+        const char *s = SCM_STRING_BODY_START(b);
+        ScmSmallInt size = SCM_STRING_BODY_SIZE(b);
+        int inc = SCM_STRING_BODY_INCOMPLETE_P(b);
+        if (size == 0) break;
+
+        if (!SCM_FALSEP(name) && (s[0] == ' ' || s[0] == '\t')) {
+            /* continuation line */
+            Scm_DStringPutz(&ds, s, size);
+            incomplete |= inc;
+            continue;
+        }
+        if (!SCM_FALSEP(name)) {
+            ScmObj body = Scm_DStringGet(&ds, incomplete
+                                         ? SCM_STRING_INCOMPLETE : 0);
+            SCM_APPEND1(h, t, SCM_LIST2(name, body));
+            name = SCM_FALSE;
+        }
+
+        const char *bstart;
+        if (split_field(s, size, inc, &name, &bstart)) {
+            Scm_DStringInit(&ds);
+            Scm_DStringPutz(&ds, bstart, s + size - bstart);
+            incomplete = inc;
+        } else if (strict) {
+            *error = SCM_RFC822_BAD_LINE;
+            *bad_line = line;
+            return SCM_FALSE;
+        }
+    }
+    if (!SCM_FALSEP(name)) {
+        ScmObj body = Scm_DStringGet(&ds, incomplete
+                                     ? SCM_STRING_INCOMPLETE : 0);
+        SCM_APPEND1(h, t, SCM_LIST2(name, body));
+    }
+    return h;
+}
+
+ScmObj Scm_RFC822ReadHeaders(ScmPort *in, int strict,
+                             int *error, ScmObj *bad_line)
+{
+    ScmVM *vm = Scm_VM();
+    ScmObj r = SCM_FALSE;
+    if (PORT_LOCKED(in, vm)) {
+        r = read_headers(in, strict, error, bad_line);
+    } else {
+        PORT_LOCK(in, vm);
+        PORT_SAFE_CALL(in, r = read_headers(in, strict, error, bad_line),
+                       /*no cleanup*/);
+        PORT_UNLOCK(in);
+    }
+    return r;
+}
+
+/*================================================================
+ * Initialization
+ */
+
+void Scm_Init_rfc822(void)
+{
+    for (size_t i = 0; i < NUM_COMMON_FIELD_NAMES; i++) {
+        common_field_lens[i] = strlen(common_field_names[i]);
+        common_field_strings[i] =
+            Scm_MakeString(common_field_names[i], -1, -1,
+                           SCM_STRING_IMMUTABLE);
+    }
+}
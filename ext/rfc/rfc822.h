@@ -0,0 +1,66 @@
+/*
+ * rfc822.h - RFC822 header reader for rfc.822
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_RFC_822_H
+#define GAUCHE_RFC_822_H
+
+#include <gauche.h>
+
+SCM_DECL_BEGIN
+
+/* Error codes of Scm_RFC822ReadHeaders */
+enum {
+    SCM_RFC822_OK,
+    SCM_RFC822_PREMATURE_EOF,   /* EOF before the end of the header */
+    SCM_RFC822_BAD_LINE         /* a line that isn't a header field */
+};
+
+/* Reads a header block from IN up to an empty line or EOF, and returns
+   ((name body) ...), unfolding the continuation lines.  Field names
+   are lowercased, and the well-known ones are shared (see below).
+   If STRICT is true and the header is malformed, stops reading and
+   sets *ERROR; in case of SCM_RFC822_BAD_LINE, *BAD_LINE is set to the
+   offending line. */
+extern ScmObj Scm_RFC822ReadHeaders(ScmPort *in, int strict,
+                                    int *error, ScmObj *bad_line);
+
+/* If NAME, a lowercase string, is one of the well-known field names,
+   returns the shared immutable string for it.  Otherwise returns
+   NAME itself. */
+extern ScmObj Scm_RFC822InternFieldName(ScmString *name);
+
+extern void Scm_Init_rfc822(void);
+
+SCM_DECL_END
+
+#endif /*GAUCHE_RFC_822_H*/
@@ -55,6 +55,27 @@ Content-Length: 4349
 (test* "rfc822-read-headers" #t
        (equal? rfc822-header1-list
                (rfc822-read-headers (open-input-string rfc822-header1))))
+(test* "rfc822-read-headers (reader)" #t
+       (equal? rfc822-header1-list
+               (rfc822-read-headers (open-input-string rfc822-header1)
+                                    :reader (cut read-line <> #t))))
+(test* "rfc822-read-headers (interned names)" '(#t #t #f)
+       (let1 hs (rfc822-read-headers (open-input-string rfc822-header1))
+         (list (eq? (car (assoc "content-type" hs))
+                    (rfc822-intern-field-name "Content-Type"))
+               (eq? (car (assoc "received" hs))
+                    (car (assoc "received" (cdr hs))))
+               (eq? (car (assoc "x-mailer" hs))
+                    (rfc822-intern-field-name "X-Mailer")))))
+(test* "rfc822-read-headers (malformed)"
+       '(("a" "b c") ("d" "") ("e" "f"))
+       (rfc822-read-headers
+        (open-input-string "A : b\r\n c\r\nno colon\r\nd:\nbad name: x\n e:f")))
+(test* "rfc822-read-headers (strict, bad line)" (test-error <rfc822-parse-error>)
+       (rfc822-read-headers (open-input-string "a: b\nno colon\n\n")
+                            :strict? #t))
+(test* "rfc822-read-headers (strict, eof)" (test-error <rfc822-parse-error>)
+       (rfc822-read-headers (open-input-string "a: b\n c") :strict? #t))
 
 ;; token parsers
 (test* "rfc822-field->tokens (basic)"
@@ -451,5 +472,43 @@ Content-Length: 4349
               #f)))))
                      
 (dotimes (n 8) (mime-roundtrip-tester n))
+
+;; The boundary is looked for in chunks; make sure the parts are split
+;; right wherever the chunk boundaries fall.
+(use gauche.uvector)
+(use rfc.base64)
+(let* ([body (make-string 20000 #\a)]
+       [blob (u8vector-append (make-u8vector 9000 13) #u8(10 45 45 98 0 255))]
+       [msg (string-append "prologue\r\n--bnd\r\n"
+                           "content-type: text/plain\r\n\r\n"
+                           body "\r\n--bnd\n\r\n"
+                           "--bndx\r\n--bn\r\n\r\n--bnd\r\n"
+                           "content-type: application/octet-stream\r\n"
+                           "content-transfer-encoding: base64\r\n\r\n"
+                           (base64-encode-bytevector blob)
+                           "\r\n--bnd--\r\nepilogue")]
+       [parse (^[handler]
+                (map (cut ref <> 'content)
+                     (ref (call-with-input-string msg
+                            (cut mime-parse-message <>
+                                 '(("content-type"
+                                    "multipart/mixed; boundary=bnd"))
+                                 handler))
+                          'content)))])
+  (test* "mime-parse-message (long parts)"
+         (list body "--bndx\r\n--bn\r\n")
+         (list-head (parse (cut mime-body->string <> <>)) 2))
+  (test* "mime-body->u8vector"
+         (list (string->u8vector body) (string->u8vector "--bndx\r\n--bn\r\n")
+               blob)
+         (parse (cut mime-body->u8vector <> <>)))
+  (test* "mime-retrieve-body with a sink"
+         (list 20000 14 (u8vector-length blob))
+         (parse (^[part port]
+                  (rlet1 count 0
+                    (mime-retrieve-body part port
+                                        (^[chunk]
+                                          (inc! count
+                                                (u8vector-length chunk)))))))))
     
 (test-end)
@@ -0,0 +1,348 @@
+/*
+ * uri.c - URI parser and percent-encoding for rfc.uri
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The URI decomposition procedures used to be regexp matches.  Here we
+ * scan the string once, giving the same results as those regexps did
+ * (they're quoted in the comments).  The delimiters are all ASCII, but
+ * we step over multibyte characters as a whole so that we won't mistake
+ * a trailing byte of SJIS for a delimiter.
+ */
+
+#include <string.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "uri.h"
+
+#define IS_ALPHA(c)  (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z'))
+#define IS_DIGIT(c)  ((c) >= '0' && (c) <= '9')
+
+static const char hexdigits[] = "0123456789ABCDEF";
+
+/* Returns the value of a hex digit, or -1 */
+static inline int hexval(u_char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/*================================================================
+ * Decomposition
+ */
+
+/* Returns the first position in [P, END) that has one of the ASCII
+   characters in STOPS, or END. */
+static const char *scan_to(const char *p, const char *end, const char *stops)
+{
+    while (p < end) {
+        u_char c = (u_char)*p;
+        if (c < 0x80) {
+            if (c != 0 && strchr(stops, c)) return p;
+            p++;
+        } else {
+            p += SCM_CHAR_NFOLLOWS(c) + 1;
+        }
+    }
+    return end;
+}
+
+static inline ScmObj substr(const char *start, const char *end)
+{
+    return Scm_MakeString(start, end - start, -1, SCM_STRING_COPYING);
+}
+
+/* "^([A-Za-z][A-Za-z0-9+.-]*):" */
+void Scm_URISchemeSpecific(ScmString *uri, ScmObj *scheme, ScmObj *specific)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(uri);
+    const char *s = SCM_STRING_BODY_START(b);
+    const char *end = s + SCM_STRING_BODY_SIZE(b), *p = s;
+
+    if (p < end && IS_ALPHA(*p)) {
+        for (p++; p < end; p++) {
+            if (!(IS_ALPHA(*p) || IS_DIGIT(*p)
+                  || *p == '+' || *p == '.' || *p == '-')) break;
+        }
+        if (p < end && *p == ':') {
+            char *buf = SCM_NEW_ATOMIC2(char*, p - s + 1);
+            for (ScmSmallInt i = 0; i < p - s; i++) {
+                buf[i] = (s[i] >= 'A' && s[i] <= 'Z') ? s[i]-'A'+'a' : s[i];
+            }
+            buf[p - s] = '\0';
+            *scheme = Scm_MakeString(buf, p - s, p - s, 0);
+            *specific = substr(p + 1, end);
+            return;
+        }
+    }
+    *scheme = SCM_FALSE;
+    *specific = SCM_OBJ(uri);
+}
+
+/* "^(?:\/\/([^\/?#]*))?([^?#]+)?(?:\?([^#]*))?(?:#(.*))?$"
+   Returns authority, path, query and fragment in R. */
+void Scm_URIDecomposeHierarchical(ScmString *specific, ScmObj r[4])
+{
+    const ScmStringBody *b = SCM_STRING_BODY(specific);
+    const char *s = SCM_STRING_BODY_START(b);
+    const char *end = s + SCM_STRING_BODY_SIZE(b), *p = s, *q;
+
+    r[0] = r[1] = r[2] = r[3] = SCM_FALSE;
+    if (end - p >= 2 && p[0] == '/' && p[1] == '/') {
+        q = scan_to(p + 2, end, "/?#");
+        r[0] = substr(p + 2, q);
+        p = q;
+    }
+    q = scan_to(p, end, "?#");
+    if (q > p) r[1] = substr(p, q);
+    p = q;
+    if (p < end && *p == '?') {
+        q = scan_to(p + 1, end, "#");
+        r[2] = substr(p + 1, q);
+        p = q;
+    }
+    if (p < end) r[3] = substr(p + 1, end); /* *p must be '#' */
+}
+
+/* Matches the part after userinfo:
+   "(?:(?<host>[^:]*)|(?:\[(?<v6host>[a-fA-F\d:]+)\]))(?::(?<port>\d*))?$"
+   On success, returns TRUE and sets the host and the port, which is
+   #f if there's none. */
+static int match_hostport(const char *s, const char *end,
+                          ScmObj *host, ScmObj *port)
+{
+    const char *p = scan_to(s, end, ":"), *q;
+
+    /* The first alternative: no colon, or a colon followed by digits. */
+    if (p == end) {
+        *host = substr(s, end);
+        *port = SCM_FALSE;
+        return TRUE;
+    }
+    for (q = p + 1; q < end && IS_DIGIT(*q); q++)
+        ;
+    if (q == end) {
+        *host = substr(s, p);
+        *port = substr(p + 1, end);
+        return TRUE;
+    }
+
+    /* The second alternative: bracketed IPv6 address. */
+    if (*s != '[') return FALSE;
+    for (q = s + 1; q < end && (hexval(*q) >= 0 || *q == ':'); q++)
+        ;
+    if (q == s + 1 || q == end || *q != ']') return FALSE;
+    p = q + 1;
+    if (p == end) {
+        *host = substr(s + 1, q);
+        *port = SCM_FALSE;
+        return TRUE;
+    }
+    if (*p != ':') return FALSE;
+    const char *d = p + 1;
+    while (d < end && IS_DIGIT(*d)) d++;
+    if (d != end) return FALSE;
+    *host = substr(s + 1, q);
+    *port = substr(p + 1, end);
+    return TRUE;
+}
+
+/* "^(?:(?<userinfo>.*?)@)?" followed by the above.
+   Returns userinfo, host and port in R, or all #f if AUTHORITY doesn't
+   match. */
+void Scm_URIDecomposeAuthority(ScmString *authority, ScmObj r[3])
+{
+    const ScmStringBody *b = SCM_STRING_BODY(authority);
+    const char *s = SCM_STRING_BODY_START(b);
+    const char *end = s + SCM_STRING_BODY_SIZE(b);
+
+    /* The userinfo part is non-greedy, so we try the earliest '@' first. */
+    for (const char *a = scan_to(s, end, "@"); a < end;
+         a = scan_to(a + 1, end, "@")) {
+        if (match_hostport(a + 1, end, &r[1], &r[2])) {
+            r[0] = substr(s, a);
+            return;
+        }
+    }
+    if (match_hostport(s, end, &r[1], &r[2])) {
+        r[0] = SCM_FALSE;
+        return;
+    }
+    r[0] = r[1] = r[2] = SCM_FALSE;
+}
+
+static ScmObj non_empty(ScmObj s)
+{
+    if (SCM_STRINGP(s) && SCM_STRING_BODY_SIZE(SCM_STRING_BODY(s)) > 0) {
+        return s;
+    }
+    return SCM_FALSE;
+}
+
+/* Returns scheme, userinfo, host, port, path, query and fragment in R. */
+void Scm_URIParse(ScmString *uri, ScmObj r[7])
+{
+    ScmObj specific, hier[4], auth[3];
+
+    Scm_URISchemeSpecific(uri, &r[0], &specific);
+    Scm_URIDecomposeHierarchical(SCM_STRING(specific), hier);
+    if (SCM_STRINGP(hier[0])) {
+        Scm_URIDecomposeAuthority(SCM_STRING(hier[0]), auth);
+    } else {
+        auth[0] = auth[1] = auth[2] = SCM_FALSE;
+    }
+    r[1] = auth[0];
+    r[2] = non_empty(auth[1]);
+    r[3] = SCM_STRINGP(auth[2])
+        ? Scm_StringToNumber(SCM_STRING(auth[2]), 10, 0)
+        : SCM_FALSE;
+    r[4] = non_empty(hier[1]);
+    r[5] = hier[2];
+    r[6] = hier[3];
+}
+
+/*================================================================
+ * Percent encoding
+ */
+
+/* Decodes SRC[0..LEN) into DST, which must have LEN bytes of room.
+   If FINAL is false, stops before a '%' that may be followed by hex
+   digits in the next chunk.  Returns the number of bytes written, and
+   sets *CONSUMED. */
+static ScmSmallInt decode_bytes(const u_char *src, ScmSmallInt len,
+                                u_char *dst, int cgi_decode, int final,
+                                ScmSmallInt *consumed)
+{
+    const u_char *s = src, *end = src + len;
+    u_char *d = dst;
+
+    while (s < end) {
+        const u_char *pct = memchr(s, '%', end - s);
+        const u_char *stop = pct ? pct : end;
+        if (cgi_decode) {
+            for (; s < stop; s++) *d++ = (*s == '+') ? ' ' : *s;
+        } else {
+            memcpy(d, s, stop - s);
+            d += stop - s;
+            s = stop;
+        }
+        if (s == end) break;
+        /* s points to '%' */
+        if (end - s < 3 && !final) break;
+        int hi = (end - s >= 3) ? hexval(s[1]) : -1;
+        int lo = (end - s >= 3) ? hexval(s[2]) : -1;
+        if (hi >= 0 && lo >= 0) {
+            *d++ = (u_char)(hi*16 + lo);
+            s += 3;
+        } else {
+            /* We're permissive; a stray '%' is taken literally. */
+            *d++ = '%';
+            s++;
+        }
+    }
+    *consumed = s - src;
+    return d - dst;
+}
+
+ScmObj Scm_URIDecode(const char *src, ScmSmallInt len, int cgi_decode)
+{
+    u_char *buf = SCM_NEW_ATOMIC2(u_char*, len + 1);
+    ScmSmallInt consumed;
+    ScmSmallInt n = decode_bytes((const u_char*)src, len, buf, cgi_decode,
+                                 TRUE, &consumed);
+    buf[n] = '\0';
+    return Scm_MakeString((char*)buf, n, -1, 0);
+}
+
+/* Encodes SRC[0..LEN) into DST, which must have 3*LEN bytes of room.
+   Returns the number of bytes written.  Only the bytes below 0x80 that
+   are in NOESCAPE are passed as they are. */
+static ScmSmallInt encode_bytes(const u_char *src, ScmSmallInt len,
+                                char *dst, ScmCharSet *noescape)
+{
+    char *d = dst;
+    for (ScmSmallInt i = 0; i < len; i++) {
+        u_char b = src[i];
+        if (b < SCM_CHAR_SET_SMALL_CHARS
+            && SCM_BITS_TEST(noescape->small, b)) {
+            *d++ = (char)b;
+        } else {
+            *d++ = '%';
+            *d++ = hexdigits[b >> 4];
+            *d++ = hexdigits[b & 0x0f];
+        }
+    }
+    return d - dst;
+}
+
+ScmObj Scm_URIEncode(const char *src, ScmSmallInt len, ScmCharSet *noescape)
+{
+    char *buf = SCM_NEW_ATOMIC2(char*, len*3 + 1);
+    ScmSmallInt n = encode_bytes((const u_char*)src, len, buf, noescape);
+    buf[n] = '\0';
+    return Scm_MakeString(buf, n, n, 0);
+}
+
+#define CHUNK_SIZE 4096
+
+void Scm_URIDecodePort(ScmPort *in, ScmPort *out, int cgi_decode)
+{
+    u_char ibuf[CHUNK_SIZE], obuf[CHUNK_SIZE];
+    ScmSmallInt carry = 0, consumed;
+
+    for (;;) {
+        int r = Scm_Getz((char*)ibuf + carry, (int)(CHUNK_SIZE - carry), in);
+        int final = (r <= 0);
+        ScmSmallInt n = carry + (final ? 0 : r);
+        ScmSmallInt k = decode_bytes(ibuf, n, obuf, cgi_decode, final,
+                                     &consumed);
+        if (k > 0) Scm_Putz((char*)obuf, (int)k, out);
+        if (final) break;
+        carry = n - consumed;
+        memmove(ibuf, ibuf + consumed, carry);
+    }
+}
+
+void Scm_URIEncodePort(ScmPort *in, ScmPort *out, ScmCharSet *noescape)
+{
+    u_char ibuf[CHUNK_SIZE];
+    char obuf[CHUNK_SIZE*3];
+
+    for (;;) {
+        int r = Scm_Getz((char*)ibuf, CHUNK_SIZE, in);
+        if (r <= 0) break;
+        ScmSmallInt k = encode_bytes(ibuf, r, obuf, noescape);
+        Scm_Putz(obuf, (int)k, out);
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * uri.h - URI parser and percent-encoding for rfc.uri
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_RFC_URI_H
+#define GAUCHE_RFC_URI_H
+
+#include <gauche.h>
+
+SCM_DECL_BEGIN
+
+/* Decomposition.  They return the same values as uri-scheme&specific,
+   uri-decompose-hierarchical, uri-decompose-authority and uri-parse,
+   in the order, in the given array. */
+extern void Scm_URISchemeSpecific(ScmString *uri,
+                                  ScmObj *scheme, ScmObj *specific);
+extern void Scm_URIDecomposeHierarchical(ScmString *specific, ScmObj r[4]);
+extern void Scm_URIDecomposeAuthority(ScmString *authority, ScmObj r[3]);
+extern void Scm_URIParse(ScmString *uri, ScmObj r[7]);
+
+/* Percent encoding of a byte sequence.  The encoder passes the ASCII
+   bytes in NOESCAPE as they are.  The decoder returns a string, which
+   can be incomplete. */
+extern ScmObj Scm_URIEncode(const char *src, ScmSmallInt len,
+                            ScmCharSet *noescape);
+extern ScmObj Scm_URIDecode(const char *src, ScmSmallInt len, int cgi_decode);
+
+/* Port versions.  They read IN up to EOF. */
+extern void Scm_URIEncodePort(ScmPort *in, ScmPort *out, ScmCharSet *noescape);
+extern void Scm_URIDecodePort(ScmPort *in, ScmPort *out, int cgi_decode);
+
+SCM_DECL_END
+
+#endif /*GAUCHE_RFC_URI_H*/
@@ -32,11 +32,26 @@
  */
 
 #include "ctrie.h"
+#include "atomic_ops.h"
 
 /*
  * Constructor
  */
 
+/* The root is read with acquire and written with release by the
+   copy-on-write operations, so that a reader sees fully initialized
+   nodes and leaves.  On most platforms these are ordinary loads and
+   stores. */
+static inline Node *root_get(const CompactTrie *ct)
+{
+    return (Node*)AO_load_acquire((const volatile AO_t*)&ct->root);
+}
+
+static inline void root_publish(CompactTrie *ct, Node *root)
+{
+    AO_store_release((volatile AO_t*)&ct->root, (AO_t)root);
+}
+
 CompactTrie *MakeCompactTrie(void)
 {
     CompactTrie *t = SCM_NEW(CompactTrie);
@@ -160,8 +175,9 @@ static Leaf *get_rec(Node *n, u_long key, int level)
 Leaf *CompactTrieGet(CompactTrie *ct, u_long key)
 {
     KEY_MASK(key);
-    if (ct->root == NULL) return NULL;
-    else return get_rec(ct->root, key, 0);
+    Node *root = root_get(ct);
+    if (root == NULL) return NULL;
+    else return get_rec(root, key, 0);
 }
 
 /*
@@ -312,6 +328,168 @@ void CompactTrieClear(CompactTrie *ct,
     if (n) clear_rec(ct, n, clearer, data);
 }
 
+/*
+ * Copy-on-write update
+ */
+
+/* Returns a fresh copy of N with room for EXTRA more entries. */
+static Node *node_copy(const Node *n, int extra)
+{
+    int size = NODE_NCHILDREN(n);
+    Node *m = make_node(size + extra);
+    m->emap = n->emap;
+    m->lmap = n->lmap;
+    for (int i=0; i<size; i++) m->entries[i] = n->entries[i];
+    return m;
+}
+
+static Node *node_copy_insert(Node *n, u_long ind, void *entry, int leafp)
+{
+    /* node_insert leaves N intact if it needs to extend the node. */
+    if (NODE_NCHILDREN(n)&(NODE_SIZE_INCR-1)) n = node_copy(n, 0);
+    return node_insert(n, ind, entry, leafp);
+}
+
+static Node *node_copy_delete(const Node *n, u_long ind)
+{
+    Node *m = node_copy(n, 0);
+    node_delete(m, ind);
+    return m;
+}
+
+/* Creates a subtree that holds two leaves with different keys. */
+static Node *make_pair_node(Leaf *a, Leaf *b, int level)
+{
+    u_long ia = KEY2INDEX(leaf_key(a), level);
+    u_long ib = KEY2INDEX(leaf_key(b), level);
+    Node *m = make_node(NODE_SIZE_INCR);
+
+    if (ia == ib) {
+        NODE_ARC_SET(m, ia);
+        NODE_ENTRY(m, 0) = make_pair_node(a, b, level+1);
+    } else {
+        NODE_ARC_SET(m, ia);
+        NODE_LEAF_SET(m, ia);
+        NODE_ARC_SET(m, ib);
+        NODE_LEAF_SET(m, ib);
+        NODE_ENTRY(m, (ia < ib)? 0 : 1) = a;
+        NODE_ENTRY(m, (ia < ib)? 1 : 0) = b;
+    }
+    return m;
+}
+
+/* Returns a new node that replaces N. */
+static Node *put_rec(Node *n, Leaf *leaf, int level, Leaf **replaced)
+{
+    u_long key = leaf_key(leaf);
+    u_long ind = KEY2INDEX(key, level);
+
+    if (!NODE_HAS_ARC(n, ind)) {
+        return node_copy_insert(n, ind, (void*)leaf, TRUE);
+    }
+
+    u_long off = NODE_INDEX2OFF(n, ind);
+    Node *m = node_copy(n, 0);
+    if (!NODE_ARC_IS_LEAF(n, ind)) {
+        NODE_ENTRY(m, off) = put_rec((Node*)NODE_ENTRY(n, off), leaf,
+                                     level+1, replaced);
+    } else {
+        Leaf *l0 = (Leaf*)NODE_ENTRY(n, off);
+        if (leaf_key(l0) == key) {
+            *replaced = l0;
+            NODE_ENTRY(m, off) = leaf;
+        } else {
+            NODE_ENTRY(m, off) = make_pair_node(l0, leaf, level+1);
+            NODE_LEAF_RESET(m, ind);
+        }
+    }
+    return m;
+}
+
+Leaf *CompactTriePut(CompactTrie *ct, Leaf *leaf)
+{
+    Leaf *replaced = NULL;
+    Node *root = ct->root, *newroot;
+
+    if (root == NULL) {
+        u_long ind = KEY2INDEX(leaf_key(leaf), 0);
+        newroot = make_node(NODE_SIZE_INCR);
+        NODE_ARC_SET(newroot, ind);
+        NODE_LEAF_SET(newroot, ind);
+        NODE_ENTRY(newroot, 0) = leaf;
+    } else {
+        newroot = put_rec(root, leaf, 0, &replaced);
+    }
+    root_publish(ct, newroot);
+    if (replaced == NULL) ct->numEntries++;
+    return replaced;
+}
+
+/* Returns N itself if KEY isn't found.  Otherwise, returns a new node
+   that replaces N, or if N is to be eliminated, its only remaining
+   leaf with *LEAFP set to TRUE.  Like del_rec, the root is never
+   eliminated. */
+static void *remove_rec(Node *n, u_long key, int level,
+                        Leaf **deleted, int *leafp)
+{
+    u_long ind = KEY2INDEX(key, level);
+
+    if (!NODE_HAS_ARC(n, ind)) return n;
+    u_long off = NODE_INDEX2OFF(n, ind);
+
+    if (!NODE_ARC_IS_LEAF(n, ind)) {
+        Node *orig = (Node*)NODE_ENTRY(n, off);
+        int cleafp = FALSE;
+        void *r = remove_rec(orig, key, level+1, deleted, &cleafp);
+        if (r == (void*)orig) return n;
+        if (cleafp && NODE_NCHILDREN(n) == 1 && level > 0) {
+            *leafp = TRUE;
+            return r;
+        }
+        Node *m = node_copy(n, 0);
+        NODE_ENTRY(m, off) = r;
+        if (cleafp) NODE_LEAF_SET(m, ind);
+        return m;
+    } else {
+        Leaf *l0 = (Leaf*)NODE_ENTRY(n, off);
+        if (leaf_key(l0) != key) return n;
+        *deleted = l0;
+        if (NODE_NCHILDREN(n) == 1) {
+            /* this only happens when N is root. */
+            SCM_ASSERT(level == 0);
+            return NULL;
+        }
+        if (NODE_NCHILDREN(n) == 2 && level > 0) {
+            u_long other = n->emap & ~(1UL << ind);
+            if (n->lmap & other) {
+                *leafp = TRUE;
+                return NODE_ENTRY(n, (off == 0)? 1 : 0);
+            }
+        }
+        return node_copy_delete(n, ind);
+    }
+}
+
+Leaf *CompactTrieRemove(CompactTrie *ct, u_long key)
+{
+    Leaf *deleted = NULL;
+    int leafp = FALSE;
+    KEY_MASK(key);
+    if (ct->root == NULL) return NULL;
+    void *r = remove_rec(ct->root, key, 0, &deleted, &leafp);
+    if (deleted) {
+        root_publish(ct, (Node*)r);
+        ct->numEntries--;
+    }
+    return deleted;
+}
+
+void CompactTrieSnapshot(CompactTrie *dst, const CompactTrie *src)
+{
+    dst->numEntries = src->numEntries;
+    dst->root = root_get(src);
+}
+
 /*
  * Key finding
  */
@@ -412,6 +590,40 @@ void CompactTrieCopy(CompactTrie *dst, const CompactTrie *src,
     dst->numEntries = src->numEntries;
 }
 
+/*
+ * Statistics
+ */
+static void stat_rec(const Node *n, u_int depth, CompactTrieStat *st,
+                     void (*leafproc)(Leaf*, void*), void *data)
+{
+    int size = NODE_NCHILDREN(n);
+    int nalloc = (size+NODE_SIZE_INCR-1)&(~(NODE_SIZE_INCR-1));
+    if (nalloc < 2) nalloc = 2;
+
+    st->numNodes++;
+    st->nodeBytes += sizeof(Node) + sizeof(void*)*(nalloc-2);
+    if (depth > st->maxDepth) st->maxDepth = depth;
+    for (int i=0, off=0; i<MAX_NODE_SIZE; i++) {
+        if (!NODE_HAS_ARC(n, i)) continue;
+        if (NODE_ARC_IS_LEAF(n, i)) {
+            st->numLeaves++;
+            if (leafproc) leafproc((Leaf*)NODE_ENTRY(n, off), data);
+        } else {
+            stat_rec((Node*)NODE_ENTRY(n, off), depth+1, st, leafproc, data);
+        }
+        off++;
+    }
+}
+
+void CompactTrieGetStat(const CompactTrie *ct, CompactTrieStat *st,
+                        void (*leafproc)(Leaf*, void*), void *data)
+{
+    Node *root = root_get(ct);
+    st->numNodes = st->numLeaves = st->nodeBytes = 0;
+    st->maxDepth = 0;
+    if (root) stat_rec(root, 1, st, leafproc, data);
+}
+
 /*
  * Iterator
  */
@@ -166,6 +166,25 @@ extern void  CompactTrieCopy(CompactTrie *dst,
                              const CompactTrie *src,
                              Leaf *(*copy)(Leaf*, void*), void *data);
 
+/* Copy-on-write updates.  They never modify a node reachable from the
+ * current root; the nodes on the path to the changed leaf are copied and
+ * the new root is published with a release store.  So readers that use
+ * CompactTrieGet or iterate over a snapshot don't need a lock while a
+ * writer updates the trie.  Writers must still be serialized, and a trie
+ * updated this way must not be touched by the in-place operations (Add,
+ * Delete and Clear).  A leaf given to CompactTriePut must not be modified
+ * afterwards.
+ *
+ * CompactTriePut inserts LEAF, whose key must be already set, replacing
+ * the leaf with the same key if any; the replaced leaf is returned.
+ */
+extern Leaf *CompactTriePut(CompactTrie *ct, Leaf *leaf);
+extern Leaf *CompactTrieRemove(CompactTrie *ct, u_long key);
+
+/* Makes DST share the current nodes of SRC.  As far as SRC is only
+   updated by the copy-on-write operations, DST stays as a frozen view. */
+extern void  CompactTrieSnapshot(CompactTrie *dst, const CompactTrie *src);
+
 extern Leaf *CompactTrieFirstLeaf(CompactTrie *ct);
 extern Leaf *CompactTrieLastLeaf(CompactTrie *ct);
 extern Leaf *CompactTrieNextLeaf(CompactTrie *ct, u_long key);
@@ -175,6 +194,19 @@ extern Leaf *CompactTrieNextLeaf(CompactTrie *ct, u_long key);
 extern void  CompactTrieIterInit(CompactTrieIter *it, CompactTrie *ct);
 extern Leaf *CompactTrieIterNext(CompactTrieIter *it);
 
+/* Statistics.  NODEBYTES is estimated from the number of entries of
+   each node, so it can be smaller than the actual allocation after
+   deletions.  If LEAFPROC isn't NULL, it is called on each leaf. */
+typedef struct CompactTrieStatRec {
+    u_long numNodes;
+    u_long numLeaves;
+    u_long nodeBytes;
+    u_int  maxDepth;            /* root is at depth 1 */
+} CompactTrieStat;
+
+extern void CompactTrieGetStat(const CompactTrie *ct, CompactTrieStat *st,
+                               void (*leafproc)(Leaf*, void*), void *data);
+
 /* For debug */
 extern void CompactTrieDump(ScmPort *out, const CompactTrie *ct,
                             void (*dumper)(ScmPort *, Leaf*, int, void*),
@@ -41,6 +41,7 @@
           sparse-table-update! sparse-table-push! sparse-table-pop!
           sparse-table-fold sparse-table-map sparse-table-for-each
           sparse-table-keys sparse-table-values sparse-table-comparator
+          sparse-table-concurrent? sparse-table-stat
           %sparse-table-dump %sparse-table-check
 
           <sparse-vector-base> <sparse-vector> <sparse-s8vector>
@@ -56,6 +57,7 @@
           sparse-vector-push! sparse-vector-pop!
           sparse-vector-fold sparse-vector-map sparse-vector-for-each
           sparse-vector-keys sparse-vector-values
+          sparse-vector-load! sparse-vector-stat
           %sparse-vector-dump
 
           <sparse-matrix-base> <sparse-matrix> <sparse-s8matrix>
@@ -70,6 +72,7 @@
           sparse-matrix-push! sparse-matrix-pop!
           sparse-matrix-fold sparse-matrix-map sparse-matrix-for-each
           sparse-matrix-keys sparse-matrix-values
+          sparse-matrix-stat
           )
   )
 (select-module data.sparse)
@@ -154,7 +157,8 @@
  (define-type <sparse-table> "SparseTable*" "sparse table"
    "SPARSE_TABLE_P" "SPARSE_TABLE")
 
- (define-cproc %make-sparse-table (type cmpr::<comparator>)
+ (define-cproc %make-sparse-table (type cmpr::<comparator>
+                                     concurrent::<boolean>)
    (let* ([t::ScmHashType SCM_HASH_EQ])
      (cond
       [(SCM_EQ type 'eq?)      (set! t SCM_HASH_EQ)]
@@ -162,10 +166,14 @@
       [(SCM_EQ type 'equal?)   (set! t SCM_HASH_EQUAL)]
       [(SCM_EQ type 'string=?) (set! t SCM_HASH_STRING)]
       [else                    (set! t SCM_HASH_GENERAL)])
-     (return (MakeSparseTable t cmpr 0))))
+     (return (MakeSparseTable t cmpr
+                              (?: concurrent SPARSE_TABLE_CONCURRENT 0)))))
 
  (define-cproc sparse-table-comparator (st::<sparse-table>)
    (return (SCM_OBJ (-> st comparator))))
+
+ (define-cproc sparse-table-concurrent? (st::<sparse-table>) ::<boolean>
+   (return (SPARSE_TABLE_CONCURRENT_P st)))
  
  (define-cproc sparse-table-num-entries (st::<sparse-table>) ::<ulong>
    (return (-> st numEntries)))
@@ -192,6 +200,8 @@
 
  (define-cproc sparse-table-copy (sv::<sparse-table>) SparseTableCopy)
 
+ (define-cproc sparse-table-stat (st::<sparse-table>) SparseTableStat)
+
  (define-cfn sparse-table-iter (args::ScmObj* nargs::int data::void*) :static
    (let* ([iter::SparseTableIter* (cast SparseTableIter* data)]
           [r (SparseTableIterNext iter)]
@@ -220,7 +230,7 @@
     (equal? . ,equal-comparator)
     (string=? . ,string-comparator)))
 
-(define (make-sparse-table comparator)
+(define (make-sparse-table comparator :key (concurrent #f))
   (define (bad)
     (error "make-sparse-table needs a comparator or one of the symbols eq?, \
             eqv?, equal? or string=?, as an argument, but got:" comparator))
@@ -234,7 +244,7 @@
                (values type comparator)
                (values #f comparator))]
             [else (bad)])
-    (%make-sparse-table type cmpr)))
+    (%make-sparse-table type cmpr concurrent)))
 
 (define (sparse-table-push! sptab key val)
   ;; Can be optimized
@@ -324,6 +334,11 @@
 
  (define-cproc sparse-vector-copy (sv::<sparse-vector>) SparseVectorCopy)
 
+ (define-cproc sparse-vector-load! (sv::<sparse-vector> indices values)
+   ::<void> SparseVectorLoad)
+
+ (define-cproc sparse-vector-stat (sv::<sparse-vector>) SparseVectorStat)
+
  (define-cproc sparse-vector-inc! (sv::<sparse-vector>
                                    index::<ulong>
                                    delta::<number>
@@ -509,6 +524,8 @@
 
 (define-cproc sparse-matrix-copy (sv::<sparse-matrix>) SparseVectorCopy)
 
+(define-cproc sparse-matrix-stat (sv::<sparse-matrix>) SparseVectorStat)
+
 (define-cproc sparse-matrix-inc! (sv::<sparse-matrix>
                                   x y
                                   delta::<number>
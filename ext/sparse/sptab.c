@@ -104,6 +104,7 @@ ScmObj MakeSparseTable(ScmHashType type, ScmComparator *comparator,
     CompactTrieInit(&v->trie);
     v->numEntries = 0;
     v->comparator = comparator;
+    v->flags = flags;
 
     switch (type) {
     case SCM_HASH_EQ:
@@ -186,8 +187,68 @@ ScmObj SparseTableRef(SparseTable *st, ScmObj key, ScmObj fallback)
  * Insertion
  */
 
+/* In a concurrent table, a published leaf and its chain are never
+   modified.  We make a new leaf and replace the old one. */
+static ScmObj set_cow(SparseTable *st, ScmObj key, ScmObj value, int flags)
+{
+    int createp = !(flags&SCM_DICT_NO_CREATE);
+    u_long hv = sparse_table_hash(st, key);
+    TLeaf *z = (TLeaf*)CompactTrieGet(&st->trie, hv);
+    TLeaf *nz = (TLeaf*)leaf_allocate(NULL);
+    int added = FALSE;
+
+    if (z == NULL) {
+        if (!createp) return SCM_UNBOUND;
+        leaf_key_set(LEAF(nz), hv);
+        nz->entry.key = key;
+        nz->entry.value = value;
+        added = TRUE;
+    } else if (!leaf_is_chained(z)) {
+        nz->hdr = z->hdr;
+        if (sparse_table_eq(st, z->entry.key, key)) {
+            nz->entry.key = z->entry.key;
+            nz->entry.value = value;
+        } else {
+            if (!createp) return SCM_UNBOUND;
+            leaf_mark_chained(nz);
+            nz->chain.pair = Scm_Cons(key, value);
+            nz->chain.next = SCM_LIST1(Scm_Cons(z->entry.key,
+                                                z->entry.value));
+            added = TRUE;
+        }
+    } else {
+        ScmObj h = SCM_NIL, t = SCM_NIL, cp;
+        int found = FALSE;
+        nz->hdr = z->hdr;
+        /* The pairs other than the one with KEY can be shared. */
+        SCM_FOR_EACH(cp, Scm_Cons(z->chain.pair, z->chain.next)) {
+            ScmObj p = SCM_CAR(cp);
+            if (!found && sparse_table_eq(st, SCM_CAR(p), key)) {
+                SCM_APPEND1(h, t, Scm_Cons(SCM_CAR(p), value));
+                found = TRUE;
+            } else {
+                SCM_APPEND1(h, t, p);
+            }
+        }
+        if (found) {
+            nz->chain.pair = SCM_CAR(h);
+            nz->chain.next = SCM_CDR(h);
+        } else {
+            if (!createp) return SCM_UNBOUND;
+            nz->chain.pair = Scm_Cons(key, value);
+            nz->chain.next = h;
+            added = TRUE;
+        }
+    }
+    CompactTriePut(&st->trie, LEAF(nz));
+    if (added) st->numEntries++;
+    return value;
+}
+
 ScmObj SparseTableSet(SparseTable *st, ScmObj key, ScmObj value, int flags)
 {
+    if (SPARSE_TABLE_CONCURRENT_P(st)) return set_cow(st, key, value, flags);
+
     int createp = !(flags&SCM_DICT_NO_CREATE);
     u_long hv = sparse_table_hash(st, key);
     TLeaf *z;
@@ -241,9 +302,51 @@ ScmObj SparseTableSet(SparseTable *st, ScmObj key, ScmObj value, int flags)
  * Deletion
  */
 
+static ScmObj delete_cow(SparseTable *st, ScmObj key)
+{
+    u_long hv = sparse_table_hash(st, key);
+    TLeaf *z = (TLeaf*)CompactTrieGet(&st->trie, hv);
+
+    if (z == NULL) return SCM_UNBOUND;
+    if (!leaf_is_chained(z)) {
+        if (!sparse_table_eq(st, key, z->entry.key)) return SCM_UNBOUND;
+        CompactTrieRemove(&st->trie, hv);
+        st->numEntries--;
+        return z->entry.value;
+    }
+
+    ScmObj h = SCM_NIL, t = SCM_NIL, cp, retval = SCM_UNBOUND;
+    SCM_FOR_EACH(cp, Scm_Cons(z->chain.pair, z->chain.next)) {
+        ScmObj p = SCM_CAR(cp);
+        if (SCM_UNBOUNDP(retval) && sparse_table_eq(st, key, SCM_CAR(p))) {
+            retval = SCM_CDR(p);
+        } else {
+            SCM_APPEND1(h, t, p);
+        }
+    }
+    if (SCM_UNBOUNDP(retval)) return SCM_UNBOUND;
+
+    TLeaf *nz = (TLeaf*)leaf_allocate(NULL);
+    nz->hdr = z->hdr;
+    if (SCM_NULLP(SCM_CDR(h))) {
+        /* make sure we have more than one entry in a chained leaf */
+        leaf_mark_unchained(nz);
+        nz->entry.key = SCM_CAAR(h);
+        nz->entry.value = SCM_CDAR(h);
+    } else {
+        nz->chain.pair = SCM_CAR(h);
+        nz->chain.next = SCM_CDR(h);
+    }
+    CompactTriePut(&st->trie, LEAF(nz));
+    st->numEntries--;
+    return retval;
+}
+
 /* returns value of the deleted entry, or SCM_UNBOUND if there's no entry */
 ScmObj SparseTableDelete(SparseTable *st, ScmObj key)
 {
+    if (SPARSE_TABLE_CONCURRENT_P(st)) return delete_cow(st, key);
+
     u_long hv = sparse_table_hash(st, key);
     TLeaf *z = (TLeaf*)CompactTrieGet(&st->trie, hv);
     ScmObj retval = SCM_UNBOUND;
@@ -298,7 +401,12 @@ static void clear_leaf(Leaf *f, void *data)
 void SparseTableClear(SparseTable *st)
 {
     st->numEntries = 0;
-    CompactTrieClear(&st->trie, clear_leaf, NULL);
+    if (SPARSE_TABLE_CONCURRENT_P(st)) {
+        /* Readers and snapshots may still be using the nodes. */
+        CompactTrieInit(&st->trie);
+    } else {
+        CompactTrieClear(&st->trie, clear_leaf, NULL);
+    }
 }
 
 /*===================================================================
@@ -329,7 +437,12 @@ ScmObj SparseTableCopy(const SparseTable *s)
 {
     SparseTable *d = SCM_NEW(SparseTable);
     memcpy(d, s, sizeof(SparseTable));
-    CompactTrieCopy(&d->trie, &s->trie, copy_leaf, NULL);
+    if (SPARSE_TABLE_CONCURRENT_P(s)) {
+        /* Neither table modifies the shared nodes. */
+        CompactTrieSnapshot(&d->trie, &s->trie);
+    } else {
+        CompactTrieCopy(&d->trie, &s->trie, copy_leaf, NULL);
+    }
     return SCM_OBJ(d);
 }
 
@@ -340,7 +453,12 @@ ScmObj SparseTableCopy(const SparseTable *s)
 void SparseTableIterInit(SparseTableIter *it, SparseTable *st)
 {
     it->st = st;
-    CompactTrieIterInit(&it->ctit, &st->trie);
+    if (SPARSE_TABLE_CONCURRENT_P(st)) {
+        CompactTrieSnapshot(&it->snapshot, &st->trie);
+        CompactTrieIterInit(&it->ctit, &it->snapshot);
+    } else {
+        CompactTrieIterInit(&it->ctit, &st->trie);
+    }
     it->chain = SCM_NIL;
     it->end = FALSE;
 }
@@ -369,6 +487,50 @@ ScmObj SparseTableIterNext(SparseTableIter *it)
  * Miscellaneous
  */
 
+typedef struct {
+    u_long chainedLeaves;
+    u_long pairs;               /* # of pairs used for chains */
+} ChainStat;
+
+static void leaf_stat(Leaf *leaf, void *data)
+{
+    TLeaf *z = (TLeaf*)leaf;
+    ChainStat *cs = (ChainStat*)data;
+    if (leaf_is_chained(z)) {
+        /* chain.pair, plus the cell and the entry for each of chain.next */
+        cs->chainedLeaves++;
+        cs->pairs += 1 + 2*Scm_Length(z->chain.next);
+    }
+}
+
+ScmObj SparseTableStat(SparseTable *st)
+{
+    CompactTrieStat ts;
+    ChainStat cs = {0, 0};
+    CompactTrieGetStat(&st->trie, &ts, leaf_stat, &cs);
+
+    double fill = (ts.numLeaves > 0)
+        ? (double)st->numEntries / ts.numLeaves : 0.0;
+    u_long bytes = ts.nodeBytes + ts.numLeaves * sizeof(TLeaf)
+        + cs.pairs * sizeof(ScmPair);
+
+    return Scm_List(SCM_LIST2(SCM_MAKE_KEYWORD("num-entries"),
+                              Scm_MakeIntegerU(st->numEntries)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("num-nodes"),
+                              Scm_MakeIntegerU(ts.numNodes)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("num-leaves"),
+                              Scm_MakeIntegerU(ts.numLeaves)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("num-chained-leaves"),
+                              Scm_MakeIntegerU(cs.chainedLeaves)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("max-depth"),
+                              Scm_MakeIntegerU(ts.maxDepth)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("leaf-fill-ratio"),
+                              Scm_MakeFlonum(fill)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("bytes"),
+                              Scm_MakeIntegerU(bytes)),
+                    NULL);
+}
+
 static void leaf_dump(ScmPort *out, Leaf *leaf, int indent, void *data)
 {
     TLeaf *z = (TLeaf*)leaf;
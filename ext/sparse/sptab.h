@@ -51,8 +51,20 @@ typedef struct SparseTableRec {
     u_long      (*hashfn)(ScmObj key);
     int         (*cmpfn)(ScmObj a, ScmObj b);
     ScmComparator *comparator;  /* only used for generic table */
+    u_long      flags;
 } SparseTable;
 
+/* Flags for MakeSparseTable */
+enum {
+    /* Updates are done by copy-on-write, so that readers can look up
+       and iterate the table without locking while a single writer
+       updates it.  Iterators see a snapshot of the table taken when
+       they are created. */
+    SPARSE_TABLE_CONCURRENT = (1L<<0)
+};
+
+#define SPARSE_TABLE_CONCURRENT_P(st) ((st)->flags & SPARSE_TABLE_CONCURRENT)
+
 SCM_CLASS_DECL(Scm_SparseTableClass);
 #define SCM_CLASS_SPARSE_TABLE  (&Scm_SparseTableClass)
 #define SPARSE_TABLE(obj)       ((SparseTable*)(obj))
@@ -67,12 +79,14 @@ extern ScmObj SparseTableDelete(SparseTable *st, ScmObj key);
 extern void   SparseTableClear(SparseTable *st);
 extern ScmObj SparseTableCopy(const SparseTable *st);
 
+extern ScmObj SparseTableStat(SparseTable *st);
 extern void   SparseTableDump(SparseTable *sv);
 extern void   SparseTableCheck(SparseTable *sv);
 
 /* Iterator */
 typedef struct SparseTableIterRec {
     SparseTable *st;
+    CompactTrie snapshot;       /* used for a concurrent table */
     CompactTrieIter ctit;
     ScmObj chain;
     int end;
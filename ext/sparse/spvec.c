@@ -249,7 +249,8 @@ static void g_dump(ScmPort *out, Leaf *leaf, int indent, void *data)
 }
 
 static SparseVectorDescriptor g_desc = {
-    g_ref, g_set, g_allocate, g_delete, g_clear, g_copy, g_iter, g_dump, 1
+    g_ref, g_set, g_allocate, g_delete, g_clear, g_copy, g_iter, g_dump, 1,
+    SCM_UVECTOR_INVALID
 };
 
 SCM_DEFINE_BUILTIN_CLASS(Scm_SparseVectorClass, NULL, NULL, NULL, NULL,
@@ -542,6 +543,7 @@ U_ITER(f64, MASK64)
         u_copy,                                                         \
         SCM_CPP_CAT(tag,_iter),                                         \
         NULL, shift,                                                    \
+        SCM_CPP_CAT(SCM_UVECTOR_,TAG)                                   \
     };                                                                  \
     SCM_DEFINE_BUILTIN_CLASS(SCM_CPP_CAT3(Scm_Sparse,TAG,VectorClass),  \
                              NULL, NULL, NULL, NULL, spvec_cpl);        \
@@ -560,6 +562,111 @@ U_DECL(f16, F16, SHIFT16);
 U_DECL(f32, F32, SHIFT32);
 U_DECL(f64, F64, SHIFT64);
 
+/*===================================================================
+ * Bulk load
+ */
+
+/* INDICES is a u32vector or u64vector, and VALUES is a vector or a
+   uvector of the same length.  We look up the trie only when the leaf
+   changes, so loading sorted indices takes one trie access per leaf
+   rather than per element.  If VALUES has the same element type as SV,
+   elements are copied into the leaves without boxing. */
+void SparseVectorLoad(SparseVector *sv, ScmObj indices, ScmObj values)
+{
+    int wide = FALSE;
+    if (SCM_U64VECTORP(indices)) wide = TRUE;
+    else if (!SCM_U32VECTORP(indices)) {
+        Scm_Error("u32vector or u64vector required, but got %S", indices);
+    }
+    ScmSmallInt n = SCM_UVECTOR_SIZE(indices);
+
+    int vtype = SCM_UVECTOR_INVALID;
+    if (SCM_UVECTORP(values)) {
+        vtype = Scm_UVectorType(SCM_CLASS_OF(values));
+        if (SCM_UVECTOR_SIZE(values) != n) goto badlen;
+    } else if (SCM_VECTORP(values)) {
+        if (SCM_VECTOR_SIZE(values) != n) goto badlen;
+    } else {
+        Scm_Error("vector or uvector required, but got %S", values);
+    }
+
+    int shift = sv->desc->shift;
+    u_long mask = (1UL<<shift)-1;
+    int raw = (vtype != SCM_UVECTOR_INVALID && vtype == sv->desc->uvtype);
+    int esize = raw? Scm_UVectorElementSize(SCM_CLASS_OF(values)) : 0;
+    Leaf *leaf = NULL;
+    u_long leafkey = 0;
+
+    for (ScmSmallInt i=0; i<n; i++) {
+        u_long index;
+        if (wide) {
+            ScmUInt64 k = SCM_U64VECTOR_ELEMENTS(indices)[i];
+#if SIZEOF_LONG == 4
+            if (k > ULONG_MAX) {
+                Scm_Error("index out of range: %S", Scm_MakeIntegerU64(k));
+            }
+#endif
+            index = (u_long)k;
+        } else {
+            index = SCM_U32VECTOR_ELEMENTS(indices)[i];
+        }
+
+        u_long key = index >> shift;
+        if (leaf == NULL || key != leafkey) {
+            leaf = CompactTrieAdd(&sv->trie, key, sv->desc->allocate, sv);
+            leafkey = key;
+        }
+        if (raw) {
+            u_long k = index & mask;
+            memcpy(ULEAF(leaf)->u8 + k*esize,
+                   (char*)SCM_UVECTOR_ELEMENTS(values) + i*esize, esize);
+            if (!leaf_data_bit_test(leaf, k)) {
+                leaf_data_bit_set(leaf, k);
+                sv->numEntries++;
+            }
+        } else {
+            ScmObj v = SCM_VECTORP(values)
+                ? SCM_VECTOR_ELEMENT(values, i)
+                : Scm_VMUVectorRef(SCM_UVECTOR(values), vtype, i, SCM_UNBOUND);
+            SCM_FLONUM_ENSURE_MEM(v);
+            if (sv->desc->set(leaf, index, v)) sv->numEntries++;
+        }
+    }
+    return;
+ badlen:
+    Scm_Error("indices and values must have the same length, "
+              "but got %S and %S", indices, values);
+}
+
+/*===================================================================
+ * Statistics
+ */
+
+ScmObj SparseVectorStat(SparseVector *sv)
+{
+    CompactTrieStat st;
+    CompactTrieGetStat(&sv->trie, &st, NULL, NULL);
+
+    size_t leafsize = (sv->desc == &g_desc)? sizeof(GLeaf) : sizeof(ULeaf);
+    double capacity = (double)st.numLeaves * (1UL << sv->desc->shift);
+    double fill = (capacity > 0)? sv->numEntries / capacity : 0.0;
+    u_long bytes = st.nodeBytes + st.numLeaves * leafsize;
+
+    return Scm_List(SCM_LIST2(SCM_MAKE_KEYWORD("num-entries"),
+                              Scm_MakeIntegerU(sv->numEntries)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("num-nodes"),
+                              Scm_MakeIntegerU(st.numNodes)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("num-leaves"),
+                              Scm_MakeIntegerU(st.numLeaves)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("max-depth"),
+                              Scm_MakeIntegerU(st.maxDepth)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("leaf-fill-ratio"),
+                              Scm_MakeFlonum(fill)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("bytes"),
+                              Scm_MakeIntegerU(bytes)),
+                    NULL);
+}
+
 /*===================================================================
  * Generic constructor
  */
@@ -99,6 +99,8 @@ struct SparseVectorDescriptorRec {
     void     (*dump)(ScmPort *out, Leaf *leaf, int indent, void *data);
 
     int shift;                  /* # of shift bits to access Leaf */
+    int uvtype;                 /* ScmUVectorType of the elements, or
+                                   SCM_UVECTOR_INVALID */
 };
 
 /* Max # of bits for index.  Theoretrically we can extend this
@@ -119,6 +121,9 @@ extern void   SparseVectorClear(SparseVector *sv);
 extern ScmObj SparseVectorCopy(const SparseVector *src);
 extern ScmObj SparseVectorInc(SparseVector *sv, u_long index, ScmObj delta,
                               ScmObj fallback);
+extern void   SparseVectorLoad(SparseVector *sv, ScmObj indices,
+                               ScmObj values);
+extern ScmObj SparseVectorStat(SparseVector *sv);
 extern void   SparseVectorDump(SparseVector *sv);
 
 extern void   SparseVectorIterInit(SparseVectorIter *iter, SparseVector *sv);
@@ -182,6 +182,48 @@
 (spvec-heavy 'f32 (^x (exact->inexact (logand x #xfffff))))
 (spvec-heavy 'f64 exact->inexact)
 
+(use gauche.uvector)
+(let ([idx (u32vector 0 1 2 3 100 101 1000000)]
+      [vals (f64vector 0.5 1.5 2.5 3.5 4.5 5.5 6.5)])
+  (define (contents sv) (sort (sparse-vector-map sv cons) < car))
+  (define expected
+    (map cons (u32vector->list idx) (f64vector->list vals)))
+
+  (test* "sparse-vector-load! (same type)" expected
+         (rlet1 sv (make-sparse-vector 'f64)
+           (sparse-vector-load! sv idx vals))
+         (^[e r] (equal? e (contents r))))
+  (test* "sparse-vector-load! (conversion)" '((0 . 0) (100 . 4) (101 . 5))
+         (let1 sv (make-sparse-vector 's8)
+           (sparse-vector-load! sv (u64vector 100 0 101) (s32vector 4 0 5))
+           (contents sv)))
+  (test* "sparse-vector-load! (vector, overwrite)"
+         '(3 ((1 . b) (2 . c) (5 . d)))
+         (let1 sv (make-sparse-vector)
+           (sparse-vector-set! sv 2 'z)
+           (sparse-vector-load! sv (u32vector 1 2 5) '#(b c d))
+           (list (sparse-vector-num-entries sv) (contents sv))))
+  (test* "sparse-vector-load! (length mismatch)" (test-error)
+         (sparse-vector-load! (make-sparse-vector 'f64) idx (f64vector 1.0)))
+  (test* "sparse-vector-load! (bad indices)" (test-error)
+         (sparse-vector-load! (make-sparse-vector 'f64) '#(0 1) vals))
+
+  ;; An f64 leaf holds two elements on 64-bit platforms, one on 32-bit.
+  (test* "sparse-vector-stat"
+         `(7 ,(if (= (sparse-vector-max-index-bits) 64) 4 7) #t)
+         (let* ([sv (rlet1 sv (make-sparse-vector 'f64)
+                      (sparse-vector-load! sv idx vals))]
+                [st (sparse-vector-stat sv)])
+           (list (cadr (assq :num-entries st))
+                 (cadr (assq :num-leaves st))
+                 (and (< 0 (cadr (assq :leaf-fill-ratio st)) 1)
+                      (> (cadr (assq :bytes st)) 0)
+                      (>= (cadr (assq :num-nodes st)) 1)))))
+  (test* "sparse-vector-stat (empty)" '(0 0 0)
+         (let1 st (sparse-vector-stat (make-sparse-vector))
+           (map (^k (cadr (assq k st))) '(:num-nodes :num-leaves :bytes))))
+  )
+
 
 ;; sparse table----------------------------------------------------
 (test-section "sparse-table")
@@ -208,41 +250,111 @@
 (sptab-heavy 'equal? (^k (list k k)))
 (sptab-heavy 'string=? (^k (number->string k 36)))
 
+(test* "sparse-table-stat" '(4 3 1)
+       (let1 t (make-sparse-table 'equal?)
+         ;; (0 . 5) and #(0 5) have the same hash value
+         (for-each (cut sparse-table-set! t <> #t) '((0 . 5) #(0 5) a b))
+         (let1 st (sparse-table-stat t)
+           (map (^k (cadr (assq k st)))
+                '(:num-entries :num-leaves :num-chained-leaves)))))
+
+(define (sptab-heavy-concurrent type keygen)
+  (heavy-test #"sparse-table (~type, concurrent)"
+              (make-sparse-table type :concurrent #t)
+              sparse-table-ref sparse-table-set! sparse-table-num-entries
+              sparse-table-clear! sparse-table-keys sparse-table-values
+              sparse-table-delete! sparse-table-copy %sparse-table-check
+              keygen values))
+
+(sptab-heavy-concurrent 'eqv? values)
+(sptab-heavy-concurrent 'string=? (^k (number->string k 36)))
+
+;; In a concurrent table, iterators and copies see a snapshot.
+(let1 t (make-sparse-table 'eqv? :concurrent #t)
+  (dotimes [k 100] (sparse-table-set! t k k))
+  (test* "sparse-table-concurrent?" '(#t #f)
+         (list (sparse-table-concurrent? t)
+               (sparse-table-concurrent? (make-sparse-table 'eqv?))))
+  (test* "concurrent sparse-table snapshot iteration" '(100 4950)
+         (let1 s (sparse-table-fold t
+                                    (^[k v s]
+                                      (sparse-table-delete! t k)
+                                      (sparse-table-set! t (+ k 1000) v)
+                                      (+ s v))
+                                    0)
+           (list (sparse-table-num-entries t) s)))
+  (test* "concurrent sparse-table snapshot copy" '(100 0 (1000 1099))
+         (let1 u (sparse-table-copy t)
+           (sparse-table-clear! t)
+           (list (sparse-table-num-entries u)
+                 (sparse-table-num-entries t)
+                 (list (apply min (sparse-table-keys u))
+                       (apply max (sparse-table-keys u)))))))
+
+(cond-expand
+ [gauche.sys.threads
+  (use gauche.threads)
+  (test* "concurrent sparse-table lock-free readers" #t
+         (let* ([t (make-sparse-table 'eqv? :concurrent #t)]
+                [n 20000]
+                [_ (dotimes [k 1000] (sparse-table-set! t (- -1 k) k))]
+                [reader (^[]
+                          ;; Negative keys are never touched by the writer.
+                          (let loop ([i 0] [ok #t])
+                            (if (= i n)
+                              ok
+                              (let1 k (modulo i 1000)
+                                (loop (+ i 1)
+                                      (and ok
+                                           (eqv? (sparse-table-ref t (- -1 k)
+                                                                   #f)
+                                                 k)))))))]
+                [ths (map (^_ (thread-start! (make-thread reader)))
+                          (iota 2))])
+           (dotimes [k n]
+             (sparse-table-set! t k k)
+             (when (odd? k) (sparse-table-delete! t (- k 1))))
+           (and (every thread-join! ths)
+                (= (sparse-table-num-entries t) (+ 1000 (quotient n 2)))
+                (begin (%sparse-table-check t) #t))))]
+ [else])
+
 ;; The following tests use specifically crafted keys that
 ;; have the same hash value, so we go through 'chained' leaf path.
 
-(let ([t (make-sparse-table 'equal?)]
-      [keys '((0 . 5) (1 . 0) #(0 5) #(1 0))])
-
-  (define (vals tab) (map (cut sparse-table-ref tab <> #f) keys))
-
-  (sparse-table-set! t '(0 . 5) 'a)
-  (sparse-table-set! t '(1 . 0) 'b)
-  (sparse-table-set! t '#(0 5) 'c)
-  (sparse-table-set! t '#(1 0) 'd)
-
-  (test* "key conflicts / ref" '(a b c d) (vals t))
-  (test* "key conflicts / set" '((z . a) (z . b) (z . c) (z . d))
-         (begin (for-each (cut sparse-table-push! t <> 'z) keys)
-                (vals t)))
-  (let1 u (sparse-table-copy t)
-    (test* "key conflicts / copy 1" '((z . a) (z . b) (z . c) (z . d))
-           (vals u))
-    (test* "key conflicts / copy 2" '((z z z z) (a b c d))
-           (let1 z (map (cut sparse-table-pop! u <>) keys)
-             (list z (vals u))))
-    (test* "key conflicts / copy (original)" '((z . a) (z . b) (z . c) (z . d))
-           (vals t))
-
-    (test* "key conflicts delete 1" '(#f b c d)
-           (begin (sparse-table-delete! u '(0 . 5)) (vals u)))
-    (test* "key conflicts delete 2" '(#f b #f d)
-           (begin (sparse-table-delete! u '#(0 5)) (vals u)))
-    (test* "key conflicts delete 3" '(#f b #f #f)
-           (begin (sparse-table-delete! u '#(1 0)) (vals u)))
-    (test* "key conflicts delete 4" '(#f #f #f #f)
-           (begin (sparse-table-delete! u '(1 . 0)) (vals u)))
-    ))
+(dolist [concurrent '(#f #t)]
+  (let ([t (make-sparse-table 'equal? :concurrent concurrent)]
+        [keys '((0 . 5) (1 . 0) #(0 5) #(1 0))])
+
+    (define (vals tab) (map (cut sparse-table-ref tab <> #f) keys))
+
+    (sparse-table-set! t '(0 . 5) 'a)
+    (sparse-table-set! t '(1 . 0) 'b)
+    (sparse-table-set! t '#(0 5) 'c)
+    (sparse-table-set! t '#(1 0) 'd)
+
+    (test* "key conflicts / ref" '(a b c d) (vals t))
+    (test* "key conflicts / set" '((z . a) (z . b) (z . c) (z . d))
+           (begin (for-each (cut sparse-table-push! t <> 'z) keys)
+                  (vals t)))
+    (let1 u (sparse-table-copy t)
+      (test* "key conflicts / copy 1" '((z . a) (z . b) (z . c) (z . d))
+             (vals u))
+      (test* "key conflicts / copy 2" '((z z z z) (a b c d))
+             (let1 z (map (cut sparse-table-pop! u <>) keys)
+               (list z (vals u))))
+      (test* "key conflicts / copy (original)" '((z . a) (z . b) (z . c) (z . d))
+             (vals t))
+
+      (test* "key conflicts delete 1" '(#f b c d)
+             (begin (sparse-table-delete! u '(0 . 5)) (vals u)))
+      (test* "key conflicts delete 2" '(#f b #f d)
+             (begin (sparse-table-delete! u '#(0 5)) (vals u)))
+      (test* "key conflicts delete 3" '(#f b #f #f)
+             (begin (sparse-table-delete! u '#(1 0)) (vals u)))
+      (test* "key conflicts delete 4" '(#f #f #f #f)
+             (begin (sparse-table-delete! u '(1 . 0)) (vals u)))
+      )))
 
 ;; custom comparator
 (let ()
@@ -59,6 +59,7 @@
           time-tai->time-monotonic time-tai->time-monotonic!
           time-tai->time-utc time-tai->time-utc!
           date->string string->date <date>
+          make-date-formatter make-date-parser
           )
   )
 (select-module srfi-19)
@@ -447,7 +448,7 @@
 ;; Offset of local timezone in seconds.
 ;; System-dependent.
 
-(define (tm:local-tz-offset)
+(define (tm:compute-local-tz-offset now)
   (define (tm->seconds-in-year tm)
     (+ (cond [(assv (+ (slot-ref tm 'mon) 1) tm:month-assoc)
               => (^p (* (+ (cdr p)
@@ -459,8 +460,7 @@
              [else (error "something wrong")])
        (* (slot-ref tm 'hour) 3600)
        (* (slot-ref tm 'min) 60)))
-  (let* ([now   (sys-time)]
-         [local (sys-localtime now)]
+  (let* ([local (sys-localtime now)]
          [local-sec (tm->seconds-in-year local)]
          [local-yr  (slot-ref local 'year)]
          [gm    (sys-gmtime now)]
@@ -480,6 +480,19 @@
                  (if (tm:leap-year? (slot-ref gm 'year)) 31622400 31536000)))]
           )))
 
+;; The offset can only change at a second boundary, so we keep the one
+;; computed for the last second.  Parameters are thread-local, hence each
+;; thread has its own cache without locking.
+(define tm:local-tz-offset-cache (make-parameter '(#f . #f)))
+
+(define (tm:local-tz-offset)
+  (let ([now (sys-time)]
+        [cache (tm:local-tz-offset-cache)])
+    (if (eqv? (car cache) now)
+      (cdr cache)
+      (rlet1 offset (tm:compute-local-tz-offset now)
+        (tm:local-tz-offset-cache (cons now offset))))))
+
 ;; special thing -- ignores nanos
 (define (tm:time->julian-day-number seconds tz-offset)
   (/ (+ (* tm:tai-epoch-in-jd tm:sid)
@@ -753,6 +766,90 @@
 (define tm:locale-time-format "~H:~M:~S")
 (define tm:iso-8601-date-time-format "~Y-~m-~dT~H:~M:~S~z")
 
+;; Native helpers for the ISO-8601 form "YYYY-MM-DDTHH:MM:SS[zone]",
+;; which is by far the most common template.  They deal only with
+;; fixnum fields and the exact layout; they return #f otherwise and the
+;; caller falls back to the generic path.
+
+(inline-stub
+ (declcode "#include <stdio.h>")
+
+ (define-cproc %date->iso8601 (year month day hour minute second
+                               zone?::<boolean> offset)
+   (unless (and (SCM_INTP year) (SCM_INTP month) (SCM_INTP day)
+                (SCM_INTP hour) (SCM_INTP minute) (SCM_INTP second))
+     (return SCM_FALSE))
+   (when (and zone? (not (SCM_INTP offset)))
+     (return SCM_FALSE))
+   (let* ([buf::(.array char [256])]
+          [n::int (snprintf buf (sizeof buf)
+                            "%ld-%02ld-%02ldT%02ld:%02ld:%02ld"
+                            (SCM_INT_VALUE year) (SCM_INT_VALUE month)
+                            (SCM_INT_VALUE day) (SCM_INT_VALUE hour)
+                            (SCM_INT_VALUE minute) (SCM_INT_VALUE second))])
+     (when zone?
+       (let* ([off::long (SCM_INT_VALUE offset)]
+              [a::long (?: (< off 0) (- off) off)])
+         (if (== off 0)
+           (snprintf (+ buf n) (- (sizeof buf) n) "Z")
+           (snprintf (+ buf n) (- (sizeof buf) n) "%c%02ld%02ld"
+                     (?: (< off 0) #\- #\+)
+                     (/ a 3600) (/ (% a 3600) 60)))))
+     (return (SCM_MAKE_STR_COPYING buf))))
+
+ ;; Returns the value of N decimal digits at S, or -1.
+ (define-cfn iso8601-digits (s::(const char*) n::int) ::long :static
+   (let* ([v::long 0])
+     (dotimes [i n]
+       (let* ([c::int (aref s i)])
+         (unless (and (<= #\0 c) (<= c #\9)) (return -1))
+         (set! v (+ (* v 10) (- c #\0)))))
+     (return v)))
+
+ ;; Returns year, month, day, hour, minute, second and zone offset of
+ ;; the ISO-8601 date at the beginning of STR.  If ZONE? is false, no
+ ;; zone is expected and the offset is #f.  Trailing characters are
+ ;; ignored, as string->date does.  If STR doesn't match, all values
+ ;; are #f.
+ (define-cproc %iso8601->date-fields (str::<string> zone?::<boolean>)
+   ::(<top> <top> <top> <top> <top> <top> <top>)
+   (let* ([size::ScmSmallInt 0]
+          [s::(const char*) (Scm_GetStringContent str (& size) NULL NULL)]
+          [y::long] [mo::long] [d::long] [h::long] [mi::long] [sec::long]
+          [off::long 0])
+     (unless (and (>= size 19)
+                  (== (aref s 4) #\-) (== (aref s 7) #\-)
+                  (== (aref s 10) #\T)
+                  (== (aref s 13) #\:) (== (aref s 16) #\:))
+       (goto fail))
+     (set! y   (iso8601-digits s 4)
+           mo  (iso8601-digits (+ s 5) 2)
+           d   (iso8601-digits (+ s 8) 2)
+           h   (iso8601-digits (+ s 11) 2)
+           mi  (iso8601-digits (+ s 14) 2)
+           sec (iso8601-digits (+ s 17) 2))
+     (when (or (< y 0) (< mo 0) (< d 0) (< h 0) (< mi 0) (< sec 0))
+       (goto fail))
+     (when zone?
+       (cond [(and (> size 19)
+                   (or (== (aref s 19) #\Z) (== (aref s 19) #\z)))
+              (set! off 0)]
+             [(and (>= size 24)
+                   (or (== (aref s 19) #\+) (== (aref s 19) #\-)))
+              (let* ([zh::long (iso8601-digits (+ s 20) 2)]
+                     [zm::long (iso8601-digits (+ s 22) 2)])
+                (when (or (< zh 0) (< zm 0)) (goto fail))
+                (set! off (+ (* zh 3600) (* zm 60)))
+                (when (== (aref s 19) #\-) (set! off (- off))))]
+             [else (goto fail)]))
+     (return (SCM_MAKE_INT y) (SCM_MAKE_INT mo) (SCM_MAKE_INT d)
+             (SCM_MAKE_INT h) (SCM_MAKE_INT mi) (SCM_MAKE_INT sec)
+             (?: zone? (SCM_MAKE_INT off) SCM_FALSE))
+     (label fail)
+     (return SCM_FALSE SCM_FALSE SCM_FALSE SCM_FALSE SCM_FALSE SCM_FALSE
+             SCM_FALSE)))
+ )
+
 ;; returns a string rep. of number N, of minimum LENGTH,
 ;; padded with character PAD-WITH. If PAD-WITH is #f,
 ;; no padding is done, and it's as if number->string was used.
@@ -809,6 +906,22 @@
           [minutes (abs (quotient (remainder offset (* 60 60)) 60))])
       (format #t "~2,'0d~2,'0d" hours minutes))))
 
+;; Directives that are shorthands of other templates.  The template
+;; compiler expands them in place.
+(define tm:directive-templates
+  `((#\c . ,tm:locale-date-time-format)
+    (#\D . "~m/~d/~y")
+    (#\h . "~b")
+    (#\r . "~I:~M:~S ~p")
+    (#\T . "~H:~M:~S")
+    (#\x . ,tm:locale-short-date-format)
+    (#\X . ,tm:locale-time-format)
+    (#\1 . "~Y-~m-~d")
+    (#\2 . "~H:~M:~S~z")
+    (#\3 . "~H:~M:~S")
+    (#\4 . ,tm:iso-8601-date-time-format)
+    (#\5 . "~Y-~m-~dT~H:~M:~S")))
+
 ;; A table of output formatting directives.
 ;; the first time is the format char.
 ;; the second is a procedure that takes the date, a padding character
@@ -824,12 +937,8 @@
               (display (tm:locale-abbr-month (date-month date)))))
     (#\B . ,(^[date pad-with]
               (display (tm:locale-long-month (date-month date)))))
-    (#\c . ,(^[date pad-with]
-              (display (date->string date tm:locale-date-time-format))))
     (#\d . ,(^[date pad-with]
               (format #t "~2,'0d" (date-day date))))
-    (#\D . ,(^[date pad-with]
-              (display (date->string date "~m/~d/~y"))))
     (#\e . ,(^[date pad-with]
               (format #t "~2,' d" (date-day date))))
     (#\f . ,(^[date pad-with]
@@ -838,8 +947,6 @@
               (let1 nanostr (number->string (/. (date-nanosecond date) tm:nano/i))
                 (cond [(string-index nanostr #\.)
                        => (^i (display (string-drop nanostr (+ i 1))))]))))
-    (#\h . ,(^[date pad-with]
-              (display (date->string date "~b"))))
     (#\H . ,(^[date pad-with]
               (display (tm:padding (date-hour date) pad-with 2))))
     (#\I . ,(^[date pad-with]
@@ -865,16 +972,12 @@
               (display (tm:padding (date-nanosecond date) pad-with 9))))
     (#\p . ,(^[date pad-with]
               (display (tm:locale-am/pm (date-hour date)))))
-    (#\r . ,(^[date pad-with]
-              (display (date->string date "~I:~M:~S ~p"))))
     (#\s . ,(^[date pad-with]
               (display (time-second (date->time-utc date)))))
     (#\S . ,(^[date pad-with]
               (display (tm:padding (date-second date) pad-with 2))))
     (#\t . ,(^[date pad-with]
               (display #\tab)))
-    (#\T . ,(^[date pad-with]
-              (display (date->string date "~H:~M:~S"))))
     (#\U . ,(^[date pad-with]
               (format #t "~2,'0d"
                       (if (> (tm:days-before-first-week date 0) 0)
@@ -884,10 +987,6 @@
               (format #t "~2,'0d" (date-week-number date 1))))
     (#\w . ,(^[date pad-with]
               (display (date-week-day date))))
-    (#\x . ,(^[date pad-with]
-              (display (date->string date tm:locale-short-date-format))))
-    (#\X . ,(^[date pad-with]
-              (display (date->string date tm:locale-time-format))))
     (#\W . ,(^[date pad-with]
               (format #t "~2,'0d"
                       (if (> (tm:days-before-first-week date 1) 0)
@@ -901,53 +1000,85 @@
               (tm:tz-printer (date-zone-offset date))))
     (#\Z . ,(^[date pad-with]
               (tm:locale-print-time-zone date)))
-    (#\1 . ,(^[date pad-with]
-              (display (date->string date "~Y-~m-~d"))))
-    (#\2 . ,(^[date pad-with]
-              (display (date->string date "~H:~M:~S~z"))))
-    (#\3 . ,(^[date pad-with]
-              (display (date->string date "~H:~M:~S"))))
-    (#\4 . ,(^[date pad-with]
-              (display (date->string date "~Y-~m-~dT~H:~M:~S~z"))))
-    (#\5 . ,(^[date pad-with]
-              (display (date->string date "~Y-~m-~dT~H:~M:~S"))))
     ))
 
-(define (date->string date . maybe-fmtstr)
-  (let1 format-string (get-optional maybe-fmtstr "~c")
-    (with-input-from-string format-string
-      (^[]
-        (define (bad i)
-          (errorf "date->string: bad date format string: \"~a >>>~a<<< ~a\""
-                  (string-take format-string i)
-                  (substring format-string i (+ i 1))
-                  (string-drop format-string (+ i 1))))
-
-        (define (call-formatter ch pad ind)
-          (if-let1 fn (assv ch tm:directives)
-            (begin ((cdr fn) date pad) (rec (read-char) (+ ind 1)))
-            (bad ind)))
-
-        (define (rec ch ind)
-          (cond
-           [(eof-object? ch)]
-           [(not (char=? ch #\~))
-            (write-char ch) (rec (read-char) (+ ind 1))]
-           [else
-            (let1 ch2 (read-char)
-              (cond
-               [(eof-object? ch2) (write-char ch)]
-               ;; Gauche extension: ~@x calls the directive 'x' with locale
-               ;; set to C, so the caller can guarantee the output.  Currently
-               ;; the library only supports the default locale, so we can simply
-               ;; ignore '@'.  In future we'll add locale-sensitive stuff.
-               [(char=? ch2 #\@)
-                (call-formatter (read-char) #f (+ ind 2))]
-               [else (call-formatter ch2 #\0 (+ ind 1))]))]))
-
-        ;; body
-        (with-output-to-string
-          (cut rec (read-char) 0))))))
+;; Compiles FORMAT-STRING into a list of procedures, each of which
+;; takes a date and writes its part to the current output port.
+(define (tm:compile-format format-string)
+  (define len (string-length format-string))
+  (define (bad i)
+    (errorf "date->string: bad date format string: \"~a >>>~a<<< ~a\""
+            (string-take format-string i)
+            (substring format-string i (+ i 1))
+            (string-drop format-string (+ i 1))))
+  (define (flush-literal chars r)
+    (if (null? chars)
+      r
+      (let1 lit (list->string (reverse chars))
+        (cons (^_ (display lit)) r))))
+  (define (directive ch pad i r)
+    (cond [(assv ch tm:directive-templates)
+           => (^p (append (reverse (tm:compile-format (cdr p))) r))]
+          [(assv ch tm:directives)
+           => (^p (let1 fn (cdr p) (cons (^[date] (fn date pad)) r)))]
+          [else (bad i)]))
+  (let loop ([i 0] [chars '()] [r '()])
+    (cond
+     [(= i len) (reverse (flush-literal chars r))]
+     [(not (char=? (string-ref format-string i) #\~))
+      (loop (+ i 1) (cons (string-ref format-string i) chars) r)]
+     [(= (+ i 1) len) (loop len (cons #\~ chars) r)]
+     ;; Gauche extension: ~@x calls the directive 'x' with locale
+     ;; set to C, so the caller can guarantee the output.  Currently
+     ;; the library only supports the default locale, so we can simply
+     ;; ignore '@'.  In future we'll add locale-sensitive stuff.
+     [(char=? (string-ref format-string (+ i 1)) #\@)
+      (when (= (+ i 2) len) (bad (+ i 1)))
+      (loop (+ i 3) '()
+            (directive (string-ref format-string (+ i 2)) #f (+ i 2)
+                       (flush-literal chars r)))]
+     [else
+      (loop (+ i 2) '()
+            (directive (string-ref format-string (+ i 1)) #\0 (+ i 1)
+                       (flush-literal chars r)))])))
+
+(define (tm:iso8601-formatter zone? fallback)
+  (^[date]
+    (or (%date->iso8601 (date-year date) (date-month date) (date-day date)
+                        (date-hour date) (date-minute date) (date-second date)
+                        zone? (date-zone-offset date))
+        (fallback date))))
+
+(define (make-date-formatter format-string)
+  (let* ([emitters (tm:compile-format format-string)]
+         [generic (^[date]
+                    (with-output-to-string
+                      (^[] (dolist [e emitters] (e date)))))])
+    (cond [(member format-string '("~Y-~m-~dT~H:~M:~S~z" "~4"))
+           (tm:iso8601-formatter #t generic)]
+          [(member format-string '("~Y-~m-~dT~H:~M:~S" "~5"))
+           (tm:iso8601-formatter #f generic)]
+          [else generic])))
+
+;; date->string and string->date keep the procedure compiled for the
+;; last template, for the common case of calling them repeatedly with
+;; the same one.  The entry is a pair (template . procedure), replaced
+;; as a whole so that other threads never see a mismatched pair.
+(define tm:last-formatter '(#f . #f))
+(define tm:last-parser '(#f . #f))
+
+(define-syntax tm:cached-compile
+  (syntax-rules ()
+    [(_ var template compile)
+     (let1 e var
+       (if (equal? (car e) template)
+         (cdr e)
+         (rlet1 proc (compile template)
+           (set! var (cons (string-copy template) proc)))))]))
+
+(define (date->string date :optional (format-string "~c"))
+  ((tm:cached-compile tm:last-formatter format-string make-date-formatter)
+   date))
 
 (define (tm:char->int ch)
   (or (digit->integer ch)
@@ -1115,62 +1246,83 @@
          tm:zone-reader (^[val object] (slot-set! object 'zone-offset val)))
    )))
 
-(define (tm:string->date date index format-string str-len port template-string)
-  (define (bad)
+;; Compiles TEMPLATE-STRING into a list of procedures, each of which
+;; takes a date and an input port, reads its part and updates the date.
+(define (tm:compile-parser template-string)
+  (define len (string-length template-string))
+  (define (bad i)
     (errorf "string->date: bad date format string: \"~a >>>~a<<< ~a\""
-            (string-take template-string index)
-            (substring template-string index (+ index 1))
-            (string-drop template-string (+ index 1))))
-  (define (skip-until port skipper)
+            (string-take template-string i)
+            (substring template-string i (+ i 1))
+            (string-drop template-string (+ i 1))))
+  (define (skip-until port skipper i)
     (let1 ch (peek-char port)
-      (when (eof-object? port) (bad))
-      (unless (skipper ch)
-        (read-char port) (skip-until port skipper))))
-  (if (>= index str-len)
-    (values)
-    (let1 current-char (string-ref format-string index)
-      (if (not (char=? current-char #\~))
-        (let1 port-char (read-char port)
-          (when (or (eof-object? port-char)
-                  (not (char=? current-char port-char)))
-            (bad))
-          (tm:string->date date (+ index 1) format-string str-len port template-string))
-        ;; otherwise, it's an escape, we hope
-        (if (> (+ index 1) str-len)
-          (bad)
-          (let* ([format-char (string-ref format-string (+ index 1))]
-                 [format-info (assoc format-char tm:read-directives)])
-            (when (not format-info) (bad))
-            (let ([skipper (cadr format-info)]
-                  [reader  (caddr format-info)]
-                  [actor   (cadddr format-info)])
-              (skip-until port skipper)
-              (let1 val (reader port)
-                (when (eof-object? val) (bad))
-                (actor val date))
-              (tm:string->date date (+ index 2) format-string  str-len port template-string))))))))
+      (cond [(eof-object? ch) (bad i)]
+            [(skipper ch)]
+            [else (read-char port) (skip-until port skipper i)])))
+  (let loop ([i 0] [r '()])
+    (cond
+     [(= i len) (reverse r)]
+     [(not (char=? (string-ref template-string i) #\~))
+      (let1 ch (string-ref template-string i)
+        (loop (+ i 1)
+              (cons (^[date port]
+                      (unless (eqv? (read-char port) ch) (bad i)))
+                    r)))]
+     [(= (+ i 1) len) (bad i)]
+     [(assv (string-ref template-string (+ i 1)) tm:read-directives)
+      => (^[info]
+           (let ([skipper (cadr info)]
+                 [reader  (caddr info)]
+                 [actor   (cadddr info)])
+             (loop (+ i 2)
+                   (cons (^[date port]
+                           (skip-until port skipper i)
+                           (let1 val (reader port)
+                             (when (eof-object? val) (bad i))
+                             (actor val date)))
+                         r))))]
+     [else (bad i)])))
+
+(define (tm:date-ok? date)
+  (and (date-nanosecond date)
+       (date-second date)
+       (date-minute date)
+       (date-hour date)
+       (date-day date)
+       (date-month date)
+       (date-year date)
+       (date-zone-offset date)))
+
+(define (tm:iso8601-parser zone? fallback)
+  (^[input]
+    (receive (year month day hour minute second offset)
+        (%iso8601->date-fields input zone?)
+      (if year
+        (make-date 0 second minute hour day month year
+                   (if zone? offset (tm:local-tz-offset)))
+        (fallback input)))))
+
+(define (make-date-parser template-string)
+  (let* ([steps (tm:compile-parser template-string)]
+         [generic
+          (^[input]
+            (let ([date (make-date 0 0 0 0 #f #f #f (tm:local-tz-offset))]
+                  [port (open-input-string input)])
+              (dolist [step steps] (step date port))
+              (if (tm:date-ok? date)
+                date
+                (errorf "string->date: incomplete date read: ~s for ~s"
+                        date template-string))))])
+    (cond [(equal? template-string "~Y-~m-~dT~H:~M:~S~z")
+           (tm:iso8601-parser #t generic)]
+          [(equal? template-string "~Y-~m-~dT~H:~M:~S")
+           (tm:iso8601-parser #f generic)]
+          [else generic])))
 
 (define (string->date input-string template-string)
-  (define (tm:date-ok? date)
-    (and (date-nanosecond date)
-         (date-second date)
-         (date-minute date)
-         (date-hour date)
-         (date-day date)
-         (date-month date)
-         (date-year date)
-         (date-zone-offset date)))
-  (let1 newdate (make-date 0 0 0 0 #f #f #f (tm:local-tz-offset))
-    (tm:string->date newdate
-                     0
-                     template-string
-                     (string-length template-string)
-                     (open-input-string input-string)
-                     template-string)
-    (if (tm:date-ok? newdate)
-      newdate
-      (errorf "string->date: incomplete date read: ~s for ~s"
-              newdate template-string))))
+  ((tm:cached-compile tm:last-parser template-string make-date-parser)
+   input-string))
 
 ;; A table of leap seconds
 ;; See ftp://maia.usno.navy.mil/ser7/tai-utc.dat
@@ -276,6 +276,13 @@
        (string-trim-both "  \t  a b c d  \r\n" #[\r\n]))
 (test* "string-trim-both"  "a b c d"
        (string-trim-both "349853a b c d03490" #[\d]))
+(test* "string-trim (multibyte)" '("\u3042 b\u3044  " "  \u3042 b\u3044" "\u3042 b\u3044" "")
+       (list (string-trim "  \u3042 b\u3044  ")
+             (string-trim-right "  \u3042 b\u3044  ")
+             (string-trim-both "\u3046 \u3042 b\u3044\u3046 " #[\s\u3046])
+             (string-trim-both "  \u3046" #[\s\u3046])))
+(test* "string-trim (pred)" "a b "
+       (string-trim "12a b " char-numeric?))
 
 ;; string-fill - in string.scm
 
@@ -325,6 +332,11 @@
 (test* "string-prefix-ci?" #f (string-prefix-ci? "abcf" "aBCDEfg"))
 (test* "string-suffix?" #t    (string-suffix? "defg" "abcdefg"))
 (test* "string-suffix?" #f    (string-suffix? "aefg" "abcdefg"))
+(test* "string-suffix? (multibyte)" '(#t #f #t #f)
+       (list (string-suffix? "\u3044c" "\u3042\u3044c")
+             (string-suffix? "\u3042c" "\u3042\u3044c")
+             (string-prefix? "\u3042\u3044" "\u3042\u3044c")
+             (string-prefix? "\u3042\u3046" "\u3042\u3044c")))
 (test* "string-suffix-ci?" #t (string-suffix-ci? "defg" "aBCDEfg"))
 (test* "string-suffix-ci?" #f (string-suffix-ci? "aefg" "aBCDEfg"))
 
@@ -344,6 +356,19 @@
        (string-index-right "abcd:efgh;ijkl" #[\d]))
 (test* "string-index-right" 4
        (string-index-right "abcd:efgh;ijkl" #[\W] 2 5))
+(test* "string-index (pred)" 2
+       (string-index "ab3d" char-numeric?))
+(test* "string-index (multibyte)" '(3 4 1 4)
+       (let1 s "\u3042b\u3044:c\u3046:"
+         (list (string-index s #\:)
+               (string-index-right s #[:c] 0 5)
+               (string-skip s #[\u3042\u3044])
+               (string-skip-right s #[\u3046:]))))
+(test* "string-skip" '(3 #f 2 #f)
+       (list (string-skip "   a b" #\space)
+             (string-skip "    " #[\s])
+             (string-skip-right "a b   " #\space)
+             (string-skip-right "" #\space)))
 
 (test* "string-count" 2
        (string-count "abc def\tghi jkl" #\space))
@@ -365,6 +390,8 @@
        (string-contains "eek -- what a geek." "ee" 12 18))
 (test* "string-contains-ci" 15
        (string-contains-ci "Eek -- what a geek." "EE" 12 18))
+(test* "string-contains-ci (multibyte)" 2
+       (string-contains-ci "\u3042\u3044AbC" "aBc"))
 
 (test* "string-titlecase" "--Capitalize This Sentence."
        (string-titlecase "--capitalize tHIS sentence."))
@@ -599,6 +626,13 @@
 (test* "string-tokenize" '("elp" "make" "programs" "run" "run")
        (string-tokenize "Help make programs run, run, RUN!"
                         #[a-z]))
+(test* "string-tokenize" '() (string-tokenize ""))
+(test* "string-tokenize" '() (string-tokenize "   "))
+(test* "string-tokenize" '("a" "bc") (string-tokenize "  a bc"))
+(test* "string-tokenize" '("ab" "c") (string-tokenize "ab c  " #[\S] 0 6))
+(test* "string-tokenize" '("b" "c") (string-tokenize "ab c  " #[\S] 1))
+(test* "string-tokenize" '("\u3042\u3044" "\u3046")
+       (string-tokenize "\u3042\u3044 \u3046 "))
 
 (test* "string-filter" "rrrr"
        (string-filter #\r "Help make programs run, run, RUN!"))
@@ -803,6 +837,56 @@
          (map (cut slot-ref d <>)
               '(year month day hour minute second zone-offset))))
 
+(test* "date->string (compound directives)"
+       "05/15/02 01:23:34 AM|Wed May 15 01:23:34-1000 2002"
+       (date->string (make-date 0 34 23 1 15 5 2002 -36000) "~D ~r|~c"))
+
+(test* "date->string (bad format)" (test-error)
+       (date->string (make-date 0 34 23 1 15 5 2002 -36000) "~Y ~Q"))
+
+(let ([iso (make-date-formatter "~Y-~m-~dT~H:~M:~S~z")]
+      [iso5 (make-date-formatter "~5")]
+      [other (make-date-formatter "[~H~~~M]")])
+  (test* "make-date-formatter (iso-8601)"
+         '("2002-05-15T01:23:04-1000" "2002-05-15T01:23:04Z"
+           "987-01-02T03:04:05+0530" "2002-05-15T01:23:04")
+         (list (iso (make-date 0 4 23 1 15 5 2002 -36000))
+               (iso (make-date 0 4 23 1 15 5 2002 0))
+               (iso (make-date 0 5 4 3 2 1 987 19800))
+               (iso5 (make-date 0 4 23 1 15 5 2002 -36000))))
+  (test* "make-date-formatter (iso-8601, bignum year)"
+         "100000000000000000000-05-15T01:23:04-1000"
+         (iso (make-date 0 4 23 1 15 5 (expt 10 20) -36000)))
+  (test* "make-date-formatter" "[01~23]"
+         (other (make-date 0 4 23 1 15 5 2002 -36000))))
+
+(let ([iso (make-date-parser "~Y-~m-~dT~H:~M:~S~z")]
+      [fields (^d (map (cut slot-ref d <>)
+                       '(year month day hour minute second zone-offset)))])
+  (test* "make-date-parser (iso-8601)"
+         '((2002 5 15 12 34 56 -36000) (2002 5 15 12 34 56 0)
+           (2002 5 15 12 34 56 19800))
+         (map (^s (fields (iso s)))
+              '("2002-05-15T12:34:56-1000" "2002-05-15T12:34:56Z"
+                "2002-05-15T12:34:56+0530xyz")))
+  (test* "make-date-parser (iso-8601, loose)"
+         '(2002 5 1 2 3 4 32400)
+         (fields (iso "2002-5-1T2:3:4+0900")))
+  (test* "make-date-parser (iso-8601, bad)" (test-error)
+         (iso "2002-05-15T12:34:56+09:00"))
+  (test* "make-date-parser (bad template)" (test-error)
+         (make-date-parser "~Y ~Q"))
+  (test* "make-date-parser"
+         '(2002 11 2 7 14 11 32400)
+         (fields ((make-date-parser "~d~b~Y~H~M~S~z")
+                  "02/Nov/2002:07:14:11 +0900"))))
+
+(test* "date->string and string->date roundtrip"
+       "2002-05-15T12:34:56+0900"
+       (date->string (string->date "2002-05-15T12:34:56+0900"
+                                   "~Y-~m-~dT~H:~M:~S~z")
+                     "~4"))
+
 ;;
 ;; testing srfi-43
 ;;
@@ -0,0 +1,253 @@
+/*
+ * ssax-lex.c - lexer primitives for sxml.ssax
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "gauche/priv/portP.h"
+#include "ssax-lex.h"
+
+/*
+ * These replace the hot spots of SSAX, which are written with
+ * per-character peek-char/read-char in text.parse style.  They scan the
+ * port buffer directly while it holds ASCII bytes, and fall back to
+ * Getc/Ungetc otherwise, so the results are the same as the original.
+ */
+
+/*================================================================
+ * Port buffer access (same as ext/rfc/json.c)
+ */
+
+static inline int fast_range(ScmPort *port, const char **cur, const char **end)
+{
+    if (port->closed || port->scrcnt > 0
+        || port->ungotten != SCM_CHAR_INVALID) return FALSE;
+    switch (SCM_PORT_TYPE(port)) {
+    case SCM_PORT_FILE:
+        *cur = port->src.buf.current;
+        *end = port->src.buf.end;
+        return (*cur < *end);
+    case SCM_PORT_ISTR:
+        *cur = port->src.istr.current;
+        *end = port->src.istr.end;
+        return (*cur < *end);
+    default:
+        return FALSE;
+    }
+}
+
+/* Consumes bytes up to NEWCUR, which contain LINES newlines. */
+static inline void fast_advance(ScmPort *port, const char *newcur, u_long lines)
+{
+    if (SCM_PORT_TYPE(port) == SCM_PORT_FILE) {
+        port->bytes += newcur - port->src.buf.current;
+        port->src.buf.current = (char*)newcur;
+    } else {
+        port->bytes += newcur - port->src.istr.current;
+        port->src.istr.current = newcur;
+    }
+    port->line += lines;
+}
+
+/* Evaluates EXPR with PORT locked. */
+#define WITH_PORT_LOCKED(port, expr)                            \
+    do {                                                        \
+        ScmVM *vm_ = Scm_VM();                                  \
+        if (PORT_LOCKED(port, vm_)) {                           \
+            expr;                                               \
+        } else {                                                \
+            PORT_LOCK(port, vm_);                               \
+            PORT_SAFE_CALL(port, expr, /*no cleanup*/);         \
+            PORT_UNLOCK(port);                                  \
+        }                                                       \
+    } while (0)
+
+/*================================================================
+ * ssax:skip-S
+ *
+ *   Skips XML whitespaces (#x20 #x9 #xA #xD), and returns the next
+ *   character without consuming it, or EOF.
+ */
+
+#define XML_S_P(c) ((c) == ' ' || (c) == '\n' || (c) == '\t' || (c) == '\r')
+
+static ScmObj skip_S(ScmPort *port)
+{
+    const char *cur, *end;
+    if (fast_range(port, &cur, &end)) {
+        const char *q = cur;
+        u_long lines = 0;
+        while (q < end && XML_S_P(*q)) {
+            if (*q == '\n') lines++;
+            q++;
+        }
+        fast_advance(port, q, lines);
+        if (q < end && (unsigned char)*q < 0x80) return SCM_MAKE_CHAR(*q);
+    }
+    for (;;) {
+        int c = Scm_GetcUnsafe(port);
+        if (c == EOF) return SCM_EOF;
+        if (!XML_S_P(c)) {
+            Scm_UngetcUnsafe(c, port);
+            return SCM_MAKE_CHAR(c);
+        }
+    }
+}
+
+ScmObj Scm_SSAXSkipS(ScmPort *port)
+{
+    volatile ScmObj r = SCM_UNDEFINED;
+    WITH_PORT_LOCKED(port, r = skip_S(port));
+    return r;
+}
+
+/*================================================================
+ * ssax:read-NCName
+ *
+ *   NCName ::= (Letter | '_') (Letter | Digit | '.' | '-' | '_')*
+ *   where Letter is char-alphabetic?, as in SSAX.
+ *   Returns a symbol, or #f if the next character can't start NCName
+ *   (nothing is consumed then).
+ */
+
+static inline int ascii_ncname_char_p(int b, int first)
+{
+    if ((b >= 'a' && b <= 'z') || (b >= 'A' && b <= 'Z') || b == '_')
+        return TRUE;
+    if (first) return FALSE;
+    return (b >= '0' && b <= '9') || b == '.' || b == '-';
+}
+
+static inline int ncname_char_p(ScmChar c, int first)
+{
+    if (SCM_CHAR_ASCII_P(c)) return ascii_ncname_char_p(c, first);
+    return Scm_CharAlphabeticP(c);
+}
+
+static ScmObj read_NCName(ScmPort *port)
+{
+    ScmDString ds;
+    int first = TRUE;
+    Scm_DStringInit(&ds);
+
+    for (;;) {
+        const char *cur, *end;
+        if (fast_range(port, &cur, &end)) {
+            const char *q = cur;
+            while (q < end && ascii_ncname_char_p((unsigned char)*q, first)) {
+                q++;
+                first = FALSE;
+            }
+            if (q > cur) {
+                Scm_DStringPutz(&ds, cur, (int)(q - cur));
+                fast_advance(port, q, 0);
+            }
+            /* If we stopped at an ASCII char, that's the end. */
+            if (q < end && (unsigned char)*q < 0x80) break;
+        }
+        int c = Scm_GetcUnsafe(port);
+        if (c == EOF) break;
+        if (!ncname_char_p(c, first)) {
+            Scm_UngetcUnsafe(c, port);
+            break;
+        }
+        Scm_DStringPutc(&ds, c);
+        first = FALSE;
+    }
+    if (first) return SCM_FALSE;
+    return Scm_Intern(SCM_STRING(Scm_DStringGet(&ds, 0)));
+}
+
+ScmObj Scm_SSAXReadNCName(ScmPort *port)
+{
+    volatile ScmObj r = SCM_UNDEFINED;
+    WITH_PORT_LOCKED(port, r = read_NCName(port));
+    return r;
+}
+
+/*================================================================
+ * Character data
+ *
+ *   Reads characters up to one of #\< #\& #\return, which is left
+ *   unconsumed, and returns them as a string.  If EOF is reached,
+ *   returns the string read so far if EXPECT_EOF, or #f otherwise.
+ *   This is (next-token '() terminators ...) in ssax:read-char-data.
+ */
+
+static inline int char_data_term_p(ScmChar c)
+{
+    return c == '<' || c == '&' || c == '\r';
+}
+
+static ScmObj read_char_data(ScmPort *port, int expect_eof)
+{
+    ScmDString ds;
+    Scm_DStringInit(&ds);
+
+    for (;;) {
+        const char *cur, *end;
+        if (fast_range(port, &cur, &end)) {
+            const char *q = cur;
+            u_long lines = 0;
+            while (q < end) {
+                unsigned char b = (unsigned char)*q;
+                if (b >= 0x80 || char_data_term_p(b)) break;
+                if (b == '\n') lines++;
+                q++;
+            }
+            if (q > cur) {
+                Scm_DStringPutz(&ds, cur, (int)(q - cur));
+                fast_advance(port, q, lines);
+            }
+            if (q < end && char_data_term_p((unsigned char)*q)) break;
+        }
+        int c = Scm_GetcUnsafe(port);
+        if (c == EOF) {
+            if (!expect_eof) return SCM_FALSE;
+            break;
+        }
+        if (char_data_term_p(c)) {
+            Scm_UngetcUnsafe(c, port);
+            break;
+        }
+        Scm_DStringPutc(&ds, c);
+    }
+    return Scm_DStringGet(&ds, 0);
+}
+
+ScmObj Scm_SSAXReadCharData(ScmPort *port, int expect_eof)
+{
+    volatile ScmObj r = SCM_UNDEFINED;
+    WITH_PORT_LOCKED(port, r = read_char_data(port, expect_eof));
+    return r;
+}
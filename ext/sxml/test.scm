@@ -5,6 +5,81 @@
 ;; ssax test is derived from the original SSAX source.
 (include "./ssax-test.scm")
 
+(use gauche.test)
+(use gauche.generator)
+
+(test-start "SSAX native lexer and pull parser")
+(use sxml.ssax)
+
+(test* "skip-S" '(#\a "a")
+       (call-with-input-string " \t\r\n  a"
+         (^p (list (ssax:skip-S p) (string (read-char p))))))
+(test* "skip-S eof" #t
+       (eof-object? (call-with-input-string "  \n" ssax:skip-S)))
+(test* "read-NCName" '(abc-1.x ":b")
+       (call-with-input-string "abc-1.x:b"
+         (^p (let* ([n (ssax:read-NCName p)]
+                    [rest (read-string 10 p)])
+               (list n rest)))))
+(test* "read-NCName error" (test-error)
+       (call-with-input-string "1abc" ssax:read-NCName))
+(let ()
+  (define (collect s1 s2 seed)
+    (if (string-null? s2) (cons s1 seed) (list* s2 s1 seed)))
+  (define (t str)
+    (call-with-input-string str
+      (^p (receive (seed token) (ssax:read-char-data p #t collect '())
+            (list (reverse seed)
+                  (if (eof-object? token) token (xml-token-kind token)))))))
+  (test* "read-char-data" '(("abc" "\n" "def" "\n" "gh") ENTITY-REF)
+         (t "abc\r\ndef\r\ngh&amp;"))
+  (test* "read-char-data" `((,(make-string 10000 #\a) "\n" "b") START)
+         (t (string-append (make-string 10000 #\a) "\rb<x/>")))
+  (test* "read-char-data eof" `(("a") ,(eof-object)) (t "a"))
+  (test* "read-char-data unexpected eof" (test-error)
+         (call-with-input-string "a"
+           (cut ssax:read-char-data <> #f collect '())))
+  (cond-expand
+   [gauche.ces.utf8
+    (test* "read-NCName non-ascii" '(|\x3042;\x3044;_1| ":b")
+           (call-with-input-string "\u3042\u3044_1:b"
+             (^p (let1 n (ssax:read-NCName p)
+                   (list n (read-string 10 p))))))
+    (test* "read-char-data non-ascii" '(("\u3042b") END)
+           (t "\u3042b</x>"))]
+   [else]))
+
+(let ()
+  (define xml
+    "<?xml version='1.0'?>
+<feed><title>t</title>
+  <entry id='1'><name>a</name><entry id='x'/></entry>
+  <!-- comment -->
+  <other><entry id='2'>b</entry></other>
+  <entry id='3'>c &amp; d</entry>
+</feed>")
+  (define (t path)
+    (generator->list
+     (call-with-input-string xml (cut ssax:make-element-generator path <>))))
+  (test* "element generator" '((entry (@ (id "1")) (name "a") (entry (@ (id "x"))))
+                               (entry (@ (id "3")) "c & d"))
+         (t '(feed entry)))
+  (test* "element generator (*)" '((entry (@ (id "x"))) (entry (@ (id "2")) "b"))
+         (t '(feed * entry)))
+  (test* "element generator (//)" '((entry (@ (id "1")) (name "a") (entry (@ (id "x"))))
+                                    (entry (@ (id "2")) "b")
+                                    (entry (@ (id "3")) "c & d"))
+         (t '(// entry)))
+  (test* "element generator (title)" '((title "t")) (t '(feed title)))
+  (test* "element generator (none)" '() (t '(nothing)))
+  (test* "element generator (namespace)" '((x:b "1") (x:b "2"))
+         (generator->list
+          (call-with-input-string
+              "<a xmlns:y='urn:x'><y:b>1</y:b><y:b>2</y:b></a>"
+            (cut ssax:make-element-generator '(a x:b) <> '((x . "urn:x")))))))
+
+(test-end)
+
 ;(load "./tree-trans-test.scm")
 ;(load "./to-html-test.scm")
 
@@ -23,6 +98,46 @@
   (test* "ns-trans" '((rss:title "foo"))
          ((sxpath "//my:title" ns-alist) sxml)))
 
+;; compiled queries must agree with sxpath
+(let ((doc '(*TOP*
+             (doc (@ (lang "en"))
+                  (title "T")
+                  (sec (@ (id "a")) (title "A") (para "a1") (para "a2")
+                       (sec (@ (id "b")) (title "B") (para "b1")))
+                  (sec (@ (id "c")) (para "c1") (para "c2") (para "c3"))
+                  (appendix (para "x1"))))))
+  (for-each
+   (lambda (path)
+     (test* (format "compile-sxpath ~s" path)
+            ((sxpath path) doc)
+            ((compile-sxpath path) doc)))
+   `((doc sec)
+     (doc sec para)
+     (doc sec (para 2))
+     (doc (sec 2) (para 1))
+     (doc (sec (title)) para)
+     (doc (sec (@ id)) (para 1))
+     (doc (sec (equal? (title "B"))))
+     (doc (or@ sec appendix) para)
+     (doc (not@ sec) *text*)
+     (doc sec *)
+     (doc ((sec para) 2))
+     (doc (sec (title) 1) para)
+     (doc (sec -1) para)
+     (// para)
+     (doc // title)
+     (doc // (para 1))
+     (doc sec // para *text*)
+     (,(lambda (nodes root vars) ((sxpath '(// sec)) nodes)) (title))
+     "doc/sec[2]/para"
+     ()))
+  (test* "compile-sxpath with root" ((sxpath '(doc sec title)) doc doc)
+         ((compile-sxpath '(doc sec title)) doc doc))
+  (test* "compile-if-car-sxpath" '(para "a2")
+         ((compile-if-car-sxpath '(// sec (para 2))) doc))
+  (test* "compile-if-car-sxpath" #f
+         ((compile-if-car-sxpath '(doc (sec 5))) doc)))
+
 (test-end)
 
 ;; sxml.serializer test
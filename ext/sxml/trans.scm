@@ -11,6 +11,7 @@
 ;;  - Run-test macro definition and uses are eliminated.
 ;;  - Some macro and function definitions are replaced for
 ;;    the ones that uses Gauche's native method for efficiency.
+;;  - Some subexpressions are replaced as well (*subst-table*).
 
 (define *trans-table*
   '(;; remove run-test stuff
@@ -40,6 +41,18 @@
     ;; We have Gauche-specific versions for them
     ((define-macro (sxml:find-name-separator ...) ...))
     ((define (sxml:error ...) ...))
+    ;; Native lexer primitives (see sxml-ssax.scm.in)
+    ((define (ssax:skip-S ...) ...))
+    ((define (ssax:read-NCName ...) ...))
+    ))
+
+;; Subexpressions replaced wherever they appear.  Each entry is
+;; (<original> . <replacement>), compared with equal?.
+(define *subst-table*
+  '(;; in ssax:read-char-data
+    ((next-token '() char-data-terminators "reading char data" port)
+     . (or (%ssax-read-char-data port expect-eof?)
+           (errorf "~a~a" (port-position-prefix port) "reading char data")))
     ))
 
 (define (prelude file)
@@ -64,6 +77,11 @@
           [(match? (caar rules) sexp) (cdar rules)]
           [else (loop (cdr rules))])))
 
+(define (subst sexp)
+  (cond [(assoc sexp *subst-table*) => cdr]
+        [(pair? sexp) (cons (subst (car sexp)) (subst (cdr sexp)))]
+        [else sexp]))
+
 (define (include-translating file process)
   (with-input-from-file file
     (^[]
@@ -73,7 +91,7 @@
 (define (process-body file)
   (include-translating file
                        (^[sexp]
-                         (for-each write (replace *trans-table* sexp))
+                         (for-each (^x (write (subst x))) (replace *trans-table* sexp))
                          (newline))))
 
 (define (process-test file)
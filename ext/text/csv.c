@@ -0,0 +1,294 @@
+/*
+ * csv.c - native CSV tokenizer for text.csv
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ctype.h>
+#include <string.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "gauche/priv/portP.h"
+#include "csv.h"
+
+#define CSV_WHITESPACE_P(c) \
+    ((SCM_CHAR_ASCII_P(c) && isspace(c)) || SCM_CHAR_EXTRA_WHITESPACE(c))
+
+/*================================================================
+ * Port buffer access
+ *
+ *   As in json.c, the runs of plain ASCII bytes are taken directly
+ *   from the port buffer when it is available, and everything else
+ *   goes through Getc.
+ */
+
+static inline int fast_range(ScmPort *port, const char **cur, const char **end)
+{
+    if (port->closed || port->scrcnt > 0
+        || port->ungotten != SCM_CHAR_INVALID) return FALSE;
+    switch (SCM_PORT_TYPE(port)) {
+    case SCM_PORT_FILE:
+        *cur = port->src.buf.current;
+        *end = port->src.buf.end;
+        return (*cur < *end);
+    case SCM_PORT_ISTR:
+        *cur = port->src.istr.current;
+        *end = port->src.istr.end;
+        return (*cur < *end);
+    default:
+        return FALSE;
+    }
+}
+
+/* Consumes bytes up to NEWCUR, which contain LINES newlines. */
+static inline void fast_advance(ScmPort *port, const char *newcur, u_long lines)
+{
+    if (SCM_PORT_TYPE(port) == SCM_PORT_FILE) {
+        port->bytes += newcur - port->src.buf.current;
+        port->src.buf.current = (char*)newcur;
+    } else {
+        port->bytes += newcur - port->src.istr.current;
+        port->src.istr.current = newcur;
+    }
+    port->line += lines;
+}
+
+/*================================================================
+ * Record reader
+ *
+ *   The syntax is the same as the original Scheme version:
+ *   Leading whitespaces of a field are skipped, and trailing whitespaces
+ *   of an unquoted field are trimmed.  A quoted field may contain
+ *   separators and newlines; two quote characters in it stand for one.
+ *   Characters between the closing quote and the next separator are
+ *   ignored.
+ */
+
+typedef struct csv_reader_rec {
+    ScmPort *port;
+    ScmChar sep;
+    ScmChar quo;
+    int sepb;                   /* sep if it's ASCII, -1 otherwise */
+    int quob;                   /* quo if it's ASCII, -1 otherwise */
+} csv_reader;
+
+#define CGETC(r)   Scm_GetcUnsafe((r)->port)
+#define EOR_P(c)   ((c) == '\n' || (c) == EOF)
+
+static ScmObj dstring_head(ScmDString *ds, int size)
+{
+    int s, l;
+    const char *p = Scm_DStringPeek(ds, &s, &l);
+    return Scm_MakeString(p, size, -1, SCM_STRING_COPYING);
+}
+
+/* C is the first character of an unquoted field, already consumed.
+   Returns the field, and sets the terminating character to *TERM. */
+static ScmObj read_unquoted(csv_reader *r, ScmChar c, ScmChar *term)
+{
+    ScmDString ds;
+    Scm_DStringInit(&ds);
+    Scm_DStringPutc(&ds, c);
+    int last = Scm_DStringSize(&ds);   /* size up to the last non-ws char */
+
+    for (;;) {
+        const char *cur, *end;
+        if (fast_range(r->port, &cur, &end)) {
+            const char *q = cur;
+            while (q < end) {
+                unsigned char b = (unsigned char)*q;
+                if (b >= 0x80 || b == '\n' || b == r->sepb) break;
+                q++;
+            }
+            if (q > cur) {
+                const char *nw = q;
+                while (nw > cur && isspace((unsigned char)nw[-1])) nw--;
+                Scm_DStringPutz(&ds, cur, (int)(q - cur));
+                if (nw > cur) last = Scm_DStringSize(&ds) - (int)(q - nw);
+                fast_advance(r->port, q, 0);
+            }
+        }
+        c = CGETC(r);
+        if (EOR_P(c) || c == r->sep) break;
+        Scm_DStringPutc(&ds, c);
+        if (!CSV_WHITESPACE_P(c)) last = Scm_DStringSize(&ds);
+    }
+    *term = c;
+    return dstring_head(&ds, last);
+}
+
+/* Reads a quoted field after the opening quote.  Returns the field,
+   and sets the character after the closing quote to *NEXT. */
+static ScmObj read_quoted(csv_reader *r, ScmChar *next)
+{
+    ScmDString ds;
+    Scm_DStringInit(&ds);
+
+    for (;;) {
+        const char *cur, *end;
+        if (fast_range(r->port, &cur, &end)) {
+            const char *q = cur;
+            u_long lines = 0;
+            while (q < end) {
+                unsigned char b = (unsigned char)*q;
+                if (b >= 0x80 || b == r->quob) break;
+                if (b == '\n') lines++;
+                q++;
+            }
+            if (q > cur) {
+                Scm_DStringPutz(&ds, cur, (int)(q - cur));
+                fast_advance(r->port, q, lines);
+            }
+        }
+        ScmChar c = CGETC(r);
+        if (c == EOF) Scm_Error("unterminated quoted field");
+        if (c == r->quo) {
+            c = CGETC(r);
+            if (c != r->quo) {
+                *next = c;
+                break;
+            }
+        }
+        Scm_DStringPutc(&ds, c);
+    }
+    return Scm_DStringGet(&ds, 0);
+}
+
+static ScmObj read_record(csv_reader *r)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    ScmChar c = CGETC(r);
+
+    if (c == EOF) return SCM_EOF;
+    for (;;) {
+        /* C is the first character of a field */
+        if (EOR_P(c)) {
+            SCM_APPEND1(h, t, SCM_MAKE_STR(""));
+            return h;
+        } else if (c == r->sep) {
+            SCM_APPEND1(h, t, SCM_MAKE_STR(""));
+            c = CGETC(r);
+        } else if (c == r->quo) {
+            SCM_APPEND1(h, t, read_quoted(r, &c));
+            while (!EOR_P(c) && c != r->sep) c = CGETC(r);
+            if (EOR_P(c)) return h;
+            c = CGETC(r);
+        } else if (CSV_WHITESPACE_P(c)) {
+            c = CGETC(r);
+        } else {
+            SCM_APPEND1(h, t, read_unquoted(r, c, &c));
+            if (EOR_P(c)) return h;
+            c = CGETC(r);
+        }
+    }
+}
+
+static void init_reader(csv_reader *r, ScmChar sep, ScmChar quo)
+{
+    r->sep = sep;
+    r->quo = quo;
+    r->sepb = SCM_CHAR_ASCII_P(sep) ? (int)sep : -1;
+    r->quob = SCM_CHAR_ASCII_P(quo) ? (int)quo : -1;
+}
+
+ScmObj Scm_CSVReadRecord(ScmPort *port, ScmChar sep, ScmChar quo)
+{
+    ScmVM *vm = Scm_VM();
+    volatile ScmObj r = SCM_UNDEFINED;
+    csv_reader rd;
+
+    if (!SCM_IPORTP(port)) Scm_Error("input port required, but got %S", port);
+    rd.port = port;
+    init_reader(&rd, sep, quo);
+
+    if (PORT_LOCKED(port, vm)) {
+        r = read_record(&rd);
+    } else {
+        PORT_LOCK(port, vm);
+        PORT_SAFE_CALL(port, r = read_record(&rd), /*no cleanup*/);
+        PORT_UNLOCK(port);
+    }
+    return r;
+}
+
+/*================================================================
+ * Record boundary
+ *
+ *   Scans BUF, which begins at a record boundary, with the same syntax
+ *   as read_record but without constructing fields, and returns the
+ *   offset just after the last complete record, or -1 if BUF doesn't
+ *   contain a complete record.  This is used to split the input into
+ *   chunks that can be parsed independently.
+ */
+
+enum {
+    CSV_START,                  /* beginning of a field */
+    CSV_UNQUOTED,               /* in an unquoted field */
+    CSV_QUOTED,                 /* in a quoted field */
+    CSV_QUOTE_SEEN,             /* quote char in a quoted field */
+    CSV_TAIL                    /* after a quoted field */
+};
+
+int Scm_CSVRecordBoundary(const char *buf, int size, ScmChar sep, ScmChar quo)
+{
+    const char *p = buf, *end = buf + size;
+    int state = CSV_START, last = -1;
+
+    while (p < end) {
+        ScmChar c;
+        int n = SCM_CHAR_NFOLLOWS(*p);
+        if (p + n >= end) break;
+        SCM_CHAR_GET(p, c);
+        p += n + 1;
+
+        switch (state) {
+        case CSV_QUOTED:
+            if (c == quo) state = CSV_QUOTE_SEEN;
+            continue;
+        case CSV_QUOTE_SEEN:
+            if (c == quo) { state = CSV_QUOTED; continue; }
+            break;
+        default:
+            break;
+        }
+        if (c == '\n') {
+            last = (int)(p - buf);
+            state = CSV_START;
+        } else if (c == sep) {
+            state = CSV_START;
+        } else if (state == CSV_START) {
+            if (c == quo) state = CSV_QUOTED;
+            else if (!CSV_WHITESPACE_P(c)) state = CSV_UNQUOTED;
+        } else if (state == CSV_QUOTE_SEEN) {
+            state = CSV_TAIL;
+        }
+    }
+    return last;
+}
@@ -0,0 +1,105 @@
+/*
+ * html.c - HTML escaping for text.html-lite
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The characters to escape are all below 0x40, so they never appear as
+ * a part of a multibyte character in the supported encodings, and we
+ * can just scan bytes.
+ */
+
+#include <string.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "html.h"
+
+/* The entity for the byte C, or NULL. */
+static inline const char *entity(u_char c)
+{
+    switch (c) {
+    case '<': return "&lt;";
+    case '>': return "&gt;";
+    case '&': return "&amp;";
+    case '"': return "&quot;";
+    default:  return NULL;
+    }
+}
+
+/* Returns the pointer to the first byte to escape in [P, END), or END. */
+static inline const char *scan_plain(const char *p, const char *end)
+{
+    for (; p < end; p++) {
+        if (entity((u_char)*p)) break;
+    }
+    return p;
+}
+
+ScmObj Scm_HtmlEscapeString(ScmString *s)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(s);
+    const char *p = SCM_STRING_BODY_START(b);
+    const char *end = p + SCM_STRING_BODY_SIZE(b);
+    const char *q = scan_plain(p, end);
+    if (q == end) return SCM_OBJ(s);
+
+    ScmDString ds;
+    Scm_DStringInit(&ds);
+    for (;;) {
+        Scm_DStringPutz(&ds, p, q - p);
+        if (q == end) break;
+        Scm_DStringPutz(&ds, entity((u_char)*q), -1);
+        p = q + 1;
+        q = scan_plain(p, end);
+    }
+    return Scm_DStringGet(&ds, SCM_STRING_BODY_INCOMPLETE_P(b)
+                          ? SCM_STRING_INCOMPLETE : 0);
+}
+
+#define CHUNK_SIZE 4096
+
+void Scm_HtmlEscapePort(ScmPort *in, ScmPort *out)
+{
+    char buf[CHUNK_SIZE];
+
+    for (;;) {
+        int r = Scm_Getz(buf, CHUNK_SIZE, in);
+        if (r <= 0) break;
+        const char *p = buf, *end = buf + r, *q;
+        while ((q = scan_plain(p, end)) < end) {
+            if (q > p) Scm_Putz(p, (int)(q - p), out);
+            const char *e = entity((u_char)*q);
+            Scm_Putz(e, (int)strlen(e), out);
+            p = q + 1;
+        }
+        if (end > p) Scm_Putz(p, (int)(end - p), out);
+    }
+}
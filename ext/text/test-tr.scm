@@ -87,4 +87,24 @@
 (test* "escape in spec" "*ello, World!"
        (string-tr "Hello,-World!" "A\\-H" "_ \\*"))
 
+(test* "multibyte" "あいうえおABC"
+       (string-tr "アイウエオabc" "ア-オa-z" "あ-おA-Z"))
+(test* "multibyte, delete" "イエbc"
+       (string-tr "アイウエオabc" "アウオa" "" :delete #t))
+(test* "cached table" '("hELLO" "wORLD")
+       (map (cut string-tr <> "A-Za-z" "a-zA-Z") '("Hello" "World")))
+
+;; The port version reads the input by chunks; make sure multibyte
+;; characters across the chunk boundary are handled.
+(let1 input (string-append (make-string 4095 #\a) "アイウ"
+                           (make-string 5000 #\b))
+  (test* "port, chunk boundary"
+         (string-append (make-string 4095 #\A) "あいう"
+                        (make-string 5000 #\B))
+         (call-with-output-string
+           (^[out]
+             ((build-transliterator "a-zア-ン" "A-Zあ-ん"
+                                    :input (open-input-string input)
+                                    :output out))))))
+
 (test-end)
@@ -0,0 +1,182 @@
+/*
+ * tr.c - transliteration engine for text.tr
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "tr.h"
+
+/*================================================================
+ * Table lookup
+ *
+ *   The tables are built in Scheme (see libsrc/text/tr.scm); here we
+ *   just run them.  The semantics of the options follow the original
+ *   Scheme loop:  A squeezed run is the same output character repeated,
+ *   where a character outside of the from-set breaks the run, and a
+ *   deleted character doesn't.
+ */
+
+typedef struct tr_rec {
+    const ScmInt32 *flat;
+    ScmSmallInt flatSize;
+    const ScmInt32 *sparse;
+    ScmSmallInt sparseSize;     /* # of groups */
+    int delete;
+    int squeeze;
+    ScmChar prev;               /* last output char in a run, or INVALID */
+} tr;
+
+static void tr_init(tr *t, ScmUVector *flat, ScmUVector *sparse, int flags)
+{
+    if (!SCM_S32VECTORP(flat)) {
+        Scm_Error("s32vector required, but got %S", flat);
+    }
+    if (!SCM_S32VECTORP(sparse) || SCM_UVECTOR_SIZE(sparse) % 4 != 0) {
+        Scm_Error("s32vector of groups of four required, but got %S", sparse);
+    }
+    t->flat = SCM_S32VECTOR_ELEMENTS(flat);
+    t->flatSize = SCM_UVECTOR_SIZE(flat);
+    t->sparse = SCM_S32VECTOR_ELEMENTS(sparse);
+    t->sparseSize = SCM_UVECTOR_SIZE(sparse) / 4;
+    t->delete = (flags & SCM_TR_DELETE) != 0;
+    t->squeeze = (flags & SCM_TR_SQUEEZE) != 0;
+    t->prev = SCM_CHAR_INVALID;
+}
+
+static ScmInt32 tr_lookup(tr *t, ScmChar ch)
+{
+    if (ch < t->flatSize) return t->flat[ch];
+    const ScmInt32 *s = t->sparse;
+    for (ScmSmallInt i = 0; i < t->sparseSize; i++, s += 4) {
+        if (s[0] <= ch && ch <= s[1]) {
+            switch (s[2]) {
+            case SCM_TR_SPARSE_OFFSET: return s[3] + (ch - s[0]);
+            case SCM_TR_SPARSE_CHAR:   return s[3];
+            default:                   return SCM_TR_NO_MAP;
+            }
+        }
+    }
+    return SCM_TR_NOT_IN_FROM;
+}
+
+/* Returns the character to output for CH, or SCM_CHAR_INVALID. */
+static inline ScmChar tr_char(tr *t, ScmChar ch)
+{
+    ScmInt32 v = tr_lookup(t, ch);
+    if (v >= 0) {
+        if (t->squeeze && t->prev == v) return SCM_CHAR_INVALID;
+        return (t->prev = v);
+    }
+    if (v == SCM_TR_NOT_IN_FROM) {
+        t->prev = SCM_CHAR_INVALID;
+        return ch;
+    }
+    if (t->delete) return SCM_CHAR_INVALID;
+    if (t->squeeze && t->prev == ch) return SCM_CHAR_INVALID;
+    return (t->prev = ch);
+}
+
+/* Transliterates the complete characters in [P, END) into DS.
+   Returns the position after the last complete character. */
+static const char *tr_bytes(tr *t, const char *p, const char *end,
+                            ScmDString *ds)
+{
+    while (p < end) {
+        unsigned char b = (unsigned char)*p;
+        ScmChar ch, out;
+        if (b < 0x80) {
+            ch = b;
+            p++;
+        } else {
+            int n = SCM_CHAR_NFOLLOWS(b);
+            if (end - p <= n) break;
+            SCM_CHAR_GET(p, ch);
+            p += n + 1;
+        }
+        out = tr_char(t, ch);
+        if (out == SCM_CHAR_INVALID) continue;
+        if (out < 0x80) SCM_DSTRING_PUTB(ds, out);
+        else Scm_DStringPutc(ds, out);
+    }
+    return p;
+}
+
+/*================================================================
+ * Entry points
+ */
+
+ScmObj Scm_TrString(ScmString *s, ScmUVector *flat, ScmUVector *sparse,
+                    int flags)
+{
+    tr t;
+    ScmDString ds;
+    u_int size;
+    const char *p = Scm_GetStringContent(s, &size, NULL, NULL);
+
+    tr_init(&t, flat, sparse, flags);
+    Scm_DStringInit(&ds);
+    tr_bytes(&t, p, p + size, &ds);
+    return Scm_DStringTake(&ds, 0);
+}
+
+#define CHUNK_SIZE 4096
+
+/* We read IN by chunks of bytes.  A multibyte character split at the
+   end of a chunk is carried over to the next one. */
+void Scm_TrPort(ScmPort *in, ScmPort *out,
+                ScmUVector *flat, ScmUVector *sparse, int flags)
+{
+    tr t;
+    char buf[CHUNK_SIZE];
+    ScmSmallInt carry = 0;
+    ScmDString ds;
+
+    tr_init(&t, flat, sparse, flags);
+    Scm_DStringInit(&ds);
+    for (;;) {
+        int r = Scm_Getz(buf + carry, (int)(CHUNK_SIZE - carry), in);
+        if (r <= 0) {
+            /* Incomplete character at the end; pass it as is. */
+            if (carry > 0) Scm_Putz(buf, (int)carry, out);
+            break;
+        }
+        const char *end = buf + carry + r;
+        const char *p = tr_bytes(&t, buf, end, &ds);
+        int size;
+        const char *o = Scm_DStringPeek(&ds, &size, NULL);
+        if (size > 0) Scm_Putz(o, (int)size, out);
+        Scm_DStringInit(&ds);
+        carry = end - p;
+        memmove(buf, p, carry);
+    }
+}
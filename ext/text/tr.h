@@ -0,0 +1,74 @@
+/*
+ * tr.h - transliteration engine for text.tr
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_TEXT_TR_H
+#define GAUCHE_TEXT_TR_H
+
+#include <gauche.h>
+
+SCM_DECL_BEGIN
+
+/* A compiled transliteration table consists of two s32vectors.
+   FLAT is indexed by the character code below its length, and its
+   element is one of:
+     >= 0              - the character code to be mapped to
+     SCM_TR_NOT_IN_FROM - the character isn't in the from-set
+     SCM_TR_NO_MAP      - in the from-set, but not in the to-set
+   SPARSE has groups of four elements (from to kind value) for the
+   characters outside of FLAT, searched in order.  KIND is one of
+   SCM_TR_SPARSE_*. */
+enum {
+    SCM_TR_NOT_IN_FROM = -1,
+    SCM_TR_NO_MAP = -2
+};
+
+enum {
+    SCM_TR_SPARSE_OFFSET,       /* maps to value + (code - from) */
+    SCM_TR_SPARSE_CHAR,         /* maps to value */
+    SCM_TR_SPARSE_NO_MAP        /* in the from-set but not in the to-set */
+};
+
+/* Flags */
+enum {
+    SCM_TR_DELETE  = (1L<<0),
+    SCM_TR_SQUEEZE = (1L<<1)
+};
+
+extern ScmObj Scm_TrString(ScmString *s, ScmUVector *flat, ScmUVector *sparse,
+                           int flags);
+extern void   Scm_TrPort(ScmPort *in, ScmPort *out,
+                         ScmUVector *flat, ScmUVector *sparse, int flags);
+
+SCM_DECL_END
+
+#endif /*GAUCHE_TEXT_TR_H*/
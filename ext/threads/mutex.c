@@ -70,6 +70,7 @@ static ScmObj mutex_allocate(ScmClass *klass, ScmObj initargs)
     mutex->locked = FALSE;
     mutex->owner = NULL;
     mutex->locker_proc = mutex->unlocker_proc = SCM_FALSE;
+    mutex->spinCount = 0;
     return SCM_OBJ(mutex);
 }
 
@@ -162,6 +163,16 @@ ScmObj Scm_MakeMutex(ScmObj name)
     return m;
 }
 
+/* An adaptive mutex spins a while before blocking, hoping that the
+   owner releases it soon.  It pays off when critical sections are
+   short and owners are running on other CPUs. */
+ScmObj Scm_MakeAdaptiveMutex(ScmObj name, int spinCount)
+{
+    ScmObj m = Scm_MakeMutex(name);
+    SCM_MUTEX(m)->spinCount = (spinCount > 0)? spinCount : 0;
+    return m;
+}
+
 /*
  * Lock and unlock mutex
  */
@@ -175,6 +186,11 @@ ScmObj Scm_MutexLock(ScmMutex *mutex, ScmObj timeout, ScmVM *owner)
     int intr = FALSE;
 
     ScmTimeSpec *pts = Scm_GetTimeSpec(timeout, &ts);
+    /* Peeking mutex->locked without the lock is racy, but it's only
+       a hint; the real check is done below with the lock held. */
+    for (int i = 0; i < mutex->spinCount; i++) {
+        if (!*(volatile int*)&mutex->locked) break;
+    }
     SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(mutex->mutex);
     while (mutex->locked) {
         if (mutex->owner && mutex->owner->state == SCM_VM_TERMINATED) {
@@ -354,6 +370,234 @@ ScmObj Scm_ConditionVariableBroadcast(ScmConditionVariable *cond)
     return SCM_UNDEFINED;
 }
 
+/*=====================================================
+ * Reader/writer lock
+ */
+
+static ScmObj rwlock_allocate(ScmClass *klass, ScmObj initargs);
+static void   rwlock_print(ScmObj rw, ScmPort *port, ScmWriteContext *ctx);
+
+SCM_DEFINE_BASE_CLASS(Scm_RWLockClass, ScmRWLock,
+                      rwlock_print, NULL, NULL, rwlock_allocate,
+                      default_cpl);
+
+static void rwlock_finalize(ScmObj obj, void *data)
+{
+    ScmRWLock *rw = SCM_RWLOCK(obj);
+    SCM_INTERNAL_MUTEX_DESTROY(rw->mutex);
+    SCM_INTERNAL_COND_DESTROY(rw->readerCond);
+    SCM_INTERNAL_COND_DESTROY(rw->writerCond);
+}
+
+static ScmObj rwlock_allocate(ScmClass *klass, ScmObj initargs)
+{
+    ScmRWLock *rw = SCM_NEW_INSTANCE(ScmRWLock, klass);
+    SCM_INTERNAL_MUTEX_INIT(rw->mutex);
+    SCM_INTERNAL_COND_INIT(rw->readerCond);
+    SCM_INTERNAL_COND_INIT(rw->writerCond);
+    Scm_RegisterFinalizer(SCM_OBJ(rw), rwlock_finalize, NULL);
+    rw->name = SCM_FALSE;
+    rw->specific = SCM_UNDEFINED;
+    rw->numReader = 0;
+    rw->numWaitingWriter = 0;
+    rw->writer = NULL;
+    rw->writeLocked = FALSE;
+    return SCM_OBJ(rw);
+}
+
+static void rwlock_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
+{
+    ScmRWLock *rw = SCM_RWLOCK(obj);
+
+    (void)SCM_INTERNAL_MUTEX_LOCK(rw->mutex);
+    int nreaders = rw->numReader;
+    int wlocked = rw->writeLocked;
+    ScmObj name = rw->name;
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(rw->mutex);
+
+    if (SCM_FALSEP(name)) Scm_Printf(port, "#<rwlock %p ", rw);
+    else                  Scm_Printf(port, "#<rwlock %S ", name);
+    if (wlocked)           Scm_Printf(port, "write-locked>");
+    else if (nreaders > 0) Scm_Printf(port, "read-locked by %d>", nreaders);
+    else                   Scm_Printf(port, "unlocked>");
+}
+
+static ScmObj sym_read_locked;
+static ScmObj sym_write_locked;
+static ScmObj sym_unlocked;
+
+static ScmObj rwlock_state_get(ScmRWLock *rw)
+{
+    ScmObj r;
+    (void)SCM_INTERNAL_MUTEX_LOCK(rw->mutex);
+    if (rw->writeLocked)        r = sym_write_locked;
+    else if (rw->numReader > 0) r = sym_read_locked;
+    else                        r = sym_unlocked;
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(rw->mutex);
+    return r;
+}
+
+static ScmObj rwlock_name_get(ScmRWLock *rw)
+{
+    return rw->name;
+}
+
+static void rwlock_name_set(ScmRWLock *rw, ScmObj name)
+{
+    rw->name = name;
+}
+
+static ScmObj rwlock_specific_get(ScmRWLock *rw)
+{
+    return rw->specific;
+}
+
+static void rwlock_specific_set(ScmRWLock *rw, ScmObj value)
+{
+    rw->specific = value;
+}
+
+static ScmClassStaticSlotSpec rwlock_slots[] = {
+    SCM_CLASS_SLOT_SPEC("name", rwlock_name_get, rwlock_name_set),
+    SCM_CLASS_SLOT_SPEC("state", rwlock_state_get, NULL),
+    SCM_CLASS_SLOT_SPEC("specific", rwlock_specific_get, rwlock_specific_set),
+    SCM_CLASS_SLOT_SPEC_END()
+};
+
+ScmObj Scm_MakeRWLock(ScmObj name)
+{
+    ScmObj rw = rwlock_allocate(SCM_CLASS_RWLOCK, SCM_NIL);
+    SCM_RWLOCK(rw)->name = name;
+    return rw;
+}
+
+/* A writer that is killed while holding the lock would block everyone
+   forever; we treat the lock as released as mutexes do, but without
+   raising abandoned-mutex-exception since the protected data may be
+   read by many. */
+static int rwlock_write_abandoned(ScmRWLock *rw)
+{
+    return (rw->writeLocked && rw->writer
+            && rw->writer->state == SCM_VM_TERMINATED);
+}
+
+ScmObj Scm_RWLockReadLock(ScmRWLock *rw, ScmObj timeout)
+{
+#ifdef GAUCHE_HAS_THREADS
+    ScmTimeSpec ts;
+    ScmObj r = SCM_TRUE;
+    int intr = FALSE;
+
+    ScmTimeSpec *pts = Scm_GetTimeSpec(timeout, &ts);
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(rw->mutex);
+    while (rw->writeLocked || rw->numWaitingWriter > 0) {
+        if (rwlock_write_abandoned(rw)) {
+            rw->writeLocked = FALSE;
+            rw->writer = NULL;
+            continue;
+        }
+        if (pts) {
+            int tr = SCM_INTERNAL_COND_TIMEDWAIT(rw->readerCond, rw->mutex, pts);
+            if (tr == SCM_INTERNAL_COND_TIMEDOUT) { r = SCM_FALSE; break; }
+            else if (tr == SCM_INTERNAL_COND_INTR) { intr = TRUE; break; }
+        } else {
+            SCM_INTERNAL_COND_WAIT(rw->readerCond, rw->mutex);
+        }
+    }
+    if (SCM_TRUEP(r) && !intr) rw->numReader++;
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    if (intr) {
+        Scm_SigCheck(Scm_VM());
+        return Scm_RWLockReadLock(rw, timeout);
+    }
+    return r;
+#else  /* !GAUCHE_HAS_THREADS */
+    return SCM_TRUE;            /* dummy */
+#endif /* !GAUCHE_HAS_THREADS */
+}
+
+ScmObj Scm_RWLockReadUnlock(ScmRWLock *rw)
+{
+#ifdef GAUCHE_HAS_THREADS
+    int err = FALSE;
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(rw->mutex);
+    if (rw->numReader <= 0) {
+        err = TRUE;
+    } else if (--rw->numReader == 0 && rw->numWaitingWriter > 0) {
+        SCM_INTERNAL_COND_SIGNAL(rw->writerCond);
+    }
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    if (err) Scm_Error("rwlock isn't read-locked: %S", rw);
+#endif /* GAUCHE_HAS_THREADS */
+    return SCM_TRUE;
+}
+
+ScmObj Scm_RWLockWriteLock(ScmRWLock *rw, ScmObj timeout)
+{
+#ifdef GAUCHE_HAS_THREADS
+    ScmTimeSpec ts;
+    ScmObj r = SCM_TRUE;
+    int intr = FALSE;
+
+    ScmTimeSpec *pts = Scm_GetTimeSpec(timeout, &ts);
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(rw->mutex);
+    rw->numWaitingWriter++;
+    while (rw->writeLocked || rw->numReader > 0) {
+        if (rwlock_write_abandoned(rw)) {
+            rw->writeLocked = FALSE;
+            rw->writer = NULL;
+            continue;
+        }
+        if (pts) {
+            int tr = SCM_INTERNAL_COND_TIMEDWAIT(rw->writerCond, rw->mutex, pts);
+            if (tr == SCM_INTERNAL_COND_TIMEDOUT) { r = SCM_FALSE; break; }
+            else if (tr == SCM_INTERNAL_COND_INTR) { intr = TRUE; break; }
+        } else {
+            SCM_INTERNAL_COND_WAIT(rw->writerCond, rw->mutex);
+        }
+    }
+    rw->numWaitingWriter--;
+    if (SCM_TRUEP(r) && !intr) {
+        rw->writeLocked = TRUE;
+        rw->writer = Scm_VM();
+    } else if (rw->numWaitingWriter == 0 && !rw->writeLocked) {
+        /* We gave up; let the readers blocked by us go. */
+        SCM_INTERNAL_COND_BROADCAST(rw->readerCond);
+    }
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    if (intr) {
+        Scm_SigCheck(Scm_VM());
+        return Scm_RWLockWriteLock(rw, timeout);
+    }
+    return r;
+#else  /* !GAUCHE_HAS_THREADS */
+    return SCM_TRUE;            /* dummy */
+#endif /* !GAUCHE_HAS_THREADS */
+}
+
+ScmObj Scm_RWLockWriteUnlock(ScmRWLock *rw)
+{
+#ifdef GAUCHE_HAS_THREADS
+    int err = FALSE;
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(rw->mutex);
+    if (!rw->writeLocked) {
+        err = TRUE;
+    } else {
+        rw->writeLocked = FALSE;
+        rw->writer = NULL;
+        /* Writers first; readers are woken when no writer is waiting. */
+        if (rw->numWaitingWriter > 0) {
+            SCM_INTERNAL_COND_SIGNAL(rw->writerCond);
+        } else {
+            SCM_INTERNAL_COND_BROADCAST(rw->readerCond);
+        }
+    }
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    if (err) Scm_Error("rwlock isn't write-locked: %S", rw);
+#endif /* GAUCHE_HAS_THREADS */
+    return SCM_TRUE;
+}
+
 /*
  * Initialization
  */
@@ -365,4 +609,8 @@ void Scm_Init_mutex(ScmModule *mod)
     sym_not_abandoned = SCM_INTERN("not-abandoned");
     Scm_InitStaticClass(&Scm_MutexClass, "<mutex>", mod, mutex_slots, 0);
     Scm_InitStaticClass(&Scm_ConditionVariableClass, "<condition-variable>", mod, cv_slots, 0);
+    sym_read_locked   = SCM_INTERN("read-locked");
+    sym_write_locked  = SCM_INTERN("write-locked");
+    sym_unlocked      = SCM_INTERN("unlocked");
+    Scm_InitStaticClass(&Scm_RWLockClass, "<rwlock>", mod, rwlock_slots, 0);
 }
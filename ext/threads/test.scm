@@ -41,6 +41,21 @@
          (^p (let1 t (thread-start! (make-thread (^[] (display "hello" p))))
                (thread-join! t)))))
 
+(test* "make-thread with stack size" '(#t #t)
+       (let* ([t0 (make-thread (^[] #f))]
+              [t1 (make-thread (^[] #f) 'big (* 4 (vm-stack-size t0)))]
+              [t2 (make-thread (^[] #f) 'small 1)])
+         (list (= (vm-stack-size t1) (* 4 (vm-stack-size t0)))
+               (<= (vm-stack-size t2) (vm-stack-size t0)))))
+(test* "stack overflow count" #t
+       (let* ([sum (^[n] (let loop ([n n]) (if (= n 0) 0 (+ n (loop (- n 1))))))]
+              [run (^[size]
+                     (let1 t (make-thread (^[] (sum 20000)
+                                            (vm-stack-overflow-count))
+                                          #f size)
+                       (thread-join! (thread-start! t))))])
+         (> (run 0) (run (* 100 (vm-stack-size))))))
+
 ;; calculate fibonacchi in awful way
 (define (mt-fib n)
   (let1 threads (make-vector n)
@@ -112,6 +127,49 @@
          (thread-terminate! t1)
          (thread-state t1)))
 
+;; system threads and VM stacks are recycled; make sure the reused
+;; ones don't carry the state over.
+(test* "recycled threads" '(0 1 2 3 4 5 6 7 8 9)
+       (map (^i (thread-join!
+                 (thread-start!
+                  (make-thread (^[] (and (not (thread-specific (current-thread)))
+                                         (begin
+                                           (thread-specific-set! (current-thread)
+                                                                 i)
+                                           (let loop ([n 1000] [acc '()])
+                                             (if (= n 0)
+                                               (thread-specific (current-thread))
+                                               (loop (- n 1) (cons n acc)))))))))))
+            (iota 10)))
+
+(test* "recycled threads, concurrently" 4950
+       (apply + (map thread-join!
+                     (map (^i (thread-start! (make-thread (^[] i))))
+                          (iota 100)))))
+
+;; Affinity is only supported on some platforms; we just check the
+;; ones we get back.
+(when (thread-affinity (current-thread))
+  (let1 cpu (car (thread-affinity (current-thread)))
+    (test* "make-thread with affinity" (list cpu)
+           (thread-join!
+            (thread-start!
+             (make-thread (^[] (thread-affinity (current-thread))) #f 0
+                          :affinity (list cpu)))))
+    (test* "recycled threads don't keep affinity" #t
+           (let1 cpus (thread-join!
+                       (thread-start!
+                        (make-thread (^[] (thread-affinity (current-thread))))))
+             (equal? cpus (thread-affinity (current-thread)))))
+    (test* "thread-affinity-set! with bad cpu" (test-error)
+           (thread-affinity-set! (current-thread) '(-1)))))
+
+(test* "numa-node-cpus" #t
+       (let1 nodes (numa-node-cpus)
+         (and (pair? nodes)
+              (every (^[cpus] (and (pair? cpus) (every integer? cpus)))
+                     nodes))))
+
 ;;---------------------------------------------------------------------
 (test-section "thread and error")
 
@@ -246,6 +304,98 @@
               (list r0 r1 (mutex-state m)))))
         ))
 
+;; adaptive mutex
+(test* "adaptive mutex" 10000
+       (let ([m (make-adaptive-mutex 'adaptive)]
+             [count 0])
+         (let1 ts (map (^_ (make-thread
+                            (^[] (dotimes [2500]
+                                   (with-locking-mutex m
+                                     (^[] (inc! count)))))))
+                       (iota 4))
+           (for-each thread-start! ts)
+           (for-each thread-join! ts)
+           count)))
+
+;;---------------------------------------------------------------------
+(test-section "reader/writer locks")
+
+(test* "make-rwlock" '(#t foo unlocked)
+       (let1 rw (make-rwlock 'foo)
+         (list (rwlock? rw) (rwlock-name rw) (rwlock-state rw))))
+
+(test* "multiple readers" '(read-locked #t unlocked)
+       (let1 rw (make-rwlock)
+         (rwlock-read-lock! rw)
+         (rwlock-read-lock! rw)
+         (let* ([s0 (rwlock-state rw)]
+                [r (thread-join!
+                    (thread-start!
+                     (make-thread (^[] (begin0 (rwlock-read-lock! rw 0.1)
+                                         (rwlock-read-unlock! rw))))))])
+           (rwlock-read-unlock! rw)
+           (rwlock-read-unlock! rw)
+           (list s0 r (rwlock-state rw)))))
+
+(test* "write lock excludes others" '(write-locked #f #f #t)
+       (let1 rw (make-rwlock)
+         (rwlock-write-lock! rw)
+         (let* ([s0 (rwlock-state rw)]
+                [try (^[locker]
+                       (thread-join!
+                        (thread-start!
+                         (make-thread (^[] (locker rw 0.05))))))]
+                [r0 (try rwlock-read-lock!)]
+                [r1 (try rwlock-write-lock!)])
+           (rwlock-write-unlock! rw)
+           (list s0 r0 r1 (rwlock-write-lock! rw 0)))))
+
+(test* "unlocking unlocked rwlock" (test-error)
+       (rwlock-read-unlock! (make-rwlock)))
+(test* "unlocking unlocked rwlock" (test-error)
+       (rwlock-write-unlock! (make-rwlock)))
+
+(test* "writer preference" '(#f (writer reader))
+       (let ([rw (make-rwlock)]
+             [log '()]
+             [m (make-mutex)])
+         (define (log! x) (with-locking-mutex m (^[] (push! log x))))
+         (rwlock-read-lock! rw)
+         (let1 w (thread-start!
+                  (make-thread (^[] (with-rwlock-write-lock rw
+                                      (^[] (log! 'writer))))))
+           (sys-nanosleep #e1e8)          ;let the writer start waiting
+           (let* ([r0 (rwlock-read-lock! rw 0.05)]
+                  [r (thread-start!
+                      (make-thread (^[] (with-rwlock-read-lock rw
+                                          (^[] (log! 'reader))))))])
+             (sys-nanosleep #e1e8)
+             (rwlock-read-unlock! rw)
+             (thread-join! w)
+             (thread-join! r)
+             (list r0 (reverse log))))))
+
+(test* "readers and writers" 2000
+       (let ([rw (make-rwlock)]
+             [v (make-vector 2 0)])
+         (let1 ts
+             (map (^i (make-thread
+                       (if (even? i)
+                         (^[] (dotimes [500]
+                                (with-rwlock-write-lock rw
+                                  (^[]
+                                    (vector-set! v 0 (+ (vector-ref v 0) 1))
+                                    (vector-set! v 1 (+ (vector-ref v 1) 1))))))
+                         (^[] (dotimes [500]
+                                (with-rwlock-read-lock rw
+                                  (^[]
+                                    (unless (= (vector-ref v 0) (vector-ref v 1))
+                                      (error "inconsistent read")))))))))
+                  (iota 8))
+           (for-each thread-start! ts)
+           (for-each thread-join! ts)
+           (vector-ref v 0))))
+
 ;;---------------------------------------------------------------------
 (test-section "condition variables")
 
@@ -504,6 +654,64 @@
          (for-each thread-join! ts)
          (atom-ref a)))
 
+(test-section "atomic boxes")
+
+(use gauche.uvector)
+
+(let1 b (make-atomic-box 'a)
+  (test* "atomic-box" '(#t a) (list (atomic-box? b) (atomic-box-ref b)))
+  (test* "atomic-box-set!" 'b (begin (atomic-box-set! b 'b) (atomic-box-ref b)))
+  (test* "atomic-box-swap!" '(b c) (list (atomic-box-swap! b 'c) (atomic-box-ref b)))
+  (test* "atomic-box-cas!" '(#f c #t d)
+         (list (atomic-box-cas! b 'x 'y) (atomic-box-ref b)
+               (atomic-box-cas! b 'c 'd) (atomic-box-ref b))))
+
+(let1 b (make-atomic-fxbox 10)
+  (test* "atomic-fxbox" '(#t 10) (list (atomic-fxbox? b) (atomic-fxbox-ref b)))
+  (test* "atomic-fxbox-fetch-add!" '(10 11 16)
+         (list (atomic-fxbox-fetch-add! b) (atomic-fxbox-fetch-add! b 5)
+               (atomic-fxbox-ref b)))
+  (test* "atomic-fxbox-fetch-sub!" '(16 13)
+         (list (atomic-fxbox-fetch-sub! b 3) (atomic-fxbox-ref b)))
+  (test* "atomic-fxbox-cas!" '(#f #t -1)
+         (list (atomic-fxbox-cas! b 0 1) (atomic-fxbox-cas! b 13 -1)
+               (atomic-fxbox-ref b)))
+  (test* "atomic-fxbox-set!" 'error
+         (guard (e [else 'error]) (atomic-fxbox-set! b 'x))))
+
+(test* "atomic fxbox counting" 3000
+       (let ([b (make-atomic-fxbox)] [ts '()])
+         (dotimes [n 30]
+           (push! ts
+                  (thread-start! (make-thread
+                                  (^[] (dotimes [m 100]
+                                         (atomic-fxbox-fetch-add! b)))))))
+         (for-each thread-join! ts)
+         (atomic-fxbox-ref b)))
+
+(test* "atomic box update with cas" 300
+       (let ([b (make-atomic-box 0)] [ts '()])
+         (dotimes [n 30]
+           (push! ts
+                  (thread-start!
+                   (make-thread
+                    (^[] (dotimes [m 10]
+                           (let loop ([v (atomic-box-ref b)])
+                             (unless (atomic-box-cas! b v (+ v 1))
+                               (loop (atomic-box-ref b))))))))))
+         (for-each thread-join! ts)
+         (atomic-box-ref b)))
+
+(test* "vector-cas!" '(#f #t #(a z c))
+       (let1 v (vector 'a 'b 'c)
+         (list (vector-cas! v 1 'x 'y) (vector-cas! v 1 'b 'z) v)))
+(test* "vector-cas! out of range" (test-error) (vector-cas! (vector 1) 1 1 2))
+(test* "uvector-cas!" '(#f #t #s32(1 -5))
+       (let1 v (s32vector 1 2)
+         (list (uvector-cas! v 1 3 4) (uvector-cas! v 1 2 -5) v)))
+(test* "uvector-cas! unsupported" (test-error)
+       (uvector-cas! (u8vector 1) 0 1 2))
+
 ;;---------------------------------------------------------------------
 (test-section "threads and promise")
 
@@ -529,6 +737,39 @@
            (for-each thread-join! ts)
            count)))
 
+;;---------------------------------------------------------------------
+(test-section "threads and symbols")
+
+;; Threads intern the same set of fresh names concurrently, which also
+;; makes the symbol table grow while they're working.
+(test* "concurrent interning" #t
+       (let* ([names (map (^i (format "thread-intern-test-~d" i))
+                          (iota 20000))]
+              [ts (map (^_ (make-thread (^[] (map string->symbol names))))
+                       (iota 4))])
+         (for-each thread-start! ts)
+         (let1 rs (map thread-join! ts)
+           (every (^r (every eq? r (car rs))) rs))))
+
+;;---------------------------------------------------------------------
+(test-section "threads and autoload")
+
+;; Threads hit the same unresolved autoload at once.  The file takes
+;; a while to load, so that all of them have to wait for the first one.
+(sys-system "rm -rf test.o")
+(sys-mkdir "test.o" #o755)
+(with-output-to-file "test.o/al.scm"
+  (^[] (write '(begin (sys-nanosleep #e5e7)
+                      (define thread-autoload-test-var 'ok)))))
+(autoload "test.o/al" thread-autoload-test-var)
+
+(test* "concurrent autoload" (make-list 10 'ok)
+       (let1 ts (map (^_ (make-thread (^[] thread-autoload-test-var)))
+                     (iota 10))
+         (for-each thread-start! ts)
+         (map thread-join! ts)))
+(sys-system "rm -rf test.o")
+
 ;;---------------------------------------------------------------------
 (test-section "threads and lazy sequences")
 
@@ -596,6 +837,28 @@
                         (make-mtqueue :max-length 0)
                         100 3)
 
+(test-producer-consumer "(mpmc-queue)"
+                        (make-mpmc-queue 5)
+                        100 3)
+
+(test* "mpmc-queue many producers" (iota 400)
+       (let* ([q (make-mpmc-queue 7)]
+              [ps (map (^k (thread-start!
+                            (make-thread
+                             (^[] (dotimes [i 100]
+                                    (enqueue/wait! q (+ (* k 100) i)))))))
+                       (iota 4))]
+              [r (list-tabulate 400 (^_ (dequeue/wait! q)))])
+         (for-each thread-join! ps)
+         (sort r)))
+
+(test* "mpmc-queue dequeue/wait! timeout" "timed out!"
+       (dequeue/wait! (make-mpmc-queue 1) 0.01 "timed out!"))
+(test* "mpmc-queue enqueue/wait! timeout" "timed out!"
+       (let1 q (make-mpmc-queue 1)
+         (enqueue! q 'a)
+         (enqueue/wait! q 'b 0.01 "timed out!")))
+
 (test* "dequeue/wait! timeout" "timed out!"
        (dequeue/wait! (make-mtqueue) 0.01 "timed out!"))
 (test* "enqueue/wait! timeout" "timed out!"
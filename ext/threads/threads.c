@@ -31,6 +31,8 @@
  *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define _GNU_SOURCE  /* for CPU_SET and pthread_setaffinity_np on Linux */
+
 #include <gauche.h>
 #include <gauche/vm.h>
 #include <gauche/extend.h>
@@ -43,6 +45,11 @@
 #ifdef HAVE_SCHED_H
 #include <sched.h>
 #endif
+#if defined(__linux__) && defined(GAUCHE_USE_PTHREADS)
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#define HAVE_THREAD_PRIORITY 1
+#endif
 
 /*==============================================================
  * Thread interface
@@ -51,13 +58,23 @@
 /* Creation.  In the "NEW" state, a VM is allocated but actual thread
    is not created. */
 ScmObj Scm_MakeThread(ScmProcedure *thunk, ScmObj name)
+{
+    return Scm_MakeThreadWithStackSize(thunk, name, 0);
+}
+
+/* If STACKSIZE is zero or negative, the new thread gets the same
+   stack size as the current thread. */
+ScmObj Scm_MakeThreadWithStackSize(ScmProcedure *thunk, ScmObj name,
+                                   long stackSize)
 {
     ScmVM *current = Scm_VM();
 
     if (SCM_PROCEDURE_REQUIRED(thunk) != 0) {
         Scm_Error("thunk required, but got %S", thunk);
     }
-    ScmVM *vm = Scm_NewVM(current, name);
+    ScmVM *vm = (stackSize > 0
+                 ? Scm_NewVMWithStackSize(current, name, stackSize)
+                 : Scm_NewVM(current, name));
     vm->thunk = thunk;
     return SCM_OBJ(vm);
 }
@@ -94,10 +111,25 @@ static void thread_cleanup(void *data)
 }
 
 #if defined(GAUCHE_HAS_THREADS)
-static SCM_INTERNAL_THREAD_PROC_RETTYPE thread_entry(void *data)
-{
-    ScmVM *vm = SCM_VM(data);
+/* The default signal mask on the thread creation */
+static struct threadRec {
+    int dummy;                  /* required to place this in data area */
+    sigset_t defaultSigmask;
+    int attrsChanged;           /* TRUE once affinity/priority is set */
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP)
+    cpu_set_t defaultAffinity;
+#endif
+#if defined(HAVE_THREAD_PRIORITY)
+    int defaultPriority;
+#endif
+} threadrec = { 0 };
+
+#if defined(GAUCHE_USE_PTHREADS)
+static void reset_thread_attrs(void);
+#endif
 
+static void thread_run(ScmVM *vm)
+{
     if (!Scm_AttachVM(vm)) {
         vm->resultException =
             Scm_MakeError(SCM_MAKE_STR("attaching VM to thread failed"));
@@ -126,16 +158,108 @@ static SCM_INTERNAL_THREAD_PROC_RETTYPE thread_entry(void *data)
                 Scm_Panic("unknown escape");
             }
         } SCM_END_PROTECT;
+        Scm__VMReleaseStack(vm);
         SCM_INTERNAL_THREAD_CLEANUP_POP();
     }
-    return SCM_INTERNAL_THREAD_PROC_RETVAL;
 }
 
-/* The default signal mask on the thread creation */
-static struct threadRec {
-    int dummy;                  /* required to place this in data area */
-    sigset_t defaultSigmask;
-} threadrec = { 0 };
+#if defined(GAUCHE_USE_PTHREADS)
+/* Reusing system threads.
+   When a thread finishes running its VM, it parks itself for a while
+   instead of exiting.  Scm_ThreadStart hands a new VM to a parked
+   thread if there's one, saving the cost of pthread_create.
+   Each parked thread waits on its own carrier record on its C stack;
+   the record is only touched with carriers.mutex held.
+
+   The maximum number of parked threads and how long they wait can be
+   set by the environment variables GAUCHE_THREAD_IDLE_MAX and
+   GAUCHE_THREAD_IDLE_TIMEOUT (in seconds).  Setting the former to 0
+   disables the reuse. */
+struct carrier {
+    struct carrier *next;
+    pthread_t thread;
+    pthread_cond_t cv;
+    ScmVM *vm;                  /* set by the dispatcher */
+};
+
+static struct {
+    pthread_mutex_t mutex;
+    struct carrier *idle;
+    int numIdle;
+    int maxIdle;
+    int idleTimeout;
+} carriers = { PTHREAD_MUTEX_INITIALIZER, NULL, 0, 8, 10 };
+
+/* Wait for a VM to run next.  Returns NULL if timed out. */
+static ScmVM *carrier_park(void)
+{
+    struct carrier c;
+    ScmVM *vm = NULL;
+
+    c.thread = pthread_self();
+    c.vm = NULL;
+    pthread_cond_init(&c.cv, NULL);
+    pthread_mutex_lock(&carriers.mutex);
+    if (carriers.numIdle < carriers.maxIdle) {
+        ScmTimeSpec ts;
+        Scm_GetTimeSpec(SCM_MAKE_INT(carriers.idleTimeout), &ts);
+        c.next = carriers.idle;
+        carriers.idle = &c;
+        carriers.numIdle++;
+        while (c.vm == NULL) {
+            if (pthread_cond_timedwait(&c.cv, &carriers.mutex, &ts) == ETIMEDOUT
+                && c.vm == NULL) {
+                struct carrier **p = &carriers.idle;
+                while (*p != &c) p = &(*p)->next;
+                *p = c.next;
+                carriers.numIdle--;
+                break;
+            }
+        }
+        vm = c.vm;
+    }
+    pthread_mutex_unlock(&carriers.mutex);
+    pthread_cond_destroy(&c.cv);
+    return vm;
+}
+
+/* Hand VM to a parked thread.  Returns FALSE if there's none.
+   Caller holds vm->vmlock. */
+static int carrier_dispatch(ScmVM *vm)
+{
+    int r = FALSE;
+    pthread_mutex_lock(&carriers.mutex);
+    struct carrier *c = carriers.idle;
+    if (c != NULL) {
+        carriers.idle = c->next;
+        carriers.numIdle--;
+        vm->thread = c->thread;
+        c->vm = vm;
+        pthread_cond_signal(&c->cv);
+        r = TRUE;
+    }
+    pthread_mutex_unlock(&carriers.mutex);
+    return r;
+}
+#endif /*GAUCHE_USE_PTHREADS*/
+
+static SCM_INTERNAL_THREAD_PROC_RETTYPE thread_entry(void *data)
+{
+    ScmVM *vm = SCM_VM(data);
+#if defined(GAUCHE_USE_PTHREADS)
+    for (;;) {
+        thread_run(vm);
+        if ((vm = carrier_park()) == NULL) break;
+        /* The previous VM may have changed the mask, affinity and
+           priority. */
+        pthread_sigmask(SIG_SETMASK, &threadrec.defaultSigmask, NULL);
+        if (threadrec.attrsChanged) reset_thread_attrs();
+    }
+#else  /*!GAUCHE_USE_PTHREADS*/
+    thread_run(vm);
+#endif /*!GAUCHE_USE_PTHREADS*/
+    return SCM_INTERNAL_THREAD_PROC_RETVAL;
+}
 #endif /* defined(GAUCHE_HAS_THREADS) */
 
 /* Start a thread.  If the VM is in "NEW" state, create a new thread and
@@ -161,7 +285,7 @@ ScmObj Scm_ThreadStart(ScmVM *vm)
         SCM_ASSERT(vm->thunk);
         vm->state = SCM_VM_RUNNABLE;
 #if defined(GAUCHE_USE_PTHREADS)
-        {
+        if (!carrier_dispatch(vm)) {
             pthread_attr_t thattr;
             sigset_t omask;
             pthread_attr_init(&thattr);
@@ -465,6 +589,131 @@ ScmObj Scm_ThreadTerminate(ScmVM *target)
     return SCM_UNDEFINED;
 }
 
+/*==============================================================
+ * Thread attributes
+ *
+ *  CPU affinity is expressed as a list of CPU numbers.  The priority
+ *  is the 'nice' value of the thread, which Linux keeps per thread;
+ *  a thread can only change its own priority, for we don't know the
+ *  kernel thread id of other threads.
+ */
+
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP)
+static ScmObj cpuset_to_list(cpu_set_t *set)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    for (int i = 0; i < CPU_SETSIZE; i++) {
+        if (CPU_ISSET(i, set)) SCM_APPEND1(h, t, SCM_MAKE_INT(i));
+    }
+    return h;
+}
+
+static void list_to_cpuset(ScmObj cpus, cpu_set_t *set)
+{
+    ScmObj cp;
+    CPU_ZERO(set);
+    SCM_FOR_EACH(cp, cpus) {
+        ScmObj n = SCM_CAR(cp);
+        if (!SCM_INTP(n) || SCM_INT_VALUE(n) < 0
+            || SCM_INT_VALUE(n) >= CPU_SETSIZE) {
+            Scm_Error("CPU number out of range: %S", n);
+        }
+        CPU_SET(SCM_INT_VALUE(n), set);
+    }
+    if (!SCM_NULLP(cp)) Scm_Error("proper list of CPU numbers required, but got %S", cpus);
+    if (CPU_COUNT(set) == 0) Scm_Error("CPU set can't be empty");
+}
+
+/* Returns the system thread of VM, which must be running. */
+static pthread_t running_thread(ScmVM *vm, const char *what)
+{
+    if (vm != Scm_VM() && vm->state != SCM_VM_RUNNABLE
+        && vm->state != SCM_VM_STOPPED) {
+        Scm_Error("can't %s of a thread that isn't running: %S", what, vm);
+    }
+    return vm->thread;
+}
+#endif /*HAVE_PTHREAD_SETAFFINITY_NP*/
+
+ScmObj Scm_ThreadAffinity(ScmVM *vm)
+{
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP)
+    cpu_set_t set;
+    pthread_t th = running_thread(vm, "get affinity");
+    int r = pthread_getaffinity_np(th, sizeof(set), &set);
+    if (r != 0) {
+        errno = r;
+        Scm_SysError("pthread_getaffinity_np failed on %S", vm);
+    }
+    return cpuset_to_list(&set);
+#else
+    return SCM_FALSE;           /* unknown */
+#endif
+}
+
+void Scm_ThreadAffinitySet(ScmVM *vm, ScmObj cpus)
+{
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP)
+    cpu_set_t set;
+    list_to_cpuset(cpus, &set);
+    pthread_t th = running_thread(vm, "set affinity");
+    threadrec.attrsChanged = TRUE;
+    int r = pthread_setaffinity_np(th, sizeof(set), &set);
+    if (r != 0) {
+        errno = r;
+        Scm_SysError("pthread_setaffinity_np failed on %S", vm);
+    }
+#else
+    Scm_Error("setting thread affinity isn't supported on this platform");
+#endif
+}
+
+ScmObj Scm_ThreadPriority(ScmVM *vm)
+{
+#if defined(HAVE_THREAD_PRIORITY)
+    if (vm != Scm_VM()) {
+        Scm_Error("only the priority of the calling thread can be taken: %S", vm);
+    }
+    errno = 0;
+    int p = getpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid));
+    if (p == -1 && errno != 0) Scm_SysError("getpriority failed");
+    return SCM_MAKE_INT(p);
+#else
+    return SCM_FALSE;           /* unknown */
+#endif
+}
+
+void Scm_ThreadPrioritySet(ScmVM *vm, int priority)
+{
+#if defined(HAVE_THREAD_PRIORITY)
+    if (vm != Scm_VM()) {
+        Scm_Error("only the priority of the calling thread can be changed: %S", vm);
+    }
+    threadrec.attrsChanged = TRUE;
+    if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), priority) < 0) {
+        Scm_SysError("setpriority failed");
+    }
+#else
+    Scm_Error("setting thread priority isn't supported on this platform");
+#endif
+}
+
+#if defined(GAUCHE_USE_PTHREADS)
+/* A reused thread starts over with the initial attributes.  Restoring
+   a lower nice value may not be permitted, in which case we leave it. */
+static void reset_thread_attrs(void)
+{
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP)
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                           &threadrec.defaultAffinity);
+#endif
+#if defined(HAVE_THREAD_PRIORITY)
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid),
+                threadrec.defaultPriority);
+#endif
+}
+#endif /*GAUCHE_USE_PTHREADS*/
+
 /*
  * Initialization.
  */
@@ -475,5 +724,27 @@ void Scm_Init_threads(ScmModule *mod)
 # if defined(GAUCHE_PTHREAD_SIGNAL)
     sigdelset(&threadrec.defaultSigmask, GAUCHE_PTHREAD_SIGNAL);
 # endif /*defined(GAUCHE_PTHRAD_SIGNAL)*/
+    const char *e = Scm_GetEnv("GAUCHE_THREAD_IDLE_MAX");
+    if (e != NULL) {
+        long n = strtol(e, NULL, 10);
+        if (n >= 0 && n <= INT_MAX) carriers.maxIdle = (int)n;
+    }
+    e = Scm_GetEnv("GAUCHE_THREAD_IDLE_TIMEOUT");
+    if (e != NULL) {
+        long n = strtol(e, NULL, 10);
+        if (n > 0 && n <= INT_MAX) carriers.idleTimeout = (int)n;
+    }
+# if defined(HAVE_PTHREAD_SETAFFINITY_NP)
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                               &threadrec.defaultAffinity) != 0) {
+        CPU_ZERO(&threadrec.defaultAffinity);
+        for (int i = 0; i < CPU_SETSIZE; i++) {
+            CPU_SET(i, &threadrec.defaultAffinity);
+        }
+    }
+# endif
+# if defined(HAVE_THREAD_PRIORITY)
+    threadrec.defaultPriority = getpriority(PRIO_PROCESS, 0);
+# endif
 #endif /*GAUCHE_USE_PTHREADS*/
 }
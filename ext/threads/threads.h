@@ -44,6 +44,8 @@
  */
 
 extern ScmObj Scm_MakeThread(ScmProcedure *thunk, ScmObj name);
+extern ScmObj Scm_MakeThreadWithStackSize(ScmProcedure *thunk, ScmObj name,
+                                          long stackSize);
 extern ScmObj Scm_ThreadStart(ScmVM *vm);
 extern ScmObj Scm_ThreadJoin(ScmVM *vm, ScmObj timeout, ScmObj timeoutval);
 extern ScmObj Scm_ThreadStop(ScmVM *vm, ScmObj timeout, ScmObj timeoutval);
@@ -51,6 +53,11 @@ extern ScmObj Scm_ThreadCont(ScmVM *vm);
 extern ScmObj Scm_ThreadSleep(ScmObj timeout);
 extern ScmObj Scm_ThreadTerminate(ScmVM *vm);
 
+extern ScmObj Scm_ThreadAffinity(ScmVM *vm);
+extern void   Scm_ThreadAffinitySet(ScmVM *vm, ScmObj cpus);
+extern ScmObj Scm_ThreadPriority(ScmVM *vm);
+extern void   Scm_ThreadPrioritySet(ScmVM *vm, int priority);
+
 /*---------------------------------------------------------
  * SYNCHRONIZATION DEVICES
  *
@@ -95,6 +102,8 @@ typedef struct ScmMutexRec {
     ScmVM *owner;              /* the thread who owns this lock; may be NULL */
     ScmObj locker_proc;        /* subr thunk to lock this mutex */
     ScmObj unlocker_proc;      /* subr thunk to unlock this mutex */
+    int   spinCount;           /* adaptive mutex spins this many times
+                                  before blocking.  0 for plain mutex. */
 } ScmMutex;
 
 SCM_CLASS_DECL(Scm_MutexClass);
@@ -103,6 +112,7 @@ SCM_CLASS_DECL(Scm_MutexClass);
 #define SCM_MUTEXP(obj)        SCM_XTYPEP(obj, SCM_CLASS_MUTEX)
 
 ScmObj Scm_MakeMutex(ScmObj name);
+ScmObj Scm_MakeAdaptiveMutex(ScmObj name, int spinCount);
 ScmObj Scm_MutexLock(ScmMutex *mutex, ScmObj timeout, ScmVM *owner);
 ScmObj Scm_MutexUnlock(ScmMutex *mutex, ScmConditionVariable *cv, ScmObj timeout);
 ScmObj Scm_MutexLocker(ScmMutex *mutex);
@@ -110,15 +120,20 @@ ScmObj Scm_MutexUnlocker(ScmMutex *mutex);
 
 /*
  * Scheme reader/writer lock.
+ * Writer-preferring: once a writer is waiting, new readers wait until
+ * the writer has done.
  */
 typedef struct ScmRWLockRec {
-    SCM_HEADER;
+    SCM_INSTANCE_HEADER;
     ScmInternalMutex mutex;
-    ScmInternalCond cond;
+    ScmInternalCond readerCond;
+    ScmInternalCond writerCond;
     ScmObj name;
     ScmObj specific;
-    int numReader;
-    int numWriter;
+    int numReader;              /* # of threads holding read lock */
+    int numWaitingWriter;       /* # of threads waiting for write lock */
+    ScmVM *writer;              /* thread holding write lock, or NULL */
+    int writeLocked;
 } ScmRWLock;
 
 SCM_CLASS_DECL(Scm_RWLockClass);
@@ -127,6 +142,10 @@ SCM_CLASS_DECL(Scm_RWLockClass);
 #define SCM_RWLOCKP(obj)       SCM_XTYPEP(obj, SCM_CLASS_RWLOCK)
 
 ScmObj Scm_MakeRWLock(ScmObj name);
+ScmObj Scm_RWLockReadLock(ScmRWLock *rw, ScmObj timeout);
+ScmObj Scm_RWLockReadUnlock(ScmRWLock *rw);
+ScmObj Scm_RWLockWriteLock(ScmRWLock *rw, ScmObj timeout);
+ScmObj Scm_RWLockWriteUnlock(ScmRWLock *rw);
 
 
 #endif /*GAUCHE_THREADS_H*/
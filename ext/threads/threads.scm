@@ -39,11 +39,19 @@
           thread? make-thread thread-name thread-specific-set! thread-specific
           thread-state thread-start! thread-yield! thread-sleep!
           thread-join! thread-terminate! thread-stop! thread-cont!
+          thread-affinity thread-affinity-set!
+          thread-priority thread-priority-set! numa-node-cpus
 
           mutex? make-mutex mutex-name mutex-state
           mutex-specific-set! mutex-specific
           with-locking-mutex mutex-lock! mutex-unlock!
-          mutex-locker mutex-unlocker
+          mutex-locker mutex-unlocker make-adaptive-mutex
+
+          rwlock? make-rwlock rwlock-name rwlock-state
+          rwlock-specific rwlock-specific-set!
+          rwlock-read-lock! rwlock-read-unlock!
+          rwlock-write-lock! rwlock-write-unlock!
+          with-rwlock-read-lock with-rwlock-write-lock
 
           condition-variable? make-condition-variable condition-variable-name
           condition-variable-specific condition-variable-specific-set!
@@ -53,7 +61,14 @@
           terminated-thread-exception? uncaught-exception?
           uncaught-exception-reason
 
-          atom atom? atom-ref atomic atomic-update!))
+          atom atom? atom-ref atomic atomic-update!
+
+          <atomic-box> make-atomic-box atomic-box? atomic-box-ref
+          atomic-box-set! atomic-box-swap! atomic-box-cas!
+          <atomic-fxbox> make-atomic-fxbox atomic-fxbox? atomic-fxbox-ref
+          atomic-fxbox-set! atomic-fxbox-swap! atomic-fxbox-cas!
+          atomic-fxbox-fetch-add! atomic-fxbox-fetch-sub!
+          vector-cas! uvector-cas!))
 (select-module gauche.threads)
 
 (inline-stub
@@ -100,8 +115,16 @@
      (slot-ref thread 'specific))
    thread-specific-set!))
 
-(define (make-thread thunk :optional (name #f))
-  (rlet1 t (%make-thread thunk name)
+(define (make-thread thunk :optional (name #f) (stack-size 0)
+                     :key (affinity #f) (priority #f))
+  ;; Affinity and priority are set by the new thread itself, so that
+  ;; they're in effect before THUNK runs.
+  (define (body)
+    (when affinity (thread-affinity-set! (current-thread) affinity))
+    (when priority (thread-priority-set! (current-thread) priority))
+    (thunk))
+  (rlet1 t (%make-thread (if (or affinity priority) body thunk)
+                         name stack-size)
     ((with-module gauche.internal %vm-custom-error-reporter-set!) t (^e #f))))
 
 (inline-stub
@@ -114,13 +137,14 @@
      [else (Scm_Error "[internal] thread state has invalid value: %d"
                       (-> vm state))]))
 
- (define-cproc %make-thread (thunk::<procedure> name) Scm_MakeThread)
+ (define-cproc %make-thread (thunk::<procedure> name stack-size::<long>)
+   Scm_MakeThreadWithStackSize)
 
  (define-cproc thread-start! (vm::<thread>) Scm_ThreadStart)
 
  (define-cproc thread-yield! () ::<void> Scm_YieldCPU)
 
- (define-cproc thread-sleep! (timeout) Scm_ThreadSleep)
+ (define-cproc %thread-sleep! (timeout) Scm_ThreadSleep)
 
  (define-cproc thread-join! (vm::<thread> :optional (timeout #f) timeout-val)
    Scm_ThreadJoin)
@@ -132,8 +156,56 @@
    Scm_ThreadStop)
 
  (define-cproc thread-cont! (target::<thread>) Scm_ThreadCont)
+
+ (define-cproc thread-affinity (vm::<thread>) Scm_ThreadAffinity)
+ (define-cproc thread-affinity-set! (vm::<thread> cpus) ::<void>
+   Scm_ThreadAffinitySet)
+ (define-cproc thread-priority (vm::<thread>) Scm_ThreadPriority)
+ (define-cproc thread-priority-set! (vm::<thread> priority::<int>) ::<void>
+   Scm_ThreadPrioritySet)
  )
 
+;; Returns a list of CPU lists, one for each NUMA node.  If the system
+;; doesn't tell us the topology, all CPUs are regarded to be in one node.
+(define (numa-node-cpus)
+  (define (parse-cpulist str)           ; "0-3,8-11"
+    (append-map (^[range]
+                  (let1 ns (map string->number (string-split range #\-))
+                    (cond [(not (every integer? ns)) '()]
+                          [(= (length ns) 1) ns]
+                          [(= (length ns) 2)
+                           (iota (+ (- (cadr ns) (car ns)) 1) (car ns))]
+                          [else '()])))
+                (string-split str #\,)))
+  (define (node-cpus path)
+    (guard (e [(<system-error> e) '()])
+      (let1 line (with-input-from-file path read-line)
+        (if (string? line) (parse-cpulist line) '()))))
+  (let* ([dir "/sys/devices/system/node"]
+         [nodes (if (file-is-directory? dir)
+                  (sort (filter-map (^[name]
+                                      (and-let* ([m (#/^node(\d+)$/ name)])
+                                        (string->number (m 1))))
+                                    (sys-readdir dir)))
+                  '())]
+         [cpus (remove null?
+                       (map (^n (node-cpus #"~|dir|/node~|n|/cpulist"))
+                            nodes))])
+    (if (null? cpus)
+      (list (iota (sys-available-processors)))
+      cpus)))
+
+;; User-level schedulers (e.g. control.fiber) can install a hook to make
+;; thread-sleep! suspend the running task instead of the thread.  The
+;; hook returns #f if it doesn't handle the call.
+(define %thread-sleep-hook #f)
+(define (%set-thread-sleep-hook! proc) (set! %thread-sleep-hook proc))
+
+(define (thread-sleep! timeout)
+  (unless (and %thread-sleep-hook (%thread-sleep-hook timeout))
+    (%thread-sleep! timeout))
+  (undefined))
+
 ;;===============================================================
 ;; Mutex
 ;;
@@ -167,6 +239,8 @@
 
 (inline-stub
  (define-cproc make-mutex (:optional (name #f)) Scm_MakeMutex)
+ (define-cproc make-adaptive-mutex (:optional (name #f) (spin-count::<int> 100))
+   Scm_MakeAdaptiveMutex)
 
  (define-cise-stmt with-mutex
    [(_ mutex . form)
@@ -192,6 +266,56 @@
  (define-cproc mutex-unlocker (mutex::<mutex>) Scm_MutexUnlocker)
  )
 
+;;===============================================================
+;; Reader/writer lock
+;;
+
+(define (rwlock? obj) (is-a? obj <rwlock>))
+
+(define (rwlock-name rw)
+  (check-arg rwlock? rw)
+  (slot-ref rw 'name))
+
+(define (rwlock-state rw)
+  (check-arg rwlock? rw)
+  (slot-ref rw 'state))
+
+(define (rwlock-specific-set! rw value)
+  (check-arg rwlock? rw)
+  (slot-set! rw 'specific value))
+
+(define rwlock-specific
+  (getter-with-setter
+   (^[rw]
+     (check-arg rwlock? rw)
+     (slot-ref rw 'specific))
+   rwlock-specific-set!))
+
+(inline-stub
+ (define-type <rwlock> "ScmRWLock*" "rwlock" "SCM_RWLOCKP" "SCM_RWLOCK")
+
+ (define-cproc make-rwlock (:optional (name #f)) Scm_MakeRWLock)
+
+ (define-cproc rwlock-read-lock! (rw::<rwlock> :optional (timeout #f))
+   Scm_RWLockReadLock)
+ (define-cproc rwlock-read-unlock! (rw::<rwlock>) Scm_RWLockReadUnlock)
+ (define-cproc rwlock-write-lock! (rw::<rwlock> :optional (timeout #f))
+   Scm_RWLockWriteLock)
+ (define-cproc rwlock-write-unlock! (rw::<rwlock>) Scm_RWLockWriteUnlock)
+ )
+
+(define (with-rwlock-read-lock rw thunk)
+  (dynamic-wind
+      (^[] (rwlock-read-lock! rw))
+      thunk
+      (^[] (rwlock-read-unlock! rw))))
+
+(define (with-rwlock-write-lock rw thunk)
+  (dynamic-wind
+      (^[] (rwlock-write-lock! rw))
+      thunk
+      (^[] (rwlock-write-unlock! rw))))
+
 ;;===============================================================
 ;; Condition variable
 ;;
@@ -290,3 +414,153 @@
 (define (atom-ref atom :optional (index 0) (timeout #f) (timeout-val #f))
   (unless (atom? atom) (error "atom required, but got:" atom))
   ((atom-applier atom) (^ xs (list-ref xs index)) timeout timeout-val))
+
+;;===============================================================
+;; Atomic boxes and atomic element updates
+;;
+
+;; Unlike atoms, these don't use a mutex; each operation is a single
+;; atomic instruction (provided by libatomic_ops), so they are suitable
+;; for counters and flags shared by many threads.  Note that the
+;; comparison in compare-and-swap is eq?.
+
+(inline-stub
+ "#include \"atomic_ops.h\""
+
+ "typedef struct ScmAtomicBoxRec {
+    SCM_HEADER;
+    volatile AO_t value;        /* ScmObj */
+  } ScmAtomicBox;"
+
+ "typedef struct ScmAtomicFxboxRec {
+    SCM_HEADER;
+    volatile AO_t value;        /* C long */
+  } ScmAtomicFxbox;"
+
+ (define-cclass <atomic-box> :private ScmAtomicBox* "Scm_AtomicBoxClass" ()
+   ()
+   [printer
+    (Scm_Printf port "#<atomic-box %S>"
+                (cast ScmObj (AO_load (& (-> (SCM_ATOMIC_BOX obj) value)))))])
+
+ (define-cclass <atomic-fxbox> :private ScmAtomicFxbox* "Scm_AtomicFxboxClass"
+   ()
+   ()
+   [printer
+    (Scm_Printf port "#<atomic-fxbox %ld>"
+                (cast long (AO_load (& (-> (SCM_ATOMIC_FXBOX obj) value)))))])
+
+ (define-cproc make-atomic-box (:optional (value #f))
+   (let* ([z::ScmAtomicBox* (SCM_NEW ScmAtomicBox)])
+     (SCM_SET_CLASS z SCM_CLASS_ATOMIC_BOX)
+     (AO_store_release (& (-> z value)) (cast AO_t value))
+     (return (SCM_OBJ z))))
+
+ (define-cproc atomic-box-ref (b::<atomic-box>)
+   (return (cast ScmObj (AO_load_acquire (& (-> b value))))))
+
+ (define-cproc atomic-box-set! (b::<atomic-box> value) ::<void>
+   (AO_store_release (& (-> b value)) (cast AO_t value)))
+
+ (define-cproc atomic-box-swap! (b::<atomic-box> value)
+   (let* ([old::AO_t])
+     (while TRUE
+       (set! old (AO_load (& (-> b value))))
+       (when (AO_compare_and_swap_full (& (-> b value)) old (cast AO_t value))
+         (break)))
+     (return (cast ScmObj old))))
+
+ (define-cproc atomic-box-cas! (b::<atomic-box> expected value) ::<boolean>
+   (return (AO_compare_and_swap_full (& (-> b value))
+                                     (cast AO_t expected)
+                                     (cast AO_t value))))
+
+ ;; The value of fxbox is kept as a C long, so arithmetic wraps around
+ ;; at machine word size.
+ (define-cproc make-atomic-fxbox (:optional (value::<fixnum> 0))
+   (let* ([z::ScmAtomicFxbox* (SCM_NEW_ATOMIC ScmAtomicFxbox)])
+     (SCM_SET_CLASS z SCM_CLASS_ATOMIC_FXBOX)
+     (AO_store_release (& (-> z value)) (cast AO_t value))
+     (return (SCM_OBJ z))))
+
+ (define-cproc atomic-fxbox-ref (b::<atomic-fxbox>)
+   (return (Scm_MakeInteger (cast long (AO_load_acquire (& (-> b value)))))))
+
+ (define-cproc atomic-fxbox-set! (b::<atomic-fxbox> value::<fixnum>) ::<void>
+   (AO_store_release (& (-> b value)) (cast AO_t value)))
+
+ (define-cproc atomic-fxbox-swap! (b::<atomic-fxbox> value::<fixnum>)
+   (let* ([old::AO_t])
+     (while TRUE
+       (set! old (AO_load (& (-> b value))))
+       (when (AO_compare_and_swap_full (& (-> b value)) old (cast AO_t value))
+         (break)))
+     (return (Scm_MakeInteger (cast long old)))))
+
+ (define-cproc atomic-fxbox-cas! (b::<atomic-fxbox>
+                                  expected::<fixnum> value::<fixnum>)
+   ::<boolean>
+   (return (AO_compare_and_swap_full (& (-> b value))
+                                     (cast AO_t expected)
+                                     (cast AO_t value))))
+
+ ;; Returns the value before addition.
+ (define-cproc atomic-fxbox-fetch-add! (b::<atomic-fxbox>
+                                        :optional (delta::<fixnum> 1))
+   (return (Scm_MakeInteger
+            (cast long (AO_fetch_and_add_full (& (-> b value))
+                                              (cast AO_t delta))))))
+
+ (define-cproc atomic-fxbox-fetch-sub! (b::<atomic-fxbox>
+                                        :optional (delta::<fixnum> 1))
+   (return (Scm_MakeInteger
+            (cast long (AO_fetch_and_add_full (& (-> b value))
+                                              (cast AO_t (- delta)))))))
+
+ ;; CAS on a vector element.
+ (define-cproc vector-cas! (v::<vector> k::<fixnum> expected value)
+   ::<boolean>
+   (unless (and (<= 0 k) (< k (SCM_VECTOR_SIZE v)))
+     (Scm_Error "index out of range: %ld" k))
+   (return (AO_compare_and_swap_full
+            (cast (volatile AO_t*) (+ (SCM_VECTOR_ELEMENTS v) k))
+            (cast AO_t expected)
+            (cast AO_t value))))
+
+ ;; CAS on an element of s32, u32, s64 or u64 vector.  The latter two
+ ;; are only supported when the machine word is 64bit.
+ (define-cproc uvector-cas! (v::<uvector> k::<fixnum> expected value)
+   ::<boolean>
+   (SCM_UVECTOR_CHECK_MUTABLE v)
+   (unless (and (<= 0 k) (< k (SCM_UVECTOR_SIZE v)))
+     (Scm_Error "index out of range: %ld" k))
+   (case (Scm_UVectorType (SCM_CLASS_OF v))
+     [(SCM_UVECTOR_S32 SCM_UVECTOR_U32)
+      (.if "defined(AO_HAVE_int_compare_and_swap_full)"
+           (let* ([e::ScmUInt32] [n::ScmUInt32])
+             (if (== (Scm_UVectorType (SCM_CLASS_OF v)) SCM_UVECTOR_S32)
+               (set! e (cast ScmUInt32 (Scm_GetInteger32Clamp expected SCM_CLAMP_ERROR NULL))
+                     n (cast ScmUInt32 (Scm_GetInteger32Clamp value SCM_CLAMP_ERROR NULL)))
+               (set! e (Scm_GetIntegerU32Clamp expected SCM_CLAMP_ERROR NULL)
+                     n (Scm_GetIntegerU32Clamp value SCM_CLAMP_ERROR NULL)))
+             (return (AO_int_compare_and_swap_full
+                      (+ (cast (volatile unsigned int*) (SCM_UVECTOR_ELEMENTS v))
+                         k)
+                      e n))))]
+     [(SCM_UVECTOR_S64 SCM_UVECTOR_U64)
+      (when (== (sizeof (.type AO_t)) 8)
+        (let* ([e::ScmUInt64] [n::ScmUInt64])
+          (if (== (Scm_UVectorType (SCM_CLASS_OF v)) SCM_UVECTOR_S64)
+            (set! e (cast ScmUInt64 (Scm_GetInteger64Clamp expected SCM_CLAMP_ERROR NULL))
+                  n (cast ScmUInt64 (Scm_GetInteger64Clamp value SCM_CLAMP_ERROR NULL)))
+            (set! e (Scm_GetIntegerU64Clamp expected SCM_CLAMP_ERROR NULL)
+                  n (Scm_GetIntegerU64Clamp value SCM_CLAMP_ERROR NULL)))
+          (return (AO_compare_and_swap_full
+                   (+ (cast (volatile AO_t*) (SCM_UVECTOR_ELEMENTS v)) k)
+                   (cast AO_t e) (cast AO_t n)))))])
+   (Scm_Error "uvector-cas! doesn't support %S" v)
+   (return FALSE))
+ )
+
+(define (atomic-box? obj) (is-a? obj <atomic-box>))
+(define (atomic-fxbox? obj) (is-a? obj <atomic-fxbox>))
@@ -44,6 +44,12 @@
 #if defined(GAUCHE_USE_AXTLS)
 #include "axTLS/ssl/ssl.h"
 #else /*!GAUCHE_USE_AXTLS*/
+#if defined(GAUCHE_USE_OPENSSL)
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#endif /*GAUCHE_USE_OPENSSL*/
+/* Flags and object types are the same as axTLS, so that the Scheme
+   code doesn't need to care about the backend. */
 #define SSL_CLIENT_AUTHENTICATION               0x00010000
 #define SSL_SERVER_VERIFY_LATER                 0x00020000
 #define SSL_NO_DEFAULT_KEY                      0x00040000
@@ -67,7 +73,18 @@ typedef struct ScmTLSRec {
   SSL_CTX* ctx;
   SSL* conn;
   ScmPort* in_port, * out_port;
-#endif /*GAUCHE_USE_AXTLS*/
+  /* Session id of the last client connection, to resume the session
+     on the next connect. */
+  uint8_t session_id[SSL_SESSION_ID_SIZE];
+  int session_id_size;
+  int session_reused;
+#elif defined(GAUCHE_USE_OPENSSL)
+  SSL_CTX* ctx;                 /* may be shared by tls-clone */
+  SSL* conn;
+  ScmPort* in_port, * out_port;
+  uint32_t options;
+  SSL_SESSION* session;         /* last client session, for resumption */
+#endif /*GAUCHE_USE_OPENSSL*/
 } ScmTLS;
 
 SCM_CLASS_DECL(Scm_TLSClass);
@@ -77,6 +94,7 @@ SCM_CLASS_DECL(Scm_TLSClass);
 #define SCM_TLSP(obj)   SCM_XTYPEP(obj, SCM_CLASS_TLS)
 
 extern ScmObj Scm_MakeTLS(uint32_t options, int num_sessions);
+extern ScmObj Scm_TLSClone(ScmTLS* t);
 extern ScmObj Scm_TLSDestroy(ScmTLS* t);
 extern ScmObj Scm_TLSLoadObject(ScmTLS* t, ScmObj obj_type,
                                 const char *filename,
@@ -84,6 +102,7 @@ extern ScmObj Scm_TLSLoadObject(ScmTLS* t, ScmObj obj_type,
 extern ScmObj Scm_TLSConnect(ScmTLS* t, int fd);
 extern ScmObj Scm_TLSAccept(ScmTLS* t, int fd);
 extern ScmObj Scm_TLSClose(ScmTLS* t);
+extern int    Scm_TLSSessionReused(ScmTLS* t);
 
 /*
    KZ: presumably due to block sizes imposed by the crypto algorithms
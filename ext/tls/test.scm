@@ -64,6 +64,60 @@
                        :output "ssltest.log"
                        :wait #t)))
   ]
+ [(and gauche.net.tls.openssl gauche.sys.threads)
+  ;; Loopback test with a self-signed certificate, checking that the
+  ;; second connection resumes the session.
+  (use gauche.net)
+  (use gauche.threads)
+
+  (define (make-test-cert)
+    (guard (e [(<process-abnormal-exit> e) #f]
+              [(<system-error> e) #f])
+      (run-process '("openssl" "req" "-x509" "-newkey" "rsa:2048" "-nodes"
+                     "-keyout" "test.key" "-out" "test.crt" "-days" "1"
+                     "-subj" "/CN=localhost")
+                   :output :null :error :null :wait #t)
+      (file-exists? "test.crt")))
+
+  (if (not (make-test-cert))
+    (warn "couldn't create a test certificate: loopback tests are skipped.\n")
+    (let* ([server-tls (make-tls SSL_SERVER_VERIFY_LATER 16)]
+           [server (make-server-socket 'inet 0 :reuse-addr? #t)]
+           [port (sockaddr-port (socket-address server))]
+           [serve (^[]
+                    (let* ([s (socket-accept server)]
+                           [t (tls-clone server-tls)])
+                      (tls-accept t (socket-fd s))
+                      (let1 line (read-line (tls-input-port t))
+                        (display #"~|line|\n" (tls-output-port t))
+                        (flush (tls-output-port t)))
+                      (tls-close t)
+                      (tls-destroy t)
+                      (socket-close s)))]
+           [th (thread-start! (make-thread (^[] (serve) (serve))))]
+           [client-tls (make-tls)]
+           [talk (^[msg]
+                   (let1 s (make-client-socket 'inet "127.0.0.1" port)
+                     (tls-connect client-tls (socket-fd s))
+                     (display #"~|msg|\n" (tls-output-port client-tls))
+                     (flush (tls-output-port client-tls))
+                     (begin0 (list (read-line (tls-input-port client-tls))
+                                   (tls-session-reused? client-tls))
+                       (tls-close client-tls)
+                       (socket-close s))))])
+      (test* "load certificate" #t
+             (tls-load-object server-tls SSL_OBJ_X509_CERT "test.crt"))
+      (test* "load private key" #t
+             (tls-load-object server-tls SSL_OBJ_RSA_KEY "test.key"))
+      (test* "connect" '("hello" #f) (talk "hello"))
+      (test* "session resumption" '("again" #t) (talk "again"))
+      (thread-join! th)
+      (tls-destroy client-tls)
+      (tls-destroy server-tls)
+      (socket-close server)
+      (sys-unlink "test.crt")
+      (sys-unlink "test.key")))
+  ]
  [else])
 
 (test-end)
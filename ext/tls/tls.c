@@ -33,6 +33,11 @@
 
 #include "gauche-tls.h"
 #include <gauche/extend.h>
+#include <string.h>
+
+#if defined(GAUCHE_USE_AXTLS) || defined(GAUCHE_USE_OPENSSL)
+#define HAVE_TLS_BACKEND 1
+#endif
 
 static void tls_print(ScmObj obj, ScmPort* port, ScmWriteContext* ctx);
 
@@ -55,22 +60,67 @@ static void tls_finalize(ScmObj obj, void* data)
         ssl_ctx_free(t->ctx);
         t->ctx = NULL;
     }
-#endif /*GAUCHE_USE_AXTLS*/
+#elif defined(GAUCHE_USE_OPENSSL)
+    if (t->ctx) {
+        Scm_TLSClose(t);
+        /* The context is reference-counted, so the clones sharing it
+           aren't affected. */
+        SSL_CTX_free(t->ctx);
+        t->ctx = NULL;
+    }
+    if (t->session) {
+        SSL_SESSION_free(t->session);
+        t->session = NULL;
+    }
+#endif /*GAUCHE_USE_OPENSSL*/
 }
 
 static void context_check(ScmTLS* tls, const char* op)
 {
-#if defined(GAUCHE_USE_AXTLS)
+#if defined(HAVE_TLS_BACKEND)
     if (!tls->ctx) Scm_Error("attempt to %s destroyed TLS: %S", op, tls);
-#endif /*GAUCHE_USE_AXTLS*/
+#endif /*HAVE_TLS_BACKEND*/
 }
 
 static void close_check(ScmTLS* tls, const char* op)
 {
-#if defined(GAUCHE_USE_AXTLS)
+#if defined(HAVE_TLS_BACKEND)
     if (!tls->conn) Scm_Error("attempt to %s closed TLS: %S", op, tls);
-#endif /*GAUCHE_USE_AXTLS*/
+#endif /*HAVE_TLS_BACKEND*/
+}
+
+#if defined(GAUCHE_USE_OPENSSL)
+/* Raise an error with the message from OpenSSL's error queue, if any. */
+static void openssl_error(const char *msg)
+{
+    unsigned long e = ERR_get_error();
+    if (e) {
+        char buf[256];
+        ERR_error_string_n(e, buf, sizeof(buf));
+        ERR_clear_error();
+        Scm_Error("%s: %s", msg, buf);
+    } else {
+        Scm_SysError("%s", msg);
+    }
+}
+
+static void openssl_init_context(ScmTLS* t, int num_sessions)
+{
+    t->ctx = SSL_CTX_new(TLS_method());
+    if (!t->ctx) openssl_error("SSL_CTX_new() failed");
+    SSL_CTX_set_default_verify_paths(t->ctx);
+    /* The server side session cache lives in the context, so it is
+       shared among the TLS objects created by tls-clone.  Session tickets
+       are issued regardless of the cache. */
+    SSL_CTX_set_session_id_context(t->ctx, (const unsigned char*)"gauche", 6);
+    if (num_sessions > 0) {
+        SSL_CTX_set_session_cache_mode(t->ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(t->ctx, num_sessions);
+    } else {
+        SSL_CTX_set_session_cache_mode(t->ctx, SSL_SESS_CACHE_OFF);
+    }
 }
+#endif /*GAUCHE_USE_OPENSSL*/
 
 ScmObj Scm_MakeTLS(uint32_t options, int num_sessions)
 {
@@ -80,19 +130,54 @@ ScmObj Scm_MakeTLS(uint32_t options, int num_sessions)
     t->ctx = ssl_ctx_new(options, num_sessions);
     t->conn = NULL;
     t->in_port = t->out_port = 0;
-#endif /*GAUCHE_USE_AXTLS*/
+    t->session_id_size = 0;
+    t->session_reused = FALSE;
+#elif defined(GAUCHE_USE_OPENSSL)
+    t->conn = NULL;
+    t->in_port = t->out_port = 0;
+    t->options = options;
+    t->session = NULL;
+    openssl_init_context(t, num_sessions);
+#endif /*GAUCHE_USE_OPENSSL*/
     Scm_RegisterFinalizer(SCM_OBJ(t), tls_finalize, NULL);
     return SCM_OBJ(t);
 }
 
+/* Creates a new TLS object sharing the context of T, i.e. the loaded
+   certificates and keys, and the session cache.  A server can clone
+   one configured TLS for each accepted connection so that clients can
+   resume their sessions. */
+ScmObj Scm_TLSClone(ScmTLS* t)
+{
+    context_check(t, "clone");
+#if defined(GAUCHE_USE_OPENSSL)
+    ScmTLS* c = SCM_NEW(ScmTLS);
+    SCM_SET_CLASS(c, SCM_CLASS_TLS);
+    SSL_CTX_up_ref(t->ctx);
+    c->ctx = t->ctx;
+    c->conn = NULL;
+    c->in_port = c->out_port = 0;
+    c->options = t->options;
+    c->session = t->session;
+    if (c->session) SSL_SESSION_up_ref(c->session);
+    Scm_RegisterFinalizer(SCM_OBJ(c), tls_finalize, NULL);
+    return SCM_OBJ(c);
+#elif defined(GAUCHE_USE_AXTLS)
+    Scm_Error("tls-clone isn't supported by the axTLS backend");
+    return SCM_UNDEFINED;       /* dummy */
+#else  /*!HAVE_TLS_BACKEND*/
+    return Scm_MakeTLS(0, 0);
+#endif /*!HAVE_TLS_BACKEND*/
+}
+
 /* Explicitly destroys the context.  The axtls context holds open fd for
    /dev/urandom, and sometimes gc isn't called early enough before we use
    up all fds, so explicit destruction is recommended whenever possible. */
 ScmObj Scm_TLSDestroy(ScmTLS* t)
 {
-#if defined(GAUCHE_USE_AXTLS)
+#if defined(HAVE_TLS_BACKEND)
     tls_finalize(SCM_OBJ(t), NULL);
-#endif /*GAUCHE_USE_AXTLS*/
+#endif /*HAVE_TLS_BACKEND*/
     return SCM_TRUE;
 }
 
@@ -104,7 +189,26 @@ ScmObj Scm_TLSClose(ScmTLS* t)
         t->conn = 0;
         t->in_port = t->out_port = 0;
     }
-#endif /*GAUCHE_USE_AXTLS*/
+#elif defined(GAUCHE_USE_OPENSSL)
+    if (t->ctx && t->conn) {
+        /* Keep the client session so that the next tls-connect can
+           resume it. */
+        if (!SSL_is_server(t->conn)) {
+            SSL_SESSION* s = SSL_get1_session(t->conn);
+            if (s && SSL_SESSION_is_resumable(s)) {
+                if (t->session) SSL_SESSION_free(t->session);
+                t->session = s;
+            } else if (s) {
+                SSL_SESSION_free(s);
+            }
+        }
+        SSL_shutdown(t->conn);
+        SSL_free(t->conn);
+        ERR_clear_error();
+        t->conn = 0;
+        t->in_port = t->out_port = 0;
+    }
+#endif /*GAUCHE_USE_OPENSSL*/
     return SCM_TRUE;
 }
 
@@ -115,7 +219,32 @@ ScmObj Scm_TLSLoadObject(ScmTLS* t, ScmObj obj_type,
     uint32_t type = Scm_GetIntegerU32Clamp(obj_type, SCM_CLAMP_ERROR, NULL);
     if (ssl_obj_load(t->ctx, type, filename, password) == SSL_OK)
         return SCM_TRUE;
-#endif /*GAUCHE_USE_AXTLS*/
+#elif defined(GAUCHE_USE_OPENSSL)
+    uint32_t type = Scm_GetIntegerU32Clamp(obj_type, SCM_CLAMP_ERROR, NULL);
+    int r = 0;
+    context_check(t, "load object into");
+    switch (type) {
+    case SSL_OBJ_X509_CERT:
+        r = SSL_CTX_use_certificate_chain_file(t->ctx, filename);
+        break;
+    case SSL_OBJ_X509_CACERT:
+        r = SSL_CTX_load_verify_locations(t->ctx, filename, NULL);
+        break;
+    case SSL_OBJ_RSA_KEY:
+    case SSL_OBJ_PKCS8:
+        /* The default PEM password callback uses the userdata as
+           the password. */
+        SSL_CTX_set_default_passwd_cb_userdata(t->ctx, (void*)password);
+        r = SSL_CTX_use_PrivateKey_file(t->ctx, filename, SSL_FILETYPE_PEM);
+        SSL_CTX_set_default_passwd_cb_userdata(t->ctx, NULL);
+        break;
+    default:
+        /* PKCS12 isn't supported yet. */
+        break;
+    }
+    ERR_clear_error();
+    if (r == 1) return SCM_TRUE;
+#endif /*GAUCHE_USE_OPENSSL*/
     return SCM_FALSE;
 }
 
@@ -124,12 +253,44 @@ ScmObj Scm_TLSConnect(ScmTLS* t, int fd)
 #if defined(GAUCHE_USE_AXTLS)
     context_check(t, "connect");
     if (t->conn) Scm_SysError("attempt to connect already-connected TLS %S", t);
-    t->conn = ssl_client_new(t->ctx, fd, 0, 0);
+    t->conn = ssl_client_new(t->ctx, fd,
+                             (t->session_id_size > 0 ? t->session_id : NULL),
+                             t->session_id_size);
     int r = ssl_handshake_status(t->conn);
     if (r != SSL_OK) {
         Scm_Error("TLS handshake failed: %d", r);
     }
-#endif /*GAUCHE_USE_AXTLS*/
+    /* axTLS doesn't tell us whether the session is resumed, but the server
+       echoes the session id we sent iff it does. */
+    const uint8_t* id = ssl_get_session_id(t->conn);
+    int id_size = ssl_get_session_id_size(t->conn);
+    t->session_reused = (id_size > 0 && id_size == t->session_id_size
+                         && memcmp(id, t->session_id, id_size) == 0);
+    memcpy(t->session_id, id, id_size);
+    t->session_id_size = id_size;
+#elif defined(GAUCHE_USE_OPENSSL)
+    context_check(t, "connect");
+    if (t->conn) Scm_SysError("attempt to connect already-connected TLS %S", t);
+    SSL* conn = SSL_new(t->ctx);
+    if (!conn) openssl_error("SSL_new() failed");
+    SSL_set_verify(conn,
+                   ((t->options & SSL_SERVER_VERIFY_LATER)
+                    ? SSL_VERIFY_NONE : SSL_VERIFY_PEER),
+                   NULL);
+    if (t->session) SSL_set_session(conn, t->session);
+    if (!SSL_set_fd(conn, fd)) {
+        SSL_free(conn);
+        openssl_error("SSL_set_fd() failed");
+    }
+    int r = SSL_connect(conn);
+    if (r != 1) {
+        int e = SSL_get_error(conn, r);
+        SSL_free(conn);
+        if (ERR_peek_error()) openssl_error("TLS handshake failed");
+        Scm_Error("TLS handshake failed: %d", e);
+    }
+    t->conn = conn;
+#endif /*GAUCHE_USE_OPENSSL*/
     return SCM_OBJ(t);
 }
 
@@ -139,10 +300,49 @@ ScmObj Scm_TLSAccept(ScmTLS* t, int fd)
     context_check(t, "accept");
     if (t->conn) Scm_SysError("attempt to connect already-connected TLS %S", t);
     t->conn = ssl_server_new(t->ctx, fd);
-#endif /*GAUCHE_USE_AXTLS*/
+    t->session_reused = FALSE;
+#elif defined(GAUCHE_USE_OPENSSL)
+    context_check(t, "accept");
+    if (t->conn) Scm_SysError("attempt to connect already-connected TLS %S", t);
+    SSL* conn = SSL_new(t->ctx);
+    if (!conn) openssl_error("SSL_new() failed");
+    SSL_set_verify(conn,
+                   ((t->options & SSL_CLIENT_AUTHENTICATION)
+                    ? SSL_VERIFY_PEER|SSL_VERIFY_FAIL_IF_NO_PEER_CERT
+                    : SSL_VERIFY_NONE),
+                   NULL);
+    if (!SSL_set_fd(conn, fd)) {
+        SSL_free(conn);
+        openssl_error("SSL_set_fd() failed");
+    }
+    int r = SSL_accept(conn);
+    if (r != 1) {
+        int e = SSL_get_error(conn, r);
+        SSL_free(conn);
+        if (ERR_peek_error()) openssl_error("TLS handshake failed");
+        Scm_Error("TLS handshake failed: %d", e);
+    }
+    t->conn = conn;
+#endif /*GAUCHE_USE_OPENSSL*/
     return SCM_OBJ(t);
 }
 
+/* Returns TRUE iff the current connection resumed a previous session. */
+int Scm_TLSSessionReused(ScmTLS* t)
+{
+#if defined(GAUCHE_USE_AXTLS)
+    return t->conn && t->session_reused;
+#elif defined(GAUCHE_USE_OPENSSL)
+    return t->conn && SSL_session_reused(t->conn);
+#else  /*!HAVE_TLS_BACKEND*/
+    return FALSE;
+#endif /*!HAVE_TLS_BACKEND*/
+}
+
+#if defined(GAUCHE_USE_OPENSSL)
+#define TLS_READ_BUFSIZ 16384   /* max TLS record size */
+#endif
+
 ScmObj Scm_TLSRead(ScmTLS* t)
 {
 #if defined(GAUCHE_USE_AXTLS)
@@ -150,14 +350,36 @@ ScmObj Scm_TLSRead(ScmTLS* t)
     close_check(t, "read");
     int r; uint8_t* buf;
     while ((r = ssl_read(t->conn, &buf)) == SSL_OK);
+    if (r == SSL_CLOSE_NOTIFY) return SCM_EOF;
     if (r < 0) Scm_SysError("ssl_read() failed");
     return Scm_MakeString((char*) buf, r, r, SCM_STRING_INCOMPLETE);
-#else  /*!GAUCHE_USE_AXTLS*/
+#elif defined(GAUCHE_USE_OPENSSL)
+    context_check(t, "read");
+    close_check(t, "read");
+    char buf[TLS_READ_BUFSIZ];
+    int r;
+    for (;;) {
+        r = SSL_read(t->conn, buf, TLS_READ_BUFSIZ);
+        if (r > 0) break;
+        int e = SSL_get_error(t->conn, r);
+        if (e == SSL_ERROR_ZERO_RETURN) return SCM_EOF;
+        if (e == SSL_ERROR_SYSCALL && ERR_peek_error() == 0) {
+            if (r == 0) return SCM_EOF; /* peer closed without close_notify */
+            if (errno == EINTR) {
+                Scm_SigCheck(Scm_VM());
+                continue;
+            }
+        }
+        openssl_error("SSL_read() failed");
+    }
+    return Scm_MakeString(buf, r, r,
+                          SCM_STRING_INCOMPLETE|SCM_STRING_COPYING);
+#else  /*!HAVE_TLS_BACKEND*/
     return SCM_FALSE;
-#endif /*!GAUCHE_USE_AXTLS*/
+#endif /*!HAVE_TLS_BACKEND*/
 }
 
-#if defined(GAUCHE_USE_AXTLS)
+#if defined(HAVE_TLS_BACKEND)
 static const uint8_t* get_message_body(ScmObj msg, u_int *size)
 {
     if (SCM_UVECTORP(msg)) {
@@ -171,7 +393,7 @@ static const uint8_t* get_message_body(ScmObj msg, u_int *size)
         return 0;
     }
 }
-#endif /*GAUCHE_USE_AXTLS*/
+#endif /*HAVE_TLS_BACKEND*/
 
 ScmObj Scm_TLSWrite(ScmTLS* t, ScmObj msg)
 {
@@ -185,42 +407,68 @@ ScmObj Scm_TLSWrite(ScmTLS* t, ScmObj msg)
         Scm_SysError("ssl_write() failed");
     }
     return SCM_MAKE_INT(r);
-#else  /*!GAUCHE_USE_AXTLS*/
+#elif defined(GAUCHE_USE_OPENSSL)
+    context_check(t, "write");
+    close_check(t, "write");
+    u_int size;
+    const uint8_t* cmsg = get_message_body(msg, &size);
+    if (size == 0) return SCM_MAKE_INT(0);
+    /* Without SSL_MODE_ENABLE_PARTIAL_WRITE, SSL_write writes
+       everything or fails. */
+    for (;;) {
+        int r = SSL_write(t->conn, cmsg, (int)size);
+        if (r > 0) break;
+        int e = SSL_get_error(t->conn, r);
+        if (e == SSL_ERROR_SYSCALL && ERR_peek_error() == 0 && errno == EINTR) {
+            Scm_SigCheck(Scm_VM());
+            continue;
+        }
+        openssl_error("SSL_write() failed");
+    }
+    return SCM_MAKE_INT(size);
+#else  /*!HAVE_TLS_BACKEND*/
     return SCM_FALSE;
-#endif /*!GAUCHE_USE_AXTLS*/
+#endif /*!HAVE_TLS_BACKEND*/
 }
 
 ScmObj Scm_TLSInputPort(ScmTLS* t)
 {
-#if defined(GAUCHE_USE_AXTLS)
+#if defined(HAVE_TLS_BACKEND)
     return SCM_OBJ(t->in_port);
-#endif /*GAUCHE_USE_AXTLS*/
+#else  /*!HAVE_TLS_BACKEND*/
+    return SCM_FALSE;
+#endif /*!HAVE_TLS_BACKEND*/
 }
 
 ScmObj Scm_TLSOutputPort(ScmTLS* t)
 {
-#if defined(GAUCHE_USE_AXTLS)
+#if defined(HAVE_TLS_BACKEND)
     return SCM_OBJ(t->out_port);
-#endif /*GAUCHE_USE_AXTLS*/
+#else  /*!HAVE_TLS_BACKEND*/
+    return SCM_FALSE;
+#endif /*!HAVE_TLS_BACKEND*/
 }
 
 ScmObj Scm_TLSInputPortSet(ScmTLS* t, ScmObj port)
 {
-#if defined(GAUCHE_USE_AXTLS)
+#if defined(HAVE_TLS_BACKEND)
     t->in_port = SCM_PORT(port);
-#endif /*GAUCHE_USE_AXTLS*/
+#endif /*HAVE_TLS_BACKEND*/
     return port;
 }
 
 ScmObj Scm_TLSOutputPortSet(ScmTLS* t, ScmObj port)
 {
-#if defined(GAUCHE_USE_AXTLS)
+#if defined(HAVE_TLS_BACKEND)
     t->out_port = SCM_PORT(port);
-#endif /*GAUCHE_USE_AXTLS*/
+#endif /*HAVE_TLS_BACKEND*/
     return port;
 }
 
 void Scm_Init_tls(ScmModule *mod)
 {
     Scm_InitStaticClass(&Scm_TLSClass, "<tls>", mod, NULL, 0);
+#if defined(GAUCHE_USE_OPENSSL)
+    OPENSSL_init_ssl(0, NULL);
+#endif /*GAUCHE_USE_OPENSSL*/
 }
@@ -35,8 +35,8 @@
 
 (define-module rfc.tls
   (use gauche.vport)
-  (export <tls> make-tls tls-destroy tls-connect tls-accept tls-close
-          tls-load-object tls-read tls-write
+  (export <tls> make-tls tls-clone tls-destroy tls-connect tls-accept tls-close
+          tls-load-object tls-read tls-write tls-session-reused?
           tls-input-port tls-output-port
 
           SSL_SERVER_VERIFY_LATER SSL_CLIENT_AUTHENTICATION
@@ -76,12 +76,15 @@
      (return (Scm_MakeTLS f num-sessions))))
  (define-cproc tls-load-object (tls::<tls> obj-type filename::<const-cstring>
                                            :optional (password::<const-cstring>? #f)) Scm_TLSLoadObject)
+ (define-cproc tls-clone (tls::<tls>) Scm_TLSClone)
  (define-cproc tls-destroy (tls::<tls>) Scm_TLSDestroy)
  (define-cproc %tls-connect (tls::<tls> fd::<long>) Scm_TLSConnect)
  (define-cproc %tls-accept (tls::<tls> fd::<long>) Scm_TLSAccept)
  (define-cproc %tls-close (tls::<tls>) Scm_TLSClose)
  (define-cproc tls-read (tls::<tls>) Scm_TLSRead)
  (define-cproc tls-write (tls::<tls> msg) Scm_TLSWrite)
+ (define-cproc tls-session-reused? (tls::<tls>) ::<boolean>
+   Scm_TLSSessionReused)
  (define-cproc tls-input-port (tls::<tls>) Scm_TLSInputPort)
  (define-cproc tls-output-port (tls::<tls>) Scm_TLSOutputPort)
  ;; internal
@@ -118,16 +121,18 @@
   (rlet1 ip (make <virtual-input-port>)
     (set! (~ ip'getb)
           (let ((buf #f) (pos 0) (size 0))
-            (^[]
+            (rec (getb)
               (if buf
                 (rlet1 r (string-byte-ref buf pos)
                   (set! pos (+ pos 1))
                   (when (= pos size) (set! buf #f)))
-                (begin
-                  (set! buf (tls-read tls))
-                  (set! size (string-size buf))
-                  (set! pos 1)
-                  (string-byte-ref buf 0))))))))
+                (let1 s (tls-read tls)
+                  (cond [(eof-object? s) s] ; connection closed
+                        [(zero? (string-size s)) (getb)]
+                        [else (set! buf s)
+                              (set! size (string-size s))
+                              (set! pos 0)
+                              (getb)]))))))))
 
 (define (make-tls-output-port tls)
   (rlet1 op (make <virtual-output-port>)
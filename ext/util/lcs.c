@@ -0,0 +1,106 @@
+/*
+ * lcs.c - Myers O(ND) difference algorithm for util.lcs
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "lcs.h"
+
+/* This is a straightforward translation of the Scheme version that was
+ * in lcs.scm, which implements
+ *   Eugene Myers, "An O(ND) Difference Algorithm and Its Variations",
+ *   Algorithmica Vol. 1 No. 2, 1986, pp. 251-266.
+ * For each diagonal k, we keep the furthest reaching x, and the common
+ * elements found on the path so far (in reverse order) and its length.
+ * Keeping the loop and the diagonal vectors in C avoids the generic
+ * arithmetic and vector access of the Scheme version.
+ */
+
+static inline int lcs_eq(ScmObj x, ScmObj y, int cmp, ScmObj proc)
+{
+    switch (cmp) {
+    case SCM_LCS_EQ:    return SCM_EQ(x, y);
+    case SCM_LCS_EQV:   return Scm_EqvP(x, y);
+    case SCM_LCS_EQUAL: return Scm_EqualP(x, y);
+    default:            return !SCM_FALSEP(Scm_ApplyRec2(proc, x, y));
+    }
+}
+
+ScmObj Scm_LCSWithPositions(ScmObj a, ScmObj b, int cmp, ScmObj proc)
+{
+    int N, M;
+    ScmObj *A = Scm_ListToArray(a, &N, NULL, TRUE);
+    ScmObj *B = Scm_ListToArray(b, &M, NULL, TRUE);
+    ScmSmallInt MN = N + M;
+
+    if (MN == 0) return SCM_LIST2(SCM_MAKE_INT(0), SCM_NIL);
+
+    /* Diagonals -MN..MN are mapped to 0..2*MN. */
+    ScmSmallInt *V_d = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, 2*MN+1);
+    ScmSmallInt *V_l = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, 2*MN+1);
+    ScmObj *V_r = SCM_NEW_ARRAY(ScmObj, 2*MN+1);
+    for (ScmSmallInt i = 0; i <= 2*MN; i++) {
+        V_d[i] = 0; V_l[i] = 0; V_r[i] = SCM_NIL;
+    }
+    V_d += MN; V_l += MN; V_r += MN;
+
+    for (ScmSmallInt d = 0; d <= MN; d++) {
+        for (ScmSmallInt k = -d; k <= d; k += 2) {
+            ScmSmallInt x, l;
+            ScmObj r;
+            if (k == -d || (k != d && V_d[k-1] < V_d[k+1])) {
+                x = V_d[k+1]; l = V_l[k+1]; r = V_r[k+1];
+            } else {
+                x = V_d[k-1] + 1; l = V_l[k-1]; r = V_r[k-1];
+            }
+            ScmSmallInt y = x - k;
+            while (x < N && y < M && lcs_eq(A[x], B[y], cmp, proc)) {
+                r = Scm_Cons(SCM_LIST3(A[x], SCM_MAKE_INT(x), SCM_MAKE_INT(y)),
+                             r);
+                x++; y++; l++;
+            }
+            V_d[k] = x; V_r[k] = r; V_l[k] = l;
+
+            if (x >= N && y >= M) {
+                /* Pick the path with the longest common part. */
+                ScmSmallInt maxl = 0;
+                ScmObj maxr = SCM_NIL;
+                for (ScmSmallInt i = -MN; i <= MN; i++) {
+                    if (V_l[i] > maxl) { maxl = V_l[i]; maxr = V_r[i]; }
+                }
+                return SCM_LIST2(SCM_MAKE_INT(maxl), Scm_Reverse(maxr));
+            }
+        }
+    }
+    Scm_Error("lcs-with-positions: something's wrong (implementation error?)");
+    return SCM_UNDEFINED;       /* dummy */
+}
@@ -0,0 +1,261 @@
+/*
+ * levenshtein.c - bit-parallel edit distances for util.levenshtein
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "levenshtein.h"
+
+/* We use the bit-parallel algorithms presented in
+ *   Gene Myers, "A fast bit-vector algorithm for approximate string
+ *   matching based on dynamic programming", JACM 46(3), 1999, and
+ *   Heikki Hyyro, "A bit-vector algorithm for computing Levenshtein
+ *   and Damerau edit distances", Nordic Journal of Computing 10, 2003.
+ * The columns of the DP matrix are encoded as bit vectors of vertical
+ * deltas, one bit per character of A, so that each character of B is
+ * processed in O(ceil(len(A)/64)) word operations.  The Levenshtein
+ * distance uses the blocked version for A longer than 64 characters.
+ */
+
+#define WORD_BITS 64
+typedef uint64_t word_t;
+
+/*================================================================
+ * Pattern match vectors
+ *
+ *   For each distinct character c in A, peq holds a bit vector whose
+ *   i-th bit is set iff A[i] == c.  Characters are looked up by an
+ *   open-addressing hash table.
+ */
+
+typedef struct peq_rec {
+    int len;                    /* length of A */
+    int words;                  /* number of words per vector */
+    int nchars;                 /* number of distinct characters */
+    ScmChar *chars;             /* distinct characters */
+    word_t *masks;              /* nchars * words */
+    word_t *zero;               /* all-zero vector for unknown chars */
+    int hmask;                  /* hash table size - 1 */
+    int *htab;                  /* index to chars, or -1 */
+} peq;
+
+static inline int peq_hash(ScmChar c, int hmask)
+{
+    return (int)(((u_long)c * 2654435761UL) >> 8) & hmask;
+}
+
+static const word_t *peq_lookup(const peq *p, ScmChar c)
+{
+    int h = peq_hash(c, p->hmask);
+    for (;;) {
+        int k = p->htab[h];
+        if (k < 0) return p->zero;
+        if (p->chars[k] == c) return p->masks + (size_t)k * p->words;
+        h = (h + 1) & p->hmask;
+    }
+}
+
+static void peq_init(peq *p, const ScmStringBody *b)
+{
+    int len = SCM_STRING_BODY_LENGTH(b);
+    int words = (len + WORD_BITS - 1) / WORD_BITS;
+    int hsize = 16;
+    while (hsize < len * 2) hsize <<= 1;
+
+    p->len = len;
+    p->words = words;
+    p->nchars = 0;
+    p->chars = SCM_NEW_ATOMIC_ARRAY(ScmChar, len);
+    p->masks = SCM_NEW_ATOMIC_ARRAY(word_t, (size_t)len * words);
+    p->zero = SCM_NEW_ATOMIC_ARRAY(word_t, words);
+    memset(p->zero, 0, sizeof(word_t) * words);
+    p->hmask = hsize - 1;
+    p->htab = SCM_NEW_ATOMIC_ARRAY(int, hsize);
+    for (int i = 0; i < hsize; i++) p->htab[i] = -1;
+
+    const char *cp = SCM_STRING_BODY_START(b);
+    for (int i = 0; i < len; i++) {
+        ScmChar c;
+        SCM_CHAR_GET(cp, c);
+        cp += SCM_CHAR_NBYTES(c);
+
+        int h = peq_hash(c, p->hmask), k;
+        for (;;) {
+            k = p->htab[h];
+            if (k < 0) {
+                k = p->nchars++;
+                p->chars[k] = c;
+                p->htab[h] = k;
+                memset(p->masks + (size_t)k * words, 0,
+                       sizeof(word_t) * words);
+                break;
+            }
+            if (p->chars[k] == c) break;
+            h = (h + 1) & p->hmask;
+        }
+        p->masks[(size_t)k * words + i / WORD_BITS]
+            |= (word_t)1 << (i % WORD_BITS);
+    }
+}
+
+/*================================================================
+ * Distance calculation
+ *
+ *   CUTOFF < 0 means no cutoff.  Returns -1 if the distance exceeds
+ *   CUTOFF.  After processing j characters of B (of length n), the
+ *   final distance is at least D[m][j] - (n - j), so we can give up
+ *   as soon as it exceeds CUTOFF.
+ */
+
+/* Levenshtein distance.  VP and VN are work areas of p->words words. */
+static long l_distance(const peq *p, const ScmStringBody *b, long cutoff,
+                       word_t *VP, word_t *VN)
+{
+    int m = p->len, n = SCM_STRING_BODY_LENGTH(b), words = p->words;
+    const char *cp = SCM_STRING_BODY_START(b);
+    word_t last = (word_t)1 << ((m - 1) % WORD_BITS);
+    long dist = m;
+
+    for (int w = 0; w < words; w++) { VP[w] = ~(word_t)0; VN[w] = 0; }
+
+    for (int j = 0; j < n; j++) {
+        ScmChar c;
+        SCM_CHAR_GET(cp, c);
+        cp += SCM_CHAR_NBYTES(c);
+        const word_t *PM = peq_lookup(p, c);
+        /* Horizontal deltas entering the top row: D[0][j] - D[0][j-1] = 1 */
+        word_t HPcarry = 1, HNcarry = 0;
+
+        for (int w = 0; w < words; w++) {
+            word_t vp = VP[w], vn = VN[w];
+            word_t X = PM[w] | HNcarry;
+            word_t D0 = (((X & vp) + vp) ^ vp) | X | vn;
+            word_t HP = vn | ~(D0 | vp);
+            word_t HN = D0 & vp;
+            word_t hpc = HPcarry, hnc = HNcarry;
+            if (w < words - 1) {
+                HPcarry = HP >> (WORD_BITS - 1);
+                HNcarry = HN >> (WORD_BITS - 1);
+            } else {
+                HPcarry = (HP & last) ? 1 : 0;
+                HNcarry = (HN & last) ? 1 : 0;
+            }
+            HP = (HP << 1) | hpc;
+            HN = (HN << 1) | hnc;
+            VP[w] = HN | ~(D0 | HP);
+            VN[w] = HP & D0;
+        }
+        dist += (long)HPcarry - (long)HNcarry;
+        if (cutoff >= 0 && dist - (n - j - 1) > cutoff) return -1;
+    }
+    return (cutoff >= 0 && dist > cutoff)? -1 : dist;
+}
+
+/* Restricted edit distance (optimal string alignment).  A must be
+   at most 64 characters. */
+static long re_distance(const peq *p, const ScmStringBody *b, long cutoff)
+{
+    int m = p->len, n = SCM_STRING_BODY_LENGTH(b);
+    const char *cp = SCM_STRING_BODY_START(b);
+    word_t last = (word_t)1 << (m - 1);
+    word_t VP = ~(word_t)0, VN = 0, D0 = 0, PMprev = 0;
+    long dist = m;
+
+    for (int j = 0; j < n; j++) {
+        ScmChar c;
+        SCM_CHAR_GET(cp, c);
+        cp += SCM_CHAR_NBYTES(c);
+        word_t PM = *peq_lookup(p, c);
+        word_t TR = (((~D0) & PM) << 1) & PMprev;
+        D0 = ((((PM & VP) + VP) ^ VP) | PM | VN) | TR;
+        word_t HP = VN | ~(D0 | VP);
+        word_t HN = D0 & VP;
+        if (HP & last) dist++;
+        if (HN & last) dist--;
+        HP = (HP << 1) | 1;
+        HN = HN << 1;
+        VP = HN | ~(D0 | HP);
+        VN = HP & D0;
+        PMprev = PM;
+        if (cutoff >= 0 && dist - (n - j - 1) > cutoff) return -1;
+    }
+    return (cutoff >= 0 && dist > cutoff)? -1 : dist;
+}
+
+ScmObj Scm_EditDistances(ScmObj a, ScmObj bs, ScmObj cutoff, int transpose)
+{
+    long lim = -1;
+    if (SCM_INTP(cutoff)) {
+        lim = SCM_INT_VALUE(cutoff);
+        if (lim < 0) return SCM_FALSE;
+    } else if (!SCM_FALSEP(cutoff)) {
+        return SCM_FALSE;
+    }
+
+    if (!SCM_STRINGP(a)) return SCM_FALSE;
+    const ScmStringBody *ab = SCM_STRING_BODY(a);
+    if (SCM_STRING_BODY_INCOMPLETE_P(ab)) return SCM_FALSE;
+    if (transpose && SCM_STRING_BODY_LENGTH(ab) > WORD_BITS) return SCM_FALSE;
+
+    ScmObj cp;
+    SCM_FOR_EACH(cp, bs) {
+        ScmObj b = SCM_CAR(cp);
+        if (!SCM_STRINGP(b)
+            || SCM_STRING_BODY_INCOMPLETE_P(SCM_STRING_BODY(b))) {
+            return SCM_FALSE;
+        }
+    }
+
+    peq p;
+    word_t *VP = NULL, *VN = NULL;
+    int m = SCM_STRING_BODY_LENGTH(ab);
+    if (m > 0) {
+        peq_init(&p, ab);
+        VP = SCM_NEW_ATOMIC_ARRAY(word_t, p.words);
+        VN = SCM_NEW_ATOMIC_ARRAY(word_t, p.words);
+    }
+
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    SCM_FOR_EACH(cp, bs) {
+        const ScmStringBody *bb = SCM_STRING_BODY(SCM_CAR(cp));
+        long n = SCM_STRING_BODY_LENGTH(bb), d;
+        if (lim >= 0 && labs(n - m) > lim) d = -1;
+        else if (m == 0) d = n;
+        else if (transpose) d = re_distance(&p, bb, lim);
+        else d = l_distance(&p, bb, lim, VP, VN);
+        SCM_APPEND1(h, t, (d < 0) ? SCM_FALSE : Scm_MakeInteger(d));
+    }
+    return h;
+}
@@ -0,0 +1,54 @@
+/*
+ * levenshtein.h - bit-parallel edit distances for util.levenshtein
+ *
+ *   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_UTIL_LEVENSHTEIN_H
+#define GAUCHE_UTIL_LEVENSHTEIN_H
+
+#include <gauche.h>
+
+SCM_DECL_BEGIN
+
+/* Calculates the edit distance between the string A and each string
+   in the list BS, comparing characters by their values.  If TRANSPOSE
+   is true, the restricted edit distance is calculated; otherwise the
+   Levenshtein distance.  CUTOFF is #f or a nonnegative integer, and
+   a distance exceeding it is reported as #f.  Returns a list of the
+   distances, or #f if the arguments can't be handled here (non-string,
+   incomplete string, or A longer than 64 characters for the restricted
+   edit distance). */
+extern ScmObj Scm_EditDistances(ScmObj a, ScmObj bs, ScmObj cutoff,
+                                int transpose);
+
+SCM_DECL_END
+
+#endif /*GAUCHE_UTIL_LEVENSHTEIN_H*/
@@ -16,6 +16,9 @@
 
 ;; Conceptually, an array is a backing storage and a procedure to
 ;; map n-dimensional indices to an index of the backing storage.
+;; The mapping is affine, and usually kept as an offset and a stride
+;; for each dimension, so that arrays sharing the storage (views) can
+;; be created and handed to the native kernels without copying.
 
 (define-module gauche.array
   (use srfi-1)
@@ -29,6 +32,7 @@
           array? make-array shape array array-rank
           array-start array-end array-ref array-set!
           share-array subarray array-equal?
+          array-transpose-view subarray-view array-slice array-broadcast
           array-valid-index?  shape-valid-index?
           array-shape array-length array-size
           array-for-each-index shape-for-each
@@ -85,6 +89,14 @@
 (define-class <array-base> ()
   ((start-vector    :init-keyword :start-vector :getter start-vector-of)
    (end-vector      :init-keyword :end-vector   :getter end-vector-of)
+   ;; The element at the start index is at OFFSET of the backing storage,
+   ;; and incrementing the k-th index advances the storage index by the
+   ;; k-th element of STRIDES (an s32vector).  STRIDES is #f if the
+   ;; array is created with an explicit mapper.
+   (offset          :init-keyword :offset       :getter offset-of
+                    :init-value 0)
+   (strides         :init-keyword :strides      :getter strides-of
+                    :init-value #f)
    (mapper          :init-keyword :mapper       :getter mapper-of)
    (getter          :getter getter-of)
    (setter          :getter setter-of)
@@ -97,6 +109,10 @@
   (let ([get   (backing-storage-getter-of (class-of self))]
         [set   (backing-storage-setter-of (class-of self))]
         [store (backing-storage-of self)])
+    (unless (slot-bound? self 'mapper)
+      (set! (slot-ref self 'mapper)
+            (generate-amap (start-vector-of self) (end-vector-of self)
+                           (offset-of self) (strides-of self))))
     (set! (slot-ref self 'getter) (^[index] (get store index)))
     (set! (slot-ref self 'setter) (^[index value] (set store index value)))))
 
@@ -185,11 +201,15 @@
   :backing-storage-length f64vector-length)
 
 (define-method copy-object ((self <array-base>))
-  (make (class-of self)
-    :start-vector (start-vector-of self)
-    :end-vector   (end-vector-of self)
-    :mapper       (mapper-of self)
-    :backing-storage (copy-object (backing-storage-of self))))
+  (if (or (array-packed? self) (not (strides-of self)))
+    (make (class-of self)
+      :start-vector (start-vector-of self)
+      :end-vector   (end-vector-of self)
+      :offset       (offset-of self)
+      :strides      (strides-of self)
+      :mapper       (mapper-of self)
+      :backing-storage (copy-object (backing-storage-of self)))
+    (pack-array self (array-shape self))))
 
 ;; NB: these should be built-in; but here for now.
 (define-method copy-object ((self <vector>))    (vector-copy self))
@@ -211,35 +231,36 @@
 ;;  Given begin-vector Vb = #s32(b0 b1 ... bN)
 ;;        end-vector   Ve = #s32(e0 e1 ... eN)
 ;;        where b0 <= e0, ..., bN <= eN
+;;        offset       o
+;;        strides      Vc = #s32(c0 c1 ... cN)
 ;;  Returns a procedure,
 ;;    which calculates 1-dimentional offset off to the backing storage,
 ;;          from given index vector #s32(i0 i1 ... iN)
 ;;
-;;  Pre-calculation:
+;;  Mapping
+;;   off = o + c0*(i0-b0) + c1*(i1-b1) + .. + cN*(iN-bN)
+;;
+;;  For a fresh array, o = 0 and the elements are laid out in row-major
+;;  order:
 ;;    sizes          s0 = e0 - b0, s1 = e1 - b1 ...
-;;    coefficients   c0   = s1 * s2 * ... * sN
+;;    strides        c0   = s1 * s2 * ... * sN
 ;;                   c1   = s2 * ... * sN
 ;;                   cN-1 = sN
 ;;                   cN   = 1
 ;;
-;;  Mapping
-;;   off = c0*(i0-b0) + c1*(i1-b1) + .. + cN*(iN-bN)
-;;
-;;
 
 (define (zero-vector? vec)
   (not (s32vector-range-check vec 0 0)))
 
-(define (generate-amap Vb Ve)
-  (let* ([rank    (s32vector-length Vb)]
-         [indices (iota rank)]
-         [Vs      (s32vector-sub Ve Vb)]
-         [-Vb     (map-to <s32vector> - Vb)]
-         [Ve-1    (s32vector-sub Ve 1)]
-         [vcl     (fold-right (^[sN l] (cons (* sN (car l)) l))
-                              '(1)
-                              (s32vector->list Vs))]
-         [Vc      (coerce-to <s32vector> (cdr vcl))])
+(define (row-major-strides Vb Ve)
+  (let1 vcl (fold-right (^[sN l] (cons (* sN (car l)) l))
+                        '(1)
+                        (s32vector->list (s32vector-sub Ve Vb)))
+    (coerce-to <s32vector> (cdr vcl))))
+
+(define (generate-amap Vb Ve offset Vc)
+  (let ([Ve-1 (s32vector-sub Ve 1)]
+        [base (- offset (s32vector-dot Vc Vb))])
     (^[Vi]
       (cond [(s32vector-range-check Ve-1 Vi #f)
              => (^i (errorf "index of dimension ~s is too big: ~s"
@@ -247,7 +268,7 @@
             [(s32vector-range-check Vb #f Vi)
              => (^i (errorf "index of dimension ~s is too small: ~s"
                             i (ref Vi i)))]
-            [else (s32vector-dot Vc (s32vector-add -Vb Vi))]))))
+            [else (+ base (s32vector-dot Vc Vi))]))))
 
 ;; shape index tests
 
@@ -303,7 +324,7 @@
       (make <array>
         :start-vector (s32vector 0 0)
         :end-vector (s32vector rank 2)
-        :mapper (^[Vi] (s32vector-dot (s32vector 2 1) Vi))
+        :strides (s32vector 2 1)
         :backing-storage (list->vector args)))))
 
 (define (shape->start/end-vector shape)
@@ -328,7 +349,7 @@
     (make class
       :start-vector Vb
       :end-vector Ve
-      :mapper (generate-amap Vb Ve)
+      :strides (row-major-strides Vb Ve)
       :backing-storage (apply (backing-storage-creator-of class)
                               (fold * 1 (s32vector-sub Ve Vb))
                               maybe-init))))
@@ -359,15 +380,36 @@
 (define-array-ctors || u8 s8 u16 s16 u32 s32 u64 s64 f16 f32 f64)
 
 (define (subarray ar sh)
-  (receive (Vb Ve) (shape->start/end-vector sh)
-    (let* ([rank (s32vector-length Vb)]
-           [Vb2 (make-s32vector rank 0)]
-           [Ve2 (s32vector-sub Ve Vb)]
-           [new-shape (start/end-vector->shape Vb2 Ve2)])
-      (tabulate-array new-shape
-                      (^[ind] (array-ref ar (s32vector->vector
-                                             (s32vector-add Vb ind))))
-                      (make-vector rank)))))
+  (let1 v (subarray-view ar sh)
+    (pack-array v (array-shape v))))
+
+;; Returns #t if the elements of A fill its backing storage in row-major
+;; order, i.e. A isn't a view of a part of the storage.
+(define (array-packed? a)
+  (and-let* ([strides (strides-of a)]
+             [ (zero? (offset-of a)) ]
+             [ (= (array-size a)
+                  ((backing-storage-length-of (class-of a))
+                   (backing-storage-of a))) ])
+    (let ([Vs (array-dims a)]
+          [Vc (row-major-strides (start-vector-of a) (end-vector-of a))])
+      ;; strides of dimensions of length 1 don't matter
+      (every (^k (or (<= (s32vector-ref Vs k) 1)
+                     (= (s32vector-ref strides k) (s32vector-ref Vc k))))
+             (iota (s32vector-length Vs))))))
+
+;; Returns a new array of the class of A and the shape SH, which has the
+;; same lengths of dimensions as A, and copies the elements of A into it.
+(define (pack-array a sh)
+  (rlet1 r (make-array-internal (class-of a) sh)
+    (if (and (strides-of a) (uvector? (backing-storage-of a)))
+      (%uvector-strided-op! 'copy (array-dims a)
+                            (backing-storage-of r) 0 (strides-of r)
+                            (backing-storage-of a) (offset-of a) (strides-of a))
+      (let ([set (backing-storage-setter-of (class-of r))]
+            [store (backing-storage-of r)]
+            [i 0])
+        (array-for-each (^x (set store i x) (inc! i)) a)))))
 
 (define (array? obj)
   (is-a? obj <array-base>))
@@ -384,6 +426,9 @@
   (unless (array? array) (error "array required, but got" array))
   (s32vector-ref (end-vector-of array) k))
 
+(define (array-dims array)
+  (s32vector-sub (end-vector-of array) (start-vector-of array)))
+
 ;;---------------------------------------------------------------
 ;; Array ref and set!
 ;;
@@ -457,14 +502,123 @@
   (^[Vi] (omap (map (^[ci cvec] (+ ci (s32vector-dot cvec Vi)))
                     constants coeffs))))
 
+;; If the original array has strides Vc, its k-th index is
+;; ck + cveck . Vi, so the storage index is
+;;   base + sum_k Vc[k] * (ck + cveck . Vi)
+;; where base = offset - Vc . Vb of the original array.  Returns the
+;; offset and the strides of the new array starting at Vb.
+(define (shared-strides array Vb constants coeffs)
+  (let ([Vc (strides-of array)]
+        [strides (make-s32vector (s32vector-length Vb) 0)])
+    (unless (= (length constants) (s32vector-length Vc))
+      (errorf "share-array: mapping procedure must return ~a values, \
+               but returned ~a" (s32vector-length Vc) (length constants)))
+    (let1 base (fold (^[c ci cvec base]
+                       (s32vector-add! strides (s32vector-mul cvec c))
+                       (+ base (* c ci)))
+                     (- (offset-of array)
+                        (s32vector-dot Vc (start-vector-of array)))
+                     (s32vector->list Vc) constants coeffs)
+      (values (+ base (s32vector-dot strides Vb)) strides))))
+
 (define (share-array array shape proc)
   (receive (Vb Ve) (shape->start/end-vector shape)
     (receive (constants coeffs) (affine-proc->coeffs proc (size-of Vb))
-      (make (class-of array)
-        :start-vector Vb
-        :end-vector   Ve
-        :mapper (generate-shared-map (mapper-of array) constants coeffs)
-        :backing-storage (backing-storage-of array)))))
+      (if (strides-of array)
+        (receive (offset strides) (shared-strides array Vb constants coeffs)
+          (make (class-of array)
+            :start-vector Vb
+            :end-vector   Ve
+            :offset       offset
+            :strides      strides
+            :backing-storage (backing-storage-of array)))
+        (make (class-of array)
+          :start-vector Vb
+          :end-vector   Ve
+          :mapper (generate-shared-map (mapper-of array) constants coeffs)
+          :backing-storage (backing-storage-of array))))))
+
+;;---------------------------------------------------------------
+;; Views
+;;   These return arrays that share the backing storage with the
+;;   given array, built by share-array.
+;;
+
+(define (swap-dims lis dim1 dim2)
+  (let1 v (list->vector lis)
+    (vector-set! v dim1 (list-ref lis dim2))
+    (vector-set! v dim2 (list-ref lis dim1))
+    (vector->list v)))
+
+(define (check-dimension who ar dim)
+  (unless (and (exact-integer? dim) (< -1 dim (array-rank ar)))
+    (errorf "~a: dimension out of range for an array of rank ~a: ~s"
+            who (array-rank ar) dim)))
+
+(define (array-transpose-view ar :optional (dim1 0) (dim2 1))
+  (check-dimension 'array-transpose-view ar dim1)
+  (check-dimension 'array-transpose-view ar dim2)
+  (let ([Vb (s32vector->list (start-vector-of ar))]
+        [Ve (s32vector->list (end-vector-of ar))])
+    (share-array ar
+                 (start/end-vector->shape
+                  (list->s32vector (swap-dims Vb dim1 dim2))
+                  (list->s32vector (swap-dims Ve dim1 dim2)))
+                 (^ ind (apply values (swap-dims ind dim1 dim2))))))
+
+(define (subarray-view ar sh)
+  (receive (Vb Ve) (shape->start/end-vector sh)
+    (unless (and (= (s32vector-length Vb) (array-rank ar))
+                 (not (s32vector-range-check Vb (start-vector-of ar) #f))
+                 (not (s32vector-range-check Ve #f (end-vector-of ar))))
+      (errorf "subarray: shape ~s is out of the range of the array of shape ~s"
+              (array->list sh) (array->list (array-shape ar))))
+    (let1 Vb-list (s32vector->list Vb)
+      (share-array ar
+                   (start/end-vector->shape
+                    (make-s32vector (s32vector-length Vb) 0)
+                    (s32vector-sub Ve Vb))
+                   (^ ind (apply values (map + ind Vb-list)))))))
+
+(define (array-slice ar dim index)
+  (check-dimension 'array-slice ar dim)
+  (unless (and (exact-integer? index)
+               (<= (array-start ar dim) index)
+               (< index (array-end ar dim)))
+    (errorf "array-slice: index of dimension ~s out of range: ~s" dim index))
+  (let ([drop-dim (^[lis] (append (take lis dim) (drop lis (+ dim 1))))])
+    (share-array ar
+                 (start/end-vector->shape
+                  (list->s32vector
+                   (drop-dim (s32vector->list (start-vector-of ar))))
+                  (list->s32vector
+                   (drop-dim (s32vector->list (end-vector-of ar)))))
+                 (^ ind (receive (head tail) (split-at ind dim)
+                          (apply values (append head (list index) tail)))))))
+
+;; Like NumPy, the shapes are aligned at the last dimension, and the
+;; dimensions of AR of length 1 are stretched.
+(define (array-broadcast ar sh)
+  (receive (Vb Ve) (shape->start/end-vector sh)
+    (let* ([rank (array-rank ar)]
+           [skip (- (s32vector-length Vb) rank)]
+           [bad (^[] (errorf "array-broadcast: can't broadcast an array of \
+                              shape ~s to ~s"
+                             (array->list (array-shape ar)) (array->list sh)))]
+           [maps (if (< skip 0)
+                   (bad)
+                   (map (^k (let ([ob (array-start ar k)]
+                                  [ol (array-length ar k)]
+                                  [nb (s32vector-ref Vb (+ k skip))]
+                                  [nl (- (s32vector-ref Ve (+ k skip))
+                                         (s32vector-ref Vb (+ k skip)))])
+                              (cond [(= ol 1) (^_ ob)]
+                                    [(= ol nl) (^i (+ (- i nb) ob))]
+                                    [else (bad)])))
+                        (iota rank)))])
+      (share-array ar sh
+                   (^ ind (apply values (map (^[f i] (f i))
+                                             maps (drop ind skip))))))))
 
 ;;---------------------------------------------------------------
 ;; Array utilities
@@ -511,16 +665,20 @@
     [else (^[proc vec] (apply proc (vector->list vec)))]))
 
 (define (array-for-each proc ar)
-  (for-each proc (backing-storage-of ar)))
+  (cond [(array-packed? ar) (for-each proc (backing-storage-of ar))]
+        [(zero? (array-rank ar)) (proc (array-ref ar))]
+        [else (array-for-each-index ar
+                (^[ind] (proc (array-ref ar ind)))
+                (make-vector (array-rank ar)))]))
 
 (define (array-any pred ar)
   (let/cc found
-    (for-each (^x (if (pred x) (found #t))) (backing-storage-of ar))
+    (array-for-each (^x (if (pred x) (found #t))) ar)
     #f))
 
 (define (array-every pred ar)
   (let/cc found
-    (for-each (^x (if (not (pred x)) (found #f))) (backing-storage-of ar))
+    (array-for-each (^x (if (not (pred x)) (found #f))) ar)
     #t))
 
 ;; repeat construct
@@ -16,6 +16,119 @@
 
 (select-module gauche.array)
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; native kernels
+;;
+;; <f32array>s and <f64array>s laid out by strides (see array.scm) are
+;; handed to the kernels in uvmatrix.c, including views such as the
+;; ones made by share-array and array-transpose-view.  The procedures
+;; in this section return #f if the arguments don't qualify, and the
+;; callers fall back to the generic code.
+
+;; Returns the backing storage of A if A is such an array.
+(define (native-storage a)
+  (and (or (eq? (class-of a) <f64array>) (eq? (class-of a) <f32array>))
+       (strides-of a)
+       (backing-storage-of a)))
+
+;; Returns the number of rows and columns if A is such a matrix,
+;; or two #f's.
+(define (native-matrix-size a)
+  (if (and (= (array-rank a) 2) (native-storage a))
+    (values (array-length a 0) (array-length a 1))
+    (values #f #f)))
+
+;; LU decomposition needs the elements in row-major order.  Returns A
+;; itself if it is already so, or a packed copy of it.
+(define (packed-array a)
+  (if (array-packed? a) a (copy-object a)))
+
+(define (native-array-mul a b)
+  (and (eq? (class-of a) (class-of b))
+       (receive (n m) (native-matrix-size a)
+         (and n
+              (receive (m2 p) (native-matrix-size b)
+                (and m2 (= m m2)
+                     (rlet1 c (make-array-internal (class-of a) (shape 0 n 0 p))
+                       (%uvector-matrix-mul! (backing-storage-of c)
+                                             (backing-storage-of a)
+                                             (offset-of a) (strides-of a)
+                                             (backing-storage-of b)
+                                             (offset-of b) (strides-of b)
+                                             n m p))))))))
+
+;; LU-decomposes the storage of a packed NxN matrix A in place.  Returns
+;; the pivot vector and the sign of the permutation (0 if A is singular).
+(define (native-lu! a n)
+  (let* ([piv (make-s32vector n)]
+         [sign (%uvector-matrix-lu! (backing-storage-of a) piv n)])
+    (values piv sign)))
+
+(define (native-determinant! a)
+  (receive (n m) (native-matrix-size a)
+    (and n (= n m)
+         (let1 a (packed-array a)
+           (receive (piv sign) (native-lu! a n)
+             (if (zero? sign)
+               0.0
+               (let1 lu (backing-storage-of a)
+                 (do ([i 0 (+ i 1)]
+                      [d (exact->inexact sign)
+                         (* d (uvector-ref lu (* i (+ n 1))))])
+                     [(= i n) d]))))))))
+
+;; Solves B X = Y for X, where X is a packed matrix initially holding Y
+;; and is overwritten.  Returns X, or the symbol singular if B isn't
+;; regular.
+(define (native-solve! x b)
+  (receive (n r) (native-matrix-size x)
+    (receive (nb mb) (native-matrix-size b)
+      (and n nb (= n nb mb) (eq? (class-of x) (class-of b))
+           (let1 lu (pack-array b (shape 0 n 0 n))
+             (receive (piv sign) (native-lu! lu n)
+               (if (zero? sign)
+                 'singular
+                 (begin
+                   (%uvector-matrix-lu-solve! (backing-storage-of lu) piv
+                                              (backing-storage-of x) n r)
+                   x))))))))
+
+(define (native-array-inverse a)
+  (receive (n m) (native-matrix-size a)
+    (and n (= n m)
+         (let1 r (native-solve! (identity-array n (class-of a)) a)
+           (if (eq? r 'singular) #f r)))))
+
+;; Elementwise operation OP (add, sub, mul or div) between A and an
+;; array or a real number B.  The result is stored in A, which is
+;; returned.  B may be a view on the same storage as A, e.g. made by
+;; array-broadcast; it is copied first if its layout differs from A's,
+;; so that the result doesn't depend on the order of the operation.
+(define (native-elementwise! op a b)
+  (and-let* ([sa (native-storage a)]
+             [b (cond [(real? b) b]
+                      [(and (eq? (class-of a) (class-of b))
+                            (native-storage b)
+                            (equal? (start-vector-of a) (start-vector-of b))
+                            (equal? (end-vector-of a) (end-vector-of b)))
+                       (if (and (eq? (backing-storage-of b) sa)
+                                (not (and (= (offset-of a) (offset-of b))
+                                          (equal? (strides-of a)
+                                                  (strides-of b)))))
+                         (copy-object b)
+                         b)]
+                      [else #f])])
+    (if (real? b)
+      (%uvector-strided-op! op (array-dims a)
+                            sa (offset-of a) (strides-of a)
+                            sa (offset-of a) (strides-of a)
+                            b)
+      (%uvector-strided-op! op (array-dims a)
+                            sa (offset-of a) (strides-of a)
+                            sa (offset-of a) (strides-of a)
+                            (backing-storage-of b) (offset-of b) (strides-of b)))
+    a))
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; general array manipulation
 
@@ -42,19 +155,49 @@
       (let ([c (make-minimal-backend-array
                 (list a b) (start/end-vector->shape c-start c-end))]
             [off (- (s32vector-ref a-end dimension) (s32vector-ref a-start dimension))])
-        (array-for-each-index a
-          (^i (array-set! c i (array-ref a i)))
-          (make-vector a-rank))
-        (array-for-each-index b
-          (^i (let1 j (vector-copy i)
-                (dotimes [dim a-rank]
-                  (vector-set! j dim (+ (vector-ref j dim) (vector-ref diff dim))))
-                (vector-set! j dimension (+ off (vector-ref j dimension)))
-                (array-set! c j (array-ref b i))))
-          (make-vector b-rank))
+        (if (native-copyable? c a b)
+          (let1 sc (backing-storage-of c)
+            (%uvector-strided-op! 'copy (array-dims a)
+                                  sc (offset-of c) (strides-of c)
+                                  (backing-storage-of a)
+                                  (offset-of a) (strides-of a))
+            (%uvector-strided-op! 'copy (array-dims b)
+                                  sc (+ (offset-of c)
+                                        (* off (s32vector-ref (strides-of c)
+                                                              dimension)))
+                                  (strides-of c)
+                                  (backing-storage-of b)
+                                  (offset-of b) (strides-of b)))
+          (begin
+            (array-for-each-index a
+              (^i (array-set! c i (array-ref a i)))
+              (make-vector a-rank))
+            (array-for-each-index b
+              (^i (let1 j (vector-copy i)
+                    (dotimes [dim a-rank]
+                      (vector-set! j dim (+ (vector-ref j dim) (vector-ref diff dim))))
+                    (vector-set! j dimension (+ off (vector-ref j dimension)))
+                    (array-set! c j (array-ref b i))))
+              (make-vector b-rank))))
         c))))
 
+;; Returns #t if the elements of arrays SRCS can be copied into DST by
+;; the native kernel.
+(define (native-copyable? dst . srcs)
+  (let1 store (backing-storage-of dst)
+    (and (uvector? store)
+         (strides-of dst)
+         (every (^[src] (and (strides-of src)
+                             (eq? (class-of (backing-storage-of src))
+                                  (class-of store))))
+                srcs))))
+
 (define (array-transpose a :optional (dim1 0) (dim2 1))
+  (if (native-storage a)
+    (copy-object (array-transpose-view a dim1 dim2))
+    (generic-array-transpose a dim1 dim2)))
+
+(define (generic-array-transpose a dim1 dim2)
   (let* ([sh (copy-object (array-shape a))]
          [rank (array-rank a)]
          [tmp0 (array-ref sh dim1 0)]
@@ -199,6 +342,10 @@
             (array-set! a i j (/ (array-ref a i j) divisor))))))))
 
 (define (array-inverse a)
+  (or (native-array-inverse a)
+      (generic-array-inverse a)))
+
+(define (generic-array-inverse a)
   (let* ([start (start-vector-of a)]
          [end (end-vector-of a)]
          [rank (s32vector-length start)]
@@ -221,6 +368,10 @@
 
 
 (define (determinant! a)
+  (or (native-determinant! a)
+      (generic-determinant! a)))
+
+(define (generic-determinant! a)
   (let* ([start (s32vector->list (start-vector-of a))]
          [end (s32vector->list (end-vector-of a))]
          [row-col-offset (- (car start) (cadr start))]
@@ -250,6 +401,10 @@
 ;; matrix arithmetic
 
 (define (array-mul a b) ; NxM * MxP => NxP
+  (or (native-array-mul a b)
+      (generic-array-mul a b)))
+
+(define (generic-array-mul a b)
   (let ([a-start (start-vector-of a)]
         [a-end (end-vector-of a)]
         [b-start (start-vector-of b)]
@@ -281,9 +436,17 @@
             (array-set! res (- i a-start-row) (- k b-start-col) tmp)))))))
 
 (define (array-div-left a b)
-  (if-let1 b-1 (array-inverse b)
-    (array-mul b-1 a)
-    (error "Matrix is not regular:" b)))
+  (let1 x (and (eq? (class-of a) (class-of b))
+               (= (array-rank a) 2)
+               (native-storage a)
+               (pack-array a (shape 0 (array-length a 0)
+                                    0 (array-length a 1))))
+    (case (and x (native-solve! x b))
+      [(#f) (if-let1 b-1 (array-inverse b)
+              (array-mul b-1 a)
+              (error "Matrix is not regular:" b))]
+      [(singular) (error "Matrix is not regular:" b)]
+      [else x])))
 
 (define (array-div-right a b)
   (if-let1 b-1 (array-inverse b)
@@ -318,13 +481,15 @@
   a)
 
 (define-method array-add-elements! ((a <array-base>) (b <number>))
-  (array-map! a (^i (+ b i)) a))
+  (or (native-elementwise! 'add a b)
+      (array-map! a (^i (+ b i)) a)))
 
 (define-method array-add-elements! ((a <number>) (b <array-base>))
   (array-map! (copy-object b) (^i (+ a i)) b))
 
 (define-method array-add-elements! ((a <array-base>) (b <array-base>))
-  (array-map! a (^[i j] (+ i j)) a b))
+  (or (native-elementwise! 'add a b)
+      (array-map! a (^[i j] (+ i j)) a b)))
 
 (define (array-add-elements a . rest)
   (rlet1 res (copy-object a)
@@ -340,13 +505,15 @@
   (apply array-sub-elements! a c rest))
 
 (define-method array-sub-elements! ((a <array-base>) (b <number>))
-  (array-map! a (^i (- i b)) a))
+  (or (native-elementwise! 'sub a b)
+      (array-map! a (^i (- i b)) a)))
 
 (define-method array-sub-elements! ((a <number>) (b <array-base>))
   (array-map! (copy-object b) (^i (- a i)) b))
 
 (define-method array-sub-elements! ((a <array-base>) (b <array-base>))
-  (array-map! a (^[i j] (- i j)) a b))
+  (or (native-elementwise! 'sub a b)
+      (array-map! a (^[i j] (- i j)) a b)))
 
 (define (array-sub-elements a . rest)
   (rlet1 res (copy-object a)
@@ -362,13 +529,15 @@
   a)
 
 (define-method array-mul-elements! ((a <array-base>) (b <number>))
-  (array-map! a (^i (* b i)) a))
+  (or (native-elementwise! 'mul a b)
+      (array-map! a (^i (* b i)) a)))
 
 (define-method array-mul-elements! ((a <number>) (b <array-base>))
   (array-map! (copy-object b) (^i (* a i)) b))
 
 (define-method array-mul-elements! ((a <array-base>) (b <array-base>))
-  (array-map! a (^[i j] (* i j)) a b))
+  (or (native-elementwise! 'mul a b)
+      (array-map! a (^[i j] (* i j)) a b)))
 
 (define (array-mul-elements a . rest)
   (rlet1 res (copy-object a)
@@ -384,13 +553,15 @@
   a)
 
 (define-method array-div-elements! ((a <array-base>) (b <number>))
-  (array-map! a (^i (/ i b)) a))
+  (or (native-elementwise! 'div a b)
+      (array-map! a (^i (/ i b)) a)))
 
 (define-method array-div-elements! ((a <number>) (b <array-base>))
   (array-map! (copy-object b) (^i (/ a i)) b))
 
 (define-method array-div-elements! ((a <array-base>) (b <array-base>))
-  (array-map! a (^[i j] (/ i j)) a b))
+  (or (native-elementwise! 'div a b)
+      (array-map! a (^[i j] (/ i j)) a b)))
 
 (define (array-div-elements a . rest)
   (rlet1 res (copy-object a)
@@ -99,6 +99,67 @@
 (uvmaketester <f32vector> make-f32vector '(0 1.0 -1.0)) 
 (uvmaketester <f64vector> make-f64vector '(0 1.0 -1.0)) 
 
+(dolist [storage '(malloc mmap)]
+  (test* #"off-heap storage (~storage)" `(#u8(7 7 7 9) ,storage (7 9) 0 released)
+         (let* ([v (make-u8vector 4 7 :storage storage)]
+                [a (uvector-alias <u8vector> v 2)])
+           (u8vector-set! a 1 9)
+           (let* ([c (u8vector-copy v)]
+                  [s (uvector-storage v)]
+                  [l (list (u8vector-ref v 2) (u8vector-ref v 3))])
+             (uvector-release! v)
+             (list c s l (u8vector-length v) (uvector-storage v))))))
+
+(test* "off-heap storage (make-uvector)" '(#f64(0.0 0.0 0.0) malloc)
+       (let1 v (make-uvector <f64vector> 3 :storage 'malloc)
+         (list v (uvector-storage v))))
+
+(test* "off-heap storage (heap)" 'heap
+       (uvector-storage (make-u8vector 3 :storage 'heap)))
+
+(test* "uvector-release! on heap vector" (test-error)
+       (uvector-release! (make-u8vector 3)))
+
+(cond-expand
+ [gauche.os.windows]
+ [else
+  (let ([file "test.o.mmap"])
+    (define (file-bytes)
+      (call-with-input-file file (cut read-uvector <u8vector> 16 <>)))
+    (sys-unlink file)
+    (call-with-output-file file
+      (cut write-uvector (u8vector-copy '#u8(0 1 2 3 4 5 6 7
+                                             8 9 10 11 12 13 14 15)) <>))
+    (test* "mmap-u8vector (read)" '(#u8(0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15)
+                                    file #t)
+           (let1 v (mmap-u8vector file)
+             (list (u8vector-copy v) (uvector-storage v)
+                   (uvector-immutable? v))))
+    (test* "mmap-u8vector (read, immutable)" (test-error)
+           (u8vector-set! (mmap-u8vector file) 0 1))
+    (test* "mmap-u8vector (offset, length)" '#u8(4 5 6)
+           (u8vector-copy (mmap-u8vector file :offset 4 :length 3)))
+    (test* "mmap-u32vector (bad offset)" (test-error)
+           (mmap-u32vector file :offset 2))
+    (test* "mmap-u32vector (too long)" (test-error)
+           (mmap-u32vector file :length 5))
+    (test* "mmap-uvector (private)" '(200 0)
+           (let1 v (mmap-uvector <u8vector> file :mode 'private)
+             (u8vector-set! v 0 200)
+             (list (u8vector-ref v 0) (u8vector-ref (file-bytes) 0))))
+    (test* "mmap-u8vector (shared)" '(#u8(0 1 2 3 99 5 6 7 8 9 10 11 12 13 14 77)
+                                      released)
+           (let* ([v (mmap-u8vector file :mode 'shared)]
+                  [s (uvector-slice v 4 16)])
+             (u8vector-set! s 0 99)
+             (u8vector-set! s 11 77)
+             (uvector-sync! s)
+             (uvector-release! v)
+             (list (file-bytes) (uvector-storage v))))
+    (test* "uvector-sync! on non-file vector" (test-error)
+           (uvector-sync! (make-u8vector 3 0 :storage 'mmap)))
+    (sys-unlink file))])
+
 ;;-------------------------------------------------------------------
 (test-section "ref and set")
 
@@ -1025,6 +1086,135 @@
 (dotprod-test-generate f64 #f64(32767 -32767 32767 -32767 32767)
                        #f64(32767 -32767 32767 -32767 32767))
 
+;;-------------------------------------------------------------------
+(test-section "long vectors")
+
+;; Some operations on f32, f64, s32 and u8 vectors are vectorized.
+;; Make sure both the vectorized part and the rest are right.
+
+(define-macro (long-arith-test-generate tag lis0 lis1)
+  (define (proc name) (string->symbol #"~|tag|vector~name"))
+  `(let* ([l0 ,lis0]
+          [l1 ,lis1]
+          [v0 (apply ,(proc "") l0)]
+          [v1 (apply ,(proc "") l1)])
+     (test* ,#"long ~|tag|vector-add" (map + l0 l1)
+            (coerce-to <list> (,(proc "-add") v0 v1)))
+     (test* ,#"long ~|tag|vector-sub" l0
+            (coerce-to <list> (,(proc "-sub") (,(proc "-add") v0 v1) v1)))
+     (test* ,#"long ~|tag|vector-mul" (map * l0 l0)
+            (coerce-to <list> (,(proc "-mul") v0 v0)))
+     (test* ,#"long ~|tag|vector-dot" (apply + (map * l0 l1))
+            (,(proc "-dot") v0 v1))))
+
+(define (gen-list n f) (map f (iota n)))
+
+(long-arith-test-generate u8
+                          (gen-list 99 (^i (modulo (* i 37) 16)))
+                          (gen-list 99 (^i (modulo (* i 11) 128))))
+(long-arith-test-generate s32
+                          (gen-list 99 (^i (- (modulo (* i 7919) 65536) 32768)))
+                          (gen-list 99 (^i (- (modulo (* i 1543) 1024) 512))))
+(long-arith-test-generate f32
+                          (gen-list 99 (^i (/. (- (modulo (* i 37) 101) 50) 2)))
+                          (gen-list 99 (^i (/. (modulo (* i 11) 64) 4))))
+(long-arith-test-generate f64
+                          (gen-list 99 (^i (/. (- (modulo (* i 37) 101) 50) 2)))
+                          (gen-list 99 (^i (/. (modulo (* i 11) 64) 4))))
+
+(test* "long f64vector-div" (make-f64vector 41 0.25)
+       (f64vector-div (make-f64vector 41 1.0) (make-f64vector 41 4.0)))
+(test* "long f32vector-add!" (make-f32vector 41 3.0)
+       (let1 v (make-f32vector 41 1.0)
+         (f32vector-add! v (make-f32vector 41 2.0))
+         v))
+
+(test* "long u8vector-add (overflow)" (test-error)
+       (u8vector-add (make-u8vector 40 200) (make-u8vector 40 100)))
+(test* "long u8vector-add (clamp)" (make-u8vector 40 255)
+       (u8vector-add (make-u8vector 40 200) (make-u8vector 40 100) 'high))
+(test* "long u8vector-sub (clamp)" (make-u8vector 40 0)
+       (u8vector-sub (make-u8vector 40 100) (make-u8vector 40 200) 'low))
+(test* "long u8vector-sub (underflow)" (test-error)
+       (u8vector-sub (make-u8vector 40 100) (make-u8vector 40 200) 'high))
+(test* "long u8vector-mul (clamp)" (make-u8vector 40 255)
+       (u8vector-mul (make-u8vector 40 16) (make-u8vector 40 16) 'both))
+(test* "long u8vector-dot" (* 100000 255 255)
+       (u8vector-dot (make-u8vector 100000 255) (make-u8vector 100000 255)))
+
+(test* "long s32vector-add (overflow)" (test-error)
+       (s32vector-add (make-s32vector 40 (expt 2 30))
+                      (make-s32vector 40 (expt 2 30))))
+(test* "long s32vector-add (partial clamp)"
+       (let1 v (make-s32vector 40 2)
+         (s32vector-set! v 20 (- (expt 2 31) 1))
+         v)
+       (let1 v (make-s32vector 40 1)
+         (s32vector-set! v 20 (- (expt 2 31) 1))
+         (s32vector-add v (make-s32vector 40 1) 'both)))
+(test* "long s32vector-mul (clamp)"
+       (list (- (expt 2 31) 1) (- (expt 2 31)) (- (expt 2 31)))
+       (let1 v (s32vector-mul (make-s32vector 40 (expt 2 16))
+                              (apply s32vector
+                                     (append (make-list 20 (expt 2 16))
+                                             (make-list 10 (- (expt 2 16)))
+                                             (make-list 10 (- (expt 2 15)))))
+                              'both)
+         (list (s32vector-ref v 0) (s32vector-ref v 25) (s32vector-ref v 35))))
+(test* "long s32vector-dot" (* 40 (expt 2 62))
+       (s32vector-dot (make-s32vector 40 (- (expt 2 31)))
+                      (make-s32vector 40 (- (expt 2 31)))))
+
+;;-------------------------------------------------------------------
+(test-section "reductions")
+
+(define-macro (reduction-test-generate tag lis)
+  (define (proc name) (string->symbol #"~|tag|vector-~name"))
+  `(let* ([l ,lis]
+          [v (,(string->symbol #"list->~|tag|vector") l)]
+          [mn (apply min l)]
+          [mx (apply max l)])
+     (test* ,#"~|tag|vector-sum" (apply + l) (,(proc "sum") v))
+     (test* ,#"~|tag|vector-min" mn (,(proc "min") v))
+     (test* ,#"~|tag|vector-max" mx (,(proc "max") v))
+     (test* ,#"~|tag|vector-argmin" (list-index (cut = mn <>) l)
+            (,(proc "argmin") v))
+     (test* ,#"~|tag|vector-argmax" (list-index (cut = mx <>) l)
+            (,(proc "argmax") v))))
+
+(reduction-test-generate s8  (gen-list 99 (^i (- (modulo (* i 37) 256) 128))))
+(reduction-test-generate u8  (gen-list 99 (^i (modulo (* i 37) 256))))
+(reduction-test-generate s16 (gen-list 99 (^i (- (modulo (* i 7919) 65536) 32768))))
+(reduction-test-generate u16 (gen-list 99 (^i (modulo (* i 7919) 65536))))
+(reduction-test-generate s32 (gen-list 99 (^i (- (modulo (* i 2654435761) (expt 2 32))
+                                                 (expt 2 31)))))
+(reduction-test-generate u32 (gen-list 99 (^i (modulo (* i 2654435761) (expt 2 32)))))
+(reduction-test-generate s64 (gen-list 99 (^i (- (modulo (* i 11400714819323198485)
+                                                         (expt 2 64))
+                                                 (expt 2 63)))))
+(reduction-test-generate u64 (gen-list 99 (^i (modulo (* i 11400714819323198485)
+                                                      (expt 2 64)))))
+(reduction-test-generate f16 (gen-list 99 (^i (/. (- (modulo (* i 37) 101) 50) 2))))
+(reduction-test-generate f32 (gen-list 99 (^i (/. (- (modulo (* i 37) 101) 50) 2))))
+(reduction-test-generate f64 (gen-list 99 (^i (/. (- (modulo (* i 37) 101) 50) 2))))
+(reduction-test-generate s32 '(3))
+
+(test* "u8vector-argmax (first occurrence)" 1 (u8vector-argmax #u8(1 5 3 5)))
+(test* "f32vector-argmin (first occurrence)" 2
+       (f32vector-argmin #f32(3 2 -1 4 -1)))
+(test* "s32vector-argmax (first occurrence)" 3
+       (s32vector-argmax (list->s32vector (append (make-list 3 0)
+                                                  (make-list 30 7)))))
+(test* "u8vector-sum" (* 100000 255) (u8vector-sum (make-u8vector 100000 255)))
+(test* "s32vector-sum" (* 40 (- (expt 2 31) 1))
+       (s32vector-sum (make-s32vector 40 (- (expt 2 31) 1))))
+(test* "u64vector-sum" (* 3 (- (expt 2 64) 1))
+       (u64vector-sum (make-u64vector 3 (- (expt 2 64) 1))))
+(test* "s8vector-sum ()" 0 (s8vector-sum #s8()))
+(test* "f64vector-sum ()" 0.0 (f64vector-sum #f64()))
+(test* "u8vector-max ()" (test-error) (u8vector-max #u8()))
+(test* "f32vector-argmax ()" (test-error) (f32vector-argmax #f32()))
+
 ;;-------------------------------------------------------------------
 (test-section "range-check")
 
@@ -1410,6 +1600,37 @@
   (run-across test-reverse-endian)
   )
 
+(cond-expand
+ (gauche.os.windows #f)
+ (else
+  (define (would-block? thunk)
+    (guard (e [(and (condition-has-type? e <system-error>)
+                    (eqv? (condition-ref e 'errno) EAGAIN))
+               #t])
+      (thunk)
+      #f))
+
+  (receive (in out) (sys-pipe)
+    (set! (port-nonblocking? in) #t)
+    (test* "read-block! from empty non-blocking pipe" #t
+           (would-block? (cut read-block! (make-u8vector 10) in)))
+    (test* "read-block! from non-blocking pipe (partial)" '(5 #u8(1 2 3 4 5 0 0 0 0 0))
+           (let1 buf (make-u8vector 10 0)
+             (write-block '#u8(1 2 3 4 5) out)
+             (flush out)
+             (list (read-block! buf in) buf)))
+    (set! (port-nonblocking? out) #t)
+    (let* ([size 1000000]
+           [n (write-block (make-u16vector size 1) out)])
+      (test* "write-block to non-blocking pipe (partial)" #t
+             (and (exact-integer? n) (< 0 n size)))
+      (test* "write-block to full non-blocking pipe" #t
+             (would-block? (cut write-block (make-u16vector size 1) out))))
+    ;; OUT still has pending output, which now gets EPIPE.
+    (close-port in)
+    (guard (e [else #f]) (close-port out)))
+  ))
+
 ;;-------------------------------------------------------------------
 (test-section "string <-> uvector")
 
@@ -1663,6 +1884,63 @@
               [dst (uvector-alias <u8vector> src)])
          (u8vector-set! dst 0 1)))
 
+(test* "slice" '(#s16(2 30 4) #s16(0 1 2 30 4 5))
+       (let* ([src (s16vector 0 1 2 3 4 5)]
+              [dst (uvector-slice src 2 5)])
+         (s16vector-set! dst 1 30)
+         (list dst src)))
+(test* "slice (default range)" #f64(1.0 2.0)
+       (uvector-slice #f64(0.0 1.0 2.0) 1))
+(test* "slice of slice" #u32(3 4)
+       (uvector-slice (uvector-slice (u32vector 1 2 3 4 5) 1 4) 1))
+(test* "slice (out of range)" (test-error)
+       (uvector-slice (u8vector 1 2 3) 2 4))
+(test* "slice immutability" (test-error)
+       (u8vector-set! (uvector-slice '#u8(0 1 2 3) 1) 0 1))
+(test* "slice arithmetic" #s32(0 11 22 3)
+       (let1 v (s32vector 0 1 2 3)
+         (s32vector-add! (uvector-slice v 1 3) #s32(10 20))
+         v))
+(test* "slice and read-block!" #u8(0 97 98 99 0)
+       (let1 v (make-u8vector 5 0)
+         (read-block! (uvector-slice v 1 4) (open-input-string "abcdef"))
+         v))
+(test* "slice and write-block" "bc"
+       (with-output-to-string
+         (cut write-block (uvector-slice #u8(97 98 99 100) 1 3))))
+
+(test* "uvector-sort!" '#s8(-128 -3 0 5 127)
+       (uvector-sort! (s8vector 5 -3 127 0 -128)))
+(test* "uvector-sort! (range)" '#u16(9 1 2 7 0)
+       (uvector-sort! (u16vector 9 7 2 1 0) 1 4))
+(test* "uvector-sort! on slice" '#u32(5 1 3 4 0)
+       (let1 v (u32vector 5 4 3 1 0)
+         (uvector-sort! (uvector-slice v 1 4))
+         v))
+(test* "uvector-sort! (immutable)" (test-error)
+       (uvector-sort! '#u8(3 2 1)))
+(test* "u64vector-sort!" '#u64(0 1 18446744073709551615)
+       (u64vector-sort! (u64vector 18446744073709551615 0 1)))
+(test* "s32vector-sort!" '#s32(-2147483648 -1 0 1 2147483647)
+       (s32vector-sort! (s32vector 1 2147483647 -1 -2147483648 0)))
+(test* "f16vector-sort!" '#f16(-2.0 -0.5 0.0 1.5)
+       (f16vector-sort! (f16vector 1.5 0.0 -2.0 -0.5)))
+(test* "f32vector-sort!" '#f32(-inf.0 -1.0 0.25 +inf.0)
+       (f32vector-sort! (f32vector 0.25 +inf.0 -1.0 -inf.0)))
+(test* "f64vector-sort! (-0.0)" '(-1.0 -0.0 0.0 2.0)
+       (f64vector->list (f64vector-sort! (f64vector 0.0 2.0 -0.0 -1.0))))
+(test* "f64vector-sort! (long)" #t
+       (let* ([n 5000]
+              [v (make-f64vector n)])
+         (dotimes [i n] (f64vector-set! v i (* (- (modulo (* i 7919) n) 2500) 0.5)))
+         (f64vector-sort! v)
+         (let loop ([i 1])
+           (cond [(= i n) #t]
+                 [(< (f64vector-ref v i) (f64vector-ref v (- i 1))) #f]
+                 [else (loop (+ i 1))]))))
+(test* "sort on s16vector" '#s16(-5 0 3)
+       (sort #s16(3 -5 0)))
+
 ;;-------------------------------------------------------------------
 ; (use gauche.array)
 (test-section "gauche.array")
@@ -2137,6 +2415,60 @@
                  (array-ref sub 1 1)))
     ))
 
+(test-section "array views")
+(let1 a (tabulate-array (shape 0 3 0 4) (^[i j] (+ (* i 10) j)))
+  (test* "array-transpose-view" '(0 10 20 1 11 21 2 12 22 3 13 23)
+         (array->list (array-transpose-view a)))
+  (test* "array-transpose-view shape" '(0 4 0 3)
+         (array->list (array-shape (array-transpose-view a))))
+  (test* "array-transpose-view shares storage" 99
+         (let1 b (copy-object a)
+           (array-set! (array-transpose-view b) 2 1 99)
+           (array-ref b 1 2)))
+  (test* "subarray-view" '(11 12 21 22)
+         (array->list (subarray-view a (shape 1 3 1 3))))
+  (test* "subarray-view of a view" '(12 22)
+         (array->list (subarray-view (array-transpose-view a)
+                                     (shape 2 3 1 3))))
+  (test* "subarray-view range" (test-error)
+         (subarray-view a (shape 1 4 1 3)))
+  (test* "subarray of a view" '(21 22)
+         (array->list (subarray (array-transpose-view a) (shape 1 3 2 3))))
+  (test* "array-slice (row)" '(20 21 22 23)
+         (array->list (array-slice a 0 2)))
+  (test* "array-slice (column)" '(1 11 21)
+         (array->list (array-slice a 1 1)))
+  (test* "array-slice (rank 0)" 21
+         (array-ref (array-slice (array-slice a 0 2) 0 1)))
+  (test* "array-slice range" (test-error)
+         (array-slice a 0 3))
+  (test* "array-broadcast" '(0 1 2 3 0 1 2 3)
+         (array->list (array-broadcast (array-slice a 0 0) (shape 0 2 0 4))))
+  (test* "array-broadcast (column)" '(0 0 10 10 20 20)
+         (array->list (array-broadcast (subarray-view a (shape 0 3 0 1))
+                                       (shape 0 3 0 2))))
+  (test* "array-broadcast mismatch" (test-error)
+         (array-broadcast a (shape 0 3 0 5)))
+  (test* "copy-object of a view" '(#t (1 11 21))
+         (let* ([s (array-slice a 1 1)]
+                [c (copy-object s)])
+           (array-set! c 0 -1)
+           (list (= (array-ref a 0 1) 1) (array->list s))))
+  (test* "array-for-each on a view" '(3 13 23)
+         (let1 r '()
+           (array-for-each (^x (push! r x)) (array-slice a 1 3))
+           (reverse r)))
+  (test* "array-every on a view" #t
+         (array-every odd? (array-slice a 1 1)))
+  (test* "write a view" "#,(<u8array> (0 2) 11 21)"
+         (let1 u (make-u8array (shape 0 3 0 4))
+           (array-map! u identity a)
+           (write-to-string
+            (array-slice (subarray-view (array-transpose-view u)
+                                        (shape 1 2 1 3))
+                         0 0))))
+  )
+
 ;;----------------------------------------------------------------
 (test-section "array-iteration")
 
@@ -2347,6 +2679,100 @@
       #,(<s16array> (0 1 0 1) 204))
      )))
 
+;; <f32array> and <f64array> go through the native kernels.  Compare
+;; them with the results of generic arrays.
+(let ()
+  (define (->array a)
+    (tabulate-array (array-shape a) (^[ind] (array-ref a ind))
+                    (make-vector (array-rank a))))
+  (define (array-of class a)
+    (rlet1 r ((if (eq? class <f64array>) make-f64array make-f32array)
+              (array-shape a))
+      (array-map! r identity a)))
+  ;; small integer elements, so that products are exact.  A positive
+  ;; DIAG makes the matrix diagonally dominant, hence regular.
+  (define (random-array class n m :optional (diag 0))
+    (let1 seed 12345
+      (array-of class
+                (tabulate-array (shape 0 n 0 m)
+                                (^[i j]
+                                  (set! seed (modulo (+ (* seed 1103515245)
+                                                        12345)
+                                                     2147483648))
+                                  (+ (- (modulo (quotient seed 65536) 11) 5)
+                                     (if (= i j) diag 0)))))))
+  (dolist [class (list <f64array> <f32array>)]
+    (let* ([c (class-name class)]
+           [a (random-array class 70 45)]
+           [b (random-array class 45 90)]
+           [s (random-array class 50 50 100)])
+      (test* #"array-mul (~c)" (array-mul (->array a) (->array b))
+             (array-mul a b) array-approx-equal?)
+      (test* #"array-mul result class (~c)" class
+             (class-of (array-mul a b)))
+      (test* #"array-transpose (~c)" (array-transpose (->array a))
+             (array-transpose a) array-approx-equal?)
+      (test* #"determinant (~c)" -2.0
+             (determinant (array-of class #,(<array> (0 2 0 2) 1 2 3 4)))
+             approx-equal?)
+      (test* #"determinant (~c, singular)" 0.0
+             (determinant (array-of class #,(<array> (0 2 0 2) 1 2 2 4))))
+      (test* #"array-inverse (~c, singular)" #f
+             (array-inverse
+              (array-of class #,(<array> (0 2 0 2) 1 2 2 4))))
+      (test* #"array-inverse (~c)" (identity-array 50)
+             (array-mul s (array-inverse s))
+             (^[x y] (array-equal? x y (cut approx-equal? <> <> 1e-3))))
+      (test* #"array-div-left (~c)" (->array b)
+             (let1 d (random-array class 45 45 100)
+               (array-mul d (array-div-left b d)))
+             (^[x y] (array-equal? x y (cut approx-equal? <> <> 1e-3))))
+      (test* #"array-add-elements (~c)"
+             (array-add-elements (->array s) 2 (->array s))
+             (array-add-elements s 2 s) array-approx-equal?)
+      (test* #"array-div-elements (~c)"
+             (array-div-elements (->array s) 4)
+             (array-div-elements s 4) array-approx-equal?)
+      ;; views go to the kernels without copying
+      (let1 t (share-array a (shape 0 45 0 70) (^[i j] (values j i)))
+        (test* #"array-mul (~c, shared)" (array-mul (->array t) (->array a))
+               (array-mul t a) array-approx-equal?))
+      (let ([t (array-transpose-view b)]
+            [r (subarray-view b (shape 5 25 10 80))])
+        (test* #"array-mul (~c, transposed)"
+               (array-mul (->array t) (->array a))
+               (array-mul t a) array-approx-equal?)
+        (test* #"array-mul (~c, subarray)"
+               (array-mul (->array a) (subarray (->array b) (shape 0 45 7 47)))
+               (array-mul a (subarray-view b (shape 0 45 7 47)))
+               array-approx-equal?)
+        (test* #"array-transpose (~c, subarray)"
+               (array-transpose (->array r))
+               (array-transpose r) array-approx-equal?)
+        (let1 d (random-array class 6 6 10)
+          (test* #"determinant (~c, transposed)"
+                 (determinant (->array d))
+                 (determinant (array-transpose-view d))
+                 (^[x y] (< (abs (- x y)) (* 1e-5 (abs x)))))))
+      (test* #"array-add-elements (~c, broadcast)"
+             (array-add-elements (->array s)
+                                 (array-broadcast (array-slice (->array s) 0 3)
+                                                  (array-shape s)))
+             (array-add-elements s (array-broadcast (array-slice s 0 3)
+                                                    (array-shape s)))
+             array-approx-equal?)
+      (test* #"array-add-elements! (~c, view)"
+             (->array (array-add-elements s (array-transpose-view s)))
+             (let1 s2 (copy-object s)
+               (array-add-elements! s2 (array-transpose-view s2))
+               s2)
+             array-approx-equal?)
+      (test* #"array-concatenate (~c)"
+             (array-concatenate (->array a) (->array (array-transpose-view b)))
+             (array-concatenate a (array-transpose-view b))
+             array-approx-equal?)
+      )))
+
 
 ;;-------------------------------------------------------------------
 ;; NB: copy-port uses read-block! and write-block for block copy,
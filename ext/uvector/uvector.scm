@@ -132,6 +132,52 @@
  (define-cproc uvector-alias
    (klass::<class> v::<uvector> :optional (start::<int> 0) (end::<int> -1))
    Scm_UVectorAlias)
+ (define-cproc uvector-slice
+   (v::<uvector> :optional (start::<int> 0) (end::<int> -1))
+   Scm_UVectorSlice)
+ )
+
+;; uvector-sort!
+(inline-stub
+ (define-cproc uvector-sort!
+   (v::<uvector> :optional (start::<fixnum> 0) (end::<fixnum> -1))
+   (Scm_UVectorSort v start end)
+   (return (SCM_OBJ v)))
+ )
+
+;; matrix and strided array kernels, used by gauche.array (see matrix.scm)
+(inline-stub
+ "#include \"uvmatrix.h\""
+
+ (define-cproc %uvector-matrix-mul! (c::<uvector>
+                                     a::<uvector> aoff::<fixnum>
+                                     astr::<s32vector>
+                                     b::<uvector> boff::<fixnum>
+                                     bstr::<s32vector>
+                                     n::<int> m::<int> p::<int>)
+   ::<void> Scm__UVMatrixMul)
+ ;; OP is one of copy, add, sub, mul or div.
+ (define-cproc %uvector-strided-op! (op dims::<s32vector>
+                                     d::<uvector> doff::<fixnum>
+                                     dstr::<s32vector>
+                                     x::<uvector> xoff::<fixnum>
+                                     xstr::<s32vector>
+                                     :optional (y #f) (yoff::<fixnum> 0)
+                                               (ystr::<s32vector>? #f))
+   ::<void>
+   (let* ([o::int 0])
+     (cond [(SCM_EQ op 'copy) (set! o UVM_COPY)]
+           [(SCM_EQ op 'add)  (set! o UVM_ADD)]
+           [(SCM_EQ op 'sub)  (set! o UVM_SUB)]
+           [(SCM_EQ op 'mul)  (set! o UVM_MUL)]
+           [(SCM_EQ op 'div)  (set! o UVM_DIV)]
+           [else (Scm_Error "bad strided operation: %S" op)])
+     (Scm__UVStridedOp o dims d doff dstr x xoff xstr y yoff ystr)))
+ (define-cproc %uvector-matrix-lu! (a::<uvector> piv::<s32vector> n::<int>)
+   ::<int> Scm__UVMatrixLU)
+ (define-cproc %uvector-matrix-lu-solve! (lu::<uvector> piv::<s32vector>
+                                          b::<uvector> n::<int> r::<int>)
+   ::<void> Scm__UVMatrixLUSolve)
  )
 
 ;; byte swapping
@@ -173,9 +219,14 @@
 ;; allocation by class
 (inline-stub
  (define-cproc make-uvector (klass::<class> size::<fixnum>
-                             :optional (init 0))
+                             :optional (init 0) :rest opts)
    (unless (>= size 0) (Scm_Error "invalid uvector size: %d" size))
-   (let* ([v (Scm_MakeUVector klass size NULL)])
+   (when (SCM_KEYWORDP init)            ; (make-uvector c n :storage s)
+     (set! opts (Scm_Cons init opts) init (SCM_MAKE_INT 0)))
+   (let* ([v (?: (SCM_NULLP opts)
+                 (Scm_MakeUVector klass size NULL)
+                 (Scm_MakeUVectorStorage klass size
+                                         (Scm_GetKeyword ':storage opts 'heap)))])
      (case (Scm_UVectorType klass)
        [(SCM_UVECTOR_S8)
         (Scm_S8VectorFill (SCM_S8VECTOR v) 
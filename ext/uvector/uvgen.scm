@@ -301,16 +301,83 @@
 
 (define (dummy . _) "/* not implemented */")
 
+;;===============================================================
+;; SIMD kernel calls (see uvsimd.h)
+;;
+
+(define (simd-elts tag v)
+  #"SCM_~(string-upcase (symbol->string tag))VECTOR_ELEMENTS(~v)")
+
+(define (simd-kernel tag name)
+  #"Scm__UVSimd~(string-upcase (symbol->string tag))~name")
+
+(define (SIMD_NUMOP tag opname)
+  (^[d s0 s1 size clamp]
+    (let1 args #"UVSIMD_~(string-upcase opname), ~(simd-elts tag d), \
+                 ~(simd-elts tag s0), ~(simd-elts tag s1), ~size"
+      (case tag
+        [(f32 f64 s32) #"~(simd-kernel tag \"Op\")(~args)"]
+        [(u8)          #"~(simd-kernel tag \"Op\")(~args, ~clamp)"]
+        [else "0"]))))
+
+(define (SIMD_DOT tag)
+  (^[i0 x y size r rr]
+    (let1 call (^[name . accs]
+                 #"~i0 = ~(simd-kernel tag name)(~(simd-elts tag x), \
+                   ~(simd-elts tag y), ~|size|~(string-join accs \", &\" 'prefix))")
+      (simd-accum tag i0 r rr call "Dot"))))
+
+(define (SIMD_SUM tag)
+  (^[i0 x size r rr]
+    (let1 call (^[name . accs]
+                 #"~i0 = ~(simd-kernel tag name)(~(simd-elts tag x), \
+                   ~|size|~(string-join accs \", &\" 'prefix))")
+      (simd-accum tag i0 r rr call "Sum"))))
+
+;; Common part of SIMD_DOT and SIMD_SUM.  Floating point partial results
+;; go to R; integer ones go to RR, for they may not fit in ntype.
+(define (simd-accum tag i0 r rr call name)
+  (case tag
+    [(f32 f64)
+     #"{ double s_; ~(call name \"s_\"); if (~i0 > 0) ~r = s_; }"]
+    [(s32)
+     (if (equal? name "Dot")
+       #"{ ScmInt64 h_; ScmUInt64 l_; ~(call name \"h_\" \"l_\");\n\
+          if (~i0 > 0) ~rr = Scm_Add(~rr, \
+            Scm_Add(Scm_Ash(Scm_MakeInteger64(h_), 32), \
+                    Scm_MakeIntegerU64(l_))); }"
+       #"{ ScmInt64 s_; ~(call name \"s_\");\n\
+          if (~i0 > 0) ~rr = Scm_Add(~rr, Scm_MakeInteger64(s_)); }")]
+    [(u8)
+     #"{ ScmUInt64 s_; ~(call name \"s_\");\n\
+        if (~i0 > 0) ~rr = Scm_Add(~rr, Scm_MakeIntegerU64(s_)); }"]
+    [else #"~i0 = 0"]))
+
+(define (SIMD_MINMAX tag)
+  (^[i0 x size maxp r]
+    (let1 etype (case tag
+                  [(f32) "float"] [(f64) "double"]
+                  [(s32) "ScmInt32"] [(u8) "u_char"] [else #f])
+      (if etype
+        #"{ ~etype m_; int k_ = ~(simd-kernel tag \"MinMax\")(\
+             ~(simd-elts tag x), ~size, ~maxp, &m_);\n\
+            if (k_ > 0) { ~i0 = k_; ~r = m_; } }"
+        "/* no SIMD kernel */"))))
+
 ;;===============================================================
 ;; Uvector opertaion generator
 ;;
 
 (define (generate-numop)
+  (define (tag-of rule) (string->symbol (getval rule 't)))
   (for-each (^[opname Opname Sopname]
               (dolist [rule (make-rules)]
                 (for-each (cute substitute <> `((opname  ,opname)
                                                 (Opname  ,Opname)
                                                 (Sopname ,Sopname)
+                                                (SIMD_NUMOP
+                                                 ,(SIMD_NUMOP (tag-of rule)
+                                                              opname))
                                                 ,@rule))
                           *tmpl-numop*)))
             '("add" "sub" "mul")
@@ -320,6 +387,8 @@
     (for-each (cute substitute <> `((opname  "div")
                                     (Opname  "Div")
                                     (Sopname  "Div")
+                                    (SIMD_NUMOP ,(SIMD_NUMOP (tag-of rule)
+                                                             "div"))
                                     ,@rule))
               *tmpl-numop*)))
 
@@ -355,7 +424,9 @@
         (case tag
           [(s64 u64) #"SCM_SET_INT64_ZERO(~r)"]
           [else #"~r = 0"]))
-      (for-each (cute substitute <> `((ZERO  ,ZERO) ,@rule))
+      (for-each (cute substitute <> `((ZERO  ,ZERO)
+                                      (SIMD_DOT ,(SIMD_DOT tag))
+                                      ,@rule))
                 *tmpl-dotop*))))
 
 (define (generate-rangeop)
@@ -411,6 +482,24 @@
                                         ,@rule))
                   *tmpl-rangeop*)))))
 
+(define (generate-reduceop)
+  (dolist [rule (make-rules)]
+    (let1 tag (string->symbol (getval rule 't))
+      (define (ZERO r)
+        (case tag
+          [(s64 u64) #"SCM_SET_INT64_ZERO(~r)"]
+          [else #"~r = 0"]))
+      (define (LT a b)
+        (case tag
+          [(s64 u64) #"INT64LT(~|a|, ~|b|)"]
+          [else      #"(~a < ~b)"]))
+      (for-each (cute substitute <> `((ZERO  ,ZERO)
+                                      (LT  ,LT)
+                                      (SIMD_SUM ,(SIMD_SUM tag))
+                                      (SIMD_MINMAX ,(SIMD_MINMAX tag))
+                                      ,@rule))
+                *tmpl-reduceop*))))
+
 (define (generate-swapb)
   (dolist [rule (make-rules)]
     (let1 tag (string->symbol (getval rule 't))
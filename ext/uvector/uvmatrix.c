@@ -0,0 +1,628 @@
+/*
+ * uvmatrix.c - dense matrix kernels for gauche.array
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * These are the core of array-mul, array-inverse, determinant and the
+ * element-wise operations of gauche.array (see matrix.scm), used when
+ * the operands are <f32array>s or <f64array>s.
+ *
+ * An array is a strided view of its backing storage: the element at
+ * the start index is at OFFSET, and incrementing the index of the k-th
+ * dimension advances STRIDES[k] elements (which may be zero or
+ * negative).  Matrix multiplication packs the operands into contiguous
+ * buffers when they aren't already; LU decomposition works on
+ * contiguous matrices only, and the callers give it a fresh copy.
+ *
+ * If Gauche is configured with --with-blas, multiplication of large
+ * matrices is done by cblas_?gemm, and LU decomposition by
+ * LAPACKE_?getrf/?getrs if LAPACKE is also available.  Otherwise, and
+ * for small matrices where the call overhead dominates, we use the
+ * following loops; they are blocked so that the working set fits in the
+ * cache, and the innermost loops run over contiguous rows so that the
+ * compiler can vectorize them.  Both produce the same LU format (unit
+ * lower triangle L and upper triangle U packed in one matrix, and
+ * 0-based row interchanges), so they can be mixed.
+ */
+
+#include <gauche.h>
+#include <math.h>
+#include "uvmatrix.h"
+
+#if defined(HAVE_CBLAS)
+#include <cblas.h>
+#endif
+#if defined(HAVE_LAPACKE)
+#include <lapacke.h>
+#endif
+
+#define BLOCK_I  64
+#define BLOCK_K  128
+#define BLOCK_J  256
+#define BLOCK_T  32
+
+/* Matrices smaller than these are handled by our own loops */
+#define BLAS_MIN_FLOPS  (64*64*64)
+#define LAPACK_MIN_N    64
+
+#define MIN(a, b)  ((a) < (b) ? (a) : (b))
+#define MAX(a, b)  ((a) > (b) ? (a) : (b))
+
+#define DEFINE_KERNELS(T, TAG, ABS)                                     \
+static void TAG##_mul(T *c, const T *a, const T *b, int n, int m, int p) \
+{                                                                       \
+    memset(c, 0, sizeof(T)*n*p);                                        \
+    for (int ii = 0; ii < n; ii += BLOCK_I) {                           \
+        int ie = MIN(ii + BLOCK_I, n);                                  \
+        for (int kk = 0; kk < m; kk += BLOCK_K) {                       \
+            int ke = MIN(kk + BLOCK_K, m);                              \
+            for (int jj = 0; jj < p; jj += BLOCK_J) {                   \
+                int je = MIN(jj + BLOCK_J, p);                          \
+                int i = ii;                                             \
+                /* four rows of C at a time, to reuse the rows of B */  \
+                for (; i + 4 <= ie; i += 4) {                           \
+                    T *c0 = c + (size_t)i*p, *c1 = c0 + p;              \
+                    T *c2 = c1 + p, *c3 = c2 + p;                       \
+                    for (int k = kk; k < ke; k++) {                     \
+                        const T *br = b + (size_t)k*p;                  \
+                        T a0 = a[(size_t)i*m + k];                      \
+                        T a1 = a[(size_t)(i+1)*m + k];                  \
+                        T a2 = a[(size_t)(i+2)*m + k];                  \
+                        T a3 = a[(size_t)(i+3)*m + k];                  \
+                        for (int j = jj; j < je; j++) {                 \
+                            T bj = br[j];                               \
+                            c0[j] += a0*bj; c1[j] += a1*bj;             \
+                            c2[j] += a2*bj; c3[j] += a3*bj;             \
+                        }                                               \
+                    }                                                   \
+                }                                                       \
+                for (; i < ie; i++) {                                   \
+                    T *cr = c + (size_t)i*p;                            \
+                    for (int k = kk; k < ke; k++) {                     \
+                        const T *br = b + (size_t)k*p;                  \
+                        T ak = a[(size_t)i*m + k];                      \
+                        for (int j = jj; j < je; j++) cr[j] += ak*br[j]; \
+                    }                                                   \
+                }                                                       \
+            }                                                           \
+        }                                                               \
+    }                                                                   \
+}                                                                       \
+                                                                        \
+static int TAG##_lu(T *a, ScmInt32 *piv, int n)                         \
+{                                                                       \
+    int sign = 1;                                                       \
+    for (int k = 0; k < n; k++) {                                       \
+        int p = k;                                                      \
+        T pmax = ABS(a[(size_t)k*n + k]);                               \
+        for (int i = k+1; i < n; i++) {                                 \
+            T v = ABS(a[(size_t)i*n + k]);                              \
+            if (v > pmax) { pmax = v; p = i; }                          \
+        }                                                               \
+        piv[k] = p;                                                     \
+        if (pmax == 0) { sign = 0; continue; }                          \
+        if (p != k) {                                                   \
+            T *rk = a + (size_t)k*n, *rp = a + (size_t)p*n;             \
+            for (int j = 0; j < n; j++) {                               \
+                T t = rk[j]; rk[j] = rp[j]; rp[j] = t;                  \
+            }                                                           \
+            sign = -sign;                                               \
+        }                                                               \
+        const T *rk = a + (size_t)k*n;                                  \
+        T pivot = rk[k];                                                \
+        for (int i = k+1; i < n; i++) {                                 \
+            T *ri = a + (size_t)i*n;                                    \
+            T l = ri[k] / pivot;                                        \
+            ri[k] = l;                                                  \
+            if (l == 0) continue;                                       \
+            for (int j = k+1; j < n; j++) ri[j] -= l*rk[j];             \
+        }                                                               \
+    }                                                                   \
+    return sign;                                                        \
+}                                                                       \
+                                                                        \
+static void TAG##_lusolve(const T *lu, const ScmInt32 *piv, T *b,       \
+                          int n, int r)                                 \
+{                                                                       \
+    for (int k = 0; k < n; k++) {                                       \
+        if (piv[k] != k) {                                              \
+            T *bk = b + (size_t)k*r, *bp = b + (size_t)piv[k]*r;        \
+            for (int j = 0; j < r; j++) {                               \
+                T t = bk[j]; bk[j] = bp[j]; bp[j] = t;                  \
+            }                                                           \
+        }                                                               \
+    }                                                                   \
+    /* forward substitution with unit lower triangle */                 \
+    for (int i = 1; i < n; i++) {                                       \
+        T *bi = b + (size_t)i*r;                                        \
+        for (int k = 0; k < i; k++) {                                   \
+            T l = lu[(size_t)i*n + k];                                  \
+            if (l == 0) continue;                                       \
+            const T *bk = b + (size_t)k*r;                              \
+            for (int j = 0; j < r; j++) bi[j] -= l*bk[j];               \
+        }                                                               \
+    }                                                                   \
+    /* backward substitution with upper triangle */                     \
+    for (int i = n-1; i >= 0; i--) {                                    \
+        T *bi = b + (size_t)i*r;                                        \
+        for (int k = i+1; k < n; k++) {                                 \
+            T u = lu[(size_t)i*n + k];                                  \
+            if (u == 0) continue;                                       \
+            const T *bk = b + (size_t)k*r;                              \
+            for (int j = 0; j < r; j++) bi[j] -= u*bk[j];               \
+        }                                                               \
+        T d = lu[(size_t)i*n + i];                                      \
+        for (int j = 0; j < r; j++) bi[j] /= d;                         \
+    }                                                                   \
+}
+
+DEFINE_KERNELS(float, f32, fabsf)
+DEFINE_KERNELS(double, f64, fabs)
+
+/* Copies an NxM strided matrix S into contiguous D.  Blocked, so that
+   it works well for transposed views. */
+#define DEFINE_PACK(T, TAG)                                             \
+static void TAG##_pack(T *d, const T *s, ScmSmallInt rs, ScmSmallInt cs, \
+                       int n, int m)                                    \
+{                                                                       \
+    if (cs == 1) {                                                      \
+        for (int i = 0; i < n; i++) {                                   \
+            memcpy(d + (size_t)i*m, s + i*rs, sizeof(T)*m);             \
+        }                                                               \
+        return;                                                         \
+    }                                                                   \
+    for (int ii = 0; ii < n; ii += BLOCK_T) {                           \
+        int ie = MIN(ii + BLOCK_T, n);                                  \
+        for (int jj = 0; jj < m; jj += BLOCK_T) {                       \
+            int je = MIN(jj + BLOCK_T, m);                              \
+            for (int i = ii; i < ie; i++) {                             \
+                for (int j = jj; j < je; j++) {                         \
+                    d[(size_t)i*m + j] = s[i*rs + j*cs];                \
+                }                                                       \
+            }                                                           \
+        }                                                               \
+    }                                                                   \
+}
+
+DEFINE_PACK(ScmUInt32, u32)
+DEFINE_PACK(ScmUInt64, u64)
+
+/*
+ * Argument checks
+ */
+
+/* Returns TRUE for f64, FALSE for f32 */
+static int check_class(const char *name, ScmUVector *v, ScmUVector *ref)
+{
+    if (!SCM_F32VECTORP(v) && !SCM_F64VECTORP(v)) {
+        Scm_Error("%s: f32vector or f64vector required, but got: %S",
+                  name, SCM_OBJ(v));
+    }
+    if (ref != NULL && !SCM_EQ(Scm_ClassOf(SCM_OBJ(v)),
+                               Scm_ClassOf(SCM_OBJ(ref)))) {
+        Scm_Error("%s: uvector class mismatch: %S and %S",
+                  name, SCM_OBJ(ref), SCM_OBJ(v));
+    }
+    return SCM_F64VECTORP(v);
+}
+
+static void check_size(const char *name, ScmUVector *v, int rows, int cols)
+{
+    if (rows < 0 || cols < 0
+        || SCM_UVECTOR_SIZE(v) != (ScmSmallInt)rows*cols) {
+        Scm_Error("%s: %dx%d matrix required, but got a vector of length %d",
+                  name, rows, cols, SCM_UVECTOR_SIZE(v));
+    }
+}
+
+/* Checks that every element of the view of the given DIMS lies within
+   V.  Returns FALSE if the view is empty. */
+static int check_view(const char *name, ScmUVector *v, ScmSmallInt off,
+                      ScmS32Vector *strides, const ScmInt32 *dims, int rank)
+{
+    if (SCM_S32VECTOR_SIZE(strides) != rank) {
+        Scm_Error("%s: strides %S don't match the rank %d",
+                  name, SCM_OBJ(strides), rank);
+    }
+    const ScmInt32 *st = SCM_S32VECTOR_ELEMENTS(strides);
+    ScmSmallInt lo = off, hi = off;
+    for (int k = 0; k < rank; k++) {
+        if (dims[k] < 0) Scm_Error("%s: negative dimension", name);
+        if (dims[k] == 0) return FALSE;
+        if (st[k] > 0) hi += (ScmSmallInt)st[k] * (dims[k]-1);
+        else           lo += (ScmSmallInt)st[k] * (dims[k]-1);
+    }
+    if (lo < 0 || hi >= SCM_UVECTOR_SIZE(v)) {
+        Scm_Error("%s: view (offset %ld, strides %S) is out of the range "
+                  "of the backing storage of length %d", name,
+                  off, SCM_OBJ(strides), SCM_UVECTOR_SIZE(v));
+    }
+    return TRUE;
+}
+
+/* Returns a pointer to the NxM view of V at OFF with row stride RS and
+   column stride CS, as a contiguous row-major matrix.  If the view
+   isn't contiguous it is copied into a fresh buffer. */
+static const void *contiguous_matrix(ScmUVector *v, ScmSmallInt off,
+                                     ScmSmallInt rs, ScmSmallInt cs,
+                                     int n, int m)
+{
+    int f64p = SCM_F64VECTORP(v);
+    if (cs == 1 && (rs == m || n == 1)) {
+        return f64p
+            ? (const void*)(SCM_F64VECTOR_ELEMENTS(v) + off)
+            : (const void*)(SCM_F32VECTOR_ELEMENTS(v) + off);
+    }
+    if (f64p) {
+        ScmUInt64 *p = SCM_NEW_ATOMIC_ARRAY(ScmUInt64, (size_t)n*m);
+        u64_pack(p, (ScmUInt64*)SCM_F64VECTOR_ELEMENTS(v) + off, rs, cs, n, m);
+        return p;
+    } else {
+        ScmUInt32 *p = SCM_NEW_ATOMIC_ARRAY(ScmUInt32, (size_t)n*m);
+        u32_pack(p, (ScmUInt32*)SCM_F32VECTOR_ELEMENTS(v) + off, rs, cs, n, m);
+        return p;
+    }
+}
+
+#if defined(HAVE_CBLAS)
+/* Returns the leading dimension to pass to BLAS for an NxM view with
+   row stride RS and column stride CS, or 0 if BLAS can't take it. */
+static int blas_ld(ScmSmallInt rs, ScmSmallInt cs, int n, int m)
+{
+    if (cs == 1 && (rs >= m || n == 1)) return (int)MAX(rs, m);
+    if (rs == 1 && (cs >= n || m == 1)) return (int)MAX(cs, n);
+    return 0;
+}
+#endif /*HAVE_CBLAS*/
+
+void Scm__UVMatrixMul(ScmUVector *c,
+                      ScmUVector *a, ScmSmallInt aoff, ScmS32Vector *astr,
+                      ScmUVector *b, ScmSmallInt boff, ScmS32Vector *bstr,
+                      int n, int m, int p)
+{
+    static const char name[] = "matrix-mul";
+    int f64p = check_class(name, a, NULL);
+    check_class(name, b, a);
+    check_class(name, c, a);
+    check_size(name, c, n, p);
+    SCM_UVECTOR_CHECK_MUTABLE(c);
+    ScmInt32 adims[2] = {n, m}, bdims[2] = {m, p};
+    int anonempty = check_view(name, a, aoff, astr, adims, 2);
+    int bnonempty = check_view(name, b, boff, bstr, bdims, 2);
+    if (n == 0 || p == 0) return;
+    if (!anonempty || !bnonempty) {  /* m == 0 */
+        memset(SCM_UVECTOR_ELEMENTS(c), 0, Scm_UVectorSizeInBytes(c));
+        return;
+    }
+    ScmSmallInt ars = SCM_S32VECTOR_ELEMENTS(astr)[0];
+    ScmSmallInt acs = SCM_S32VECTOR_ELEMENTS(astr)[1];
+    ScmSmallInt brs = SCM_S32VECTOR_ELEMENTS(bstr)[0];
+    ScmSmallInt bcs = SCM_S32VECTOR_ELEMENTS(bstr)[1];
+#if defined(HAVE_CBLAS)
+    /* BLAS takes transposed operands as well, as long as one of the
+       strides is 1 and the other doesn't make rows overlap. */
+    int lda = blas_ld(ars, acs, n, m), ldb = blas_ld(brs, bcs, m, p);
+    if ((double)n*m*p >= BLAS_MIN_FLOPS && lda != 0 && ldb != 0) {
+        enum CBLAS_TRANSPOSE ta = (acs == 1)? CblasNoTrans : CblasTrans;
+        enum CBLAS_TRANSPOSE tb = (bcs == 1)? CblasNoTrans : CblasTrans;
+        if (f64p) {
+            cblas_dgemm(CblasRowMajor, ta, tb, n, p, m,
+                        1.0, SCM_F64VECTOR_ELEMENTS(a) + aoff, lda,
+                        SCM_F64VECTOR_ELEMENTS(b) + boff, ldb,
+                        0.0, SCM_F64VECTOR_ELEMENTS(c), p);
+        } else {
+            cblas_sgemm(CblasRowMajor, ta, tb, n, p, m,
+                        1.0f, SCM_F32VECTOR_ELEMENTS(a) + aoff, lda,
+                        SCM_F32VECTOR_ELEMENTS(b) + boff, ldb,
+                        0.0f, SCM_F32VECTOR_ELEMENTS(c), p);
+        }
+        return;
+    }
+#endif /*HAVE_CBLAS*/
+    const void *ap = contiguous_matrix(a, aoff, ars, acs, n, m);
+    const void *bp = contiguous_matrix(b, boff, brs, bcs, m, p);
+    if (f64p) {
+        f64_mul(SCM_F64VECTOR_ELEMENTS(c), ap, bp, n, m, p);
+    } else {
+        f32_mul(SCM_F32VECTOR_ELEMENTS(c), ap, bp, n, m, p);
+    }
+}
+
+/*
+ * Element-wise operations on strided views
+ */
+
+typedef struct strided_op_rec {
+    int op;                     /* UVM_* */
+    int f64p;
+    int eltsize;
+    int n;                      /* length of the innermost dimension */
+    char *d;                    /* storage base pointers */
+    const char *x;
+    const char *y;              /* NULL if scalar */
+    double scalar;
+    ScmSmallInt ds, xs, ys;     /* innermost strides */
+} strided_op;
+
+#define DEFINE_ROW_OP(T, TAG)                                           \
+static void TAG##_row(const strided_op *o, ScmSmallInt d, ScmSmallInt x, \
+                      ScmSmallInt y)                                    \
+{                                                                       \
+    T *dp = (T*)o->d + d;                                               \
+    const T *xp = (const T*)o->x + x;                                   \
+    ScmSmallInt ds = o->ds, xs = o->xs;                                 \
+    int n = o->n;                                                       \
+    if (o->y == NULL) {                                                 \
+        T c = (T)o->scalar;                                             \
+        switch (o->op) {                                                \
+        case UVM_ADD:                                                   \
+            for (int i=0; i<n; i++) dp[i*ds] = xp[i*xs] + c;            \
+            break;                                                      \
+        case UVM_SUB:                                                   \
+            for (int i=0; i<n; i++) dp[i*ds] = xp[i*xs] - c;            \
+            break;                                                      \
+        case UVM_MUL:                                                   \
+            for (int i=0; i<n; i++) dp[i*ds] = xp[i*xs] * c;            \
+            break;                                                      \
+        case UVM_DIV:                                                   \
+            for (int i=0; i<n; i++) dp[i*ds] = xp[i*xs] / c;            \
+            break;                                                      \
+        }                                                               \
+    } else {                                                            \
+        const T *yp = (const T*)o->y + y;                               \
+        ScmSmallInt ys = o->ys;                                         \
+        switch (o->op) {                                                \
+        case UVM_ADD:                                                   \
+            for (int i=0; i<n; i++) dp[i*ds] = xp[i*xs] + yp[i*ys];     \
+            break;                                                      \
+        case UVM_SUB:                                                   \
+            for (int i=0; i<n; i++) dp[i*ds] = xp[i*xs] - yp[i*ys];     \
+            break;                                                      \
+        case UVM_MUL:                                                   \
+            for (int i=0; i<n; i++) dp[i*ds] = xp[i*xs] * yp[i*ys];     \
+            break;                                                      \
+        case UVM_DIV:                                                   \
+            for (int i=0; i<n; i++) dp[i*ds] = xp[i*xs] / yp[i*ys];     \
+            break;                                                      \
+        }                                                               \
+    }                                                                   \
+}
+
+DEFINE_ROW_OP(float, f32)
+DEFINE_ROW_OP(double, f64)
+
+#define DEFINE_COPY_ROW(T, TAG)                                         \
+static void TAG##_copy_row(const strided_op *o, ScmSmallInt d,          \
+                           ScmSmallInt x)                               \
+{                                                                       \
+    T *dp = (T*)o->d + d;                                               \
+    const T *xp = (const T*)o->x + x;                                   \
+    ScmSmallInt ds = o->ds, xs = o->xs;                                 \
+    for (int i = 0; i < o->n; i++) dp[i*ds] = xp[i*xs];                 \
+}
+
+DEFINE_COPY_ROW(u_char, u8)
+DEFINE_COPY_ROW(unsigned short, u16)
+DEFINE_COPY_ROW(ScmUInt32, u32)
+DEFINE_COPY_ROW(ScmUInt64, u64)
+
+static void do_row(const strided_op *o, ScmSmallInt d, ScmSmallInt x,
+                   ScmSmallInt y)
+{
+    if (o->op == UVM_COPY) {
+        if (o->ds == 1 && o->xs == 1) {
+            memmove(o->d + d*o->eltsize, o->x + x*o->eltsize,
+                    (size_t)o->n*o->eltsize);
+            return;
+        }
+        switch (o->eltsize) {
+        case 1: u8_copy_row(o, d, x); break;
+        case 2: u16_copy_row(o, d, x); break;
+        case 4: u32_copy_row(o, d, x); break;
+        case 8: u64_copy_row(o, d, x); break;
+        }
+    } else if (o->f64p) {
+        f64_row(o, d, x, y);
+    } else {
+        f32_row(o, d, x, y);
+    }
+}
+
+void Scm__UVStridedOp(int op, ScmS32Vector *dims,
+                      ScmUVector *d, ScmSmallInt doff, ScmS32Vector *dstr,
+                      ScmUVector *x, ScmSmallInt xoff, ScmS32Vector *xstr,
+                      ScmObj y, ScmSmallInt yoff, ScmS32Vector *ystr)
+{
+    static const char name[] = "strided-op";
+    int rank = SCM_S32VECTOR_SIZE(dims);
+    const ScmInt32 *dm = SCM_S32VECTOR_ELEMENTS(dims);
+    strided_op o;
+
+    if (op == UVM_COPY) {
+        if (!SCM_EQ(Scm_ClassOf(SCM_OBJ(d)), Scm_ClassOf(SCM_OBJ(x)))) {
+            Scm_Error("%s: uvector class mismatch: %S and %S",
+                      name, SCM_OBJ(d), SCM_OBJ(x));
+        }
+        o.f64p = FALSE;
+    } else {
+        o.f64p = check_class(name, d, NULL);
+        check_class(name, x, d);
+        if (SCM_UVECTORP(y)) {
+            check_class(name, SCM_UVECTOR(y), d);
+        } else if (!SCM_REALP(y)) {
+            Scm_Error("%s: uvector or real number required, but got: %S",
+                      name, y);
+        }
+    }
+    SCM_UVECTOR_CHECK_MUTABLE(d);
+    if (!check_view(name, d, doff, dstr, dm, rank)) return;
+    check_view(name, x, xoff, xstr, dm, rank);
+    if (op != UVM_COPY && SCM_UVECTORP(y)) {
+        if (ystr == NULL) Scm_Error("%s: strides required for %S", name, y);
+        check_view(name, SCM_UVECTOR(y), yoff, ystr, dm, rank);
+        o.y = SCM_UVECTOR_ELEMENTS(y);
+        o.scalar = 0;
+    } else {
+        o.y = NULL;
+        o.scalar = (op == UVM_COPY)? 0 : Scm_GetDouble(y);
+    }
+
+    o.op = op;
+    o.eltsize = Scm_UVectorElementSize(Scm_ClassOf(SCM_OBJ(d)));
+    o.d = SCM_UVECTOR_ELEMENTS(d);
+    o.x = SCM_UVECTOR_ELEMENTS(x);
+    const ScmInt32 *ds = SCM_S32VECTOR_ELEMENTS(dstr);
+    const ScmInt32 *xs = SCM_S32VECTOR_ELEMENTS(xstr);
+    const ScmInt32 *ys = o.y? SCM_S32VECTOR_ELEMENTS(ystr) : NULL;
+
+    if (rank == 0) {
+        o.n = 1; o.ds = o.xs = o.ys = 0;
+        do_row(&o, doff, xoff, yoff);
+        return;
+    }
+    o.n = dm[rank-1];
+    o.ds = ds[rank-1];
+    o.xs = xs[rank-1];
+    o.ys = ys? ys[rank-1] : 0;
+
+    /* Transposing copy into a contiguous matrix is blocked */
+    if (op == UVM_COPY && rank == 2 && ds[1] == 1 && ds[0] == dm[1]
+        && (o.eltsize == 4 || o.eltsize == 8)) {
+        if (o.eltsize == 4) {
+            u32_pack((ScmUInt32*)o.d + doff, (const ScmUInt32*)o.x + xoff,
+                     xs[0], xs[1], dm[0], dm[1]);
+        } else {
+            u64_pack((ScmUInt64*)o.d + doff, (const ScmUInt64*)o.x + xoff,
+                     xs[0], xs[1], dm[0], dm[1]);
+        }
+        return;
+    }
+
+    /* Iterate over the outer dimensions like an odometer */
+    int *ind = SCM_NEW_ATOMIC_ARRAY(int, rank);
+    for (int k = 0; k < rank; k++) ind[k] = 0;
+    ScmSmallInt dp = doff, xp = xoff, yp = yoff;
+    for (;;) {
+        do_row(&o, dp, xp, yp);
+        int k = rank - 2;
+        for (; k >= 0; k--) {
+            dp += ds[k]; xp += xs[k]; if (ys) yp += ys[k];
+            if (++ind[k] < dm[k]) break;
+            dp -= (ScmSmallInt)ds[k]*dm[k];
+            xp -= (ScmSmallInt)xs[k]*dm[k];
+            if (ys) yp -= (ScmSmallInt)ys[k]*dm[k];
+            ind[k] = 0;
+        }
+        if (k < 0) break;
+    }
+}
+
+int Scm__UVMatrixLU(ScmUVector *a, ScmS32Vector *piv, int n)
+{
+    static const char name[] = "matrix-lu";
+    int f64p = check_class(name, a, NULL);
+    check_size(name, a, n, n);
+    check_size(name, SCM_UVECTOR(piv), n, 1);
+    SCM_UVECTOR_CHECK_MUTABLE(a);
+    SCM_UVECTOR_CHECK_MUTABLE(piv);
+    ScmInt32 *pv = SCM_S32VECTOR_ELEMENTS(piv);
+#if defined(HAVE_LAPACKE)
+    if (n >= LAPACK_MIN_N) {
+        lapack_int *ipiv = SCM_NEW_ATOMIC_ARRAY(lapack_int, n);
+        lapack_int info;
+        if (f64p) {
+            info = LAPACKE_dgetrf(LAPACK_ROW_MAJOR, n, n,
+                                  SCM_F64VECTOR_ELEMENTS(a), n, ipiv);
+        } else {
+            info = LAPACKE_sgetrf(LAPACK_ROW_MAJOR, n, n,
+                                  SCM_F32VECTOR_ELEMENTS(a), n, ipiv);
+        }
+        if (info < 0) {
+            Scm_Error("%s: LAPACKE_?getrf failed (%d)", name, (int)info);
+        }
+        int sign = 1;
+        for (int k = 0; k < n; k++) {
+            pv[k] = (ScmInt32)ipiv[k] - 1;
+            if (pv[k] != k) sign = -sign;
+        }
+        return (info > 0)? 0 : sign;
+    }
+#endif /*HAVE_LAPACKE*/
+    if (f64p) return f64_lu(SCM_F64VECTOR_ELEMENTS(a), pv, n);
+    else      return f32_lu(SCM_F32VECTOR_ELEMENTS(a), pv, n);
+}
+
+void Scm__UVMatrixLUSolve(ScmUVector *lu, ScmS32Vector *piv,
+                          ScmUVector *b, int n, int r)
+{
+    static const char name[] = "matrix-lu-solve";
+    int f64p = check_class(name, lu, NULL);
+    check_class(name, b, lu);
+    check_size(name, lu, n, n);
+    check_size(name, SCM_UVECTOR(piv), n, 1);
+    check_size(name, b, n, r);
+    SCM_UVECTOR_CHECK_MUTABLE(b);
+    ScmInt32 *pv = SCM_S32VECTOR_ELEMENTS(piv);
+    for (int k = 0; k < n; k++) {
+        if (pv[k] < k || pv[k] >= n) {
+            Scm_Error("%s: invalid pivot vector: %S", name, SCM_OBJ(piv));
+        }
+    }
+    if (n == 0 || r == 0) return;
+#if defined(HAVE_LAPACKE)
+    if (n >= LAPACK_MIN_N) {
+        lapack_int *ipiv = SCM_NEW_ATOMIC_ARRAY(lapack_int, n);
+        for (int k = 0; k < n; k++) ipiv[k] = pv[k] + 1;
+        lapack_int info;
+        if (f64p) {
+            info = LAPACKE_dgetrs(LAPACK_ROW_MAJOR, 'N', n, r,
+                                  SCM_F64VECTOR_ELEMENTS(lu), n, ipiv,
+                                  SCM_F64VECTOR_ELEMENTS(b), r);
+        } else {
+            info = LAPACKE_sgetrs(LAPACK_ROW_MAJOR, 'N', n, r,
+                                  SCM_F32VECTOR_ELEMENTS(lu), n, ipiv,
+                                  SCM_F32VECTOR_ELEMENTS(b), r);
+        }
+        if (info < 0) {
+            Scm_Error("%s: LAPACKE_?getrs failed (%d)", name, (int)info);
+        }
+        return;
+    }
+#endif /*HAVE_LAPACKE*/
+    if (f64p) {
+        f64_lusolve(SCM_F64VECTOR_ELEMENTS(lu), pv,
+                    SCM_F64VECTOR_ELEMENTS(b), n, r);
+    } else {
+        f32_lusolve(SCM_F32VECTOR_ELEMENTS(lu), pv,
+                    SCM_F32VECTOR_ELEMENTS(b), n, r);
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ * uvmatrix.h - dense matrix kernels for gauche.array
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_UVMATRIX_H
+#define GAUCHE_UVMATRIX_H
+
+/*
+ * Operands are f32vectors or f64vectors of the same class.  A strided
+ * operand is given as the backing storage, the offset of the first
+ * element, and an s32vector of strides (in elements) of each
+ * dimension.  Other matrices hold the elements contiguously in
+ * row-major order.  The destination must not share storage with the
+ * sources unless noted.
+ */
+
+/* C (NxP) = A (NxM) * B (MxP).  A and B are strided. */
+extern void Scm__UVMatrixMul(ScmUVector *c,
+                             ScmUVector *a, ScmSmallInt aoff,
+                             ScmS32Vector *astr,
+                             ScmUVector *b, ScmSmallInt boff,
+                             ScmS32Vector *bstr,
+                             int n, int m, int p);
+
+enum {
+    UVM_COPY,                   /* any uvector class */
+    UVM_ADD,
+    UVM_SUB,
+    UVM_MUL,
+    UVM_DIV
+};
+
+/* D = X op Y element-wise, where D, X and Y are strided views of the
+   dimensions DIMS; Y may be a real number instead.  For UVM_COPY, Y
+   is ignored.  D may be the same view as X or Y. */
+extern void Scm__UVStridedOp(int op, ScmS32Vector *dims,
+                             ScmUVector *d, ScmSmallInt doff,
+                             ScmS32Vector *dstr,
+                             ScmUVector *x, ScmSmallInt xoff,
+                             ScmS32Vector *xstr,
+                             ScmObj y, ScmSmallInt yoff,
+                             ScmS32Vector *ystr);
+
+/* LU decomposition of A (NxN) in place, with partial pivoting.
+   Row K was swapped with row PIV[K] at K-th step.  Returns 1 or -1,
+   the sign of the permutation, or 0 if A is singular. */
+extern int Scm__UVMatrixLU(ScmUVector *a, ScmS32Vector *piv, int n);
+
+/* Solves A X = B, where LU and PIV are the result of Scm__UVMatrixLU
+   of A.  B (NxR) is overwritten by X. */
+extern void Scm__UVMatrixLUSolve(ScmUVector *lu, ScmS32Vector *piv,
+                                 ScmUVector *b, int n, int r);
+
+#endif /*GAUCHE_UVMATRIX_H*/
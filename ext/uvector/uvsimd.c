@@ -0,0 +1,894 @@
+/*
+ * uvsimd.c - vectorized kernels for uniform vector operations
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The kernels are called from the code generated by uvgen.scm (see
+ * uvector.c.tmpl) for the hot loops of f32, f64, s32 and u8 vectors.
+ * On x86 we use SSE2 or AVX2, whichever the running CPU supports; on
+ * AArch64 we use NEON for floating-point vectors.  Elementwise
+ * floating-point operations give bit-identical results to the scalar
+ * loops; dot products and sums may differ in the last bits since the
+ * order of summation differs.
+ */
+
+#include <gauche.h>
+#include "uvsimd.h"
+
+#if (defined(__x86_64__) || defined(__i386__))                          \
+    && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))     \
+    && !defined(SCM_EMULATE_INT64)
+#define UVSIMD_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define UVSIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* D[i] = X[i] op Y[i] for each chunk of W elements */
+#define BINOP_LOOP(W, LOAD, STORE, OP)                                  \
+    for (; i+(W)<=n; i+=(W)) STORE(d+i, OP(LOAD(x+i), LOAD(y+i)))
+
+#if defined(UVSIMD_X86)
+
+#define FEATURE_SSE2  1
+#define FEATURE_AVX2  2
+
+/* -1: not checked yet */
+static int x86_features = -1;
+
+static int check_x86_features(void)
+{
+    unsigned int a, b, c, d;
+    int r = 0;
+    if (__get_cpuid(1, &a, &b, &c, &d)) {
+        if (d & (1U<<26)) r |= FEATURE_SSE2;
+        if ((c & (1U<<27)) && __get_cpuid_max(0, NULL) >= 7) { /* OSXSAVE */
+            unsigned int lo, hi;
+            __asm__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+            if ((lo & 6) == 6) {            /* XMM and YMM state */
+                __cpuid_count(7, 0, a, b, c, d);
+                if (b & (1U<<5)) r |= FEATURE_AVX2;
+            }
+        }
+    }
+    /* Setting it more than once from different threads is harmless. */
+    x86_features = r;
+    return r;
+}
+
+#define FEATURES() \
+    (x86_features >= 0 ? x86_features : check_x86_features())
+
+/*================================================================
+ * SSE2
+ */
+
+__attribute__((target("sse2")))
+static int f32op_sse2(int op, float *d, const float *x, const float *y, int n)
+{
+    int i = 0;
+    switch (op) {
+    case UVSIMD_ADD: BINOP_LOOP(4, _mm_loadu_ps, _mm_storeu_ps, _mm_add_ps); break;
+    case UVSIMD_SUB: BINOP_LOOP(4, _mm_loadu_ps, _mm_storeu_ps, _mm_sub_ps); break;
+    case UVSIMD_MUL: BINOP_LOOP(4, _mm_loadu_ps, _mm_storeu_ps, _mm_mul_ps); break;
+    case UVSIMD_DIV: BINOP_LOOP(4, _mm_loadu_ps, _mm_storeu_ps, _mm_div_ps); break;
+    }
+    return i;
+}
+
+__attribute__((target("sse2")))
+static int f64op_sse2(int op, double *d, const double *x, const double *y,
+                      int n)
+{
+    int i = 0;
+    switch (op) {
+    case UVSIMD_ADD: BINOP_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd); break;
+    case UVSIMD_SUB: BINOP_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_sub_pd); break;
+    case UVSIMD_MUL: BINOP_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_mul_pd); break;
+    case UVSIMD_DIV: BINOP_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_div_pd); break;
+    }
+    return i;
+}
+
+/* s32 add and sub; stops before the chunk that overflows. */
+__attribute__((target("sse2")))
+static int s32op_sse2(int op, ScmInt32 *d, const ScmInt32 *x,
+                      const ScmInt32 *y, int n)
+{
+    int i = 0;
+    if (op != UVSIMD_ADD && op != UVSIMD_SUB) return 0;
+    for (; i+4<=n; i+=4) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(x+i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(y+i));
+        __m128i r, ov;
+        if (op == UVSIMD_ADD) {
+            r = _mm_add_epi32(a, b);
+            ov = _mm_and_si128(_mm_xor_si128(a, r), _mm_xor_si128(b, r));
+        } else {
+            r = _mm_sub_epi32(a, b);
+            ov = _mm_and_si128(_mm_xor_si128(a, b), _mm_xor_si128(a, r));
+        }
+        if (_mm_movemask_ps(_mm_castsi128_ps(ov))) break;
+        _mm_storeu_si128((__m128i*)(d+i), r);
+    }
+    return i;
+}
+
+/* u8 ops.  If the result of a chunk doesn't fit, we store the saturated
+   result when CLAMP allows it, or stop otherwise. */
+__attribute__((target("sse2")))
+static int u8op_sse2(int op, u_char *d, const u_char *x, const u_char *y,
+                     int n, int clamp)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i all = _mm_cmpeq_epi8(zero, zero);
+    const __m128i u8max = _mm_set1_epi16(255);
+    int sat = (op == UVSIMD_SUB)? (clamp & SCM_CLAMP_LO) : (clamp & SCM_CLAMP_HI);
+    int i = 0;
+    for (; i+16<=n; i+=16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(x+i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(y+i));
+        __m128i r, ok;
+        switch (op) {
+        case UVSIMD_ADD:
+            r = _mm_adds_epu8(a, b);
+            ok = _mm_cmpeq_epi8(r, _mm_add_epi8(a, b));
+            break;
+        case UVSIMD_SUB:
+            r = _mm_subs_epu8(a, b);
+            ok = _mm_cmpeq_epi8(r, _mm_sub_epi8(a, b));
+            break;
+        case UVSIMD_MUL: {
+            __m128i pl = _mm_mullo_epi16(_mm_unpacklo_epi8(a, zero),
+                                         _mm_unpacklo_epi8(b, zero));
+            __m128i ph = _mm_mullo_epi16(_mm_unpackhi_epi8(a, zero),
+                                         _mm_unpackhi_epi8(b, zero));
+            __m128i okl = _mm_cmpeq_epi16(_mm_srli_epi16(pl, 8), zero);
+            __m128i okh = _mm_cmpeq_epi16(_mm_srli_epi16(ph, 8), zero);
+            pl = _mm_or_si128(_mm_and_si128(okl, pl),
+                              _mm_andnot_si128(okl, u8max));
+            ph = _mm_or_si128(_mm_and_si128(okh, ph),
+                              _mm_andnot_si128(okh, u8max));
+            r = _mm_packus_epi16(pl, ph);
+            ok = _mm_packs_epi16(okl, okh);
+            break;
+        }
+        default:
+            return 0;
+        }
+        if (!sat && _mm_movemask_epi8(_mm_cmpeq_epi8(ok, all)) != 0xffff) break;
+        _mm_storeu_si128((__m128i*)(d+i), r);
+    }
+    return i;
+}
+
+__attribute__((target("sse2")))
+static int f32dot_sse2(const float *x, const float *y, int n, double *r)
+{
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    double t[2];
+    int i = 0;
+    for (; i+4<=n; i+=4) {
+        __m128 a = _mm_loadu_ps(x+i);
+        __m128 b = _mm_loadu_ps(y+i);
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_cvtps_pd(a), _mm_cvtps_pd(b)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(a, a)),
+                                           _mm_cvtps_pd(_mm_movehl_ps(b, b))));
+    }
+    _mm_storeu_pd(t, _mm_add_pd(acc0, acc1));
+    *r = t[0] + t[1];
+    return i;
+}
+
+__attribute__((target("sse2")))
+static int f64dot_sse2(const double *x, const double *y, int n, double *r)
+{
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    double t[2];
+    int i = 0;
+    for (; i+4<=n; i+=4) {
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(x+i),
+                                           _mm_loadu_pd(y+i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(x+i+2),
+                                           _mm_loadu_pd(y+i+2)));
+    }
+    _mm_storeu_pd(t, _mm_add_pd(acc0, acc1));
+    *r = t[0] + t[1];
+    return i;
+}
+
+/* Each 32bit lane gains at most 2*2*255*255 per iteration, so we move
+   the lanes to the 64bit accumulator every U8DOT_BLOCK iterations. */
+#define U8DOT_BLOCK 4096
+
+__attribute__((target("sse2")))
+static int u8dot_sse2(const u_char *x, const u_char *y, int n, ScmUInt64 *r)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc64 = zero;
+    ScmUInt64 t[2];
+    int i = 0;
+    while (i+16 <= n) {
+        __m128i acc32 = zero;
+        for (int k=0; k<U8DOT_BLOCK && i+16<=n; k++, i+=16) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(x+i));
+            __m128i b = _mm_loadu_si128((const __m128i*)(y+i));
+            acc32 = _mm_add_epi32(acc32,
+                                  _mm_madd_epi16(_mm_unpacklo_epi8(a, zero),
+                                                 _mm_unpacklo_epi8(b, zero)));
+            acc32 = _mm_add_epi32(acc32,
+                                  _mm_madd_epi16(_mm_unpackhi_epi8(a, zero),
+                                                 _mm_unpackhi_epi8(b, zero)));
+        }
+        acc64 = _mm_add_epi64(acc64, _mm_unpacklo_epi32(acc32, zero));
+        acc64 = _mm_add_epi64(acc64, _mm_unpackhi_epi32(acc32, zero));
+    }
+    _mm_storeu_si128((__m128i*)t, acc64);
+    *r = t[0] + t[1];
+    return i;
+}
+
+__attribute__((target("sse2")))
+static int f32sum_sse2(const float *x, int n, double *r)
+{
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    double t[2];
+    int i = 0;
+    for (; i+4<=n; i+=4) {
+        __m128 a = _mm_loadu_ps(x+i);
+        acc0 = _mm_add_pd(acc0, _mm_cvtps_pd(a));
+        acc1 = _mm_add_pd(acc1, _mm_cvtps_pd(_mm_movehl_ps(a, a)));
+    }
+    _mm_storeu_pd(t, _mm_add_pd(acc0, acc1));
+    *r = t[0] + t[1];
+    return i;
+}
+
+__attribute__((target("sse2")))
+static int f64sum_sse2(const double *x, int n, double *r)
+{
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    double t[2];
+    int i = 0;
+    for (; i+4<=n; i+=4) {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(x+i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(x+i+2));
+    }
+    _mm_storeu_pd(t, _mm_add_pd(acc0, acc1));
+    *r = t[0] + t[1];
+    return i;
+}
+
+/* s32 elements are sign-extended into 64bit lanes; they can't overflow
+   since the vector length is less than 2^31. */
+__attribute__((target("sse2")))
+static int s32sum_sse2(const ScmInt32 *x, int n, ScmInt64 *r)
+{
+    __m128i acc = _mm_setzero_si128();
+    ScmInt64 t[2];
+    int i = 0;
+    for (; i+4<=n; i+=4) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(x+i));
+        __m128i s = _mm_srai_epi32(a, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(a, s));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(a, s));
+    }
+    _mm_storeu_si128((__m128i*)t, acc);
+    *r = t[0] + t[1];
+    return i;
+}
+
+__attribute__((target("sse2")))
+static int u8sum_sse2(const u_char *x, int n, ScmUInt64 *r)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    ScmUInt64 t[2];
+    int i = 0;
+    for (; i+16<=n; i+=16) {
+        acc = _mm_add_epi64(acc,
+                            _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(x+i)),
+                                         zero));
+    }
+    _mm_storeu_si128((__m128i*)t, acc);
+    *r = t[0] + t[1];
+    return i;
+}
+
+#define HREDUCE(type, nlanes, t, maxp, r)                               \
+    do {                                                                \
+        type m_ = (t)[0];                                               \
+        for (int k_=1; k_<(nlanes); k_++) {                             \
+            if ((maxp)? (m_ < (t)[k_]) : ((t)[k_] < m_)) m_ = (t)[k_];  \
+        }                                                               \
+        *(r) = m_;                                                      \
+    } while (0)
+
+__attribute__((target("sse2")))
+static int f32minmax_sse2(const float *x, int n, int maxp, float *r)
+{
+    float t[4];
+    int i = 4;
+    if (n < 4) return 0;
+    __m128 m = _mm_loadu_ps(x);
+    if (maxp) for (; i+4<=n; i+=4) m = _mm_max_ps(m, _mm_loadu_ps(x+i));
+    else      for (; i+4<=n; i+=4) m = _mm_min_ps(m, _mm_loadu_ps(x+i));
+    _mm_storeu_ps(t, m);
+    HREDUCE(float, 4, t, maxp, r);
+    return i;
+}
+
+__attribute__((target("sse2")))
+static int f64minmax_sse2(const double *x, int n, int maxp, double *r)
+{
+    double t[2];
+    int i = 2;
+    if (n < 2) return 0;
+    __m128d m = _mm_loadu_pd(x);
+    if (maxp) for (; i+2<=n; i+=2) m = _mm_max_pd(m, _mm_loadu_pd(x+i));
+    else      for (; i+2<=n; i+=2) m = _mm_min_pd(m, _mm_loadu_pd(x+i));
+    _mm_storeu_pd(t, m);
+    HREDUCE(double, 2, t, maxp, r);
+    return i;
+}
+
+/* SSE2 lacks pminsd/pmaxsd; select with a comparison mask. */
+__attribute__((target("sse2")))
+static int s32minmax_sse2(const ScmInt32 *x, int n, int maxp, ScmInt32 *r)
+{
+    ScmInt32 t[4];
+    int i = 4;
+    if (n < 4) return 0;
+    __m128i m = _mm_loadu_si128((const __m128i*)x);
+    for (; i+4<=n; i+=4) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(x+i));
+        __m128i g = maxp? _mm_cmpgt_epi32(a, m) : _mm_cmpgt_epi32(m, a);
+        m = _mm_or_si128(_mm_and_si128(g, a), _mm_andnot_si128(g, m));
+    }
+    _mm_storeu_si128((__m128i*)t, m);
+    HREDUCE(ScmInt32, 4, t, maxp, r);
+    return i;
+}
+
+__attribute__((target("sse2")))
+static int u8minmax_sse2(const u_char *x, int n, int maxp, u_char *r)
+{
+    u_char t[16];
+    int i = 16;
+    if (n < 16) return 0;
+    __m128i m = _mm_loadu_si128((const __m128i*)x);
+    if (maxp) {
+        for (; i+16<=n; i+=16)
+            m = _mm_max_epu8(m, _mm_loadu_si128((const __m128i*)(x+i)));
+    } else {
+        for (; i+16<=n; i+=16)
+            m = _mm_min_epu8(m, _mm_loadu_si128((const __m128i*)(x+i)));
+    }
+    _mm_storeu_si128((__m128i*)t, m);
+    HREDUCE(u_char, 16, t, maxp, r);
+    return i;
+}
+
+/*================================================================
+ * AVX2
+ */
+
+__attribute__((target("avx2")))
+static int f32op_avx2(int op, float *d, const float *x, const float *y, int n)
+{
+    int i = 0;
+    switch (op) {
+    case UVSIMD_ADD: BINOP_LOOP(8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_add_ps); break;
+    case UVSIMD_SUB: BINOP_LOOP(8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_sub_ps); break;
+    case UVSIMD_MUL: BINOP_LOOP(8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_mul_ps); break;
+    case UVSIMD_DIV: BINOP_LOOP(8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_div_ps); break;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int f64op_avx2(int op, double *d, const double *x, const double *y,
+                      int n)
+{
+    int i = 0;
+    switch (op) {
+    case UVSIMD_ADD: BINOP_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd); break;
+    case UVSIMD_SUB: BINOP_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_sub_pd); break;
+    case UVSIMD_MUL: BINOP_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_mul_pd); break;
+    case UVSIMD_DIV: BINOP_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_div_pd); break;
+    }
+    return i;
+}
+
+/* For multiplication we compute the full 64bit products of even and
+   odd lanes, and see if their upper halves are just sign extension. */
+__attribute__((target("avx2")))
+static int s32op_avx2(int op, ScmInt32 *d, const ScmInt32 *x,
+                      const ScmInt32 *y, int n)
+{
+    int i = 0;
+    for (; i+8<=n; i+=8) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(x+i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(y+i));
+        __m256i r;
+        int ov;
+        switch (op) {
+        case UVSIMD_ADD:
+            r = _mm256_add_epi32(a, b);
+            ov = _mm256_movemask_ps(_mm256_castsi256_ps(
+                     _mm256_and_si256(_mm256_xor_si256(a, r),
+                                      _mm256_xor_si256(b, r))));
+            break;
+        case UVSIMD_SUB:
+            r = _mm256_sub_epi32(a, b);
+            ov = _mm256_movemask_ps(_mm256_castsi256_ps(
+                     _mm256_and_si256(_mm256_xor_si256(a, b),
+                                      _mm256_xor_si256(a, r))));
+            break;
+        case UVSIMD_MUL: {
+            __m256i pe = _mm256_mul_epi32(a, b);
+            __m256i po = _mm256_mul_epi32(_mm256_srli_epi64(a, 32),
+                                          _mm256_srli_epi64(b, 32));
+            __m256i hi = _mm256_blend_epi32(_mm256_srli_epi64(pe, 32), po, 0xaa);
+            r = _mm256_mullo_epi32(a, b);
+            ov = ~_mm256_movemask_ps(_mm256_castsi256_ps(
+                      _mm256_cmpeq_epi32(hi, _mm256_srai_epi32(r, 31)))) & 0xff;
+            break;
+        }
+        default:
+            return 0;
+        }
+        if (ov) break;
+        _mm256_storeu_si256((__m256i*)(d+i), r);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int u8op_avx2(int op, u_char *d, const u_char *x, const u_char *y,
+                     int n, int clamp)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i u8max = _mm256_set1_epi16(255);
+    int sat = (op == UVSIMD_SUB)? (clamp & SCM_CLAMP_LO) : (clamp & SCM_CLAMP_HI);
+    int i = 0;
+    for (; i+32<=n; i+=32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(x+i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(y+i));
+        __m256i r, ok;
+        switch (op) {
+        case UVSIMD_ADD:
+            r = _mm256_adds_epu8(a, b);
+            ok = _mm256_cmpeq_epi8(r, _mm256_add_epi8(a, b));
+            break;
+        case UVSIMD_SUB:
+            r = _mm256_subs_epu8(a, b);
+            ok = _mm256_cmpeq_epi8(r, _mm256_sub_epi8(a, b));
+            break;
+        case UVSIMD_MUL: {
+            /* unpack and pack work within 128bit lanes, so the order
+               is preserved. */
+            __m256i pl = _mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero),
+                                            _mm256_unpacklo_epi8(b, zero));
+            __m256i ph = _mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero),
+                                            _mm256_unpackhi_epi8(b, zero));
+            __m256i okl = _mm256_cmpeq_epi16(_mm256_srli_epi16(pl, 8), zero);
+            __m256i okh = _mm256_cmpeq_epi16(_mm256_srli_epi16(ph, 8), zero);
+            r = _mm256_packus_epi16(_mm256_min_epu16(pl, u8max),
+                                    _mm256_min_epu16(ph, u8max));
+            ok = _mm256_packs_epi16(okl, okh);
+            break;
+        }
+        default:
+            return 0;
+        }
+        if (!sat && _mm256_movemask_epi8(ok) != -1) break;
+        _mm256_storeu_si256((__m256i*)(d+i), r);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int f32dot_avx2(const float *x, const float *y, int n, double *r)
+{
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    double t[4];
+    int i = 0;
+    for (; i+8<=n; i+=8) {
+        acc0 = _mm256_add_pd(acc0,
+                             _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(x+i)),
+                                           _mm256_cvtps_pd(_mm_loadu_ps(y+i))));
+        acc1 = _mm256_add_pd(acc1,
+                             _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(x+i+4)),
+                                           _mm256_cvtps_pd(_mm_loadu_ps(y+i+4))));
+    }
+    _mm256_storeu_pd(t, _mm256_add_pd(acc0, acc1));
+    *r = (t[0] + t[1]) + (t[2] + t[3]);
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int f64dot_avx2(const double *x, const double *y, int n, double *r)
+{
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    double t[4];
+    int i = 0;
+    for (; i+8<=n; i+=8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(x+i),
+                                                 _mm256_loadu_pd(y+i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(x+i+4),
+                                                 _mm256_loadu_pd(y+i+4)));
+    }
+    _mm256_storeu_pd(t, _mm256_add_pd(acc0, acc1));
+    *r = (t[0] + t[1]) + (t[2] + t[3]);
+    return i;
+}
+
+/* Products of s32 elements take up to 63 bits, so we split each of them
+   into the signed upper half and the unsigned lower half and sum them
+   separately.  Neither sum overflows for vectors shorter than 2^31. */
+__attribute__((target("avx2")))
+static int s32dot_avx2(const ScmInt32 *x, const ScmInt32 *y, int n,
+                       ScmInt64 *hi, ScmUInt64 *lo)
+{
+    const __m256i lomask = _mm256_set1_epi64x(0xffffffffLL);
+    const __m256i signbit = _mm256_set1_epi64x(0x80000000LL);
+    __m256i acchi = _mm256_setzero_si256(), acclo = _mm256_setzero_si256();
+    ScmInt64 th[4];
+    ScmUInt64 tl[4];
+    int i = 0;
+    for (; i+8<=n; i+=8) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(x+i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(y+i));
+        __m256i p[2];
+        p[0] = _mm256_mul_epi32(a, b);
+        p[1] = _mm256_mul_epi32(_mm256_srli_epi64(a, 32),
+                                _mm256_srli_epi64(b, 32));
+        for (int k=0; k<2; k++) {
+            /* sign-extend the upper half */
+            __m256i h = _mm256_xor_si256(_mm256_srli_epi64(p[k], 32), signbit);
+            acchi = _mm256_add_epi64(acchi, _mm256_sub_epi64(h, signbit));
+            acclo = _mm256_add_epi64(acclo, _mm256_and_si256(p[k], lomask));
+        }
+    }
+    _mm256_storeu_si256((__m256i*)th, acchi);
+    _mm256_storeu_si256((__m256i*)tl, acclo);
+    *hi = th[0] + th[1] + th[2] + th[3];
+    *lo = tl[0] + tl[1] + tl[2] + tl[3];
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int f32sum_avx2(const float *x, int n, double *r)
+{
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    double t[4];
+    int i = 0;
+    for (; i+8<=n; i+=8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_cvtps_pd(_mm_loadu_ps(x+i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_cvtps_pd(_mm_loadu_ps(x+i+4)));
+    }
+    _mm256_storeu_pd(t, _mm256_add_pd(acc0, acc1));
+    *r = (t[0] + t[1]) + (t[2] + t[3]);
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int f64sum_avx2(const double *x, int n, double *r)
+{
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    double t[4];
+    int i = 0;
+    for (; i+8<=n; i+=8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(x+i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(x+i+4));
+    }
+    _mm256_storeu_pd(t, _mm256_add_pd(acc0, acc1));
+    *r = (t[0] + t[1]) + (t[2] + t[3]);
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int s32minmax_avx2(const ScmInt32 *x, int n, int maxp, ScmInt32 *r)
+{
+    ScmInt32 t[8];
+    int i = 8;
+    if (n < 8) return 0;
+    __m256i m = _mm256_loadu_si256((const __m256i*)x);
+    if (maxp) {
+        for (; i+8<=n; i+=8)
+            m = _mm256_max_epi32(m, _mm256_loadu_si256((const __m256i*)(x+i)));
+    } else {
+        for (; i+8<=n; i+=8)
+            m = _mm256_min_epi32(m, _mm256_loadu_si256((const __m256i*)(x+i)));
+    }
+    _mm256_storeu_si256((__m256i*)t, m);
+    HREDUCE(ScmInt32, 8, t, maxp, r);
+    return i;
+}
+
+#endif /* UVSIMD_X86 */
+
+/*================================================================
+ * NEON (AArch64; floating-point only)
+ */
+
+#if defined(UVSIMD_NEON)
+
+static int f32op_neon(int op, float *d, const float *x, const float *y, int n)
+{
+    int i = 0;
+    switch (op) {
+    case UVSIMD_ADD: BINOP_LOOP(4, vld1q_f32, vst1q_f32, vaddq_f32); break;
+    case UVSIMD_SUB: BINOP_LOOP(4, vld1q_f32, vst1q_f32, vsubq_f32); break;
+    case UVSIMD_MUL: BINOP_LOOP(4, vld1q_f32, vst1q_f32, vmulq_f32); break;
+    case UVSIMD_DIV: BINOP_LOOP(4, vld1q_f32, vst1q_f32, vdivq_f32); break;
+    }
+    return i;
+}
+
+static int f64op_neon(int op, double *d, const double *x, const double *y,
+                      int n)
+{
+    int i = 0;
+    switch (op) {
+    case UVSIMD_ADD: BINOP_LOOP(2, vld1q_f64, vst1q_f64, vaddq_f64); break;
+    case UVSIMD_SUB: BINOP_LOOP(2, vld1q_f64, vst1q_f64, vsubq_f64); break;
+    case UVSIMD_MUL: BINOP_LOOP(2, vld1q_f64, vst1q_f64, vmulq_f64); break;
+    case UVSIMD_DIV: BINOP_LOOP(2, vld1q_f64, vst1q_f64, vdivq_f64); break;
+    }
+    return i;
+}
+
+static int f32dot_neon(const float *x, const float *y, int n, double *r)
+{
+    float64x2_t acc0 = vdupq_n_f64(0.0), acc1 = vdupq_n_f64(0.0);
+    int i = 0;
+    for (; i+4<=n; i+=4) {
+        float32x4_t a = vld1q_f32(x+i), b = vld1q_f32(y+i);
+        acc0 = vaddq_f64(acc0, vmulq_f64(vcvt_f64_f32(vget_low_f32(a)),
+                                         vcvt_f64_f32(vget_low_f32(b))));
+        acc1 = vaddq_f64(acc1, vmulq_f64(vcvt_high_f64_f32(a),
+                                         vcvt_high_f64_f32(b)));
+    }
+    *r = vaddvq_f64(vaddq_f64(acc0, acc1));
+    return i;
+}
+
+static int f64dot_neon(const double *x, const double *y, int n, double *r)
+{
+    float64x2_t acc0 = vdupq_n_f64(0.0), acc1 = vdupq_n_f64(0.0);
+    int i = 0;
+    for (; i+4<=n; i+=4) {
+        acc0 = vaddq_f64(acc0, vmulq_f64(vld1q_f64(x+i), vld1q_f64(y+i)));
+        acc1 = vaddq_f64(acc1, vmulq_f64(vld1q_f64(x+i+2), vld1q_f64(y+i+2)));
+    }
+    *r = vaddvq_f64(vaddq_f64(acc0, acc1));
+    return i;
+}
+
+static int f32sum_neon(const float *x, int n, double *r)
+{
+    float64x2_t acc0 = vdupq_n_f64(0.0), acc1 = vdupq_n_f64(0.0);
+    int i = 0;
+    for (; i+4<=n; i+=4) {
+        float32x4_t a = vld1q_f32(x+i);
+        acc0 = vaddq_f64(acc0, vcvt_f64_f32(vget_low_f32(a)));
+        acc1 = vaddq_f64(acc1, vcvt_high_f64_f32(a));
+    }
+    *r = vaddvq_f64(vaddq_f64(acc0, acc1));
+    return i;
+}
+
+static int f64sum_neon(const double *x, int n, double *r)
+{
+    float64x2_t acc0 = vdupq_n_f64(0.0), acc1 = vdupq_n_f64(0.0);
+    int i = 0;
+    for (; i+4<=n; i+=4) {
+        acc0 = vaddq_f64(acc0, vld1q_f64(x+i));
+        acc1 = vaddq_f64(acc1, vld1q_f64(x+i+2));
+    }
+    *r = vaddvq_f64(vaddq_f64(acc0, acc1));
+    return i;
+}
+
+#endif /* UVSIMD_NEON */
+
+/*================================================================
+ * Entry points
+ */
+
+#if defined(UVSIMD_X86)
+#define DISPATCH(avx2call, sse2call)                    \
+    do {                                                \
+        int f_ = FEATURES();                            \
+        if (f_ & FEATURE_AVX2) return avx2call;         \
+        if (f_ & FEATURE_SSE2) return sse2call;         \
+    } while (0)
+#define DISPATCH_SSE2(sse2call)                         \
+    do {                                                \
+        if (FEATURES() & FEATURE_SSE2) return sse2call; \
+    } while (0)
+#define DISPATCH_AVX2(avx2call)                         \
+    do {                                                \
+        if (FEATURES() & FEATURE_AVX2) return avx2call; \
+    } while (0)
+#endif
+
+int Scm__UVSimdF32Op(int op, float *d, const float *x, const float *y, int n)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH(f32op_avx2(op, d, x, y, n), f32op_sse2(op, d, x, y, n));
+#elif defined(UVSIMD_NEON)
+    return f32op_neon(op, d, x, y, n);
+#endif
+    return 0;
+}
+
+int Scm__UVSimdF64Op(int op, double *d, const double *x, const double *y,
+                     int n)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH(f64op_avx2(op, d, x, y, n), f64op_sse2(op, d, x, y, n));
+#elif defined(UVSIMD_NEON)
+    return f64op_neon(op, d, x, y, n);
+#endif
+    return 0;
+}
+
+int Scm__UVSimdS32Op(int op, ScmInt32 *d, const ScmInt32 *x,
+                     const ScmInt32 *y, int n)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH(s32op_avx2(op, d, x, y, n), s32op_sse2(op, d, x, y, n));
+#endif
+    return 0;
+}
+
+int Scm__UVSimdU8Op(int op, u_char *d, const u_char *x, const u_char *y,
+                    int n, int clamp)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH(u8op_avx2(op, d, x, y, n, clamp),
+             u8op_sse2(op, d, x, y, n, clamp));
+#endif
+    return 0;
+}
+
+int Scm__UVSimdF32Dot(const float *x, const float *y, int n, double *r)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH(f32dot_avx2(x, y, n, r), f32dot_sse2(x, y, n, r));
+#elif defined(UVSIMD_NEON)
+    return f32dot_neon(x, y, n, r);
+#endif
+    return 0;
+}
+
+int Scm__UVSimdF64Dot(const double *x, const double *y, int n, double *r)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH(f64dot_avx2(x, y, n, r), f64dot_sse2(x, y, n, r));
+#elif defined(UVSIMD_NEON)
+    return f64dot_neon(x, y, n, r);
+#endif
+    return 0;
+}
+
+int Scm__UVSimdS32Dot(const ScmInt32 *x, const ScmInt32 *y, int n,
+                      ScmInt64 *hi, ScmUInt64 *lo)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH_AVX2(s32dot_avx2(x, y, n, hi, lo));
+#endif
+    return 0;
+}
+
+int Scm__UVSimdU8Dot(const u_char *x, const u_char *y, int n, ScmUInt64 *r)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH_SSE2(u8dot_sse2(x, y, n, r));
+#endif
+    return 0;
+}
+
+int Scm__UVSimdF32Sum(const float *x, int n, double *r)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH(f32sum_avx2(x, n, r), f32sum_sse2(x, n, r));
+#elif defined(UVSIMD_NEON)
+    return f32sum_neon(x, n, r);
+#endif
+    return 0;
+}
+
+int Scm__UVSimdF64Sum(const double *x, int n, double *r)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH(f64sum_avx2(x, n, r), f64sum_sse2(x, n, r));
+#elif defined(UVSIMD_NEON)
+    return f64sum_neon(x, n, r);
+#endif
+    return 0;
+}
+
+int Scm__UVSimdS32Sum(const ScmInt32 *x, int n, ScmInt64 *r)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH_SSE2(s32sum_sse2(x, n, r));
+#endif
+    return 0;
+}
+
+int Scm__UVSimdU8Sum(const u_char *x, int n, ScmUInt64 *r)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH_SSE2(u8sum_sse2(x, n, r));
+#endif
+    return 0;
+}
+
+int Scm__UVSimdF32MinMax(const float *x, int n, int maxp, float *r)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH_SSE2(f32minmax_sse2(x, n, maxp, r));
+#endif
+    return 0;
+}
+
+int Scm__UVSimdF64MinMax(const double *x, int n, int maxp, double *r)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH_SSE2(f64minmax_sse2(x, n, maxp, r));
+#endif
+    return 0;
+}
+
+int Scm__UVSimdS32MinMax(const ScmInt32 *x, int n, int maxp, ScmInt32 *r)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH(s32minmax_avx2(x, n, maxp, r), s32minmax_sse2(x, n, maxp, r));
+#endif
+    return 0;
+}
+
+int Scm__UVSimdU8MinMax(const u_char *x, int n, int maxp, u_char *r)
+{
+#if defined(UVSIMD_X86)
+    DISPATCH_SSE2(u8minmax_sse2(x, n, maxp, r));
+#endif
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * uvsimd.h - vectorized kernels for uniform vector operations
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_UVSIMD_H
+#define GAUCHE_UVSIMD_H
+
+/*
+ * Each kernel handles a leading part of its arguments using SIMD
+ * instructions and returns the number of elements it has processed;
+ * the caller finishes the rest (or everything, if 0 is returned) with
+ * the ordinary scalar loop.  Integer kernels also stop before a chunk
+ * that would overflow, so that the scalar code can signal the error or
+ * clamp the value as the uvector API requires.
+ *
+ * Which instruction set to use is determined at the first call.
+ */
+
+enum {
+    UVSIMD_ADD,
+    UVSIMD_SUB,
+    UVSIMD_MUL,
+    UVSIMD_DIV                  /* f32 and f64 only */
+};
+
+/* d[i] = x[i] op y[i].  D may be the same as X or Y. */
+extern int Scm__UVSimdF32Op(int op, float *d, const float *x,
+                            const float *y, int n);
+extern int Scm__UVSimdF64Op(int op, double *d, const double *x,
+                            const double *y, int n);
+extern int Scm__UVSimdS32Op(int op, ScmInt32 *d, const ScmInt32 *x,
+                            const ScmInt32 *y, int n);
+extern int Scm__UVSimdU8Op(int op, u_char *d, const u_char *x,
+                           const u_char *y, int n, int clamp);
+
+/* Dot products.  The partial result is stored in *r (for s32, the sum
+   is *hi * 2^32 + *lo, for it may not fit in 64 bits). */
+extern int Scm__UVSimdF32Dot(const float *x, const float *y, int n,
+                             double *r);
+extern int Scm__UVSimdF64Dot(const double *x, const double *y, int n,
+                             double *r);
+extern int Scm__UVSimdS32Dot(const ScmInt32 *x, const ScmInt32 *y, int n,
+                             ScmInt64 *hi, ScmUInt64 *lo);
+extern int Scm__UVSimdU8Dot(const u_char *x, const u_char *y, int n,
+                            ScmUInt64 *r);
+
+/* Sums */
+extern int Scm__UVSimdF32Sum(const float *x, int n, double *r);
+extern int Scm__UVSimdF64Sum(const double *x, int n, double *r);
+extern int Scm__UVSimdS32Sum(const ScmInt32 *x, int n, ScmInt64 *r);
+extern int Scm__UVSimdU8Sum(const u_char *x, int n, ScmUInt64 *r);
+
+/* Minimum (MAXP == FALSE) or maximum (MAXP == TRUE).  *r is set only
+   when the return value is positive.  The result is unspecified if
+   X contains NaN. */
+extern int Scm__UVSimdF32MinMax(const float *x, int n, int maxp, float *r);
+extern int Scm__UVSimdF64MinMax(const double *x, int n, int maxp, double *r);
+extern int Scm__UVSimdS32MinMax(const ScmInt32 *x, int n, int maxp,
+                                ScmInt32 *r);
+extern int Scm__UVSimdU8MinMax(const u_char *x, int n, int maxp, u_char *r);
+
+#endif /* GAUCHE_UVSIMD_H */
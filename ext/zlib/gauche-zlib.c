@@ -342,6 +342,7 @@ ScmObj Scm_MakeDeflatingPort(ScmPort *source, int level,
     info->stream_endp = FALSE;
     info->level = level;
     info->strategy = strategy;
+    info->par = NULL;
 
     ScmPortBuffer bufrec;
     memset(&bufrec, 0, sizeof(bufrec));
@@ -360,6 +361,507 @@ ScmObj Scm_MakeDeflatingPort(ScmPort *source, int level,
                                 SCM_PORT_OUTPUT, TRUE, &bufrec);
 }
 
+/*================================================================
+ * Parallel deflating port
+ *
+ *  Like pigz, the input is split into blocks, and each block is
+ *  compressed into raw deflate data on a worker thread, with the last
+ *  32KB of the preceding input as the dictionary.  All blocks but the
+ *  last end with a sync flush, so the compressed blocks are byte
+ *  aligned and can just be concatenated.  The calling thread writes
+ *  the zlib or gzip header, the compressed blocks in order, and the
+ *  trailer with the check value combined from those of the blocks.
+ *
+ *  Worker threads only touch malloc'ed memory; all the port I/O is
+ *  done by the calling thread.
+ */
+
+#if defined(GAUCHE_USE_PTHREADS)
+
+#include <signal.h>
+
+#define PAR_DEFAULT_BLOCK_SIZE  (128*1024)
+#define PAR_WINDOW_SIZE         32768
+
+enum { PAR_RAW, PAR_ZLIB, PAR_GZIP };
+
+typedef struct ParJobRec {
+    struct ParJobRec *next_queued;  /* waiting for a worker */
+    struct ParJobRec *next_ordered; /* in submission order */
+    unsigned char *in;              /* input, followed by dict */
+    size_t inlen;
+    unsigned char *dict;
+    size_t dictlen;
+    int last;                   /* finish the stream with this block */
+    int level;
+    int strategy;
+    unsigned char *out;
+    size_t outlen;
+    uLong check;                /* crc32 or adler32 of the input */
+    int result;                 /* Z_OK or error code */
+    int done;
+} ParJob;
+
+typedef struct ScmZlibParallelRec {
+    int nthreads;
+    pthread_t *threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t work;        /* a job is queued, or shutdown */
+    pthread_cond_t done;        /* a job is done */
+    ParJob *queue_head, *queue_tail;
+    ParJob *order_head, *order_tail;
+    int njobs;                  /* # of jobs not written out yet */
+    int shutdown;
+    int format;                 /* PAR_RAW, PAR_ZLIB or PAR_GZIP */
+    int window_bits;            /* 9..15 */
+    int memlevel;
+    int header_written;
+    int has_dict;               /* user dictionary is given */
+    uLong dict_adler;
+    unsigned char window[PAR_WINDOW_SIZE]; /* tail of the input so far */
+    size_t windowlen;
+    uLong check;
+} ScmZlibParallel;
+
+/* Runs on a worker thread. */
+static void par_compress(ScmZlibParallel *par, ParJob *job)
+{
+    z_stream s;
+    memset(&s, 0, sizeof(s));
+    job->result = deflateInit2(&s, job->level, Z_DEFLATED,
+                               -par->window_bits, par->memlevel,
+                               job->strategy);
+    if (job->result != Z_OK) return;
+    if (job->dictlen > 0) {
+        job->result = deflateSetDictionary(&s, job->dict, job->dictlen);
+        if (job->result != Z_OK) {
+            deflateEnd(&s);
+            return;
+        }
+    }
+
+    size_t outsize = deflateBound(&s, job->inlen) + 16;
+    job->out = malloc(outsize);
+    if (job->out == NULL) {
+        job->result = Z_MEM_ERROR;
+        deflateEnd(&s);
+        return;
+    }
+    s.next_in = job->in;
+    s.avail_in = job->inlen;
+    s.next_out = job->out;
+    s.avail_out = outsize;
+    for (;;) {
+        int r = deflate(&s, job->last ? Z_FINISH : Z_SYNC_FLUSH);
+        if (r == Z_STREAM_ERROR) {
+            job->result = r;
+            break;
+        }
+        if (job->last ? (r == Z_STREAM_END) : (s.avail_out > 0)) break;
+        if (s.avail_out == 0) {
+            size_t used = s.next_out - job->out;
+            unsigned char *p = realloc(job->out, outsize*2);
+            if (p == NULL) {
+                job->result = Z_MEM_ERROR;
+                break;
+            }
+            job->out = p;
+            outsize *= 2;
+            s.next_out = p + used;
+            s.avail_out = outsize - used;
+        }
+    }
+    job->outlen = s.next_out - job->out;
+    if (par->format == PAR_GZIP) {
+        job->check = crc32(0L, job->in, job->inlen);
+    } else {
+        job->check = adler32(1L, job->in, job->inlen);
+    }
+    deflateEnd(&s);
+}
+
+static void *par_worker(void *data)
+{
+    ScmZlibParallel *par = (ScmZlibParallel*)data;
+    pthread_mutex_lock(&par->mutex);
+    for (;;) {
+        while (par->queue_head == NULL && !par->shutdown) {
+            pthread_cond_wait(&par->work, &par->mutex);
+        }
+        ParJob *job = par->queue_head;
+        if (job == NULL) break; /* shutdown */
+        par->queue_head = job->next_queued;
+        if (par->queue_head == NULL) par->queue_tail = NULL;
+        pthread_mutex_unlock(&par->mutex);
+        par_compress(par, job);
+        pthread_mutex_lock(&par->mutex);
+        job->done = TRUE;
+        pthread_cond_broadcast(&par->done);
+    }
+    pthread_mutex_unlock(&par->mutex);
+    return NULL;
+}
+
+static void par_free_job(ParJob *job)
+{
+    free(job->in);
+    free(job->out);
+    free(job);
+}
+
+/* Stops the workers and frees everything.  Jobs not written out yet
+   are discarded. */
+static void par_shutdown(ScmZlibParallel *par)
+{
+    pthread_mutex_lock(&par->mutex);
+    par->shutdown = TRUE;
+    pthread_cond_broadcast(&par->work);
+    pthread_mutex_unlock(&par->mutex);
+    for (int i=0; i<par->nthreads; i++) {
+        pthread_join(par->threads[i], NULL);
+    }
+    for (ParJob *job = par->order_head, *next; job; job = next) {
+        next = job->next_ordered;
+        par_free_job(job);
+    }
+    pthread_cond_destroy(&par->done);
+    pthread_cond_destroy(&par->work);
+    pthread_mutex_destroy(&par->mutex);
+    free(par->threads);
+    free(par);
+}
+
+/* Queues DATA as the next block. */
+static void par_submit(ScmZlibParallel *par, ScmZlibInfo *info,
+                       const unsigned char *data, size_t len, int last)
+{
+    ParJob *job = calloc(1, sizeof(ParJob));
+    if (job) job->in = malloc(len + par->windowlen + 1);
+    if (job == NULL || job->in == NULL) {
+        free(job);
+        Scm_ZlibError(Z_MEM_ERROR, "memory exhausted");
+    }
+    memcpy(job->in, data, len);
+    job->inlen = len;
+    job->dict = job->in + len;
+    job->dictlen = par->windowlen;
+    memcpy(job->dict, par->window, par->windowlen);
+    job->last = last;
+    job->level = info->level;
+    job->strategy = info->strategy;
+    job->result = Z_OK;
+
+    /* Keep the last 32KB of input as the dictionary of the next block. */
+    if (len >= PAR_WINDOW_SIZE) {
+        memcpy(par->window, data + len - PAR_WINDOW_SIZE, PAR_WINDOW_SIZE);
+        par->windowlen = PAR_WINDOW_SIZE;
+    } else {
+        size_t keep = par->windowlen;
+        if (keep > PAR_WINDOW_SIZE - len) keep = PAR_WINDOW_SIZE - len;
+        memmove(par->window, par->window + par->windowlen - keep, keep);
+        memcpy(par->window + keep, data, len);
+        par->windowlen = keep + len;
+    }
+
+    pthread_mutex_lock(&par->mutex);
+    if (par->queue_tail) par->queue_tail->next_queued = job;
+    else par->queue_head = job;
+    par->queue_tail = job;
+    if (par->order_tail) par->order_tail->next_ordered = job;
+    else par->order_head = job;
+    par->order_tail = job;
+    par->njobs++;
+    pthread_cond_signal(&par->work);
+    pthread_mutex_unlock(&par->mutex);
+}
+
+static void par_put(ScmZlibInfo *info, const unsigned char *data, size_t len)
+{
+    Scm_Putz((const char*)data, len, info->remote);
+    info->strm->total_out += len;
+}
+
+static void par_write_header(ScmZlibParallel *par, ScmZlibInfo *info)
+{
+    unsigned char h[10];
+    int n = 0;
+    int level = (info->level == Z_DEFAULT_COMPRESSION) ? 6 : info->level;
+
+    /* Same as what deflate() writes. */
+    if (par->format == PAR_ZLIB) {
+        int level_flags;
+        if (info->strategy >= Z_HUFFMAN_ONLY || level < 2) level_flags = 0;
+        else if (level < 6) level_flags = 1;
+        else if (level == 6) level_flags = 2;
+        else level_flags = 3;
+        unsigned int header = (Z_DEFLATED + ((par->window_bits-8)<<4)) << 8;
+        header |= (level_flags << 6);
+        if (par->has_dict) header |= 0x20; /* PRESET_DICT */
+        header += 31 - (header % 31);
+        h[n++] = (header >> 8) & 0xff;
+        h[n++] = header & 0xff;
+        if (par->has_dict) {
+            h[n++] = (par->dict_adler >> 24) & 0xff;
+            h[n++] = (par->dict_adler >> 16) & 0xff;
+            h[n++] = (par->dict_adler >> 8) & 0xff;
+            h[n++] = par->dict_adler & 0xff;
+        }
+    } else if (par->format == PAR_GZIP) {
+        h[n++] = 0x1f; h[n++] = 0x8b; h[n++] = Z_DEFLATED;
+        h[n++] = 0;             /* flags */
+        h[n++] = 0; h[n++] = 0; h[n++] = 0; h[n++] = 0; /* mtime */
+        h[n++] = (level == 9 ? 2
+                  : (info->strategy >= Z_HUFFMAN_ONLY || level < 2) ? 4
+                  : 0);
+        h[n++] = 3;             /* OS: unix */
+    }
+    if (n > 0) par_put(info, h, n);
+    par->header_written = TRUE;
+}
+
+static void par_write_trailer(ScmZlibParallel *par, ScmZlibInfo *info)
+{
+    unsigned char t[8];
+    uLong c = par->check;
+    unsigned long len = info->strm->total_in;
+    if (par->format == PAR_ZLIB) {
+        t[0] = (c >> 24) & 0xff; t[1] = (c >> 16) & 0xff;
+        t[2] = (c >> 8) & 0xff;  t[3] = c & 0xff;
+        par_put(info, t, 4);
+    } else if (par->format == PAR_GZIP) {
+        t[0] = c & 0xff;          t[1] = (c >> 8) & 0xff;
+        t[2] = (c >> 16) & 0xff;  t[3] = (c >> 24) & 0xff;
+        t[4] = len & 0xff;        t[5] = (len >> 8) & 0xff;
+        t[6] = (len >> 16) & 0xff; t[7] = (len >> 24) & 0xff;
+        par_put(info, t, 8);
+    }
+}
+
+/* Writes out the finished jobs in order.  Waits for unfinished ones
+   as long as more than MAXPENDING jobs are left. */
+static void par_drain(ScmZlibParallel *par, ScmZlibInfo *info, int maxpending)
+{
+    for (;;) {
+        pthread_mutex_lock(&par->mutex);
+        ParJob *job = par->order_head;
+        if (job == NULL || (!job->done && par->njobs <= maxpending)) {
+            pthread_mutex_unlock(&par->mutex);
+            break;
+        }
+        while (!job->done) pthread_cond_wait(&par->done, &par->mutex);
+        par->order_head = job->next_ordered;
+        if (par->order_head == NULL) par->order_tail = NULL;
+        par->njobs--;
+        pthread_mutex_unlock(&par->mutex);
+
+        if (job->result != Z_OK) {
+            int r = job->result;
+            par_free_job(job);
+            Scm_ZlibError(r, "deflate failed in a worker thread");
+        }
+        if (!par->header_written) par_write_header(par, info);
+        if (par->format == PAR_GZIP) {
+            par->check = crc32_combine(par->check, job->check, job->inlen);
+        } else {
+            par->check = adler32_combine(par->check, job->check, job->inlen);
+        }
+        info->strm->total_in += job->inlen;
+        info->strm->adler = par->check;
+        /* Don't leak the job if the remote port raises an error. */
+        SCM_UNWIND_PROTECT {
+            par_put(info, job->out, job->outlen);
+        }
+        SCM_WHEN_ERROR {
+            par_free_job(job);
+            SCM_NEXT_HANDLER;
+        }
+        SCM_END_PROTECT;
+        par_free_job(job);
+    }
+}
+
+static int par_deflate_flusher(ScmPort *port, int cnt, int forcep)
+{
+    ScmZlibInfo *info = SCM_PORT_ZLIB_INFO(port);
+    ScmZlibParallel *par = info->par;
+    int avail = SCM_PORT_BUFFER_AVAIL(port);
+
+    if (avail > 0) {
+        par_submit(par, info, (unsigned char*)port->src.buf.buffer,
+                   avail, FALSE);
+    }
+    if (info->flush == Z_FULL_FLUSH) {
+        /* The next block doesn't refer to the data so far. */
+        par->windowlen = 0;
+        info->flush = Z_NO_FLUSH;
+    }
+    /* Keep the workers busy, but don't let the pending output grow
+       without bound. */
+    par_drain(par, info, forcep ? 0 : par->nthreads*2);
+    return avail;
+}
+
+static void par_deflate_closer(ScmPort *port)
+{
+    ScmZlibInfo *info = SCM_PORT_ZLIB_INFO(port);
+    ScmZlibParallel *par = info->par;
+
+    if (par == NULL) return;
+    SCM_UNWIND_PROTECT {
+        par_submit(par, info, (unsigned char*)port->src.buf.buffer,
+                   SCM_PORT_BUFFER_AVAIL(port), TRUE);
+        par_drain(par, info, 0);
+        par_write_trailer(par, info);
+    }
+    SCM_WHEN_ERROR {
+        info->par = NULL;
+        par_shutdown(par);
+        SCM_NEXT_HANDLER;
+    }
+    SCM_END_PROTECT;
+    info->par = NULL;
+    par_shutdown(par);
+    Scm_Flush(info->remote);
+    if (info->ownerp) {
+        Scm_ClosePort(info->remote);
+    }
+}
+
+#endif /*GAUCHE_USE_PTHREADS*/
+
+/* NTHREADS > 1 creates a port that compresses blocks in parallel.
+   Without pthreads, it falls back to the ordinary deflating port. */
+ScmObj Scm_MakeParallelDeflatingPort(ScmPort *source, int level,
+                                     int window_bits, int memlevel,
+                                     int strategy, ScmObj dict,
+                                     int bufsiz, int ownerp,
+                                     int nthreads)
+{
+#if defined(GAUCHE_USE_PTHREADS)
+    if (nthreads <= 1) {
+        return Scm_MakeDeflatingPort(source, level, window_bits, memlevel,
+                                     strategy, dict, bufsiz, ownerp);
+    }
+
+    /* Validate the parameters just as the serial port does, since the
+       workers can't report errors until the data is written. */
+    z_stream t;
+    memset(&t, 0, sizeof(t));
+    int r = deflateInit2(&t, level, Z_DEFLATED, window_bits,
+                         memlevel, strategy);
+    if (r != Z_OK) {
+        Scm_ZlibError(r, "deflateInit2 error: %s", t.msg);
+    }
+    uLong dict_adler = 0;
+    const unsigned char *dictp = NULL;
+    size_t dictlen = 0;
+    if (!SCM_FALSEP(dict)) {
+        if (!SCM_STRINGP(dict)) {
+            deflateEnd(&t);
+            Scm_Error("String required, but got %S", dict);
+        }
+        dictp = (const unsigned char*)SCM_STRING_START(dict);
+        dictlen = SCM_STRING_SIZE(dict);
+        r = deflateSetDictionary(&t, dictp, dictlen);
+        if (r != Z_OK) {
+            deflateEnd(&t);
+            Scm_ZlibError(r, "deflateSetDictionary failed: %s", t.msg);
+        }
+        dict_adler = t.adler;
+    }
+    deflateEnd(&t);
+
+    ScmZlibParallel *par = calloc(1, sizeof(ScmZlibParallel));
+    pthread_t *threads = malloc(sizeof(pthread_t) * nthreads);
+    if (par == NULL || threads == NULL) {
+        free(par); free(threads);
+        Scm_ZlibError(Z_MEM_ERROR, "memory exhausted");
+    }
+    if (window_bits < 0) {
+        par->format = PAR_RAW;
+        par->window_bits = -window_bits;
+    } else if (window_bits > 15) {
+        par->format = PAR_GZIP;
+        par->window_bits = window_bits - 16;
+    } else {
+        par->format = PAR_ZLIB;
+        par->window_bits = window_bits;
+    }
+    if (par->window_bits < 9) par->window_bits = 9; /* as zlib does */
+    par->memlevel = memlevel;
+    par->check = (par->format == PAR_GZIP) ? crc32(0L, NULL, 0)
+                                           : adler32(0L, NULL, 0);
+    if (dictp) {
+        size_t n = dictlen > PAR_WINDOW_SIZE ? PAR_WINDOW_SIZE : dictlen;
+        memcpy(par->window, dictp + dictlen - n, n);
+        par->windowlen = n;
+        par->has_dict = TRUE;
+        par->dict_adler = dict_adler;
+    }
+    par->threads = threads;
+    pthread_mutex_init(&par->mutex, NULL);
+    pthread_cond_init(&par->work, NULL);
+    pthread_cond_init(&par->done, NULL);
+
+    /* Workers inherit the signal mask; they shouldn't take signals
+       meant for Scheme threads. */
+    sigset_t set, oset;
+    sigfillset(&set);
+    pthread_sigmask(SIG_SETMASK, &set, &oset);
+    for (int i=0; i<nthreads; i++) {
+        if (pthread_create(&par->threads[i], NULL, par_worker, par) != 0) {
+            pthread_sigmask(SIG_SETMASK, &oset, NULL);
+            par->nthreads = i;
+            par_shutdown(par);
+            Scm_SysError("couldn't create a deflating thread");
+        }
+        par->nthreads = i+1;
+    }
+    pthread_sigmask(SIG_SETMASK, &oset, NULL);
+
+    ScmZlibInfo *info = SCM_NEW(ScmZlibInfo);
+    /* The stream only keeps the totals and the check value, for
+       zstream-total-in etc. */
+    z_streamp strm = SCM_NEW_ATOMIC2(z_streamp, sizeof(z_stream));
+    memset(strm, 0, sizeof(z_stream));
+    strm->adler = par->check;
+
+    info->strm = strm;
+    info->remote = source;
+    info->bufsiz = 0;
+    info->buf = NULL;
+    info->ptr = NULL;
+    info->ownerp = ownerp;
+    info->flush = Z_NO_FLUSH;
+    info->stream_endp = FALSE;
+    info->level = level;
+    info->strategy = strategy;
+    info->dict_adler = dictp ? Scm_MakeIntegerU(dict_adler) : SCM_FALSE;
+    info->par = par;
+
+    bufsiz = (bufsiz <= 0) ? PAR_DEFAULT_BLOCK_SIZE : fix_buffer_size(bufsiz);
+
+    ScmPortBuffer bufrec;
+    memset(&bufrec, 0, sizeof(bufrec));
+    bufrec.size = bufsiz;
+    bufrec.buffer = SCM_NEW_ATOMIC2(char *, bufsiz);
+    bufrec.mode = SCM_PORT_BUFFER_FULL;
+    bufrec.filler = NULL;
+    bufrec.flusher = par_deflate_flusher;
+    bufrec.closer = par_deflate_closer;
+    bufrec.ready = NULL;
+    bufrec.filenum = zlib_fileno;
+    bufrec.data = (void*)info;
+
+    ScmObj name = port_name("deflating", source);
+    return Scm_MakeBufferedPort(SCM_CLASS_DEFLATING_PORT, name,
+                                SCM_PORT_OUTPUT, TRUE, &bufrec);
+#else  /*!GAUCHE_USE_PTHREADS*/
+    return Scm_MakeDeflatingPort(source, level, window_bits, memlevel,
+                                 strategy, dict, bufsiz, ownerp);
+#endif /*!GAUCHE_USE_PTHREADS*/
+}
+
 /*================================================================
  * Inflating port
  */
@@ -491,6 +993,7 @@ ScmObj Scm_MakeInflatingPort(ScmPort *sink, int bufsiz,
     info->level = 0;
     info->strategy = 0;
     info->dict_adler = SCM_FALSE;
+    info->par = NULL;
 
     ScmPortBuffer bufrec;
     memset(&bufrec, 0, sizeof(bufrec));
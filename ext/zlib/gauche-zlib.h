@@ -61,6 +61,7 @@ typedef struct ScmZlibInfoRec {
     int level;
     int strategy;
     ScmObj dict_adler;
+    struct ScmZlibParallelRec *par; /* non-NULL for parallel deflating port */
 } ScmZlibInfo;
 
 #define SCM_PORT_ZLIB_INFO(p) ((ScmZlibInfo*)(p)->src.buf.data)
@@ -77,6 +78,11 @@ extern ScmObj Scm_MakeDeflatingPort(ScmPort *source, int level,
                                     int window_bits, int memlevel,
                                     int strategy, ScmObj dict,
                                     int bufsiz, int ownerp);
+extern ScmObj Scm_MakeParallelDeflatingPort(ScmPort *source, int level,
+                                            int window_bits, int memlevel,
+                                            int strategy, ScmObj dict,
+                                            int bufsiz, int ownerp,
+                                            int nthreads);
 extern ScmObj Scm_MakeInflatingPort(ScmPort *sink, int bufsiz,
                                     int window_bits, ScmObj dict,
                                     int ownerp);
@@ -219,6 +219,44 @@
          (close-output-port p)
          (zstream-data-type p)))
 
+;; parallel deflating
+(let ([data (with-output-to-string
+              (^[] (dotimes [i 20000] (format #t "~a:~a " i (* i i)))))]
+      [par-deflate (^[str . args]
+                     (call-with-output-string
+                       (^p (let1 p2 (apply open-deflating-port p
+                                           :threads 4 :buffer-size 4096 args)
+                             (display str p2)
+                             (close-output-port p2)))))])
+  (test* "open-deflating-port :threads" data
+         (inflate-string (par-deflate data)))
+  (test* "open-deflating-port :threads (gzip)" data
+         (gzip-decode-string (par-deflate data :window-bits (+ 15 16))))
+  (test* "open-deflating-port :threads (raw)" data
+         (inflate-string (par-deflate data :window-bits -15)
+                         :window-bits -15))
+  (test* "open-deflating-port :threads (empty)" ""
+         (inflate-string (par-deflate "")))
+  (test* "open-deflating-port :threads :dictionary" data
+         (inflate-string (par-deflate data :dictionary "1:1 2:4")
+                         :dictionary "1:1 2:4"))
+  (test* "open-deflating-port :threads, check values"
+         (list (adler32 data) (string-size data))
+         (let1 p (open-deflating-port (open-output-string) :threads 3)
+           (display data p)
+           (close-output-port p)
+           (list (zstream-adler32 p) (zstream-total-in p))))
+  (test* "open-deflating-port :threads, full flush" (string-append data data)
+         (inflate-string
+          (call-with-output-string
+            (^p (let1 p2 (open-deflating-port p :threads 2)
+                  (display data p2)
+                  (deflating-port-full-flush p2)
+                  (zstream-params-set! p2 :compression-level 1)
+                  (display data p2)
+                  (close-output-port p2))))))
+  )
+
 ;;------------------------------------------------------------------
 (test-section "inflate port")
 
@@ -122,10 +122,12 @@
                                      strategy::<fixnum>
                                      dictionary
                                      buffer-size::<fixnum>
-                                     owner?)
-   (return (Scm_MakeDeflatingPort source compression-level window-bits
-                                  memory-level strategy dictionary
-                                  buffer-size (not (SCM_FALSEP owner?)))))
+                                     owner?
+                                     threads::<fixnum>)
+   (return (Scm_MakeParallelDeflatingPort source compression-level window-bits
+                                          memory-level strategy dictionary
+                                          buffer-size (not (SCM_FALSEP owner?))
+                                          threads)))
 
  (define-cproc open-inflating-port (sink::<input-port>
                                     :key (buffer-size::<fixnum> 0)
@@ -156,9 +158,13 @@
       [(SCM_FALSEP strategy) (set! st (-> info strategy))]
       [(SCM_INTP strategy) (set! st (SCM_INT_VALUE strategy))]
       [else (SCM_TYPE_ERROR strategy "fixnum or #f")])
-     (let* ([r::int (deflateParams strm lv st)])
-       (unless (== r Z_OK)
-         (Scm_ZlibError r "deflateParams failed: %s" (-> strm msg))))))
+     (if (-> info par)
+       ;; parallel port; the new parameters take effect from the next block
+       (set! (-> info level) lv
+             (-> info strategy) st)
+       (let* ([r::int (deflateParams strm lv st)])
+         (unless (== r Z_OK)
+           (Scm_ZlibError r "deflateParams failed: %s" (-> strm msg)))))))
 
  (define-cproc deflating-port-full-flush (port::<deflating-port>) ::<void>
    (set! (-> (SCM_PORT_ZLIB_INFO port) flush) Z_FULL_FLUSH)
@@ -187,11 +193,12 @@
                                   (strategy Z_DEFAULT_STRATEGY)
                                   (dictionary #f)
                                   (buffer-size 0)
-                                  (owner? #f))
+                                  (owner? #f)
+                                  (threads 1))
   (%open-deflating-port source compression-level
                         window-bits memory-level
                         strategy dictionary
-                        buffer-size owner?))
+                        buffer-size owner? threads))
 
 ;; utility procedures
 (define (deflate-string str . args)
@@ -0,0 +1,513 @@
+/*
+ * gauche-zstd.c - zstd module
+ *
+ *   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gauche-zstd.h"
+#include <gauche/class.h>
+#include <zdict.h>
+
+#define MINIMUM_BUFFER_SIZE 1024
+
+/*================================================================
+ * Class stuff
+ */
+
+static ScmClass *port_cpl[] = {
+    SCM_CLASS_STATIC_PTR(Scm_PortClass),
+    SCM_CLASS_STATIC_PTR(Scm_TopClass),
+    NULL
+};
+
+SCM_DEFINE_BASE_CLASS(Scm_ZstdCompressingPortClass,
+                      ScmPort, /* instance type */
+                      NULL, NULL, NULL, NULL, port_cpl);
+
+SCM_DEFINE_BASE_CLASS(Scm_ZstdDecompressingPortClass,
+                      ScmPort, /* instance type */
+                      NULL, NULL, NULL, NULL, port_cpl);
+
+static void zstd_dict_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
+{
+    Scm_Printf(port, "#<zstd-dictionary %u>", SCM_ZSTD_DICT(obj)->id);
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_ZstdDictClass, zstd_dict_print);
+
+/*================================================================
+ * Common
+ */
+
+static void zstd_check(size_t r, const char *what)
+{
+    if (ZSTD_isError(r)) {
+        Scm_Error("%s failed: %s", what, ZSTD_getErrorName(r));
+    }
+}
+
+/* DATA must be a u8vector or a string. */
+static void data_bytes(ScmObj data, const void **start, size_t *size)
+{
+    if (SCM_U8VECTORP(data)) {
+        *start = SCM_UVECTOR_ELEMENTS(data);
+        *size = SCM_U8VECTOR_SIZE(data);
+    } else if (SCM_STRINGP(data)) {
+        const ScmStringBody *b = SCM_STRING_BODY(data);
+        *start = SCM_STRING_BODY_START(b);
+        *size = SCM_STRING_BODY_SIZE(b);
+    } else {
+        Scm_Error("u8vector or string required, but got: %S", data);
+    }
+}
+
+static void check_dict(ScmObj dict)
+{
+    if (!SCM_FALSEP(dict) && !SCM_ZSTD_DICT_P(dict)
+        && !SCM_U8VECTORP(dict) && !SCM_STRINGP(dict)) {
+        Scm_Error("<zstd-dictionary>, u8vector or string required, "
+                  "but got: %S", dict);
+    }
+}
+
+/* The contexts are malloc'ed by libzstd, so they're freed before
+   raising an error. */
+static void cctx_setup(ZSTD_CCtx *cctx, int level, ScmObj dict, int nthreads,
+                       int checksump)
+{
+    size_t r = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+    if (!ZSTD_isError(r)) {
+        r = ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, checksump);
+    }
+    if (!ZSTD_isError(r) && nthreads > 1) {
+        /* This fails if libzstd is built without threads; we just
+           compress on the calling thread then. */
+        (void)ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, nthreads);
+    }
+    if (!ZSTD_isError(r)) {
+        if (SCM_ZSTD_DICT_P(dict)) {
+            r = ZSTD_CCtx_refCDict(cctx, SCM_ZSTD_DICT(dict)->cdict);
+        } else if (!SCM_FALSEP(dict)) {
+            const void *p; size_t n;
+            data_bytes(dict, &p, &n);
+            r = ZSTD_CCtx_loadDictionary(cctx, p, n);
+        }
+    }
+    if (ZSTD_isError(r)) {
+        ZSTD_freeCCtx(cctx);
+        zstd_check(r, "setting up compression");
+    }
+}
+
+static void dctx_setup(ZSTD_DCtx *dctx, ScmObj dict)
+{
+    size_t r = 0;
+    if (SCM_ZSTD_DICT_P(dict)) {
+        r = ZSTD_DCtx_refDDict(dctx, SCM_ZSTD_DICT(dict)->ddict);
+    } else if (!SCM_FALSEP(dict)) {
+        const void *p; size_t n;
+        data_bytes(dict, &p, &n);
+        r = ZSTD_DCtx_loadDictionary(dctx, p, n);
+    }
+    if (ZSTD_isError(r)) {
+        ZSTD_freeDCtx(dctx);
+        zstd_check(r, "setting up decompression");
+    }
+}
+
+static ScmObj port_name(const char *type, ScmPort *remote)
+{
+    ScmObj out = Scm_MakeOutputStringPort(TRUE);
+    Scm_Printf(SCM_PORT(out), "[%s %A]", type, Scm_PortName(remote));
+    return Scm_GetOutputStringUnsafe(SCM_PORT(out), 0);
+}
+
+static int zstd_fileno(ScmPort *port)
+{
+    return Scm_PortFileNo(SCM_PORT_ZSTD_INFO(port)->remote);
+}
+
+/*================================================================
+ * Compressing port
+ */
+
+/* Feeds the port buffer to the compressor with MODE, and writes out
+   whatever comes out. */
+static void compress_buffer(ScmPort *port, ZSTD_EndDirective mode)
+{
+    ScmZstdInfo *info = SCM_PORT_ZSTD_INFO(port);
+    ZSTD_inBuffer in = { port->src.buf.buffer, SCM_PORT_BUFFER_AVAIL(port), 0 };
+
+    for (;;) {
+        ZSTD_outBuffer out = { info->buf, info->bufsiz, 0 };
+        size_t r = ZSTD_compressStream2(info->cctx, &out, &in, mode);
+        zstd_check(r, "ZSTD_compressStream2");
+        if (out.pos > 0) {
+            Scm_Putz(info->buf, out.pos, info->remote);
+            info->total_out += out.pos;
+        }
+        if (mode == ZSTD_e_continue ? (in.pos == in.size) : (r == 0)) break;
+    }
+    info->total_in += in.size;
+}
+
+static int compress_flusher(ScmPort *port, int cnt, int forcep)
+{
+    compress_buffer(port, forcep ? ZSTD_e_flush : ZSTD_e_continue);
+    return SCM_PORT_BUFFER_AVAIL(port);
+}
+
+static void compress_closer(ScmPort *port)
+{
+    ScmZstdInfo *info = SCM_PORT_ZSTD_INFO(port);
+
+    if (info->cctx == NULL) return;
+    SCM_UNWIND_PROTECT {
+        compress_buffer(port, ZSTD_e_end);
+    }
+    SCM_WHEN_ERROR {
+        ZSTD_freeCCtx(info->cctx);
+        info->cctx = NULL;
+        SCM_NEXT_HANDLER;
+    }
+    SCM_END_PROTECT;
+    ZSTD_freeCCtx(info->cctx);
+    info->cctx = NULL;
+    Scm_Flush(info->remote);
+    if (info->ownerp) {
+        Scm_ClosePort(info->remote);
+    }
+}
+
+ScmObj Scm_MakeZstdCompressingPort(ScmPort *drain, int level, ScmObj dict,
+                                   int nthreads, int checksump,
+                                   int bufsiz, int ownerp)
+{
+    check_dict(dict);
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    if (cctx == NULL) Scm_Error("couldn't create a zstd compression context");
+    cctx_setup(cctx, level, dict, nthreads, checksump);
+
+    ScmZstdInfo *info = SCM_NEW(ScmZstdInfo);
+    info->cctx = cctx;
+    info->dctx = NULL;
+    info->remote = drain;
+    info->dict = dict;
+    info->ownerp = ownerp;
+    info->stream_endp = FALSE;
+    info->frame_rest = 0;
+    info->out_full = FALSE;
+    info->bufsiz = ZSTD_CStreamOutSize();
+    info->buf = SCM_NEW_ATOMIC2(char *, info->bufsiz);
+    info->start = info->end = 0;
+    info->total_in = info->total_out = 0;
+
+    /* Feed the compressor in its preferred chunk size by default. */
+    if (bufsiz <= 0) bufsiz = ZSTD_CStreamInSize();
+    else if (bufsiz < MINIMUM_BUFFER_SIZE) bufsiz = MINIMUM_BUFFER_SIZE;
+
+    ScmPortBuffer bufrec;
+    memset(&bufrec, 0, sizeof(bufrec));
+    bufrec.size = bufsiz;
+    bufrec.buffer = SCM_NEW_ATOMIC2(char *, bufsiz);
+    bufrec.mode = SCM_PORT_BUFFER_FULL;
+    bufrec.filler = NULL;
+    bufrec.flusher = compress_flusher;
+    bufrec.closer = compress_closer;
+    bufrec.ready = NULL;
+    bufrec.filenum = zstd_fileno;
+    bufrec.data = (void*)info;
+
+    ScmObj name = port_name("zstd-compressing", drain);
+    return Scm_MakeBufferedPort(SCM_CLASS_ZSTD_COMPRESSING_PORT, name,
+                                SCM_PORT_OUTPUT, TRUE, &bufrec);
+}
+
+/*================================================================
+ * Decompressing port
+ */
+
+static int decompress_filler(ScmPort *port, int mincnt)
+{
+    ScmZstdInfo *info = SCM_PORT_ZSTD_INFO(port);
+    ZSTD_outBuffer out = { port->src.buf.end, SCM_PORT_BUFFER_ROOM(port), 0 };
+
+    if (info->stream_endp) return 0;
+    while (out.pos == 0) {
+        if (info->start == info->end && !info->out_full) {
+            int n = Scm_Getz(info->buf, info->bufsiz, info->remote);
+            if (n <= 0) {
+                info->stream_endp = TRUE;
+                if (info->frame_rest != 0) {
+                    Scm_Error("zstd data is truncated: %S",
+                              Scm_PortName(info->remote));
+                }
+                break;
+            }
+            info->start = 0;
+            info->end = n;
+            info->total_in += n;
+        }
+        ZSTD_inBuffer in = { info->buf, info->end, info->start };
+        size_t r = ZSTD_decompressStream(info->dctx, &out, &in);
+        if (ZSTD_isError(r)) {
+            info->stream_endp = TRUE;
+            Scm_Error("zstd data error in %S: %s",
+                      Scm_PortName(info->remote), ZSTD_getErrorName(r));
+        }
+        info->start = in.pos;
+        info->frame_rest = r;
+        info->out_full = (out.pos == out.size);
+    }
+    info->total_out += out.pos;
+    return (int)out.pos;
+}
+
+static void decompress_closer(ScmPort *port)
+{
+    ScmZstdInfo *info = SCM_PORT_ZSTD_INFO(port);
+    if (info->dctx == NULL) return;
+    ZSTD_freeDCtx(info->dctx);
+    info->dctx = NULL;
+    if (info->ownerp) {
+        Scm_ClosePort(info->remote);
+    }
+}
+
+ScmObj Scm_MakeZstdDecompressingPort(ScmPort *source, ScmObj dict,
+                                     int bufsiz, int ownerp)
+{
+    check_dict(dict);
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if (dctx == NULL) Scm_Error("couldn't create a zstd decompression context");
+    dctx_setup(dctx, dict);
+
+    ScmZstdInfo *info = SCM_NEW(ScmZstdInfo);
+    info->cctx = NULL;
+    info->dctx = dctx;
+    info->remote = source;
+    info->dict = dict;
+    info->ownerp = ownerp;
+    info->stream_endp = FALSE;
+    info->frame_rest = 0;
+    info->out_full = FALSE;
+    info->bufsiz = ZSTD_DStreamInSize();
+    info->buf = SCM_NEW_ATOMIC2(char *, info->bufsiz);
+    info->start = info->end = 0;
+    info->total_in = info->total_out = 0;
+
+    if (bufsiz <= 0) bufsiz = ZSTD_DStreamOutSize();
+    else if (bufsiz < MINIMUM_BUFFER_SIZE) bufsiz = MINIMUM_BUFFER_SIZE;
+
+    ScmPortBuffer bufrec;
+    memset(&bufrec, 0, sizeof(bufrec));
+    bufrec.size = bufsiz;
+    bufrec.buffer = SCM_NEW_ATOMIC2(char *, bufsiz);
+    bufrec.mode = SCM_PORT_BUFFER_FULL;
+    bufrec.filler = decompress_filler;
+    bufrec.flusher = NULL;
+    bufrec.closer = decompress_closer;
+    bufrec.ready = NULL;
+    bufrec.filenum = zstd_fileno;
+    bufrec.data = (void*)info;
+
+    ScmObj name = port_name("zstd-decompressing", source);
+    return Scm_MakeBufferedPort(SCM_CLASS_ZSTD_DECOMPRESSING_PORT, name,
+                                SCM_PORT_INPUT, TRUE, &bufrec);
+}
+
+/*================================================================
+ * One-shot compression
+ */
+
+ScmObj Scm_ZstdCompress(const void *data, size_t size, int level,
+                        ScmObj dict, int nthreads)
+{
+    check_dict(dict);
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    if (cctx == NULL) Scm_Error("couldn't create a zstd compression context");
+    cctx_setup(cctx, level, dict, nthreads, FALSE);
+
+    size_t cap = ZSTD_compressBound(size);
+    void *dst = malloc(cap);
+    if (dst == NULL) {
+        ZSTD_freeCCtx(cctx);
+        Scm_Error("couldn't allocate %zu bytes for compression", cap);
+    }
+    size_t r = ZSTD_compress2(cctx, dst, cap, data, size);
+    ZSTD_freeCCtx(cctx);
+    if (ZSTD_isError(r)) {
+        free(dst);
+        zstd_check(r, "ZSTD_compress2");
+    }
+    ScmObj v = Scm_MakeU8VectorFromArray(r, dst);
+    free(dst);
+    return v;
+}
+
+/* The decompressed size may not be recorded in the frames, so we
+   decompress into a growing buffer. */
+ScmObj Scm_ZstdDecompress(const void *data, size_t size, ScmObj dict)
+{
+    check_dict(dict);
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if (dctx == NULL) Scm_Error("couldn't create a zstd decompression context");
+    dctx_setup(dctx, dict);
+
+    unsigned long long csize = ZSTD_getFrameContentSize(data, size);
+    size_t cap = (csize == ZSTD_CONTENTSIZE_UNKNOWN
+                  || csize == ZSTD_CONTENTSIZE_ERROR
+                  || csize > (unsigned long long)SCM_SMALL_INT_MAX)
+        ? (size_t)size*4 + 64 : (size_t)csize + 1;
+    unsigned char *dst = malloc(cap);
+    ZSTD_inBuffer in = { data, size, 0 };
+    ZSTD_outBuffer out = { dst, cap, 0 };
+    size_t r = 0;
+    const char *err = NULL;
+
+    while (dst != NULL) {
+        r = ZSTD_decompressStream(dctx, &out, &in);
+        if (ZSTD_isError(r)) { err = ZSTD_getErrorName(r); break; }
+        if (in.pos == in.size && out.pos < out.size) {
+            if (r != 0 && size > 0) err = "data is truncated";
+            break;
+        }
+        if (out.pos == out.size) {
+            unsigned char *p = realloc(dst, cap*2);
+            if (p == NULL) { free(dst); dst = NULL; break; }
+            dst = p;
+            cap *= 2;
+            out.dst = dst;
+            out.size = cap;
+        }
+    }
+    ZSTD_freeDCtx(dctx);
+    if (dst == NULL) Scm_Error("couldn't allocate memory for decompression");
+    if (err) {
+        free(dst);
+        Scm_Error("zstd decompression failed: %s", err);
+    }
+    ScmObj v = Scm_MakeU8VectorFromArray(out.pos, dst);
+    free(dst);
+    return v;
+}
+
+/*================================================================
+ * Dictionaries
+ */
+
+static void zstd_dict_finalize(ScmObj obj, void *data)
+{
+    ScmZstdDict *d = SCM_ZSTD_DICT(obj);
+    if (d->cdict) { ZSTD_freeCDict(d->cdict); d->cdict = NULL; }
+    if (d->ddict) { ZSTD_freeDDict(d->ddict); d->ddict = NULL; }
+}
+
+/* Digests the dictionary content once, so that it can be shared
+   by many compression and decompression. */
+ScmObj Scm_ZstdLoadDictionary(const void *data, size_t size, int level)
+{
+    ZSTD_CDict *cdict = ZSTD_createCDict(data, size, level);
+    ZSTD_DDict *ddict = ZSTD_createDDict(data, size);
+    if (cdict == NULL || ddict == NULL) {
+        if (cdict) ZSTD_freeCDict(cdict);
+        if (ddict) ZSTD_freeDDict(ddict);
+        Scm_Error("couldn't load a zstd dictionary");
+    }
+    ScmZstdDict *d = SCM_NEW(ScmZstdDict);
+    SCM_SET_CLASS(d, SCM_CLASS_ZSTD_DICT);
+    d->cdict = cdict;
+    d->ddict = ddict;
+    d->id = ZSTD_getDictID_fromDict(data, size);
+    d->level = level;
+    Scm_RegisterFinalizer(SCM_OBJ(d), zstd_dict_finalize, NULL);
+    return SCM_OBJ(d);
+}
+
+/* SAMPLES is a list of u8vectors or strings. */
+ScmObj Scm_ZstdTrainDictionary(ScmObj samples, size_t capacity)
+{
+    int nsamples = Scm_Length(samples);
+    if (nsamples < 0) Scm_Error("list of samples required, but got: %S",
+                                samples);
+    if (capacity == 0) Scm_Error("dictionary size must be positive");
+
+    size_t total = 0;
+    ScmObj cp;
+    SCM_FOR_EACH(cp, samples) {
+        const void *p; size_t n;
+        data_bytes(SCM_CAR(cp), &p, &n);
+        total += n;
+    }
+
+    size_t *sizes = SCM_NEW_ATOMIC_ARRAY(size_t, nsamples+1);
+    char *buf = SCM_NEW_ATOMIC2(char *, total+1);
+    size_t pos = 0, i = 0;
+    SCM_FOR_EACH(cp, samples) {
+        const void *p; size_t n;
+        data_bytes(SCM_CAR(cp), &p, &n);
+        memcpy(buf + pos, p, n);
+        pos += n;
+        sizes[i++] = n;
+    }
+
+    void *dict = SCM_NEW_ATOMIC2(void *, capacity);
+    size_t r = ZDICT_trainFromBuffer(dict, capacity, buf, sizes,
+                                     (unsigned)nsamples);
+    if (ZDICT_isError(r)) {
+        Scm_Error("zstd dictionary training failed: %s",
+                  ZDICT_getErrorName(r));
+    }
+    return Scm_MakeU8VectorFromArray(r, dict);
+}
+
+/* Returns 0 if DICT doesn't have an ID (raw content dictionary). */
+unsigned int Scm_ZstdDictionaryID(ScmObj dict)
+{
+    if (SCM_ZSTD_DICT_P(dict)) return SCM_ZSTD_DICT(dict)->id;
+    const void *p; size_t n;
+    data_bytes(dict, &p, &n);
+    return ZSTD_getDictID_fromDict(p, n);
+}
+
+/*
+ * Module initialization function.
+ */
+void Scm_Init_zstd(void)
+{
+    ScmModule *mod = SCM_MODULE(SCM_FIND_MODULE("rfc.zstd", TRUE));
+
+    Scm_InitStaticClass(&Scm_ZstdCompressingPortClass,
+                        "<zstd-compressing-port>", mod, NULL, 0);
+    Scm_InitStaticClass(&Scm_ZstdDecompressingPortClass,
+                        "<zstd-decompressing-port>", mod, NULL, 0);
+    Scm_InitStaticClass(&Scm_ZstdDictClass, "<zstd-dictionary>",
+                        mod, NULL, 0);
+}
@@ -0,0 +1,157 @@
+;;;
+;;; Test zstd
+;;;
+
+#!no-fold-case
+
+(use gauche.test)
+(use gauche.uvector)
+
+(test-start "rfc.zstd")
+
+;; bail out if we aren't configured to build zstd
+(unless (file-exists? (string-append "rfc--zstd." (gauche-dso-suffix)))
+  (test-end)
+  (exit 0))
+
+(load "./zstd")
+(import rfc.zstd)
+(test-module 'rfc.zstd)
+
+(test* "zstd-version" #t (string? (zstd-version)))
+(test* "zstd levels" #t (< (zstd-min-level) 0 (zstd-max-level)))
+
+(define *data*
+  (with-output-to-string
+    (^[] (dotimes [i 30000] (format #t "~a:~a " i (* i i))))))
+
+;;------------------------------------------------------------------
+(test-section "one-shot")
+
+(test* "zstd-compress" #t
+       (< (u8vector-length (zstd-compress *data*)) (string-size *data*)))
+(test* "zstd-compress/decompress" *data*
+       (u8vector->string (zstd-decompress (zstd-compress *data*))))
+(test* "zstd-compress/decompress (u8vector)" '#u8(1 2 3 0 255)
+       (zstd-decompress (zstd-compress '#u8(1 2 3 0 255))))
+(test* "zstd-compress/decompress (empty)" '#u8()
+       (zstd-decompress (zstd-compress "")))
+(test* "zstd-compress :level" *data*
+       (u8vector->string
+        (zstd-decompress (zstd-compress *data* :level (zstd-max-level)))))
+(test* "zstd-compress :threads" *data*
+       (u8vector->string (zstd-decompress (zstd-compress *data* :threads 4))))
+(test* "zstd-decompress concatenated frames" "foobar"
+       (u8vector->string
+        (zstd-decompress (u8vector-append (zstd-compress "foo")
+                                          (zstd-compress "bar")))))
+(test* "zstd-decompress (truncated)" (test-error)
+       (let1 v (zstd-compress *data*)
+         (zstd-decompress (u8vector-copy v 0 (quotient (u8vector-length v) 2)))))
+(test* "zstd-decompress (garbage)" (test-error)
+       (zstd-decompress "this isn't zstd data"))
+
+;;------------------------------------------------------------------
+(test-section "ports")
+
+(define (compress-via-port str . args)
+  (call-with-output-string
+    (^p (let1 p2 (apply open-zstd-compressing-port p args)
+          (display str p2)
+          (close-output-port p2)))))
+(define (decompress-via-port str . args)
+  (port->string (apply open-zstd-decompressing-port
+                       (open-input-string str) args)))
+
+(test* "<zstd-compressing-port>" <zstd-compressing-port>
+       (class-of (open-zstd-compressing-port (open-output-string))))
+(test* "port-name" "[zstd-compressing (output string port)]"
+       (port-name (open-zstd-compressing-port (open-output-string))))
+(test* "compressing port" *data*
+       (u8vector->string (zstd-decompress (compress-via-port *data*))))
+(test* "compressing port :threads :checksum" *data*
+       (u8vector->string
+        (zstd-decompress (compress-via-port *data* :threads 3 :checksum #t
+                                            :buffer-size 4096))))
+(test* "decompressing port" *data*
+       (decompress-via-port (u8vector->string (zstd-compress *data*))))
+(test* "decompressing port :buffer-size" *data*
+       (decompress-via-port (compress-via-port *data*) :buffer-size 1024))
+(test* "decompressing port (empty)" ""
+       (decompress-via-port ""))
+(test* "decompressing port (truncated)" (test-error)
+       (let1 s (compress-via-port *data*)
+         (decompress-via-port (string-copy s 0 (quotient (string-size s) 2)))))
+
+(test* "flush" "abc"
+       (let* ([out (open-output-string)]
+              [p (open-zstd-compressing-port out)])
+         (display "abc" p)
+         (flush p)
+         ;; the data written so far can be decompressed before closing
+         (begin0
+           (read-string 3 (open-zstd-decompressing-port
+                           (open-input-string (get-output-string out))))
+           (close-output-port p))))
+
+(test* "zstd-total-in/out" (list (string-size *data*) #t)
+       (let* ([out (open-output-string)]
+              [p (open-zstd-compressing-port out)])
+         (display *data* p)
+         (close-output-port p)
+         (list (zstd-total-in p)
+               (= (zstd-total-out p) (string-size (get-output-string out))))))
+
+(test* "owner?" '(#f #t)
+       (map (^[owner?]
+              (let1 p (open-output-string)
+                (close-output-port (open-zstd-compressing-port p :owner? owner?))
+                (port-closed? p)))
+            '(#f #t)))
+
+;;------------------------------------------------------------------
+(test-section "dictionary")
+
+(define *samples*
+  (map (^i (format "{\"id\":~a,\"name\":\"user~a\",\"groups\":[\"staff\",\"dev\"]}"
+                   i (* i 7)))
+       (iota 2000)))
+
+(define *dict* (zstd-train-dictionary *samples* :size 4096))
+
+(test* "zstd-train-dictionary" #t
+       (and (u8vector? *dict*) (<= (u8vector-length *dict*) 4096)))
+(test* "zstd-dictionary-id" #t
+       (positive? (zstd-dictionary-id *dict*)))
+
+(let ([msg (list-ref *samples* 1234)])
+  (test* "compress with dictionary" msg
+         (u8vector->string
+          (zstd-decompress (zstd-compress msg :dictionary *dict*)
+                           :dictionary *dict*)))
+  (test* "dictionary improves ratio" #t
+         (< (u8vector-length (zstd-compress msg :dictionary *dict*))
+            (u8vector-length (zstd-compress msg))))
+  (test* "zstd-frame-dictionary-id" (zstd-dictionary-id *dict*)
+         (zstd-frame-dictionary-id (zstd-compress msg :dictionary *dict*)))
+  (test* "dictionary required" (test-error)
+         (zstd-decompress (zstd-compress msg :dictionary *dict*)))
+
+  (let1 d (zstd-load-dictionary *dict* :level 5)
+    (test* "zstd-load-dictionary" (zstd-dictionary-id *dict*)
+           (zstd-dictionary-id d))
+    (test* "loaded dictionary" msg
+           (u8vector->string
+            (zstd-decompress (zstd-compress msg :dictionary d) :dictionary d)))
+    (test* "loaded dictionary and raw dictionary" msg
+           (u8vector->string
+            (zstd-decompress (zstd-compress msg :dictionary d)
+                             :dictionary *dict*)))
+    (test* "ports with dictionary" msg
+           (decompress-via-port (compress-via-port msg :dictionary d)
+                                :dictionary d))))
+
+(test* "bad dictionary" (test-error)
+       (zstd-compress "abc" :dictionary 'foo))
+
+(test-end)
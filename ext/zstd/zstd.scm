@@ -0,0 +1,136 @@
+;;;
+;;; rfc.zstd - Zstandard compression
+;;;
+;;;   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+
+#!no-fold-case
+
+(define-module rfc.zstd
+  (use gauche.uvector)
+  (export zstd-version zstd-min-level zstd-max-level
+          <zstd-compressing-port> <zstd-decompressing-port>
+          open-zstd-compressing-port open-zstd-decompressing-port
+          zstd-total-in zstd-total-out
+          zstd-compress zstd-decompress
+          <zstd-dictionary> zstd-load-dictionary zstd-train-dictionary
+          zstd-dictionary-id zstd-frame-dictionary-id
+          ))
+(select-module rfc.zstd)
+
+(inline-stub
+ (declcode "#include \"gauche-zstd.h\"")
+ (initcode (Scm_Init_zstd))
+
+ (define-type <zstd-compressing-port> "ScmPort*" "zstd compressing port"
+   "SCM_ZSTD_COMPRESSING_PORT_P" "SCM_PORT")
+ (define-type <zstd-decompressing-port> "ScmPort*" "zstd decompressing port"
+   "SCM_ZSTD_DECOMPRESSING_PORT_P" "SCM_PORT")
+
+ "#define SCM_ZSTD_PORT_P(x) (SCM_ZSTD_COMPRESSING_PORT_P(x)||SCM_ZSTD_DECOMPRESSING_PORT_P(x))"
+ ;; proxy type, like <xflating-port> in rfc.zlib
+ (define-type <zstd-port> "ScmPort*" "zstd port"
+   "SCM_ZSTD_PORT_P" "SCM_PORT")
+
+ (define-cfn data_element (data::ScmObj
+                           start::(const void**)
+                           siz::size_t*)
+   ::void :static
+   (cond [(SCM_U8VECTORP data)
+          (set! (* start) (SCM_UVECTOR_ELEMENTS (SCM_U8VECTOR data))
+                (* siz)   (SCM_U8VECTOR_SIZE (SCM_U8VECTOR data)))]
+         [(SCM_STRINGP data)
+          (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY data)])
+            (set! (* start) (SCM_STRING_BODY_START b)
+                  (* siz)   (SCM_STRING_BODY_SIZE b)))]
+         [else
+          (Scm_Error "u8vector or string required, but got: %S" data)]))
+
+ (define-cproc zstd-version ()
+   (expr <top> (SCM_MAKE_STR (ZSTD_versionString))))
+ (define-cproc zstd-min-level () ::<int> ZSTD_minCLevel)
+ (define-cproc zstd-max-level () ::<int> ZSTD_maxCLevel)
+
+ (define-cproc open-zstd-compressing-port (drain::<output-port>
+                                           :key (level::<fixnum> 0)
+                                           (dictionary #f)
+                                           (threads::<fixnum> 1)
+                                           (checksum #f)
+                                           (buffer-size::<fixnum> 0)
+                                           (owner? #f))
+   (return (Scm_MakeZstdCompressingPort drain level dictionary threads
+                                        (not (SCM_FALSEP checksum))
+                                        buffer-size
+                                        (not (SCM_FALSEP owner?)))))
+
+ (define-cproc open-zstd-decompressing-port (source::<input-port>
+                                             :key (dictionary #f)
+                                             (buffer-size::<fixnum> 0)
+                                             (owner? #f))
+   (return (Scm_MakeZstdDecompressingPort source dictionary buffer-size
+                                          (not (SCM_FALSEP owner?)))))
+
+ (define-cproc zstd-total-in (port::<zstd-port>) ::<ulong>
+   (return (-> (SCM_PORT_ZSTD_INFO port) total_in)))
+ (define-cproc zstd-total-out (port::<zstd-port>) ::<ulong>
+   (return (-> (SCM_PORT_ZSTD_INFO port) total_out)))
+
+ (define-cproc zstd-compress (data :key (level::<fixnum> 0)
+                                   (dictionary #f)
+                                   (threads::<fixnum> 1))
+   (let* ([start::(const void*)] [siz::size_t])
+     (data_element data (& start) (& siz))
+     (return (Scm_ZstdCompress start siz level dictionary threads))))
+
+ (define-cproc zstd-decompress (data :key (dictionary #f))
+   (let* ([start::(const void*)] [siz::size_t])
+     (data_element data (& start) (& siz))
+     (return (Scm_ZstdDecompress start siz dictionary))))
+
+ (define-cproc zstd-load-dictionary (data :key (level::<fixnum> 0))
+   (let* ([start::(const void*)] [siz::size_t])
+     (data_element data (& start) (& siz))
+     (return (Scm_ZstdLoadDictionary start siz level))))
+
+ (define-cproc zstd-train-dictionary (samples::<list>
+                                      :key (size::<fixnum> 112640))
+   (when (<= size 0)
+     (Scm_Error "dictionary size must be positive, but got: %ld" size))
+   (return (Scm_ZstdTrainDictionary samples size)))
+
+ (define-cproc zstd-dictionary-id (dict) ::<uint>
+   (return (Scm_ZstdDictionaryID dict)))
+
+ (define-cproc zstd-frame-dictionary-id (data) ::<uint>
+   (let* ([start::(const void*)] [siz::size_t])
+     (data_element data (& start) (& siz))
+     (return (ZSTD_getDictID_fromFrame start siz))))
+ )
@@ -1246,6 +1246,10 @@ GC_INNER GC_bool GC_expand_hp_inner(word n)
 
     if (n < MINHINCR) n = MINHINCR;
     bytes = ROUNDUP_PAGESIZE(n * HBLKSIZE);
+    if (GC_huge_pages != GC_HUGE_PAGES_NONE) {
+        /* Keep the heap sections in whole huge pages.  */
+        bytes = (bytes + GC_HUGE_PAGE_SIZE - 1) & ~(GC_HUGE_PAGE_SIZE - 1);
+    }
     if (GC_max_heapsize != 0 && GC_heapsize + bytes > GC_max_heapsize) {
         /* Exceeded self-imposed limit */
         return(FALSE);
@@ -410,6 +410,20 @@ GC_API void GC_CALL GC_set_pages_executable(int);
 /* use or need synchronization (i.e. acquiring the allocator lock).     */
 GC_API int GC_CALL GC_get_pages_executable(void);
 
+/* Huge page modes for the heap.  GC_HUGE_PAGES_ADVISE asks the kernel  */
+/* to back the heap sections by transparent huge pages (madvise with    */
+/* MADV_HUGEPAGE).  GC_HUGE_PAGES_HUGETLB tries to map them from the    */
+/* reserved huge pages (MAP_HUGETLB) first, and falls back to the       */
+/* former.  In either mode, the heap is expanded in multiples of        */
+/* GC_HUGE_PAGE_SIZE.  Only effective on Linux; should be set before    */
+/* the collector is initialized, but a later setting affects the        */
+/* subsequent heap expansions.                                          */
+#define GC_HUGE_PAGES_NONE    0
+#define GC_HUGE_PAGES_ADVISE  1
+#define GC_HUGE_PAGES_HUGETLB 2
+GC_API void GC_CALL GC_set_huge_pages(int);
+GC_API int GC_CALL GC_get_huge_pages(void);
+
 /* Overrides the default handle-fork mode.  Non-zero value means GC     */
 /* should install proper pthread_atfork handlers.  Has effect only if   */
 /* called before GC_INIT.  Clients should invoke GC_set_handle_fork     */
@@ -667,6 +681,11 @@ GC_API size_t GC_CALL GC_get_bytes_since_gc(void);
 /* getter (see GC_get_heap_size comment regarding thread-safety).       */
 GC_API size_t GC_CALL GC_get_total_bytes(void);
 
+/* Return the number of separately added heap sections.  This is an     */
+/* unsynchronized getter (see GC_get_heap_size comment regarding        */
+/* thread-safety).                                                      */
+GC_API size_t GC_CALL GC_get_heap_sects_count(void);
+
 /* Return the heap usage information.  This is a thread-safe (atomic)   */
 /* alternative for the five above getters.   (This function acquires    */
 /* the allocator lock thus preventing data racing and returning the     */
@@ -1417,6 +1417,13 @@ GC_EXTERN unsigned GC_n_kinds;
 GC_EXTERN word GC_n_heap_sects; /* Number of separately added heap      */
                                 /* sections.                            */
 
+GC_EXTERN int GC_huge_pages;    /* One of GC_HUGE_PAGES_xxx.            */
+#ifndef GC_HUGE_PAGE_SIZE
+# define GC_HUGE_PAGE_SIZE ((word)2 << 20)
+                                /* Assumed size of a huge page; the     */
+                                /* common one on x86_64 and aarch64.    */
+#endif
+
 #ifdef USE_PROC_FOR_LIBRARIES
   GC_EXTERN word GC_n_memory;   /* Number of GET_MEM allocated memory   */
                                 /* sections.                            */
@@ -103,6 +103,8 @@
 #define IGNORE_PAGES_EXECUTABLE 1
                         /* Undefined on GC_pages_executable real use.   */
 
+GC_INNER int GC_huge_pages = GC_HUGE_PAGES_NONE;
+
 #ifdef NEED_PROC_MAPS
 /* We need to parse /proc/self/maps, either to find dynamic libraries,  */
 /* and/or to find the register backing store base (IA64).  Do it once   */
@@ -2075,12 +2077,49 @@ STATIC ptr_t GC_unix_mmap_get_mem(word bytes)
     return((ptr_t)result);
 }
 
+/* Parts of a hugetlb mapping can't be unmapped, so we don't use it     */
+/* with USE_MUNMAP.                                                     */
+# if defined(MAP_HUGETLB) && defined(MAP_ANONYMOUS) && !defined(USE_MUNMAP)
+/* Returns BYTES of memory from the reserved huge pages, or 0 if BYTES  */
+/* isn't a multiple of the huge page size or there are not enough       */
+/* huge pages.                                                          */
+STATIC ptr_t GC_unix_hugetlb_get_mem(word bytes)
+{
+    void *result;
+
+    if (GC_huge_pages != GC_HUGE_PAGES_HUGETLB
+        || (bytes & (GC_HUGE_PAGE_SIZE - 1)) != 0) return(0);
+    result = mmap(0, bytes, (PROT_READ | PROT_WRITE)
+                            | (GC_pages_executable ? PROT_EXEC : 0),
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#   undef IGNORE_PAGES_EXECUTABLE
+    if (result == MAP_FAILED) return(0);
+    return((ptr_t)result);
+}
+#   define HUGETLB_GET_MEM(bytes) GC_unix_hugetlb_get_mem(bytes)
+# endif
+
 # endif  /* MMAP_SUPPORTED */
 
+/* Asks for transparent huge pages for the memory just obtained.  The   */
+/* kernel may ignore it; it's just a hint.                              */
+STATIC ptr_t GC_advise_huge_pages(ptr_t p, word bytes)
+{
+# ifdef MADV_HUGEPAGE
+    if (p != 0 && GC_huge_pages != GC_HUGE_PAGES_NONE)
+      (void)madvise(p, (size_t)bytes, MADV_HUGEPAGE);
+# endif
+  return(p);
+}
+
 #if defined(USE_MMAP)
   ptr_t GC_unix_get_mem(word bytes)
   {
-    return GC_unix_mmap_get_mem(bytes);
+#   ifdef HUGETLB_GET_MEM
+      ptr_t result = HUGETLB_GET_MEM(bytes);
+      if (result != 0) return result;
+#   endif
+    return GC_advise_huge_pages(GC_unix_mmap_get_mem(bytes), bytes);
   }
 #else /* !USE_MMAP */
 
@@ -2132,6 +2171,10 @@ ptr_t GC_unix_get_mem(word bytes)
     static GC_bool sbrk_failed = FALSE;
     ptr_t result = 0;
 
+#   ifdef HUGETLB_GET_MEM
+      result = HUGETLB_GET_MEM(bytes);
+      if (result != 0) return result;
+#   endif
     if (!sbrk_failed) result = GC_unix_sbrk_get_mem(bytes);
     if (0 == result) {
         sbrk_failed = TRUE;
@@ -2141,9 +2184,9 @@ ptr_t GC_unix_get_mem(word bytes)
         /* Try sbrk again, in case sbrk memory became available.        */
         result = GC_unix_sbrk_get_mem(bytes);
     }
-    return result;
+    return GC_advise_huge_pages(result, bytes);
 # else /* !MMAP_SUPPORTED */
-    return GC_unix_sbrk_get_mem(bytes);
+    return GC_advise_huge_pages(GC_unix_sbrk_get_mem(bytes), bytes);
 # endif
 }
 
@@ -4308,6 +4351,16 @@ GC_API void GC_CALL GC_set_pages_executable(int value)
   GC_pages_executable = (GC_bool)(value != 0);
 }
 
+GC_API void GC_CALL GC_set_huge_pages(int mode)
+{
+  GC_huge_pages = mode;
+}
+
+GC_API int GC_CALL GC_get_huge_pages(void)
+{
+  return GC_huge_pages;
+}
+
 /* Returns non-zero if the GC-allocated memory is executable.   */
 /* GC_get_pages_executable is defined after all the places      */
 /* where GC_get_pages_executable is undefined.                  */
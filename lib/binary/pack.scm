@@ -22,7 +22,7 @@
   (use gauche.uvector)
   (use gauche.parameter)
   (use binary.io)
-  (export pack unpack unpack-skip make-packer))
+  (export pack unpack unpack-skip make-packer make-unpacker))
 (select-module binary.pack)
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
@@ -1001,9 +1001,122 @@
     (lambda ()
       (read-packers-until-token the-eof-object))))
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; compiled fixed-layout templates
+
+;; A template consisting only of fixed-size numbers, `a' strings and `x'
+;; pads with numeric counts, possibly grouped by (), describes a record
+;; of fixed layout.  Such a template is compiled into a record layout of
+;; binary.io, which packs and unpacks a whole record in C.  Other
+;; templates go through the dispatch closures above.
+
+(define %make-binary-layout
+  (with-module binary.io %make-binary-layout))
+(define %unpack-binary-record
+  (with-module binary.io %unpack-binary-record))
+(define %pack-binary-record!
+  (with-module binary.io %pack-binary-record!))
+
+;; Returns a record layout, or #f if TEMPLATE isn't a fixed layout.
+(define (template->layout template)
+  (define (field c bang)
+    (case c
+      ((#\c) '(s8 #f)) ((#\C) '(u8 #f))
+      ((#\s) (and (not bang) '(s16 #f)))
+      ((#\S) (and (not bang) '(u16 #f)))
+      ((#\i #\l) (and (not bang) '(s32 #f)))
+      ((#\I #\L) (and (not bang) '(u32 #f)))
+      ((#\n) (if bang '(s16 big-endian) '(u16 big-endian)))
+      ((#\N) (if bang '(s32 big-endian) '(u32 big-endian)))
+      ((#\v) (if bang '(s16 little-endian) '(u16 little-endian)))
+      ((#\V) (if bang '(s32 little-endian) '(u32 little-endian)))
+      ((#\q) '(s64 #f)) ((#\Q) '(u64 #f))
+      ((#\f) '(f32 #f)) ((#\d) '(f64 #f))
+      (else #f)))
+  (define (count)
+    (skip-pack-comments)
+    (if (and (char? (peek-char)) (char-numeric? (peek-char)))
+      (read-number)
+      1))
+  ;; Returns a list of fields up to CLOSE, or #f
+  (define (items close)
+    (let loop ((res '()))
+      (skip-pack-comments)
+      (let ((c (read-char)))
+        (cond
+          ((eqv? c close) (reverse res))
+          ((eof-object? c) #f)
+          ((eqv? c #\()
+           (let* ((sub (items #\)))
+                  (n (and sub (count))))
+             (and sub (loop (append (reverse (concatenate (make-list n sub)))
+                                    res)))))
+          ((memv (peek-char) '(#\* #\[)) #f)
+          (else
+           (let* ((bang (read-bang))
+                  (n (count)))
+             (skip-pack-comments)
+             (cond
+               ((eqv? (peek-char) #\/) #f)
+               ((memv c '(#\a #\x))
+                (loop (cons (list (if (eqv? c #\a) 'string 'pad) #f n) res)))
+               ((field c bang)
+                => (lambda (f)
+                     (loop (append (make-list n (append f '(0))) res))))
+               (else #f))))))))
+  (let ((fields (with-input-from-string template
+                  (lambda () (items the-eof-object)))))
+    (and fields (%make-binary-layout fields))))
+
+(define (layout-size layout) (s32vector-ref layout 0))
+
+(define (check-extra-values rest)
+  (when (pair? rest)
+    (error "pack: extra values remaining:" rest)))
+
+;; The direct packer procedure of a compiled template.  Packs VALS to
+;; DEST, an output port or a u8vector, and returns the offset after the
+;; record for a u8vector.
+(define (make-layout-packer layout)
+  (let ((size (layout-size layout)))
+    (lambda (vals :optional (dest (current-output-port)) (offset 0))
+      (if (output-port? dest)
+        (let ((buf (make-u8vector size)))
+          (check-extra-values (%pack-binary-record! layout buf 0 vals))
+          (write-uvector buf dest)
+          (undefined))
+        (begin
+          (check-extra-values (%pack-binary-record! layout dest offset vals))
+          (+ offset size))))))
+
+(define (make-dispatch-packer dispatch)
+  (define (pack-to port vals)
+    (check-extra-values (with-output-to-port port
+                          (lambda () (dispatch 'pack vals)))))
+  (lambda (vals :optional (dest (current-output-port)) (offset 0))
+    (if (output-port? dest)
+      (begin (pack-to dest vals) (undefined))
+      (let ((bytes (string->u8vector
+                    (call-with-output-string (cut pack-to <> vals)))))
+        (u8vector-copy! dest offset bytes)
+        (+ offset (u8vector-length bytes))))))
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; exported interface
 
+;; The closure returned by make-packer dispatches symbol commands as
+;; above; called with a list of values, it packs them directly.
+(define (make-packer-closure template)
+  (let* ((dispatch (read-all-packers template))
+         (layout (template->layout template))
+         (direct (if layout
+                   (make-layout-packer layout)
+                   (make-dispatch-packer dispatch))))
+    (lambda (arg . rest)
+      (if (symbol? arg)
+        (apply dispatch arg rest)
+        (apply direct arg rest)))))
+
 ;; making a parameter for thread safety, maybe better shared between
 ;; threads with a mutex.
 (define make-packer
@@ -1012,10 +1125,36 @@
       (if cached?
         (let ((res (hash-table-get (cache) template #f)))
           (unless res
-            (set! res (read-all-packers template))
+            (set! res (make-packer-closure template))
             (hash-table-put! (cache) template res))
           res)
-        (read-all-packers template)))))
+        (make-packer-closure template)))))
+
+;; Returns a procedure that unpacks one record from SOURCE, an input
+;; port or a uvector with a byte offset.  For a fixed layout template,
+;; the record is read at once, and EOF is returned at the end of input.
+(define (make-unpacker template)
+  (let ((layout (template->layout template)))
+    (if layout
+      (let ((size (layout-size layout)))
+        (lambda (:optional (source (current-input-port)) (offset 0))
+          (if (input-port? source)
+            (let ((buf (if (zero? size)
+                         (make-u8vector 0)
+                         (read-uvector <u8vector> size source))))
+              (cond ((eof-object? buf) buf)
+                    ((< (u8vector-length buf) size)
+                     (error "unpack: premature end of input for template:"
+                            template))
+                    (else (%unpack-binary-record layout buf 0))))
+            (%unpack-binary-record layout source offset))))
+      (let ((packer (make-packer template)))
+        (lambda (:optional (source (current-input-port)) (offset 0))
+          (with-input-from-port (if (input-port? source)
+                                  source
+                                  (open-input-string
+                                   (u8vector->string source offset)))
+            (cut packer 'unpack)))))))
 
 (define (pack template values :key (output #f) (to-string? #f) (cached? #t))
   (let ((packer (make-packer template cached?))
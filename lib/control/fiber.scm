@@ -0,0 +1,397 @@
+;;;
+;;; control.fiber - lightweight threads
+;;;
+;;;   Copyright (c) 2010-2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+(define-module control.fiber
+  (use gauche.threads)
+  (use gauche.record)
+  (use gauche.partcont)
+  (use gauche.selector)
+  (use data.queue)
+  (use data.heap)
+  (export make-fiber-scheduler fiber-scheduler? fiber-scheduler-shutdown!
+          default-fiber-scheduler
+          spawn-fiber fiber? fiber-name fiber-state current-fiber
+          fiber-yield! fiber-sleep! fiber-join!
+          fiber-wait-readable fiber-wait-writable))
+(select-module control.fiber)
+
+;; A fiber is a lightweight thread of control.  It doesn't have its
+;; own VM; it is a partial continuation captured when the fiber
+;; suspends, so its stack is only as large as what it actually uses.
+;;
+;; A scheduler has a number of workers, each of which is an OS thread
+;; running an event loop.  New fibers are distributed to the workers
+;; in round-robin.  Since a continuation can only be resumed on the VM
+;; that captured it, a fiber stays on its worker for its lifetime.
+;;
+;; Each worker has the following queues:
+;;   runq   - tasks (thunks) ready to run.  Only the worker touches it.
+;;   inbox  - tasks posted by other threads.  The worker moves them to
+;;            runq.  If the worker is blocking in select, the poster
+;;            wakes it by writing a byte into the wake pipe.
+;;   timers - a heap of (deadline . thunk), for sleep and timeouts.
+;; Fibers waiting for I/O are kept in the waiters table, keyed by
+;; (fd . flag), and the worker's selector watches those fds.
+
+(define-record-type <fiber-scheduler> %make-scheduler fiber-scheduler?
+  (workers scheduler-workers scheduler-workers-set!) ; vector of <worker>
+  (next    scheduler-next scheduler-next-set!)       ; round-robin index
+  (mutex   scheduler-mutex))
+
+(define-record-type <worker> %make-worker worker?
+  (scheduler worker-scheduler)
+  (runq      worker-runq)
+  (inbox     worker-inbox)
+  (timers    worker-timers)
+  (selector  worker-selector)
+  (waiters   worker-waiters)            ; (fd . flag) -> list of thunks
+  (wake-in   worker-wake-in)
+  (wake-out  worker-wake-out)
+  (sleeping  worker-sleeping)           ; <atomic-box>, #t while in select
+  (current   worker-current worker-current-set!)   ; running fiber
+  (live      worker-live worker-live-set!)         ; # of unfinished fibers
+  (stopping  worker-stopping worker-stopping-set!)
+  (thread    worker-thread worker-thread-set!))
+
+(define-record-type <fiber> %make-fiber fiber?
+  (name    fiber-name)
+  (thunk   fiber-thunk)
+  (state   fiber-state %fiber-state-set!) ; runnable, running, suspended,
+                                          ; done or error
+  (result  fiber-result fiber-result-set!) ; list of values, or condition
+  (joiners fiber-joiners fiber-joiners-set!)
+  (mutex   fiber-mutex)
+  (cv      fiber-cv))
+
+;; The worker the current thread is running, or #f.
+(define %worker (make-parameter #f))
+
+(define %real-sleep (with-module gauche.threads %thread-sleep!))
+
+(define (%now) (time->seconds (current-time)))
+
+(define (%deadline timeout)
+  (if (is-a? timeout <time>)
+    (time->seconds timeout)
+    (+ (%now) timeout)))
+
+(define (%fd port-or-fd)
+  (if (port? port-or-fd) (port-file-number port-or-fd) port-or-fd))
+
+;;;
+;;; Scheduler
+;;;
+
+(define *scheduler* #f)
+(define *scheduler-mutex* (make-mutex))
+
+;; API
+;; Returns the scheduler used when no explicit scheduler is given.  It is
+;; created on demand with as many workers as available processors.
+(define (default-fiber-scheduler)
+  (or *scheduler*
+      (with-locking-mutex *scheduler-mutex*
+        (^[] (or *scheduler*
+                 (rlet1 s (make-fiber-scheduler)
+                   (set! *scheduler* s)))))))
+
+;; API
+(define (make-fiber-scheduler :optional (num-workers
+                                         (max 1 (sys-available-processors))))
+  (rlet1 s (%make-scheduler #f 0 (make-mutex))
+    (let1 ws (list->vector (map (^_ (%make-worker-for s)) (iota num-workers)))
+      (scheduler-workers-set! s ws)
+      (vector-for-each
+       (^w (worker-thread-set! w (thread-start!
+                                  (make-thread (^[] (worker-run! w))
+                                               'fiber-worker))))
+       ws))))
+
+;; API
+;; Waits for all fibers to finish, then stops the workers.
+(define (fiber-scheduler-shutdown! s)
+  (when (and-let1 w (%worker) (eq? (worker-scheduler w) s))
+    (error "can't shut down a fiber scheduler from its own fiber:" s))
+  (vector-for-each (^w (worker-post! w (^[] (worker-stopping-set! w #t))))
+                   (scheduler-workers s))
+  (vector-for-each (^w (thread-join! (worker-thread w)))
+                   (scheduler-workers s))
+  (with-locking-mutex *scheduler-mutex*
+    (^[] (when (eq? *scheduler* s) (set! *scheduler* #f)))))
+
+(define (%pick-worker s)
+  (let1 ws (scheduler-workers s)
+    (with-locking-mutex (scheduler-mutex s)
+      (^[] (let1 i (scheduler-next s)
+             (scheduler-next-set! s (modulo (+ i 1) (vector-length ws)))
+             (vector-ref ws i))))))
+
+;;;
+;;; Worker
+;;;
+
+(define (%make-worker-for s)
+  (receive (in out) (sys-pipe :buffering :none)
+    (rlet1 w (%make-worker s (make-queue) (make-mtqueue)
+                           (make-binary-heap :key car)
+                           (make <selector> :backend 'auto)
+                           (make-hash-table 'equal?)
+                           in out (make-atomic-box #f) #f 0 #f #f)
+      (selector-add! (worker-selector w) in (^[p flag] (read-byte p)) '(r)))))
+
+;; Schedules THUNK to run on W.  Can be called from any thread.
+(define (worker-post! w thunk)
+  (if (eq? (%worker) w)
+    (enqueue! (worker-runq w) thunk)
+    (begin
+      (enqueue! (worker-inbox w) thunk)
+      (when (atomic-box-swap! (worker-sleeping w) #f)
+        (write-byte 0 (worker-wake-out w))))))
+
+(define (worker-run! w)
+  (parameterize ([%worker w])
+    (worker-loop w))
+  (close-port (worker-wake-in w))
+  (close-port (worker-wake-out w)))
+
+(define (worker-loop w)
+  (define runq (worker-runq w))
+  (let loop ()
+    (drain-inbox! w)
+    (fire-timers! w)
+    ;; Run only the tasks queued so far, so that a fiber that keeps
+    ;; yielding can't keep others waiting for I/O.
+    (dotimes [(queue-length runq)]
+      (reset ((dequeue! runq)))
+      (worker-current-set! w #f))
+    (unless (and (worker-stopping w)
+                 (zero? (worker-live w))
+                 (queue-empty? runq)
+                 (queue-empty? (worker-inbox w)))
+      (poll! w)
+      (loop))))
+
+(define (drain-inbox! w)
+  (let loop ()
+    (when-let1 task (dequeue! (worker-inbox w) #f)
+      (enqueue! (worker-runq w) task)
+      (loop))))
+
+(define (fire-timers! w)
+  (let ([timers (worker-timers w)]
+        [now (%now)])
+    (let loop ()
+      (unless (binary-heap-empty? timers)
+        (when (<= (car (binary-heap-find-min timers)) now)
+          ((cdr (binary-heap-pop-min! timers)))
+          (loop))))))
+
+;; Waits for I/O, timers or posted tasks.  Doesn't block if there are
+;; tasks ready to run.
+(define (poll! w)
+  (define (timeout)
+    (and (not (binary-heap-empty? (worker-timers w)))
+         (let1 dt (- (car (binary-heap-find-min (worker-timers w))) (%now))
+           (max 0 (exact (ceiling (* dt 1e6)))))))
+  (if (queue-empty? (worker-runq w))
+    (begin
+      (atomic-box-set! (worker-sleeping w) #t)
+      (selector-select (worker-selector w)
+                       (if (queue-empty? (worker-inbox w)) (timeout) 0))
+      (atomic-box-set! (worker-sleeping w) #f))
+    (selector-select (worker-selector w) 0)))
+
+(define (worker-add-waiter! w fd flag thunk)
+  (let* ([key (cons fd flag)]
+         [thunks (hash-table-get (worker-waiters w) key '())])
+    (when (null? thunks)
+      (selector-add! (worker-selector w) fd
+                     (^[fd flag] (fd-ready! w fd flag)) (list flag)))
+    (hash-table-put! (worker-waiters w) key (append thunks (list thunk)))))
+
+(define (worker-remove-waiter! w fd flag thunk)
+  (let* ([key (cons fd flag)]
+         [thunks (delete thunk (hash-table-get (worker-waiters w) key '())
+                         eq?)])
+    (if (null? thunks)
+      (when (hash-table-exists? (worker-waiters w) key)
+        (hash-table-delete! (worker-waiters w) key)
+        (selector-delete! (worker-selector w) fd #f (list flag)))
+      (hash-table-put! (worker-waiters w) key thunks))))
+
+;; All the waiters are woken; those who find the fd not ready after all
+;; wait again.
+(define (fd-ready! w fd flag)
+  (let* ([key (cons fd flag)]
+         [thunks (hash-table-get (worker-waiters w) key '())])
+    (hash-table-delete! (worker-waiters w) key)
+    (selector-delete! (worker-selector w) fd #f (list flag))
+    (for-each (^t (t)) thunks)))
+
+;;;
+;;; Fibers
+;;;
+
+;; API
+(define (current-fiber)
+  (and-let1 w (%worker) (worker-current w)))
+
+;; API
+(define (spawn-fiber thunk :key (name #f) (scheduler #f))
+  (let* ([s (or scheduler
+                (and-let1 w (%worker) (worker-scheduler w))
+                (default-fiber-scheduler))]
+         [w (%pick-worker s)]
+         [f (%make-fiber name thunk 'runnable #f '()
+                         (make-mutex) (make-condition-variable))])
+    (worker-post! w (^[] (fiber-run! w f)))
+    f))
+
+(define (fiber-run! w f)
+  (worker-live-set! w (+ (worker-live w) 1))
+  (worker-current-set! w f)
+  (%fiber-state-set! f 'running)
+  (receive (state result)
+      (guard (e [else (values 'error e)])
+        (receive r ((fiber-thunk f)) (values 'done r)))
+    (worker-live-set! w (- (worker-live w) 1))
+    (let1 joiners (with-locking-mutex (fiber-mutex f)
+                    (^[] (%fiber-state-set! f state)
+                         (fiber-result-set! f result)
+                         (condition-variable-broadcast! (fiber-cv f))
+                         (begin0 (fiber-joiners f)
+                                 (fiber-joiners-set! f '()))))
+      (for-each (^j (j)) joiners))))
+
+(define (%fiber-finished? f)
+  (memq (fiber-state f) '(done error)))
+
+;; Suspends the current fiber.  REGISTER is called with a procedure,
+;; RESUME, and it must arrange RESUME to be called exactly once, from
+;; any thread.  The argument given to RESUME is returned from %suspend!.
+(define (%suspend! register)
+  (let ([w (%worker)]
+        [f (current-fiber)])
+    (%fiber-state-set! f 'suspended)
+    (shift k
+      (register (^[val]
+                  (worker-post! w (^[]
+                                    (worker-current-set! w f)
+                                    (%fiber-state-set! f 'running)
+                                    (k val))))))))
+
+;; API
+(define (fiber-yield!)
+  (if (current-fiber)
+    (%suspend! (^[resume] (resume #t)))
+    (thread-yield!))
+  (undefined))
+
+;; API
+(define (fiber-sleep! timeout)
+  (if (current-fiber)
+    (let1 w (%worker)
+      (%suspend! (^[resume]
+                   (binary-heap-push! (worker-timers w)
+                                      (cons (%deadline timeout)
+                                            (^[] (resume #t)))))))
+    (%real-sleep timeout))
+  (undefined))
+
+;; thread-sleep! called in a fiber suspends the fiber instead of
+;; the worker thread.
+((with-module gauche.threads %set-thread-sleep-hook!)
+ (^[timeout] (and (current-fiber) (begin (fiber-sleep! timeout) #t))))
+
+;; API
+(define (fiber-join! f)
+  (unless (%fiber-finished? f)
+    (if (current-fiber)
+      (%suspend!
+       (^[resume]
+         (unless (with-locking-mutex (fiber-mutex f)
+                   (^[] (or (%fiber-finished? f)
+                            (begin
+                              (fiber-joiners-set! f (cons (^[] (resume #t))
+                                                          (fiber-joiners f)))
+                              #f))))
+           (resume #t))))
+      (let ([m (fiber-mutex f)]
+            [cv (fiber-cv f)])
+        (mutex-lock! m)
+        (let loop ()
+          (unless (%fiber-finished? f)
+            (mutex-unlock! m cv)
+            (mutex-lock! m)
+            (loop)))
+        (mutex-unlock! m))))
+  (if (eq? (fiber-state f) 'done)
+    (apply values (fiber-result f))
+    (raise (fiber-result f))))
+
+;; API
+(define (fiber-wait-readable port-or-fd :optional (timeout #f))
+  (or (and (input-port? port-or-fd) (byte-ready? port-or-fd))
+      (%wait-fd port-or-fd 'r timeout)))
+
+;; API
+(define (fiber-wait-writable port-or-fd :optional (timeout #f))
+  (%wait-fd port-or-fd 'w timeout))
+
+(define (%wait-fd port-or-fd flag timeout)
+  (if (current-fiber)
+    (let ([w (%worker)]
+          [fd (%fd port-or-fd)])
+      (%suspend!
+       (^[resume]
+         (let* ([fired #f]
+                [fire (^[v] (unless fired (set! fired #t) (resume v)))]
+                [on-ready (^[] (fire #t))])
+           (worker-add-waiter! w fd flag on-ready)
+           (when timeout
+             (binary-heap-push! (worker-timers w)
+                                (cons (%deadline timeout)
+                                      (^[]
+                                        (worker-remove-waiter! w fd flag
+                                                               on-ready)
+                                        (fire #f)))))))))
+    (let1 fds (rlet1 s (make <sys-fdset>) (sys-fdset-set! s port-or-fd #t))
+      (receive (n . _)
+          (if (eq? flag 'r)
+            (sys-select fds #f #f (%select-timeout timeout))
+            (sys-select #f fds #f (%select-timeout timeout)))
+        (> n 0)))))
+
+(define (%select-timeout timeout)
+  (and timeout
+       (max 0 (exact (ceiling (* (- (%deadline timeout) (%now)) 1e6))))))
@@ -0,0 +1,325 @@
+;;;
+;;; control.future - futures and parallel sequence operations
+;;;
+;;;   Copyright (c) 2010-2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+
+(define-module control.future
+  (use control.job)
+  (use control.thread-pool)
+  (use gauche.record)
+  (use gauche.uvector)
+  (use gauche.threads)
+  (export future make-future future? future-done? touch
+          future-pool
+          parallel-map parallel-for-each parallel-fold
+          parallel-sort!))
+(select-module control.future)
+
+;; Futures and parallel-* operations run on a thread pool that persists
+;; across calls, so the cost of creating a VM per thread is paid only
+;; once.  Since they are built on spawn/sync, futures created inside a
+;; future go to the current worker's deque and nested touch helps
+;; running other jobs instead of blocking a worker.
+
+(define *pool* #f)
+(define *pool-mutex* (make-mutex))
+
+;; API
+;; Returns the pool used when no explicit pool is given.  It is created
+;; on demand with as many workers as available processors.
+(define (future-pool)
+  (or *pool*
+      (with-locking-mutex *pool-mutex*
+        (^[] (or *pool*
+                 (rlet1 p (make-thread-pool (max 1 (sys-available-processors)))
+                   (set! *pool* p)))))))
+
+(define-record-type <future> %make-future future?
+  (job future-job))
+
+;; API
+(define (make-future thunk :optional (pool (future-pool)))
+  (%make-future (spawn pool thunk)))
+
+;; API
+(define-syntax future
+  (syntax-rules ()
+    [(_ expr ...) (make-future (^[] expr ...))]))
+
+;; API
+(define (future-done? f)
+  (and (memq (job-status (future-job f)) '(done error killed)) #t))
+
+;; API
+;; Touching a future repeatedly returns the same value (or raises
+;; the same condition).
+(define (touch f) (sync (future-job f)))
+
+;;;
+;;; Parallel sequence operations
+;;;
+
+;; We accept lists, vectors and uvectors.  Lists are converted to vectors
+;; first so that chunks can be sliced by index.
+(define (%accessor seq)
+  (cond [(vector? seq)  (values seq vector-ref (vector-length seq))]
+        [(list? seq)    (let1 v (list->vector seq)
+                          (values v vector-ref (vector-length v)))]
+        [(uvector? seq) (values seq uvector-ref (uvector-length seq))]
+        [else (error "list, vector or uvector required, but got:" seq)]))
+
+;; By default we make about four chunks per worker, so that a slow
+;; chunk can be compensated by others.
+(define (%chunk-size len chunk-size pool)
+  (cond [(not chunk-size)
+         (max 1 (ceiling (/ len (* 4 (~ pool'size)))))]
+        [(and (exact-integer? chunk-size) (positive? chunk-size)) chunk-size]
+        [else (error "chunk-size must be a positive exact integer, \
+                      but got:" chunk-size)]))
+
+;; Calls (proc seq ref start end) for each chunk in parallel, and returns
+;; a list of the results in the order of the chunks.
+(define (%run-chunks v ref len chunk-size pool proc)
+  (let1 size (%chunk-size len chunk-size pool)
+    (let loop ([start 0] [jobs '()])
+      (if (< start len)
+        (let1 end (min len (+ start size))
+          (loop end (cons (spawn pool (^[] (proc v ref start end))) jobs)))
+        (map sync (reverse! jobs))))))
+
+;; API
+;; The result is a list if SEQ is a list, and a vector otherwise.
+(define (parallel-map fn seq :key (chunk-size #f) (pool (future-pool)))
+  (receive (v ref len) (%accessor seq)
+    (let1 r (make-vector len)
+      (%run-chunks v ref len chunk-size pool
+                   (^[v ref start end]
+                     (do ([i start (+ i 1)])
+                         [(= i end)]
+                       (vector-set! r i (fn (ref v i))))))
+      (if (list? seq) (vector->list r) r))))
+
+;; API
+(define (parallel-for-each fn seq :key (chunk-size #f) (pool (future-pool)))
+  (receive (v ref len) (%accessor seq)
+    (%run-chunks v ref len chunk-size pool
+                 (^[v ref start end]
+                   (do ([i start (+ i 1)])
+                       [(= i end)]
+                     (fn (ref v i))))))
+  (undefined))
+
+;; API
+;; Each chunk is folded by KONS starting from KNIL, then the chunk
+;; results are folded by COMBINE from left to right.  For the result
+;; to be deterministic, COMBINE must be associative and KNIL must be
+;; its identity.
+(define (parallel-fold kons knil seq
+                       :key (combine kons) (chunk-size #f) (pool (future-pool)))
+  (receive (v ref len) (%accessor seq)
+    (let1 rs (%run-chunks v ref len chunk-size pool
+                          (^[v ref start end]
+                            (do ([i start (+ i 1)]
+                                 [acc knil (kons (ref v i) acc)])
+                                [(= i end) acc])))
+      (if (null? rs)
+        knil
+        (fold combine (car rs) (cdr rs))))))
+
+;;;
+;;; Parallel sort
+;;;
+
+;; Chunks are sorted in parallel, then adjacent runs are merged level by
+;; level, ping-ponging between SEQ and a work buffer.  Each merge is split
+;; into independent pieces at the chunk size, so all workers are busy
+;; until the last level.  The merges take the left element on ties, hence
+;; the result is that of a stable sort regardless of the number of workers.
+;;
+;; Without a comparator, runs are sorted and merged in C: uvectors by
+;; their raw elements, and vectors by keys with the default ordering
+;; (elements themselves unless KEY is given).  With a comparator, keys are
+;; still computed once per element, and comparisons are done in Scheme.
+;; A buffer is either a uvector, or a pair of an element vector and a key
+;; vector.
+
+(define %sort-by-keys! (with-module gauche.internal %sort-by-keys!))
+(define %merge-split   (with-module gauche.internal %merge-split))
+(define %merge!        (with-module gauche.internal %merge!))
+
+;; Below this, splitting a sort only adds overhead.
+(define-constant *min-sort-chunk* 4096)
+
+;; API
+(define (parallel-sort! seq :optional (cmp #f)
+                        :key (key #f) (chunk-size #f) (pool (future-pool)))
+  (define less?
+    (cond [(not cmp) #f]
+          [(comparator? cmp) (^[a b] (< (comparator-compare cmp a b) 0))]
+          [(applicable? cmp <bottom> <bottom>) cmp]
+          [else (error "parallel-sort! requires a comparator or a procedure \
+                        that takes two arguments, but got:" cmp)]))
+  (cond [(and (uvector? seq) (not less?) (not key))
+         (%parallel-merge-sort! seq (uvector-length seq)
+                                (make-uvector (class-of seq) (uvector-length seq))
+                                (^[b s e] (uvector-sort! b s e))
+                                %merge-split %merge!
+                                (^[dst src s e] (uvector-copy! dst s src s e))
+                                chunk-size pool)]
+        [(uvector? seq)
+         (let1 v (uvector->vector seq)
+           (%parallel-sort-vector! v less? key chunk-size pool)
+           (do ([i 0 (+ i 1)])
+               [(= i (vector-length v))]
+             (uvector-set! seq i (vector-ref v i))))]
+        [(vector? seq) (%parallel-sort-vector! seq less? key chunk-size pool)]
+        [else (error "vector or uvector required, but got:" seq)])
+  seq)
+
+(define (%parallel-sort-vector! v less? key chunk-size pool)
+  (define len (vector-length v))
+  (define keys
+    (if key
+      (rlet1 ks (make-vector len)
+        (%run-chunks v vector-ref len chunk-size pool
+                     (^[v ref start end]
+                       (do ([i start (+ i 1)])
+                           [(= i end)]
+                         (vector-set! ks i (key (ref v i)))))))
+      (vector-copy v)))
+  (define (copy! dst src s e)
+    (vector-copy! (car dst) s (car src) s e)
+    (vector-copy! (cdr dst) s (cdr src) s e))
+  (if less?
+    (%parallel-merge-sort! (cons v keys) len
+                           (cons (make-vector len) (make-vector len))
+                           (^[b s e] (%sort-run-by! (car b) (cdr b) s e less?))
+                           (^[keys a0 a1 b0 b1 k]
+                             (%merge-split-by keys a0 a1 b0 b1 k less?))
+                           (^[dst dk d src sk a0 a1 b0 b1]
+                             (%merge-by! dst dk d src sk a0 a1 b0 b1 less?))
+                           copy! chunk-size pool)
+    (%parallel-merge-sort! (cons v keys) len
+                           (cons (make-vector len) (make-vector len))
+                           (^[b s e] (%sort-by-keys! (car b) (cdr b) s e))
+                           %merge-split %merge!
+                           copy! chunk-size pool)))
+
+;; SORT-RUN!, SPLIT and MERGE! follow the protocols of %sort-by-keys!
+;; (on a buffer), %merge-split and %merge!, respectively.
+(define (%parallel-merge-sort! buf len tmp sort-run! split merge! copy!
+                               chunk-size pool)
+  (define size
+    (if chunk-size
+      (%chunk-size len chunk-size pool)
+      (max *min-sort-chunk* (%chunk-size len #f pool))))
+  (define (elts b) (if (pair? b) (car b) b))
+  (define (keys b) (if (pair? b) (cdr b) b))
+  (define (key-vec b) (and (pair? b) (cdr b)))
+  (define (run-all thunks) (for-each sync (map (cut spawn pool <>) thunks)))
+  ;; Jobs to merge the runs [a0, a1) and [a1, b1) of SRC into DST
+  (define (merge-jobs dst src a0 a1 b1)
+    (let1 n (- b1 a0)
+      (let loop ([k 0] [i 0] [jobs '()])
+        (if (>= k n)
+          jobs
+          (let* ([k1 (min n (+ k size))]
+                 [i1 (split (keys src) a0 a1 a1 b1 k1)]
+                 [job (^[] (merge! (elts dst) (key-vec dst) (+ a0 k)
+                                   (elts src) (key-vec src)
+                                   (+ a0 i) (+ a0 i1)
+                                   (+ a1 (- k i)) (+ a1 (- k1 i1))))])
+            (loop k1 i1 (cons job jobs)))))))
+  (define (copy-jobs dst src s e)
+    (let loop ([s s] [jobs '()])
+      (if (>= s e)
+        jobs
+        (let1 s1 (min e (+ s size))
+          (loop s1 (cons (^[] (copy! dst src s s1)) jobs))))))
+  ;; sort chunks
+  (when (> len 1)
+    (let1 bounds (append (iota (ceiling (/ len size)) 0 size) (list len))
+      (run-all (map (^[s e] (^[] (sort-run! buf s e)))
+                    bounds (cdr bounds)))
+      ;; merge runs
+      (let loop ([bounds bounds] [src buf] [dst tmp])
+        (if (null? (cddr bounds))
+          (unless (eq? src buf)
+            (run-all (copy-jobs buf src 0 len)))
+          (let pair-up ([bs bounds] [next '()] [jobs '()])
+            (cond [(null? (cdr bs))
+                   (run-all jobs)
+                   (loop (reverse! (cons (car bs) next)) dst src)]
+                  [(null? (cddr bs))
+                   (pair-up (cdr bs) (cons (car bs) next)
+                            (append (copy-jobs dst src (car bs) (cadr bs)) jobs))]
+                  [else
+                   (pair-up (cddr bs) (cons (car bs) next)
+                            (append (merge-jobs dst src
+                                                (car bs) (cadr bs) (caddr bs))
+                                    jobs))])))))))
+
+;; Scheme versions of the run primitives, used with a comparator.
+(define (%sort-run-by! v keys s e less?)
+  (let1 ps (make-vector (- e s))
+    (do ([i s (+ i 1)])
+        [(= i e)]
+      (vector-set! ps (- i s) (cons (vector-ref keys i) (vector-ref v i))))
+    (stable-sort! ps (^[a b] (less? (car a) (car b))))
+    (do ([i s (+ i 1)])
+        [(= i e)]
+      (let1 p (vector-ref ps (- i s))
+        (vector-set! keys i (car p))
+        (vector-set! v i (cdr p))))))
+
+(define (%merge-split-by keys a0 a1 b0 b1 k less?)
+  (let loop ([lo (max 0 (- k (- b1 b0)))] [hi (min k (- a1 a0))])
+    (if (>= lo hi)
+      lo
+      (let* ([i (quotient (+ lo hi) 2)]
+             [j (- k i)])
+        (if (and (> j 0) (< (+ a0 i) a1)
+                 (not (less? (vector-ref keys (+ b0 j -1))
+                             (vector-ref keys (+ a0 i)))))
+          (loop (+ i 1) hi)
+          (loop lo i))))))
+
+(define (%merge-by! dst dkeys d src skeys a0 a1 b0 b1 less?)
+  (define (put! k i) (vector-set! dst k (vector-ref src i))
+                     (vector-set! dkeys k (vector-ref skeys i)))
+  (let loop ([i a0] [j b0] [k d])
+    (cond [(and (< i a1)
+                (or (= j b1)
+                    (not (less? (vector-ref skeys j) (vector-ref skeys i)))))
+           (put! k i) (loop (+ i 1) j (+ k 1))]
+          [(< j b1) (put! k j) (loop i (+ j 1) (+ k 1))]
+          [else (undefined)])))
@@ -47,7 +47,8 @@
   (export <thread-pool>
           <thread-pool-shut-down>
           make-thread-pool thread-pool-results thread-pool-shut-down?
-          add-job! wait-all terminate-all!))
+          add-job! wait-all terminate-all!
+          spawn sync))
 (select-module control.thread-pool)
 
 ;; - Thread job is queued in job queue.
@@ -55,6 +56,12 @@
 ;; - optionally, the client can ask to queue the finished job to result-queue.
 ;; - while exeuting the job, thread keeps job record in its 'specific' slot.
 ;; - graceful termination is requested by 'over in the job queue.
+;; - jobs spawned by a worker go to the worker's own deque.  Idle workers
+;;   steal from other workers' deques before waiting on the job queue.
+;;   When a job is spawned while some workers are waiting on the job
+;;   queue, 'wake is put into the job queue to let one of them steal.
+;; - with :affinity 'numa, workers are pinned to NUMA nodes round-robin,
+;;   and steal from the workers on the same node first.
 
 (define-class <thread-pool> ()
   ((result-queue :init-form (make-mtqueue)) ; Queue Job
@@ -62,6 +69,9 @@
    (pool         :init-keyword :pool :init-value '()) ; [Thread]
    (size         :init-keyword :size :init-value 2)
    (job-queue    :init-form (make-mtqueue)) ; Queue (Bool . Job)
+   (deques       :init-value '#())          ; Vector of Queue (Bool . Job)
+   (affinity     :init-keyword :affinity :init-value #f) ; #f or numa
+   (steal-orders :init-value '#())          ; Vector of [Int]
    (max-backlog  :allocation :propagated
                  :propagate '(job-queue max-length)
                  :init-keyword :max-backlog)
@@ -69,15 +79,35 @@
    )
   :metaclass <propagate-meta>)
 
-(define (make-thread-pool size :key (max-backlog #f))
-  (make <thread-pool> :size size :max-backlog max-backlog))
+(define (make-thread-pool size :key (max-backlog #f) (affinity #f))
+  (unless (memq affinity '(#f numa))
+    (error "affinity must be either #f or numa, but got:" affinity))
+  (make <thread-pool> :size size :max-backlog max-backlog :affinity affinity))
 
 (define-method initialize ((pool <thread-pool>) initargs)
   (next-method)
-  (set! (~ pool'pool)
-        (list-tabulate (~ pool'size)
-                       (lambda (_)
-                         (thread-start! (make-thread (cut worker pool)))))))
+  (let* ([size (~ pool'size)]
+         [nodes (if (and (~ pool'affinity)
+                         (thread-affinity (current-thread))) ; supported?
+                  (numa-node-cpus)
+                  '(#f))]
+         [nnodes (length nodes)])
+    ;; Worker i runs on node (i mod nnodes).  It looks at its own deque
+    ;; first, then the ones of the same node, then the rest.
+    (define (steal-order i)
+      (receive (same other)
+          (partition (^k (= (modulo k nnodes) (modulo i nnodes)))
+                     (map (^k (modulo (+ i k) size)) (iota size)))
+        (append same other)))
+    (set! (~ pool'deques) (vector-tabulate size (^_ (make-mtqueue))))
+    (set! (~ pool'steal-orders) (vector-tabulate size steal-order))
+    (set! (~ pool'pool)
+          (list-tabulate size
+                         (lambda (i)
+                           (let1 cpus (list-ref nodes (modulo i nnodes))
+                             (thread-start!
+                              (make-thread (cut worker pool i) #f 0
+                                           :affinity cpus))))))))
 
 (define (thread-pool-results pool)    (~ pool'result-queue))
 (define (thread-pool-shut-down? pool) (~ pool'shut-down))
@@ -88,16 +118,36 @@
 (define (%shut-down pool)
   (error <thread-pool-shut-down> :pool pool "Thread pool has shut down"))
 
-(define (worker pool)
+;; (pool . index) if the current thread is a worker.
+;; Parameters are thread-local, so each worker sets its own.
+(define %current-worker (make-parameter #f))
+
+(define (%run-job pool entry)
   (define self (current-thread))
-  (match (dequeue/wait! (~ pool'job-queue))
-    [(need-result . job)
-     (thread-specific-set! self job)
-     (job-run! job)                     ; captures errors
-     (when need-result (enqueue! (~ pool'result-queue) job))
-     (thread-specific-set! self #f)
-     (worker pool)]
-    [_ #t]))                            ; no more jobs
+  (let ([prev (thread-specific self)]   ; non-#f if we're in sync
+        [job (cdr entry)])
+    (thread-specific-set! self job)
+    (job-run! job)                      ; captures errors
+    (when (car entry) (enqueue! (~ pool'result-queue) job))
+    (thread-specific-set! self prev)))
+
+;; Take a job from our own deque, or steal one from others.
+(define (%find-job pool index)
+  (let1 deques (~ pool'deques)
+    (let loop ([ks (vector-ref (~ pool'steal-orders) index)])
+      (and (pair? ks)
+           (or (dequeue! (vector-ref deques (car ks)) #f)
+               (loop (cdr ks)))))))
+
+(define (worker pool index)
+  (%current-worker (cons pool index))
+  (let loop ()
+    (cond [(%find-job pool index) => (^e (%run-job pool e) (loop))]
+          [else
+           (match (dequeue/wait! (~ pool'job-queue))
+             ['wake (loop)]
+             [(? pair? e) (%run-job pool e) (loop)]
+             [_ #t])])))                ; no more jobs
 
 ;; Returns job if queued, #f if job queue is full
 (define (add-job! pool thunk :optional (need-result #f) (timeout #f))
@@ -109,6 +159,43 @@
            (%shut-down pool)
            job))))
 
+;; Fork/join.  A job spawned by a worker is pushed to its own deque,
+;; so that it is run by the same worker unless others are idle.
+(define (spawn pool thunk)
+  (when (~ pool'shut-down) (%shut-down pool))
+  (let1 job (make-job thunk :waitable #t)
+    (job-acknowledge! job)
+    (match (%current-worker)
+      [((? (cut eq? pool <>)) . index)
+       (queue-push! (vector-ref (~ pool'deques) index) (cons #f job))
+       (when (> (mtqueue-num-waiting-readers (~ pool'job-queue)) 0)
+         (enqueue! (~ pool'job-queue) 'wake))]
+      [_ (enqueue/wait! (~ pool'job-queue) (cons #f job))])
+    job))
+
+;; Wait for JOB to finish and returns its result.  If it raised an error,
+;; sync reraises it.  When called from a worker, it runs other jobs
+;; while waiting, so that nested spawn/sync won't exhaust the workers.
+(define (sync job)
+  (define (finished?) (memq (job-status job) '(done error killed)))
+  (define (wait-a-bit)
+    (if ((with-module control.job job-waiter-cv) job)
+      (job-wait job 0.005)
+      (sys-nanosleep #e1e6)))
+  (match (%current-worker)
+    [(pool . index)
+     (let loop ()
+       (unless (finished?)
+         (if-let1 e (%find-job pool index)
+           (%run-job pool e)
+           (wait-a-bit))
+         (loop)))]
+    [_ (until (finished?) (wait-a-bit))])
+  (case (job-status job)
+    [(done) (job-result job)]
+    [(error) (raise (job-result job))]
+    [else (error "job has been killed:" (job-result job))]))
+
 ;; Note: The signature has been changed from 0.9.1, in which wait-all
 ;; only takes check-interval optional argument.  It is impossible to detect
 ;; the old usage, since integer is a valid argument as timeout.  However,
@@ -132,6 +219,7 @@
                         or #f, but got:" timeout)]))
   (let loop ([now (and abstime (current-time))])
     (cond [(and (queue-empty? (~ pool'job-queue))
+                (every queue-empty? (vector->list (~ pool'deques)))
                 (every (^t (not (thread-specific t))) (~ pool'pool)))]
           [(and abstime (time>=? now abstime)) #f] ;timeout
           [else (sys-nanosleep check-interval)
@@ -154,9 +242,12 @@
 
   ;; If requested, cancel jobs already queued but not being executing.
   (when cancel-queued-jobs
-    (dolist [job (dequeue-all! (~ pool'job-queue))]
-      (job-mark-killed! (cdr job) "thread pool has shut down")
-      (enqueue! (~ pool'result-queue) (cdr job))))
+    (dolist [job (append-map dequeue-all!
+                             (cons (~ pool'job-queue)
+                                   (vector->list (~ pool'deques))))]
+      (when (pair? job)                 ; skip 'wake
+        (job-mark-killed! (cdr job) "thread pool has shut down")
+        (enqueue! (~ pool'result-queue) (cdr job)))))
 
   ;; Sends threads termination message
   (dotimes [count size]
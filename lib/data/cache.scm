@@ -81,6 +81,8 @@
   (use gauche.dictionary)
   (use data.queue)
   (use data.heap)
+  (use gauche.record)
+  (use gauche.threads)
   (use srfi-114)
   (export <cache>
           ;; Protocol
@@ -98,6 +100,7 @@
           make-ttl-cache
           make-ttlr-cache
           make-lru-cache
+          make-concurrent-cache
           make-counting-cache cache-stats))
 (select-module data.cache)
 
@@ -368,6 +371,170 @@
       (cache-compact-queue! (~ c'timestamps) (cache-storage c)))
     (cons key (cdr tv))))
 
+;; Concurrent cache
+;;  - Can be shared among threads.  Entries are split into stripes by
+;;    the hash value of the key, each of which has its own mutex, table
+;;    and clock, so that accesses to different stripes don't block
+;;    each other.
+;;  - Eviction is CLOCK (second chance).  Each entry has a reference bit,
+;;    set when it is read or written.  The clock is a queue of entries.
+;;    To evict, we take the front entry; if its bit is set, we clear it
+;;    and put the entry back, otherwise we drop it.  So we don't need
+;;    to renumber entries as in the LRU cache, and every operation is
+;;    amortized O(1).
+;;  - Capacity is the total weight of the entries, where the weight of
+;;    an entry is given by the weigher (1 for each entry by default).
+;;    Each stripe gets an equal share of it.  An entry heavier than the
+;;    share of the stripe isn't cached.
+;;  - An entry is #(key value weight referenced?).  An evicted entry
+;;    gets #f as its weight, and is removed from the clock lazily.
+;;  - The storage slot isn't used.
+;;  - It keeps hit/miss/eviction counts, which cache-stats returns.
+
+(define-class <concurrent-cache> (<cache>)
+  ([capacity :init-keyword :capacity]
+   [weigher :init-keyword :weigher :init-value #f]  ; value -> weight
+   [num-stripes :init-keyword :num-stripes :init-value 16]
+   ;; private
+   [hasher]
+   [stripes]))
+
+(define-record-type %cache-stripe %make-cache-stripe %cache-stripe?
+  (lock)
+  (table)                               ; key -> entry
+  (clock)                               ; <queue> of entries
+  (capacity)
+  (weight)                              ; total weight of the entries
+  (hits)
+  (misses)
+  (evictions))
+
+(define (make-concurrent-cache capacity :key (comparator #f) (weigher #f)
+                                            (num-stripes 16))
+  (make <concurrent-cache> :comparator comparator :capacity capacity
+        :weigher weigher :num-stripes num-stripes))
+
+(define-method initialize ((c <concurrent-cache>) initargs)
+  (next-method)
+  (let ([n (~ c'num-stripes)]
+        [cmpr (cache-comparator c)])
+    (unless (and (exact-integer? n) (positive? n))
+      (error "num-stripes must be a positive exact integer, but got:" n))
+    (set! (~ c'hasher) (cut comparator-hash cmpr <>))
+    (set! (~ c'stripes)
+          (vector-tabulate n
+                           (^_ (%make-cache-stripe (make-mutex)
+                                                   (make-hash-table cmpr)
+                                                   (make-queue)
+                                                   (ceiling (/ (~ c'capacity) n))
+                                                   0 0 0 0))))))
+
+;; Calls (proc stripe) with the stripe for KEY locked.
+(define-inline (%with-cache-stripe cache key proc)
+  (let* ([stripes (~ cache'stripes)]
+         [s (vector-ref stripes (modulo ((~ cache'hasher) key)
+                                        (vector-length stripes)))])
+    (with-locking-mutex (%cache-stripe-lock s) (^[] (proc s)))))
+
+(define (%cache-entry-weight cache value)
+  (if-let1 w (~ cache'weigher) (w value) 1))
+
+;; The following procedures must be called with the stripe locked.
+;; A new entry is added after making room for it, so that it isn't
+;; evicted before the other entries get their second chance.
+
+(define (%cache-stripe-drop! s e)
+  (hash-table-delete! (%cache-stripe-table s) (vector-ref e 0))
+  (%cache-stripe-weight-set! s (- (%cache-stripe-weight s) (vector-ref e 2)))
+  (vector-set! e 2 #f))
+
+;; Runs the clock hand until the stripe has room for EXTRA more weight.
+;; It terminates, since the second round sees all bits cleared.
+(define (%cache-stripe-sweep! s extra)
+  (let ([clock (%cache-stripe-clock s)])
+    (let loop ()
+      (when (> (+ (%cache-stripe-weight s) extra) (%cache-stripe-capacity s))
+        (let1 e (dequeue! clock)
+          (cond [(not (vector-ref e 2))] ;already dropped
+                [(vector-ref e 3) (vector-set! e 3 #f) (enqueue! clock e)]
+                [else (%cache-stripe-drop! s e)
+                      (%cache-stripe-evictions-set!
+                       s (+ (%cache-stripe-evictions s) 1))])
+          (loop))))))
+
+;; Leaving dropped entries in the clock is harmless, but we don't want
+;; them to pile up when entries are repeatedly evicted by cache-evict!.
+(define (%cache-stripe-compact! s)
+  (let ([clock (%cache-stripe-clock s)])
+    (when (> (queue-length clock)
+             (* 2 (+ (hash-table-num-entries (%cache-stripe-table s)) 8)))
+      (dolist [e (dequeue-all! clock)]
+        (when (vector-ref e 2) (enqueue! clock e))))))
+
+(define (%cache-stripe-put! cache s key value)
+  (let ([w (%cache-entry-weight cache value)]
+        [e (hash-table-get (%cache-stripe-table s) key #f)])
+    (cond [(> w (%cache-stripe-capacity s))
+           (when e (%cache-stripe-drop! s e) (%cache-stripe-compact! s))]
+          [e (%cache-stripe-weight-set!
+              s (+ (%cache-stripe-weight s) (- w (vector-ref e 2))))
+             (vector-set! e 1 value)
+             (vector-set! e 2 w)
+             (vector-set! e 3 #t)
+             (%cache-stripe-sweep! s 0)]
+          [else (%cache-stripe-sweep! s w)
+                (let1 e (vector key value w #f)
+                  (hash-table-put! (%cache-stripe-table s) key e)
+                  (enqueue! (%cache-stripe-clock s) e)
+                  (%cache-stripe-weight-set! s (+ (%cache-stripe-weight s) w)))])))
+
+(define-method cache-check! ((cache <concurrent-cache>) key)
+  (%with-cache-stripe cache key
+    (^[s]
+      (if-let1 e (hash-table-get (%cache-stripe-table s) key #f)
+        (begin (vector-set! e 3 #t)
+               (%cache-stripe-hits-set! s (+ (%cache-stripe-hits s) 1))
+               (cons key (vector-ref e 1)))
+        (begin (%cache-stripe-misses-set! s (+ (%cache-stripe-misses s) 1))
+               #f)))))
+
+(define-method cache-register! ((cache <concurrent-cache>) key value)
+  (%with-cache-stripe cache key (^[s] (%cache-stripe-put! cache s key value)))
+  (cons key value))
+
+(define-method cache-write! ((cache <concurrent-cache>) key value)
+  (%with-cache-stripe cache key (^[s] (%cache-stripe-put! cache s key value)))
+  (undefined))
+
+(define-method cache-evict! ((cache <concurrent-cache>) key)
+  (%with-cache-stripe cache key
+    (^[s]
+      (and-let1 e (hash-table-get (%cache-stripe-table s) key #f)
+        (%cache-stripe-drop! s e)
+        (%cache-stripe-compact! s))))
+  (undefined))
+
+(define-method cache-clear! ((cache <concurrent-cache>))
+  (vector-for-each
+   (^[s] (with-locking-mutex (%cache-stripe-lock s)
+           (^[] (hash-table-clear! (%cache-stripe-table s))
+                (dequeue-all! (%cache-stripe-clock s))
+                (%cache-stripe-weight-set! s 0))))
+   (~ cache'stripes))
+  (undefined))
+
+;; The counts are summed up one stripe at a time, so they may not be
+;; a consistent snapshot while other threads are using the cache.
+(define-method cache-stats ((cache <concurrent-cache>))
+  (let ([hits 0] [misses 0] [evictions 0])
+    (vector-for-each
+     (^[s] (with-locking-mutex (%cache-stripe-lock s)
+             (^[] (inc! hits (%cache-stripe-hits s))
+                  (inc! misses (%cache-stripe-misses s))
+                  (inc! evictions (%cache-stripe-evictions s)))))
+     (~ cache'stripes))
+    `(:hits ,hits :misses ,misses :evictions ,evictions)))
+
 ;; Counting cache
 ;; - This is a wrapper cache to count cache misses/hits
 ;; NB: counting cache's storage directly points to inner-cache's storage.
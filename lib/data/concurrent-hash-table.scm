@@ -0,0 +1,170 @@
+;;;
+;;;  data.concurrent-hash-table - Hash tables shared among threads
+;;;
+;;;   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; A hash table that can be shared among threads.  The entries are
+;; split into several stripes, each of which is an ordinary hash table
+;; guarded by its own mutex.  Accesses to the keys in different stripes
+;; don't block each other.
+;;
+;; Reads also take the stripe lock.  The hash core may relink the
+;; chains while it's being extended, so an unlocked read concurrent
+;; with insertion could miss an existing entry.
+
+(define-module data.concurrent-hash-table
+  (use gauche.record)
+  (use gauche.threads)
+  (use gauche.dictionary)
+  (export <concurrent-hash-table>
+          make-concurrent-hash-table concurrent-hash-table?
+          concurrent-hash-table-comparator
+          concurrent-hash-table-num-entries
+          concurrent-hash-table-get concurrent-hash-table-put!
+          concurrent-hash-table-exists? concurrent-hash-table-delete!
+          concurrent-hash-table-update! concurrent-hash-table-clear!
+          concurrent-hash-table-fold concurrent-hash-table-for-each
+          concurrent-hash-table-map
+          concurrent-hash-table-keys concurrent-hash-table-values
+          concurrent-hash-table->alist))
+(select-module data.concurrent-hash-table)
+
+(define-record-type <concurrent-hash-table> %make-cht concurrent-hash-table?
+  (comparator concurrent-hash-table-comparator)
+  (hasher)                              ; key -> hash value
+  (tables)                              ; #(<hash-table> ...)
+  (locks))                              ; #(<mutex> ...)
+
+(define (%hasher comparator)
+  (case comparator
+    [(eq?) eq-hash]
+    [(eqv?) eqv-hash]
+    [(equal?) hash]
+    [(string=?) string-hash]
+    [else (cut comparator-hash comparator <>)]))
+
+;; API
+(define (make-concurrent-hash-table :optional (comparator 'eq?)
+                                              (num-stripes 16))
+  (unless (and (exact-integer? num-stripes) (positive? num-stripes))
+    (error "num-stripes must be a positive exact integer, but got:"
+           num-stripes))
+  (let1 tables (vector-tabulate num-stripes
+                                (^_ (make-hash-table comparator)))
+    (%make-cht (hash-table-comparator (vector-ref tables 0))
+               (%hasher comparator)
+               tables
+               (vector-tabulate num-stripes (^_ (make-mutex))))))
+
+(define-inline (%stripe cht key)
+  (modulo ((concurrent-hash-table-hasher cht) key)
+          (vector-length (concurrent-hash-table-tables cht))))
+
+;; Calls (proc table) with the stripe for KEY locked.
+(define-inline (%with-stripe cht key proc)
+  (let1 i (%stripe cht key)
+    (with-locking-mutex (vector-ref (concurrent-hash-table-locks cht) i)
+      (^[] (proc (vector-ref (concurrent-hash-table-tables cht) i))))))
+
+;; Calls (proc table) on each stripe in turn, with the stripe locked.
+(define (%for-each-stripe cht proc)
+  (vector-for-each (^[tab lock] (with-locking-mutex lock (^[] (proc tab))))
+                   (concurrent-hash-table-tables cht)
+                   (concurrent-hash-table-locks cht)))
+
+;; API
+(define (concurrent-hash-table-get cht key . fallback)
+  (%with-stripe cht key (^[tab] (apply hash-table-get tab key fallback))))
+
+;; API
+(define (concurrent-hash-table-put! cht key value)
+  (%with-stripe cht key (^[tab] (hash-table-put! tab key value))))
+
+;; API
+(define (concurrent-hash-table-exists? cht key)
+  (%with-stripe cht key (^[tab] (hash-table-exists? tab key))))
+
+;; API
+(define (concurrent-hash-table-delete! cht key)
+  (%with-stripe cht key (^[tab] (hash-table-delete! tab key))))
+
+;; API
+;; PROC is called while the stripe is locked, so that the update is
+;; atomic.  PROC must not access the same table.
+(define (concurrent-hash-table-update! cht key proc . fallback)
+  (%with-stripe cht key
+                (^[tab] (apply hash-table-update! tab key proc fallback))))
+
+;; API
+;; The following procedures visit one stripe at a time; they don't see
+;; a consistent snapshot of the whole table if other threads are
+;; modifying it.  PROC is called without holding locks.
+(define (concurrent-hash-table-num-entries cht)
+  (rlet1 n 0
+    (%for-each-stripe cht (^[tab] (inc! n (hash-table-num-entries tab))))))
+
+(define (concurrent-hash-table-clear! cht)
+  (%for-each-stripe cht hash-table-clear!))
+
+(define (concurrent-hash-table->alist cht)
+  (rlet1 r '()
+    (%for-each-stripe cht (^[tab] (set! r (append (hash-table->alist tab) r))))))
+
+(define (concurrent-hash-table-fold cht kons knil)
+  (fold (^[p seed] (kons (car p) (cdr p) seed)) knil
+        (concurrent-hash-table->alist cht)))
+
+(define (concurrent-hash-table-for-each cht proc)
+  (for-each (^p (proc (car p) (cdr p))) (concurrent-hash-table->alist cht)))
+
+(define (concurrent-hash-table-map cht proc)
+  (map (^p (proc (car p) (cdr p))) (concurrent-hash-table->alist cht)))
+
+(define (concurrent-hash-table-keys cht)
+  (map car (concurrent-hash-table->alist cht)))
+
+(define (concurrent-hash-table-values cht)
+  (map cdr (concurrent-hash-table->alist cht)))
+
+(define-dict-interface <concurrent-hash-table>
+  :get        concurrent-hash-table-get
+  :put!       concurrent-hash-table-put!
+  :delete!    concurrent-hash-table-delete!
+  :clear!     concurrent-hash-table-clear!
+  :exists?    concurrent-hash-table-exists?
+  :fold       concurrent-hash-table-fold
+  :for-each   concurrent-hash-table-for-each
+  :map        concurrent-hash-table-map
+  :keys       concurrent-hash-table-keys
+  :values     concurrent-hash-table-values
+  :update!    concurrent-hash-table-update!
+  :->alist    concurrent-hash-table->alist
+  :comparator concurrent-hash-table-comparator)
@@ -0,0 +1,330 @@
+;;;
+;;;  data.timer-wheel - Hierarchical timing wheels
+;;;
+;;;   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; Hierarchical hashed timing wheels.
+;;
+;; G. Varghese and A. Lauck, Hashed and hierarchical timing wheels:
+;; efficient data structures for implementing a timer facility,
+;; IEEE/ACM Trans. on Networking 5(6) pp.824-834, Dec. 1997.
+;;
+;; Time is quantized into ticks of RESOLUTION seconds.  The wheel has
+;; LEVELS levels of 2^BITS slots each.  A timer expiring at tick E is
+;; kept at the lowest level K such that E and the current tick agree
+;; on all bits above BITS*(K+1), in the slot (E >> BITS*K) & mask.
+;; When the current tick crosses a boundary of 2^(BITS*K), the slot of
+;; level K we've just reached is emptied and its timers are
+;; redistributed to lower levels.  Timers too far to fit in the top
+;; level go to the overflow list, which is redistributed each time the
+;; top level wraps around.
+;;
+;; Each slot is a circular doubly-linked list with a sentinel, so adding
+;; and cancelling a timer is O(1).  Advancing the wheel costs O(1) per
+;; tick plus O(1) per timer fired or redistributed, and ticks in which
+;; the lower levels are empty are skipped over.
+
+(define-module data.timer-wheel
+  (use gauche.record)
+  (export make-timer-wheel timer-wheel?
+          timer-wheel-add! timer-wheel-cancel! timer-wheel-reschedule!
+          timer-wheel-num-timers timer-wheel-empty?
+          timer-wheel-advance! timer-wheel-next-timeout
+          timer-wheel-select
+          timer? timer-active?))
+(select-module data.timer-wheel)
+
+(autoload gauche.selector selector-select)
+
+;; A slot, and also a timer, is a node of a doubly-linked list.  A slot
+;; is a sentinel whose expiry is #f.
+(define-record-type timer %make-timer timer?
+  (expiry)                              ; tick, or #f for a sentinel
+  (thunk)
+  (level)                               ; -1 for overflow
+  (prev)
+  (next)
+  (owner))                              ; wheel, or #f if not scheduled
+
+(define (make-slot)
+  (rlet1 s (%make-timer #f #f #f #f #f #f)
+    (timer-prev-set! s s)
+    (timer-next-set! s s)))
+
+(define-inline (slot-empty? s) (eq? (timer-next s) s))
+
+(define (slot-push! s t)                ; append T at the end of S
+  (let1 p (timer-prev s)
+    (timer-next-set! p t)
+    (timer-prev-set! t p)
+    (timer-next-set! t s)
+    (timer-prev-set! s t)))
+
+(define (unlink! t)
+  (let ([p (timer-prev t)]
+        [n (timer-next t)])
+    (timer-next-set! p n)
+    (timer-prev-set! n p)
+    (timer-prev-set! t #f)
+    (timer-next-set! t #f)))
+
+(define-record-type timer-wheel %make-timer-wheel timer-wheel?
+  (resolution)                          ; seconds per tick
+  (bits)                                ; log2 of the number of slots
+  (slots)                               ; vector of levels*2^bits slots
+  (overflow)                            ; slot
+  (counts)                              ; vector of # of timers per level
+  (num-timers)
+  (current)                             ; current tick
+  (clock))                              ; thunk returning seconds
+
+(define (default-clock)
+  (receive (sec nsec) (sys-clock-gettime-monotonic)
+    (if sec
+      (+ sec (/ nsec 1e9))
+      (receive (sec usec) (sys-gettimeofday)
+        (+ sec (/ usec 1e6))))))
+
+(define (make-timer-wheel :key (resolution 0.001) (bits 8) (levels 4)
+                               (clock default-clock))
+  (unless (and (real? resolution) (> resolution 0))
+    (error "resolution must be a positive real number, but got:" resolution))
+  (unless (and (exact-integer? bits) (<= 1 bits 16))
+    (error "bits must be an exact integer between 1 and 16, but got:" bits))
+  (unless (and (exact-integer? levels) (<= 1 levels))
+    (error "levels must be a positive exact integer, but got:" levels))
+  (%make-timer-wheel resolution bits
+                     (vector-tabulate (^_ (make-slot)) (* levels (ash 1 bits)))
+                     (make-slot)
+                     (make-vector levels 0)
+                     0
+                     (floor->exact (/ (clock) resolution))
+                     clock))
+
+(define-inline (wheel-levels w) (vector-length (timer-wheel-counts w)))
+(define-inline (wheel-mask w) (- (ash 1 (timer-wheel-bits w)) 1))
+
+(define (wheel-slot w level index)
+  (vector-ref (timer-wheel-slots w)
+              (+ (ash level (timer-wheel-bits w)) index)))
+
+(define (now-tick w)
+  (floor->exact (/ ((timer-wheel-clock w)) (timer-wheel-resolution w))))
+
+;; Put timer T, which isn't in any list, into the appropriate slot
+;; relative to the current tick.
+(define (place! w t)
+  (let ([e (timer-expiry t)]
+        [cur (timer-wheel-current w)]
+        [bits (timer-wheel-bits w)]
+        [nlevels (wheel-levels w)])
+    (let loop ([k 0])
+      (cond [(= k nlevels)
+             (timer-level-set! t -1)
+             (slot-push! (timer-wheel-overflow w) t)]
+            [(= (ash e (- (* bits (+ k 1)))) (ash cur (- (* bits (+ k 1)))))
+             (timer-level-set! t k)
+             (vector-set! (timer-wheel-counts w) k
+                          (+ (vector-ref (timer-wheel-counts w) k) 1))
+             (slot-push! (wheel-slot w k (logand (ash e (- (* bits k)))
+                                                 (wheel-mask w)))
+                         t)]
+            [else (loop (+ k 1))]))))
+
+;; Take timer T out of the wheel's structure; T stays scheduled.
+(define (detach! w t)
+  (let1 k (timer-level t)
+    (when (>= k 0)
+      (vector-set! (timer-wheel-counts w) k
+                   (- (vector-ref (timer-wheel-counts w) k) 1))))
+  (unlink! t))
+
+(define (delay->expiry w delay)
+  (unless (and (real? delay) (>= delay 0))
+    (error "delay must be a nonnegative real number, but got:" delay))
+  (+ (timer-wheel-current w)
+     (max 1 (ceiling->exact (/ delay (timer-wheel-resolution w))))))
+
+;; API
+(define (timer-wheel-add! w delay thunk)
+  (rlet1 t (%make-timer (delay->expiry w delay) thunk #f #f #f w)
+    (place! w t)
+    (timer-wheel-num-timers-set! w (+ (timer-wheel-num-timers w) 1))))
+
+;; API
+(define (timer-active? t) (boolean (timer-owner t)))
+
+;; API
+(define (timer-wheel-cancel! w t)
+  (and (eq? (timer-owner t) w)
+       (begin
+         (detach! w t)
+         (timer-owner-set! t #f)
+         (timer-wheel-num-timers-set! w (- (timer-wheel-num-timers w) 1))
+         #t)))
+
+;; API
+;; Typical use is to push back an idle timeout on each activity.
+(define (timer-wheel-reschedule! w t delay)
+  (if (eq? (timer-owner t) w)
+    (detach! w t)
+    (begin
+      (when (timer-owner t)
+        (error "timer is scheduled in another wheel:" t))
+      (timer-owner-set! t w)
+      (timer-wheel-num-timers-set! w (+ (timer-wheel-num-timers w) 1))))
+  (timer-expiry-set! t (delay->expiry w delay))
+  (place! w t)
+  t)
+
+;; API
+(define (timer-wheel-empty? w) (zero? (timer-wheel-num-timers w)))
+
+;; Move all timers in slot S to where they belong now.
+(define (cascade! w s)
+  (until (slot-empty? s)
+    (let1 t (timer-next s)
+      (detach! w t)
+      (place! w t))))
+
+;; Process the tick CUR, which is already set as the current tick.
+;; Returns the number of timers fired.
+(define (process-tick! w cur)
+  (let ([bits (timer-wheel-bits w)]
+        [mask (wheel-mask w)]
+        [nlevels (wheel-levels w)])
+    (when (zero? (logand cur (- (ash 1 (* bits nlevels)) 1)))
+      (cascade! w (timer-wheel-overflow w)))
+    (do ([k (- nlevels 1) (- k 1)])
+        [(= k 0)]
+      (when (zero? (logand cur (- (ash 1 (* bits k)) 1)))
+        (cascade! w (wheel-slot w k (logand (ash cur (- (* bits k))) mask)))))
+    (let1 s (wheel-slot w 0 (logand cur mask))
+      (let loop ([n 0])
+        (if (slot-empty? s)
+          n
+          (let1 t (timer-next s)
+            (timer-wheel-cancel! w t)
+            ((timer-thunk t))
+            (loop (+ n 1))))))))
+
+;; Number of lowest levels that have no timers.
+(define (empty-low-levels w)
+  (let1 counts (timer-wheel-counts w)
+    (let loop ([k 0])
+      (if (and (< k (vector-length counts)) (zero? (vector-ref counts k)))
+        (loop (+ k 1))
+        k))))
+
+;; API
+;; Fires all timers expired by NOW, in seconds of the wheel's clock.
+;; Returns the number of timers fired.
+(define (timer-wheel-advance! w :optional (now #f))
+  (let1 target (if now
+                 (floor->exact (/ now (timer-wheel-resolution w)))
+                 (now-tick w))
+    (let loop ([n 0])
+      (let1 cur (timer-wheel-current w)
+        (cond [(>= cur target) n]
+              [(timer-wheel-empty? w)
+               (timer-wheel-current-set! w target)
+               n]
+              [else
+               ;; If levels below K are empty, nothing happens until the
+               ;; next multiple of 2^(bits*K).
+               (let* ([sh (* (timer-wheel-bits w) (empty-low-levels w))]
+                      [next (min target (ash (+ (ash cur (- sh)) 1) sh))])
+                 (timer-wheel-current-set! w next)
+                 (loop (+ n (process-tick! w next))))])))))
+
+;; API
+;; Returns the time in microseconds until the wheel needs to be advanced,
+;; or #f if there's no timers.  The value is suitable as the timeout
+;; argument of sys-select and selector-select.  It may be earlier than
+;; the actual expiration of the nearest timer, when the wheel needs to
+;; redistribute timers in the upper levels; it is never later.
+(define (timer-wheel-next-timeout w :optional (now #f))
+  (and (not (timer-wheel-empty? w))
+       (let* ([bits (timer-wheel-bits w)]
+              [mask (wheel-mask w)]
+              [cur (timer-wheel-current w)]
+              [next-tick (next-event-tick w bits mask cur)]
+              [now (or now ((timer-wheel-clock w)))]
+              [secs (- (* next-tick (timer-wheel-resolution w)) now)])
+         (max 0 (ceiling->exact (* secs 1e6))))))
+
+;; The earliest tick at which something happens.  A timer at level K
+;; is always in a slot after the current index of level K, so the first
+;; nonempty slot is reached at the boundary that sets the index to it.
+;; Overflowed timers are looked at when the top level wraps around.
+(define (next-event-tick w bits mask cur)
+  (define nlevels (wheel-levels w))
+  (define (first-nonempty k idx)
+    (let scan ([i (+ idx 1)])
+      (cond [(> i mask) #f]
+            [(slot-empty? (wheel-slot w k i)) (scan (+ i 1))]
+            [else i])))
+  (let loop ([k 0] [best #f])
+    (define (pick cand) (if best (min best cand) cand))
+    (cond
+     [(= k nlevels)
+      (if (slot-empty? (timer-wheel-overflow w))
+        best
+        (let1 sh (* bits nlevels)
+          (pick (ash (+ (ash cur (- sh)) 1) sh))))]
+     [(zero? (vector-ref (timer-wheel-counts w) k)) (loop (+ k 1) best)]
+     [else
+      (let* ([sh (* bits k)]
+             [base (ash cur (- sh))]
+             [idx (logand base mask)]
+             [found (first-nonempty k idx)])
+        (loop (+ k 1)
+              (pick (if found
+                      (ash (+ base (- found idx)) sh)
+                      (ash (+ (ash base (- bits)) 1) (+ sh bits))))))])))
+
+;; API
+;; Waits the events on SELECTOR, but no later than the nearest timer of
+;; the wheel, then fires expired timers.  TIMEOUT limits the wait, as
+;; in selector-select.  Returns the value of selector-select.
+(define (timer-wheel-select w selector :optional (timeout #f))
+  (let* ([tw (timer-wheel-next-timeout w)]
+         [to (cond [(not timeout) tw]
+                   [(not tw) timeout]
+                   [else (min tw (timeout->microseconds timeout))])]
+         [r (selector-select selector to)])
+    (timer-wheel-advance! w)
+    r))
+
+(define (timeout->microseconds timeout)
+  (if (pair? timeout)
+    (+ (* (car timeout) 1000000) (cadr timeout))
+    timeout))
@@ -39,6 +39,7 @@
           dbm-open    dbm-close   dbm-closed? dbm-get
           dbm-put!    dbm-delete! dbm-exists?
           dbm-fold    dbm-for-each  dbm-map
+          dbm-put-batch! dbm-with-transaction
           dbm-db-exists? dbm-db-remove dbm-db-copy dbm-db-move dbm-db-rename
           dbm-type->class)
   )
@@ -165,6 +166,23 @@
   (reverse
    (dbm-fold dbm (^[key value r] (cons (proc key value) r)) '())))
 
+;;
+;; Bulk updates.  The default dbm-with-transaction just calls THUNK;
+;; subclasses specialize it to defer costly per-update operations
+;; (syncs, renames) until THUNK returns.  A nested call joins the
+;; outermost one.
+;;
+
+(define-method dbm-with-transaction ((dbm <dbm>) thunk)
+  (when (dbm-closed? dbm)
+    (errorf "dbm-with-transaction: dbm already closed: ~s" dbm))
+  (thunk))
+
+;; KVS is a list of (key . value).
+(define-method dbm-put-batch! ((dbm <dbm>) kvs)
+  (dbm-with-transaction dbm
+    (^[] (for-each (^p (dbm-put! dbm (car p) (cdr p))) kvs))))
+
 ;;
 ;; Collection framework
 ;;
@@ -71,6 +71,13 @@
 ;;; read/write.  It is naturally taken care of by the file system.
 ;;; It uses fcntl advisory lock to prevent race conditions that involve
 ;;; more than one entries, whenever available.
+;;;
+;;; Inside dbm-with-transaction, the files prepared in Incoming directory
+;;; are not moved until the transaction ends.  The pending table maps
+;;; each updated key to #t (the new value is in Incoming) or #f (deleted).
+;;; On an error, the files in Incoming are discarded.  We also remember
+;;; the directories we've made, so that we don't need to check them for
+;;; each entry.
 
 (define-constant *fsdbm-version*   "1.0")
 (define-constant *version-file*    "Fsdbm")
@@ -86,7 +93,9 @@
   ())
 
 (define-class <fsdbm> (<dbm>)
-  ((closed? :init-value #f))
+  ((closed? :init-value #f)
+   (pending :init-value #f)             ;hash table during a transaction
+   (known-dirs :init-value #f))         ;ditto
   :metaclass <fsdbm-meta>)
 
 (define-method dbm-open ((self <fsdbm>))
@@ -121,55 +130,100 @@
 (define-method dbm-put! ((self <fsdbm>) key value)
   (next-method)
   (let* ((k (%dbm-k2s self key))
-         (inpath (build-path (ref self 'path) *incoming-dir* (key->path k)))
-         (path   (value-file-path k (ref self 'path))))
-    (make-directory* (sys-dirname path) (dir-perm (ref self 'file-mode)))
-    (make-directory* (sys-dirname inpath) (dir-perm (ref self 'file-mode)))
+         (inpath (incoming-file-path self k)))
+    (ensure-directory self (sys-dirname inpath))
     (with-output-to-file inpath
       (lambda () (display (%dbm-v2s self value)))
-      :if-exists :error) ;; should it be error?
-    (sys-rename inpath path)))
+      :if-exists (if (eq? (pending-state self k) #t)
+                   :supersede
+                   :error)) ;; should it be error?
+    (if (ref self 'pending)
+      (hash-table-put! (ref self 'pending) k #t)
+      (commit-entry self k #t))))
 
 (define-method dbm-get ((self <fsdbm>) key . args)
   (next-method)
-  (let ((path (value-file-path (%dbm-k2s self key) (ref self 'path))))
-    (cond ((call-with-input-file path
-             (^p (and p (%dbm-s2v self (read-chunk p))))
-             :if-does-not-exist #f))
+  (let ((path (current-file-path self (%dbm-k2s self key))))
+    (cond ((and path
+                (call-with-input-file path
+                  (^p (and p (%dbm-s2v self (read-chunk p))))
+                  :if-does-not-exist #f)))
           ((pair? args) (car args))
           (else (errorf "fsdbm: no data for key ~s in database ~s"
                         key self)))))
 
 (define-method dbm-exists? ((self <fsdbm>) key)
   (next-method)
-  (file-exists? (value-file-path (%dbm-k2s self key) (ref self 'path))))
+  (let ((path (current-file-path self (%dbm-k2s self key))))
+    (and path (file-exists? path))))
 
 (define-method dbm-delete! ((self <fsdbm>) key)
   (next-method)
-  (sys-unlink (value-file-path (%dbm-k2s self key) (ref self 'path))))
+  (let ((k (%dbm-k2s self key)))
+    (cond ((ref self 'pending)
+           => (lambda (pending)
+                (when (eq? (hash-table-get pending k 'none) #t)
+                  (sys-unlink (incoming-file-path self k)))
+                (hash-table-put! pending k #f)))
+          (else (commit-entry self k #f)))))
+
+(define-method dbm-with-transaction ((self <fsdbm>) thunk)
+  (define (end! commit?)
+    (let ((pending (ref self 'pending)))
+      (set! (ref self 'pending) #f)
+      (unwind-protect
+          (hash-table-for-each pending
+                               (if commit?
+                                 (cut commit-entry self <> <>)
+                                 (lambda (k state)
+                                   (when state
+                                     (sys-unlink (incoming-file-path self k))))))
+        (set! (ref self 'known-dirs) #f))))
+  (next-method self
+               (lambda ()
+                 (if (ref self 'pending)
+                   (thunk)
+                   (begin
+                     (set! (ref self 'pending) (make-hash-table 'string=?))
+                     (set! (ref self 'known-dirs) (make-hash-table 'string=?))
+                     (receive r (guard (e (else (end! #f) (raise e)))
+                                  (thunk))
+                       (end! #t)
+                       (apply values r)))))))
 
 (define-method dbm-fold ((self <fsdbm>) proc seed)
   (define prefix-len
     (string-length (build-path (ref self 'path) "a/")))
+  (define pending (ref self 'pending))
   (define (apply-kv path seed)
     (if (file-is-directory? path)
       (fold apply-kv seed
             (directory-list path :add-path? #t :children? #t))
       (let ((k (path->key (string-drop path prefix-len))))
-        (if k
+        (if (and k (not (and pending (hash-table-exists? pending k))))
           (proc (%dbm-s2k self k)
                 (call-with-input-file path
                   (^p (%dbm-s2v self (read-chunk p))))
                 seed)
           seed))))
+  (define (apply-pending k state seed)
+    (if state
+      (proc (%dbm-s2k self k)
+            (call-with-input-file (incoming-file-path self k)
+              (^p (%dbm-s2v self (read-chunk p))))
+            seed)
+      seed))
   (next-method)
-  (fold (lambda (c seed)
-          (let1 p (build-path (ref self 'path) c)
-            (if (file-exists? p)
-              (fold apply-kv seed
-                    (directory-list p :add-path? #t :children? #t))
-              seed)))
-        seed *hash-dirs*))
+  (let1 seed (fold (lambda (c seed)
+                     (let1 p (build-path (ref self 'path) c)
+                       (if (file-exists? p)
+                         (fold apply-kv seed
+                               (directory-list p :add-path? #t :children? #t))
+                         seed)))
+                   seed *hash-dirs*)
+    (if pending
+      (hash-table-fold pending apply-pending seed)
+      seed)))
 
 (define-method dbm-db-exists? ((class <fsdbm-meta>) name)
   (fsdbm-directory? name))
@@ -272,6 +326,38 @@
                       (with-input-from-string path
                         (cut shash 0 *hash-range*)))))
 
+(define (incoming-file-path self key)
+  (build-path (ref self 'path) *incoming-dir* (key->path key)))
+
+;; #t if KEY is updated, #f if deleted, or none if not touched
+;; in the current transaction.
+(define (pending-state self key)
+  (if-let1 pending (ref self 'pending)
+    (hash-table-get pending key 'none)
+    'none))
+
+;; Returns the file that has the current value of KEY, or #f if
+;; it's deleted in the current transaction.
+(define (current-file-path self key)
+  (case (pending-state self key)
+    ((#t) (incoming-file-path self key))
+    ((#f) #f)
+    (else (value-file-path key (ref self 'path)))))
+
+(define (ensure-directory self dir)
+  (let ((known (ref self 'known-dirs)))
+    (unless (and known (hash-table-exists? known dir))
+      (make-directory* dir (dir-perm (ref self 'file-mode)))
+      (when known (hash-table-put! known dir #t)))))
+
+;; Moves the new value of KEY from Incoming, or deletes KEY if STATE is #f.
+(define (commit-entry self key state)
+  (let ((path (value-file-path key (ref self 'path))))
+    (if state
+      (begin (ensure-directory self (sys-dirname path))
+             (sys-rename (incoming-file-path self key) path))
+      (sys-unlink path))))
+
 (define (value-file-path key :optional (dir #f))
   (let1 p (key->path key)
     (if dir
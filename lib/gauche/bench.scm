@@ -0,0 +1,302 @@
+;;;
+;;; gauche/bench.scm - benchmark harness
+;;;
+;;;   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; gauche.time gives a single sample, which is fine for a quick look
+;; but not for telling whether a change made things faster.  This module
+;; takes repeated samples after warm-up and summarizes them with the
+;; statistics robust to outliers (median and MAD), separating the time
+;; spent in GC.
+
+(define-module gauche.bench
+  (use gauche.record)
+  (use gauche.sequence)
+  (autoload rfc.json construct-json parse-json)
+  (export benchmark <bench-result> bench-result?
+          bench-result-name bench-result-iterations bench-result-samples
+          bench-result-gc-samples bench-result-allocated
+          bench-result-median bench-result-mad
+          bench-result-ci-low bench-result-ci-high
+          bench-result-mean bench-result-min bench-result-max
+          bench-result-gc-time
+          define-benchmark register-benchmark! run-benchmarks
+          report-bench-result report-bench-results
+          bench-results->json write-bench-results-json
+          read-bench-results-json compare-bench-results)
+  )
+(select-module gauche.bench)
+
+;;;
+;;; Result
+;;;
+
+;; All times are in nanoseconds per iteration.  SAMPLES and GC-SAMPLES
+;; are vectors in the order of the runs; the summary statistics are
+;; computed from SAMPLES, which include the time spent in GC.
+(define-record-type <bench-result> %make-bench-result bench-result?
+  (name       bench-result-name)
+  (iterations bench-result-iterations) ; per sample
+  (samples    bench-result-samples)
+  (gc-samples bench-result-gc-samples)
+  (allocated  bench-result-allocated)  ; bytes per iteration
+  (median     bench-result-median)
+  (mad        bench-result-mad)
+  (ci-low     bench-result-ci-low)
+  (ci-high    bench-result-ci-high)
+  (mean       bench-result-mean)
+  (min        bench-result-min)
+  (max        bench-result-max)
+  (gc-time    bench-result-gc-time))   ; median of gc-samples
+
+(define-method write-object ((obj <bench-result>) port)
+  (format port "#<bench-result ~s ~a ±~a>"
+          (bench-result-name obj)
+          (format-ns (bench-result-median obj))
+          (format-ns (bench-result-mad obj))))
+
+;; Statistics.  XS is a sorted vector.
+(define (sorted-median xs)
+  (let1 n (vector-length xs)
+    (if (odd? n)
+      (vector-ref xs (quotient n 2))
+      (/. (+ (vector-ref xs (- (quotient n 2) 1))
+             (vector-ref xs (quotient n 2)))
+          2))))
+
+(define (sorted-mad xs med)
+  (sorted-median (sort (vector-map (^x (abs (- x med))) xs))))
+
+;; Distribution-free 95% confidence interval of the median, from the
+;; order statistics (normal approximation of the binomial distribution).
+(define (sorted-median-ci xs)
+  (let* ([n (vector-length xs)]
+         [h (* 0.98 (sqrt n))]
+         [lo (clamp (floor->exact (- (/ n 2) h)) 1 n)]
+         [hi (clamp (ceiling->exact (+ 1 (/ n 2) h)) 1 n)])
+    (values (vector-ref xs (- lo 1)) (vector-ref xs (- hi 1)))))
+
+(define (make-result name iterations samples gc-samples allocated)
+  (let* ([xs (sort samples)]
+         [n (vector-length xs)]
+         [med (sorted-median xs)])
+    (receive (lo hi) (sorted-median-ci xs)
+      (%make-bench-result name iterations samples gc-samples allocated
+                          med (sorted-mad xs med) lo hi
+                          (/. (fold + 0 xs) n)
+                          (vector-ref xs 0) (vector-ref xs (- n 1))
+                          (sorted-median (sort gc-samples))))))
+
+;;;
+;;; Measurement
+;;;
+
+(define (gc-pause-us)
+  (cadr (assq :total-pause-time (gc-event-stat))))
+
+(define (allocated-bytes)
+  (cadr (assq :total-bytes (gc-stat))))
+
+;; Runs THUNK N times and returns elapsed ns, ns spent in GC, and
+;; bytes allocated.
+(define (run-sample thunk n)
+  (let* ([g0 (gc-pause-us)]
+         [a0 (allocated-bytes)]
+         [t0 (monotonic-ns)])
+    (let loop ([i 0])
+      (when (< i n) (thunk) (loop (+ i 1))))
+    (let* ([t1 (monotonic-ns)]
+           [a1 (allocated-bytes)]
+           [g1 (gc-pause-us)])
+      (values (- t1 t0) (* 1000 (- g1 g0)) (- a1 a0)))))
+
+(define (null-thunk) #f)
+
+;; Finds the iteration count with which a sample takes at least
+;; TARGET-NS.
+(define (calibrate thunk target-ns)
+  (let loop ([n 1])
+    (let1 t (values-ref (run-sample thunk n) 0)
+      (cond [(>= t target-ns) n]
+            [(< t (quotient target-ns 100)) (loop (* n 10))]
+            [else (loop (max (+ n 1)
+                             (ceiling->exact (* n (/. target-ns (max t 1))))))]))))
+
+;; API
+(define (benchmark name thunk :key (runs 10) (warmup 3) (iterations #f)
+                   (sample-time 0.01) (gc-before-run #t))
+  (unless (and (exact-integer? runs) (> runs 0))
+    (error "runs must be a positive exact integer, but got:" runs))
+  (let* ([n (or iterations
+                (calibrate thunk (round->exact (* sample-time 1e9))))]
+         ;; the cost of the loop itself, subtracted from each sample
+         [overhead (values-ref (run-sample null-thunk n) 0)])
+    (dotimes [_ warmup] (run-sample thunk n))
+    (let ([samples (make-vector runs)]
+          [gc-samples (make-vector runs)])
+      (let loop ([i 0] [alloc 0])
+        (if (= i runs)
+          (make-result name n samples gc-samples (/. alloc (* runs n)))
+          (begin
+            (when gc-before-run (gc))
+            (receive (t g a) (run-sample thunk n)
+              (vector-set! samples i (/. (max (- t overhead) 0) n))
+              (vector-set! gc-samples i (/. g n))
+              (loop (+ i 1) (+ alloc a)))))))))
+
+;;;
+;;; Registry, for benchmark suites
+;;;
+
+(define *benchmarks* '())               ; ((name thunk . opts) ...), reversed
+
+;; API
+(define (register-benchmark! name thunk . opts)
+  (set! *benchmarks*
+        (cons (list* name thunk opts)
+              (remove (^b (equal? (car b) name)) *benchmarks*))))
+
+;; API
+;;  (define-benchmark "name" body ...)
+;;  (define-benchmark ("name" :runs 5 ...) body ...)
+(define-syntax define-benchmark
+  (syntax-rules ()
+    [(_ (name . opts) body ...)
+     (register-benchmark! name (^[] body ...) . opts)]
+    [(_ name body ...)
+     (register-benchmark! name (^[] body ...))]))
+
+;; API
+;; SELECT may be #f (all), a regexp or a predicate on the name.
+;; The other keyword arguments are the defaults for benchmark; the
+;; options given to define-benchmark take precedence.
+(define (run-benchmarks :key (select #f) (port (current-output-port))
+                        :allow-other-keys opts)
+  (define (selected? name)
+    (cond [(not select) #t]
+          [(regexp? select) (boolean (rxmatch select name))]
+          [else (select name)]))
+  (filter-map (^b (and (selected? (car b))
+                       (rlet1 r (apply benchmark (car b) (cadr b)
+                                       (append (cddr b) opts))
+                         (when port
+                           (report-bench-result r port)
+                           (flush port)))))
+              (reverse *benchmarks*)))
+
+;;;
+;;; Reporting
+;;;
+
+;; VAL is nonnegative.  As in gauche.time, we don't rely on format for
+;; flonums.
+(define (format-fixed val digs unit)
+  (let* ([scale (expt 10 digs)]
+         [n (round->exact (* val scale))])
+    (if (zero? digs)
+      (format "~d~a" n unit)
+      (format "~d.~v,'0d~a" (quotient n scale) digs (remainder n scale) unit))))
+
+(define (format-ns ns)
+  (cond [(< ns 1e3) (format-fixed ns 1 "ns")]
+        [(< ns 1e6) (format-fixed (/. ns 1e3) 2 "us")]
+        [(< ns 1e9) (format-fixed (/. ns 1e6) 2 "ms")]
+        [else       (format-fixed (/. ns 1e9) 3 "s")]))
+
+(define (format-bytes b)
+  (cond [(< b 1024) (format-fixed b 0 "B")]
+        [(< b 1048576) (format-fixed (/. b 1024) 1 "KB")]
+        [else (format-fixed (/. b 1048576) 1 "MB")]))
+
+;; API
+(define (report-bench-result r :optional (port (current-output-port)))
+  (format port "~30a ~10@a ±~9a [~a, ~a]  gc ~a  alloc ~a  (~ax~a)\n"
+          (bench-result-name r)
+          (format-ns (bench-result-median r))
+          (format-ns (bench-result-mad r))
+          (format-ns (bench-result-ci-low r))
+          (format-ns (bench-result-ci-high r))
+          (format-ns (bench-result-gc-time r))
+          (format-bytes (bench-result-allocated r))
+          (vector-length (bench-result-samples r))
+          (bench-result-iterations r)))
+
+;; API
+(define (report-bench-results rs :optional (port (current-output-port)))
+  (for-each (cut report-bench-result <> port) rs))
+
+;; API
+;; Returns a JSON-ready alist.
+(define (bench-results->json rs)
+  (define (result->json r)
+    `(("name" . ,(bench-result-name r))
+      ("iterations" . ,(bench-result-iterations r))
+      ("median_ns" . ,(bench-result-median r))
+      ("mad_ns" . ,(bench-result-mad r))
+      ("ci_low_ns" . ,(bench-result-ci-low r))
+      ("ci_high_ns" . ,(bench-result-ci-high r))
+      ("mean_ns" . ,(bench-result-mean r))
+      ("min_ns" . ,(bench-result-min r))
+      ("max_ns" . ,(bench-result-max r))
+      ("gc_ns" . ,(bench-result-gc-time r))
+      ("alloc_bytes" . ,(bench-result-allocated r))
+      ("samples_ns" . ,(bench-result-samples r))
+      ("gc_samples_ns" . ,(bench-result-gc-samples r))))
+  `(("gauche_version" . ,(gauche-version))
+    ("results" . ,(map-to <vector> result->json rs))))
+
+;; API
+(define (write-bench-results-json rs :optional (port (current-output-port)))
+  (construct-json (bench-results->json rs) port)
+  (newline port))
+
+;; API
+;; Reads what write-bench-results-json wrote.  Returns an alist of
+;; (name . json-alist).
+(define (read-bench-results-json :optional (port (current-input-port)))
+  (map (^r (cons (assoc-ref r "name") r))
+       (vector->list (assoc-ref (parse-json port) "results" '#()))))
+
+;; API
+;; Compares RS with BASELINE, which is what read-bench-results-json
+;; returns.  A benchmark is regarded as regressed if its confidence
+;; interval lies above the baseline's, and the median got slower by
+;; more than THRESHOLD (a ratio).  Returns a list of
+;; (name baseline-median median), for regressed ones.
+(define (compare-bench-results rs baseline :key (threshold 0.05))
+  (filter-map
+   (^r (and-let* ([b (assoc-ref baseline (bench-result-name r))]
+                  [bmed (assoc-ref b "median_ns")]
+                  [bhi (assoc-ref b "ci_high_ns" bmed)]
+                  [ (> (bench-result-ci-low r) bhi) ]
+                  [ (> (bench-result-median r) (* bmed (+ 1 threshold))) ])
+         (list (bench-result-name r) bmed (bench-result-median r))))
+   rs))
@@ -168,35 +168,113 @@
 ;; Precompile multiple Scheme sources that are to be linked into
 ;; single DSO.  Need to check dependency.  The name of the first
 ;; source is used to derive DSO name.
+;;
+;; Sources are grouped into waves, each of which only depends on the
+;; previous waves (a source that uses another module in SRCS loads its
+;; *.sci file).  With JOBS > 1, the sources in a wave are precompiled
+;; concurrently by forked processes.  With INCREMENTAL, a source is
+;; skipped if its outputs are newer than the source, and none of the
+;; sources it depends on is recompiled.  With SHOW-TIMING, the time
+;; spent for each source is reported to stderr.
 (define (cgen-precompile-multi srcs
                                :key (ext-initializer #f)
                                     ((:strip-prefix prefix) #f)
                                     ((:dso-name dso) #f)
                                     (predef-syms '())
                                     (macros-to-keep '())
-                                    (extra-optimization #f))
+                                    (extra-optimization #f)
+                                    (jobs 1)
+                                    (incremental #f)
+                                    (show-timing #f))
   (match srcs
     [() #f]
     [(main . subs)
-     (clean-output-files srcs prefix)
-     (with-tmodule-recording
-      <ptmodule>
-      (dolist [src (order-files-by-dependency srcs)]
-        (let* ([out.c ($ xlate-cfilename
-                         $ strip-prefix (path-swap-extension src "c") prefix)]
-               [initname (string-tr (path-sans-extension out.c) "-+." "___")])
-          (%cgen-precompile src
-                            :out.c out.c
-                            :dso-name (or dso (basename-sans-extension main))
-                            :predef-syms predef-syms
-                            :strip-prefix prefix
-                            :macros-to-keep macros-to-keep
-                            :extra-optimization extra-optimization
-                            :ext-initializer (and (equal? src main)
-                                                  ext-initializer)
-                            :initializer-name #"Scm_Init_~initname"))))]
+     (define (compile1 src)
+       (let* ([out.c (multi-output-cfile src prefix)]
+              [initname (string-tr (path-sans-extension out.c) "-+." "___")])
+         (%cgen-precompile src
+                           :out.c out.c
+                           :dso-name (or dso (basename-sans-extension main))
+                           :predef-syms predef-syms
+                           :strip-prefix prefix
+                           :macros-to-keep macros-to-keep
+                           :extra-optimization extra-optimization
+                           :ext-initializer (and (equal? src main)
+                                                 ext-initializer)
+                           :initializer-name #"Scm_Init_~initname")))
+     (receive (waves src-deps) (group-files-by-dependency srcs)
+       (let* ([targets (if incremental
+                         (outdated-files waves src-deps prefix)
+                         srcs)]
+              [times (begin
+                       (clean-output-files targets prefix)
+                       (with-tmodule-recording
+                        <ptmodule>
+                        (append-map
+                         (^[wave]
+                           (run-precompile-wave compile1
+                                                (filter (cut member <> targets)
+                                                        wave)
+                                                jobs))
+                         waves)))])
+         (when show-timing (report-precompile-times times))))]
     ))
 
+(define (multi-output-cfile src prefix)
+  ($ xlate-cfilename $ strip-prefix (path-swap-extension src "c") prefix))
+
+;; Precompile SRCS, running up to JOBS processes at once.
+;; Returns a list of (src . seconds).
+(define (run-precompile-wave compile1 srcs jobs)
+  (define (now)
+    (receive (sec usec) (sys-gettimeofday) (+ sec (/. usec 1e6))))
+  (define (timed src)
+    (let1 start (now)
+      (compile1 src)
+      (cons src (- (now) start))))
+  (define (spawn src)
+    (let1 pid (sys-fork)
+      (when (zero? pid)
+        (let1 code (guard (e [else (report-error e) 70])
+                     (compile1 src)
+                     0)
+          (flush-all-ports)
+          (sys-exit code)))
+      pid))
+  (if (or (<= jobs 1)
+          (length<=? srcs 1)
+          (not (global-variable-bound? 'gauche 'sys-fork)))
+    (map timed srcs)
+    ;; RUNNING is an alist of pid -> (src . start-time)
+    (let loop ([pending srcs] [running '()] [done '()] [failed '()])
+      (cond
+       [(and (pair? pending) (null? failed) (< (length running) jobs))
+        (let1 start (now)
+          (loop (cdr pending)
+                (acons (spawn (car pending)) (cons (car pending) start) running)
+                done failed))]
+       [(null? running)
+        (unless (null? failed)
+          (error "precompilation failed:" (reverse failed)))
+        (reverse done)]
+       [else
+        (receive (pid status) (sys-waitpid -1)
+          (match (assv pid running)
+            [#f (loop pending running done failed)]
+            [(_ src . start)
+             (let1 ok? (and (sys-wait-exited? status)
+                            (zero? (sys-wait-exit-status status)))
+               (loop pending (alist-delete pid running eqv?)
+                     (acons src (- (now) start) done)
+                     (if ok? failed (cons src failed))))]))]))))
+
+(define (report-precompile-times times)
+  (let1 port (current-error-port)
+    (dolist [p (sort times > cdr)]
+      (format port ";; precomp ~8,3f s  ~a\n" (cdr p) (car p)))
+    (format port ";; precomp ~8,3f s  total (~d files)\n"
+            (fold + 0 (map cdr times)) (length times))))
+
 ;; Common stuff -- process single source
 (define (%cgen-precompile src
                           :key (out.c #f)
@@ -372,6 +450,48 @@
          [unsorted-srcs (lset-difference string=? srcs sorted-srcs)])
     (append sorted-srcs unsorted-srcs)))
 
+;; Groups SRCS into a list of waves, so that a source only depends on
+;; the sources in the previous waves.  Sources without define-module go
+;; to the last wave, for we don't know their dependencies.
+;; Returns the waves, and an alist of source -> the sources it depends on.
+(define (group-files-by-dependency srcs)
+  (let* ([deps (filter-map get-module-dependency srcs)]
+         [mod->src (map (^.[(n s _) (cons n s)]) deps)]
+         [src-deps (map (^.[(n s ns)
+                            (cons s (filter-map (cut assq-ref mod->src <>) ns))])
+                        deps)]
+         [levels (make-hash-table 'equal?)])
+    (dolist [s (order-files-by-dependency srcs)]
+      (and-let1 ds (assoc-ref src-deps s)
+        (hash-table-put! levels s
+                         (fold (^[d m] (max m (+ (hash-table-get levels d -1) 1)))
+                               0 ds))))
+    (let* ([nlevels (+ (hash-table-fold levels (^[_ l m] (max l m)) -1) 1)]
+           [level-of (^s (hash-table-get levels s nlevels))])
+      (values (map (^l (filter (^s (= (level-of s) l)) srcs))
+                   (iota (+ nlevels 1)))
+              src-deps))))
+
+;; Returns the sources that need to be precompiled, i.e. those whose
+;; outputs are missing or older than the source, and those that depend
+;; on such sources.
+(define (outdated-files waves src-deps prefix)
+  (define (outputs src)
+    (cons (multi-output-cfile src prefix)
+          (if (check-first-form-is-define-module src)
+            (list (strip-prefix (path-swap-extension src "sci") prefix))
+            '())))
+  (define (stale? src)
+    (any (^o (not (and (file-exists? o) (file-mtime>? o src)))) (outputs src)))
+  (fold (^[wave outdated]
+          (append outdated
+                  (filter (^s (or (stale? s)
+                                  (if-let1 ds (assoc-ref src-deps s)
+                                    (any (cut member <> outdated) ds)
+                                    (pair? outdated))))
+                          wave)))
+        '() waves))
+
 ;; Removes *.sci files before start compiling so that the old file
 ;; won't interfere with compilation.
 (define (clean-output-files scms prefix)
@@ -0,0 +1,136 @@
+;;;
+;;; gauche.cgen.runtime - compile stubs at runtime
+;;;
+;;;   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+
+;; *EXPERIMENTAL*
+;; Compile stub forms (define-cproc etc., whose bodies are CiSE) with
+;; the C compiler Gauche is configured with, and load the result as a DSO.
+;; The DSO is cached by the hash of the forms, so the compiler runs
+;; only when the forms are changed.  It's handy to write small C kernels
+;; without setting up an extension package.
+;;
+;;   (use gauche.cgen.runtime)
+;;   (define-cproc/runtime dot (x::<f64vector> y::<f64vector>) ::<double>
+;;     (let* ([s::double 0.0])
+;;       (dotimes [i (SCM_F64VECTOR_SIZE x)]
+;;         (+= s (* (aref (SCM_F64VECTOR_ELEMENTS x) i)
+;;                  (aref (SCM_F64VECTOR_ELEMENTS y) i))))
+;;       (return s)))
+
+(define-module gauche.cgen.runtime
+  (use gauche.cgen)
+  (use gauche.cgen.stub)
+  (use gauche.package.compile)
+  (use gauche.config)
+  (use gauche.parameter)
+  (use file.util)
+  (export runtime-stub define-cproc/runtime compile-runtime-stub
+          runtime-stub-cache-directory))
+(select-module gauche.cgen.runtime)
+
+;; Where the compiled DSOs are kept.
+(define runtime-stub-cache-directory
+  (make-parameter
+   (or (sys-getenv "GAUCHE_RUNTIME_STUB_CACHE")
+       (build-path (or (sys-getenv "XDG_CACHE_HOME")
+                       (build-path (home-directory) ".cache"))
+                   "gauche" "runtime-stub"))))
+
+;; (runtime-stub <stub-form> ...)
+;;  Compiles and loads stub forms, such as define-cproc, define-cfn
+;;  and C declarations in strings, into the current module.
+(define-syntax runtime-stub
+  (er-macro-transformer
+   (^[f r c]
+     `(,(r 'compile-runtime-stub) ',(cdr f) (,(r 'current-module))))))
+
+;; (define-cproc/runtime name (arg ...) [::rettype] body ...)
+(define-syntax define-cproc/runtime
+  (er-macro-transformer
+   (^[f r c]
+     `(,(r 'compile-runtime-stub) '((define-cproc ,@(cdr f)))
+                                  (,(r 'current-module))))))
+
+;; Compiles FORMS, a list of stub forms, and loads the result into
+;; MODULE.  Returns the path of the DSO.
+(define (compile-runtime-stub forms module)
+  (let* ([modname (or (module-name module)
+                      (error "can't compile runtime stub into an anonymous \
+                              module:" module))]
+         [forms (unwrap-syntax forms)]
+         ;; The DSO depends on the version of Gauche, as well as the forms.
+         [key (write-to-string (list (gauche-version) modname forms))]
+         [name (format "rtstub_~8,'0x~8,'0x"
+                       (portable-hash key 0) (portable-hash key 1))]
+         [dir (runtime-stub-cache-directory)]
+         [sofile (build-path dir #"~|name|.~(gauche-config \"--so-suffix\")")]
+         [keyfile (build-path dir #"~|name|.key")])
+    ;; The key file guards against a hash collision.
+    (unless (and (file-exists? sofile)
+                 (equal? (file->string keyfile :if-does-not-exist #f) key))
+      (build-dso dir name modname forms sofile)
+      (with-output-to-file keyfile (cut display key)))
+    (dynamic-load sofile)
+    sofile))
+
+;; We build in a private directory and rename the DSO into place,
+;; so that concurrent processes compiling the same forms won't step
+;; on each other.
+(define (build-dso dir name modname forms sofile)
+  (let* ([work (build-path dir #"~|name|.~(sys-getpid)")]
+         [stubfile (build-path work #"~|name|_stub.stub")]
+         [ofile (build-path work #"~|name|.~(gauche-config \"--object-suffix\")")]
+         [tmpso (build-path work (sys-basename sofile))])
+    (make-directory* work)
+    (unwind-protect
+        (begin
+          (with-output-to-file stubfile
+            (^[] (for-each (^x (write x) (newline))
+                           (stub-prologue name modname))
+                 (for-each (^x (write x) (newline)) forms)))
+          (gauche-package-compile stubfile :output ofile)
+          (gauche-package-link tmpso (list ofile))
+          (sys-rename tmpso sofile))
+      (remove-directory* work))))
+
+;; The initial strings in a stub file go to the declaration part.
+;; The init function genstub generates takes the module, so we give
+;; dynamic-load a wrapper, which is named after the DSO.
+(define (stub-prologue name modname)
+  `("#include <gauche/extend.h>"
+    ,#"void Scm_Init_~|name|_stub(ScmModule*);"
+    ,#"void Scm_Init_~|name|(void)\
+       {\
+         SCM_INIT_EXTENSION(~|name|);\
+         Scm_Init_~|name|_stub(SCM_FIND_MODULE(~(cgen-safe-string (symbol->string modname)), SCM_FIND_MODULE_CREATE));\
+       }"))
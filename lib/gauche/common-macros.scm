@@ -438,12 +438,11 @@
 (define-syntax guard
   (syntax-rules ()
     [(guard (var . clauses) . body)
-     (with-error-handler
-         (lambda (e)
-           (let ((var e))
-             (%guard-rec var e . clauses)))
-       (lambda () . body)
-       :rewind-before #t)]))
+     (%with-guard-handler
+      (lambda (e)
+        (let ((var e))
+          (%guard-rec var e . clauses)))
+      (lambda () . body))]))
 
 (define-syntax %guard-rec
   (syntax-rules (else =>)
@@ -38,15 +38,19 @@
   (use srfi-13)
   (use gauche.fcntl)
   (use gauche.parameter)
-  (export <log-drain>
+  (export <log-drain> <async-log-drain>
           log-open
           log-format
-          log-default-drain)
+          log-default-drain
+          log-drain-flush log-drain-close log-drain-dropped)
   )
 (select-module gauche.logger)
 
 (autoload gauche.syslog sys-openlog sys-syslog LOG_PID LOG_INFO LOG_USER)
 (autoload file.util file-mtime<?)
+(autoload gauche.threads make-thread thread-start! thread-join!
+                         atom atom-ref atomic-update!)
+(autoload data.queue make-mtqueue enqueue! enqueue/wait! dequeue/wait!)
 
 ;; <log-drain> class
 (define-class <log-drain> ()
@@ -232,19 +236,159 @@
 (define-method log-format ((fmtstr <string>) . args)
   (apply log-format (log-default-drain) fmtstr args))
 
+(define (log-message drain fmt args)
+  (let1 prefix (log-get-prefix drain)
+    ($ string-concatenate
+       $ fold-right (^[data rest]
+                      (if (and (null? rest) (string-null? data))
+                        '()          ;ignore trailing newlines
+                        (list* prefix data "\n" rest)))
+                    '()
+       $ string-split (apply format #f fmt args) #\newline)))
+
 (define-method log-format ((drain <log-drain>) fmt . args)
-  (let* ([prefix (log-get-prefix drain)]
-         [str ($ string-concatenate
-                 $ fold-right (^[data rest]
-                                (if (and (null? rest) (string-null? data))
-                                  '()          ;ignore trailing newlines
-                                  (list* prefix data "\n" rest)))
-                              '()
-                 $ string-split (apply format #f fmt args) #\newline)])
+  (let1 str (log-message drain fmt args)
     (with-log-output drain (^p (display str p)))))
 
-;; log-open path &keyword :program-name :prefix
+;; log-open path &keyword :program-name :prefix :async ...
+;;   If :async is true, an <async-log-drain> is created, and the
+;;   rest of the keyword arguments are passed to it.
 
 (define (log-open path . args)
-  (log-default-drain (apply make <log-drain> :path path args)))
+  (log-default-drain
+   (apply make (if (get-keyword :async args #f) <async-log-drain> <log-drain>)
+          :path path (delete-keyword :async args))))
+
+;;
+;; Asynchronous drain
+;;
+;;   Messages are formatted in the caller's thread and queued to a
+;;   background writer thread.  The writer keeps the log file open in
+;;   append mode and writes out messages in a batch, when the buffered
+;;   messages reach FLUSH-SIZE bytes, or FLUSH-INTERVAL seconds have passed
+;;   since the oldest buffered message was queued.  The file lock is taken
+;;   once per batch.  If the file is moved away (e.g. by log rotation),
+;;   the writer reopens the path before the next batch.
+;;
+;;   When QUEUE-SIZE messages are pending, log-format waits for the room
+;;   if OVERFLOW is 'block, or discards the message if it is 'drop.
+;;   The number of discarded messages is kept in DROPPED.
+;;
+;;   Pending messages are written only by the writer thread, so call
+;;   log-drain-close before the program exits.  After closing, log-format
+;;   to the drain writes synchronously like <log-drain>.
+
+(define-class <async-log-drain> (<log-drain>)
+  ((queue-size     :init-keyword :queue-size :initform 10000)
+   (overflow       :init-keyword :overflow :initform 'block)
+   (flush-size     :init-keyword :flush-size :initform 65536)
+   (flush-interval :init-keyword :flush-interval :initform 1)
+   (%queue   :initform #f)
+   (%thread  :initform #f)
+   (%port    :initform #f)
+   (%dropped :initform #f)))
+
+(define-method initialize ((self <async-log-drain>) initargs)
+  (next-method)
+  (let ([path (slot-ref self 'path)]
+        [qsize (slot-ref self 'queue-size)])
+    (unless (or (string? path) (eq? path #t) (eq? path 'syslog))
+      (error "async log drain needs a file path, #t or syslog, but got:"
+             path))
+    (unless (memq (slot-ref self 'overflow) '(block drop))
+      (error "overflow must be either block or drop, but got:"
+             (slot-ref self 'overflow)))
+    (unless (and (exact-integer? qsize) (> qsize 0))
+      (error "queue-size must be a positive exact integer, but got:" qsize))
+    (slot-set! self '%dropped (atom 0))
+    (slot-set! self '%queue (make-mtqueue :max-length qsize))
+    (slot-set! self '%thread
+               (thread-start! (make-thread (cut async-log-writer self)
+                                           'log-writer)))))
+
+(define-method log-format ((drain <async-log-drain>) fmt . args)
+  (let ([q (slot-ref drain '%queue)]
+        [str (log-message drain fmt args)])
+    (cond [(not q) (with-log-output drain (^p (display str p)))]
+          [(eq? (slot-ref drain 'overflow) 'block) (enqueue/wait! q str)]
+          [(enqueue/wait! q str 0 #f)]
+          [else (atomic-update! (slot-ref drain '%dropped) (cut + <> 1))])
+    (undefined)))
+
+;; Waits until all the messages queued so far are written out.
+(define (log-drain-flush drain)
+  (async-log-request drain 'flush))
+
+;; Writes out the pending messages, and stops the writer thread.
+(define (log-drain-close drain)
+  (when (slot-ref drain '%queue)
+    (async-log-request drain 'close)
+    (thread-join! (slot-ref drain '%thread))
+    (slot-set! drain '%queue #f)
+    (slot-set! drain '%thread #f)))
+
+(define (log-drain-dropped drain)
+  (atom-ref (slot-ref drain '%dropped)))
+
+(define (async-log-request drain req)
+  (and-let1 q (slot-ref drain '%queue)
+    (let1 reply (make-mtqueue :max-length 1)
+      (enqueue/wait! q (cons req reply))
+      (dequeue/wait! reply))))
+
+;; Runs in the writer thread.
+(define (async-log-writer drain)
+  (define q (slot-ref drain '%queue))
+  (define flush-size (slot-ref drain 'flush-size))
+  (define interval (slot-ref drain 'flush-interval))
+  (define timeout (list 'timeout))
+  (define (now) (time->seconds (current-time)))
+  (define (write-out! msgs)             ;msgs are in reverse order
+    (unless (null? msgs)
+      (guard (e [else (atomic-update! (slot-ref drain '%dropped)
+                                      (cut + <> (length msgs)))])
+        (if (string? (slot-ref drain 'path))
+          (async-log-write-file drain (string-concatenate-reverse msgs))
+          (dolist [m (reverse msgs)]
+            (with-log-output drain (^p (display m p))))))))
+  (let loop ([msgs '()] [bytes 0] [deadline #f])
+    (let1 m (if deadline
+              (dequeue/wait! q (max 0 (- deadline (now))) timeout)
+              (dequeue/wait! q))
+      (cond [(string? m)
+             (let ([msgs (cons m msgs)]
+                   [bytes (+ bytes (string-size m))])
+               (if (>= bytes flush-size)
+                 (begin (write-out! msgs) (loop '() 0 #f))
+                 (loop msgs bytes (or deadline (+ (now) interval)))))]
+            [(eq? m timeout) (write-out! msgs) (loop '() 0 #f)]
+            [(eq? (car m) 'flush)
+             (write-out! msgs)
+             (enqueue! (cdr m) #t)
+             (loop '() 0 #f)]
+            [else                       ;close
+             (write-out! msgs)
+             (and-let1 p (slot-ref drain '%port)
+               (close-output-port p)
+               (slot-set! drain '%port #f))
+             (enqueue! (cdr m) #t)]))))
+
+(define (async-log-write-file drain str)
+  (define path (slot-ref drain 'path))
+  (define (same-file? p)
+    (and-let* ([st (guard (e [(<system-error> e) #f]) (sys-stat path))]
+               [fst (sys-fstat p)])
+      (and (eqv? (slot-ref st 'dev) (slot-ref fst 'dev))
+           (eqv? (slot-ref st 'ino) (slot-ref fst 'ino)))))
+  (let1 p (slot-ref drain '%port)
+    (when (and p (not (same-file? p)))
+      (close-output-port p)
+      (set! p #f))
+    (unless p
+      (set! p (open-output-file path :if-exists :append))
+      (slot-set! drain '%port p))
+    (let1 l (lock-data drain p)
+      (lock-file drain p l)
+      (unwind-protect (begin (display str p) (flush p))
+        (unlock-file drain p l)))))
 
@@ -106,10 +106,19 @@
                   (begin (write-block buf dst 0 nr)
                          (loop (+ count nr))))))))))))
 
+;; If both ports are file ports, we let the kernel copy the bytes
+;; between file descriptors.  Returns #f if that isn't possible.
+(define (%copy-port-fd src dst size)
+  (if (and (integer? size) (not (negative? size)))
+    (and (fixnum? size) (%port-copy-fd src dst size))
+    (%port-copy-fd src dst -1)))
+
 (define (copy-port src dst :key (unit 4096) (size -1))
   (check-arg input-port? src)
   (check-arg output-port? dst)
-  (cond [(eq? unit 'byte)
+  (cond [(and (or (eq? unit 'byte) (integer? unit))
+              (%copy-port-fd src dst size))]
+        [(eq? unit 'byte)
          (if (and (integer? size) (not (negative? size)))
            (%do-copy/limit1 (read-byte src) (write-byte data dst) size)
            (%do-copy (read-byte src) (write-byte data dst) (+ count 1)))]
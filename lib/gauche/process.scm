@@ -48,6 +48,8 @@
           process-send-signal process-kill process-stop process-continue
           process-list
           run-process-pipeline do-process-pipeline
+          <pipeline> run-pipeline pipeline? pipeline-processes
+          pipeline-input pipeline-output pipeline-wait pipeline-status
           ;; process ports
           open-input-process-port   open-output-process-port
           call-with-input-process   call-with-output-process
@@ -530,6 +532,65 @@
     (when eflag (for-each %check-normal-exit ps))
     (every (^p (zero? (process-exit-status p))) ps)))
 
+;; The pipeline object
+;;   run-pipeline is like run-process-pipeline, but returns a <pipeline>
+;;   object, which allows to wait on the whole pipeline and to examine
+;;   the status of each stage.  Stages are connected directly by the
+;;   pipes given to the child processes, and the parent closes both
+;;   ends of each pipe as soon as the connected stages are spawned, so
+;;   the data never goes through this process.
+(define-class <pipeline> ()
+  ((processes :init-keyword :processes :getter pipeline-processes)))
+
+(define-method write-object ((p <pipeline>) port)
+  (format port "#<pipeline ~a>"
+          (map (^p (process-pid p)) (pipeline-processes p))))
+
+(define (pipeline? obj) (is-a? obj <pipeline>))
+
+(define (run-pipeline commands
+                      :key (input #f) (output #f) (error #f)
+                      (wait #f)
+                      (sigmask #f) (directory #f)
+                      (detached #f))
+  (when (null? commands)
+    (error "At least one command is required to run-pipeline"))
+  (and-let1 offending (any (^c (and (not (pair? c)) (list c))) commands)
+    (errorf "Command list contains non-list command line '~s': ~s"
+            (car offending) commands))
+  (define (spawn cmdline in out)
+    (run-process cmdline :input in :output out :error error
+                 :sigmask sigmask :directory directory :detached detached))
+  ;; IN is the read end of the pipe from the previous stage, or the
+  ;; INPUT argument for the first stage.
+  (define (close-in in)
+    (unless (eq? in input) (close-input-port in)))
+  (let loop ([cmds commands] [in input] [ps '()])
+    (if (null? (cdr cmds))
+      (let1 p (unwind-protect (spawn (car cmds) in output) (close-in in))
+        (rlet1 pl (make <pipeline> :processes (reverse (cons p ps)))
+          (when (and wait (not detached)) (pipeline-wait pl))))
+      (receive (pin pout) (sys-pipe)
+        (let1 p (unwind-protect (spawn (car cmds) in pout)
+                  (close-output-port pout)
+                  (close-in in))
+          (loop (cdr cmds) pin (cons p ps)))))))
+
+;; Returns the port connected to the stdin of the first stage, or
+;; the stdout of the last stage, when :pipe is given to run-pipeline.
+(define (pipeline-input pl) (process-input (car (pipeline-processes pl))))
+(define (pipeline-output pl) (process-output (last (pipeline-processes pl))))
+
+;; Waits all the stages, and returns the list of their exit statuses.
+(define (pipeline-wait pl)
+  (for-each process-wait (pipeline-processes pl))
+  (pipeline-status pl))
+
+;; Returns the list of exit statuses of the stages; #f for the stage
+;; that hasn't been waited.
+(define (pipeline-status pl)
+  (map process-exit-status (pipeline-processes pl)))
+
 ;;===================================================================
 ;; Process ports
 ;;
@@ -32,6 +32,21 @@
 ;;;
 
 
+;; The selector uses one of the following backends to wait for the
+;; events.
+;;
+;;  select - Uses sys-select.  Every call of selector-select passes
+;;           the whole fd sets to the kernel.  Available on all platforms
+;;           that support sys-select, and it is the default.
+;;  poller - Uses <sys-poller> (epoll, kqueue or IOCP), in which fds are
+;;           registered in the kernel.  The cost of selector-select is
+;;           proportional to the number of ready fds, and there's no
+;;           limit of FD_SETSIZE.
+;;  auto   - Uses poller if available, select otherwise.
+;;
+;; With the poller backend, we keep the handlers in a hashtable keyed by
+;; fd, instead of the lists of (port-or-fd . proc).
+
 (define-module gauche.selector
   (use srfi-1)
   (export <selector> selector-add! selector-delete! selector-select)
@@ -45,8 +60,37 @@
    (rhandlers :init-form '())  ; list of (port-or-fd . proc)
    (whandlers :init-form '())  ; ditto
    (xhandlers :init-form '())  ; ditto
+   (backend :init-keyword :backend :init-value 'select)
+   (trigger :init-keyword :trigger :init-value 'level) ; level or edge
+   (poller :init-form #f)      ; <sys-poller> if backend is poller
+   (fd-handlers :init-form #f) ; fd -> list of (flag port-or-fd . proc)
   ))
 
+(define (%make-poller)
+  (cond-expand
+   [gauche.sys.poller (make-sys-poller)]
+   [else (error "poller backend isn't supported on this platform")]))
+
+(define-method initialize ((selector <selector>) initargs)
+  (next-method)
+  (let1 backend (case (slot-ref selector 'backend)
+                  [(select) 'select]
+                  [(poller) 'poller]
+                  [(auto) (cond-expand [gauche.sys.poller 'poller]
+                                       [else 'select])]
+                  [else (errorf "invalid backend ~s, must be select, poller \
+                                 or auto" (slot-ref selector 'backend))])
+    (unless (memq (slot-ref selector 'trigger) '(level edge))
+      (errorf "invalid trigger ~s, must be level or edge"
+              (slot-ref selector 'trigger)))
+    (when (and (eq? backend 'select)
+               (eq? (slot-ref selector 'trigger) 'edge))
+      (error "edge trigger requires the poller backend"))
+    (slot-set! selector 'backend backend)
+    (when (eq? backend 'poller)
+      (slot-set! selector 'poller (%make-poller))
+      (slot-set! selector 'fd-handlers (make-hash-table 'eqv?)))))
+
 (define (canon-flag flag)
   (case flag
     [(r read) 'r]
@@ -62,47 +106,100 @@
   (case flag
     [(r) 'rhandlers] [(w) 'whandlers] [(x) 'xhandlers]))
 
+(define (poller? selector) (eq? (slot-ref selector 'backend) 'poller))
+
+(define (port-or-fd->fd port-or-fd)
+  (if (integer? port-or-fd)
+    port-or-fd
+    (or (port-file-number port-or-fd)
+        (errorf "port ~s doesn't have a file descriptor" port-or-fd))))
+
+;; Sets the handler list of FD, and tells the kernel which events to wait.
+(define (poller-update! selector fd entries)
+  (let ([tab (slot-ref selector 'fd-handlers)]
+        [flags (delete-duplicates (map car entries))])
+    (if (null? entries)
+      (hash-table-delete! tab fd)
+      (hash-table-put! tab fd entries))
+    (sys-poller-set! (slot-ref selector 'poller) fd
+                     (if (and (pair? flags)
+                              (eq? (slot-ref selector 'trigger) 'edge))
+                       (cons 'edge flags)
+                       flags))))
+
 (define-method selector-add! ((selector <selector>) port-or-fd proc flags)
   (check-arg procedure? proc)
   (check-arg list? flags)
-  (dolist [flag (map canon-flag flags)]
-    (let* ([slot (flag->fd-slot flag)]
-           [fds (or (slot-ref selector slot)
-                    (rlet1 f (make <sys-fdset>)
-                      (slot-set! selector slot f)))])
-      (set! (sys-fdset-ref fds port-or-fd) #t))
-    (slot-push! selector (flag->handler-slot flag) (cons port-or-fd proc))))
+  (if (poller? selector)
+    (let* ([fd (port-or-fd->fd port-or-fd)]
+           [entries (hash-table-get (slot-ref selector 'fd-handlers) fd '())])
+      (poller-update! selector fd
+                      (fold (^[flag es]
+                              (acons flag (cons port-or-fd proc)
+                                     (remove (^e (and (eq? (car e) flag)
+                                                      (equal? (cadr e)
+                                                              port-or-fd)))
+                                             es)))
+                            entries (map canon-flag flags))))
+    (dolist [flag (map canon-flag flags)]
+      (let* ([slot (flag->fd-slot flag)]
+             [fds (or (slot-ref selector slot)
+                      (rlet1 f (make <sys-fdset>)
+                        (slot-set! selector slot f)))])
+        (set! (sys-fdset-ref fds port-or-fd) #t))
+      (slot-push! selector (flag->handler-slot flag) (cons port-or-fd proc)))))
 
 (define-method selector-delete! ((selector <selector>) port-or-fd proc flags)
   (let1 flags (if flags (map canon-flag flags) '(r w x))
-    (for-each (^[fds handlers]
-                (cond
-                 [port-or-fd
-                  (if-let1 p (assoc port-or-fd (slot-ref selector handlers))
-                    (when (or (not proc) (eq? proc (cdr p)))
-                      (slot-set! selector handlers
-                                 (delete p (slot-ref selector handlers)))
-                      (if-let1 fds (slot-ref selector fds)
-                        (sys-fdset-set! fds port-or-fd #f))))]
-                 [proc
-                  (let loop ([h (slot-ref selector handlers)]
-                             [newh '()])
-                    (cond [(null? h)
-                           (slot-set! selector handlers (reverse newh))]
-                          [(eq? proc (cdar h))
-                           (if-let1 fds (slot-ref selector fds)
-                             (sys-fdset-set! fds (caar h) #f))
-                           (loop (cdr h) newh)]
-                          [else
-                           (loop (cdr h) (cons (car h) newh))]))]
-                 [else
-                  (slot-set! selector fds #f)
-                  (slot-set! selector handlers '())]))
-              (map flag->fd-slot flags)
-              (map flag->handler-slot flags))))
+    (if (poller? selector)
+      (poller-delete! selector port-or-fd proc flags)
+      (for-each (^[fds handlers]
+                  (cond
+                   [port-or-fd
+                    (if-let1 p (assoc port-or-fd (slot-ref selector handlers))
+                      (when (or (not proc) (eq? proc (cdr p)))
+                        (slot-set! selector handlers
+                                   (delete p (slot-ref selector handlers)))
+                        (if-let1 fds (slot-ref selector fds)
+                          (sys-fdset-set! fds port-or-fd #f))))]
+                   [proc
+                    (let loop ([h (slot-ref selector handlers)]
+                               [newh '()])
+                      (cond [(null? h)
+                             (slot-set! selector handlers (reverse newh))]
+                            [(eq? proc (cdar h))
+                             (if-let1 fds (slot-ref selector fds)
+                               (sys-fdset-set! fds (caar h) #f))
+                             (loop (cdr h) newh)]
+                            [else
+                             (loop (cdr h) (cons (car h) newh))]))]
+                   [else
+                    (slot-set! selector fds #f)
+                    (slot-set! selector handlers '())]))
+                (map flag->fd-slot flags)
+                (map flag->handler-slot flags)))))
+
+(define (poller-delete! selector port-or-fd proc flags)
+  (define (drop? e)                     ; e : (flag port-or-fd . proc)
+    (and (memq (car e) flags)
+         (or (not port-or-fd) (equal? port-or-fd (cadr e)))
+         (or (not proc) (eq? proc (cddr e)))))
+  (define (update! fd entries)
+    (let1 es (remove drop? entries)
+      (unless (= (length es) (length entries))
+        (poller-update! selector fd es))))
+  (if port-or-fd
+    (let1 fd (port-or-fd->fd port-or-fd)
+      (update! fd (hash-table-get (slot-ref selector 'fd-handlers) fd '())))
+    (dolist [p (hash-table->alist (slot-ref selector 'fd-handlers))]
+      (update! (car p) (cdr p)))))
 
 (define-method selector-select ((selector <selector>) :optional (timeout #f))
+  (if (poller? selector)
+    (poller-select selector timeout)
+    (fdset-select selector timeout)))
 
+(define (fdset-select selector timeout)
   (define (pick-handlers fds handlers flag)
     (fold (^[entry tail]
             (let1 fd (car entry)
@@ -124,3 +221,18 @@
                  (pick-handlers wfds (slot-ref selector 'whandlers) 'w)
                  (pick-handlers xfds (slot-ref selector 'xhandlers) 'x))))
     nfds))
+
+(define (poller-select selector timeout)
+  (let* ([events (sys-poller-wait (slot-ref selector 'poller) timeout)]
+         [tab (slot-ref selector 'fd-handlers)]
+         [calls (append-map
+                 (^[ev]                 ; ev : (fd flag ...)
+                   (filter-map (^e (and (memq (car e) (cdr ev))
+                                        (list (cddr e) (cadr e) (car e))))
+                               (hash-table-get tab (car ev) '())))
+                 events)])
+    ;; Call the handlers in the same order as the select backend.
+    (dolist [flag '(r w x)]
+      (dolist [h calls]
+        (when (eq? (caddr h) flag) (apply (car h) (cdr h)))))
+    (length events)))
@@ -25,6 +25,43 @@
 
 (define %sort  (with-module gauche.internal %sort))
 (define %sort! (with-module gauche.internal %sort!))
+(define %sort-by-keys! (with-module gauche.internal %sort-by-keys!))
+
+;; Sorting uvectors, and sorting by keys with the default ordering, are
+;; done in C (radix sort for numbers) and don't call back to Scheme
+;; except to compute keys.
+(define (key-vector key vec)
+  (let* ([n (vector-length vec)]
+         [keys (make-vector n)])
+    (do ([i 0 (+ i 1)])
+        [(= i n) keys]
+      (vector-set! keys i (key (vector-ref vec i))))))
+
+;; A comparator whose comparison procedure is the builtin compare orders
+;; objects just like the default, so we can sort with it in C, after
+;; checking the types of the objects (a list or a vector).
+(define (builtin-order? cmp)
+  (or (not cmp)
+      (and (comparator? cmp)
+           ((with-module gauche.internal comparator-builtin-compare?) cmp))))
+
+(define (check-types cmp objs)
+  (when (and cmp
+             (not (eq? (comparator-type-test-predicate cmp)
+                       (with-module gauche.internal default-type-test))))
+    ((if (vector? objs) vector-for-each for-each)
+     (cut comparator-check-type cmp <>) objs)))
+
+;; Stably sorts a list or a vector in place by the builtin compare.
+(define (sort-by-self! seq)
+  (if (vector? seq)
+    (begin (%sort-by-keys! seq (vector-copy seq)) seq)
+    (let1 v (list->vector seq)
+      (%sort-by-keys! v (vector-copy v))
+      (do ([lis seq (cdr lis)]
+           [i 0 (+ i 1)])
+          [(null? lis) seq]
+        (set-car! lis (vector-ref v i))))))
 
 (define-syntax define-less?
   (syntax-rules ()
@@ -138,7 +175,7 @@
 ;;; adapted it to work destructively in Scheme.
 
 (define (sort! seq . args)
-  (if (and (or (pair? seq) (vector? seq)) (null? args))
+  (if (and (or (pair? seq) (vector? seq) (uvector? seq)) (null? args))
     (%sort! seq)                  ; use internal version
     (apply stable-sort! seq args)))
 
@@ -165,6 +202,9 @@
                                         p)]
                              [else '()]))])
       (cond [(null? seq) seq]
+            [(and (or (pair? seq) (vector? seq)) (builtin-order? cmp))
+             (check-types cmp seq)
+             (sort-by-self! seq)]
             [(pair? seq) (step (length seq))]
             [(vector? seq)
              (let ([n (vector-length seq)]
@@ -174,12 +214,26 @@
                     [i 0 (+ i 1)])
                    [(null? p) vector]
                  (vector-set! vector i (car p))))]
+            [(and (uvector? seq) (not cmp)) (%sort! seq)]
             [(is-a? seq <sequence>) (%generic-sort! seq less?)]
             [else (error "sequence required, but got:" seq)]))
     ;; Avoid making intermediate structure, for the point of stable-sort!
     ;; is to avoid allocation.
     (letrec ([kless? (^[a b] (less? (cdr a) (cdr b)))])
       (cond [(null? seq) seq]
+            [(and (builtin-order? cmp) (vector? seq))
+             (let1 keys (key-vector key seq)
+               (check-types cmp keys)
+               (%sort-by-keys! seq keys))]
+            [(and (builtin-order? cmp) (pair? seq))
+             (let* ([v (list->vector seq)]
+                    [keys (key-vector key v)])
+               (check-types cmp keys)
+               (%sort-by-keys! v keys)
+               (do ([lis seq (cdr lis)]
+                    [i 0 (+ i 1)])
+                   [(null? lis) seq]
+                 (set-car! lis (vector-ref v i))))]
             [(pair? seq)
              (do ([spine seq (cdr spine)])
                  [(null? spine)]
@@ -216,13 +270,14 @@
   (define-less? less? cmp 'sort)
   (if (memq key `(,identity ,values))
     (cond [(null? seq) seq]
-          [(pair? seq) (stable-sort! (list-copy seq) less?)]
-          [(vector? seq) (list->vector (sort! (vector->list seq) less?))]
+          [(pair? seq) (stable-sort! (list-copy seq) cmp)]
+          [(vector? seq) (list->vector (sort! (vector->list seq) cmp))]
+          [(and (uvector? seq) (not cmp)) (%sort seq)]
           [(is-a? seq <sequence>) (%generic-sort seq less?)]
           [else (error "sequence required, but got:" seq)])
     (cond [(null? seq) seq]
-          [(pair? seq) (stable-sort! (list-copy seq) less? key)]
-          [(vector? seq) (stable-sort! (vector-copy seq) less? key)]
+          [(pair? seq) (stable-sort! (list-copy seq) cmp key)]
+          [(vector? seq) (stable-sort! (vector-copy seq) cmp key)]
           [(is-a? seq <sequence>) (%generic-sort seq less? key)]
           [else (error "sequence required, but got:" seq)])))
 
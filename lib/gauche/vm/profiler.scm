@@ -34,9 +34,13 @@
 (define-module gauche.vm.profiler
   (use srfi-13)
   (use util.match)
+  (use gauche.uvector)
   (extend gauche.internal)
   (export profiler-show profiler-get-result
-          profiler-show-load-stats with-profiler)
+          profiler-show-load-stats with-profiler
+          profiler-snapshot
+          profiler-export-folded profiler-export-pprof
+          profiler-alloc-snapshot)
   )
 (select-module gauche.vm.profiler)
 
@@ -54,6 +58,123 @@
     (hash-table-map r (^(k v) (cons (entry-name k) v)))
     #f))
 
+;;
+;; Returns the stack samples taken by the continuous sampler since the
+;; last call, as a list of ((<frame> <caller-frame> ...) . <count>),
+;; sorted by count.  The sampler keeps running.
+;; Each frame is a name of the code.  If source-info is true, each frame
+;; is (<name> . <location>), where <location> is (<file> <line>) or #f.
+;;
+(define (profiler-snapshot :key (all-threads #t) (source-info #f))
+  (define (frame f)
+    (if source-info
+      (cons (entry-name (car f))
+            (and-let* ([si (cdr f)]
+                       [loc (debug-source-info si)])
+              (list (car loc) (cadr loc))))
+      (entry-name (car f))))
+  ;; Different raw frames can map to the same frame representation;
+  ;; merge them.
+  (let1 ht (make-hash-table 'equal?)
+    (hash-table-for-each (profiler-raw-snapshot all-threads)
+                         (^(k v) (hash-table-update! ht (map frame k)
+                                                     (cut + v <>) 0)))
+    (sort-by (hash-table-map ht cons) cdr >)))
+
+;;
+;; Returns the allocation samples taken since the last call, as a list of
+;; (<kind> <name> <location> <samples> <bytes>), sorted by bytes.
+;; <kind> is one of pair, string, flonum, vector, closure or other.
+;; <bytes> is an estimate: the number of sampled intervals times the
+;; interval given to profiler-alloc-start.  The sampler keeps running.
+;;
+(define (profiler-alloc-snapshot :key (all-threads #t))
+  (define kinds '#(other pair string flonum vector closure))
+  (define (loc si)
+    (and-let* ([si]
+               [l (debug-source-info si)])
+      (list (car l) (cadr l))))
+  (let1 ht (make-hash-table 'equal?)
+    (hash-table-for-each
+     (profiler-raw-alloc-snapshot all-threads)
+     (^(k v)
+       (match-let1 (kind code . si) k
+         (hash-table-update! ht (list (vector-ref kinds kind)
+                                      (if code (entry-name code) 'toplevel)
+                                      (loc si))
+                             (^p (cons (+ (car p) (car v))
+                                       (+ (cdr p) (cdr v))))
+                             '(0 . 0)))))
+    (sort-by (hash-table-map ht (^(k v) `(,@k ,(car v) ,(cdr v))))
+             (cut list-ref <> 4) >)))
+
+;;
+;; Exporters.  SAMPLES must be a result of
+;; (profiler-snapshot :source-info #t).
+;;
+
+;; Folded stack format, as read by flamegraph.pl: one line per stack,
+;; frames from outermost to innermost separated by ';', followed by
+;; the count.
+(define (profiler-export-folded samples :optional (port (current-output-port)))
+  (dolist [s samples]
+    (display (string-join (map folded-label (reverse (car s))) ";") port)
+    (format port " ~d\n" (cdr s))))
+
+;; pprof profile.proto format (uncompressed).
+(define (profiler-export-pprof samples :optional (port (current-output-port)))
+  (let ([strings (make-hash-table 'equal?)]
+        [funcs (make-hash-table 'equal?)]
+        [locs (make-hash-table 'equal?)]
+        [rstrings '()] [rfuncs '()] [rlocs '()])
+    (define (str s)
+      (or (hash-table-get strings s #f)
+          (rlet1 id (hash-table-num-entries strings)
+            (hash-table-put! strings s id)
+            (push! rstrings s))))
+    ;; function key: (label . file)
+    (define (func label file)
+      (let1 key (cons label file)
+        (or (hash-table-get funcs key #f)
+            (rlet1 id (+ (hash-table-num-entries funcs) 1)
+              (hash-table-put! funcs key id)
+              (push! rfuncs
+                     (append (pb-int 1 id)
+                             (pb-int 2 (str label))
+                             (pb-int 3 (str label))
+                             (pb-int 4 (str (or file "")))))))))
+    (define (loc frame)
+      (let* ([label (frame-label frame)]
+             [file (and (cdr frame) (x->string (car (cdr frame))))]
+             [line (or (and (cdr frame) (cadr (cdr frame))) 0)]
+             [fid (func label file)]
+             [key (cons fid line)])
+        (or (hash-table-get locs key #f)
+            (rlet1 id (+ (hash-table-num-entries locs) 1)
+              (hash-table-put! locs key id)
+              (push! rlocs
+                     (append (pb-int 1 id)
+                             (pb-bytes 4 (append (pb-int 1 fid)
+                                                 (pb-int 2 line)))))))))
+    (str "")
+    (let* ([sample-type (append (pb-int 1 (str "samples"))
+                                (pb-int 2 (str "count")))]
+           [cpu-type (append (pb-int 1 (str "cpu"))
+                             (pb-int 2 (str "nanoseconds")))]
+           [ss (map (^s (append (pb-packed 1 (map loc (car s)))
+                                (pb-packed 2 (list (cdr s)
+                                                   (* (cdr s) 10000000)))))
+                    samples)]
+           [body (append (pb-bytes 1 sample-type)
+                         (pb-bytes 1 cpu-type)
+                         (append-map (cut pb-bytes 2 <>) ss)
+                         (append-map (cut pb-bytes 4 <>) (reverse rlocs))
+                         (append-map (cut pb-bytes 5 <>) (reverse rfuncs))
+                         (append-map (cut pb-string 6 <>) (reverse rstrings))
+                         (pb-bytes 11 cpu-type)
+                         (pb-int 12 10000000))])
+      (write-uvector (list->u8vector body) port))))
+
 ;;
 ;; Show the profiler result.
 ;;
@@ -178,6 +299,37 @@
         (receive (q r) (quotient&remainder val 10000)
           (format "~2d.~4,'0d" q r))))))
 
+;; A frame of profiler-snapshot :source-info #t, as a string.
+(define (frame-label frame)
+  (let1 name (car frame)
+    (regexp-replace-all #/[; ]/ (if (symbol? name)
+                                  (symbol->string name)
+                                  (write-to-string name))
+                        "_")))
+
+(define (folded-label frame)
+  (match (cdr frame)
+    [(file line) (format "~a[~a:~a]" (frame-label frame)
+                         (regexp-replace-all #/[; ]/ (x->string file) "_")
+                         line)]
+    [_ (frame-label frame)]))
+
+;; Protocol buffer encoding.  Each procedure returns a list of octets.
+(define (pb-varint n)
+  (if (< n 128)
+    (list n)
+    (cons (logior (logand n #x7f) #x80) (pb-varint (ash n -7)))))
+(define (pb-int field n)
+  (append (pb-varint (ash field 3)) (pb-varint n)))
+(define (pb-bytes field octets)
+  (append (pb-varint (logior (ash field 3) 2))
+          (pb-varint (length octets))
+          octets))
+(define (pb-string field s)
+  (pb-bytes field (u8vector->list (string->u8vector s))))
+(define (pb-packed field ns)
+  (pb-bytes field (append-map pb-varint ns)))
+
 ;; Return a 'printable' notation of sampled code location
 (define (entry-name obj)
   (cond
@@ -54,10 +54,13 @@
   (use gauche.charconv)
   (use gauche.sequence)
   (use gauche.uvector)
+  (use gauche.threads)
   (use util.match)
   (use text.tree)
   (export <http-error>
           http-user-agent make-http-connection reset-http-connection
+          http-connection-pool make-http-connection-pool
+          http-connection-pool-shutdown!
           http-compose-query http-compose-form-data
           http-status-code->description
 
@@ -93,6 +96,11 @@
 
 (define-condition-type <http-error> <error> #f)
 
+;; Raised when the server closes the connection without replying.  On a
+;; reused connection it usually means the server has timed it out, so
+;; we retry the request on a new connection.
+(define-condition-type <http-no-reply-error> <http-error> #f)
+
 ;;==============================================================
 ;; Global parameters
 ;;
@@ -251,7 +259,8 @@
 
   ;; final touch of request headers
   (define (req-headers host)
-    (cond-list [(~ conn'persistent) @ (if (~ conn'proxy)
+    (cond-list [(or (~ conn'persistent) (http-connection-pool))
+                @ (if (~ conn'proxy)
                                         '(:proxy-connection keep-alive)
                                         '(:connection keep-alive))]
                [#t @ `(:host ,host :user-agent ,user-agent
@@ -272,7 +281,15 @@
   ;;   (redirect-to <method> <location>)
   (define (request-response in out method uri host sender)
     (send-request out method uri sender (req-headers host) enc)
-    (receive (code rep-headers) (receive-header in)
+    (receive (code rep-headers keep-alive?) (receive-header in)
+      (set! (~ conn'keep-alive)
+            (and keep-alive?
+                 (or (eq? method 'HEAD)
+                     (member code no-body-replies)
+                     (assoc "content-length" rep-headers)
+                     (equal? (rfc822-header-ref rep-headers
+                                                "transfer-encoding")
+                             "chunked"))))
       (if-let1 consider-redirect (and (string-prefix? "3" code) redirector)
         ;; we retrieve body as string, not using caller-provided receiver
         (let* ([body (get-body in method code rep-headers
@@ -299,7 +316,8 @@
       (let1 result
           (with-connection
            conn
-           (^[i o] (request-response i o method uri host sender)))
+           (^[i o] (request-response i o method uri host sender))
+           (memq method '(GET HEAD PUT DELETE)))
         (match result
           [('reply code rep-headers body) (values code rep-headers body)]
           [('redirect-to method location)
@@ -499,6 +517,8 @@
    (proxy         :init-keyword :proxy)
    (extra-headers :init-keyword :extra-headers)
    (secure        :init-keyword :secure) ; boolean
+   (keep-alive    :init-value #f)       ; set after each response; true if
+                                        ; the socket can be used again.
    ))
 
 (define (make-http-connection server :key
@@ -724,19 +744,151 @@
     (socket-close (~ conn'socket))
     (set! (~ conn'socket) #f)))
 
-(define (with-connection conn proc)
-  (unless (~ conn'persistent)
-    (unless (~ conn'socket) (start-socket-connection conn))
+(define (connection-ports conn)
+  (if (~ conn'secure)
+    `(,(tls-input-port (~ conn'secure-agent))
+      ,(tls-output-port (~ conn'secure-agent)))
+    `(,(socket-input-port (~ conn'socket))
+      ,(socket-output-port (~ conn'socket)))))
+
+;; Calls PROC with the input and output ports of CONN's connection.
+;; A persistent connection keeps its socket as long as the server allows.
+;; Otherwise, the socket is taken from and given back to the current
+;; connection pool if there is one, or closed after PROC returns.
+;; If a reused socket turns out to have been closed by the server and
+;; RETRY? is true, PROC is called again on a new connection.
+(define (with-connection conn proc :optional (retry? #f))
+  (define pool (and (not (~ conn'persistent)) (http-connection-pool)))
+  (define (open!)
+    (start-socket-connection conn)
     (when (~ conn'secure) (start-secure-agent conn)))
-  (unwind-protect
-      (apply proc (if (~ conn'secure)
-                    `(,(tls-input-port (~ conn'secure-agent))
-                      ,(tls-output-port (~ conn'secure-agent)))
-                    `(,(socket-input-port (~ conn'socket))
-                      ,(socket-output-port (~ conn'socket)))))
-    (unless (~ conn'persistent)
-      (when (~ conn'secure) (shutdown-secure-agent conn))
-      (shutdown-socket-connection conn))))
+  (define (run reused?)
+    (guard (e [(and reused? retry? (stale-connection-error? e))
+               (reset-http-connection conn)
+               (open!)
+               (run #f)])
+      (apply proc (connection-ports conn))))
+  (let ([reserved #f] [done #f])
+    (unwind-protect
+        (let1 reused? (cond [(~ conn'socket) #t]
+                            [pool (begin0 (pool-checkout! pool conn)
+                                    (set! reserved #t))]
+                            [else #f])
+          (unless reused? (open!))
+          (set! (~ conn'keep-alive) #f)
+          (begin0 (run reused?) (set! done #t)))
+      (if (and done (~ conn'keep-alive) (or pool (~ conn'persistent)))
+        (when reserved (pool-checkin! pool conn))
+        (begin
+          (reset-http-connection conn)
+          (when reserved (pool-release! pool conn)))))))
+
+(define (stale-connection-error? e)
+  (or (<http-no-reply-error> e)
+      (and (<system-error> e)
+           (memv (condition-ref e 'errno) `(,EPIPE ,ECONNRESET)))))
+
+;;==============================================================
+;; Connection pool
+;;
+
+;; A connection pool keeps idle sockets of finished requests, keyed by
+;; the server, the TLS setting and the proxy, so that later requests to
+;; the same server skip connection setup.  It also limits the number of
+;; connections per key; if that many are busy, a new request waits for
+;; one of them to be returned.
+;;
+;;   idle   - key -> list of (expiry socket . secure-agent), newest first
+;;   counts - key -> number of checked-out connections
+
+(define-class <http-connection-pool> ()
+  ((max-per-host :init-keyword :max-per-host)
+   (idle-timeout :init-keyword :idle-timeout)
+   (idle   :init-form (make-hash-table 'equal?))
+   (counts :init-form (make-hash-table 'equal?))
+   (mutex  :init-form (make-mutex))
+   (cv     :init-form (make-condition-variable))))
+
+(define (make-http-connection-pool :key (max-per-host 8) (idle-timeout 30))
+  (make <http-connection-pool>
+    :max-per-host max-per-host :idle-timeout idle-timeout))
+
+;; When set, string server arguments are served with pooled connections.
+(define http-connection-pool
+  (make-parameter #f
+                  (^x (unless (or (not x) (is-a? x <http-connection-pool>))
+                        (error "<http-connection-pool> or #f required, \
+                                but got:" x))
+                      x)))
+
+(define (pool-key conn) (list (~ conn'server) (~ conn'secure) (~ conn'proxy)))
+
+(define (pool-now) (time->seconds (current-time)))
+
+(define (close-pooled-socket entry)
+  (match-let1 (_ sock . agent) entry
+    (when agent
+      (guard (e [else #f]) (tls-close agent) (tls-destroy agent)))
+    (guard (e [(<system-error> e) #f]) (socket-shutdown sock))
+    (socket-close sock)))
+
+;; Reserves a connection slot for CONN's key.  If there's a live idle
+;; socket, attaches it to CONN and returns #t; otherwise returns #f and
+;; the caller should open a new one.  Waits while the key is at its limit.
+(define (pool-checkout! pool conn)
+  (define key (pool-key conn))
+  (define expired '())
+  (define entry
+    (with-locking-mutex (~ pool'mutex)
+      (^[] (let loop ()
+             (let* ([now (pool-now)]
+                    [live (filter (^e (if (< now (car e))
+                                        #t
+                                        (begin (push! expired e) #f)))
+                                  (hash-table-get (~ pool'idle) key '()))])
+               (cond [(pair? live)
+                      (hash-table-put! (~ pool'idle) key (cdr live))
+                      (hash-table-update! (~ pool'counts) key (cut + <> 1) 0)
+                      (car live)]
+                     [(< (hash-table-get (~ pool'counts) key 0)
+                         (~ pool'max-per-host))
+                      (hash-table-delete! (~ pool'idle) key)
+                      (hash-table-update! (~ pool'counts) key (cut + <> 1) 0)
+                      #f]
+                     [else
+                      (hash-table-put! (~ pool'idle) key live)
+                      (mutex-unlock! (~ pool'mutex) (~ pool'cv))
+                      (mutex-lock! (~ pool'mutex))
+                      (loop)]))))))
+  (for-each close-pooled-socket expired)
+  (and entry
+       (begin (set! (~ conn'socket) (cadr entry))
+              (set! (~ conn'secure-agent) (cddr entry))
+              #t)))
+
+;; Gives CONN's socket back to the pool as idle.
+(define (pool-checkin! pool conn)
+  (let ([entry `(,(+ (pool-now) (~ pool'idle-timeout))
+                 ,(~ conn'socket) . ,(~ conn'secure-agent))]
+        [key (pool-key conn)])
+    (set! (~ conn'socket) #f)
+    (set! (~ conn'secure-agent) #f)
+    (with-locking-mutex (~ pool'mutex)
+      (^[] (hash-table-push! (~ pool'idle) key entry)
+           (hash-table-update! (~ pool'counts) key (cut - <> 1) 1)
+           (condition-variable-broadcast! (~ pool'cv))))))
+
+;; Frees CONN's slot after its socket has been closed.
+(define (pool-release! pool conn)
+  (with-locking-mutex (~ pool'mutex)
+    (^[] (hash-table-update! (~ pool'counts) (pool-key conn) (cut - <> 1) 1)
+         (condition-variable-broadcast! (~ pool'cv)))))
+
+(define (http-connection-pool-shutdown! pool)
+  (let1 entries (with-locking-mutex (~ pool'mutex)
+                  (^[] (begin0 (concatenate (hash-table-values (~ pool'idle)))
+                         (hash-table-clear! (~ pool'idle)))))
+    (for-each close-pooled-socket entries)))
 
 ;; canonicalize uri for the sake of redirection.
 ;; URI is a request-uri given to the API, or the redirect location specified
@@ -798,13 +950,22 @@
   (flush out))
 
 ;; receive
+;; Returns the status code, the headers, and whether the server allows
+;; us to keep the connection.
 (define (receive-header remote)
-  (receive (code reason) (parse-status-line (read-line remote))
-    (values code (rfc822-header->list remote))))
+  (let1 line (read-line remote)
+    (receive (code reason) (parse-status-line line)
+      (let* ([hdrs (rfc822-header->list remote)]
+             [conn-hdr (string-downcase
+                        (or (rfc822-header-ref hdrs "connection") ""))])
+        (values code hdrs
+                (if (#/^HTTP\/1\.0/ line)
+                  (string-contains conn-hdr "keep-alive")
+                  (not (string-contains conn-hdr "close"))))))))
 
 (define (parse-status-line line)
   (cond [(eof-object? line)
-         (error <http-error> "http reply contains no data")]
+         (error <http-no-reply-error> "http reply contains no data")]
         [(#/\w+\s+(\d\d\d)\s+(.*)/ line) => (^m (values (m 1) (m 2)))]
         [else (error <http-error> "bad reply from server" line)]))
 
@@ -31,16 +31,25 @@
 ;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ;;;
 
+;; This module is autoloaded from rfc.mime.  You don't need to "use" this
+;; directly.
 ;; This module is autoloaded from rfc.mime.  You don't need to "use" this
 ;; directly.
 (define-module rfc.mime-port
   (use gauche.uvector)
   (use gauche.vport)
-  (use data.queue)
-  (use util.match)
+  (use rfc.mime)
   (export make-mime-port))
 (select-module rfc.mime-port)
 
+;; The scanner is defined in rfc.mime, for it's compiled together with
+;; its stubs.
+(define %mime-scan-boundary (with-module rfc.mime %mime-scan-boundary))
+(define NO_DELIMITER (with-module rfc.mime SCM_MIME_NO_DELIMITER))
+(define PART_DELIMITER (with-module rfc.mime SCM_MIME_PART_DELIMITER))
+(define SCAN_AT_START (with-module rfc.mime SCM_MIME_SCAN_AT_START))
+(define SCAN_EOF (with-module rfc.mime SCM_MIME_SCAN_EOF))
+
 ;;===============================================================
 ;; Virtual port to recognize mime boundary
 ;;
@@ -51,107 +60,94 @@
    ))
 
 ;; Creates a procedural port, which reads from SRCPORT until it reaches
-;; either EOF or MIME boundary.  Basically it runs a DFA.
+;; either EOF or MIME boundary.
+;;
+;; We read SRCPORT ahead into BUF in chunks, and let the C scanner find
+;; the delimiter in it.  The bytes in BUF[START..END) are not consumed
+;; yet.  Reading ahead is safe, since the mime port owns SRCPORT until
+;; its EOF; after the close delimiter we skip the rest anyway.
 (define (make-mime-port boundary srcport)
-  (define q (make-queue))
   (define --boundary (string->u8vector #"--~boundary"))
+  (define buf (make-u8vector (max 8192 (* 2 (+ (u8vector-length --boundary)
+                                                 4)))))
+  (define start 0)
+  (define end 0)
+  (define src-eof? #f)
+  (define at-start? #t)       ;the first delimiter may lack the line break
 
   (define port (make <mime-port>))
 
-  (define eof (read-from-string ""))
-
-  (define (deq! q)
-    (if (queue-empty? q) eof (dequeue! q)))
-
-  (define (fifo! q b)
-    (enqueue! q b) (dequeue! q))
-
-  (define (getb)
-    (if (queue-empty? q)
-      (case (ref port 'state)
-        [(prologue) (skip-prologue)]
-        [(boundary eof) eof]
-        [else (newb)])
-      (dequeue! q)))
-
-  (define (newb)
-    (match (read-byte srcport)
-      [(and #x0d b) ;; CR, check to see LF
-       (let1 b2 (peek-byte srcport)
-         (if (eqv? b2 #x0a)
-           (begin
-             (read-byte srcport)
-             (enqueue! q b #x0a)
-             (check-boundary))
-           b))]
-      [(and #x0a b) ;; LF, check boundary
-       (enqueue! q b) (check-boundary)]
-      [(? eof-object?) (set! (ref port 'state) 'eof) eof]
-      [b b]))
-
-  (define (check-boundary)
-    (let loop ((b   (peek-byte srcport))
-               (ind 0)
-               (max (u8vector-length --boundary)))
-      (cond [(eof-object? b) (deq! q)]
-            [(= ind max)
-             (cond [(memv b '(#x0d #x0a)) ;;found boundary
-                    (read-byte srcport)   ;;consume LF or CRLF
-                    (when (and (eqv? #x0d b)
-                               (eqv? #x0a (peek-byte srcport)))
-                      (read-byte srcport))
-                    (dequeue-all! q)
-                    (set! (ref port 'state) 'boundary)
-                    eof]
-                   [(eqv? b #x2d) ;; maybe end boundary
-                    (enqueue! q (read-byte srcport))
-                    (cond [(eqv? (peek-byte srcport) #x2d);; yes, end boundary
-                           (read-byte srcport)
-                           (dequeue-all! q)
-                           (skip-epilogue)]
-                          [else (deq! q)])]
-                   [else (deq! q)])]
-            [(= b (u8vector-ref --boundary ind))
-             (enqueue! q (read-byte srcport))
-             (loop (peek-byte srcport) (+ ind 1) max)]
-            [(queue-empty? q) (newb)]
-            [else (dequeue! q)])))
-
-  ;; Reads past the first boundary.  The first boundary may appear
-  ;; at the beginning of the message (instead of after CRLF), so
-  ;; we need slightly different handling than the normal getb.
-  (define (skip-prologue)
-    (let loop ((b (check-boundary)))
-      (cond
-       [(eof-object? b)
-        (cond [(eq? (ref port 'state) 'boundary) ; we've found the boundary
-               (set! (ref port 'state) 'body) (getb)]
-              [else                              ; no boundary found
-               (set! (ref port 'state) 'eof) eof])]
-       [(queue-empty? q) (loop (newb))]
-       [else (dequeue-all! q) (loop (newb))])))
-
-  (define (skip-epilogue)
-    (let loop ((b (read-byte srcport)))
-      (if (eof-object? b)
-        (begin (set! (ref port 'state) 'eof) b)
-        (loop (read-byte srcport)))))
+  ;; Reads more data from SRCPORT into BUF.
+  (define (refill!)
+    (when (> start 0)
+      (u8vector-copy! buf 0 buf start end)
+      (set! end (- end start))
+      (set! start 0))
+    (let1 n (read-uvector! buf srcport end)
+      (if (eof-object? n)
+        (set! src-eof? #t)
+        (set! end (+ end n)))))
+
+  (define (scan)
+    (%mime-scan-boundary buf start end --boundary
+                         (logior (if at-start? SCAN_AT_START 0)
+                                 (if src-eof? SCAN_EOF 0))))
+
+  (define (skip-epilogue!)
+    (set! start 0)
+    (set! end 0)
+    (until src-eof? (refill!) (set! end 0))
+    (set! (ref port 'state) 'eof))
+
+  ;; Takes the delimiter at START..DEND.
+  (define (take-delimiter! kind dend)
+    (set! start dend)
+    (set! at-start? #f)
+    (if (= kind PART_DELIMITER)
+      (set! (ref port 'state) 'boundary)
+      (skip-epilogue!)))
+
+  ;; Reads past the first boundary.
+  (define (skip-prologue!)
+    (receive (kind dstart dend) (scan)
+      (cond [(= kind NO_DELIMITER)
+             (unless (= dstart start) (set! at-start? #f))
+             (set! start dstart)
+             (cond [src-eof? (set! (ref port 'state) 'eof)]
+                   [else (refill!) (skip-prologue!)])]
+            [else
+             (set! start dstart)
+             (take-delimiter! kind dend)
+             (when (eq? (ref port 'state) 'boundary)
+               (set! (ref port 'state) 'body))])))
+
+  ;; Copies the body up to LIMIT into VEC.  We don't leave CR at the
+  ;; end of the chunk, for it may be a part of the next delimiter.
+  (define (copy-body! vec limit)
+    (let* ([avail (- limit start)]
+           [n (min avail (u8vector-length vec))]
+           [n (if (and (< n avail) (> n 1)
+                       (= (u8vector-ref buf (+ start n -1)) #x0d))
+                (- n 1)
+                n)])
+      (u8vector-copy! vec 0 buf start (+ start n))
+      (set! start (+ start n))
+      n))
 
   ;; fills vector, until it sees either
   ;;   (1) vec got full
   ;;   (2) srcport reaches EOF
   ;;   (3) mime-boundary is read
   (define (fill vec)
-    (let1 len (u8vector-length vec)
-      (let loop ((ind 0))
-        (if (= ind len)
-          len
-          (let1 b (getb)
-            (if (eof-object? b)
-              ind
-              (begin (u8vector-set! vec ind b)
-                     (loop (+ ind 1)))))))))
+    (case (ref port 'state)
+      [(prologue) (skip-prologue!) (fill vec)]
+      [(boundary eof) 0]
+      [else
+       (receive (kind dstart dend) (scan)
+         (cond [(> dstart start) (copy-body! vec dstart)]
+               [(not (= kind NO_DELIMITER)) (take-delimiter! kind dend) 0]
+               [src-eof? (set! (ref port 'state) 'eof) 0]
+               [else (refill!) (fill vec)]))]))
 
   (set! (ref port 'fill) fill)
   port)
-
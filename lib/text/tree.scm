@@ -13,15 +13,21 @@
 (define-method write-tree (tree)
   (write-tree tree (current-output-port)))
 
+;; Strings and lists are the common case, so we walk them directly
+;; instead of dispatching on every node; other objects still go through
+;; the generic function.
 (define-method write-tree ((tree <list>) out)
-  (let loop ((tree tree))
-    (cond ((null? tree))
-          ((pair? tree) (write-tree (car tree) out) (loop (cdr tree)))
-          (else (write-tree tree out)))))
+  (with-port-locking out
+    (^[] (let walk ([tree tree])
+           (cond [(pair? tree)
+                  (walk (car tree))
+                  (walk (cdr tree))]
+                 [(null? tree)]
+                 [(string? tree) (display tree out)]
+                 [else (write-tree tree out)])))))
 
 (define-method write-tree ((tree <top>) out)
   (display tree out))
 
 (define (tree->string tree)
-  (with-output-to-string (lambda () (write-tree tree))))
-
+  (call-with-output-string (cut write-tree tree <>)))
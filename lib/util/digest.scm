@@ -51,7 +51,8 @@
   ()
   :metaclass <message-digest-algorithm-meta>)
 
-(define-method digest-update! ((self <message-digest-algorithm>) data)
+(define-method digest-update! ((self <message-digest-algorithm>) data
+                               :optional start end)
   #f)
 (define-method digest-final! ((self <message-digest-algorithm>))
   #f)
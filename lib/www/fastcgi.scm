@@ -0,0 +1,375 @@
+;;;
+;;; www.fastcgi - FastCGI responder
+;;;
+;;;   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+
+;; EXPERIMENTAL : API may change
+
+;; FastCGI specification: http://www.mit.edu/~yandros/doc/specs/fcgi-spec.html
+
+(define-module www.fastcgi
+  (use srfi-1)
+  (use gauche.net)
+  (use gauche.threads)
+  (use gauche.record)
+  (use gauche.vport)
+  (use gauche.uvector)
+  (use control.thread-pool)
+  (use www.cgi)
+  (export fastcgi-main))
+(select-module www.fastcgi)
+
+;; fastcgi-main keeps the process alive and runs cgi-main for each
+;; request with cgi-metavariables bound to the request's parameters,
+;; its stdin stream as the current input port, and an output port that
+;; sends FastCGI STDOUT records as the current output port.
+;;
+;; Each connection is read by its own thread, which demultiplexes the
+;; records into requests.  When the parameters and the stdin of a
+;; request are complete, it is run on a pool of worker threads, so that
+;; the requests multiplexed on a connection are served concurrently.
+;; Writes to a connection are serialized by its mutex.  With
+;; num-workers 0, connections are served one at a time and requests
+;; are run in the reading thread.
+
+;; Record types
+(define-constant FCGI_BEGIN_REQUEST      1)
+(define-constant FCGI_ABORT_REQUEST      2)
+(define-constant FCGI_END_REQUEST        3)
+(define-constant FCGI_PARAMS             4)
+(define-constant FCGI_STDIN              5)
+(define-constant FCGI_STDOUT             6)
+(define-constant FCGI_STDERR             7)
+(define-constant FCGI_DATA               8)
+(define-constant FCGI_GET_VALUES         9)
+(define-constant FCGI_GET_VALUES_RESULT 10)
+(define-constant FCGI_UNKNOWN_TYPE      11)
+
+(define-constant FCGI_RESPONDER          1)
+(define-constant FCGI_KEEP_CONN          1)
+
+;; Protocol status of END_REQUEST
+(define-constant FCGI_REQUEST_COMPLETE   0)
+(define-constant FCGI_UNKNOWN_ROLE       3)
+
+;; Maximum content length of a record we send; a multiple of 8 so that
+;; full records need no padding.
+(define-constant MAX_CONTENT 65528)
+
+(define-record-type <server> %make-server #f
+  (proc        server-proc)
+  (cgi-options server-cgi-options)
+  (socket      server-socket)
+  (pool        server-pool)             ; thread pool or #f
+  (max-conns   server-max-conns)
+  (remaining   server-remaining server-remaining-set!) ; #f for unlimited
+  (mutex       server-mutex))
+
+(define-record-type <connection> %make-connection #f
+  (socket   conn-socket)
+  (iport    conn-iport)
+  (oport    conn-oport)
+  (mutex    conn-mutex)
+  (requests conn-requests)              ; id -> <request>
+  (running  conn-running conn-running-set!) ; # of requests being run
+  (eof      conn-eof conn-eof-set!))    ; reader is done
+
+(define-record-type <request> %make-request #f
+  (id        req-id)
+  (keep-conn req-keep-conn)
+  (params    req-params req-params-set!) ; list of u8vectors, reversed
+  (stdin     req-stdin req-stdin-set!)   ; ditto
+  (state     req-state req-state-set!))  ; params, stdin, running, aborted
+
+;; API
+(define (fastcgi-main proc :key (port #f) (path #f) (host :loopback)
+                                (num-workers 4) (max-requests #f)
+                                (backlog 128)
+                      :allow-other-keys cgi-options)
+  (if (not (or port path))
+    ;; Not a FastCGI server; behave as a plain CGI script.
+    (apply cgi-main proc cgi-options)
+    (let1 server (%make-server proc cgi-options
+                               (if path
+                                 (make-server-socket 'unix path
+                                                     :backlog backlog)
+                                 (make-server-socket
+                                  (make <sockaddr-in> :host host :port port)
+                                  :reuse-addr? #t :backlog backlog))
+                               (and (> num-workers 0)
+                                    (make-thread-pool num-workers))
+                               (max num-workers 1)
+                               max-requests
+                               (make-mutex))
+      (unwind-protect
+          (accept-loop server)
+        (begin
+          (socket-close (server-socket server))
+          (and-let1 pool (server-pool server)
+            (wait-all pool)
+            (terminate-all! pool))
+          (when path (sys-unlink path))))
+      0)))
+
+(define (accept-loop server)
+  (let loop ()
+    (and-let* ([ (not (eqv? (server-remaining server) 0)) ]
+               [sock (guard (e [(<system-error> e)
+                                ;; the socket is closed when max-requests
+                                ;; is reached
+                                (and (not (eqv? (server-remaining server) 0))
+                                     (raise e))])
+                       (socket-accept (server-socket server)))])
+      (let1 conn (%make-connection sock
+                                   (socket-input-port sock :buffering :modest)
+                                   (socket-output-port sock :buffering :full)
+                                   (make-mutex)
+                                   (make-hash-table 'eqv?)
+                                   0 #f)
+        (if (server-pool server)
+          (thread-start! (make-thread (^[] (serve-connection server conn))))
+          (serve-connection server conn)))
+      (loop))))
+
+;; Reads records from CONN until EOF.
+(define (serve-connection server conn)
+  (guard (e [else #f])                   ;connection reset etc.
+    (let loop ()
+      (receive (type id content) (read-record (conn-iport conn))
+        (when type
+          (handle-record server conn type id content)
+          (loop)))))
+  (with-locking-mutex (conn-mutex conn)
+    (^[]
+      (conn-eof-set! conn #t)
+      (when (zero? (conn-running conn))
+        (socket-close (conn-socket conn))))))
+
+(define (handle-record server conn type id content)
+  (define (req) (hash-table-get (conn-requests conn) id #f))
+  (cond
+   [(= type FCGI_BEGIN_REQUEST)
+    (let ([role (+ (* 256 (u8vector-ref content 0)) (u8vector-ref content 1))]
+          [keep (logtest (u8vector-ref content 2) FCGI_KEEP_CONN)])
+      (if (= role FCGI_RESPONDER)
+        (hash-table-put! (conn-requests conn) id
+                         (%make-request id keep '() '() 'params))
+        (send-end-request conn id 0 FCGI_UNKNOWN_ROLE)))]
+   [(= type FCGI_PARAMS)
+    (and-let1 r (req)
+      (if (zero? (u8vector-length content))
+        (req-state-set! r 'stdin)
+        (req-params-set! r (cons content (req-params r)))))]
+   [(= type FCGI_STDIN)
+    (and-let1 r (req)
+      (if (zero? (u8vector-length content))
+        (start-request server conn r)
+        (req-stdin-set! r (cons content (req-stdin r)))))]
+   [(= type FCGI_ABORT_REQUEST)
+    (and-let1 r (req)
+      (if (eq? (req-state r) 'running)
+        (req-state-set! r 'aborted)     ;output is discarded
+        (begin (hash-table-delete! (conn-requests conn) id)
+               (send-end-request conn id 0 FCGI_REQUEST_COMPLETE))))]
+   [(= type FCGI_GET_VALUES)
+    (send-record conn FCGI_GET_VALUES_RESULT 0
+                 (encode-params
+                  (filter-map (^[p] (and (assoc (car p) (parse-params content))
+                                         p))
+                              `(("FCGI_MAX_CONNS"
+                                 ,(x->string (server-max-conns server)))
+                                ("FCGI_MAX_REQS"
+                                 ,(x->string (server-max-conns server)))
+                                ("FCGI_MPXS_CONNS"
+                                 ,(if (server-pool server) "1" "0"))))))]
+   [(= type FCGI_DATA)]                 ;only for the filter role
+   [(zero? id)
+    (send-record conn FCGI_UNKNOWN_TYPE 0 (u8vector type 0 0 0 0 0 0 0))]))
+
+(define (start-request server conn req)
+  (req-state-set! req 'running)
+  (with-locking-mutex (conn-mutex conn)
+    (cut conn-running-set! conn (+ (conn-running conn) 1)))
+  (if-let1 pool (server-pool server)
+    (add-job! pool (^[] (run-request server conn req)))
+    (run-request server conn req)))
+
+(define (run-request server conn req)
+  (let ([params (parse-params (concat-chunks (req-params req)))]
+        [in (open-input-uvector (concat-chunks (req-stdin req)))]
+        [out (make <buffered-output-port>
+               :buffer-size MAX_CONTENT
+               :flush (^[buf complete?]
+                        (unless (eq? (req-state req) 'aborted)
+                          (send-stream conn FCGI_STDOUT (req-id req) buf))
+                        (u8vector-length buf)))])
+    (guard (e [else (report-error e)])
+      (parameterize ([cgi-metavariables params]
+                     [cgi-temporary-files '()])
+        (with-ports in out (current-error-port)
+          (^[] (apply cgi-main (server-proc server)
+                      (server-cgi-options server))))))
+    (guard (e [else #f]) (close-output-port out))
+    (finish-request server conn req)))
+
+(define (finish-request server conn req)
+  (guard (e [else #f])
+    (send-stream conn FCGI_STDOUT (req-id req) '#u8())
+    (send-end-request conn (req-id req) 0 FCGI_REQUEST_COMPLETE))
+  (with-locking-mutex (conn-mutex conn)
+    (^[]
+      (hash-table-delete! (conn-requests conn) (req-id req))
+      (conn-running-set! conn (- (conn-running conn) 1))
+      (cond [(and (conn-eof conn) (zero? (conn-running conn)))
+             (socket-close (conn-socket conn))]
+            [(not (req-keep-conn req))
+             ;; wakes up the reader, which closes the socket
+             (guard (e [else #f])
+               (socket-shutdown (conn-socket conn) SHUT_RDWR))])))
+  (with-locking-mutex (server-mutex server)
+    (^[]
+      (and-let1 n (server-remaining server)
+        (server-remaining-set! server (- n 1))
+        (when (= n 1)
+          ;; wakes up accept-loop
+          (guard (e [else #f])
+            (socket-shutdown (server-socket server) SHUT_RDWR))
+          (socket-close (server-socket server)))))))
+
+;;;
+;;; Records
+;;;
+
+;; Returns type, request id and content, or #f's on EOF.
+(define (read-record in)
+  (let1 header (read-bytes in 8)
+    (if (not header)
+      (values #f #f #f)
+      (let* ([type (u8vector-ref header 1)]
+             [id   (+ (* 256 (u8vector-ref header 2)) (u8vector-ref header 3))]
+             [clen (+ (* 256 (u8vector-ref header 4)) (u8vector-ref header 5))]
+             [plen (u8vector-ref header 6)]
+             [content (read-bytes in clen)])
+        (if (and content (read-bytes in plen))
+          (values type id content)
+          (values #f #f #f))))))
+
+;; Reads exactly N bytes, or returns #f on premature EOF.
+(define (read-bytes in n)
+  (let1 buf (make-u8vector n)
+    (let loop ([i 0])
+      (if (= i n)
+        buf
+        (let1 r (read-uvector! buf in i)
+          (and (not (eof-object? r))
+               (loop (+ i r))))))))
+
+(define (send-record conn type id content :optional (start 0)
+                     (end (u8vector-length content)))
+  (let* ([len (- end start)]
+         [pad (modulo (- len) 8)]
+         [out (conn-oport conn)])
+    (with-locking-mutex (conn-mutex conn)
+      (^[]
+        (write-uvector (u8vector 1 type (ash id -8) (logand id 255)
+                                 (ash len -8) (logand len 255) pad 0)
+                       out)
+        (write-uvector content out start end)
+        (unless (zero? pad) (write-uvector (make-u8vector pad 0) out))
+        (flush out)))))
+
+;; Sends DATA as a stream, splitting it into records as needed.  Empty
+;; data sends the end-of-stream record.
+(define (send-stream conn type id data)
+  (let1 size (u8vector-length data)
+    (if (zero? size)
+      (send-record conn type id data)
+      (let loop ([start 0])
+        (when (< start size)
+          (let1 end (min size (+ start MAX_CONTENT))
+            (send-record conn type id data start end)
+            (loop end)))))))
+
+(define (send-end-request conn id app-status protocol-status)
+  (send-record conn FCGI_END_REQUEST id
+               (u8vector (logand (ash app-status -24) 255)
+                         (logand (ash app-status -16) 255)
+                         (logand (ash app-status -8) 255)
+                         (logand app-status 255)
+                         protocol-status 0 0 0)))
+
+(define (concat-chunks rchunks)
+  (case (length rchunks)
+    [(0) '#u8()]
+    [(1) (car rchunks)]
+    [else (apply u8vector-append (reverse rchunks))]))
+
+;;;
+;;; Name-value pairs
+;;;
+
+;; Returns (("NAME" "VALUE") ...), the format of cgi-metavariables.
+(define (parse-params bytes)
+  (define size (u8vector-length bytes))
+  (define (get-length i)
+    (let1 b (u8vector-ref bytes i)
+      (if (< b 128)
+        (values b (+ i 1))
+        (values (+ (ash (logand b 127) 24)
+                   (ash (u8vector-ref bytes (+ i 1)) 16)
+                   (ash (u8vector-ref bytes (+ i 2)) 8)
+                   (u8vector-ref bytes (+ i 3)))
+                (+ i 4)))))
+  (let loop ([i 0] [r '()])
+    (if (>= i size)
+      (reverse r)
+      (receive (nlen i) (get-length i)
+        (receive (vlen i) (get-length i)
+          (let ([name  (u8vector->string bytes i (+ i nlen))]
+                [value (u8vector->string bytes (+ i nlen) (+ i nlen vlen))])
+            (loop (+ i nlen vlen) (cons (list name value) r))))))))
+
+(define (encode-params params)
+  (define (encode-length n)
+    (if (< n 128)
+      (u8vector n)
+      (u8vector (logior (ash n -24) 128) (logand (ash n -16) 255)
+                (logand (ash n -8) 255) (logand n 255))))
+  (apply u8vector-append
+         '#u8()
+         (append-map (^[p]
+                       (let ([name  (string->u8vector (car p))]
+                             [value (string->u8vector (cadr p))])
+                         (list (encode-length (u8vector-length name))
+                               (encode-length (u8vector-length value))
+                               name value)))
+                     params)))
@@ -0,0 +1,510 @@
+;;;
+;;; www.server - embedded HTTP server
+;;;
+;;;   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; EXPERIMENTAL : API may change
+
+(define-module www.server
+  (use srfi-1)
+  (use srfi-13)
+  (use gauche.net)
+  (use gauche.threads)
+  (use gauche.selector)
+  (use gauche.record)
+  (use gauche.vport)
+  (use gauche.uvector)
+  (use control.thread-pool)
+  (use data.queue)
+  (use rfc.822)
+  (use rfc.uri)
+  (use file.util)
+  (use text.tree)
+  (export make-http-server http-server? http-server-port
+          http-server-start! http-server-stop!
+          <http-request> http-request?
+          http-request-method http-request-uri http-request-path
+          http-request-query http-request-version http-request-headers
+          http-request-header http-request-body http-request-remote-address
+          http-respond http-respond-file http-respond-chunked
+          http-server-cgi-handler))
+(select-module www.server)
+
+(autoload rfc.http http-status-code->description)
+(autoload www.cgi cgi-main cgi-metavariables cgi-temporary-files)
+
+;; The server runs an event loop in the thread that calls
+;; http-server-start!, and serves requests on a pool of worker threads.
+;;
+;; The event loop watches the listening sockets and the idle connections,
+;; i.e. those waiting for the next request, with a selector (epoll or
+;; kqueue where available).  When a connection becomes readable, it is
+;; handed to a worker, which reads and serves requests on it as long
+;; as more data is already there.  Then the worker gives a keep-alive
+;; connection back to the event loop through the 'returned' queue,
+;; writing a byte to the wake pipe so that the loop notices it.
+;; Idle connections are closed after keep-alive-timeout seconds.
+;;
+;; Thus a worker is never occupied by an idle client, and the number of
+;; threads doesn't grow with the number of connections.
+
+(define-record-type <http-server> %make-http-server http-server?
+  (handler            server-handler)
+  (sockets            server-sockets)
+  (num-workers        server-num-workers)
+  (keep-alive-timeout server-keep-alive-timeout)
+  (max-body-size      server-max-body-size)
+  (returned           server-returned)   ; <mtqueue> of <connection>
+  (wake-in            server-wake-in server-wake-in-set!)
+  (wake-out           server-wake-out server-wake-out-set!)
+  (state              server-state server-state-set!)) ; created, running,
+                                                       ; stopping or stopped
+
+(define-record-type <connection> %make-connection #f
+  (socket     conn-socket)
+  (iport      conn-iport)
+  (oport      conn-oport)
+  (remote     conn-remote)
+  (idle-since conn-idle-since conn-idle-since-set!))
+
+(define-record-type <http-request> %make-http-request http-request?
+  (method     http-request-method)      ; "GET", "POST", ...
+  (uri        http-request-uri)         ; request-target as sent
+  (path       http-request-path)
+  (query      http-request-query)       ; string or #f
+  (version    http-request-version)     ; "HTTP/1.1" or "HTTP/1.0"
+  (headers    http-request-headers)     ; (("name" "value") ...)
+  (body       http-request-body)        ; input port
+  (server     request-server)
+  (conn       request-conn)
+  (keep-alive request-keep-alive request-keep-alive-set!)
+  (responded  request-responded request-responded-set!))
+
+(define (http-request-header req name :optional (default #f))
+  (rfc822-header-ref (http-request-headers req) name default))
+
+(define (http-request-remote-address req)
+  (conn-remote (request-conn req)))
+
+(define (%now) (time->seconds (current-time)))
+
+;;;
+;;; Server
+;;;
+
+;; API
+(define (make-http-server handler :key (host #f) (port 8080)
+                                       (num-workers 4)
+                                       (keep-alive-timeout 15)
+                                       (max-body-size (* 16 1024 1024))
+                                       (backlog 128))
+  (%make-http-server handler
+                     (make-server-sockets host port :reuse-addr? #t
+                                          :backlog backlog)
+                     num-workers keep-alive-timeout max-body-size
+                     (make-mtqueue) #f #f 'created))
+
+;; API
+;; Returns the port number the server listens to; handy when the server
+;; is created with port 0.
+(define (http-server-port server)
+  (sockaddr-port (socket-getsockname (car (server-sockets server)))))
+
+;; API
+;; Runs the server in the calling thread until http-server-stop! is called.
+(define (http-server-start! server)
+  (unless (eq? (server-state server) 'created)
+    (error "http server can't be started in the state:"
+           (server-state server)))
+  (receive (in out) (sys-pipe :buffering :none)
+    (server-wake-in-set! server in)
+    (server-wake-out-set! server out))
+  (server-state-set! server 'running)
+  (let1 pool (make-thread-pool (server-num-workers server))
+    (unwind-protect
+        (run-loop server pool)
+      (begin
+        (server-state-set! server 'stopping)
+        (terminate-all! pool)
+        (drain-returned! server close-connection)
+        (for-each socket-close (server-sockets server))
+        (close-port (server-wake-out server))
+        (close-port (server-wake-in server))
+        (server-state-set! server 'stopped)))))
+
+;; API
+;; Can be called from any thread, including from a handler.
+(define (http-server-stop! server)
+  (when (eq? (server-state server) 'running)
+    (server-state-set! server 'stopping)
+    (wake! server)))
+
+(define (wake! server)
+  (guard (e [else #f])                  ;the pipe may be closed already
+    (write-byte 0 (server-wake-out server))))
+
+(define (drain-returned! server proc)
+  (let loop ()
+    (and-let* ([conn (dequeue! (server-returned server) #f)])
+      (proc conn)
+      (loop))))
+
+(define (run-loop server pool)
+  (define sel (make <selector> :backend 'auto))
+  (define idle (make-hash-table 'eq?))  ; connections waiting for a request
+  (define timeout (server-keep-alive-timeout server))
+
+  (define (watch! conn)
+    (conn-idle-since-set! conn (%now))
+    (hash-table-put! idle conn #t)
+    (selector-add! sel (socket-fd (conn-socket conn))
+                   (^[fd flag] (dispatch! conn))
+                   '(r)))
+  (define (unwatch! conn)
+    (hash-table-delete! idle conn)
+    (selector-delete! sel (socket-fd (conn-socket conn)) #f '(r)))
+  (define (dispatch! conn)
+    (unwatch! conn)
+    (add-job! pool (^[] (serve-connection server conn))))
+  (define (accept! sock)
+    ;; EMFILE etc. just leaves the client in the backlog for now.
+    (dolist [s (guard (e [(<system-error> e) '()]) (socket-accept-all sock))]
+      (socket-set-nonblocking! s #f)
+      (watch! (make-connection s))))
+  (define (sweep!)
+    (let1 limit (- (%now) timeout)
+      (dolist [conn (hash-table-keys idle)]
+        (when (< (conn-idle-since conn) limit)
+          (unwatch! conn)
+          (close-connection conn)))))
+
+  (dolist [s (server-sockets server)]
+    (socket-set-nonblocking! s #t)
+    (selector-add! sel (socket-fd s) (^[fd flag] (accept! s)) '(r)))
+  (selector-add! sel (server-wake-in server)
+                 (^[p flag] (read-byte p) (drain-returned! server watch!))
+                 '(r))
+  (unwind-protect
+      (let loop ()
+        (when (eq? (server-state server) 'running)
+          (selector-select sel 1000000) ; at least once a second to sweep
+          (sweep!)
+          (loop)))
+    (dolist [conn (hash-table-keys idle)]
+      (unwatch! conn)
+      (close-connection conn))))
+
+(define (make-connection sock)
+  (%make-connection sock
+                    (socket-input-port sock :buffering :modest)
+                    (socket-output-port sock :buffering :full)
+                    (socket-address sock)
+                    0))
+
+(define (close-connection conn)
+  (guard (e [else #f])
+    (socket-shutdown (conn-socket conn) SHUT_RDWR))
+  (socket-close (conn-socket conn)))
+
+;; Runs in a worker thread.  Serves requests while they keep coming,
+;; then hands the connection back to the event loop or closes it.
+(define (serve-connection server conn)
+  (guard (e [else (close-connection conn)])
+    (let loop ()
+      (if-let1 req (read-request server conn)
+        (begin
+          (handle-request server req)
+          (cond [(or (not (request-keep-alive req))
+                     (not (eq? (server-state server) 'running)))
+                 (close-connection conn)]
+                [(byte-ready? (conn-iport conn)) (loop)]
+                [else
+                 (enqueue! (server-returned server) conn)
+                 (wake! server)]))
+        (close-connection conn)))))
+
+;;;
+;;; Reading requests
+;;;
+
+(define (read-request server conn)
+  (define in (conn-iport conn))
+  (let1 line (read-line in)
+    (cond
+     [(eof-object? line) #f]
+     ;; RFC7230 allows empty lines before a request-line
+     [(string-null? line) (read-request server conn)]
+     [(#/^([A-Z]+) (\S+) (HTTP\/1\.[01])$/ line)
+      => (^m
+          (let* ([headers (rfc822-read-headers in :strict? #f)]
+                 [version (m 3)]
+                 [conn-hdr (string-downcase
+                            (rfc822-header-ref headers "connection" ""))]
+                 [keep-alive (if (equal? version "HTTP/1.0")
+                               (string-contains conn-hdr "keep-alive")
+                               (not (string-contains conn-hdr "close")))])
+            (receive (path query) (split-request-uri (m 2))
+              (let1 body (request-body-port server conn headers)
+                (and body
+                     (%make-http-request (m 1) (m 2) path query version
+                                         headers body server conn
+                                         (and keep-alive #t) #f))))))]
+     [else
+      (send-error conn 400 "Bad Request")
+      #f])))
+
+(define (split-request-uri uri)
+  (if-let1 i (string-index uri #\?)
+    (values (substring uri 0 i) (substring uri (+ i 1) (string-length uri)))
+    (values uri #f)))
+
+;; Returns an input port to read the request body, or #f if the request
+;; is rejected.
+(define (request-body-port server conn headers)
+  (define in (conn-iport conn))
+  (define limit (server-max-body-size server))
+  (cond
+   [(equal? (rfc822-header-ref headers "transfer-encoding") "chunked")
+    (read-chunked-body conn limit)]
+   [(rfc822-header-ref headers "content-length")
+    => (^[len]
+         (let1 n (string->number len)
+           (cond [(not (and (exact-integer? n) (>= n 0)))
+                  (send-error conn 400 "Bad Request") #f]
+                 [(> n limit)
+                  (send-error conn 413 "Payload Too Large") #f]
+                 [else (open-input-limited-length-port in n)])))]
+   [else (open-input-string "")]))
+
+(define (read-chunked-body conn limit)
+  (define in (conn-iport conn))
+  (let loop ([total 0] [chunks '()])
+    (let1 line (read-line in)
+      (rxmatch-if (and (string? line) (#/^([[:xdigit:]]+)/ line)) (#f digits)
+        (let1 size (string->number digits 16)
+          (cond
+           [(> (+ total size) limit)
+            (send-error conn 413 "Payload Too Large") #f]
+           [(zero? size)
+            ;; skip trailer
+            (do ([l (read-line in) (read-line in)])
+                [(or (eof-object? l) (string-null? l))])
+            (open-input-uvector (apply u8vector-append (reverse chunks)))]
+           [else
+            (let1 chunk (read-uvector <u8vector> size in)
+              (read-line in)
+              (loop (+ total size) (cons chunk chunks)))]))
+        (begin (send-error conn 400 "Bad Request") #f)))))
+
+;;;
+;;; Responding
+;;;
+
+(define (handle-request server req)
+  (guard (e [else
+             (report-error e)
+             (request-keep-alive-set! req #f)
+             (unless (request-responded req)
+               (guard (e2 [else #f])
+                 (http-respond req 500 '(("content-type" "text/plain"))
+                               "Internal Server Error\n")))])
+    ((server-handler server) req)
+    (unless (request-responded req)
+      (error "http handler returned without responding:" (http-request-uri req))))
+  ;; Discard unread body, so that we can read the next request.
+  (when (request-keep-alive req)
+    (let ([body (http-request-body req)]
+          [buf (make-u8vector 4096)])
+      (until (eof-object? (read-uvector! buf body)))))
+  (flush (conn-oport (request-conn req))))
+
+(define (send-error conn status message)
+  (guard (e [else #f])
+    (let1 out (conn-oport conn)
+      (display #"HTTP/1.1 ~status ~message\r\n\
+                 content-type: text/plain\r\n\
+                 content-length: ~(+ (string-size message) 1)\r\n\
+                 connection: close\r\n\r\n~message\n" out)
+      (flush out))))
+
+(define (send-head req status headers extra)
+  (when (request-responded req)
+    (error "response already sent for the request:" (http-request-uri req)))
+  (request-responded-set! req #t)
+  (display
+   (tree->string
+    `(,#"HTTP/1.1 ~status ~(or (http-status-code->description status) \"\")\r\n"
+      ,@(map (^h `(,(x->string (car h)) ": " ,(x->string (cadr h)) "\r\n"))
+             (append extra headers))
+      ,(if (request-keep-alive req) "" "connection: close\r\n")
+      "\r\n"))
+   (conn-oport (request-conn req))))
+
+(define (head-request? req) (equal? (http-request-method req) "HEAD"))
+
+;; API
+;; BODY can be a string, a u8vector, or a text tree.
+(define (http-respond req status headers body)
+  (let* ([body (cond [(or (string? body) (u8vector? body)) body]
+                     [(not body) ""]
+                     [else (tree->string body)])]
+         [len (if (u8vector? body) (u8vector-length body) (string-size body))]
+         [out (conn-oport (request-conn req))])
+    (send-head req status headers `(("content-length" ,len)))
+    (unless (head-request? req)
+      (if (u8vector? body) (write-uvector body out) (display body out)))
+    (flush out)))
+
+(define *content-types*
+  '(("html" . "text/html") ("htm" . "text/html") ("txt" . "text/plain")
+    ("css" . "text/css") ("js" . "application/javascript")
+    ("json" . "application/json") ("xml" . "application/xml")
+    ("png" . "image/png") ("jpg" . "image/jpeg") ("jpeg" . "image/jpeg")
+    ("gif" . "image/gif") ("svg" . "image/svg+xml") ("ico" . "image/x-icon")
+    ("pdf" . "application/pdf") ("wasm" . "application/wasm")))
+
+;; API
+;; The file content goes through copy-port, which uses sendfile(2)
+;; where available, avoiding copies in user space.
+(define (http-respond-file req path :key (status 200) (headers '())
+                                        (content-type #f))
+  (if (not (and (file-is-regular? path) (file-is-readable? path)))
+    (http-respond req 404 '(("content-type" "text/plain")) "Not Found\n")
+    (let ([out (conn-oport (request-conn req))]
+          [ctype (or content-type
+                     (assoc-ref *content-types*
+                                (string-downcase (or (path-extension path) ""))
+                                "application/octet-stream"))])
+      (send-head req status headers `(("content-type" ,ctype)
+                                      ("content-length" ,(file-size path))))
+      (flush out)
+      (unless (head-request? req)
+        (call-with-input-file path (cut copy-port <> out)
+                              :element-type :binary)
+        (flush out)))))
+
+;; API
+;; PROC is called with an output port.  What's written to it is sent
+;; in chunked transfer coding, flushed whenever the port's buffer fills.
+;; HTTP/1.0 clients get the plain data and the connection is closed
+;; afterwards to mark the end.
+(define (http-respond-chunked req status headers proc)
+  (define out (conn-oport (request-conn req)))
+  (cond
+   [(equal? (http-request-version req) "HTTP/1.0")
+    (request-keep-alive-set! req #f)
+    (send-head req status headers '())
+    (unless (head-request? req) (proc out))
+    (flush out)]
+   [else
+    (send-head req status headers '(("transfer-encoding" "chunked")))
+    (flush out)
+    (unless (head-request? req)
+      (let1 port (make <buffered-output-port>
+                   :flush (^[buf complete?]
+                            (let1 n (u8vector-length buf)
+                              (when (> n 0)
+                                (format out "~x\r\n" n)
+                                (write-uvector buf out)
+                                (display "\r\n" out)
+                                (flush out))
+                              n)))
+        (proc port)
+        (close-output-port port))
+      (display "0\r\n\r\n" out)
+      (flush out))]))
+
+;;;
+;;; www.cgi compatibility
+;;;
+
+;; API
+;; Returns a handler that runs PROC just as cgi-main does.  PROC
+;; receives the parsed parameters and returns a text tree, which begins
+;; with CGI headers (e.g. the output of cgi-header).
+(define (http-server-cgi-handler proc :key (merge-cookies #f)
+                                           (part-handlers '())
+                                           (on-error #f))
+  (^[req]
+    (let1 out (open-output-string)
+      (parameterize ([cgi-metavariables (request-metavariables req)]
+                     [cgi-temporary-files '()])
+        (with-ports (http-request-body req) out (current-error-port)
+          (^[] (apply cgi-main proc :merge-cookies merge-cookies
+                      :part-handlers part-handlers
+                      (if on-error `(:on-error ,on-error) '())))))
+      (receive (status headers body) (parse-cgi-output (get-output-string out))
+        (http-respond req status headers body)))))
+
+(define (request-metavariables req)
+  (define (hdr->meta h)
+    `(,(string-append "HTTP_" (string-upcase (regexp-replace-all #/-/ (car h) "_")))
+      ,(cadr h)))
+  (let ([hdrs (http-request-headers req)]
+        [addr (http-request-remote-address req)])
+    `(("REQUEST_METHOD" ,(http-request-method req))
+      ("SERVER_PROTOCOL" ,(http-request-version req))
+      ("SERVER_SOFTWARE" ,#"Gauche/~(gauche-version)")
+      ("GATEWAY_INTERFACE" "CGI/1.1")
+      ("SERVER_NAME" ,(car (string-split (http-request-header req "host"
+                                                                "localhost")
+                                          #\:)))
+      ("SERVER_PORT" ,(x->string (http-server-port (request-server req))))
+      ("SCRIPT_NAME" "")
+      ("PATH_INFO" ,(uri-decode-string (http-request-path req)))
+      ("QUERY_STRING" ,(or (http-request-query req) ""))
+      ("REMOTE_ADDR" ,(remote-address-string addr))
+      ,@(cond-list [(http-request-header req "content-type")
+                    => (^v `("CONTENT_TYPE" ,v))]
+                   [(http-request-header req "content-length")
+                    => (^v `("CONTENT_LENGTH" ,v))])
+      ,@(map hdr->meta hdrs))))
+
+(define (remote-address-string addr)
+  (case (sockaddr-family addr)
+    [(inet)  (inet-address->string (sockaddr-addr addr) AF_INET)]
+    [(inet6) (inet-address->string (sockaddr-addr addr) AF_INET6)]
+    [else "127.0.0.1"]))
+
+;; Splits CGI output into status, headers and body.
+(define (parse-cgi-output output)
+  (receive (head body) (if-let1 m (#/\r?\n\r?\n/ output)
+                         (values (m 'before) (m 'after))
+                         (values output ""))
+    (let* ([hdrs (rfc822-read-headers (open-input-string #"~|head|\n\n")
+                                      :strict? #f)]
+           [status (cond [(rfc822-header-ref hdrs "status")
+                          => (^s (x->integer (car (string-split s #\space))))]
+                         [(rfc822-header-ref hdrs "location") 302]
+                         [else 200])])
+      (values status
+              (remove (^h (equal? (car h) "status")) hdrs)
+              body))))
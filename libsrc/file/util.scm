@@ -44,6 +44,7 @@
   (use util.match)
   (use gauche.parameter)
   (export current-directory directory-list directory-list2 directory-fold
+          directory-generator
           home-directory temporary-directory
           make-directory* create-directory* remove-directory* delete-directory*
           copy-directory*
@@ -160,26 +161,64 @@
       (partition selector (map (cut build-path dir <>) entries))
       (partition (^e (selector (build-path dir e))) entries))))
 
-;; directory-fold DIR PROC KNIL &keyword LISTER FOLDER FOLLOW-LINK?
+;; The native directory walker (walk.c).  It reads directories with
+;; readdir and uses d_type to find subdirectories, stat'ing entries
+;; only when needed, and hands out the files one at a time.
+(inline-stub
+ (declcode "#include \"walk.h\"")
+
+ (define-cproc %make-directory-walker (root::<string> follow-link::<boolean>
+                                       sorted::<boolean> nthreads::<int>)
+   (return (Scm_MakeDirectoryWalker root follow-link sorted nthreads)))
+ )
+
+(define (%walker-threads parallel)
+  (cond [(not parallel) 0]
+        [(eq? parallel #t) (max (sys-available-processors) 1)]
+        [(and (exact-integer? parallel) (positive? parallel)) parallel]
+        [else (error "parallel must be a boolean or a positive exact integer, \
+                      but got:" parallel)]))
+
+(define (%directory? path follow-link?)
+  (and (file-exists? path)
+       (eq? (slot-ref (%stat path follow-link?) 'type) 'directory)))
+
+;; directory-fold DIR PROC KNIL &keyword LISTER FOLDER FOLLOW-LINK? PARALLEL
+;;  Without LISTER and FOLDER, we use the native walker.
 (define (directory-fold dir proc knil
-                        :key (lister (lambda (path knil)
-                                       (values (directory-list path
-                                                               :add-path? #t
-                                                               :children? #t)
-                                               knil)))
-                             (folder fold)
-                             (follow-link? #t))
-  (define (selector e)
-    (and (file-exists? e)
-         (eq? (slot-ref (%stat e follow-link?) 'type) 'directory)))
+                        :key (lister #f) (folder #f)
+                             (follow-link? #t) (parallel #f))
+  (define (selector e) (%directory? e follow-link?))
   (define (rec path knil)
     (if (selector path)
       ;; [TODO]: For the backward compatibiliy, we allow LISTER to return
       ;; only a single value.  Should be removed, probably in 0.9.
-      (receive res (lister path knil)
-        (folder rec (get-optional (cdr res) knil) (car res)))
+      (receive res ((or lister default-lister) path knil)
+        ((or folder fold) rec (get-optional (cdr res) knil) (car res)))
       (proc path knil)))
-  (rec dir knil))
+  (define (default-lister path knil)
+    (values (directory-list path :add-path? #t :children? #t) knil))
+  (define walker
+    (and (not lister) (not folder) (selector dir)
+         (%make-directory-walker dir follow-link? (not parallel)
+                                 (%walker-threads parallel))))
+  (if walker
+    (let loop ([knil knil])
+      (let1 path (walker)
+        (if (eof-object? path)
+          knil
+          (loop (proc path knil)))))
+    (rec dir knil)))
+
+;; directory-generator DIR &keyword FOLLOW-LINK? PARALLEL
+;;  Returns a generator of the pathnames directory-fold would pass to PROC.
+(define (directory-generator dir :key (follow-link? #t) (parallel #f))
+  (or (and (%directory? dir follow-link?)
+           (%make-directory-walker dir follow-link? (not parallel)
+                                   (%walker-threads parallel)))
+      (let1 paths (reverse (directory-fold dir cons '()
+                                           :follow-link? follow-link?))
+        (^[] (if (null? paths) (eof-object) (pop! paths))))))
 
 ;; mkdir -p
 (define (make-directory* dir :optional (mode #o755))
@@ -56,7 +56,7 @@
           gmap gmap-accum gfilter gremove gdelete gdelete-neighbor-dups
           gfilter-map gstate-filter gbuffer-filter
           gtake gtake* gdrop gtake-while gdrop-while grxmatch gslices
-          glet* glet1 do-generator
+          glet* glet1 do-generator generator-pipeline
 
           ;; srfi-121 compatibility
           generator make-iota-generator make-range-generator
@@ -703,6 +703,182 @@
 (define (generator-unfold gen unfold . args)
   (apply unfold eof-object? identity (^_ (gen)) (gen) args))
 
+;; (generator-pipeline source stage ...)
+;;   Fuses a chain of standard combinators into a single generator.
+;;   It is equivalent to nesting the combinators, e.g.
+;;     (generator-pipeline gen (gfilter odd?) (gmap square) (gtake 5))
+;;   works like (gtake (gmap square (gfilter odd? gen)) 5), but no
+;;   intermediate generators are created; each element is pulled from
+;;   the source and passed through the stages within one loop.
+;;   A stage can be one of:
+;;     (gmap proc) (gfilter pred) (gremove pred) (gfilter-map proc)
+;;     (gtake n) (gdrop n) (gtake-while pred) (gdrop-while pred)
+;;     (gconcatenate)
+;;   SOURCE can be (gunfold stop? mapper successor seed), which is also
+;;   fused; other expressions are coerced to a generator as the other
+;;   combinators do.  The source and stage arguments are evaluated once,
+;;   from left to right, when the pipeline is created.
+;;
+;;   The expansion consists of one 'segment' per gconcatenate, plus one.
+;;   Segment 0 pulls from the source, and segment k pulls from the inner
+;;   generator it took from the output of segment k-1.  Each segment
+;;   has a flag set when it is exhausted (or cut by gtake/gtake-while),
+;;   so that the upstream isn't pulled once the result is known.
+(define-syntax generator-pipeline
+  (er-macro-transformer
+   (^[f r c]
+     (define kinds '((gmap . map) (gfilter . filter) (gremove . remove)
+                     (gfilter-map . filter-map) (gtake . take) (gdrop . drop)
+                     (gtake-while . take-while) (gdrop-while . drop-while)))
+     ;; Returns (kind arg-var state-var), pushing bindings.
+     (define bindings '())
+     (define (bind! var init) (push! bindings (list var init)))
+     (define (parse-stage s)
+       (define (kind? name) (c (car s) (r name)))
+       (cond [(not (and (pair? s) (list? s)))
+              (error "malformed generator-pipeline stage:" s)]
+             [(kind? 'gconcatenate)
+              (unless (null? (cdr s))
+                (error "gconcatenate in generator-pipeline takes no \
+                        arguments:" s))
+              '(concatenate)]
+             [(find (^k (kind? (car k))) kinds)
+              => (^k (unless (= (length s) 2)
+                       (error "generator-pipeline stage needs exactly one \
+                               argument:" s))
+                     (let ([arg (gensym)] [state (gensym)])
+                       (bind! arg (cadr s))
+                       (case (cdr k)
+                         [(take drop) (bind! state 0)]
+                         [(drop-while) (bind! state #t)])
+                       (list (cdr k) arg state)))]
+             [else
+              (error "unsupported generator-pipeline stage:" s)]))
+     ;; Splits the list of parsed stages at each concatenate.
+     (define (split-segments stages)
+       (let loop ([stages stages] [seg '()] [segs '()])
+         (cond [(null? stages) (reverse (cons (reverse seg) segs))]
+               [(eq? (caar stages) 'concatenate)
+                (loop (cdr stages) '() (cons (reverse seg) segs))]
+               [else (loop (cdr stages) (cons (car stages) seg) segs)])))
+     ;; Code to pass X through STAGES.  FIN is the segment's flag.
+     ;; A skipped element makes the segment pull the next one.
+     (define (gen-stages stages x fin)
+       (if (null? stages)
+         x
+         (let ([rest (cdr stages)]
+               [arg (cadar stages)]
+               [state (caddar stages)])
+           (ecase (caar stages)
+             [(map)
+              (let1 y (gensym)
+                (quasirename r
+                  (let ((,y (,arg ,x))) ,(gen-stages rest y fin))))]
+             [(filter)
+              (quasirename r
+                (if (,arg ,x) ,(gen-stages rest x fin) (loop)))]
+             [(remove)
+              (quasirename r
+                (if (,arg ,x) (loop) ,(gen-stages rest x fin)))]
+             [(filter-map)
+              (let1 y (gensym)
+                (quasirename r
+                  (let ((,y (,arg ,x)))
+                    (if ,y ,(gen-stages rest y fin) (loop)))))]
+             [(take)
+              (quasirename r
+                (begin (set! ,state (+ ,state 1))
+                       (if (>= ,state ,arg) (set! ,fin #t))
+                       ,(gen-stages rest x fin)))]
+             [(drop)
+              (quasirename r
+                (if (< ,state ,arg)
+                  (begin (set! ,state (+ ,state 1)) (loop))
+                  ,(gen-stages rest x fin)))]
+             [(take-while)
+              (quasirename r
+                (if (,arg ,x)
+                  ,(gen-stages rest x fin)
+                  (begin (set! ,fin #t) (eof-object))))]
+             [(drop-while)
+              (quasirename r
+                (if (and ,state (,arg ,x))
+                  (loop)
+                  (begin (set! ,state #f) ,(gen-stages rest x fin))))]))))
+     ;; Code to fetch the input of a segment.
+     (define (gunfold-source? src)
+       (and (pair? src) (c (car src) (r 'gunfold))
+            (list? src) (= (length src) 5)))
+     (define (gen-source src)
+       (if (gunfold-source? src)
+         (let ([p (gensym)] [m (gensym)] [g (gensym)] [seed (gensym)])
+           (for-each bind! (list p m g seed) (cdr src))
+           (quasirename r
+             (if (,p ,seed)
+               (eof-object)
+               (let ((v (,m ,seed))) (set! ,seed (,g ,seed)) v))))
+         (let1 gen (gensym)
+           (bind! gen (quasirename r (%->gen ,src)))
+           `(,gen))))
+     (define (gen-inner inner upstream)
+       (quasirename r
+         (let loop ()
+           (cond [(eof-object? ,inner) ,inner]
+                 [(not ,inner)
+                  (let ((g (,upstream)))
+                    (set! ,inner (if (eof-object? g) g (%->gen g)))
+                    (loop))]
+                 [else (let ((v (,inner)))
+                         (if (eof-object? v)
+                           (begin (set! ,inner #f) (loop))
+                           v))]))))
+     (define (gen-segment input stages fin)
+       (let1 x (gensym)
+         (quasirename r
+           (lambda ()
+             (let loop ()
+               (if ,fin
+                 (eof-object)
+                 (let ((,x ,input))
+                   (if (eof-object? ,x)
+                     (begin (set! ,fin #t) ,x)
+                     ,(gen-stages stages x fin)))))))))
+
+     (unless (and (pair? (cdr f)) (list? (cddr f)))
+       (error "malformed generator-pipeline:" f))
+     (let* ([input0 (gen-source (cadr f))]
+            [segs (split-segments (map parse-stage (cddr f)))]
+            [fins (map (^_ (gensym)) segs)]
+            [pulls (map (^_ (gensym)) segs)])
+       (for-each (^[fin] (bind! fin #f)) fins)
+       (let1 procs
+           (let loop ([segs segs] [fins fins] [pulls pulls]
+                      [input input0] [upstream #f] [acc '()])
+             (if (null? segs)
+               (reverse acc)
+               (let ([inner (gensym)] [next (gensym)])
+                 (when upstream (bind! inner #f))
+                 (loop (cdr segs) (cdr fins) (cdr pulls)
+                       `(,next) (car pulls)
+                       `(,@(if upstream
+                             `((,(car input)
+                                  (,(r 'lambda) () ,(gen-inner inner upstream))))
+                             '())
+                         (,(car pulls) ,(gen-segment input (car segs) (car fins)))
+                         ,@acc)))))
+         (quasirename r
+           (let* ,(reverse bindings)
+             (letrec ,procs
+               ,@(append-map
+                  (^[seg fin]
+                    (filter-map (^[st] (and (eq? (car st) 'take)
+                                           (quasirename r
+                                             (if (<= ,(cadr st) 0)
+                                               (set! ,fin #t)))))
+                                seg))
+                  segs fins)
+               ,(last pulls)))))))))
+
 ;; srfi-121 compatibility aliases
 ;; NB: We're not sure if we should put them here, or split them to
 ;; srfi-121 module.
@@ -52,6 +52,9 @@
    (restorer)                           ;used to restore previous value
    (pre-observers)
    (post-observers)
+   (index)                              ;index to the VM parameter table
+   (initial)                            ;initial value (filtered)
+   (observed :init-value #f)            ;#t once a hook is created
    ))
 
 (define-method initialize ((self <parameter>) initargs)
@@ -64,6 +67,8 @@
          [index ((with-module gauche.internal %vm-make-parameter-slot))]
          [%ref  (with-module gauche.internal %vm-parameter-ref)]
          [%set! (with-module gauche.internal %vm-parameter-set!)])
+    (slot-set! self 'index index)
+    (slot-set! self 'initial init-value)
     (slot-set! self 'getter (^() (%ref index init-value)))
     (slot-set! self 'setter
                (if filter
@@ -84,6 +89,7 @@
     (let-syntax ([hook-ref
                   (syntax-rules ()
                     [(_ var) (^() (or var (rlet1 h (make-hook 2)
+                                            (slot-set! self 'observed #t)
                                             (set! var h))))])])
       (slot-set! self 'pre-observers (hook-ref pre-hook))
       (slot-set! self 'post-observers (hook-ref post-hook)))
@@ -114,30 +120,32 @@
 (define-syntax parameterize
   (syntax-rules ()
     [(_ () . body) (begin . body)]
-    [(_ ((param val)) . body)
-     (let ([P param] [V val] [restarted #f])
-       (dynamic-wind
-         (^[] (if restarted
-                (set! V (%restore-parameter P V))
-                (set! V (P V))))
-         (^[] . body)
-         (^[] (set! restarted #t)
-              (set! V (%restore-parameter P V)))))]
     [(_ ((param val) ...) . body)
-     (let ([P (list param ...)]
-           [S '()]                      ;saved values
-           [restarted #f])
-       (dynamic-wind
-         (^[] (if restarted
-                (set! S (map (^[p v] (%restore-parameter p v)) P S))
-                (set! S (map (^[p] (p)) P))))
-         (^[] (unless restarted
-                (set! S (map (^[p v] (p v)) P (list val ...))))
-           . body)
-         (^[] (set! restarted #t)
-              (set! S (map (^[p v] (%restore-parameter p v)) P S)))))]
+     (%parameterize (list param ...) (list val ...) (^[] . body))]
     [(_ . x) (syntax-rules "Invalid parameterize form:" (parameterize . x))]))
 
+;; If all parameters are <parameter>s without observers, we apply the
+;; filters here and let the VM swap the values directly, avoiding
+;; closure allocation.  Otherwise, we go through the setter and the
+;; restorer of each parameter so that the observers are called.
+(define (%parameterize params vals thunk)
+  (if (every (^p (and (is-a? p <parameter>) (not (slot-ref p 'observed))))
+             params)
+    ((with-module gauche.internal %vm-parameterize)
+     (map (^p (slot-ref p 'index)) params)
+     (map (^p (slot-ref p 'initial)) params)
+     (map (^[p v] (if-let1 f (slot-ref p 'filter) (f v) v)) params vals)
+     thunk)
+    (let ([S '()]                       ;saved values
+          [restarted #f])
+      (dynamic-wind
+        (^[] (if restarted
+               (set! S (map (^[p v] (%restore-parameter p v)) params S))
+               (set! S (map (^[p v] (p v)) params vals))))
+        thunk
+        (^[] (set! restarted #t)
+             (set! S (map (^[p v] (%restore-parameter p v)) params S)))))))
+
 ;; hooks
 
 (define-method parameter-pre-observers ((self <parameter>))
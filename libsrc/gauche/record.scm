@@ -91,7 +91,12 @@
 ;;;
 
 (define-class <record-meta> (<class>)
-  ((field-specs :init-keyword :field-specs :init-value '#())))
+  ((field-specs :init-keyword :field-specs :init-value '#())
+   ;; Typed fields, including inherited ones; a vector of
+   ;; #(index type-code flonum-offset name).  See %record-unbox-fields!
+   ;; in libobj.scm.
+   (typed-fields :init-value '#())
+   (num-flonums  :init-value 0)))
 (define-class <record> () () :metaclass <record-meta>)
 
 (define-class <pseudo-record-meta> (<record-meta>)
@@ -134,21 +139,59 @@
   (fold (^[c r] (append (slot-ref c'direct-slots) r))
         '() (reverse (slot-ref class'cpl))))
 
+(define-macro (%ref) '(with-module gauche.object %record-ref))
+(define-macro (%set) '(with-module gauche.object %record-set!))
+
+;; Field types.  The position in the list is the type code passed to
+;; %record-unbox-fields!.  Fixnum and u8 values are immediate, so they're
+;; just checked.  Flonum fields are kept in an f64vector shared by all
+;; the flonum fields of the instance, so setting them doesn't allocate.
+(define *field-types* '(fixnum u8 flonum))
+
+(define (%check-field-value rtd field type v)
+  (if (case type
+        [(fixnum) (fixnum? v)]
+        [(u8)     (and (fixnum? v) (>= v 0) (< v 256))]
+        [(flonum) (real? v)]
+        [else #t])
+    v
+    (errorf "~a required for field ~a of ~s, but got ~s" type field rtd v)))
+
 (define-method compute-get-n-set ((class <record-meta>) slot)
   ;; trick: we let (next-method) adjust the instance slot count, but
   ;; we uses :index option of the slot to determine the actual slot number.
   (next-method)
-  (let1 s
-      (compute-slot-accessor class slot (slot-definition-option slot :index))
-    (if (slot-definition-option slot :immutable #f)
-      `(,(^o (slot-ref-using-accessor o s))
-        ,(^[o v] (errorf "slot ~a of ~a is immutable"
-                         (slot-definition-name slot) o))
-        ,(^o (slot-bound-using-accessor? o s)))
-      s)))
+  (let* ([k (slot-definition-option slot :index)]
+         [s (compute-slot-accessor class slot k)]
+         [name (slot-definition-name slot)]
+         [type (slot-definition-option slot :field-type #f)]
+         [ro (and (slot-definition-option slot :immutable #f)
+                  (^[o v] (errorf "slot ~a of ~a is immutable" name o)))])
+    (case type
+      [(flonum)
+       (let1 off (slot-definition-option slot :flonum-offset)
+         `(,(^o (f64vector-ref ((%ref) class o k) off))
+           ,(or ro
+                (^[o v] (f64vector-set! ((%ref) class o k) off
+                                        (%check-field-value class name
+                                                            type v))))
+           ,(^o (slot-bound-using-accessor? o s))))]
+      [(fixnum u8)
+       `(,(^o (slot-ref-using-accessor o s))
+         ,(or ro
+              (^[o v] (slot-set-using-accessor!
+                       o s (%check-field-value class name type v))))
+         ,(^o (slot-bound-using-accessor? o s)))]
+      [else
+       (if ro
+         `(,(^o (slot-ref-using-accessor o s))
+           ,ro
+           ,(^o (slot-bound-using-accessor? o s)))
+         s)])))
 
 (define (%valid-fieldspecs? specs signal-error?)
   (define (id? x) (or (symbol? x) (identifier? x)))
+  (define (type? x) (memq (unwrap-syntax x) *field-types*))
   (if (not (vector? specs))
     (if signal-error?
       (error "make-rtd: fieldspecs must be a vector, but got" specs)
@@ -156,24 +199,63 @@
     (every (^[spec]
              (match spec
                [((or 'mutable 'immutable) (? id? name)) #t]
+               [((or 'mutable 'immutable) (? id? name) (? type?)) #t]
                [(? id? name) #t]
                [other (if signal-error?
                         (error "make-rtd: invalid field spec:" other)
                         #f)]))
            (vector->list specs)))) ;; efficiency?
 
-(define (fieldspecs->slotspecs specs offset)
+;; Returns a list of slot specs.  OFFSET is the number of inherited slots,
+;; and FLO-OFFSET is the number of inherited flonum fields.
+(define (fieldspecs->slotspecs specs offset flo-offset)
+  (define flo flo-offset)
+  (define (typed name opts type)
+    (case type
+      [(#f) `(,name ,@opts)]
+      [(flonum) (begin0 `(,name ,@opts :field-type flonum
+                                :flonum-offset ,flo)
+                  (inc! flo))]
+      [else `(,name ,@opts :field-type ,type)]))
   (%valid-fieldspecs? specs #t)
   (map-with-index
    (^[k spec]
      (match spec
-       [('mutable   name)
-        `(,(unwrap-syntax name) :index ,(+ k offset))]
-       [('immutable name)
-        `(,(unwrap-syntax name) :immutable #t :index ,(+ k offset))]
+       [('mutable   name . type)
+        (typed (unwrap-syntax name) `(:index ,(+ k offset))
+               (and (pair? type) (unwrap-syntax (car type))))]
+       [('immutable name . type)
+        (typed (unwrap-syntax name) `(:immutable #t :index ,(+ k offset))
+               (and (pair? type) (unwrap-syntax (car type))))]
        [name `(,(unwrap-syntax name) :index ,(+ k offset))]))
    specs))
 
+;; Collects the typed fields from the slot specs, appending them to
+;; the parent's.
+(define (%setup-typed-fields! rtd parent slotspecs)
+  (let1 own (filter-map
+             (^[spec]
+               (and-let1 type (get-keyword :field-type (cdr spec) #f)
+                 (vector (get-keyword :index (cdr spec))
+                         (list-index (cut eq? type <>) *field-types*)
+                         (get-keyword :flonum-offset (cdr spec) 0)
+                         (car spec))))
+             slotspecs)
+    (slot-set! rtd 'typed-fields
+               (vector-append (if parent (slot-ref parent 'typed-fields) '#())
+                              (list->vector own)))
+    (slot-set! rtd 'num-flonums
+               (+ (if parent (slot-ref parent 'num-flonums) 0)
+                  (count (^v (eq? (vector-ref v 1) 2)) own)))))
+
+(define (%typed-rtd? rtd)
+  (not (zero? (vector-length (slot-ref rtd 'typed-fields)))))
+
+(define-inline (%unbox! rtd obj)
+  ((with-module gauche.object %record-unbox-fields!)
+   obj (slot-ref rtd 'typed-fields) (slot-ref rtd 'num-flonums))
+  obj)
+
 (define (%check-rtd obj)
   (unless (rtd? obj) (error "rtd required, bot got" obj)))
 
@@ -219,11 +301,19 @@
 ;;;
 
 (define (make-rtd name fieldspecs :optional (parent #f) :rest opts)
-  (make (if parent (class-of parent) <record-meta>)
-    :name name :field-specs fieldspecs :metaclass <record-meta>
-    :supers (list (or parent <record>))
-    :slots ($ fieldspecs->slotspecs fieldspecs
-              $ if parent (length (class-slots parent)) 0)))
+  (let* ([slotspecs (fieldspecs->slotspecs
+                     fieldspecs
+                     (if parent (length (class-slots parent)) 0)
+                     (if parent (slot-ref parent 'num-flonums) 0))]
+         [rtd (make (if parent (class-of parent) <record-meta>)
+                :name name :field-specs fieldspecs :metaclass <record-meta>
+                :supers (list (or parent <record>))
+                :slots slotspecs)])
+    (when (and (is-a? rtd <pseudo-record-meta>)
+               (any (cut get-keyword :field-type <> #f) (map cdr slotspecs)))
+      (error "make-rtd: pseudo records can't have typed fields:" fieldspecs))
+    (%setup-typed-fields! rtd parent slotspecs)
+    rtd))
 
 (define (rtd? obj) (is-a? obj <record-meta>))
 
@@ -274,6 +364,11 @@
   `(apply (%make) ,rtd ,@(cdr tmps) ,(car tmps))
   `((%makev) ,rtd ,argv))
 
+(define-ctor-generators %typed-record-ctor
+  `(%unbox! ,rtd ((%make) ,rtd ,@vars))
+  `(%unbox! ,rtd (apply (%make) ,rtd ,@(cdr tmps) ,(car tmps)))
+  `(%unbox! ,rtd ((%makev) ,rtd ,argv)))
+
 (define (vector->vector x) x)
 
 (for-each-subst
@@ -310,36 +405,84 @@
             (slot-definition-option s :immutable #f))
     (errorf "record ~s does not have a slot named ~s" rtd field)))
 
-(define-macro (define-rtd-methods rtd-meta ctor-name-base referencer* mutator*)
-  (define gen-default-ctor (sym+ ctor-name-base '-default))
-  (define gen-custom-ctor  (sym+ ctor-name-base '-custom))
+;; Returns the field offset in the shared f64vector, or #f if FIELD
+;; isn't a flonum field.
+(define (%flonum-offset rtd field)
+  (and-let* ([s (assq field (class-slots rtd))])
+    (slot-definition-option s :flonum-offset #f)))
+
+;; Accessor and mutator of typed fields.  They return #f if FIELD
+;; is untyped.
+(define (%typed-accessor rtd field k immutable?)
+  (and-let* ([s (assq field (class-slots rtd))]
+             [type (slot-definition-option s :field-type #f)])
+    (let1 get (if-let1 off (%flonum-offset rtd field)
+                (^o (f64vector-ref ((%ref) rtd o k) off))
+                (^o ((%ref) rtd o k)))
+      (if immutable?
+        get
+        (getter-with-setter get (%typed-mutator rtd field k))))))
+
+(define (%typed-mutator rtd field k)
+  (and-let* ([s (assq field (class-slots rtd))]
+             [type (slot-definition-option s :field-type #f)])
+    (if-let1 off (%flonum-offset rtd field)
+      (^[o v] (f64vector-set! ((%ref) rtd o k) off v))
+      (^[o v] ((%set) rtd o k (%check-field-value rtd field type v))))))
+
+;; If TYPED-CTOR-NAME-BASE is given, the rtds of RTD-META may have typed
+;; fields, and the constructors for them are generated by it.
+(define-macro (define-rtd-methods rtd-meta ctor-name-base referencer* mutator*
+                . typed-ctor-name-base)
+  (define typed? (pair? typed-ctor-name-base))
+  (define (gen-ctor suffix . args)
+    (if typed?
+      `(if (%typed-rtd? rtd)
+         (,(sym+ (car typed-ctor-name-base) suffix) ,@args)
+         (,(sym+ ctor-name-base suffix) ,@args))
+      `(,(sym+ ctor-name-base suffix) ,@args)))
+  (define (or-typed typed-expr expr)
+    (if typed? `(or ,typed-expr ,expr) expr))
   `(begin
      (define-method %rtd-constructor ((rtd ,rtd-meta) . rest)
        (%check-rtd rtd)
        (if (null? rest)
-         (,gen-default-ctor rtd (length (slot-ref rtd'slots)))
+         ,(gen-ctor '-default 'rtd '(length (slot-ref rtd'slots)))
          (let1 all-names (rtd-all-field-names rtd)
            (let ([mapvec  (%calculate-field-mapvec all-names (car rest))]
                  [nfields (vector-length all-names)])
-             (,gen-custom-ctor rtd (vector-length (car rest)))))))
+             ,(gen-ctor '-custom 'rtd '(vector-length (car rest)))))))
      (define-method %rtd-accessor ((rtd ,rtd-meta) field)
        (receive (k immutable?) (%get-slot-index rtd field #f)
-         (if immutable?
-           (^o (,@referencer* o k))
-           (getter-with-setter
-            (^o (,@referencer* o k))
-            (^(o v) (,@mutator* o k v))))))
+         ,(or-typed
+           '(%typed-accessor rtd field k immutable?)
+           `(if immutable?
+              (^o (,@referencer* o k))
+              (getter-with-setter
+               (^o (,@referencer* o k))
+               (^(o v) (,@mutator* o k v)))))))
      (define-method %rtd-mutator ((rtd ,rtd-meta) field)
        (receive (k immutable?) (%get-slot-index rtd field #t)
          (when immutable?
            (errorf "slot ~a of record ~s is immutable" field rtd))
-         (^(o v) (,@mutator* o k v))))
+         ,(or-typed
+           '(%typed-mutator rtd field k)
+           `(^(o v) (,@mutator* o k v)))))
      ))
-  
+
 (define-rtd-methods <record-meta>
   %record-ctor
-  ((with-module gauche.object %record-ref) rtd)
-  ((with-module gauche.object %record-set!) rtd))
+  ((%ref) rtd)
+  ((%set) rtd)
+  %typed-record-ctor)
+
+;; Used by the accessors and modifiers generated by define-record-type.
+;; Returns the slot index of FIELD in RTD if RTD is an ordinary record
+;; type, or #f if it is a pseudo record type (or some other subclass
+;; of <record-meta>), for which the generic accessors should be used.
+(define (%record-field-index rtd field)
+  (receive (k immutable?) (%get-slot-index rtd field #f)
+    (and (eq? (class-of rtd) <record-meta>) k)))
 
 (for-each-subst
  (list vector u8vector s8vector u16vector s16vector u32vector s32vector
@@ -359,6 +502,12 @@
 ;;; Syntactic layer
 ;;;
 
+;; If the record type doesn't have a parent, we know the slot index
+;; of each field at the expansion time, so the accessors and modifiers
+;; become inlinable procedures that load or store the slot directly.
+;; With a parent, the index is looked up once when the record type
+;; is defined; if the parent turns out to be a pseudo record type,
+;; the generic accessor is used instead.
 (define-macro (define-record-type type-spec ctor-spec pred-spec . field-specs)
   (define (->id x) ((with-module gauche.internal make-identifier) x
                     (find-module 'gauche.record) '()))
@@ -369,18 +518,51 @@
   (define %asor (->id 'rtd-accessor))
   (define %mtor (->id 'rtd-mutator))
   (define %define-inline (->id 'define-inline))
+  (define %lambda (->id 'lambda))
+  (define %let    (->id 'let))
+  (define %if     (->id 'if))
+  (define %and    (->id 'and))
+  (define %set!   (->id 'set!))
+  (define %setter (->id 'setter))
+  (define %index  (->id '%record-field-index))
+  (define %offset (->id '%flonum-offset))
+  (define %check  (->id '%check-field-value))
+  (define %ref `(,(->id 'with-module) gauche.object %record-ref))
+  (define %set `(,(->id 'with-module) gauche.object %record-set!))
   (define tmp   (gensym))
-  (define (build-field-spec)
+
+  ;; Each field is parsed into (name type accessor modifier mutable?).
+  ;; The field name may be (name type) to declare the field type.
+  (define (parse-field typename spec)
+    (define (name+type f)
+      (match f
+        [(? id? f) (values f #f)]
+        [((? id? f) (? id? t))
+         (let1 t (unwrap-syntax t)
+           (unless (memq t *field-types*)
+             (error "invalid field type:" t))
+           (values f t))]
+        [_ (error "invalid field spec:" spec)]))
+    (match spec
+      [(f a m) (receive (n t) (name+type f) (list n t a m #t))]
+      [(f a)   (receive (n t) (name+type f) (list n t a #f #f))]
+      [(f)     (receive (n t) (name+type f)
+                 (list n t (sym+ typename '- n) (sym+ typename '- n '-set!)
+                       #t))]
+      [(? id? f) (list f #f (sym+ typename '- f) #f #f)]
+      [x (error "invalid field spec:" x)]))
+
+  (define (build-field-spec fields)
     (map-to <vector> (match-lambda
-                       [((? id? f) a s) f]
-                       [((? id? f) a) `(immutable ,f)]
-                       [((? id? f)) f]
-                       [(? id? f) `(immutable ,f)]
-                       [x (error "invalid field spec:" x)])
-            field-specs))
-  (define (build-def typename parent)
+                       [(n #f _ _ #t) n]
+                       [(n t _ _ #t) `(mutable ,n ,t)]
+                       [(n #f _ _ #f) `(immutable ,n)]
+                       [(n t _ _ #f) `(immutable ,n ,t)])
+            fields))
+  (define (build-def typename parent fields)
     `(,%define-inline ,typename
-       (,%make ',typename ',(build-field-spec) ,@(if parent `(,parent) '()))))
+       (,%make ',typename ',(build-field-spec fields)
+               ,@(if parent `(,parent) '()))))
   (define (build-ctor typename)
     (match ctor-spec
       [#f '()]
@@ -398,29 +580,76 @@
       [(? id? pred-name)
        `((,%define-inline (,pred-name ,tmp) ((,%pred ,typename) ,tmp)))]
       [x (error "invalid predicate spec" pred-spec)]))
-  (define (build-accessors typename)
-    (map (match-lambda
-           [(f a . _) `(,%define-inline ,a (,%asor ,typename ',f))]
-           [(f)       `(,%define-inline ,(sym+ typename '- f)
-                         (,%asor ,typename ',f))]
-           [f         `(,%define-inline ,(sym+ typename '- f)
-                         (,%asor ,typename ',f))])
-         field-specs))
-  (define (build-mutators typename)
-    (append-map (match-lambda
-                  [(f a m) `((,%define-inline ,m (,%mtor ,typename ',f)))]
-                  [(f)     `((,%define-inline ,(sym+ typename '- f '-set!)
-                               (,%mtor ,typename ',f)))]
-                  [_ '()])
-                field-specs))
+
+  ;; Expressions to load and store the field value.
+  (define (ref-expr typename type o k off)
+    (if (eq? type 'flonum)
+      `(,(->id 'f64vector-ref) (,%ref ,typename ,o ,k) ,off)
+      `(,%ref ,typename ,o ,k)))
+  (define (set-expr typename name type o k off v)
+    (define (checked test)
+      `(,%if ,test ,v (,%check ,typename ',(unwrap-syntax name) ',type ,v)))
+    (case type
+      [(flonum) `(,(->id 'f64vector-set!) (,%ref ,typename ,o ,k) ,off ,v)]
+      [(fixnum) `(,%set ,typename ,o ,k ,(checked `(,(->id 'fixnum?) ,v)))]
+      [(u8)     `(,%set ,typename ,o ,k
+                        ,(checked `(,%and (,(->id 'fixnum?) ,v)
+                                          (,(->id '>=) ,v 0)
+                                          (,(->id '<) ,v 256))))]
+      [else     `(,%set ,typename ,o ,k ,v)]))
+
+  ;; Generates an inlinable procedure definition.  ARGS are the arguments
+  ;; of the procedure, with the record at the first, and GEN takes the
+  ;; slot index and the flonum offset and returns the body.
+  ;; FALLBACK is used when the index can't be known (see above).
+  (define (build-inline typename parent fields field name type args
+                        gen fallback)
+    (if parent
+      (let ([k (gensym)] [off (gensym)] [g (gensym)])
+        `(,%define-inline ,name
+           (,%let ([,k (,%index ,typename ',(unwrap-syntax field))]
+                   ,@(if (eq? type 'flonum)
+                       `([,off (,%offset ,typename ',(unwrap-syntax field))])
+                       '())
+                   [,g ,fallback])
+             (,%lambda ,args (,%if ,k ,(gen k off) (,g ,@args))))))
+      (let* ([names (map (^f (unwrap-syntax (car f))) fields)]
+             [k (list-index (cute eq? (unwrap-syntax field) <>) names)]
+             [off (count (^f (eq? (cadr f) 'flonum)) (take fields k))])
+        `(,%define-inline (,name ,@args) ,(gen k off)))))
+
+  (define (build-accessors typename parent fields)
+    (append-map
+     (match-lambda
+       [(n t a m mutable?)
+        (let1 o (gensym)
+          `(,(build-inline typename parent fields n a t (list o)
+                           (cut ref-expr typename t o <> <>)
+                           `(,%asor ,typename ',(unwrap-syntax n)))
+            ,@(if mutable?
+                `((,%set! (,%setter ,a)
+                          (,%mtor ,typename ',(unwrap-syntax n))))
+                '())))])
+     fields))
+  (define (build-mutators typename parent fields)
+    (append-map
+     (match-lambda
+       [(n t a #f _) '()]
+       [(n t a m _)
+        (let ([o (gensym)] [v (gensym)])
+          `(,(build-inline typename parent fields n m t (list o v)
+                           (cut set-expr typename n t o <> <> v)
+                           `(,%mtor ,typename ',(unwrap-syntax n)))))])
+     fields))
 
   (receive (typename parent) (match type-spec
                                [((? id? name) parent) (values name parent)]
                                [(? id? name) (values name #f)]
                                [x (error "invalid type-spec" type-spec)])
-    `(begin ,(build-def typename parent)
-            ,@(build-ctor typename)
-            ,@(build-pred typename)
-            ,@(build-accessors typename)
-            ,@(build-mutators typename)))
+    (let1 fields (map (cut parse-field typename <>) field-specs)
+      `(begin ,(build-def typename parent fields)
+              ,@(build-ctor typename)
+              ,@(build-pred typename)
+              ,@(build-accessors typename parent fields)
+              ,@(build-mutators typename parent fields))))
     )
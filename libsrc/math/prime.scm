@@ -39,90 +39,101 @@
   (use gauche.generator)
   (use gauche.sequence)
   (use gauche.threads)
-  (use data.sparse)
-  (use util.match)
-  (export primes *primes* reset-primes
+  (autoload data.sparse make-sparse-vector
+                        sparse-vector-ref sparse-vector-set!)
+  (export primes *primes* reset-primes primes-in-range
           small-prime? *small-prime-bound*
           miller-rabin-prime? bpsw-prime?
           naive-factorize mc-factorize
           jacobi totient))
 (select-module math.prime)
 
+;;;
+;;; Native support
+;;;
+
+(inline-stub
+ (declcode "#include \"prime.h\"")
+ (initcode (Scm_Init_prime))
+
+ ;; Returns a u8vector of bits; bit K is 1 iff START+2K is prime.
+ ;; START must be odd.  See prime.c.
+ (define-cproc %prime-sieve (start end nthreads::<int>)
+   (return (Scm_PrimeSieve (Scm_GetIntegerU64 start) (Scm_GetIntegerU64 end)
+                           nthreads)))
+
+ ;; These require N < 2^64.
+ (define-cproc %strong-prp? (n a) ::<boolean>
+   (return (Scm_PrimeStrongPRP (Scm_GetIntegerU64 n) (Scm_GetIntegerU64 a))))
+ (define-cproc %miller-rabin-prime64? (n) ::<boolean>
+   (return (Scm_PrimeMillerRabin64 (Scm_GetIntegerU64 n))))
+ (define-cproc %bpsw-prime64? (n) ::<boolean>
+   (return (Scm_PrimeBPSW64 (Scm_GetIntegerU64 n))))
+ )
+
+(define-constant *native-bound* 18446744073709551616) ; (expt 2 64)
+
 ;;;
 ;;; Infinite sequence of prime numbers
 ;;;
 
-;; This section of code is based on the segment sieve prime number generator
-;; written by @cddddr.  Optimized by SK.  As of 0.9.4_pre2, it can generate
-;; first 10^7 primes in 14sec on 2.4GHz Core2 machine.
-
-(define (take-first-term a0 d lower-bound)
-  (if (<= lower-bound a0)
-      a0
-      (+ a0 (* d (quotient (- lower-bound a0 (- d) 1) d)))))
-(define (->odd x)  (if (odd? x) x (+ x 1)))
-(define (->even x) (if (even? x) x (+ x 1)))
-(define-inline (integer->index x) (ash x -1))
-
-(define-constant *segment-size* (->even #e5e4))
-(define-constant *first-segment-start*
-  (->odd (ceiling->exact (expt *segment-size* 0.6))))
-(define-constant *sieve-vec-size* (/ *segment-size* 2))
-(define-constant *sieve-filler* '#u8(0))
-
-;; sieve is a bytevector, representing a range of odd numbers.
-;; given odd number N in the range [start, end] (where start and end
-;; are both odd), (vector-ref bytevec (/ (- N start) 2)) is 0 if N
-;; is composite, 1 if not.
-(define (segment-sieve! bytevec start primes)
-  (let ([root (floor->exact (sqrt (+ start *segment-size* -1)))]
-        [start-index (integer->index start)])
-    (let sieve! ([ps (cdr primes)])
-      (match-let1 (p . qs) ps
-        (when (<= p root)
-          (let1 i (- (take-first-term (integer->index (* p p)) p start-index)
-                     start-index)
-            (u8vector-multi-copy! bytevec i p *sieve-filler*))
-          (sieve! qs))))))
-
-(define (bytevec->generator bytevec start)
+;; The sequence used to be generated by the segment sieve written by
+;; @cddddr in Scheme.  Now each segment is sieved by Scm_PrimeSieve,
+;; and we just pick the primes out of the bitmap.
+
+(define-constant *segment-size* 1000000) ; must be even
+
+;; Returns a generator of the primes in the bitmap returned by
+;; %prime-sieve, in ascending order.
+(define (bitmap->generator bitmap start)
+  (define nbits (* (u8vector-length bitmap) 8))
   (let1 i 0
     (^[] (let loop ([j i])
-           (cond [(>= j *sieve-vec-size*) (set! i j) (eof-object)]
-                 [(not (zero? (u8vector-ref bytevec j)))
+           (cond [(>= j nbits) (set! i j) (eof-object)]
+                 [(and (zero? (logand j 7))
+                       (zero? (u8vector-ref bitmap (ash j -3))))
+                  (loop (+ j 8))]
+                 [(logbit? (logand j 7) (u8vector-ref bitmap (ash j -3)))
                   (set! i (+ j 1))
                   (+ (* j 2) start)]
                  [else (loop (+ j 1))])))))
 
-(define (segment-prime-generator start primes)
-  (let1 bytevec (make-u8vector *sieve-vec-size* 1)
-    (segment-sieve! bytevec start primes)
-    (bytevec->generator bytevec start)))
-
-;; Head of prime sequence.  We don't make it a generator,
-;; for we only need to calculate them once and it won't
-;; take long.  We just wrap it with delay so that it won't
-;; tax loading time.
-(define *small-primes*
-  (delay (list-ec (:range n 2 *first-segment-start*)
-                  (if (every?-ec (:range j 2 (+ 1 (floor->exact (sqrt n))))
-                                 (< 0 (mod n j))))
-                  n)))
+;; Returns a list of the primes in the bitmap, in ascending order.
+(define (bitmap->list bitmap start)
+  (let loop ([j (- (* (u8vector-length bitmap) 8) 1)] [r '()])
+    (cond [(< j 0) r]
+          [(logbit? (logand j 7) (u8vector-ref bitmap (ash j -3)))
+           (loop (- j 1) (cons (+ (* j 2) start) r))]
+          [else (loop (- j 1) r)])))
+
+(define (segment-prime-generator start)
+  (bitmap->generator (%prime-sieve start (+ start *segment-size*) 1) start))
 
 ;; API
 (define (primes)
-  (define start *first-segment-start*)
-  (define gen (list->generator (force *small-primes*)))
+  (define start 1)
+  (define gen (^[] (eof-object)))
   (define (gen-primes)
     (let loop ([v (gen)])
       (if (eof-object? v)
         (begin
-          (set! gen (segment-prime-generator start prime-lseq))
+          (set! gen (segment-prime-generator start))
           (inc! start *segment-size*)
           (loop (gen)))
         v)))
-  (define prime-lseq (generator->lseq gen-primes))
-  prime-lseq)
+  (generator->lseq 2 gen-primes))
+
+;; API
+(define (primes-in-range start end :key (num-threads 1))
+  (unless (and (exact-integer? start) (exact-integer? end))
+    (error "exact integers are expected for the range, but got:" start end))
+  (let1 s (let1 s (max start 1) (if (odd? s) s (+ s 1)))
+    (let1 ps (if (< s end)
+               (bitmap->list (%prime-sieve s end num-threads) s)
+               '())
+      (if (<= start 2 (- end 1))
+        (cons 2 ps)
+        ps))))
 
 ;; API
 (define *primes* (primes))
@@ -140,6 +151,11 @@
 ;; n is the number to be tested, a is the chosen base.
 ;; returns #f if n is composite.
 (define (miller-rabin-test a n)
+  (if (< n *native-bound*)
+    (%strong-prp? n a)
+    (miller-rabin-test-generic a n)))
+
+(define (miller-rabin-test-generic a n)
   (let* ([n-1 (- n 1)]
          [s (twos-exponent-factor n-1)]
          [d (ash n-1 (- s))]
@@ -153,30 +169,18 @@
 ;; For small integers, determinisitc Miller-Rabin is known.
 ;; Selfridge&Wagstaff  doi:10.2307/2006210
 ;; Jaeschke doi:10.2307/2153262
-(define *deterministic-witnesses*
-  ;; ((bound a ...) ...)
-  ;; If the number to test is less than bound, we only need to test with a ...
-  '((1373653 2 3)
-    (9080191 31 73)
-    (4759123141 2 7 61)
-    (2152302898747 2 3 5 7 11)
-    (3474749660383 2 3 5 7 11 13)
-    (341550071728321 2 3 5 7 11 13 17)))
-
-(define *small-prime-bound*
-  (car (last *deterministic-witnesses*)))
-
-(define (deterministic-miller-rabin n witnesses)
-  (every?-ec (: a witnesses) (miller-rabin-test a n)))
+;; The native test uses the first 12 primes as witnesses, which is
+;; deterministic for all n < 2^64 (Sorenson&Webster doi:10.1090/mcom/3134).
+;; We keep the bound where the older witness set was known to work,
+;; for the value of *small-prime-bound* is a part of API.
+(define *small-prime-bound* 341550071728321)
 
 ;; If n is below *small-prime-bound*, returns deterministic
 ;; answer.  If n is over, always return #f.
 (define (small-prime? n)
-  (if (<= n 100)
-    (boolean (memv n (take *primes* 25))) ; we have 25 primes below 100.
-    (and-let* ([ (odd? n) ]
-               [p (find (^p (< n (car p))) *deterministic-witnesses*)])
-      (deterministic-miller-rabin n (cdr p)))))
+  (and (exact-integer? n)
+       (< 1 n *small-prime-bound*)
+       (%miller-rabin-prime64? n)))
 
 (define *miller-rabin-random-source*
   (rlet1 s (make-random-source)
@@ -285,6 +289,7 @@
 ;; API
 (define (bpsw-prime? n)
   (cond [(< n 2) #f]
+        [(< n *native-bound*) (%bpsw-prime64? n)]
         [(= n 2) #t]
         [(even? n) #f]
         [else
@@ -44,6 +44,7 @@
   (use util.match)
   (export <rfc822-parse-error> rfc822-parse-errorf
           rfc822-read-headers rfc822-header->list rfc822-header-ref
+          rfc822-intern-field-name
           rfc822-skip-cfws
           *rfc822-atext-chars* *rfc822-standard-tokenizers*
           rfc822-atom rfc822-dot-atom rfc822-quoted-string
@@ -88,8 +89,39 @@
 ;; Generic header parser.  Returns ((name body) ...)
 ;; Does process unfolding.
 ;; May throw <rfc822-parse-error> if :strict? is true.
-(define (rfc822-read-headers iport :key (strict? #f)
-                             (reader (cut read-line <> #t)))
+;; Unless a custom READER is given, the work is done in C (ext/rfc/rfc822.c).
+
+(inline-stub
+ (declcode "#include \"rfc822.h\"")
+ (initcode (Scm_Init_rfc822))
+
+ (define-cproc %rfc822-read-headers (iport::<input-port> strict::<boolean>)
+   ::(<top> <int> <top>)
+   (let* ([err::int 0] [bad-line SCM_FALSE]
+          [r (Scm_RFC822ReadHeaders iport strict (& err) (& bad-line))])
+     (return r err bad-line)))
+ (define-cproc %rfc822-intern-field-name (name::<string>)
+   Scm_RFC822InternFieldName)
+ (define-enum SCM_RFC822_PREMATURE_EOF)
+ (define-enum SCM_RFC822_BAD_LINE)
+ )
+
+(define (rfc822-read-headers iport :key (strict? #f) (reader #f))
+  (if reader
+    (read-headers-with-reader iport strict? reader)
+    (receive (headers err line) (%rfc822-read-headers iport strict?)
+      (cond [(eqv? err SCM_RFC822_PREMATURE_EOF)
+             (rfc822-parse-errorf #f #f "premature end of message header")]
+            [(eqv? err SCM_RFC822_BAD_LINE)
+             (rfc822-parse-errorf #f #f "bad header line: ~s" line)]
+            [else headers]))))
+
+;; Returns the lowercase field name, shared with the ones returned by
+;; rfc822-read-headers if it's a well-known one.
+(define (rfc822-intern-field-name name)
+  (%rfc822-intern-field-name (string-downcase name)))
+
+(define (read-headers-with-reader iport strict? reader)
 
   (define (accum name bodies r)
     (cons (list name (string-concatenate-reverse bodies)) r))
@@ -110,7 +142,7 @@
                               [name (string-incomplete->complete n)]
                               [name (string-trim-both name)]
                               [ (string-every #[\u0021-\u0039\u003b-\u007e] name) ])
-                     (string-downcase name))
+                     (rfc822-intern-field-name name))
           (cond
            [name
             (let loop2 ([nline (reader iport)]
@@ -0,0 +1,100 @@
+;;;
+;;; base64.scm - base64 encoding/decoding routine
+;;;
+;;;   Copyright (c) 2000-2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; Implements Base64 encoding/decoding routine
+;; Ref: RFC2045 section 6.8  <http://www.rfc-editor.org/rfc/rfc2045.txt>
+;; and RFC3548 <http://www.rfc-editor.org/rfc/rfc3548.txt>
+
+;; The encoder and the decoder are implemented in C (ext/rfc/base64.c).
+
+(define-module rfc.base64
+  (export base64-encode base64-encode-string base64-encode-bytevector
+          base64-decode base64-decode-string base64-decode-bytevector))
+(select-module rfc.base64)
+
+(inline-stub
+ (declcode "#include \"base64.h\"")
+ (initcode (Scm_Init_base64))
+
+ ;; SRC is a string or a u8vector.  Strings are taken as byte sequences.
+ (define-cfn data_element (data::ScmObj
+                           start::(const u_char**)
+                           siz::ScmSmallInt*)
+   ::void :static
+   (cond [(SCM_U8VECTORP data)
+          (set! (* start) (SCM_U8VECTOR_ELEMENTS data)
+                (* siz)   (SCM_U8VECTOR_SIZE data))]
+         [(SCM_STRINGP data)
+          (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY data)])
+            (set! (* start) (cast (const u_char*) (SCM_STRING_BODY_START b))
+                  (* siz)   (SCM_STRING_BODY_SIZE b)))]
+         [else
+          (Scm_Error "u8vector or string required, but got: %S" data)]))
+
+ (define-cproc %base64-encode (src line-width::<int> url-safe::<boolean>)
+   (let* ([start::(const u_char*) NULL] [siz::ScmSmallInt 0])
+     (data_element src (& start) (& siz))
+     (return (Scm_Base64Encode start siz line-width url-safe))))
+ (define-cproc %base64-decode (src url-safe::<boolean> to-u8vector::<boolean>)
+   (let* ([start::(const u_char*) NULL] [siz::ScmSmallInt 0])
+     (data_element src (& start) (& siz))
+     (return (Scm_Base64Decode start siz url-safe to-u8vector))))
+ (define-cproc %base64-encode-port (in::<input-port> out::<output-port>
+                                    line-width::<int> url-safe::<boolean>)
+   ::<void> Scm_Base64EncodePort)
+ (define-cproc %base64-decode-port (in::<input-port> out::<output-port>
+                                    url-safe::<boolean>)
+   ::<void> Scm_Base64DecodePort)
+ )
+
+(define (%line-width line-width)
+  (if (and line-width (> line-width 0)) line-width 0))
+
+(define (base64-decode :key (url-safe #f))
+  (%base64-decode-port (current-input-port) (current-output-port) url-safe))
+
+(define (base64-decode-string string :key (url-safe #f))
+  (%base64-decode string url-safe #f))
+
+(define (base64-decode-bytevector string :key (url-safe #f))
+  (%base64-decode string url-safe #t))
+
+(define (base64-encode :key (line-width 76) (url-safe #f))
+  (%base64-encode-port (current-input-port) (current-output-port)
+                       (%line-width line-width) url-safe))
+
+(define (base64-encode-string string :key (line-width 76) (url-safe #f))
+  (%base64-encode string (%line-width line-width) url-safe))
+
+(define (base64-encode-bytevector u8v :key (line-width 76) (url-safe #f))
+  (%base64-encode u8v (%line-width line-width) url-safe))
@@ -41,6 +41,7 @@
   (use gauche.parameter)
   (use gauche.sequence)
   (use gauche.generator)
+  (use gauche.record)
   (use parser.peg)
   (use gauche.unicode)
   (use srfi-13)
@@ -49,6 +50,7 @@
   (export <json-parse-error> <json-construct-error>
           parse-json parse-json-string
           parse-json*
+          json-event-generator json-fold json-path-generator
           construct-json construct-json-string
 
           json-array-handler json-object-handler json-special-handler
@@ -74,6 +76,41 @@
 (define (build-object pairs) ((json-object-handler) pairs))
 (define (build-special symbol) ((json-special-handler) symbol))
 
+;; The parser and the writer are implemented in C (ext/rfc/json.c).
+;; They call back the following procedures to raise errors, and
+;; to write dictionaries and general sequences.
+(inline-stub
+ (declcode "#include \"json.h\"")
+ (initcode (Scm_Init_json))
+
+ (define-cproc %parse-json (port::<input-port>
+                            array-handler object-handler special-handler)
+   Scm_JSONParse)
+ (define-cproc %write-json (obj port::<output-port>) ::<void>
+   Scm_JSONWrite)
+ (define-cproc %json-read-token (port::<input-port> peek::<boolean>)
+   Scm_JSONReadToken)
+ (define-cproc %json-position (port::<port>)
+   (return (Scm_MakeIntegerU (-> port bytes))))
+ )
+
+(define (%json-parse-error pos objs msg)
+  (error <json-parse-error> :position pos :objects objs :message msg))
+
+(define (%json-construct-error obj msg)
+  (error <json-construct-error> :object obj msg obj))
+
+;; Passes #f for the default handlers, so that the C parser can skip
+;; calling them.
+(define (%parse-json-1 port)
+  (let ([ah (json-array-handler)]
+        [oh (json-object-handler)]
+        [sh (json-special-handler)])
+    (%parse-json port
+                 (if (eq? ah list->vector) #f ah)
+                 (if (eq? oh identity) #f oh)
+                 (if (eq? sh identity) #f sh))))
+
 ;;;============================================================
 ;;; Parser
 ;;;
@@ -179,98 +216,197 @@
 
 ;; entry point
 (define (parse-json :optional (port (current-input-port)))
-  (guard (e [(<parse-error> e)
-             ;; not to expose parser.peg's <parse-error>.
-             (error <json-parse-error>
-                    :position (~ e'position) :objects (~ e'objects)
-                    :message (~ e'message))])
-    (peg-parse-port json-parser port)))
+  (%parse-json-1 port))
 
 (define (parse-json-string str)
   (call-with-input-string str (cut parse-json <>)))
 
 (define (parse-json* :optional (port (current-input-port)))
-  (guard (e [(<parse-error> e)
-             ;; not to expose parser.peg's <parse-error>.
-             (error <json-parse-error>
-                    :position (~ e'position) :objects (~ e'objects)
-                    :message (~ e'message))])
-    (generator->list (peg-parser->generator json-parser port))))
+  (let loop ([r '()])
+    (let1 v (%parse-json-1 port)
+      (if (eof-object? v)
+        (reverse! r)
+        (loop (cons v r))))))
+
+;;;============================================================
+;;; Event parser
+;;;
+
+;; The event parser reads JSON texts token by token, keeping only the
+;; stack of containers being read, so it can handle inputs that are
+;; too large to be materialized.
+;;
+;; An event is one of the following pairs:
+;;   (start-object . #f)  (end-object . #f)
+;;   (start-array . #f)   (end-array . #f)
+;;   (key . <string>)
+;;   (value . <obj>)       ; a string, a number, or a special
+;;
+;; A frame in the stack is (array . <index>) or (object . <key>), where
+;; <index> and <key> tell the position of the element being read.
+
+(define-record-type json-reader %make-json-reader #t
+  port
+  (stack)                               ;list of frames
+  (state))                              ;see %json-next-event
+
+(define (%make-reader port) (%make-json-reader port '() 'toplevel))
+
+(define (%reader-error r tok msg)
+  (%json-parse-error (%json-position (json-reader-port r))
+                     (if (eof-object? tok) '() (list tok))
+                     (if (eof-object? tok) "unexpected end of input" msg)))
+
+(define (%after-value! r)
+  (json-reader-state-set! r (if (null? (json-reader-stack r))
+                              'toplevel
+                              'after-value)))
+
+;; Returns #t if the next token is the beginning of a value.
+(define (%expecting-value? r)
+  (case (json-reader-state r)
+    [(value) #t]
+    [(first-elt toplevel)
+     (let1 c (%json-read-token (json-reader-port r) #t)
+       (not (or (eof-object? c) (eqv? c #\]))))]
+    [else #f]))
+
+;; Path of the value to be read next, from the outermost container.
+(define (%reader-path r) (reverse (map cdr (json-reader-stack r))))
+
+;; Reads the value to be read next as a whole.
+(define (%json-read-value r)
+  (let1 v (%parse-json-1 (json-reader-port r))
+    (when (eof-object? v) (%reader-error r v #f))
+    (%after-value! r)
+    v))
+
+;; States:
+;;  toplevel    - expecting a value or EOF
+;;  value       - expecting a value
+;;  first-elt   - after '[', expecting a value or ']'
+;;  first-key   - after '{', expecting a key or '}'
+;;  key         - expecting a key
+;;  after-value - expecting ',' or the closing bracket
+(define (%json-next-event r)
+  (define port (json-reader-port r))
+  (define (start! kind init state)
+    (json-reader-stack-set! r (acons kind init (json-reader-stack r)))
+    (json-reader-state-set! r state))
+  (define (value tok)
+    (cond [(eqv? tok #\[) (start! 'array 0 'first-elt) '(start-array . #f)]
+          [(eqv? tok #\{) (start! 'object #f 'first-key) '(start-object . #f)]
+          [(or (char? tok) (eof-object? tok))
+           (%reader-error r tok #"unexpected token: ~tok")]
+          [else (%after-value! r)
+                (cons 'value (if (symbol? tok) (build-special tok) tok))]))
+  (define (close tok)
+    (let1 kind (caar (json-reader-stack r))
+      (unless (eqv? tok (if (eq? kind 'array) #\] #\}))
+        (%reader-error r tok #"unexpected token: ~tok"))
+      (json-reader-stack-set! r (cdr (json-reader-stack r)))
+      (%after-value! r)
+      (if (eq? kind 'array) '(end-array . #f) '(end-object . #f))))
+  (define (key tok)
+    (unless (string? tok) (%reader-error r tok #"object key expected: ~tok"))
+    (let1 colon (%json-read-token port #f)
+      (unless (eqv? colon #\:) (%reader-error r colon #"':' expected: ~colon"))
+      (set-cdr! (car (json-reader-stack r)) tok)
+      (json-reader-state-set! r 'value)
+      (cons 'key tok)))
+  (let1 tok (%json-read-token port #f)
+    (case (json-reader-state r)
+      [(toplevel) (if (eof-object? tok) tok (value tok))]
+      [(value) (value tok)]
+      [(first-elt) (if (eqv? tok #\]) (close tok) (value tok))]
+      [(first-key) (if (eqv? tok #\}) (close tok) (key tok))]
+      [(key) (key tok)]
+      [(after-value)
+       (if (eqv? tok #\,)
+         (let1 frame (car (json-reader-stack r))
+           (if (eq? (car frame) 'array)
+             (begin (set-cdr! frame (+ (cdr frame) 1))
+                    (json-reader-state-set! r 'value))
+             (json-reader-state-set! r 'key))
+           (%json-next-event r))
+         (close tok))])))
+
+(define (json-event-generator :optional (port (current-input-port)))
+  (let1 r (%make-reader port)
+    (^[] (%json-next-event r))))
+
+(define (json-fold proc seed :optional (port (current-input-port)))
+  (let ([r (%make-reader port)])
+    (let loop ([seed seed])
+      (let1 ev (%json-next-event r)
+        (if (eof-object? ev)
+          seed
+          (loop (proc (car ev) (cdr ev) seed)))))))
+
+;; PATH is a list of steps from the toplevel value.  Each step is
+;; a string (object key), an exact nonnegative integer (array index),
+;; or a symbol * (any key or index).
+(define (json-path-generator path :optional (port (current-input-port)))
+  (define depth (length path))
+  (define (step-match? step pos)
+    (cond [(eq? step '*) #t]
+          [(string? step) (and (string? pos) (string=? step pos))]
+          [else (eqv? step pos)]))
+  (define (match? r)
+    (and (= (length (json-reader-stack r)) depth)
+         (every step-match? path (%reader-path r))))
+  (dolist [step path]
+    (unless (or (eq? step '*) (string? step)
+                (and (exact-integer? step) (>= step 0)))
+      (error "bad step in json path:" step)))
+  (let1 r (%make-reader port)
+    (^[] (let loop ()
+           (if (and (match? r) (%expecting-value? r))
+             (%json-read-value r)
+             (let1 ev (%json-next-event r)
+               (if (eof-object? ev) ev (loop))))))))
 
 ;;;============================================================
 ;;; Writer
 ;;;
 
-(define (print-value obj)
-  (cond [(or (eq? obj 'false) (eq? obj #f)) (display "false")]
-        [(or (eq? obj 'true) (eq? obj #t))  (display "true")]
-        [(eq? obj 'null)  (display "null")]
-        [(list? obj)      (print-object obj)]
-        [(string? obj)    (print-string obj)]
-        [(number? obj)    (print-number obj)]
-        [(is-a? obj <dictionary>) (print-object obj)]
-        [(is-a? obj <sequence>)   (print-array obj)]
+;; Called from the C writer for objects it doesn't know.
+(define (%print-json-generic obj port)
+  (cond [(is-a? obj <dictionary>) (print-object obj port)]
+        [(is-a? obj <sequence>)   (print-array obj port)]
         [else (error <json-construct-error> :object obj
                      "can't convert Scheme object to json:" obj)]))
 
-(define (print-object obj)
-  (display "{")
+(define (print-object obj port)
+  (display "{" port)
   (fold (^[attr comma]
           (unless (pair? attr)
             (error <json-construct-error> :object obj
                    "construct-json needs an assoc list or dictionary, \
                     but got:" obj))
-          (display comma)
-          (print-string (x->string (car attr)))
-          (display ":")
-          (print-value (cdr attr))
+          (display comma port)
+          (%write-json (x->string (car attr)) port)
+          (display ":" port)
+          (%write-json (cdr attr) port)
           ",")
         "" obj)
-  (display "}"))
+  (display "}" port))
 
-(define (print-array obj)
-  (display "[")
+(define (print-array obj port)
+  (display "[" port)
   (for-each-with-index (^[i val]
-                         (unless (zero? i) (display ","))
-                         (print-value val))
+                         (unless (zero? i) (display "," port))
+                         (%write-json val port))
                        obj)
-  (display "]"))
-
-(define (print-number num)
-  (cond [(or (not (real? num)) (not (finite? num)))
-         (error <json-construct-error> :object num
-                "json cannot represent a number" num)]
-        [(and (rational? num) (not (integer? num)))
-         (write (exact->inexact num))]
-        [else (write num)]))
-
-(define (print-string str)
-  (define specials
-    '((#\" . #\") (#\\ . #\\) (#\x08 . #\b) (#\page . #\f)
-      (#\newline . #\n) (#\return . #\r) (#\tab . #\t)))
-  (define (hexescape code) (format #t "\\u~4,'0x" code))
-  (define (print-char c)
-    (cond [(assv c specials) => (^p (write-char #\\) (write-char (cdr p)))]
-          [(and (char-set-contains? char-set:ascii c)
-                (not (eq? (char-general-category c) 'Cc)))
-           (write-char c)]
-          [else
-           (let1 code (char->ucs c)
-             (if (>= code #x10000)
-               (for-each hexescape (ucs4->utf16 code))
-               (hexescape code)))]))
-  (display "\"")
-  (string-for-each print-char str)
-  (display "\""))
+  (display "]" port))
 
 (define (construct-json x :optional (oport (current-output-port)))
-  (with-output-to-port oport
-    (^()
-      (cond [(or (list? x) (is-a? x <dictionary>)) (print-object x)]
-            [(and (is-a? x <sequence>) (not (string? x))) (print-array x)]
-            [else (error <json-construct-error> :object x
-                         "construct-json expects a list or a vector, \
-                          but got" x)]))))
+  (if (or (list? x) (is-a? x <dictionary>)
+          (and (is-a? x <sequence>) (not (string? x))))
+    (%write-json x oport)
+    (error <json-construct-error> :object x
+           "construct-json expects a list or a vector, \
+            but got" x)))
 
 (define (construct-json-string x)
   (call-with-output-string (cut construct-json x <>)))
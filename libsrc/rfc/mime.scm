@@ -46,6 +46,7 @@
   (use srfi-13)
   (use srfi-14)
   (use rfc.822)
+  (use gauche.uvector)
   (use util.match)
   (export mime-parse-version
           mime-parse-content-type mime-parse-content-disposition
@@ -54,13 +55,14 @@
           mime-decode-word mime-decode-text
           <mime-part>
           mime-parse-message mime-retrieve-body
-          mime-body->string mime-body->file
+          mime-body->string mime-body->u8vector mime-body->file
           mime-make-boundary mime-compose-message mime-compose-message-string
           )
   )
 (select-module rfc.mime)
 
-(autoload rfc.quoted-printable quoted-printable-decode-string
+(autoload rfc.quoted-printable quoted-printable-decode
+          quoted-printable-decode-string
           quoted-printable-encode quoted-printable-encode-string)
 (autoload rfc.base64 base64-decode-string base64-decode
           base64-encode-string base64-encode)
@@ -68,6 +70,34 @@
           ces-upper-compatible? ces-conversion-supported? ces-convert)
 (autoload rfc.mime-port make-mime-port)
 (autoload srfi-27 random-integer)       ;for MIME boundary generation
+(autoload gauche.vport open-output-uvector get-output-uvector
+          <buffered-output-port>)
+
+;; The boundary detection of rfc.mime-port is done in C (ext/rfc/mime.c).
+(inline-stub
+ (declcode "#include \"mime.h\"")
+
+ ;; Returns the kind of the delimiter found in BUF[START..END), and its
+ ;; range.  See mime.h for the details.
+ (define-cproc %mime-scan-boundary (buf::<u8vector> start::<fixnum>
+                                    end::<fixnum> delim::<u8vector>
+                                    flags::<int>)
+   ::(<int> <fixnum> <fixnum>)
+   (unless (and (<= 0 start) (<= start end)
+                (<= end (SCM_U8VECTOR_SIZE buf)))
+     (Scm_Error "buffer range out of bound: [%ld, %ld)" start end))
+   (let* ([dstart::ScmSmallInt 0] [dend::ScmSmallInt 0]
+          [r::int (Scm_MimeScanBoundary (SCM_U8VECTOR_ELEMENTS buf) start end
+                                        (SCM_U8VECTOR_ELEMENTS delim)
+                                        (SCM_U8VECTOR_SIZE delim)
+                                        flags (& dstart) (& dend))])
+     (return r dstart dend)))
+ (define-enum SCM_MIME_NO_DELIMITER)
+ (define-enum SCM_MIME_PART_DELIMITER)
+ (define-enum SCM_MIME_CLOSE_DELIMITER)
+ (define-enum SCM_MIME_SCAN_AT_START)
+ (define-enum SCM_MIME_SCAN_EOF)
+ )
 
 ;;===============================================================
 ;; Basic utility
@@ -389,61 +419,54 @@
 ;; Body readers
 ;;
 
+;; OUTP may be an output port, or a procedure that is called with
+;; a u8vector of each chunk of the decoded body.  The u8vector is
+;; only valid during the call.
 (define (mime-retrieve-body packet inp outp)
-
-  (define (read-line/nl)
-    (let loop ([c (read-char inp)]
-               [chars '()])
-      (cond [(eof-object? c)
-             (if (null? chars) c  (list->string (reverse! chars)))]
-            [(char=? c #\newline) (list->string (reverse! (cons c chars)))]
-            [(char=? c #\return)
-             (let1 c (peek-char inp)
-               (if (char=? c #\newline)
-                 (list->string (reverse! (list* (read-char inp)
-                                                #\return
-                                                chars)))
-                 (list->string (reverse! (cons #\return chars)))))]
-            [else (loop (read-char inp) (cons c chars))])))
-
-  (define (read-text decoder)
-    (let loop ([line (read-line/nl)])
-      (unless (eof-object? line)
-        (display (decoder line) outp)
-        (loop (read-line/nl)))))
-
-  (define (read-base64)
-    (define (base64-output string out)
-      (with-input-from-string string
-        (cut with-port-locking (current-input-port)
-             (cut with-output-to-port out base64-decode))))
-    (let1 buf (open-output-string :private? #t)
-      (let loop ([line (read-line inp)])
-        (unless (eof-object? line)
-          (display line buf)
-          (loop (read-line inp))))
-      (base64-output (get-output-string buf) outp))
-    )
-
-  (with-port-locking inp
-    (^[] (let1 enc (ref packet 'transfer-encoding)
-           (cond
-            [(string-ci=? enc "base64") (read-base64)]
-            [(string-ci=? enc "quoted-printable")
-             (read-text quoted-printable-decode-string)]
-            [(member enc '("7bit" "8bit" "binary"))
-             (let loop ((b (read-byte inp)))
-               (unless (eof-object? b)
-                 (write-byte b outp)
-                 (loop (read-byte inp))))]
-            ))))
-  )
+  (define (copy-bytes out)
+    (let1 buf (make-u8vector 8192)
+      (let loop ()
+        (let1 n (read-uvector! buf inp)
+          (unless (eof-object? n)
+            (write-uvector buf out 0 n)
+            (loop))))))
+
+  ;; The base64 decoder stops after the padding; we discard the rest.
+  (define (read-base64 out)
+    (with-input-from-port inp
+      (cut with-output-to-port out base64-decode))
+    (until (eof-object? (read-uvector! (make-u8vector 256) inp))))
+
+  (define (read-quoted-printable out)
+    (with-input-from-port inp
+      (cut with-output-to-port out quoted-printable-decode)))
+
+  (define (retrieve out)
+    (with-port-locking inp
+      (^[] (let1 enc (ref packet 'transfer-encoding)
+             (cond
+              [(string-ci=? enc "base64") (read-base64 out)]
+              [(string-ci=? enc "quoted-printable") (read-quoted-printable out)]
+              [(member enc '("7bit" "8bit" "binary")) (copy-bytes out)]
+              )))))
+
+  (if (procedure? outp)
+    (let1 out (make <buffered-output-port>
+                :flush (^[buf complete?] (outp buf) (u8vector-length buf)))
+      (retrieve out)
+      (close-output-port out))
+    (retrieve outp)))
 
 (define (mime-body->string packet inp)
   (let1 s (open-output-string :private? #t)
     (mime-retrieve-body packet inp s)
     (get-output-string s)))
 
+(define (mime-body->u8vector packet inp)
+  (let1 p (open-output-uvector (make-u8vector 0) :extendable #t)
+    (mime-retrieve-body packet inp p)
+    (get-output-uvector p :shared #t)))
+
 (define (mime-body->file packet inp filename)
   (call-with-output-file filename
     (^[outp]
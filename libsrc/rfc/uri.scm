@@ -63,6 +63,48 @@
   )
 (select-module rfc.uri)
 
+;; The decomposition and the percent encoding are done in C
+;; (ext/rfc/uri.c).
+(inline-stub
+ (declcode "#include \"uri.h\"")
+
+ (define-cproc %uri-scheme&specific (uri::<string>) ::(<top> <top>)
+   (let* ([scheme] [specific])
+     (Scm_URISchemeSpecific uri (& scheme) (& specific))
+     (return scheme specific)))
+ (define-cproc %uri-decompose-hierarchical (specific::<string>)
+   ::(<top> <top> <top> <top>)
+   (let* ([r::(.array ScmObj (4))])
+     (Scm_URIDecomposeHierarchical specific r)
+     (return (aref r 0) (aref r 1) (aref r 2) (aref r 3))))
+ (define-cproc %uri-decompose-authority (authority::<string>)
+   ::(<top> <top> <top>)
+   (let* ([r::(.array ScmObj (3))])
+     (Scm_URIDecomposeAuthority authority r)
+     (return (aref r 0) (aref r 1) (aref r 2))))
+ (define-cproc %uri-parse (uri::<string>)
+   ::(<top> <top> <top> <top> <top> <top> <top>)
+   (let* ([r::(.array ScmObj (7))])
+     (Scm_URIParse uri r)
+     (return (aref r 0) (aref r 1) (aref r 2) (aref r 3)
+             (aref r 4) (aref r 5) (aref r 6))))
+
+ (define-cproc %uri-encode (s::<string> noescape::<char-set>)
+   (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY s)])
+     (return (Scm_URIEncode (SCM_STRING_BODY_START b)
+                            (SCM_STRING_BODY_SIZE b) noescape))))
+ (define-cproc %uri-decode (s::<string> cgi-decode::<boolean>)
+   (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY s)])
+     (return (Scm_URIDecode (SCM_STRING_BODY_START b)
+                            (SCM_STRING_BODY_SIZE b) cgi-decode))))
+ (define-cproc %uri-encode-port (in::<input-port> out::<output-port>
+                                 noescape::<char-set>)
+   ::<void> Scm_URIEncodePort)
+ (define-cproc %uri-decode-port (in::<input-port> out::<output-port>
+                                 cgi-decode::<boolean>)
+   ::<void> Scm_URIDecodePort)
+ )
+
 ;;==============================================================
 ;; Generic parser
 ;;
@@ -73,45 +115,29 @@
 ;; The escaped characters of the scheme specific part is not unescaped;
 ;; their interpretation is dependent on the scheme.
 
+;; The C routines give the same results as the following regexps:
+;;  scheme&specific: #/^([A-Za-z][A-Za-z0-9+.-]*):/
+;;  hierarchical:    #/^(?:\/\/([^\/?#]*))?([^?#]+)?(?:\?([^#]*))?(?:#(.*))?$/
+;;  authority:       #/^(?:(?<userinfo>.*?)@)?(?:(?<host>[^:]*)|(?:\[(?<v6host>[a-fA-F\d:]+)\]))(?::(?<port>\d*))?$/
+
 (define (uri-scheme&specific uri)
-  (cond [(#/^([A-Za-z][A-Za-z0-9+.-]*):/ uri)
-         => (^m (values (string-downcase (m 1)) (m 'after)))]
-        [else (values #f uri)]))
+  (%uri-scheme&specific uri))
 
 (define (uri-decompose-hierarchical specific)
-  (cond
-   [(and (string? specific)
-         (#/^(?:\/\/([^\/?#]*))?([^?#]+)?(?:\?([^#]*))?(?:#(.*))?$/ specific))
-    => (^m (values (m 1) (m 2) (m 3) (m 4)))]
-   [else (values #f #f #f #f)]))
+  (if (string? specific)
+    (%uri-decompose-hierarchical specific)
+    (values #f #f #f #f)))
 
 (define (uri-decompose-authority authority)
-  (cond
-   [(and (string? authority)
-         (#/^(?:(?<userinfo>.*?)@)?(?:(?<host>[^:]*)|(?:\[(?<v6host>[a-fA-F\d:]+)\]))(?::(?<port>\d*))?$/ authority))
-    => (^m (values (m 'userinfo) (or (m 'v6host) (m 'host)) (m 'port)))]
-   [else (values #f #f #f)]))
+  (if (string? authority)
+    (%uri-decompose-authority authority)
+    (values #f #f #f)))
 
 ;; A common cliche (suggested by Kouhei Sutou)
 ;; Returns: scheme, user-info, host, port, path, query, fragment
+;; Empty host and path are returned as #f.
 (define (uri-parse uri)
-  (define (filter-non-empty-string str)
-    (and (string? str)
-         (not (string-null? str))
-         str))
-  (receive (scheme specific)
-      (uri-scheme&specific uri)
-    (receive (authority path query fragment)
-        (uri-decompose-hierarchical specific)
-      (receive (user-info host port)
-          (uri-decompose-authority authority)
-        (values scheme
-                user-info
-                (filter-non-empty-string host)
-                (and port (string->number port))
-                (filter-non-empty-string path)
-                query
-                fragment)))))
+  (%uri-parse uri))
 
 ;; Convenience utility
 ;;  (uri-ref "http://foo:8080/baz?q" 'host) => "foo"
@@ -277,39 +303,17 @@
 ;;  the semantics of specific URI scheme.
 ;;  These procedures provides basic building components.
 
+;; A '%' that isn't followed by two hex digits is taken literally.
 (define (uri-decode :key (cgi-decode #f))
-  (let loop ([c (read-char)])
-    (cond [(eof-object? c)]
-          [(char=? c #\%)
-           (let1 c1 (read-char)
-             (cond
-              [(eof-object? c1) (write-char c)] ;; just be permissive
-              [(digit->integer c1 16)
-               => (^[i1]
-                    (let1 c2 (read-char)
-                      (cond [(eof-object? c2) (write-char c) (write-char c1)]
-                            [(digit->integer c2 16)
-                             => (^[i2]
-                                  (write-byte (+ (* i1 16) i2))
-                                  (loop (read-char)))]
-                            [else (write-char c) (write-char c1) (loop c2)])))]
-                   [else (write-char c) (loop c1)]))]
-          [(char=? c #\+)
-           (if cgi-decode (write-char #\space) (write-char #\+))
-           (loop (read-char))]
-          [else (write-char c) (loop (read-char))])))
+  (%uri-decode-port (current-input-port) (current-output-port) cgi-decode))
 
 (define (uri-decode-string string :key (encoding (gauche-character-encoding))
-                           :allow-other-keys args)
-  (define (wrap out)
-    (wrap-with-output-conversion out (gauche-character-encoding)
-                                 :from-code encoding))
-  (call-with-string-io string
-    (^[in out]
-      (with-ports in (wrap out) (current-error-port)
-        (^[]
-          (apply uri-decode args)
-          (close-output-port (current-output-port)))))))
+                           (cgi-decode #f)
+                           :allow-other-keys)
+  (let1 s (%uri-decode string cgi-decode)
+    (if (ces-upper-compatible? encoding (gauche-character-encoding))
+      s
+      (ces-convert s encoding))))
 
 ;; Default set of characters that can be passed without escaping.
 ;; See 2.3 "Unreserved Characters" of RFC 2396.  It is slightly
@@ -322,23 +326,15 @@
 ;; 'noescape' char-set is only valid in ASCII range.  All bytes
 ;; larger than #x80 are encoded unconditionally.
 (define (uri-encode :key ((:noescape echars) *rfc3986-unreserved-char-set*))
-  (let loop ([b (read-byte)])
-    (unless (eof-object? b)
-      (if (and (< b #x80)
-               (char-set-contains? echars (integer->char b)))
-        (write-byte b)
-        (format #t "%~2,'0X" b))
-      (loop (read-byte)))))
+  (%uri-encode-port (current-input-port) (current-output-port) echars))
 
 (define (uri-encode-string string :key (encoding (gauche-character-encoding))
-                           :allow-other-keys args)
-  (define (wrap in)
-    (wrap-with-input-conversion in (gauche-character-encoding)
-                                :to-code encoding))
-  (call-with-string-io string
-    (^[in out]
-      (with-ports (wrap in) out (current-error-port)
-        (cut apply uri-encode args)))))
+                           ((:noescape echars) *rfc3986-unreserved-char-set*)
+                           :allow-other-keys)
+  (%uri-encode (if (ces-upper-compatible? encoding (gauche-character-encoding))
+                 string
+                 (ces-convert string (gauche-character-encoding) encoding))
+               echars))
 
 ;;==============================================================
 ;; Data uri scheme (rfc2397)
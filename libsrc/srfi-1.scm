@@ -412,6 +412,77 @@
 
 (define (%lset2<= = lis1 lis2) (every (^x (member x lis2 =)) lis1))
 
+;; [SK] The set operations below are O(n*m) with linear member tests.
+;; If the equality predicate is one of those hash tables know, and the
+;; lists are long enough, we use hash tables instead.  For equal?, we
+;; only do so when the elements can be hashed without object-hash.
+;; Note that this doesn't change the order of the results.
+(define-constant %lset-hash-threshold 32)
+
+(define (%lset-simple? x)
+  (or (number? x) (string? x) (symbol? x) (char? x) (boolean? x)
+      (null? x) (keyword? x)))
+
+;; Returns a hash table type to use for LISTS, or #f.
+(define (%lset-hash-type = lists)
+  (and (>= (fold (^[l n] (+ (length l) n)) 0 lists) %lset-hash-threshold)
+       (cond [(eq? = eq?) 'eq?]
+             [(eq? = eqv?) 'eqv?]
+             [(eq? = string=?) 'string=?]
+             [(and (eq? = equal?) (every (cut every %lset-simple? <>) lists))
+              'equal?]
+             [else #f])))
+
+(define (%lset-table type lists)
+  (rlet1 ht (make-hash-table type)
+    (dolist [lis lists]
+      (dolist [x lis] (hash-table-put! ht x #t)))))
+
+;; ANS + LIS, for lset-union.  Returns new elements of LIS consed on ANS.
+(define (%lset-union2 = ans lis)
+  (if-let1 type (%lset-hash-type = (list ans lis))
+    (let1 ht (%lset-table type (list ans))
+      (fold (^[elt ans] (if (hash-table-exists? ht elt)
+                          ans
+                          (begin (hash-table-put! ht elt #t) (cons elt ans))))
+            ans lis))
+    (fold (lambda (elt ans) (if (any (^x (= x elt)) ans)
+                              ans
+                              (cons elt ans)))
+          ans lis)))
+
+;; Destructive version of the above, for lset-union!.
+(define (%lset-union2! = ans lis)
+  (if-let1 type (%lset-hash-type = (list ans lis))
+    (let1 ht (%lset-table type (list ans))
+      (pair-fold (^[pair ans]
+                   (let1 elt (car pair)
+                     (if (hash-table-exists? ht elt)
+                       ans
+                       (begin (hash-table-put! ht elt #t)
+                              (set-cdr! pair ans)
+                              pair))))
+                 ans lis))
+    (pair-fold (lambda (pair ans)
+                 (let ((elt (car pair)))
+                   (if (any (^x (= x elt)) ans)
+                     ans
+                     (begin (set-cdr! pair ans) pair))))
+               ans lis)))
+
+;; Returns a predicate to tell if an element of LIS1 is in every (if
+;; EVERY? is true) or any of LISTS.
+(define (%lset-in-lists = lis1 lists every?)
+  (if-let1 type (%lset-hash-type = (cons lis1 lists))
+    (if every?
+      (let1 hts (map (^l (%lset-table type (list l))) lists)
+        (^x (every (cut hash-table-exists? <> x) hts)))
+      (let1 ht (%lset-table type lists)
+        (^x (hash-table-exists? ht x))))
+    (if every?
+      (^x (every (lambda (lis) (member x lis =)) lists))
+      (^x (any (lambda (lis) (member x lis =)) lists)))))
+
 (define (lset<= = . lists)
   (check-arg procedure? =)
   (or (not (pair? lists)) ; 0-ary case
@@ -446,11 +517,7 @@
             (cond ((null? lis) ans)     ; Don't copy any lists
                   ((null? ans) lis)     ; if we don't have to.
                   ((eq? lis ans) ans)
-                  (else
-                   (fold (lambda (elt ans) (if (any (^x (= x elt)) ans)
-                                             ans
-                                             (cons elt ans)))
-                         ans lis))))
+                  (else (%lset-union2 = ans lis))))
           '() lists))
 
 (define (lset-union! = . lists)
@@ -459,13 +526,7 @@
             (cond ((null? lis) ans)     ; Don't copy any lists
                   ((null? ans) lis)     ; if we don't have to.
                   ((eq? lis ans) ans)
-                  (else
-                   (pair-fold (lambda (pair ans)
-                                (let ((elt (car pair)))
-                                  (if (any (^x (= x elt)) ans)
-                                    ans
-                                    (begin (set-cdr! pair ans) pair))))
-                              ans lis))))
+                  (else (%lset-union2! = ans lis))))
           '() lists))
 
 
@@ -474,18 +535,14 @@
   (let ((lists (delete lis1 lists eq?))) ; Throw out any LIS1 vals.
     (cond ((any null-list? lists) '())          ; Short cut
           ((null? lists)          lis1)         ; Short cut
-          (else (filter (lambda (x)
-                          (every (lambda (lis) (member x lis =)) lists))
-                        lis1)))))
+          (else (filter (%lset-in-lists = lis1 lists #t) lis1)))))
 
 (define (lset-intersection! = lis1 . lists)
   (check-arg procedure? =)
   (let ((lists (delete lis1 lists eq?))) ; Throw out any LIS1 vals.
     (cond ((any null-list? lists) '())          ; Short cut
           ((null? lists)          lis1)         ; Short cut
-          (else (filter! (lambda (x)
-                           (every (lambda (lis) (member x lis =)) lists))
-                         lis1)))))
+          (else (filter! (%lset-in-lists = lis1 lists #t) lis1)))))
 
 
 (define (lset-difference = lis1 . lists)
@@ -493,20 +550,14 @@
   (let ((lists (filter pair? lists)))   ; Throw out empty lists.
     (cond ((null? lists)     lis1)      ; Short cut
           ((memq lis1 lists) '())       ; Short cut
-          (else (filter (lambda (x)
-                          (every (lambda (lis) (not (member x lis =)))
-                                 lists))
-                        lis1)))))
+          (else (remove (%lset-in-lists = lis1 lists #f) lis1)))))
 
 (define (lset-difference! = lis1 . lists)
   (check-arg procedure? =)
   (let ((lists (filter pair? lists)))   ; Throw out empty lists.
     (cond ((null? lists)     lis1)      ; Short cut
           ((memq lis1 lists) '())       ; Short cut
-          (else (filter! (lambda (x)
-                           (every (lambda (lis) (not (member x lis =)))
-                                  lists))
-                         lis1)))))
+          (else (remove! (%lset-in-lists = lis1 lists #f) lis1)))))
 
 
 (define (lset-xor = . lists)
@@ -558,19 +609,15 @@
   (check-arg procedure? =)
   (cond ((every null-list? lists) (values lis1 '()))    ; Short cut
         ((memq lis1 lists)        (values '() lis1))    ; Short cut
-        (else (partition (lambda (elt)
-                           (not (any (lambda (lis) (member elt lis =))
-                                     lists)))
-                         lis1))))
+        (else (let1 in? (%lset-in-lists = lis1 lists #f)
+                (partition (^x (not (in? x))) lis1)))))
 
 (define (lset-diff+intersection! = lis1 . lists)
   (check-arg procedure? =)
   (cond ((every null-list? lists) (values lis1 '()))    ; Short cut
         ((memq lis1 lists)        (values '() lis1))    ; Short cut
-        (else (partition! (lambda (elt)
-                            (not (any (lambda (lis) (member elt lis =))
-                                      lists)))
-                          lis1))))
+        (else (let1 in? (%lset-in-lists = lis1 lists #f)
+                (partition! (^x (not (in? x))) lis1)))))
 
 (define map-in-order map) ; Gauche's map is already in order
 
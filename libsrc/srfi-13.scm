@@ -95,6 +95,12 @@
 (define %maybe-substring (with-module gauche.internal %maybe-substring))
 (define %hash-string (with-module gauche.internal %hash-string))
 (define %string-replace-body! (with-module gauche.internal %string-replace-body!))
+(define %string-index (with-module gauche.internal %string-index))
+(define %string-trim (with-module gauche.internal %string-trim))
+(define %string-tokenize (with-module gauche.internal %string-tokenize))
+(define %string-prefix? (with-module gauche.internal %string-prefix?))
+(define %string-suffix? (with-module gauche.internal %string-suffix?))
+(define %string-contains-ci (with-module gauche.internal %string-contains-ci))
 ;;;
 ;;; Predicates
 ;;;
@@ -203,6 +209,12 @@
 
 (define (string-trim s :optional (c/s/p #[\s]) start end)
   (check-arg string? s)
+  (if (procedure? c/s/p)
+    (%string-trim/pred s c/s/p start end)
+    (%string-trim (%maybe-substring s start end) c/s/p #t #f)))
+
+;; Chars and char-sets are handled natively; these are for predicates.
+(define (%string-trim/pred s c/s/p start end)
   (let ((pred (%get-char-pred c/s/p))
         (sp (make-string-pointer (%maybe-substring s start end))))
     (let loop ((ch (string-pointer-next! sp)))
@@ -214,6 +226,11 @@
 
 (define (string-trim-right s :optional (c/s/p #[\s]) start end)
   (check-arg string? s)
+  (if (procedure? c/s/p)
+    (%string-trim-right/pred s c/s/p start end)
+    (%string-trim (%maybe-substring s start end) c/s/p #f #t)))
+
+(define (%string-trim-right/pred s c/s/p start end)
   (let ((pred (%get-char-pred c/s/p))
         (sp (make-string-pointer (%maybe-substring s start end) -1)))
     (let loop ((ch (string-pointer-prev! sp)))
@@ -225,6 +242,11 @@
 
 (define (string-trim-both s :optional (c/s/p #[\s]) start end)
   (check-arg string? s)
+  (if (procedure? c/s/p)
+    (%string-trim-both/pred s c/s/p start end)
+    (%string-trim (%maybe-substring s start end) c/s/p #t #t)))
+
+(define (%string-trim-both/pred s c/s/p start end)
   (let ((pred (%get-char-pred c/s/p))
         (sp (make-string-pointer (%maybe-substring s start end))))
     (let loop ((ch (string-pointer-next! sp)))
@@ -414,7 +436,7 @@
   (check-arg string? s2)
   (let ((str1 (%maybe-substring s1 start1 end1))
         (str2 (%maybe-substring s2 start2 end2)))
-    (%string-prefix-int str1 str2 char=? (lambda (cnt flag) flag))))
+    (%string-prefix? str1 str2)))
 
 (define (string-prefix-ci? s1 s2 :optional start1 end1 start2 end2)
   (check-arg string? s1)
@@ -457,7 +479,7 @@
   (check-arg string? s2)
   (let ((str1 (%maybe-substring s1 start1 end1))
         (str2 (%maybe-substring s2 start2 end2)))
-    (%string-suffix-int str1 str2 char=? (lambda (cnt flag) flag))))
+    (%string-suffix? str1 str2)))
 
 (define (string-suffix-ci? s1 s2 :optional start1 end1 start2 end2)
   (check-arg string? s1)
@@ -470,8 +492,17 @@
 ;;; Search
 ;;;
 
+(define (%string-index-int s cs args right? skip?)
+  (and-let1 i (%string-index (apply %maybe-substring s args) cs right? skip?)
+    (if (pair? args) (+ (car args) i) i)))
+
 (define (string-index s c/s/p . args)
   (check-arg string? s)
+  (if (procedure? c/s/p)
+    (%string-index/pred s c/s/p args)
+    (%string-index-int s c/s/p args #f #f)))
+
+(define (%string-index/pred s c/s/p args)
   (let ((pred (%get-char-pred c/s/p))
         (offset (if (pair? args) (car args) 0))
         (sp (apply make-string-pointer s 0 args)))
@@ -482,6 +513,11 @@
 
 (define (string-index-right s c/s/p . args)
   (check-arg string? s)
+  (if (procedure? c/s/p)
+    (%string-index-right/pred s c/s/p args)
+    (%string-index-int s c/s/p args #t #f)))
+
+(define (%string-index-right/pred s c/s/p args)
   (let ((pred (%get-char-pred c/s/p))
         (offset (if (pair? args) (car args) 0))
         (sp (apply make-string-pointer s -1 args)))
@@ -492,6 +528,11 @@
 
 (define (string-skip s c/s/p . args)
   (check-arg string? s)
+  (if (procedure? c/s/p)
+    (%string-skip/pred s c/s/p args)
+    (%string-index-int s c/s/p args #f #t)))
+
+(define (%string-skip/pred s c/s/p args)
   (let ((pred (%get-char-pred c/s/p))
         (offset (if (pair? args) (car args) 0))
         (sp (apply make-string-pointer s 0 args)))
@@ -502,6 +543,11 @@
 
 (define (string-skip-right s c/s/p . args)
   (check-arg string? s)
+  (if (procedure? c/s/p)
+    (%string-skip-right/pred s c/s/p args)
+    (%string-index-int s c/s/p args #t #t)))
+
+(define (%string-skip-right/pred s c/s/p args)
   (let ((pred (%get-char-pred c/s/p))
         (offset (if (pair? args) (car args) 0))
         (sp (apply make-string-pointer s -1 args)))
@@ -528,13 +574,12 @@
          (res  (string-scan str1 str2)))
     (and res (+ start1 res))))
 
-;; not tuned (maybe to be moved to native)
 (define (string-contains-ci s1 s2 :optional (start1 0) end1 start2 end2)
   (check-arg string? s1)
   (check-arg string? s2)
-  (let* ((str1 (string-upcase (%maybe-substring s1 start1 end1)))
-         (str2 (string-upcase (%maybe-substring s2 start2 end2)))
-         (res  (string-scan str1 str2)))
+  (let* ((str1 (%maybe-substring s1 start1 end1))
+         (str2 (%maybe-substring s2 start2 end2))
+         (res  (%string-contains-ci str1 str2)))
     (and res (+ start1 res))))
 
 ;;;
@@ -785,25 +830,8 @@
 
 (define (string-tokenize s :optional (token-set #[\S]) start end)
   (check-arg string? s)
-  (letrec ([src (open-input-string (%maybe-substring s start end))]
-           [in-word (^[ch dst r]
-                      (cond [(eof-object? ch)
-                             (reverse! (cons (get-output-string dst) r))]
-                            [(char-set-contains? token-set ch)
-                             (write-char ch dst)
-                             (in-word (read-char src) dst r)]
-                            [else
-                             (out-word (read-char src)
-                                       (cons (get-output-string dst) r))]))]
-           [out-word (^[ch r]
-                       (cond [(eof-object? ch) (reverse! r)]
-                             [(char-set-contains? token-set ch)
-                              (let ((dst (open-output-string)))
-                                (write-char ch dst)
-                                (in-word (read-char src) dst r))]
-                             [else
-                              (out-word (read-char src) r)]))])
-    (out-word (read-char src) '())))
+  ;; Tokens share the storage with S instead of being copied.
+  (%string-tokenize (%maybe-substring s start end) token-set))
 
 ;;;
 ;;; Filter
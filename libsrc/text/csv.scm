@@ -38,7 +38,9 @@
   (use srfi-14)
   (use srfi-42)
   (use gauche.sequence)
+  (use gauche.uvector)
   (export make-csv-reader
+          port->csv-rows
           make-csv-writer
           make-csv-header-parser
           make-csv-record-parser
@@ -46,6 +48,8 @@
   )
 (select-module text.csv)
 
+(autoload control.future make-future touch)
+
 ;;;
 ;;;Low-level API - convert text into nested lists
 ;;;
@@ -56,44 +60,66 @@
     (csv-reader separator quote-char port)))
 
 (define (csv-reader sep quo port)
-  (define (eor? ch) (or (eqv? ch #\newline) (eof-object? ch)))
-
-  (define (start fields)
-    (let1 ch (read-char port)
-      (cond [(eor? ch) (reverse! (cons "" fields))]
-            [(eqv? ch sep) (start (cons "" fields))]
-            [(eqv? ch quo) (quoted fields)]
-            [(char-whitespace? ch) (start fields)]
-            [else (unquoted (list ch) fields)])))
-
-  (define (unquoted chs fields)
-    (let loop ([ch (read-char port)] [last chs] [chs chs])
-      (cond [(eor? ch) (reverse! (cons (finish last) fields))]
-            [(eqv? ch sep) (start (cons (finish last) fields))]
-            [(char-whitespace? ch) (loop (read-char port) last (cons ch chs))]
-            [else (let1 chs (cons ch chs)
-                    (loop (read-char port) chs chs))])))
-
-  (define (finish rchrs) (list->string (reverse! rchrs)))
-
-  (define (quoted fields)
-    (let loop ([ch (read-char port)] [chs '()])
-      (cond [(eof-object? ch) (error "unterminated quoted field")]
-            [(eqv? ch quo)
-             (if (eqv? (peek-char port) quo)
-               (begin (read-char port) (loop (read-char port) (cons quo chs)))
-               (quoted-tail (cons (finish chs) fields)))]
-            [else (loop (read-char port) (cons ch chs))])))
-
-  (define (quoted-tail fields)
-    (let loop ([ch (read-char port)])
-      (cond [(eor? ch) (reverse! fields)]
-            [(eqv? ch sep) (start fields)]
-            [else (loop (read-char port))])))
-
-  (if (eof-object? (peek-char port))
-    (eof-object)
-    (start '())))
+  (%csv-read-record port sep quo))
+
+;; The record reader is implemented in C (ext/text/csv.c).
+(inline-stub
+ (declcode "#include \"csv.h\"")
+
+ (define-cproc %csv-read-record (port::<input-port> sep::<char> quo::<char>)
+   Scm_CSVReadRecord)
+ (define-cproc %csv-record-boundary (buf::<u8vector> sep::<char> quo::<char>)
+   ::<int>
+   (return (Scm_CSVRecordBoundary (cast (const char*) (SCM_UVECTOR_ELEMENTS buf))
+                                  (SCM_UVECTOR_SIZE buf) sep quo)))
+ )
+
+;; API
+;; Reads all records from PORT and returns a list of them.
+;; If PARALLEL is true, the input is split into chunks of about
+;; CHUNK-SIZE bytes at record boundaries, and the chunks are parsed
+;; by futures (see control.future).
+(define (port->csv-rows port separator
+                        :key (quote-char #\") (parallel #f)
+                             (chunk-size 1048576))
+  (define (read-all p)
+    (let loop ([r '()])
+      (let1 row (%csv-read-record p separator quote-char)
+        (if (eof-object? row)
+          (reverse! r)
+          (loop (cons row r))))))
+  (define (parse-chunk buf end)
+    (read-all (open-input-string (u8vector->string buf 0 end))))
+  (define max-pending (* 2 (max 1 (sys-available-processors))))
+  (if (not parallel)
+    (read-all port)
+    ;; PENDING is a queue of futures, in reverse order.  We keep at most
+    ;; MAX-PENDING chunks in flight, to bound the memory usage.
+    (let loop ([rest '#u8()] [pending '()] [results '()])
+      (define (submit buf end)
+        (let1 f (make-future (^[] (parse-chunk buf end)))
+          (if (< (length pending) max-pending)
+            (values (cons f pending) results)
+            (let1 oldest (last pending)
+              (values (cons f (drop-right pending 1))
+                      (cons (touch oldest) results))))))
+      (define (finish pending results)
+        (concatenate (reverse! (fold (^[f rs] (cons (touch f) rs))
+                                     results (reverse pending)))))
+      (let1 chunk (read-uvector <u8vector> chunk-size port)
+        (if (eof-object? chunk)
+          (if (zero? (u8vector-length rest))
+            (finish pending results)
+            (receive (pending results) (submit rest (u8vector-length rest))
+              (finish pending results)))
+          (let* ([buf (if (zero? (u8vector-length rest))
+                        chunk
+                        (u8vector-append rest chunk))]
+                 [b (%csv-record-boundary buf separator quote-char)])
+            (if (< b 0)
+              (loop buf pending results)
+              (receive (pending results) (submit buf b)
+                (loop (u8vector-copy buf b) pending results)))))))))
 
 ;; API
 (define (make-csv-writer separator :optional
@@ -34,22 +34,27 @@
 (define-module text.html-lite
   (use text.tree)
   (use srfi-1)
+  (use util.match)
   (export html-escape html-escape-string html-doctype)
   )
 (select-module text.html-lite)
 
 ;; Escaping ---------------------------------------------
+
+;; The escaping is done in C (ext/text/html.c).
+(inline-stub
+ (declcode "#include \"html.h\"")
+
+ (define-cproc %html-escape-string (s::<string>) Scm_HtmlEscapeString)
+ (define-cproc %html-escape-port (in::<input-port> out::<output-port>)
+   ::<void> Scm_HtmlEscapePort)
+ )
+
 (define (html-escape)
-  (generator-for-each (^c (case c
-                            [(#\<) (display "&lt;")]
-                            [(#\>) (display "&gt;")]
-                            [(#\&) (display "&amp;")]
-                            [(#\") (display "&quot;")]
-                            [else (display c)]))
-                      read-char))
+  (%html-escape-port (current-input-port) (current-output-port)))
 
 (define (html-escape-string string)
-  (with-string-io (x->string string) html-escape))
+  (%html-escape-string (x->string string)))
 
 ;; Doctype ----------------------------------------------
 
@@ -96,25 +101,26 @@
 
 ;; Elements ------------------------------------------------
 
+(define (K k) (keyword->string k)) ;; we don't need leading colon
+
+;; Renders an attribute KEY=VAL.
+(define (render-attr key val)
+  (cond [(eq? val #f) '()]
+        [(eq? val #t) (list " " (K key))]
+        [else (list " " (K key) "=\"" (html-escape-string (x->string val))
+                    "\"")]))
+
 (define (make-html-element name . args)
   (let ((empty? (get-keyword :empty? args #f)))
-    (define (K k) (keyword->string k)) ;; we don't need leading colon
     (define (get-attr args attrs)
       (cond ((null? args) (values (reverse attrs) args))
             ((keyword? (car args))
              (cond ((null? (cdr args))
                     (values (reverse (list* (K (car args)) " " attrs)) args))
-                   ((eq? (cadr args) #f)
-                    (get-attr (cddr args) attrs))
-                   ((eq? (cadr args) #t)
-                    (get-attr (cddr args) (list* (K (car args)) " " attrs)))
                    (else
                     (get-attr (cddr args)
-                              (list* (format #f "=\"~a\""
-                                             (html-escape-string (x->string (cadr args))))
-                                     (K (car args))
-                                     " "
-                                     attrs)))))
+                              (cons (render-attr (car args) (cadr args))
+                                    attrs)))))
             (else (values (reverse attrs) args))))
 
     (if empty?
@@ -127,24 +133,98 @@
         (receive (attr args) (get-attr args '())
           (list "<" name attr ">" args "</" name "\n>"))))))
 
+;; Compile-time rendering ------------------------------------
+;;
+;; Each html:* procedure has a compiler macro that renders the constant
+;; parts of the call into strings.  E.g.
+;;
+;;   (html:p :class "x" (html:b "Note:") text)
+;;    => (list "<p class=\"x\"><b>Note:</b\n>" text "</p\n>")
+;;
+;; A call whose arguments are all constant becomes a single string.  We
+;; give up if we can't tell where the attributes end, that is, if the
+;; first argument that isn't a literal keyword may evaluate to a keyword.
+
+;; html:* symbol -> (name . empty?)
+(define *html-elements* (make-hash-table 'eq?))
+
+(define (html-call-info x rename compare)
+  (and (pair? x)
+       (let1 sym (unwrap-syntax (car x))
+         (and (symbol? sym)
+              (and-let* ([info (hash-table-get *html-elements* sym #f)]
+                         [ (compare (car x) (rename sym)) ])
+                info)))))
+
+(define (literal? x)
+  (or (string? x) (number? x) (char? x) (boolean? x) (keyword? x)))
+
+;; Returns the rendered expression of the call FORM, or #f.
+(define (render-html-call form name empty? rename compare)
+  (define (finish attrs content)
+    (and (or (not empty?) (null? content))
+         (let1 pieces (if empty?
+                        `(,#"<~name" ,@attrs " />")
+                        `(,#"<~name" ,@attrs ">"
+                          ,@(map render-content content)
+                          ,#"</~|name|\n>"))
+           (merge-pieces pieces))))
+  (define (render-content x)
+    (cond [(literal? x) (x->string x)]
+          [(html-call-info x rename compare)
+           => (^[info]
+                (or (render-html-call x (car info) (cdr info) rename compare)
+                    x))]
+          [else x]))
+  (define (merge-pieces pieces)
+    (let loop ([ps pieces] [strs '()] [r '()])
+      (define (flush)
+        (if (null? strs) r (cons (apply string-append (reverse strs)) r)))
+      (cond [(null? ps)
+             (match (reverse (flush))
+               [((? string? s)) s]
+               [xs `(,(rename 'list) ,@xs)])]
+            [(string? (car ps)) (loop (cdr ps) (cons (car ps) strs) r)]
+            [else (loop (cdr ps) '() (cons (car ps) (flush)))])))
+  (let loop ([args (cdr form)] [attrs '()])
+    (cond [(null? args) (finish (reverse attrs) '())]
+          [(keyword? (car args))
+           (cond [(null? (cdr args)) #f]
+                 [(literal? (cadr args))
+                  (loop (cddr args)
+                        (cons (tree->string (render-attr (car args)
+                                                         (cadr args)))
+                              attrs))]
+                 [else
+                  (loop (cddr args)
+                        (cons `(,(rename 'render-attr) ,(car args) ,(cadr args))
+                              attrs))])]
+          [(or (literal? (car args))
+               (html-call-info (car args) rename compare))
+           (finish (reverse attrs) args)]
+          [else #f])))
+
+(define (html-element-expander name empty?)
+  (^[form rename compare]
+    (or (render-html-call form name empty? rename compare) form)))
+
 (define-macro (define-html-elements . elements)
   (define (make-scheme-name name)
     (string->symbol (format #f "html:~a" name)))
+  (define (defs name empty?)
+    (let1 sname (make-scheme-name name)
+      `((define ,sname (make-html-element ',name :empty? ,empty?))
+        (export ,sname)
+        (hash-table-put! *html-elements* ',sname '(,name . ,empty?))
+        (define-compiler-macro ,sname
+          (er-transformer (html-element-expander ',name ,empty?))))))
   (let loop ((elements elements)
              (r '()))
-    (cond ((null? elements) `(begin ,@(reverse r)))
+    (cond ((null? elements) `(begin ,@r))
           ((and (pair? (cdr elements)) (eqv? (cadr elements) :empty))
-           (loop (cddr elements)
-                 (list* `(define ,(make-scheme-name (car elements))
-                           (make-html-element ',(car elements) :empty? #t))
-                        `(export ,(make-scheme-name (car elements)))
-                        r)))
+           (loop (cddr elements) (append r (defs (car elements) #t))))
           (else
-           (loop (cdr elements)
-                 (list* `(define ,(make-scheme-name (car elements))
-                           (make-html-element ',(car elements)))
-                        `(export ,(make-scheme-name (car elements)))
-                        r))))
+           (loop (cdr elements) (append r (defs (car elements) #f)))))
     ))
 
 ;; http://www.w3.org/TR/html4/sgml/dtd.html
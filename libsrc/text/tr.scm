@@ -37,43 +37,85 @@
   (use srfi-1)
   (use srfi-13)
   (use gauche.generator)
+  (use gauche.uvector)
   (export tr transliterate string-tr string-transliterate
           build-transliterator)
   )
 (select-module text.tr)
 
+(autoload gauche.threads atom atomic)
+
+;; The transliteration itself is done in C (ext/text/tr.c), with the
+;; table compiled into s32vectors.  See tr.h for the format.
+(inline-stub
+ (declcode "#include \"tr.h\"")
+
+ (define-cproc %tr-string (str::<string> flat::<s32vector> sparse::<s32vector>
+                           flags::<int>)
+   (return (Scm_TrString str (SCM_UVECTOR flat) (SCM_UVECTOR sparse) flags)))
+ (define-cproc %tr-port (in::<input-port> out::<output-port>
+                         flat::<s32vector> sparse::<s32vector> flags::<int>)
+   ::<void>
+   (Scm_TrPort in out (SCM_UVECTOR flat) (SCM_UVECTOR sparse) flags))
+ (define-enum SCM_TR_DELETE)
+ (define-enum SCM_TR_SQUEEZE)
+ (define-enum SCM_TR_NOT_IN_FROM)
+ (define-enum SCM_TR_NO_MAP)
+ (define-enum SCM_TR_SPARSE_OFFSET)
+ (define-enum SCM_TR_SPARSE_CHAR)
+ (define-enum SCM_TR_SPARSE_NO_MAP)
+ )
+
 (define (tr from to . options)
   ((apply build-transliterator from to options)))
 
 (define transliterate tr)               ;alias
 
-(define (string-tr str from to . options)
-  (with-string-io str (cut apply tr from to options)))
+(define (string-tr str from to :key ((:delete d?) #f) ((:squeeze s?) #f)
+                   ((:complement c?) #f) ((:table-size size) 256)
+                   :allow-other-keys)
+  (receive (flat sparse) (compiled-tr-table from to size c?)
+    (%tr-string str flat sparse (tr-flags d? s?))))
 
 (define string-transliterate string-tr) ;alias
 
 (define (build-transliterator from to :key ((:delete d?) #f) ((:squeeze s?) #f)
                               ((:complement c?) #f) ((:table-size size) 256)
                               (input #f) (output #f))
-  (let1 tab (build-tr-table from to size c?)
+  (receive (flat sparse) (compiled-tr-table from to size c?)
     (^[]
-      (let ([in  (or input (current-input-port))]
-            [out (or output (current-output-port))])
-        (let loop ([char (read-char in)] [prev #f])
-          (unless (eof-object? char)
-            (let1 c (tr-table-ref tab (char->integer char))
-              (cond
-               [(char? c)               ;transliterated
-                (unless (and s? (eqv? prev c)) (display c out))
-                (loop (read-char in) c)]
-               [c                       ;char is not in from-set
-                (display char out)
-                (loop (read-char in) #f)]
-               [(not d?)                ;char is in from but not to, and no :d
-                (unless (and s? (eqv? prev char)) (display char out))
-                (loop (read-char in) char)]
-               [else
-                (loop (read-char in) prev)]))))))))
+      (%tr-port (or input (current-input-port))
+                (or output (current-output-port))
+                flat sparse (tr-flags d? s?)))))
+
+(define (tr-flags delete? squeeze?)
+  (logior (if delete? SCM_TR_DELETE 0)
+          (if squeeze? SCM_TR_SQUEEZE 0)))
+
+;; Compiled tables are cached, for the same specs are likely to be
+;; used repeatedly (e.g. string-tr in a loop).
+(define-constant *tr-cache-size* 256)
+(define %tr-cache (atom (make-hash-table 'equal?)))
+
+(define (compiled-tr-table from to size compl?)
+  (let1 key (list from to size compl?)
+    (apply values
+           (atomic %tr-cache
+                   (^[tab]
+                     (or (hash-table-get tab key #f)
+                         (rlet1 r (receive (flat sparse)
+                                      (compile-tr-table
+                                       (build-tr-table from to size compl?))
+                                    (list flat sparse))
+                           (when (>= (hash-table-num-entries tab)
+                                     *tr-cache-size*)
+                             (hash-table-clear! tab))
+                           ;; the key strings may be mutated later
+                           (hash-table-put! tab
+                                            (list (string-copy from)
+                                                  (string-copy to)
+                                                  size compl?)
+                                            r))))))))
 
 ;;--------------------------------------------------------------------
 ;; Parse character array syntax
@@ -272,6 +314,21 @@
                  v))]
             [else (loop (cdr e))]))))
 
+;; Converts <tr-table> into the s32vectors the C engine uses.
+(define (compile-tr-table tab)
+  (define (code v)
+    (cond [(char? v) (char->integer v)]
+          [v  SCM_TR_NOT_IN_FROM]
+          [else SCM_TR_NO_MAP]))
+  (define (sparse-group e)              ; e : (from to value)
+    (let1 v (caddr e)
+      (cond [(integer? v) (list (car e) (cadr e) SCM_TR_SPARSE_OFFSET v)]
+            [(char? v) (list (car e) (cadr e) SCM_TR_SPARSE_CHAR
+                             (char->integer v))]
+            [else (list (car e) (cadr e) SCM_TR_SPARSE_NO_MAP 0)])))
+  (values (vector->s32vector (vector-map code (vector-of tab)))
+          (list->s32vector (append-map sparse-group (sparse-of tab)))))
+
 (define (build-tr-table from-spec to-spec size compl?)
   (rlet1 tab (make <tr-table> :vector-size size)
     (let ([from-ca (build-char-array from-spec size)]
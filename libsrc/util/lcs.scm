@@ -46,7 +46,7 @@
   (export lcs lcs-with-positions lcs-fold lcs-edit-list))
 (select-module util.lcs)
 
-;; The base algorithm.   This code implements
+;; The base algorithm is implemented in C (lcs.c).  It implements
 ;; Eugene Myers, "An O(ND) Difference Algorithm and Its Variations",
 ;; Algorithmica Vol. 1 No. 2, 1986, pp. 251-266.
 ;; It takes O((M+N)D) time and O((M+N)L) space, where
@@ -58,69 +58,25 @@
 ;; The Myers's paper gives refinement of the algorithm
 ;; that improves worst case behavior, but I don't implement it yet. --[SK]
 
-(define (lcs-with-positions a-ls b-ls :optional (eq equal?))
-  (let* ((A  (list->vector a-ls))
-         (B  (list->vector b-ls))
-         (N  (vector-length A))
-         (M  (vector-length B))
-         (M+N (+ N M))
-         (V_d (make-vector (+ (* 2 M+N) 1) 0))
-         (V_r (make-vector (+ (* 2 M+N) 1) '()))
-         (V_l (make-vector (+ (* 2 M+N) 1) 0)))
+(inline-stub
+ (declcode "#include \"lcs.h\"")
 
-    (let-syntax ((vd
-                  (syntax-rules ()
-                    ((vd i) (vector-ref V_d (+ i M+N)))
-                    ((vd i x) (vector-set! V_d (+ i M+N) x))))
-                 (vr
-                  (syntax-rules ()
-                    ((vr i) (vector-ref V_r (+ i M+N)))
-                    ((vr i x) (vector-set! V_r (+ i M+N) x))))
-                 (vl
-                  (syntax-rules ()
-                    ((vl i) (vector-ref V_l (+ i M+N)))
-                    ((vl i x) (vector-set! V_l (+ i M+N) x)))))
+ (define-enum SCM_LCS_EQ)
+ (define-enum SCM_LCS_EQV)
+ (define-enum SCM_LCS_EQUAL)
+ (define-enum SCM_LCS_PROC)
 
-      (define (finish)
-        (let loop ((i (- M+N)) (maxl 0) (r '()))
-          (cond ((> i M+N) (list maxl (reverse! r)))
-                ((> (vl i) maxl)
-                 (loop (+ i 1) (vl i) (vr i)))
-                (else
-                 (loop (+ i 1) maxl r)))))
+ (define-cproc %lcs-with-positions (a::<list> b::<list> cmp::<int> proc)
+   (return (Scm_LCSWithPositions a b cmp proc)))
+ )
 
-      (if (zero? M+N)
-        '(0 ()) ;; boundary case
-        (let d-loop ((d 0))
-          (if (> d M+N)
-            (error "lcs-with-positions; something's wrong (implementation error?)")
-            (let k-loop ((k (- d)))
-              (if (> k d)
-                (d-loop (+ d 1))
-                (receive (x l r)
-                    (if (or (= k (- d))
-                            (and (not (= k d))
-                                 (< (vd (- k 1)) (vd (+ k 1)))))
-                      (values (vd (+ k 1)) (vl (+ k 1)) (vr (+ k 1)))
-                      (values (+ (vd (- k 1)) 1) (vl (- k 1)) (vr (- k 1))))
-                  (receive (x y l r)
-                      (let xy-loop ((x x) (y (- x k)) (l l) (r r))
-                        (cond ((>= x N) (values x y l r))
-                              ((>= y M) (values x y l r))
-                              ((eq (vector-ref A x) (vector-ref B y))
-                               (xy-loop (+ x 1) (+ y 1) (+ l 1)
-                                        (cons (list (vector-ref A x) x y)
-                                              r)))
-                              (else (values x y l r))))
-                    (vd k x)
-                    (vr k r)
-                    (vl k l)
-                    (if (and (>= x N) (>= y M))
-                      (finish)
-                      (k-loop (+ k 2))))
-                  )))
-            )))
-      )))
+(define (lcs-with-positions a-ls b-ls :optional (eq equal?))
+  (%lcs-with-positions a-ls b-ls
+                       (cond [(eq? eq equal?) SCM_LCS_EQUAL]
+                             [(eq? eq eqv?)   SCM_LCS_EQV]
+                             [(eq? eq eq?)    SCM_LCS_EQ]
+                             [else            SCM_LCS_PROC])
+                       eq))
 
 ;; Just returns the LCS
 (define (lcs a b :optional (eq equal?))
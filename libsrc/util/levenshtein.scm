@@ -69,6 +69,24 @@
 ;;  hand, this one restricts how transposition is applied and is not
 ;;  fully compatible to Damerau-Levenshtein.
 
+;; If A and all of Bs are strings and the elements are compared by
+;; their values, Levenshtein and restricted edit distances are calculated
+;; by the bit-parallel algorithms in C (levenshtein.c), which process
+;; one character of B in O(ceil(length(A)/64)) word operations.  The
+;; restricted edit distance is handled there only when A has at most
+;; 64 characters.  Other cases are handled by the DP in Scheme below.
+
+(inline-stub
+ (declcode "#include \"levenshtein.h\"")
+
+ (define-cproc %edit-distances (a bs::<list> cutoff transpose::<boolean>)
+   (return (Scm_EditDistances a bs cutoff transpose)))
+ )
+
+;; Returns true if elt= compares characters by their values
+(define (char-value-elt=? elt=)
+  (or (eq? elt= eqv?) (eq? elt= eq?) (eq? elt= equal?) (eq? elt= char=?)))
+
 ;; It is often explaned using (N+k)x(M+k) array for dynamic programming
 ;; (k=1 or 2), but we only need to refer to look back at most k rows,
 ;; so we can run the algorithm with k+1 rows and rotating them.
@@ -147,10 +165,11 @@
     (map f Bs)))
       
 (define (l-distance A B :key (elt= eqv?) (cutoff #f))
-  (car (l-base A (list B) elt= cutoff)))
+  (car (l-distances A (list B) :elt= elt= :cutoff cutoff)))
 
 (define (l-distances A Bs  :key (elt= eqv?) (cutoff #f))
-  (l-base A Bs elt= cutoff))
+  (or (and (char-value-elt=? elt=) (%edit-distances A Bs cutoff #f))
+      (l-base A Bs elt= cutoff)))
 
 ;; Restricted Edit distance
 ;;
@@ -193,7 +212,7 @@
               (let* ([d (min (+ (vector-ref row-0 (+ i 1)) 1)
                              (+ (vector-ref row-1 (+ i 2)) 1)
                              (+ (vector-ref row-1 (+ i 1)) (if (elt= a b) 0 1)))]
-                     [d (if (and (> i 1) (> j 1)
+                     [d (if (and (> i 0) (> j 0)
                                  (elt= (aref i)       (bref (- j 1)))
                                  (elt= (aref (- i 1)) (bref j)))
                           (min d (+ (vector-ref (caddr rows) i)
@@ -219,10 +238,11 @@
     (map f Bs)))
       
 (define (re-distance A B :key (elt= eqv?) (cutoff #f))
-  (car (re-base A (list B) elt= cutoff)))
+  (car (re-distances A (list B) :elt= elt= :cutoff cutoff)))
 
 (define (re-distances A Bs  :key (elt= eqv?) (cutoff #f))
-  (re-base A Bs elt= cutoff))
+  (or (and (char-value-elt=? elt=) (%edit-distances A Bs cutoff #t))
+      (re-base A Bs elt= cutoff)))
 
 ;; Damerau-Levenshtein distance
 ;; We need a way to look up the last character position seen in A.
@@ -895,6 +895,9 @@
       (assm tst k s)))))
 
 (define (assm tst f s)
+  (assm-1 (runtime-test tst) f s))
+
+(define (assm-1 tst f s)
   (cond
    ((equal? s f) s)
    ((and (eq? s #t) (eq? f #f)) tst)
@@ -967,7 +970,7 @@
       `(call-with-current-continuation
         (lambda (,k)
           (let ((,fail (lambda () (call-with-values (lambda () ,f) ,k))))
-            ,(assm tst `(,fail) s2))))))
+            ,(assm-1 tst `(,fail) s2))))))
    ((and #f
          (pair? s)
          (equal? (car s) 'let)
@@ -989,9 +992,29 @@
     (let ((fail (caaadr s))
           (s2 (caddr s)))
       `(let ((,fail (lambda () ,f)))
-         ,(assm tst `(,fail) s2))))
+         ,(assm-1 tst `(,fail) s2))))
    (else `(if ,tst ,s ,f))))
 
+;; While generating code, literal comparisons are kept as (equal? e p) so
+;; that `in' can reason about them.  When we finally emit a test, we use
+;; eq? or eqv? if it gives the same answer, for the compiler can open-code
+;; them (often into a single branch instruction) while equal? is a call.
+(define (runtime-test tst)
+  (if (and (eq? (car tst) 'equal?)
+           (pair? (cdr tst))
+           (pair? (cddr tst))
+           (null? (cdddr tst)))
+    (let* ([e (cadr tst)]
+           [p (caddr tst)]
+           [d (if (and (pair? p) (eq? (car p) 'quote) (pair? (cdr p)))
+                (cadr p)
+                p)])
+      (cond
+       [(or (symbol? d) (keyword? d) (boolean? d) (null? d)) `(eq? ,e ,p)]
+       [(or (char? d) (number? d)) `(eqv? ,e ,p)]
+       [else tst]))
+    tst))
+
 (define (guarantees code x)
   (let ((a (add-a x)) (d (add-d x)))
     (let loop ((code code))
@@ -141,7 +141,9 @@
           debug-print-pre debug-print-post debug-funcall-pre)
 
 (autoload gauche.vm.profiler
-          profiler-show profiler-show-load-stats with-profiler)
+          profiler-show profiler-show-load-stats with-profiler
+          profiler-snapshot profiler-export-folded profiler-export-pprof
+          profiler-alloc-snapshot)
 
 (autoload srfi-0  (:macro cond-expand))
 (autoload srfi-7  (:macro program))
@@ -190,7 +192,7 @@
                           string-hash string-ci-hash
                           symbol-hash number-hash hash-bound)
 
-(autoload gauche.treeutil make-tree-map tree-map-empty?
+(autoload gauche.treeutil make-tree-map make-btree-map tree-map-empty?
                           tree-map-min tree-map-max
                           tree-map-pop-min! tree-map-pop-max!
                           tree-map-fold tree-map-fold-right
@@ -838,12 +838,159 @@ static ScmBignum *bignum_mul_word(ScmBignum *br, const ScmBignum *bx,
     return br;
 }
 
+/* Threshold, in words, above which Karatsuba multiplication is used.
+   Below it, the schoolbook method is faster. */
+#ifndef BIGNUM_KARATSUBA_THRESHOLD
+#define BIGNUM_KARATSUBA_THRESHOLD 24
+#endif
+
+/* Word-array routines used by Karatsuba multiplication.  Arrays are
+   least significant word first. */
+
+/* a[0..an) += b[0..bn), an >= bn.  Returns the carry. */
+static u_long words_add(u_long *a, int an, const u_long *b, int bn)
+{
+    u_long c = 0;
+    int i;
+    for (i=0; i<bn; i++) {
+        u_long r;
+        UADD(r, c, a[i], b[i]);
+        a[i] = r;
+    }
+    for (; c && i<an; i++) {
+        u_long r;
+        UADD(r, c, a[i], 0);
+        a[i] = r;
+    }
+    return c;
+}
+
+/* a[0..an) -= b[0..bn), an >= bn.  Returns the borrow. */
+static u_long words_sub(u_long *a, int an, const u_long *b, int bn)
+{
+    u_long c = 0;
+    int i;
+    for (i=0; i<bn; i++) {
+        u_long r;
+        USUB(r, c, a[i], b[i]);
+        a[i] = r;
+    }
+    for (; c && i<an; i++) {
+        u_long r;
+        USUB(r, c, a[i], 0);
+        a[i] = r;
+    }
+    return c;
+}
+
+/* r[0..xn+yn) = x[0..xn) * y[0..yn), schoolbook. */
+static void words_mul_basecase(u_long *r, const u_long *x, int xn,
+                               const u_long *y, int yn)
+{
+    for (int i=0; i<xn+yn; i++) r[i] = 0;
+    for (int j=0; j<yn; j++) {
+        u_long c = 0, yj = y[j];
+        if (yj == 0) continue;
+        for (int i=0; i<xn; i++) {
+            u_long hi, lo, t, c1 = 0, c2 = 0;
+            UMUL(hi, lo, x[i], yj);
+            UADD(t, c1, lo, c);
+            UADD(lo, c2, t, r[i+j]);
+            r[i+j] = lo;
+            c = hi + c1 + c2;   /* never overflows */
+        }
+        r[j+xn] = c;
+    }
+}
+
+/* Number of scratch words needed by words_mul_karatsuba for size N. */
+static int karatsuba_scratch_size(int n)
+{
+    int s = 0;
+    while (n >= BIGNUM_KARATSUBA_THRESHOLD) {
+        int m = n - n/2;
+        s += 4*(m+1);
+        n = m+1;
+    }
+    return s;
+}
+
+/* r[0..2n) = x[0..n) * y[0..n).  SCRATCH must have at least
+   karatsuba_scratch_size(n) words.
+   With x = x1*B^h + x0 and y = y1*B^h + y0,
+     x*y = z2*B^2h + (z1 - z2 - z0)*B^h + z0
+   where z2 = x1*y1, z0 = x0*y0, and z1 = (x0+x1)*(y0+y1). */
+static void words_mul_karatsuba(u_long *r, const u_long *x, const u_long *y,
+                                int n, u_long *scratch)
+{
+    if (n < BIGNUM_KARATSUBA_THRESHOLD) {
+        words_mul_basecase(r, x, n, y, n);
+        return;
+    }
+    int h = n/2, m = n - h;
+    u_long *sx = scratch, *sy = scratch + (m+1), *t = scratch + 2*(m+1);
+
+    words_mul_karatsuba(r, x, y, h, scratch);
+    words_mul_karatsuba(r + 2*h, x + h, y + h, m, scratch);
+
+    for (int i=0; i<m; i++) sx[i] = x[h+i];
+    sx[m] = words_add(sx, m, x, h);
+    for (int i=0; i<m; i++) sy[i] = y[h+i];
+    sy[m] = words_add(sy, m, y, h);
+    words_mul_karatsuba(t, sx, sy, m+1, scratch + 4*(m+1));
+
+    words_sub(t, 2*(m+1), r, 2*h);
+    words_sub(t, 2*(m+1), r + 2*h, 2*m);
+    /* The middle term is less than B^(2m+1), so the top word is zero. */
+    words_add(r + h, 2*n - h, t, 2*m+1);
+}
+
+/* r[0..xn+yn) = x[0..xn) * y[0..yn), xn >= yn >= threshold.
+   Splits x into yn-word chunks to multiply with Karatsuba. */
+static void words_mul_large(u_long *r, const u_long *x, int xn,
+                            const u_long *y, int yn)
+{
+    int ssize = karatsuba_scratch_size(yn);
+
+    if (xn == yn) {
+        u_long *scratch = SCM_NEW_ATOMIC_ARRAY(u_long, ssize);
+        words_mul_karatsuba(r, x, y, yn, scratch);
+        return;
+    }
+
+    u_long *tmp = SCM_NEW_ATOMIC_ARRAY(u_long, 2*yn + ssize);
+    u_long *scratch = tmp + 2*yn;
+    for (int i=0; i<xn+yn; i++) r[i] = 0;
+    for (int off=0; off<xn; off+=yn) {
+        int chunk = xn - off;
+        if (chunk >= yn) {
+            words_mul_karatsuba(tmp, x + off, y, yn, scratch);
+            words_add(r + off, xn + yn - off, tmp, 2*yn);
+        } else if (chunk >= BIGNUM_KARATSUBA_THRESHOLD) {
+            words_mul_large(tmp, y, yn, x + off, chunk);
+            words_add(r + off, xn + yn - off, tmp, yn + chunk);
+        } else {
+            words_mul_basecase(tmp, y, yn, x + off, chunk);
+            words_add(r + off, xn + yn - off, tmp, yn + chunk);
+        }
+    }
+}
+
 /* returns bx * by.  not normalized */
 static ScmBignum *bignum_mul(const ScmBignum *bx, const ScmBignum *by)
 {
     ScmBignum *br = make_bignum(bx->size + by->size);
-    for (u_int i=0; i<by->size; i++) {
-        bignum_mul_word(br, bx, by->values[i], i);
+    if (bx->size < BIGNUM_KARATSUBA_THRESHOLD
+        || by->size < BIGNUM_KARATSUBA_THRESHOLD) {
+        for (u_int i=0; i<by->size; i++) {
+            bignum_mul_word(br, bx, by->values[i], i);
+        }
+    } else if (bx->size >= by->size) {
+        words_mul_large(br->values, bx->values, bx->size,
+                        by->values, by->size);
+    } else {
+        words_mul_large(br->values, by->values, by->size,
+                        bx->values, bx->size);
     }
     br->sign = bx->sign * by->sign;
     return br;
@@ -1086,6 +1233,81 @@ long Scm_BignumRemSI(const ScmBignum *dividend, long divisor)
 #endif
 }
 
+/*-----------------------------------------------------------------------
+ * Division of large numbers
+ *
+ *   When both the divisor and the quotient are large, we compute
+ *   the reciprocal of the divisor with Newton iteration and multiply,
+ *   so that the division costs a few multiplications, which are fast
+ *   with Karatsuba.  These work on Scheme integers with generic
+ *   arithmetic, for the operands are large enough that the allocation
+ *   overhead doesn't matter.
+ */
+
+/* Use Newton division if both the divisor and the quotient have more
+   words than this. */
+#ifndef BIGNUM_NEWTON_THRESHOLD
+#define BIGNUM_NEWTON_THRESHOLD 100
+#endif
+
+/* Number of bits of nonnegative exact integer X. */
+static long integer_bits(ScmObj x)
+{
+    if (SCM_INTP(x)) {
+        long v = SCM_INT_VALUE(x);
+        return v ? Scm__HighestBitNumber((u_long)v) + 1 : 0;
+    }
+    const ScmBignum *b = SCM_BIGNUM(x);
+    int k = (int)b->size;
+    while (k > 0 && b->values[k-1] == 0) k--;
+    if (k == 0) return 0;
+    return (long)(k-1)*WORD_BITS + Scm__HighestBitNumber(b->values[k-1]) + 1;
+}
+
+/* V is a positive integer of P bits.  Returns an approximation of
+   2^(2P)/V, with an error of a few units. */
+static ScmObj newton_reciprocal(ScmObj v, long p)
+{
+    if (p <= BIGNUM_NEWTON_THRESHOLD*WORD_BITS) {
+        return Scm_Quotient(Scm_Ash(SCM_MAKE_INT(1), 2*p), v, NULL);
+    }
+    /* Get the reciprocal of the upper H bits of V, which approximates
+       x = 2^(2P)/V to about H bits, then one Newton step
+          x' = x + x * (2^(2P) - V*x) / 2^(2P)
+       doubles the precision.  Note that x = xh * 2^(P-H). */
+    long h = p/2 + WORD_BITS;
+    ScmObj xh = newton_reciprocal(Scm_Ash(v, -(p - h)), h);
+    ScmObj e = Scm_Sub(Scm_Ash(SCM_MAKE_INT(1), 2*p),
+                       Scm_Ash(Scm_Mul(v, xh), p - h));
+    return Scm_Add(Scm_Ash(xh, p - h),
+                   Scm_Ash(Scm_Mul(xh, e), (p - h) - 2*p));
+}
+
+/* A and D are positive integers.  Returns the quotient and sets
+   the remainder in *R. */
+static ScmObj newton_divrem(ScmObj a, ScmObj d, ScmObj *r)
+{
+    long m = integer_bits(a), n = integer_bits(d);
+    long p = (m - n + 1) + 2*WORD_BITS; /* quotient bits + guard */
+
+    /* a/d ~ (a*2^(p-n)) / (d*2^(p-n)), where the latter has P bits. */
+    ScmObj x = newton_reciprocal(Scm_Ash(d, p - n), p);
+    ScmObj q = Scm_Ash(Scm_Mul(Scm_Ash(a, p - n), x), -2*p);
+
+    /* The estimated quotient is off by a few at most.  Fix it up. */
+    ScmObj rr = Scm_Sub(a, Scm_Mul(q, d));
+    while (Scm_Sign(rr) < 0) {
+        q = Scm_Sub(q, SCM_MAKE_INT(1));
+        rr = Scm_Add(rr, d);
+    }
+    while (Scm_NumCmp(rr, d) >= 0) {
+        q = Scm_Add(q, SCM_MAKE_INT(1));
+        rr = Scm_Sub(rr, d);
+    }
+    *r = rr;
+    return q;
+}
+
 /* assuming dividend and divisor is normalized.  returns quotient and
    remainder */
 ScmObj Scm_BignumDivRem(const ScmBignum *dividend, const ScmBignum *divisor)
@@ -1095,6 +1317,16 @@ ScmObj Scm_BignumDivRem(const ScmBignum *dividend, const ScmBignum *divisor)
         return Scm_Cons(SCM_MAKE_INT(0), SCM_OBJ(dividend));
     }
 
+    if (divisor->size > BIGNUM_NEWTON_THRESHOLD
+        && dividend->size - divisor->size > BIGNUM_NEWTON_THRESHOLD) {
+        ScmObj r;
+        ScmObj q = newton_divrem(Scm_Abs(SCM_OBJ(dividend)),
+                                 Scm_Abs(SCM_OBJ(divisor)), &r);
+        if (dividend->sign * divisor->sign < 0) q = Scm_Negate(q);
+        if (dividend->sign < 0) r = Scm_Negate(r);
+        return Scm_Cons(q, r);
+    }
+
     ScmBignum *q = make_bignum(dividend->size - divisor->size + 1);
     ScmBignum *r = bignum_gdiv(dividend, divisor, q);
     q->sign = dividend->sign * divisor->sign;
@@ -1277,24 +1509,107 @@ int Scm_BignumLogCount(const ScmBignum *b)
  * Printing
  */
 
+/* Use divide-and-conquer conversion if the number has more words
+   than this. */
+#ifndef BIGNUM_TOSTRING_THRESHOLD
+#define BIGNUM_TOSTRING_THRESHOLD 200
+#endif
+
+/* Write digits of nonnegative integer X, which must be a mutable
+   bignum whose size has no leading zero words, backward from END.
+   Each bignum_sdiv takes CHUNK digits, using divisor CHUNKVAL =
+   RADIX^CHUNK.  If WIDTH > 0, leading zeros are padded to make it
+   WIDTH digits.  Returns the pointer to the first digit. */
+static char *bignum_to_digits_simple(ScmBignum *x, int radix, int chunk,
+                                     u_long chunkval, const char *tab,
+                                     long width, char *end)
+{
+    char *p = end;
+    while (x->size > 0) {
+        u_long rem = bignum_sdiv(x, chunkval);
+        while (x->size > 0 && x->values[x->size-1] == 0) x->size--;
+        if (x->size > 0) {
+            for (int i=0; i<chunk; i++, rem /= radix) *--p = tab[rem%radix];
+        } else {
+            for (; rem > 0; rem /= radix) *--p = tab[rem%radix];
+        }
+    }
+    while (end - p < width) *--p = '0';
+    return p;
+}
+
+/* Divide-and-conquer version.  POWS[i] is RADIX^(CHUNK*2^i).  X is
+   a nonnegative integer less than POWS[LEVEL+1]. */
+static char *bignum_to_digits_rec(ScmObj x, ScmObj *pows, int level,
+                                  int radix, int chunk, u_long chunkval,
+                                  const char *tab, long width, char *end)
+{
+    if (width == 0) {
+        /* No padding needed; skip levels that has no upper part. */
+        while (level >= 0 && Scm_NumCmp(x, pows[level]) < 0) level--;
+    }
+    if (level < 0 || SCM_INTP(x)
+        || SCM_BIGNUM_SIZE(x) <= BIGNUM_TOSTRING_THRESHOLD/2) {
+        ScmBignum *b = SCM_INTP(x)
+            ? SCM_BIGNUM(Scm_MakeBignumFromSI(SCM_INT_VALUE(x)))
+            : SCM_BIGNUM(Scm_BignumCopy(SCM_BIGNUM(x)));
+        while (b->size > 0 && b->values[b->size-1] == 0) b->size--;
+        return bignum_to_digits_simple(b, radix, chunk, chunkval, tab,
+                                       width, end);
+    }
+    long lowidth = (long)chunk << level;
+    ScmObj r;
+    ScmObj q = Scm_Quotient(x, pows[level], &r);
+    bignum_to_digits_rec(r, pows, level-1, radix, chunk, chunkval, tab,
+                         lowidth, end);
+    return bignum_to_digits_rec(q, pows, level-1, radix, chunk, chunkval,
+                                tab, width > 0 ? width - lowidth : 0,
+                                end - lowidth);
+}
+
 ScmObj Scm_BignumToString(const ScmBignum *b, int radix, int use_upper)
 {
     static const char ltab[] = "0123456789abcdefghijklmnopqrstuvwxyz";
     static const char utab[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
     const char *tab = use_upper? utab : ltab;
-    ScmObj h = SCM_NIL, t = SCM_NIL;
     if (radix < 2 || radix > 36)
         Scm_Error("radix out of range: %d", radix);
-    ScmBignum *q = SCM_BIGNUM(Scm_BignumCopy(b));
-    for (;q->size > 0;) {
-        long rem = bignum_sdiv(q, radix);
-        SCM_ASSERT(rem >= 0 && rem < radix);
-        SCM_APPEND1(h, t, SCM_MAKE_CHAR(tab[rem]));
-        for (; q->values[q->size-1] == 0 && q->size > 0; q->size--)
-            ;
+
+    /* We take as many digits as possible by each bignum_sdiv, whose
+       divisor must fit in a half word. */
+    int chunk = 1;
+    u_long chunkval = radix;
+    while (chunkval * radix < HALF_WORD) {
+        chunkval *= radix;
+        chunk++;
+    }
+
+    /* Each digit carries at least floor(log2(radix)) bits. */
+    ScmObj x = Scm_Abs(SCM_OBJ(b));
+    long ndigits = integer_bits(x) / Scm__HighestBitNumber(radix) + 1;
+    char *buf = SCM_NEW_ATOMIC_ARRAY(char, ndigits + 1);
+    char *end = buf + ndigits + 1, *p;
+
+    if (SCM_BIGNUM_SIZE(b) > BIGNUM_TOSTRING_THRESHOLD) {
+        ScmObj pows[SCM_WORD_BITS];
+        int level = 0;
+        pows[0] = Scm_MakeIntegerU(chunkval);
+        /* Find the level such that pows[level] <= x < pows[level+1] */
+        for (;;) {
+            ScmObj next = Scm_Mul(pows[level], pows[level]);
+            if (Scm_NumCmp(next, x) > 0) break;
+            pows[++level] = next;
+        }
+        p = bignum_to_digits_rec(x, pows, level, radix, chunk, chunkval,
+                                 tab, 0, end);
+    } else {
+        ScmBignum *q = SCM_BIGNUM(Scm_BignumCopy(b));
+        while (q->size > 0 && q->values[q->size-1] == 0) q->size--;
+        p = bignum_to_digits_simple(q, radix, chunk, chunkval, tab, 0, end);
     }
-    if (q->sign < 0) SCM_APPEND1(h, t, SCM_MAKE_CHAR('-'));
-    return Scm_ListToString(Scm_ReverseX(h));
+    if (b->sign < 0) *--p = '-';
+    return Scm_MakeString(p, (int)(end - p), (int)(end - p),
+                          SCM_STRING_COPYING);
 }
 
 int Scm_DumpBignum(const ScmBignum *b, ScmPort *out)
@@ -1349,3 +1664,41 @@ ScmBignum *Scm_BignumAccMultAddUI(ScmBignum *acc, u_long coef, u_long c)
         return rr;
     }
 }
+
+/* Add x to the accumulator acc in place, if acc has enough room.
+   Otherwise, a new bignum with some extra room is allocated and returned.
+   Acc need not be normalized, and the result isn't normalized either.
+   This allows to sum up a sequence of bignums without allocating
+   intermediate results. */
+ScmBignum *Scm_BignumAccAdd(ScmBignum *acc, const ScmBignum *x)
+{
+    u_int asize = acc->size;
+    u_int xsize = SCM_BIGNUM_SIZE(x);
+    while (asize > 0 && acc->values[asize-1] == 0) asize--;
+    u_int need = ((asize > xsize)? asize : xsize) + 1;
+    if (acc->size < need) {
+        ScmBignum *rr = make_bignum(need + 3); /* 3 is arbitrary increment */
+        rr->sign = acc->sign;
+        for (u_int i=0; i<asize; i++) rr->values[i] = acc->values[i];
+        acc = rr;
+    }
+    if (SCM_BIGNUM_SIGN(acc) == SCM_BIGNUM_SIGN(x)) {
+        bignum_add_int(acc, acc, x);
+    } else {
+        bignum_sub_int(acc, acc, x);
+    }
+    return acc;
+}
+
+ScmBignum *Scm_BignumAccAddSI(ScmBignum *acc, long y)
+{
+    ScmBignum *by;
+    ALLOC_TEMP_BIGNUM(by, 1);
+    if (y < 0) {
+        by->values[0] = (u_long)(-(y+1)) + 1;
+        by->sign = -1;
+    } else {
+        by->values[0] = (u_long)y;
+    }
+    return Scm_BignumAccAdd(acc, by);
+}
@@ -88,6 +88,86 @@ int Scm_EqvP(ScmObj x, ScmObj y)
    For now, let such cyclic structures explode.
 */
 
+/* Before falling back to the Scheme routine, we try to compare nested
+   lists and vectors in C with an explicit stack, up to EQUAL_FUEL nodes.
+   If the structures are larger than that, or circular, we give up and
+   let the Scheme routine handle it from the beginning.  It's the same
+   strategy as the 'precheck' in the paper.  Non-aggregate elements are
+   compared by Scm_EqualP, which doesn't recurse for them.
+
+   Returns TRUE, FALSE, or -1 if we run out of fuel.
+*/
+#define EQUAL_FUEL        10000
+#define EQUAL_STACK_INIT  32
+
+typedef struct equal_frame_rec {
+    ScmObj x;
+    ScmObj y;
+    ScmSmallInt i;              /* next index if vectors, -1 otherwise */
+} equal_frame;
+
+static int equal_bounded(ScmObj x, ScmObj y)
+{
+    equal_frame sinit[EQUAL_STACK_INIT], *stack = sinit;
+    ScmSmallInt sp = 0, ssize = EQUAL_STACK_INIT;
+    int fuel = EQUAL_FUEL;
+
+#define PUSH_FRAME(xx, yy, ii)                                          \
+    do {                                                                \
+        if (sp == ssize) {                                              \
+            equal_frame *ns = SCM_NEW_ARRAY(equal_frame, ssize*2);      \
+            memcpy(ns, stack, sizeof(equal_frame)*ssize);               \
+            stack = ns;                                                 \
+            ssize *= 2;                                                 \
+        }                                                               \
+        stack[sp].x = (xx);                                             \
+        stack[sp].y = (yy);                                             \
+        stack[sp].i = (ii);                                             \
+        sp++;                                                           \
+    } while (0)
+
+    for (;;) {
+        if (--fuel < 0) return -1;
+        if (SCM_EQ(x, y)) {
+            /* fallthrough */
+        } else if (SCM_PAIRP(x)) {
+            if (!SCM_PAIRP(y)) return FALSE;
+            /* Save cdrs, and go down to cars. */
+            PUSH_FRAME(SCM_CDR(x), SCM_CDR(y), -1);
+            x = SCM_CAR(x);
+            y = SCM_CAR(y);
+            continue;
+        } else if (SCM_VECTORP(x)) {
+            if (!SCM_VECTORP(y)) return FALSE;
+            if (SCM_VECTOR_SIZE(x) != SCM_VECTOR_SIZE(y)) return FALSE;
+            PUSH_FRAME(x, y, 0);
+        } else if (!(SCM_VECTORP(y) || SCM_PAIRP(y)) && Scm_EqualP(x, y)) {
+            /* fallthrough */
+        } else {
+            return FALSE;
+        }
+
+        /* Pick the next pair of objects to compare. */
+        for (;;) {
+            if (sp == 0) return TRUE;
+            equal_frame *f = &stack[sp-1];
+            if (f->i < 0) {
+                x = f->x; y = f->y;
+                sp--;
+                break;
+            }
+            if (f->i < SCM_VECTOR_SIZE(f->x)) {
+                x = SCM_VECTOR_ELEMENT(f->x, f->i);
+                y = SCM_VECTOR_ELEMENT(f->y, f->i);
+                f->i++;
+                break;
+            }
+            sp--;
+        }
+    }
+#undef PUSH_FRAME
+}
+
 int Scm_EqualP(ScmObj x, ScmObj y)
 {
 #define CHECK_AGGREGATE(a, b)                   \
@@ -192,6 +272,9 @@ int Scm_EqualP(ScmObj x, ScmObj y)
 
  fallback: 
     {
+        int r = equal_bounded(x, y);
+        if (r >= 0) return r;
+
         /* Fall back to Scheme version. */
         static ScmObj equal_interleave_proc = SCM_UNDEFINED;
         SCM_BIND_PROC(equal_interleave_proc, "%interleave-equal?",
@@ -211,6 +211,12 @@ SCM_DEFINE_BUILTIN_CLASS(Scm_CharSetClass,
 #define MASK_SET(cs, ch)    SCM_BITS_SET(cs->small, ch)
 #define MASK_RESET(cs, ch)  SCM_BITS_RESET(cs->small, ch)
 
+static void charset_modified(ScmCharSet *cs)
+{
+    cs->lookup = NULL;
+    cs->lookupCount = 0;
+}
+
 
 /*----------------------------------------------------------------------
  * Printer
@@ -295,6 +301,8 @@ static ScmCharSet *make_charset(void)
     SCM_SET_CLASS(cs, SCM_CLASS_CHARSET);
     Scm_BitsFill(cs->small, 0, SCM_CHAR_SET_SMALL_CHARS, 0);
     Scm_TreeCoreInit(&cs->large, cmp, NULL);
+    cs->lookup = NULL;
+    cs->lookupCount = 0;
     return cs;
 }
 
@@ -386,6 +394,7 @@ ScmObj Scm_CharSetAddRange(ScmCharSet *cs, ScmChar from, ScmChar to)
         Scm_BitsFill(cs->small, (int)from, SCM_CHAR_SET_SMALL_CHARS, TRUE);
         from = SCM_CHAR_SET_SMALL_CHARS;
     }
+    charset_modified(cs);
 
     /* Let e have the lower bound. */
     e = Scm_TreeCoreClosestEntries(&cs->large, from, &lo, &hi);
@@ -437,6 +446,7 @@ ScmObj Scm_CharSetComplement(ScmCharSet *cs)
 
     Scm_BitsOperate(cs->small, SCM_BIT_NOT1, cs->small, NULL,
                     0, SCM_CHAR_SET_SMALL_CHARS);
+    charset_modified(cs);
     int last = SCM_CHAR_SET_SMALL_CHARS-1;
     /* we can't use treeiter, since we modify the tree while traversing it. */
     while ((e = Scm_TreeCoreNextEntry(&cs->large, last)) != NULL) {
@@ -478,6 +488,96 @@ ScmObj Scm_CharSetCaseFold(ScmCharSet *cs)
     return SCM_OBJ(cs);
 }
 
+/*-----------------------------------------------------------------
+ * Lookup table
+ */
+
+/* The lookup table is a three-level bitmap of large chars:
+ *
+ *   plane[c>>16] => mid[i][(c>>8)&0xff] => leaf[j], bit (c&0xff)
+ *
+ * An entry of plane[] or mid[] is either LOOKUP_EMPTY, LOOKUP_FULL,
+ * or an index of the next level table.  Blocks whose chars are all
+ * in the set, or all out of the set, don't need a table of their own,
+ * so the table only grows with the number of range boundaries, not
+ * with the size of the ranges.  E.g. a set of a few CJK ranges needs
+ * one mid table and a handful of leaves.
+ *
+ * Scm_CharSetContains builds the table after it searched the tree
+ * LOOKUP_THRESHOLD times, so that char-sets used only a few times
+ * don't pay for it.  The regexp compiler builds it upfront.
+ */
+#define LOOKUP_PLANES     ((SCM_CHAR_MAX>>16)+1)
+#define LOOKUP_EMPTY      0
+#define LOOKUP_FULL       1
+#define LOOKUP_LEAF_WORDS SCM_BITS_NUM_WORDS(256)
+#define LOOKUP_THRESHOLD  64
+
+struct ScmCharSetLookupRec {
+    u_short plane[LOOKUP_PLANES];
+    u_short (*mid)[256];
+    ScmBits (*leaf)[LOOKUP_LEAF_WORDS];
+};
+
+void Scm_CharSetCompile(ScmCharSet *cs)
+{
+    if (cs->lookup) return;
+    /* Each range adds at most two partially filled planes and two
+       partially filled blocks.  We give up if the indexes don't fit. */
+    u_long nranges = Scm_TreeCoreNumEntries(&cs->large);
+    u_long maxtabs = nranges*2 + 2;
+    if (maxtabs > USHRT_MAX) return;
+
+    ScmCharSetLookup *t = SCM_NEW(ScmCharSetLookup);
+    u_long nmids = (maxtabs < LOOKUP_PLANES+2)? maxtabs : LOOKUP_PLANES+2;
+    t->mid = SCM_NEW_ATOMIC2(u_short(*)[256], nmids*sizeof(u_short[256]));
+    t->leaf = SCM_NEW_ATOMIC2(ScmBits(*)[LOOKUP_LEAF_WORDS],
+                              maxtabs*sizeof(ScmBits[LOOKUP_LEAF_WORDS]));
+    memset(t->plane, 0, sizeof(t->plane));
+    memset(t->mid, 0, nmids*sizeof(u_short[256]));
+    memset(t->leaf, 0, maxtabs*sizeof(ScmBits[LOOKUP_LEAF_WORDS]));
+
+    u_short imid = LOOKUP_FULL+1, ileaf = LOOKUP_FULL+1;
+    ScmTreeIter iter;
+    ScmDictEntry *e;
+    Scm_TreeIterInit(&iter, &cs->large, NULL);
+    while ((e = Scm_TreeIterNext(&iter)) != NULL) {
+        ScmChar c = (ScmChar)e->key, hi = (ScmChar)e->value;
+        while (c <= hi) {
+            int p = c >> 16;
+            if ((c & 0xffff) == 0 && hi - c >= 0xffff) {
+                t->plane[p] = LOOKUP_FULL;
+                c += 0x10000;
+                continue;
+            }
+            if (t->plane[p] == LOOKUP_EMPTY) t->plane[p] = imid++;
+            u_short *m = t->mid[t->plane[p]];
+            int b = (c >> 8) & 0xff;
+            if ((c & 0xff) == 0 && hi - c >= 0xff) {
+                m[b] = LOOKUP_FULL;
+                c += 0x100;
+                continue;
+            }
+            if (m[b] == LOOKUP_EMPTY) m[b] = ileaf++;
+            ScmChar end = (hi < (c|0xff))? hi : (c|0xff);
+            Scm_BitsFill(t->leaf[m[b]], (int)(c & 0xff), (int)(end & 0xff)+1,
+                         TRUE);
+            c = end + 1;
+        }
+    }
+    cs->lookup = t;
+}
+
+static inline int lookup_test(ScmCharSetLookup *t, ScmChar c)
+{
+    if (c > SCM_CHAR_MAX) return FALSE;
+    u_int i = t->plane[c >> 16];
+    if (i <= LOOKUP_FULL) return i;
+    i = t->mid[i][(c >> 8) & 0xff];
+    if (i <= LOOKUP_FULL) return i;
+    return SCM_BITS_TEST(t->leaf[i], c & 0xff);
+}
+
 /*-----------------------------------------------------------------
  * Query
  */
@@ -486,12 +586,15 @@ int Scm_CharSetContains(ScmCharSet *cs, ScmChar c)
 {
     if (c < 0) return FALSE;
     if (c < SCM_CHAR_SET_SMALL_CHARS) return MASK_ISSET(cs, c);
-    else {
-        ScmDictEntry *e, *l, *h;
-        e = Scm_TreeCoreClosestEntries(&cs->large, (int)c, &l, &h);
-        if (e || (l && l->value >= c)) return TRUE;
-        else return FALSE;
+    if (cs->lookup) return lookup_test(cs->lookup, c);
+    if (cs->lookupCount++ == LOOKUP_THRESHOLD) {
+        Scm_CharSetCompile(cs);
+        if (cs->lookup) return lookup_test(cs->lookup, c);
     }
+    ScmDictEntry *e, *l, *h;
+    e = Scm_TreeCoreClosestEntries(&cs->large, (int)c, &l, &h);
+    if (e || (l && l->value >= c)) return TRUE;
+    else return FALSE;
 }
 
 /*-----------------------------------------------------------------
@@ -540,7 +643,7 @@ void Scm_CharSetDump(ScmCharSet *cs, ScmPort *port)
     }
     Scm_Printf(port, "\nranges:");
     Scm_TreeCoreDump(&cs->large, port);
-    Scm_Printf(port, "\n");
+    Scm_Printf(port, "\nlookup: %s\n", cs->lookup? "built" : "none");
 }
 
 /*-----------------------------------------------------------------
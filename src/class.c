@@ -183,6 +183,13 @@ static struct {
                                              to ensure this sturcture is
                                              placed in the data area */
 
+/* Generation count of dispatch caches of generic functions.  Bumped
+   whenever the result of applicable method computation may change,
+   which invalidates all the caches.  See Scm__ComputeSortedApplicableMethods.
+*/
+static volatile u_long method_cache_generation = 0;
+#define INVALIDATE_METHOD_CACHE()  (method_cache_generation++)
+
 /* Imporant slots in <class> metaboject can be modified only when the
    class is in 'malleable' state.   Here's the check. */
 #define CHECK_MALLEABLE(k, who)                         \
@@ -398,6 +405,7 @@ static ScmObj class_allocate(ScmClass *klass, ScmObj initargs)
     (void)SCM_INTERNAL_MUTEX_INIT(instance->mutex);
     (void)SCM_INTERNAL_COND_INIT(instance->cv);
     instance->data = NULL;      /* see the above note on the 'data' member */
+    instance->initCache = NULL;
     return SCM_OBJ(instance);
 }
 
@@ -652,6 +660,7 @@ static void class_cpl_set(ScmClass *klass, ScmObj val)
     klass->cpl = Scm_CopyList(val);
     /* find correct allocation method */
     find_core_allocator(klass);
+    INVALIDATE_METHOD_CACHE();
     return;
   err:
     Scm_Error("class precedence list must be a proper list of class "
@@ -1007,6 +1016,7 @@ void Scm_StartClassRedefinition(ScmClass *klass)
 
     /* Allow modification of important slots */
     Scm_ClassMalleableSet(klass, TRUE);
+    INVALIDATE_METHOD_CACHE();
 }
 
 /* %commit-class-redefinition klass newklass */
@@ -1032,6 +1042,7 @@ void Scm_CommitClassRedefinition(ScmClass *klass, ScmObj newklass)
         (void)SCM_INTERNAL_COND_BROADCAST(klass->cv);
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(klass->mutex);
+    INVALIDATE_METHOD_CACHE();
 
     /* Decrement the recursive global lock. */
     unlock_class_redefinition(vm);
@@ -1347,6 +1358,36 @@ ScmObj Scm_VMSlotInitializeUsingAccessor(ScmObj obj,
     Scm_VMApply(SCM_OBJ(&Scm_GenericSlotMissing),       \
                 SCM_LIST4(SCM_OBJ(klass), obj, slot, val))
 
+/* Slot accessor cache
+ *
+ * Looking up the accessor alist for every slot access is costly for
+ * classes with many slots.  We keep a global direct-mapped table from
+ * (class, slot name) to the slot accessor.  slot-ref and slot-set! with
+ * a constant slot name mostly hits the same entry every time, so this
+ * works like an inline cache of the call site, without needing to
+ * patch the code vector.
+ *
+ * An entry records the accessor alist of the class it was computed
+ * from; if the alist is replaced (it can only be done while the class
+ * is malleable), the entry is simply ignored.  A redefined class is
+ * caught before the lookup, so we don't need other invalidation.
+ * Entries are never modified once stored, so no lock is required.
+ */
+#define SLOT_ACCESSOR_CACHE_SIZE 256
+
+typedef struct slot_accessor_cache_entry_rec {
+    ScmClass *klass;
+    ScmObj accessors;
+    ScmObj slot;
+    ScmSlotAccessor *sa;
+} slot_accessor_cache_entry;
+
+static slot_accessor_cache_entry *slot_accessor_cache[SLOT_ACCESSOR_CACHE_SIZE];
+
+#define SLOT_ACCESSOR_CACHE_INDEX(klass, slot)                  \
+    ((u_int)((((u_long)(klass))>>4) ^ (((u_long)(slot))>>3))     \
+     % SLOT_ACCESSOR_CACHE_SIZE)
+
 /* GET-SLOT-ACCESSOR
  *
  * (define (get-slot-accessor class slot)
@@ -1355,12 +1396,26 @@ ScmObj Scm_VMSlotInitializeUsingAccessor(ScmObj obj,
  */
 ScmSlotAccessor *Scm_GetSlotAccessor(ScmClass *klass, ScmObj slot)
 {
+    u_int ind = SLOT_ACCESSOR_CACHE_INDEX(klass, slot);
+    slot_accessor_cache_entry *e = slot_accessor_cache[ind];
+    if (e != NULL && e->klass == klass && SCM_EQ(e->slot, slot)
+        && SCM_EQ(e->accessors, klass->accessors)) {
+        return e->sa;
+    }
+
     ScmObj p = Scm_Assq(slot, klass->accessors);
     if (!SCM_PAIRP(p)) return NULL;
     if (!SCM_XTYPEP(SCM_CDR(p), SCM_CLASS_SLOT_ACCESSOR))
         Scm_Error("slot accessor information of class %S, slot %S is screwed up.",
                   SCM_OBJ(klass), slot);
-    return SCM_SLOT_ACCESSOR(SCM_CDR(p));
+
+    e = SCM_NEW(slot_accessor_cache_entry);
+    e->klass = klass;
+    e->accessors = klass->accessors;
+    e->slot = slot;
+    e->sa = SCM_SLOT_ACCESSOR(SCM_CDR(p));
+    slot_accessor_cache[ind] = e;
+    return e->sa;
 }
 
 /* (internal) slot-ref-using-accessor
@@ -1957,6 +2012,130 @@ static SCM_DEFINE_METHOD(object_initialize_rec,
                          object_initialize_SPEC,
                          object_initialize, NULL);
 
+/* Fast instance construction
+ *
+ * For the common case that neither allocate-instance nor initialize
+ * is customized for the class, and every slot is a plain instance slot
+ * initialized by a keyword or a constant init-value, (make class . initargs)
+ * can skip both generic dispatches and the continuation-passing walk
+ * over the accessors.  We precompute the slot numbers, init keywords
+ * and init values per class and keep it in klass->initCache.
+ *
+ * The info is recomputed whenever method_cache_generation changes
+ * (methods are added or deleted, or classes are redefined) or the
+ * accessors of the class are replaced.  Once created, the info is
+ * never modified, so no lock is needed.
+ */
+typedef struct instance_init_rec {
+    int slotNumber;
+    ScmObj initKeyword;         /* keyword or #f */
+    ScmObj initValue;           /* SCM_UNBOUND if none */
+} instance_init;
+
+typedef struct instance_init_cache_rec {
+    u_long generation;
+    ScmObj accessors;
+    int fastp;                  /* TRUE if we can take the fast path */
+    int numInits;
+    instance_init *inits;
+} instance_init_cache;
+
+/* Returns TRUE iff the only methods of GF possibly applicable when
+   the first argument is an instance of KLASS is M. */
+static int only_default_method_p(ScmGeneric *gf, ScmClass *klass,
+                                 ScmMethod *m)
+{
+    ScmObj mp;
+    SCM_FOR_EACH(mp, gf->methods) {
+        ScmMethod *mm = SCM_METHOD(SCM_CAR(mp));
+        if (mm == m) continue;
+        if (SCM_PROCEDURE_REQUIRED(mm) == 0
+            || Scm_SubtypeP(klass, mm->specializers[0])) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static instance_init_cache *compute_instance_init(ScmClass *klass,
+                                                  u_long gen)
+{
+    instance_init_cache *c = SCM_NEW(instance_init_cache);
+    c->generation = gen;
+    c->accessors = klass->accessors;
+    c->fastp = FALSE;
+    c->numInits = 0;
+    c->inits = NULL;
+
+    if (SCM_CLASS_CATEGORY(klass) != SCM_CLASS_SCHEME
+        || klass->allocate != instance_allocate
+        || !only_default_method_p(&Scm_GenericAllocate,
+                                  Scm_ClassOf(SCM_OBJ(klass)),
+                                  &class_allocate_rec)
+        || !only_default_method_p(&Scm_GenericInitialize, klass,
+                                  &object_initialize_rec)) {
+        return c;
+    }
+
+    int len = Scm_Length(klass->accessors);
+    if (len < 0) return c;
+    instance_init *inits = SCM_NEW_ARRAY(instance_init, len);
+    int n = 0;
+    ScmObj ap;
+    SCM_FOR_EACH(ap, klass->accessors) {
+        ScmSlotAccessor *sa = SCM_SLOT_ACCESSOR(SCM_CDAR(ap));
+        int keyp = SCM_KEYWORDP(sa->initKeyword);
+        int valp = sa->initializable && !SCM_UNBOUNDP(sa->initValue);
+        int thunkp = sa->initializable && SCM_UNBOUNDP(sa->initValue)
+            && SCM_PROCEDUREP(sa->initThunk);
+
+        if (thunkp) return c;   /* needs to call Scheme */
+        if (!keyp && !valp) continue;
+        if (sa->getter || sa->setter || sa->slotNumber < 0) return c;
+        inits[n].slotNumber = sa->slotNumber;
+        inits[n].initKeyword = keyp? sa->initKeyword : SCM_FALSE;
+        inits[n].initValue = valp? sa->initValue : SCM_UNBOUND;
+        n++;
+    }
+    c->fastp = TRUE;
+    c->numInits = n;
+    c->inits = inits;
+    return c;
+}
+
+/* Called from the default make method.  Returns a fully initialized
+   instance of KLASS if we can take the fast path, #f otherwise. */
+ScmObj Scm__MakeInstanceFast(ScmClass *klass, ScmObj initargs)
+{
+    if (!SCM_FALSEP(klass->redefined) || SCM_CLASS_MALLEABLE_P(klass)) {
+        return SCM_FALSE;
+    }
+    u_long gen = method_cache_generation;
+    instance_init_cache *c = (instance_init_cache*)klass->initCache;
+    if (c == NULL || c->generation != gen
+        || !SCM_EQ(c->accessors, klass->accessors)) {
+        c = compute_instance_init(klass, gen);
+        klass->initCache = c;
+    }
+    if (!c->fastp) return SCM_FALSE;
+    /* Let the normal path report malformed initargs. */
+    if (!SCM_NULLP(initargs)) {
+        int len = Scm_Length(initargs);
+        if (len < 0 || len % 2) return SCM_FALSE;
+    }
+
+    ScmObj obj = instance_allocate(klass, initargs);
+    for (int i=0; i<c->numInits; i++) {
+        ScmObj v = SCM_UNBOUND;
+        if (!SCM_NULLP(initargs) && !SCM_FALSEP(c->inits[i].initKeyword)) {
+            v = Scm_GetKeyword(c->inits[i].initKeyword, initargs, SCM_UNBOUND);
+        }
+        if (SCM_UNBOUNDP(v)) v = c->inits[i].initValue;
+        if (!SCM_UNBOUNDP(v)) scheme_slot_set(obj, c->inits[i].slotNumber, v);
+    }
+    return obj;
+}
+
 /* Default equal? delegates compare action to generic function object-equal?.
    We can't use VMApply here */
 static int object_compare(ScmObj x, ScmObj y, int equalp)
@@ -2001,6 +2180,7 @@ static ScmObj generic_allocate(ScmClass *klass, ScmObj initargs)
     gf->fallback = Scm_NoNextMethod;
     gf->data = NULL;
     gf->maxReqargs = 0;
+    gf->cache = NULL;
     (void)SCM_INTERNAL_MUTEX_INIT(gf->lock);
     return SCM_OBJ(gf);
 }
@@ -2056,6 +2236,7 @@ static void generic_methods_set(ScmGeneric *gf, ScmObj val)
     gf->methods = val;
     gf->maxReqargs = reqs;
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
+    INVALIDATE_METHOD_CACHE();
 }
 
 /* Make base generic function from C */
@@ -2279,6 +2460,83 @@ ScmObj Scm_SortMethods(ScmObj methods, ScmObj *argv, int argc)
     return Scm_ArrayToList(array, len);
 }
 
+/* Dispatch cache
+ *
+ *  Computing and sorting applicable methods on every generic call is
+ *  costly, so we cache the sorted method list per generic, keyed by the
+ *  number of arguments and the classes of the arguments used for
+ *  selection (up to maxReqargs).  The cache is a small direct-mapped
+ *  table; an entry is never modified once stored, so readers don't
+ *  need a lock.
+ *
+ *  The result depends on the methods of the generic, their specializers
+ *  and the class precedence lists of the argument classes.  Whenever any
+ *  of them may change, we bump the global method_cache_generation, which
+ *  invalidates all the caches at once.  Such changes are rare once the
+ *  program is loaded.
+ */
+#define METHOD_CACHE_SIZE      16
+#define METHOD_CACHE_MAX_ARGS  4
+
+typedef struct method_cache_entry_rec {
+    int argc;
+    ScmClass *classes[METHOD_CACHE_MAX_ARGS];
+    ScmObj methods;             /* sorted applicable methods */
+} method_cache_entry;
+
+typedef struct method_cache_rec {
+    u_long generation;
+    method_cache_entry *entries[METHOD_CACHE_SIZE];
+} method_cache;
+
+ScmObj Scm__ComputeSortedApplicableMethods(ScmGeneric *gf,
+                                           ScmObj *argv, int argc)
+{
+    int nsel = (argc < gf->maxReqargs)? argc : gf->maxReqargs;
+    if (nsel > METHOD_CACHE_MAX_ARGS) {
+        ScmObj mm = Scm_ComputeApplicableMethods(gf, argv, argc, FALSE);
+        if (SCM_NULLP(mm)) return mm;
+        return Scm_SortMethods(mm, argv, argc);
+    }
+
+    u_long gen = method_cache_generation;
+    ScmClass *classes[METHOD_CACHE_MAX_ARGS];
+    u_long h = (u_long)argc;
+    for (int i=0; i<nsel; i++) {
+        classes[i] = Scm_ClassOf(argv[i]);
+        h = h*31 + ((u_long)classes[i] >> 4);
+    }
+    u_int slot = (u_int)((h ^ (h >> 5)) % METHOD_CACHE_SIZE);
+
+    method_cache *c = (method_cache*)gf->cache;
+    if (c != NULL && c->generation == gen) {
+        method_cache_entry *e = c->entries[slot];
+        if (e != NULL && e->argc == argc) {
+            int i;
+            for (i=0; i<nsel; i++) {
+                if (e->classes[i] != classes[i]) break;
+            }
+            if (i == nsel) return e->methods;
+        }
+    }
+
+    ScmObj mm = Scm_ComputeApplicableMethods(gf, argv, argc, FALSE);
+    if (!SCM_NULLP(mm)) mm = Scm_SortMethods(mm, argv, argc);
+
+    method_cache_entry *e = SCM_NEW(method_cache_entry);
+    e->argc = argc;
+    for (int i=0; i<nsel; i++) e->classes[i] = classes[i];
+    e->methods = mm;
+    if (c == NULL || c->generation != gen) {
+        c = SCM_NEW(method_cache);
+        c->generation = gen;
+        for (int i=0; i<METHOD_CACHE_SIZE; i++) c->entries[i] = NULL;
+        gf->cache = c;
+    }
+    c->entries[slot] = e;
+    return mm;
+}
+
 /*=====================================================================
  * Method
  */
@@ -2426,6 +2684,7 @@ static void method_specializers_set(ScmMethod *m, ScmObj val)
         m->specializers = NULL;
     else
         m->specializers = class_list_to_array(val, len);
+    INVALIDATE_METHOD_CACHE();
 }
 
 /* update-direct-method! method old-class new-class
@@ -2450,6 +2709,7 @@ ScmObj Scm_UpdateDirectMethod(ScmMethod *m, ScmClass *old, ScmClass *newc)
     for (int i=0; i<rec; i++) {
         if (sp[i] == old) sp[i] = newc;
     }
+    INVALIDATE_METHOD_CACHE();
     if (SCM_FALSEP(Scm_Memq(SCM_OBJ(m), newc->directMethods))) {
         newc->directMethods = Scm_Cons(SCM_OBJ(m), newc->directMethods);
     }
@@ -2527,6 +2787,7 @@ ScmObj Scm_AddMethod(ScmGeneric *gf, ScmMethod *method)
         gf->maxReqargs = reqs;
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
+    INVALIDATE_METHOD_CACHE();
 
     if (method_locked != NULL) {
         Scm_Error("Attempt to replace a locked method %S",
@@ -2581,6 +2842,7 @@ ScmObj Scm_DeleteMethod(ScmGeneric *gf, ScmMethod *method)
         }
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(gf->lock);
+    INVALIDATE_METHOD_CACHE();
     return SCM_UNDEFINED;
 }
 
@@ -3291,10 +3553,13 @@ void Scm__InitClass(void)
     /* regexp.c */
     CINIT(SCM_CLASS_REGEXP,           "<regexp>");
     CINIT(SCM_CLASS_REGMATCH,         "<regmatch>");
+    CINIT(SCM_CLASS_REGEXP_SET,       "<regexp-set>");
 
     /* string.c */
     CINIT(SCM_CLASS_STRING,           "<string>");
     CINIT(SCM_CLASS_STRING_POINTER,   "<string-pointer>");
+    CINIT(SCM_CLASS_STRING_BUILDER,   "<string-builder>");
+    CINIT(SCM_CLASS_STRING_MATCHER,   "<string-matcher>");
 
     /* symbol.c */
     CINIT(SCM_CLASS_SYMBOL,           "<symbol>");
@@ -111,6 +111,10 @@ ScmObj Scm_ComparatorHashFunction(ScmComparator *cmpr)
 int Scm_Compare(ScmObj x, ScmObj y)
 {
     /* Shortcut for typical case */
+    if (SCM_INTP(x) && SCM_INTP(y)) {
+        ScmSmallInt ix = SCM_INT_VALUE(x), iy = SCM_INT_VALUE(y);
+        return (ix < iy)? -1 : (ix > iy)? 1 : 0;
+    }
     if (SCM_NUMBERP(x) && SCM_NUMBERP(y)) {
         if (SCM_COMPNUMP(x) || SCM_COMPNUMP(y)) {
             /* Scm_NumCmp can't compare complex numbers---it doesn't make
@@ -277,6 +281,9 @@ int Scm_Compare(ScmObj x, ScmObj y)
  *  if (x > y), it may return a positive integer or #f.
  *
  * If cmpfn is #f, the first object's default compare method is used.
+ * Cmpfn can also be a comparator, whose comparison procedure is used
+ * (its type test isn't applied).  If it is the builtin compare, we
+ * use Scm_Compare directly.
  *
  * Some notes:
  *  - We can't use libc's qsort, since it doesn't pass closure to cmpfn.
@@ -375,6 +382,11 @@ void Scm_SortArray(ScmObj *elts, int nelts, ScmObj cmpfn)
     if (nelts <= 1) return;
     /* approximate 2*log2(nelts) */
     for (i=nelts,limit=1; i > 0; limit++) {i>>=1;}
+    if (SCM_COMPARATORP(cmpfn)) {
+        ScmComparator *c = SCM_COMPARATOR(cmpfn);
+        if (c->flags & SCM_COMPARATOR_BUILTIN_COMPARE) cmpfn = SCM_FALSE;
+        else cmpfn = Scm_ComparatorComparisonProcedure(c);
+    }
     if (SCM_PROCEDUREP(cmpfn)) {
         sort_q(elts, 0, nelts-1, 0, limit, cmp_scm, cmpfn);
     } else {
@@ -415,6 +427,393 @@ ScmObj Scm_SortListX(ScmObj objs, ScmObj fn)
     return sort_list_int(objs, fn, TRUE);
 }
 
+/*
+ * Radix sort
+ *
+ *  Uniform vectors, and vectors keyed by fixnums or flonums, are sorted
+ *  by LSD radix sort, which doesn't call comparison at all.  The keys
+ *  are mapped to unsigned integers whose order agrees with the numeric
+ *  order: the sign bit of signed integers is flipped, and for floating
+ *  point numbers, the sign bit of positive numbers is flipped and all
+ *  the bits of negative numbers are inverted.  Hence -0.0 comes before
+ *  0.0, and NaNs go to either end by their sign bit.
+ *
+ *  The sort is stable.  If VALS is not NULL, it is permuted along with
+ *  the keys.  A pass is skipped if all keys share the digit.
+ */
+
+#define DEFINE_RADIX_SORT(T, TAG)                                       \
+static void TAG##_radix_sort(T *keys, T *ktmp,                          \
+                             ScmSmallInt *vals, ScmSmallInt *vtmp,      \
+                             size_t n)                                  \
+{                                                                       \
+    size_t count[sizeof(T)][256];                                       \
+    memset(count, 0, sizeof(count));                                    \
+    for (size_t i = 0; i < n; i++) {                                    \
+        for (size_t b = 0; b < sizeof(T); b++) {                        \
+            count[b][(keys[i] >> (b*8)) & 0xff]++;                      \
+        }                                                               \
+    }                                                                   \
+    T *src = keys, *dst = ktmp;                                         \
+    ScmSmallInt *vsrc = vals, *vdst = vtmp;                             \
+    for (size_t b = 0; b < sizeof(T); b++) {                            \
+        size_t *c = count[b], sum = 0;                                  \
+        if (c[(src[0] >> (b*8)) & 0xff] == n) continue;                 \
+        for (int d = 0; d < 256; d++) {                                 \
+            size_t t = c[d]; c[d] = sum; sum += t;                      \
+        }                                                               \
+        for (size_t i = 0; i < n; i++) {                                \
+            size_t j = c[(src[i] >> (b*8)) & 0xff]++;                   \
+            dst[j] = src[i];                                            \
+            if (vals) vdst[j] = vsrc[i];                                \
+        }                                                               \
+        T *t = src; src = dst; dst = t;                                 \
+        ScmSmallInt *vt = vsrc; vsrc = vdst; vdst = vt;                 \
+    }                                                                   \
+    if (src != keys) {                                                  \
+        memcpy(keys, src, n*sizeof(T));                                 \
+        if (vals) memcpy(vals, vsrc, n*sizeof(ScmSmallInt));            \
+    }                                                                   \
+}
+
+DEFINE_RADIX_SORT(uint8_t,  u8)
+DEFINE_RADIX_SORT(uint16_t, u16)
+DEFINE_RADIX_SORT(uint32_t, u32)
+#if !SCM_EMULATE_INT64
+DEFINE_RADIX_SORT(uint64_t, u64)
+#endif
+
+/* Key mappings.  FLIP maps a signed integer, and FKEY/FUNKEY map a
+   floating point number and back. */
+#define SIGNBIT(T)     ((T)1 << (sizeof(T)*8-1))
+#define FLIP(T, x)     ((T)((x) ^ SIGNBIT(T)))
+#define FKEY(T, x)     ((T)(((x) & SIGNBIT(T))? ~(x) : (x) | SIGNBIT(T)))
+#define FUNKEY(T, x)   ((T)(((x) & SIGNBIT(T))? (x) & ~SIGNBIT(T) : ~(x)))
+
+#define RADIX_SORT_LOOP(T, TAG, p, n, map, unmap)                       \
+    do {                                                                \
+        T *keys_ = (T*)(p);                                             \
+        T *tmp_ = malloc(sizeof(T)*(n));                                \
+        if (tmp_ == NULL) Scm_Error("uvector-sort!: out of memory");    \
+        for (ScmSmallInt i_ = 0; i_ < (n); i_++) {                      \
+            keys_[i_] = map(T, keys_[i_]);                              \
+        }                                                               \
+        TAG##_radix_sort(keys_, tmp_, NULL, NULL, (n));                 \
+        for (ScmSmallInt i_ = 0; i_ < (n); i_++) {                      \
+            keys_[i_] = unmap(T, keys_[i_]);                            \
+        }                                                               \
+        free(tmp_);                                                     \
+    } while (0)
+
+#define IDENT(T, x)  (x)
+
+void Scm_UVectorSort(ScmUVector *v, ScmSmallInt start, ScmSmallInt end)
+{
+    ScmSmallInt size = SCM_UVECTOR_SIZE(v);
+    SCM_CHECK_START_END(start, end, size);
+    SCM_UVECTOR_CHECK_MUTABLE(v);
+    ScmSmallInt n = end - start;
+    if (n <= 1) return;
+    ScmUVectorType type = Scm_UVectorType(Scm_ClassOf(SCM_OBJ(v)));
+    void *p = (char*)SCM_UVECTOR_ELEMENTS(v)
+        + start * Scm_UVectorElementSize(Scm_ClassOf(SCM_OBJ(v)));
+
+    switch (type) {
+    case SCM_UVECTOR_U8:  RADIX_SORT_LOOP(uint8_t, u8, p, n, IDENT, IDENT); break;
+    case SCM_UVECTOR_S8:  RADIX_SORT_LOOP(uint8_t, u8, p, n, FLIP, FLIP); break;
+    case SCM_UVECTOR_U16: RADIX_SORT_LOOP(uint16_t, u16, p, n, IDENT, IDENT); break;
+    case SCM_UVECTOR_S16: RADIX_SORT_LOOP(uint16_t, u16, p, n, FLIP, FLIP); break;
+    case SCM_UVECTOR_F16: RADIX_SORT_LOOP(uint16_t, u16, p, n, FKEY, FUNKEY); break;
+    case SCM_UVECTOR_U32: RADIX_SORT_LOOP(uint32_t, u32, p, n, IDENT, IDENT); break;
+    case SCM_UVECTOR_S32: RADIX_SORT_LOOP(uint32_t, u32, p, n, FLIP, FLIP); break;
+    case SCM_UVECTOR_F32: RADIX_SORT_LOOP(uint32_t, u32, p, n, FKEY, FUNKEY); break;
+#if !SCM_EMULATE_INT64
+    case SCM_UVECTOR_U64: RADIX_SORT_LOOP(uint64_t, u64, p, n, IDENT, IDENT); break;
+    case SCM_UVECTOR_S64: RADIX_SORT_LOOP(uint64_t, u64, p, n, FLIP, FLIP); break;
+    case SCM_UVECTOR_F64: RADIX_SORT_LOOP(uint64_t, u64, p, n, FKEY, FUNKEY); break;
+#else  /*SCM_EMULATE_INT64*/
+    case SCM_UVECTOR_U64: case SCM_UVECTOR_S64: case SCM_UVECTOR_F64: {
+        /* Rare; go through boxed elements */
+        ScmObj vec = Scm_MakeVector(n, SCM_FALSE);
+        for (ScmSmallInt i = 0; i < n; i++) {
+            SCM_VECTOR_ELEMENTS(vec)[i] =
+                Scm_VMUVectorRef(v, type, start+i, SCM_UNBOUND);
+        }
+        Scm_SortArray(SCM_VECTOR_ELEMENTS(vec), (int)n, SCM_FALSE);
+        ScmObj r = Scm_ListToUVector(Scm_ClassOf(SCM_OBJ(v)),
+                                     Scm_VectorToList(SCM_VECTOR(vec), 0, -1),
+                                     SCM_CLAMP_ERROR);
+        memcpy(p, SCM_UVECTOR_ELEMENTS(r), Scm_UVectorSizeInBytes(SCM_UVECTOR(r)));
+        break;
+    }
+#endif /*SCM_EMULATE_INT64*/
+    default:
+        Scm_Error("uvector-sort!: unsupported uvector: %S", SCM_OBJ(v));
+    }
+}
+
+/*
+ * Stable sort by keys with the default ordering
+ *
+ *   Sorts ELTS by the corresponding KEYS in place, both of length N.
+ *   The keys are compared by Scm_Compare, without calling back to
+ *   Scheme unless the keys are objects with a user-defined compare
+ *   method.  If all the keys are fixnums, or all are flonums, radix
+ *   sort is used.  KEYS are rearranged along with ELTS.
+ */
+
+#if !SCM_EMULATE_INT64
+/* Radix key of a flonum.  -0.0 and 0.0 are equal, and so are NaNs,
+   which come after everything else. */
+static inline uint64_t flonum_key(ScmObj x)
+{
+    union { double d; uint64_t u; } v;
+    v.d = SCM_FLONUM_VALUE(x);
+    if (v.d == 0.0) v.d = 0.0;
+    else if (v.d != v.d) v.u = ~(uint64_t)0 >> 1;
+    return FKEY(uint64_t, v.u);
+}
+#endif /*!SCM_EMULATE_INT64*/
+
+/* Merge sort of indices IDX by KEYS[IDX[i]]; TMP is a work area */
+static void merge_sort_index(ScmSmallInt *idx, ScmSmallInt *tmp,
+                             ScmObj *keys, ScmSmallInt n)
+{
+    /* insertion sort for short runs */
+    const ScmSmallInt RUN = 16;
+    for (ScmSmallInt lo = 0; lo < n; lo += RUN) {
+        ScmSmallInt hi = (lo + RUN < n)? lo + RUN : n;
+        for (ScmSmallInt i = lo+1; i < hi; i++) {
+            ScmSmallInt x = idx[i], j = i;
+            for (; j > lo && Scm_Compare(keys[idx[j-1]], keys[x]) > 0; j--) {
+                idx[j] = idx[j-1];
+            }
+            idx[j] = x;
+        }
+    }
+    ScmSmallInt *src = idx, *dst = tmp;
+    for (ScmSmallInt w = RUN; w < n; w *= 2) {
+        for (ScmSmallInt lo = 0; lo < n; lo += 2*w) {
+            ScmSmallInt mid = (lo + w < n)? lo + w : n;
+            ScmSmallInt hi = (lo + 2*w < n)? lo + 2*w : n;
+            ScmSmallInt i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) {
+                /* take from the right only if strictly less, for stability */
+                if (Scm_Compare(keys[src[j]], keys[src[i]]) < 0) {
+                    dst[k++] = src[j++];
+                } else {
+                    dst[k++] = src[i++];
+                }
+            }
+            while (i < mid) dst[k++] = src[i++];
+            while (j < hi)  dst[k++] = src[j++];
+        }
+        ScmSmallInt *t = src; src = dst; dst = t;
+    }
+    if (src != idx) memcpy(idx, src, n*sizeof(ScmSmallInt));
+}
+
+void Scm_SortArrayByKeys(ScmObj *elts, ScmObj *keys, ScmSmallInt n)
+{
+    if (n <= 1) return;
+    ScmSmallInt *idx = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, n);
+    ScmSmallInt *itmp = SCM_NEW_ATOMIC_ARRAY(ScmSmallInt, n);
+    for (ScmSmallInt i = 0; i < n; i++) idx[i] = i;
+
+    int fixnums = TRUE, flonums = TRUE;
+    for (ScmSmallInt i = 0; i < n && (fixnums || flonums); i++) {
+        if (!SCM_INTP(keys[i])) fixnums = FALSE;
+        if (!SCM_FLONUMP(keys[i])) flonums = FALSE;
+    }
+#if !SCM_EMULATE_INT64
+    if (fixnums || flonums) {
+        uint64_t *k = SCM_NEW_ATOMIC_ARRAY(uint64_t, n);
+        uint64_t *ktmp = SCM_NEW_ATOMIC_ARRAY(uint64_t, n);
+        for (ScmSmallInt i = 0; i < n; i++) {
+            if (fixnums) {
+                k[i] = FLIP(uint64_t, (uint64_t)(int64_t)SCM_INT_VALUE(keys[i]));
+            } else {
+                k[i] = flonum_key(keys[i]);
+            }
+        }
+        u64_radix_sort(k, ktmp, idx, itmp, n);
+    } else
+#endif /*!SCM_EMULATE_INT64*/
+    {
+        merge_sort_index(idx, itmp, keys, n);
+    }
+
+    /* apply the permutation */
+    ScmObj *t = SCM_NEW_ARRAY(ScmObj, n);
+    for (ScmSmallInt i = 0; i < n; i++) t[i] = keys[idx[i]];
+    memcpy(keys, t, n*sizeof(ScmObj));
+    for (ScmSmallInt i = 0; i < n; i++) t[i] = elts[idx[i]];
+    memcpy(elts, t, n*sizeof(ScmObj));
+}
+
+/*
+ * Merging sorted runs
+ *
+ *   These are building blocks of parallel sort.  A merge of two sorted
+ *   runs A and B is split into pieces that can be done independently:
+ *   the *Split functions return how many elements of A are among the
+ *   first K elements of the merged result.  Elements of A come before
+ *   equal elements of B, so that merging is stable.
+ *
+ *   Uvector runs are ordered as Scm_UVectorSort does, and keyed runs
+ *   as Scm_SortArrayByKeys does.
+ */
+
+#define DEFINE_UV_MERGE(T, NAME, map)                                   \
+static ScmSmallInt NAME##_merge_split(const T *a, ScmSmallInt na,       \
+                                     const T *b, ScmSmallInt nb,        \
+                                     ScmSmallInt k)                     \
+{                                                                       \
+    ScmSmallInt lo = (k > nb)? k - nb : 0, hi = (k < na)? k : na;       \
+    while (lo < hi) {                                                   \
+        ScmSmallInt i = (lo + hi)/2, j = k - i;                         \
+        if (j > 0 && i < na && !(map(T, b[j-1]) < map(T, a[i]))) {      \
+            lo = i + 1;                                                 \
+        } else {                                                        \
+            hi = i;                                                     \
+        }                                                               \
+    }                                                                   \
+    return lo;                                                          \
+}                                                                       \
+static void NAME##_merge(T *d, const T *a, ScmSmallInt na,              \
+                         const T *b, ScmSmallInt nb)                    \
+{                                                                       \
+    ScmSmallInt i = 0, j = 0;                                           \
+    while (i < na && j < nb) {                                          \
+        if (map(T, b[j]) < map(T, a[i])) *d++ = b[j++];                 \
+        else                             *d++ = a[i++];                 \
+    }                                                                   \
+    while (i < na) *d++ = a[i++];                                       \
+    while (j < nb) *d++ = b[j++];                                       \
+}
+
+DEFINE_UV_MERGE(uint8_t,  u8,  IDENT)
+DEFINE_UV_MERGE(uint8_t,  s8,  FLIP)
+DEFINE_UV_MERGE(uint16_t, u16, IDENT)
+DEFINE_UV_MERGE(uint16_t, s16, FLIP)
+DEFINE_UV_MERGE(uint16_t, f16, FKEY)
+DEFINE_UV_MERGE(uint32_t, u32, IDENT)
+DEFINE_UV_MERGE(uint32_t, s32, FLIP)
+DEFINE_UV_MERGE(uint32_t, f32, FKEY)
+#if !SCM_EMULATE_INT64
+DEFINE_UV_MERGE(uint64_t, u64, IDENT)
+DEFINE_UV_MERGE(uint64_t, s64, FLIP)
+DEFINE_UV_MERGE(uint64_t, f64, FKEY)
+#endif /*!SCM_EMULATE_INT64*/
+
+#define UV_MERGE_CASES(body)                                            \
+    case SCM_UVECTOR_U8:  body(uint8_t,  u8);  break;                   \
+    case SCM_UVECTOR_S8:  body(uint8_t,  s8);  break;                   \
+    case SCM_UVECTOR_U16: body(uint16_t, u16); break;                   \
+    case SCM_UVECTOR_S16: body(uint16_t, s16); break;                   \
+    case SCM_UVECTOR_F16: body(uint16_t, f16); break;                   \
+    case SCM_UVECTOR_U32: body(uint32_t, u32); break;                   \
+    case SCM_UVECTOR_S32: body(uint32_t, s32); break;                   \
+    case SCM_UVECTOR_F32: body(uint32_t, f32); break;                   \
+    UV_MERGE_CASES64(body)
+
+#if !SCM_EMULATE_INT64
+#define UV_MERGE_CASES64(body)                                          \
+    case SCM_UVECTOR_U64: body(uint64_t, u64); break;                   \
+    case SCM_UVECTOR_S64: body(uint64_t, s64); break;                   \
+    case SCM_UVECTOR_F64: body(uint64_t, f64); break;
+#else  /*SCM_EMULATE_INT64*/
+#define UV_MERGE_CASES64(body)  /*nothing*/
+#endif /*SCM_EMULATE_INT64*/
+
+/* Ranges are [a0, a1) and [b0, b1) of SRC; the caller has checked them. */
+ScmSmallInt Scm_UVectorMergeSplit(ScmUVector *src,
+                                  ScmSmallInt a0, ScmSmallInt a1,
+                                  ScmSmallInt b0, ScmSmallInt b1,
+                                  ScmSmallInt k)
+{
+    ScmUVectorType type = Scm_UVectorType(Scm_ClassOf(SCM_OBJ(src)));
+    void *p = SCM_UVECTOR_ELEMENTS(src);
+#define SPLIT(T, NAME) \
+    return NAME##_merge_split((T*)p + a0, a1 - a0, (T*)p + b0, b1 - b0, k)
+    switch (type) {
+        UV_MERGE_CASES(SPLIT)
+    default:
+        Scm_Error("uvector merge: unsupported uvector: %S", SCM_OBJ(src));
+    }
+#undef SPLIT
+    return 0;                   /* dummy */
+}
+
+/* Merges [a0, a1) and [b0, b1) of SRC into DST from index D.  DST and
+   SRC must be the same type and must not overlap in the ranges. */
+void Scm_UVectorMerge(ScmUVector *dst, ScmSmallInt d, ScmUVector *src,
+                      ScmSmallInt a0, ScmSmallInt a1,
+                      ScmSmallInt b0, ScmSmallInt b1)
+{
+    SCM_UVECTOR_CHECK_MUTABLE(dst);
+    ScmUVectorType type = Scm_UVectorType(Scm_ClassOf(SCM_OBJ(src)));
+    if (Scm_UVectorType(Scm_ClassOf(SCM_OBJ(dst))) != type) {
+        Scm_Error("uvector merge: type mismatch: %S and %S",
+                  SCM_OBJ(dst), SCM_OBJ(src));
+    }
+    void *p = SCM_UVECTOR_ELEMENTS(src), *q = SCM_UVECTOR_ELEMENTS(dst);
+#define MERGE(T, NAME) \
+    NAME##_merge((T*)q + d, (T*)p + a0, a1 - a0, (T*)p + b0, b1 - b0)
+    switch (type) {
+        UV_MERGE_CASES(MERGE)
+    default:
+        Scm_Error("uvector merge: unsupported uvector: %S", SCM_OBJ(src));
+    }
+#undef MERGE
+}
+
+static inline int key_less(ScmObj x, ScmObj y)
+{
+    if (SCM_INTP(x) && SCM_INTP(y)) {
+        return SCM_INT_VALUE(x) < SCM_INT_VALUE(y);
+    }
+#if !SCM_EMULATE_INT64
+    if (SCM_FLONUMP(x) && SCM_FLONUMP(y)) {
+        return flonum_key(x) < flonum_key(y);
+    }
+#endif /*!SCM_EMULATE_INT64*/
+    return Scm_Compare(x, y) < 0;
+}
+
+ScmSmallInt Scm_MergeSplitByKeys(ScmObj *akeys, ScmSmallInt na,
+                                 ScmObj *bkeys, ScmSmallInt nb,
+                                 ScmSmallInt k)
+{
+    ScmSmallInt lo = (k > nb)? k - nb : 0, hi = (k < na)? k : na;
+    while (lo < hi) {
+        ScmSmallInt i = (lo + hi)/2, j = k - i;
+        if (j > 0 && i < na && !key_less(bkeys[j-1], akeys[i])) {
+            lo = i + 1;
+        } else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+/* Merges the runs (A, AKEYS) and (B, BKEYS) into (DST, DKEYS). */
+void Scm_MergeByKeys(ScmObj *dst, ScmObj *dkeys,
+                     ScmObj *a, ScmObj *akeys, ScmSmallInt na,
+                     ScmObj *b, ScmObj *bkeys, ScmSmallInt nb)
+{
+    ScmSmallInt i = 0, j = 0;
+    while (i < na && j < nb) {
+        if (key_less(bkeys[j], akeys[i])) {
+            *dst++ = b[j]; *dkeys++ = bkeys[j++];
+        } else {
+            *dst++ = a[i]; *dkeys++ = akeys[i++];
+        }
+    }
+    for (; i < na; i++) { *dst++ = a[i]; *dkeys++ = akeys[i]; }
+    for (; j < nb; j++) { *dst++ = b[j]; *dkeys++ = bkeys[j]; }
+}
+
 /*
  * Initialization
  */
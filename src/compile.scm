@@ -188,6 +188,11 @@
 ;; Maximum size of $LAMBDA node we allow to duplicate and inline.
 (define-constant SMALL_LAMBDA_SIZE 12)
 
+;; Minimum number of clauses (excluding 'else') of 'case' form to compile
+;; it into a table lookup by CASE-INDEX insn.  With fewer clauses,
+;; testing clauses one by one is just as fast.
+(define-constant CASE_DISPATCH_MIN_CLAUSES 8)
+
 (define-inline (variable? arg) (or (symbol? arg) (identifier? arg)))
 (define-inline (variable-or-keyword? arg)
   (or (symbol? arg) (keyword? arg) (identifier? arg)))
@@ -1801,6 +1806,52 @@
     (receive (reqs opts) (split-at iargs reqargs)
       (append! reqs (list (if (null? opts) ($const '()) ($list #f opts)))))))
 
+;; Keys that can be looked up by CASE-INDEX insn.  They must be eq?-comparable
+;; and have a portable hash value.  We limit integers to the range that
+;; is a fixnum on every platform, for the table may be precompiled.
+(define (case-dispatch-key? k)
+  (or (symbol? k)
+      (char? k)
+      (and (exact-integer? k) (<= -536870912 k 536870911))))
+
+;; Build a dispatch table for CASE-INDEX insn.  KEYSS is a list of lists of
+;; keys, one for each clause.  A key maps to the index of the first
+;; clause that contains it; other objects map to DEFAULT.  See
+;; case_dispatch_index() in vm.c for the layout of the table.
+(define (pass1/case-dispatch-table keyss default)
+  (let1 alist (let loop ([keyss keyss] [i 0] [r '()])
+                (if (null? keyss)
+                  (reverse r)
+                  (loop (cdr keyss) (+ i 1)
+                        (let kloop ([ks (car keyss)] [r r])
+                          (cond [(null? ks) r]
+                                [(assq (car ks) r) (kloop (cdr ks) r)]
+                                [else (kloop (cdr ks) (acons (car ks) i r))])))))
+    (if (and (pair? alist) (every (^p (exact-integer? (car p))) alist))
+      (let* ([lo (apply min (map car alist))]
+             [hi (apply max (map car alist))]
+             [size (+ (- hi lo) 1)])
+        (if (<= size (* (length alist) 2))
+          (let1 indices (make-vector size default)
+            (dolist [p alist] (vector-set! indices (- (car p) lo) (cdr p)))
+            (vector default lo indices))
+          (case-dispatch-hash-table alist default)))
+      (case-dispatch-hash-table alist default))))
+
+(define (case-dispatch-hash-table alist default)
+  (let* ([size (let loop ([s 8])
+                 (if (< s (* (length alist) 2)) (loop (* s 2)) s))]
+         [mask (- size 1)]
+         [keys (make-vector size #f)]
+         [indices (make-vector size default)])
+    (dolist [p alist]
+      (let loop ([i (logand (portable-hash (car p) 0) mask)])
+        (if (vector-ref keys i)
+          (loop (logand (+ i 1) mask))
+          (begin (vector-set! keys i (car p))
+                 (vector-set! indices i (cdr p))))))
+    (vector default keys indices)))
+
 ;;----------------------------------------------------------------
 ;; Pass1 syntaxes
 ;;
@@ -1827,6 +1878,8 @@
 (define lazy.        (global-id 'lazy))
 (define eager.       (global-id 'eager))
 (define values.      (global-id 'values))
+(define call-with-values. (global-id 'call-with-values))
+(define error.       (global-id 'error))
 (define begin.       (global-id 'begin))
 (define include.     (global-id 'include))
 (define include-ci.  (global-id 'include-ci))
@@ -1899,10 +1952,18 @@
        ;; other code except the code generated in the same macro expansion.
        ;; A trick - we directly modify the identifier, so that other forms
        ;; referring to the same (eq?) identifier can keep referring it.
-       (let1 id (if (identifier? name)
-                  (%rename-toplevel-identifier! name)
-                  (make-identifier name module '()))
-         ($define oform flags id (pass1 expr cenv))))]
+       (let ([id (if (identifier? name)
+                   (%rename-toplevel-identifier! name)
+                   (make-identifier name module '()))]
+             [iform (pass1 expr cenv)])
+         (if (and (symbol? name)
+                  (not (memq 'const flags))
+                  (module-sealed-for-inlining? module)
+                  (pass1/small-closure? iform))
+           (begin
+             (pass1/mark-closure-inlinable! iform name cenv)
+             ($define oform (cons 'inlinable flags) id iform))
+           ($define oform flags id iform))))]
     [_ (error "syntax-error:" oform)]))
 
 (define (%rename-toplevel-identifier! identifier)
@@ -1941,6 +2002,38 @@
 ;;      of subst-lvars above for the details of transformation.
 ;;
 
+;; Sealed module.
+;;   (seal-module) declares that the toplevel procedures defined after it
+;;   in the current module won't be redefined.  Then pass1/define treats
+;;   definitions of small procedures like define-inline, so that they can
+;;   be inlined into the callers, including the ones in other modules.
+;;   The declaration only affects the compiler; it is recorded in the
+;;   module's info alist while the module is compiled.
+;;   If such a procedure is redefined by an ordinary definition after all,
+;;   Scm_MakeBinding warns and drops the inlinable mark, so the callers
+;;   compiled after that see the new definition.
+
+(define-pass1-syntax (seal-module form cenv) :gauche
+  (check-toplevel form cenv)
+  (match form
+    [(_) (let1 m (cenv-module cenv)
+           (unless (module-sealed-for-inlining? m)
+             (slot-set! m 'info (acons 'sealed-for-inlining #t
+                                       (slot-ref m 'info))))
+           ($values0))]
+    [_ (error "syntax-error: malformed seal-module:" form)]))
+
+(define (module-sealed-for-inlining? module)
+  (cond [(assq 'sealed-for-inlining (slot-ref module 'info)) => cdr]
+        [else #f]))
+
+;; Returns #t if IFORM is a $LAMBDA node small enough to be inlined
+;; without define-inline.
+(define (pass1/small-closure? iform)
+  (and (has-tag? iform $LAMBDA)
+       (< (iform-count-size-upto ($lambda-body iform) SMALL_LAMBDA_SIZE)
+          SMALL_LAMBDA_SIZE)))
+
 (define-pass1-syntax (define-inline form cenv) :gauche
   (check-toplevel form cenv)
   (match form
@@ -2349,20 +2442,24 @@
     [else (error "syntax-error: malformed cond:" form)]))
 
 (define-pass1-syntax (case form cenv) :null
+  (define (else-clause? cl)
+    (and (pair? cl) (global-eq? (car cl) 'else cenv)))
+  (define (clause-body cl exprs tmpvar)
+    (match exprs
+      ;; (elts => proc) -- SRFI-87 case clause
+      [((? (cut global-eq? <> '=> cenv)) proc)
+       ($call cl
+              (pass1 proc (cenv-sans-name cenv))
+              (list ($lref tmpvar)))]
+      ;; (elts . exprs)
+      [_ ($seq (imap (cut pass1 <> cenv) exprs))]))
   (define (process-clauses tmpvar cls)
     (match cls
       [() ($const-undef)]
-      [(([? (cut global-eq? <> 'else cenv)] exprs ...) . rest)
+      [((? else-clause?) . rest)
        (unless (null? rest)
          (error "syntax-error: 'else' clause followed by more clauses:" form))
-       (match exprs
-         ;; (else => proc) -- SRFI-87 case clause
-         [((? (cut global-eq? <> '=> cenv)) proc)
-          ($call (car cls)
-                 (pass1 proc (cenv-sans-name cenv))
-                 (list ($lref tmpvar)))]
-         ;; (else . exprs)
-         [_ ($seq (imap (cut pass1 <> cenv) exprs))])]
+       (clause-body (car cls) (cdar cls) tmpvar)]
       [((elts exprs ...) . rest)
        (let ([nelts (length elts)]
              [elts  (map unwrap-syntax elts)])
@@ -2373,16 +2470,49 @@
                         ($eq? #f  ($lref tmpvar) ($const (car elts)))
                         ($eqv? #f ($lref tmpvar) ($const (car elts))))]
                 [else ($memv #f ($lref tmpvar) ($const elts))])
-              (match exprs
-                ;; (elts => proc) -- SRFI-87 case clause
-                [((? (cut global-eq? <> '=> cenv)) proc)
-                 ($call (car cls)
-                        (pass1 proc (cenv-sans-name cenv))
-                        (list ($lref tmpvar)))]
-                ;; (elts . exprs)
-                [_ ($seq (imap (cut pass1 <> cenv) exprs))])
+              (clause-body (car cls) exprs tmpvar)
               (process-clauses tmpvar (cdr cls))))]
       [_ (error "syntax-error: bad clause in case:" form)]))
+  ;; If there are many clauses and all keys are fixnums, chars or symbols,
+  ;; we look up the clause index with CASE-INDEX insn and then branch
+  ;; on the index by binary search, instead of testing clauses one by one.
+  ;; Returns #f if CLS isn't eligible, or malformed (in which case
+  ;; process-clauses reports the error).
+  (define (dispatch-clauses tmpvar cls)
+    (let loop ([cls cls] [n 0] [clauses '()] [keyss '()] [elses '()])
+      (match cls
+        [() (and (>= n CASE_DISPATCH_MIN_CLAUSES)
+                 (dispatch-tree tmpvar n (reverse clauses) (reverse keyss)
+                                elses))]
+        [((? else-clause?)) (loop '() n clauses keyss cls)]
+        [(((elts ...) exprs ...) . rest)
+         (let1 elts (map unwrap-syntax elts)
+           (and (every case-dispatch-key? elts)
+                (loop rest (+ n 1) (cons (car cls) clauses) (cons elts keyss)
+                      elses)))]
+        [_ #f])))
+  (define (dispatch-tree tmpvar n clauses keyss elses)
+    (let* ([table (pass1/case-dispatch-table keyss n)]
+           [idx (make-lvar 'idx)]
+           [init ($asm form `(,CASE-INDEX)
+                       (list ($lref tmpvar) ($const table)))]
+           [bodies (list->vector
+                    (append (imap (^[cl] (clause-body cl (cdr cl) tmpvar))
+                                  clauses)
+                            (list (process-clauses tmpvar elses))))])
+      (lvar-initval-set! idx init)
+      ($let form 'let
+            (list idx)
+            (list init)
+            ;; Clause I is selected iff idx == I; idx == N is the else clause.
+            (let rec ([lo 0] [hi (+ n 1)])
+              (if (= (- hi lo) 1)
+                (vector-ref bodies lo)
+                (let1 mid (quotient (+ lo hi) 2)
+                  ($if #f
+                       ($asm #f `(,NUMLT2) (list ($lref idx) ($const mid)))
+                       (rec lo mid)
+                       (rec mid hi))))))))
 
   (match form
     [(_)
@@ -2394,7 +2524,8 @@
        ($let form 'let
              (list tmp)
              (list etree)
-             (process-clauses tmp clause)))]
+             (or (dispatch-clauses tmp clause)
+                 (process-clauses tmp clause))))]
     [_ (error "syntax-error: malformed case:" form)]))
 
 (define-pass1-syntax (and-let* form cenv) :gauche
@@ -5356,6 +5487,8 @@
       (pass5/asm-numdiv2 info (car args) (cadr args) ccb renv ctx)]
      [(LOGAND LOGIOR LOGXOR)
       (pass5/asm-bitwise info (car insn) (car args) (cadr args) ccb renv ctx)]
+     [(CASE-INDEX)
+      (pass5/asm-case-index info (car args) (cadr args) ccb renv ctx)]
      [(VEC-REF)
       (pass5/asm-vec-ref info (car args) (cadr args) ccb renv ctx)]
      [(VEC-SET)
@@ -5533,6 +5666,11 @@
                                   0 ($const-value x) y)
     (pass5/builtin-twoargs info insn 0 x y)))
 
+;; The second arg is always a constant dispatch table generated by
+;; the 'case' form.  See pass1/case-dispatch-table.
+(define (pass5/asm-case-index info key table ccb renv ctx)
+  (pass5/builtin-onearg+operand info CASE-INDEX 0 ($const-value table) key))
+
 (define (pass5/asm-vec-ref info vec k ccb renv ctx)
   (cond [(and ($const? k)
               (unsigned-integer-fits-insn-arg? ($const-value k)))
@@ -6012,6 +6150,216 @@
                       ))))))]
       [_ (undefined)])))
 
+;; (call-with-values producer (lambda formals body ...)) is turned into
+;; ($receive formals (producer) body ...), so that the values are directly
+;; bound to the consumer's local variables instead of going through a
+;; rest list and apply.
+(define-builtin-inliner call-with-values
+  (^[form cenv]
+    (match form
+      [(_ producer consumer)
+       (let ([p (pass1 producer cenv)]
+             [c (pass1 consumer cenv)])
+         (if (has-tag? c $LAMBDA)
+           ($receive form ($lambda-reqargs c) ($lambda-optarg c)
+                     ($lambda-lvars c) ($call form p '()) ($lambda-body c))
+           ($call form ($gref call-with-values.) (list p c))))]
+      [_ (undefined)])))
+
+;;--------------------------------------------------------
+;; Inlining higher-order list procedures
+;;
+
+;; (map (lambda (x) ...) lis) and the like are expanded into a loop when
+;; the procedure argument is a lambda form, or a local variable bound to
+;; one, that takes the right number of arguments.  The procedure is bound
+;; to a local variable outside of the loop.  If it is called only at one
+;; place, Pass 2 inlines its body into the loop; otherwise it becomes a
+;; local procedure.  Either way, no closure is created per call of map etc.,
+;; and the loop itself is an embedded one.  The expanded loops behave
+;; as the definitions in liblist.scm, including the errors they signal.
+;; Calls with more than one list are left to the procedures.
+
+;; Returns #t if PROC is an IForm of known lambda that takes NARGS.
+(define (hof-known-proc? proc nargs)
+  (let1 lam (cond [(has-tag? proc $LAMBDA) proc]
+                  [($lref? proc) (lvar-initval ($lref-lvar proc))]
+                  [else #f])
+    (and (vector? lam)
+         (has-tag? lam $LAMBDA)
+         (= ($lambda-reqargs lam) nargs)
+         (= ($lambda-optarg lam) 0))))
+
+;; Builds
+;;   (let ([f PROC] [l LIS])
+;;     (letrec ([loop (lambda VARS BODY)]) ENTRY))
+;; BODY is (body f l loop vars), and ENTRY is (entry l loop), where f, l
+;; and loop are lvars and vars is a list of lvars.
+(define (hof-expand form proc lis var-names body entry)
+  (let* ([f (make-lvar 'proc)]
+         [l (make-lvar 'lis)]
+         [loop (make-lvar 'loop)]
+         [vars (imap make-lvar+ var-names)]
+         [lmda ($lambda form 'loop (length vars) 0 vars
+                        (body f l loop vars) #f)])
+    (lvar-initval-set! f proc)
+    (lvar-initval-set! l lis)
+    (lvar-initval-set! loop lmda)
+    ($let form 'let (list f l) (list proc lis)
+          ($let form 'rec (list loop) (list lmda)
+                (entry l loop)))))
+
+(define (hof-call proc . args) ($call #f ($lref proc) args))
+(define (hof-car v) ($asm #f `(,CAR) (list ($lref v))))
+(define (hof-cdr v) ($asm #f `(,CDR) (list ($lref v))))
+(define (hof-cons x v) ($asm #f `(,CONS) (list x ($lref v))))
+(define (hof-reverse v) ($asm #f `(,REVERSE) (list ($lref v))))
+(define (hof-error msg v)
+  ($call #f ($gref error.) (list ($const msg) ($lref v))))
+
+;; (cond [(pair? v) PAIR] [(null? v) NULL] [else <error>]), where the
+;; error is the one map and for-each raise on the improper list L.
+(define (hof-dispatch v l pair null)
+  ($if #f ($asm #f `(,PAIRP) (list ($lref v)))
+       pair
+       ($if #f ($asm #f `(,NULLP) (list ($lref v)))
+            null
+            (hof-error "improper list not allowed:" l))))
+
+;; (if (null-list? v) NULL NOT-NULL)
+(define (hof-null-list v null not-null)
+  ($if #f ($asm #f `(,NULLP) (list ($lref v)))
+       null
+       ($if #f ($asm #f `(,PAIRP) (list ($lref v)))
+            not-null
+            (hof-error "argument must be a list, but got:" v))))
+
+;; EXPAND receives the form and the list of argument IForms, and returns
+;; the expanded loop, or #f to give up.  Since we've already run pass1 on
+;; the arguments, we generate the ordinary call by ourselves in that case.
+(define (gen-hof-inliner name expand)
+  (let1 id (global-id name)
+    (^[form cenv]
+      (let1 args (imap (cut pass1 <> cenv) (cdr form))
+        (or (expand form args)
+            ($call form ($gref id) args))))))
+
+;; (for-each proc lis)
+(define-builtin-inliner for-each
+  (gen-hof-inliner
+   'for-each
+   (^[form args]
+     (match args
+       [(proc lis)
+        (and (hof-known-proc? proc 1)
+             (hof-expand form proc lis '(xs)
+                         (^[f l loop vars]
+                           (let1 xs (car vars)
+                             (hof-dispatch xs l
+                                           ($seq
+                                            (list (hof-call f (hof-car xs))
+                                                  (hof-call loop (hof-cdr xs))))
+                                           ($const-undef))))
+                         (^[l loop] (hof-call loop ($lref l)))))]
+       [_ #f]))))
+
+;; (map proc lis)
+(define-builtin-inliner map
+  (gen-hof-inliner
+   'map
+   (^[form args]
+     (match args
+       [(proc lis)
+        (and (hof-known-proc? proc 1)
+             (hof-expand form proc lis '(xs r)
+                         (^[f l loop vars]
+                           (let ([xs (car vars)] [r (cadr vars)])
+                             (hof-dispatch xs l
+                                           (hof-call loop (hof-cdr xs)
+                                                     (hof-cons
+                                                      (hof-call f (hof-car xs))
+                                                      r))
+                                           (hof-reverse r))))
+                         (^[l loop] (hof-call loop ($lref l) ($const-nil)))))]
+       [_ #f]))))
+
+;; (fold kons knil lis)
+(define-builtin-inliner fold
+  (gen-hof-inliner
+   'fold
+   (^[form args]
+     (match args
+       [(proc knil lis)
+        (and (hof-known-proc? proc 2)
+             (let1 k (make-lvar 'knil)
+               (lvar-initval-set! k knil)
+               ($let form 'let (list k) (list knil)
+                     (hof-expand form proc lis '(xs acc)
+                                 (^[f l loop vars]
+                                   (let ([xs (car vars)] [acc (cadr vars)])
+                                     (hof-null-list xs
+                                                    ($lref acc)
+                                                    (hof-call loop (hof-cdr xs)
+                                                              (hof-call f (hof-car xs)
+                                                                        ($lref acc))))))
+                                 (^[l loop]
+                                   (hof-call loop ($lref l) ($lref k)))))))]
+       [_ #f]))))
+
+;; (filter pred lis)
+(define-builtin-inliner filter
+  (gen-hof-inliner
+   'filter
+   (^[form args]
+     (match args
+       [(proc lis)
+        (and (hof-known-proc? proc 1)
+             (hof-expand form proc lis '(xs r)
+                         (^[f l loop vars]
+                           (let ([xs (car vars)] [r (cadr vars)])
+                             (hof-null-list xs
+                                            (hof-reverse r)
+                                            ($if #f (hof-call f (hof-car xs))
+                                                 (hof-call loop (hof-cdr xs)
+                                                           (hof-cons (hof-car xs) r))
+                                                 (hof-call loop (hof-cdr xs)
+                                                           ($lref r))))))
+                         (^[l loop] (hof-call loop ($lref l) ($const-nil)))))]
+       [_ #f]))))
+
+;; (any pred lis) and (every pred lis).  As in liblist.scm, the last
+;; element is passed to PRED in a tail call.
+(define (gen-any/every-inliner name every?)
+  (gen-hof-inliner
+   name
+   (^[form args]
+     (match args
+       [(proc lis)
+        (and (hof-known-proc? proc 1)
+             (hof-expand form proc lis '(head tail)
+                         (^[f l loop vars]
+                           (let ([h (car vars)] [t (cadr vars)])
+                             (hof-null-list t
+                                            (hof-call f ($lref h))
+                                            (let1 next (hof-call loop (hof-car t)
+                                                                 (hof-cdr t))
+                                              (if every?
+                                                ($if #f (hof-call f ($lref h))
+                                                     next
+                                                     ($const-f))
+                                                ($if #f (hof-call f ($lref h))
+                                                     ($it)
+                                                     next))))))
+                         (^[l loop]
+                           (hof-null-list l
+                                          (if every? ($const-t) ($const-f))
+                                          (hof-call loop (hof-car l)
+                                                    (hof-cdr l))))))]
+       [_ #f]))))
+
+(define-builtin-inliner any   (gen-any/every-inliner 'any #f))
+(define-builtin-inliner every (gen-any/every-inliner 'every #t))
+
 ;;--------------------------------------------------------
 ;; Customizable inliner interface
 ;;
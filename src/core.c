@@ -113,6 +113,8 @@ extern void Scm_Init_compile(void);
 extern void Scm_Init_libomega(void);
 
 static void finalizable(void);
+static void gc_event(GC_EventType type);
+static void gc_setup_from_env(void);
 static void init_cond_features(void);
 
 #ifdef GAUCHE_USE_PTHREADS
@@ -123,6 +125,44 @@ static int (*ptr_pthread_create)(void) = NULL;
 /* flag to see if Scheme infrastructure is fully initialized or not */
 static int scheme_initialized = FALSE;
 
+/* Time spent by each initialization routine, in microseconds.
+   Recorded always, since it costs only a couple of gettimeofday()
+   calls per routine; 'gosh -ftrace-startup' shows them by
+   Scm__PrintInitTimes.  */
+#define MAX_INIT_TIMES 64
+static struct {
+    const char *name;
+    long usec;
+} init_times[MAX_INIT_TIMES];
+static int num_init_times = 0;
+
+static long init_clock(void)
+{
+#if defined(HAVE_GETTIMEOFDAY)
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec*1000000 + tv.tv_usec;
+#else  /*!HAVE_GETTIMEOFDAY*/
+    return 0;
+#endif /*!HAVE_GETTIMEOFDAY*/
+}
+
+static void record_init_time(const char *name, long t0)
+{
+    if (num_init_times < MAX_INIT_TIMES) {
+        init_times[num_init_times].name = name;
+        init_times[num_init_times].usec = init_clock() - t0;
+        num_init_times++;
+    }
+}
+
+#define TIMED_INIT(fn)                          \
+    do {                                        \
+        long t0_ = init_clock();                \
+        fn();                                   \
+        record_init_time(#fn, t0_);             \
+    } while (0)
+
 /*
  * Entry point of initlalizing Gauche runtime
  */
@@ -138,6 +178,7 @@ void Scm_Init(const char *signature)
 
     /* Some platforms require this.  It is harmless if GC is
        already initialized, so we call it here just in case. */
+    Scm_GCPreInit();
     GC_init();
 
     /* Set up GC parameters.  We need to call finalizers at the safe
@@ -146,62 +187,64 @@ void Scm_Init(const char *signature)
     GC_oom_fn = oom_handler;
     GC_finalize_on_demand = TRUE;
     GC_finalizer_notifier = finalizable;
+    GC_set_on_collection_event(gc_event);
+    gc_setup_from_env();
 
     (void)SCM_INTERNAL_MUTEX_INIT(cond_features.mutex);
 
     /* Initialize components.  The order is important, for some components
        rely on the other components to be initialized. */
-    Scm__InitParameter();
-    Scm__InitVM();
-    Scm__InitHash();
-    Scm__InitSymbol();
-    Scm__InitModule();
-    Scm__InitNumber();
-    Scm__InitChar();
-    Scm__InitClass();
-    Scm__InitCollection();
-    Scm__InitExceptions();
-    Scm__InitProc();
-    Scm__InitPort();
-    Scm__InitWrite();
-    Scm__InitMacro();
-    Scm__InitLoad();
-    Scm__InitRegexp();
-    Scm__InitRead();
-    Scm__InitSignal();
-    Scm__InitSystem();
-    Scm__InitComparator();
-
-    Scm_Init_libalpha();
-    Scm_Init_libbool();
-    Scm_Init_libchar();
-    Scm_Init_libcode();
-    Scm_Init_libcmp();
-    Scm_Init_libdict();
-    Scm_Init_libeval();
-    Scm_Init_libexc();
-    Scm_Init_libfmt();
-    Scm_Init_libio();
-    Scm_Init_liblazy();
-    Scm_Init_liblist();
-    Scm_Init_libmisc();
-    Scm_Init_libmod();
-    Scm_Init_libnum();
-    Scm_Init_libobj();
-    Scm_Init_libproc();
-    Scm_Init_librx();
-    Scm_Init_libsrfis();
-    Scm_Init_libstr();
-    Scm_Init_libsym();
-    Scm_Init_libsys();
-    Scm_Init_libvec();
-    Scm_Init_compile();
-    Scm_Init_libomega();
-
-    Scm__InitCompaux();
+    TIMED_INIT(Scm__InitParameter);
+    TIMED_INIT(Scm__InitVM);
+    TIMED_INIT(Scm__InitHash);
+    TIMED_INIT(Scm__InitSymbol);
+    TIMED_INIT(Scm__InitModule);
+    TIMED_INIT(Scm__InitNumber);
+    TIMED_INIT(Scm__InitChar);
+    TIMED_INIT(Scm__InitClass);
+    TIMED_INIT(Scm__InitCollection);
+    TIMED_INIT(Scm__InitExceptions);
+    TIMED_INIT(Scm__InitProc);
+    TIMED_INIT(Scm__InitPort);
+    TIMED_INIT(Scm__InitWrite);
+    TIMED_INIT(Scm__InitMacro);
+    TIMED_INIT(Scm__InitLoad);
+    TIMED_INIT(Scm__InitRegexp);
+    TIMED_INIT(Scm__InitRead);
+    TIMED_INIT(Scm__InitSignal);
+    TIMED_INIT(Scm__InitSystem);
+    TIMED_INIT(Scm__InitComparator);
+
+    TIMED_INIT(Scm_Init_libalpha);
+    TIMED_INIT(Scm_Init_libbool);
+    TIMED_INIT(Scm_Init_libchar);
+    TIMED_INIT(Scm_Init_libcode);
+    TIMED_INIT(Scm_Init_libcmp);
+    TIMED_INIT(Scm_Init_libdict);
+    TIMED_INIT(Scm_Init_libeval);
+    TIMED_INIT(Scm_Init_libexc);
+    TIMED_INIT(Scm_Init_libfmt);
+    TIMED_INIT(Scm_Init_libio);
+    TIMED_INIT(Scm_Init_liblazy);
+    TIMED_INIT(Scm_Init_liblist);
+    TIMED_INIT(Scm_Init_libmisc);
+    TIMED_INIT(Scm_Init_libmod);
+    TIMED_INIT(Scm_Init_libnum);
+    TIMED_INIT(Scm_Init_libobj);
+    TIMED_INIT(Scm_Init_libproc);
+    TIMED_INIT(Scm_Init_librx);
+    TIMED_INIT(Scm_Init_libsrfis);
+    TIMED_INIT(Scm_Init_libstr);
+    TIMED_INIT(Scm_Init_libsym);
+    TIMED_INIT(Scm_Init_libsys);
+    TIMED_INIT(Scm_Init_libvec);
+    TIMED_INIT(Scm_Init_compile);
+    TIMED_INIT(Scm_Init_libomega);
+
+    TIMED_INIT(Scm__InitCompaux);
 
     Scm_SelectModule(Scm_GaucheModule());
-    Scm__InitAutoloads();
+    TIMED_INIT(Scm__InitAutoloads);
 
     Scm_SelectModule(Scm_UserModule());
 
@@ -221,6 +264,19 @@ int Scm_InitializedP()
     return scheme_initialized;
 }
 
+/* Called from main.c when -ftrace-startup is given */
+void Scm__PrintInitTimes(ScmPort *out)
+{
+    long total = 0;
+    Scm_Printf(out, ";; Startup initialization time (usec):\n");
+    for (int i=0; i<num_init_times; i++) {
+        Scm_Printf(out, ";;  %8ld  %s\n",
+                   init_times[i].usec, init_times[i].name);
+        total += init_times[i].usec;
+    }
+    Scm_Printf(out, ";;  %8ld  total\n", total);
+}
+
 /*=============================================================
  * GC utilities
  */
@@ -297,14 +353,479 @@ void finalizable(void)
     }
 }
 
-/* Called from VM loop.  Queue is not empty. */
+static void gc_finalizers_run(int n);
+static void gc_run_handler(void);
+
+/* Called from VM loop.  Queue is not empty.  This is also used to
+   deliver GC events to the Scheme-level handler. */
 ScmObj Scm_VMFinalizerRun(ScmVM *vm)
 {
-    GC_invoke_finalizers();
     vm->finalizerPending = FALSE;
+    gc_finalizers_run(GC_invoke_finalizers());
+    gc_run_handler();
     return SCM_UNDEFINED;
 }
 
+/*=============================================================
+ * GC telemetry
+ */
+
+/* Pause time histogram.  Bucket 0 counts pauses under 1us, bucket i
+   (0 < i < GC_HIST_BUCKETS-1) counts pauses in [2^(i-1), 2^i) us,
+   and the last bucket counts the rest. */
+#define GC_HIST_BUCKETS 26
+#define GC_RECENT_EVENTS 64
+
+struct gc_stat_rec {
+    /* states of the ongoing collection */
+    long startWall;
+    clock_t startCpu;
+    u_long startHeap;
+    /* accumulated stats */
+    u_long count;               /* # of collections recorded */
+    long totalWall;
+    long maxWall;
+    u_long totalFinalizers;
+    u_long histogram[GC_HIST_BUCKETS];
+    ScmGCEvent recent[GC_RECENT_EVENTS]; /* ring; count is the head */
+    /* callbacks */
+    ScmGCEventCallback callback;
+    void *callbackData;
+    ScmObj handler;             /* Scheme handler or #f */
+    u_long delivered;           /* # of events passed to handler */
+    int inHandler;
+};
+
+/* Modified with GC lock held (see gc_event), so we access it under the
+   GC lock via GC_call_with_alloc_lock. */
+static struct gc_stat_rec gcstat = {
+    0, 0, 0, 0, 0, 0, 0, {0}, {{0}}, NULL, NULL, SCM_FALSE, 0, 0
+};
+
+static u_long gc_heap_in_use(void)
+{
+    struct GC_prof_stats_s st;
+    /* We're called with GC lock held. */
+#ifdef GC_THREADS
+    GC_get_prof_stats_unsafe(&st, sizeof(st));
+#else
+    GC_get_prof_stats(&st, sizeof(st));
+#endif
+    return (u_long)(st.heapsize_full - st.free_bytes_full);
+}
+
+/* Called by GC with the GC lock held.  We can't allocate here. */
+static void gc_event(GC_EventType type)
+{
+    if (type == GC_EVENT_START) {
+        gcstat.startWall = init_clock();
+        gcstat.startCpu = clock();
+        gcstat.startHeap = gc_heap_in_use();
+    } else if (type == GC_EVENT_END) {
+        ScmGCEvent *ev = &gcstat.recent[gcstat.count % GC_RECENT_EVENTS];
+        long wall = init_clock() - gcstat.startWall;
+        if (wall < 0) wall = 0;
+        ev->gcNo = (u_long)GC_get_gc_no();
+        ev->wallTime = wall;
+        ev->cpuTime = (long)((double)(clock() - gcstat.startCpu)
+                             * 1000000 / CLOCKS_PER_SEC);
+        ev->heapBefore = gcstat.startHeap;
+        ev->heapAfter = gc_heap_in_use();
+        ev->reclaimed = (ev->heapBefore > ev->heapAfter)
+            ? ev->heapBefore - ev->heapAfter : 0;
+        ev->finalizersRun = 0;
+
+        int b = 0;
+        while (b < GC_HIST_BUCKETS-1 && wall >= (1L<<b)) b++;
+        gcstat.histogram[b]++;
+        gcstat.totalWall += wall;
+        if (wall > gcstat.maxWall) gcstat.maxWall = wall;
+        gcstat.count++;
+
+        if (gcstat.callback) gcstat.callback(ev, gcstat.callbackData);
+        if (!SCM_FALSEP(gcstat.handler)) {
+            /* Ask the VM to call us back at the safe point. */
+            ScmVM *vm = Scm_VM();
+            if (vm != NULL) {
+                vm->finalizerPending = TRUE;
+                vm->attentionRequest = TRUE;
+            }
+        }
+    }
+}
+
+/* Functions called via GC_call_with_alloc_lock */
+static void *gc_snapshot(void *buf)
+{
+    *(struct gc_stat_rec*)buf = gcstat;
+    return NULL;
+}
+
+static void *gc_add_finalizers(void *data)
+{
+    int n = *(int*)data;
+    gcstat.totalFinalizers += n;
+    if (gcstat.count > 0) {
+        gcstat.recent[(gcstat.count-1) % GC_RECENT_EVENTS].finalizersRun += n;
+    }
+    return NULL;
+}
+
+static void *gc_set_callback(void *data)
+{
+    struct gc_stat_rec *r = (struct gc_stat_rec*)data;
+    gcstat.callback = r->callback;
+    gcstat.callbackData = r->callbackData;
+    return NULL;
+}
+
+static void *gc_set_handler(void *data)
+{
+    gcstat.handler = SCM_OBJ(data);
+    gcstat.delivered = gcstat.count;
+    return NULL;
+}
+
+static void *gc_set_delivered(void *data)
+{
+    gcstat.delivered = *(u_long*)data;
+    return NULL;
+}
+
+static void gc_finalizers_run(int n)
+{
+    if (n > 0) GC_call_with_alloc_lock(gc_add_finalizers, &n);
+}
+
+void Scm_SetGCEventCallback(ScmGCEventCallback cb, void *data)
+{
+    struct gc_stat_rec r;
+    r.callback = cb;
+    r.callbackData = data;
+    GC_call_with_alloc_lock(gc_set_callback, &r);
+}
+
+void Scm_SetGCEventHandler(ScmObj handler)
+{
+    if (!SCM_FALSEP(handler) && !SCM_PROCEDUREP(handler)) {
+        Scm_Error("procedure or #f required, but got %S", handler);
+    }
+    GC_call_with_alloc_lock(gc_set_handler, handler);
+}
+
+static ScmObj gc_event_to_list(const ScmGCEvent *ev)
+{
+    return Scm_List(SCM_LIST2(SCM_MAKE_KEYWORD("gc-no"),
+                              Scm_MakeIntegerU(ev->gcNo)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("wall-time"),
+                              Scm_MakeInteger(ev->wallTime)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("cpu-time"),
+                              Scm_MakeInteger(ev->cpuTime)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("heap-before"),
+                              Scm_MakeIntegerU(ev->heapBefore)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("heap-after"),
+                              Scm_MakeIntegerU(ev->heapAfter)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("reclaimed"),
+                              Scm_MakeIntegerU(ev->reclaimed)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("finalizers-run"),
+                              Scm_MakeIntegerU(ev->finalizersRun)),
+                    NULL);
+}
+
+/* Returns a list of events in [from, st->count) in ST, at most
+   GC_RECENT_EVENTS of them, oldest first. */
+static ScmObj gc_events(const struct gc_stat_rec *st, u_long from)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    if (st->count - from > GC_RECENT_EVENTS) from = st->count - GC_RECENT_EVENTS;
+    for (u_long i = from; i < st->count; i++) {
+        SCM_APPEND1(h, t, gc_event_to_list(&st->recent[i % GC_RECENT_EVENTS]));
+    }
+    return h;
+}
+
+/* Pass the events since the last delivery to the Scheme handler. */
+static void gc_run_handler(void)
+{
+    static struct gc_stat_rec st; /* too big for stack; protected by
+                                     inHandler */
+    if (SCM_FALSEP(gcstat.handler) || gcstat.inHandler) return;
+    if (gcstat.delivered == gcstat.count) return;
+
+    gcstat.inHandler = TRUE;
+    GC_call_with_alloc_lock(gc_snapshot, &st);
+    GC_call_with_alloc_lock(gc_set_delivered, &st.count);
+    ScmObj handler = st.handler;
+    ScmObj events = gc_events(&st, st.delivered);
+    SCM_UNWIND_PROTECT {
+        ScmObj cp;
+        SCM_FOR_EACH(cp, events) Scm_ApplyRec1(handler, SCM_CAR(cp));
+    } SCM_WHEN_ERROR {
+        gcstat.inHandler = FALSE;
+        SCM_NEXT_HANDLER;
+    } SCM_END_PROTECT;
+    gcstat.inHandler = FALSE;
+}
+
+ScmObj Scm_GCEventStat(void)
+{
+    struct gc_stat_rec st;
+    GC_call_with_alloc_lock(gc_snapshot, &st);
+    return SCM_LIST4(SCM_LIST2(SCM_MAKE_KEYWORD("gc-count"),
+                               Scm_MakeIntegerU(st.count)),
+                     SCM_LIST2(SCM_MAKE_KEYWORD("total-pause-time"),
+                               Scm_MakeInteger(st.totalWall)),
+                     SCM_LIST2(SCM_MAKE_KEYWORD("max-pause-time"),
+                               Scm_MakeInteger(st.maxWall)),
+                     SCM_LIST2(SCM_MAKE_KEYWORD("finalizers-run"),
+                               Scm_MakeIntegerU(st.totalFinalizers)));
+}
+
+/* Returns ((<upper-bound-us> . <count>) ...).  The upper bound of the
+   last bucket is +inf.0. */
+ScmObj Scm_GCPauseHistogram(void)
+{
+    struct gc_stat_rec st;
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    GC_call_with_alloc_lock(gc_snapshot, &st);
+    for (int i=0; i<GC_HIST_BUCKETS; i++) {
+        ScmObj bound = (i < GC_HIST_BUCKETS-1)
+            ? Scm_MakeInteger(1L<<i)
+            : Scm_MakeFlonum(SCM_DBL_POSITIVE_INFINITY);
+        SCM_APPEND1(h, t, Scm_Cons(bound, Scm_MakeIntegerU(st.histogram[i])));
+    }
+    return h;
+}
+
+/* Returns the recent collection records, oldest first. */
+ScmObj Scm_GCRecentEvents(void)
+{
+    struct gc_stat_rec st;
+    GC_call_with_alloc_lock(gc_snapshot, &st);
+    return gc_events(&st, 0);
+}
+
+/*
+ * GC tuning
+ *
+ *  The number of marker threads is fixed when GC is initialized, so
+ *  GAUCHE_GC_MARKERS must be seen before that; the application calls
+ *  Scm_GCPreInit() before GC_INIT() (gosh does).  We also call it from
+ *  Scm_Init, which is effective only when GC hasn't been initialized.
+ *
+ *  Other parameters can be changed any time.  Their initial values
+ *  are taken from environment variables in Scm_Init:
+ *
+ *   GAUCHE_GC_INCREMENTAL         - Non-empty value other than "0" turns
+ *                                   on incremental/generational mode.
+ *   GAUCHE_GC_FREE_SPACE_DIVISOR  - Larger value makes GC run more often
+ *                                   and keep the heap smaller.
+ *   GAUCHE_GC_MAX_PAUSE           - Target pause time in milliseconds
+ *                                   for incremental mode.
+ *   GAUCHE_GC_FULL_FREQUENCY      - # of partial collections between
+ *                                   full ones in incremental mode.
+ *   GAUCHE_GC_INITIAL_HEAP_SIZE   - The heap is expanded to this size
+ *                                   at startup, so that a program that
+ *                                   needs a large heap won't grow it
+ *                                   bit by bit.  Suffix k, m or g can
+ *                                   be used.
+ *
+ *  The huge page mode should be set before GC allocates the initial heap,
+ *  so it is taken from GAUCHE_GC_HUGE_PAGES in Scm_GCPreInit:
+ *  "thp" asks for transparent huge pages, "hugetlb" tries the reserved
+ *  huge pages first, and "0" or "none" turns it off.
+ */
+
+static int gc_incremental = FALSE;
+
+static int gc_huge_pages_mode(const char *v)
+{
+    if (strcmp(v, "thp") == 0) return GC_HUGE_PAGES_ADVISE;
+    if (strcmp(v, "hugetlb") == 0) return GC_HUGE_PAGES_HUGETLB;
+    return GC_HUGE_PAGES_NONE;
+}
+
+void Scm_GCPreInit(void)
+{
+#if !defined(GAUCHE_WINDOWS)
+    const char *m = getenv("GAUCHE_GC_MARKERS");
+    if (m != NULL && m[0] != '\0') setenv("GC_MARKERS", m, FALSE);
+#endif /*!GAUCHE_WINDOWS*/
+    const char *h = getenv("GAUCHE_GC_HUGE_PAGES");
+#if defined(GAUCHE_GC_HUGE_PAGES_DEFAULT)
+    if (h == NULL) h = GAUCHE_GC_HUGE_PAGES_DEFAULT;
+#endif
+    if (h != NULL) GC_set_huge_pages(gc_huge_pages_mode(h));
+}
+
+static long gc_env_long(const char *name)
+{
+    const char *v = getenv(name);
+    if (v == NULL || v[0] == '\0') return -1;
+    char *ep;
+    long r = strtol(v, &ep, 10);
+    /* We're called before ports are initialized, so we silently
+       ignore invalid values. */
+    if (*ep != '\0' || r < 0) return -1;
+    return r;
+}
+
+/* Parses a byte size, which may have a suffix k, m or g.  Returns -1
+   if V is unset or invalid. */
+static long gc_env_size(const char *v)
+{
+    if (v == NULL || v[0] == '\0') return -1;
+    char *ep;
+    long r = strtol(v, &ep, 10);
+    if (r < 0) return -1;
+    switch (*ep) {
+    case 'k': case 'K': r <<= 10; ep++; break;
+    case 'm': case 'M': r <<= 20; ep++; break;
+    case 'g': case 'G': r <<= 30; ep++; break;
+    }
+    if (*ep != '\0') return -1;
+    return r;
+}
+
+static void gc_enable_incremental(void)
+{
+    if (!gc_incremental) {
+        GC_enable_incremental();
+        gc_incremental = TRUE;
+    }
+}
+
+static void *gc_set_time_limit(void *data)
+{
+    GC_set_time_limit(*(unsigned long*)data);
+    return NULL;
+}
+
+static void *gc_set_full_freq(void *data)
+{
+    GC_set_full_freq(*(int*)data);
+    return NULL;
+}
+
+static void *gc_get_params(void *data)
+{
+    long *r = (long*)data;
+    r[0] = (long)GC_get_time_limit();
+    r[1] = (long)GC_get_full_freq();
+    return NULL;
+}
+
+static void gc_setup_from_env(void)
+{
+    const char *inc = getenv("GAUCHE_GC_INCREMENTAL");
+#if defined(GAUCHE_GC_INCREMENTAL_DEFAULT)
+    if (inc == NULL) inc = "1";
+#endif
+    if (getenv("GC_ENABLE_INCREMENTAL") != NULL) gc_incremental = TRUE;
+    if (inc != NULL && inc[0] != '\0' && strcmp(inc, "0") != 0) {
+        gc_enable_incremental();
+    }
+
+    long v;
+    if ((v = gc_env_long("GAUCHE_GC_FREE_SPACE_DIVISOR")) > 0) {
+        GC_set_free_space_divisor((GC_word)v);
+    }
+    if ((v = gc_env_long("GAUCHE_GC_MAX_PAUSE")) >= 0) {
+        unsigned long t = (unsigned long)v;
+        GC_call_with_alloc_lock(gc_set_time_limit, &t);
+    }
+    if ((v = gc_env_long("GAUCHE_GC_FULL_FREQUENCY")) >= 0) {
+        int f = (int)v;
+        GC_call_with_alloc_lock(gc_set_full_freq, &f);
+    }
+
+    const char *hs = getenv("GAUCHE_GC_INITIAL_HEAP_SIZE");
+#if defined(GAUCHE_GC_INITIAL_HEAP_SIZE_DEFAULT)
+    if (hs == NULL) hs = GAUCHE_GC_INITIAL_HEAP_SIZE_DEFAULT;
+#endif
+    if ((v = gc_env_size(hs)) > 0) {
+        size_t cur = GC_get_heap_size();
+        /* If the heap can't be expanded, we just go on with the
+           ordinary growth. */
+        if ((size_t)v > cur) (void)GC_expand_hp((size_t)v - cur);
+    }
+}
+
+ScmObj Scm_GCConfiguration(void)
+{
+    long params[2];
+    int markers = 1;
+#if defined(GC_THREADS)
+    markers = GC_get_parallel() + 1;
+#endif
+    GC_call_with_alloc_lock(gc_get_params, params);
+    ScmObj maxpause = (params[0] == GC_TIME_UNLIMITED
+                       ? SCM_FALSE : Scm_MakeInteger(params[0]));
+    ScmObj hugepages = SCM_FALSE;
+    switch (GC_get_huge_pages()) {
+    case GC_HUGE_PAGES_ADVISE:  hugepages = SCM_INTERN("thp"); break;
+    case GC_HUGE_PAGES_HUGETLB: hugepages = SCM_INTERN("hugetlb"); break;
+    }
+    return Scm_List(SCM_LIST2(SCM_MAKE_KEYWORD("markers"),
+                              Scm_MakeInteger(markers)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("incremental"),
+                              SCM_MAKE_BOOL(gc_incremental)),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("free-space-divisor"),
+                              Scm_MakeIntegerU(GC_get_free_space_divisor())),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("max-pause"), maxpause),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("full-frequency"),
+                              Scm_MakeInteger(params[1])),
+                    SCM_LIST2(SCM_MAKE_KEYWORD("huge-pages"), hugepages),
+                    NULL);
+}
+
+void Scm_GCConfigure(ScmObj key, ScmObj value)
+{
+    if (SCM_EQ(key, SCM_MAKE_KEYWORD("incremental"))) {
+        if (!SCM_FALSEP(value)) {
+            gc_enable_incremental();
+        } else if (gc_incremental) {
+            Scm_Error("incremental GC can't be turned off once enabled");
+        }
+    } else if (SCM_EQ(key, SCM_MAKE_KEYWORD("free-space-divisor"))) {
+        u_long d = Scm_GetIntegerUClamp(value, SCM_CLAMP_HI, NULL);
+        if (d == 0) {
+            Scm_Error("free-space-divisor must be a positive integer, "
+                      "but got %S", value);
+        }
+        GC_set_free_space_divisor((GC_word)d);
+    } else if (SCM_EQ(key, SCM_MAKE_KEYWORD("max-pause"))) {
+        unsigned long t = GC_TIME_UNLIMITED;
+        if (!SCM_FALSEP(value)) {
+            t = Scm_GetIntegerUClamp(value, SCM_CLAMP_HI, NULL);
+            if (t > GC_TIME_UNLIMITED) t = GC_TIME_UNLIMITED;
+        }
+        GC_call_with_alloc_lock(gc_set_time_limit, &t);
+    } else if (SCM_EQ(key, SCM_MAKE_KEYWORD("full-frequency"))) {
+        int f = Scm_GetIntegerClamp(value, SCM_CLAMP_BOTH, NULL);
+        if (f < 0) {
+            Scm_Error("full-frequency must be a nonnegative integer, "
+                      "but got %S", value);
+        }
+        GC_call_with_alloc_lock(gc_set_full_freq, &f);
+    } else if (SCM_EQ(key, SCM_MAKE_KEYWORD("huge-pages"))) {
+        int mode = GC_HUGE_PAGES_NONE;
+        if (SCM_SYMBOLP(value)) {
+            mode = gc_huge_pages_mode(Scm_GetStringConst(SCM_SYMBOL_NAME(value)));
+        }
+        if (mode == GC_HUGE_PAGES_NONE && !SCM_FALSEP(value)) {
+            Scm_Error("huge-pages must be #f, thp or hugetlb, but got %S",
+                      value);
+        }
+        GC_set_huge_pages(mode);
+    } else if (SCM_EQ(key, SCM_MAKE_KEYWORD("markers"))) {
+        Scm_Error("the number of GC markers can only be set at startup "
+                  "via GAUCHE_GC_MARKERS");
+    } else {
+        Scm_Error("unknown GC parameter: %S", key);
+    }
+}
+
 /*=============================================================
  * Program cleanup & termination
  */
@@ -90,6 +90,7 @@
 #endif
 #endif /* LIBGAUCHE_BODY */ 
 #include <gc.h>
+#include <gc_tiny_fl.h>         /* for GC_TINY_FREELISTS in ScmVM */
 
 #ifndef SCM_DECL_BEGIN
 #ifdef __cplusplus
@@ -470,8 +471,39 @@ typedef struct ScmInstanceRec {
 #define SCM_INSTANCE_SLOTS(obj)  (SCM_INSTANCE(obj)->slots)
 
 /* Fundamental allocators */
-#define SCM_MALLOC(size)          GC_MALLOC(size)
-#define SCM_MALLOC_ATOMIC(size)   GC_MALLOC_ATOMIC(size)
+
+/* While the allocation sampler is running or allocations are counted
+   (see prof.c), allocations go through Scm__AllocSample.  KIND tells
+   what is allocated, so that allocations of frequently created objects
+   can be told apart. */
+enum {
+    SCM_ALLOC_OTHER,
+    SCM_ALLOC_PAIR,
+    SCM_ALLOC_STRING,
+    SCM_ALLOC_FLONUM,
+    SCM_ALLOC_VECTOR,
+    SCM_ALLOC_CLOSURE,
+    SCM_ALLOC_NUM_KINDS
+};
+
+/* Bits of Scm__AllocHookFlags */
+enum {
+    SCM_ALLOC_HOOK_SAMPLE = 1,  /* allocation sampler is running */
+    SCM_ALLOC_HOOK_COUNT = 2    /* count bytes allocated per VM */
+};
+
+SCM_EXTERN volatile int Scm__AllocHookFlags;
+SCM_EXTERN void *Scm__AllocSample(size_t size, int atomic, int kind);
+
+#define SCM_MALLOC_KIND(size, kind)                                     \
+    (Scm__AllocHookFlags                                                \
+     ? Scm__AllocSample(size, FALSE, kind) : GC_MALLOC(size))
+#define SCM_MALLOC_ATOMIC_KIND(size, kind)                              \
+    (Scm__AllocHookFlags                                                \
+     ? Scm__AllocSample(size, TRUE, kind) : GC_MALLOC_ATOMIC(size))
+
+#define SCM_MALLOC(size)          SCM_MALLOC_KIND(size, SCM_ALLOC_OTHER)
+#define SCM_MALLOC_ATOMIC(size)   SCM_MALLOC_ATOMIC_KIND(size, SCM_ALLOC_OTHER)
 #define SCM_STRDUP(s)             GC_STRDUP(s)
 #define SCM_STRDUP_PARTIAL(s, n)  Scm_StrdupPartial(s, n)
 
@@ -481,6 +513,7 @@ typedef struct ScmInstanceRec {
 #define SCM_NEW_ATOMIC(type)  ((type*)(SCM_MALLOC_ATOMIC(sizeof(type))))
 #define SCM_NEW_ATOMIC_ARRAY(type, nelts)  ((type*)(SCM_MALLOC_ATOMIC(sizeof(type)*(nelts))))
 #define SCM_NEW_ATOMIC2(type, size) ((type)(SCM_MALLOC_ATOMIC(size)))
+#define SCM_NEW_KIND(type, kind) ((type*)(SCM_MALLOC_KIND(sizeof(type), kind)))
 
 typedef void (*ScmFinalizerProc)(ScmObj z, void *data);
 SCM_EXTERN void Scm_RegisterFinalizer(ScmObj z, ScmFinalizerProc finalizer,
@@ -698,6 +731,8 @@ struct ScmClassRec {
     ScmInternalCond cv;         /* wait on this while a class being updated */
     void   *data;               /* extra data to do nasty trick.  See the note
                                    in class.c */
+    void   *initCache;          /* precomputed info for fast instance
+                                   construction.  See class.c */
 } SCM_ALIGN8;
 
 typedef struct ScmClassStaticSlotSpecRec ScmClassStaticSlotSpec;
@@ -1046,8 +1081,14 @@ struct ScmExtendedPairRec {
 #define SCM_SET_CAR(obj, value) (SCM_CAR(obj) = (value))
 #define SCM_SET_CDR(obj, value) (SCM_CDR(obj) = (value))
 
-#define SCM_EXTENDED_PAIR_P(obj) \
-    (SCM_PAIRP(obj)&&GC_base(obj)&&GC_size(obj)>=sizeof(ScmExtendedPair))
+/* Some lists are allocated as a block of consecutive pairs (see
+   list.c).  Such a block has at least SCM_PAIR_BLOCK_MIN pairs, so
+   it is never taken as an extended pair. */
+#define SCM_PAIR_BLOCK_MIN 3
+#define SCM_EXTENDED_PAIR_P(obj)                                \
+    (SCM_PAIRP(obj)&&GC_base(obj)==(void*)(obj)                 \
+     &&GC_size(obj)>=sizeof(ScmExtendedPair)                    \
+     &&GC_size(obj)<SCM_PAIR_BLOCK_MIN*sizeof(ScmPair))
 #define SCM_EXTENDED_PAIR(obj)  ((ScmExtendedPair*)(obj))
 
 
@@ -1463,6 +1504,7 @@ struct ScmGenericRec {
     ScmObj (*fallback)(ScmObj *argv, int argc, ScmGeneric *gf);
     void *data;
     ScmInternalMutex lock;
+    void *cache;                /* dispatch cache (class.c) */
 };
 
 SCM_CLASS_DECL(Scm_GenericClass);
@@ -1626,6 +1668,7 @@ SCM_CLASS_DECL(Scm_LazyPairClass);
 
 SCM_EXTERN ScmObj Scm_MakeLazyPair(ScmObj item, ScmObj generator);
 SCM_EXTERN int    Scm_DecomposeLazyPair(ScmObj obj, ScmObj *item, ScmObj *generator);
+SCM_EXTERN ScmObj Scm_ChunkToLazySeq(ScmObj chunk, ScmObj chunkgen);
 SCM_EXTERN ScmObj Scm_ForceLazyPair(volatile ScmLazyPair *lp);
 SCM_EXTERN int Scm_PairP(ScmObj x);
 
@@ -1722,6 +1765,11 @@ SCM_EXTERN ScmObj Scm_RegComp(ScmString *pattern, int flags);
 SCM_EXTERN ScmObj Scm_RegCompFromAST(ScmObj ast);
 SCM_EXTERN ScmObj Scm_RegOptimizeAST(ScmObj ast);
 SCM_EXTERN ScmObj Scm_RegExec(ScmRegexp *rx, ScmString *input);
+SCM_EXTERN int    Scm_RegMatchP(ScmRegexp *rx, ScmString *input);
+SCM_EXTERN ScmObj Scm_RegMatchPositions(ScmRegexp *rx, ScmString *input,
+                                        ScmUVector *v);
+SCM_EXTERN ScmObj Scm_RegSearchPort(ScmRegexp *rx, ScmPort *port,
+                                    ScmObj proc);
 SCM_EXTERN void Scm_RegDump(ScmRegexp *rx);
 
 SCM_CLASS_DECL(Scm_RegMatchClass);
@@ -1736,6 +1784,19 @@ SCM_EXTERN ScmObj Scm_RegMatchAfter(ScmRegMatch *rm, ScmObj obj);
 SCM_EXTERN ScmObj Scm_RegMatchBefore(ScmRegMatch *rm, ScmObj obj);
 SCM_EXTERN void Scm_RegMatchDump(ScmRegMatch *match);
 
+/* Regexp set tells which of the regexps match a string, scanning it
+   once.  The structure is hidden in regexp.c. */
+typedef struct ScmRegexpSetRec ScmRegexpSet;
+
+SCM_CLASS_DECL(Scm_RegexpSetClass);
+#define SCM_CLASS_REGEXP_SET      (&Scm_RegexpSetClass)
+#define SCM_REGEXP_SET(obj)       ((ScmRegexpSet*)obj)
+#define SCM_REGEXP_SETP(obj)      SCM_XTYPEP(obj, SCM_CLASS_REGEXP_SET)
+
+SCM_EXTERN ScmObj Scm_MakeRegexpSet(ScmObj regexps);
+SCM_EXTERN ScmObj Scm_RegexpSetRegexps(ScmRegexpSet *set);
+SCM_EXTERN ScmObj Scm_RegexpSetMatches(ScmRegexpSet *set, ScmString *input);
+
 /*-------------------------------------------------------
  * STUB MACROS
  */
@@ -1774,6 +1835,8 @@ SCM_EXTERN ScmObj Scm_SysSigmask(int how, ScmSysSigset *newmask);
 SCM_EXTERN ScmObj Scm_Pause(void);
 SCM_EXTERN ScmObj Scm_SigSuspend(ScmSysSigset *mask);
 SCM_EXTERN int    Scm_SigWait(ScmSysSigset *mask);
+SCM_EXTERN int    Scm_SignalNotificationFd(void);
+SCM_EXTERN ScmObj Scm_SignalNotificationDrain(void);
 SCM_EXTERN sigset_t Scm_GetMasterSigmask(void);
 SCM_EXTERN void   Scm_SetMasterSigmask(sigset_t *set);
 SCM_EXTERN ScmObj Scm_SignalName(int signum);
@@ -1809,7 +1872,9 @@ SCM_EXTERN void   Scm_ProfilerReset(void);
 /* Program start and termination */
 
 SCM_EXTERN void Scm_Init(const char *signature);
+SCM_EXTERN void Scm_GCPreInit(void);
 SCM_EXTERN int  Scm_InitializedP(void);
+SCM_EXTERN void Scm__PrintInitTimes(ScmPort *out); /* private */
 SCM_EXTERN void Scm_Cleanup(void);
 SCM_EXTERN void Scm_Exit(int code) SCM_NORETURN;
 SCM_EXTERN void Scm_Abort(const char *msg) SCM_NORETURN;
@@ -1825,6 +1890,30 @@ SCM_EXTERN void Scm_RegisterDL(void *data_start, void *data_end,
                                void *bss_start, void *bss_end);
 SCM_EXTERN void Scm_GCSentinel(void *obj, const char *name);
 
+/* GC telemetry.  A record is made for each collection. */
+typedef struct ScmGCEventRec {
+    u_long gcNo;                /* collection number */
+    long wallTime;              /* pause time in microseconds */
+    long cpuTime;               /* process cpu time spent, in microseconds */
+    u_long heapBefore;          /* bytes in use before collection */
+    u_long heapAfter;           /* bytes in use after collection */
+    u_long reclaimed;           /* bytes reclaimed */
+    u_long finalizersRun;       /* # of finalizers run after collection */
+} ScmGCEvent;
+
+/* C callback, called right after each collection with the GC lock
+   held.  It must not allocate nor call Scheme code. */
+typedef void (*ScmGCEventCallback)(const ScmGCEvent *ev, void *data);
+SCM_EXTERN void   Scm_SetGCEventCallback(ScmGCEventCallback cb, void *data);
+SCM_EXTERN void   Scm_SetGCEventHandler(ScmObj handler);
+SCM_EXTERN ScmObj Scm_GCEventStat(void);
+SCM_EXTERN ScmObj Scm_GCPauseHistogram(void);
+SCM_EXTERN ScmObj Scm_GCRecentEvents(void);
+
+/* GC tuning */
+SCM_EXTERN ScmObj Scm_GCConfiguration(void);
+SCM_EXTERN void   Scm_GCConfigure(ScmObj key, ScmObj value);
+
 SCM_EXTERN ScmObj Scm_GetFeatures(void);
 SCM_EXTERN void   Scm_AddFeature(const char *feature, const char *mod);
 
@@ -86,6 +86,8 @@ SCM_EXTERN ScmObj Scm_BignumAsh(const ScmBignum *bx, int cnt);
 SCM_EXTERN ScmBignum *Scm_MakeBignumWithSize(int size, u_long init);
 SCM_EXTERN ScmBignum *Scm_BignumAccMultAddUI(ScmBignum *acc,
                                              u_long coef, u_long c);
+SCM_EXTERN ScmBignum *Scm_BignumAccAdd(ScmBignum *acc, const ScmBignum *x);
+SCM_EXTERN ScmBignum *Scm_BignumAccAddSI(ScmBignum *acc, long y);
 
 SCM_EXTERN int Scm_DumpBignum(const ScmBignum *b, ScmPort *out);
 
@@ -46,14 +46,24 @@
  * the following entries:
  *   #x3040 => #x30ff, #x4e00 => #x9fbf.
  * Lookup is trivial using Scm_TreeCoreClosestEntries.
+ *
+ * A char-set that is searched many times also gets a multi-level
+ * bitmap of large chars (lookup), so that the membership test doesn't
+ * need a tree search.  It is built on demand by Scm_CharSetCompile,
+ * and discarded when the char-set is modified.  See char.c for the
+ * details.
  */
 
 #define SCM_CHAR_SET_SMALL_CHARS 128
 
+typedef struct ScmCharSetLookupRec ScmCharSetLookup;
+
 struct ScmCharSetRec {
     SCM_HEADER;
     ScmBits small[SCM_BITS_NUM_WORDS(SCM_CHAR_SET_SMALL_CHARS)];
     ScmTreeCore large;
+    ScmCharSetLookup *lookup;   /* bitmap of large chars, or NULL */
+    u_int lookupCount;          /* # of tree searches w/o lookup */
 };
 
 SCM_CLASS_DECL(Scm_CharSetClass);
@@ -83,6 +93,7 @@ SCM_EXTERN ScmObj Scm_CharSetRead(ScmPort *input, int *complement_p,
                                   int error_p, int bracket_syntax);
 
 SCM_EXTERN int    Scm_CharSetContains(ScmCharSet *cs, ScmChar c);
+SCM_EXTERN void   Scm_CharSetCompile(ScmCharSet *cs);
 SCM_EXTERN void   Scm_CharSetDump(ScmCharSet *cs, ScmPort *port);
 
 /* predefined character set API */
@@ -131,6 +131,7 @@ SCM_CLASS_DECL(Scm_AccessorMethodClass);
 
 SCM_EXTERN ScmObj Scm_Allocate(ScmClass *klass, ScmObj initargs);
 SCM_EXTERN ScmObj Scm_NewInstance(ScmClass *klass, int coresize);
+SCM_EXTERN ScmObj Scm__MakeInstanceFast(ScmClass *klass, ScmObj initargs);
 SCM_EXTERN ScmObj Scm__AllocateAndInitializeInstance(ScmClass *klass,
                                                      ScmObj *inits,
                                                      int numInits,
@@ -144,6 +145,9 @@ SCM_EXTERN ScmObj Scm_ComputeApplicableMethods(ScmGeneric *gf,
                                                int argc,
                                                int applyargs);
 SCM_EXTERN ScmObj Scm_SortMethods(ScmObj methods, ScmObj *argv, int argc);
+SCM_EXTERN ScmObj Scm__ComputeSortedApplicableMethods(ScmGeneric *gf,
+                                                      ScmObj *argv,
+                                                      int argc);
 SCM_EXTERN ScmObj Scm_MakeNextMethod(ScmGeneric *gf, ScmObj methods,
                                      ScmObj *argv, int argc,
                                      int copyargs, int applyargs);
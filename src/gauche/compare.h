@@ -78,13 +78,27 @@ struct ScmComparatorRec {
 
    SCM_COMPARATOR_SRFI_128 - Indicates this is srfi-128-style comparator,
      so using orderFn is preferred to compareFn.
+
+   SCM_COMPARATOR_BUILTIN_COMPARE - The comparison procedure is the
+     builtin `compare', so we can call Scm_Compare directly.
+
+   SCM_COMPARATOR_EQUIV_* - The equality predicate is one of the builtin
+     eq?, eqv?, equal? or string=?.  Hash tables use the corresponding
+     builtin hash function and comparison, instead of calling the
+     comparator's procedures.
 */
 enum ScmComparatorFlags {
     SCM_COMPARATOR_NO_ORDER = (1L<<0), /* 'compare' proc unavailable */
     SCM_COMPARATOR_NO_HASH  = (1L<<1), /* 'hash' proc unavailable */
     SCM_COMPARATOR_ANY_TYPE = (1L<<2), /* type-test always returns #t */
     SCM_COMPARATOR_USE_COMPARISON = (1L<<3), /* equality use comarison */
-    SCM_COMPARATOR_SRFI_128 = (1L<<4)  /* srfi-128 style comparator */
+    SCM_COMPARATOR_SRFI_128 = (1L<<4), /* srfi-128 style comparator */
+    SCM_COMPARATOR_BUILTIN_COMPARE = (1L<<5), /* compareFn is `compare' */
+    SCM_COMPARATOR_EQUIV_EQ     = (1L<<6), /* eqFn is eq? */
+    SCM_COMPARATOR_EQUIV_EQV    = (2L<<6), /* eqFn is eqv? */
+    SCM_COMPARATOR_EQUIV_EQUAL  = (3L<<6), /* eqFn is equal? */
+    SCM_COMPARATOR_EQUIV_STRING = (4L<<6), /* eqFn is string=? */
+    SCM_COMPARATOR_EQUIV_MASK   = (7L<<6)
 };
 
 SCM_CLASS_DECL(Scm_ComparatorClass);
@@ -104,6 +118,24 @@ SCM_EXTERN int    Scm_Compare(ScmObj x, ScmObj y);
 SCM_EXTERN void   Scm_SortArray(ScmObj *elts, int nelts, ScmObj cmpfn);
 SCM_EXTERN ScmObj Scm_SortList(ScmObj objs, ScmObj fn);
 SCM_EXTERN ScmObj Scm_SortListX(ScmObj objs, ScmObj fn);
+SCM_EXTERN void   Scm_SortArrayByKeys(ScmObj *elts, ScmObj *keys,
+                                     ScmSmallInt nelts);
+SCM_EXTERN void   Scm_UVectorSort(ScmUVector *v, ScmSmallInt start,
+                                 ScmSmallInt end);
+SCM_EXTERN ScmSmallInt Scm_UVectorMergeSplit(ScmUVector *src,
+                                         ScmSmallInt a0, ScmSmallInt a1,
+                                         ScmSmallInt b0, ScmSmallInt b1,
+                                         ScmSmallInt k);
+SCM_EXTERN void   Scm_UVectorMerge(ScmUVector *dst, ScmSmallInt d,
+                                  ScmUVector *src,
+                                  ScmSmallInt a0, ScmSmallInt a1,
+                                  ScmSmallInt b0, ScmSmallInt b1);
+SCM_EXTERN ScmSmallInt Scm_MergeSplitByKeys(ScmObj *akeys, ScmSmallInt na,
+                                        ScmObj *bkeys, ScmSmallInt nb,
+                                        ScmSmallInt k);
+SCM_EXTERN void   Scm_MergeByKeys(ScmObj *dst, ScmObj *dkeys,
+                                 ScmObj *a, ScmObj *akeys, ScmSmallInt na,
+                                 ScmObj *b, ScmObj *bkeys, ScmSmallInt nb);
 
 
 SCM_DECL_END
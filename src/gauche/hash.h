@@ -98,6 +98,11 @@ SCM_EXTERN ScmDictEntry *Scm_HashCoreSearch(ScmHashCore *core,
 SCM_EXTERN int  Scm_HashCoreNumEntries(ScmHashCore *core);
 
 SCM_EXTERN void Scm_HashCoreClear(ScmHashCore *core);
+SCM_EXTERN void Scm_HashCoreReserve(ScmHashCore *core, int numEntries);
+SCM_EXTERN void Scm_HashCoreCompact(ScmHashCore *core);
+SCM_EXTERN int  Scm_HashCoreSweep(ScmHashCore *core,
+                                  int (*deadp)(ScmDictEntry*, void*),
+                                  void *data, int *cursor, int nbuckets);
 
 struct ScmHashIterRec {
     ScmHashCore *core;
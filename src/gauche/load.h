@@ -95,6 +95,9 @@ SCM_EXTERN ScmObj Scm_GetLoadPath(void);
 SCM_EXTERN ScmObj Scm_AddLoadPath(const char *cpath, int afterp);
 SCM_EXTERN void   Scm_AddLoadPathHook(ScmObj proc, int afterp);
 SCM_EXTERN void   Scm_DeleteLoadPathHook(ScmObj proc);
+SCM_EXTERN ScmObj Scm__FindFileInDirectory(ScmString *dir,
+                                           ScmString *filename,
+                                           ScmObj suffixes);
 
 /*=================================================================
  * Dynamic Loading
@@ -134,7 +137,7 @@ struct ScmAutoloadRec {
                                    the autoload object is created, and never
                                    be modified. */
 
-    int loaded;                 /* The flag that indicates this autoload
+    volatile ScmWord loaded;    /* The flag that indicates this autoload
                                    is resolved, and value field contains
                                    the resolved value.  Once the autoload
                                    goes into "loaded" status, no field
@@ -142,7 +145,8 @@ struct ScmAutoloadRec {
     ScmObj value;               /* The resolved value */
     ScmInternalMutex mutex;     /* mutex to resolve this autoload */
     ScmInternalCond cv;         /* ... and condition variable. */
-    ScmVM *locker;              /* The thread that is resolving the autoload.*/
+    ScmVM *volatile locker;     /* The thread that is resolving the autoload.
+                                   Set by CAS; see Scm_ResolveAutoload. */
 };
 
 SCM_CLASS_DECL(Scm_AutoloadClass);
@@ -69,6 +69,9 @@ struct ScmModuleRec {
     ScmObj info;                /* alist of metainfo; e.g.
                                    (source-info . <string>) */
     int    sealed;              /* if true, no modification is allowed */
+    ScmHashTable *lookupCache;  /* Symbol -> GLoc or #f; caches the results
+                                   of global binding search.  see module.c */
+    u_long lookupCacheGen;      /* binding generation the cache is valid */
 };
 
 #define SCM_MODULE(obj)       ((ScmModule*)(obj))
@@ -274,6 +274,7 @@ SCM_EXTERN ScmObj Scm_ExactToInexact(ScmObj obj);
 #define Scm_Inexact  Scm_ExactToInexact
 
 SCM_EXTERN ScmObj Scm_Add(ScmObj arg1, ScmObj arg2);
+SCM_EXTERN ScmObj Scm_AddList(ScmObj args);
 SCM_EXTERN ScmObj Scm_Sub(ScmObj arg1, ScmObj arg2);
 SCM_EXTERN ScmObj Scm_Mul(ScmObj arg1, ScmObj arg2);
 SCM_EXTERN ScmObj Scm_Div(ScmObj arg1, ScmObj arg2);
@@ -59,6 +59,8 @@ SCM_EXTERN void Scm_InitParameterLoc(ScmVM *vm, ScmParameterLoc *location, ScmOb
 SCM_EXTERN ScmObj Scm_ParameterRef(ScmVM *vm, const ScmParameterLoc *location);
 SCM_EXTERN ScmObj Scm_ParameterSet(ScmVM *vm, const ScmParameterLoc *location,
                                    ScmObj value);
+SCM_EXTERN ScmObj Scm_VMParameterize(int num, const ScmParameterLoc *locations,
+                                     const ScmObj *values, ScmObj thunk);
 
 /* A "primitive parameter" is a mere SUBR that acts like parameter
    (except it doesn't have filters and hooks). */
@@ -78,7 +78,7 @@ typedef struct ScmPortBufferRec {
     char *current;      /* current buffer position */
     char *end;          /* the end of the current valid data */
     int  size;          /* buffer size */
-    int  mode;          /* buffering mode (ScmPortBufferMode) & SIGPIPE flag */
+    int  mode;          /* buffering mode (ScmPortBufferMode) & flags */
     int  (*filler)(ScmPort *p, int min);
     int  (*flusher)(ScmPort *p, int cnt, int forcep);
     void (*closer)(ScmPort *p);
@@ -201,6 +201,13 @@ enum ScmPortBufferMode {
    this flag is ignored, for we don't have SIGPIPE.  */
 #define SCM_PORT_BUFFER_SIGPIPE_SENSITIVE  (1L<<8)
 
+/* If this flag is set in `mode' member of ScmPortBuffer, the underlying
+   file descriptor is in non-blocking mode.  Instead of waiting, an
+   operation that can't proceed raises an error with EAGAIN, or returns
+   what it could do by then if the API allows a partial result.
+   Use Scm_SetPortNonblocking to change it.  */
+#define SCM_PORT_BUFFER_NONBLOCKING        (1L<<9)
+
 /* Port types.  The type is also represented by a port's class, but
    C routine can dispatch quicker using these flags.  User code
    doesn't need to care about these. */
@@ -227,8 +234,10 @@ enum ScmPortFlags {
                                    of two-pass writing. */
     SCM_PORT_PRIVATE = (1L<<2), /* this port is for 'private' use within
                                    a thread, so never need to be locked. */
-    SCM_PORT_CASE_FOLD = (1L<<3) /* read from or write to this port should
+    SCM_PORT_CASE_FOLD = (1L<<3), /* read from or write to this port should
                                     be case folding. */
+    SCM_PORT_MMAP = (1L<<4)     /* input string port reading a mmap'ed
+                                   file.  See Scm_OpenMmapFilePort. */
 };
 
 #if 0 /* not implemented */
@@ -309,6 +318,8 @@ SCM_EXTERN int    Scm_GetPortBufferingMode(ScmPort *port);
 SCM_EXTERN void   Scm_SetPortBufferingMode(ScmPort *port, int mode);
 SCM_EXTERN int    Scm_GetPortBufferSigpipeSensitive(ScmPort *port);
 SCM_EXTERN void   Scm_SetPortBufferSigpipeSensitive(ScmPort *port, int sensitive);
+SCM_EXTERN int    Scm_GetPortNonblocking(ScmPort *port);
+SCM_EXTERN void   Scm_SetPortNonblocking(ScmPort *port, int nonblocking);
 SCM_EXTERN int    Scm_GetPortCaseFolding(ScmPort *port);
 SCM_EXTERN void   Scm_SetPortCaseFolding(ScmPort *port, int flag);
 SCM_EXTERN ScmObj Scm_GetPortReaderLexicalMode(ScmPort *port);
@@ -322,6 +333,9 @@ SCM_EXTERN ScmObj Scm_PortSeek(ScmPort *port, ScmObj off, int whence);
 SCM_EXTERN ScmObj Scm_PortSeekUnsafe(ScmPort *port, ScmObj off, int whence);
 SCM_EXTERN int    Scm_PortFileNo(ScmPort *port);
 SCM_EXTERN void   Scm_PortFdDup(ScmPort *dst, ScmPort *src);
+SCM_EXTERN ScmSmallInt Scm_PortCopyFd(ScmPort *src, ScmPort *dst,
+                                      ScmSmallInt limit);
+SCM_EXTERN ScmObj Scm_ReadBlockView(ScmPort *port, ScmSmallInt max);
 SCM_EXTERN int    Scm_FdReady(int fd, int dir);
 SCM_EXTERN int    Scm_ByteReady(ScmPort *port);
 SCM_EXTERN int    Scm_ByteReadyUnsafe(ScmPort *port);
@@ -356,6 +370,9 @@ SCM_EXTERN void   Scm_PutbUnsafe(ScmByte b, ScmPort *port);
 SCM_EXTERN void   Scm_PutcUnsafe(ScmChar c, ScmPort *port);
 SCM_EXTERN void   Scm_PutsUnsafe(ScmString *s, ScmPort *port);
 SCM_EXTERN void   Scm_PutzUnsafe(const char *s, int len, ScmPort *port);
+SCM_EXTERN void   Scm_WriteGather(ScmObj items, ScmPort *port);
+SCM_EXTERN int    Scm_PutzNonblocking(const char *s, int siz, int unit,
+                                      ScmPort *port);
 SCM_EXTERN void   Scm_FlushUnsafe(ScmPort *port);
 
 SCM_EXTERN void   Scm_Ungetc(ScmChar ch, ScmPort *port);
@@ -397,6 +414,18 @@ SCM_EXTERN ScmObj Scm_WithPort(ScmPort *port[], ScmObj thunk,
 SCM_EXTERN ScmObj Scm_OpenFilePort(const char *path, int flags,
                                    int buffering, int perm);
 
+/* Access pattern hints for Scm_OpenFilePortWithHints */
+enum ScmPortAccessPattern {
+    SCM_PORT_ACCESS_NORMAL,
+    SCM_PORT_ACCESS_SEQUENTIAL,
+    SCM_PORT_ACCESS_RANDOM
+};
+
+SCM_EXTERN ScmObj Scm_OpenFilePortWithHints(const char *path, int flags,
+                                            int buffering, int perm,
+                                            int bufsiz, int access);
+SCM_EXTERN ScmObj Scm_OpenMmapFilePort(const char *path);
+
 SCM_EXTERN ScmObj Scm_Stdin(void);
 SCM_EXTERN ScmObj Scm_Stdout(void);
 SCM_EXTERN ScmObj Scm_Stderr(void);
@@ -422,6 +451,7 @@ SCM_EXTERN ScmObj Scm_MakeOutputStringPort(int privatep);
 
 SCM_EXTERN ScmObj Scm_GetOutputString(ScmPort *port, int flags);
 SCM_EXTERN ScmObj Scm_GetOutputStringUnsafe(ScmPort *port, int flags);
+SCM_EXTERN ScmObj Scm_TakeOutputString(ScmPort *port, int flags);
 SCM_EXTERN ScmObj Scm_GetRemainingInputString(ScmPort *port, int flags);
 
 /*================================================================
@@ -80,15 +80,18 @@ void Scm__SetupPortsForWindows(int has_console);
  *  Unlocking the port is a single atomic opertaion, port->lockOwner = NULL,
  *  hence PORT_UNLOCK doesn't need mutex to do that.
  *
- *  To lock the port, the thread needs to grab a system-level lock
- *  (spinlock if available, mutex otherwise) to check the lockOwner
- *  pointer.  If the port is locked, the thread yields CPU and
- *  try again later.
+ *  If the calling thread already owns the port (including the
+ *  'private' ports, which are prelocked by its owner, and the ports
+ *  locked by with-port-locking), locking is just incrementing
+ *  lockCount.  Otherwise, the thread swaps lockOwner from NULL (or
+ *  from a terminated VM) to itself with a single compare-and-swap;
+ *  no system-level lock is involved, so the uncontended case costs
+ *  one atomic instruction.  If the port is locked by another thread,
+ *  the thread yields CPU and try again later.
  *
- *  It is possible that lockOwner slot changes its value to NULL during
- *  a thread is trying to lock the port, since PORT_UNLOCK doesn't obtain
- *  the system-level lock.  If it happens, the thread trying to lock
- *  the port would wait extra timeslice.  Not a big deal.
+ *  (We used to take a system-level lock (port->lock) to check and set
+ *  lockOwner.  The field is kept for binary compatibility, but is no
+ *  longer used.)
  *
  *  Note that we cannot use a condition variable to let the locking thread
  *  wait on it.  If we use CV, unlocking becomes two-step opertaion
@@ -96,21 +99,28 @@ void Scm__SetupPortsForWindows(int has_console);
  *  atomic.  We would need to get system-level lock in PORT_UNLOCK as well.
  */
 
+/* Atomically replace P's lockOwner with N if it is O.  Returns
+   TRUE on success.  Full memory barrier. */
+#if defined(__GNUC__)
+#define PORT_CAS_OWNER(p, o, n) \
+    __sync_bool_compare_and_swap(&(p)->lockOwner, (o), (n))
+#else
+SCM_EXTERN int Scm__PortCASOwner(ScmPort *p, ScmVM *old, ScmVM *new_);
+#define PORT_CAS_OWNER(p, o, n) Scm__PortCASOwner(p, o, n)
+#endif
+
 /* Lock a port P.  Can perform recursive lock. */
 #define PORT_LOCK(p, vm)                                        \
     do {                                                        \
       if (p->lockOwner != vm) {                                 \
           for (;;) {                                            \
-              ScmVM* owner__;                                   \
-              (void)SCM_INTERNAL_FASTLOCK_LOCK(p->lock);        \
-              owner__ = p->lockOwner;                           \
-              if (owner__ == NULL                               \
-                  || (owner__->state == SCM_VM_TERMINATED)) {   \
-                  p->lockOwner = vm;                            \
+              ScmVM* owner__ = p->lockOwner;                    \
+              if ((owner__ == NULL                              \
+                   || (owner__->state == SCM_VM_TERMINATED))    \
+                  && PORT_CAS_OWNER(p, owner__, vm)) {          \
                   p->lockCount = 1;                             \
+                  break;                                        \
               }                                                 \
-              (void)SCM_INTERNAL_FASTLOCK_UNLOCK(p->lock);      \
-              if (p->lockOwner == vm) break;                    \
               Scm_YieldCPU();                                   \
           }                                                     \
       } else {                                                  \
@@ -72,6 +72,24 @@
  *
  * Profile result can only be examined when the profile is in "PAUSING"
  * state.
+ *
+ * Continuous sampler:
+ *
+ * Independently from the above, Scm_ProfilerContinuousStart turns on
+ * sampling for all threads.  Each VM gets a fixed-size ring of stack
+ * samples, so the memory usage is bounded no matter how long it runs;
+ * the oldest samples are overwritten.  Scm_ProfilerSnapshot aggregates
+ * the samples taken since the last snapshot without stopping the sampler.
+ *
+ * Allocation sampler:
+ *
+ * Scm_ProfilerAllocStart makes SCM_MALLOC and its friends go through
+ * Scm__AllocSample, which takes a sample every time the VM allocates
+ * the given number of bytes.  A sample records the kind of the object
+ * (SCM_ALLOC_* in gauche.h) and the code and pc the VM is executing.
+ * Samples are kept in a per-VM ring as the continuous sampler does.
+ * The same hook is used to count the bytes allocated by each VM
+ * (see Scm_VMStatCountAllocation).
  */
 
 /* Profiler status */
@@ -117,8 +135,63 @@ struct ScmVMProfilerRec {
     ScmProfCount  counts[SCM_PROF_COUNTER_IN_BUFFER];
 };
 
+/* A stack sample of the continuous sampler.  frames[0] is the code
+   being executed, followed by its callers.  Unused entries are NULL.
+   pcs[i] is the pc in frames[i] if it is a compiled code, used
+   to look up the source location. */
+#define SCM_PROF_STACK_DEPTH  16
+
+typedef struct ScmProfStackSampleRec {
+    ScmObj frames[SCM_PROF_STACK_DEPTH];
+    SCM_PCTYPE pcs[SCM_PROF_STACK_DEPTH];
+} ScmProfStackSample;
+
+/* # of samples kept per VM by the continuous sampler. */
+#define SCM_PROF_RING_SIZE  512
+
+/* Sample ring of the continuous sampler.  Only the signal handler on the
+   owner thread writes to it.  Samples in [tail, head) haven't been
+   taken by Scm_ProfilerSnapshot yet; if more than SCM_PROF_RING_SIZE
+   samples are accumulated, the older ones are lost. */
+struct ScmProfRingRec {
+    volatile u_long head;       /* total # of samples written */
+    u_long tail;                /* # of samples already consumed */
+    ScmProfStackSample samples[SCM_PROF_RING_SIZE];
+};
+
+/* A sample of the allocation sampler.  WEIGHT is the number of sampling
+   intervals this sample stands for; it can be more than 1 if a large
+   object is allocated. */
+typedef struct ScmAllocSampleRec {
+    ScmObj code;                /* ScmCompiledCode or #f */
+    SCM_PCTYPE pc;
+    int kind;                   /* SCM_ALLOC_* */
+    int weight;
+} ScmAllocSample;
+
+/* # of samples kept per VM by the allocation sampler. */
+#define SCM_PROF_ALLOC_RING_SIZE  1024
+
+struct ScmAllocRingRec {
+    long countdown;             /* bytes to allocate until next sample */
+    u_long head;                /* total # of samples written */
+    u_long tail;                /* # of samples already consumed */
+    ScmAllocSample samples[SCM_PROF_ALLOC_RING_SIZE];
+};
+
 SCM_EXTERN ScmObj Scm_ProfilerRawResult(void);
 
+/* Continuous sampler API */
+SCM_EXTERN void   Scm_ProfilerContinuousStart(void);
+SCM_EXTERN void   Scm_ProfilerContinuousStop(void);
+SCM_EXTERN ScmObj Scm_ProfilerSnapshot(int allThreads);
+SCM_EXTERN void   Scm__ProfilerAttachVM(ScmVM *vm);
+
+/* Allocation sampler API */
+SCM_EXTERN void   Scm_ProfilerAllocStart(long interval);
+SCM_EXTERN void   Scm_ProfilerAllocStop(void);
+SCM_EXTERN ScmObj Scm_ProfilerAllocSnapshot(int allThreads);
+
 /* Call Counter API */
 
 SCM_EXTERN void Scm_ProfilerCountBufferFlush(ScmVM *vm);
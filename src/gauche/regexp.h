@@ -54,6 +54,10 @@ struct ScmRegexpRec {
                             match at the beginning of the regexp.  It can be
                             used to skip input start position when regexp
                             isn't BOL_ANCHORED. */
+    struct ScmRegDFARec *dfa; /* Automata to match without backtracking,
+                            or NULL if the regexp uses backreferences,
+                            lookaround or other features that need
+                            backtracking.  See regexp.c. */
 };
 
 struct ScmRegMatchRec {
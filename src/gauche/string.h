@@ -75,6 +75,9 @@ typedef struct ScmStringBodyRec {
     unsigned int length;
     unsigned int size;
     const char *start;
+    const unsigned int *index;  /* character index -> byte offset table.
+                                   built lazily by string.c for multibyte
+                                   bodies.  may be NULL. */
 } ScmStringBody;
 
 #if SIZEOF_LONG == 4
@@ -161,6 +164,8 @@ SCM_EXTERN ScmObj  Scm_MakeString(const char *str,
                                   int flags);
 SCM_EXTERN ScmObj  Scm_MakeFillString(ScmSmallInt len, ScmChar fill);
 SCM_EXTERN ScmObj  Scm_CopyStringWithFlags(ScmString *str, int flags, int mask);
+SCM_EXTERN ScmObj  Scm_CopyStringDetached(ScmString *str);
+SCM_EXTERN ScmObj  Scm_StringCompact(ScmString *str);
 
 #define SCM_MAKE_STR(cstr) \
     Scm_MakeString(cstr, -1, -1, 0)
@@ -264,6 +269,26 @@ SCM_EXTERN ScmObj  Scm_StringScanChar(ScmString *s1, ScmChar ch, int retmode);
 SCM_EXTERN ScmObj  Scm_StringScanRight(ScmString *s1, ScmString *s2, int retmode);
 SCM_EXTERN ScmObj  Scm_StringScanCharRight(ScmString *s1, ScmChar ch, int retmode);
 
+SCM_EXTERN ScmObj  Scm_StringIndex(ScmString *s, ScmObj cs, int flags);
+SCM_EXTERN ScmObj  Scm_StringTrim(ScmString *s, ScmObj cs, int flags);
+SCM_EXTERN ScmObj  Scm_StringTokenize(ScmString *s, ScmObj cs);
+SCM_EXTERN int     Scm_StringPrefixP(ScmString *s1, ScmString *s2);
+SCM_EXTERN int     Scm_StringSuffixP(ScmString *s1, ScmString *s2);
+SCM_EXTERN ScmObj  Scm_StringContainsCI(ScmString *s1, ScmString *s2);
+
+/* "flags" argument for Scm_StringIndex */
+enum {
+    SCM_STRING_INDEX_RIGHT = (1L<<0), /* search from the end */
+    SCM_STRING_INDEX_SKIP = (1L<<1)   /* find a char that doesn't match */
+};
+
+/* "flags" argument for Scm_StringTrim */
+enum {
+    SCM_STRING_TRIM_LEFT = (1L<<0),
+    SCM_STRING_TRIM_RIGHT = (1L<<1),
+    SCM_STRING_TRIM_BOTH = (SCM_STRING_TRIM_LEFT|SCM_STRING_TRIM_RIGHT)
+};
+
 /* "retmode" argument for string scan */
 enum {
     SCM_STRING_SCAN_INDEX,      /* return index */
@@ -296,7 +321,8 @@ SCM_EXTERN ScmObj  Scm_MaybeSubstring(ScmString *x, ScmObj start, ScmObj end);
 
 #define SCM_STRING_CONST_INITIALIZER(str, len, siz)             \
     { { SCM_CLASS_STATIC_TAG(Scm_StringClass) }, NULL,          \
-      { SCM_STRING_IMMUTABLE|SCM_STRING_TERMINATED, (len), (siz), (str) } }
+      { SCM_STRING_IMMUTABLE|SCM_STRING_TERMINATED, (len), (siz), (str), \
+        NULL } }
 
 #define SCM_DEFINE_STRING_CONST(name, str, len, siz)            \
     ScmString name = SCM_STRING_CONST_INITIALIZER(str, len, siz)
@@ -333,6 +359,7 @@ struct ScmDStringRec {
 SCM_EXTERN void        Scm_DStringInit(ScmDString *dstr);
 SCM_EXTERN int         Scm_DStringSize(ScmDString *dstr);
 SCM_EXTERN ScmObj      Scm_DStringGet(ScmDString *dstr, int flags);
+SCM_EXTERN ScmObj      Scm_DStringTake(ScmDString *dstr, int flags);
 SCM_EXTERN const char *Scm_DStringGetz(ScmDString *dstr);
 SCM_EXTERN const char *Scm_DStringPeek(ScmDString *dstr, int *size, int *len);
 SCM_EXTERN void        Scm_DStringPutz(ScmDString *dstr, const char *str,
@@ -364,6 +391,40 @@ SCM_EXTERN void        Scm_DStringPutc(ScmDString *dstr, ScmChar ch);
 
 SCM_EXTERN void Scm__DStringRealloc(ScmDString *dstr, int min_incr);
 
+/*
+ * String matchers
+ *   Finds the leftmost occurrence of any of a set of strings in one
+ *   pass.  The internal structure is in string.c.
+ */
+typedef struct ScmStringMatcherRec ScmStringMatcher;
+
+SCM_CLASS_DECL(Scm_StringMatcherClass);
+#define SCM_CLASS_STRING_MATCHER  (&Scm_StringMatcherClass)
+#define SCM_STRING_MATCHERP(obj)  SCM_XTYPEP(obj, SCM_CLASS_STRING_MATCHER)
+#define SCM_STRING_MATCHER(obj)   ((ScmStringMatcher*)obj)
+
+SCM_EXTERN ScmObj Scm_MakeStringMatcher(ScmObj strings);
+SCM_EXTERN ScmObj Scm_StringMatcherScan(ScmStringMatcher *m, ScmString *str);
+
+/*
+ * String builders
+ *   A Scheme object wrapping DString, so that Scheme code can build
+ *   a long string piece by piece without copying what is already
+ *   accumulated.
+ */
+typedef struct ScmStringBuilderRec {
+    SCM_HEADER;
+    ScmDString ds;
+} ScmStringBuilder;
+
+SCM_CLASS_DECL(Scm_StringBuilderClass);
+#define SCM_CLASS_STRING_BUILDER  (&Scm_StringBuilderClass)
+#define SCM_STRING_BUILDERP(obj)  SCM_XTYPEP(obj, SCM_CLASS_STRING_BUILDER)
+#define SCM_STRING_BUILDER(obj)   ((ScmStringBuilder*)obj)
+
+SCM_EXTERN ScmObj Scm_MakeStringBuilder(void);
+SCM_EXTERN void   Scm_StringBuilderAdd(ScmStringBuilder *sb, ScmObj obj);
+
 /*
  * Utility.  Returns NUL-terminated string (SRC doesn't need to be
  * NUL-terminated, but must be longer than SIZE).
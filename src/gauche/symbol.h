@@ -67,11 +67,12 @@ typedef enum {
  */
 
 SCM_EXTERN ScmObj Scm_MakeSymbol(ScmString *name, int interned);
+SCM_EXTERN ScmObj Scm_InternCString(const char *str, ScmSmallInt size);
 SCM_EXTERN ScmObj Scm_Gensym(ScmString *prefix);
 SCM_EXTERN ScmObj Scm_SymbolSansPrefix(ScmSymbol *s, ScmSymbol *p);
 
 #define Scm_Intern(name)  Scm_MakeSymbol(name, TRUE)
-#define SCM_INTERN(cstr)  Scm_Intern(SCM_STRING(SCM_MAKE_STR_IMMUTABLE(cstr)))
+#define SCM_INTERN(cstr)  Scm_InternCString(cstr, -1)
 
 SCM_EXTERN void Scm_WriteSymbolName(ScmString *snam, ScmPort *port,
                                     ScmWriteContext *ctx, u_int flags);
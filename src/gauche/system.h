@@ -128,6 +128,7 @@ SCM_EXTERN void Scm_GetTimeOfDay(u_long *sec, u_long *usec);
 SCM_EXTERN long Scm_CurrentMicroseconds();
 SCM_EXTERN int  Scm_ClockGetTimeMonotonic(u_long *sec, u_long *nsec);
 SCM_EXTERN int  Scm_ClockGetResMonotonic(u_long *sec, u_long *nsec);
+SCM_EXTERN int  Scm_ClockGetTimeThreadCPU(u_long *sec, u_long *nsec);
 
 /* Gauche also has a <time> object, as specified in SRFI-18, SRFI-19
  * and SRFI-21.  It can be constructed from the basic system interface
@@ -278,6 +279,64 @@ typedef struct ScmHeaderRec ScmSysFdset;
 #define SCM_SYS_FDSET_P(obj)    (FALSE)
 #endif /*!HAVE_SELECT*/
 
+/* poller - scalable alternative of select, using epoll, kqueue, or
+   an I/O completion port on Windows.
+   An fd is registered with a set of events it waits for, so we don't
+   need to pass the whole fd set for each wait, and we don't have
+   the limit of FD_SETSIZE. */
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE1)
+#define GAUCHE_POLLER_EPOLL 1
+#elif defined(HAVE_SYS_EVENT_H) && defined(HAVE_KQUEUE)
+#define GAUCHE_POLLER_KQUEUE 1
+#elif defined(GAUCHE_WINDOWS)
+#define GAUCHE_POLLER_IOCP 1
+#endif
+
+#if (defined(GAUCHE_POLLER_EPOLL) || defined(GAUCHE_POLLER_KQUEUE) \
+     || defined(GAUCHE_POLLER_IOCP)) \
+    && defined(HAVE_SELECT)
+#define GAUCHE_POLLER 1
+
+#if defined(GAUCHE_POLLER_IOCP)
+/* Windows has no readiness notification that scales, but a socket can
+   be polled asynchronously through the AFD driver and the result is
+   delivered to a completion port.  See system.c for the details. */
+typedef struct ScmSysPollerRec {
+    SCM_HEADER;
+    HANDLE iocp;                /* completion port; NULL if closed */
+    HANDLE afd;                 /* AFD device to issue polls */
+    ScmHashCore regs;           /* fd -> struct ScmSysPollerRegRec* */
+    struct ScmSysPollerRegRec *updates; /* regs to (re)submit polls */
+    struct ScmSysPollerRegRec *zombies; /* deleted, but poll pending */
+    int numAlways;              /* # of regs that are always ready */
+} ScmSysPoller;
+#else  /*!GAUCHE_POLLER_IOCP*/
+typedef struct ScmSysPollerRec {
+    SCM_HEADER;
+    int fd;                     /* epoll or kqueue descriptor; -1 if closed */
+} ScmSysPoller;
+#endif /*!GAUCHE_POLLER_IOCP*/
+
+SCM_CLASS_DECL(Scm_SysPollerClass);
+#define SCM_CLASS_SYS_POLLER    (&Scm_SysPollerClass)
+#define SCM_SYS_POLLER(obj)     ((ScmSysPoller*)(obj))
+#define SCM_SYS_POLLER_P(obj)   (SCM_XTYPEP(obj, SCM_CLASS_SYS_POLLER))
+
+/* Event flags */
+enum {
+    SCM_SYS_POLL_READ   = (1L<<0),
+    SCM_SYS_POLL_WRITE  = (1L<<1),
+    SCM_SYS_POLL_EXCEPT = (1L<<2),
+    SCM_SYS_POLL_EDGE   = (1L<<3)  /* option: edge-triggered */
+};
+
+SCM_EXTERN ScmObj Scm_MakeSysPoller(void);
+SCM_EXTERN void   Scm_SysPollerSet(ScmSysPoller *poller, int fd, int events);
+SCM_EXTERN ScmObj Scm_SysPollerWait(ScmSysPoller *poller, ScmObj timeout,
+                                    int maxevents);
+SCM_EXTERN void   Scm_SysPollerClose(ScmSysPoller *poller);
+#endif /*GAUCHE_POLLER*/
+
 /*==============================================================
  * Miscellaneous
  */
@@ -34,8 +34,13 @@
 /* This file is included from gauche.h */
 
 /*
- * Provides ScmTreeCore, a raw red-black tree implementation,
+ * Provides ScmTreeCore, a raw balanced tree implementation,
  * and ScmTreeMap, ScmObj wrapper of ScmTreeCore.
+ *
+ * ScmTreeCore can be either a red-black tree (default) or a B+-tree.
+ * The latter keeps many entries in a node and links the leaves, so
+ * it is more cache-friendly for large maps, especially for ordered
+ * traversals.  Both share the same API.
  */
 
 #ifndef GAUCHE_TREEMAP_H
@@ -49,13 +54,20 @@ typedef struct ScmTreeCoreRec ScmTreeCore;
 
 typedef int ScmTreeCoreCompareProc(ScmTreeCore*, intptr_t, intptr_t);
 
+typedef enum ScmTreeCoreTypeEnum {
+    SCM_TREE_CORE_RBTREE,       /* red-black tree */
+    SCM_TREE_CORE_BTREE         /* B+-tree */
+} ScmTreeCoreType;
+
 /* A general tree map for internal use.  This is NOT a Scheme object. */
 
 struct ScmTreeCoreRec {
-    ScmDictEntry *root;
+    ScmDictEntry *root;         /* the root node; its actual type depends
+                                   on TYPE. */
     ScmTreeCoreCompareProc *cmp;
     int   num_entries;
     void  *data;
+    ScmTreeCoreType type;
 };
 
 #define SCM_TREE_CORE_DATA(core)  ((core)->data)
@@ -64,6 +76,8 @@ typedef struct ScmTreeIterRec {
     ScmTreeCore  *t;
     ScmDictEntry *e;
     int at_end;
+    void *leaf;                 /* B+-tree only: the leaf containing E */
+    int   index;                /* B+-tree only: the position of E in LEAF */
 } ScmTreeIter;
 
 /*
@@ -72,6 +86,10 @@ typedef struct ScmTreeIterRec {
 SCM_EXTERN void Scm_TreeCoreInit(ScmTreeCore *tc,
                                  ScmTreeCoreCompareProc *cmp,
                                  void *data);
+SCM_EXTERN void Scm_TreeCoreInitWithType(ScmTreeCore *tc,
+                                         ScmTreeCoreType type,
+                                         ScmTreeCoreCompareProc *cmp,
+                                         void *data);
 SCM_EXTERN void Scm_TreeCoreCopy(ScmTreeCore *dst,
                                  const ScmTreeCore *src);
 SCM_EXTERN void Scm_TreeCoreClear(ScmTreeCore *tc);
@@ -105,6 +123,17 @@ SCM_EXTERN int           Scm_TreeCoreNumEntries(ScmTreeCore *tc);
 
 SCM_EXTERN int           Scm_TreeCoreEq(ScmTreeCore *a, ScmTreeCore *b);
 
+/*
+ * Order statistics and range operations
+ */
+SCM_EXTERN int           Scm_TreeCoreRank(ScmTreeCore *tc, intptr_t key);
+SCM_EXTERN ScmDictEntry *Scm_TreeCoreNth(ScmTreeCore *tc, int n);
+SCM_EXTERN void          Scm_TreeCoreSplit(ScmTreeCore *tc, intptr_t key,
+                                           ScmTreeCore *dst);
+SCM_EXTERN void          Scm_TreeCoreJoin(ScmTreeCore *tc, ScmTreeCore *src);
+SCM_EXTERN int           Scm_TreeCoreDeleteRange(ScmTreeCore *tc,
+                                                 intptr_t lo, intptr_t hi);
+
 /*
  * Iterators
  */
@@ -142,6 +171,9 @@ SCM_CLASS_DECL(Scm_TreeMapClass);
 
 SCM_EXTERN ScmObj    Scm_MakeTreeMap(ScmTreeCoreCompareProc *cmp,
                                      void *data);
+SCM_EXTERN ScmObj    Scm_MakeTreeMapWithType(ScmTreeCoreType type,
+                                             ScmTreeCoreCompareProc *cmp,
+                                             void *data);
 SCM_EXTERN ScmObj    Scm_TreeMapCopy(const ScmTreeMap *src);
 
 SCM_EXTERN ScmObj    Scm_TreeMapRef(ScmTreeMap *tm, ScmObj key,
@@ -149,6 +149,26 @@ SCM_EXTERN ScmObj Scm_MakeUVectorFull(ScmClass *klass,
                                       ScmSmallInt size, void *init,
                                       int immutablep, void *owner);
 SCM_EXTERN ScmObj Scm_ListToUVector(ScmClass *klass, ScmObj list, int clamp);
+
+/* Off-heap uvector bodies.  The body is allocated outside of GC heap
+   so that it doesn't count toward GC pressure.  It is freed by
+   Scm_UVectorRelease, or when the uvector (and all its aliases)
+   become garbage. */
+enum {
+    SCM_UVECTOR_STORAGE_HEAP,   /* normal (atomic) GC heap */
+    SCM_UVECTOR_STORAGE_MALLOC, /* malloc()-ed */
+    SCM_UVECTOR_STORAGE_MMAP,   /* anonymous mmap()-ed */
+    SCM_UVECTOR_STORAGE_FILE,   /* mmap()-ed file */
+    SCM_UVECTOR_STORAGE_RELEASED
+};
+SCM_EXTERN ScmObj Scm_MakeUVectorStorage(ScmClass *klass, ScmSmallInt size,
+                                         ScmObj storage);
+SCM_EXTERN int    Scm_UVectorStorage(ScmUVector *v);
+SCM_EXTERN void   Scm_UVectorRelease(ScmUVector *v);
+SCM_EXTERN ScmObj Scm_MapFileUVector(ScmClass *klass, const char *path,
+                                     ScmObj mode, off_t offset,
+                                     ScmSmallInt length);
+SCM_EXTERN void   Scm_UVectorSync(ScmUVector *v, int async);
 SCM_EXTERN ScmObj Scm_VMUVectorRef(ScmUVector *v, int t,
                                    ScmSmallInt k, ScmObj fallback);
 SCM_EXTERN ScmObj Scm_ReadUVector(ScmPort *port, const char *tag,
@@ -34,10 +34,14 @@
 #ifndef GAUCHE_VM_H
 #define GAUCHE_VM_H
 
-/* Size of stack per VM (in words). */
+/* Default size of stack per VM (in words).  Each VM can be created
+   with a larger stack by Scm_NewVMWithStackSize; this value is also
+   the lower bound, for the compiler assumes it when it decides the
+   maximum number of literal arguments (see compile.scm). */
 #define SCM_VM_STACK_SIZE      10000
 
-/* Maximum # of values allowed for multiple value return */
+/* # of values that fit in the VM's value registers without spilling.
+   More values are allowed; see Scm__VMEnsureValues(). */
 #define SCM_VM_MAX_VALUES      20
 
 /* Finalizer queue size */
@@ -139,6 +143,16 @@ SCM_EXTERN void Scm_CallCC(ScmObj body);
 
 SCM_EXTERN int  Scm__VMProtectStack(ScmVM *vm);
 SCM_EXTERN void Scm__VMUnprotectStack(ScmVM *vm);
+SCM_EXTERN void Scm__VMReleaseStack(ScmVM *vm);
+SCM_EXTERN void Scm__VMEnsureValues(ScmVM *vm, int nvals);
+
+/* Make sure vm->vals can hold NVALS values (VAL0 is not in vm->vals,
+   so we need NVALS-1 slots). */
+#define SCM_VM_ENSURE_VALUES(vm, nvals)                         \
+    do {                                                        \
+        if ((nvals) - 1 > (vm)->valsSize)                       \
+            Scm__VMEnsureValues(vm, nvals);                     \
+    } while (0)
 
 /*
  * Syntactic closure
@@ -372,9 +386,13 @@ SCM_EXTERN ScmObj Scm_VMFinalizerRun(ScmVM *vm);
  *
  *  Not much stats are collected yet, but will grow in future.
  *  Stats collections are only active if SCM_COLLECT_VM_STATS
- *  runtime flag is TRUE.
- *  Stats are collected per-VM (i.e. per-thread), but currently
- *  we don't have an API to gather them.
+ *  runtime flag is TRUE, except the event counters, which are cheap
+ *  enough to be counted always.  allocBytes is only counted while
+ *  allocation counting is turned on by Scm_VMStatCountAllocation,
+ *  since it needs a hook in the allocator.
+ *  Stats are collected per-VM (i.e. per-thread).  Scheme code can
+ *  get sovCount by vm-stack-overflow-count, and the counters by
+ *  vm-stats.
  */
 
 typedef struct ScmVMStatRec {
@@ -382,12 +400,26 @@ typedef struct ScmVMStatRec {
     u_long     sovCount; /* # of stack overflow */
     double     sovTime;  /* cumulated time of stack ov handling */
 
+    /* Event counters */
+    u_long     callCount;       /* # of procedure calls */
+    u_long     genericCount;    /* # of generic function dispatches */
+    u_long     contSaveCount;   /* # of save_cont (continuation frames
+                                   moved to the heap) */
+    u_long     reentryCount;    /* # of VM loop re-entries from C
+                                   (Scm_ApplyRec, Scm_EvalRec etc.) */
+    ScmUInt64  allocBytes;      /* bytes allocated */
+    u_long     sovCountAtReset; /* sovCount when the counters are reset;
+                                   we don't reset sovCount itself, for
+                                   it is reported as a running total */
+
     /* Load statistics chain */
     ScmObj     loadStat;
 } ScmVMStat;
 
 /* The profiler structure is defined in prof.h */
 typedef struct ScmVMProfilerRec ScmVMProfiler;
+typedef struct ScmProfRingRec ScmProfRing;
+typedef struct ScmAllocRingRec ScmAllocRing;
 
 /*
  * VM structure
@@ -466,8 +498,13 @@ struct ScmVMRec {
                                    being accumulated.  This is a part of
                                    continuation.                             */
     ScmObj val0;                /* Value register.                           */
-    ScmObj vals[SCM_VM_MAX_VALUES]; /* Value register for multiple values */
+    ScmObj *vals;               /* Value registers for multiple values.
+                                   Normally points to valsBuf; replaced by
+                                   a larger heap area when more values
+                                   are to be returned. */
     int    numVals;             /* # of values */
+    int    valsSize;            /* # of slots vals can hold */
+    ScmObj valsBuf[SCM_VM_MAX_VALUES];
 
     ScmObj handlers;            /* chain of active dynamic handlers          */
 
@@ -524,6 +561,10 @@ struct ScmVMRec {
     ScmVMStat stat;
     int profilerRunning;
     ScmVMProfiler *prof;
+    ScmProfRing *profRing;      /* for continuous sampler; see prof.h */
+    ScmAllocRing *allocRing;    /* for allocation sampler; see prof.h */
+    void *tinyFreeLists[GC_TINY_FREELISTS]; /* for inline allocation
+                                               in VM loop; see vm.c */
 
 #if defined(GAUCHE_USE_WTHREADS)
     ScmWinCleanup *winCleanup; /* mimic pthread_cleanup_* */
@@ -533,11 +574,20 @@ struct ScmVMRec {
                                    Can be recycled, so don't use this to
                                    identify thread programtically.
                                    Set by vm_register. */
+
+    long stackSize;             /* Size of the stack area, in words. */
 };
 
 SCM_EXTERN ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name);
+SCM_EXTERN ScmVM *Scm_NewVMWithStackSize(ScmVM *proto, ScmObj name,
+                                         long stackSize);
 SCM_EXTERN int    Scm_AttachVM(ScmVM *vm);
 SCM_EXTERN void   Scm_DetachVM(ScmVM *vm);
+SCM_EXTERN void   Scm_VMRuntimeStats(u_long *nvms, u_long *sov,
+                                     u_long *samples);
+SCM_EXTERN ScmObj Scm_VMStats(ScmVM *vm);
+SCM_EXTERN void   Scm_VMStatsReset(ScmVM *vm);
+SCM_EXTERN void   Scm_VMStatCountAllocation(int flag);
 SCM_EXTERN void   Scm_VMDump(ScmVM *vm);
 SCM_EXTERN void   Scm_VMDefaultExceptionHandler(ScmObj exc);
 /* TRANSIENT: Scm_VMThrowException2 is to keep ABI compatibility.  Will be
@@ -91,7 +91,9 @@ typedef struct ScmWeakHashTableRec {
     ScmObj      defaultValue;
     ScmHashProc        *hashfn;
     ScmHashCompareProc *cmpfn;
-    u_int       goneEntries;
+    u_int       goneEntries;    /* # of entries swept after their keys
+                                   are GC-ed */
+    int         sweepCursor;    /* the bucket to be swept next */
 } ScmWeakHashTable;
 
 typedef struct ScmWeakHashIterRec {
@@ -119,6 +121,9 @@ SCM_EXTERN ScmObj Scm_WeakHashTableSet(ScmWeakHashTable *ht,
 SCM_EXTERN ScmObj Scm_WeakHashTableDelete(ScmWeakHashTable *ht, ScmObj key);
 SCM_EXTERN ScmObj Scm_WeakHashTableKeys(ScmWeakHashTable *ht);
 SCM_EXTERN ScmObj Scm_WeakHashTableValues(ScmWeakHashTable *ht);
+SCM_EXTERN int    Scm_WeakHashTableSweep(ScmWeakHashTable *ht);
+SCM_EXTERN void   Scm_WeakHashTableStat(ScmWeakHashTable *ht,
+                                        ScmSmallInt *live, ScmSmallInt *dead);
 
 SCM_EXTERN void   Scm_WeakHashIterInit(ScmWeakHashIter *iter,
                                        ScmWeakHashTable *ht);
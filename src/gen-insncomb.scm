@@ -0,0 +1,295 @@
+;;;
+;;; gen-insncomb.scm - generate combined insns from insn frequency profile
+;;;
+;;;   Copyright (c) 2016  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; Reads the instruction frequency profile and generates combined
+;; instructions for the most frequent instruction pairs.
+;;
+;; (1) Build Gauche with COUNT_INSN_FREQUENCY defined in vm.c, and
+;;     run your workload with it.  The profile is dumped at exit.
+;;
+;;      GAUCHE_INSN_FREQUENCY_FILE=insn.prof gosh your-workload.scm
+;;
+;; (2) Regenerate vminsn-comb.scm from the profile.
+;;
+;;      make INSNPROFILE=/path/to/insn.prof insn-comb
+;;
+;;     or, directly,
+;;
+;;      gosh ./gen-insncomb.scm [options] insn.prof vminsn.scm vminsn-comb.scm
+;;
+;;     Options:
+;;      --threshold RATIO  Ignore pairs that account for less than RATIO
+;;                         of all dispatched instructions.  Default 0.005.
+;;      --max N            Generate at most N instructions.  Default 16.
+;;
+;; (3) Rebuild.  Geninsn reads vminsn-comb.scm after vminsn.scm, and
+;;     the combined instructions are incorporated in the instruction
+;;     combiner (see code.c), so the compiler emits them automatically.
+;;
+;; We only generate combinations that geninsn knows how to synthesize
+;; the body from the ingredients (see construct-vmbody in geninsn).
+;; The instructions already in vminsn-comb.scm are carried over if they
+;; are still frequent enough.
+
+(use srfi-1)
+(use srfi-13)
+(use gauche.parseopt)
+(use file.util)
+(use util.match)
+
+;; LREF shortcuts.  Must match geninsn.
+(define-constant .lrefx.
+  '(LREF0 LREF1 LREF2 LREF3 LREF10 LREF11 LREF12 LREF20 LREF21 LREF30))
+
+;; Dispatch table in run_loop has this many entries.
+(define-constant .max-insns. 256)
+
+;;=============================================================
+;; Instruction definitions
+;;
+
+;; (name nparams operand-type combined body obsoleted?)
+(define (insn-name i)     (list-ref i 0))
+(define (insn-nparams i)  (list-ref i 1))
+(define (insn-operand i)  (list-ref i 2))
+(define (insn-combined i) (list-ref i 3))
+(define (insn-body i)     (list-ref i 4))
+(define (insn-obsoleted? i) (list-ref i 5))
+
+(define (lref-replace form lrefx)
+  (match form
+    [(syms ...) (map (cut lref-replace <> lrefx) syms)]
+    [symbol ($ string->symbol
+               $ regexp-replace #/\bLREF\b/ (x->string symbol)
+               $ x->string lrefx)]))
+
+;; Returns a list of insns in FILE, in order.
+(define (read-insns file)
+  (define (make-insn name nparams operand opts)
+    (let-optionals* opts ([combined #f] [body #f] . flags)
+      (list name (if (pair? nparams) (car nparams) nparams) operand
+            combined body (boolean (memq :obsoleted flags)))))
+  (define (lrefx-insns insn nparams operand comb)
+    (map (^[lrefx] (make-insn (lref-replace insn lrefx) nparams operand
+                              `(,(lref-replace comb lrefx))))
+         .lrefx.))
+  (append-map (^[form]
+                (match form
+                  [('define-insn name nparams operand . opts)
+                   (list (make-insn name nparams operand opts))]
+                  [('define-insn-lref* insn nparams operand comb)
+                   (cons (make-insn insn 2 operand `(,comb))
+                         (lrefx-insns insn 0 operand comb))]
+                  [('define-insn-lref+ insn nparams operand comb)
+                   (lrefx-insns insn nparams operand comb)]
+                  [_ '()]))
+              (file->sexp-list file)))
+
+(define (tree-has? pred tree)
+  (cond [(pair? tree) (or (tree-has? pred (car tree))
+                          (tree-has? pred (cdr tree)))]
+        [else (pred tree)]))
+
+(define (result-body? insn)               ;body uses $result
+  (and-let* ([body (insn-body insn)])
+    (tree-has? (^s (and (symbol? s)
+                        (string-prefix? "$result" (symbol->string s))))
+               body)))
+
+(define (argr-body? insn)                 ;body takes arg only by $w/argr
+  (and-let* ([body (insn-body insn)])
+    (and (tree-has? (cut eq? '$w/argr <>) body)
+         (not (tree-has? (cut memq <> '(VAL0 $w/argp)) body)))))
+
+;;=============================================================
+;; Combination candidates
+;;
+
+(define (symbol-join syms)
+  ($ string->symbol $ string-join (map x->string syms) "-"))
+
+;; Returns the sequence of base insns INSN stands for.
+(define (expand-insn insn)
+  (or (insn-combined insn) (list (insn-name insn))))
+
+;; Returns (nparams . operand-type) of the combined insn of SEQ,
+;; or #f if more than one ingredient needs parameters or an operand.
+(define (combined-params seq lookup)
+  (let loop ([seq seq] [np 0] [op 'none])
+    (match seq
+      [() (cons np op)]
+      [(name . rest)
+       (let1 i (lookup name)
+         (cond [(not i) #f]
+               [(and (> (insn-nparams i) 0) (> np 0)) #f]
+               [(and (not (eq? (insn-operand i) 'none)) (not (eq? op 'none)))
+                #f]
+               [else (loop rest (max np (insn-nparams i))
+                           (if (eq? (insn-operand i) 'none) op
+                               (insn-operand i)))]))])))
+
+;; Mirrors do-combined in geninsn.  ARGR? is #t if the first
+;; insn of SEQ takes the value from an LREF prefix.
+(define (synthesizable? seq lookup argr?)
+  (define (live name)
+    (and-let* ([i (lookup name)]) (and (not (insn-obsoleted? i)) i)))
+  (define (base name)
+    (and-let* ([i (live name)]) (and (insn-body i) i)))
+  (define (first-ok? i)
+    (if argr? (argr-body? i) #t))
+  (match seq
+    [(x) (and-let* ([i (base x)]) (first-ok? i))]
+    [(x (or 'PUSH 'RET 'CALL 'TAIL-CALL))
+     (and-let* ([i (base x)]) (and (result-body? i) (first-ok? i)))]
+    [('PUSH . next) (and (not argr?) (pair? next)
+                         (boolean (live (symbol-join next))))]
+    [((? (cut memq <> .lrefx.)) 'PUSH . next)
+     (and (not argr?) (pair? next) (boolean (live (symbol-join next))))]
+    [((? (cut memq <> .lrefx.)) . next)
+     (and (not argr?) (pair? next) (synthesizable? next lookup #t))]
+    [_ #f]))
+
+;; Profile is an alist of (insn-name count pair-count ...)
+(define (read-profile file)
+  (match (with-input-from-file file read)
+    [(:instruction-frequencies freqs . _) freqs]
+    [_ (error "bad instruction frequency profile:" file)]))
+
+;; Returns a list of (seq . count), sorted by count.  A candidate that
+;; begins with LREF shortcut is folded to the LREF family.
+(define (candidates profile base-lookup comb-insns)
+  (define names (list->vector (map car profile)))
+  (define counts (make-hash-table 'equal?))
+  (define (all-lookup name)
+    (or (base-lookup name)
+        (find (^i (eq? (insn-name i) name)) comb-insns)))
+  (define (family seq)
+    (if (memq (car seq) .lrefx.) (cons 'LREF (cdr seq)) seq))
+  (define (add! seq count)
+    ;; sequences led by generic LREF can't be combined; the LREF
+    ;; parameters would conflict with the other ingredients'.
+    (unless (eq? (car seq) 'LREF)
+      (hash-table-update! counts (family seq) (cut + <> count) 0)))
+  (dolist [entry profile]
+    (match-let1 (name count . pairs) entry
+      (when (find (^i (eq? (insn-name i) name)) comb-insns)
+        (and-let* ([i (all-lookup name)]) (add! (expand-insn i) count)))
+      (and-let* ([i (all-lookup name)])
+        (for-each (^[next c]
+                    (when (> c 0)
+                      (and-let* ([j (all-lookup (vector-ref names next))])
+                        (add! (append (expand-insn i) (expand-insn j)) c))))
+                  (iota (length pairs)) pairs))))
+  (sort (hash-table->alist counts) > cdr))
+
+;;=============================================================
+;; Main
+;;
+
+(define (usage)
+  (print "Usage: gosh gen-insncomb.scm [--threshold RATIO] [--max N] \
+          PROFILE VMINSN OUTPUT")
+  (exit 1))
+
+(define (main args)
+  (let-args (cdr args) ([threshold "threshold=f" 0.005]
+                        [maxinsns  "max=i" 16]
+                        [else => (^ _ (usage))]
+                        . rest)
+    (match rest
+      [(profile-file vminsn-file output-file)
+       (generate profile-file vminsn-file output-file threshold maxinsns)]
+      [_ (usage)])
+    0))
+
+(define (generate profile-file vminsn-file output-file threshold maxinsns)
+  (let* ([base-insns (read-insns vminsn-file)]
+         [comb-insns (if (file-exists? output-file)
+                       (read-insns output-file)
+                       '())]
+         [base-lookup (^n (find (^i (eq? (insn-name i) n)) base-insns))]
+         [profile (read-profile profile-file)]
+         [total (fold (^(e s) (+ (cadr e) s)) 0 profile)]
+         [room (- .max-insns. (length base-insns))])
+    (define (known? seq)
+      (find (^i (or (eq? (insn-name i) (symbol-join seq))
+                    (equal? (insn-combined i) seq)))
+            base-insns))
+    (define (lref-family? seq) (eq? (car seq) 'LREF))
+    (define (valid? seq)
+      (and (pair? (cdr seq))
+           (not (known? seq))
+           (if (lref-family? seq)
+             (and (every (^x (not (known? (cons x (cdr seq))))) .lrefx.)
+                  (synthesizable? (cons 'LREF0 (cdr seq)) base-lookup #f)
+                  (combined-params (cdr seq) base-lookup))
+             (and (synthesizable? seq base-lookup #f)
+                  (combined-params seq base-lookup)))))
+    (define (cost seq) (if (lref-family? seq) (length .lrefx.) 1))
+    (let loop ([cands (candidates profile base-lookup comb-insns)]
+               [room room] [n 0] [r '()])
+      (match cands
+        [() (emit output-file profile-file (reverse r) base-lookup total)]
+        [((seq . count) . rest)
+         (cond [(or (>= n maxinsns)
+                    (< count (* threshold total)))
+                (loop '() room n r)]
+               [(and (valid? seq) (<= (cost seq) room))
+                (loop rest (- room (cost seq)) (+ n 1) (acons seq count r))]
+               [else (loop rest room n r)])]))))
+
+(define (percent count total)
+  (/ (round (/. (* count 10000) total)) 100))
+
+(define (emit output-file profile-file cands base-lookup total)
+  (with-output-to-file output-file
+    (^[]
+      (print ";;; Generated by gen-insncomb.scm.  DO NOT EDIT.")
+      (print ";;; The combined instructions for the frequent instruction")
+      (print ";;; pairs.  See gen-insncomb.scm for how to regenerate this.")
+      (print ";;; Profile: " (sys-basename profile-file))
+      (dolist [c cands]
+        (match-let1 (seq . count) c
+          (if (eq? (car seq) 'LREF)
+            (match-let1 (np . op) (combined-params (cdr seq) base-lookup)
+              (format #t "\n;; ~d (~a%)\n" count (percent count total))
+              (write `(define-insn-lref+ ,(symbol-join seq) ,np ,op ,seq)))
+            (match-let1 (np . op) (combined-params seq base-lookup)
+              (format #t "\n;; ~d (~a%)\n" count (percent count total))
+              (write `(define-insn ,(symbol-join seq) ,np ,op ,seq))))
+          (newline))))
+    :if-exists :supersede))
+
+;; Local variables:
+;; mode: scheme
+;; end:
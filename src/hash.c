@@ -230,11 +230,14 @@ static u_long internal_string_hash(ScmString *str, u_long salt, int portable)
     }
 }
 
+static u_long equal_hash_aggregate(ScmObj obj, u_long salt, int portable);
+
 /* equal-hash, which satisfies
      forall x, y: equal(x,y) => hash(x) = hash(y)
   
    Both default-hash and portable-hash have this property but their
    requirements are slightly different, so here's the common part.
+   Lists and vectors are handled by equal_hash_aggregate below.
 */
 static u_long equal_hash_common(ScmObj obj, u_long salt, int portable)
 {
@@ -246,23 +249,18 @@ static u_long equal_hash_common(ScmObj obj, u_long salt, int portable)
         return hashval&PORTABLE_HASHMASK;
     } else if (SCM_STRINGP(obj)) {
         return internal_string_hash(SCM_STRING(obj), salt, portable);
-    } else if (SCM_PAIRP(obj)) {
-        u_long h = 0, h2;
-        ScmObj cp;
-        SCM_FOR_EACH(cp, obj) {
-            h2 = equal_hash_common(SCM_CAR(cp), salt, portable);
-            h = COMBINE(h, h2);
-        }
-        h2 = equal_hash_common(cp, salt, portable);
-        return COMBINE(h, h2);
-    } else if (SCM_VECTORP(obj)) {
-        int siz = SCM_VECTOR_SIZE(obj);
-        u_long h = 0, h2;
-        for (int i=0; i<siz; i++) {
-            h2 = equal_hash_common(SCM_VECTOR_ELEMENT(obj, i), salt, portable);
-            h = COMBINE(h, h2);
-        }
-        return h;
+    } else if (SCM_PAIRP(obj) || SCM_VECTORP(obj)) {
+        return equal_hash_aggregate(obj, salt, portable);
+    } else if (!portable && SCM_UVECTORP(obj)
+               && Scm_UVectorType(SCM_CLASS_OF(obj)) <= SCM_UVECTOR_U64) {
+        /* Integer uvectors are equal? iff their contents are the same
+           bit pattern, so we can hash the bytes.  We don't do this for
+           portable hash, since the byte order varies.  Flonum vectors
+           can't take this path because of -0.0. */
+        u_long h = Scm__DwSipDefaultHash((uint8_t*)SCM_UVECTOR_ELEMENTS(obj),
+                                         Scm_UVectorSizeInBytes(SCM_UVECTOR(obj)),
+                                         salt, salt);
+        return COMBINE(h, Scm_UVectorType(SCM_CLASS_OF(obj)));
 #if GAUCHE_KEEP_DISJOINT_KEYWORD_OPTION
     } else if (SCM_KEYWORDP(obj)) {
         if (portable) {
@@ -327,6 +325,89 @@ static u_long equal_hash_common(ScmObj obj, u_long salt, int portable)
     }
 }
 
+/* Lists and vectors are hashed with an explicit stack, so that deeply
+   nested structures won't overflow the C stack.  The result is the same
+   as the straightforward recursion:
+
+     list:   fold COMBINE over the hashes of the elements, starting from 0,
+             then COMBINE the hash of the last cdr.
+     vector: fold COMBINE over the hashes of the elements, starting from 0.
+*/
+#define HASH_STACK_INIT 32
+
+typedef struct hash_frame_rec {
+    ScmObj obj;                 /* list cursor, or vector */
+    ScmSmallInt i;              /* vector index, or -1 for list,
+                                   -2 for list whose last cdr is done */
+    u_long h;
+} hash_frame;
+
+static u_long equal_hash_aggregate(ScmObj obj, u_long salt, int portable)
+{
+    hash_frame sinit[HASH_STACK_INIT], *stack = sinit;
+    ScmSmallInt sp = 0, ssize = HASH_STACK_INIT;
+    u_long v;
+
+#define PUSH_FRAME(o)                                                   \
+    do {                                                                \
+        if (sp == ssize) {                                              \
+            hash_frame *ns = SCM_NEW_ARRAY(hash_frame, ssize*2); \
+            memcpy(ns, stack, sizeof(hash_frame)*ssize);                \
+            stack = ns;                                                 \
+            ssize *= 2;                                                 \
+        }                                                               \
+        stack[sp].obj = (o);                                            \
+        stack[sp].i = SCM_VECTORP(o) ? 0 : -1;                          \
+        stack[sp].h = 0;                                                \
+        sp++;                                                           \
+    } while (0)
+
+    PUSH_FRAME(obj);
+    for (;;) {
+        hash_frame *f = &stack[sp-1];
+        ScmObj next;
+        if (f->i >= 0) {
+            if (f->i < SCM_VECTOR_SIZE(f->obj)) {
+                next = SCM_VECTOR_ELEMENT(f->obj, f->i++);
+            } else {
+                v = f->h;
+                goto popped;
+            }
+        } else if (SCM_PAIRP(f->obj)) {
+            next = SCM_CAR(f->obj);
+            f->obj = SCM_CDR(f->obj);
+        } else {
+            /* The last cdr.  Frames marked -2 never come to the top
+               of the loop; they're finished in 'popped'. */
+            next = f->obj;
+            f->i = -2;
+        }
+
+        if (SCM_PAIRP(next) || SCM_VECTORP(next)) {
+            PUSH_FRAME(next);
+            continue;
+        }
+        v = equal_hash_common(next, salt, portable);
+        if (f->i != -2) {
+            f->h = COMBINE(f->h, v);
+            continue;
+        }
+        v = COMBINE(f->h, v);
+      popped:
+        /* V is the hash value of the object of the topmost frame. */
+        for (;;) {
+            if (--sp == 0) return v;
+            f = &stack[sp-1];
+            if (f->i != -2) {
+                f->h = COMBINE(f->h, v);
+                break;
+            }
+            v = COMBINE(f->h, v);
+        }
+    }
+#undef PUSH_FRAME
+}
+
 /* For recursive call to the current hash function - see call-object-hash
    and object-hash definitions in libomega.scm. */
 static ScmParameterLoc current_recursive_hash;
@@ -407,6 +488,36 @@ u_long Scm_CombineHashValue(u_long a, u_long b)
  * throw Scheme error.  Be aware of that.
  */
 
+/*
+ * Replace the bucket array of TABLE with one of NEWSIZE buckets, which
+ * must be a power of two, relinking every entry by its saved hash value.
+ * Used by insert_entry to extend the table, and by Scm_HashCoreReserve
+ * and Scm_HashCoreCompact to resize it explicitly.
+ */
+static void resize_buckets(ScmHashCore *table, int newsize)
+{
+    int newbits = 0;
+    for (int i=newsize; i > 1; i /= 2) newbits++;
+
+    Entry **newb = SCM_NEW_ARRAY(Entry*, newsize);
+    for (int i=0; i<newsize; i++) newb[i] = NULL;
+
+    ScmHashIter iter;
+    Entry *f;
+    Scm_HashIterInit(&iter, table);
+    while ((f = (Entry*)Scm_HashIterNext(&iter)) != NULL) {
+        int index = HASH2INDEX(newsize, newbits, f->hashval);
+        f->next = newb[index];
+        newb[index] = f;
+    }
+    /* gc friendliness */
+    for (int i=0; i<table->numBuckets; i++) table->buckets[i] = NULL;
+
+    table->numBuckets = newsize;
+    table->numBucketsLog2 = newbits;
+    table->buckets = (void**)newb;
+}
+
 /*
  * Common function called when the accessor function needs to add an entry.
  */
@@ -426,26 +537,7 @@ static Entry *insert_entry(ScmHashCore *table,
 
     if (table->numEntries > table->numBuckets*MAX_AVG_CHAIN_LIMITS) {
         /* Extend the table */
-        int newsize = (table->numBuckets << EXTEND_BITS);
-        int newbits = table->numBucketsLog2 + EXTEND_BITS;
-
-        Entry **newb = SCM_NEW_ARRAY(Entry*, newsize);
-        for (int i=0; i<newsize; i++) newb[i] = NULL;
-
-        ScmHashIter iter;
-        Entry *f;
-        Scm_HashIterInit(&iter, table);
-        while ((f = (Entry*)Scm_HashIterNext(&iter)) != NULL) {
-            index = HASH2INDEX(newsize, newbits, f->hashval);
-            f->next = newb[index];
-            newb[index] = f;
-        }
-        /* gc friendliness */
-        for (int i=0; i<table->numBuckets; i++) table->buckets[i] = NULL;
-
-        table->numBuckets = newsize;
-        table->numBucketsLog2 = newbits;
-        table->buckets = (void**)newb;
+        resize_buckets(table, table->numBuckets << EXTEND_BITS);
     }
     return e;
 }
@@ -560,8 +652,11 @@ static Entry *string_access(ScmHashCore *table, intptr_t k, ScmDictOp op)
     const ScmStringBody *keyb = SCM_STRING_BODY(key);
     long size = SCM_STRING_BODY_SIZE(keyb);
     for (Entry *e = buckets[index], *p = NULL; e; p = e, e = e->next) {
+        if (e->hashval != hashval) continue;
         ScmObj ee = SCM_OBJ(e->key);
         const ScmStringBody *eeb = SCM_STRING_BODY(ee);
+        /* Literal keys are often the same string, or share the body */
+        if (ee == key || eeb == keyb) FOUND(table, op, e, p, index);
         int eesize = SCM_STRING_BODY_SIZE(eeb);
         if (size == eesize
             && memcmp(SCM_STRING_BODY_START(keyb),
@@ -627,6 +722,9 @@ static Entry *multiword_access(ScmHashCore *table, intptr_t k, ScmDictOp op)
 /*
  * Accessor function for general case
  *    (hashfn and cmpfn are given by user)
+ * Equal keys must have the same hash value, so we compare the saved
+ * hash value first and call cmpfn only when it matches.  It saves
+ * costly calls of equal? or user's procedure on the collided entries.
  */
 static Entry *general_access(ScmHashCore *table, intptr_t key, ScmDictOp op)
 {
@@ -637,7 +735,9 @@ static Entry *general_access(ScmHashCore *table, intptr_t key, ScmDictOp op)
     Entry **buckets = (Entry**)table->buckets;
 
     for (Entry *e = buckets[index], *p = NULL; e; p = e, e = e->next) {
-        if (table->cmpfn(table, key, e->key)) FOUND(table, op, e, p, index);
+        if (e->hashval == hashval && table->cmpfn(table, key, e->key)) {
+            FOUND(table, op, e, p, index);
+        }
     }
     NOTFOUND(table, op, key, hashval, index);
 }
@@ -749,6 +849,7 @@ void Scm_HashCoreCopy(ScmHashCore *dst, const ScmHashCore *src)
             Entry *e = SCM_NEW(Entry);
             e->key = s->key;
             e->value = s->value;
+            e->hashval = s->hashval;
             e->next = NULL;
             if (p) p->next = e;
             else   b[i] = e;
@@ -778,6 +879,61 @@ void Scm_HashCoreClear(ScmHashCore *table)
     table->numEntries = 0;
 }
 
+/* Make TABLE have enough buckets to hold NUMENTRIES entries without
+   being extended on the way.  Useful before bulk insertion.  Never
+   shrinks the table. */
+void Scm_HashCoreReserve(ScmHashCore *table, int numEntries)
+{
+    if (numEntries <= table->numBuckets*MAX_AVG_CHAIN_LIMITS) return;
+    u_int newsize = round2up((numEntries + MAX_AVG_CHAIN_LIMITS - 1)
+                             / MAX_AVG_CHAIN_LIMITS);
+    if ((int)newsize > table->numBuckets) resize_buckets(table, newsize);
+}
+
+/* Shrink the bucket array of TABLE to fit the current number of
+   entries.  After deleting most of the entries from a large table,
+   this gives back the memory and makes iteration cheaper. */
+void Scm_HashCoreCompact(ScmHashCore *table)
+{
+    u_int newsize = DEFAULT_NUM_BUCKETS;
+    while ((int)newsize*MAX_AVG_CHAIN_LIMITS < table->numEntries) {
+        newsize <<= EXTEND_BITS;
+    }
+    if ((int)newsize < table->numBuckets) resize_buckets(table, newsize);
+}
+
+/* Delete the entries for which DEADP returns true, scanning NBUCKETS
+   buckets from *CURSOR, which is updated for the next call.  A negative
+   NBUCKETS scans the whole table.  Returns the number of deleted entries.
+   This lets tables whose entries can become stale (e.g. weak tables)
+   clean themselves up a bit at a time, instead of a whole scan. */
+int Scm_HashCoreSweep(ScmHashCore *table,
+                      int (*deadp)(ScmDictEntry*, void*), void *data,
+                      int *cursor, int nbuckets)
+{
+    int deleted = 0;
+    int index = (*cursor >= 0 && *cursor < table->numBuckets)? *cursor : 0;
+
+    if (nbuckets < 0 || nbuckets > table->numBuckets) {
+        nbuckets = table->numBuckets;
+    }
+    for (int i=0; i<nbuckets; i++) {
+        Entry **buckets = BUCKETS(table);
+        for (Entry *e = buckets[index], *p = NULL, *n; e; e = n) {
+            n = e->next;
+            if (deadp((ScmDictEntry*)e, data)) {
+                delete_entry(table, e, p, index);
+                deleted++;
+            } else {
+                p = e;
+            }
+        }
+        if (++index >= table->numBuckets) index = 0;
+    }
+    *cursor = index;
+    return deleted;
+}
+
 ScmDictEntry *Scm_HashCoreSearch(ScmHashCore *table, intptr_t key,
                                  ScmDictOp op)
 {
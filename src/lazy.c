@@ -457,6 +457,92 @@ ScmObj Scm_MakeLazyPair(ScmObj item, ScmObj generator)
     return SCM_OBJ(z);
 }
 
+/* Chunked lazy sequence.
+   Calling the generator and taking the ownership of the lazy pair for
+   every element can be a significant overhead.  A chunked lazy sequence
+   is driven by a generator that returns a block of elements at a time,
+   as a vector, a uvector or a string.  When forced, the whole chunk is
+   unrolled into ordinary pairs, and only the last element of the chunk
+   is put in the lookahead slot of a new lazy pair.  So forcing most
+   elements costs nothing more than following the cdr.
+
+   The generator slot of such a lazy pair holds a subr whose data is the
+   chunk generator, so that it's distinguished from the ordinary one.
+   The subr isn't supposed to be called directly.
+ */
+static ScmObj chunk_gen_stub(ScmObj *args, int nargs, void *data)
+{
+    Scm_Error("A chunk generator of a lazy sequence can't be called "
+              "directly.");
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+#define CHUNK_GENERATOR_P(obj) \
+    (SCM_SUBRP(obj) && SCM_SUBR_FUNC(obj) == chunk_gen_stub)
+#define CHUNK_GENERATOR_BODY(obj)  SCM_OBJ(SCM_SUBR_DATA(obj))
+
+/* Unroll CHUNK into a list whose last pair is a lazy pair with the
+   chunk generator GEN.  Returns #f if CHUNK is empty. */
+static ScmObj chunk_unroll(ScmObj chunk, ScmObj gen)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL, last = SCM_UNDEFINED;
+
+    if (SCM_VECTORP(chunk)) {
+        ScmSmallInt n = SCM_VECTOR_SIZE(chunk);
+        if (n == 0) return SCM_FALSE;
+        for (ScmSmallInt i=0; i<n-1; i++) {
+            SCM_APPEND1(h, t, SCM_VECTOR_ELEMENT(chunk, i));
+        }
+        last = SCM_VECTOR_ELEMENT(chunk, n-1);
+    } else if (SCM_UVECTORP(chunk)) {
+        ScmUVector *uv = SCM_UVECTOR(chunk);
+        int type = Scm_UVectorType(SCM_CLASS_OF(uv));
+        ScmSmallInt n = SCM_UVECTOR_SIZE(uv);
+        if (n == 0) return SCM_FALSE;
+        for (ScmSmallInt i=0; i<n; i++) {
+            ScmObj v = Scm_VMUVectorRef(uv, type, i, SCM_UNBOUND);
+            SCM_FLONUM_ENSURE_MEM(v);
+            if (i == n-1) last = v;
+            else SCM_APPEND1(h, t, v);
+        }
+    } else if (SCM_STRINGP(chunk)) {
+        const ScmStringBody *b = SCM_STRING_BODY(chunk);
+        ScmSmallInt n = SCM_STRING_BODY_LENGTH(b);
+        const char *s = SCM_STRING_BODY_START(b);
+        if (SCM_STRING_BODY_INCOMPLETE_P(b)) {
+            Scm_Error("A chunk generator returned an incomplete string: %S",
+                      chunk);
+        }
+        if (n == 0) return SCM_FALSE;
+        for (ScmSmallInt i=0; i<n; i++) {
+            ScmChar ch;
+            SCM_CHAR_GET(s, ch);
+            s += SCM_CHAR_NBYTES(ch);
+            if (i == n-1) last = SCM_MAKE_CHAR(ch);
+            else SCM_APPEND1(h, t, SCM_MAKE_CHAR(ch));
+        }
+    } else {
+        Scm_Error("A chunk generator must return a vector, a uvector, "
+                  "a string or an EOF, but got: %S", chunk);
+        return SCM_UNDEFINED;   /* dummy */
+    }
+
+    ScmObj z = Scm_MakeLazyPair(last, gen);
+    if (SCM_NULLP(h)) return z;
+    SCM_SET_CDR(t, z);
+    return h;
+}
+
+/* Returns a lazy sequence of the elements of CHUNK followed by the ones
+   from the chunks CHUNKGEN yields.  Returns #f if CHUNK is empty; the
+   caller should call CHUNKGEN again.  */
+ScmObj Scm_ChunkToLazySeq(ScmObj chunk, ScmObj chunkgen)
+{
+    ScmObj gen = Scm_MakeSubr(chunk_gen_stub, (void*)chunkgen, 0, 0,
+                              SCM_FALSE);
+    return chunk_unroll(chunk, gen);
+}
+
 /* Force a lazy pair.
    NB: When an error occurs during forcing, we release the lock of the
    pair, so that the pair can be forced again.  However, the generator
@@ -479,18 +565,26 @@ ScmObj Scm_ForceLazyPair(volatile ScmLazyPair *lp)
                incomplete stack frame if there's any. */
             int extra_frame_pushed = Scm__VMProtectStack(vm);
             SCM_UNWIND_PROTECT {
-                ScmObj val = Scm_ApplyRec0(lp->generator);
-                ScmObj newgen = (vm->numVals == 1)? lp->generator : vm->vals[0];
-                vm->numVals = 1; /* make sure the extra val won't leak out */
-
-                if (SCM_EOFP(val)) {
-                    lp->item = SCM_NIL;
-                    lp->generator = SCM_NIL;
+                ScmObj gen = lp->generator;
+                ScmObj next = SCM_NIL;
+                if (CHUNK_GENERATOR_P(gen)) {
+                    /* Skip empty chunks. */
+                    for (;;) {
+                        ScmObj chunk = Scm_ApplyRec0(CHUNK_GENERATOR_BODY(gen));
+                        vm->numVals = 1;
+                        if (SCM_EOFP(chunk)) break;
+                        next = chunk_unroll(chunk, gen);
+                        if (!SCM_FALSEP(next)) break;
+                        next = SCM_NIL;
+                    }
                 } else {
-                    ScmObj newlp = Scm_MakeLazyPair(val, newgen);
-                    lp->item = newlp;
-                    lp->generator = SCM_NIL;
+                    ScmObj val = Scm_ApplyRec0(gen);
+                    ScmObj newgen = (vm->numVals == 1)? gen : vm->vals[0];
+                    vm->numVals = 1; /* make sure the extra val won't leak out */
+                    if (!SCM_EOFP(val)) next = Scm_MakeLazyPair(val, newgen);
                 }
+                lp->item = next;
+                lp->generator = SCM_NIL;
                 AO_nop_full();
                 SCM_SET_CAR(lp, item);
                 /* We don't need barrier here. */
@@ -60,14 +60,25 @@
                                 comparison-proc ; or order-proc
                                 hash name 
                                 any-type::<boolean> use-cmp::<boolean>
-                                srfi-128::<boolean>)
+                                srfi-128::<boolean>
+                                builtin-cmp::<boolean> equiv)
   (let* ([flags::u_long (logior (?: srfi-128 SCM_COMPARATOR_SRFI_128 0)
                                 (?: (SCM_EQ comparison-proc SCM_FALSE)
                                     SCM_COMPARATOR_NO_ORDER 0)
                                 (?: (SCM_EQ hash SCM_FALSE)
                                     SCM_COMPARATOR_NO_HASH 0)
                                 (?: any-type SCM_COMPARATOR_ANY_TYPE 0)
-                                (?: use-cmp SCM_COMPARATOR_USE_COMPARISON 0))])
+                                (?: use-cmp SCM_COMPARATOR_USE_COMPARISON 0)
+                                (?: builtin-cmp
+                                    SCM_COMPARATOR_BUILTIN_COMPARE 0))])
+    (cond [(SCM_EQ equiv 'eq?)
+           (set! flags (logior flags SCM_COMPARATOR_EQUIV_EQ))]
+          [(SCM_EQ equiv 'eqv?)
+           (set! flags (logior flags SCM_COMPARATOR_EQUIV_EQV))]
+          [(SCM_EQ equiv 'equal?)
+           (set! flags (logior flags SCM_COMPARATOR_EQUIV_EQUAL))]
+          [(SCM_EQ equiv 'string=?)
+           (set! flags (logior flags SCM_COMPARATOR_EQUIV_STRING))])
     (return
      (Scm_MakeComparator type-test equality-test comparison-proc hash
                          name flags))))
@@ -90,6 +101,18 @@
   (cond [(or (eq? hash #f) (applicable? hash <bottom>)) hash]
         [else (error "make-comparator needs a procedure or #f as hash, but got:" hash)])) 
 
+;; If equality-test is one of the builtin equivalence predicates and
+;; hash is a builtin hash function, returns the name of the predicate,
+;; so that hash tables can use the builtin hash type instead.  We don't
+;; do so for other hash functions, which may have side effects.
+(define (builtin-equivalence equality-test hash)
+  (and (or (eq? hash eq-hash) (eq? hash eqv-hash) (eq? hash default-hash))
+       (cond [(eq? equality-test eq?) 'eq?]
+             [(eq? equality-test eqv?) 'eqv?]
+             [(eq? equality-test equal?) 'equal?]
+             [(eq? equality-test string=?) 'string=?]
+             [else #f])))
+
 ;; API - srfi-114 constructor
 (define-in-module gauche (make-comparator/compare type-test equality-test
                                                   comparison-proc hash
@@ -107,7 +130,9 @@
                       name
                       (eq? type default-type-test)
                       (eq? equality-test #t)
-                      #f)))
+                      #f
+                      (eq? comparison-proc compare)
+                      (builtin-equivalence equality-test hash))))
 
 ;; API - srfi-128 constructor
 (define-in-module gauche (make-comparator type-test equality-test
@@ -125,7 +150,9 @@
                       name
                       (eq? type default-type-test)
                       (eq? equality-test #t)
-                      #t)))
+                      #t
+                      #f
+                      (builtin-equivalence equality-test hash))))
 
 (define (%make-fallback-compare comparator)
   (if (eq? (comparator-flavor comparator) 'ordering)
@@ -193,6 +220,10 @@
 (define-cproc comparator-equality-use-comparison? (c::<comparator>) ::<boolean>
   (return (logand (-> c flags) SCM_COMPARATOR_USE_COMPARISON)))
 
+;; Used by sort procedures to sort with Scm_Compare
+(define-cproc comparator-builtin-compare? (c::<comparator>) ::<boolean>
+  (return (logand (-> c flags) SCM_COMPARATOR_BUILTIN_COMPARE)))
+
 ;; Expose as a class
 (select-module gauche)
 (inline-stub
@@ -248,7 +279,9 @@
 
 (define-cproc comparator-compare (c::<comparator> a b) :constant
   (if (logand (-> c flags) SCM_COMPARATOR_ANY_TYPE)
-    (return (Scm_VMApply2 (Scm_ComparatorComparisonProcedure c) a b))
+    (if (logand (-> c flags) SCM_COMPARATOR_BUILTIN_COMPARE)
+      (return (SCM_MAKE_INT (Scm_Compare a b)))
+      (return (Scm_VMApply2 (Scm_ComparatorComparisonProcedure c) a b)))
     (let1/cps r (Scm_VMApply1 (-> c typeFn) a)
       [c::ScmComparator* a b]
       (when (SCM_FALSEP r)
@@ -257,7 +290,10 @@
         [c::ScmComparator* a b]
         (when (SCM_FALSEP r)
           (Scm_Error "Comparator %S cannot accept object %S" c b))
-        (return (Scm_VMApply2 (Scm_ComparatorComparisonProcedure c) a b))))))
+        (if (logand (-> c flags) SCM_COMPARATOR_BUILTIN_COMPARE)
+          (return (SCM_MAKE_INT (Scm_Compare a b)))
+          (return (Scm_VMApply2 (Scm_ComparatorComparisonProcedure c)
+                                a b)))))))
 
 ;;;
 ;;; Generic comparison
@@ -288,6 +324,13 @@
          (let* ([r (Scm_VectorCopy (SCM_VECTOR seq) 0 -1 SCM_UNDEFINED)])
            (Scm_SortArray (SCM_VECTOR_ELEMENTS r) (SCM_VECTOR_SIZE r) '#f)
            (return r))]
+        [(SCM_UVECTORP seq)
+         (let* ([r (Scm_MakeUVector (Scm_ClassOf seq)
+                                    (SCM_UVECTOR_SIZE seq) NULL)])
+           (memcpy (SCM_UVECTOR_ELEMENTS r) (SCM_UVECTOR_ELEMENTS seq)
+                   (Scm_UVectorSizeInBytes (SCM_UVECTOR seq)))
+           (Scm_UVectorSort (SCM_UVECTOR r) 0 -1)
+           (return r))]
         [(>= (Scm_Length seq) 0) (return (Scm_SortList seq '#f))]
         [else (SCM_TYPE_ERROR seq "proper list or vector")
               (return SCM_UNDEFINED)]))
@@ -296,7 +339,76 @@
   (cond [(SCM_VECTORP seq)
          (Scm_SortArray (SCM_VECTOR_ELEMENTS seq) (SCM_VECTOR_SIZE seq) '#f)
          (return seq)]
+        [(SCM_UVECTORP seq)
+         (Scm_UVectorSort (SCM_UVECTOR seq) 0 -1)
+         (return seq)]
         [(>= (Scm_Length seq) 0) (return (Scm_SortListX seq '#f))]
         [else (SCM_TYPE_ERROR seq "proper list or vector")
               (return SCM_UNDEFINED)]))
 
+;; Stably sorts VEC by KEYS, a vector of the same length, with the
+;; default ordering.  KEYS are rearranged along with VEC.
+(define-cproc %sort-by-keys! (vec::<vector> keys::<vector>
+                              :optional (start::<fixnum> 0) (end::<fixnum> -1))
+  (let* ([size::ScmSmallInt (SCM_VECTOR_SIZE vec)])
+    (unless (== size (SCM_VECTOR_SIZE keys))
+      (Scm_Error "vector and keys length mismatch: %S vs %S" vec keys))
+    (SCM_CHECK_START_END start end size)
+    (Scm_SortArrayByKeys (+ (SCM_VECTOR_ELEMENTS vec) start)
+                         (+ (SCM_VECTOR_ELEMENTS keys) start)
+                         (- end start))
+    (return (SCM_OBJ vec))))
+
+;; Merging adjacent sorted runs [a0, a1) and [b0, b1), for parallel sort.
+;; A run is either a uvector, or a vector accompanied by a vector of keys
+;; (runs sorted by %sort-by-keys!).  %merge-split returns how many
+;; elements of the first run are among the first K merged elements.
+(inline-stub
+ (define-cfn merge-run-size (run) ::ScmSmallInt :static
+   (cond [(SCM_UVECTORP run) (return (SCM_UVECTOR_SIZE run))]
+         [(SCM_VECTORP run) (return (SCM_VECTOR_SIZE run))]
+         [else (SCM_TYPE_ERROR run "vector or uvector") (return 0)]))
+ (define-cfn merge-check-ranges (size::ScmSmallInt
+                                 a0::ScmSmallInt a1::ScmSmallInt
+                                 b0::ScmSmallInt b1::ScmSmallInt) ::void :static
+   (unless (and (<= 0 a0) (<= a0 a1) (<= a1 b0) (<= b0 b1) (<= b1 size))
+     (Scm_Error "invalid merge ranges [%ld, %ld) and [%ld, %ld) for length %ld"
+                (cast long a0) (cast long a1) (cast long b0) (cast long b1)
+                (cast long size))))
+ )
+
+(define-cproc %merge-split (keys a0::<fixnum> a1::<fixnum>
+                                 b0::<fixnum> b1::<fixnum> k::<fixnum>)
+  ::<fixnum>
+  (merge-check-ranges (merge-run-size keys) a0 a1 b0 b1)
+  (unless (and (<= 0 k) (<= k (+ (- a1 a0) (- b1 b0))))
+    (Scm_Error "merge split point out of range: %ld" (cast long k)))
+  (if (SCM_UVECTORP keys)
+    (return (Scm_UVectorMergeSplit (SCM_UVECTOR keys) a0 a1 b0 b1 k))
+    (let* ([e::ScmObj* (SCM_VECTOR_ELEMENTS keys)])
+      (return (Scm_MergeSplitByKeys (+ e a0) (- a1 a0) (+ e b0) (- b1 b0) k)))))
+
+;; DKEYS and SKEYS are ignored for uvectors.
+(define-cproc %merge! (dst dkeys d::<fixnum> src skeys
+                           a0::<fixnum> a1::<fixnum> b0::<fixnum> b1::<fixnum>)
+  ::<void>
+  (merge-check-ranges (merge-run-size src) a0 a1 b0 b1)
+  (unless (and (<= 0 d)
+               (<= (+ d (- a1 a0) (- b1 b0)) (merge-run-size dst)))
+    (Scm_Error "merge destination out of range: %ld" (cast long d)))
+  (cond [(SCM_UVECTORP src)
+         (unless (SCM_UVECTORP dst) (SCM_TYPE_ERROR dst "uvector"))
+         (Scm_UVectorMerge (SCM_UVECTOR dst) d (SCM_UVECTOR src) a0 a1 b0 b1)]
+        [else
+         (unless (SCM_VECTORP dst) (SCM_TYPE_ERROR dst "vector"))
+         (unless (and (SCM_VECTORP dkeys) (SCM_VECTORP skeys)
+                      (== (SCM_VECTOR_SIZE dkeys) (SCM_VECTOR_SIZE dst))
+                      (== (SCM_VECTOR_SIZE skeys) (SCM_VECTOR_SIZE src)))
+           (Scm_Error "merge keys mismatch: %S, %S" dkeys skeys))
+         (let* ([s::ScmObj* (SCM_VECTOR_ELEMENTS src)]
+                [sk::ScmObj* (SCM_VECTOR_ELEMENTS skeys)])
+           (Scm_MergeByKeys (+ (SCM_VECTOR_ELEMENTS dst) d)
+                            (+ (SCM_VECTOR_ELEMENTS dkeys) d)
+                            (+ s a0) (+ sk a0) (- a1 a0)
+                            (+ s b0) (+ sk b0) (- b1 b0)))]))
+
@@ -179,6 +179,42 @@
          [e::ScmObj (Scm_ApplyRec2 (-> c eqFn) (SCM_OBJ a) (SCM_OBJ b))])
     (return (not (SCM_FALSEP e)))))
 
+
+;; For comparators whose equality predicate is a builtin one, we use
+;; the builtin hash function and comparison of the corresponding type.
+(define-cfn builtin-hash-type (c::ScmComparator*) ::int :static
+  (case (logand (-> c flags) SCM_COMPARATOR_EQUIV_MASK)
+    [(SCM_COMPARATOR_EQUIV_EQ)     (return SCM_HASH_EQ)]
+    [(SCM_COMPARATOR_EQUIV_EQV)    (return SCM_HASH_EQV)]
+    [(SCM_COMPARATOR_EQUIV_EQUAL)  (return SCM_HASH_EQUAL)]
+    [(SCM_COMPARATOR_EQUIV_STRING) (return SCM_HASH_STRING)]
+    [else (return -1)]))
+
+(define-cfn builtin-hashtable-hash-typecheck (h::(const ScmHashCore*)
+                                              key::intptr_t)
+  ::u_long :static
+  (let* ([c::ScmComparator* (cast ScmComparator* (-> h data))]
+         [type::int (builtin-hash-type c)]
+         [hashfn::ScmHashProc* NULL]
+         [cmpfn::ScmHashCompareProc* NULL])
+    (unless (logand (-> c flags) SCM_COMPARATOR_ANY_TYPE)
+      (when (SCM_FALSEP (Scm_ApplyRec1 (-> c typeFn) (SCM_OBJ key)))
+        (Scm_Error "Invalid key for hashtable: %S" (SCM_OBJ key))))
+    (when (and (== type SCM_HASH_STRING) (not (SCM_STRINGP (SCM_OBJ key))))
+      (Scm_Error "Invalid key for hashtable: %S" (SCM_OBJ key)))
+    (Scm_HashCoreTypeToProcs type (& hashfn) (& cmpfn))
+    (return (hashfn h key))))
+
+;; NB: a has gone through builtin-hashtable-hash-typecheck.
+(define-cfn builtin-hashtable-eq (h::(const ScmHashCore*)
+                                  a::intptr_t b::intptr_t)
+  ::int :static
+  (let* ([c::ScmComparator* (cast ScmComparator* (-> h data))]
+         [hashfn::ScmHashProc* NULL]
+         [cmpfn::ScmHashCompareProc* NULL])
+    (Scm_HashCoreTypeToProcs (builtin-hash-type c) (& hashfn) (& cmpfn))
+    (return (cmpfn h a b))))
+
 (define-cfn generic-hashtable-eq-typecheck (h::(const ScmHashCore*)
                                             a::intptr_t b::intptr_t)
   ::int :static
@@ -197,15 +233,28 @@
 (define-cproc %make-hash-table-from-comparator (comparator::<comparator>
                                                 init-size::<int>
                                                 has-type-check::<boolean>)
-  (if has-type-check
-    (return (Scm_MakeHashTableFull generic-hashtable-hash-typecheck
-                                   generic-hashtable-eq-typecheck
-                                   init-size
-                                   comparator))
-    (return (Scm_MakeHashTableFull generic-hashtable-hash
-                                   generic-hashtable-eq
-                                   init-size
-                                   comparator))))
+  (let* ([type::int (builtin-hash-type comparator)])
+    (cond
+     [(and (>= type 0) (not has-type-check) (!= type SCM_HASH_STRING))
+      (let* ([hashfn::ScmHashProc* NULL]
+             [cmpfn::ScmHashCompareProc* NULL])
+        (Scm_HashCoreTypeToProcs type (& hashfn) (& cmpfn))
+        (return (Scm_MakeHashTableFull hashfn cmpfn init-size comparator)))]
+     [(>= type 0)
+      (return (Scm_MakeHashTableFull builtin-hashtable-hash-typecheck
+                                     builtin-hashtable-eq
+                                     init-size
+                                     comparator))]
+     [has-type-check
+      (return (Scm_MakeHashTableFull generic-hashtable-hash-typecheck
+                                     generic-hashtable-eq-typecheck
+                                     init-size
+                                     comparator))]
+     [else
+      (return (Scm_MakeHashTableFull generic-hashtable-hash
+                                     generic-hashtable-eq
+                                     init-size
+                                     comparator))])))
 
 ;; Comparator argument can be <comparator> or one of the symbols
 ;; eq?, eqv?, equal? or string=?.
@@ -265,6 +314,13 @@
 (define-cproc hash-table-clear! (hash::<hash-table>) ::<void>
   (Scm_HashCoreClear (SCM_HASH_TABLE_CORE hash)))
 
+(define-cproc hash-table-reserve! (hash::<hash-table> n::<fixnum>) ::<void>
+  (when (< n 0) (Scm_Error "non-negative integer required, but got: %ld" n))
+  (Scm_HashCoreReserve (SCM_HASH_TABLE_CORE hash) (cast int n)))
+
+(define-cproc hash-table-compact! (hash::<hash-table>) ::<void>
+  (Scm_HashCoreCompact (SCM_HASH_TABLE_CORE hash)))
+
 (define-cproc hash-table-get (hash::<hash-table> key :optional fallback)
   (dict-get hash Scm_HashTableRef))
 
@@ -320,6 +376,7 @@
 ;; conversion to/from hash-table
 (define (alist->hash-table a . opt-cmpr)
   (rlet1 tb (apply make-hash-table opt-cmpr)
+    (hash-table-reserve! tb (length a))
     (for-each (^x (hash-table-put! tb (car x) (cdr x))) a)))
 
 (define (hash-table->alist h)
@@ -343,19 +400,33 @@
          (Scm_Error "compare procedure of tree-map's comparator %S returned \
                      non-integral value: %S" cmpr r))
        (return (SCM_INT_VALUE r)))))
+ ;; Used instead of tree-map-cmp if the comparator's comparison procedure
+ ;; is the builtin compare.  core->data also contains the comparator.
+ (define-cfn tree-map-builtin-cmp (core::ScmTreeCore* x::intptr_t y::intptr_t)
+   ::int :static
+   (return (Scm_Compare (SCM_OBJ x) (SCM_OBJ y))))
  )
 
-(define-cproc %make-tree-map (comparator)
+(define-cproc %make-tree-map (comparator :optional (btree::<boolean> #f))
   (begin
     (SCM_ASSERT (SCM_COMPARATORP comparator))
-    (return (Scm_MakeTreeMap tree_map_cmp comparator))))
+    (return (Scm_MakeTreeMapWithType (?: btree
+                                         SCM_TREE_CORE_BTREE
+                                         SCM_TREE_CORE_RBTREE)
+                                     (?: (logand (-> (SCM_COMPARATOR comparator)
+                                                     flags)
+                                                 SCM_COMPARATOR_BUILTIN_COMPARE)
+                                         tree_map_builtin_cmp
+                                         tree_map_cmp)
+                                     comparator))))
 
 ;; TODO: We do want to return something even for tree-maps that aren't
 ;; created from the Scheme world.  But how?
 (define-cproc tree-map-comparator (tm::<tree-map>)
   (let* ([d::void* (-> (SCM_TREE_MAP_CORE tm) data)])
     (if (or (== d NULL)
-            (!= (-> (SCM_TREE_MAP_CORE tm) cmp) tree-map-cmp))
+            (and (!= (-> (SCM_TREE_MAP_CORE tm) cmp) tree-map-cmp)
+                 (!= (-> (SCM_TREE_MAP_CORE tm) cmp) tree-map-builtin-cmp)))
       (return SCM_FALSE)
       (begin
         (SCM_ASSERT (SCM_COMPARATORP d))
@@ -432,6 +503,37 @@
 (define-cproc tree-map-clear! (tm::<tree-map>) ::<void>
   (Scm_TreeCoreClear (SCM_TREE_MAP_CORE tm)))
 
+;; Order statistics and range operations
+(define-cproc tree-map-nth (tm::<tree-map> n::<fixnum>)
+  (let* ([core::ScmTreeCore* (SCM_TREE_MAP_CORE tm)]
+         [e::ScmDictEntry* NULL])
+    (when (and (>= n 0) (< n (Scm_TreeCoreNumEntries core)))
+      (set! e (Scm_TreeCoreNth core (cast int n))))
+    (if e
+      (return (Scm_Cons (SCM_DICT_KEY e) (SCM_DICT_VALUE e)))
+      (return '#f))))
+
+(define-cproc tree-map-count-range (tm::<tree-map> lo hi) ::<int>
+  (let* ([core::ScmTreeCore* (SCM_TREE_MAP_CORE tm)]
+         [i::int (Scm_TreeCoreRank core (cast intptr_t lo))]
+         [j::int (Scm_TreeCoreRank core (cast intptr_t hi))])
+    (return (?: (< i j) (- j i) 0))))
+
+(define-cproc tree-map-delete-range! (tm::<tree-map> lo hi) ::<int>
+  (return (Scm_TreeCoreDeleteRange (SCM_TREE_MAP_CORE tm)
+                                   (cast intptr_t lo) (cast intptr_t hi))))
+
+(define-cproc tree-map-split! (tm::<tree-map> key)
+  (let* ([core::ScmTreeCore* (SCM_TREE_MAP_CORE tm)]
+         [r (Scm_MakeTreeMapWithType (-> core type) (-> core cmp)
+                                     (-> core data))])
+    (Scm_TreeCoreSplit core (cast intptr_t key) (SCM_TREE_MAP_CORE r))
+    (return r)))
+
+(define-cproc tree-map-join! (tm::<tree-map> src::<tree-map>)
+  (Scm_TreeCoreJoin (SCM_TREE_MAP_CORE tm) (SCM_TREE_MAP_CORE src))
+  (return (SCM_OBJ tm)))
+
 (inline-stub
  ;;
  ;; Finds the entry closest to the given key
@@ -288,6 +288,11 @@
 ;;   NB: find-file-in-paths in file.util is similar to this, but this one
 ;;   captures the exact behavior of `load'.
 (select-module gauche.internal)
+;; Returns the found path, #f if not found, or #t if DIR isn't a directory.
+(define-cproc %find-file-in-directory (dir::<string> filename::<string>
+                                       suffixes)
+  Scm__FindFileInDirectory)
+
 (define (find-load-file filename paths suffixes
                         :key (error-if-not-found #f)
                              (allow-archive #f)
@@ -310,16 +315,18 @@
      [(null? ps)
       (and error-if-not-found
            (errorf "cannot find ~s in ~s" filename paths))]
-     [(file-is-directory? (car ps))
-      (if-let1 found (try-suffixes (string-append (car ps) "/" filename))
-        (list found (cdr ps))
-        (do-relative (cdr ps)))]
-     [(and allow-archive
-           (or (equal? (car ps) "") (file-is-regular? (car ps))))
-      (if-let1 r (any (^p (p (car ps) filename suffixes)) *load-path-hooks*)
-        (list (car r) (cdr ps) (cdr r))
-        (do-relative (cdr ps)))]
-     [else (do-relative (cdr ps))]))
+     [else
+      (let1 found (%find-file-in-directory (car ps) filename suffixes)
+        (cond [(string? found) (list found (cdr ps))]
+              [(not found) (do-relative (cdr ps))]
+              ;; (car ps) isn't a directory
+              [(and allow-archive
+                    (or (equal? (car ps) "") (file-is-regular? (car ps))))
+               (if-let1 r (any (^p (p (car ps) filename suffixes))
+                               *load-path-hooks*)
+                 (list (car r) (cdr ps) (cdr r))
+                 (do-relative (cdr ps)))]
+              [else (do-relative (cdr ps))]))]))
 
   (when (equal? filename "")
     (error "bad filename to load" filename))
@@ -495,7 +502,25 @@
     (list ':bytes-since-gc
           (Scm_MakeIntegerFromUI (cast u_long (GC_get_bytes_since_gc))))
     (list ':total-bytes
-          (Scm_MakeIntegerFromUI (cast u_long (GC_get_total_bytes)))))))
+          (Scm_MakeIntegerFromUI (cast u_long (GC_get_total_bytes))))
+    (list ':heap-sections
+          (Scm_MakeIntegerFromUI (cast u_long (GC_get_heap_sects_count)))))))
+
+;; API
+(define-cproc gc-event-stat () Scm_GCEventStat)
+(define-cproc gc-pause-histogram () Scm_GCPauseHistogram)
+(define-cproc gc-recent-events () Scm_GCRecentEvents)
+(define-cproc set-gc-event-handler! (handler) ::<void> Scm_SetGCEventHandler)
+
+;; API
+(define-cproc gc-configuration () Scm_GCConfiguration)
+(define-cproc gc-configure! (:rest kvs) ::<void>
+  (let* ([cp kvs])
+    (while (SCM_PAIRP cp)
+      (unless (and (SCM_KEYWORDP (SCM_CAR cp)) (SCM_PAIRP (SCM_CDR cp)))
+        (Scm_Error "keyword-value list required, but got: %S" kvs))
+      (Scm_GCConfigure (SCM_CAR cp) (SCM_CADR cp))
+      (set! cp (SCM_CDDR cp)))))
 
 (select-module gauche.internal)
 ;; for diagnostics
@@ -565,6 +590,30 @@
   (:optional (vm::<thread> (c "SCM_OBJ(Scm_VM())"))) ::<void>
   (Scm_VMDump vm))
 
+;; API
+(define-cproc vm-stack-size
+  (:optional (vm::<thread> (c "SCM_OBJ(Scm_VM())"))) ::<long>
+  (return (-> vm stackSize)))
+
+;; API
+;; Returns the number of times the VM stack is flushed to the heap
+(define-cproc vm-stack-overflow-count
+  (:optional (vm::<thread> (c "SCM_OBJ(Scm_VM())"))) ::<ulong>
+  (return (-> vm stat sovCount)))
+
+;; API
+;; Returns the event counters of the VM; see Scm_VMStats.
+(define-cproc vm-stats
+  (:optional (vm::<thread> (c "SCM_OBJ(Scm_VM())")))
+  Scm_VMStats)
+
+(define-cproc vm-stats-reset!
+  (:optional (vm::<thread> (c "SCM_OBJ(Scm_VM())"))) ::<void>
+  Scm_VMStatsReset)
+
+(define-cproc vm-stats-count-allocation! (flag::<boolean>) ::<void>
+  Scm_VMStatCountAllocation)
+
 ;; API
 (define-cproc vm-get-stack-trace
   (:optional (vm::<thread> (c "SCM_OBJ(Scm_VM())")))
@@ -657,6 +706,29 @@
           (ref loc initialValue) init-value)
     (return (Scm_ParameterSet (Scm_VM) (& loc) new-value))))
 
+;; INDICES, INIT-VALUES and VALUES are lists of the same length.
+;; VALUES must already be filtered.
+(define-cproc %vm-parameterize (indices::<list> init-values::<list>
+                                values::<list> thunk)
+  (let* ([n::int (Scm_Length indices)])
+    (unless (and (== (Scm_Length init-values) n)
+                 (== (Scm_Length values) n))
+      (Scm_Error "%%vm-parameterize: list length mismatch: %S, %S, %S"
+                 indices init-values values))
+    (let* ([locs::ScmParameterLoc* (SCM_NEW_ARRAY ScmParameterLoc n)]
+           [vals::ScmObj* (SCM_NEW_ARRAY ScmObj n)]
+           [i::int 0])
+      (dolist [index indices]
+        (unless (SCM_INTP index)
+          (Scm_Error "%%vm-parameterize: bad parameter index: %S" index))
+        (set! (ref (aref locs i) index) (SCM_INT_VALUE index)
+              (ref (aref locs i) initialValue) (SCM_CAR init-values)
+              (aref vals i) (SCM_CAR values)
+              init-values (SCM_CDR init-values)
+              values (SCM_CDR values))
+        (post++ i))
+      (return (Scm_VMParameterize n locs vals thunk)))))
+
 ;; TRANSIENT
 ;; For the backward compatibility---files precompiled by 0.9.2 or before
 ;; can contain reference to the old API (as the result of expansion of
@@ -55,6 +55,11 @@
     (result (Scm_VMWithGuardHandler handler thunk))
     (result (Scm_VMWithErrorHandler handler thunk))))
 
+;; Used by the expansion of guard.  HANDLER and THUNK are lambdas
+;; generated by the macro, so we skip argument checks and keyword parsing.
+(define-cproc %with-guard-handler (handler thunk)
+  (result (Scm_VMWithGuardHandler handler thunk)))
+
 (define-cproc report-error (exception :optional port)
   ;; TRANSIENT: change this to Scm_ReportError when switching API to 0.95.
   Scm_ReportError2)
@@ -461,6 +461,24 @@
         (unless (fr-args-used? argptr)
           (errorf "Too many arguments given to format string ~s" fmtstr))))))
 
+;; Formatter cache
+;; Most format strings are literals, so the same string object is passed
+;; over and over.  We keep a small direct-mapped cache keyed by the identity
+;; of immutable format strings, so that we don't need to parse them every
+;; time.  An entry is replaced by a single vector-set!, so we don't need
+;; a lock.
+(define *formatter-cache* (make-vector 64 #f))
+
+(define (formatter-compile/cache fmtstr)
+  (if (string-immutable? fmtstr)
+    (let* ([i (modulo (eq-hash fmtstr) (vector-length *formatter-cache*))]
+           [e (vector-ref *formatter-cache* i)])
+      (if (and e (eq? (car e) fmtstr))
+        (cdr e)
+        (rlet1 f (formatter-compile fmtstr)
+          (vector-set! *formatter-cache* i (cons fmtstr f)))))
+    (formatter-compile fmtstr)))
+
 (define (call-formatter shared? locking? formatter port ctrl args)
   (cond [((with-module gauche.internal %port-write-state) port)
          ;; We're in middle of shared writing.
@@ -474,14 +492,16 @@
         [else (formatter args port ctrl)]))
 
 (define (format-2 shared? out control fmtstr args)
-  (let1 formatter (formatter-compile fmtstr)
-    (case out
-      [(#t)
-       (call-formatter shared? #t formatter (current-output-port) control args)]
-      [(#f) (let1 out (open-output-string)
-              (call-formatter shared? #f formatter out control args)
-              (get-output-string out))]
-      [else (call-formatter shared? #t formatter out control args)])))
+  (format-3 shared? out control (formatter-compile/cache fmtstr) args))
+
+(define (format-3 shared? out control formatter args)
+  (case out
+    [(#t)
+     (call-formatter shared? #t formatter (current-output-port) control args)]
+    [(#f) (let1 out (open-output-string)
+            (call-formatter shared? #f formatter out control args)
+            (get-output-string out))]
+    [else (call-formatter shared? #t formatter out control args)]))
 
 ;; handle optional destination arg
 (define (format-1 shared? args)
@@ -508,3 +528,15 @@
 ;; API
 (define-in-module gauche (format . args) (format-1 #f args))
 (define-in-module gauche (format/ss . args) (format-1 #t args))
+
+;; Explicitly pre-compiled format string
+;; ((formatter fmtstr) dest arg ...) == (format dest fmtstr arg ...)
+(define-in-module gauche (formatter fmtstr :optional (controls #f))
+  (unless (string? fmtstr)
+    (error "format string required, but got:" fmtstr))
+  (let1 fmt (formatter-compile fmtstr)
+    (^[dest . args]
+      (unless (or (boolean? dest) (port? dest))
+        (error "formatter: destination must be a boolean or a port, but got:"
+               dest))
+      (format-3 #f dest controls fmt args))))
@@ -111,6 +111,12 @@
     (return (?: (< i 0) SCM_FALSE (Scm_MakeInteger i)))))
 (define-cproc port-fd-dup! (dst::<port> src::<port>) ::<void> Scm_PortFdDup)
 
+;; Used by copy-port.  Returns #f if SRC and DST aren't both file ports.
+(define-cproc %port-copy-fd (src::<input-port> dst::<output-port>
+                             limit::<fixnum>)
+  (let* ([n::ScmSmallInt (Scm_PortCopyFd src dst limit)])
+    (return (?: (< n 0) SCM_FALSE (Scm_MakeInteger n)))))
+
 (define-cproc port-attribute-set! (port::<port> key val)
   Scm_PortAttrSet)
 (define-cproc port-attribute-ref (port::<port> key :optional fallback)
@@ -140,6 +146,11 @@
            port (Scm_BufferingMode mode (-> port direction) -1)))
   (return (Scm_GetPortBufferingModeAsKeyword port)))
 
+(define-cproc port-nonblocking? (port::<port>) ::<boolean>
+  (setter (port::<port> flag::<boolean>) ::<void>
+          (Scm_SetPortNonblocking port flag))
+  Scm_GetPortNonblocking)
+
 (define-cproc port-case-fold-set! (port::<port> flag::<boolean>) ::<void>
   (if flag
     (logior= (SCM_PORT_FLAGS port) SCM_PORT_CASE_FOLD)
@@ -185,21 +196,46 @@
 (define-cproc %open-input-file (path::<string>
                                 :key (if-does-not-exist :error)
                                 (buffering #f)
+                                (buffer-size::<fixnum> 0)
+                                (access-pattern #f)
                                 (element-type :character))
-  (let* ([ignerr::int FALSE])
+  (let* ([ignerr::int FALSE]
+         [access::int SCM_PORT_ACCESS_NORMAL])
     (cond [(SCM_FALSEP if-does-not-exist) (set! ignerr TRUE)]
           [(not (SCM_EQ if-does-not-exist ':error))
            (Scm_TypeError ":if-does-not-exist" ":error or #f"
                           if-does-not-exist)])
+    (cond [(SCM_FALSEP access-pattern)]
+          [(SCM_EQ access-pattern 'sequential)
+           (set! access SCM_PORT_ACCESS_SEQUENTIAL)]
+          [(SCM_EQ access-pattern 'random)
+           (set! access SCM_PORT_ACCESS_RANDOM)]
+          [else (Scm_TypeError ":access-pattern" "sequential, random or #f"
+                               access-pattern)])
+    (when (or (< buffer-size 0) (> buffer-size INT_MAX))
+      (Scm_Error "buffer-size out of range: %ld" buffer-size))
     (let* ([bufmode::int (Scm_BufferingMode buffering SCM_PORT_INPUT
                                             SCM_PORT_BUFFER_FULL)]
-           [o (Scm_OpenFilePort (Scm_GetStringConst path)
-                                O_RDONLY bufmode 0)])
+           [o (Scm_OpenFilePortWithHints (Scm_GetStringConst path)
+                                         O_RDONLY bufmode 0
+                                         buffer-size access)])
       (when (and (SCM_FALSEP o) (not (%open/allow-noexist? ignerr)))
         (Scm_SysError "couldn't open input file: %S" path))
       (return o))))
 
 ;; Primitive open routine.  The Scheme wrapper handles other keyword args
+(define-cproc open-input-mmap-file (path::<string>
+                                   :key (if-does-not-exist :error))
+  (let* ([ignerr::int FALSE])
+    (cond [(SCM_FALSEP if-does-not-exist) (set! ignerr TRUE)]
+          [(not (SCM_EQ if-does-not-exist ':error))
+           (Scm_TypeError ":if-does-not-exist" ":error or #f"
+                          if-does-not-exist)])
+    (let* ([o (Scm_OpenMmapFilePort (Scm_GetStringConst path))])
+      (when (and (SCM_FALSEP o) (not (%open/allow-noexist? ignerr)))
+        (Scm_SysError "couldn't open input file: %S" path))
+      (return o))))
+
 (define-cproc %open-output-file (path::<string>
                                  :key (if-exists :supersede)
                                  (if-does-not-exist :create)
@@ -345,6 +381,11 @@
 (define-cproc get-remaining-input-string (iport::<input-port>)
   (return (Scm_GetRemainingInputString iport 0)))
 
+;; Used when the port is discarded right after; avoids copying the content.
+(select-module gauche.internal)
+(define-cproc %take-output-string (oport::<output-port>)
+  (return (Scm_TakeOutputString oport 0)))
+
 ;; Coding aware port
 (select-module gauche)
 
@@ -560,6 +601,13 @@
              (return (Scm_MakeString buf nread nread SCM_STRING_INCOMPLETE))]
             ))))
 
+;; Returns a u8vector sharing the port buffer; valid until the next read.
+(define-cproc read-block-view (bytes::<fixnum>
+                               :optional (port::<input-port> (current-input-port)))
+  (when (< bytes 0)
+    (Scm_Error "bytes must be non-negative integer: %ld" bytes))
+  (return (Scm_ReadBlockView port bytes)))
+
 (define-cproc read-list (closer::<char>
                          :optional (port (current-input-port)))
   (return (Scm_ReadList port closer)))
@@ -721,6 +769,10 @@
   (SCM_PUTB byte port)
   (return 1))
 
+(define-cproc write-gather (items
+                            :optional (port::<output-port> (current-output-port)))
+  ::<void> Scm_WriteGather)
+
 (define-cproc write-limited (obj limit::<fixnum>
                                  :optional (port (current-output-port)))
   ::<int> (return (Scm_WriteLimited obj port SCM_WRITE_WRITE limit)))
@@ -897,7 +949,7 @@
 (define-in-module gauche (with-output-to-string thunk)
   (let1 out (open-output-string)
     (with-output-to-port out thunk)
-    (get-output-string out)))
+    (%take-output-string out)))
 
 (define-in-module gauche (with-input-from-string str thunk)
   (with-input-from-port (open-input-string str) thunk))
@@ -905,7 +957,7 @@
 (define-in-module gauche (call-with-output-string proc)
   (let1 out (open-output-string)
     (proc out)
-    (get-output-string out)))
+    (%take-output-string out)))
 
 (define-in-module gauche (call-with-input-string str proc)
   (proc (open-input-string str)))
@@ -914,7 +966,7 @@
   (let ([out (open-output-string)]
         [in  (open-input-string str)])
     (proc in out)
-    (get-output-string out)))
+    (%take-output-string out)))
 
 (define-in-module gauche (with-string-io str thunk)
   (with-output-to-string (cut with-input-from-string str thunk)))
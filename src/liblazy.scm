@@ -70,6 +70,8 @@
             ;; some other thread; handle it.
             [else (result SCM_EOF SCM_FALSE)]))))
 
+(define-cproc %chunk->lseq (chunk chunkgen) Scm_ChunkToLazySeq)
+
 (define-cproc %force-lazy-pair (lp)
   (if (SCM_LAZY_PAIR_P lp)
     (result (Scm_ForceLazyPair (SCM_LAZY_PAIR lp)))
@@ -98,6 +100,34 @@
         (%make-lazy-pair item (car args))
         (cons item (rec (car args) (cdr args)))))))
 
+;; Chunked version
+;;   GEN returns a vector, a uvector or a string at a time, and EOF at
+;;   the end.  Each chunk is unrolled into ordinary pairs when forced,
+;;   so most elements can be accessed without forcing a lazy pair.
+;;   The chunk isn't retained, so GEN may reuse the same buffer.
+(define-in-module gauche (chunked-generator->lseq gen)
+  (let loop ()
+    (let1 chunk (gen)
+      (if (eof-object? chunk)
+        '()
+        (or (%chunk->lseq chunk gen) (loop))))))
+
+;; Returns a chunk generator that reads items from PORT with READER.
+;; We read ahead only the input already available, so that a sequence
+;; on an interactive port doesn't block more than the unchunked one.
+(define (%port-chunk-generator reader port)
+  (define size 64)
+  (define buf (make-vector size))
+  (define eof? #f)
+  (^[] (let loop ([i 0])
+         (cond [(= i size) buf]
+               [(or eof? (and (> i 0) (not (char-ready? port))))
+                (if (= i 0) (eof-object) (vector-copy buf 0 i))]
+               [else (let1 x (reader port)
+                       (if (eof-object? x)
+                         (begin (set! eof? #t) (loop i))
+                         (begin (vector-set! buf i x) (loop (+ i 1)))))]))))
+
 ;; For convenience.
 (define-in-module gauche (lrange start :optional (end +inf.0) (step 1))
   ;; Exact numbers.  Fast way.
@@ -143,11 +173,11 @@
     (generator->lseq gen)))
 
 (define-in-module gauche (port->char-lseq :optional (port (current-input-port)))
-  (generator->lseq (cut read-char port)))
+  (chunked-generator->lseq (%port-chunk-generator read-char port)))
 (define-in-module gauche (port->byte-lseq :optional (port (current-input-port)))
   (generator->lseq (cut read-byte port)))
 (define-in-module gauche (port->string-lseq :optional (port (current-input-port)))
-  (generator->lseq (cut read-line port)))
+  (chunked-generator->lseq (%port-chunk-generator read-line port)))
 (define-in-module gauche (port->sexp-lseq :optional (port (current-input-port)))
   (generator->lseq (cut read port)))
 
@@ -248,9 +248,7 @@
 
 (define-cproc + (:rest args) ::<number> :fast-flonum
   (cond [(not (SCM_PAIRP args)) (return (SCM_MAKE_INT 0))]
-        [else (let* ([r::ScmObj (SCM_CAR args)])
-                (dolist [v (SCM_CDR args)] (set! r (Scm_Add r v)))
-                (return r))]))
+        [else (return (Scm_AddList args))]))
 
 (define-cproc - (arg1 :rest args) ::<number> :fast-flonum
   (if (SCM_NULLP args)
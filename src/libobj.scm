@@ -60,13 +60,16 @@
 ;;   to make a method specialized for <class>, i.e. the most common "make".
 ;;   However, we can't say (make <method> ...) before we have a make method.
 ;;   So we have to "hard wire" the method creation.
+;;   The body first tries %make-instance-fast, which bypasses
+;;   allocate-instance and initialize when neither is customized.
 
 (let ([%make (^[class . initargs]
                (rlet1 obj (allocate-instance class initargs)
                  (initialize obj initargs)))]
       [body  (^[class initargs next-method]
-               (rlet1 obj (allocate-instance class initargs)
-                 (initialize obj initargs)))])
+               (or (%make-instance-fast class initargs)
+                   (rlet1 obj (allocate-instance class initargs)
+                     (initialize obj initargs))))])
   (add-method! make
                (%make <method>
                       :generic make
@@ -561,6 +564,10 @@
 (define-cproc %finish-class-initialization! (klass::<class>) ::<void>
   (Scm_ClassMalleableSet klass FALSE))
 
+;; Returns #f if the fast path isn't applicable.  See class.c.
+(define-cproc %make-instance-fast (klass::<class> initargs)
+  Scm__MakeInstanceFast)
+
 ;;
 ;; Record related builtins
 ;;
@@ -579,15 +586,66 @@
     (return (Scm__AllocateAndInitializeInstance klass v n 0))))
 
 (define-cproc %record-ref (klass::<class> obj k::<fixnum>)
+  ;; The common case is that OBJ is a direct instance of KLASS, for which
+  ;; we can check the index against KLASS and load the slot directly.
+  (when (and (SCM_XTYPEP obj klass)
+             (<= 0 k) (< k (-> klass numInstanceSlots)))
+    (return (aref (SCM_INSTANCE_SLOTS obj) k)))
   (unless (SCM_ISA obj klass)
     (Scm_Error "record-ref: instance of %S expected, got %S" klass obj))
   (return (Scm_InstanceSlotRef obj k)))
 
 (define-cproc %record-set! (klass::<class> obj k::<fixnum> val) ::<void>
+  (when (and (SCM_XTYPEP obj klass)
+             (<= 0 k) (< k (-> klass numInstanceSlots)))
+    (set! (aref (SCM_INSTANCE_SLOTS obj) k) val)
+    (return))
   (unless (SCM_ISA obj klass)
     (Scm_Error "record-set!: instance of %S expected, got %S" klass obj))
   (Scm_InstanceSlotSet obj k val))
 
+;; Called by the constructors of records with typed fields, after the
+;; slots are filled by the initial values.  SPECS is a vector of
+;; #(index type offset name), where type is 0 (fixnum), 1 (u8) or
+;; 2 (flonum).  The flonum fields share one f64vector of NFLO elements,
+;; which is stored in each of their slots; OFFSET is the field's
+;; position in it.  Uninitialized flonum fields become 0.0.
+(define-cproc %record-unbox-fields! (obj specs::<vector> nflo::<fixnum>)
+  ::<void>
+  (let* ([slots::ScmObj* (SCM_INSTANCE_SLOTS obj)]
+         [fv (?: (> nflo 0)
+                 (Scm_MakeUVector SCM_CLASS_F64VECTOR nflo NULL)
+                 SCM_FALSE)]
+         [n::ScmSmallInt (SCM_VECTOR_SIZE specs)])
+    (dotimes [i n]
+      (let* ([s (SCM_VECTOR_ELEMENT specs i)]
+             [k::ScmSmallInt (SCM_INT_VALUE (SCM_VECTOR_ELEMENT s 0))]
+             [type::int (SCM_INT_VALUE (SCM_VECTOR_ELEMENT s 1))]
+             [v (aref slots k)]
+             [unset::int (or (SCM_UNBOUNDP v) (SCM_UNDEFINEDP v))])
+        (case type
+          [(0) (unless (or unset (SCM_INTP v))
+                 (Scm_Error "fixnum required for field %S of %S, but got %S"
+                            (SCM_VECTOR_ELEMENT s 3) (Scm_ClassOf obj) v))]
+          [(1) (unless (or unset
+                           (and (SCM_INTP v)
+                                (<= 0 (SCM_INT_VALUE v))
+                                (<= (SCM_INT_VALUE v) 255)))
+                 (Scm_Error "u8 required for field %S of %S, but got %S"
+                            (SCM_VECTOR_ELEMENT s 3) (Scm_ClassOf obj) v))]
+          [(2) (let* ([off::ScmSmallInt
+                       (SCM_INT_VALUE (SCM_VECTOR_ELEMENT s 2))])
+                 (cond [unset
+                        (set! (aref (SCM_F64VECTOR_ELEMENTS fv) off) 0.0)]
+                       [(SCM_REALP v)
+                        (set! (aref (SCM_F64VECTOR_ELEMENTS fv) off)
+                              (Scm_GetDouble v))]
+                       [else
+                        (Scm_Error "real required for field %S of %S, but got %S"
+                                   (SCM_VECTOR_ELEMENT s 3) (Scm_ClassOf obj)
+                                   v)])
+                 (set! (aref slots k) fv))])))))
+
 (define-cproc touch-instance! (obj) Scm_VMTouchInstance)
 
 ;;----------------------------------------------------------------
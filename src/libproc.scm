@@ -214,11 +214,26 @@
 (define-cproc profiler-start () ::<void> Scm_ProfilerStart)
 (define-cproc profiler-stop  () ::<int>  Scm_ProfilerStop)
 (define-cproc profiler-reset () ::<void> Scm_ProfilerReset)
+(define-cproc profiler-continuous-start () ::<void>
+  Scm_ProfilerContinuousStart)
+(define-cproc profiler-continuous-stop () ::<void>
+  Scm_ProfilerContinuousStop)
+(define-cproc profiler-alloc-start (:optional (interval-kb::<int> 64))
+  ::<void>
+  (Scm_ProfilerAllocStart (* interval-kb 1024)))
+(define-cproc profiler-alloc-stop () ::<void> Scm_ProfilerAllocStop)
 
 (select-module gauche.internal)
 ;; Autoloaded profiler-get-result will use this.
 ;; See lib/gauche/vm/profiler.scm
 (define-cproc profiler-raw-result () Scm_ProfilerRawResult)
+;; Used by profiler-snapshot.
+(define-cproc profiler-raw-snapshot (:optional (all-threads::<boolean> #t))
+  (return (Scm_ProfilerSnapshot all-threads)))
+;; Used by profiler-alloc-snapshot.
+(define-cproc profiler-raw-alloc-snapshot
+  (:optional (all-threads::<boolean> #t))
+  (return (Scm_ProfilerAllocSnapshot all-threads)))
 
 ;;;
 ;;; Introspection
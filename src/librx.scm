@@ -65,6 +65,17 @@
           [else (SCM_TYPE_ERROR regexp "regexp")])
     (return (Scm_RegExec rx str))))
 
+;; These don't create a match object.
+(define-cproc regexp-match? (regexp::<regexp> str::<string>) ::<boolean>
+  Scm_RegMatchP)
+(define-cproc regexp-match-positions! (regexp::<regexp> str::<string>
+                                       v::<s32vector>)
+  Scm_RegMatchPositions)
+
+;; Calls PROC with the stream offset and the match for each match in PORT.
+(define-cproc regexp-search-port (regexp::<regexp> port::<input-port> proc)
+  Scm_RegSearchPort)
+
 (inline-stub
  (define-cise-stmt rxmatchop
    [(_ (exp ...)) (template exp)]
@@ -96,6 +107,20 @@
     (return SCM_NIL)
     (rxmatchop (-> (SCM_REGMATCH match) grpNames))))
 
+;; matching many regexps at once
+(inline-stub
+ (define-type <regexp-set> "ScmRegexpSet*" "regexp set"
+   "SCM_REGEXP_SETP" "SCM_REGEXP_SET")
+ )
+
+(define-cproc make-regexp-set (regexps::<list>) Scm_MakeRegexpSet)
+(define-cproc regexp-set? (obj) ::<boolean> SCM_REGEXP_SETP)
+(define-cproc regexp-set-regexps (set::<regexp-set>) Scm_RegexpSetRegexps)
+
+;; Returns a list of indices of the regexps that match STR.
+(define-cproc regexp-set-matches (set::<regexp-set> str::<string>)
+  Scm_RegexpSetMatches)
+
 (select-module gauche.internal)
 (define-cproc %regexp-dump (rx::<regexp>) ::<void> Scm_RegDump)
 (define-cproc %regmatch-dump (rm::<regmatch>) ::<void> Scm_RegMatchDump)
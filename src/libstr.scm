@@ -65,6 +65,13 @@
 (define-cproc string-append (:rest args) Scm_StringAppend)
 
 (select-module gauche)
+;; Substrings share the storage with the original string.  These
+;; give the string its own storage.
+(define-cproc string-copy-detached (str::<string> :optional start end)
+  (return (Scm_CopyStringDetached
+           (SCM_STRING (Scm_MaybeSubstring str start end)))))
+(define-cproc string-compact! (str::<string>) Scm_StringCompact)
+
 (define-cproc string-join (strs::<list>
                            :optional (delim::<string> " ") (grammar infix))
   (let* ([gm::int 0])
@@ -117,6 +124,21 @@
 (define-cproc %maybe-substring (str::<string> :optional start end)
   Scm_MaybeSubstring)
 
+;; srfi-13 support.  CS is a char or a char-set.
+(define-cproc %string-index (s::<string> cs right?::<boolean> skip?::<boolean>)
+  (return (Scm_StringIndex s cs (logior (?: right? SCM_STRING_INDEX_RIGHT 0)
+                                       (?: skip? SCM_STRING_INDEX_SKIP 0)))))
+(define-cproc %string-trim (s::<string> cs left?::<boolean> right?::<boolean>)
+  (return (Scm_StringTrim s cs (logior (?: left? SCM_STRING_TRIM_LEFT 0)
+                                       (?: right? SCM_STRING_TRIM_RIGHT 0)))))
+(define-cproc %string-tokenize (s::<string> cs) Scm_StringTokenize)
+(define-cproc %string-prefix? (s1::<string> s2::<string>) ::<boolean>
+  Scm_StringPrefixP)
+(define-cproc %string-suffix? (s1::<string> s2::<string>) ::<boolean>
+  Scm_StringSuffixP)
+(define-cproc %string-contains-ci (s1::<string> s2::<string>)
+  Scm_StringContainsCI)
+
 ;; bound argument is for srfi-13
 (define-cproc %hash-string (str::<string> :optional bound) ::<ulong>
   (let* ([modulo::u_long 0])
@@ -165,6 +187,19 @@
                        either string or character" s2)
            (return SCM_UNDEFINED)])))
 
+;; multiple string search
+(inline-stub
+ (define-type <string-matcher> "ScmStringMatcher*" "string matcher"
+   "SCM_STRING_MATCHERP" "SCM_STRING_MATCHER")
+ )
+
+(define-cproc make-string-matcher (strings::<list>) Scm_MakeStringMatcher)
+(define-cproc string-matcher? (obj) ::<boolean> SCM_STRING_MATCHERP)
+
+;; Returns the index of the leftmost match and the matched string.
+(define-cproc string-matcher-scan (m::<string-matcher> s::<string>)
+  Scm_StringMatcherScan)
+
 ;;
 ;; Modifying string
 ;;  They are just for backward compatibility, and they are expensive
@@ -317,6 +352,34 @@
 (define-cproc byte-substring (str::<string> start::<fixnum> end::<fixnum>)
   (return (Scm_Substring str start end TRUE)))
 
+;;
+;; String builders
+;;
+
+(select-module gauche)
+(inline-stub
+ (define-type <string-builder> "ScmStringBuilder*" "string builder"
+   "SCM_STRING_BUILDERP" "SCM_STRING_BUILDER")
+ )
+
+(define-cproc make-string-builder () Scm_MakeStringBuilder)
+(define-cproc string-builder? (obj) ::<boolean> SCM_STRING_BUILDERP)
+
+(define-cproc string-builder-add! (sb::<string-builder> :rest objs) ::<void>
+  (dolist [obj objs] (Scm_StringBuilderAdd sb obj)))
+
+;; Returns #f if the content is incomplete.
+(define-cproc string-builder-length (sb::<string-builder>)
+  (let* ([len::int (ref (-> sb ds) length)])
+    (return (?: (< len 0) SCM_FALSE (SCM_MAKE_INT len)))))
+(define-cproc string-builder-size (sb::<string-builder>) ::<int>
+  (return (Scm_DStringSize (& (-> sb ds)))))
+
+(define-cproc string-builder->string (sb::<string-builder>)
+  (return (Scm_DStringGet (& (-> sb ds)) 0)))
+(define-cproc string-builder-clear! (sb::<string-builder>) ::<void>
+  (Scm_DStringInit (& (-> sb ds))))
+
 ;;
 ;; String pointers
 ;;
@@ -363,6 +363,9 @@
 
 (define-cproc sys-sigwait (mask::<sys-sigset>) ::<int> Scm_SigWait)
 
+(define-cproc sys-signal-notification-fd () ::<int> Scm_SignalNotificationFd)
+(define-cproc sys-signal-notification-drain () Scm_SignalNotificationDrain)
+
 (inline-stub
  (initcode (.if "defined HAVE_SIGWAIT"
                 (Scm_AddFeature "gauche.sys.sigwait" NULL))))
@@ -792,6 +795,31 @@
       (begin (set! SCM_RESULT0 SCM_FALSE)
              (set! SCM_RESULT1 SCM_FALSE)))))
 
+;; Nanosecond counters for instrumentation.  Unlike current-time and
+;; sys-gettimeofday, they don't allocate on 64-bit platforms, where the
+;; result always fits in a fixnum.  Return #f if the system doesn't provide
+;; the clock.
+(inline-stub
+ (define-cfn sec-nsec->integer (sec::u_long nsec::u_long) :static
+   (.if "SIZEOF_LONG >= 8"
+        (return (Scm_MakeIntegerU (+ (* sec 1000000000) nsec)))
+        (return (Scm_Add (Scm_Mul (Scm_MakeIntegerU sec)
+                                  (SCM_MAKE_INT 1000000000))
+                         (Scm_MakeIntegerU nsec)))))
+ )
+
+(define-cproc monotonic-ns ()
+  (let* ([sec::u_long] [nsec::u_long])
+    (if (Scm_ClockGetTimeMonotonic (& sec) (& nsec))
+      (return (sec-nsec->integer sec nsec))
+      (return SCM_FALSE))))
+
+(define-cproc cpu-time-ns ()
+  (let* ([sec::u_long] [nsec::u_long])
+    (if (Scm_ClockGetTimeThreadCPU (& sec) (& nsec))
+      (return (sec-nsec->integer sec nsec))
+      (return SCM_FALSE))))
+
 (define-cproc current-time ()           ;SRFI-18, SRFI-19, SRFI-21
   Scm_CurrentTime)
 
@@ -1295,6 +1323,54 @@
    ) ;; when defined(HAVE_SELECT)
  )
 
+;;---------------------------------------------------------------------
+;; poller (epoll/kqueue)
+
+(inline-stub
+ (define-type <sys-poller> "ScmSysPoller*")
+
+ (when "defined(GAUCHE_POLLER)"
+   (define-cfn poller-flags (flags) ::int :static
+     (let* ([r::int 0])
+       (dolist [f flags]
+         (cond [(or (SCM_EQ f 'r) (SCM_EQ f 'read))
+                (logior= r SCM_SYS_POLL_READ)]
+               [(or (SCM_EQ f 'w) (SCM_EQ f 'write))
+                (logior= r SCM_SYS_POLL_WRITE)]
+               [(or (SCM_EQ f 'x) (SCM_EQ f 'exception))
+                (logior= r SCM_SYS_POLL_EXCEPT)]
+               [(SCM_EQ f 'edge) (logior= r SCM_SYS_POLL_EDGE)]
+               [else (Scm_Error "invalid flag %S, must be one of r, w, x \
+                                 or edge" f)]))
+       (return r)))
+
+   (define-cproc make-sys-poller () Scm_MakeSysPoller)
+
+   (define-cproc sys-poller-set! (poller::<sys-poller> pf flags::<list>)
+     ::<void>
+     (let* ([fd::int (Scm_GetPortFd pf TRUE)])
+       (Scm_SysPollerSet poller fd (poller-flags flags))))
+
+   (define-cproc sys-poller-wait (poller::<sys-poller>
+                                  :optional (timeout #f)
+                                            (maxevents::<fixnum> 256))
+     (let* ([h SCM_NIL] [t SCM_NIL])
+       (dolist [p (Scm_SysPollerWait poller timeout maxevents)]
+         (let* ([e::int (SCM_INT_VALUE (SCM_CDR p))]
+                [fs SCM_NIL])
+           (when (logand e SCM_SYS_POLL_EXCEPT) (set! fs (Scm_Cons 'x fs)))
+           (when (logand e SCM_SYS_POLL_WRITE)  (set! fs (Scm_Cons 'w fs)))
+           (when (logand e SCM_SYS_POLL_READ)   (set! fs (Scm_Cons 'r fs)))
+           (SCM_APPEND1 h t (Scm_Cons (SCM_CAR p) fs))))
+       (return h)))
+
+   (define-cproc sys-poller-close (poller::<sys-poller>) ::<void>
+     Scm_SysPollerClose)
+
+   (initcode (Scm_AddFeature "gauche.sys.poller" NULL))
+   ) ;; when defined(GAUCHE_POLLER)
+ )
+
 ;;---------------------------------------------------------------------
 ;; miscellaneous
 
@@ -192,5 +192,20 @@
   SCM_UVECTOR_IMMUTABLE_P)
 (define-cproc uvector? (obj) ::<boolean> :constant
   SCM_UVECTORP)
+(define-cproc uvector-storage (v::<uvector>)
+  (case (Scm_UVectorStorage v)
+    [(SCM_UVECTOR_STORAGE_MALLOC) (return 'malloc)]
+    [(SCM_UVECTOR_STORAGE_MMAP) (return 'mmap)]
+    [(SCM_UVECTOR_STORAGE_FILE) (return 'file)]
+    [(SCM_UVECTOR_STORAGE_RELEASED) (return 'released)]
+    [else (return 'heap)]))
+(define-cproc uvector-release! (v::<uvector>) ::<void> Scm_UVectorRelease)
+(define-cproc mmap-uvector (klass::<class> path::<const-cstring>
+                            :key (mode 'read) (offset::<integer> 0)
+                                 (length::<fixnum> -1))
+  (return (Scm_MapFileUVector klass path mode
+                              (Scm_IntegerToOffset offset) length)))
+(define-cproc uvector-sync! (v::<uvector> :optional (async::<boolean> #f))
+  ::<void> Scm_UVectorSync)
 
 
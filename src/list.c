@@ -54,9 +54,61 @@ SCM_DEFINE_BUILTIN_CLASS(Scm_NullClass, NULL, NULL, NULL, NULL, list_cpl);
  * CONSTRUCTOR
  */
 
+/*
+ * Pair blocks
+ *
+ *   When we know the length of the list to be created, we allocate
+ *   its pairs as a contiguous block, each cdr pointing to the next pair.
+ *   Traversal walks consecutive memory, and GC handles one object
+ *   per block instead of one per pair.  Since GC recognizes interior
+ *   pointers, a reference to any pair in a block keeps the whole block;
+ *   we cap the block size to limit such retention.
+ *
+ *   The elements are taken from ARRAY if it's not NULL, or from
+ *   the cars of LIS if it's a pair, or FILL otherwise.
+ */
+#define PAIR_BLOCK_MAX 32
+
+static ScmObj make_pair_blocks(ScmSmallInt n, ScmObj *array, ScmObj lis,
+                               ScmObj fill, ScmObj tail)
+{
+    ScmObj head = tail;
+    ScmObj *link = &head;
+
+    while (n > 0) {
+        ScmSmallInt k = (n > PAIR_BLOCK_MAX) ? PAIR_BLOCK_MAX : n;
+        ScmPair *b;
+        if (k < SCM_PAIR_BLOCK_MIN) {
+            b = SCM_NEW_KIND(ScmPair, SCM_ALLOC_PAIR);
+            k = 1;
+        } else {
+            b = (ScmPair*)SCM_MALLOC_KIND(sizeof(ScmPair)*k, SCM_ALLOC_PAIR);
+        }
+        for (ScmSmallInt i=0; i<k; i++) {
+            ScmObj e;
+            if (array) {
+                e = *array++;
+            } else if (SCM_PAIRP(lis)) {
+                e = SCM_CAR(lis);
+                lis = SCM_CDR(lis);
+            } else {
+                e = fill;
+            }
+            SCM_FLONUM_ENSURE_MEM(e);
+            SCM_SET_CAR(&b[i], e);
+            if (i < k-1) SCM_SET_CDR(&b[i], SCM_OBJ(&b[i+1]));
+        }
+        SCM_SET_CDR(&b[k-1], tail);
+        *link = SCM_OBJ(b);
+        link = &SCM_CDR(&b[k-1]);
+        n -= k;
+    }
+    return head;
+}
+
 ScmObj Scm_Cons(ScmObj car, ScmObj cdr)
 {
-    ScmPair *z = SCM_NEW(ScmPair);
+    ScmPair *z = SCM_NEW_KIND(ScmPair, SCM_ALLOC_PAIR);
     /* NB: these ENSURE_MEMs are moved here from vm loop to reduce
        the register pressure there.  In most cases these increases
        just a couple of mask-and-test instructions on the data on
@@ -70,8 +122,8 @@ ScmObj Scm_Cons(ScmObj car, ScmObj cdr)
 
 ScmObj Scm_Acons(ScmObj caar, ScmObj cdar, ScmObj cdr)
 {
-    ScmPair *y = SCM_NEW(ScmPair);
-    ScmPair *z = SCM_NEW(ScmPair);
+    ScmPair *y = SCM_NEW_KIND(ScmPair, SCM_ALLOC_PAIR);
+    ScmPair *z = SCM_NEW_KIND(ScmPair, SCM_ALLOC_PAIR);
     SCM_SET_CAR(y, caar);
     SCM_SET_CDR(y, cdar);
     SCM_SET_CAR(z, SCM_OBJ(y));
@@ -113,13 +165,13 @@ ScmObj Scm_VaList(va_list pvar)
          obj = va_arg(pvar, ScmObj))
     {
         if (SCM_NULLP(start)) {
-            start = SCM_OBJ(SCM_NEW(ScmPair));
+            start = SCM_OBJ(SCM_NEW_KIND(ScmPair, SCM_ALLOC_PAIR));
             SCM_SET_CAR(start, obj);
             SCM_SET_CDR(start, SCM_NIL);
             cp = start;
         } else {
             ScmObj item;
-            item = SCM_OBJ(SCM_NEW(ScmPair));
+            item = SCM_OBJ(SCM_NEW_KIND(ScmPair, SCM_ALLOC_PAIR));
             SCM_SET_CDR(cp, item);
             SCM_SET_CAR(item, obj);
             SCM_SET_CDR(item, SCM_NIL);
@@ -143,12 +195,8 @@ ScmObj Scm_ArrayToList(ScmObj *elts, int nelts)
 
 ScmObj Scm_ArrayToListWithTail(ScmObj *elts, int nelts, ScmObj tail)
 {
-    ScmObj h = SCM_NIL, t = SCM_NIL;
-    if (elts) {
-        for (int i=0; i<nelts; i++) SCM_APPEND1(h, t, *elts++);
-    }
-    if (!SCM_NULLP(tail)) SCM_APPEND(h, t, tail);
-    return h;
+    if (elts == NULL || nelts <= 0) return tail;
+    return make_pair_blocks(nelts, elts, SCM_NIL, SCM_NIL, tail);
 }
 
 ScmObj *Scm_ListToArray(ScmObj list, int *nelts, ScmObj *store, int alloc)
@@ -241,12 +289,10 @@ ScmObj Scm_CopyList(ScmObj list)
 {
     if (!SCM_PAIRP(list)) return list;
 
-    ScmObj start = SCM_NIL, last = SCM_NIL;
-    SCM_FOR_EACH(list, list) {
-        SCM_APPEND1(start, last, SCM_CAR(list));
-    }
-    if (!SCM_NULLP(list)) SCM_SET_CDR(last, list);
-    return start;
+    ScmSmallInt n = 0;
+    ScmObj cp;
+    SCM_FOR_EACH(cp, list) n++;
+    return make_pair_blocks(n, NULL, list, SCM_NIL, cp);
 }
 
 /* Scm_MakeList(len, fill)
@@ -259,11 +305,7 @@ ScmObj Scm_MakeList(ScmSmallInt len, ScmObj fill)
     if (len < 0) {
         Scm_Error("make-list: negative length given: %ld", len);
     }
-    ScmObj start = SCM_NIL, last = SCM_NIL;
-    while (len--) {
-        SCM_APPEND1(start, last, fill);
-    }
-    return start;
+    return make_pair_blocks(len, NULL, SCM_NIL, fill, SCM_NIL);
 }
 
 
@@ -333,14 +375,14 @@ ScmObj Scm_Reverse2(ScmObj list, ScmObj tail)
 {
     if (!SCM_PAIRP(list)) return tail;
 
-    ScmPair *p = SCM_NEW(ScmPair);
+    ScmPair *p = SCM_NEW_KIND(ScmPair, SCM_ALLOC_PAIR);
     SCM_SET_CAR(p, SCM_NIL);
     SCM_SET_CDR(p, tail);
     ScmObj result = SCM_OBJ(p);
     ScmObj cp;
     SCM_FOR_EACH(cp, list) {
         SCM_SET_CAR(result, SCM_CAR(cp));
-        p = SCM_NEW(ScmPair);
+        p = SCM_NEW_KIND(ScmPair, SCM_ALLOC_PAIR);
         SCM_SET_CAR(p, SCM_NIL);
         SCM_SET_CDR(p, result);
         result = SCM_OBJ(p);
@@ -586,13 +628,104 @@ ScmObj Scm_AssocDeleteX(ScmObj elt, ScmObj alist, int cmpmode)
     return alist;
 }
 
-/* DeleteDuplicates.  preserve the order of original list.   N^2 algorithm */
+/* DeleteDuplicates.  preserve the order of original list.
+
+   We search the elements we've kept so far linearly, until their number
+   reaches DEDUP_HASH_THRESHOLD; then we put them in a hash table.  For
+   equal? we can do so only when equal-hash doesn't need to call
+   object-hash and equal? doesn't see through identifiers, so we stay
+   linear once we see an element that doesn't satisfy simply_hashable().
+*/
+#define DEDUP_HASH_THRESHOLD 32
+
+static int simply_hashable(ScmObj obj, int depth)
+{
+    if (!SCM_PTRP(obj) || SCM_NUMBERP(obj) || SCM_STRINGP(obj)
+        || SCM_SYMBOLP(obj) || SCM_KEYWORDP(obj)) return TRUE;
+    if (depth <= 0) return FALSE;
+    if (SCM_PAIRP(obj)) {
+        ScmObj cp;
+        int n = 0;
+        SCM_FOR_EACH(cp, obj) {
+            if (++n > DEDUP_HASH_THRESHOLD) return FALSE;
+            if (!simply_hashable(SCM_CAR(cp), depth-1)) return FALSE;
+        }
+        return simply_hashable(cp, depth-1);
+    }
+    if (SCM_VECTORP(obj)) {
+        ScmSmallInt len = SCM_VECTOR_SIZE(obj);
+        if (len > DEDUP_HASH_THRESHOLD) return FALSE;
+        for (ScmSmallInt i=0; i<len; i++) {
+            if (!simply_hashable(SCM_VECTOR_ELEMENT(obj, i), depth-1)) {
+                return FALSE;
+            }
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+typedef struct dedup_rec {
+    int cmpmode;
+    int state;                  /* 0: linear, 1: hashing, -1: gave up */
+    ScmSmallInt count;
+    ScmHashCore set;
+} dedup;
+
+static void dedup_add(dedup *d, ScmObj obj)
+{
+    ScmDictEntry *e = Scm_HashCoreSearch(&d->set, (intptr_t)obj,
+                                         SCM_DICT_CREATE);
+    (void)SCM_DICT_SET_VALUE(e, SCM_TRUE);
+}
+
+/* Returns TRUE if OBJ is in the kept elements, the list from HEAD until
+   STOP.  Otherwise, record that OBJ will be kept. */
+static int dedup_seen(dedup *d, ScmObj obj, ScmObj head, ScmObj stop)
+{
+    if (d->state >= 0 && d->cmpmode == SCM_CMP_EQUAL
+        && !simply_hashable(obj, 8)) {
+        d->state = -1;
+    }
+    if (d->state == 1) {
+        ScmDictEntry *e = Scm_HashCoreSearch(&d->set, (intptr_t)obj,
+                                             SCM_DICT_GET);
+        if (e) return TRUE;
+        dedup_add(d, obj);
+        return FALSE;
+    }
+
+    ScmObj cp;
+    for (cp = head; SCM_PAIRP(cp) && cp != stop; cp = SCM_CDR(cp)) {
+        if (Scm_EqualM(obj, SCM_CAR(cp), d->cmpmode)) return TRUE;
+    }
+    if (d->state == 0 && ++d->count >= DEDUP_HASH_THRESHOLD) {
+        ScmHashType type = (d->cmpmode == SCM_CMP_EQ) ? SCM_HASH_EQ
+            : (d->cmpmode == SCM_CMP_EQV) ? SCM_HASH_EQV : SCM_HASH_EQUAL;
+        Scm_HashCoreInitSimple(&d->set, type, DEDUP_HASH_THRESHOLD*2, NULL);
+        for (cp = head; SCM_PAIRP(cp) && cp != stop; cp = SCM_CDR(cp)) {
+            dedup_add(d, SCM_CAR(cp));
+        }
+        dedup_add(d, obj);
+        d->state = 1;
+    }
+    return FALSE;
+}
+
+static void dedup_init(dedup *d, int cmpmode)
+{
+    d->cmpmode = cmpmode;
+    d->state = 0;
+    d->count = 0;
+}
 
 ScmObj Scm_DeleteDuplicates(ScmObj list, int cmpmode)
 {
     ScmObj result = SCM_NIL, tail = SCM_NIL, lp;
+    dedup d;
+    dedup_init(&d, cmpmode);
     SCM_FOR_EACH(lp, list) {
-        if (SCM_FALSEP(Scm_Member(SCM_CAR(lp), result, cmpmode))) {
+        if (!dedup_seen(&d, SCM_CAR(lp), result, SCM_NIL)) {
             SCM_APPEND1(result, tail, SCM_CAR(lp));
         }
     }
@@ -602,12 +735,17 @@ ScmObj Scm_DeleteDuplicates(ScmObj list, int cmpmode)
 
 ScmObj Scm_DeleteDuplicatesX(ScmObj list, int cmpmode)
 {
-    ScmObj lp;
-
+    ScmObj lp, prev = SCM_NIL;
+    dedup d;
+    dedup_init(&d, cmpmode);
     SCM_FOR_EACH(lp, list) {
-        ScmObj obj = SCM_CAR(lp);
-        ScmObj tail = Scm_DeleteX(obj, SCM_CDR(lp), cmpmode);
-        if (SCM_CDR(lp) != tail) SCM_SET_CDR(lp, tail);
+        /* The kept elements are the ones from LIST until LP. */
+        if (dedup_seen(&d, SCM_CAR(lp), list, lp)) {
+            SCM_SET_CDR(prev, SCM_CDR(lp));
+            lp = prev;
+        } else {
+            prev = lp;
+        }
     }
     return list;
 }
@@ -42,6 +42,7 @@
 
 #include <ctype.h>
 #include <fcntl.h>
+#include "atomic_ops.h"
 
 /*
  * Load file.
@@ -56,6 +57,10 @@ static struct {
     ScmGloc *load_path_hooks_rec; /* *load-path-hooks*   */
     ScmInternalMutex path_mutex;
 
+    /* Cached directory listings to search load paths */
+    ScmHashCore dir_cache;      /* directory path -> dir_listing */
+    ScmInternalMutex dir_cache_mutex;
+
     /* Provided features */
     ScmObj provided;            /* List of provided features. */
     ScmObj providing;           /* Alist of features that is being loaded,
@@ -348,6 +353,231 @@ void Scm_DeleteLoadPathHook(ScmObj proc)
     (void)SCM_INTERNAL_MUTEX_UNLOCK(ldinfo.path_mutex);
 }
 
+/*------------------------------------------------------------------
+ * Searching a file in a load path directory
+ *
+ *  Every `require' and `use' probes each directory in *load-path*
+ *  with the file name and each suffix, which costs a handful of
+ *  stat()s per directory, mostly failing ones.  Instead, we keep
+ *  a listing of each directory we've searched, and validate it with
+ *  one stat() of the directory, for adding or removing an entry
+ *  changes the directory's mtime.
+ *
+ *  Since mtime has coarse granularity, an entry added within the same
+ *  tick as the last modification would go unnoticed.  So we keep the
+ *  listing only if the directory had been modified before we started
+ *  reading it.
+ *
+ *  The cache isn't used on platforms whose file systems are usually
+ *  case-insensitive or normalize names, for the name we look for may
+ *  not literally appear in the listing.  We just stat() there.
+ */
+
+#if !defined(GAUCHE_WINDOWS) && !defined(__CYGWIN__) && !defined(__APPLE__)
+#define USE_DIR_CACHE 1
+#endif
+
+/* Returns TRUE iff PATH exists and is not a directory, as find-load-file
+   checks it. */
+static int loadable_file_p(const char *path)
+{
+    ScmStat st;
+    return (stat(path, &st) == 0 && !S_ISDIR(st.st_mode));
+}
+
+static const char *path_join(const char *dir, const char *name)
+{
+    size_t dlen = strlen(dir), nlen = strlen(name);
+    char *buf = SCM_NEW_ATOMIC2(char*, dlen + nlen + 2);
+    memcpy(buf, dir, dlen);
+    buf[dlen] = '/';
+    memcpy(buf + dlen + 1, name, nlen + 1);
+    return buf;
+}
+
+static const char *suffix_string(ScmObj suffix)
+{
+    if (!SCM_STRINGP(suffix)) {
+        Scm_Error("load suffix must be a string, but got: %S", suffix);
+    }
+    return Scm_GetStringConst(SCM_STRING(suffix));
+}
+
+/* Try STEM and STEM+suffix without the cache. */
+static ScmObj probe_files(const char *stem, ScmObj suffixes)
+{
+    if (loadable_file_p(stem)) return SCM_MAKE_STR_COPYING(stem);
+
+    ScmObj sp;
+    SCM_FOR_EACH(sp, suffixes) {
+        const char *suffix = suffix_string(SCM_CAR(sp));
+        size_t slen = strlen(stem), xlen = strlen(suffix);
+        char *buf = SCM_NEW_ATOMIC2(char*, slen + xlen + 1);
+        memcpy(buf, stem, slen);
+        memcpy(buf + slen, suffix, xlen + 1);
+        if (loadable_file_p(buf)) return SCM_MAKE_STR_COPYING(buf);
+    }
+    return SCM_FALSE;
+}
+
+#if USE_DIR_CACHE
+#include <dirent.h>
+
+typedef struct dir_listing_rec {
+    dev_t dev;
+    ino_t ino;
+    time_t mtime;
+    ScmHashCore entries;        /* name -> entry kind */
+} dir_listing;
+
+enum {
+    DIRENT_FILE,                /* anything other than directory */
+    DIRENT_DIR,
+    DIRENT_UNKNOWN              /* symlink, or d_type isn't available */
+};
+
+#define DIR_UNLISTABLE  ((dir_listing*)1)
+
+/* Read the directory PATH, whose stat is ST.  Returns DIR_UNLISTABLE if
+   we can't read the directory (we may still be able to search it).
+   *CACHEABLE is set to TRUE if we can keep the listing. */
+static dir_listing *read_dir_listing(const char *path, ScmStat *st,
+                                     int *cacheable)
+{
+    time_t start = time(NULL);
+    DIR *dirp = opendir(path);
+    if (dirp == NULL) return DIR_UNLISTABLE;
+
+    dir_listing *d = SCM_NEW(dir_listing);
+    d->dev = st->st_dev;
+    d->ino = st->st_ino;
+    d->mtime = st->st_mtime;
+    Scm_HashCoreInitSimple(&d->entries, SCM_HASH_STRING, 0, NULL);
+
+    struct dirent *dire;
+    while ((dire = readdir(dirp)) != NULL) {
+        int kind = DIRENT_UNKNOWN;
+#if defined(DT_DIR)
+        switch (dire->d_type) {
+        case DT_DIR: kind = DIRENT_DIR; break;
+        case DT_LNK: case DT_UNKNOWN: kind = DIRENT_UNKNOWN; break;
+        default: kind = DIRENT_FILE; break;
+        }
+#endif /*DT_DIR*/
+        ScmDictEntry *e =
+            Scm_HashCoreSearch(&d->entries,
+                               (intptr_t)SCM_MAKE_STR_COPYING(dire->d_name),
+                               SCM_DICT_CREATE);
+        (void)SCM_DICT_SET_VALUE(e, SCM_MAKE_INT(kind));
+    }
+    closedir(dirp);
+    *cacheable = (st->st_mtime < start);
+    return d;
+}
+
+/* Returns the listing of the directory PATH, NULL if PATH isn't
+   a directory, or DIR_UNLISTABLE. */
+static dir_listing *get_dir_listing(const char *path)
+{
+    ScmStat st;
+    if (stat(path, &st) < 0 || !S_ISDIR(st.st_mode)) return NULL;
+
+    ScmObj key = SCM_MAKE_STR_COPYING(path);
+    dir_listing *d = NULL;
+    (void)SCM_INTERNAL_MUTEX_LOCK(ldinfo.dir_cache_mutex);
+    ScmDictEntry *e = Scm_HashCoreSearch(&ldinfo.dir_cache, (intptr_t)key,
+                                         SCM_DICT_GET);
+    if (e) d = (dir_listing*)e->value;
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(ldinfo.dir_cache_mutex);
+
+    if (d != NULL && d->mtime == st.st_mtime
+        && d->ino == st.st_ino && d->dev == st.st_dev) {
+        return d;
+    }
+
+    int cacheable = FALSE;
+    d = read_dir_listing(path, &st, &cacheable);
+    (void)SCM_INTERNAL_MUTEX_LOCK(ldinfo.dir_cache_mutex);
+    if (cacheable) {
+        e = Scm_HashCoreSearch(&ldinfo.dir_cache, (intptr_t)key,
+                               SCM_DICT_CREATE);
+        e->value = (intptr_t)d;
+    } else {
+        Scm_HashCoreSearch(&ldinfo.dir_cache, (intptr_t)key, SCM_DICT_DELETE);
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(ldinfo.dir_cache_mutex);
+    return d;
+}
+
+/* Check if NAME in the directory DIR, whose listing is D, is
+   a directory (WANTDIR is TRUE) or a loadable file (WANTDIR is FALSE). */
+static int dir_entry_p(dir_listing *d, const char *dir, const char *name,
+                       int wantdir)
+{
+    ScmDictEntry *e = Scm_HashCoreSearch(&d->entries,
+                                         (intptr_t)SCM_MAKE_STR(name),
+                                         SCM_DICT_GET);
+    if (e == NULL) return FALSE;
+    switch (SCM_INT_VALUE(SCM_DICT_VALUE(e))) {
+    case DIRENT_FILE: return !wantdir;
+    case DIRENT_DIR:  return wantdir;
+    default: {
+        ScmStat st;
+        if (stat(path_join(dir, name), &st) < 0) return FALSE;
+        return (S_ISDIR(st.st_mode) ? wantdir : !wantdir);
+    }
+    }
+}
+#endif /*USE_DIR_CACHE*/
+
+/* Look for FILENAME, then FILENAME with each of SUFFIXES, in the
+   directory DIR.  This is the inner loop of find-load-file.
+   Returns the path if found, #f if not, or #t if DIR isn't
+   a directory, in which case the caller may consult load path hooks. */
+ScmObj Scm__FindFileInDirectory(ScmString *dir, ScmString *filename,
+                                ScmObj suffixes)
+{
+    const char *d = Scm_GetStringConst(dir);
+    const char *f = Scm_GetStringConst(filename);
+#if USE_DIR_CACHE
+    dir_listing *listing = get_dir_listing(d);
+    if (listing == NULL) return SCM_TRUE;
+
+    /* Descend to the directory that would contain the file, pruning
+       with the listings on the way. */
+    const char *slash;
+    while (listing != DIR_UNLISTABLE
+           && (slash = strchr(f, '/')) != NULL && slash != f) {
+        const char *sub = SCM_STRDUP_PARTIAL(f, slash - f);
+        if (!dir_entry_p(listing, d, sub, TRUE)) return SCM_FALSE;
+        d = path_join(d, sub);
+        f = slash + 1;
+        listing = get_dir_listing(d);
+        if (listing == NULL) return SCM_FALSE; /* removed meanwhile */
+    }
+    if (listing != DIR_UNLISTABLE && *f != '\0' && strchr(f, '/') == NULL) {
+        if (dir_entry_p(listing, d, f, FALSE)) {
+            return SCM_MAKE_STR_COPYING(path_join(d, f));
+        }
+        ScmObj sp;
+        SCM_FOR_EACH(sp, suffixes) {
+            ScmObj name = Scm_StringAppendC(SCM_STRING(SCM_MAKE_STR(f)),
+                                            suffix_string(SCM_CAR(sp)),
+                                            -1, -1);
+            const char *n = Scm_GetStringConst(SCM_STRING(name));
+            if (dir_entry_p(listing, d, n, FALSE)) {
+                return SCM_MAKE_STR_COPYING(path_join(d, n));
+            }
+        }
+        return SCM_FALSE;
+    }
+#else  /*!USE_DIR_CACHE*/
+    ScmStat st;
+    if (stat(d, &st) < 0 || !S_ISDIR(st.st_mode)) return SCM_TRUE;
+#endif /*!USE_DIR_CACHE*/
+    return probe_files(path_join(d, f), suffixes);
+}
+
 /*------------------------------------------------------------------
  * Dynamic linking
  */
@@ -1045,13 +1275,55 @@ void Scm_DefineAutoload(ScmModule *where,
 }
 
 
+/* Returns TRUE iff the calling thread is in the middle of loading PATH. */
+static int loading_by_self_p(ScmObj path, ScmVM *vm)
+{
+    int r = FALSE;
+    ScmObj cp;
+    (void)SCM_INTERNAL_MUTEX_LOCK(ldinfo.prov_mutex);
+    SCM_FOR_EACH(cp, ldinfo.providing) {
+        ScmObj p = SCM_CAR(cp);
+        if (SCM_CADR(p) == SCM_OBJ(vm) && Scm_EqualP(SCM_CAR(p), path)) {
+            r = TRUE;
+            break;
+        }
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(ldinfo.prov_mutex);
+    return r;
+}
+
+#define AUTOLOAD_LOCKER_CAS(adata, old, new_)                           \
+    AO_compare_and_swap_full((volatile AO_t*)&(adata)->locker,          \
+                             (AO_t)(old), (AO_t)(new_))
+
+/* Give up resolving ADATA and wake up the waiters, one of which will
+   take over. */
+static void autoload_release(ScmAutoload *adata)
+{
+    (void)SCM_INTERNAL_MUTEX_LOCK(adata->mutex);
+    AO_store_release((volatile AO_t*)&adata->locker, (AO_t)NULL);
+    (void)SCM_INTERNAL_COND_BROADCAST(adata->cv);
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(adata->mutex);
+}
+
+/* Resolving autoload works like a once-flag.  Once the autoload is
+ * resolved, adata->loaded is set with release semantics after the value
+ * and the binding are in place, so the fast path is just a load-acquire;
+ * and the global variable reference that triggered the autoload sees
+ * the new binding from then on.
+ *
+ * Until then, the first thread claims the autoload by CAS-ing itself
+ * into adata->locker, and others wait on the autoload's own condition
+ * variable.  No global lock is held while waiting; we only peek at the
+ * providing list under ldinfo.prov_mutex to see if the calling thread
+ * is loading the file itself.
+ */
 ScmObj Scm_ResolveAutoload(ScmAutoload *adata, int flags)
 {
-    int circular = FALSE;
     ScmVM *vm = Scm_VM();
 
     /* shortcut in case if somebody else already did the job. */
-    if (adata->loaded) return adata->value;
+    if (AO_load_acquire((volatile AO_t*)&adata->loaded)) return adata->value;
 
     /* check to see if this autoload is recursive.  if so, we just return
        SCM_UNBOUND and let the caller handle the issue (NB: it isn't
@@ -1060,51 +1332,47 @@ ScmObj Scm_ResolveAutoload(ScmAutoload *adata, int flags)
        name is set autoload and define-method is in the file that's being
        autoloaded, define-method finds the name is an autoload that points
        the currently autoloaded file.)
-       we have to be careful to exclude the case that when one thread is
-       resolving autoload another thread enters here and sees this autoload
-       is already being resolved.
-     */
-    if ((adata->locker == NULL || adata->locker == vm)
-        && !SCM_FALSEP(Scm_Assoc(SCM_OBJ(adata->path),
-                                 ldinfo.providing,
-                                 SCM_CMP_EQUAL))) {
-        return SCM_UNBOUND;
-    }
+       Only the loading by the calling thread counts; if another thread
+       is loading the file, we'll wait for it in do_require.  We must not
+       wait for the locker below in that case, though, for the locker may
+       be waiting for us to finish loading the file. */
+    if (loading_by_self_p(SCM_OBJ(adata->path), vm)) return SCM_UNBOUND;
 
-    /* obtain the lock to load this autoload */
-    (void)SCM_INTERNAL_MUTEX_LOCK(adata->mutex);
-    do {
-        if (adata->loaded) break;
-        if (adata->locker == NULL) {
-            adata->locker = vm;
-        } else if (adata->locker == vm) {
-            /* bad circular dependency */
-            circular = TRUE;
-        } else if (adata->locker->state == SCM_VM_TERMINATED) {
+    /* claim this autoload, or wait for the one who has claimed it. */
+    for (;;) {
+        if (AUTOLOAD_LOCKER_CAS(adata, NULL, vm)) break;
+        ScmVM *locker = adata->locker;
+        if (locker == vm) {
+            /* Since we have already checked recursive loading, it isn't
+               normal if we reach here.  Right now I have no idea how this
+               happens, but just in case we raise an error. */
+            Scm_Error("Attempted to trigger the same autoload %S#%S recursively.  Maybe circular autoload dependency?",
+                      adata->module, adata->name);
+        }
+        if (locker != NULL && locker->state == SCM_VM_TERMINATED) {
             /* the loading thread have died prematurely.
                let's take over the task. */
-            adata->locker = vm;
-        } else {
-            (void)SCM_INTERNAL_COND_WAIT(adata->cv, adata->mutex);
+            if (AUTOLOAD_LOCKER_CAS(adata, locker, vm)) break;
             continue;
         }
-    } while (0);
-    SCM_INTERNAL_MUTEX_UNLOCK(adata->mutex);
-    if (adata->loaded) {
-        /* ok, somebody did the work for me.  just use the result. */
-        return adata->value;
+        (void)SCM_INTERNAL_MUTEX_LOCK(adata->mutex);
+        if (!AO_load_acquire((volatile AO_t*)&adata->loaded)
+            && adata->locker == locker && locker != NULL) {
+            (void)SCM_INTERNAL_COND_WAIT(adata->cv, adata->mutex);
+        }
+        (void)SCM_INTERNAL_MUTEX_UNLOCK(adata->mutex);
+        if (AO_load_acquire((volatile AO_t*)&adata->loaded)) {
+            /* ok, somebody did the work for me.  just use the result. */
+            return adata->value;
+        }
     }
-
-    if (circular) {
-        /* Since we have already checked recursive loading, it isn't normal
-           if we reach here.  Right now I have no idea how this happens, but
-           just in case we raise an error. */
-        adata->locker = NULL;
-        SCM_INTERNAL_COND_BROADCAST(adata->cv);
-        Scm_Error("Attempted to trigger the same autoload %S#%S recursively.  Maybe circular autoload dependency?",
-                  adata->module, adata->name);
+    /* The previous locker may have finished just before we claimed. */
+    if (AO_load_acquire((volatile AO_t*)&adata->loaded)) {
+        autoload_release(adata);
+        return adata->value;
     }
 
+    ScmObj value = SCM_UNBOUND;
     SCM_UNWIND_PROTECT {
         do_require(SCM_OBJ(adata->path), SCM_LOAD_PROPAGATE_ERROR,
                    adata->module, NULL);
@@ -1122,33 +1390,32 @@ ScmObj Scm_ResolveAutoload(ScmAutoload *adata, int flags)
             ScmGloc *g = Scm_FindBinding(adata->module, adata->name, 0);
             SCM_ASSERT(f != NULL);
             SCM_ASSERT(g != NULL);
-            adata->value = SCM_GLOC_GET(f);
-            if (SCM_UNBOUNDP(adata->value) || SCM_AUTOLOADP(adata->value)) {
+            value = SCM_GLOC_GET(f);
+            if (SCM_UNBOUNDP(value) || SCM_AUTOLOADP(value)) {
                 Scm_Error("Autoloaded symbol %S is not defined in the module %S",
                           adata->name, adata->import_from);
             }
-            SCM_GLOC_SET(g, adata->value);
+            SCM_GLOC_SET(g, value);
         } else {
             /* Normal import.  The binding must have been inserted to
                adata->module */
             ScmGloc *g = Scm_FindBinding(adata->module, adata->name, 0);
             SCM_ASSERT(g != NULL);
-            adata->value = SCM_GLOC_GET(g);
-            if (SCM_UNBOUNDP(adata->value) || SCM_AUTOLOADP(adata->value)) {
+            value = SCM_GLOC_GET(g);
+            if (SCM_UNBOUNDP(value) || SCM_AUTOLOADP(value)) {
                 Scm_Error("Autoloaded symbol %S is not defined in the file %S",
                           adata->name, adata->path);
             }
         }
     } SCM_WHEN_ERROR {
-        adata->locker = NULL;
-        SCM_INTERNAL_COND_BROADCAST(adata->cv);
+        autoload_release(adata);
         SCM_NEXT_HANDLER;
     } SCM_END_PROTECT;
 
-    adata->loaded = TRUE;
-    adata->locker = NULL;
-    SCM_INTERNAL_COND_BROADCAST(adata->cv);
-    return adata->value;
+    adata->value = value;
+    AO_store_release((volatile AO_t*)&adata->loaded, (AO_t)TRUE);
+    autoload_release(adata);
+    return value;
 }
 
 /*------------------------------------------------------------------
@@ -1230,6 +1497,7 @@ void Scm__InitLoad(void)
     SCM_APPEND1(init_load_suffixes, t, SCM_MAKE_STR(".scm"));
 
     (void)SCM_INTERNAL_MUTEX_INIT(ldinfo.path_mutex);
+    (void)SCM_INTERNAL_MUTEX_INIT(ldinfo.dir_cache_mutex);
     (void)SCM_INTERNAL_MUTEX_INIT(ldinfo.prov_mutex);
     (void)SCM_INTERNAL_COND_INIT(ldinfo.prov_cv);
     (void)SCM_INTERNAL_MUTEX_INIT(ldinfo.dso_mutex);
@@ -1260,6 +1528,7 @@ void Scm__InitLoad(void)
                                     SCM_MAKE_STR("." SHLIB_SO_SUFFIX));
     ldinfo.dso_table = SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_STRING,0));
     ldinfo.dso_prelinked = SCM_NIL;
+    Scm_HashCoreInitSimple(&ldinfo.dir_cache, SCM_HASH_STRING, 0, NULL);
 
 #define PARAM_INIT(var, name, val) Scm_DefinePrimitiveParameter(m, name, val, &ldinfo.var)
     PARAM_INIT(load_history, "current-load-history", SCM_NIL);
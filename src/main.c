@@ -116,6 +116,8 @@ void usage(void)
             "      no-post-inline-pass\n"
             "                      don't run post-inline optimization pass.\n"
             "      no-source-info  don't preserve source information for debugging\n"
+            "      trace-startup   report time spent by initialization routines,\n"
+            "                      and by each file loaded (same as -pload)\n"
             "      test            test mode, to run gosh inside the build tree\n"
             );
     exit(1);
@@ -178,6 +180,10 @@ void further_options(const char *optarg)
     else if (strcmp(optarg, "test") == 0) {
         test_mode = TRUE;
     }
+    else if (strcmp(optarg, "trace-startup") == 0) {
+        Scm__PrintInitTimes(SCM_CURERR);
+        SCM_VM_RUNTIME_FLAG_SET(vm, SCM_COLLECT_LOAD_STATS);
+    }
     /* For development; not for public use */
     else if (strcmp(optarg, "collect-stats") == 0) {
         stats_mode = TRUE;
@@ -201,7 +207,7 @@ void further_options(const char *optarg)
     }
     else {
         fprintf(stderr, "unknown -f option: %s\n", optarg);
-        fprintf(stderr, "supported options are: -fcase-fold, -fload-verbose, -finclude-verbose, -fno-inline, -fno-inline-globals, -fno-inline-locals, -fno-inline-constants, -fno-source-info, -fno-post-inline-pass, -fno-lambda-lifting-pass, -fwarn-legacy-syntax, or -ftest\n");
+        fprintf(stderr, "supported options are: -fcase-fold, -fload-verbose, -finclude-verbose, -fno-inline, -fno-inline-globals, -fno-inline-locals, -fno-inline-constants, -fno-source-info, -fno-post-inline-pass, -fno-lambda-lifting-pass, -fwarn-legacy-syntax, -ftrace-startup, or -ftest\n");
         exit(1);
     }
 }
@@ -581,6 +587,7 @@ int main(int ac, char **av)
     int has_console = init_console();
 #endif /*defined(GAUCHE_WINDOWS)*/
 
+    Scm_GCPreInit();
     GC_INIT();
     Scm_Init(GAUCHE_SIGNATURE);
     sig_setup();
@@ -161,7 +161,10 @@ static void init_module(ScmModule *m, ScmObj name, ScmHashTable *internal)
     }
     m->external = SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
     m->origin = m->prefix = SCM_FALSE;
+    m->info = SCM_NIL;
     m->sealed = FALSE;
+    m->lookupCache = NULL;
+    m->lookupCacheGen = 0;
 }
 
 /* Internal */
@@ -392,6 +395,51 @@ static ScmGloc *search_binding(ScmModule *module, ScmSymbol *symbol,
     return NULL;
 }
 
+/* Lookup cache
+ *
+ * Searching imported and inherited modules for every lookup is costly,
+ * and it is repeated each time eval or global-variable-ref is called on
+ * the same name.  Each module caches the result of the full search
+ * (with no flags), both positive (a gloc) and negative (#f).
+ *
+ * The result can change when a module gains or loses a binding or
+ * an export, when a phantom binding gets its value, or when a module's
+ * imports or precedence list change.  Instead of tracking which modules
+ * are affected, such operations bump binding_generation, which lets
+ * all the caches be discarded lazily.  Changing the value of an
+ * existing binding doesn't affect the cache, since the gloc stays the
+ * same.  The generation and the caches are protected by modules.mutex.
+ */
+#define LOOKUP_CACHE_MAX  4096
+
+static u_long binding_generation = 1;
+
+#define INVALIDATE_LOOKUP_CACHE()  (binding_generation++)
+
+/* Must be called while holding modules.mutex */
+static ScmGloc *search_binding_cached(ScmModule *module, ScmSymbol *symbol)
+{
+    ScmHashTable *c = module->lookupCache;
+    if (c == NULL) {
+        c = module->lookupCache =
+            SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
+        module->lookupCacheGen = binding_generation;
+    } else if (module->lookupCacheGen != binding_generation
+               || Scm_HashCoreNumEntries(SCM_HASH_TABLE_CORE(c))
+                  >= LOOKUP_CACHE_MAX) {
+        Scm_HashCoreClear(SCM_HASH_TABLE_CORE(c));
+        module->lookupCacheGen = binding_generation;
+    } else {
+        ScmObj v = Scm_HashTableRef(c, SCM_OBJ(symbol), SCM_UNBOUND);
+        if (SCM_GLOCP(v))  return SCM_GLOC(v);
+        if (SCM_FALSEP(v)) return NULL;
+    }
+
+    ScmGloc *g = search_binding(module, symbol, FALSE, FALSE, FALSE);
+    Scm_HashTableSet(c, SCM_OBJ(symbol), g? SCM_OBJ(g) : SCM_FALSE, 0);
+    return g;
+}
+
 ScmGloc *Scm_FindBinding(ScmModule *module, ScmSymbol *symbol, int flags)
 {
     int stay_in_module = flags&SCM_BINDING_STAY_IN_MODULE;
@@ -399,7 +447,12 @@ ScmGloc *Scm_FindBinding(ScmModule *module, ScmSymbol *symbol, int flags)
     ScmGloc *gloc = NULL;
 
     SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(modules.mutex);
-    gloc = search_binding(module, symbol, stay_in_module, external_only, FALSE);
+    if (!stay_in_module && !external_only) {
+        gloc = search_binding_cached(module, symbol);
+    } else {
+        gloc = search_binding(module, symbol, stay_in_module, external_only,
+                              FALSE);
+    }
     SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
     return gloc;
 }
@@ -430,6 +483,7 @@ ScmGloc *Scm_MakeBinding(ScmModule *module, ScmSymbol *symbol,
     ScmGloc *g;
     ScmObj oldval = SCM_UNDEFINED;
     int prev_kind = 0;
+    int invalidate = FALSE;
     int kind = ((flags&SCM_BINDING_CONST)
                 ? SCM_BINDING_CONST
                 : ((flags&SCM_BINDING_INLINABLE)
@@ -444,6 +498,8 @@ ScmGloc *Scm_MakeBinding(ScmModule *module, ScmSymbol *symbol,
         if (Scm_GlocConstP(g))          prev_kind = SCM_BINDING_CONST;
         else if (Scm_GlocInlinableP(g)) prev_kind = SCM_BINDING_INLINABLE;
         oldval = g->value;
+        /* phantom binding becoming real, or vice versa */
+        invalidate = SCM_UNBOUNDP(oldval) || SCM_UNBOUNDP(value);
     } else {
         g = SCM_GLOC(Scm_MakeGloc(symbol, module));
         Scm_HashTableSet(module->internal, SCM_OBJ(symbol), SCM_OBJ(g), 0);
@@ -451,12 +507,21 @@ ScmGloc *Scm_MakeBinding(ScmModule *module, ScmSymbol *symbol,
         if (module->exportAll && SCM_SYMBOL_INTERNED(symbol)) {
             Scm_HashTableSet(module->external, SCM_OBJ(symbol), SCM_OBJ(g), 0);
         }
+        invalidate = TRUE;
     }
     SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
 
     g->value = value;
     Scm_GlocMark(g, kind);
 
+    /* We invalidate lookup caches after setting the value, for
+       the lookup result depends on whether the gloc is phantom. */
+    if (invalidate) {
+        (void)SCM_INTERNAL_MUTEX_LOCK(modules.mutex);
+        INVALIDATE_LOOKUP_CACHE();
+        (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
+    }
+
     if (prev_kind != 0) {
         /* NB: Scm_EqualP may throw an error.  It won't leave the state
            inconsistent, but be aware. */
@@ -506,6 +571,7 @@ void Scm_HideBinding(ScmModule *module, ScmSymbol *symbol)
         ScmGloc *g = SCM_GLOC(Scm_MakeGloc(symbol, module));
         g->hidden = TRUE;
         Scm_HashTableSet(module->external, SCM_OBJ(symbol), SCM_OBJ(g), 0);
+        INVALIDATE_LOOKUP_CACHE();
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
 
@@ -549,6 +615,7 @@ int Scm_AliasBinding(ScmModule *target, ScmSymbol *targetName,
     SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(modules.mutex);
     Scm_HashTableSet(target->external, SCM_OBJ(targetName), SCM_OBJ(g), 0);
     Scm_HashTableSet(target->internal, SCM_OBJ(targetName), SCM_OBJ(g), 0);
+    INVALIDATE_LOOKUP_CACHE();
     SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
     return TRUE;
 }
@@ -602,6 +669,7 @@ ScmObj Scm_ImportModule(ScmModule *module,
             break;
         }
         module->imported = p;
+        INVALIDATE_LOOKUP_CACHE();
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
 
@@ -686,6 +754,7 @@ ScmObj Scm_ExportSymbols(ScmModule *module, ScmObj specs)
                              SCM_DICT_VALUE(e), 0);
         }
     }
+    INVALIDATE_LOOKUP_CACHE();
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
 
     /* Now, if this export changes the meaning of exported symbols, we
@@ -725,6 +794,7 @@ ScmObj Scm_ExportAll(ScmModule *module)
                 (void)SCM_DICT_SET_VALUE(ee, SCM_DICT_VALUE(e));
             }
         }
+        INVALIDATE_LOOKUP_CACHE();
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
     return SCM_OBJ(module);
@@ -779,6 +849,9 @@ ScmObj Scm_ExtendModule(ScmModule *module, ScmObj supers)
         Scm_Error("can't extend those modules simultaneously because of inconsistent precedence lists: %S", supers);
     }
     module->mpl = Scm_Cons(SCM_OBJ(module), mpl);
+    (void)SCM_INTERNAL_MUTEX_LOCK(modules.mutex);
+    INVALIDATE_LOOKUP_CACHE();
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
     return module->mpl;
 }
 
@@ -296,7 +296,7 @@ static void report_flonum_count(void *data)
 
 ScmObj Scm_MakeFlonum(double d)
 {
-    ScmFlonum *f = SCM_NEW(ScmFlonum);
+    ScmFlonum *f = SCM_NEW_KIND(ScmFlonum, SCM_ALLOC_FLONUM);
     SCM_FLONUM_VALUE(f) = d;
 #ifdef COUNT_FLONUM_ALLOC
     flonum_count++;
@@ -1805,6 +1805,40 @@ static ScmObj scm_add(ScmObj arg0, ScmObj arg1, int vmp)
 }
 DEFINE_DUAL_API2(Scm_Add, Scm_VMAdd, scm_add)
 
+/* Sums up the numbers in ARGS, which must be a non-empty list.
+   While the partial sum is an exact integer and bignums are involved,
+   we accumulate it in place instead of allocating a new bignum for
+   each intermediate result. */
+ScmObj Scm_AddList(ScmObj args)
+{
+    ScmObj r = SCM_CAR(args), cp;
+    ScmBignum *acc = NULL;
+    SCM_FOR_EACH(cp, SCM_CDR(args)) {
+        ScmObj v = SCM_CAR(cp);
+        if (acc != NULL) {
+            if (SCM_INTP(v)) {
+                acc = Scm_BignumAccAddSI(acc, SCM_INT_VALUE(v));
+                continue;
+            }
+            if (SCM_BIGNUMP(v)) {
+                acc = Scm_BignumAccAdd(acc, SCM_BIGNUM(v));
+                continue;
+            }
+            r = Scm_NormalizeBignum(acc);
+            acc = NULL;
+        } else if (SCM_BIGNUMP(v) && (SCM_INTP(r) || SCM_BIGNUMP(r))) {
+            acc = Scm_MakeBignumWithSize(SCM_BIGNUM_SIZE(v) + 2, 0);
+            acc = Scm_BignumAccAdd(acc, SCM_BIGNUM(v));
+            if (SCM_INTP(r)) acc = Scm_BignumAccAddSI(acc, SCM_INT_VALUE(r));
+            else             acc = Scm_BignumAccAdd(acc, SCM_BIGNUM(r));
+            continue;
+        }
+        r = Scm_Add(r, v);
+    }
+    if (acc != NULL) r = Scm_NormalizeBignum(acc);
+    return r;
+}
+
 
 static ScmObj scm_sub(ScmObj arg0, ScmObj arg1, int vmp)
 {
@@ -3381,6 +3415,333 @@ static inline int numcmp3(ScmObj x, ScmObj d, ScmObj y)
     }
 }
 
+/*
+ * Fast path of number printer
+ *
+ * This version implements Grisu3 (Florian Loitsch, "Printing
+ * Floating-Point Numbers Quickly and Accurately with Integers",
+ * PLDI '10, pp.233--243, 2010).  It uses only 64bit integer arithmetic,
+ * and either returns the shortest digits that read back to the same
+ * number, choosing the closest one, or reports that it can't decide.
+ * About 0.5% of the doubles fall in the latter case, for which we use
+ * Burger&Dybvig algorithm below.
+ *
+ * The boundaries are treated the same way as print_double does, so
+ * that we get the identical output with either route.
+ */
+
+#if !SCM_EMULATE_INT64
+
+typedef struct {
+    ScmUInt64 f;
+    int e;
+} diy_fp;
+
+/* Cached powers of ten: 10^k ~ f * 2^e, for k = -348, -340, ..., 340.
+   f is normalized and rounded to the nearest. */
+static const struct {
+    ScmUInt64 f;
+    short e;
+    short k;
+} cached_pow10[] = {
+    {0xfa8fd5a0081c0288ULL, -1220, -348},
+    {0xbaaee17fa23ebf76ULL, -1193, -340},
+    {0x8b16fb203055ac76ULL, -1166, -332},
+    {0xcf42894a5dce35eaULL, -1140, -324},
+    {0x9a6bb0aa55653b2dULL, -1113, -316},
+    {0xe61acf033d1a45dfULL, -1087, -308},
+    {0xab70fe17c79ac6caULL, -1060, -300},
+    {0xff77b1fcbebcdc4fULL, -1034, -292},
+    {0xbe5691ef416bd60cULL, -1007, -284},
+    {0x8dd01fad907ffc3cULL,  -980, -276},
+    {0xd3515c2831559a83ULL,  -954, -268},
+    {0x9d71ac8fada6c9b5ULL,  -927, -260},
+    {0xea9c227723ee8bcbULL,  -901, -252},
+    {0xaecc49914078536dULL,  -874, -244},
+    {0x823c12795db6ce57ULL,  -847, -236},
+    {0xc21094364dfb5637ULL,  -821, -228},
+    {0x9096ea6f3848984fULL,  -794, -220},
+    {0xd77485cb25823ac7ULL,  -768, -212},
+    {0xa086cfcd97bf97f4ULL,  -741, -204},
+    {0xef340a98172aace5ULL,  -715, -196},
+    {0xb23867fb2a35b28eULL,  -688, -188},
+    {0x84c8d4dfd2c63f3bULL,  -661, -180},
+    {0xc5dd44271ad3cdbaULL,  -635, -172},
+    {0x936b9fcebb25c996ULL,  -608, -164},
+    {0xdbac6c247d62a584ULL,  -582, -156},
+    {0xa3ab66580d5fdaf6ULL,  -555, -148},
+    {0xf3e2f893dec3f126ULL,  -529, -140},
+    {0xb5b5ada8aaff80b8ULL,  -502, -132},
+    {0x87625f056c7c4a8bULL,  -475, -124},
+    {0xc9bcff6034c13053ULL,  -449, -116},
+    {0x964e858c91ba2655ULL,  -422, -108},
+    {0xdff9772470297ebdULL,  -396, -100},
+    {0xa6dfbd9fb8e5b88fULL,  -369,  -92},
+    {0xf8a95fcf88747d94ULL,  -343,  -84},
+    {0xb94470938fa89bcfULL,  -316,  -76},
+    {0x8a08f0f8bf0f156bULL,  -289,  -68},
+    {0xcdb02555653131b6ULL,  -263,  -60},
+    {0x993fe2c6d07b7facULL,  -236,  -52},
+    {0xe45c10c42a2b3b06ULL,  -210,  -44},
+    {0xaa242499697392d3ULL,  -183,  -36},
+    {0xfd87b5f28300ca0eULL,  -157,  -28},
+    {0xbce5086492111aebULL,  -130,  -20},
+    {0x8cbccc096f5088ccULL,  -103,  -12},
+    {0xd1b71758e219652cULL,   -77,   -4},
+    {0x9c40000000000000ULL,   -50,    4},
+    {0xe8d4a51000000000ULL,   -24,   12},
+    {0xad78ebc5ac620000ULL,     3,   20},
+    {0x813f3978f8940984ULL,    30,   28},
+    {0xc097ce7bc90715b3ULL,    56,   36},
+    {0x8f7e32ce7bea5c70ULL,    83,   44},
+    {0xd5d238a4abe98068ULL,   109,   52},
+    {0x9f4f2726179a2245ULL,   136,   60},
+    {0xed63a231d4c4fb27ULL,   162,   68},
+    {0xb0de65388cc8ada8ULL,   189,   76},
+    {0x83c7088e1aab65dbULL,   216,   84},
+    {0xc45d1df942711d9aULL,   242,   92},
+    {0x924d692ca61be758ULL,   269,  100},
+    {0xda01ee641a708deaULL,   295,  108},
+    {0xa26da3999aef774aULL,   322,  116},
+    {0xf209787bb47d6b85ULL,   348,  124},
+    {0xb454e4a179dd1877ULL,   375,  132},
+    {0x865b86925b9bc5c2ULL,   402,  140},
+    {0xc83553c5c8965d3dULL,   428,  148},
+    {0x952ab45cfa97a0b3ULL,   455,  156},
+    {0xde469fbd99a05fe3ULL,   481,  164},
+    {0xa59bc234db398c25ULL,   508,  172},
+    {0xf6c69a72a3989f5cULL,   534,  180},
+    {0xb7dcbf5354e9beceULL,   561,  188},
+    {0x88fcf317f22241e2ULL,   588,  196},
+    {0xcc20ce9bd35c78a5ULL,   614,  204},
+    {0x98165af37b2153dfULL,   641,  212},
+    {0xe2a0b5dc971f303aULL,   667,  220},
+    {0xa8d9d1535ce3b396ULL,   694,  228},
+    {0xfb9b7cd9a4a7443cULL,   720,  236},
+    {0xbb764c4ca7a44410ULL,   747,  244},
+    {0x8bab8eefb6409c1aULL,   774,  252},
+    {0xd01fef10a657842cULL,   800,  260},
+    {0x9b10a4e5e9913129ULL,   827,  268},
+    {0xe7109bfba19c0c9dULL,   853,  276},
+    {0xac2820d9623bf429ULL,   880,  284},
+    {0x80444b5e7aa7cf85ULL,   907,  292},
+    {0xbf21e44003acdd2dULL,   933,  300},
+    {0x8e679c2f5e44ff8fULL,   960,  308},
+    {0xd433179d9c8cb841ULL,   986,  316},
+    {0x9e19db92b4e31ba9ULL,  1013,  324},
+    {0xeb96bf6ebadf77d9ULL,  1039,  332},
+    {0xaf87023b9bf0ee6bULL,  1066,  340},
+};
+
+#define CACHED_POW10_MIN_K     (-348)
+#define CACHED_POW10_K_STEP    8
+
+/* The range of binary exponent of the scaled value, so that the integral
+   part fits in 32bits. */
+#define GRISU_ALPHA  (-60)
+#define GRISU_GAMMA  (-32)
+
+static inline diy_fp diy_fp_normalize(diy_fp x)
+{
+    while (!(x.f & ((ScmUInt64)1<<63))) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+/* Upper 64bits of the 128bit product, rounded. */
+static inline diy_fp diy_fp_mul(diy_fp x, diy_fp y)
+{
+    const ScmUInt64 M32 = 0xffffffffUL;
+    ScmUInt64 a = x.f >> 32, b = x.f & M32;
+    ScmUInt64 c = y.f >> 32, d = y.f & M32;
+    ScmUInt64 ac = a*c, bc = b*c, ad = a*d, bd = b*d;
+    ScmUInt64 tmp = (bd >> 32) + (ad & M32) + (bc & M32) + ((ScmUInt64)1<<31);
+    diy_fp r;
+    r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+    r.e = x.e + y.e + 64;
+    return r;
+}
+
+/* Adjust the last digit toward the real value.  Returns FALSE if we
+   can't be sure the result is the closest one within the range.
+   All the distances are measured from the upper (unsafe) limit. */
+static int grisu_round_weed(char *buf, int len, ScmUInt64 dist_high_w,
+                            ScmUInt64 unsafe, ScmUInt64 rest,
+                            ScmUInt64 ten_kappa, ScmUInt64 unit)
+{
+    ScmUInt64 small_dist = dist_high_w - unit;
+    ScmUInt64 big_dist = dist_high_w + unit;
+
+    while (rest < small_dist
+           && unsafe - rest >= ten_kappa
+           && (rest + ten_kappa < small_dist
+               || small_dist - rest >= rest + ten_kappa - small_dist)) {
+        buf[len-1]--;
+        rest += ten_kappa;
+    }
+    if (rest < big_dist
+        && unsafe - rest >= ten_kappa
+        && (rest + ten_kappa < big_dist
+            || big_dist - rest > rest + ten_kappa - big_dist)) {
+        return FALSE;
+    }
+    return (2*unit <= rest) && (rest <= unsafe - 4*unit);
+}
+
+/* Generate digits of W, which is between LOW and HIGH, all scaled by
+   a power of ten so that their exponents are within [alpha, gamma].
+   The digits are stored in BUF, and *KAPPA gets the exponent of
+   the last digit. */
+static int grisu_digit_gen(diy_fp low, diy_fp w, diy_fp high,
+                           char *buf, int *len, int *kappa)
+{
+    ScmUInt64 unit = 1;
+    ScmUInt64 too_low = low.f - unit;
+    ScmUInt64 too_high = high.f + unit;
+    ScmUInt64 unsafe = too_high - too_low;
+    int shift = -w.e;
+    ScmUInt64 one = (ScmUInt64)1 << shift;
+    u_int integrals = (u_int)(too_high >> shift);
+    ScmUInt64 fractionals = too_high & (one - 1);
+    u_int divisor = 1;
+    int k = 0;
+
+    /* The largest power of ten that's not more than INTEGRALS. */
+    while (divisor <= integrals/10) {
+        divisor *= 10;
+        k++;
+    }
+    if (integrals > 0) k++; else divisor = 0;
+
+    *kappa = k;
+    *len = 0;
+    while (*kappa > 0) {
+        buf[(*len)++] = (char)('0' + integrals/divisor);
+        integrals %= divisor;
+        (*kappa)--;
+        ScmUInt64 rest = ((ScmUInt64)integrals << shift) + fractionals;
+        if (rest < unsafe) {
+            return grisu_round_weed(buf, *len, too_high - w.f, unsafe, rest,
+                                    (ScmUInt64)divisor << shift, unit);
+        }
+        divisor /= 10;
+    }
+    for (;;) {
+        fractionals *= 10;
+        unit *= 10;
+        unsafe *= 10;
+        buf[(*len)++] = (char)('0' + (int)(fractionals >> shift));
+        fractionals &= one - 1;
+        (*kappa)--;
+        if (fractionals < unsafe) {
+            return grisu_round_weed(buf, *len, (too_high - w.f)*unit, unsafe,
+                                    fractionals, one, unit);
+        }
+    }
+}
+
+/* Put the shortest digits of positive finite VAL into DIGITS, which
+   must have at least 18 bytes, and sets the number of digits to *NDIGITS
+   and the decimal exponent to *EST such that VAL = 0.DIGITS * 10^EST.
+   Returns FALSE if the digits can't be determined by this method. */
+static int grisu_digits(double val, char *digits, int *ndigits, int *est)
+{
+    union { double d; ScmUInt64 i; } u;
+    u.d = val;
+    ScmUInt64 frac = u.i & (((ScmUInt64)1<<52) - 1);
+    int bexp = (int)((u.i >> 52) & 0x7ff);
+    diy_fp v, w, mp, mm;
+
+    if (bexp == 0) {
+        v.f = frac;
+        v.e = -1074;
+    } else {
+        v.f = frac + ((ScmUInt64)1<<52);
+        v.e = bexp - 1075;
+    }
+    w = diy_fp_normalize(v);
+
+    /* m+ and m-.  Like print_double, we regard the lower boundary closer
+       whenever the significand is a power of two and VAL is normalized. */
+    mp.f = (v.f << 1) + 1;
+    mp.e = v.e - 1;
+    mp = diy_fp_normalize(mp);
+    if (frac == 0 && bexp != 0) {
+        mm.f = (v.f << 2) - 1;
+        mm.e = v.e - 2;
+    } else {
+        mm.f = (v.f << 1) - 1;
+        mm.e = v.e - 1;
+    }
+    mm.f <<= mm.e - mp.e;
+    mm.e = mp.e;
+
+    /* Pick a power of ten c such that the exponent of w*c is within
+       [alpha, gamma]. */
+    int min_e = GRISU_ALPHA - (w.e + 64);
+    int k = (int)ceil((min_e + 63) * 0.30102999566398114);
+    int index = (-CACHED_POW10_MIN_K + k - 1) / CACHED_POW10_K_STEP + 1;
+    diy_fp c;
+    c.f = cached_pow10[index].f;
+    c.e = cached_pow10[index].e;
+    int mk = cached_pow10[index].k;
+
+    int kappa;
+    if (!grisu_digit_gen(diy_fp_mul(mm, c), diy_fp_mul(w, c),
+                         diy_fp_mul(mp, c), digits, ndigits, &kappa)) {
+        return FALSE;
+    }
+    *est = kappa - mk + *ndigits;
+    return TRUE;
+}
+
+
+/* Format DIGITS with decimal exponent EST (VAL = 0.DIGITS * 10^EST) in
+   the same way as print_double.  BUF and BUFLEN are after the sign. */
+static void print_double_digits(char *buf, int buflen,
+                                const char *digits, int ndigits, int est,
+                                int exp_lo, int exp_hi)
+{
+    int point;
+    if (est < exp_hi && est > exp_lo) { point = est; est = 1; }
+    else { point = 1; }
+
+    if (point <= 0) {
+        *buf++ = '0'; buflen--;
+        *buf++ = '.', buflen--;
+        for (int digs=point;digs<0 && buflen>5;digs++) {
+            *buf++ = '0'; buflen--;
+        }
+    }
+
+    int digs;
+    for (digs=1; digs<ndigits; digs++) {
+        *buf++ = digits[digs-1];
+        if (digs == point) *buf++ = '.', buflen--;
+    }
+    *buf++ = digits[ndigits-1];
+
+    if (digs <= point) {
+        for (;digs<point&&buflen>5;digs++) {
+            *buf++ = '0', buflen--;
+        }
+        *buf++ = '.';
+        *buf++ = '0';
+    }
+
+    est--;
+    if (est != 0) {
+        *buf++ = 'e';
+        sprintf(buf, "%d", (int)est);
+    } else {
+        *buf++ = 0;
+    }
+}
+
+#endif /*!SCM_EMULATE_INT64*/
+
 /* The main routine to get string representation of double.
    Convert VAL to a string and store to BUF, which must have at least FLT_BUF
    bytes long.
@@ -3415,6 +3776,19 @@ static void print_double(char *buf, int buflen, double val, int plus_sign,
 
     if (val < 0.0) *buf++ = '-', buflen--;
     else if (plus_sign) *buf++ = '+', buflen--;
+
+#if !SCM_EMULATE_INT64
+    if (precision < 0) {
+        char digits[24];
+        int ndigits, est;
+        if (grisu_digits(fabs(val), digits, &ndigits, &est)) {
+            print_double_digits(buf, buflen, digits, ndigits, est,
+                                exp_lo, exp_hi);
+            return;
+        }
+    }
+#endif /*!SCM_EMULATE_INT64*/
+
     {
         /* variable names follows Burger&Dybvig paper. mp, mm for m+, m-.
            note that m+ == m- for most cases, and m+ == 2*m- for the rest.
@@ -3786,6 +4160,68 @@ static u_long bigdig[RADIX_MAX-RADIX_MIN+1] = { 0 };
 
 static ScmObj numread_error(const char *msg, struct numread_packet *context);
 
+/* Reading a long run of digits one by one is quadratic.  If we have
+   more than READ_DIGITS_DC_THRESHOLD digits, we split them into halves
+   recursively and combine them with multiplication, which is fast for
+   large numbers.  Runs no longer than READ_DIGITS_DC_BASE digits are
+   read directly. */
+#define READ_DIGITS_DC_THRESHOLD 1000
+#define READ_DIGITS_DC_BASE      400
+
+static inline int digit_value(char c, int radix)
+{
+    int v;
+    if (c >= '0' && c <= '9') v = c - '0';
+    else if (c >= 'a' && c <= 'z') v = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'Z') v = c - 'A' + 10;
+    else return -1;
+    return (v < radix)? v : -1;
+}
+
+/* LEN valid digits in STR, LEN <= READ_DIGITS_DC_BASE */
+static ScmObj read_digits_simple(const char *str, long len, int radix)
+{
+    int chunk = (int)longdigs[radix-RADIX_MIN] + 1;
+    u_long bdig = bigdig[radix-RADIX_MIN];
+    ScmBignum *acc = Scm_MakeBignumWithSize((int)(len/chunk) + 2, 0);
+    u_long v = 0;
+    int digits = 0;
+    for (long i = 0; i < len; i++) {
+        v = v * radix + digit_value(str[i], radix);
+        if (++digits == chunk) {
+            acc = Scm_BignumAccMultAddUI(acc, bdig, v);
+            v = 0;
+            digits = 0;
+        }
+    }
+    if (digits > 0) acc = Scm_BignumAccMultAddUI(acc, ipow(radix, digits), v);
+    return Scm_NormalizeBignum(acc);
+}
+
+/* LEN valid digits in STR.  POWS[i] is RADIX^(READ_DIGITS_DC_BASE*2^i),
+   calculated on demand, and NPOWS is the number of valid entries. */
+static ScmObj read_digits_dc(const char *str, long len, int radix,
+                             ScmObj *pows, int *npows)
+{
+    if (len <= READ_DIGITS_DC_BASE) return read_digits_simple(str, len, radix);
+
+    int level = 0;
+    while (((long)READ_DIGITS_DC_BASE << (level+1)) < len) level++;
+    if (*npows == 0) {
+        pows[0] = Scm_ExactIntegerExpt(SCM_MAKE_INT(radix),
+                                       SCM_MAKE_INT(READ_DIGITS_DC_BASE));
+        *npows = 1;
+    }
+    while (*npows <= level) {
+        pows[*npows] = Scm_Mul(pows[*npows-1], pows[*npows-1]);
+        (*npows)++;
+    }
+    long lolen = (long)READ_DIGITS_DC_BASE << level;
+    ScmObj hi = read_digits_dc(str, len - lolen, radix, pows, npows);
+    ScmObj lo = read_digits_dc(str + len - lolen, lolen, radix, pows, npows);
+    return Scm_Add(Scm_Mul(hi, pows[level]), lo);
+}
+
 /* Returns either small integer or bignum.
    initval may be a Scheme integer that will be 'concatenated' before
    the integer to be read; it is used to read floating-point number.
@@ -3821,6 +4257,34 @@ static ScmObj read_uint(const char **strp, int *lenp,
         digread = TRUE;
     }
 
+    if (len > READ_DIGITS_DC_THRESHOLD && !ctx->padread) {
+        long run = 0;
+        while (run < len && digit_value(str[run], radix) >= 0) run++;
+        if (run > READ_DIGITS_DC_THRESHOLD) {
+            ScmObj pows[SCM_WORD_BITS];
+            int npows = 0;
+            ScmObj v = read_digits_dc(str, run, radix, pows, &npows);
+            if (value_big != NULL || value_int != 0) {
+                ScmObj init = (value_big != NULL)
+                    ? Scm_NormalizeBignum(value_big)
+                    : Scm_MakeIntegerU(value_int);
+                v = Scm_Add(Scm_Mul(init,
+                                    Scm_ExactIntegerExpt(SCM_MAKE_INT(radix),
+                                                         Scm_MakeInteger(run))),
+                            v);
+            }
+            if (SCM_INTP(v)) {
+                value_big = SCM_BIGNUM(Scm_MakeBignumFromSI(SCM_INT_VALUE(v)));
+            } else {
+                value_big = SCM_BIGNUM(Scm_BignumCopy(SCM_BIGNUM(v)));
+            }
+            value_int = digits = 0;
+            digread = TRUE;
+            str += run;
+            len -= run;
+        }
+    }
+
     while (len--) {
         int digval = -1;
         char c = tolower(*str++);
@@ -3872,6 +4336,199 @@ static ScmObj read_uint(const char **strp, int *lenp,
     return Scm_NormalizeBignum(SCM_BIGNUM(value_big));
 }
 
+/*
+ * Fast path of number reader
+ *
+ * This version implements Eisel-Lemire algorithm (Daniel Lemire,
+ * "Number Parsing at a Gigabyte per Second", Software: Practice and
+ * Experience 51(8), 2021).  Given a decimal significand W that fits in
+ * 64bits and an exponent Q, it computes the closest double of W*10^Q
+ * with a 128bit approximation of 5^Q, and reports when it can't be
+ * sure of the rounding.  In that case we fall back to algorithmR.
+ */
+
+#if !SCM_EMULATE_INT64
+
+#define POW5_MIN_Q  (-342)
+#define POW5_MAX_Q  308
+
+/* pow5_128[2*(q-POW5_MIN_Q)] and pow5_128[2*(q-POW5_MIN_Q)+1] hold
+   the upper and lower 64bits of 5^q, normalized to [2^127, 2^128).
+   For negative q it is rounded up. */
+static ScmUInt64 pow5_128[(POW5_MAX_Q-POW5_MIN_Q+1)*2];
+static int pow5_128_initialized = FALSE;
+
+/* A minimal multiword arithmetic to calculate pow5_128.  A multiword
+   number is an array of POW5_WORDS 32bit words, least significant first. */
+#define POW5_WORDS  56
+#define POW5_NBITS  1760        /* we calculate 2^POW5_NBITS / 5^k */
+
+static int mw_bit(const ScmUInt32 *a, long i)
+{
+    if (i < 0 || i >= POW5_WORDS*32) return 0;
+    return (a[i/32] >> (i%32)) & 1;
+}
+
+static long mw_bitlen(const ScmUInt32 *a)
+{
+    for (int i=POW5_WORDS-1; i>=0; i--) {
+        if (a[i]) {
+            long n = i*32;
+            for (ScmUInt32 w = a[i]; w; w >>= 1) n++;
+            return n;
+        }
+    }
+    return 0;
+}
+
+static void mw_mul5(ScmUInt32 *a)
+{
+    ScmUInt64 carry = 0;
+    for (int i=0; i<POW5_WORDS; i++) {
+        carry += (ScmUInt64)a[i] * 5;
+        a[i] = (ScmUInt32)carry;
+        carry >>= 32;
+    }
+}
+
+static void mw_div5(ScmUInt32 *a)
+{
+    ScmUInt64 rem = 0;
+    for (int i=POW5_WORDS-1; i>=0; i--) {
+        rem = (rem << 32) | a[i];
+        a[i] = (ScmUInt32)(rem / 5);
+        rem %= 5;
+    }
+}
+
+/* Lower 128bits of floor(A / 2^s).  S may be negative. */
+static void mw_extract128(const ScmUInt32 *a, long s, ScmUInt64 *r)
+{
+    r[0] = r[1] = 0;
+    for (int i=0; i<128; i++) {
+        if (mw_bit(a, i+s)) r[i < 64 ? 1 : 0] |= (ScmUInt64)1 << (i%64);
+    }
+}
+
+static void pow5_128_init(void)
+{
+    ScmUInt32 p[POW5_WORDS], x[POW5_WORDS];
+    ScmUInt64 r[2];
+
+    /* 5^q, truncated */
+    memset(p, 0, sizeof(p));
+    p[0] = 1;
+    for (int q=0; q<=POW5_MAX_Q; q++) {
+        mw_extract128(p, mw_bitlen(p) - 128, r);
+        pow5_128[2*(q-POW5_MIN_Q)]   = r[0];
+        pow5_128[2*(q-POW5_MIN_Q)+1] = r[1];
+        mw_mul5(p);
+    }
+
+    /* 5^-k.  We keep x = floor(2^POW5_NBITS / 5^k) and p = 5^k, and
+       take the upper 128bits of floor(2^b / 5^k) + 1, where b is chosen
+       so that the quotient has enough precision. */
+    memset(p, 0, sizeof(p));
+    memset(x, 0, sizeof(x));
+    p[0] = 1;
+    x[POW5_NBITS/32] = 1U << (POW5_NBITS%32);
+    for (int k=1; k<=-POW5_MIN_Q; k++) {
+        mw_mul5(p);
+        mw_div5(x);
+        long z = mw_bitlen(p);
+        long b = (k <= 27) ? z + 127 : 2*z + 128;
+        long lo = POW5_NBITS - b;              /* floor(2^b/5^k) = x>>lo */
+        long t = mw_bitlen(x) - lo - 128;   /* excess bits */
+        int carry = TRUE;
+        for (long i=lo; i<lo+t; i++) {
+            if (!mw_bit(x, i)) { carry = FALSE; break; }
+        }
+        mw_extract128(x, lo+t, r);
+        if (carry && ++r[1] == 0 && ++r[0] == 0) {
+            r[0] = (ScmUInt64)1<<63;   /* overflowed to 2^128 */
+        }
+        pow5_128[2*(-k-POW5_MIN_Q)]   = r[0];
+        pow5_128[2*(-k-POW5_MIN_Q)+1] = r[1];
+    }
+    pow5_128_initialized = TRUE;
+}
+
+/* 64x64 -> 128bit multiplication */
+static inline void umul128(ScmUInt64 x, ScmUInt64 y,
+                           ScmUInt64 *hi, ScmUInt64 *lo)
+{
+    const ScmUInt64 M32 = 0xffffffffUL;
+    ScmUInt64 a = x >> 32, b = x & M32;
+    ScmUInt64 c = y >> 32, d = y & M32;
+    ScmUInt64 ac = a*c, bc = b*c, ad = a*d, bd = b*d;
+    ScmUInt64 mid = (bd >> 32) + (bc & M32) + (ad & M32);
+    *lo = (mid << 32) | (bd & M32);
+    *hi = ac + (bc >> 32) + (ad >> 32) + (mid >> 32);
+}
+
+/* Compute W * 10^Q, where W > 0.  Returns FALSE when the result can't
+   be determined by this method. */
+static int eisel_lemire(ScmUInt64 w, long q, double *result)
+{
+    if (q < POW5_MIN_Q || q > POW5_MAX_Q) return FALSE;
+    if (!pow5_128_initialized) pow5_128_init();
+
+    int lz = 0;
+    while (!(w & ((ScmUInt64)1<<63))) { w <<= 1; lz++; }
+
+    /* We need upper 55bits (mantissa + 1 + rounding bit + 1) of
+       the product.  If the lower bits of the first product are all
+       ones, the carry from the next word may affect it. */
+    int index = 2*(int)(q - POW5_MIN_Q);
+    ScmUInt64 hi, lo, hi2, lo2;
+    umul128(w, pow5_128[index], &hi, &lo);
+    if ((hi & 0x1ff) == 0x1ff) {
+        umul128(w, pow5_128[index+1], &hi2, &lo2);
+        lo += hi2;
+        if (hi2 > lo) hi++;
+    }
+    if (lo == ~(ScmUInt64)0 && (q < -27 || q > 55)) return FALSE;
+
+    int upperbit = (int)(hi >> 63);
+    ScmUInt64 mant = hi >> (upperbit + 9);
+    /* floor(log2(10^q)) + 63 + ... ; (217706*q)>>16 is floor(q*log2(10)) */
+    long power2 = ((217706*q) >> 16) + 63 + upperbit - lz + 1023;
+
+    if (power2 <= 0) {
+        /* denormalized */
+        if (-power2 + 1 >= 64) {
+            *result = 0.0;
+            return TRUE;
+        }
+        mant >>= -power2 + 1;
+        mant += (mant & 1);
+        mant >>= 1;
+        power2 = (mant < ((ScmUInt64)1<<52)) ? 0 : 1;
+    } else {
+        /* Ties can only occur for small q; we detect if the product is
+           exact and exactly halfway, and round to even. */
+        if (lo <= 1 && q >= -4 && q <= 23 && (mant & 3) == 1
+            && (mant << (upperbit + 9)) == hi) {
+            mant &= ~(ScmUInt64)1;
+        }
+        mant += (mant & 1);
+        mant >>= 1;
+        if (mant >= ((ScmUInt64)2<<52)) {
+            mant = (ScmUInt64)1<<52;
+            power2++;
+        }
+        mant &= ~((ScmUInt64)1<<52);
+        if (power2 >= 0x7ff) return FALSE; /* let the caller handle inf */
+    }
+
+    union { double d; ScmUInt64 i; } u;
+    u.i = mant | ((ScmUInt64)power2 << 52);
+    *result = u.d;
+    return TRUE;
+}
+
+#endif /*!SCM_EMULATE_INT64*/
+
 /*
  * Find a double number closest to f * 10^e, using z as the starting
  * approximation.  The algorithm (and its name) is taken from Will Clinger's
@@ -4142,6 +4799,27 @@ static ScmObj read_real(const char **strp, int *lenp,
        AlgorithmR.  We have to be careful, however, not to overflow
        the following GetDouble call. */
     int raise_factor = exponent - fracdigs;
+
+#if !SCM_EMULATE_INT64
+    /* Try Eisel-Lemire if the fraction fits in 64bits but the simple
+       exact case below doesn't apply. */
+    if (Scm_NumCmp(fraction, SCM_2_52) > 0
+        || raise_factor > MAX_EXACT_10_EXP
+        || raise_factor < -MAX_EXACT_10_EXP) {
+        int oor = FALSE;
+        ScmUInt64 w = 0;
+        if (SCM_INTP(fraction)) {
+            w = (ScmUInt64)SCM_INT_VALUE(fraction);
+        } else {
+            w = Scm_BignumToUI64(SCM_BIGNUM(fraction), SCM_CLAMP_NONE, &oor);
+        }
+        double d;
+        if (!oor && w > 0 && eisel_lemire(w, raise_factor, &d)) {
+            return Scm_MakeFlonum(minusp? -d : d);
+        }
+    }
+#endif /*!SCM_EMULATE_INT64*/
+
     double realnum = Scm_GetDouble(fraction);
 
     if (SCM_IS_INF(realnum)) {
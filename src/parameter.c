@@ -207,6 +207,48 @@ void Scm_DefinePrimitiveParameter(ScmModule *mod,
     *location = pd->loc;
 }
 
+/*
+ * Parameterize
+ *
+ * Rebinds the parameters at LOCS to VALS during the dynamic extent of
+ * calling THUNK.  Both the before and after handlers of the dynamic
+ * wind just swap the saved values with the current ones, so that the
+ * values at the time of leaving the extent are restored upon re-entry.
+ * We use a single subr for both, and no Scheme closures are involved.
+ * Filters and observers of Scheme-level parameters are handled by
+ * the caller (see parameterize in gauche.parameter).
+ */
+typedef struct parameterize_data_rec {
+    int num;
+    ScmParameterLoc *locs;
+    ScmObj *vals;
+} parameterize_data;
+
+static ScmObj parameterize_swap(ScmObj *args, int argc, void *data)
+{
+    parameterize_data *d = (parameterize_data*)data;
+    ScmVM *vm = Scm_VM();
+    for (int i=0; i<d->num; i++) {
+        d->vals[i] = Scm_ParameterSet(vm, &d->locs[i], d->vals[i]);
+    }
+    return SCM_UNDEFINED;
+}
+
+ScmObj Scm_VMParameterize(int num, const ScmParameterLoc *locs,
+                          const ScmObj *vals, ScmObj thunk)
+{
+    parameterize_data *d = SCM_NEW(parameterize_data);
+    d->num = num;
+    d->locs = SCM_NEW_ARRAY(ScmParameterLoc, num);
+    d->vals = SCM_NEW_ARRAY(ScmObj, num);
+    for (int i=0; i<num; i++) {
+        d->locs[i] = locs[i];
+        d->vals[i] = vals[i];
+    }
+    ScmObj swap = Scm_MakeSubr(parameterize_swap, d, 0, 0, SCM_FALSE);
+    return Scm_VMDynamicWind(swap, thunk, swap);
+}
+
 void Scm__InitParameter(void)
 {
     SCM_INTERNAL_MUTEX_INIT(parameter_mutex);
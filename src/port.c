@@ -31,16 +31,30 @@
  *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/* splice(2) and copy_file_range(2) on glibc need this. */
+#define _GNU_SOURCE
+
 #define LIBGAUCHE_BODY
 #include "gauche.h"
 #include "gauche/class.h"
 #include "gauche/priv/portP.h"
 #include "gauche/priv/builtin-syms.h"
+#include "atomic_ops.h"
 
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <ctype.h>
+#if defined(HAVE_SYS_SENDFILE_H)
+#include <sys/sendfile.h>
+#endif
+#if defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#endif
+#if defined(HAVE_SYS_UIO_H) && defined(HAVE_WRITEV) && !defined(GAUCHE_WINDOWS)
+#include <sys/uio.h>
+#define USE_WRITEV 1
+#endif
 
 #undef MAX
 #undef MIN
@@ -51,6 +65,8 @@
     (SCM_PORT(obj)->src.buf.mode & SCM_PORT_BUFFER_MODE_MASK)
 #define SCM_PORT_BUFFER_SIGPIPE_SENSITIVE_P(obj) \
     (SCM_PORT(obj)->src.buf.mode & SCM_PORT_BUFFER_SIGPIPE_SENSITIVE)
+#define SCM_PORT_BUFFER_NONBLOCKING_P(obj) \
+    (SCM_PORT(obj)->src.buf.mode & SCM_PORT_BUFFER_NONBLOCKING)
 
 /* Parameter location for the global reader lexical mode, from which
    ports inherit. */
@@ -65,7 +81,10 @@ static void port_finalize(ScmObj obj, void* data);
 static void register_buffered_port(ScmPort *port);
 static void unregister_buffered_port(ScmPort *port);
 static void bufport_flush(ScmPort*, int, int);
+static int  file_filler(ScmPort *p, int cnt);
+static int  file_flusher(ScmPort *p, int cnt, int forcep);
 static void file_closer(ScmPort *p);
+static void istr_unmap(ScmPort *p);
 
 static ScmObj get_port_name(ScmPort *port)
 {
@@ -100,12 +119,24 @@ static void set_port_sigpipe_sensitive(ScmPort *port, ScmObj val)
     Scm_SetPortBufferSigpipeSensitive(port, SCM_BOOL_VALUE(val));
 }
 
+static ScmObj get_port_nonblocking(ScmPort *port)
+{
+    return SCM_MAKE_BOOL(Scm_GetPortNonblocking(port));
+}
+
+static void set_port_nonblocking(ScmPort *port, ScmObj val)
+{
+    Scm_SetPortNonblocking(port, !SCM_FALSEP(val));
+}
+
 static ScmClassStaticSlotSpec port_slots[] = {
     SCM_CLASS_SLOT_SPEC("name", get_port_name, NULL),
     SCM_CLASS_SLOT_SPEC("buffering", get_port_buffering,
                         set_port_buffering),
     SCM_CLASS_SLOT_SPEC("sigpipe-sensitive?", get_port_sigpipe_sensitive,
                         set_port_sigpipe_sensitive),
+    SCM_CLASS_SLOT_SPEC("nonblocking?", get_port_nonblocking,
+                        set_port_nonblocking),
     SCM_CLASS_SLOT_SPEC("current-line", get_port_current_line, NULL),
     SCM_CLASS_SLOT_SPEC_END()
 };
@@ -153,12 +184,19 @@ static void port_cleanup(ScmPort *port)
     case SCM_PORT_FILE:
         if (SCM_PORT_DIR(port) == SCM_PORT_OUTPUT) {
             if (!SCM_PORT_ERROR_OCCURRED_P(port)) {
+                /* We don't want to lose the pending output. */
+                if (SCM_PORT_BUFFER_NONBLOCKING_P(port)) {
+                    Scm_SetPortNonblocking(port, FALSE);
+                }
                 bufport_flush(port, 0, TRUE);
             }
             unregister_buffered_port(port);
         }
         if (port->ownerp && port->src.buf.closer) port->src.buf.closer(port);
         break;
+    case SCM_PORT_ISTR:
+        if (port->flags & SCM_PORT_MMAP) istr_unmap(port);
+        break;
     case SCM_PORT_PROC:
         if (port->src.vt.Close) port->src.vt.Close(port);
         break;
@@ -234,6 +272,13 @@ void Scm_ClosePort(ScmPort *port)
  * Locking ports
  */
 
+/* Used by PORT_LOCK if the compiler doesn't provide atomic builtins. */
+int Scm__PortCASOwner(ScmPort *p, ScmVM *old, ScmVM *new_)
+{
+    return AO_compare_and_swap_full((volatile AO_t*)&p->lockOwner,
+                                    (AO_t)old, (AO_t)new_);
+}
+
 /* OBSOLETED */
 /* C routines can use PORT_SAFE_CALL, so we reimplemented this in libio.scm.
    Kept here for ABI compatibility; will be gone by 1.0.  */
@@ -623,6 +668,59 @@ void Scm_SetPortBufferSigpipeSensitive(ScmPort *port, int sensitive)
     }
 }
 
+/* Non-blocking mode.  It is only meaningful for ports directly working
+   on a file descriptor, so we reject other buffered ports. */
+int Scm_GetPortNonblocking(ScmPort *port)
+{
+    if (SCM_PORT_TYPE(port) != SCM_PORT_FILE) return FALSE;
+    return (SCM_PORT_BUFFER_NONBLOCKING_P(port) != FALSE);
+}
+
+void Scm_SetPortNonblocking(ScmPort *port, int nonblocking)
+{
+    if (SCM_PORT_TYPE(port) != SCM_PORT_FILE
+        || (SCM_PORT_DIR(port) == SCM_PORT_INPUT
+            && port->src.buf.filler != file_filler)
+        || (SCM_PORT_DIR(port) == SCM_PORT_OUTPUT
+            && port->src.buf.flusher != file_flusher)) {
+        Scm_Error("port doesn't support non-blocking mode: %S", port);
+    }
+#if !defined(GAUCHE_WINDOWS)
+    int fd = (int)(intptr_t)port->src.buf.data;
+    if (fd < 0) Scm_Error("port already closed: %S", port);
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) Scm_SysError("fcntl(F_GETFL) failed on %S", port);
+    if (nonblocking) flags |=  O_NONBLOCK;
+    else             flags &= ~O_NONBLOCK;
+    if (fcntl(fd, F_SETFL, flags) < 0) {
+        Scm_SysError("fcntl(F_SETFL) failed on %S", port);
+    }
+    if (nonblocking) {
+        port->src.buf.mode |=  SCM_PORT_BUFFER_NONBLOCKING;
+    } else {
+        port->src.buf.mode &= ~SCM_PORT_BUFFER_NONBLOCKING;
+    }
+#else  /*GAUCHE_WINDOWS*/
+    if (nonblocking) {
+        Scm_Error("non-blocking mode isn't supported on this platform: %S",
+                  port);
+    }
+#endif /*GAUCHE_WINDOWS*/
+}
+
+/* Raises an error that the operation on a non-blocking port P would block.
+   The condition is a compound of <system-error> with EAGAIN and
+   <io-read-error> or <io-write-error>, so the caller can wait for
+   the port to be ready, e.g. with a selector, and retry. */
+static void port_would_block(ScmPort *p, int dir)
+{
+    errno = EAGAIN;
+    Scm_PortError(p,
+                  (dir == SCM_PORT_INPUT
+                   ? SCM_PORT_ERROR_INPUT : SCM_PORT_ERROR_OUTPUT),
+                  "operation on non-blocking port %S would block", p);
+}
+
 /* Port case folding mode is usually set at port creation, according
    to the VM's case folding mode.   In rare occasion we need to switch
    it (but it's not generally recommended). */
@@ -716,10 +814,77 @@ static void bufport_flush(ScmPort *p, int cnt, int forcep)
     }
 }
 
+/* Called when the buffer doesn't have room for NEED bytes.  Flushes
+   the buffer to make room.  If the port is non-blocking, the flusher
+   may not be able to write anything; we raise an error in that case,
+   leaving the buffer content intact. */
+static void bufport_make_room(ScmPort *p, int need)
+{
+    bufport_flush(p, 0, FALSE);
+    if (SCM_PORT_BUFFER_NONBLOCKING_P(p)
+        && p->src.buf.end - p->src.buf.current < need) {
+        port_would_block(p, SCM_PORT_OUTPUT);
+    }
+}
+
+#if defined(USE_WRITEV)
+#if defined(IOV_MAX)
+#define WRITEV_MAX IOV_MAX
+#else
+#define WRITEV_MAX 16
+#endif
+
+/* Writes out the buffer content of a file port P, followed by the
+   chunks in IOV[1] ... IOV[IOVCNT-1], with writev(2).  IOV[0] is
+   used for the buffer content.  The buffer is empty on return. */
+static void bufport_writev(ScmPort *p, struct iovec *iov, int iovcnt)
+{
+    int fd = (int)(intptr_t)p->src.buf.data;
+    SCM_ASSERT(fd >= 0);
+    iov[0].iov_base = p->src.buf.buffer;
+    iov[0].iov_len = SCM_PORT_BUFFER_AVAIL(p);
+    p->src.buf.current = p->src.buf.buffer;
+
+    while (iovcnt > 0) {
+        ssize_t r;
+        errno = 0;
+        SCM_SYSCALL(r, writev(fd, iov, MIN(iovcnt, WRITEV_MAX)));
+        if (r < 0) {
+            /* See file_flusher */
+            if (SCM_PORT_BUFFER_SIGPIPE_SENSITIVE_P(p)) Scm_Exit(1);
+            p->error = TRUE;
+            Scm_SysError("write failed on %S", p);
+        }
+        while (iovcnt > 0 && (size_t)r >= iov->iov_len) {
+            r -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (r > 0) {
+            iov->iov_base = (char*)iov->iov_base + r;
+            iov->iov_len -= r;
+        }
+    }
+}
+#endif /*USE_WRITEV*/
+
 /* Writes siz bytes in src to the buffered port.  siz may be larger than
    the port's buffer.  Won't return until entire siz bytes are written. */
 static void bufport_write(ScmPort *p, const char *src, int siz)
 {
+#if defined(USE_WRITEV)
+    /* If the data doesn't fit in the buffer anyway, we pass it to
+       the kernel directly along with the buffer content, instead of
+       copying it into the buffer piecewise. */
+    if (siz >= p->src.buf.size && p->src.buf.flusher == file_flusher
+        && !SCM_PORT_BUFFER_NONBLOCKING_P(p)) {
+        struct iovec iov[2];
+        iov[1].iov_base = (void*)src;
+        iov[1].iov_len = siz;
+        bufport_writev(p, iov, 2);
+        return;
+    }
+#endif /*USE_WRITEV*/
     do {
         int room = (int)(p->src.buf.end - p->src.buf.current);
         if (room >= siz) {
@@ -731,7 +896,7 @@ static void bufport_write(ScmPort *p, const char *src, int siz)
             p->src.buf.current += room;
             siz -= room;
             src += room;
-            bufport_flush(p, 0, FALSE);
+            bufport_make_room(p, 1);
         }
     } while (siz > 0);
 }
@@ -740,6 +905,9 @@ static void bufport_write(ScmPort *p, const char *src, int siz)
  * If ALLOW_LESS is true, however, we allow to return before the full
  * data is read.
  * Returns the number of bytes actually read, or 0 if EOF, or -1 if error.
+ * On a non-blocking port, the read may stop when no more data is
+ * available; if we couldn't read anything, we return -1 when ALLOW_LESS
+ * is true, or raise an error otherwise.
  */
 static int bufport_fill(ScmPort *p, int min, int allow_less)
 {
@@ -761,6 +929,12 @@ static int bufport_fill(ScmPort *p, int min, int allow_less)
 
     do {
         int r = p->src.buf.filler(p, toread-nread);
+        if (r < 0 && SCM_PORT_BUFFER_NONBLOCKING_P(p)) {
+            /* No data is available now.  We return what we got. */
+            if (nread > 0) break;
+            if (allow_less) return -1;
+            port_would_block(p, SCM_PORT_INPUT);
+        }
         if (r <= 0) break;
         nread += r;
         p->src.buf.end += r;
@@ -778,6 +952,8 @@ static int bufport_fill(ScmPort *p, int min, int allow_less)
  * However, if the filler procedure returns exactly the requested size,
  * and we need more bytes, we gotta be careful -- next call to the filler
  * procedure may or may not block.  So we need to check the ready procedure.
+ * On a non-blocking port we return whatever we got, and raise an error
+ * only if no data is available at all.
  */
 static int bufport_read(ScmPort *p, char *dst, int siz)
 {
@@ -805,7 +981,8 @@ static int bufport_read(ScmPort *p, char *dst, int siz)
 
         int req = MIN(siz, p->src.buf.size);
         int r = bufport_fill(p, req, TRUE);
-        if (r <= 0) break; /* EOF or an error*/
+        if (r < 0 && nread == 0) port_would_block(p, SCM_PORT_INPUT);
+        if (r <= 0) break; /* EOF, an error, or no more data available */
         if (r >= siz) {
             memcpy(dst, p->src.buf.current, siz);
             p->src.buf.current += siz;
@@ -826,7 +1003,7 @@ static int bufport_read(ScmPort *p, char *dst, int siz)
  *
  *   The OS doesn't automatically flush the buffered output port,
  *   as it does on FILE* structure.  So Gauche keeps track of active
- *   output buffered ports, in a weak vector.
+ *   output buffered ports, in weak vectors.
  *   When the port is no longer used, it is collected by GC and removed
  *   from the vector.   Scm_FlushAllPorts() flushes the active ports.
  *
@@ -836,84 +1013,104 @@ static int bufport_read(ScmPort *p, char *dst, int siz)
  *   and at that moment GC has already cleared the vector entry.  So we
  *   can rather let GC remove the entries.
  *
- *   When we find the weak vector is full, we trigger a global GC once.
- *   It may collect garbaged ports and make some room in the vector,
- *   even though the ports are not finalized (GC_gcollect doesn't call
- *   finalizers; they are called at the next checkpoint in VM).
+ *   The table is split into PORT_SHARDS shards by the hash of the port's
+ *   address, each with its own mutex, so that threads opening and closing
+ *   ports don't contend on a single lock.  Each shard is an open-addressing
+ *   hash table in a weak vector.  We keep the upper bound of occupied
+ *   entries in 'used'; when it reaches half of the vector, we count the
+ *   live entries (GC may have cleared some of them) and double the vector
+ *   if they still occupy more than a quarter of it.
  */
 
-/*TODO: allow to extend the port vector. */
+#define PORT_SHARDS      16     /* need to be 2^n */
+#define PORT_SHARD_INIT  16     /* initial size of each shard, need to be 2^n */
 
-#define PORT_VECTOR_SIZE 256    /* need to be 2^n */
-
-static struct {
+static struct port_shard {
     int dummy;
     ScmWeakVector   *ports;
+    int size;                   /* size of ports */
+    int used;                   /* upper bound of occupied entries */
     ScmInternalMutex mutex;
-} active_buffered_ports = { 1, NULL }; /* magic to put this in .data area */
+} active_buffered_ports[PORT_SHARDS] = { { 1, NULL } }; /* magic to put this in .data area */
 
 #define PORT_HASH(port)  \
-    ((((SCM_WORD(port)>>3) * 2654435761UL)>>16) % PORT_VECTOR_SIZE)
+    (((SCM_WORD(port)>>3) * 2654435761UL)>>16)
+#define PORT_SHARD(port) \
+    (&active_buffered_ports[PORT_HASH(port) % PORT_SHARDS])
+#define PORT_SLOT(port, size) \
+    ((int)((PORT_HASH(port) / PORT_SHARDS) % (size)))
+
+/* Put PORT in the shard S.  S must have a free entry.
+   Used entry may have #<port> or #t.  #t is for transient state
+   during Scm_FlushAllPorts()---see below.  Must be called with
+   S's mutex held. */
+static void shard_insert(struct port_shard *s, ScmObj port)
+{
+    int i = PORT_SLOT(port, s->size), c = 0;
+    while (!SCM_FALSEP(Scm_WeakVectorRef(s->ports, i, SCM_FALSE))) {
+        i -= ++c; while (i<0) i+=s->size;
+    }
+    Scm_WeakVectorSet(s->ports, i, port);
+    s->used++;
+}
 
-static void register_buffered_port(ScmPort *port)
+/* Make sure the shard S has room for one more entry, keeping its load
+   factor no more than 1/2.  Must be called with S's mutex held. */
+static void shard_reserve(struct port_shard *s)
 {
-    int i, h, c;
-    int tried_gc = FALSE;
-    int need_gc  = FALSE;
-
-  retry:
-    h = i = (int)PORT_HASH(port);
-    c = 0;
-    /* search an available entry by quadratic hash
-       used entry may have #<port> or #t.  #t is for transient state
-       during Scm_FlushAllPorts()---see below. */
-    (void)SCM_INTERNAL_MUTEX_LOCK(active_buffered_ports.mutex);
-    while (!SCM_FALSEP(Scm_WeakVectorRef(active_buffered_ports.ports,
-                                         i, SCM_FALSE))) {
-        i -= ++c; while (i<0) i+=PORT_VECTOR_SIZE;
-        if (i == h) {
-            /* Vector entry is full.  We run global GC to try to collect
-               unused entry. */
-            need_gc = TRUE;
-            break;
-        }
+    if (s->used < s->size/2) return;
+
+    ScmWeakVector *old = s->ports;
+    int oldsize = s->size, live = 0;
+    for (int i=0; i<oldsize; i++) {
+        if (!SCM_FALSEP(Scm_WeakVectorRef(old, i, SCM_FALSE))) live++;
     }
-    if (!need_gc) {
-        Scm_WeakVectorSet(active_buffered_ports.ports, i, SCM_OBJ(port));
+    if (live < oldsize/4) {
+        /* Enough entries have been cleared by GC. */
+        s->used = live;
+        return;
     }
-    (void)SCM_INTERNAL_MUTEX_UNLOCK(active_buffered_ports.mutex);
-
-    if (need_gc) {
-        if (tried_gc) {
-            /* We should probably try to extend the weak vector.
-               But for the time being... */
-            Scm_Panic("active buffered port table overflow");
-        } else {
-            GC_gcollect();
-            tried_gc = TRUE;
-            need_gc = FALSE;
-            goto retry;
-        }
+    /* Rehash into a vector of double size.  Entries that are #t are
+       being flushed by Scm_FlushAllPorts, which will put the ports
+       back (see below), so we don't carry them over. */
+    s->size = oldsize*2;
+    s->ports = SCM_WEAK_VECTOR(Scm_MakeWeakVector(s->size));
+    s->used = 0;
+    for (int i=0; i<oldsize; i++) {
+        ScmObj p = Scm_WeakVectorRef(old, i, SCM_FALSE);
+        if (SCM_PORTP(p)) shard_insert(s, p);
     }
 }
 
+static void register_buffered_port(ScmPort *port)
+{
+    struct port_shard *s = PORT_SHARD(port);
+    (void)SCM_INTERNAL_MUTEX_LOCK(s->mutex);
+    shard_reserve(s);
+    shard_insert(s, SCM_OBJ(port));
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(s->mutex);
+}
+
 /* This should be called when the output buffered port is explicitly closed.
-   The ports collected by GC are automatically unregistered. */
+   The ports collected by GC are automatically unregistered.
+   The probe sequence visits every entry of the shard once, so a port
+   that isn't in the table costs a full scan of its shard; it only
+   happens when the port is closed while Scm_FlushAllPorts is flushing it. */
 static void unregister_buffered_port(ScmPort *port)
 {
-    int h = (int)PORT_HASH(port);
-    int i = h;
-    int c = 0;
-    (void)SCM_INTERNAL_MUTEX_LOCK(active_buffered_ports.mutex);
-    do {
-        ScmObj p = Scm_WeakVectorRef(active_buffered_ports.ports, i, SCM_FALSE);
+    struct port_shard *s = PORT_SHARD(port);
+    (void)SCM_INTERNAL_MUTEX_LOCK(s->mutex);
+    int i = PORT_SLOT(port, s->size);
+    for (int c = 0; c < s->size;) {
+        ScmObj p = Scm_WeakVectorRef(s->ports, i, SCM_FALSE);
         if (!SCM_FALSEP(p) && SCM_EQ(SCM_OBJ(port), p)) {
-            Scm_WeakVectorSet(active_buffered_ports.ports, i, SCM_FALSE);
+            Scm_WeakVectorSet(s->ports, i, SCM_FALSE);
+            s->used--;
             break;
         }
-        i -= ++c; while (i<0) i+=PORT_VECTOR_SIZE;
-    } while (i != h);
-    (void)SCM_INTERNAL_MUTEX_UNLOCK(active_buffered_ports.mutex);
+        i -= ++c; while (i<0) i+=s->size;
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(s->mutex);
 }
 
 /* Flush all ports.  Note that it is possible that this routine can be
@@ -924,42 +1121,62 @@ static void unregister_buffered_port(ScmPort *port)
    port vector anymore).
    Even if more than one thread calls Scm_FlushAllPorts simultaneously,
    the flush method is called only once for each vector.
+   If a shard is extended while we're flushing it, the entries we've
+   marked are not carried over to the new vector; we rescan the new
+   vector from the beginning, and put the saved ports back by insertion.
  */
 void Scm_FlushAllPorts(int exitting)
 {
-    ScmObj p = SCM_FALSE;
-    int saved = 0;
-
-    ScmVector *save = SCM_VECTOR(Scm_MakeVector(PORT_VECTOR_SIZE, SCM_FALSE));
-    ScmWeakVector *ports = active_buffered_ports.ports;
-
-    for (int i=0; i<PORT_VECTOR_SIZE;) {
-        (void)SCM_INTERNAL_MUTEX_LOCK(active_buffered_ports.mutex);
-        for (; i<PORT_VECTOR_SIZE; i++) {
-            p = Scm_WeakVectorRef(ports, i, SCM_FALSE);
-            if (SCM_PORTP(p)) {
-                Scm_VectorSet(save, i, p);
-                /* Set #t so that the slot won't be reused. */
-                Scm_WeakVectorSet(ports, i, SCM_TRUE);
-                saved++;
-                break;
+    for (int k=0; k<PORT_SHARDS; k++) {
+        struct port_shard *s = &active_buffered_ports[k];
+        ScmObj save = SCM_NIL;  /* ((vector index . port) ...) */
+        ScmWeakVector *ports = NULL;
+        int i = 0;
+
+        for (;;) {
+            ScmObj p = SCM_FALSE;
+            (void)SCM_INTERNAL_MUTEX_LOCK(s->mutex);
+            if (s->ports != ports) {
+                ports = s->ports;
+                i = 0;
             }
-        }
-        (void)SCM_INTERNAL_MUTEX_UNLOCK(active_buffered_ports.mutex);
-        if (SCM_PORTP(p)) {
+            for (; i<s->size; i++) {
+                p = Scm_WeakVectorRef(ports, i, SCM_FALSE);
+                if (SCM_PORTP(p)) {
+                    save = Scm_Cons(Scm_Cons(SCM_OBJ(ports),
+                                             Scm_Cons(SCM_MAKE_INT(i), p)),
+                                    save);
+                    /* Set #t so that the slot won't be reused. */
+                    Scm_WeakVectorSet(ports, i, SCM_TRUE);
+                    break;
+                }
+            }
+            (void)SCM_INTERNAL_MUTEX_UNLOCK(s->mutex);
+            if (!SCM_PORTP(p)) break;
             SCM_ASSERT(SCM_PORT_TYPE(p)==SCM_PORT_FILE);
             if (!SCM_PORT_ERROR_OCCURRED_P(SCM_PORT(p))) {
+                if (exitting && SCM_PORT_BUFFER_NONBLOCKING_P(p)) {
+                    Scm_SetPortNonblocking(SCM_PORT(p), FALSE);
+                }
                 bufport_flush(SCM_PORT(p), 0, TRUE);
             }
         }
-    }
-    if (!exitting && saved) {
-        (void)SCM_INTERNAL_MUTEX_LOCK(active_buffered_ports.mutex);
-        for (int i=0; i<PORT_VECTOR_SIZE; i++) {
-            p = Scm_VectorRef(save, i, SCM_FALSE);
-            if (SCM_PORTP(p)) Scm_WeakVectorSet(ports, i, p);
+        if (!exitting && !SCM_NULLP(save)) {
+            ScmObj cp;
+            (void)SCM_INTERNAL_MUTEX_LOCK(s->mutex);
+            SCM_FOR_EACH(cp, save) {
+                ScmObj e = SCM_CAR(cp);
+                ScmObj p = SCM_CDDR(e);
+                if (SCM_EQ(SCM_CAR(e), SCM_OBJ(s->ports))) {
+                    /* The slot is still reserved by #t. */
+                    Scm_WeakVectorSet(s->ports, SCM_INT_VALUE(SCM_CADR(e)), p);
+                } else {
+                    shard_reserve(s);
+                    shard_insert(s, p);
+                }
+            }
+            (void)SCM_INTERNAL_MUTEX_UNLOCK(s->mutex);
         }
-        (void)SCM_INTERNAL_MUTEX_UNLOCK(active_buffered_ports.mutex);
     }
 }
 
@@ -1040,6 +1257,10 @@ static int file_filler(ScmPort *p, int cnt)
         errno = 0;
         SCM_SYSCALL(r, read(fd, datptr, cnt-nread));
         if (r < 0) {
+            if ((errno == EAGAIN || errno == EWOULDBLOCK)
+                && SCM_PORT_BUFFER_NONBLOCKING_P(p)) {
+                return -1;      /* bufport_fill handles it */
+            }
             p->error = TRUE;
             Scm_SysError("read failed on %S", p);
         } else if (r == 0) {
@@ -1067,6 +1288,10 @@ static int file_flusher(ScmPort *p, int cnt, int forcep)
         errno = 0;
         SCM_SYSCALL(r, write(fd, datptr, datsiz-nwrote));
         if (r < 0) {
+            if ((errno == EAGAIN || errno == EWOULDBLOCK)
+                && SCM_PORT_BUFFER_NONBLOCKING_P(p)) {
+                break;          /* the caller checks the rest */
+            }
             if (SCM_PORT_BUFFER_SIGPIPE_SENSITIVE_P(p)) {
                 /* (sort of) emulate termination by SIGPIPE.
                    NB: The difference is visible from the outside world
@@ -1118,6 +1343,49 @@ static off_t file_seeker(ScmPort *p, off_t offset, int whence)
 }
 
 ScmObj Scm_OpenFilePort(const char *path, int flags, int buffering, int perm)
+{
+    return Scm_OpenFilePortWithHints(path, flags, buffering, perm,
+                                     0, SCM_PORT_ACCESS_NORMAL);
+}
+
+/* Buffer size of a sequentially accessed regular file, if no size is
+   given explicitly.  Larger buffer cuts the number of read(2) calls;
+   we don't allocate more than the file needs, though. */
+#define SCM_PORT_SEQUENTIAL_BUFSIZ (128*1024)
+
+static int sequential_bufsize(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) return 0;
+    if (st.st_size >= SCM_PORT_SEQUENTIAL_BUFSIZ) {
+        return SCM_PORT_SEQUENTIAL_BUFSIZ;
+    }
+    if (st.st_size <= SCM_PORT_DEFAULT_BUFSIZ) return 0;
+    /* round up to a multiple of the default size */
+    return (int)((st.st_size + SCM_PORT_DEFAULT_BUFSIZ - 1)
+                 / SCM_PORT_DEFAULT_BUFSIZ * SCM_PORT_DEFAULT_BUFSIZ);
+}
+
+/* Tells the kernel how the file will be accessed, so that it can adjust
+   readahead.  It's just a hint; we ignore errors (e.g. on pipes). */
+static void file_access_hint(int fd, int access)
+{
+#if defined(HAVE_POSIX_FADVISE)
+    switch (access) {
+    case SCM_PORT_ACCESS_SEQUENTIAL:
+        (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        break;
+    case SCM_PORT_ACCESS_RANDOM:
+        (void)posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+        break;
+    }
+#endif /*HAVE_POSIX_FADVISE*/
+}
+
+/* BUFSIZ is the size of the port buffer; 0 to choose one from ACCESS
+   and the file.  ACCESS is one of SCM_PORT_ACCESS_*. */
+ScmObj Scm_OpenFilePortWithHints(const char *path, int flags, int buffering,
+                                 int perm, int bufsiz, int access)
 {
     int dir = 0;
 
@@ -1127,6 +1395,10 @@ ScmObj Scm_OpenFilePort(const char *path, int flags, int buffering, int perm)
     if (buffering < SCM_PORT_BUFFER_FULL || buffering > SCM_PORT_BUFFER_NONE) {
         Scm_Error("bad buffering flag: %d", buffering);
     }
+    if (bufsiz < 0) Scm_Error("bad buffer size: %d", bufsiz);
+    if (access < SCM_PORT_ACCESS_NORMAL || access > SCM_PORT_ACCESS_RANDOM) {
+        Scm_Error("bad access pattern: %d", access);
+    }
 #if defined(GAUCHE_WINDOWS)
     /* Force binary mode if not specified */
     if (!(flags & (O_TEXT|O_BINARY))) {
@@ -1142,11 +1414,16 @@ ScmObj Scm_OpenFilePort(const char *path, int flags, int buffering, int perm)
        errors would be caught by later operations anyway.
     */
     if (flags & O_APPEND) (void)lseek(fd, 0, SEEK_END);
-    
+
+    file_access_hint(fd, access);
+    if (bufsiz == 0 && access == SCM_PORT_ACCESS_SEQUENTIAL) {
+        bufsiz = sequential_bufsize(fd);
+    }
+
     ScmPortBuffer bufrec;
     bufrec.mode = buffering;
     bufrec.buffer = NULL;
-    bufrec.size = 0;
+    bufrec.size = bufsiz;
     bufrec.filler = file_filler;
     bufrec.flusher = file_flusher;
     bufrec.closer = file_closer;
@@ -1193,6 +1470,411 @@ ScmObj Scm_MakePortWithFd(ScmObj name, int direction,
     return p;
 }
 
+/*
+ * Copying between file ports
+ *
+ *   Scm_PortCopyFd copies bytes from an input file port to an output
+ *   file port directly between the underlying file descriptors, letting
+ *   the kernel move the data when possible (copy_file_range(2),
+ *   sendfile(2) or splice(2)), instead of copying them through two
+ *   port buffers.  It is used by copy-port.
+ */
+
+#define FD_COPY_CHUNK  (1024*1024)
+
+enum {
+    FD_COPY_FILE_RANGE,         /* copy_file_range(2), file to file */
+    FD_COPY_SENDFILE,           /* sendfile(2), from file */
+    FD_COPY_SPLICE,             /* splice(2), either end is a pipe */
+    FD_COPY_READ_WRITE          /* fallback */
+};
+
+#if !defined(GAUCHE_WINDOWS)
+static ssize_t fd_write_all(int fd, const char *buf, size_t n)
+{
+    size_t nwrote = 0;
+    while (nwrote < n) {
+        ssize_t r;
+        SCM_SYSCALL(r, write(fd, buf+nwrote, n-nwrote));
+        if (r < 0) return -1;
+        nwrote += r;
+    }
+    return (ssize_t)nwrote;
+}
+
+/* Copies up to N bytes from IN to OUT with METHOD.  Returns the number
+   of bytes copied, 0 on EOF, or -1 on error with errno set. */
+static ssize_t fd_copy_step(int method, int in, int out, size_t n)
+{
+    ssize_t r;
+    switch (method) {
+#if defined(HAVE_COPY_FILE_RANGE)
+    case FD_COPY_FILE_RANGE:
+        SCM_SYSCALL(r, copy_file_range(in, NULL, out, NULL, n, 0));
+        return r;
+#endif
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+    case FD_COPY_SENDFILE:
+        SCM_SYSCALL(r, sendfile(out, in, NULL, n));
+        return r;
+#endif
+#if defined(HAVE_SPLICE)
+    case FD_COPY_SPLICE:
+        SCM_SYSCALL(r, splice(in, NULL, out, NULL, n, SPLICE_F_MOVE));
+        return r;
+#endif
+    default: {
+        char buf[SCM_PORT_DEFAULT_BUFSIZ];
+        if (n > sizeof(buf)) n = sizeof(buf);
+        SCM_SYSCALL(r, read(in, buf, n));
+        if (r <= 0) return r;
+        return fd_write_all(out, buf, r);
+    }
+    }
+}
+
+/* Returns TRUE if METHOD failed on the first call because it doesn't
+   support this pair of file descriptors, so that we can try another. */
+static int fd_copy_unsupported_p(int method, int e)
+{
+    if (method == FD_COPY_READ_WRITE) return FALSE;
+    return (e == EINVAL || e == ENOSYS || e == EXDEV
+#if defined(EOPNOTSUPP)
+            || e == EOPNOTSUPP
+#endif
+            /* copy_file_range rejects output opened with O_APPEND */
+            || (method == FD_COPY_FILE_RANGE && e == EBADF));
+}
+
+static int fd_copy_method(int in, int out)
+{
+    struct stat sin, sout;
+    if (fstat(in, &sin) < 0 || fstat(out, &sout) < 0) {
+        return FD_COPY_READ_WRITE;
+    }
+    if (S_ISREG(sin.st_mode) && S_ISREG(sout.st_mode)) {
+        return FD_COPY_FILE_RANGE;
+    }
+    if (S_ISREG(sin.st_mode)) return FD_COPY_SENDFILE;
+    if (S_ISFIFO(sin.st_mode) || S_ISFIFO(sout.st_mode)) {
+        return FD_COPY_SPLICE;
+    }
+    return FD_COPY_READ_WRITE;
+}
+
+static int fd_copyable_p(ScmPort *p, int dir)
+{
+    if (SCM_PORT_TYPE(p) != SCM_PORT_FILE || SCM_PORT_DIR(p) != dir) {
+        return FALSE;
+    }
+    if (SCM_PORT_CLOSED_P(p) || SCM_PORT_ERROR_OCCURRED_P(p)) return FALSE;
+    /* The loop below doesn't deal with EAGAIN. */
+    if (SCM_PORT_BUFFER_NONBLOCKING_P(p)) return FALSE;
+    if (dir == SCM_PORT_INPUT) {
+        /* We can't pass the bytes read ahead by peek-char/peek-byte. */
+        if (p->src.buf.filler != file_filler) return FALSE;
+        if (p->scrcnt > 0 || p->ungotten != SCM_CHAR_INVALID) return FALSE;
+    } else {
+        if (p->src.buf.flusher != file_flusher) return FALSE;
+    }
+    return (int)(intptr_t)p->src.buf.data >= 0;
+}
+
+/* Called with both ports locked. */
+static ScmSmallInt port_copy_fd(ScmPort *src, ScmPort *dst, ScmSmallInt limit)
+{
+    if (!fd_copyable_p(src, SCM_PORT_INPUT)
+        || !fd_copyable_p(dst, SCM_PORT_OUTPUT)) {
+        return -1;
+    }
+    int in = (int)(intptr_t)src->src.buf.data;
+    int out = (int)(intptr_t)dst->src.buf.data;
+    ScmSmallInt count = 0;
+
+    /* Flush what's written to DST so far, then pass the bytes already
+       in SRC's buffer. */
+    bufport_flush(dst, 0, TRUE);
+    ScmSmallInt pending = src->src.buf.end - src->src.buf.current;
+    if (limit >= 0 && pending > limit) pending = limit;
+    if (pending > 0) {
+        if (fd_write_all(out, src->src.buf.current, pending) < 0) goto err;
+        src->src.buf.current += pending;
+        src->bytes += pending;
+        count = pending;
+    }
+
+    int method = fd_copy_method(in, out);
+    int started = FALSE;
+    while (limit < 0 || count < limit) {
+        size_t n = FD_COPY_CHUNK;
+        if (limit >= 0 && (size_t)(limit - count) < n) n = limit - count;
+        ssize_t r = fd_copy_step(method, in, out, n);
+        if (r < 0) {
+            if (!started && fd_copy_unsupported_p(method, errno)) {
+                method = (method == FD_COPY_FILE_RANGE)
+                    ? FD_COPY_SENDFILE : FD_COPY_READ_WRITE;
+                continue;
+            }
+            goto err;
+        }
+        if (r == 0) break;
+        started = TRUE;
+        src->bytes += r;
+        count += r;
+    }
+    return count;
+
+  err:
+    if (errno == EPIPE && SCM_PORT_BUFFER_SIGPIPE_SENSITIVE_P(dst)) {
+        /* Emulate termination by SIGPIPE; see file_flusher. */
+        Scm_Exit(1);
+    }
+    Scm_SysError("copying from %S to %S failed", src, dst);
+    return -1;                  /* dummy */
+}
+
+static ScmSmallInt port_copy_fd_lock_dst(ScmPort *src, ScmPort *dst,
+                                         ScmSmallInt limit)
+{
+    ScmVM *vm = Scm_VM();
+    ScmSmallInt r = -1;
+    PORT_LOCK(dst, vm);
+    PORT_SAFE_CALL(dst, r = port_copy_fd(src, dst, limit), /*no cleanup*/);
+    PORT_UNLOCK(dst);
+    return r;
+}
+#endif /*!GAUCHE_WINDOWS*/
+
+/* Copies up to LIMIT bytes (or until EOF if LIMIT is negative) from
+   SRC to DST.  Returns the number of bytes copied.  If the ports aren't
+   both plain file ports this doesn't touch them and returns -1; the
+   caller should copy in the usual way then. */
+ScmSmallInt Scm_PortCopyFd(ScmPort *src, ScmPort *dst, ScmSmallInt limit)
+{
+#if !defined(GAUCHE_WINDOWS)
+    ScmVM *vm = Scm_VM();
+    ScmSmallInt r = -1;
+    PORT_LOCK(src, vm);
+    PORT_SAFE_CALL(src, r = port_copy_fd_lock_dst(src, dst, limit),
+                   /*no cleanup*/);
+    PORT_UNLOCK(src);
+    return r;
+#else  /*GAUCHE_WINDOWS*/
+    return -1;
+#endif /*GAUCHE_WINDOWS*/
+}
+
+/*
+ * Buffer views
+ *
+ *   Scm_ReadBlockView returns an immutable u8vector that shares the
+ *   input port's internal storage instead of copying it out, holding
+ *   up to MAX bytes of whatever is immediately available (it fills the
+ *   buffer once if it is empty).  The content of the view is valid only
+ *   until the next input operation on the port, which may overwrite the
+ *   buffer.  Returns EOF at the end of input.
+ *
+ *   For file ports the view aliases the port buffer; for input string
+ *   ports it aliases the string body, which never changes.  Other ports,
+ *   and bytes pending in the scratch area, are copied.
+ */
+
+/* A view needn't be as long as requested, so we don't allocate more
+   than a buffer's worth here. */
+static ScmObj read_view_copy(ScmPort *p, ScmSmallInt max)
+{
+    if (max > SCM_PORT_DEFAULT_BUFSIZ) max = SCM_PORT_DEFAULT_BUFSIZ;
+    char *buf = SCM_NEW_ATOMIC2(char*, max);
+    int n = Scm_GetzUnsafe(buf, (int)max, p);
+    if (n <= 0) return SCM_EOF;
+    return Scm_MakeUVectorFull(SCM_CLASS_U8VECTOR, n, buf, TRUE, NULL);
+}
+
+static ScmObj read_view(ScmPort *p, ScmSmallInt max)
+{
+    if (SCM_PORT_CLOSED_P(p)) {
+        Scm_PortError(p, SCM_PORT_ERROR_CLOSED,
+                      "I/O attempted on closed port: %S", p);
+    }
+    if (p->scrcnt || p->ungotten != SCM_CHAR_INVALID) {
+        return read_view_copy(p, max);
+    }
+
+    ScmSmallInt n;
+    char *start;
+    switch (SCM_PORT_TYPE(p)) {
+    case SCM_PORT_FILE:
+        if (p->src.buf.current >= p->src.buf.end) {
+            int r = bufport_fill(p, 0, TRUE);
+            if (r < 0) port_would_block(p, SCM_PORT_INPUT);
+            if (r == 0) return SCM_EOF;
+        }
+        start = p->src.buf.current;
+        n = MIN(max, p->src.buf.end - start);
+        p->src.buf.current += n;
+        break;
+    case SCM_PORT_ISTR:
+        if (p->src.istr.current >= p->src.istr.end) return SCM_EOF;
+        start = (char*)p->src.istr.current;
+        n = MIN(max, p->src.istr.end - p->src.istr.current);
+        p->src.istr.current += n;
+        break;
+    default:
+        return read_view_copy(p, max);
+    }
+    p->bytes += n;
+    return Scm_MakeUVectorFull(SCM_CLASS_U8VECTOR, n, start, TRUE, p);
+}
+
+ScmObj Scm_ReadBlockView(ScmPort *p, ScmSmallInt max)
+{
+    if (SCM_PORT_DIR(p) != SCM_PORT_INPUT) {
+        Scm_Error("input port required, but got %S", p);
+    }
+    if (max <= 0) {
+        return Scm_MakeUVector(SCM_CLASS_U8VECTOR, 0, NULL);
+    }
+
+    ScmVM *vm = Scm_VM();
+    ScmObj r = SCM_EOF;
+    PORT_LOCK(p, vm);
+    PORT_SAFE_CALL(p, r = read_view(p, max), /*no cleanup*/);
+    PORT_UNLOCK(p);
+    return r;
+}
+
+/*
+ * Partial writes on non-blocking ports
+ */
+
+/* Puts as many whole UNIT-byte chunks of S as the port accepts without
+   blocking.  Must be called with P locked. */
+static int try_write(const char *s, int siz, int unit, ScmPort *p)
+{
+    int total = 0;
+
+    if (SCM_PORT_CLOSED_P(p)) {
+        Scm_PortError(p, SCM_PORT_ERROR_CLOSED,
+                      "I/O attempted on closed port: %S", p);
+    }
+    if (PORT_WALKER_P(p)) return siz;
+    while (total < siz) {
+        int room = (int)(p->src.buf.end - p->src.buf.current);
+        int n = MIN(siz - total, room/unit*unit);
+        memcpy(p->src.buf.current, s + total, n);
+        p->src.buf.current += n;
+        total += n;
+        if (total == siz) break;
+        bufport_flush(p, 0, FALSE);
+        if (p->src.buf.end - p->src.buf.current < unit) break;
+    }
+    if (SCM_PORT_BUFFER_MODE(p) != SCM_PORT_BUFFER_FULL) {
+        bufport_flush(p, 0, TRUE);
+    }
+    if (total == 0 && siz > 0) port_would_block(p, SCM_PORT_OUTPUT);
+    return total;
+}
+
+/* Writes SIZ bytes from S to P, and returns the number of bytes written.
+   If P is a non-blocking port, this may write less than SIZ bytes,
+   but always a multiple of UNIT, when the port can't take more data
+   without blocking.  If it can't take any, an error is raised.
+   Other ports behave just as Scm_Putz. */
+int Scm_PutzNonblocking(const char *s, int siz, int unit, ScmPort *p)
+{
+    if (unit <= 0) unit = 1;
+    if (!Scm_GetPortNonblocking(p)
+        || SCM_PORT_DIR(p) != SCM_PORT_OUTPUT
+        || p->src.buf.size < unit) {
+        Scm_Putz(s, siz, p);
+        return siz;
+    }
+
+    int r = 0;
+    ScmVM *vm = Scm_VM();
+    PORT_LOCK(p, vm);
+    PORT_SAFE_CALL(p, r = try_write(s, siz, unit, p), /*no cleanup*/);
+    PORT_UNLOCK(p);
+    return r;
+}
+
+/*
+ * Gathering writes
+ */
+
+static void write_gather(ScmObj items, int n, ScmPort *p)
+{
+    ScmObj cp;
+
+    if (SCM_PORT_CLOSED_P(p)) {
+        Scm_PortError(p, SCM_PORT_ERROR_CLOSED,
+                      "I/O attempted on closed port: %S", p);
+    }
+    if (PORT_WALKER_P(p)) return;
+#if defined(USE_WRITEV)
+    if (SCM_PORT_TYPE(p) == SCM_PORT_FILE
+        && p->src.buf.flusher == file_flusher
+        && !SCM_PORT_BUFFER_NONBLOCKING_P(p)) {
+        struct iovec *iov = SCM_NEW_ATOMIC_ARRAY(struct iovec, n+1);
+        int i = 1;
+        SCM_FOR_EACH(cp, items) {
+            ScmObj x = SCM_CAR(cp);
+            if (SCM_STRINGP(x)) {
+                u_int size;
+                iov[i].iov_base =
+                    (void*)Scm_GetStringContent(SCM_STRING(x), &size,
+                                                NULL, NULL);
+                iov[i].iov_len = size;
+            } else {
+                iov[i].iov_base = SCM_UVECTOR_ELEMENTS(x);
+                iov[i].iov_len = Scm_UVectorSizeInBytes(SCM_UVECTOR(x));
+            }
+            i++;
+        }
+        bufport_writev(p, iov, n+1);
+        return;
+    }
+#endif /*USE_WRITEV*/
+    SCM_FOR_EACH(cp, items) {
+        ScmObj x = SCM_CAR(cp);
+        if (SCM_STRINGP(x)) {
+            u_int size;
+            const char *s = Scm_GetStringContent(SCM_STRING(x), &size,
+                                                 NULL, NULL);
+            Scm_PutzUnsafe(s, size, p);
+        } else {
+            Scm_PutzUnsafe((const char*)SCM_UVECTOR_ELEMENTS(x),
+                           Scm_UVectorSizeInBytes(SCM_UVECTOR(x)), p);
+        }
+    }
+}
+
+/* Writes the content of strings and uvectors in the list ITEMS to
+   PORT, in order.  On a file port the buffer content and all the items
+   are written out immediately with a single writev(2) call (unless
+   there are more items than the system allows in one call).  On other
+   ports it's the same as writing each item with Scm_Putz. */
+void Scm_WriteGather(ScmObj items, ScmPort *port)
+{
+    ScmObj cp;
+    int n = 0;
+    SCM_FOR_EACH(cp, items) {
+        ScmObj x = SCM_CAR(cp);
+        if (!SCM_STRINGP(x) && !SCM_UVECTORP(x)) {
+            Scm_Error("string or uvector required, but got %S", x);
+        }
+        n++;
+    }
+    if (!SCM_NULLP(cp)) {
+        Scm_Error("proper list required, but got %S", items);
+    }
+
+    ScmVM *vm = Scm_VM();
+    PORT_LOCK(port, vm);
+    PORT_SAFE_CALL(port, write_gather(items, n, port), /*no cleanup*/);
+    PORT_UNLOCK(port);
+}
+
 /*===============================================================
  * String port
  */
@@ -1219,6 +1901,71 @@ ScmObj Scm_MakeOutputStringPort(int privatep)
     return SCM_OBJ(p);
 }
 
+/* Input string port over a memory-mapped file.  The port reads
+   the mapped pages directly, without read(2) nor the port buffer.
+   The mapping is released when the port is closed or collected,
+   so Scm_GetRemainingInputString copies the content for this port. */
+ScmObj Scm_OpenMmapFilePort(const char *path)
+{
+#if defined(HAVE_SYS_MMAN_H) && !defined(GAUCHE_WINDOWS)
+    int fd;
+    struct stat st;
+    void *addr = NULL;
+
+    SCM_SYSCALL(fd, open(path, O_RDONLY));
+    if (fd < 0) return SCM_FALSE;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        Scm_SysError("fstat failed on %s", path);
+    }
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        Scm_Error("regular file required to map, but got %s", path);
+    }
+    if ((uintmax_t)st.st_size > (uintmax_t)SIZE_MAX) {
+        close(fd);
+        Scm_Error("file too large to map: %s", path);
+    }
+    if (st.st_size > 0) {
+        addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            int e = errno;
+            close(fd);
+            errno = e;
+            Scm_SysError("mmap failed on %s", path);
+        }
+    }
+    /* The mapping stays valid after closing fd. */
+    close(fd);
+
+    ScmPort *p = make_port(SCM_CLASS_PORT, SCM_PORT_INPUT, SCM_PORT_ISTR);
+    if (addr) {
+        p->src.istr.start = (const char*)addr;
+        p->src.istr.end = (const char*)addr + st.st_size;
+        p->flags |= SCM_PORT_MMAP;
+    } else {
+        p->src.istr.start = p->src.istr.end = "";
+    }
+    p->src.istr.current = p->src.istr.start;
+    p->name = SCM_MAKE_STR_COPYING(path);
+    return SCM_OBJ(p);
+#else  /* !HAVE_SYS_MMAN_H || GAUCHE_WINDOWS */
+    Scm_Error("memory-mapped file ports aren't supported on this platform");
+    return SCM_UNDEFINED;       /* dummy */
+#endif /* !HAVE_SYS_MMAN_H || GAUCHE_WINDOWS */
+}
+
+static void istr_unmap(ScmPort *p)
+{
+#if defined(HAVE_SYS_MMAN_H) && !defined(GAUCHE_WINDOWS)
+    void *addr = (void*)p->src.istr.start;
+    size_t len = (size_t)(p->src.istr.end - p->src.istr.start);
+    p->src.istr.start = p->src.istr.current = p->src.istr.end = "";
+    p->flags &= ~SCM_PORT_MMAP;
+    (void)munmap(addr, len);
+#endif
+}
+
 ScmObj Scm_GetOutputString(ScmPort *port, int flags)
 {
     if (SCM_PORT_TYPE(port) != SCM_PORT_OSTR)
@@ -1237,6 +1984,20 @@ ScmObj Scm_GetOutputStringUnsafe(ScmPort *port, int flags)
     return Scm_DStringGet(&SCM_PORT(port)->src.ostr, flags);
 }
 
+/* Like Scm_GetOutputString, but the result may share the port's buffer
+   (see Scm_DStringTake).  For the case the port is discarded right after,
+   e.g. with-output-to-string. */
+ScmObj Scm_TakeOutputString(ScmPort *port, int flags)
+{
+    if (SCM_PORT_TYPE(port) != SCM_PORT_OSTR)
+        Scm_Error("output string port required, but got %S", port);
+    ScmVM *vm = Scm_VM();
+    PORT_LOCK(port, vm);
+    ScmObj r = Scm_DStringTake(&SCM_PORT(port)->src.ostr, flags);
+    PORT_UNLOCK(port);
+    return r;
+}
+
 /* TRANSIENT: Pre-0.9 Compatibility routine.  Kept for the binary compatibility.
    Will be removed on 1.0 */
 ScmObj Scm__GetOutputStringCompat(ScmPort *port)
@@ -1262,6 +2023,7 @@ ScmObj Scm_GetRemainingInputString(ScmPort *port, int flags)
         Scm_Error("input string port required, but got %S", port);
     /* NB: we don't need to lock the port, since the string body
        the port is pointing won't be changed. */
+    if (port->flags & SCM_PORT_MMAP) flags |= SCM_STRING_COPYING;
     const char *ep = port->src.istr.end;
     const char *cp = port->src.istr.current;
     /* Things gets complicated if there's an ungotten char or bytes.
@@ -1810,8 +2572,13 @@ ScmObj Scm_SetCurrentErrorPort(ScmPort *port)
 
 void Scm__InitPort(void)
 {
-    (void)SCM_INTERNAL_MUTEX_INIT(active_buffered_ports.mutex);
-    active_buffered_ports.ports = SCM_WEAK_VECTOR(Scm_MakeWeakVector(PORT_VECTOR_SIZE));
+    for (int k=0; k<PORT_SHARDS; k++) {
+        struct port_shard *s = &active_buffered_ports[k];
+        (void)SCM_INTERNAL_MUTEX_INIT(s->mutex);
+        s->ports = SCM_WEAK_VECTOR(Scm_MakeWeakVector(PORT_SHARD_INIT));
+        s->size = PORT_SHARD_INIT;
+        s->used = 0;
+    }
 
     Scm_InitStaticClass(&Scm_PortClass, "<port>",
                         Scm_GaucheModule(), port_slots, 0);
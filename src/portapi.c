@@ -118,7 +118,7 @@ void Scm_PutbUnsafe(ScmByte b, ScmPort *p)
     switch (SCM_PORT_TYPE(p)) {
     case SCM_PORT_FILE:
         if (p->src.buf.current >= p->src.buf.end) {
-            SAFE_CALL(p, bufport_flush(p, (int)(p->src.buf.current - p->src.buf.buffer), FALSE));
+            SAFE_CALL(p, bufport_make_room(p, 1));
         }
         SCM_ASSERT(p->src.buf.current < p->src.buf.end);
         *p->src.buf.current++ = b;
@@ -162,7 +162,7 @@ void Scm_PutcUnsafe(ScmChar c, ScmPort *p)
     case SCM_PORT_FILE: {
         int nb = SCM_CHAR_NBYTES(c);
         if (p->src.buf.current+nb > p->src.buf.end) {
-            SAFE_CALL(p, bufport_flush(p, (int)(p->src.buf.current - p->src.buf.buffer), FALSE));
+            SAFE_CALL(p, bufport_make_room(p, nb));
         }
         SCM_ASSERT(p->src.buf.current+nb <= p->src.buf.end);
         SCM_CHAR_PUT(p->src.buf.current, c);
@@ -308,6 +308,10 @@ void Scm_FlushUnsafe(ScmPort *p)
     switch (SCM_PORT_TYPE(p)) {
     case SCM_PORT_FILE:
         SAFE_CALL(p, bufport_flush(p, 0, TRUE));
+        if (SCM_PORT_BUFFER_NONBLOCKING_P(p) && SCM_PORT_BUFFER_AVAIL(p) > 0) {
+            UNLOCK(p);
+            port_would_block(p, SCM_PORT_OUTPUT);
+        }
         UNLOCK(p);
         break;
     case SCM_PORT_OSTR:
@@ -819,15 +823,63 @@ int Scm_GetzUnsafe(char *buf, int buflen, ScmPort *p)
 
 /* Auxiliary procedures */
 
-/* NB: it may be further optimized by scanning the contents of buffer
-   when the port is a buffered port or an input string, which allows
-   us to avoid mb->wc->mb conversion.   See port.c, v 1.69 for some
-   attempt to do so.  The problem there is that if I have to take
-   into account the cases of the ungotten char and the scratch buffer,
-   code becomes ugly.  There might be some better approach. */
-
 #ifndef READLINE_AUX
 #define READLINE_AUX
+
+static ScmObj readline_eof(ScmDString *ds)
+{
+    if (Scm_DStringSize(ds) == 0) return SCM_EOF;
+    return Scm_DStringGet(ds, 0);
+}
+
+/* Fast path for buffered ports and input string ports, used when
+   nothing is ungotten.  Instead of reading byte by byte, we look for
+   '\n' in the buffer with memchr and take the line out of it at once.
+   If we see '\r', we leave it to the byte-by-byte loop and return
+   SCM_UNBOUND; the bytes before it are in DS. */
+static ScmObj readline_fast(ScmPort *p, ScmDString *ds)
+{
+    int filep = (SCM_PORT_TYPE(p) == SCM_PORT_FILE);
+    for (;;) {
+        const char *cur, *end;
+        if (filep) {
+            if (p->src.buf.current >= p->src.buf.end
+                && bufport_fill(p, 1, FALSE) == 0) {
+                return readline_eof(ds);
+            }
+            cur = p->src.buf.current;
+            end = p->src.buf.end;
+        } else {
+            cur = p->src.istr.current;
+            end = p->src.istr.end;
+            if (cur >= end) return readline_eof(ds);
+        }
+
+        const char *nl = memchr(cur, '\n', end - cur);
+        const char *stop = nl? nl : end;
+        const char *cr = memchr(cur, '\r', stop - cur);
+        if (cr) {
+            stop = cr;
+            nl = NULL;
+        }
+        const char *next = nl? nl+1 : stop;
+        if (filep) p->src.buf.current = (char*)next;
+        else       p->src.istr.current = next;
+        p->bytes += next - cur;
+
+        if (nl) {
+            p->line++;
+            if (Scm_DStringSize(ds) == 0) {
+                return Scm_MakeString(cur, nl - cur, -1, SCM_STRING_COPYING);
+            }
+            Scm_DStringPutz(ds, cur, nl - cur);
+            return Scm_DStringGet(ds, 0);
+        }
+        Scm_DStringPutz(ds, cur, stop - cur);
+        if (cr) return SCM_UNBOUND;
+    }
+}
+
 /* Assumes the port is locked, and the caller takes care of unlocking
    even if an error is signalled within this body */
 /* NB: this routine reads bytes, not chars.  It allows to readline
@@ -838,8 +890,15 @@ ScmObj readline_body(ScmPort *p)
     ScmDString ds;
 
     Scm_DStringInit(&ds);
+    if (p->scrcnt == 0 && p->ungotten == SCM_CHAR_INVALID
+        && !SCM_PORT_CLOSED_P(p)
+        && (SCM_PORT_TYPE(p) == SCM_PORT_FILE
+            || SCM_PORT_TYPE(p) == SCM_PORT_ISTR)) {
+        ScmObj r = readline_fast(p, &ds);
+        if (!SCM_UNBOUNDP(r)) return r;
+    }
     int b1 = Scm_GetbUnsafe(p);
-    if (b1 == EOF) return SCM_EOF;
+    if (b1 == EOF) return readline_eof(&ds);
     for (;;) {
         if (b1 == EOF) return Scm_DStringGet(&ds, 0);
         if (b1 == '\n') break;
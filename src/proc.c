@@ -65,7 +65,7 @@ static void proc_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
 
 ScmObj Scm_MakeClosure(ScmObj code, ScmEnvFrame *env)
 {
-    ScmClosure *c = SCM_NEW(ScmClosure);
+    ScmClosure *c = SCM_NEW_KIND(ScmClosure, SCM_ALLOC_CLOSURE);
 
     SCM_ASSERT(SCM_COMPILED_CODE(code));
     /* CODE->signatureInfo can be #f or (<signature> . <other-info>) */
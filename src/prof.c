@@ -73,6 +73,19 @@
         setitimer(ITIMER_PROF, &tval, &oval);   \
     } while (0)
 
+/*=============================================================
+ * Continuous sampler state
+ */
+
+/* TRUE while the continuous sampler is on.  Read by the signal handler. */
+static volatile int ring_enabled = FALSE;
+
+/* List of VMs that have a sample ring.  Protected by ring_mutex. */
+static ScmObj ring_vms = SCM_NIL;
+static ScmInternalMutex ring_mutex = SCM_INTERNAL_MUTEX_INITIALIZER;
+
+static void ring_sample(ScmVM *vm);
+
 /*=============================================================
  * Statistic sampler
  */
@@ -103,7 +116,9 @@ static void sampler_flush(ScmVM *vm)
 static void sampler_sample(int sig)
 {
     ScmVM *vm = Scm_VM();
-    if (vm == NULL || vm->prof == NULL) return;
+    if (vm == NULL) return;
+    if (ring_enabled && vm->profRing) ring_sample(vm);
+    if (vm->prof == NULL) return;
     if (vm->prof->state != SCM_PROFILER_RUNNING) return;
 
     if (vm->prof->currentSample >= SCM_PROF_SAMPLES_IN_BUFFER) {
@@ -149,6 +164,166 @@ void collect_samples(ScmVMProfiler *prof)
     }
 }
 
+/*=============================================================
+ * Continuous sampler
+ */
+
+/* Called from the signal handler.  We only store pointers here; the
+   ring is allocated in the GC heap, so the sampled objects are kept
+   alive until they are overwritten. */
+static void ring_sample(ScmVM *vm)
+{
+    ScmProfRing *ring = vm->profRing;
+    ScmProfStackSample *s = &ring->samples[ring->head % SCM_PROF_RING_SIZE];
+    int i = 0;
+
+    if (vm->base) {
+        if (vm->pc && SCM_VM_INSN_CODE(*vm->pc) == SCM_VM_RET
+            && SCM_SUBRP(vm->val0)) {
+            s->pcs[i] = NULL;
+            s->frames[i++] = vm->val0;
+        } else {
+            s->pcs[i] = vm->pc;
+            s->frames[i++] = SCM_OBJ(vm->base);
+        }
+    }
+    for (ScmContFrame *c = vm->cont; c && i < SCM_PROF_STACK_DEPTH;
+         c = c->prev) {
+        ScmCompiledCode *b = c->base;
+        /* Skip C continuation frames; their pc doesn't point into
+           the code vector of base. */
+        if (b == NULL || c->pc < b->code || c->pc >= b->code + b->codeSize) {
+            continue;
+        }
+        s->pcs[i] = c->cpc;
+        s->frames[i++] = SCM_OBJ(b);
+    }
+    for (; i < SCM_PROF_STACK_DEPTH; i++) {
+        s->frames[i] = NULL;
+        s->pcs[i] = NULL;
+    }
+    ring->head++;
+}
+
+static ScmProfRing *make_ring(void)
+{
+    ScmProfRing *ring = SCM_NEW(ScmProfRing);
+    ring->head = ring->tail = 0;
+    return ring;
+}
+
+static void install_sampler(void)
+{
+    /* NB: this should be done globally!!! */
+    struct sigaction act;
+    act.sa_handler = sampler_sample;
+    sigfillset(&act.sa_mask);
+    act.sa_flags = SA_RESTART;
+    if (sigaction(SIGPROF, &act, NULL) < 0) {
+        Scm_SysError("sigaction failed");
+    }
+}
+
+/* Called from Scm_NewVM.  If the continuous sampler is on, the new VM
+   gets its ring so that the new thread is sampled as well. */
+void Scm__ProfilerAttachVM(ScmVM *vm)
+{
+    if (!ring_enabled || vm->profRing) return;
+    vm->profRing = make_ring();
+    SCM_INTERNAL_MUTEX_LOCK(ring_mutex);
+    ring_vms = Scm_Cons(SCM_OBJ(vm), ring_vms);
+    SCM_INTERNAL_MUTEX_UNLOCK(ring_mutex);
+}
+
+void Scm_ProfilerContinuousStart(void)
+{
+    ScmVM *vm = Scm_VM();
+    if (ring_enabled) return;
+    ring_enabled = TRUE;
+    Scm__ProfilerAttachVM(vm);
+    install_sampler();
+    ITIMER_START();
+}
+
+void Scm_ProfilerContinuousStop(void)
+{
+    ScmVM *vm = Scm_VM();
+    if (!ring_enabled) return;
+    ring_enabled = FALSE;
+    /* Keep the timer if the call-counting profiler is running on this
+       thread. */
+    if (vm->prof == NULL || vm->prof->state != SCM_PROFILER_RUNNING) {
+        ITIMER_STOP();
+    }
+}
+
+/* Add the new samples in RING to the table H.  The key is a list of
+   sampled frames, each of which is (<code> . <source-info>), and
+   the value is the number of hits. */
+static void ring_collect(ScmProfRing *ring, ScmHashTable *h)
+{
+    u_long head = ring->head;
+    u_long start = ring->tail;
+    if (head - start > SCM_PROF_RING_SIZE) {
+        start = head - SCM_PROF_RING_SIZE; /* older ones are overwritten */
+    }
+    for (u_long k = start; k < head; k++) {
+        ScmProfStackSample *s = &ring->samples[k % SCM_PROF_RING_SIZE];
+        ScmObj h_ = SCM_NIL, t_ = SCM_NIL;
+        for (int i=0; i<SCM_PROF_STACK_DEPTH && s->frames[i]; i++) {
+            ScmObj info = SCM_FALSE;
+            if (SCM_COMPILED_CODE_P(s->frames[i]) && s->pcs[i]) {
+                info = Scm_VMGetSourceInfo(SCM_COMPILED_CODE(s->frames[i]),
+                                           s->pcs[i]);
+            }
+            SCM_APPEND1(h_, t_, Scm_Cons(s->frames[i], info));
+        }
+        ScmObj e = Scm_HashTableRef(h, h_, SCM_MAKE_INT(0));
+        Scm_HashTableSet(h, h_, SCM_MAKE_INT(SCM_INT_VALUE(e)+1), 0);
+    }
+    ring->tail = head;
+}
+
+/* Returns a hash table of stack samples taken since the last call.
+   If ALLTHREADS is FALSE, only the samples of the calling thread
+   are collected.  The sampler keeps running. */
+ScmObj Scm_ProfilerSnapshot(int allThreads)
+{
+    ScmVM *self = Scm_VM();
+    ScmHashTable *h =
+        SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQUAL, 0));
+    ScmObj vms = SCM_NIL, live = SCM_NIL, cp;
+
+    SCM_INTERNAL_MUTEX_LOCK(ring_mutex);
+    vms = ring_vms;
+    SCM_INTERNAL_MUTEX_UNLOCK(ring_mutex);
+
+    /* block the sampler on this thread while we're reading the ring */
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPROF);
+    SIGPROCMASK(SIG_BLOCK, &set, NULL);
+    SCM_FOR_EACH(cp, vms) {
+        ScmVM *vm = SCM_VM(SCM_CAR(cp));
+        if (!allThreads && vm != self) continue;
+        /* Samples of other threads may be being written while we read.
+           It may cause a torn entry, which is tolerable for statistics. */
+        if (vm->profRing) ring_collect(vm->profRing, h);
+    }
+    SIGPROCMASK(SIG_UNBLOCK, &set, NULL);
+
+    /* Drop terminated threads from the list. */
+    SCM_INTERNAL_MUTEX_LOCK(ring_mutex);
+    SCM_FOR_EACH(cp, ring_vms) {
+        if (SCM_VM(SCM_CAR(cp))->state != SCM_VM_TERMINATED) {
+            live = Scm_Cons(SCM_CAR(cp), live);
+        }
+    }
+    ring_vms = live;
+    SCM_INTERNAL_MUTEX_UNLOCK(ring_mutex);
+    return SCM_OBJ(h);
+}
+
 /*=============================================================
  * Call Counter
  */
@@ -231,15 +406,7 @@ void Scm_ProfilerStart(void)
     vm->prof->state = SCM_PROFILER_RUNNING;
     vm->profilerRunning = TRUE;
 
-    /* NB: this should be done globally!!! */
-    struct sigaction act;
-    act.sa_handler = sampler_sample;
-    sigfillset(&act.sa_mask);
-    act.sa_flags = SA_RESTART;
-    if (sigaction(SIGPROF, &act, NULL) < 0) {
-        Scm_SysError("sigaction failed");
-    }
-
+    install_sampler();
     ITIMER_START();
 }
 
@@ -248,7 +415,7 @@ int Scm_ProfilerStop(void)
     ScmVM *vm = Scm_VM();
     if (vm->prof == NULL) return 0;
     if (vm->prof->state != SCM_PROFILER_RUNNING) return 0;
-    ITIMER_STOP();
+    if (!ring_enabled) ITIMER_STOP();
     vm->prof->state = SCM_PROFILER_PAUSING;
     vm->profilerRunning = FALSE;
     return vm->prof->totalSamples;
@@ -337,4 +504,172 @@ ScmObj Scm_ProfilerRawResult(void)
     Scm_Error("profiler is not supported.");
     return SCM_FALSE;
 }
+
+void Scm_ProfilerContinuousStart(void)
+{
+    Scm_Error("profiler is not supported.");
+}
+
+void Scm_ProfilerContinuousStop(void)
+{
+    Scm_Error("profiler is not supported.");
+}
+
+ScmObj Scm_ProfilerSnapshot(int allThreads)
+{
+    Scm_Error("profiler is not supported.");
+    return SCM_FALSE;
+}
+
+void Scm__ProfilerAttachVM(ScmVM *vm)
+{
+}
 #endif /* !GAUCHE_PROFILE */
+
+/*=============================================================
+ * Allocation sampler
+ */
+
+/* This doesn't depend on the interval timer, so it is available
+   regardless of GAUCHE_PROFILE. */
+
+volatile int Scm__AllocHookFlags = 0;   /* SCM_ALLOC_HOOK_* */
+static long alloc_interval = 64*1024; /* bytes between samples */
+
+/* List of VMs that have an allocation ring.  Protected by alloc_mutex. */
+static ScmObj alloc_vms = SCM_NIL;
+static ScmInternalMutex alloc_mutex = SCM_INTERNAL_MUTEX_INITIALIZER;
+
+static ScmAllocRing *alloc_attach_vm(ScmVM *vm)
+{
+    /* NB: We're called from the allocator, so we use GC_MALLOC
+       directly to avoid recursion. */
+    ScmAllocRing *r = (ScmAllocRing*)GC_MALLOC(sizeof(ScmAllocRing));
+    r->countdown = alloc_interval;
+    r->head = r->tail = 0;
+    vm->allocRing = r;
+    /* Scm_Cons comes back to Scm__AllocSample, but now the ring is set. */
+    SCM_INTERNAL_MUTEX_LOCK(alloc_mutex);
+    alloc_vms = Scm_Cons(SCM_OBJ(vm), alloc_vms);
+    SCM_INTERNAL_MUTEX_UNLOCK(alloc_mutex);
+    return r;
+}
+
+/* Called via SCM_MALLOC etc. while the allocation sampler is running
+   or allocations are counted. */
+void *Scm__AllocSample(size_t size, int atomic, int kind)
+{
+    void *p = atomic? GC_MALLOC_ATOMIC(size) : GC_MALLOC(size);
+    ScmVM *vm = Scm_VM();
+    if (vm == NULL) return p;
+
+    int flags = Scm__AllocHookFlags;
+    if (flags & SCM_ALLOC_HOOK_COUNT) vm->stat.allocBytes += size;
+    if (!(flags & SCM_ALLOC_HOOK_SAMPLE)) return p;
+
+    ScmAllocRing *r = vm->allocRing;
+    if (r == NULL) r = alloc_attach_vm(vm);
+    r->countdown -= (long)size;
+    if (r->countdown > 0) return p;
+
+    int weight = (int)(1 + (-r->countdown) / alloc_interval);
+    r->countdown += weight * alloc_interval;
+
+    ScmAllocSample *s = &r->samples[r->head % SCM_PROF_ALLOC_RING_SIZE];
+    s->code = vm->base ? SCM_OBJ(vm->base) : SCM_FALSE;
+    s->pc = vm->pc;
+    s->kind = kind;
+    s->weight = weight;
+    r->head++;
+    return p;
+}
+
+void Scm_ProfilerAllocStart(long interval)
+{
+    if (interval <= 0) {
+        Scm_Error("allocation sampling interval must be positive, but got %ld",
+                  interval);
+    }
+    alloc_interval = interval;
+    SCM_INTERNAL_MUTEX_LOCK(alloc_mutex);
+    Scm__AllocHookFlags |= SCM_ALLOC_HOOK_SAMPLE;
+    SCM_INTERNAL_MUTEX_UNLOCK(alloc_mutex);
+}
+
+void Scm_ProfilerAllocStop(void)
+{
+    SCM_INTERNAL_MUTEX_LOCK(alloc_mutex);
+    Scm__AllocHookFlags &= ~SCM_ALLOC_HOOK_SAMPLE;
+    SCM_INTERNAL_MUTEX_UNLOCK(alloc_mutex);
+}
+
+/* Turns on/off counting the bytes allocated by each VM (allocBytes of
+   ScmVMStat).  It makes every allocation go through Scm__AllocSample,
+   so it is off by default. */
+void Scm_VMStatCountAllocation(int flag)
+{
+    SCM_INTERNAL_MUTEX_LOCK(alloc_mutex);
+    if (flag) Scm__AllocHookFlags |= SCM_ALLOC_HOOK_COUNT;
+    else      Scm__AllocHookFlags &= ~SCM_ALLOC_HOOK_COUNT;
+    SCM_INTERNAL_MUTEX_UNLOCK(alloc_mutex);
+}
+
+/* Add the new samples in R to the table H.  The key is
+   (<kind> <code> . <source-info>), and the value is
+   (<# of samples> . <estimated bytes>). */
+static void alloc_collect(ScmAllocRing *r, ScmHashTable *h)
+{
+    u_long head = r->head;
+    u_long start = r->tail;
+    if (head - start > SCM_PROF_ALLOC_RING_SIZE) {
+        start = head - SCM_PROF_ALLOC_RING_SIZE; /* older ones are lost */
+    }
+    for (u_long k = start; k < head; k++) {
+        ScmAllocSample *s = &r->samples[k % SCM_PROF_ALLOC_RING_SIZE];
+        ScmObj info = SCM_FALSE;
+        if (SCM_COMPILED_CODE_P(s->code) && s->pc) {
+            info = Scm_VMGetSourceInfo(SCM_COMPILED_CODE(s->code), s->pc);
+        }
+        ScmObj key = Scm_Cons(SCM_MAKE_INT(s->kind), Scm_Cons(s->code, info));
+        ScmObj e = Scm_HashTableRef(h, key, SCM_FALSE);
+        if (SCM_FALSEP(e)) {
+            e = Scm_Cons(SCM_MAKE_INT(0), SCM_MAKE_INT(0));
+            Scm_HashTableSet(h, key, e, 0);
+        }
+        SCM_SET_CAR(e, SCM_MAKE_INT(SCM_INT_VALUE(SCM_CAR(e)) + 1));
+        SCM_SET_CDR(e, Scm_Add(SCM_CDR(e),
+                               Scm_MakeInteger((long)s->weight*alloc_interval)));
+    }
+    r->tail = head;
+}
+
+/* Returns a hash table of allocation samples taken since the last call.
+   Sampling continues.  Note that this function itself allocates, which
+   may show up in a later snapshot. */
+ScmObj Scm_ProfilerAllocSnapshot(int allThreads)
+{
+    ScmVM *self = Scm_VM();
+    ScmHashTable *h =
+        SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQUAL, 0));
+    ScmObj vms, live = SCM_NIL, cp;
+
+    SCM_INTERNAL_MUTEX_LOCK(alloc_mutex);
+    vms = alloc_vms;
+    SCM_INTERNAL_MUTEX_UNLOCK(alloc_mutex);
+
+    SCM_FOR_EACH(cp, vms) {
+        ScmVM *vm = SCM_VM(SCM_CAR(cp));
+        if (!allThreads && vm != self) continue;
+        if (vm->allocRing) alloc_collect(vm->allocRing, h);
+    }
+
+    SCM_INTERNAL_MUTEX_LOCK(alloc_mutex);
+    SCM_FOR_EACH(cp, alloc_vms) {
+        if (SCM_VM(SCM_CAR(cp))->state != SCM_VM_TERMINATED) {
+            live = Scm_Cons(SCM_CAR(cp), live);
+        }
+    }
+    alloc_vms = live;
+    SCM_INTERNAL_MUTEX_UNLOCK(alloc_mutex);
+    return SCM_OBJ(h);
+}
@@ -410,6 +410,64 @@ static int char_is_delimiter(ScmChar ch)
             || SCM_CHAR_EXTRA_WHITESPACE(ch));
 }
 
+/*----------------------------------------------------------------
+ * Buffer-level fast path
+ *
+ *   Bulk data files mostly consist of ASCII symbols, fixnums and
+ *   plain strings.  If the port has pending bytes in its buffer
+ *   (a file port or an input string port, with nothing in the scratch
+ *   or ungotten slots), we scan them directly instead of calling Getc
+ *   for every character.  The fast routines consume as much as they
+ *   can handle and leave the rest to the generic routines, so they
+ *   never change what is read.
+ */
+
+/* Returns TRUE and sets the available byte range if the fast path
+   can be used on PORT. */
+static inline int fast_range(ScmPort *port, const char **cur, const char **end)
+{
+    if (port->closed || port->scrcnt > 0
+        || port->ungotten != SCM_CHAR_INVALID) return FALSE;
+    switch (SCM_PORT_TYPE(port)) {
+    case SCM_PORT_FILE:
+        *cur = port->src.buf.current;
+        *end = port->src.buf.end;
+        return TRUE;
+    case SCM_PORT_ISTR:
+        *cur = port->src.istr.current;
+        *end = port->src.istr.end;
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/* Consumes bytes up to NEWCUR, which contain LINES newlines. */
+static inline void fast_advance(ScmPort *port, const char *newcur, u_long lines)
+{
+    if (SCM_PORT_TYPE(port) == SCM_PORT_FILE) {
+        port->bytes += newcur - port->src.buf.current;
+        port->src.buf.current = (char*)newcur;
+    } else {
+        port->bytes += newcur - port->src.istr.current;
+        port->src.istr.current = newcur;
+    }
+    port->line += lines;
+}
+
+/* Skips ASCII constituent chars from CUR and returns the pointer past them. */
+static inline const char *fast_word_span(const char *cur, const char *end,
+                                          int include_hash_sign)
+{
+    while (cur < end) {
+        unsigned char b = (unsigned char)*cur;
+        if (b >= 0x80) break;
+        if (!(ctypes[b]&1) && !(b == '#' && include_hash_sign)) break;
+        cur++;
+    }
+    return cur;
+}
+
 static void read_nested_comment(ScmPort *port, ScmReadContext *ctx)
 {
     int nesting = 0;
@@ -463,6 +521,30 @@ static void read_comment(ScmPort *port) /* leading semicolon is already read */
 
 static int skipws(ScmPort *port, ScmReadContext *ctx)
 {
+    const char *cur, *end;
+    if (fast_range(port, &cur, &end)) {
+        const char *p = cur;
+        u_long lines = 0;
+        int c = EOF;
+        while (p < end) {
+            unsigned char b = (unsigned char)*p;
+            if (b == '\n') { lines++; p++; continue; }
+            if (b >= 0x80) break;
+            if (isspace(b)) { p++; continue; }
+            if (b == ';') {
+                const char *nl = memchr(p, '\n', end - p);
+                if (nl == NULL) break; /* let read_comment handle it */
+                p = nl;
+                continue;
+            }
+            c = b;
+            p++;
+            break;
+        }
+        fast_advance(port, p, lines);
+        if (c != EOF) return c;
+    }
+
     for (;;) {
         int c = Scm_GetcUnsafe(port);
         if (c == EOF) return c;
@@ -1052,6 +1134,27 @@ static ScmObj read_string(ScmPort *port, int incompletep,
 #define INTRALINE_WS(var)                               \
     ((var)==' ' || (var)=='\t' || SCM_CHAR_EXTRA_WHITESPACE_INTRALINE(var))
 
+    const char *cur, *end;
+    if (!incompletep && fast_range(port, &cur, &end)) {
+        const char *p = cur;
+        u_long lines = 0;
+        while (p < end) {
+            unsigned char b = (unsigned char)*p;
+            if (b == '"' || b == '\\' || b >= 0x80) break;
+            if (b == '\n') lines++;
+            p++;
+        }
+        int size = (int)(p - cur);
+        if (p < end && *p == '"') {
+            ScmObj s = Scm_MakeString(cur, size, size,
+                                      SCM_STRING_COPYING|SCM_STRING_IMMUTABLE);
+            fast_advance(port, p+1, lines);
+            return s;
+        }
+        Scm_DStringPutz(&ds, cur, size);
+        fast_advance(port, p, lines);
+    }
+
     for (;;) {
         FETCH(c);
         switch (c) {
@@ -1272,6 +1375,17 @@ static ScmObj read_word(ScmPort *port, ScmChar initial, ScmReadContext *ctx,
         SCM_DSTRING_PUTC(&ds, initial);
     }
 
+    const char *cur, *end;
+    if (!case_fold && fast_range(port, &cur, &end)) {
+        const char *p = fast_word_span(cur, end, include_hash_sign);
+        Scm_DStringPutz(&ds, cur, (int)(p - cur));
+        fast_advance(port, p, 0);
+        /* If an ASCII delimiter follows, the word is complete. */
+        if (p < end && (unsigned char)*p < 0x80) {
+            return Scm_DStringGet(&ds, 0);
+        }
+    }
+
     for (;;) {
         int c = Scm_GetcUnsafe(port);
         if (c == EOF || !char_word_constituent(c, include_hash_sign)) {
@@ -1351,8 +1465,44 @@ static ScmObj read_number(ScmPort *port, ScmChar initial, int radix,
     return num;
 }
 
+/* Fast path of read_symbol_or_number for plain decimal fixnums, which
+   are entirely in the port buffer.  INITIAL has already been read.
+   Returns SCM_UNBOUND without consuming anything if it can't handle
+   the token. */
+static ScmObj read_fast_fixnum(ScmPort *port, ScmChar initial)
+{
+    const char *cur, *end;
+    if (!fast_range(port, &cur, &end)) {
+        return SCM_UNBOUND;
+    }
+    int negative = (initial == '-');
+    long v = 0;
+    int ndigits = 0;
+    if (isdigit(initial)) {
+        v = initial - '0';
+        ndigits++;
+    } else if (initial != '+' && initial != '-') {
+        return SCM_UNBOUND;
+    }
+    const char *p = cur;
+    for (; p < end && isdigit((unsigned char)*p); p++, ndigits++) {
+        int d = *p - '0';
+        if (v > (SCM_SMALL_INT_MAX - d) / 10) return SCM_UNBOUND;
+        v = v*10 + d;
+    }
+    if (ndigits == 0 || p == end || (unsigned char)*p >= 0x80
+        || char_word_constituent(*p, TRUE)) {
+        return SCM_UNBOUND;
+    }
+    fast_advance(port, p, 0);
+    return SCM_MAKE_INT(negative ? -v : v);
+}
+
 static ScmObj read_symbol_or_number(ScmPort *port, ScmChar initial, ScmReadContext *ctx)
 {
+    ScmObj fix = read_fast_fixnum(port, initial);
+    if (!SCM_UNBOUNDP(fix)) return fix;
+
     ScmString *s = SCM_STRING(read_word(port, initial, ctx, FALSE, TRUE));
     ScmObj num = Scm_StringToNumber(s, 10, 0);
     if (num != SCM_FALSE) return num;
@@ -35,6 +35,7 @@
 #include <setjmp.h>
 #include <ctype.h>
 #define LIBGAUCHE_BODY
+#include "atomic_ops.h"
 #include "gauche.h"
 #include "gauche/regexp.h"
 #include "gauche/class.h"
@@ -170,6 +171,8 @@ enum {
 #define SCM_REGEXP_SIMPLE_PREFIX  (1L<<3) /* The regexp begins with a repeating
                                              character or charset, e.g. #/a+b/.
                                              See is_simple_prefixed() below. */
+#define SCM_REGEXP_LITERAL_PREFIX (1L<<4) /* Every match begins with mustMatch.
+                                             See rc_literal() below. */
 
 /* AST - the first pass of regexp compiler creates intermediate AST.
  * Alternatively, you can provide AST directly to the regexp compiler,
@@ -219,6 +222,8 @@ enum {
  * case-folded.
  */
 
+typedef struct ScmRegDFARec ScmRegDFA;
+
 /* NB: regexp printer is defined in libobj.scm */
 static int  regexp_compare(ScmObj x, ScmObj y, int equalp);
 
@@ -241,6 +246,7 @@ static ScmRegexp *make_regexp(void)
     rx->flags = 0;
     rx->pattern = SCM_FALSE;
     rx->ast = SCM_FALSE;
+    rx->dfa = NULL;
     return rx;
 }
 
@@ -1039,6 +1045,12 @@ static void rc_setup_charsets(ScmRegexp *rx, regcomp_ctx *ctx)
     ScmObj cp = Scm_Reverse(ctx->sets);
     for (int i=0; !SCM_NULLP(cp); cp = SCM_CDR(cp)) {
         rx->sets[i++] = SCM_CHAR_SET(SCM_CAR(cp));
+        /* Sets with non-ASCII chars are searched for every input char,
+           so we build the lookup table now instead of waiting for
+           Scm_CharSetContains to do so. */
+        if (!SCM_CHAR_SET_SMALLP(SCM_CAR(cp))) {
+            Scm_CharSetCompile(SCM_CHAR_SET(SCM_CAR(cp)));
+        }
     }
 }
 
@@ -1873,6 +1885,115 @@ static ScmObj calculate_lasetn(ScmObj ast)
     else return calculate_laset(SCM_CAR(ast), SCM_CDR(ast));
 }
 
+/* Finds a literal string every match must contain, e.g. "ERROR" of
+   #/\d+ ERROR:/, so that the matcher can reject the input that doesn't
+   have it without running the regexp.  If the literal also begins every
+   match, e.g. "GET /" of #/GET \/\S+/, the matcher can skip the input
+   to where it appears.  We only look at the chars that appear in a row
+   in the sequence of the regexp, which is enough for most of the cases. */
+typedef struct literal_ctx_rec {
+    ScmDString run;             /* the literal chars we're collecting */
+    int runp;                   /* RUN began at the beginning of match */
+    int startp;                 /* nothing has been consumed yet */
+    int casefoldp;
+    ScmObj longest;             /* the longest literal so far, or #f */
+    ScmObj prefix;              /* the literal that begins a match, or #f */
+} literal_ctx;
+
+static void rc_literal_rec(literal_ctx *lit, ScmObj ast);
+
+static void rc_literal_flush(literal_ctx *lit)
+{
+    int size = Scm_DStringSize(&lit->run);
+    if (size > 0) {
+        ScmObj s = Scm_DStringGet(&lit->run, 0);
+        if (lit->runp) lit->prefix = s;
+        if (SCM_FALSEP(lit->longest)
+            || SCM_STRING_BODY_SIZE(SCM_STRING_BODY(lit->longest)) < size) {
+            lit->longest = s;
+        }
+        Scm_DStringInit(&lit->run);
+    }
+    lit->runp = FALSE;
+}
+
+static void rc_literal_seq(literal_ctx *lit, ScmObj seq)
+{
+    ScmObj cp;
+    SCM_FOR_EACH(cp, seq) rc_literal_rec(lit, SCM_CAR(cp));
+}
+
+static void rc_literal_rec(literal_ctx *lit, ScmObj ast)
+{
+    if (SCM_CHARP(ast) && !lit->casefoldp) {
+        if (Scm_DStringSize(&lit->run) == 0) lit->runp = lit->startp;
+        Scm_DStringPutc(&lit->run, SCM_CHAR_VALUE(ast));
+        lit->startp = FALSE;
+        return;
+    }
+    /* zero-width assertions don't break the run */
+    if (SCM_EQ(ast, SCM_SYM_BOL) || SCM_EQ(ast, SCM_SYM_EOL)
+        || SCM_EQ(ast, SCM_SYM_WB) || SCM_EQ(ast, SCM_SYM_NWB)) {
+        return;
+    }
+    if (SCM_PAIRP(ast)) {
+        ScmObj type = SCM_CAR(ast);
+        if (SCM_INTP(type)) {
+            rc_literal_seq(lit, SCM_CDDR(ast));
+            return;
+        }
+        if (SCM_EQ(type, SCM_SYM_SEQ) || SCM_EQ(type, SCM_SYM_ONCE)) {
+            rc_literal_seq(lit, SCM_CDR(ast));
+            return;
+        }
+        if (SCM_EQ(type, SCM_SYM_SEQ_UNCASE)
+            || SCM_EQ(type, SCM_SYM_SEQ_CASE)) {
+            int oldcase = lit->casefoldp;
+            lit->casefoldp = SCM_EQ(type, SCM_SYM_SEQ_UNCASE);
+            rc_literal_seq(lit, SCM_CDR(ast));
+            lit->casefoldp = oldcase;
+            return;
+        }
+        if (SCM_EQ(type, SCM_SYM_ASSERT) || SCM_EQ(type, SCM_SYM_NASSERT)
+            || SCM_EQ(type, SCM_SYM_LOOKBEHIND)) {
+            return;
+        }
+        if ((SCM_EQ(type, SCM_SYM_REP) || SCM_EQ(type, SCM_SYM_REP_MIN)
+             || SCM_EQ(type, SCM_SYM_REP_WHILE))
+            && SCM_INTP(SCM_CADR(ast)) && SCM_INT_VALUE(SCM_CADR(ast)) > 0) {
+            /* the first round is required, but may not continue the run */
+            rc_literal_flush(lit);
+            rc_literal_seq(lit, SCM_CDR(SCM_CDDR(ast)));
+            rc_literal_flush(lit);
+            lit->startp = FALSE;
+            return;
+        }
+    }
+    rc_literal_flush(lit);
+    lit->startp = FALSE;
+}
+
+static void rc_literal(regcomp_ctx *ctx, ScmObj ast)
+{
+    literal_ctx lit;
+    Scm_DStringInit(&lit.run);
+    lit.runp = FALSE;
+    lit.startp = TRUE;
+    lit.casefoldp = ctx->casefoldp;
+    lit.longest = lit.prefix = SCM_FALSE;
+    rc_literal_rec(&lit, ast);
+    rc_literal_flush(&lit);
+
+    if (!SCM_FALSEP(lit.prefix)) {
+        ctx->rx->mustMatch = SCM_STRING(lit.prefix);
+        ctx->rx->flags |= SCM_REGEXP_LITERAL_PREFIX;
+    } else if (!SCM_FALSEP(lit.longest)) {
+        ctx->rx->mustMatch = SCM_STRING(lit.longest);
+    }
+}
+
+static ScmRegDFA *dfa_make(ScmRegexp *rx, ScmObj ast);
+
 /* pass 3 */
 static ScmObj rc3(regcomp_ctx *ctx, ScmObj ast)
 {
@@ -1880,6 +2001,7 @@ static ScmObj rc3(regcomp_ctx *ctx, ScmObj ast)
     if (is_bol_anchored(ast)) ctx->rx->flags |= SCM_REGEXP_BOL_ANCHORED;
     else if (is_simple_prefixed(ast)) ctx->rx->flags |= SCM_REGEXP_SIMPLE_PREFIX;
     ctx->rx->laset = calculate_laset(ast, SCM_NIL);
+    if (!(ctx->rx->flags & SCM_REGEXP_BOL_ANCHORED)) rc_literal(ctx, ast);
 
     /* pass 3-1 : count # of insns */
     ctx->codemax = 1;
@@ -1895,6 +2017,7 @@ static ScmObj rc3(regcomp_ctx *ctx, ScmObj ast)
     ctx->rx->numCodes = ctx->codep;
 
     ctx->rx->ast = ast;
+    ctx->rx->dfa = dfa_make(ctx->rx, ast);
     return SCM_OBJ(ctx->rx);
 }
 
@@ -1906,6 +2029,8 @@ void Scm_RegDump(ScmRegexp *rx)
         Scm_Printf(SCM_CUROUT, ",BOL_ANCHORED");
     if (rx->flags&SCM_REGEXP_SIMPLE_PREFIX)
         Scm_Printf(SCM_CUROUT, ",SIMPLE_PREFIX");
+    if (rx->flags&SCM_REGEXP_LITERAL_PREFIX)
+        Scm_Printf(SCM_CUROUT, ",LITERAL_PREFIX");
     Scm_Printf(SCM_CUROUT, ")\n");
     Scm_Printf(SCM_CUROUT, " laset = %S\n", rx->laset);
     Scm_Printf(SCM_CUROUT, "  must = ");
@@ -2763,8 +2888,10 @@ static void rex_rec(const unsigned char *code,
     }
 }
 
+/* MATCHES is the work area the matcher filled; we copy it, for the
+   work area may be on C stack. */
 static ScmObj make_match(ScmRegexp *rx, ScmString *orig,
-                         struct match_ctx *ctx)
+                         struct ScmRegMatchSub **matches)
 {
     ScmRegMatch *rm = SCM_NEW(ScmRegMatch);
     SCM_SET_CLASS(rm, SCM_CLASS_REGMATCH);
@@ -2777,38 +2904,62 @@ static ScmObj make_match(ScmRegexp *rx, ScmString *orig,
     rm->input = SCM_STRING_BODY_START(origb);
     rm->inputLen = SCM_STRING_BODY_LENGTH(origb);
     rm->inputSize = SCM_STRING_BODY_SIZE(origb);
-    rm->matches = ctx->matches;
+    rm->matches = SCM_NEW_ARRAY(struct ScmRegMatchSub *, rx->numGroups);
+    for (int i = 0; i < rx->numGroups; i++) {
+        struct ScmRegMatchSub *sub = SCM_NEW(struct ScmRegMatchSub);
+        sub->start = -1;
+        sub->length = -1;
+        sub->after = -1;
+        sub->startp = matches[i]->startp;
+        sub->endp = matches[i]->endp;
+        rm->matches[i] = sub;
+    }
     return SCM_OBJ(rm);
 }
 
-static ScmObj rex(ScmRegexp *rx, ScmString *orig,
-                  const char *start, const char *end)
+/* The work area for submatches.  We use C stack unless the regexp has
+   many groups, so that matching itself doesn't allocate. */
+#define MATCH_SLOTS_LOCAL 16
+
+static struct ScmRegMatchSub **match_slots(ScmRegexp *rx,
+                                           struct ScmRegMatchSub **ptrs,
+                                           struct ScmRegMatchSub *subs)
+{
+    if (rx->numGroups > MATCH_SLOTS_LOCAL) {
+        ptrs = SCM_NEW_ARRAY(struct ScmRegMatchSub *, rx->numGroups);
+        subs = SCM_NEW_ATOMIC_ARRAY(struct ScmRegMatchSub, rx->numGroups);
+    }
+    for (int i = 0; i < rx->numGroups; i++) ptrs[i] = &subs[i];
+    return ptrs;
+}
+
+/* Tries to match RX at START.  Returns TRUE if it matches, leaving
+   submatches in MATCHES.  INPUT is the beginning of the input. */
+static int rex(ScmRegexp *rx, const char *input,
+               const char *start, const char *end,
+               struct ScmRegMatchSub **matches)
 {
     struct match_ctx ctx;
     sigjmp_buf cont;
 
     ctx.rx = rx;
     ctx.codehead = rx->code;
-    ctx.input = SCM_STRING_BODY_START(SCM_STRING_BODY(orig));
+    ctx.input = input;
     ctx.stop = end;
     ctx.begin_stack = (void*)&ctx;
     ctx.cont = &cont;
-    ctx.matches = SCM_NEW_ARRAY(struct ScmRegMatchSub *, rx->numGroups);
+    ctx.matches = matches;
 
     for (int i = 0; i < rx->numGroups; i++) {
-        ctx.matches[i] = SCM_NEW(struct ScmRegMatchSub);
-        ctx.matches[i]->start = -1;
-        ctx.matches[i]->length = -1;
-        ctx.matches[i]->after = -1;
-        ctx.matches[i]->startp = NULL;
-        ctx.matches[i]->endp = NULL;
+        matches[i]->startp = NULL;
+        matches[i]->endp = NULL;
     }
 
     if (sigsetjmp(cont, FALSE) == 0) {
         rex_rec(ctx.codehead, start, &ctx);
-        return SCM_FALSE;
+        return FALSE;
     }
-    return make_match(rx, orig, &ctx);
+    return TRUE;
 }
 
 /* advance start pointer while the character matches (skip_match=TRUE) or does
@@ -2830,46 +2981,953 @@ static inline const char *skip_input(const char *start, const char *limit,
 }
 
 /*----------------------------------------------------------------------
- * entry point
+ * Lazy DFA
  */
-ScmObj Scm_RegExec(ScmRegexp *rx, ScmString *str)
+
+/* Rex_rec takes exponential time on some regexps, e.g. #/(a|aa)*b/ on
+ * a long run of 'a's, and it tries every start position when nothing
+ * matches.  If the regexp doesn't use backreferences, lookaround,
+ * conditionals or standalone patterns, we match it with automata
+ * instead, which run in time linear to the input.
+ *
+ * From the AST we build an NFA, mirroring what rc3 generates, so that
+ * it prefers the same alternatives as rex_rec does.  A DFA state is an
+ * ordered list of NFA threads, higher priority first.  When a thread
+ * reaches the end of the regexp, the threads after it are dropped, as
+ * rex_rec would never try them.  So the forward automaton, with an
+ * implicit thread starting at every position, tells where the match
+ * rex_rec would find ends.  Then another automaton built from the
+ * reversed regexp runs backward from that end, and the furthest point
+ * it reaches is where the match starts.  If the regexp has submatches,
+ * we let rex_rec find them, starting from that point.
+ *
+ * DFA states are created when we first need them, and the transitions
+ * by ASCII characters are cached in each state.  Once created, a state
+ * or a transition is never changed, so the matcher reads them without
+ * locking; creating them is serialized by a mutex.  If the automaton
+ * grows too big, we discard all states and start over.
+ *
+ * Assertions such as \b and $ depend on the characters on both sides,
+ * so threads are kept as they are right after consuming a character,
+ * and we follow the empty transitions when we see the next character.
+ * Consequently a state knows whether a match ended just before the
+ * character that led to it.
+ *
+ * Rep-while that rc3 compiles into RE_*R never gives back what it
+ * consumed, which limits the strings the regexp matches.  Forward, the
+ * DN_REP node does the same.  Backward, the loop is guarded by a
+ * DN_NOTNEXT node, which checks the character on its right; the state
+ * remembers which guards the last character failed.
+ */
+
+enum {
+    DN_CHAR,                    /* matches a char */
+    DN_CHAR1_CI,                /* a single-byte char, case insensitive */
+    DN_CHAR_CI,                 /* a char, case insensitive */
+    DN_ANY,                     /* any char */
+    DN_SET,                     /* a char in the charset */
+    DN_NSET,                    /* a char not in the charset */
+    DN_REP,                     /* consumes chars matching SUB as many as
+                                   possible, without backtracking */
+    DN_NOTNEXT,                 /* backward only; the char on the right
+                                   doesn't match SUB.  ALT is the index of
+                                   the guard. */
+    DN_SPLIT,                   /* try NEXT, then ALT */
+    DN_BOL,
+    DN_EOL,
+    DN_WB,
+    DN_NWB,
+    DN_MATCH,
+    DN_FAIL
+};
+
+typedef struct dfa_node_rec {
+    unsigned char op;
+    unsigned char sub;          /* DN_REP, DN_NOTNEXT: the op to test */
+    int arg;                    /* char, or charset index */
+    int next;
+    int alt;                    /* DN_SPLIT only */
+} dfa_node;
+
+#define DFA_ASCII        128
+#define DFA_HI_CACHE     16     /* must be power of 2 */
+#define DFA_MAX_NODES    20000
+#define DFA_MAX_STATES   2000
+#define DFA_MAX_GUARDS   16
+#define DFA_EOF          (-2)    /* distinct from SCM_CHAR_INVALID */
+
+/* state flags */
+#define DS_MATCHED  (1L<<0)     /* a match ended before the last char */
+#define DS_EDGE     (1L<<1)     /* seen side is the edge of the input */
+#define DS_WORD     (1L<<2)     /* last char was a word constituent */
+#define DS_NOSTART  (1L<<3)     /* don't start new threads any more */
+#define DS_GUARD(i) (1L<<((i)+4)) /* last char matched i-th DN_NOTNEXT */
+
+typedef struct dfa_state_rec dfa_state;
+
+typedef struct dfa_hi_rec {     /* cached transition by non-ASCII char */
+    ScmChar ch;
+    dfa_state *to;
+} dfa_hi;
+
+struct dfa_state_rec {
+    dfa_state *next[DFA_ASCII];
+    dfa_hi *hi[DFA_HI_CACHE];
+    dfa_state *chain;           /* hash chain */
+    u_long hash;
+    int final;                  /* -1: unknown, or TRUE if we have a match
+                                   when the input ends here */
+    int flags;
+    int numThreads;
+    int numMatches;             /* set mode only; # of patterns whose match
+                                   ended before the last char.  Their
+                                   indices follow the threads. */
+    int threads[1];             /* variable length */
+};
+
+typedef struct dfa_rec {
+    dfa_node *nodes;
+    int numNodes;
+    int start;
+    int reverse;                /* TRUE if it runs right to left */
+    int anchored;               /* TRUE if it only starts at the origin */
+    int setp;                   /* TRUE if it tells every pattern of a
+                                   regexp set that matches */
+    int numPatterns;            /* set mode only */
+    int numGuards;
+    int *guards;                /* DN_NOTNEXT nodes */
+    ScmCharSet **sets;
+    ScmInternalMutex mutex;
+    dfa_state **buckets;
+    int numBuckets;
+    int numStates;
+    dfa_state *init;            /* forward only; initial state */
+    /* work area, used while mutex is held */
+    unsigned int *mark;         /* visited while following empty moves */
+    unsigned int *qmark;        /* already in OUT */
+    unsigned int *pmark;        /* set mode only; pattern already in OUT */
+    unsigned int gen;
+    int *stack;
+    int *out;                   /* threads, then patterns in set mode */
+} dfa;
+
+struct ScmRegDFARec {
+    dfa *forward;
+    dfa *backward;
+};
+
+/*
+ * Building NFA
+ */
+
+typedef struct dfa_builder_rec {
+    ScmRegexp *rx;
+    dfa_node *nodes;
+    int numNodes;
+    int maxNodes;
+    int reverse;
+    int casefoldp;
+    int setbase;                /* set mode; offset of rx's charsets */
+    int numGuards;
+    int guards[DFA_MAX_GUARDS];
+    int ok;
+} dfa_builder;
+
+static int db_node(dfa_builder *b, int op, int arg, int next, int alt)
 {
-    const ScmStringBody *b = SCM_STRING_BODY(str);
-    const char *start = SCM_STRING_BODY_START(b);
-    const char *end = start + SCM_STRING_BODY_SIZE(b);
-    const ScmStringBody *mb = rx->mustMatch? SCM_STRING_BODY(rx->mustMatch) : NULL;
-    int mustMatchLen = mb? SCM_STRING_BODY_SIZE(mb) : 0;
-    const char *start_limit = end - mustMatchLen;
+    if (b->numNodes >= b->maxNodes) {
+        if (b->maxNodes >= DFA_MAX_NODES) {
+            b->ok = FALSE;
+            return 0;           /* node #0 is FAIL */
+        }
+        int newmax = b->maxNodes * 2;
+        dfa_node *newnodes = SCM_NEW_ATOMIC_ARRAY(dfa_node, newmax);
+        memcpy(newnodes, b->nodes, sizeof(dfa_node) * b->numNodes);
+        b->nodes = newnodes;
+        b->maxNodes = newmax;
+    }
+    dfa_node *n = &b->nodes[b->numNodes];
+    n->op = op;
+    n->sub = 0;
+    n->arg = arg;
+    n->next = next;
+    n->alt = alt;
+    return b->numNodes++;
+}
 
-    if (SCM_STRING_INCOMPLETE_P(str)) {
-        Scm_Error("incomplete string is not allowed: %S", str);
+static int db_rec(dfa_builder *b, ScmObj ast, int lastp, int next);
+
+static inline int db_charset_index(dfa_builder *b, ScmObj cs)
+{
+    return b->setbase + rc3_charset_index(b->rx, cs);
+}
+
+/* A run of literal chars, ITEMS[0] to ITEMS[N-1], of NRUN bytes. */
+static int db_run(dfa_builder *b, ScmObj *items, int n, int nrun, int next)
+{
+    for (int k = 0; k < n; k++) {
+        int i = b->reverse? k : n-1-k;
+        ScmChar ch = SCM_CHAR_VALUE(items[i]);
+        int op = (!b->casefoldp? DN_CHAR
+                  : (nrun == 1)? DN_CHAR1_CI : DN_CHAR_CI);
+        next = db_node(b, op, ch, next, 0);
     }
-#if 0
-    /* Disabled for now; we need to use more heuristics to determine
-       when we should apply mustMatch.  For example, if the regexp
-       begins with BOL assertion and constant string, then it would be
-       faster to go for rex directly. */
-    if (rx->mustMatch) {
-        /* Prescreening.  If the input string doesn't contain mustMatch
-           string, it can't match the entire expression. */
-        if (SCM_FALSEP(Scm_StringScan(str, rx->mustMatch,
-                                      SCM_STRING_SCAN_INDEX))) {
-            return SCM_FALSE;
+    return next;
+}
+
+/* Mirrors rc3_seq, including how literal chars are grouped. */
+static int db_seq(dfa_builder *b, ScmObj seq, int lastp, int next)
+{
+    ScmObj v = Scm_ListToVector(seq, 0, -1);
+    ScmObj *items = SCM_VECTOR_ELEMENTS(v);
+    int n = SCM_VECTOR_SIZE(v);
+    /* Units in the order of the original sequence; a unit is a run of
+       chars or a single item.  ustart[k] is the first item of k-th unit. */
+    int *ustart = SCM_NEW_ATOMIC_ARRAY(int, n+1);
+    int *unrun = SCM_NEW_ATOMIC_ARRAY(int, n+1);
+    int nunits = 0;
+
+    for (int i = 0; i < n;) {
+        ustart[nunits] = i;
+        if (SCM_CHARP(items[i])) {
+            int nrun = 0;
+            do {
+                nrun += SCM_CHAR_NBYTES(SCM_CHAR_VALUE(items[i]));
+                i++;
+            } while (i < n && SCM_CHARP(items[i]) && nrun < CHAR_MAX);
+            unrun[nunits] = nrun;
+        } else {
+            unrun[nunits] = 0;
+            i++;
         }
+        nunits++;
+    }
+    ustart[nunits] = n;
+
+    for (int k = 0; k < nunits; k++) {
+        int u = b->reverse? k : nunits-1-k;
+        int i = ustart[u];
+        if (unrun[u]) {
+            next = db_run(b, items+i, ustart[u+1]-i, unrun[u], next);
+        } else {
+            next = db_rec(b, items[i], lastp && i == n-1, next);
+        }
+    }
+    return next;
+}
+
+/* COUNT copies of SEQ, as rc3_seq_rep does. */
+static int db_seq_rep(dfa_builder *b, ScmObj seq, int count, int lastp,
+                      int next)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    if (count <= 0) return next;
+    while (count-- > 0) {
+        SCM_APPEND(h, t, Scm_CopyList(seq));
+    }
+    return db_seq(b, h, lastp, next);
+}
+
+/* Mirrors rc3_minmax.  Rex_rec tries the number of repetition from
+   the most (greedy) or the least (lazy), so do we. */
+static int db_minmax(dfa_builder *b, int greedy, int count, ScmObj item,
+                     int next)
+{
+    /* copies[j] is the entry to match J more copies of ITEM. */
+    int *copies = SCM_NEW_ATOMIC_ARRAY(int, count+1);
+    copies[0] = next;
+    for (int j = 1; j <= count; j++) {
+        copies[j] = db_seq(b, item, FALSE, copies[j-1]);
+    }
+    int entry;
+    if (greedy) {
+        entry = next;
+        for (int j = 1; j <= count; j++) {
+            entry = db_node(b, DN_SPLIT, 0, copies[j], entry);
+        }
+    } else {
+        entry = copies[count];
+        for (int j = count-1; j >= 0; j--) {
+            entry = db_node(b, DN_SPLIT, 0, copies[j], entry);
+        }
+    }
+    return entry;
+}
+
+/* The cases rc3_rec emits RE_*R instructions for rep-while, i.e.
+   (rep-while m #f elem1).  The M copies of ELEM1 are matched as usual,
+   then RE_*R consumes as many ELEM1 as possible without backtracking.
+   Returns -1 if rc3_rec doesn't emit RE_*R for it. */
+static int db_rep_while(dfa_builder *b, ScmObj elem, int count, int next)
+{
+    ScmObj elem1 = SCM_CAR(elem);
+    int sub, arg = 0;
+    if (SCM_EQ(elem1, SCM_SYM_ANY)) {
+        sub = DN_ANY;
+    } else if (SCM_CHARP(elem1)) {
+        ScmChar ch = SCM_CHAR_VALUE(elem1);
+        /* RE_MATCH1R never consumes a byte over 127 */
+        if (SCM_CHAR_NBYTES(ch) == 1 && ch >= 128) {
+            return db_seq_rep(b, elem, count, FALSE, next);
+        }
+        sub = DN_CHAR;
+        arg = ch;
+    } else if (SCM_CHAR_SET_P(elem1)) {
+        sub = DN_SET;
+        arg = db_charset_index(b, elem1);
+    } else if (SCM_PAIRP(elem1) && SCM_EQ(SCM_CAR(elem1), SCM_SYM_COMP)) {
+        sub = DN_NSET;
+        arg = db_charset_index(b, SCM_CDR(elem1));
+    } else {
+        return -1;
+    }
+    if (b->reverse) {
+        /* Backward, it is an ordinary loop, except that the char right
+           after it must not match; that's where RE_*R stops. */
+        if (b->numGuards >= DFA_MAX_GUARDS) {
+            b->ok = FALSE;
+            return 0;
+        }
+        int copies = db_seq_rep(b, elem, count, FALSE, next);
+        int loop = db_node(b, DN_SPLIT, 0, copies, copies);
+        int body = db_node(b, sub, arg, loop, 0);
+        b->nodes[loop].next = body;
+        int guard = db_node(b, DN_NOTNEXT, arg, loop, b->numGuards);
+        b->nodes[guard].sub = sub;
+        b->guards[b->numGuards++] = guard;
+        return guard;
+    }
+    int n = db_node(b, DN_REP, arg, next, 0);
+    b->nodes[n].sub = sub;
+    return db_seq_rep(b, elem, count, FALSE, n);
+}
+
+/* Mirrors rc3_rec. */
+static int db_rec(dfa_builder *b, ScmObj ast, int lastp, int next)
+{
+    if (!b->ok) return 0;
+
+    if (!SCM_PAIRP(ast)) {
+        if (SCM_CHARP(ast)) {
+            ScmChar ch = SCM_CHAR_VALUE(ast);
+            int op = (!b->casefoldp? DN_CHAR
+                      : (SCM_CHAR_NBYTES(ch) == 1)? DN_CHAR1_CI : DN_CHAR_CI);
+            return db_node(b, op, ch, next, 0);
+        }
+        if (SCM_CHAR_SET_P(ast)) {
+            return db_node(b, DN_SET, db_charset_index(b, ast), next, 0);
+        }
+        if (SCM_EQ(ast, SCM_SYM_ANY)) return db_node(b, DN_ANY, 0, next, 0);
+        if (SCM_EQ(ast, SCM_SYM_BOL)) return db_node(b, DN_BOL, 0, next, 0);
+        if (SCM_EQ(ast, SCM_SYM_EOL)) {
+            if (lastp) return db_node(b, DN_EOL, 0, next, 0);
+            else return db_node(b, DN_CHAR, '$', next, 0);
+        }
+        if (SCM_EQ(ast, SCM_SYM_WB)) return db_node(b, DN_WB, 0, next, 0);
+        if (SCM_EQ(ast, SCM_SYM_NWB)) return db_node(b, DN_NWB, 0, next, 0);
+        b->ok = FALSE;
+        return 0;
+    }
+
+    ScmObj type = SCM_CAR(ast);
+    if (SCM_EQ(type, SCM_SYM_COMP)) {
+        return db_node(b, DN_NSET, db_charset_index(b, SCM_CDR(ast)),
+                       next, 0);
+    }
+    if (SCM_EQ(type, SCM_SYM_SEQ)) {
+        return db_seq(b, SCM_CDR(ast), lastp, next);
+    }
+    if (SCM_INTP(type)) {
+        /* groups don't matter here */
+        return db_seq(b, SCM_CDDR(ast), lastp, next);
+    }
+    if (SCM_EQ(type, SCM_SYM_SEQ_UNCASE) || SCM_EQ(type, SCM_SYM_SEQ_CASE)) {
+        int oldcase = b->casefoldp;
+        b->casefoldp = SCM_EQ(type, SCM_SYM_SEQ_UNCASE);
+        int r = db_seq(b, SCM_CDR(ast), lastp, next);
+        b->casefoldp = oldcase;
+        return r;
+    }
+    if (SCM_EQ(type, SCM_SYM_ALT)) {
+        ScmObj clauses = Scm_Reverse(SCM_CDR(ast));
+        if (SCM_NULLP(clauses)) return db_node(b, DN_FAIL, 0, 0, 0);
+        int entry = db_rec(b, SCM_CAR(clauses), lastp, next);
+        ScmObj cp;
+        SCM_FOR_EACH(cp, SCM_CDR(clauses)) {
+            int e = db_rec(b, SCM_CAR(cp), lastp, next);
+            entry = db_node(b, DN_SPLIT, 0, e, entry);
+        }
+        return entry;
+    }
+    if (SCM_EQ(type, SCM_SYM_REP_WHILE)) {
+        ScmObj m = SCM_CADR(ast), n = SCM_CAR(SCM_CDDR(ast));
+        ScmObj elem = SCM_CDR(SCM_CDDR(ast));
+        if (SCM_FALSEP(n)
+            && SCM_PAIRP(elem) && SCM_NULLP(SCM_CDR(elem))) {
+            int r = db_rep_while(b, elem, SCM_INT_VALUE(m), next);
+            if (r >= 0) return r;
+        }
+        type = SCM_SYM_REP;
+    }
+    if (SCM_EQ(type, SCM_SYM_REP) || SCM_EQ(type, SCM_SYM_REP_MIN)) {
+        ScmObj min = SCM_CADR(ast), max = SCM_CAR(SCM_CDDR(ast));
+        ScmObj item = SCM_CDR(SCM_CDDR(ast));
+        int greedy = SCM_EQ(type, SCM_SYM_REP);
+        int multip = (SCM_FALSEP(max) || SCM_INT_VALUE(max) > 1);
+        int tail;
+
+        if (SCM_EQ(min, max)) {
+            tail = next;
+        } else if (!SCM_FALSEP(max)) {
+            tail = db_minmax(b, greedy, SCM_INT_VALUE(max)-SCM_INT_VALUE(min),
+                             item, next);
+        } else {
+            tail = db_node(b, DN_SPLIT, 0, next, next);
+            int body = db_seq(b, item, FALSE, tail);
+            if (!b->ok) return 0;
+            if (greedy) b->nodes[tail].next = body;
+            else        b->nodes[tail].alt = body;
+        }
+        return db_seq_rep(b, item, SCM_INT_VALUE(min), multip, tail);
+    }
+    /* backref, lookaround, conditionals and standalone patterns */
+    b->ok = FALSE;
+    return 0;
+}
+
+static void db_init(dfa_builder *b, ScmRegexp *rx, int reverse)
+{
+    b->rx = rx;
+    b->maxNodes = 64;
+    b->nodes = SCM_NEW_ATOMIC_ARRAY(dfa_node, b->maxNodes);
+    b->numNodes = 0;
+    b->reverse = reverse;
+    b->casefoldp = FALSE;
+    b->setbase = 0;
+    b->numGuards = 0;
+    b->ok = TRUE;
+    db_node(b, DN_FAIL, 0, 0, 0);
+}
+
+/* Creates an automaton from the NFA built by B.  NPATS is the number
+   of patterns in set mode, or 0. */
+static dfa *db_finish(dfa_builder *b, int start, int anchored,
+                      ScmCharSet **sets, int npats)
+{
+    dfa *d = SCM_NEW(dfa);
+    d->nodes = b->nodes;
+    d->numNodes = b->numNodes;
+    d->start = start;
+    d->reverse = b->reverse;
+    d->anchored = anchored;
+    d->setp = (npats > 0);
+    d->numPatterns = npats;
+    d->numGuards = b->numGuards;
+    d->guards = SCM_NEW_ATOMIC_ARRAY(int, b->numGuards);
+    memcpy(d->guards, b->guards, sizeof(int) * b->numGuards);
+    d->sets = sets;
+    SCM_INTERNAL_MUTEX_INIT(d->mutex);
+    d->numBuckets = 64;
+    d->buckets = SCM_NEW_ARRAY(dfa_state*, d->numBuckets);
+    d->numStates = 0;
+    d->init = NULL;
+    d->mark = SCM_NEW_ATOMIC_ARRAY(unsigned int, b->numNodes);
+    d->qmark = SCM_NEW_ATOMIC_ARRAY(unsigned int, b->numNodes);
+    d->pmark = SCM_NEW_ATOMIC_ARRAY(unsigned int, npats);
+    memset(d->mark, 0, sizeof(unsigned int) * b->numNodes);
+    memset(d->qmark, 0, sizeof(unsigned int) * b->numNodes);
+    memset(d->pmark, 0, sizeof(unsigned int) * npats);
+    d->gen = 0;
+    /* each node is pushed at most once per incoming edge */
+    d->stack = SCM_NEW_ATOMIC_ARRAY(int, b->numNodes*2 + 1);
+    d->out = SCM_NEW_ATOMIC_ARRAY(int, b->numNodes + npats);
+    return d;
+}
+
+static dfa *dfa_build(ScmRegexp *rx, ScmObj ast, int reverse)
+{
+    dfa_builder b;
+    db_init(&b, rx, reverse);
+    int start = db_rec(&b, ast, TRUE, db_node(&b, DN_MATCH, 0, 0, 0));
+    if (!b.ok) return NULL;
+    return db_finish(&b, start,
+                     reverse || (rx->flags & SCM_REGEXP_BOL_ANCHORED),
+                     rx->sets, 0);
+}
+
+/* Builds a forward automaton in set mode, which runs N regexps RXS at
+   once.  DN_MATCH of the i-th regexp has i as its argument.  All of
+   RXS must have been compiled to DFA.  Returns NULL if the result gets
+   too big. */
+static dfa *dfa_build_set(ScmRegexp **rxs, int n)
+{
+    int nsets = 0;
+    for (int i = 0; i < n; i++) nsets += rxs[i]->numSets;
+    ScmCharSet **sets = SCM_NEW_ARRAY(ScmCharSet*, nsets);
+
+    dfa_builder b;
+    db_init(&b, NULL, FALSE);
+    int start = 0, setbase = nsets;
+    for (int i = n-1; i >= 0 && b.ok; i--) {
+        setbase -= rxs[i]->numSets;
+        memcpy(sets + setbase, rxs[i]->sets,
+               rxs[i]->numSets * sizeof(ScmCharSet*));
+        b.rx = rxs[i];
+        b.setbase = setbase;
+        int e = db_rec(&b, rxs[i]->ast, TRUE, db_node(&b, DN_MATCH, i, 0, 0));
+        start = (i == n-1)? e : db_node(&b, DN_SPLIT, 0, e, start);
+    }
+    if (!b.ok) return NULL;
+    return db_finish(&b, start, FALSE, sets, n);
+}
+
+/* Called from rc3.  Returns NULL if AST needs backtracking. */
+static ScmRegDFA *dfa_make(ScmRegexp *rx, ScmObj ast)
+{
+    dfa *fwd = dfa_build(rx, ast, FALSE);
+    if (fwd == NULL) return NULL;
+    dfa *bwd = dfa_build(rx, ast, TRUE);
+    if (bwd == NULL) return NULL;
+    ScmRegDFA *r = SCM_NEW(ScmRegDFA);
+    r->forward = fwd;
+    r->backward = bwd;
+    return r;
+}
+
+/*
+ * Running DFA
+ */
+
+/* Same as is_word_constituent() */
+static inline int dfa_wordp(ScmChar ch)
+{
+    return (ch >= 128 || (ch >= 0 && is_word_constituent((unsigned char)ch)));
+}
+
+static int dfa_pred(dfa *d, int op, int arg, ScmChar ch)
+{
+    switch (op) {
+    case DN_CHAR:     return ch == arg;
+    case DN_CHAR1_CI: return (SCM_CHAR_NBYTES(ch) == 1
+                              && SCM_CHAR_DOWNCASE(ch) == arg);
+    case DN_CHAR_CI:  return Scm_CharDowncase(ch) == arg;
+    case DN_ANY:      return TRUE;
+    case DN_SET:      return Scm_CharSetContains(d->sets[arg], ch);
+    case DN_NSET:     return !Scm_CharSetContains(d->sets[arg], ch);
+    }
+    return FALSE;
+}
+
+static u_long dfa_hash(int flags, const int *threads, int n)
+{
+    u_long h = flags;
+    for (int i = 0; i < n; i++) h = h*31 + threads[i];
+    return h;
+}
+
+static void dfa_flush(dfa *d)
+{
+    for (int i = 0; i < d->numBuckets; i++) d->buckets[i] = NULL;
+    d->numStates = 0;
+    d->init = NULL;
+}
+
+static void dfa_rehash(dfa *d)
+{
+    int newsize = d->numBuckets * 2;
+    dfa_state **newb = SCM_NEW_ARRAY(dfa_state*, newsize);
+    for (int i = 0; i < d->numBuckets; i++) {
+        dfa_state *s = d->buckets[i], *n;
+        for (; s; s = n) {
+            n = s->chain;
+            s->chain = newb[s->hash & (newsize-1)];
+            newb[s->hash & (newsize-1)] = s;
+        }
+    }
+    d->buckets = newb;
+    d->numBuckets = newsize;
+}
+
+/* Returns the state with given threads and flags.  In set mode, the
+   indices of matched patterns follow the N threads; M is the number of
+   them.  Mutex must be held. */
+static dfa_state *dfa_intern(dfa *d, int flags, const int *threads,
+                             int n, int m)
+{
+    u_long h = dfa_hash(flags, threads, n+m) + n;
+    for (dfa_state *s = d->buckets[h & (d->numBuckets-1)]; s; s = s->chain) {
+        if (s->hash == h && s->flags == flags && s->numThreads == n
+            && s->numMatches == m
+            && memcmp(s->threads, threads, (n+m)*sizeof(int)) == 0) {
+            return s;
+        }
+    }
+    if (d->numStates >= DFA_MAX_STATES) dfa_flush(d);
+    if (d->numStates >= d->numBuckets) dfa_rehash(d);
+    dfa_state *s = SCM_NEW2(dfa_state*, sizeof(dfa_state) + (n+m)*sizeof(int));
+    s->hash = h;
+    s->final = -1;
+    s->flags = flags;
+    s->numThreads = n;
+    s->numMatches = m;
+    memcpy(s->threads, threads, (n+m)*sizeof(int));
+    s->chain = d->buckets[h & (d->numBuckets-1)];
+    d->buckets[h & (d->numBuckets-1)] = s;
+    d->numStates++;
+    return s;
+}
+
+/* Follows the empty transitions from the threads of S, seeing CH next
+   (DFA_EOF if the input ends), and consumes CH.  The resulting threads
+   are left in d->out, and the number of them is returned.  *MATCHED is
+   set if a match ends here.  In set mode, the indices of the patterns
+   whose match ends here are put after the threads, and *MATCHED is
+   the number of them.  Mutex must be held. */
+static int dfa_expand(dfa *d, dfa_state *s, ScmChar ch, int *matched)
+{
+    int bol, eol, wordl, wordr;
+    if (d->reverse) {
+        eol = s->flags & DS_EDGE;
+        wordr = s->flags & DS_WORD;
+        bol = (ch == DFA_EOF);
+        wordl = (ch != DFA_EOF && dfa_wordp(ch));
+    } else {
+        bol = s->flags & DS_EDGE;
+        wordl = s->flags & DS_WORD;
+        eol = (ch == DFA_EOF);
+        wordr = (ch != DFA_EOF && dfa_wordp(ch));
+    }
+    int wb = (bol || eol || (!wordl != !wordr));
+    int nthreads = s->numThreads;
+    int nout = 0;
+
+    if (d->gen == UINT_MAX) {
+        memset(d->mark, 0, sizeof(unsigned int) * d->numNodes);
+        memset(d->qmark, 0, sizeof(unsigned int) * d->numNodes);
+        if (d->setp) {
+            memset(d->pmark, 0, sizeof(unsigned int) * d->numPatterns);
+        }
+        d->gen = 0;
+    }
+    unsigned int gen = ++d->gen;
+    int npats = 0;
+    int *pats = d->out + d->numNodes;
+    *matched = FALSE;
+
+#define DFA_PUSH_OUT(n)                                 \
+    do {                                                \
+        if (d->qmark[n] != gen) {                       \
+            d->qmark[n] = gen;                          \
+            d->out[nout++] = (n);                       \
+        }                                               \
+    } while (0)
+
+    int implicit = !(d->anchored || (s->flags & DS_NOSTART));
+    for (int t = 0; t < nthreads + implicit; t++) {
+        int sp = 0;
+        d->stack[sp++] = (t < nthreads)? s->threads[t] : d->start;
+        while (sp > 0) {
+            int n = d->stack[--sp];
+            if (d->mark[n] == gen) continue;
+            d->mark[n] = gen;
+            dfa_node *node = &d->nodes[n];
+            switch (node->op) {
+            case DN_SPLIT:
+                d->stack[sp++] = node->alt;
+                d->stack[sp++] = node->next;
+                break;
+            case DN_BOL: if (bol)  d->stack[sp++] = node->next; break;
+            case DN_EOL: if (eol)  d->stack[sp++] = node->next; break;
+            case DN_WB:  if (wb)   d->stack[sp++] = node->next; break;
+            case DN_NWB: if (!wb)  d->stack[sp++] = node->next; break;
+            case DN_FAIL: break;
+            case DN_MATCH:
+                if (d->setp) {
+                    /* we don't care which match rex_rec would find */
+                    if (d->pmark[node->arg] != gen) {
+                        d->pmark[node->arg] = gen;
+                        pats[npats++] = node->arg;
+                    }
+                    break;
+                }
+                *matched = TRUE;
+                if (!d->reverse) return nout; /* lower priorities are cut */
+                break;
+            case DN_NOTNEXT:
+                if (!(s->flags & DS_GUARD(node->alt))) {
+                    d->stack[sp++] = node->next;
+                }
+                break;
+            case DN_REP:
+                if (ch != DFA_EOF && dfa_pred(d, node->sub, node->arg, ch)) {
+                    DFA_PUSH_OUT(n);
+                } else {
+                    d->stack[sp++] = node->next;
+                }
+                break;
+            default:
+                if (ch != DFA_EOF && dfa_pred(d, node->op, node->arg, ch)) {
+                    DFA_PUSH_OUT(node->next);
+                }
+                break;
+            }
+        }
+    }
+#undef DFA_PUSH_OUT
+    if (npats > 0) {
+        memmove(d->out + nout, pats, npats * sizeof(int));
+        *matched = npats;
+    }
+    return nout;
+}
+
+/* State flags that tell which DN_NOTNEXT nodes CH fails. */
+static int dfa_guard_flags(dfa *d, ScmChar ch)
+{
+    int flags = 0;
+    for (int i = 0; i < d->numGuards; i++) {
+        dfa_node *node = &d->nodes[d->guards[i]];
+        if (dfa_pred(d, node->sub, node->arg, ch)) flags |= DS_GUARD(i);
+    }
+    return flags;
+}
+
+/* Transition from S by CH.  Mutex must be held. */
+static dfa_state *dfa_step(dfa *d, dfa_state *s, ScmChar ch)
+{
+    int matched;
+    int n = dfa_expand(d, s, ch, &matched);
+    if (d->setp) {
+        /* CH may be DFA_EOF, to find the matches at the end */
+        int flags = (matched? DS_MATCHED : 0) | (dfa_wordp(ch)? DS_WORD : 0);
+        return dfa_intern(d, flags, d->out, n, matched);
+    }
+    int flags = (s->flags & DS_NOSTART)
+        | (matched? DS_MATCHED|DS_NOSTART : 0)
+        | (dfa_wordp(ch)? DS_WORD : 0)
+        | dfa_guard_flags(d, ch);
+    return dfa_intern(d, flags, d->out, n, 0);
+}
+
+static dfa_state *dfa_next(dfa *d, dfa_state *s, ScmChar ch)
+{
+    dfa_state *r;
+    if (ch >= 0 && ch < DFA_ASCII) {
+        if ((r = s->next[ch]) != NULL) return r;
+        SCM_INTERNAL_MUTEX_LOCK(d->mutex);
+        r = dfa_step(d, s, ch);
+        AO_nop_full();
+        s->next[ch] = r;
+        SCM_INTERNAL_MUTEX_UNLOCK(d->mutex);
+    } else {
+        dfa_hi *e = s->hi[ch & (DFA_HI_CACHE-1)];
+        if (e && e->ch == ch) return e->to;
+        SCM_INTERNAL_MUTEX_LOCK(d->mutex);
+        r = dfa_step(d, s, ch);
+        e = SCM_NEW(dfa_hi);
+        e->ch = ch;
+        e->to = r;
+        AO_nop_full();
+        s->hi[ch & (DFA_HI_CACHE-1)] = e;
+        SCM_INTERNAL_MUTEX_UNLOCK(d->mutex);
+    }
+    return r;
+}
+
+/* Whether a match ends at the end of the input */
+static int dfa_final(dfa *d, dfa_state *s)
+{
+    if (s->final < 0) {
+        SCM_INTERNAL_MUTEX_LOCK(d->mutex);
+        int matched;
+        (void)dfa_expand(d, s, DFA_EOF, &matched);
+        s->final = matched;
+        SCM_INTERNAL_MUTEX_UNLOCK(d->mutex);
+    }
+    return s->final;
+}
+
+static dfa_state *dfa_initial(dfa *d, int flags)
+{
+    int nthreads = d->anchored? 1 : 0;
+    if (d->anchored) flags |= DS_NOSTART;
+    SCM_INTERNAL_MUTEX_LOCK(d->mutex);
+    dfa_state *s = dfa_intern(d, flags, &d->start, nthreads, 0);
+    SCM_INTERNAL_MUTEX_UNLOCK(d->mutex);
+    return s;
+}
+
+#define DFA_DEADP(s) ((s)->numThreads == 0 && ((s)->flags & DS_NOSTART))
+
+/* Returns the end of the match rex_rec would find in the input
+   [START, END), or NULL if there's no match.  ORIGIN is the beginning
+   of the input; we know no match begins before START. */
+static const char *dfa_search_end(dfa *d, const char *origin,
+                                  const char *start, const char *end)
+{
+    dfa_state *s;
+    if (start == origin) {
+        s = d->init;
+        if (s == NULL) d->init = s = dfa_initial(d, DS_EDGE);
+    } else {
+        const char *prev;
+        ScmChar ch;
+        SCM_CHAR_BACKWARD(start, origin, prev);
+        SCM_ASSERT(prev != NULL);
+        SCM_CHAR_GET(prev, ch);
+        s = dfa_initial(d, dfa_wordp(ch)? DS_WORD : 0);
+    }
+
+    const char *matchend = NULL;
+    for (const char *p = start; p < end;) {
+        ScmChar ch;
+        unsigned char b = (unsigned char)*p;
+        dfa_state *n;
+        if (b < DFA_ASCII) {
+            ch = b;
+            n = s->next[b];
+        } else {
+            SCM_CHAR_GET(p, ch);
+            n = NULL;
+        }
+        s = n? n : dfa_next(d, s, ch);
+        if (s->flags & DS_MATCHED) matchend = p;
+        if (DFA_DEADP(s)) return matchend;
+        p += SCM_CHAR_NFOLLOWS(b) + 1;
+    }
+    if (dfa_final(d, s)) matchend = end;
+    return matchend;
+}
+
+/* Given the end of a match, MATCHEND, returns its start.  If EDGEP is
+   FALSE, START isn't the beginning of the input, and the char there is
+   only used for the context; a match begins after it. */
+static const char *dfa_search_start(dfa *d, const char *start, int edgep,
+                                    const char *matchend, const char *end)
+{
+    int flags = DS_EDGE;
+    if (matchend < end) {
+        ScmChar ch;
+        SCM_CHAR_GET(matchend, ch);
+        flags = (dfa_wordp(ch)? DS_WORD : 0) | dfa_guard_flags(d, ch);
+    }
+    dfa_state *s = dfa_initial(d, flags);
+
+    const char *matchstart = NULL;
+    for (const char *p = matchend; p > start;) {
+        const char *prev;
+        ScmChar ch;
+        SCM_CHAR_BACKWARD(p, start, prev);
+        SCM_ASSERT(prev != NULL);
+        SCM_CHAR_GET(prev, ch);
+        dfa_state *n = (ch >= 0 && ch < DFA_ASCII)? s->next[ch] : NULL;
+        s = n? n : dfa_next(d, s, ch);
+        if (s->flags & DS_MATCHED) matchstart = p;
+        if (DFA_DEADP(s)) return matchstart;
+        p = prev;
+    }
+    if (edgep && dfa_final(d, s)) matchstart = start;
+    return matchstart;
+}
+
+/* Returns TRUE if there's a match, setting MATCHES, FALSE if not, or
+   -1 if we can't tell.  If MATCHES is NULL, we only see if it matches. */
+static int rex_dfa(ScmRegexp *rx, const char *origin,
+                   const char *start, const char *end,
+                   struct ScmRegMatchSub **matches)
+{
+    const char *mend = dfa_search_end(rx->dfa->forward, origin, start, end);
+    if (mend == NULL) return FALSE;
+    if (matches == NULL) return TRUE;
+    const char *mstart = dfa_search_start(rx->dfa->backward, origin, TRUE,
+                                          mend, end);
+    if (mstart == NULL) return -1; /* shouldn't happen */
+
+    if (rx->numGroups > 1) {
+        /* we need rex_rec to find submatches */
+        return rex(rx, origin, mstart, end, matches)? TRUE : -1;
+    }
+    matches[0]->startp = mstart;
+    matches[0]->endp = mend;
+    return TRUE;
+}
+
+/* Returns the first occurrence of the literal LIT in [START, END),
+   or NULL. */
+static const char *find_literal(const char *start, const char *end,
+                                const ScmStringBody *lit)
+{
+    const char *s = SCM_STRING_BODY_START(lit);
+    int size = SCM_STRING_BODY_SIZE(lit);
+    const char *limit = end - size;
+#if defined(GAUCHE_CHAR_ENCODING_EUC_JP) || defined(GAUCHE_CHAR_ENCODING_SJIS)
+    /* A byte sequence may match in the middle of a multibyte char */
+    for (const char *p = start; p <= limit; p += SCM_CHAR_NFOLLOWS(*p)+1) {
+        if (memcmp(p, s, size) == 0) return p;
+    }
+#else
+    for (const char *p = start; p <= limit; p++) {
+        p = memchr(p, s[0], limit - p + 1);
+        if (p == NULL) break;
+        if (memcmp(p + 1, s + 1, size - 1) == 0) return p;
     }
 #endif
+    return NULL;
+}
+
+/*----------------------------------------------------------------------
+ * entry point
+ */
+
+/* Finds the leftmost match of RX in [START, END) and returns TRUE,
+   leaving the submatches in MATCHES.  ORIGIN is the beginning of the
+   input.  If TESTP is TRUE, the caller only wants to know whether it
+   matches, and MATCHES may not be set. */
+static int regexec_range(ScmRegexp *rx, const char *origin,
+                         const char *start, const char *end,
+                         struct ScmRegMatchSub **matches, int testp)
+{
+    const ScmStringBody *mb = rx->mustMatch? SCM_STRING_BODY(rx->mustMatch) : NULL;
+    const char *start_limit = end;
+
+    if (mb) {
+        /* Prescreening.  If the input string doesn't contain mustMatch
+           string, it can't match the entire expression.  (We don't
+           compute mustMatch for BOL-anchored regexp, for which it would
+           be faster to go for rex directly.) */
+        const char *p = find_literal(start, end, mb);
+        if (p == NULL) return FALSE;
+        if (rx->flags & SCM_REGEXP_LITERAL_PREFIX) start = p;
+    }
+
+    if (rx->dfa) {
+        int r = rex_dfa(rx, origin, start, end, testp? NULL : matches);
+        if (r >= 0) return r;
+    }
+
     /* short cut : if rx matches only at the beginning of the string,
        we only run from the beginning of the string */
     if (rx->flags & SCM_REGEXP_BOL_ANCHORED) {
-        return rex(rx, str, start, end);
+        return rex(rx, origin, start, end, matches);
+    }
+
+    /* if every match begins with a literal, we try where it appears.
+       SIMPLE_PREFIX case is better handled below. */
+    if ((rx->flags & SCM_REGEXP_LITERAL_PREFIX)
+        && !(rx->flags & SCM_REGEXP_SIMPLE_PREFIX)) {
+        while (start != NULL) {
+            if (rex(rx, origin, start, end, matches)) return TRUE;
+            start = find_literal(start + SCM_CHAR_NFOLLOWS(*start) + 1,
+                                 end, mb);
+        }
+        return FALSE;
     }
 
     /* if we have lookahead-set, we may be able to skip input efficiently. */
     if (!SCM_FALSEP(rx->laset)) {
         if (rx->flags & SCM_REGEXP_SIMPLE_PREFIX) {
             while (start <= start_limit) {
-                ScmObj r = rex(rx, str, start, end);
-                if (!SCM_FALSEP(r)) return r;
+                if (rex(rx, origin, start, end, matches)) return TRUE;
                 const char *next = skip_input(start, start_limit, rx->laset,
                                               TRUE);
                 if (start != next) start = next;
@@ -2878,21 +3936,441 @@ ScmObj Scm_RegExec(ScmRegexp *rx, ScmString *str)
         } else {
             while (start <= start_limit) {
                 start = skip_input(start, start_limit, rx->laset, FALSE);
-                ScmObj r = rex(rx, str, start, end);
-                if (!SCM_FALSEP(r)) return r;
+                if (rex(rx, origin, start, end, matches)) return TRUE;
                 start += SCM_CHAR_NFOLLOWS(*start)+1;
             }
         }
-        return SCM_FALSE;
+        return FALSE;
     }
 
     /* normal matching */
     while (start <= start_limit) {
-        ScmObj r = rex(rx, str, start, end);
-        if (!SCM_FALSEP(r)) return r;
+        if (rex(rx, origin, start, end, matches)) return TRUE;
         start += SCM_CHAR_NFOLLOWS(*start)+1;
     }
-    return SCM_FALSE;
+    return FALSE;
+}
+
+static int regexec(ScmRegexp *rx, ScmString *str,
+                   struct ScmRegMatchSub **matches, int testp)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(str);
+    const char *start = SCM_STRING_BODY_START(b);
+
+    if (SCM_STRING_INCOMPLETE_P(str)) {
+        Scm_Error("incomplete string is not allowed: %S", str);
+    }
+    return regexec_range(rx, start, start, start + SCM_STRING_BODY_SIZE(b),
+                         matches, testp);
+}
+
+ScmObj Scm_RegExec(ScmRegexp *rx, ScmString *str)
+{
+    struct ScmRegMatchSub *ptrs[MATCH_SLOTS_LOCAL], subs[MATCH_SLOTS_LOCAL];
+    struct ScmRegMatchSub **matches = match_slots(rx, ptrs, subs);
+    if (!regexec(rx, str, matches, FALSE)) return SCM_FALSE;
+    return make_match(rx, str, matches);
+}
+
+/* Returns TRUE iff RX matches somewhere in STR.  No match object is
+   created. */
+int Scm_RegMatchP(ScmRegexp *rx, ScmString *str)
+{
+    struct ScmRegMatchSub *ptrs[MATCH_SLOTS_LOCAL], subs[MATCH_SLOTS_LOCAL];
+    return regexec(rx, str, match_slots(rx, ptrs, subs), TRUE);
+}
+
+/* Stores the start and end character indices of the match and its
+   submatches into the s32vector V, as many as it can hold; -1 for
+   unmatched groups.  Returns the number of the pairs stored, or #f
+   if RX doesn't match.  No match object is created. */
+ScmObj Scm_RegMatchPositions(ScmRegexp *rx, ScmString *str, ScmUVector *v)
+{
+    if (!SCM_S32VECTORP(v)) Scm_Error("s32vector required, but got %S", v);
+    SCM_UVECTOR_CHECK_MUTABLE(v);
+    struct ScmRegMatchSub *ptrs[MATCH_SLOTS_LOCAL], subs[MATCH_SLOTS_LOCAL];
+    struct ScmRegMatchSub **matches = match_slots(rx, ptrs, subs);
+    if (!regexec(rx, str, matches, FALSE)) return SCM_FALSE;
+
+    const ScmStringBody *b = SCM_STRING_BODY(str);
+    const char *input = SCM_STRING_BODY_START(b);
+    int singlep = (SCM_STRING_BODY_SIZE(b) == SCM_STRING_BODY_LENGTH(b));
+    ScmInt32 *elts = SCM_S32VECTOR_ELEMENTS(v);
+    int n = (int)(SCM_S32VECTOR_SIZE(v) / 2);
+    if (n > rx->numGroups) n = rx->numGroups;
+    for (int i = 0; i < n; i++) {
+        const char *sp = matches[i]->startp, *ep = matches[i]->endp;
+        if (sp == NULL) {
+            elts[i*2] = elts[i*2+1] = -1;
+        } else if (singlep) {
+            elts[i*2] = (ScmInt32)(sp - input);
+            elts[i*2+1] = (ScmInt32)(ep - input);
+        } else {
+            elts[i*2] = (ScmInt32)Scm_MBLen(input, sp);
+            elts[i*2+1] = elts[i*2] + (ScmInt32)Scm_MBLen(sp, ep);
+        }
+    }
+    return SCM_MAKE_INT(n);
+}
+
+/*----------------------------------------------------------------------
+ * Searching input port
+ *
+ *  We read the port by chunks into a window, and run the forward
+ *  automaton over it as the data comes.  When the automaton has no
+ *  threads, no match can begin before the next char, so the window only
+ *  needs to keep the bytes from there, plus a char before for the
+ *  context.  Thus the memory we use is bounded by the longest partial
+ *  match, not by the size of the input.
+ *
+ *  The regexps that need backtracking can't be run that way; for them,
+ *  we read the whole input.
+ */
+
+#define PORT_CHUNK 8192
+
+typedef struct port_window_rec {
+    ScmPort *port;
+    char *buf;
+    ScmSmallInt size;               /* # of bytes in buf */
+    ScmSmallInt capacity;
+    ScmSmallInt base;               /* stream offset of buf[0] */
+    int edgep;                  /* buf[0] is the beginning of the stream */
+    int eofp;
+} port_window;
+
+/* Reads a chunk into W.  The bytes before KEEP may be discarded; the
+   number of discarded bytes is returned in *SHIFT, by which the caller
+   should adjust the indices it has.  Returns FALSE at EOF. */
+static int pw_fill(port_window *w, ScmSmallInt keep, ScmSmallInt *shift)
+{
+    *shift = 0;
+    if (w->eofp) return FALSE;
+    if (w->capacity - w->size < PORT_CHUNK) {
+        /* We allocate a new buffer instead of moving bytes, for match
+           objects we created share the old one. */
+        ScmSmallInt rest = w->size - keep;
+        ScmSmallInt cap = w->capacity;
+        while (cap < (rest + PORT_CHUNK) * 2) cap *= 2;
+        char *nb = SCM_NEW_ATOMIC2(char*, cap);
+        memcpy(nb, w->buf + keep, rest);
+        w->buf = nb;
+        w->capacity = cap;
+        w->size = rest;
+        w->base += keep;
+        if (keep > 0) w->edgep = FALSE;
+        *shift = keep;
+    }
+    int n = Scm_Getz(w->buf + w->size, PORT_CHUNK, w->port);
+    if (n <= 0) {
+        w->eofp = TRUE;
+        return FALSE;
+    }
+    w->size += n;
+    return TRUE;
+}
+
+/* Whether W has a complete char at index P.  Reads more if needed,
+   discarding the bytes before KEEP; *SHIFT is set as in pw_fill. */
+static int pw_char_ready(port_window *w, ScmSmallInt p, ScmSmallInt keep,
+                         ScmSmallInt *shift)
+{
+    *shift = 0;
+    for (;;) {
+        if (p < w->size
+            && p + SCM_CHAR_NFOLLOWS(w->buf[p]) < w->size) return TRUE;
+        ScmSmallInt sh;
+        int more = pw_fill(w, keep, &sh);
+        p -= sh;
+        keep -= sh;
+        *shift += sh;
+        if (!more) {
+            if (p < w->size) {
+                Scm_Error("incomplete character at the end of input: %S",
+                          w->port);
+            }
+            return FALSE;
+        }
+    }
+}
+
+/* Returns the index of the char before P in W, or P if there's none. */
+static ScmSmallInt pw_prev(port_window *w, ScmSmallInt p)
+{
+    if (p == 0) return 0;
+    const char *prev;
+    SCM_CHAR_BACKWARD(w->buf + p, w->buf, prev);
+    SCM_ASSERT(prev != NULL);
+    return prev - w->buf;
+}
+
+/* Finds the next match in W from POS with the automata of RX.  Returns
+   TRUE and sets *MSTART and *MEND, or returns FALSE.  *KEEP is the index
+   of the char before *POS on entry.  Both are adjusted if the window is
+   refilled, and *POS is left where we stopped reading. */
+static int pw_search(ScmRegexp *rx, port_window *w, ScmSmallInt *pos,
+                     ScmSmallInt *keep, ScmSmallInt *mstart, ScmSmallInt *mend)
+{
+    dfa *d = rx->dfa->forward;
+    dfa_state *s;
+    int edgep = (*pos == 0 && w->edgep);
+    if (edgep) {
+        s = d->init;
+        if (s == NULL) d->init = s = dfa_initial(d, DS_EDGE);
+    } else {
+        ScmChar ch;
+        SCM_CHAR_GET(w->buf + pw_prev(w, *pos), ch);
+        s = dfa_initial(d, dfa_wordp(ch)? DS_WORD : 0);
+    }
+
+    ScmSmallInt p = *pos, matchend = -1;
+    for (;;) {
+        ScmSmallInt shift;
+        int ready = pw_char_ready(w, p, *keep, &shift);
+        p -= shift;
+        *keep -= shift;
+        if (matchend >= 0) matchend -= shift;
+        if (!ready) {
+            if (dfa_final(d, s)) matchend = w->size;
+            break;
+        }
+        ScmChar ch;
+        unsigned char b = (unsigned char)w->buf[p];
+        dfa_state *n;
+        if (b < DFA_ASCII) {
+            ch = b;
+            n = s->next[b];
+        } else {
+            SCM_CHAR_GET(w->buf + p, ch);
+            n = NULL;
+        }
+        s = n? n : dfa_next(d, s, ch);
+        if (s->flags & DS_MATCHED) matchend = p;
+        if (DFA_DEADP(s)) break;
+        if (s->numThreads == 0 && !(s->flags & DS_NOSTART)) {
+            *keep = p;
+            edgep = FALSE;
+        }
+        p += SCM_CHAR_NFOLLOWS(b) + 1;
+    }
+    *pos = p;
+    if (matchend < 0) return FALSE;
+
+    /* The match can't begin before the search did, even if the regexp
+       matches there. */
+    const char *ms = dfa_search_start(rx->dfa->backward, w->buf + *keep,
+                                      edgep, w->buf + matchend,
+                                      w->buf + w->size);
+    SCM_ASSERT(ms != NULL);
+    *mstart = ms - w->buf;
+    *mend = matchend;
+    return TRUE;
+}
+
+/* Calls PROC with the stream offset and the match object, for each
+   match of RX in the rest of PORT.  Returns the number of matches.
+   The match object only holds the matched text. */
+ScmObj Scm_RegSearchPort(ScmRegexp *rx, ScmPort *port, ScmObj proc)
+{
+    port_window w;
+    w.port = port;
+    w.capacity = PORT_CHUNK * 2;
+    w.buf = SCM_NEW_ATOMIC2(char*, w.capacity);
+    w.size = 0;
+    w.base = 0;
+    w.edgep = TRUE;
+    w.eofp = FALSE;
+
+    if (rx->dfa == NULL) {
+        ScmSmallInt shift;
+        while (pw_fill(&w, 0, &shift))
+            ;
+        ScmObj s = Scm_MakeString(w.buf, w.size, -1, 0);
+        if (SCM_STRING_INCOMPLETE_P(s)) {
+            Scm_Error("incomplete character at the end of input: %S", port);
+        }
+    }
+
+    struct ScmRegMatchSub *ptrs[MATCH_SLOTS_LOCAL], subs[MATCH_SLOTS_LOCAL];
+    struct ScmRegMatchSub **matches = match_slots(rx, ptrs, subs);
+    ScmSmallInt pos = 0, count = 0;
+    for (;;) {
+        ScmSmallInt keep = pw_prev(&w, pos), mstart, mend;
+        if (rx->dfa) {
+            if (!pw_search(rx, &w, &pos, &keep, &mstart, &mend)) break;
+            if (rx->numGroups > 1) {
+                /* we need rex_rec to find submatches */
+                int r = rex(rx, w.buf + keep, w.buf + mstart,
+                            w.buf + w.size, matches);
+                SCM_ASSERT(r);
+            } else {
+                matches[0]->startp = w.buf + mstart;
+                matches[0]->endp = w.buf + mend;
+            }
+        } else {
+            if (pos > w.size
+                || !regexec_range(rx, w.buf, w.buf + pos, w.buf + w.size,
+                                  matches, FALSE)) break;
+            mstart = matches[0]->startp - w.buf;
+            mend = matches[0]->endp - w.buf;
+        }
+
+        ScmObj str = Scm_MakeString(w.buf + mstart, mend - mstart, -1, 0);
+        Scm_ApplyRec2(proc, Scm_MakeInteger(w.base + mstart),
+                      make_match(rx, SCM_STRING(str), matches));
+        count++;
+
+        pos = mend;
+        if (mstart == mend) {
+            /* skip a char after an empty match */
+            keep = pw_prev(&w, pos);
+            if (rx->dfa) {
+                ScmSmallInt shift;
+                int ready = pw_char_ready(&w, pos, keep, &shift);
+                pos -= shift;
+                if (!ready) break;
+            } else if (pos >= w.size) {
+                break;
+            }
+            pos += SCM_CHAR_NFOLLOWS(w.buf[pos]) + 1;
+        }
+    }
+    return Scm_MakeInteger(count);
+}
+
+/*=======================================================================
+ * Regexp set
+ *
+ *  The regexps that can be run by DFA are combined into one automaton
+ *  in set mode, which scans the input once and tells all of them that
+ *  match.  The others are tried one by one.
+ */
+
+struct ScmRegexpSetRec {
+    SCM_HEADER;
+    int numRegexps;
+    ScmRegexp **regexps;
+    int *dfaIndex;              /* index in dfa's patterns, or -1 */
+    dfa *dfa;                   /* may be NULL */
+};
+
+static void regexp_set_print(ScmObj obj, ScmPort *port,
+                             ScmWriteContext *ctx)
+{
+    Scm_Printf(port, "#<regexp-set %d regexps>",
+               SCM_REGEXP_SET(obj)->numRegexps);
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_RegexpSetClass, regexp_set_print);
+
+/* REGEXPS is a list of regexps or strings. */
+ScmObj Scm_MakeRegexpSet(ScmObj regexps)
+{
+    int n = Scm_Length(regexps);
+    if (n < 0) Scm_Error("proper list required, but got %S", regexps);
+    ScmRegexpSet *set = SCM_NEW(ScmRegexpSet);
+    SCM_SET_CLASS(set, SCM_CLASS_REGEXP_SET);
+    set->numRegexps = n;
+    set->regexps = SCM_NEW_ARRAY(ScmRegexp*, n);
+    set->dfaIndex = SCM_NEW_ATOMIC_ARRAY(int, n);
+    set->dfa = NULL;
+
+    ScmRegexp **rxs = SCM_NEW_ARRAY(ScmRegexp*, n);
+    int ndfa = 0, i = 0;
+    ScmObj cp;
+    SCM_FOR_EACH(cp, regexps) {
+        ScmObj x = SCM_CAR(cp);
+        if (SCM_STRINGP(x)) x = Scm_RegComp(SCM_STRING(x), 0);
+        else if (!SCM_REGEXPP(x)) {
+            Scm_Error("regexp or string required, but got %S", x);
+        }
+        set->regexps[i] = SCM_REGEXP(x);
+        if (SCM_REGEXP(x)->dfa) {
+            set->dfaIndex[i] = ndfa;
+            rxs[ndfa++] = SCM_REGEXP(x);
+        } else {
+            set->dfaIndex[i] = -1;
+        }
+        i++;
+    }
+    if (ndfa > 0) set->dfa = dfa_build_set(rxs, ndfa);
+    return SCM_OBJ(set);
+}
+
+ScmObj Scm_RegexpSetRegexps(ScmRegexpSet *set)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    for (int i = 0; i < set->numRegexps; i++) {
+        SCM_APPEND1(h, t, SCM_OBJ(set->regexps[i]));
+    }
+    return h;
+}
+
+/* Marks in FOUND the patterns of D that match somewhere in [START, END),
+   counting them in *NFOUND.  Stops when all are found. */
+static void dfa_search_set(dfa *d, const char *start, const char *end,
+                           char *found, int *nfound)
+{
+    dfa_state *s = d->init;
+    if (s == NULL) d->init = s = dfa_initial(d, DS_EDGE);
+
+    for (const char *p = start;;) {
+        ScmChar ch;
+        dfa_state *n;
+        if (p >= end) {
+            ch = DFA_EOF;
+            n = NULL;
+        } else {
+            unsigned char b = (unsigned char)*p;
+            if (b < DFA_ASCII) {
+                ch = b;
+                n = s->next[b];
+            } else {
+                SCM_CHAR_GET(p, ch);
+                n = NULL;
+            }
+            p += SCM_CHAR_NFOLLOWS(b) + 1;
+        }
+        s = n? n : dfa_next(d, s, ch);
+        for (int i = 0; i < s->numMatches; i++) {
+            int k = s->threads[s->numThreads + i];
+            if (!found[k]) {
+                found[k] = TRUE;
+                if (++*nfound == d->numPatterns) return;
+            }
+        }
+        if (ch == DFA_EOF) return;
+    }
+}
+
+/* Returns a list of the indices of the regexps that match INPUT,
+   in increasing order. */
+ScmObj Scm_RegexpSetMatches(ScmRegexpSet *set, ScmString *input)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(input);
+    const char *start = SCM_STRING_BODY_START(b);
+    const char *end = start + SCM_STRING_BODY_SIZE(b);
+
+    if (SCM_STRING_INCOMPLETE_P(input)) {
+        Scm_Error("incomplete string is not allowed: %S", input);
+    }
+    char *found = NULL;
+    if (set->dfa) {
+        int nfound = 0;
+        found = SCM_NEW_ATOMIC2(char*, set->dfa->numPatterns);
+        memset(found, 0, set->dfa->numPatterns);
+        dfa_search_set(set->dfa, start, end, found, &nfound);
+    }
+
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    for (int i = 0; i < set->numRegexps; i++) {
+        int k = set->dfaIndex[i];
+        int matchp;
+        if (k >= 0 && found) matchp = found[k];
+        else matchp = Scm_RegMatchP(set->regexps[i], input);
+        if (matchp) SCM_APPEND1(h, t, SCM_MAKE_INT(i));
+    }
+    return h;
 }
 
 /*=======================================================================
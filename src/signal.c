@@ -36,6 +36,10 @@
 #include "gauche/vm.h"
 #include "gauche/class.h"
 
+#if !defined(GAUCHE_WINDOWS)
+#include <fcntl.h>
+#endif
+
 /* Signals
  *
  *  C-application that embeds Gauche can specify a set of signals
@@ -370,6 +374,11 @@ ScmObj Scm_SysSigsetFill(ScmSysSigset *set, int emptyp)
  * C-level signal handler - just records the signal delivery.
  */
 
+/* Self-pipe for signal notification; see Scm_SignalNotificationFd().
+   sigNotifyFds[1] is written by sig_handle, so it's set only once
+   and never closed.  -1 means notification isn't requested. */
+static volatile int sigNotifyFds[2] = {-1, -1};
+
 static void sig_handle(int signum)
 {
     ScmVM *vm = Scm_VM();
@@ -384,6 +393,17 @@ static void sig_handle(int signum)
     }
     vm->signalPending = TRUE;
     vm->attentionRequest = TRUE;
+
+#if !defined(GAUCHE_WINDOWS)
+    if (sigNotifyFds[1] >= 0) {
+        /* If the pipe is full, there are already unread notifications,
+           so we can just drop this one. */
+        unsigned char b = (unsigned char)signum;
+        int e = errno;
+        if (write(sigNotifyFds[1], &b, 1) < 0) { /* ignore */ }
+        errno = e;
+    }
+#endif
 }
 
 /*-------------------------------------------------------------------
@@ -404,7 +424,7 @@ void Scm_SignalQueueClear(ScmSignalQueue* q)
 void Scm_SignalQueueInit(ScmSignalQueue* q)
 {
 #if defined(GAUCHE_API_0_9)
-    q->sigcounts = SCM_NEW_ARRAY(unsigned char, SCM_NSIG);
+    q->sigcounts = SCM_NEW_ATOMIC_ARRAY(unsigned char, SCM_NSIG);
 #endif /* GAUCHE_API_0_9 */
     Scm_SignalQueueClear(q);
     q->pending = SCM_NIL;
@@ -998,6 +1018,68 @@ int Scm_SigWait(ScmSysSigset *mask)
 #endif
 }
 
+/*
+ * Signal notification fd
+ *
+ * An event-loop program that waits on select(2)/poll(2) can't reliably
+ * be woken up by a signal; if the signal arrives just before the
+ * program enters the system call, it sleeps until some other event
+ * occurs.  To help that, we provide the classic self-pipe: once
+ * requested, sig_handle writes the signal number to a pipe, and the
+ * program watches its read end along with other fds (e.g. by
+ * gauche.selector).  The Scheme handlers are still run by the VM as
+ * usual; the notification is just a wakeup.
+ *
+ * We don't use Linux's signalfd, for it requires the signals to be
+ * blocked, which conflicts with the way Gauche delivers them to the
+ * Scheme handlers.
+ */
+int Scm_SignalNotificationFd(void)
+{
+#if !defined(GAUCHE_WINDOWS)
+    int fds[2], r = 0;
+
+    (void)SCM_INTERNAL_MUTEX_LOCK(sigHandlers.mutex);
+    if (sigNotifyFds[0] < 0) {
+        r = pipe(fds);
+        if (r == 0) {
+            for (int i=0; i<2; i++) {
+                (void)fcntl(fds[i], F_SETFL,
+                            fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+                (void)fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+            }
+            sigNotifyFds[0] = fds[0];
+            sigNotifyFds[1] = fds[1];
+        }
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(sigHandlers.mutex);
+    if (r < 0) Scm_SysError("pipe failed");
+    return sigNotifyFds[0];
+#else  /* GAUCHE_WINDOWS */
+    Scm_Error("signal notification fd not supported on this platform");
+    return -1;
+#endif /* GAUCHE_WINDOWS */
+}
+
+/* Reads out the notifications without blocking.  Returns a list of
+   signal numbers in the order of delivery. */
+ScmObj Scm_SignalNotificationDrain(void)
+{
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+#if !defined(GAUCHE_WINDOWS)
+    unsigned char buf[64];
+
+    if (sigNotifyFds[0] < 0) return SCM_NIL;
+    for (;;) {
+        ssize_t r = read(sigNotifyFds[0], buf, sizeof(buf));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        for (ssize_t i=0; i<r; i++) SCM_APPEND1(h, t, SCM_MAKE_INT(buf[i]));
+    }
+#endif /* !GAUCHE_WINDOWS */
+    return h;
+}
+
 
 /*================================================================
  * Initialize
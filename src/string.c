@@ -32,6 +32,7 @@
  */
 
 #define LIBGAUCHE_BODY
+#include "atomic_ops.h"
 #include "gauche.h"
 
 #include <string.h>
@@ -65,13 +66,14 @@ static ScmString *make_str(ScmSmallInt len, ScmSmallInt siz,
         Scm_Error("string length (%ld) exceeds size (%ld)", len, siz);
     }
 
-    ScmString *s = SCM_NEW(ScmString);
+    ScmString *s = SCM_NEW_KIND(ScmString, SCM_ALLOC_STRING);
     SCM_SET_CLASS(s, SCM_CLASS_STRING);
     s->body = NULL;
     s->initialBody.flags = flags & SCM_STRING_FLAG_MASK;
     s->initialBody.length = len;
     s->initialBody.size = siz;
     s->initialBody.start = p;
+    s->initialBody.index = NULL;
     return s;
 }
 
@@ -103,7 +105,7 @@ void Scm_StringDump(FILE *out, ScmObj str)
    argument is in valid range.) */
 char *Scm_StrdupPartial(const char *src, size_t size)
 {
-    char *dst = SCM_NEW_ATOMIC_ARRAY(char, size+1);
+    char *dst = (char*)SCM_MALLOC_ATOMIC_KIND(size+1, SCM_ALLOC_STRING);
     memcpy(dst, src, size);
     dst[size] = '\0';
     return dst;
@@ -115,6 +117,26 @@ char *Scm_StrdupPartial(const char *src, size_t size)
 
 /* We have multiple similar functions, due to performance reasons. */
 
+/* In every supported encoding, a byte below 0x80 at a character
+   boundary is a single-byte character.  So we can skip a run of such
+   bytes a word at a time, without decoding them one by one. */
+#define WORD_LOW_BITS   (~(u_long)0/0xff)           /* 0x0101...01 */
+#define WORD_HIGH_BITS  (WORD_LOW_BITS*0x80)        /* 0x8080...80 */
+#define WORD_HAS_NUL(w) (((w) - WORD_LOW_BITS) & ~(w) & WORD_HIGH_BITS)
+
+/* Returns the number of leading bytes of STR, up to SIZE, that are
+   known to be ASCII by whole-word checks. */
+static inline ScmSmallInt ascii_prefix(const char *str, ScmSmallInt size)
+{
+    ScmSmallInt i = 0;
+    for (; i + (ScmSmallInt)sizeof(u_long) <= size; i += sizeof(u_long)) {
+        u_long w;
+        memcpy(&w, str+i, sizeof(u_long));
+        if (w & WORD_HIGH_BITS) break;
+    }
+    return i;
+}
+
 /* Calculate both length and size of C-string str.
    If str is incomplete, *plen gets -1. */
 static inline ScmSmallInt count_size_and_length(const char *str,
@@ -124,7 +146,22 @@ static inline ScmSmallInt count_size_and_length(const char *str,
     char c;
     const char *p = str;
     ScmSmallInt size = 0, len = 0;
-    while ((c = *p++) != 0) {
+    for (;;) {
+        if (((uintptr_t)p & (sizeof(u_long)-1)) == 0) {
+            /* An aligned word never crosses a page boundary, so reading
+               it is safe even if the terminating NUL is in the middle. */
+            const char *q = p;
+            for (;;) {
+                u_long w;
+                memcpy(&w, q, sizeof(u_long));
+                if ((w & WORD_HIGH_BITS) || WORD_HAS_NUL(w)) break;
+                q += sizeof(u_long);
+            }
+            len += q - p;
+            size += q - p;
+            p = q;
+        }
+        if ((c = *p++) == 0) break;
         int i = SCM_CHAR_NFOLLOWS(c);
         len++;
         size++;
@@ -143,8 +180,18 @@ static inline ScmSmallInt count_size_and_length(const char *str,
 static inline ScmSmallInt count_length(const char *str, ScmSmallInt size)
 {
     ScmSmallInt count = 0;
-    while (size-- > 0) {
+    while (size > 0) {
         unsigned char c = (unsigned char)*str;
+        if (c < 0x80) {
+            ScmSmallInt n = ascii_prefix(str, size);
+            if (n > 0) {
+                count += n;
+                str += n;
+                size -= n;
+                continue;
+            }
+        }
+        size--;
         int i = SCM_CHAR_NFOLLOWS(c);
         if (i < 0 || i > size) return -1;
         ScmChar ch;
@@ -203,7 +250,8 @@ ScmObj Scm_MakeFillString(ScmSmallInt len, ScmChar fill)
     if (len < 0) Scm_Error("length out of range: %ld", len);
     ScmSmallInt csize = SCM_CHAR_NBYTES(fill);
     CHECK_SIZE(csize*len);
-    char *ptr = SCM_NEW_ATOMIC2(char *, csize*len+1);
+    char *ptr = (char*)SCM_MALLOC_ATOMIC_KIND(csize*len+1,
+                                              SCM_ALLOC_STRING);
     char *p = ptr;
     for (int i=0; i<len; i++, p+=csize) {
         SCM_CHAR_PUT(p, fill);
@@ -225,7 +273,7 @@ ScmObj Scm_ListToString(ScmObj chars)
         len++;
         CHECK_SIZE(size);
     }
-    char *buf = SCM_NEW_ATOMIC2(char *, size+1);
+    char *buf = (char*)SCM_MALLOC_ATOMIC_KIND(size+1, SCM_ALLOC_STRING);
     char *bufp = buf;
     SCM_FOR_EACH(cp, chars) {
         ScmChar ch = SCM_CHAR_VALUE(SCM_CAR(cp));
@@ -321,6 +369,33 @@ ScmObj Scm_CopyStringWithFlags(ScmString *x, int flags, int mask)
     return SCM_OBJ(make_str(len, size, start, newflags));
 }
 
+/* Substrings share the buffer of the original string, so even a short
+   substring keeps a huge original alive.  These copy the content into
+   a buffer of its own. */
+static ScmString *detached_copy(const ScmStringBody *b, int flags)
+{
+    ScmSmallInt size = SCM_STRING_BODY_SIZE(b);
+    return make_str(SCM_STRING_BODY_LENGTH(b), size,
+                    SCM_STRDUP_PARTIAL(SCM_STRING_BODY_START(b), size),
+                    flags | SCM_STRING_TERMINATED);
+}
+
+ScmObj Scm_CopyStringDetached(ScmString *x)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(x);
+    return SCM_OBJ(detached_copy(b, (SCM_STRING_BODY_FLAGS(b)
+                                     & ~SCM_STRING_IMMUTABLE)));
+}
+
+/* Unlike other mutators, this works on immutable strings as well,
+   for the content doesn't change. */
+ScmObj Scm_StringCompact(ScmString *x)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(x);
+    x->body = SCM_STRING_BODY(detached_copy(b, SCM_STRING_BODY_FLAGS(b)));
+    return SCM_OBJ(x);
+}
+
 ScmObj Scm_StringCompleteToIncomplete(ScmString *x)
 {
     return Scm_CopyStringWithFlags(x, SCM_STRING_INCOMPLETE,
@@ -395,6 +470,7 @@ int Scm_StringEqual(ScmString *x, ScmString *y)
 {
     const ScmStringBody *xb = SCM_STRING_BODY(x);
     const ScmStringBody *yb = SCM_STRING_BODY(y);
+    if (xb == yb) return TRUE;  /* copied strings share the body */
     if ((SCM_STRING_BODY_FLAGS(xb)^SCM_STRING_BODY_FLAGS(yb))&SCM_STRING_INCOMPLETE) {
         return FALSE;
     }
@@ -501,6 +577,48 @@ static const char *forward_pos(const char *current, ScmSmallInt offset)
     return current;
 }
 
+/* To make indexed access to a long multibyte string faster, we attach
+   a table to its body, which records the byte offset of every
+   STRING_INDEX_INTERVAL-th character.  It is built at the first
+   access beyond the first interval, and never changes afterwards
+   since the body is immutable.  Seeking then only needs to walk at
+   most STRING_INDEX_INTERVAL-1 characters. */
+#define STRING_INDEX_SHIFT     6
+#define STRING_INDEX_INTERVAL  (1L<<STRING_INDEX_SHIFT)
+
+static const unsigned int *body_index(const ScmStringBody *b)
+{
+    if (b->index) return b->index;
+
+    ScmSmallInt n = (SCM_STRING_BODY_LENGTH(b) >> STRING_INDEX_SHIFT) + 1;
+    unsigned int *ix = SCM_NEW_ATOMIC_ARRAY(unsigned int, n);
+    const char *start = SCM_STRING_BODY_START(b), *p = start;
+    ix[0] = 0;
+    for (ScmSmallInt i = 1; i < n; i++) {
+        p = forward_pos(p, STRING_INDEX_INTERVAL);
+        ix[i] = (unsigned int)(p - start);
+    }
+    /* Another thread may be building the same table; it doesn't
+       matter which one wins, as long as the content is visible
+       before the pointer. */
+    AO_nop_full();
+    ((ScmStringBody*)b)->index = ix; /* discard const qualifier */
+    return ix;
+}
+
+/* Returns the pointer to the POS-th character of a complete body B.
+   POS can be equal to the length of B. */
+static const char *body_pos(const ScmStringBody *b, ScmSmallInt pos)
+{
+    const char *s = SCM_STRING_BODY_START(b);
+    if (SCM_STRING_BODY_SINGLE_BYTE_P(b)) return s + pos;
+    if (pos < STRING_INDEX_INTERVAL) return forward_pos(s, pos);
+    if (pos == SCM_STRING_BODY_LENGTH(b)) return s + SCM_STRING_BODY_SIZE(b);
+    const unsigned int *ix = body_index(b);
+    return forward_pos(s + ix[pos >> STRING_INDEX_SHIFT],
+                       pos & (STRING_INDEX_INTERVAL-1));
+}
+
 /* string-ref.
  * If POS is out of range,
  *   - returns SCM_CHAR_INVALID if range_error is FALSE
@@ -529,7 +647,7 @@ ScmChar Scm_StringRef(ScmString *str, ScmSmallInt pos, int range_error)
     if (SCM_STRING_BODY_SINGLE_BYTE_P(b)) {
         return (ScmChar)(((unsigned char *)SCM_STRING_BODY_START(b))[pos]);
     } else {
-        const char *p = forward_pos(SCM_STRING_BODY_START(b), pos);
+        const char *p = body_pos(b, pos);
         ScmChar c;
         SCM_CHAR_GET(p, c);
         return c;
@@ -567,7 +685,7 @@ const char *Scm_StringBodyPosition(const ScmStringBody *b, ScmSmallInt offset)
     if (SCM_STRING_BODY_INCOMPLETE_P(b)) {
         return (SCM_STRING_BODY_START(b)+offset);
     } else {
-        return (forward_pos(SCM_STRING_BODY_START(b), offset));
+        return body_pos(b, offset);
     }
 }
 
@@ -593,7 +711,8 @@ ScmObj Scm_StringAppend2(ScmString *x, ScmString *y)
     ScmSmallInt leny = SCM_STRING_BODY_LENGTH(yb);
     CHECK_SIZE(sizex+sizey);
     int flags = 0;
-    char *p = SCM_NEW_ATOMIC2(char *,sizex + sizey + 1);
+    char *p = (char*)SCM_MALLOC_ATOMIC_KIND(sizex + sizey + 1,
+                                            SCM_ALLOC_STRING);
 
     memcpy(p, xb->start, sizex);
     memcpy(p+sizex, yb->start, sizey);
@@ -618,7 +737,8 @@ ScmObj Scm_StringAppendC(ScmString *x, const char *str,
     else if (leny < 0) leny = count_length(str, sizey);
     CHECK_SIZE(sizex+sizey);
 
-    char *p = SCM_NEW_ATOMIC2(char *, sizex + sizey + 1);
+    char *p = (char*)SCM_MALLOC_ATOMIC_KIND(sizex + sizey + 1,
+                                            SCM_ALLOC_STRING);
     memcpy(p, xb->start, sizex);
     memcpy(p+sizex, str, sizey);
     p[sizex+sizey] = '\0';
@@ -666,7 +786,7 @@ ScmObj Scm_StringAppend(ScmObj strs)
         bodies[i++] = b;
     }
 
-    char *buf = SCM_NEW_ATOMIC2(char *, size+1);
+    char *buf = (char*)SCM_MALLOC_ATOMIC_KIND(size+1, SCM_ALLOC_STRING);
     char *bufp = buf;
     for (i=0; i<numstrs; i++) {
         const ScmStringBody *b = bodies[i];
@@ -735,7 +855,7 @@ ScmObj Scm_StringJoin(ScmObj strs, ScmString *delim, int grammer)
     len += dlen * ndelim;
     CHECK_SIZE(size);
 
-    char *buf = SCM_NEW_ATOMIC2(char *, size+1);
+    char *buf = (char*)SCM_MALLOC_ATOMIC_KIND(size+1, SCM_ALLOC_STRING);
     char *bufp = buf;
     if (grammer == SCM_STRING_JOIN_PREFIX) {
         memcpy(bufp, SCM_STRING_BODY_START(dbody), dsize);
@@ -808,13 +928,16 @@ static ScmObj substring(const ScmStringBody *xb,
                                 SCM_STRING_BODY_START(xb) + start,
                                 flags));
     } else {
-        const char *s, *e;
-        if (start) s = forward_pos(SCM_STRING_BODY_START(xb), start);
-        else s = SCM_STRING_BODY_START(xb);
+        const char *s = body_pos(xb, start);
+        const char *e;
         if (len == end) {
             e = SCM_STRING_BODY_START(xb) + SCM_STRING_BODY_SIZE(xb);
         } else {
-            e = forward_pos(s, end - start);
+            if (end - start < STRING_INDEX_INTERVAL) {
+                e = forward_pos(s, end - start);
+            } else {
+                e = body_pos(xb, end);
+            }
             flags &= ~SCM_STRING_TERMINATED;
         }
         return SCM_OBJ(make_str((int)(end - start), (int)(e - s), s, flags));
@@ -892,6 +1015,25 @@ static ScmSmallInt boyer_moore_reverse(const char *ss1, ScmSmallInt siz1,
     return -1;
 }
 
+/* Brute-force search, but we let memchr(), which is usually well
+   tuned, find the candidate positions.  We look for the last byte of
+   s2; in multibyte text the first bytes of characters tend to be the
+   same, while the last ones vary.  Assuming siz1 >= siz2 > 0. */
+static ScmSmallInt memchr_search(const char *ss1, ScmSmallInt siz1,
+                                 const char *ss2, ScmSmallInt siz2)
+{
+    const char *p = ss1 + siz2 - 1;
+    const char *end = ss1 + siz1;
+    char last = ss2[siz2-1];
+    while (p < end) {
+        p = memchr(p, last, end - p);
+        if (p == NULL) return -1;
+        if (memcmp(p - siz2 + 1, ss2, siz2 - 1) == 0) return p - siz2 + 1 - ss1;
+        p++;
+    }
+    return -1;
+}
+
 /* Primitive routines to search a substring s2 within s1.
    Returns NOT_FOUND if not fonud, FOUND_BOTH_INDEX if both byte index
    (*bi) and character index (*ci) is calculted, FOUND_BYTE_INDEX
@@ -964,15 +1106,11 @@ static int string_search(const char *s1, ScmSmallInt siz1, ScmSmallInt len1,
             /* Shortcut for single-byte strings */
             if (siz1 < siz2) return NOT_FOUND;
             if (siz1 < 256 || siz2 >= 256) {
-                /* brute-force search */
-                for (i=0; i<=siz1-siz2; i++) {
-                    if (memcmp(s2, s1+i, siz2) == 0) break;
-                }
-                if (i == siz1-siz2+1) return NOT_FOUND;
+                i = memchr_search(s1, siz1, s2, siz2);
             } else {
                 i = boyer_moore(s1, siz1, s2, siz2);
-                if (i < 0) return NOT_FOUND;
             }
+            if (i < 0) return NOT_FOUND;
             *bi = *ci = i;
             return FOUND_MAYBE_BOTH;
         }
@@ -1187,6 +1325,436 @@ ScmObj Scm_StringScanCharRight(ScmString *s1, ScmChar ch, int retmode)
     else return Scm_Values2(v1, v2);
 }
 
+/*----------------------------------------------------------------
+ * Character-set search, for srfi-13
+ *
+ *  CS is either a character or a char-set.  We step over the string
+ *  by characters, but test ASCII bytes directly against the char-set
+ *  bitmap without decoding.  Procedure predicates are handled in
+ *  Scheme.
+ */
+
+static inline int cs_match(ScmObj cs, ScmChar ch)
+{
+    if (SCM_CHARP(cs)) return SCM_CHAR_VALUE(cs) == ch;
+    if (ch >= 0 && ch < SCM_CHAR_SET_SMALL_CHARS) {
+        return SCM_BITS_TEST(SCM_CHAR_SET(cs)->small, ch);
+    }
+    return Scm_CharSetContains(SCM_CHAR_SET(cs), ch);
+}
+
+/* Decodes a character at P, and returns the pointer to the next one. */
+static inline const char *cs_next(const ScmStringBody *b, const char *p,
+                                  ScmChar *ch)
+{
+    u_char c = (u_char)*p;
+    if (c < 0x80 || SCM_STRING_BODY_INCOMPLETE_P(b)) {
+        *ch = c;
+        return p+1;
+    }
+    SCM_CHAR_GET(p, *ch);
+    return p + SCM_CHAR_NFOLLOWS(c) + 1;
+}
+
+static void cs_check(ScmObj cs)
+{
+    if (!SCM_CHARP(cs) && !SCM_CHAR_SET_P(cs)) {
+        Scm_Error("character or char-set required, but got: %S", cs);
+    }
+}
+
+/* Returns the index of the first (or last, if SCM_STRING_INDEX_RIGHT is
+   given) character in S that matches CS (or that doesn't match CS, if
+   SCM_STRING_INDEX_SKIP is given).  Returns #f if there's none. */
+ScmObj Scm_StringIndex(ScmString *s, ScmObj cs, int flags)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(s);
+    const char *p = SCM_STRING_BODY_START(b);
+    const char *e = p + SCM_STRING_BODY_SIZE(b);
+    int want = !(flags & SCM_STRING_INDEX_SKIP);
+    ScmChar ch;
+
+    cs_check(cs);
+    if (SCM_STRING_BODY_SINGLE_BYTE_P(b)) {
+        if (flags & SCM_STRING_INDEX_RIGHT) {
+            for (const char *q = e - 1; q >= p; q--) {
+                if (cs_match(cs, (u_char)*q) == want) return SCM_MAKE_INT(q - p);
+            }
+            return SCM_FALSE;
+        }
+        if (SCM_CHARP(cs) && want && SCM_CHAR_VALUE(cs) < 0x80) {
+            const char *q = memchr(p, (int)SCM_CHAR_VALUE(cs), e - p);
+            return q ? SCM_MAKE_INT(q - p) : SCM_FALSE;
+        }
+        for (const char *q = p; q < e; q++) {
+            if (cs_match(cs, (u_char)*q) == want) return SCM_MAKE_INT(q - p);
+        }
+        return SCM_FALSE;
+    }
+
+    /* Multibyte.  For the right search, we scan forward anyway and
+       remember the last match. */
+    ScmSmallInt i = 0, found = -1;
+    while (p < e) {
+        p = cs_next(b, p, &ch);
+        if (cs_match(cs, ch) == want) {
+            if (!(flags & SCM_STRING_INDEX_RIGHT)) return SCM_MAKE_INT(i);
+            found = i;
+        }
+        i++;
+    }
+    return (found >= 0) ? SCM_MAKE_INT(found) : SCM_FALSE;
+}
+
+/* Returns a substring of S without leading and/or trailing characters
+   that match CS.  The result shares the storage with S. */
+ScmObj Scm_StringTrim(ScmString *s, ScmObj cs, int flags)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(s);
+    const char *start = SCM_STRING_BODY_START(b);
+    const char *end = start + SCM_STRING_BODY_SIZE(b);
+    ScmSmallInt len = SCM_STRING_BODY_LENGTH(b);
+    int sflags = SCM_STRING_BODY_FLAGS(b) & ~SCM_STRING_IMMUTABLE;
+    ScmChar ch;
+
+    cs_check(cs);
+    if (flags & SCM_STRING_TRIM_LEFT) {
+        while (start < end) {
+            const char *n = cs_next(b, start, &ch);
+            if (!cs_match(cs, ch)) break;
+            start = n;
+            len--;
+        }
+    }
+    if ((flags & SCM_STRING_TRIM_RIGHT) && start < end) {
+        const char *oend = end;
+        if (SCM_STRING_BODY_SINGLE_BYTE_P(b)) {
+            while (end > start && cs_match(cs, (u_char)end[-1])) {
+                end--;
+                len--;
+            }
+        } else {
+            /* Scan forward and remember the end of the last character
+               that doesn't match. */
+            const char *p = start, *last = start;
+            ScmSmallInt i = 0, lastlen = 0;
+            while (p < end) {
+                p = cs_next(b, p, &ch);
+                i++;
+                if (!cs_match(cs, ch)) {
+                    last = p;
+                    lastlen = i;
+                }
+            }
+            end = last;
+            len = lastlen;
+        }
+        if (end != oend) sflags &= ~SCM_STRING_TERMINATED;
+    }
+    if (start == SCM_STRING_BODY_START(b)
+        && end == start + SCM_STRING_BODY_SIZE(b)) {
+        return SCM_OBJ(s);
+    }
+    return SCM_OBJ(make_str(len, end - start, start, sflags));
+}
+
+/* Returns a list of maximal substrings of S consisting of characters
+   in CS.  The substrings share the storage with S. */
+ScmObj Scm_StringTokenize(ScmString *s, ScmObj cs)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(s);
+    const char *p = SCM_STRING_BODY_START(b);
+    const char *e = p + SCM_STRING_BODY_SIZE(b);
+    int sflags = SCM_STRING_BODY_FLAGS(b)
+        & ~(SCM_STRING_IMMUTABLE|SCM_STRING_TERMINATED);
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    ScmChar ch;
+
+    cs_check(cs);
+    while (p < e) {
+        const char *n = cs_next(b, p, &ch);
+        if (!cs_match(cs, ch)) {
+            p = n;
+            continue;
+        }
+        const char *tstart = p;
+        ScmSmallInt tlen = 0;
+        while (p < e) {
+            n = cs_next(b, p, &ch);
+            if (!cs_match(cs, ch)) break;
+            p = n;
+            tlen++;
+        }
+        SCM_APPEND1(h, t, SCM_OBJ(make_str(tlen, p - tstart, tstart, sflags)));
+    }
+    return h;
+}
+
+/* Returns TRUE iff S1 is a prefix of S2. */
+int Scm_StringPrefixP(ScmString *s1, ScmString *s2)
+{
+    const ScmStringBody *b1 = SCM_STRING_BODY(s1);
+    const ScmStringBody *b2 = SCM_STRING_BODY(s2);
+    ScmSmallInt siz1 = SCM_STRING_BODY_SIZE(b1);
+    if (siz1 > SCM_STRING_BODY_SIZE(b2)) return FALSE;
+    if (SCM_STRING_BODY_LENGTH(b1) > SCM_STRING_BODY_LENGTH(b2)) return FALSE;
+    return memcmp(SCM_STRING_BODY_START(b1), SCM_STRING_BODY_START(b2),
+                  siz1) == 0;
+}
+
+/* Returns TRUE iff S1 is a suffix of S2.  In euc-jp and sjis, the bytes
+   of S1 may match at the middle of a multibyte character of S2, so
+   we find the character boundary first. */
+int Scm_StringSuffixP(ScmString *s1, ScmString *s2)
+{
+    const ScmStringBody *b1 = SCM_STRING_BODY(s1);
+    const ScmStringBody *b2 = SCM_STRING_BODY(s2);
+    ScmSmallInt siz1 = SCM_STRING_BODY_SIZE(b1);
+    ScmSmallInt siz2 = SCM_STRING_BODY_SIZE(b2);
+    ScmSmallInt len1 = SCM_STRING_BODY_LENGTH(b1);
+    ScmSmallInt len2 = SCM_STRING_BODY_LENGTH(b2);
+    if (siz1 > siz2 || len1 > len2) return FALSE;
+    const char *p;
+    if (BYTEWISE_SEARCHABLE(siz2, len2)) {
+        p = SCM_STRING_BODY_START(b2) + siz2 - siz1;
+    } else {
+        p = Scm_StringBodyPosition(b2, len2 - len1);
+        if (SCM_STRING_BODY_START(b2) + siz2 - p != siz1) return FALSE;
+    }
+    return memcmp(SCM_STRING_BODY_START(b1), p, siz1) == 0;
+}
+
+/* Upcases each character, as srfi-13 string-upcase does. */
+static ScmObj string_upcase_chars(const ScmStringBody *b)
+{
+    const char *p = SCM_STRING_BODY_START(b);
+    const char *e = p + SCM_STRING_BODY_SIZE(b);
+    ScmDString ds;
+    ScmChar ch;
+    Scm_DStringInit(&ds);
+    while (p < e) {
+        p = cs_next(b, p, &ch);
+        if (ch < 0x80) {
+            SCM_DSTRING_PUTB(&ds, (ch >= 'a' && ch <= 'z') ? ch - 'a' + 'A' : ch);
+        } else {
+            Scm_DStringPutc(&ds, Scm_CharUpcase(ch));
+        }
+    }
+    return Scm_DStringGet(&ds, 0);
+}
+
+/* Case-insensitive version of string-scan.  Returns the index or #f. */
+ScmObj Scm_StringContainsCI(ScmString *s1, ScmString *s2)
+{
+    ScmObj u1 = string_upcase_chars(SCM_STRING_BODY(s1));
+    ScmObj u2 = string_upcase_chars(SCM_STRING_BODY(s2));
+    return Scm_StringScan(SCM_STRING(u1), SCM_STRING(u2),
+                          SCM_STRING_SCAN_INDEX);
+}
+
+/*----------------------------------------------------------------
+ * Multiple string search
+ *
+ *  A string matcher finds the leftmost occurrence of any of the given
+ *  strings in one pass, using Aho-Corasick automaton.  We compile it
+ *  into a DFA over bytes.  To keep the table small, bytes that don't
+ *  appear in any of the strings share one column.
+ *
+ *  Like string_search, bytewise matching is only valid in utf-8 and
+ *  none, or when the text consists of single-byte characters.
+ *  Otherwise we fall back to the naive search.
+ */
+
+struct ScmStringMatcherRec {
+    SCM_HEADER;
+    ScmObj strings;             /* vector of strings */
+    int numClasses;             /* # of columns in delta */
+    int maxSize;                /* the longest string size */
+    int emptyIndex;             /* an index of empty string, or -1 */
+    int *delta;                 /* transition table */
+    int *output;                /* for each state, the index of the
+                                   longest string that ends here, or -1 */
+    unsigned char classes[256]; /* byte -> column of delta */
+};
+
+static void matcher_print(ScmObj obj, ScmPort *port,
+                          ScmWriteContext *ctx)
+{
+    Scm_Printf(port, "#<string-matcher %d strings>",
+               SCM_VECTOR_SIZE(SCM_STRING_MATCHER(obj)->strings));
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_StringMatcherClass, matcher_print);
+
+ScmObj Scm_MakeStringMatcher(ScmObj strings)
+{
+    ScmObj vec = Scm_ListToVector(strings, 0, -1);
+    int n = SCM_VECTOR_SIZE(vec);
+    ScmSmallInt total = 0;
+    ScmStringMatcher *m = SCM_NEW(ScmStringMatcher);
+    SCM_SET_CLASS(m, SCM_CLASS_STRING_MATCHER);
+    m->strings = vec;
+    m->maxSize = 0;
+    m->emptyIndex = -1;
+
+    /* Assign columns to the bytes used in the strings.  Column 0 is
+       for the other bytes. */
+    memset(m->classes, 0, sizeof(m->classes));
+    int k = 1;
+    for (int i=0; i<n; i++) {
+        ScmObj x = SCM_VECTOR_ELEMENT(vec, i);
+        if (!SCM_STRINGP(x)) Scm_Error("string required, but got %S", x);
+        const ScmStringBody *b = SCM_STRING_BODY(x);
+        const unsigned char *p =
+            (const unsigned char*)SCM_STRING_BODY_START(b);
+        int siz = SCM_STRING_BODY_SIZE(b);
+        for (int j=0; j<siz; j++) {
+            if (m->classes[p[j]] == 0) m->classes[p[j]] = k++;
+        }
+        if (siz == 0 && m->emptyIndex < 0) m->emptyIndex = i;
+        if (siz > m->maxSize) m->maxSize = siz;
+        total += siz;
+    }
+    m->numClasses = k;
+    if ((total+1)*k > SCM_SMALL_INT_MAX/(ScmSmallInt)sizeof(int)) {
+        Scm_Error("too many strings for a string matcher: %S", strings);
+    }
+
+    /* Build the trie.  Zero in delta means no edge at this stage, since
+       no edge goes back to the root in a trie. */
+    int *delta = SCM_NEW_ATOMIC_ARRAY(int, (total+1)*k);
+    int *output = SCM_NEW_ATOMIC_ARRAY(int, total+1);
+    memset(delta, 0, sizeof(int)*(total+1)*k);
+    output[0] = -1;
+    int nstates = 1;
+    for (int i=0; i<n; i++) {
+        const ScmStringBody *b = SCM_STRING_BODY(SCM_VECTOR_ELEMENT(vec, i));
+        const unsigned char *p =
+            (const unsigned char*)SCM_STRING_BODY_START(b);
+        int siz = SCM_STRING_BODY_SIZE(b);
+        if (siz == 0) continue;
+        int s = 0;
+        for (int j=0; j<siz; j++) {
+            int *e = &delta[s*k + m->classes[p[j]]];
+            if (*e == 0) {
+                output[nstates] = -1;
+                *e = nstates++;
+            }
+            s = *e;
+        }
+        if (output[s] < 0) output[s] = i; /* the first duplicate wins */
+    }
+
+    /* Fill in the failure transitions in breadth-first order.  A state
+       whose own output is empty inherits the output of its failure
+       state, which is the longest proper suffix. */
+    int *fail = SCM_NEW_ATOMIC_ARRAY(int, nstates);
+    int *queue = SCM_NEW_ATOMIC_ARRAY(int, nstates);
+    int qhead = 0, qtail = 0;
+    fail[0] = 0;
+    for (int c=1; c<k; c++) {
+        int t = delta[c];
+        if (t) { fail[t] = 0; queue[qtail++] = t; }
+    }
+    while (qhead < qtail) {
+        int s = queue[qhead++];
+        if (output[s] < 0) output[s] = output[fail[s]];
+        for (int c=1; c<k; c++) {
+            int t = delta[s*k + c];
+            if (t) {
+                fail[t] = delta[fail[s]*k + c];
+                queue[qtail++] = t;
+            } else {
+                delta[s*k + c] = delta[fail[s]*k + c];
+            }
+        }
+    }
+    m->delta = delta;
+    m->output = output;
+    return SCM_OBJ(m);
+}
+
+/* Scan STR with M.  Returns the index of the leftmost match and the
+   matched string; if more than one string match there, the longest
+   one is taken.  Returns #f and #f if nothing matches.
+   The index is a byte index if STR or the matched string is
+   incomplete, or a character index otherwise. */
+ScmObj Scm_StringMatcherScan(ScmStringMatcher *m, ScmString *str)
+{
+    const ScmStringBody *sb = SCM_STRING_BODY(str);
+    const unsigned char *s = (const unsigned char*)SCM_STRING_BODY_START(sb);
+    ScmSmallInt siz = SCM_STRING_BODY_SIZE(sb);
+    ScmSmallInt len = SCM_STRING_BODY_LENGTH(sb);
+    int incomplete = SCM_STRING_BODY_INCOMPLETE_P(sb);
+    ScmObj vec = m->strings;
+    ScmSmallInt start = -1;     /* byte index of the best match */
+    int found = -1;             /* its string index */
+
+#define NEEDLE_SIZE(i) \
+    SCM_STRING_BODY_SIZE(SCM_STRING_BODY(SCM_VECTOR_ELEMENT(vec, (i))))
+
+    if (m->emptyIndex >= 0) {
+        start = 0;
+        found = m->emptyIndex;
+    }
+
+#if MULTIBYTE_NAIVE_SEARCH_NEEDED
+    if (!incomplete && siz != len) {
+        const char *sp = (const char*)s;
+        int bestsize = (found >= 0)? 0 : -1;
+        for (ScmSmallInt ci=0; ci<len; ci++) {
+            ScmSmallInt rest = siz - (sp - (const char*)s);
+            for (int i=0; i<SCM_VECTOR_SIZE(vec); i++) {
+                const ScmStringBody *nb =
+                    SCM_STRING_BODY(SCM_VECTOR_ELEMENT(vec, i));
+                int nsiz = SCM_STRING_BODY_SIZE(nb);
+                if (nsiz > bestsize && nsiz <= rest
+                    && memcmp(sp, SCM_STRING_BODY_START(nb), nsiz) == 0) {
+                    bestsize = nsiz;
+                    found = i;
+                }
+            }
+            if (found >= 0) {
+                start = sp - (const char*)s;
+                break;
+            }
+            sp += SCM_CHAR_NFOLLOWS(*sp) + 1;
+        }
+        goto done;
+    }
+#endif /*MULTIBYTE_NAIVE_SEARCH_NEEDED*/
+
+    int state = 0;
+    int k = m->numClasses;
+    for (ScmSmallInt i=0; i<siz; i++) {
+        /* No match found later can start before the current best. */
+        if (found >= 0 && i - m->maxSize + 1 > start) break;
+        state = m->delta[state*k + m->classes[s[i]]];
+        int o = m->output[state];
+        if (o >= 0) {
+            ScmSmallInt st = i - NEEDLE_SIZE(o) + 1;
+            if (found < 0 || st < start
+                || (st == start && NEEDLE_SIZE(o) > NEEDLE_SIZE(found))) {
+                start = st;
+                found = o;
+            }
+        }
+    }
+#if MULTIBYTE_NAIVE_SEARCH_NEEDED
+  done:
+#endif
+    if (found < 0) return Scm_Values2(SCM_FALSE, SCM_FALSE);
+
+    ScmObj needle = SCM_VECTOR_ELEMENT(vec, found);
+    ScmSmallInt index = start;
+    if (!incomplete && siz != len
+        && !SCM_STRING_BODY_INCOMPLETE_P(SCM_STRING_BODY(needle))) {
+        index = count_length((const char*)s, start);
+    }
+    return Scm_Values2(Scm_MakeInteger(index), needle);
+#undef NEEDLE_SIZE
+}
+
 #undef NOT_FOUND
 #undef FOUND_BOTH_INDEX
 #undef FOUND_BYTE_INDEX
@@ -1427,12 +1995,12 @@ ScmObj Scm_MakeStringPointer(ScmString *src, ScmSmallInt index,
         ptr = sptr + index;
         effective_size = end - start;
     } else {
-        sptr = forward_pos(SCM_STRING_BODY_START(srcb), start);
-        ptr = forward_pos(sptr, index);
+        sptr = body_pos(srcb, start);
+        ptr = body_pos(srcb, start + index);
         if (end == len) {
             eptr = SCM_STRING_BODY_START(srcb) + SCM_STRING_BODY_SIZE(srcb);
         } else {
-            eptr = forward_pos(sptr, end - start);
+            eptr = body_pos(srcb, end);
         }
         effective_size = (int)(eptr - ptr);
     }
@@ -1569,8 +2137,14 @@ void Scm_StringPointerDump(ScmStringPointer *sp1)
 /* I used to use realloc() to grow the storage; now I avoid it, for
    Boehm GC's realloc almost always copies the original content and
    we don't get any benefit.
-   The growing string is kept in the chained chunks.  The size of
-   chunk getting bigger as the string grows, until a certain threshold.
+   While the string is small (up to DSTRING_CONTIGUOUS_LIMIT bytes), we
+   keep it in a single chunk, doubling it when it fills.  The copying is
+   no more than we'd do to concatenate chunks in the end, and the content
+   can be retrieved without concatenation; Scm_DStringTake can even hand
+   the chunk itself to the resulting string.
+   Beyond that, the growing string is kept in the chained chunks.  The
+   size of chunk getting bigger as the string grows, until a certain
+   threshold.
    The memory for actual chunks and the chain is allocated separately,
    in order to use SCM_NEW_ATOMIC.
  */
@@ -1580,8 +2154,11 @@ void Scm_StringPointerDump(ScmStringPointer *sp1)
  * mutex code in other parts relies on that fact.
  */
 
-/* maximum chunk size */
-#define DSTRING_MAX_CHUNK_SIZE  8180
+/* the content up to this size is kept in one chunk */
+#define DSTRING_CONTIGUOUS_LIMIT  (256*1024)
+
+/* maximum size of chained chunks */
+#define DSTRING_MAX_CHUNK_SIZE    (1024*1024)
 
 void Scm_DStringInit(ScmDString *dstr)
 {
@@ -1611,8 +2188,55 @@ int Scm_DStringSize(ScmDString *dstr)
     return (int)size;
 }
 
+static ScmDStringChunk *new_chunk(ScmSmallInt size)
+{
+    ScmDStringChunk *chunk = SCM_NEW_ATOMIC2(
+        ScmDStringChunk*,
+        sizeof(ScmDStringChunk)+size-SCM_DSTRING_INIT_CHUNK_SIZE);
+    chunk->bytes = 0;
+    return chunk;
+}
+
+/* Returns the chunk that holds the whole content, or NULL if the content
+   is in the initial chunk or spans multiple chunks. */
+static ScmDStringChunk *single_chunk(ScmDString *dstr)
+{
+    if (dstr->anchor != NULL && dstr->anchor == dstr->tail
+        && dstr->init.bytes == 0) {
+        return dstr->anchor->chunk;
+    }
+    return NULL;
+}
+
 void Scm__DStringRealloc(ScmDString *dstr, int minincr)
 {
+    /* while the content is small, move it to a bigger single chunk. */
+    if (dstr->anchor == NULL || single_chunk(dstr)) {
+        const char *data = (dstr->anchor
+                            ? dstr->anchor->chunk->data
+                            : dstr->init.data);
+        ScmSmallInt used = dstr->current - data;
+        if (used + minincr <= DSTRING_CONTIGUOUS_LIMIT) {
+            ScmSmallInt newsize = dstr->lastChunkSize * 2;
+            if (newsize < used + minincr) newsize = used + minincr;
+            ScmDStringChunk *newchunk = new_chunk(newsize);
+            memcpy(newchunk->data, data, used);
+            if (dstr->anchor) {
+                dstr->anchor->chunk = newchunk;
+            } else {
+                ScmDStringChain *newchain = SCM_NEW(ScmDStringChain);
+                newchain->next = NULL;
+                newchain->chunk = newchunk;
+                dstr->anchor = dstr->tail = newchain;
+                dstr->init.bytes = 0;
+            }
+            dstr->current = newchunk->data + used;
+            dstr->end = newchunk->data + newsize;
+            dstr->lastChunkSize = (int)newsize;
+            return;
+        }
+    }
+
     /* sets the byte count of the last chunk */
     if (dstr->tail) {
         dstr->tail->chunk->bytes = (int)(dstr->current - dstr->tail->chunk->data);
@@ -1620,9 +2244,8 @@ void Scm__DStringRealloc(ScmDString *dstr, int minincr)
         dstr->init.bytes = (int)(dstr->current - dstr->init.data);
     }
 
-    /* determine the size of the new chunk.  the increase factor 3 is
-       somewhat arbitrary, determined by rudimental benchmarking. */
-    ScmSmallInt newsize = dstr->lastChunkSize * 3;
+    /* determine the size of the new chunk. */
+    ScmSmallInt newsize = dstr->lastChunkSize * 2;
     if (newsize > DSTRING_MAX_CHUNK_SIZE) {
         newsize = DSTRING_MAX_CHUNK_SIZE;
     }
@@ -1630,11 +2253,7 @@ void Scm__DStringRealloc(ScmDString *dstr, int minincr)
         newsize = minincr;
     }
 
-    ScmDStringChunk *newchunk = SCM_NEW_ATOMIC2(
-        ScmDStringChunk*,
-        sizeof(ScmDStringChunk)+newsize-SCM_DSTRING_INIT_CHUNK_SIZE);
-    newchunk->bytes = 0;
-
+    ScmDStringChunk *newchunk = new_chunk(newsize);
     ScmDStringChain *newchain = SCM_NEW(ScmDStringChain);
 
     newchain->next = NULL;
@@ -1647,7 +2266,7 @@ void Scm__DStringRealloc(ScmDString *dstr, int minincr)
     }
     dstr->current = newchunk->data;
     dstr->end = newchunk->data + newsize;
-    dstr->lastChunkSize = newsize;
+    dstr->lastChunkSize = (int)newsize;
 }
 
 /* Retrieve accumulated string. */
@@ -1655,15 +2274,17 @@ static const char *dstring_getz(ScmDString *dstr, int *psiz, int *plen, int noal
 {
     ScmSmallInt size, len;
     char *buf;
-    if (dstr->anchor == NULL) {
+    ScmDStringChunk *chunk = single_chunk(dstr);
+    if (dstr->anchor == NULL || chunk) {
         /* we only have one chunk */
-        size = dstr->current - dstr->init.data;
+        char *data = chunk ? chunk->data : dstr->init.data;
+        size = dstr->current - data;
         CHECK_SIZE(size);
         len = dstr->length;
         if (noalloc) {
-            buf = dstr->init.data;
+            buf = data;
         } else {
-            buf = SCM_STRDUP_PARTIAL(dstr->init.data, size);
+            buf = SCM_STRDUP_PARTIAL(data, size);
         }
     } else {
         ScmDStringChain *chain = dstr->anchor;
@@ -1672,7 +2293,8 @@ static const char *dstring_getz(ScmDString *dstr, int *psiz, int *plen, int noal
         size = Scm_DStringSize(dstr);
         CHECK_SIZE(size);
         len = dstr->length;
-        bptr = buf = SCM_NEW_ATOMIC2(char*, size+1);
+        bptr = buf = (char*)SCM_MALLOC_ATOMIC_KIND(size+1,
+                                                   SCM_ALLOC_STRING);
 
         memcpy(bptr, dstr->init.data, dstr->init.bytes);
         bptr += dstr->init.bytes;
@@ -1695,6 +2317,28 @@ ScmObj Scm_DStringGet(ScmDString *dstr, int flags)
     return SCM_OBJ(make_str(len, size, str, flags|SCM_STRING_TERMINATED));
 }
 
+/* Like Scm_DStringGet, but if the content is in a single chunk, the
+   returned string shares it instead of copying.  The DString keeps its
+   content, but the shared part is never overwritten; the next write
+   moves the content to a new chunk.  Useful when the DString is likely
+   to be discarded right after. */
+ScmObj Scm_DStringTake(ScmDString *dstr, int flags)
+{
+    ScmDStringChunk *chunk = single_chunk(dstr);
+    if (chunk == NULL) return Scm_DStringGet(dstr, flags);
+
+    ScmSmallInt size = dstr->current - chunk->data;
+    CHECK_SIZE(size);
+    ScmSmallInt len = dstr->length;
+    if (len < 0) len = count_length(chunk->data, size);
+    if (dstr->current < dstr->end) {
+        *dstr->current = '\0';
+        flags |= SCM_STRING_TERMINATED;
+    }
+    dstr->end = dstr->current;  /* freeze */
+    return SCM_OBJ(make_str(len, size, chunk->data, flags));
+}
+
 /* For conveninence.   Note that dstr may already contain NUL byte in it,
    in that case you'll get chopped string. */
 const char *Scm_DStringGetz(ScmDString *dstr)
@@ -1780,3 +2424,31 @@ void Scm_DStringDump(FILE *out, ScmDString *dstr)
         fprintf(out, "\"\n");
     }
 }
+
+/*==================================================================
+ *
+ * String builder
+ *
+ */
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_StringBuilderClass, NULL);
+
+ScmObj Scm_MakeStringBuilder(void)
+{
+    ScmStringBuilder *sb = SCM_NEW(ScmStringBuilder);
+    SCM_SET_CLASS(sb, SCM_CLASS_STRING_BUILDER);
+    Scm_DStringInit(&sb->ds);
+    return SCM_OBJ(sb);
+}
+
+/* OBJ must be a string or a character. */
+void Scm_StringBuilderAdd(ScmStringBuilder *sb, ScmObj obj)
+{
+    if (SCM_STRINGP(obj)) {
+        Scm_DStringAdd(&sb->ds, SCM_STRING(obj));
+    } else if (SCM_CHARP(obj)) {
+        SCM_DSTRING_PUTC(&sb->ds, SCM_CHAR_VALUE(obj));
+    } else {
+        Scm_Error("string or character required, but got %S", obj);
+    }
+}
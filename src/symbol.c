@@ -32,6 +32,7 @@
  */
 
 #define LIBGAUCHE_BODY
+#include "atomic_ops.h"
 #include "gauche.h"
 #include "gauche/priv/builtin-syms.h"
 #include "gauche/priv/moduleP.h"
@@ -55,9 +56,147 @@ static ScmClass *keyword_cpl[] = {
 SCM_DEFINE_BUILTIN_CLASS(Scm_KeywordClass, symbol_print, symbol_compare,
                          NULL, NULL, keyword_cpl);
 
-/* name -> symbol mapper */
+/* name -> symbol mapper
+ *
+ * Interning happens frequently from multiple threads (e.g. the reader),
+ * so we don't use ScmHashTable with a global lock.  The obtable is
+ * a chained hash table whose lookup needs no lock.  Each bucket is a
+ * list of immutable nodes; a new node is pushed to the head of the
+ * bucket by compare-and-swap.  If two threads try to intern the same
+ * name simultaneously, the loser of CAS rescans the bucket and finds
+ * the winner's symbol.
+ *
+ * When the table gets crowded, a thread grabs obtable_mutex and
+ * grows the table.  It builds the new buckets from each old bucket,
+ * then replaces the old bucket with OBTABLE_FORWARD by CAS (redoing it
+ * if the bucket was changed in the meantime).  A thread that sees
+ * OBTABLE_FORWARD follows t->next to the new table.  Since the new
+ * buckets corresponding to an old bucket are complete before the old
+ * one is forwarded, no symbol is lost or duplicated.
+ */
+typedef struct obnode_rec {
+    struct obnode_rec *next;
+    u_long hashval;
+    ScmSymbol *sym;
+} obnode;
+
+typedef struct obtable_rec {
+    u_long size;                /* # of buckets; power of 2 */
+    struct obtable_rec *next;   /* new table, set when we're growing */
+    volatile AO_t buckets[1];   /* obnode*; variable length */
+} obtable_t;
+
+static obnode obtable_forward_marker;
+#define OBTABLE_FORWARD  (&obtable_forward_marker)
+#define OBTABLE_INITIAL_SIZE  4096
+
+static volatile AO_t obtable = 0;           /* obtable_t* */
+static volatile AO_t obtable_count = 0;     /* # of interned symbols */
 static ScmInternalMutex obtable_mutex = SCM_INTERNAL_MUTEX_INITIALIZER;
-static ScmHashTable *obtable = NULL;
+
+/* FNV-1a */
+static inline u_long obtable_hash(const char *s, ScmSmallInt size)
+{
+    u_long h = 2166136261UL;
+    for (ScmSmallInt i=0; i<size; i++) {
+        h = (h ^ (unsigned char)s[i]) * 16777619UL;
+    }
+    return h;
+}
+
+static inline int obnode_match(obnode *n, u_long h,
+                               const char *s, ScmSmallInt size)
+{
+    if (n->hashval != h) return FALSE;
+    const ScmStringBody *b = SCM_STRING_BODY(n->sym->name);
+    return (SCM_STRING_BODY_SIZE(b) == size
+            && memcmp(SCM_STRING_BODY_START(b), s, size) == 0);
+}
+
+static obtable_t *make_obtable(u_long size)
+{
+    obtable_t *t = SCM_NEW2(obtable_t*,
+                            sizeof(obtable_t) + (size-1)*sizeof(AO_t));
+    t->size = size;
+    t->next = NULL;
+    for (u_long i=0; i<size; i++) t->buckets[i] = 0;
+    return t;
+}
+
+/* Returns interned symbol of the name, or NULL. */
+static ScmSymbol *obtable_lookup(const char *s, ScmSmallInt size, u_long h)
+{
+    obtable_t *t = (obtable_t*)AO_load_acquire(&obtable);
+    for (;;) {
+        obnode *n = (obnode*)AO_load_acquire(&t->buckets[h & (t->size-1)]);
+        if (n == OBTABLE_FORWARD) { t = t->next; continue; }
+        for (; n; n = n->next) {
+            if (obnode_match(n, h, s, size)) return n->sym;
+        }
+        return NULL;
+    }
+}
+
+static void obtable_grow(void)
+{
+    SCM_INTERNAL_MUTEX_LOCK(obtable_mutex);
+    obtable_t *t = (obtable_t*)AO_load_acquire(&obtable);
+    if (AO_load(&obtable_count) > t->size * 2) {
+        u_long n = t->size;
+        obtable_t *t2 = make_obtable(n*2);
+        t->next = t2;
+        AO_nop_full();
+        for (u_long i=0; i<n; i++) {
+            for (;;) {
+                AO_t head = AO_load_acquire(&t->buckets[i]);
+                obnode *lo = NULL, *hi = NULL;
+                for (obnode *p = (obnode*)head; p; p = p->next) {
+                    obnode *c = SCM_NEW(obnode);
+                    c->hashval = p->hashval;
+                    c->sym = p->sym;
+                    if (p->hashval & n) { c->next = hi; hi = c; }
+                    else                { c->next = lo; lo = c; }
+                }
+                t2->buckets[i] = (AO_t)lo;
+                t2->buckets[i+n] = (AO_t)hi;
+                if (AO_compare_and_swap_full(&t->buckets[i], head,
+                                             (AO_t)OBTABLE_FORWARD)) {
+                    break;
+                }
+            }
+        }
+        AO_store_release(&obtable, (AO_t)t2);
+    }
+    SCM_INTERNAL_MUTEX_UNLOCK(obtable_mutex);
+}
+
+/* Registers SYM.  If a symbol of the same name is already there,
+   returns it instead. */
+static ScmSymbol *obtable_insert(ScmSymbol *sym)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(sym->name);
+    const char *s = SCM_STRING_BODY_START(b);
+    ScmSmallInt size = SCM_STRING_BODY_SIZE(b);
+    u_long h = obtable_hash(s, size);
+
+    obnode *node = SCM_NEW(obnode);
+    node->hashval = h;
+    node->sym = sym;
+
+    obtable_t *t = (obtable_t*)AO_load_acquire(&obtable);
+    for (;;) {
+        volatile AO_t *bucket = &t->buckets[h & (t->size-1)];
+        AO_t head = AO_load_acquire(bucket);
+        if ((obnode*)head == OBTABLE_FORWARD) { t = t->next; continue; }
+        for (obnode *n = (obnode*)head; n; n = n->next) {
+            if (obnode_match(n, h, s, size)) return n->sym;
+        }
+        node->next = (obnode*)head;
+        if (AO_compare_and_swap_full(bucket, head, (AO_t)node)) break;
+    }
+    if (AO_fetch_and_add1(&obtable_count) >= t->size * 2) obtable_grow();
+    return sym;
+}
 
 #if GAUCHE_KEEP_DISJOINT_KEYWORD_OPTION
 /* Global keyword table. */
@@ -74,10 +213,11 @@ static ScmSymbol *make_sym(ScmClass *klass, ScmString *name, int interned)
 {
     if (interned) {
         /* fast path */
-        SCM_INTERNAL_MUTEX_LOCK(obtable_mutex);
-        ScmObj e = Scm_HashTableRef(obtable, SCM_OBJ(name), SCM_FALSE);
-        SCM_INTERNAL_MUTEX_UNLOCK(obtable_mutex);
-        if (!SCM_FALSEP(e)) return SCM_SYMBOL(e);
+        const ScmStringBody *b = SCM_STRING_BODY(name);
+        const char *s = SCM_STRING_BODY_START(b);
+        ScmSmallInt size = SCM_STRING_BODY_SIZE(b);
+        ScmSymbol *e = obtable_lookup(s, size, obtable_hash(s, size));
+        if (e != NULL) return e;
     }
 
     ScmSymbol *sym = SCM_NEW(ScmSymbol);
@@ -88,25 +228,41 @@ static ScmSymbol *make_sym(ScmClass *klass, ScmString *name, int interned)
     if (!interned) {
         return sym;
     } else {
-        /* Using SCM_DICT_NO_OVERWRITE ensures that if another thread interns
-           the same name symbol between above HashTableRef and here, we'll
-           get the already interned symbol. */
-        SCM_INTERNAL_MUTEX_LOCK(obtable_mutex);
-        ScmObj e = Scm_HashTableSet(obtable, SCM_OBJ(name), SCM_OBJ(sym),
-                                    SCM_DICT_NO_OVERWRITE);
-        SCM_INTERNAL_MUTEX_UNLOCK(obtable_mutex);
-        return SCM_SYMBOL(e);
+        /* If another thread interns the same name symbol between
+           above lookup and here, we'll get the already interned symbol. */
+        return obtable_insert(sym);
     }
 }
 
 /* Intern */
 ScmObj Scm_MakeSymbol(ScmString *name, int interned)
 {
+    if (interned) {
+        /* Avoid copying the name if the symbol already exists. */
+        const ScmStringBody *b = SCM_STRING_BODY(name);
+        const char *s = SCM_STRING_BODY_START(b);
+        ScmSmallInt size = SCM_STRING_BODY_SIZE(b);
+        ScmSymbol *e = obtable_lookup(s, size, obtable_hash(s, size));
+        if (e != NULL) return SCM_OBJ(e);
+    }
     ScmObj sname = Scm_CopyStringWithFlags(name, SCM_STRING_IMMUTABLE,
                                            SCM_STRING_IMMUTABLE);
     return SCM_OBJ(make_sym(SCM_CLASS_SYMBOL, SCM_STRING(sname), interned));
 }
 
+/* Intern a symbol whose name is given as a C string of SIZE bytes
+   (if SIZE < 0, STR must be NUL-terminated).  If the symbol already
+   exists, no Scheme string is allocated. */
+ScmObj Scm_InternCString(const char *str, ScmSmallInt size)
+{
+    if (size < 0) size = (ScmSmallInt)strlen(str);
+    ScmSymbol *e = obtable_lookup(str, size, obtable_hash(str, size));
+    if (e != NULL) return SCM_OBJ(e);
+    ScmObj sname = Scm_MakeString(str, size, -1,
+                                  SCM_STRING_IMMUTABLE|SCM_STRING_COPYING);
+    return SCM_OBJ(make_sym(SCM_CLASS_SYMBOL, SCM_STRING(sname), TRUE));
+}
+
 /* Keyword prefix. */
 static SCM_DEFINE_STRING_CONST(keyword_prefix, ":", 1, 1);
 
@@ -421,7 +577,7 @@ ScmObj Scm_DeleteKeywordX(ScmObj key, ScmObj list)
 void Scm__InitSymbol(void)
 {
     SCM_INTERNAL_MUTEX_INIT(obtable_mutex);
-    obtable = SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_STRING, 4096));
+    obtable = (AO_t)make_obtable(OBTABLE_INITIAL_SIZE);
     init_builtin_syms();
 #if GAUCHE_KEEP_DISJOINT_KEYWORD_OPTION
     (void)SCM_INTERNAL_MUTEX_INIT(keywords.mutex);
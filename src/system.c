@@ -31,6 +31,9 @@
  *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/* posix_spawn_file_actions_addchdir_np etc. on glibc need this. */
+#define _GNU_SOURCE
+
 #define LIBGAUCHE_BODY
 #include "gauche.h"
 #include "gauche/class.h"
@@ -84,6 +87,17 @@ static int win_wait_for_handles(HANDLE *handles, int nhandles, int options,
 #ifdef HAVE_SCHED_H
 #include <sched.h>
 #endif
+#if defined(HAVE_SPAWN_H) && defined(HAVE_POSIX_SPAWNP)
+#include <spawn.h>
+#define USE_POSIX_SPAWN 1
+#endif
+#if defined(GAUCHE_POLLER_EPOLL)
+#include <sys/epoll.h>
+#elif defined(GAUCHE_POLLER_KQUEUE)
+#include <sys/event.h>
+#elif defined(GAUCHE_POLLER_IOCP)
+#include <winternl.h>
+#endif
 
 /*
  * Auxiliary system interface functions.   See syslib.stub for
@@ -1066,6 +1080,38 @@ int Scm_ClockGetResMonotonic(u_long *sec, u_long *nsec)
 }
 
 
+/* CPU time consumed by the calling thread.  Returns FALSE if the system
+   doesn't provide per-thread CPU clock. */
+int Scm_ClockGetTimeThreadCPU(u_long *sec, u_long *nsec)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_THREAD_CPUTIME_ID)
+    ScmTimeSpec ts;
+    int r;
+    SCM_SYSCALL(r, clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts));
+    if (r < 0) Scm_SysError("clock_gettime failed");
+    *sec = (u_long)ts.tv_sec;
+    *nsec = (u_long)ts.tv_nsec;
+    return TRUE;
+#elif defined(GAUCHE_WINDOWS)
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit,
+                        &kernel, &user)) {
+        Scm_SysError("GetThreadTimes failed");
+    }
+    /* FILETIME is in 100ns units */
+    ULONGLONG t = (((ULONGLONG)kernel.dwHighDateTime << 32)
+                   + kernel.dwLowDateTime
+                   + ((ULONGLONG)user.dwHighDateTime << 32)
+                   + user.dwLowDateTime);
+    *sec = (u_long)(t / 10000000);
+    *nsec = (u_long)((t % 10000000) * 100);
+    return TRUE;
+#else  /*!HAVE_CLOCK_GETTIME && !GAUCHE_WINDOWS*/
+    *sec = *nsec = 0;
+    return FALSE;
+#endif /*!HAVE_CLOCK_GETTIME && !GAUCHE_WINDOWS*/
+}
+
 /* Experimental.  This returns the microsecond-resolution time, wrapped
    around the fixnum resolution.  In 32-bit architecture it's a bit more
    than 1000seconds.  Good for micro-profiling, since this guarantees
@@ -1654,6 +1700,117 @@ char *win_create_command_line(ScmObj args)
 }
 #endif /*GAUCHE_WINDOWS*/
 
+/* Spawning a child without fork()
+ *   Forking a process with a large heap is costly, for the kernel has to
+ *   copy its page tables, only to be discarded by exec right away.
+ *   If what we do between fork and exec can be expressed by the file
+ *   actions of posix_spawn, we use it instead; the libc implementation
+ *   typically uses vfork or clone(CLONE_VM), whose cost doesn't depend on
+ *   the size of the parent.
+ *
+ *   FDS is what Scm_SysPrepareFdMap returns, and CDIR is the directory
+ *   to run the program, or NULL.   Returns the pid of the child.  If we
+ *   can't use posix_spawn for the request, or posix_spawn fails, returns
+ *   -1; the caller falls back to fork() then, so that the errors are
+ *   handled in the same way as before.
+ */
+#if defined(USE_POSIX_SPAWN)
+static int spawn_fd_open_p(int fd)
+{
+    int flags = fcntl(fd, F_GETFD);
+    return (flags >= 0 && !(flags & FD_CLOEXEC));
+}
+
+static pid_t sys_spawn(const char *program, char **argv, int *fds,
+                       const char *cdir)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    int nfds = 0, *tofd = NULL, *fromfd = NULL;
+    int *tmpfds = NULL, ntmp = 0;
+    int r = 0;
+    pid_t pid = -1;
+
+#if !defined(HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP)
+    if (cdir != NULL) return -1;
+#endif
+    if (posix_spawn_file_actions_init(&actions) != 0) return -1;
+    if (posix_spawnattr_init(&attr) != 0) {
+        posix_spawn_file_actions_destroy(&actions);
+        return -1;
+    }
+#if defined(POSIX_SPAWN_USEVFORK)
+    r |= posix_spawnattr_setflags(&attr, POSIX_SPAWN_USEVFORK);
+#endif
+#if defined(HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP)
+    if (cdir != NULL) {
+        r |= posix_spawn_file_actions_addchdir_np(&actions, cdir);
+    }
+#endif
+
+    if (fds != NULL) {
+        /* Same as Scm_SysSwapFds, but we shouldn't modify FDS since
+           we may fall back. */
+        nfds = fds[0];
+        tofd = fds + 1;
+        fromfd = SCM_NEW_ATOMIC_ARRAY(int, nfds);
+        tmpfds = SCM_NEW_ATOMIC_ARRAY(int, nfds);
+        memcpy(fromfd, fds + 1 + nfds, nfds * sizeof(int));
+
+        for (int i=0; i<nfds && r == 0; i++) {
+            if (tofd[i] == fromfd[i]) continue;
+            for (int j=i+1; j<nfds; j++) {
+                if (tofd[i] == fromfd[j]) {
+                    /* We dup it in the parent, and the fd is closed in the
+                       child below, for it isn't one of tofd. */
+                    int tmp = dup(tofd[i]);
+                    if (tmp < 0) { r = -1; break; }
+                    tmpfds[ntmp++] = tmp;
+                    fromfd[j] = tmp;
+                }
+            }
+            r |= posix_spawn_file_actions_adddup2(&actions,
+                                                  fromfd[i], tofd[i]);
+        }
+
+        /* Close unused fds.  We only add actions for the fds actually
+           open, for closing a closed fd may be an error. */
+        int maxfd = sysconf(_SC_OPEN_MAX);
+        if (maxfd < 0) r = -1;
+#if defined(HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP)
+        int hi = 0;
+        for (int j=0; j<nfds; j++) if (tofd[j] >= hi) hi = tofd[j] + 1;
+        if (hi < maxfd) maxfd = hi;
+#endif
+        for (int fd=0; fd<maxfd && r == 0; fd++) {
+            int j;
+            for (j=0; j<nfds; j++) if (fd == tofd[j]) break;
+            if (j == nfds && spawn_fd_open_p(fd)) {
+                r |= posix_spawn_file_actions_addclose(&actions, fd);
+            }
+        }
+#if defined(HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP)
+        if (r == 0) r = posix_spawn_file_actions_addclosefrom_np(&actions, hi);
+#endif
+    }
+
+    if (r == 0) {
+#if defined(HAVE_CRT_EXTERNS_H)
+        char **environ = *_NSGetEnviron();  /* OSX Hack*/
+#endif
+        if (posix_spawnp(&pid, program, &actions, &attr,
+                         argv, environ) != 0) {
+            pid = -1;
+        }
+    }
+
+    for (int i=0; i<ntmp; i++) close(tmpfds[i]);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return pid;
+}
+#endif /*USE_POSIX_SPAWN*/
+
 /* Scm_SysExec
  *   execvp(), with optionally setting stdios correctly.
  *
@@ -1671,6 +1828,10 @@ char *win_create_command_line(ScmObj args)
  *   show the children's pid.   If fork arg is FALSE, this procedure
  *   of course never returns.
  *
+ *   On platforms with posix_spawn, fork mode uses it instead of fork()
+ *   when neither sigmask nor detached is requested (and the directory
+ *   change can be done by posix_spawn).  See sys_spawn above.
+ *
  *   On Windows port, this returns a process handle obejct instead of
  *   pid of the child process in fork mode.  We need to keep handle, or
  *   the process exit status will be lost when the child process terminates.
@@ -1706,6 +1867,12 @@ ScmObj Scm_SysExec(ScmString *file, ScmObj args, ScmObj iomap,
 
     /* When requested, call fork() here. */
     if (forkp) {
+#if defined(USE_POSIX_SPAWN)
+        if (!detachp && mask == NULL) {
+            pid = sys_spawn(program, argv, fds, cdir);
+            if (pid > 0) return Scm_MakeInteger(pid);
+        }
+#endif /*USE_POSIX_SPAWN*/
         SCM_SYSCALL(pid, fork());
         if (pid < 0) Scm_SysError("fork failed");
     }
@@ -2305,6 +2472,566 @@ ScmObj Scm_SysSelectX(ScmObj rfds, ScmObj wfds, ScmObj efds, ScmObj timeout)
 
 #endif /* HAVE_SELECT */
 
+/*===============================================================
+ * poller
+ */
+
+#if defined(GAUCHE_POLLER)
+static void poller_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
+{
+#if defined(GAUCHE_POLLER_IOCP)
+    Scm_Printf(port, "#<sys-poller %p>", SCM_SYS_POLLER(obj)->iocp);
+#else
+    Scm_Printf(port, "#<sys-poller %d>", SCM_SYS_POLLER(obj)->fd);
+#endif
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_SysPollerClass, poller_print);
+
+#if defined(GAUCHE_POLLER_IOCP)
+/* On Windows, the poller is built on an I/O completion port.  For each
+   registered socket we issue an asynchronous poll request to the AFD
+   driver (the kernel side of Winsock), which completes to the port
+   when the socket gets ready.  It's not a documented interface, but it
+   has been stable for long and it is how other event libraries get
+   readiness notification on Windows.
+
+   A poll request is one-shot.  After it completes, the registration is
+   put back to the update queue, and the next wait resubmits it; thus
+   the poller is always level-triggered (SCM_SYS_POLL_EDGE is ignored).
+   Changing the events of a registration cancels the request in flight;
+   a deleted registration is kept in the zombie list until the kernel
+   gives back the cancelled request, for it writes into the record.
+
+   A regular file is always ready, as select on Unix regards it.  Other
+   kinds of handles, such as pipes and consoles, can't be polled. */
+
+#define IOCTL_AFD_POLL             0x00012024
+#define AFD_POLL_RECEIVE           0x0001
+#define AFD_POLL_RECEIVE_EXPEDITED 0x0002
+#define AFD_POLL_SEND              0x0004
+#define AFD_POLL_DISCONNECT        0x0008
+#define AFD_POLL_ABORT             0x0010
+#define AFD_POLL_LOCAL_CLOSE       0x0020
+#define AFD_POLL_ACCEPT            0x0080
+#define AFD_POLL_CONNECT_FAIL      0x0100
+
+#ifndef STATUS_CANCELLED
+#define STATUS_CANCELLED ((NTSTATUS)0xC0000120L)
+#endif
+#ifndef NT_SUCCESS
+#define NT_SUCCESS(st)   ((NTSTATUS)(st) >= 0)
+#endif
+#ifndef SIO_BASE_HANDLE
+#define SIO_BASE_HANDLE  0x48000022
+#endif
+
+typedef struct {
+    HANDLE Handle;
+    ULONG Events;
+    NTSTATUS Status;
+} afd_poll_handle_info;
+
+typedef struct {
+    LARGE_INTEGER Timeout;
+    ULONG NumberOfHandles;
+    ULONG Exclusive;
+    afd_poll_handle_info Handles[1];
+} afd_poll_info;
+
+/* Same layout as OVERLAPPED_ENTRY, which older headers lack. */
+typedef struct {
+    ULONG_PTR key;
+    LPOVERLAPPED overlapped;
+    ULONG_PTR internal;
+    DWORD bytes;
+} completion_entry;
+
+typedef struct ScmSysPollerRegRec {
+    IO_STATUS_BLOCK iosb;
+    afd_poll_info info;
+    int fd;
+    SOCKET base;                /* INVALID_SOCKET for a regular file */
+    int events;                 /* SCM_SYS_POLL_* */
+    int pending;                /* a poll request is in flight */
+    int queued;                 /* in the update queue */
+    int deleted;
+    struct ScmSysPollerRegRec *next; /* link in updates or zombies */
+} poll_reg;
+
+static struct {
+    NTSTATUS (NTAPI *createFile)(PHANDLE, ACCESS_MASK, POBJECT_ATTRIBUTES,
+                                 PIO_STATUS_BLOCK, PLARGE_INTEGER, ULONG,
+                                 ULONG, ULONG, ULONG, PVOID, ULONG);
+    NTSTATUS (NTAPI *deviceIoControlFile)(HANDLE, HANDLE, PVOID, PVOID,
+                                          PIO_STATUS_BLOCK, ULONG,
+                                          PVOID, ULONG, PVOID, ULONG);
+    NTSTATUS (NTAPI *cancelIoFileEx)(HANDLE, PIO_STATUS_BLOCK,
+                                     PIO_STATUS_BLOCK);
+    BOOL (WINAPI *getQueuedCompletionStatusEx)(HANDLE, completion_entry*,
+                                               ULONG, PULONG, DWORD, BOOL);
+} afd_api;
+
+static void *get_api_entry(const TCHAR *module, const char *proc,
+                           int throw_error);
+
+/* Racing threads would set the same values; it's harmless. */
+static void afd_api_init(void)
+{
+    if (afd_api.getQueuedCompletionStatusEx != NULL) return;
+    afd_api.createFile =
+        get_api_entry(_T("ntdll.dll"), "NtCreateFile", TRUE);
+    afd_api.deviceIoControlFile =
+        get_api_entry(_T("ntdll.dll"), "NtDeviceIoControlFile", TRUE);
+    afd_api.cancelIoFileEx =
+        get_api_entry(_T("ntdll.dll"), "NtCancelIoFileEx", TRUE);
+    afd_api.getQueuedCompletionStatusEx =
+        get_api_entry(_T("kernel32.dll"), "GetQueuedCompletionStatusEx",
+                      TRUE);
+}
+
+static HANDLE afd_open(HANDLE iocp)
+{
+    static WCHAR path[] = L"\\Device\\Afd\\Gauche";
+    UNICODE_STRING name;
+    OBJECT_ATTRIBUTES attrs;
+    IO_STATUS_BLOCK iosb;
+    HANDLE afd;
+
+    name.Length = sizeof(path) - sizeof(WCHAR);
+    name.MaximumLength = sizeof(path);
+    name.Buffer = path;
+    attrs.Length = sizeof(attrs);
+    attrs.RootDirectory = NULL;
+    attrs.ObjectName = &name;
+    attrs.Attributes = 0;
+    attrs.SecurityDescriptor = NULL;
+    attrs.SecurityQualityOfService = NULL;
+    NTSTATUS st = afd_api.createFile(&afd, SYNCHRONIZE, &attrs, &iosb,
+                                     NULL, 0,
+                                     FILE_SHARE_READ|FILE_SHARE_WRITE,
+                                     FILE_OPEN, 0, NULL, 0);
+    if (st != 0) return NULL;
+    if (CreateIoCompletionPort(afd, iocp, 0, 0) == NULL) {
+        CloseHandle(afd);
+        return NULL;
+    }
+    return afd;
+}
+
+/* Closing the AFD handle cancels all the pending requests.  We keep
+   the registrations, for the kernel may still write into them. */
+static void poller_close_handles(ScmSysPoller *poller)
+{
+    CloseHandle(poller->afd);
+    CloseHandle(poller->iocp);
+    poller->afd = poller->iocp = NULL;
+}
+
+static void poller_finalize(ScmObj obj, void *data)
+{
+    ScmSysPoller *poller = SCM_SYS_POLLER(obj);
+    if (poller->iocp != NULL) poller_close_handles(poller);
+}
+
+ScmObj Scm_MakeSysPoller(void)
+{
+    afd_api_init();
+    HANDLE iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (iocp == NULL) Scm_SysError("CreateIoCompletionPort failed");
+    HANDLE afd = afd_open(iocp);
+    if (afd == NULL) {
+        CloseHandle(iocp);
+        Scm_Error("couldn't open AFD device for the poller");
+    }
+    ScmSysPoller *poller = SCM_NEW(ScmSysPoller);
+    SCM_SET_CLASS(poller, SCM_CLASS_SYS_POLLER);
+    poller->iocp = iocp;
+    poller->afd = afd;
+    Scm_HashCoreInitSimple(&poller->regs, SCM_HASH_WORD, 0, NULL);
+    poller->updates = poller->zombies = NULL;
+    poller->numAlways = 0;
+    Scm_RegisterFinalizer(SCM_OBJ(poller), poller_finalize, NULL);
+    return SCM_OBJ(poller);
+}
+
+static void poller_check(ScmSysPoller *poller)
+{
+    if (poller->iocp == NULL) Scm_Error("poller already closed: %S", poller);
+}
+
+static void enqueue_update(ScmSysPoller *poller, poll_reg *reg)
+{
+    if (!reg->queued) {
+        reg->queued = TRUE;
+        reg->next = poller->updates;
+        poller->updates = reg;
+    }
+}
+
+static void cancel_poll(ScmSysPoller *poller, poll_reg *reg)
+{
+    IO_STATUS_BLOCK iosb;
+    /* If the request has already completed, it returns STATUS_NOT_FOUND
+       and the completion is in the port; either way we'll see it. */
+    (void)afd_api.cancelIoFileEx(poller->afd, &reg->iosb, &iosb);
+}
+
+static void submit_poll(ScmSysPoller *poller, poll_reg *reg)
+{
+    ULONG mask = AFD_POLL_LOCAL_CLOSE;
+    if (reg->events & SCM_SYS_POLL_READ) {
+        mask |= AFD_POLL_RECEIVE|AFD_POLL_ACCEPT
+            |AFD_POLL_DISCONNECT|AFD_POLL_ABORT;
+    }
+    if (reg->events & SCM_SYS_POLL_WRITE) {
+        mask |= AFD_POLL_SEND|AFD_POLL_CONNECT_FAIL;
+    }
+    if (reg->events & SCM_SYS_POLL_EXCEPT) {
+        mask |= AFD_POLL_RECEIVE_EXPEDITED;
+    }
+    reg->info.Timeout.QuadPart = INT64_MAX;
+    reg->info.NumberOfHandles = 1;
+    reg->info.Exclusive = FALSE;
+    reg->info.Handles[0].Handle = (HANDLE)reg->base;
+    reg->info.Handles[0].Events = mask;
+    reg->info.Handles[0].Status = 0;
+    reg->iosb.Status = STATUS_PENDING;
+    /* The reg is passed as the APC context, which we get back as the
+       'overlapped' of the completion entry. */
+    NTSTATUS st = afd_api.deviceIoControlFile(poller->afd, NULL, NULL, reg,
+                                              &reg->iosb, IOCTL_AFD_POLL,
+                                              &reg->info, sizeof(reg->info),
+                                              &reg->info, sizeof(reg->info));
+    if (st != 0 && st != STATUS_PENDING) {
+        Scm_Error("AFD poll failed on fd %d (status 0x%lx)",
+                  reg->fd, (u_long)st);
+    }
+    reg->pending = TRUE;
+}
+
+/* Registers FD to wait for EVENTS, replacing the previous registration.
+   If EVENTS doesn't have any of READ, WRITE or EXCEPT, FD is removed. */
+void Scm_SysPollerSet(ScmSysPoller *poller, int fd, int events)
+{
+    poller_check(poller);
+    events &= (SCM_SYS_POLL_READ|SCM_SYS_POLL_WRITE|SCM_SYS_POLL_EXCEPT);
+    ScmDictEntry *e = Scm_HashCoreSearch(&poller->regs, (intptr_t)fd,
+                                         SCM_DICT_GET);
+    poll_reg *reg = e ? (poll_reg*)e->value : NULL;
+
+    if (events == 0) {
+        if (reg == NULL) return;
+        Scm_HashCoreSearch(&poller->regs, (intptr_t)fd, SCM_DICT_DELETE);
+        reg->deleted = TRUE;
+        if (reg->base == INVALID_SOCKET) {
+            poller->numAlways--;
+        } else if (reg->pending) {
+            cancel_poll(poller, reg);
+            reg->next = poller->zombies;
+            poller->zombies = reg;
+        }
+        /* If it's in the update queue, it's skipped there. */
+        return;
+    }
+
+    if (reg == NULL) {
+        HANDLE h = (HANDLE)_get_osfhandle(fd);
+        if (h == INVALID_HANDLE_VALUE) Scm_SysError("invalid fd: %d", fd);
+        SOCKET base;
+        DWORD bytes;
+        reg = SCM_NEW(poll_reg);
+        reg->fd = fd;
+        if (WSAIoctl((SOCKET)h, SIO_BASE_HANDLE, NULL, 0, &base,
+                     sizeof(base), &bytes, NULL, NULL) == 0) {
+            reg->base = base;
+        } else if (GetFileType(h) == FILE_TYPE_DISK) {
+            reg->base = INVALID_SOCKET;
+            poller->numAlways++;
+        } else {
+            Scm_Error("poller can only wait on sockets and files on "
+                      "Windows, but got fd %d", fd);
+        }
+        e = Scm_HashCoreSearch(&poller->regs, (intptr_t)fd,
+                               SCM_DICT_CREATE);
+        e->value = (intptr_t)reg;
+    }
+    reg->events = events;
+    if (reg->base == INVALID_SOCKET) return;
+    if (reg->pending) {
+        /* The completion puts it back to the update queue. */
+        cancel_poll(poller, reg);
+    } else {
+        enqueue_update(poller, reg);
+    }
+}
+
+static int afd_events(poll_reg *reg)
+{
+    if (!NT_SUCCESS(reg->iosb.Status)) {
+        return SCM_SYS_POLL_READ|SCM_SYS_POLL_WRITE;
+    }
+    if (reg->info.NumberOfHandles < 1) return 0;
+    ULONG m = reg->info.Handles[0].Events;
+    int e = 0;
+    if (m & (AFD_POLL_RECEIVE|AFD_POLL_ACCEPT|AFD_POLL_DISCONNECT)) {
+        e |= SCM_SYS_POLL_READ;
+    }
+    if (m & AFD_POLL_SEND)              e |= SCM_SYS_POLL_WRITE;
+    if (m & AFD_POLL_RECEIVE_EXPEDITED) e |= SCM_SYS_POLL_EXCEPT;
+    if (m & (AFD_POLL_ABORT|AFD_POLL_CONNECT_FAIL)) {
+        e |= SCM_SYS_POLL_READ|SCM_SYS_POLL_WRITE;
+    }
+    return e & (reg->events|SCM_SYS_POLL_READ|SCM_SYS_POLL_WRITE);
+}
+
+/* Waits for events up to TIMEOUT, which is the same as sys-select's.
+   Returns a list of (fd . events) for at most MAXEVENTS fds.  An fd that
+   has an error or is hung up is reported as both readable and writable,
+   as select does. */
+ScmObj Scm_SysPollerWait(ScmSysPoller *poller, ScmObj timeout, int maxevents)
+{
+    struct timeval tv, *tvp = select_timeval(timeout, &tv);
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    int count = 0;
+
+    poller_check(poller);
+    if (maxevents <= 0) Scm_Error("maxevents must be positive: %d", maxevents);
+
+    /* Regular files are ready. */
+    if (poller->numAlways > 0) {
+        ScmHashIter iter;
+        ScmDictEntry *e;
+        Scm_HashIterInit(&iter, &poller->regs);
+        while (count < maxevents && (e = Scm_HashIterNext(&iter)) != NULL) {
+            poll_reg *reg = (poll_reg*)e->value;
+            if (reg->base != INVALID_SOCKET) continue;
+            SCM_APPEND1(h, t, Scm_Cons(SCM_MAKE_INT(reg->fd),
+                                       SCM_MAKE_INT(reg->events)));
+            count++;
+        }
+    }
+
+    /* Resubmit polls. */
+    while (poller->updates) {
+        poll_reg *reg = poller->updates;
+        poller->updates = reg->next;
+        reg->queued = FALSE;
+        if (!reg->deleted) submit_poll(poller, reg);
+    }
+
+    DWORD ms = INFINITE;
+    if (count > 0) {
+        ms = 0;
+    } else if (tvp) {
+        ms = (DWORD)(tvp->tv_sec*1000 + (tvp->tv_usec+999)/1000);
+    }
+    int room = maxevents - count;
+    completion_entry *ents = SCM_NEW_ATOMIC_ARRAY(completion_entry, room);
+    ULONG n = 0;
+    if (room > 0
+        && !afd_api.getQueuedCompletionStatusEx(poller->iocp, ents, room,
+                                                &n, ms, FALSE)) {
+        if (GetLastError() != WAIT_TIMEOUT) {
+            Scm_SysError("GetQueuedCompletionStatusEx failed");
+        }
+        n = 0;
+    }
+    for (ULONG i=0; i<n; i++) {
+        poll_reg *reg = (poll_reg*)ents[i].overlapped;
+        reg->pending = FALSE;
+        if (reg->deleted) {
+            poll_reg **p = &poller->zombies;
+            while (*p && *p != reg) p = &(*p)->next;
+            if (*p) *p = reg->next;
+            continue;
+        }
+        if (reg->iosb.Status == STATUS_CANCELLED) {
+            enqueue_update(poller, reg); /* events have been changed */
+            continue;
+        }
+        if (NT_SUCCESS(reg->iosb.Status)
+            && reg->info.NumberOfHandles >= 1
+            && (reg->info.Handles[0].Events & AFD_POLL_LOCAL_CLOSE)) {
+            /* The socket is closed; drop it as epoll does. */
+            Scm_HashCoreSearch(&poller->regs, (intptr_t)reg->fd,
+                               SCM_DICT_DELETE);
+            reg->deleted = TRUE;
+            continue;
+        }
+        int ev = afd_events(reg);
+        enqueue_update(poller, reg);
+        if (ev) {
+            SCM_APPEND1(h, t, Scm_Cons(SCM_MAKE_INT(reg->fd),
+                                       SCM_MAKE_INT(ev)));
+        }
+    }
+    return h;
+}
+
+void Scm_SysPollerClose(ScmSysPoller *poller)
+{
+    if (poller->iocp != NULL) {
+        Scm_UnregisterFinalizer(SCM_OBJ(poller));
+        poller_close_handles(poller);
+    }
+}
+#else  /*!GAUCHE_POLLER_IOCP*/
+static void poller_finalize(ScmObj obj, void *data)
+{
+    ScmSysPoller *poller = SCM_SYS_POLLER(obj);
+    if (poller->fd >= 0) {
+        close(poller->fd);
+        poller->fd = -1;
+    }
+}
+
+ScmObj Scm_MakeSysPoller(void)
+{
+    int fd;
+#if defined(GAUCHE_POLLER_EPOLL)
+    SCM_SYSCALL(fd, epoll_create1(EPOLL_CLOEXEC));
+    if (fd < 0) Scm_SysError("epoll_create1 failed");
+#else  /*GAUCHE_POLLER_KQUEUE*/
+    SCM_SYSCALL(fd, kqueue());
+    if (fd < 0) Scm_SysError("kqueue failed");
+    (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+    ScmSysPoller *poller = SCM_NEW(ScmSysPoller);
+    SCM_SET_CLASS(poller, SCM_CLASS_SYS_POLLER);
+    poller->fd = fd;
+    Scm_RegisterFinalizer(SCM_OBJ(poller), poller_finalize, NULL);
+    return SCM_OBJ(poller);
+}
+
+static void poller_check(ScmSysPoller *poller)
+{
+    if (poller->fd < 0) Scm_Error("poller already closed: %S", poller);
+}
+
+/* Registers FD to wait for EVENTS, replacing the previous registration.
+   If EVENTS doesn't have any of READ, WRITE or EXCEPT, FD is removed. */
+void Scm_SysPollerSet(ScmSysPoller *poller, int fd, int events)
+{
+    int r;
+    poller_check(poller);
+#if defined(GAUCHE_POLLER_EPOLL)
+    struct epoll_event ev;
+    ev.events = 0;
+    ev.data.fd = fd;
+    if (events & SCM_SYS_POLL_READ)   ev.events |= EPOLLIN;
+    if (events & SCM_SYS_POLL_WRITE)  ev.events |= EPOLLOUT;
+    if (events & SCM_SYS_POLL_EXCEPT) ev.events |= EPOLLPRI;
+    if (ev.events == 0) {
+        SCM_SYSCALL(r, epoll_ctl(poller->fd, EPOLL_CTL_DEL, fd, &ev));
+        /* The kernel drops closed fds by itself. */
+        if (r < 0 && errno != ENOENT && errno != EBADF) {
+            Scm_SysError("epoll_ctl failed on fd %d", fd);
+        }
+        return;
+    }
+    if (events & SCM_SYS_POLL_EDGE) ev.events |= EPOLLET;
+    SCM_SYSCALL(r, epoll_ctl(poller->fd, EPOLL_CTL_MOD, fd, &ev));
+    if (r < 0 && errno == ENOENT) {
+        SCM_SYSCALL(r, epoll_ctl(poller->fd, EPOLL_CTL_ADD, fd, &ev));
+    }
+    if (r < 0) Scm_SysError("epoll_ctl failed on fd %d", fd);
+#else  /*GAUCHE_POLLER_KQUEUE*/
+    static const struct { int flag; short filter; } filters[] = {
+        { SCM_SYS_POLL_READ,  EVFILT_READ },
+        { SCM_SYS_POLL_WRITE, EVFILT_WRITE }
+    };
+    if (events & SCM_SYS_POLL_EXCEPT) {
+        Scm_Error("kqueue poller can't wait for exceptional conditions");
+    }
+    for (int i=0; i<2; i++) {
+        struct kevent ev;
+        if (events & filters[i].flag) {
+            u_short flags = EV_ADD|EV_ENABLE;
+            if (events & SCM_SYS_POLL_EDGE) flags |= EV_CLEAR;
+            EV_SET(&ev, fd, filters[i].filter, flags, 0, 0, NULL);
+        } else {
+            EV_SET(&ev, fd, filters[i].filter, EV_DELETE, 0, 0, NULL);
+        }
+        SCM_SYSCALL(r, kevent(poller->fd, &ev, 1, NULL, 0, NULL));
+        if (r < 0 && !((errno == ENOENT || errno == EBADF)
+                       && !(events & filters[i].flag))) {
+            Scm_SysError("kevent failed on fd %d", fd);
+        }
+    }
+#endif
+}
+
+/* Waits for events up to TIMEOUT, which is the same as sys-select's.
+   Returns a list of (fd . events) for at most MAXEVENTS fds.  The same
+   fd may appear more than once.  An fd that has an error or is hung up
+   is reported as both readable and writable, as select does. */
+ScmObj Scm_SysPollerWait(ScmSysPoller *poller, ScmObj timeout, int maxevents)
+{
+    struct timeval tv, *tvp = select_timeval(timeout, &tv);
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    int n;
+
+    poller_check(poller);
+    if (maxevents <= 0) Scm_Error("maxevents must be positive: %d", maxevents);
+#if defined(GAUCHE_POLLER_EPOLL)
+    struct epoll_event *evs = SCM_NEW_ATOMIC_ARRAY(struct epoll_event,
+                                                   maxevents);
+    int ms = -1;
+    if (tvp) {
+        ms = (int)(tvp->tv_sec*1000 + (tvp->tv_usec+999)/1000);
+    }
+    SCM_SYSCALL(n, epoll_wait(poller->fd, evs, maxevents, ms));
+    if (n < 0) Scm_SysError("epoll_wait failed");
+    for (int i=0; i<n; i++) {
+        int e = 0;
+        if (evs[i].events & EPOLLIN)  e |= SCM_SYS_POLL_READ;
+        if (evs[i].events & EPOLLOUT) e |= SCM_SYS_POLL_WRITE;
+        if (evs[i].events & EPOLLPRI) e |= SCM_SYS_POLL_EXCEPT;
+        if (evs[i].events & (EPOLLERR|EPOLLHUP)) {
+            e |= SCM_SYS_POLL_READ|SCM_SYS_POLL_WRITE;
+        }
+        SCM_APPEND1(h, t, Scm_Cons(SCM_MAKE_INT(evs[i].data.fd),
+                                   SCM_MAKE_INT(e)));
+    }
+#else  /*GAUCHE_POLLER_KQUEUE*/
+    struct kevent *evs = SCM_NEW_ATOMIC_ARRAY(struct kevent, maxevents);
+    struct timespec ts, *tsp = NULL;
+    if (tvp) {
+        ts.tv_sec = tvp->tv_sec;
+        ts.tv_nsec = tvp->tv_usec * 1000;
+        tsp = &ts;
+    }
+    SCM_SYSCALL(n, kevent(poller->fd, NULL, 0, evs, maxevents, tsp));
+    if (n < 0) Scm_SysError("kevent failed");
+    for (int i=0; i<n; i++) {
+        int e = 0;
+        if (evs[i].flags & EV_ERROR) {
+            e = SCM_SYS_POLL_READ|SCM_SYS_POLL_WRITE;
+        } else if (evs[i].filter == EVFILT_READ) {
+            e = SCM_SYS_POLL_READ;
+        } else if (evs[i].filter == EVFILT_WRITE) {
+            e = SCM_SYS_POLL_WRITE;
+        }
+        SCM_APPEND1(h, t, Scm_Cons(SCM_MAKE_INT((int)evs[i].ident),
+                                   SCM_MAKE_INT(e)));
+    }
+#endif
+    return h;
+}
+
+void Scm_SysPollerClose(ScmSysPoller *poller)
+{
+    if (poller->fd >= 0) {
+        int fd = poller->fd;
+        poller->fd = -1;
+        Scm_UnregisterFinalizer(SCM_OBJ(poller));
+        if (close(fd) < 0) Scm_SysError("close failed on %S", poller);
+    }
+}
+#endif /*!GAUCHE_POLLER_IOCP*/
+#endif /*GAUCHE_POLLER*/
+
 /*===============================================================
  * Environment
  */
@@ -3212,6 +3939,9 @@ void Scm__InitSystem(void)
     Scm_InitStaticClass(&Scm_SysPasswdClass, "<sys-passwd>", mod, pwd_slots, 0);
 #ifdef HAVE_SELECT
     Scm_InitStaticClass(&Scm_SysFdsetClass, "<sys-fdset>", mod, NULL, 0);
+#endif
+#ifdef GAUCHE_POLLER
+    Scm_InitStaticClass(&Scm_SysPollerClass, "<sys-poller>", mod, NULL, 0);
 #endif
     SCM_INTERNAL_MUTEX_INIT(env_mutex);
     Scm_HashCoreInitSimple(&env_strings, SCM_HASH_STRING, 0, NULL);
@@ -45,6 +45,7 @@ typedef struct NodeRec {
     intptr_t     key;
     intptr_t     value;
     int          color;
+    int          size;          /* # of nodes in the subtree rooted here */
     struct NodeRec *parent;
     struct NodeRec *left;
     struct NodeRec *right;
@@ -79,6 +80,9 @@ enum TreeOp {
 #define ROOT(tc)         ((Node*)tc->root)
 #define SET_ROOT(tc, n)  (tc->root = (ScmDictEntry*)n)
 
+#define SIZE(n)          ((n)? (n)->size : 0)
+#define FIX_SIZE(n)      (n->size = SIZE(n->left) + SIZE(n->right) + 1)
+
 static Node *core_ref(ScmTreeCore *tc, intptr_t key, enum TreeOp op,
                       Node **lo, Node **hi);
 static Node *rightmost(Node *n);
@@ -88,6 +92,34 @@ static Node *prev_node(Node *n);
 static Node *delete_node(ScmTreeCore *tc, Node *n);
 static Node *copy_tree(Node *parent, Node *self);
 
+static ScmDictEntry *bt_ref(ScmTreeCore *tc, intptr_t key, ScmDictOp op);
+static ScmDictEntry *bt_near(ScmTreeCore *tc, intptr_t key,
+                             ScmDictEntry **lo, ScmDictEntry **hi);
+static ScmDictEntry *bt_bound(ScmTreeCore *tc, ScmTreeCoreBoundOp op,
+                              int pop);
+static ScmDictEntry *bt_iter_step(ScmTreeIter *iter, int backward);
+static void bt_copy_tree(ScmTreeCore *dst, const ScmTreeCore *src);
+static void bt_check_consistency(ScmTreeCore *tc);
+static void bt_dump(ScmTreeCore *tc, ScmPort *out, int scmobj);
+static int  bt_rank(ScmTreeCore *tc, intptr_t key);
+static ScmDictEntry *bt_nth(ScmTreeCore *tc, int i);
+static void bt_split_at(ScmTreeCore *tc, int i, ScmTreeCore *dst);
+static void bt_join(ScmTreeCore *tc, ScmTreeCore *src);
+static void bt_delete_range(ScmTreeCore *tc, int i, int j);
+
+static int  rb_rank(ScmTreeCore *tc, intptr_t key);
+static Node *rb_nth(ScmTreeCore *tc, int i);
+static void rb_split(ScmTreeCore *tc, Node *b, ScmTreeCore *dst);
+static void rb_join(ScmTreeCore *tc, ScmTreeCore *src);
+
+#define BTREEP(tc)       ((tc)->type == SCM_TREE_CORE_BTREE)
+
+static int core_cmp(ScmTreeCore *tc, intptr_t a, intptr_t b)
+{
+    if (tc->cmp) return tc->cmp(tc, a, b);
+    return (a < b)? -1 : ((a > b)? 1 : 0);
+}
+
 /*
  * Public API
  */
@@ -95,16 +127,27 @@ static Node *copy_tree(Node *parent, Node *self);
 void Scm_TreeCoreInit(ScmTreeCore *tc,
                       ScmTreeCoreCompareProc *cmp,
                       void *data)
+{
+    Scm_TreeCoreInitWithType(tc, SCM_TREE_CORE_RBTREE, cmp, data);
+}
+
+void Scm_TreeCoreInitWithType(ScmTreeCore *tc,
+                              ScmTreeCoreType type,
+                              ScmTreeCoreCompareProc *cmp,
+                              void *data)
 {
     tc->root = NULL;
     tc->cmp = cmp;
     tc->num_entries = 0;
     tc->data = data;
+    tc->type = type;
 }
 
 void Scm_TreeCoreCopy(ScmTreeCore *dst, const ScmTreeCore *src)
 {
-    if (ROOT(src)) {
+    if (BTREEP(src)) {
+        bt_copy_tree(dst, src);
+    } else if (ROOT(src)) {
         SET_ROOT(dst, copy_tree(NULL, ROOT(src)));
     } else {
         SET_ROOT(dst, NULL);
@@ -112,6 +155,7 @@ void Scm_TreeCoreCopy(ScmTreeCore *dst, const ScmTreeCore *src)
     dst->cmp = src->cmp;
     dst->num_entries = src->num_entries;
     dst->data = src->data;
+    dst->type = src->type;
 }
 
 void Scm_TreeCoreClear(ScmTreeCore *tc)
@@ -124,6 +168,7 @@ ScmDictEntry *Scm_TreeCoreSearch(ScmTreeCore *tc,
                                  intptr_t key,
                                  ScmDictOp op)
 {
+    if (BTREEP(tc)) return bt_ref(tc, key, op);
     return (ScmDictEntry*)core_ref(tc, key, (enum TreeOp)op, NULL, NULL);
 }
 
@@ -132,6 +177,7 @@ ScmDictEntry *Scm_TreeCoreClosestEntries(ScmTreeCore *tc,
                                          ScmDictEntry **lo,
                                          ScmDictEntry **hi)
 {
+    if (BTREEP(tc)) return bt_near(tc, key, lo, hi);
     Node *l, *h;
     Node *r = core_ref(tc, key, TREE_NEAR, &l, &h);
     *lo = (ScmDictEntry*)l;
@@ -141,6 +187,11 @@ ScmDictEntry *Scm_TreeCoreClosestEntries(ScmTreeCore *tc,
 
 ScmDictEntry *Scm_TreeCoreNextEntry(ScmTreeCore *tc, intptr_t key)
 {
+    if (BTREEP(tc)) {
+        ScmDictEntry *l, *h;
+        bt_near(tc, key, &l, &h);
+        return h;
+    }
     Node *l, *h;
     core_ref(tc, key, TREE_NEAR, &l, &h);
     return (ScmDictEntry*)h;
@@ -148,6 +199,11 @@ ScmDictEntry *Scm_TreeCoreNextEntry(ScmTreeCore *tc, intptr_t key)
 
 ScmDictEntry *Scm_TreeCorePrevEntry(ScmTreeCore *tc, intptr_t key)
 {
+    if (BTREEP(tc)) {
+        ScmDictEntry *l, *h;
+        bt_near(tc, key, &l, &h);
+        return l;
+    }
     Node *l, *h;
     core_ref(tc, key, TREE_NEAR, &l, &h);
     return (ScmDictEntry*)l;
@@ -170,11 +226,13 @@ static Node *core_bound(ScmTreeCore *tc, ScmTreeCoreBoundOp op, int pop)
 
 ScmDictEntry *Scm_TreeCoreGetBound(ScmTreeCore *tc, ScmTreeCoreBoundOp op)
 {
+    if (BTREEP(tc)) return bt_bound(tc, op, FALSE);
     return (ScmDictEntry*)core_bound(tc, op, FALSE);
 }
 
 ScmDictEntry *Scm_TreeCorePopBound(ScmTreeCore *tc, ScmTreeCoreBoundOp op)
 {
+    if (BTREEP(tc)) return bt_bound(tc, op, TRUE);
     return (ScmDictEntry*)core_bound(tc, op, TRUE);
 }
 
@@ -201,6 +259,92 @@ int Scm_TreeCoreEq(ScmTreeCore *a, ScmTreeCore *b)
     }
 }
 
+/* Order statistics.  Both take O(log n). */
+
+/* Returns the number of entries whose key is less than KEY. */
+int Scm_TreeCoreRank(ScmTreeCore *tc, intptr_t key)
+{
+    if (BTREEP(tc)) return bt_rank(tc, key);
+    return rb_rank(tc, key);
+}
+
+/* Returns the N-th (0-based) entry in the key order, or NULL if N is out
+   of range. */
+ScmDictEntry *Scm_TreeCoreNth(ScmTreeCore *tc, int n)
+{
+    if (n < 0 || n >= tc->num_entries) return NULL;
+    if (BTREEP(tc)) return bt_nth(tc, n);
+    return (ScmDictEntry*)rb_nth(tc, n);
+}
+
+/* Moves the entries whose keys are greater than or equal to KEY from TC
+   to DST.  DST is initialized with the same type and comparator as TC.
+   A red-black tree is split in O(log n); a B+-tree takes time
+   proportional to the smaller part. */
+void Scm_TreeCoreSplit(ScmTreeCore *tc, intptr_t key, ScmTreeCore *dst)
+{
+    Scm_TreeCoreInitWithType(dst, tc->type, tc->cmp, tc->data);
+    if (BTREEP(tc)) {
+        bt_split_at(tc, bt_rank(tc, key), dst);
+    } else {
+        Node *l, *h;
+        Node *b = core_ref(tc, key, TREE_NEAR, &l, &h);
+        if (b == NULL) b = h;
+        if (b) rb_split(tc, b, dst);
+    }
+}
+
+/* Moves all the entries of SRC into TC.  Every key in SRC must be
+   greater than the keys in TC.  Takes the same order of time as
+   Scm_TreeCoreSplit. */
+void Scm_TreeCoreJoin(ScmTreeCore *tc, ScmTreeCore *src)
+{
+    if (tc->type != src->type || tc->cmp != src->cmp
+        || tc->data != src->data) {
+        Scm_Error("can't join trees of different types or comparators");
+    }
+    if (tc->num_entries > 0 && src->num_entries > 0) {
+        ScmDictEntry *a = Scm_TreeCoreGetBound(tc, SCM_TREE_CORE_MAX);
+        ScmDictEntry *b = Scm_TreeCoreGetBound(src, SCM_TREE_CORE_MIN);
+        if (core_cmp(tc, a->key, b->key) >= 0) {
+            Scm_Error("can't join trees: the keys of the latter must be "
+                      "greater than the ones of the former");
+        }
+    }
+    if (BTREEP(tc)) bt_join(tc, src);
+    else            rb_join(tc, src);
+}
+
+/* Deletes the entries whose keys are in [LO, HI).  Returns the number
+   of deleted entries.  In a red-black tree it is done by splitting and
+   joining, hence O(log n) regardless of the number of deleted entries. */
+int Scm_TreeCoreDeleteRange(ScmTreeCore *tc, intptr_t lo, intptr_t hi)
+{
+    if (core_cmp(tc, lo, hi) >= 0) return 0;
+    if (BTREEP(tc)) {
+        int i = bt_rank(tc, lo), j = bt_rank(tc, hi);
+        bt_delete_range(tc, i, j);
+        return j - i;
+    } else {
+        Node *l, *h;
+        Node *b1 = core_ref(tc, lo, TREE_NEAR, &l, &h);
+        if (b1 == NULL) b1 = h;
+        Node *b2 = core_ref(tc, hi, TREE_NEAR, &l, &h);
+        if (b2 == NULL) b2 = h;
+        if (b1 == NULL || b1 == b2) return 0;
+
+        ScmTreeCore mid, rest;
+        Scm_TreeCoreInitWithType(&rest, tc->type, tc->cmp, tc->data);
+        Scm_TreeCoreInitWithType(&mid, tc->type, tc->cmp, tc->data);
+        rb_split(tc, b1, &mid);
+        if (b2) {
+            rb_split(&mid, b2, &rest);
+            rb_join(tc, &rest);
+        }
+        return mid.num_entries;
+    }
+}
+
 /* START can be NULL; in which case, if next call is TreeIterNext,
    it iterates from the minimum node; if next call is TreeIterPrev,
    it iterates from the maximum node. */
@@ -214,12 +358,16 @@ void Scm_TreeIterInit(ScmTreeIter *iter,
     iter->t = tc;
     iter->e = start;
     iter->at_end = FALSE;
+    iter->leaf = NULL;
+    iter->index = 0;
 }
 
 ScmDictEntry *Scm_TreeIterNext(ScmTreeIter *iter)
 {
     if (iter->at_end) return NULL;
-    if (iter->e) {
+    if (BTREEP(iter->t)) {
+        iter->e = bt_iter_step(iter, FALSE);
+    } else if (iter->e) {
         iter->e = (ScmDictEntry*)next_node((Node*)iter->e);
     } else {
         iter->e = Scm_TreeCoreGetBound(iter->t, SCM_TREE_CORE_MIN);
@@ -231,7 +379,9 @@ ScmDictEntry *Scm_TreeIterNext(ScmTreeIter *iter)
 ScmDictEntry *Scm_TreeIterPrev(ScmTreeIter *iter)
 {
     if (iter->at_end) return NULL;
-    if (iter->e) {
+    if (BTREEP(iter->t)) {
+        iter->e = bt_iter_step(iter, TRUE);
+    } else if (iter->e) {
         iter->e = (ScmDictEntry*)prev_node((Node*)iter->e);
     } else {
         iter->e = Scm_TreeCoreGetBound(iter->t, SCM_TREE_CORE_MAX);
@@ -280,11 +430,19 @@ static int check_traverse(Node *node, int depth, int *count)
     if (ld != rd) {
         Scm_Error("[internal] tree map has different black-node depth (L:%d vs R:%d)", ld, rd);
     }
+    if (node->size != SIZE(node->left) + SIZE(node->right) + 1) {
+        Scm_Error("[internal] tree map has wrong subtree size (%d)", node->size);
+    }
     return ld;
 }
 
 void Scm_TreeCoreCheckConsistency(ScmTreeCore *tc)
 {
+    if (BTREEP(tc)) {
+        bt_check_consistency(tc);
+        return;
+    }
+
     Node *r = ROOT(tc);
     int cnt = 0;
 
@@ -314,11 +472,17 @@ SCM_DEFINE_BUILTIN_CLASS(Scm_TreeMapClass, treemap_print, NULL, NULL, NULL,
  */
 
 ScmObj Scm_MakeTreeMap(ScmTreeCoreCompareProc *cmp, void *data)
+{
+    return Scm_MakeTreeMapWithType(SCM_TREE_CORE_RBTREE, cmp, data);
+}
+
+ScmObj Scm_MakeTreeMapWithType(ScmTreeCoreType type,
+                               ScmTreeCoreCompareProc *cmp, void *data)
 {
     ScmTreeMap *tm = SCM_NEW(ScmTreeMap);
     SCM_SET_CLASS(tm, SCM_CLASS_TREE_MAP);
     /* TODO: default cmp should be different from TreeCore */
-    Scm_TreeCoreInit(SCM_TREE_MAP_CORE(tm), cmp, data);
+    Scm_TreeCoreInitWithType(SCM_TREE_MAP_CORE(tm), type, cmp, data);
     return SCM_OBJ(tm);
 }
 
@@ -386,7 +550,9 @@ void Scm_TreeMapDump(ScmTreeMap *tm, ScmPort *out)
     ScmTreeCore *tc = SCM_TREE_MAP_CORE(tm);
     Node *r = ROOT(tc);
     Scm_Printf(out, "Entries=%d\n", tc->num_entries);
-    if (r) {
+    if (BTREEP(tc)) {
+        bt_dump(tc, out, TRUE);
+    } else if (r) {
         dump_traverse(r, 0, out, TRUE);
     }
 }
@@ -395,7 +561,9 @@ void Scm_TreeCoreDump(ScmTreeCore *tc, ScmPort *out)
 {
     Node *r = ROOT(tc);
     Scm_Printf(out, "Entries=%d\n", tc->num_entries);
-    if (r) {
+    if (BTREEP(tc)) {
+        bt_dump(tc, out, FALSE);
+    } else if (r) {
         dump_traverse(r, 0, out, FALSE);
     }
 }
@@ -446,6 +614,7 @@ static Node *new_node(Node *parent, intptr_t key)
     n->key = key;
     n->value = 0;
     n->color = RED;             /* default is red */
+    n->size = 1;
     n->parent = parent;
     n->left = n->right = NULL;
     return n;
@@ -487,6 +656,8 @@ static void rotate_right(ScmTreeCore *tc, Node *n)
     replace_node(tc, n, l);
     l->right = n;  n->parent = l;
     n->left = gr;  if (gr) gr->parent = n;
+    FIX_SIZE(n);
+    FIX_SIZE(l);
 }
 
 /* rotate_left:
@@ -506,6 +677,8 @@ static void rotate_left(ScmTreeCore *tc, Node *n)
     replace_node(tc, n, r);
     r->left = n;   n->parent = r;
     n->right = gl; if (gl) gl->parent = n;
+    FIX_SIZE(n);
+    FIX_SIZE(r);
 }
 
 #if 0 /* for debug */
@@ -569,6 +742,7 @@ static void delete_node1(ScmTreeCore *tc, Node *todie, Node *child)
     Node *parent = todie->parent;
 
     replace_node(tc, todie, child);
+    for (Node *p = parent; p; p = p->parent) p->size--;
     if (REDP(todie)) { DELETE_CASE("1"); return; }
     if (REDP(child)) { DELETE_CASE("2"); child->color = BLACK; return; }
 
@@ -663,6 +837,7 @@ static void swap_node(ScmTreeCore *tc, Node *x, Node *y)
 
     int c;
     SWAP(x->color, y->color, c);
+    SWAP(x->size, y->size, c);
     if (x == ROOT(tc)) SET_ROOT(tc, y);
     else if (y == ROOT(tc)) SET_ROOT(tc, x);
 #undef SWAP
@@ -734,6 +909,7 @@ Node *core_ref(ScmTreeCore *tc, intptr_t key, enum TreeOp op,
                 if (op == TREE_CREATE) {
                     n = new_node(e, key);
                     e->right = n;
+                    for (Node *p = e; p; p = p->parent) p->size++;
                     balance_tree(tc, n);
                     tc->num_entries++;
                     return n;
@@ -752,6 +928,7 @@ Node *core_ref(ScmTreeCore *tc, intptr_t key, enum TreeOp op,
                 if (op == TREE_CREATE) {
                     n = new_node(e, key);
                     e->left = n;
+                    for (Node *p = e; p; p = p->parent) p->size++;
                     balance_tree(tc, n);
                     tc->num_entries++;
                     return n;
@@ -772,7 +949,970 @@ static Node *copy_tree(Node *parent, Node *self)
     Node *n = new_node(parent, self->key);
     n->value = self->value;
     n->color = self->color;
+    n->size = self->size;
     if (self->left)  n->left = copy_tree(n, self->left);
     if (self->right) n->right = copy_tree(n, self->right);
     return n;
 }
+
+/* order statistics */
+
+/* Returns the number of nodes whose key is less than KEY. */
+static int rb_rank(ScmTreeCore *tc, intptr_t key)
+{
+    int r = 0;
+    for (Node *n = ROOT(tc); n;) {
+        if (core_cmp(tc, n->key, key) < 0) {
+            r += SIZE(n->left) + 1;
+            n = n->right;
+        } else {
+            n = n->left;
+        }
+    }
+    return r;
+}
+
+/* Returns the I-th node (0-based) in the key order. */
+static Node *rb_nth(ScmTreeCore *tc, int i)
+{
+    for (Node *n = ROOT(tc); n;) {
+        int ls = SIZE(n->left);
+        if (i < ls) {
+            n = n->left;
+        } else if (i == ls) {
+            return n;
+        } else {
+            i -= ls + 1;
+            n = n->right;
+        }
+    }
+    return NULL;
+}
+
+/* split and join
+
+   Both are done without calling the comparison procedure; the split
+   point is given as a node, and the order of the trees to be joined
+   must already be known.  */
+
+/* Number of black nodes from N to the bottom. */
+static int black_height(Node *n)
+{
+    int h = 0;
+    for (; n; n = n->left) if (BLACKP(n)) h++;
+    return h;
+}
+
+/* Joins two red-black trees L and R together with a node K, where
+   all keys in L < K's key < all keys in R.  L and R are roots
+   (either can be NULL), and K is a detached node.  Returns the root
+   of the joined tree.  Takes time proportional to the difference of
+   black heights of L and R. */
+static Node *rb_join3(Node *l, Node *k, Node *r)
+{
+    ScmTreeCore t;              /* only used as a placeholder of the root */
+
+    if (l) { l->parent = NULL; PAINT(l, BLACK); }
+    if (r) { r->parent = NULL; PAINT(r, BLACK); }
+    int lh = black_height(l), rh = black_height(r);
+
+    k->parent = NULL;
+    if (lh == rh) {
+        k->left = l;  if (l) l->parent = k;
+        k->right = r; if (r) r->parent = k;
+        PAINT(k, BLACK);
+        FIX_SIZE(k);
+        return k;
+    }
+
+    Node *p = NULL, *c;
+    int h;
+    if (lh > rh) {
+        /* Go down along the right spine of L to find a black node C
+           whose black height equals to R's, and put K there. */
+        t.root = (ScmDictEntry*)l;
+        for (c = l, h = lh; !(BLACKP(c) && h == rh); c = c->right) {
+            if (BLACKP(c)) h--;
+            p = c;
+        }
+        k->left = c;  if (c) c->parent = k;
+        k->right = r; if (r) r->parent = k;
+        p->right = k;
+        for (Node *q = p; q; q = q->parent) q->size += SIZE(r) + 1;
+    } else {
+        /* Mirror image of the above */
+        t.root = (ScmDictEntry*)r;
+        for (c = r, h = rh; !(BLACKP(c) && h == lh); c = c->left) {
+            if (BLACKP(c)) h--;
+            p = c;
+        }
+        k->right = c; if (c) c->parent = k;
+        k->left = l;  if (l) l->parent = k;
+        p->left = k;
+        for (Node *q = p; q; q = q->parent) q->size += SIZE(l) + 1;
+    }
+    k->parent = p;
+    PAINT(k, RED);
+    FIX_SIZE(k);
+    balance_tree(&t, k);
+    return (Node*)t.root;
+}
+
+/* Splits TC so that the nodes ordered before B remain in TC, and B and
+   the nodes after it go into DST, which must be empty.  We climb from B
+   to the root, joining the subtrees hanging off the path to either
+   side; the total cost is O(log n). */
+static void rb_split(ScmTreeCore *tc, Node *b, ScmTreeCore *dst)
+{
+    Node *up = b->parent;
+    int fromleft = (up && LEFTP(b));
+    Node *lo = b->left, *hi = b->right;
+
+    b->left = b->right = NULL;
+    hi = rb_join3(NULL, b, hi);
+
+    while (up) {
+        Node *p = up;
+        up = p->parent;
+        int nextleft = (up && LEFTP(p));
+        if (fromleft) {
+            /* P and its right subtree come after B */
+            Node *pr = p->right;
+            p->left = p->right = NULL;
+            hi = rb_join3(hi, p, pr);
+        } else {
+            Node *pl = p->left;
+            p->left = p->right = NULL;
+            lo = rb_join3(pl, p, lo);
+        }
+        fromleft = nextleft;
+    }
+    /* LO may still be an untouched subtree with a red root */
+    if (lo) { lo->parent = NULL; PAINT(lo, BLACK); }
+    SET_ROOT(tc, lo);
+    SET_ROOT(dst, hi);
+    tc->num_entries = SIZE(lo);
+    dst->num_entries = SIZE(hi);
+}
+
+/* Moves all the nodes of SRC to the end of TC.  All keys in SRC must be
+   greater than the keys in TC. */
+static void rb_join(ScmTreeCore *tc, ScmTreeCore *src)
+{
+    if (ROOT(src) == NULL) return;
+    if (ROOT(tc) == NULL) {
+        SET_ROOT(tc, ROOT(src));
+    } else {
+        Node *k = delete_node(src, leftmost(ROOT(src)));
+        SET_ROOT(tc, rb_join3(ROOT(tc), k, ROOT(src)));
+    }
+    tc->num_entries += src->num_entries;
+    SET_ROOT(src, NULL);
+    src->num_entries = 0;
+}
+
+/*=============================================================
+ * Internal stuff (B+-tree implementation)
+ */
+
+/* Each leaf keeps up to BT_ORDER-1 entries, and each inner node keeps
+   up to BT_ORDER-1 children; a node temporarily holds BT_ORDER items
+   right before it is split.  Non-root nodes never have fewer than
+   BT_MIN items.  Leaves are doubly linked in the key order, so that
+   traversal walks through contiguous arrays instead of chasing
+   parent pointers.
+
+   Keys are kept in the node itself so that searching doesn't need
+   to touch the entries.  Each entry is allocated separately, though,
+   since we hand out ScmDictEntry pointers which must stay valid while
+   the nodes are split and merged.
+
+   Inner nodes also keep the number of entries under each child, for
+   the order statistics.
+
+   All the comparisons are done while descending the tree, before
+   any modification; the comparison procedure may throw an error,
+   and we don't want to leave the tree in an inconsistent state. */
+
+#define BT_ORDER      32        /* must be at least 6 */
+#define BT_MIN        (BT_ORDER/2 - 1)
+#define BT_MAX_DEPTH  32
+
+/* The first two elements must match ScmDictEntry. */
+typedef struct BEntryRec {
+    intptr_t key;
+    intptr_t value;
+} BEntry;
+
+typedef struct BNodeRec {
+    int leafp;
+    int n;                      /* # of entries (leaf) or children (inner) */
+} BNode;
+
+typedef struct BLeafRec {
+    BNode hdr;
+    struct BLeafRec *prev;
+    struct BLeafRec *next;
+    intptr_t keys[BT_ORDER];
+    BEntry  *entries[BT_ORDER];
+} BLeaf;
+
+/* keys[i] (i > 0) separates children[i-1] and children[i]; all keys
+   under children[i-1] are less than keys[i], and all keys under
+   children[i] are greater than or equal to keys[i].  keys[0] is
+   not used.  counts[i] is the number of entries under children[i]. */
+typedef struct BInnerRec {
+    BNode hdr;
+    intptr_t keys[BT_ORDER];
+    BNode   *children[BT_ORDER];
+    int      counts[BT_ORDER];
+} BInner;
+
+/* The path from the root to a leaf.  We don't keep parent pointers. */
+typedef struct BPathRec {
+    int     depth;                  /* # of inner nodes */
+    BInner *nodes[BT_MAX_DEPTH];
+    int     index[BT_MAX_DEPTH];    /* the child taken at each node */
+} BPath;
+
+#define BLEAF(n)          ((BLeaf*)(n))
+#define BINNER(n)         ((BInner*)(n))
+#define BROOT(tc)         ((BNode*)(tc)->root)
+#define SET_BROOT(tc, n)  ((tc)->root = (ScmDictEntry*)(n))
+
+static BLeaf *bt_new_leaf(void)
+{
+    BLeaf *l = SCM_NEW(BLeaf);
+    l->hdr.leafp = TRUE;
+    l->hdr.n = 0;
+    l->prev = l->next = NULL;
+    return l;
+}
+
+static BInner *bt_new_inner(void)
+{
+    BInner *n = SCM_NEW(BInner);
+    n->hdr.leafp = FALSE;
+    n->hdr.n = 0;
+    return n;
+}
+
+/* Number of entries under NODE. */
+static int bt_count(BNode *node)
+{
+    if (node->leafp) return node->n;
+    int c = 0;
+    for (int i=0; i<node->n; i++) c += BINNER(node)->counts[i];
+    return c;
+}
+
+static BEntry *bt_new_entry(intptr_t key, intptr_t value)
+{
+    BEntry *e = SCM_NEW(BEntry);
+    e->key = key;
+    e->value = value;
+    return e;
+}
+
+/* Descends from the root to the leaf where KEY belongs, recording
+   the path.  Returns NULL iff the tree is empty. */
+static BLeaf *bt_descend(ScmTreeCore *tc, intptr_t key, BPath *path)
+{
+    BNode *n = BROOT(tc);
+    path->depth = 0;
+    if (n == NULL) return NULL;
+    while (!n->leafp) {
+        BInner *in = BINNER(n);
+        /* find the first separator greater than KEY */
+        int lo = 1, hi = in->hdr.n;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (core_cmp(tc, in->keys[mid], key) <= 0) lo = mid + 1;
+            else hi = mid;
+        }
+        SCM_ASSERT(path->depth < BT_MAX_DEPTH);
+        path->nodes[path->depth] = in;
+        path->index[path->depth] = lo - 1;
+        path->depth++;
+        n = in->children[lo - 1];
+    }
+    return BLEAF(n);
+}
+
+/* Descends to the leftmost or rightmost leaf. */
+static BLeaf *bt_edge(ScmTreeCore *tc, int rightp, BPath *path)
+{
+    BNode *n = BROOT(tc);
+    path->depth = 0;
+    if (n == NULL) return NULL;
+    while (!n->leafp) {
+        int i = rightp? n->n - 1 : 0;
+        SCM_ASSERT(path->depth < BT_MAX_DEPTH);
+        path->nodes[path->depth] = BINNER(n);
+        path->index[path->depth] = i;
+        path->depth++;
+        n = BINNER(n)->children[i];
+    }
+    return BLEAF(n);
+}
+
+/* Returns the first position in LEAF whose key isn't less than KEY.
+   *FOUND is set to TRUE iff the key at the position is equal to KEY. */
+static int bt_leaf_search(ScmTreeCore *tc, BLeaf *leaf, intptr_t key,
+                          int *found)
+{
+    int lo = 0, hi = leaf->hdr.n;
+    *found = FALSE;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int r = core_cmp(tc, leaf->keys[mid], key);
+        if (r == 0) { *found = TRUE; return mid; }
+        if (r < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* NODE has just got BT_ORDER items.  Split it, and insert the new
+   node to the parent, propagating the split upwards as needed. */
+static void bt_split(ScmTreeCore *tc, BNode *node, BPath *path)
+{
+    const int half = BT_ORDER / 2;
+    int level = path->depth;
+
+    while (node->n == BT_ORDER) {
+        BNode *right;
+        intptr_t sep;
+        int rcount;
+
+        if (node->leafp) {
+            BLeaf *l = BLEAF(node), *r = bt_new_leaf();
+            memcpy(r->keys, l->keys + half, (BT_ORDER-half)*sizeof(intptr_t));
+            memcpy(r->entries, l->entries + half,
+                   (BT_ORDER-half)*sizeof(BEntry*));
+            /* gc friendliness */
+            for (int i=half; i<BT_ORDER; i++) {
+                l->keys[i] = 0; l->entries[i] = NULL;
+            }
+            r->hdr.n = BT_ORDER - half;
+            l->hdr.n = half;
+            rcount = r->hdr.n;
+            r->next = l->next;
+            if (r->next) r->next->prev = r;
+            r->prev = l;
+            l->next = r;
+            sep = r->keys[0];
+            right = (BNode*)r;
+        } else {
+            BInner *l = BINNER(node), *r = bt_new_inner();
+            memcpy(r->keys, l->keys + half, (BT_ORDER-half)*sizeof(intptr_t));
+            memcpy(r->children, l->children + half,
+                   (BT_ORDER-half)*sizeof(BNode*));
+            memcpy(r->counts, l->counts + half, (BT_ORDER-half)*sizeof(int));
+            for (int i=half; i<BT_ORDER; i++) {
+                l->keys[i] = 0; l->children[i] = NULL; l->counts[i] = 0;
+            }
+            r->hdr.n = BT_ORDER - half;
+            l->hdr.n = half;
+            rcount = bt_count((BNode*)r);
+            sep = r->keys[0];
+            r->keys[0] = 0;
+            right = (BNode*)r;
+        }
+
+        if (level == 0) {
+            /* NODE was the root */
+            BInner *root = bt_new_inner();
+            root->children[0] = node;
+            root->children[1] = right;
+            root->counts[0] = bt_count(node);
+            root->counts[1] = rcount;
+            root->keys[1] = sep;
+            root->hdr.n = 2;
+            SET_BROOT(tc, root);
+            return;
+        }
+
+        BInner *p = path->nodes[--level];
+        int i = path->index[level] + 1;
+        int n = p->hdr.n;
+        memmove(p->keys + i + 1, p->keys + i, (n-i)*sizeof(intptr_t));
+        memmove(p->children + i + 1, p->children + i, (n-i)*sizeof(BNode*));
+        memmove(p->counts + i + 1, p->counts + i, (n-i)*sizeof(int));
+        p->keys[i] = sep;
+        p->children[i] = right;
+        p->counts[i] = rcount;
+        p->counts[i-1] -= rcount;
+        p->hdr.n = n + 1;
+        node = (BNode*)p;
+    }
+}
+
+/* Inserts an entry E at the I-th position of LEAF, which is at the end
+   of PATH.  LEAF is NULL iff the tree is empty. */
+static BEntry *bt_insert(ScmTreeCore *tc, BLeaf *leaf, int i, BPath *path,
+                         BEntry *e)
+{
+    intptr_t key = e->key;
+    tc->num_entries++;
+
+    if (leaf == NULL) {
+        leaf = bt_new_leaf();
+        leaf->keys[0] = key;
+        leaf->entries[0] = e;
+        leaf->hdr.n = 1;
+        SET_BROOT(tc, leaf);
+        return e;
+    }
+
+    int n = leaf->hdr.n;
+    memmove(leaf->keys + i + 1, leaf->keys + i, (n-i)*sizeof(intptr_t));
+    memmove(leaf->entries + i + 1, leaf->entries + i, (n-i)*sizeof(BEntry*));
+    leaf->keys[i] = key;
+    leaf->entries[i] = e;
+    leaf->hdr.n = n + 1;
+    for (int l=0; l<path->depth; l++) path->nodes[l]->counts[path->index[l]]++;
+    if (leaf->hdr.n == BT_ORDER) bt_split(tc, (BNode*)leaf, path);
+    return e;
+}
+
+/* Moves the last item of P's (I-1)-th child to the front of P's I-th
+   child. */
+static void bt_borrow_left(BInner *p, int i)
+{
+    BNode *node = p->children[i], *left = p->children[i-1];
+    int n = node->n, ln = left->n;
+
+    if (node->leafp) {
+        BLeaf *d = BLEAF(node), *s = BLEAF(left);
+        memmove(d->keys + 1, d->keys, n*sizeof(intptr_t));
+        memmove(d->entries + 1, d->entries, n*sizeof(BEntry*));
+        d->keys[0] = s->keys[ln-1];
+        d->entries[0] = s->entries[ln-1];
+        s->keys[ln-1] = 0;
+        s->entries[ln-1] = NULL;
+        p->keys[i] = d->keys[0];
+        p->counts[i]++;
+        p->counts[i-1]--;
+    } else {
+        BInner *d = BINNER(node), *s = BINNER(left);
+        int c = s->counts[ln-1];
+        memmove(d->keys + 1, d->keys, n*sizeof(intptr_t));
+        memmove(d->children + 1, d->children, n*sizeof(BNode*));
+        memmove(d->counts + 1, d->counts, n*sizeof(int));
+        d->keys[1] = p->keys[i];
+        d->keys[0] = 0;
+        d->children[0] = s->children[ln-1];
+        d->counts[0] = c;
+        p->keys[i] = s->keys[ln-1];
+        p->counts[i] += c;
+        p->counts[i-1] -= c;
+        s->keys[ln-1] = 0;
+        s->children[ln-1] = NULL;
+        s->counts[ln-1] = 0;
+    }
+    node->n = n + 1;
+    left->n = ln - 1;
+}
+
+/* Moves the first item of P's (I+1)-th child to the end of P's I-th
+   child. */
+static void bt_borrow_right(BInner *p, int i)
+{
+    BNode *node = p->children[i], *right = p->children[i+1];
+    int n = node->n, rn = right->n;
+
+    if (node->leafp) {
+        BLeaf *d = BLEAF(node), *s = BLEAF(right);
+        d->keys[n] = s->keys[0];
+        d->entries[n] = s->entries[0];
+        memmove(s->keys, s->keys + 1, (rn-1)*sizeof(intptr_t));
+        memmove(s->entries, s->entries + 1, (rn-1)*sizeof(BEntry*));
+        s->keys[rn-1] = 0;
+        s->entries[rn-1] = NULL;
+        p->keys[i+1] = s->keys[0];
+        p->counts[i]++;
+        p->counts[i+1]--;
+    } else {
+        BInner *d = BINNER(node), *s = BINNER(right);
+        int c = s->counts[0];
+        d->keys[n] = p->keys[i+1];
+        d->children[n] = s->children[0];
+        d->counts[n] = c;
+        p->keys[i+1] = s->keys[1];
+        p->counts[i] += c;
+        p->counts[i+1] -= c;
+        memmove(s->keys, s->keys + 1, (rn-1)*sizeof(intptr_t));
+        memmove(s->children, s->children + 1, (rn-1)*sizeof(BNode*));
+        memmove(s->counts, s->counts + 1, (rn-1)*sizeof(int));
+        s->keys[0] = 0;
+        s->keys[rn-1] = 0;
+        s->children[rn-1] = NULL;
+        s->counts[rn-1] = 0;
+    }
+    node->n = n + 1;
+    right->n = rn - 1;
+}
+
+/* Merges P's (I+1)-th child into P's I-th child. */
+static void bt_merge(BInner *p, int i)
+{
+    BNode *left = p->children[i], *right = p->children[i+1];
+    int ln = left->n, rn = right->n, pn = p->hdr.n;
+
+    SCM_ASSERT(ln + rn < BT_ORDER);
+    if (left->leafp) {
+        BLeaf *d = BLEAF(left), *s = BLEAF(right);
+        memcpy(d->keys + ln, s->keys, rn*sizeof(intptr_t));
+        memcpy(d->entries + ln, s->entries, rn*sizeof(BEntry*));
+        d->next = s->next;
+        if (d->next) d->next->prev = d;
+        /* An iterator may still point to S; empty it so that the
+           iterator notices. */
+        for (int j=0; j<rn; j++) { s->keys[j] = 0; s->entries[j] = NULL; }
+        s->prev = s->next = NULL;
+    } else {
+        BInner *d = BINNER(left), *s = BINNER(right);
+        memcpy(d->keys + ln, s->keys, rn*sizeof(intptr_t));
+        memcpy(d->children + ln, s->children, rn*sizeof(BNode*));
+        memcpy(d->counts + ln, s->counts, rn*sizeof(int));
+        d->keys[ln] = p->keys[i+1];
+    }
+    left->n = ln + rn;
+    right->n = 0;
+
+    p->counts[i] += p->counts[i+1];
+    memmove(p->keys + i + 1, p->keys + i + 2, (pn-i-2)*sizeof(intptr_t));
+    memmove(p->children + i + 1, p->children + i + 2,
+            (pn-i-2)*sizeof(BNode*));
+    memmove(p->counts + i + 1, p->counts + i + 2, (pn-i-2)*sizeof(int));
+    p->keys[pn-1] = 0;
+    p->children[pn-1] = NULL;
+    p->counts[pn-1] = 0;
+    p->hdr.n = pn - 1;
+}
+
+/* NODE, at the end of PATH, may have got fewer items than BT_MIN.
+   Restore the invariance by borrowing from or merging with a sibling,
+   propagating upwards as needed. */
+static void bt_rebalance(ScmTreeCore *tc, BNode *node, BPath *path)
+{
+    int level = path->depth;
+
+    for (;;) {
+        if (level == 0) {
+            /* NODE is the root */
+            if (node->leafp) {
+                if (node->n == 0) SET_BROOT(tc, NULL);
+            } else if (node->n == 1) {
+                SET_BROOT(tc, BINNER(node)->children[0]);
+                BINNER(node)->children[0] = NULL;
+            }
+            return;
+        }
+        if (node->n >= BT_MIN) return;
+
+        BInner *p = path->nodes[--level];
+        int i = path->index[level];
+        if (i > 0 && p->children[i-1]->n > BT_MIN) {
+            bt_borrow_left(p, i);
+            return;
+        }
+        if (i < p->hdr.n - 1 && p->children[i+1]->n > BT_MIN) {
+            bt_borrow_right(p, i);
+            return;
+        }
+        if (i > 0) bt_merge(p, i-1);
+        else       bt_merge(p, i);
+        node = (BNode*)p;
+    }
+}
+
+static BEntry *bt_delete(ScmTreeCore *tc, BLeaf *leaf, int i, BPath *path)
+{
+    BEntry *e = leaf->entries[i];
+    int n = leaf->hdr.n;
+    memmove(leaf->keys + i, leaf->keys + i + 1, (n-i-1)*sizeof(intptr_t));
+    memmove(leaf->entries + i, leaf->entries + i + 1,
+            (n-i-1)*sizeof(BEntry*));
+    leaf->keys[n-1] = 0;
+    leaf->entries[n-1] = NULL;
+    leaf->hdr.n = n - 1;
+    tc->num_entries--;
+    for (int l=0; l<path->depth; l++) path->nodes[l]->counts[path->index[l]]--;
+    bt_rebalance(tc, (BNode*)leaf, path);
+    return e;
+}
+
+/* accessor */
+static ScmDictEntry *bt_ref(ScmTreeCore *tc, intptr_t key, ScmDictOp op)
+{
+    BPath path;
+    int found = FALSE, i = 0;
+    BLeaf *leaf = bt_descend(tc, key, &path);
+
+    if (leaf) i = bt_leaf_search(tc, leaf, key, &found);
+    if (found) {
+        if (op == SCM_DICT_DELETE) {
+            return (ScmDictEntry*)bt_delete(tc, leaf, i, &path);
+        }
+        return (ScmDictEntry*)leaf->entries[i];
+    }
+    if (op == SCM_DICT_CREATE) {
+        return (ScmDictEntry*)bt_insert(tc, leaf, i, &path,
+                                        bt_new_entry(key, 0));
+    }
+    return NULL;
+}
+
+/* Non-root leaves are never empty, so the neighbor leaves always have
+   an entry. */
+static ScmDictEntry *bt_near(ScmTreeCore *tc, intptr_t key,
+                             ScmDictEntry **lo, ScmDictEntry **hi)
+{
+    BPath path;
+    int found = FALSE;
+    BLeaf *leaf = bt_descend(tc, key, &path);
+
+    *lo = *hi = NULL;
+    if (leaf == NULL) return NULL;
+
+    int i = bt_leaf_search(tc, leaf, key, &found);
+    if (i > 0) {
+        *lo = (ScmDictEntry*)leaf->entries[i-1];
+    } else if (leaf->prev) {
+        *lo = (ScmDictEntry*)leaf->prev->entries[leaf->prev->hdr.n - 1];
+    }
+    int j = found? i+1 : i;
+    if (j < leaf->hdr.n) {
+        *hi = (ScmDictEntry*)leaf->entries[j];
+    } else if (leaf->next) {
+        *hi = (ScmDictEntry*)leaf->next->entries[0];
+    }
+    return found? (ScmDictEntry*)leaf->entries[i] : NULL;
+}
+
+static ScmDictEntry *bt_bound(ScmTreeCore *tc, ScmTreeCoreBoundOp op,
+                              int pop)
+{
+    BPath path;
+    BLeaf *leaf = bt_edge(tc, (op == SCM_TREE_CORE_MAX), &path);
+    if (leaf == NULL) return NULL;
+    int i = (op == SCM_TREE_CORE_MAX)? leaf->hdr.n - 1 : 0;
+    if (pop) return (ScmDictEntry*)bt_delete(tc, leaf, i, &path);
+    else     return (ScmDictEntry*)leaf->entries[i];
+}
+
+/* order statistics */
+
+/* Returns the number of entries whose key is less than KEY. */
+static int bt_rank(ScmTreeCore *tc, intptr_t key)
+{
+    BPath path;
+    int found, r = 0;
+    BLeaf *leaf = bt_descend(tc, key, &path);
+
+    if (leaf == NULL) return 0;
+    for (int l=0; l<path.depth; l++) {
+        for (int i=0; i<path.index[l]; i++) r += path.nodes[l]->counts[i];
+    }
+    return r + bt_leaf_search(tc, leaf, key, &found);
+}
+
+/* Descends to the leaf containing the I-th entry, recording the path.
+   The position in the leaf is set to *POS. */
+static BLeaf *bt_locate_nth(ScmTreeCore *tc, int i, BPath *path, int *pos)
+{
+    BNode *n = BROOT(tc);
+    path->depth = 0;
+    SCM_ASSERT(n != NULL && i >= 0 && i < tc->num_entries);
+    while (!n->leafp) {
+        BInner *in = BINNER(n);
+        int c = 0;
+        while (c < in->hdr.n - 1 && i >= in->counts[c]) {
+            i -= in->counts[c];
+            c++;
+        }
+        SCM_ASSERT(path->depth < BT_MAX_DEPTH);
+        path->nodes[path->depth] = in;
+        path->index[path->depth] = c;
+        path->depth++;
+        n = in->children[c];
+    }
+    *pos = i;
+    return BLEAF(n);
+}
+
+static ScmDictEntry *bt_nth(ScmTreeCore *tc, int i)
+{
+    BPath path;
+    int pos;
+    BLeaf *leaf = bt_locate_nth(tc, i, &path, &pos);
+    return (ScmDictEntry*)leaf->entries[pos];
+}
+
+/* split and join
+
+   These move entries one by one at either end of the trees, which
+   needs no comparison.  We always move the smaller part, so the cost
+   is O(m log n) where m is the size of the smaller part. */
+
+/* Inserts E as the minimum (RIGHTP is FALSE) or the maximum (RIGHTP is
+   TRUE) entry. */
+static void bt_insert_edge(ScmTreeCore *tc, BEntry *e, int rightp)
+{
+    BPath path;
+    BLeaf *leaf = bt_edge(tc, rightp, &path);
+    bt_insert(tc, leaf, (leaf && rightp)? leaf->hdr.n : 0, &path, e);
+}
+
+static void bt_swap_trees(ScmTreeCore *a, ScmTreeCore *b)
+{
+    ScmDictEntry *r = a->root;
+    int n = a->num_entries;
+    a->root = b->root;
+    a->num_entries = b->num_entries;
+    b->root = r;
+    b->num_entries = n;
+}
+
+/* Moves the entries at the position I and after from TC to DST, which
+   must be empty. */
+static void bt_split_at(ScmTreeCore *tc, int i, ScmTreeCore *dst)
+{
+    int n = tc->num_entries;
+    if (i < n - i) {
+        bt_swap_trees(tc, dst);
+        for (int j=0; j<i; j++) {
+            BEntry *e = (BEntry*)bt_bound(dst, SCM_TREE_CORE_MIN, TRUE);
+            bt_insert_edge(tc, e, TRUE);
+        }
+    } else {
+        for (int j=i; j<n; j++) {
+            BEntry *e = (BEntry*)bt_bound(tc, SCM_TREE_CORE_MAX, TRUE);
+            bt_insert_edge(dst, e, FALSE);
+        }
+    }
+}
+
+/* Moves all the entries of SRC to the end of TC. */
+static void bt_join(ScmTreeCore *tc, ScmTreeCore *src)
+{
+    if (src->num_entries < tc->num_entries) {
+        while (src->num_entries > 0) {
+            BEntry *e = (BEntry*)bt_bound(src, SCM_TREE_CORE_MIN, TRUE);
+            bt_insert_edge(tc, e, TRUE);
+        }
+    } else {
+        while (tc->num_entries > 0) {
+            BEntry *e = (BEntry*)bt_bound(tc, SCM_TREE_CORE_MAX, TRUE);
+            bt_insert_edge(src, e, FALSE);
+        }
+        bt_swap_trees(tc, src);
+    }
+}
+
+/* Deletes the entries at the positions [I, J). */
+static void bt_delete_range(ScmTreeCore *tc, int i, int j)
+{
+    for (; j > i; j--) {
+        BPath path;
+        int pos;
+        BLeaf *leaf = bt_locate_nth(tc, i, &path, &pos);
+        bt_delete(tc, leaf, pos, &path);
+    }
+}
+
+/* Iteration.  ITER->leaf and ITER->index cache the position of ITER->e.
+   If the tree has been modified since the last step, the cache may be
+   stale; then we look up ITER->e again.  Returns TRUE if ITER->e is
+   still in the tree; otherwise ITER->index points to the position
+   where ITER->e would be. */
+static int bt_iter_sync(ScmTreeIter *iter)
+{
+    BLeaf *leaf = (BLeaf*)iter->leaf;
+    if (leaf && iter->index < leaf->hdr.n
+        && leaf->entries[iter->index] == (BEntry*)iter->e) {
+        return TRUE;
+    }
+
+    BPath path;
+    int found = FALSE;
+    leaf = bt_descend(iter->t, iter->e->key, &path);
+    iter->leaf = leaf;
+    iter->index = 0;
+    if (leaf) iter->index = bt_leaf_search(iter->t, leaf, iter->e->key, &found);
+    return found;
+}
+
+static ScmDictEntry *bt_iter_step(ScmTreeIter *iter, int backward)
+{
+    BLeaf *leaf;
+    int i;
+
+    if (iter->e == NULL) {
+        BPath path;
+        leaf = bt_edge(iter->t, backward, &path);
+        if (leaf == NULL) return NULL;
+        i = backward? leaf->hdr.n - 1 : 0;
+    } else {
+        int present = bt_iter_sync(iter);
+        leaf = (BLeaf*)iter->leaf;
+        if (leaf == NULL) return NULL;
+        i = iter->index;
+        if (backward) i--;
+        else if (present) i++;
+        if (i >= leaf->hdr.n) {
+            leaf = leaf->next;
+            i = 0;
+        } else if (i < 0) {
+            leaf = leaf->prev;
+            if (leaf) i = leaf->hdr.n - 1;
+        }
+        if (leaf == NULL) return NULL;
+    }
+    iter->leaf = leaf;
+    iter->index = i;
+    return (ScmDictEntry*)leaf->entries[i];
+}
+
+/* copy */
+static BNode *bt_copy_node(BNode *node, BLeaf **last)
+{
+    if (node->leafp) {
+        BLeaf *s = BLEAF(node), *d = bt_new_leaf();
+        for (int i=0; i<s->hdr.n; i++) {
+            d->keys[i] = s->keys[i];
+            d->entries[i] = bt_new_entry(s->entries[i]->key,
+                                         s->entries[i]->value);
+        }
+        d->hdr.n = s->hdr.n;
+        d->prev = *last;
+        if (*last) (*last)->next = d;
+        *last = d;
+        return (BNode*)d;
+    } else {
+        BInner *s = BINNER(node), *d = bt_new_inner();
+        memcpy(d->keys, s->keys, s->hdr.n*sizeof(intptr_t));
+        memcpy(d->counts, s->counts, s->hdr.n*sizeof(int));
+        for (int i=0; i<s->hdr.n; i++) {
+            d->children[i] = bt_copy_node(s->children[i], last);
+        }
+        d->hdr.n = s->hdr.n;
+        return (BNode*)d;
+    }
+}
+
+static void bt_copy_tree(ScmTreeCore *dst, const ScmTreeCore *src)
+{
+    BLeaf *last = NULL;
+    if (BROOT(src)) SET_BROOT(dst, bt_copy_node(BROOT(src), &last));
+    else            SET_BROOT(dst, NULL);
+}
+
+/* consistency check */
+
+/* Returns the height of NODE.  The keys under NODE must be in [LO, HI);
+   NULL means no bound. */
+static int bt_check_traverse(ScmTreeCore *tc, BNode *node, int rootp,
+                             const intptr_t *lo, const intptr_t *hi)
+{
+    int min = rootp? (node->leafp? 1 : 2) : BT_MIN;
+    if (node->n < min || node->n >= BT_ORDER) {
+        Scm_Error("[internal] B-tree node has wrong number of items: %d",
+                  node->n);
+    }
+    if (node->leafp) {
+        BLeaf *leaf = BLEAF(node);
+        for (int i=0; i<node->n; i++) {
+            if (leaf->entries[i]->key != leaf->keys[i]) {
+                Scm_Error("[internal] B-tree leaf key mismatch");
+            }
+            if ((lo && core_cmp(tc, leaf->keys[i], *lo) < 0)
+                || (hi && core_cmp(tc, leaf->keys[i], *hi) >= 0)) {
+                Scm_Error("[internal] B-tree key out of range");
+            }
+        }
+        return 1;
+    } else {
+        BInner *in = BINNER(node);
+        int height = 0;
+        for (int i=0; i<node->n; i++) {
+            const intptr_t *clo = (i == 0)? lo : &in->keys[i];
+            const intptr_t *chi = (i == node->n - 1)? hi : &in->keys[i+1];
+            int h = bt_check_traverse(tc, in->children[i], FALSE, clo, chi);
+            if (i > 0 && h != height) {
+                Scm_Error("[internal] B-tree has leaves of different depth");
+            }
+            if (in->counts[i] != bt_count(in->children[i])) {
+                Scm_Error("[internal] B-tree has wrong entry count (%d)",
+                          in->counts[i]);
+            }
+            height = h;
+        }
+        return height + 1;
+    }
+}
+
+static void bt_check_consistency(ScmTreeCore *tc)
+{
+    BPath path;
+    int cnt = 0;
+
+    if (BROOT(tc)) bt_check_traverse(tc, BROOT(tc), TRUE, NULL, NULL);
+
+    /* Check leaf links and the order of the entries */
+    BLeaf *prev = NULL;
+    for (BLeaf *leaf = bt_edge(tc, FALSE, &path); leaf; leaf = leaf->next) {
+        if (leaf->prev != prev) {
+            Scm_Error("[internal] B-tree leaf link is broken");
+        }
+        for (int i=0; i<leaf->hdr.n; i++, cnt++) {
+            if (cnt > 0) {
+                intptr_t k = (i > 0)? leaf->keys[i-1]
+                    : prev->keys[prev->hdr.n - 1];
+                if (core_cmp(tc, k, leaf->keys[i]) >= 0) {
+                    Scm_Error("[internal] B-tree entries are out of order");
+                }
+            }
+        }
+        prev = leaf;
+    }
+    if (cnt != tc->num_entries) {
+        Scm_Error("[internal] tree map node count mismatch: record %d vs actual %d", tc->num_entries, cnt);
+    }
+}
+
+/* for debug */
+static void bt_dump_traverse(BNode *node, int depth, ScmPort *out, int scmobj)
+{
+    if (node->leafp) {
+        BLeaf *leaf = BLEAF(node);
+        for (int i=0; i<node->n; i++) {
+            for (int j=0; j<depth; j++) Scm_Printf(out, "  ");
+            if (scmobj) {
+                Scm_Printf(out, "%S => %S\n",
+                           SCM_OBJ(leaf->entries[i]->key),
+                           SCM_OBJ(leaf->entries[i]->value));
+            } else {
+                Scm_Printf(out, "%08x => %08x\n",
+                           leaf->entries[i]->key, leaf->entries[i]->value);
+            }
+        }
+    } else {
+        BInner *in = BINNER(node);
+        for (int i=0; i<node->n; i++) {
+            if (i > 0) {
+                for (int j=0; j<depth; j++) Scm_Printf(out, "  ");
+                if (scmobj) Scm_Printf(out, "-- %S\n", SCM_OBJ(in->keys[i]));
+                else        Scm_Printf(out, "-- %08x\n", in->keys[i]);
+            }
+            bt_dump_traverse(in->children[i], depth+1, out, scmobj);
+        }
+    }
+}
+
+static void bt_dump(ScmTreeCore *tc, ScmPort *out, int scmobj)
+{
+    if (BROOT(tc)) bt_dump_traverse(BROOT(tc), 0, out, scmobj);
+}
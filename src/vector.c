@@ -34,6 +34,11 @@
 #define LIBGAUCHE_BODY
 #include "gauche.h"
 
+#if defined(HAVE_SYS_MMAN_H) && !defined(GAUCHE_WINDOWS)
+#include <sys/mman.h>
+#include <fcntl.h>
+#endif
+
 /*=====================================================================
  * Generic vectors
  */
@@ -80,8 +85,9 @@ SCM_DEFINE_BUILTIN_CLASS_FLAGS(Scm_VectorClass, vector_print, vector_compare,
 
 static ScmVector *make_vector(ScmSmallInt size)
 {
-    ScmVector *v = SCM_NEW2(ScmVector *,
-                            sizeof(ScmVector) + sizeof(ScmObj)*(size-1));
+    ScmVector *v = (ScmVector*)
+        SCM_MALLOC_KIND(sizeof(ScmVector) + sizeof(ScmObj)*(size-1),
+                        SCM_ALLOC_VECTOR);
     SCM_SET_CLASS(v, SCM_CLASS_VECTOR);
     v->size = size;
     return v;
@@ -306,6 +312,239 @@ ScmObj Scm_MakeUVector(ScmClass *klass, ScmSmallInt size, void *init)
     return Scm_MakeUVectorFull(klass, size, init, FALSE, NULL);
 }
 
+/*
+ * Off-heap bodies
+ *
+ *   The owner field of such uvector points to off_heap, which is
+ *   shared by the aliases (see Scm_UVectorAlias), so the body is freed
+ *   by the finalizer only after all of them become garbage.
+ *   The off_heap record itself is atomic, for the body isn't in GC heap.
+ */
+static const char off_heap_tag[] = "off-heap";
+
+typedef struct off_heap_rec {
+    const char *tag;            /* off_heap_tag */
+    int storage;                /* SCM_UVECTOR_STORAGE_* */
+    size_t size;                /* in bytes */
+    void *body;                 /* NULL if released */
+} off_heap;
+
+static off_heap *uvector_off_heap(ScmUVector *v)
+{
+    off_heap *o = (off_heap*)SCM_UVECTOR_OWNER(v);
+    if (o != NULL && o->tag == off_heap_tag) return o;
+    return NULL;
+}
+
+static void off_heap_free(off_heap *o)
+{
+    if (o->body == NULL) return;
+#if defined(HAVE_SYS_MMAN_H) && !defined(GAUCHE_WINDOWS)
+    if (o->storage == SCM_UVECTOR_STORAGE_MMAP
+        || o->storage == SCM_UVECTOR_STORAGE_FILE) {
+        munmap(o->body, o->size);
+    } else {
+        free(o->body);
+    }
+#else  /* !HAVE_SYS_MMAN_H || GAUCHE_WINDOWS */
+    free(o->body);
+#endif /* !HAVE_SYS_MMAN_H || GAUCHE_WINDOWS */
+    o->body = NULL;
+}
+
+static void off_heap_finalize(ScmObj z, void *data)
+{
+    off_heap_free((off_heap*)z);
+}
+
+/* STORAGE is one of symbols heap, malloc or mmap.  The content of
+   the body is unspecified. */
+ScmObj Scm_MakeUVectorStorage(ScmClass *klass, ScmSmallInt size,
+                              ScmObj storage)
+{
+    int type;
+    if (SCM_EQ(storage, SCM_INTERN("heap"))) {
+        return Scm_MakeUVector(klass, size, NULL);
+    } else if (SCM_EQ(storage, SCM_INTERN("malloc"))) {
+        type = SCM_UVECTOR_STORAGE_MALLOC;
+    } else if (SCM_EQ(storage, SCM_INTERN("mmap"))) {
+        type = SCM_UVECTOR_STORAGE_MMAP;
+    } else {
+        Scm_Error("uvector storage must be one of heap, malloc or mmap, "
+                  "but got: %S", storage);
+        return SCM_UNDEFINED;   /* dummy */
+    }
+
+    int eltsize = Scm_UVectorElementSize(klass);
+    SCM_ASSERT(eltsize >= 1);
+    size_t nbytes = (size_t)size*eltsize;
+    if (nbytes == 0) nbytes = 1; /* avoid zero-size allocation */
+    void *body = NULL;
+#if defined(HAVE_SYS_MMAN_H) && !defined(GAUCHE_WINDOWS)
+    if (type == SCM_UVECTOR_STORAGE_MMAP) {
+        body = mmap(NULL, nbytes, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (body == MAP_FAILED) body = NULL;
+    } else {
+        body = malloc(nbytes);
+    }
+#else  /* !HAVE_SYS_MMAN_H || GAUCHE_WINDOWS */
+    type = SCM_UVECTOR_STORAGE_MALLOC; /* mmap isn't available */
+    body = malloc(nbytes);
+#endif /* !HAVE_SYS_MMAN_H || GAUCHE_WINDOWS */
+    if (body == NULL) {
+        Scm_Error("couldn't allocate off-heap uvector body of %lu bytes",
+                  (u_long)nbytes);
+    }
+
+    off_heap *o = SCM_NEW_ATOMIC(off_heap);
+    o->tag = off_heap_tag;
+    o->storage = type;
+    o->size = nbytes;
+    o->body = body;
+    Scm_RegisterFinalizer(SCM_OBJ(o), off_heap_finalize, NULL);
+    return Scm_MakeUVectorFull(klass, size, body, FALSE, o);
+}
+
+/* Maps the file PATH and returns a uvector of KLASS whose body is the
+   mapped region.  MODE is one of symbols read (read-only; the result is
+   immutable), shared (writes go to the file) or private (writes are
+   copy-on-write and never reach the file).  OFFSET is in bytes, and must
+   be a multiple of the element size.  LENGTH is in elements; negative
+   LENGTH means up to the end of the file.  The mapping is removed by
+   Scm_UVectorRelease, or when the uvector and all its aliases become
+   garbage. */
+ScmObj Scm_MapFileUVector(ScmClass *klass, const char *path, ScmObj mode,
+                          off_t offset, ScmSmallInt length)
+{
+#if defined(HAVE_SYS_MMAN_H) && !defined(GAUCHE_WINDOWS)
+    int prot, flags, oflags;
+    if (SCM_EQ(mode, SCM_INTERN("read"))) {
+        prot = PROT_READ; flags = MAP_SHARED; oflags = O_RDONLY;
+    } else if (SCM_EQ(mode, SCM_INTERN("shared"))) {
+        prot = PROT_READ|PROT_WRITE; flags = MAP_SHARED; oflags = O_RDWR;
+    } else if (SCM_EQ(mode, SCM_INTERN("private"))) {
+        prot = PROT_READ|PROT_WRITE; flags = MAP_PRIVATE; oflags = O_RDONLY;
+    } else {
+        Scm_Error("mapping mode must be one of read, shared or private, "
+                  "but got: %S", mode);
+        return SCM_UNDEFINED;   /* dummy */
+    }
+
+    int eltsize = Scm_UVectorElementSize(klass);
+    if (eltsize < 1) Scm_Error("uvector class required, but got: %S", klass);
+    if (offset < 0 || offset % eltsize != 0) {
+        Scm_Error("offset must be a nonnegative multiple of %d, but got: %ld",
+                  eltsize, (long)offset);
+    }
+
+    int fd;
+    SCM_SYSCALL(fd, open(path, oflags));
+    if (fd < 0) Scm_SysError("couldn't open %s", path);
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        Scm_SysError("fstat failed on %s", path);
+    }
+    if (offset > st.st_size) {
+        close(fd);
+        Scm_Error("offset %ld is beyond the end of %s",
+                  (long)offset, path);
+    }
+    if (length < 0) {
+        off_t rest = st.st_size - offset;
+        if (rest % eltsize != 0) {
+            close(fd);
+            Scm_Error("size of the mapped region of %s (%ld bytes) isn't "
+                      "a multiple of the element size %d",
+                      path, (long)rest, eltsize);
+        }
+        length = (ScmSmallInt)(rest / eltsize);
+    } else if ((off_t)length*eltsize > st.st_size - offset) {
+        close(fd);
+        Scm_Error("%s is too short to map %ld elements at offset %ld",
+                  path, length, (long)offset);
+    }
+
+    /* mmap offset must be page-aligned */
+    long pagesize = sysconf(_SC_PAGESIZE);
+    off_t base = offset - offset % pagesize;
+    size_t nbytes = (size_t)(offset - base) + (size_t)length*eltsize;
+    if (nbytes == 0) nbytes = 1; /* mmap rejects zero-length mapping */
+    void *body = mmap(NULL, nbytes, prot, flags, fd, base);
+    int e = errno;
+    close(fd);
+    if (body == MAP_FAILED) {
+        errno = e;
+        Scm_SysError("couldn't map %s", path);
+    }
+
+    off_heap *o = SCM_NEW_ATOMIC(off_heap);
+    o->tag = off_heap_tag;
+    o->storage = SCM_UVECTOR_STORAGE_FILE;
+    o->size = nbytes;
+    o->body = body;
+    Scm_RegisterFinalizer(SCM_OBJ(o), off_heap_finalize, NULL);
+    return Scm_MakeUVectorFull(klass, length, (char*)body + (offset - base),
+                               (prot == PROT_READ), o);
+#else  /* !HAVE_SYS_MMAN_H || GAUCHE_WINDOWS */
+    Scm_Error("file-mapped uvector isn't supported on this platform");
+    return SCM_UNDEFINED;       /* dummy */
+#endif /* !HAVE_SYS_MMAN_H || GAUCHE_WINDOWS */
+}
+
+/* Writes back the modified pages of file-mapped uvector V.  If ASYNC is
+   true, only schedules the write.  V may be an alias of a part of the
+   mapping. */
+void Scm_UVectorSync(ScmUVector *v, int async)
+{
+    off_heap *o = uvector_off_heap(v);
+    if (o == NULL || o->storage != SCM_UVECTOR_STORAGE_FILE) {
+        Scm_Error("file-mapped uvector required, but got: %S", SCM_OBJ(v));
+    }
+    if (o->body == NULL) {
+        Scm_Error("uvector is already released: %S", SCM_OBJ(v));
+    }
+#if defined(HAVE_SYS_MMAN_H) && !defined(GAUCHE_WINDOWS)
+    long pagesize = sysconf(_SC_PAGESIZE);
+    char *start = (char*)SCM_UVECTOR_ELEMENTS(v);
+    char *end = start + Scm_UVectorSizeInBytes(v);
+    char *pstart = (char*)o->body
+        + ((start - (char*)o->body) / pagesize) * pagesize;
+    if (end <= pstart) return;
+    if (msync(pstart, end - pstart, async? MS_ASYNC : MS_SYNC) < 0) {
+        Scm_SysError("msync failed");
+    }
+#endif /* HAVE_SYS_MMAN_H && !GAUCHE_WINDOWS */
+}
+
+int Scm_UVectorStorage(ScmUVector *v)
+{
+    off_heap *o = uvector_off_heap(v);
+    if (o == NULL) return SCM_UVECTOR_STORAGE_HEAP;
+    if (o->body == NULL) return SCM_UVECTOR_STORAGE_RELEASED;
+    return o->storage;
+}
+
+/* Frees the off-heap body of V now.  V becomes a zero-length vector.
+   Aliases of V must not be used after this. */
+void Scm_UVectorRelease(ScmUVector *v)
+{
+    off_heap *o = uvector_off_heap(v);
+    if (o == NULL) {
+        Scm_Error("uvector doesn't have off-heap storage: %S", SCM_OBJ(v));
+    }
+    off_heap_free(o);
+    Scm_UnregisterFinalizer(SCM_OBJ(o));
+#if GAUCHE_API_0_95
+    v->size_flags &= 1;
+#else  /*!GAUCHE_API_0_95*/
+    v->size = 0;
+#endif /*!GAUCHE_API_0_95*/
+    v->elements = NULL;
+}
+
 ScmObj Scm_ListToUVector(ScmClass *klass, ScmObj list, int clamp)
 {
     ScmUVectorType type = Scm_UVectorType(klass);
@@ -542,7 +781,7 @@ static inline void s64pr(ScmPort *out, ScmInt64 elt)
     Scm_Printf(out, "%S", Scm_MakeInteger64(elt));
 #elif SIZEOF_LONG == 4
     char buf[50];
-    snprintf(buf, 50, "%lld", elt);
+    snprintf(buf, 50, "%ld", elt);
     Scm_Printf(out, "%s", buf);
 #else
     Scm_Printf(out, "%ld", elt);
@@ -582,13 +821,20 @@ DEF_PRINT(F64, f64, double, fpr)
 
 /* comparer */
 
-#define DEF_CMP(TAG, tag, T, eq, lt)                                    \
+/* BITWISE is true if elements are equal iff their bit patterns are
+   the same, in which case we can use memcmp for equality.  It isn't
+   the case for flonums (-0.0 vs 0.0, and NaNs). */
+#define DEF_CMP(TAG, tag, T, eq, lt, bitwise)                           \
 static int SCM_CPP_CAT3(compare_,tag,vector)(ScmObj x, ScmObj y, int equalp) \
 {                                                                       \
     ScmSmallInt xlen = SCM_CPP_CAT3(SCM_,TAG,VECTOR_SIZE)(x);           \
     ScmSmallInt ylen = SCM_CPP_CAT3(SCM_,TAG,VECTOR_SIZE)(y);           \
     if (equalp) {                                                       \
         if (xlen != ylen) return -1;                                    \
+        if (bitwise) {                                                  \
+            return memcmp(SCM_UVECTOR_ELEMENTS(x), SCM_UVECTOR_ELEMENTS(y), \
+                          xlen*sizeof(T)) ? -1 : 0;                     \
+        }                                                               \
         for (ScmSmallInt i=0; i<xlen; i++) {                            \
             T xx = SCM_CPP_CAT3(SCM_,TAG,VECTOR_ELEMENTS)(x)[i];        \
             T yy = SCM_CPP_CAT3(SCM_,TAG,VECTOR_ELEMENTS)(y)[i];        \
@@ -649,14 +895,14 @@ static inline int uint64lt(ScmUInt64 x, ScmUInt64 y)
 #define f16eqv(a, b) SCM_HALF_FLOAT_CMP(==, a, b)
 #define f16lt(a, b)  SCM_HALF_FLOAT_CMP(<, a, b)
 
-DEF_CMP(S8, s8, signed char, common_eqv, common_lt)
-DEF_CMP(U8, u8, unsigned char, common_eqv, common_lt)
-DEF_CMP(S16, s16, short, common_eqv, common_lt)
-DEF_CMP(U16, u16, u_short, common_eqv, common_lt)
-DEF_CMP(S32, s32, ScmInt32, common_eqv, common_lt)
-DEF_CMP(U32, u32, ScmUInt32, common_eqv, common_lt)
-DEF_CMP(S64, s64, ScmInt64, int64eqv, int64lt)
-DEF_CMP(U64, u64, ScmUInt64, uint64eqv, uint64lt)
-DEF_CMP(F16, f16, ScmHalfFloat, f16eqv, f16lt)
-DEF_CMP(F32, f32, float, common_eqv, common_lt)
-DEF_CMP(F64, f64, double, common_eqv, common_lt)
+DEF_CMP(S8, s8, signed char, common_eqv, common_lt, 1)
+DEF_CMP(U8, u8, unsigned char, common_eqv, common_lt, 1)
+DEF_CMP(S16, s16, short, common_eqv, common_lt, 1)
+DEF_CMP(U16, u16, u_short, common_eqv, common_lt, 1)
+DEF_CMP(S32, s32, ScmInt32, common_eqv, common_lt, 1)
+DEF_CMP(U32, u32, ScmUInt32, common_eqv, common_lt, 1)
+DEF_CMP(S64, s64, ScmInt64, int64eqv, int64lt, 1)
+DEF_CMP(U64, u64, ScmUInt64, uint64eqv, uint64lt, 1)
+DEF_CMP(F16, f16, ScmHalfFloat, f16eqv, f16lt, 0)
+DEF_CMP(F32, f32, float, common_eqv, common_lt, 0)
+DEF_CMP(F64, f64, double, common_eqv, common_lt, 0)
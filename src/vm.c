@@ -56,6 +56,8 @@ static int vm_stack_mark_proc;
 #include <sched.h>
 #endif
 
+#include "gc_inline.h"
+
 #ifndef EX_SOFTWARE
 /* SRFI-22 requires this. */
 #define EX_SOFTWARE 70
@@ -109,12 +111,27 @@ static ScmHashCore vm_table;         /* VMs other than primordial one is
                                         registered to this hashtalbe, in order
                                         to avoid being GC-ed. */
 static ScmInternalMutex vm_table_mutex;
+static u_long detached_sov_count = 0; /* stack overflows of the VMs taken
+                                         out of vm_table.  protected by
+                                         vm_table_mutex. */
 static void vm_register(ScmVM *vm);
 static void vm_unregister(ScmVM *vm);
 
 static u_long vm_numeric_id = 0;    /* used for Scm_VM->vmid */
 static ScmInternalMutex vm_id_mutex;
 
+static long default_stack_size = SCM_VM_STACK_SIZE; /* in words.  can be
+                                        changed by GAUCHE_VM_STACK_SIZE */
+
+/* Stacks of terminated threads are kept here to be reused by new VMs,
+   so that a short-lived thread doesn't need to allocate and clear a
+   large chunk.  Only stacks of default_stack_size are pooled. */
+#define VM_STACK_POOL_SIZE 16
+static ScmObj *vm_stack_pool[VM_STACK_POOL_SIZE];
+static int vm_stack_pool_count = 0;
+static ScmInternalMutex vm_stack_pool_mutex;
+static ScmObj *vm_stack_alloc(ScmVM *vm, long stackSize);
+
 #ifdef GAUCHE_USE_PTHREADS
 static pthread_key_t vm_key;
 #define theVM   ((ScmVM*)pthread_getspecific(vm_key))
@@ -170,9 +187,21 @@ static void   call_error_reporter(ScmObj e);
  */
 
 ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name)
+{
+    return Scm_NewVMWithStackSize(proto, name,
+                                  proto? proto->stackSize : default_stack_size);
+}
+
+/* STACKSIZE is in words.  If it is smaller than SCM_VM_STACK_SIZE,
+   SCM_VM_STACK_SIZE is used.  A larger stack makes deep non-tail
+   recursion cheaper, for it reduces the number of times the frames
+   are migrated to the heap by save_stack(). */
+ScmVM *Scm_NewVMWithStackSize(ScmVM *proto, ScmObj name, long stackSize)
 {
     ScmVM *v = SCM_NEW(ScmVM);
 
+    if (stackSize < SCM_VM_STACK_SIZE) stackSize = SCM_VM_STACK_SIZE;
+
     SCM_SET_CLASS(v, SCM_CLASS_VM);
     v->state = SCM_VM_NEW;
     (void)SCM_INTERNAL_MUTEX_INIT(v->vmlock);
@@ -200,16 +229,11 @@ ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name)
     v->finalizerPending = 0;
     v->stopRequest = 0;
 
-#ifdef USE_CUSTOM_STACK_MARKER
-    v->stack = (ScmObj*)GC_generic_malloc((SCM_VM_STACK_SIZE+1)*sizeof(ScmObj),
-                                          vm_stack_kind);
-    *v->stack++ = SCM_OBJ(v);
-#else  /*!USE_CUSTOM_STACK_MARKER*/
-    v->stack = SCM_NEW_ARRAY(ScmObj, SCM_VM_STACK_SIZE);
-#endif /*!USE_CUSTOM_STACK_MARKER*/
+    v->stackSize = stackSize;
+    v->stack = vm_stack_alloc(v, stackSize);
     v->sp = v->stack;
     v->stackBase = v->stack;
-    v->stackEnd = v->stack + SCM_VM_STACK_SIZE;
+    v->stackEnd = v->stack + stackSize;
 #if GAUCHE_FFX
     v->fpstack = SCM_NEW_ATOMIC_ARRAY(ScmFlonum, SCM_VM_STACK_SIZE);
     v->fpstackEnd = v->fpstack + SCM_VM_STACK_SIZE;
@@ -222,7 +246,9 @@ ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name)
     v->pc = PC_TO_RETURN;
     v->base = NULL;
     v->val0 = SCM_UNDEFINED;
-    for (int i=0; i<SCM_VM_MAX_VALUES; i++) v->vals[i] = SCM_UNDEFINED;
+    for (int i=0; i<SCM_VM_MAX_VALUES; i++) v->valsBuf[i] = SCM_UNDEFINED;
+    v->vals = v->valsBuf;
+    v->valsSize = SCM_VM_MAX_VALUES;
     v->numVals = 1;
 
     v->handlers = SCM_NIL;
@@ -243,8 +269,13 @@ ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name)
     v->stat.sovCount = 0;
     v->stat.sovTime = 0;
     v->stat.loadStat = SCM_NIL;
+    Scm_VMStatsReset(v);
     v->profilerRunning = FALSE;
     v->prof = NULL;
+    v->profRing = NULL;
+    v->allocRing = NULL;
+    Scm__ProfilerAttachVM(v);
+    for (int i=0; i<GC_TINY_FREELISTS; i++) v->tinyFreeLists[i] = NULL;
 
     (void)SCM_INTERNAL_THREAD_INIT(v->thread);
 
@@ -260,6 +291,56 @@ ScmVM *Scm_NewVM(ScmVM *proto, ScmObj name)
     return v;
 }
 
+static ScmObj *vm_stack_alloc(ScmVM *vm, long stackSize)
+{
+    ScmObj *stack = NULL;
+
+    if (stackSize == default_stack_size) {
+        (void)SCM_INTERNAL_MUTEX_LOCK(vm_stack_pool_mutex);
+        if (vm_stack_pool_count > 0) {
+            stack = vm_stack_pool[--vm_stack_pool_count];
+            vm_stack_pool[vm_stack_pool_count] = NULL;
+        }
+        (void)SCM_INTERNAL_MUTEX_UNLOCK(vm_stack_pool_mutex);
+    }
+#ifdef USE_CUSTOM_STACK_MARKER
+    if (stack == NULL) {
+        stack = (ScmObj*)GC_generic_malloc((stackSize+1)*sizeof(ScmObj),
+                                           vm_stack_kind);
+        stack++;
+    }
+    stack[-1] = SCM_OBJ(vm);
+#else  /*!USE_CUSTOM_STACK_MARKER*/
+    if (stack == NULL) stack = SCM_NEW_ARRAY(ScmObj, stackSize);
+#endif /*!USE_CUSTOM_STACK_MARKER*/
+    return stack;
+}
+
+/* Called by a thread that has finished running VM and will never
+   run Scheme code on it again.  The stack is cleared and returned to
+   the pool.  The stack can't be referenced from anywhere else at
+   this point, for captured continuations and closed environments are
+   always moved to the heap. */
+void Scm__VMReleaseStack(ScmVM *vm)
+{
+    ScmObj *stack = vm->stack;
+
+    if (stack == NULL || vm->stackSize != default_stack_size) return;
+    vm->stack = vm->stackBase = vm->stackEnd = vm->sp = vm->argp = NULL;
+    vm->env = NULL;
+    vm->cont = NULL;
+    memset(stack, 0, vm->stackSize * sizeof(ScmObj));
+#ifdef USE_CUSTOM_STACK_MARKER
+    stack[-1] = NULL;
+#endif /*USE_CUSTOM_STACK_MARKER*/
+
+    (void)SCM_INTERNAL_MUTEX_LOCK(vm_stack_pool_mutex);
+    if (vm_stack_pool_count < VM_STACK_POOL_SIZE) {
+        vm_stack_pool[vm_stack_pool_count++] = stack;
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(vm_stack_pool_mutex);
+}
+
 /* Attach the thread to the current thread.
    See the notes of Scm_NewVM above.
    Returns TRUE on success, FALSE on failure. */
@@ -400,8 +481,70 @@ static void vm_register(ScmVM *vm)
 static void vm_unregister(ScmVM *vm)
 {
     SCM_INTERNAL_MUTEX_LOCK(vm_table_mutex);
-    (void)Scm_HashCoreSearch(&vm_table, (intptr_t)vm, SCM_DICT_DELETE);
+    if (Scm_HashCoreSearch(&vm_table, (intptr_t)vm, SCM_DICT_DELETE)) {
+        detached_sov_count += vm->stat.sovCount;
+    }
+    SCM_INTERNAL_MUTEX_UNLOCK(vm_table_mutex);
+}
+
+/* Summary of the VMs, for runtime metrics.  *NVMS gets the number of
+   VMs attached to threads (including the primordial one), *SOV the total
+   number of stack overflows (including the ones of already detached VMs),
+   and *SAMPLES the total number of the samples taken by the profilers
+   currently running.  The counters of other threads are read without
+   synchronization, so they may be slightly behind. */
+void Scm_VMRuntimeStats(u_long *nvms, u_long *sov, u_long *samples)
+{
+    u_long n = 1, s = rootVM->stat.sovCount, p = 0;
+    if (rootVM->prof) p += rootVM->prof->totalSamples;
+
+    SCM_INTERNAL_MUTEX_LOCK(vm_table_mutex);
+    ScmHashIter iter;
+    ScmDictEntry *e;
+    Scm_HashIterInit(&iter, &vm_table);
+    while ((e = Scm_HashIterNext(&iter)) != NULL) {
+        ScmVM *v = (ScmVM*)e->key;
+        n++;
+        s += v->stat.sovCount;
+        if (v->prof) p += v->prof->totalSamples;
+    }
+    s += detached_sov_count;
     SCM_INTERNAL_MUTEX_UNLOCK(vm_table_mutex);
+
+    if (nvms) *nvms = n;
+    if (sov) *sov = s;
+    if (samples) *samples = p;
+}
+
+/* Event counters of VM, as ((:calls N) ...), in the format of gc-stat.
+   If VM is not the current one, the counters are read while the
+   owner thread may be updating them, so they can be slightly off. */
+ScmObj Scm_VMStats(ScmVM *vm)
+{
+    ScmVMStat *st = &vm->stat;
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+#define STAT(name, val) \
+    SCM_APPEND1(h, t, SCM_LIST2(SCM_MAKE_KEYWORD(name), val))
+    STAT("calls", Scm_MakeIntegerU(st->callCount));
+    STAT("generic-dispatches", Scm_MakeIntegerU(st->genericCount));
+    STAT("continuation-saves", Scm_MakeIntegerU(st->contSaveCount));
+    STAT("stack-flushes",
+         Scm_MakeIntegerU(st->sovCount - st->sovCountAtReset));
+    STAT("reentries", Scm_MakeIntegerU(st->reentryCount));
+    STAT("allocated-bytes", Scm_MakeIntegerU64(st->allocBytes));
+#undef STAT
+    return h;
+}
+
+void Scm_VMStatsReset(ScmVM *vm)
+{
+    ScmVMStat *st = &vm->stat;
+    st->callCount = 0;
+    st->genericCount = 0;
+    st->contSaveCount = 0;
+    st->reentryCount = 0;
+    st->allocBytes = 0;
+    st->sovCountAtReset = st->sovCount;
 }
 
 /*====================================================================
@@ -477,7 +620,7 @@ static void vm_unregister(ScmVM *vm)
 
 /* return true if ptr points into the stack area */
 #define IN_STACK_P(ptr)                         \
-      ((unsigned long)((ptr) - vm->stackBase) < SCM_VM_STACK_SIZE)
+      ((unsigned long)((ptr) - vm->stackBase) < (unsigned long)vm->stackSize)
 
 /* Check if stack has room at least size bytes. */
 #define CHECK_STACK(size)                                       \
@@ -598,32 +741,54 @@ static void vm_unregister(ScmVM *vm)
 
 /* global reference.  this piece of code is used for a few GREF-something
    combined instruction. */
+/* Global variable reference.
+   Once executed, the operand of GREF family insns is replaced by the
+   gloc, so the common path is just to take the value out of it.  The
+   rare cases---first reference of the identifier, autoload, and unbound
+   variable---are handled out of line by global_ref_slow, to keep the
+   insn handlers that expand this macro small. */
 #define GLOBAL_REF(v)                                                   \
     do {                                                                \
         ScmGloc *gloc;                                                  \
         FETCH_OPERAND(v);                                               \
-        if (!SCM_GLOCP(v)) {                                            \
-            VM_ASSERT(SCM_IDENTIFIERP(v));                              \
-            gloc = Scm_IdentifierGlobalBinding(SCM_IDENTIFIER(v));      \
-            if (gloc == NULL) {                                         \
-                VM_ERR(("unbound variable: %S",                         \
-                        SCM_IDENTIFIER(v)->name));                      \
-            }                                                           \
-            /* memorize gloc */                                         \
-            *PC = SCM_WORD(gloc);                                       \
+        if (MOSTLY_FALSE(!SCM_GLOCP(v))) {                              \
+            gloc = global_ref_resolve(vm, v);                           \
         } else {                                                        \
             gloc = SCM_GLOC(v);                                         \
         }                                                               \
         v = SCM_GLOC_GET(gloc);                                         \
-        if (SCM_AUTOLOADP(v)) {                                         \
-            v = Scm_ResolveAutoload(SCM_AUTOLOAD(v), 0);                \
-        }                                                               \
-        if (SCM_UNBOUNDP(v)) {                                          \
-            VM_ERR(("unbound variable: %S", SCM_OBJ(gloc->name)));      \
+        if (MOSTLY_FALSE(SCM_UNBOUNDP(v) || SCM_AUTOLOADP(v))) {        \
+            v = global_ref_slow(gloc, v);                               \
         }                                                               \
         INCR_PC;                                                        \
     } while (0)
 
+/* Called when the operand of GREF is still an identifier.  Look up
+   and memoize the gloc. */
+static ScmGloc *global_ref_resolve(ScmVM *vm, ScmObj id)
+{
+    SCM_ASSERT(SCM_IDENTIFIERP(id));
+    ScmGloc *gloc = Scm_IdentifierGlobalBinding(SCM_IDENTIFIER(id));
+    if (gloc == NULL) {
+        Scm_Error("unbound variable: %S", SCM_IDENTIFIER(id)->name);
+    }
+    /* memorize gloc */
+    *PC = SCM_WORD(gloc);
+    return gloc;
+}
+
+/* Called when the value of the gloc is an autoload or unbound. */
+static ScmObj global_ref_slow(ScmGloc *gloc, ScmObj v)
+{
+    if (SCM_AUTOLOADP(v)) {
+        v = Scm_ResolveAutoload(SCM_AUTOLOAD(v), 0);
+    }
+    if (SCM_UNBOUNDP(v)) {
+        Scm_Error("unbound variable: %S", SCM_OBJ(gloc->name));
+    }
+    return v;
+}
+
 /* for debug */
 #define VM_DUMP(delimiter)                      \
     fprintf(stderr, delimiter);                 \
@@ -714,6 +879,12 @@ static void vm_unregister(ScmVM *vm)
         r = (SCM_FLONUM_VALUE(x_) op Scm_GetDouble(y_));        \
     } while (0)
 
+/* TRUE if a fixnum value V fits in a half word, so that the product
+   of two such values never overflows a long. */
+#define HALF_WORD_FIXNUM_LIMIT  (1L<<(SIZEOF_LONG*4-1))
+#define HALF_WORD_FIXNUM_P(v)                                   \
+    ((u_long)((v) + HALF_WORD_FIXNUM_LIMIT) < (u_long)(2*HALF_WORD_FIXNUM_LIMIT))
+
 /* We take advantage of GCC's `computed goto' feature
    (see gcc.info, "Labels as Values").
    'NEXT' or 'NEXT_PUSHCHECK' is placed at the end of most
@@ -730,8 +901,21 @@ static void vm_unregister(ScmVM *vm)
    the combination is very frequent - but for the less frequent
    instructions, NEXT_PUSHCHECK proved effective without introducing
    new fused vm insns.
+
+   GAUCHE_USE_COMPUTED_GOTO is set by configure (--disable-computed-goto
+   turns it off).  If it isn't set at all, e.g. on the platforms we
+   don't run configure, we use computed goto when the compiler is gcc
+   compatible.  Otherwise we fall back to a plain switch statement.
 */
-#ifdef __GNUC__
+#ifndef GAUCHE_USE_COMPUTED_GOTO
+#  if defined(__GNUC__)
+#    define GAUCHE_USE_COMPUTED_GOTO 1
+#  else
+#    define GAUCHE_USE_COMPUTED_GOTO 0
+#  endif
+#endif
+
+#if GAUCHE_USE_COMPUTED_GOTO
 #define SWITCH(val) goto *dispatch_table[val];
 #define CASE(insn)  SCM_CPP_CAT(LABEL_, insn) :
 #define DEFAULT     LABEL_DEFAULT :
@@ -750,13 +934,13 @@ static void vm_unregister(ScmVM *vm)
         }                                               \
         goto *dispatch_table[SCM_VM_INSN_CODE(code)];   \
     } while (0)
-#else /* !__GNUC__ */
+#else /* !GAUCHE_USE_COMPUTED_GOTO */
 #define SWITCH(val)    switch (val)
 #define CASE(insn)     case insn :
 #define DISPATCH       dispatch:
 #define NEXT           goto dispatch
 #define NEXT_PUSHCHECK goto dispatch
-#endif
+#endif /* !GAUCHE_USE_COMPUTED_GOTO */
 
 /* Check VM interrupt request. */
 #define CHECK_INTR \
@@ -849,6 +1033,73 @@ static void local_env_shift(ScmVM *vm, int env_depth)
     else           { ENV = tenv; }
 }
 
+/* case_dispatch_index
+   Called from CASE-INDEX insn.  The compiler turns a 'case' form with
+   many fixnum, char or symbol keys into a table lookup followed by
+   a binary search of clause index (see pass1/case-dispatch-table in
+   compile.scm).  TABLE is a vector in one of two layouts:
+
+     #(<default> <lo> <indices>)
+        Dense fixnum keys.  The index for key K is (vector-ref <indices>
+        (- K <lo>)), if K is in range.
+     #(<default> <keys> <indices>)
+        Open-addressing hash table.  The size of <keys> is a power of 2,
+        and empty slots hold #f.  The slot is chosen by the portable
+        hash of the key with salt 0, so that the table computed at
+        compile time stays valid in precompiled code.
+
+   All keys are comparable by eq?, since they're fixnums, chars or
+   symbols.  <default> is returned if KEY doesn't match.
+ */
+static ScmObj case_dispatch_index(ScmObj table, ScmObj key)
+{
+    ScmObj dflt = SCM_VECTOR_ELEMENT(table, 0);
+    ScmObj sel = SCM_VECTOR_ELEMENT(table, 1);
+    ScmObj indices = SCM_VECTOR_ELEMENT(table, 2);
+
+    if (SCM_INTP(sel)) {
+        if (SCM_INTP(key)) {
+            ScmSmallInt k = SCM_INT_VALUE(key) - SCM_INT_VALUE(sel);
+            if (k >= 0 && k < SCM_VECTOR_SIZE(indices)) {
+                return SCM_VECTOR_ELEMENT(indices, k);
+            }
+        }
+        return dflt;
+    }
+
+    if (!SCM_INTP(key) && !SCM_CHARP(key) && !SCM_SYMBOLP(key)) return dflt;
+    u_long mask = (u_long)SCM_VECTOR_SIZE(sel) - 1;
+    u_long i = Scm_PortableHash(key, 0) & mask;
+    for (;;) {
+        ScmObj k = SCM_VECTOR_ELEMENT(sel, i);
+        if (SCM_EQ(k, key)) return SCM_VECTOR_ELEMENT(indices, i);
+        if (SCM_FALSEP(k)) return dflt;
+        i = (i + 1) & mask;
+    }
+}
+
+
+/*===================================================================
+ * Inline allocation
+ */
+
+/* Pairs created by the VM loop are taken from the VM's own tiny free
+   lists, refilled by GC_generic_malloc_many.  Compared to Scm_Cons,
+   we save a function call and the thread-specific lookups, both in
+   Gauche and in GC, on every cons.  Only the thread that runs VM can
+   use it.  When the allocation sampler is running or allocations are
+   counted, we go through Scm_Cons so that the allocator hook sees it. */
+static inline ScmObj vm_cons(ScmVM *vm, ScmObj car, ScmObj cdr)
+{
+    if (Scm__AllocHookFlags) {
+        return Scm_Cons(car, cdr);
+    }
+    void *z;
+    SCM_FLONUM_ENSURE_MEM(car);
+    SCM_FLONUM_ENSURE_MEM(cdr);
+    GC_CONS(z, car, cdr, vm->tinyFreeLists);
+    return SCM_OBJ(z);
+}
 
 /*===================================================================
  * Main loop of VM
@@ -858,17 +1109,18 @@ static void run_loop()
     ScmVM *vm = theVM;
     ScmWord code = 0;
 
-#ifdef __GNUC__
+#if GAUCHE_USE_COMPUTED_GOTO
     static void *dispatch_table[256] = {
 #define DEFINSN(insn, name, nargs, type, flags)   && SCM_CPP_CAT(LABEL_, insn),
 #include "vminsn.c"
 #undef DEFINSN
     };
-#endif /* __GNUC__ */
 
     /* Records the offset of each instruction handler from run_loop entry
        address.  They can be retrieved by gauche.internal#%vm-get-insn-offsets.
-       Useful for tuning if used with machine instruction-level profiler. */
+       Useful for tuning if used with machine instruction-level profiler.
+       (With switch dispatch, we can't take the handler addresses, so
+       the offsets are left zero.) */
     if (vminsn_offsets[0] == 0) {
         /* No need to lock, for this is only executed when run_loop runs for
            the first time, which is in Scm_Init(). */
@@ -877,6 +1129,7 @@ static void run_loop()
                 (unsigned long)((char*)dispatch_table[i] - (char*)run_loop);
         }
     }
+#endif /* GAUCHE_USE_COMPUTED_GOTO */
 
     for (;;) {
         DISPATCH;
@@ -887,7 +1140,7 @@ static void run_loop()
 #define VMLOOP
 #include "vminsn.c"
 #undef  VMLOOP
-#ifndef __GNUC__
+#if !GAUCHE_USE_COMPUTED_GOTO
         default:
             Scm_Panic("Illegal vm instruction: %08x",
                       SCM_VM_INSN_CODE(code));
@@ -979,17 +1232,24 @@ static inline ScmEnvFrame *save_env(ScmVM *vm, ScmEnvFrame *env_begin)
 /* Copy the continuation frames to the heap.
    We run two passes, first replacing cont frames with the forwarding
    cont frames, then updates the pointers to them.
-   After save_cont, the only thing possibly left in the stack is the argument
-   frame pointed by vm->argp.
+   If STOP is NULL, all the frames are moved, and after save_cont_upto,
+   the only thing possibly left in the stack is the argument frame
+   pointed by vm->argp.
+   If STOP is given, the frames from vm->cont up to (but not including)
+   STOP are moved; STOP and the frames below it are left in the stack.
+   This is for partial continuations, which only need the frames above
+   the boundary frame.
  */
-static void save_cont(ScmVM *vm)
+static void save_cont_upto(ScmVM *vm, ScmContFrame *stop)
 {
     ScmContFrame *c = vm->cont, *prev = NULL;
 
+    vm->stat.contSaveCount++;
+
     /* Save the environment chain first. */
     vm->env = save_env(vm, vm->env);
 
-    if (!IN_STACK_P((ScmObj*)c)) return;
+    if (!IN_STACK_P((ScmObj*)c) || c == stop) return;
 
     /* First pass */
     do {
@@ -1034,7 +1294,15 @@ static void save_cont(ScmVM *vm)
         c->prev = csave;
         c->size = -1;
         c = tmp;
-    } while (IN_STACK_P((ScmObj*)c));
+    } while (IN_STACK_P((ScmObj*)c) && c != stop);
+
+    /* The frames left in the stack may point to the env frames we've
+       just moved. */
+    for (; IN_STACK_P((ScmObj*)c); c = c->prev) {
+        if (FORWARDED_ENV_P(c->env)) {
+            c->env = FORWARDED_ENV(c->env);
+        }
+    }
 
     /* Second pass */
     if (FORWARDED_CONT_P(vm->cont)) {
@@ -1057,6 +1325,11 @@ static void save_cont(ScmVM *vm)
     }
 }
 
+static void save_cont(ScmVM *vm)
+{
+    save_cont_upto(vm, NULL);
+}
+
 static void save_stack(ScmVM *vm)
 {
 #if HAVE_GETTIMEOFDAY
@@ -1076,10 +1349,11 @@ static void save_stack(ScmVM *vm)
     /* Clear the stack.  This removes bogus pointers and accelerates GC */
     for (ScmObj *p = vm->sp; p < vm->stackEnd; p++) *p = NULL;
 
+    vm->stat.sovCount++;
+
 #if HAVE_GETTIMEOFDAY
     if (stats) {
         gettimeofday(&t1, NULL);
-        vm->stat.sovCount++;
         vm->stat.sovTime +=
             (t1.tv_sec - t0.tv_sec)*1000000+(t1.tv_usec - t0.tv_usec);
     }
@@ -1178,7 +1452,7 @@ void Scm_VMFlushFPStack(ScmVM *vm)
 
     /* first, scan value registers and incomplete frames */
     SCM_FLONUM_ENSURE_MEM(VAL0);
-    for (int i=0; i<SCM_VM_MAX_VALUES; i++) {
+    for (int i=0; i<vm->valsSize; i++) {
         SCM_FLONUM_ENSURE_MEM(vm->vals[i]);
     }
     if (IN_STACK_P(ARGP)) {
@@ -1287,7 +1561,7 @@ ScmObj Scm_VMApply(ScmObj proc, ScmObj args)
     SCM_ASSERT(ARGP == SP);
 #if 0
     reqstack = ENV_SIZE(numargs) + 1;
-    if (reqstack >= SCM_VM_STACK_SIZE) {
+    if (reqstack >= vm->stackSize) {
         /* there's no way we can accept that many arguments */
         Scm_Error("too many arguments (%d) to apply", numargs);
     }
@@ -1437,17 +1711,72 @@ void Scm_VMPushCC(ScmCContinuationProc *after,
  *   structure ScmCStack.
  */
 
+/* Fast entry of apply_rec, for closures and subrs that take exactly
+ * NARGS arguments, which are in vm->vals.  We set up the call frame as
+ * VALUES_APPLY and CALL would do, saving a trip through the instructions
+ * and the generic part of procedure call.  A subr is even called
+ * directly here; we only run the VM loop if the subr left something for
+ * the VM to do, e.g. it pushed a C continuation or made a tail call with
+ * Scm_VMApply.  Returns TRUE if the VM loop should be run.
+ */
+static int apply_rec_fast_p(ScmObj proc, int nargs)
+{
+    if (!SCM_PROCEDUREP(proc)) return FALSE;
+    if (nargs >= SCM_VM_MAX_VALUES-1) return FALSE;
+    if (SCM_PROCEDURE_OPTIONAL(proc) != 0
+        || SCM_PROCEDURE_REQUIRED(proc) != nargs) return FALSE;
+    return (SCM_PROCEDURE_TYPE(proc) == SCM_PROC_SUBR
+            || SCM_PROCEDURE_TYPE(proc) == SCM_PROC_CLOSURE);
+}
+
+static int apply_rec_enter(ScmVM *vm, ScmObj proc, int nargs)
+{
+    CHECK_STACK(ENV_SIZE(nargs));
+    for (int i=0; i<nargs; i++) PUSH_ARG(vm->vals[i]);
+    vm->numVals = 1;
+    vm->stat.callCount++;
+
+    if (SCM_PROCEDURE_TYPE(proc) == SCM_PROC_SUBR) {
+        SP = ARGP;
+        PC = PC_TO_RETURN;
+        SCM_PROF_COUNT_CALL(vm, proc);
+        VAL0 = SCM_SUBR(proc)->func(ARGP, nargs, SCM_SUBR(proc)->data);
+        /* If the subr didn't touch the VM, the VM loop would just return
+           to the boundary frame. */
+        return !(TAIL_POS() && CONT == vm->cstack->cont);
+    } else {
+        if (nargs) {
+            FINISH_ENV(SCM_PROCEDURE_INFO(proc), SCM_CLOSURE(proc)->env);
+        } else {
+            ENV = SCM_CLOSURE(proc)->env;
+            ARGP = SP;
+        }
+        vm->base = SCM_COMPILED_CODE(SCM_CLOSURE(proc)->code);
+        PC = vm->base->code;
+        CHECK_STACK(vm->base->maxstack);
+        SCM_PROF_COUNT_CALL(vm, SCM_OBJ(vm->base));
+        VAL0 = SCM_MAKE_INT(nargs); /* keep argc to VAL0, as CALL does. */
+        return TRUE;
+    }
+}
+
 /* Border gate.  All the C->Scheme calls should go through here.
  *
  *   The current C stack information is saved in cstack.  The
  *   current VM stack information is saved (as a continuation
  *   frame pointer) in cstack.cont.
+ *
+ *   If PROC is not #f, it is called with NARGS arguments in vm->vals
+ *   through apply_rec_enter, instead of executing CODEVEC.
  */
 
-static ScmObj user_eval_inner(ScmObj program, ScmWord *codevec)
+static ScmObj user_eval_inner(ScmObj program, ScmWord *codevec,
+                              ScmObj proc, int nargs)
 {
     ScmCStack cstack;
     ScmVM * volatile vm = theVM;
+    /* Once entered, we don't enter PROC again when restarted. */
+    ScmObj volatile fastproc = proc;
     /* Save prev_pc, for the boundary continuation uses pc slot
        to mark the boundary. */
     ScmWord * volatile prev_pc = PC;
@@ -1468,6 +1797,7 @@ static ScmObj user_eval_inner(ScmObj program, ScmWord *codevec)
         CHECK_STACK(vm->base->maxstack);
     }
     SCM_PROF_COUNT_CALL(vm, program);
+    vm->stat.reentryCount++;
 
     cstack.prev = vm->cstack;
     cstack.cont = vm->cont;
@@ -1476,7 +1806,11 @@ static ScmObj user_eval_inner(ScmObj program, ScmWord *codevec)
   restart:
     vm->escapeReason = SCM_VM_ESCAPE_NONE;
     if (sigsetjmp(cstack.jbuf, FALSE) == 0) {
-        run_loop();             /* VM loop */
+        ScmObj p = fastproc;
+        fastproc = SCM_FALSE;
+        if (SCM_FALSEP(p) || apply_rec_enter(vm, p, nargs)) {
+            run_loop();         /* VM loop */
+        }
         if (vm->cont == cstack.cont) {
             POP_CONT();
             PC = prev_pc;
@@ -1551,7 +1885,7 @@ ScmObj Scm_EvalRec(ScmObj expr, ScmObj e)
     if (SCM_VM_COMPILER_FLAG_IS_SET(theVM, SCM_COMPILE_SHOWRESULT)) {
         Scm_CompiledCodeDump(SCM_COMPILED_CODE(v));
     }
-    return user_eval_inner(v, NULL);
+    return user_eval_inner(v, NULL, SCM_FALSE, 0);
 }
 
 /* NB: The ApplyRec family can be called in an inner loop (e.g. the display
@@ -1569,7 +1903,9 @@ static ScmObj apply_rec(ScmVM *vm, ScmObj proc, int nargs)
     vm->val0 = proc;
     ScmObj program = vm->base?
             SCM_OBJ(vm->base) : SCM_OBJ(&internal_apply_compiled_code);
-    return user_eval_inner(program, code);
+    return user_eval_inner(program, code,
+                           apply_rec_fast_p(proc, nargs)? proc : SCM_FALSE,
+                           nargs);
 }
 
 ScmObj Scm_ApplyRec(ScmObj proc, ScmObj args)
@@ -1716,9 +2052,13 @@ static int safe_eval_wrap(int kind, ScmObj arg0, ScmObj args,
     if (SCM_UNBOUNDP(epak.exception)) {
         /* normal termination */
         if (result) {
-            result->numResults = vm->numVals;
+            /* ScmEvalPacket has a fixed number of slots; extra values
+               are dropped. */
+            int nres = (vm->numVals > SCM_VM_MAX_VALUES)
+                ? SCM_VM_MAX_VALUES : vm->numVals;
+            result->numResults = nres;
             result->results[0] = r;
-            for (int i=1; i<vm->numVals; i++) {
+            for (int i=1; i<nres; i++) {
                 result->results[i] = vm->vals[i-1];
             }
             result->exception = SCM_FALSE;
@@ -1862,7 +2202,7 @@ static ScmObj dynwind_after_cc(ScmObj result, void **data)
 
     vm->numVals = nvals;
     if (nvals > 1) {
-        SCM_ASSERT(nvals <= SCM_VM_MAX_VALUES);
+        SCM_VM_ENSURE_VALUES(vm, nvals);
         memcpy(vm->vals, data[2], sizeof(ScmObj)*(nvals-1));
     }
     return val0;
@@ -1986,7 +2326,8 @@ void Scm_VMDefaultExceptionHandler(ScmObj e)
     if (ep) {
         /* There's an escape point defined by with-error-handler. */
         ScmObj target, current;
-        ScmObj result = SCM_FALSE, rvals[SCM_VM_MAX_VALUES];
+        ScmObj result = SCM_FALSE, rvalsBuf[SCM_VM_MAX_VALUES];
+        ScmObj *rvals = rvalsBuf;
         int numVals = 0;
 
         /* To conform SRFI-34, the error handler (clauses in 'guard' form)
@@ -2021,6 +2362,9 @@ void Scm_VMDefaultExceptionHandler(ScmObj e)
         SCM_UNWIND_PROTECT {
             result = Scm_ApplyRec(ep->ehandler, SCM_LIST1(e));
             if ((numVals = vm->numVals) > 1) {
+                if (numVals > SCM_VM_MAX_VALUES) {
+                    rvals = SCM_NEW_ARRAY(ScmObj, numVals-1);
+                }
                 for (int i=0; i<numVals-1; i++) rvals[i] = vm->vals[i];
             }
             if (!ep->rewindBefore) {
@@ -2043,7 +2387,8 @@ void Scm_VMDefaultExceptionHandler(ScmObj e)
         SCM_END_PROTECT;
 
         /* Install the continuation */
-        for (int i=0; i<numVals; i++) vm->vals[i] = rvals[i];
+        SCM_VM_ENSURE_VALUES(vm, numVals);
+        for (int i=0; i<numVals-1; i++) vm->vals[i] = rvals[i];
         vm->numVals = numVals;
         vm->val0 = result;
         vm->cont = ep->cont;
@@ -2202,10 +2547,29 @@ static ScmObj discard_ehandler(ScmObj *args, int nargs, void *data)
     return SCM_UNDEFINED;
 }
 
+/* An escape point and its installer/discarder subrs are always created
+   together and live as long as each other, so we allocate them in one
+   chunk.  This keeps the non-raising path of guard to a single allocation
+   (plus what dynamic-wind needs). */
+typedef struct ehandler_block_rec {
+    ScmEscapePoint ep;
+    ScmSubr before;
+    ScmSubr after;
+} ehandler_block;
+
+static void init_ehandler_subr(ScmSubr *s, ScmSubrProc *func, void *data)
+{
+    SCM_SET_CLASS(s, SCM_CLASS_PROCEDURE);
+    SCM_PROCEDURE_INIT(s, 0, 0, SCM_PROC_SUBR, SCM_FALSE);
+    s->func = func;
+    s->data = data;
+}
+
 static ScmObj with_error_handler(ScmVM *vm, ScmObj handler,
                                  ScmObj thunk, int rewindBefore)
 {
-    ScmEscapePoint *ep = SCM_NEW(ScmEscapePoint);
+    ehandler_block *b = SCM_NEW(ehandler_block);
+    ScmEscapePoint *ep = &b->ep;
 
     /* NB: we can save pointer to the stack area (vm->cont) to ep->cont,
      * since such ep is always accessible via vm->escapePoint chain and
@@ -2226,9 +2590,9 @@ static ScmObj with_error_handler(ScmVM *vm, ScmObj handler,
     vm->escapePoint = ep; /* This will be done in install_ehandler, but
                              make sure ep is visible from save_cont
                              to redirect ep->cont */
-    ScmObj before = Scm_MakeSubr(install_ehandler, ep, 0, 0, SCM_FALSE);
-    ScmObj after  = Scm_MakeSubr(discard_ehandler, ep, 0, 0, SCM_FALSE);
-    return Scm_VMDynamicWind(before, thunk, after);
+    init_ehandler_subr(&b->before, install_ehandler, ep);
+    init_ehandler_subr(&b->after, discard_ehandler, ep);
+    return Scm_VMDynamicWind(SCM_OBJ(&b->before), thunk, SCM_OBJ(&b->after));
 }
 
 ScmObj Scm_VMWithErrorHandler(ScmObj handler, ScmObj thunk)
@@ -2346,9 +2710,8 @@ static ScmObj throw_cont_body(ScmObj handlers,    /* after/before thunks
     } else if (nargs < 1) {
         vm->numVals = 0;
         return SCM_UNDEFINED;
-    } else if (nargs >= SCM_VM_MAX_VALUES) {
-        Scm_Error("too many values passed to the continuation");
     }
+    SCM_VM_ENSURE_VALUES(vm, nargs);
 
     ap = SCM_CDR(args);
     for (int i=0; SCM_PAIRP(ap); i++, ap=SCM_CDR(ap)) {
@@ -2437,13 +2800,15 @@ ScmObj Scm_VMCallPC(ScmObj proc)
     ScmVM *vm = theVM;
 
     /* save the continuation.  we only need to save the portion above the
-       latest boundary frame (+environmentns pointed from them), but for now,
-       we save everything to make things easier.  If we want to squeeze
-       performance we'll optimize it later. */
-    save_cont(vm);
-
-    /* find the latest boundary frame */
+       latest boundary frame (+environments pointed from them); the frames
+       below it stay in the stack. */
     ScmContFrame *c, *cp;
+    for (c = vm->cont; c && !BOUNDARY_FRAME_P(c); c = c->prev)
+        /*empty*/;
+    save_cont_upto(vm, c);
+
+    /* find the latest boundary frame again, since the frames above it
+       have been moved. */
     for (c = vm->cont, cp = NULL;
          c && !BOUNDARY_FRAME_P(c);
          cp = c, c = c->prev)
@@ -2500,6 +2865,22 @@ void Scm_VMRewindProtect(ScmVM *vm)
  * Values
  */
 
+/* Called via SCM_VM_ENSURE_VALUES when the values don't fit in the
+   current value registers.  The registers are moved to the heap; we
+   don't shrink them afterwards, since a program returning many values
+   tends to do so repeatedly. */
+void Scm__VMEnsureValues(ScmVM *vm, int nvals)
+{
+    if (nvals - 1 <= vm->valsSize) return;
+    int newsize = vm->valsSize * 2;
+    if (newsize < nvals - 1) newsize = nvals - 1;
+    ScmObj *v = SCM_NEW_ARRAY(ScmObj, newsize);
+    memcpy(v, vm->vals, sizeof(ScmObj)*vm->valsSize);
+    for (int i=vm->valsSize; i<newsize; i++) v[i] = SCM_UNDEFINED;
+    vm->vals = v;
+    vm->valsSize = newsize;
+}
+
 ScmObj Scm_VMValues(ScmVM *vm, ScmObj args)
 {
     if (!SCM_PAIRP(args)) {
@@ -2509,10 +2890,9 @@ ScmObj Scm_VMValues(ScmVM *vm, ScmObj args)
     int nvals = 1;
     ScmObj cp;
     SCM_FOR_EACH(cp, SCM_CDR(args)) {
+        if (nvals > vm->valsSize) Scm__VMEnsureValues(vm, nvals+1);
         vm->vals[nvals-1] = SCM_CAR(cp);
-        if (nvals++ >= SCM_VM_MAX_VALUES) {
-            Scm_Error("too many values: %S", args);
-        }
+        nvals++;
     }
     vm->numVals = nvals;
     return SCM_CAR(args);
@@ -2609,6 +2989,7 @@ static ScmObj process_queued_requests_cc(ScmObj result, void **data)
     vm->val0 = data[1];
     if (vm->numVals > 1) {
         ScmObj cp = SCM_OBJ(data[2]);
+        SCM_VM_ENSURE_VALUES(vm, vm->numVals);
         for (int i=0; i<vm->numVals-1; i++) {
             vm->vals[i] = SCM_CAR(cp);
             cp = SCM_CDR(cp);
@@ -2890,9 +3271,10 @@ struct GC_ms_entry *vm_stack_mark(GC_word *addr,
     struct GC_ms_entry *e = mark_sp;
     ScmObj *vmsb = ((ScmObj*)addr)+1;
     ScmVM *vm = (ScmVM*)*addr;
+    if (vm == NULL) return e;   /* pooled stack */
     int limit = vm->sp - vm->stackBase + 5;
     void *spb = (void *)vm->stackBase;
-    void *sbe = (void *)(vm->stackBase + SCM_VM_STACK_SIZE);
+    void *sbe = (void *)(vm->stackBase + vm->stackSize);
     void *hb = GC_least_plausible_heap_addr;
     void *he = GC_greatest_plausible_heap_addr;
 
@@ -2934,6 +3316,16 @@ void Scm__InitVM(void)
     Scm_HashCoreInitSimple(&vm_table, SCM_HASH_EQ, 8, NULL);
     SCM_INTERNAL_MUTEX_INIT(vm_table_mutex);
     SCM_INTERNAL_MUTEX_INIT(vm_id_mutex);
+    SCM_INTERNAL_MUTEX_INIT(vm_stack_pool_mutex);
+
+    /* The default stack size can be enlarged by the environment
+       variable, which is handy for programs with deep non-tail recursion.
+       The value is in words. */
+    const char *ss = Scm_GetEnv("GAUCHE_VM_STACK_SIZE");
+    if (ss != NULL) {
+        long n = strtol(ss, NULL, 10);
+        if (n > SCM_VM_STACK_SIZE) default_stack_size = n;
+    }
 
     /* Create root VM */
     rootVM = Scm_NewVM(NULL, SCM_MAKE_STR_IMMUTABLE("root"));
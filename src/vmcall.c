@@ -57,7 +57,7 @@
             while (argc > reqargs+optargs-1) {                          \
                 ScmObj a;                                               \
                 POP_ARG(a);                                             \
-                p = Scm_Cons(a, p);                                     \
+                p = vm_cons(vm, a, p);                                  \
                 argc--;                                                 \
             }                                                           \
             PUSH_ARG(p);                                                \
@@ -85,7 +85,7 @@
                 p = Scm_CopyList(p);                                    \
                 for (int c=argc; c>reqargs+optargs; c--) {              \
                     POP_ARG(a);                                         \
-                    p = Scm_Cons(a, p);                                 \
+                    p = vm_cons(vm, a, p);                              \
                 }                                                       \
                 PUSH_ARG(p);                                            \
             } else {                                                    \
@@ -145,6 +145,7 @@
 
     argc = (int)(SP - ARGP);
     vm->numVals = 1; /* default */
+    vm->stat.callCount++;
 
     /* object-apply hook.  shift args, and insert val0 into
        the fist arg slot, then call GenericObjectApply. */
@@ -248,13 +249,31 @@
         }
       GENERIC_ENTRY:
         /* pure generic application.  we implement MOP in C. */
+        vm->stat.genericCount++;
+#if !defined(APPLY_CALL)
+        /* the sorted list of applicable methods is looked up in the
+           dispatch cache of the generic function. */
+#if GAUCHE_FFX
+        {
+            ScmObj *ap = ARGP;
+            for (int i=0;i<argc; i++, ap++) SCM_FLONUM_ENSURE_MEM(*ap);
+        }
+#endif /*GAUCHE_FFX*/
+        mm = Scm__ComputeSortedApplicableMethods(SCM_GENERIC(VAL0),
+                                                 ARGP, argc);
+        if (!SCM_NULLP(mm)) {
+            nm = Scm_MakeNextMethod(SCM_GENERIC(VAL0), SCM_CDR(mm),
+                                    ARGP, argc, TRUE, APP);
+            VAL0 = SCM_CAR(mm);
+            proctype = SCM_PROC_METHOD;
+        }
+#else  /*APPLY_CALL*/
         mm = Scm_ComputeApplicableMethods(SCM_GENERIC(VAL0), ARGP, argc, APP);
         if (!SCM_NULLP(mm)) {
             /* sort methods.  we only need as many args as
                gf->maxReqargs to order methods, so we only unfold that
                many args if applyargs.
             */
-#if defined(APPLY_CALL)
             if (argc-1<SCM_GENERIC(VAL0)->maxReqargs) {
                 ScmObj args;
                 POP_ARG(args);
@@ -267,7 +286,6 @@
                 }
                 PUSH_ARG(args);
             }
-#endif /*APPLY_CALL*/
 #if GAUCHE_FFX
             {
                 ScmObj *ap = ARGP;
@@ -280,6 +298,7 @@
             VAL0 = SCM_CAR(mm);
             proctype = SCM_PROC_METHOD;
         }
+#endif /*APPLY_CALL*/
     } else if (proctype == SCM_PROC_NEXT_METHOD) {
         ScmNextMethod *n = SCM_NEXT_METHOD(VAL0);
         int use_saved_args = FALSE;
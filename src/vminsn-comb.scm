@@ -0,0 +1,4 @@
+;;; Generated by gen-insncomb.scm.  DO NOT EDIT.
+;;; The combined instructions for the frequent instruction
+;;; pairs.  See gen-insncomb.scm for how to regenerate this.
+;;; No profile has been incorporated yet.
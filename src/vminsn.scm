@@ -35,6 +35,10 @@
 ;;; gauche/vminsn.h and vminsn.c, which are then included in vm.c.
 ;;; This file is also used by the compiler.
 ;;;
+;;; The combined instructions generated from the instruction frequency
+;;; profile live in vminsn-comb.scm, which geninsn reads after this file.
+;;; See gen-insncomb.scm.
+;;;
 ;;;
 ;;; (define-insn <name> <num-params> <operand-type>
 ;;;              :optional (<combination> '())
@@ -328,7 +332,7 @@
    '(let* ([nargs::int (SCM_VM_INSN_ARG code)]
            [i::int (- nargs 1)]
            [v VAL0])
-      (when (>= nargs SCM_VM_MAX_VALUES) ($vm-err "values got too many args"))
+      (SCM_VM_ENSURE_VALUES vm nargs)
       (VM-ASSERT (<= (- nargs 1) (- SP (-> vm stackBase))))
       (when (> nargs 0)
         (for [() (> i 0) (post-- i)]
@@ -722,6 +726,7 @@
   (begin
     (VM-ASSERT ENV)
     (let* ([nvals::int (cast int (-> ENV size))] [v])
+      (SCM_VM_ENSURE_VALUES vm nvals)
       (set! (-> vm numVals) nvals)
       (for [() (> nvals 1) (post-- nvals)]
            (POP-ARG (aref (-> vm vals) (- nvals 1))))
@@ -887,7 +892,7 @@
 ;;  as well.
 ;;
 (define-insn CONS        0 none #f
-  (let* ([ca]) (POP-ARG ca) ($result (Scm_Cons ca VAL0))))
+  (let* ([ca]) (POP-ARG ca) ($result (vm_cons vm ca VAL0))))
 (define-insn CONS-PUSH   0 none   (CONS PUSH))
 
 (define-insn CAR         0 none #f
@@ -921,10 +926,10 @@
   (let* ([nargs::int (SCM_VM_INSN_ARG code)] [cp SCM_NIL] [arg])
     (when (> nargs 0)
       (SCM_FLONUM_ENSURE_MEM VAL0)
-      (set! cp (Scm_Cons VAL0 cp))
+      (set! cp (vm_cons vm VAL0 cp))
       (while (> (pre-- nargs) 0)
         (POP-ARG arg)
-        (set! cp (Scm_Cons arg cp))))
+        (set! cp (vm_cons vm arg cp))))
     ($result cp)))
 
 (define-insn LIST-STAR   1 none #f      ; list*
@@ -934,7 +939,7 @@
       (set! cp VAL0)
       (while (> (pre-- nargs) 0)
         (POP-ARG arg)
-        (set! cp (Scm_Cons arg cp))))
+        (set! cp (vm_cons vm arg cp))))
     ($result cp)))
 
 (define-insn LENGTH      0 none #f      ; length
@@ -949,6 +954,18 @@
 (define-insn EQ   0 none #f ($w/argp v ($result:b (SCM_EQ v VAL0))))
 (define-insn EQV  0 none #f ($w/argp v ($result:b (Scm_EqvP v VAL0))))
 
+;; CASE-INDEX <table>
+;;  Look up VAL0 in the dispatch table of a large 'case' form, and leave
+;;  the index of the matching clause in VAL0.  The table is built by the
+;;  compiler; see pass1/case-dispatch-table in compile.scm and
+;;  case_dispatch_index() in vm.c.
+(define-insn CASE-INDEX  0 obj #f
+  (let* ([table])
+    ($w/argr key
+      (FETCH-OPERAND table)
+      INCR-PC
+      ($result (case_dispatch_index table key)))))
+
 (define-insn APPEND      1 none #f
   (let* ([nargs::int (SCM_VM_INSN_ARG code)] [cp SCM_NIL] [args SCM_NIL] [a])
     (when (> nargs 0)
@@ -1190,13 +1207,18 @@
 
 (define-insn NUMMUL2 0 none #f          ; *
   ($w/argp arg
-    ;; we take a shortcut if either one is flonum and the
-    ;; other is real.  (if both are integers, the overflow check
-    ;; would be cumbersome so we just call Scm_Mul).
-    (if (or (and (SCM_FLONUMP arg) (SCM_REALP VAL0))
-            (and (SCM_FLONUMP VAL0) (SCM_REALP arg)))
-      ($result:f (* (Scm_GetDouble arg) (Scm_GetDouble VAL0)))
-      ($result (Scm_Mul arg VAL0)))))
+    ;; we take a shortcut if both are fixnums that fit in a half word,
+    ;; for their product can't overflow long; or if either one is flonum
+    ;; and the other is real.  Other cases are left to Scm_Mul.
+    (cond
+     [(and (SCM_INTP arg) (SCM_INTP VAL0)
+           (HALF_WORD_FIXNUM_P (SCM_INT_VALUE arg))
+           (HALF_WORD_FIXNUM_P (SCM_INT_VALUE VAL0)))
+      ($result:n (* (SCM_INT_VALUE arg) (SCM_INT_VALUE VAL0)))]
+     [(or (and (SCM_FLONUMP arg) (SCM_REALP VAL0))
+          (and (SCM_FLONUMP VAL0) (SCM_REALP arg)))
+      ($result:f (* (Scm_GetDouble arg) (Scm_GetDouble VAL0)))]
+     [else ($result (Scm_Mul arg VAL0))])))
 
 (define-insn NUMDIV2 0 none #f          ; / (binary)
   ($w/argp arg
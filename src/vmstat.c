@@ -34,6 +34,8 @@
 /* This file is included from vm.c */
 
 #ifdef COUNT_INSN_FREQUENCY
+#include <fcntl.h>
+
 /* for statistics */
 static u_long insn1_freq[SCM_VM_NUM_INSNS];
 static u_long insn2_freq[SCM_VM_NUM_INSNS][SCM_VM_NUM_INSNS];
@@ -42,6 +44,12 @@ static u_long insn2_freq[SCM_VM_NUM_INSNS][SCM_VM_NUM_INSNS];
 static u_long lref_freq[LREF_FREQ_COUNT_MAX][LREF_FREQ_COUNT_MAX];
 static u_long lset_freq[LREF_FREQ_COUNT_MAX][LREF_FREQ_COUNT_MAX];
 
+/* The insn frequency profile is dumped at exit, to the file named by
+   the environment variable GAUCHE_INSN_FREQUENCY_FILE if it's set, or
+   to the current output port otherwise.  The dump can be fed to
+   gen-insncomb.scm to generate combined instructions from the frequent
+   instruction pairs.  See vminsn.scm. */
+
 static ScmWord fetch_insn_counting(ScmVM *vm, ScmWord code)
 {
     if (vm->base && vm->pc != vm->base->code) {
@@ -54,12 +62,12 @@ static ScmWord fetch_insn_counting(ScmVM *vm, ScmWord code)
     case SCM_VM_LREF1: lref_freq[0][1]++; break;
     case SCM_VM_LREF2: lref_freq[0][2]++; break;
     case SCM_VM_LREF3: lref_freq[0][3]++; break;
-    case SCM_VM_LREF4: lref_freq[0][4]++; break;
     case SCM_VM_LREF10: lref_freq[1][0]++; break;
     case SCM_VM_LREF11: lref_freq[1][1]++; break;
     case SCM_VM_LREF12: lref_freq[1][2]++; break;
-    case SCM_VM_LREF13: lref_freq[1][3]++; break;
-    case SCM_VM_LREF14: lref_freq[1][4]++; break;
+    case SCM_VM_LREF20: lref_freq[2][0]++; break;
+    case SCM_VM_LREF21: lref_freq[2][1]++; break;
+    case SCM_VM_LREF30: lref_freq[3][0]++; break;
     case SCM_VM_LREF:
     {
         int dep = SCM_VM_INSN_ARG0(code);
@@ -69,11 +77,6 @@ static ScmWord fetch_insn_counting(ScmVM *vm, ScmWord code)
         lref_freq[dep][off]++;
         break;
     }
-    case SCM_VM_LSET0: lset_freq[0][0]++; break;
-    case SCM_VM_LSET1: lset_freq[0][1]++; break;
-    case SCM_VM_LSET2: lset_freq[0][2]++; break;
-    case SCM_VM_LSET3: lset_freq[0][3]++; break;
-    case SCM_VM_LSET4: lset_freq[0][4]++; break;
     case SCM_VM_LSET:
     {
         int dep = SCM_VM_INSN_ARG0(code);
@@ -87,34 +90,46 @@ static ScmWord fetch_insn_counting(ScmVM *vm, ScmWord code)
     return code;
 }
 
-static void dump_insn_frequency(void *data)
+static void dump_freq_matrix(ScmPort *out, u_long (*m)[LREF_FREQ_COUNT_MAX])
 {
-    Scm_Printf(SCM_CUROUT, "(:instruction-frequencies (");
-    for (int i=0; i<SCM_VM_NUM_INSNS; i++) {
-        Scm_Printf(SCM_CUROUT, "(%s %d", Scm_VMInsnName(i), insn1_freq[i]);
-        for (int j=0; j<SCM_VM_NUM_INSNS; j++) {
-            Scm_Printf(SCM_CUROUT, " %d", insn2_freq[i][j]);
-        }
-        Scm_Printf(SCM_CUROUT, ")\n");
-    }
-    Scm_Printf(SCM_CUROUT, ")\n :lref-frequencies (");
     for (int i=0; i<LREF_FREQ_COUNT_MAX; i++) {
-        Scm_Printf(SCM_CUROUT, "(");
+        Scm_Printf(out, "(");
         for (int j=0; j<LREF_FREQ_COUNT_MAX; j++) {
-            Scm_Printf(SCM_CUROUT, "%d ", lref_freq[i][j]);
+            Scm_Printf(out, "%lu ", m[i][j]);
         }
-        Scm_Printf(SCM_CUROUT, ")\n");
+        Scm_Printf(out, ")\n");
     }
-    Scm_Printf(SCM_CUROUT, ")\n :lset-frequencies (");
-    for (int i=0; i<LREF_FREQ_COUNT_MAX; i++) {
-        Scm_Printf(SCM_CUROUT, "(");
-        for (int j=0; j<LREF_FREQ_COUNT_MAX; j++) {
-            Scm_Printf(SCM_CUROUT, "%d ", lset_freq[i][j]);
+}
+
+static void dump_insn_frequency(void *data)
+{
+    ScmPort *out = SCM_CUROUT;
+    const char *file = Scm_GetEnv("GAUCHE_INSN_FREQUENCY_FILE");
+    if (file != NULL) {
+        ScmObj p = Scm_OpenFilePort(file, O_WRONLY|O_CREAT|O_TRUNC,
+                                    SCM_PORT_BUFFER_FULL, 0666);
+        if (SCM_FALSEP(p)) {
+            Scm_Warn("couldn't open insn frequency file %s", file);
+        } else {
+            out = SCM_PORT(p);
+        }
+    }
+
+    Scm_Printf(out, "(:instruction-frequencies (");
+    for (int i=0; i<SCM_VM_NUM_INSNS; i++) {
+        Scm_Printf(out, "(%s %lu", Scm_VMInsnName(i), insn1_freq[i]);
+        for (int j=0; j<SCM_VM_NUM_INSNS; j++) {
+            Scm_Printf(out, " %lu", insn2_freq[i][j]);
         }
-        Scm_Printf(SCM_CUROUT, ")\n");
+        Scm_Printf(out, ")\n");
     }
-    Scm_Printf(SCM_CUROUT, ")\n");
-    Scm_Printf(SCM_CUROUT, ")\n");
+    Scm_Printf(out, ")\n :lref-frequencies (");
+    dump_freq_matrix(out, lref_freq);
+    Scm_Printf(out, ")\n :lset-frequencies (");
+    dump_freq_matrix(out, lset_freq);
+    Scm_Printf(out, ")\n");
+    Scm_Printf(out, ")\n");
+    if (out != SCM_CUROUT) Scm_ClosePort(out);
 }
 
 #endif /*COUNT_INSN_FREQUENCY*/
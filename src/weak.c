@@ -212,12 +212,25 @@ void *Scm_WeakBoxRef(ScmWeakBox *wbox)
  * If a key is GC-ed, the entry becomes inaccessible---from outside it
  * looks as if the entry is deleted.  We don't immediately delete the entry
  * at the time we found its key has been GC-ed, since the caller may not
- * expect the table is modified.  Instead we flag the table and delete
- * those entries when the table is modified.
+ * expect the table is modified.  Instead, every time an entry is added
+ * or deleted, we sweep a few buckets and delete the dead entries in them.
+ * The cost of cleanup is thus amortized over the insertions, and the
+ * dead entries never accumulate more than the size of the table.
+ * goneEntries counts the entries deleted that way.
+ *
+ * In a key-weak table, the entry holds the real key through a weak box.
+ * The box is allocated only when a new entry is created; searches are
+ * done with the real key and the hash value saved in the entry.
+ *
+ * NB: The values are held strongly in a key-weak table.  If a value
+ * refers to its key, the entry is never reclaimed; Boehm GC doesn't
+ * have ephemerons.  Use a table weak in both for such caches.
  */
 
-#define MARK_GONE_ENTRY(ht, e)  (ht->goneEntries++)
-
+/* # of buckets to sweep per insertion/deletion.  Since the table
+   keeps at most MAX_AVG_CHAIN_LIMITS entries per bucket on average,
+   this is a small constant amount of work. */
+#define WEAK_SWEEP_STEP  2
 
 static void weakhash_print(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
 {
@@ -240,25 +253,8 @@ SCM_DEFINE_BUILTIN_CLASS(Scm_WeakHashTableClass, weakhash_print,
                          NULL, NULL, NULL,
                          SCM_CLASS_DICTIONARY_CPL);
 
-/* Custom hasher & comparer for key-weak table, in which we insert
-   one indirection to the real key via WeakBox. */
-static u_long weak_key_hash(const ScmHashCore *hc, intptr_t key)
-{
-    ScmWeakHashTable *wh = SCM_WEAK_HASH_TABLE(hc->data);
-    ScmWeakBox *box = (ScmWeakBox *)key;
-    intptr_t realkey = (intptr_t)Scm_WeakBoxRef(box);
-    if (Scm_WeakBoxEmptyP(box)) {
-        /* There IS a small possibility that the real key has already been
-           GCed.  We return an arbitrary value (0 here); the entry won't
-           match anyway. */
-        return 0;
-    } else {
-        u_long k= wh->hashfn(hc, realkey);
-        return k;
-    }
-}
-
-
+/* Custom comparer for key-weak table.  KEY is the real key, while
+   ENTRYKEY is the weak box. */
 static int weak_key_compare(const ScmHashCore *hc, intptr_t key,
                             intptr_t entrykey)
 {
@@ -272,13 +268,20 @@ static int weak_key_compare(const ScmHashCore *hc, intptr_t key,
     }
 }
 
-/* Scan through  */
-#if 0
-static void weak_hash_cleanup(ScmWeakHashTable *wh)
+static int weak_entry_dead(ScmDictEntry *e, void *data)
 {
+    return Scm_WeakBoxEmptyP((ScmWeakBox*)e->key);
 }
-#endif
 
+/* Sweep NBUCKETS buckets (negative for all) of a key-weak table. */
+static int weak_hash_sweep(ScmWeakHashTable *wh, int nbuckets)
+{
+    if (!(wh->weakness & SCM_WEAK_KEY)) return 0;
+    int n = Scm_HashCoreSweep(SCM_WEAK_HASH_TABLE_CORE(wh), weak_entry_dead,
+                              NULL, &wh->sweepCursor, nbuckets);
+    wh->goneEntries += n;
+    return n;
+}
 
 ScmObj Scm_MakeWeakHashTableSimple(ScmHashType type,
                                    ScmWeakness weakness,
@@ -291,12 +294,13 @@ ScmObj Scm_MakeWeakHashTableSimple(ScmHashType type,
     wh->type = type;
     wh->defaultValue = defaultValue;
     wh->goneEntries = 0;
+    wh->sweepCursor = 0;
 
     if (weakness & SCM_WEAK_KEY) {
         if (!Scm_HashCoreTypeToProcs(type, &wh->hashfn, &wh->cmpfn)) {
             Scm_Error("[internal error] Scm_MakeWeakHashTableSimple: unsupported type: %d", type);
         }
-        Scm_HashCoreInitGeneral(&wh->core, weak_key_hash, weak_key_compare,
+        Scm_HashCoreInitGeneral(&wh->core, wh->hashfn, weak_key_compare,
                                 initSize, wh);
     } else {
         Scm_HashCoreInitSimple(&wh->core, type, initSize, wh);
@@ -315,7 +319,9 @@ ScmObj Scm_WeakHashTableCopy(ScmWeakHashTable *src)
     wh->hashfn = src->hashfn;
     wh->cmpfn = src->cmpfn;
     wh->goneEntries = 0;
+    wh->sweepCursor = 0;
     Scm_HashCoreCopy(&wh->core, &src->core);
+    wh->core.data = wh;
     return SCM_OBJ(wh);
 }
 
@@ -337,18 +343,19 @@ ScmObj Scm_WeakHashTableRef(ScmWeakHashTable *ht, ScmObj key, ScmObj fallback)
 ScmObj Scm_WeakHashTableSet(ScmWeakHashTable *ht, ScmObj key, ScmObj value,
                             int flags)
 {
-    intptr_t proxy;
-
-    if (ht->weakness&SCM_WEAK_KEY) {
-        proxy = (intptr_t)Scm_MakeWeakBox(key);
-    } else {
-        proxy = (intptr_t)key;
-    }
-
     ScmDictEntry *e = Scm_HashCoreSearch(
-        SCM_WEAK_HASH_TABLE_CORE(ht), proxy,
+        SCM_WEAK_HASH_TABLE_CORE(ht), (intptr_t)key,
         (flags&SCM_DICT_NO_CREATE)?SCM_DICT_GET:SCM_DICT_CREATE);
     if (!e) return SCM_UNBOUND;
+    if (e->value == 0) {
+        /* A new entry.  Replace the key with its weak box before anybody
+           else sees the entry.  The hash value is kept in the entry, so
+           it needn't be recalculated. */
+        if (ht->weakness&SCM_WEAK_KEY) {
+            *(intptr_t*)&e->key = (intptr_t)Scm_MakeWeakBox(key);
+            weak_hash_sweep(ht, WEAK_SWEEP_STEP);
+        }
+    }
     if (ht->weakness&SCM_WEAK_VALUE) {
         if (flags&SCM_DICT_NO_OVERWRITE) {
             if (e->value) {
@@ -357,6 +364,7 @@ ScmObj Scm_WeakHashTableSet(ScmWeakHashTable *ht, ScmObj key, ScmObj value,
                     return SCM_OBJ(val);
             }
         }
+        /* NB: We don't reuse the box, for a copied table shares it. */
         e->value = (intptr_t)Scm_MakeWeakBox(value);
         return value;
     } else {
@@ -372,6 +380,7 @@ ScmObj Scm_WeakHashTableDelete(ScmWeakHashTable *ht, ScmObj key)
 {
     ScmDictEntry *e = Scm_HashCoreSearch(SCM_WEAK_HASH_TABLE_CORE(ht),
                                          (intptr_t)key, SCM_DICT_DELETE);
+    weak_hash_sweep(ht, WEAK_SWEEP_STEP);
     if (e && e->value) {
         if (ht->weakness&SCM_WEAK_VALUE) {
             void *val = Scm_WeakBoxRef((ScmWeakBox*)e->value);
@@ -387,6 +396,35 @@ ScmObj Scm_WeakHashTableDelete(ScmWeakHashTable *ht, ScmObj key)
     }
 }
 
+/* Delete all the entries whose keys have been GC-ed at once.
+   Returns the number of deleted entries. */
+int Scm_WeakHashTableSweep(ScmWeakHashTable *ht)
+{
+    return weak_hash_sweep(ht, -1);
+}
+
+/* Count the entries whose keys are alive and those whose keys
+   have been GC-ed but which aren't swept yet.  Either of LIVE and DEAD
+   can be NULL. */
+void Scm_WeakHashTableStat(ScmWeakHashTable *ht,
+                           ScmSmallInt *live, ScmSmallInt *dead)
+{
+    ScmSmallInt nlive = 0, ndead = 0;
+    ScmHashIter iter;
+    ScmDictEntry *e;
+
+    Scm_HashIterInit(&iter, SCM_WEAK_HASH_TABLE_CORE(ht));
+    while ((e = Scm_HashIterNext(&iter)) != NULL) {
+        if ((ht->weakness & SCM_WEAK_KEY) && weak_entry_dead(e, NULL)) {
+            ndead++;
+        } else {
+            nlive++;
+        }
+    }
+    if (live) *live = nlive;
+    if (dead) *dead = ndead;
+}
+
 void Scm_WeakHashIterInit(ScmWeakHashIter *iter, ScmWeakHashTable *ht)
 {
     Scm_HashIterInit(&iter->iter, SCM_WEAK_HASH_TABLE_CORE(ht));
@@ -401,10 +439,7 @@ int Scm_WeakHashIterNext(ScmWeakHashIter *iter, ScmObj *key, ScmObj *value)
         if (iter->table->weakness & SCM_WEAK_KEY) {
             ScmWeakBox *box = (ScmWeakBox*)e->key;
             ScmObj realkey = SCM_OBJ(Scm_WeakBoxRef(box));
-            if (Scm_WeakBoxEmptyP(box)) {
-                MARK_GONE_ENTRY(iter->table, e);
-                continue;
-            }
+            if (Scm_WeakBoxEmptyP(box)) continue; /* swept later */
             *key = realkey;
         } else {
             *key = (ScmObj)e->key;
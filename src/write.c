@@ -762,6 +762,49 @@ static void write_rec(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
 #undef CHECK_DEPTH
 }
 
+/* Quick check of circular structure.
+   The walk pass is costly, for it is written in Scheme and records
+   every pair and vector in a hashtable.  If we're not writing shared
+   structure, only cycles matter, and most data written out doesn't have
+   one.  So we first trace OBJ in C without recording visited objects;
+   if OBJ consists only of pairs, vectors and objects whose printers
+   don't recurse, and we reach all leaves without going too deep, it
+   can't have a cycle.  Cdr-chains are checked with Floyd's algorithm
+   so that long lists don't count as deep.  Returns FALSE if we're not
+   sure; then the caller should do the full walk. */
+#define ACYCLIC_CHECK_DEPTH  1000
+
+static int write_acyclic_p(ScmObj obj, int depth)
+{
+    if (depth > ACYCLIC_CHECK_DEPTH) return FALSE;
+    if (SCM_PAIRP(obj)) {
+        ScmObj slow = obj;
+        int step = 0;
+        while (SCM_PAIRP(obj)) {
+            if (!write_acyclic_p(SCM_CAR(obj), depth+1)) return FALSE;
+            obj = SCM_CDR(obj);
+            if (++step & 1) continue;
+            slow = SCM_CDR(slow);
+            if (slow == obj) return FALSE;
+        }
+        /* check the tail */
+    }
+    if (SCM_VECTORP(obj)) {
+        ScmSmallInt len = SCM_VECTOR_SIZE(obj);
+        for (ScmSmallInt i=0; i<len; i++) {
+            if (!write_acyclic_p(SCM_VECTOR_ELEMENT(obj, i), depth+1)) {
+                return FALSE;
+            }
+        }
+        return TRUE;
+    }
+    return (!SCM_PTRP(obj)
+            || SCM_NUMBERP(obj)
+            || SCM_SYMBOLP(obj)
+            || SCM_KEYWORDP(obj)
+            || SCM_STRINGP(obj));
+}
+
 /* Write/ss main driver
    This should never be called recursively.
    We modify port->flags and port->writeState; they are cleaned up
@@ -770,6 +813,11 @@ static void write_ss(ScmObj obj, ScmPort *port, ScmWriteContext *ctx)
 {
     SCM_ASSERT(port->writeState == NULL);
 
+    if (SCM_WRITE_MODE(ctx) != SCM_WRITE_SHARED && write_acyclic_p(obj, 0)) {
+        write_rec(obj, port, ctx);
+        return;
+    }
+
     /* pass 1 */
     port->flags |= SCM_PORT_WALKING;
     if (SCM_WRITE_MODE(ctx)==SCM_WRITE_SHARED) port->flags |= SCM_PORT_WRITESS;
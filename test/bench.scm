@@ -0,0 +1,77 @@
+;;
+;; test for gauche.bench
+;;
+
+(use gauche.test)
+
+(test-start "gauche.bench")
+(use gauche.bench)
+(test-module 'gauche.bench)
+
+(define (sum-to n) (let loop ([i 0] [s 0]) (if (= i n) s (loop (+ i 1) (+ s i)))))
+
+(let1 r (benchmark "sum" (^[] (sum-to 100)) :runs 7 :warmup 1
+                   :sample-time 0.001)
+  (test* "result" #t (bench-result? r))
+  (test* "name" "sum" (bench-result-name r))
+  (test* "samples" 7 (vector-length (bench-result-samples r)))
+  (test* "gc samples" 7 (vector-length (bench-result-gc-samples r)))
+  (test* "iterations" #t (>= (bench-result-iterations r) 1))
+  (test* "order of statistics" #t
+         (<= (bench-result-min r)
+             (bench-result-ci-low r)
+             (bench-result-median r)
+             (bench-result-ci-high r)
+             (bench-result-max r)))
+  (test* "mean" #t
+         (<= (bench-result-min r) (bench-result-mean r) (bench-result-max r)))
+  (test* "mad" #t (<= 0 (bench-result-mad r)
+                      (- (bench-result-max r) (bench-result-min r))))
+  (test* "gc time" #t (<= 0 (bench-result-gc-time r)))
+  )
+
+(test* "fixed iterations" 5
+       (bench-result-iterations
+        (benchmark "x" (^[] #f) :runs 3 :warmup 0 :iterations 5)))
+
+(test* "allocation" #t
+       (> (bench-result-allocated
+           (benchmark "alloc" (^[] (make-vector 1000)) :runs 3 :warmup 0
+                      :iterations 100))
+          4000))
+
+(test* "bad runs" (test-error) (benchmark "x" (^[] #f) :runs 0))
+
+(test-section "registry")
+
+(define-benchmark "test/a" (sum-to 10))
+(define-benchmark ("test/b" :runs 2) (sum-to 10))
+(define-benchmark "other/c" (sum-to 10))
+
+(let1 rs (run-benchmarks :select #/^test\// :port #f :runs 3 :warmup 0
+                         :sample-time 0.001)
+  (test* "run-benchmarks" '("test/a" "test/b") (map bench-result-name rs))
+  (test* "run-benchmarks options" '(3 2)
+         (map (^r (vector-length (bench-result-samples r))) rs))
+  (test* "report" #t
+         (boolean (#/^test\/a / (with-output-to-string
+                                  (^[] (report-bench-results rs))))))
+
+  (test-section "json")
+  (let1 baseline (call-with-input-string
+                     (call-with-output-string
+                       (cut write-bench-results-json rs <>))
+                   read-bench-results-json)
+    (test* "roundtrip" '("test/a" "test/b") (map car baseline))
+    (test* "roundtrip median" (bench-result-median (car rs))
+           (assoc-ref (cdar baseline) "median_ns")
+           (^[a b] (< (abs (- a b)) 1e-6)))
+    (test* "compare, no regression" '() (compare-bench-results rs baseline))
+    (test* "compare, regression" '("test/a")
+           (map car
+                (compare-bench-results
+                 rs
+                 `(("test/a" ("median_ns" . 1e-3) ("ci_high_ns" . 1e-3))))))
+    ))
+
+(test-end)
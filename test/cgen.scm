@@ -376,6 +376,11 @@ some_trick();
 (use gauche.cgen.stub)
 (test-module 'gauche.cgen.stub)
 
+;;====================================================================
+(test-section "gauche.cgen.runtime")
+(use gauche.cgen.runtime)
+(test-module 'gauche.cgen.runtime)
+
 ;;====================================================================
 (test-section "gauche.cgen.precomp")
 (use gauche.cgen.precomp)
@@ -183,7 +183,183 @@
              (terminate-all! pool :force-timeout 0.05)
              (job-status xjob))))
 
-  ;; This SEGVs on 0.9.3.3 (test code by @cryks)
+  ;; fork/join with work stealing
+  (let ([pool (make-thread-pool 3)])
+    (define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))
+    (define (pfib n)
+      (if (< n 10)
+        (fib n)
+        (let1 j (spawn pool (^[] (pfib (- n 1))))
+          (+ (pfib (- n 2)) (sync j)))))
+    (test* "spawn/sync" (fib 18)
+           (sync (spawn pool (^[] (pfib 18)))))
+    (test* "sync reraises" (test-error <error> "boom")
+           (sync (spawn pool (^[] (error "boom")))))
+    (test* "wait-all after spawn" #t
+           (wait-all pool 1 #e1e7))
+    (terminate-all! pool))
+
+  (let ([pool (make-thread-pool 3 :affinity 'numa)])
+    (define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))
+    (test* "spawn/sync, numa affinity" (fib 15)
+           (sync (spawn pool (^[] (+ (sync (spawn pool (^[] (fib 14))))
+                                     (fib 13))))))
+    (terminate-all! pool))
+
+  ;; control.future
+  (test-section "control.future")
+  (use control.future)
+  (use gauche.uvector)
+  (test-module 'control.future)
+
+  (test* "future/touch" '(#t 55)
+         (let1 f (future (apply + (iota 11)))
+           (list (future? f) (touch f))))
+  (test* "touch reraises" (test-error <error> "oops")
+         (touch (future (error "oops"))))
+  (test* "nested futures" 120
+         (let loop ([n 5])
+           (if (= n 0) 1 (* n (touch (future (loop (- n 1))))))))
+  (test* "parallel-map list" (map (^x (* x x)) (iota 100))
+         (parallel-map (^x (* x x)) (iota 100)))
+  (test* "parallel-map vector" '#(1 2 3)
+         (parallel-map (^x (+ x 1)) '#(0 1 2) :chunk-size 1))
+  (test* "parallel-map uvector" '#(2 4 6)
+         (parallel-map (^x (* x 2)) '#u8(1 2 3)))
+  (test* "parallel-map empty" '() (parallel-map values '()))
+  (test* "parallel-for-each" 4950
+         (let ([sum 0] [m (make-mutex)])
+           (parallel-for-each (^x (with-locking-mutex m (^[] (inc! sum x))))
+                              (iota 100) :chunk-size 7)
+           sum))
+  (test* "parallel-fold" 499500 (parallel-fold + 0 (iota 1000)))
+  (test* "parallel-fold combine" 1000
+         (parallel-fold (^[x n] (+ n 1)) 0 (make-vector 1000 'x)
+                        :combine + :chunk-size 33))
+
+  (let* ([data (list-tabulate 1000 (^i (modulo (* i 7919) 263)))]
+         [pairs (map cons (iota 1000) data)]
+         [expected (stable-sort-by pairs cdr)])
+    (test* "parallel-sort! vector" (sort data)
+           (vector->list (parallel-sort! (list->vector data) :chunk-size 37)))
+    (test* "parallel-sort! key (stable)" expected
+           (vector->list (parallel-sort! (list->vector pairs)
+                                         :key cdr :chunk-size 50)))
+    (test* "parallel-sort! cmp (stable)" expected
+           (vector->list (parallel-sort! (list->vector pairs)
+                                         (^[a b] (< (cdr a) (cdr b)))
+                                         :chunk-size 13)))
+    (test* "parallel-sort! cmp and key" (reverse (sort data))
+           (vector->list (parallel-sort! (list->vector pairs) > :key cdr
+                                         :chunk-size 64))
+           (^[x y] (equal? x (map cdr y))))
+    (test* "parallel-sort! string keys" (sort (map number->string data))
+           (vector->list (parallel-sort! (list->vector
+                                          (map number->string data))
+                                         :chunk-size 100)))
+    (test* "parallel-sort! s32vector" (sort (map (cut - <> 131) data))
+           (uvector->list (parallel-sort! (list->s32vector
+                                           (map (cut - <> 131) data))
+                                          :chunk-size 7))))
+  (test* "parallel-sort! f64vector" '(-inf.0 -1.5 -0.0 0.0 2.0 +inf.0)
+         (f64vector->list
+          (parallel-sort! (f64vector 2.0 0.0 +inf.0 -0.0 -1.5 -inf.0)
+                          :chunk-size 2)))
+  (test* "parallel-sort! u8vector with cmp" '#u8(9 5 3 1)
+         (parallel-sort! (u8vector 3 9 1 5) > :chunk-size 1))
+  (test* "parallel-sort! empty" '#() (parallel-sort! (vector)))
+  (test* "parallel-sort! large" #t
+         (let1 v (make-f64vector 20000)
+           (dotimes [i 20000]
+             (f64vector-set! v i (* 1.0 (modulo (* i 7919) 10007))))
+           (parallel-sort! v)
+           (let loop ([i 1])
+             (or (= i 20000)
+                 (and (<= (f64vector-ref v (- i 1)) (f64vector-ref v i))
+                      (loop (+ i 1)))))))
+
+  ;; control.fiber
+  (test-section "control.fiber")
+  (use control.fiber)
+  (test-module 'control.fiber)
+
+  (let1 sched (make-fiber-scheduler 2)
+    (test* "spawn-fiber and fiber-join!" '(3 4)
+           (let1 f (spawn-fiber (^[] (values 3 4)) :scheduler sched)
+             (values->list (fiber-join! f))))
+    (test* "fiber-join! reraises" (test-error <error> "boom")
+           (fiber-join! (spawn-fiber (^[] (error "boom")) :scheduler sched)))
+    (test* "fiber-state" '(done error)
+           (let ([f0 (spawn-fiber (^[] 1) :scheduler sched)]
+                 [f1 (spawn-fiber (^[] (raise 'oops)) :scheduler sched)])
+             (fiber-join! f0)
+             (guard (e [else #f]) (fiber-join! f1))
+             (map fiber-state (list f0 f1))))
+    (test* "current-fiber" '(#f #t)
+           (list (current-fiber)
+                 (fiber-join!
+                  (spawn-fiber (^[] (fiber? (current-fiber)))
+                               :scheduler sched))))
+    (test* "fiber-yield! interleaves" '(a b a b)
+           (let ([log '()]
+                 [m (make-mutex)]
+                 [s1 (make-fiber-scheduler 1)])
+             (define (run x)
+               (dotimes [2]
+                 (with-locking-mutex m (^[] (push! log x)))
+                 (fiber-yield!)))
+             ;; Spawn both from a fiber on the same worker, so that neither
+             ;; starts before the other is queued.
+             (fiber-join!
+              (spawn-fiber (^[] (let ([fa (spawn-fiber (^[] (run 'a)))]
+                                      [fb (spawn-fiber (^[] (run 'b)))])
+                                  (fiber-join! fa)
+                                  (fiber-join! fb)))
+                           :scheduler s1))
+             (fiber-scheduler-shutdown! s1)
+             (reverse log)))
+    (test* "many sleeping fibers" 499500
+           (let1 fs (map (^i (spawn-fiber (^[] (fiber-sleep! 0.05) i)
+                                          :scheduler sched))
+                         (iota 1000))
+             (apply + (map fiber-join! fs))))
+    (test* "thread-sleep! in fiber doesn't block the worker" '(b a)
+           (let ([log '()]
+                 [m (make-mutex)]
+                 [s1 (make-fiber-scheduler 1)])
+             (define (log! x) (with-locking-mutex m (^[] (push! log x))))
+             (let ([fa (spawn-fiber (^[] (thread-sleep! 0.1) (log! 'a))
+                                    :scheduler s1)]
+                   [fb (spawn-fiber (^[] (log! 'b)) :scheduler s1)])
+               (fiber-join! fa)
+               (fiber-join! fb)
+               (fiber-scheduler-shutdown! s1)
+               (reverse log))))
+    (test* "fiber-join! from fiber" 55
+           (fiber-join!
+            (spawn-fiber
+             (^[] (apply + (map fiber-join!
+                                (map (^i (spawn-fiber (^[] (fiber-yield!) i)))
+                                     (iota 11)))))
+             :scheduler sched)))
+    (test* "fiber-wait-readable" '(#f #t #\x)
+           (receive (in out) (sys-pipe)
+             (let* ([f0 (spawn-fiber (^[] (fiber-wait-readable in 0.05))
+                                     :scheduler sched)]
+                    [r0 (fiber-join! f0)]
+                    [f1 (spawn-fiber (^[] (and (fiber-wait-readable in)
+                                               (read-char in)))
+                                     :scheduler sched)])
+               (fiber-sleep! 0.05)
+               (write-char #\x out)
+               (flush out)
+               (let1 c (fiber-join! f1)
+                 (close-port in)
+                 (close-port out)
+                 (list r0 (char? c) c)))))
+    (fiber-scheduler-shutdown! sched))
+
+    ;; This SEGVs on 0.9.3.3 (test code by @cryks)
   (test* "thread pool termination" 'terminated
          (let ([t (thread-start! (make-thread (cut undefined)))]
                [pool (make-thread-pool 10)])
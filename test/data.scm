@@ -289,6 +289,132 @@
            (cache-through! c 'd symbol->string)  ; hit
            (cache-stats c))))
 
+;; concurrent cache
+;; With one stripe, the eviction order is deterministic.
+(let ([c (make-concurrent-cache 3 :num-stripes 1)])
+  (test* "Concurrent cache spill" '(#f (a . 1) (c . 3) (d . 4))
+         (begin
+           (cache-write! c 'a 1)
+           (cache-write! c 'b 2)
+           (cache-write! c 'c 3)
+           (cache-check! c 'a)
+           (cache-write! c 'd 4)             ; a gets second chance
+           (list (cache-check! c 'b)
+                 (cache-check! c 'a)
+                 (cache-check! c 'c)
+                 (cache-check! c 'd))))
+  (test* "Concurrent cache spill 2" '((a . 1) (d . 4) #f (e . 5))
+         (begin
+           (cache-write! c 'e 5)             ; all referenced; c goes
+           (list (cache-check! c 'a)
+                 (cache-check! c 'd)
+                 (cache-check! c 'c)
+                 (cache-check! c 'e))))
+  (test* "Concurrent cache evict" '(#f (d . 4) 6)
+         (begin
+           (cache-evict! c 'a)
+           (list (cache-check! c 'a)
+                 (cache-check! c 'd)
+                 (cache-lookup! c 'f 6))))
+  (test* "Concurrent cache clear" '(#f #f)
+         (begin
+           (cache-clear! c)
+           (list (cache-check! c 'd) (cache-check! c 'e)))))
+
+(let ([c (make-concurrent-cache 10 :num-stripes 1 :weigher string-length)])
+  (test* "Concurrent cache weight" '(#f (b . "1234") (c . "12") #f)
+         (begin
+           (cache-write! c 'a "12345")
+           (cache-write! c 'b "1234")
+           (cache-write! c 'c "12")
+           (cache-write! c 'd "12345678901") ; too heavy
+           (list (cache-check! c 'a)
+                 (cache-check! c 'b)
+                 (cache-check! c 'c)
+                 (cache-check! c 'd)))))
+
+(let ([c (make-concurrent-cache 2 :num-stripes 1)])
+  (test* "Concurrent cache stats" '(:hits 1 :misses 4 :evictions 2)
+         (begin
+           (cache-through! c 'a symbol->string)  ; miss
+           (cache-through! c 'b symbol->string)  ; miss
+           (cache-through! c 'a symbol->string)  ; hit
+           (cache-through! c 'c symbol->string)  ; miss, spills b
+           (cache-through! c 'b symbol->string)  ; miss, spills a
+           (cache-stats c))))
+
+(cond-expand
+ [gauche.sys.threads
+  (use gauche.threads)
+  (test* "Concurrent cache from threads" '(4000 #t)
+         (let* ([c (make-concurrent-cache 40 :num-stripes 4)]
+                [ok #t]
+                [ts (map (^_ (thread-start!
+                              (make-thread
+                               (^[]
+                                 (dotimes [i 1000]
+                                   (let1 k (modulo (* i 7) 100)
+                                     (unless (= (cache-through! c k (cut * <> 2))
+                                                (* k 2))
+                                       (set! ok #f))))))))
+                         (iota 4))])
+           (for-each thread-join! ts)
+           (let1 st (cache-stats c)
+             (list (+ (get-keyword :hits st) (get-keyword :misses st))
+                   ok))))]
+ [else])
+
+;;;========================================================================
+(test-section "data.concurrent-hash-table")
+(use data.concurrent-hash-table)
+(test-module 'data.concurrent-hash-table)
+(use gauche.dictionary)
+
+(let1 h (make-concurrent-hash-table 'equal? 4)
+  (test* "put!/get" '(1 2 #f)
+         (begin
+           (concurrent-hash-table-put! h '(a) 1)
+           (concurrent-hash-table-put! h "b" 2)
+           (list (concurrent-hash-table-get h '(a))
+                 (concurrent-hash-table-get h "b")
+                 (concurrent-hash-table-get h 'c #f))))
+  (test* "get (no fallback)" (test-error)
+         (concurrent-hash-table-get h 'c))
+  (test* "update!" 11
+         (begin
+           (concurrent-hash-table-update! h '(a) (cut + <> 10))
+           (concurrent-hash-table-get h '(a))))
+  (test* "delete!" '(#t #f 1)
+         (list (concurrent-hash-table-delete! h "b")
+               (concurrent-hash-table-exists? h "b")
+               (concurrent-hash-table-num-entries h)))
+  (test* "dictionary" '((x . 1) ((a) . 11))
+         (begin
+           (dict-put! h 'x 1)
+           (sort (dict->alist h) (^[a b] (symbol? (car a))))))
+  (test* "dict-comparator" equal-comparator
+         (dict-comparator h))
+  (test* "clear!" 0
+         (begin (concurrent-hash-table-clear! h)
+                (concurrent-hash-table-num-entries h))))
+
+(cond-expand
+ [gauche.sys.threads
+  (use gauche.threads)
+  (test* "update! from threads" '(4000 4000)
+         (let* ([h (make-concurrent-hash-table 'eqv?)]
+                [ts (map (^_ (thread-start!
+                              (make-thread
+                               (^[]
+                                 (dotimes [i 1000]
+                                   (concurrent-hash-table-update!
+                                    h (modulo i 10) (cut + <> 1) 0))))))
+                         (iota 4))])
+           (for-each thread-join! ts)
+           (list (concurrent-hash-table-fold h (^[k v s] (+ v s)) 0)
+                 (* 400 (concurrent-hash-table-num-entries h)))))]
+ [else])
+
 ;;;========================================================================
 (test-section "data.ideque")
 (use data.ideque)
@@ -397,6 +523,7 @@
 (use srfi-27)
 (use gauche.sequence)
 (use util.match)
+(use gauche.uvector)
 
 (let ((rs (make-random-source)))
   (define (do-test data comparator) ; data must be sorted
@@ -540,6 +667,119 @@
                (max 1 1 1 1)))
   )
 
+;; native heap operations on uvectors
+(let ((rs (make-random-source)))
+  (define (do-test data maker)
+    (let* ([len (length data)]
+           [input (shuffle data rs)]
+           [hp (make-binary-heap :storage (maker len))]
+           [hp2 (build-binary-heap (list->uvector (class-of (maker 0)) input))])
+      (test* (format "native heap ~s" (class-of (maker 0)))
+             (list data (reverse data) data (take data (quotient len 2)))
+             (begin
+               (for-each (^e (binary-heap-push! hp e) (binary-heap-check hp))
+                         input)
+               (binary-heap-check hp2)
+               (list (let1 h (binary-heap-copy hp)
+                       (map-in-order (^_ (begin0 (binary-heap-pop-min! h)
+                                           (binary-heap-check h)))
+                                     (iota len)))
+                     (let1 h (binary-heap-copy hp)
+                       (map-in-order (^_ (begin0 (binary-heap-pop-max! h)
+                                           (binary-heap-check h)))
+                                     (iota len)))
+                     (map-in-order (^_ (binary-heap-pop-min! hp2)) (iota len))
+                     (let1 h (binary-heap-copy hp)
+                       (binary-heap-remove! h (^x (>= x (list-ref data (quotient len 2)))))
+                       (binary-heap-check h)
+                       (map-in-order (^_ (binary-heap-pop-min! h))
+                                     (iota (quotient len 2)))))))))
+  (do-test (iota 100) make-s32vector)
+  (do-test (iota 37) make-u8vector)
+  (do-test (map inexact (iota 64 -32)) make-f64vector)
+  (test* "native heap type check" (test-error)
+         (binary-heap-push! (make-binary-heap :storage (make-u8vector 3))
+                            'a))
+  )
+
+(let ()
+  (define (pop-all h)
+    (let loop ([r '()])
+      (if (indexed-heap-empty? h)
+        (reverse r)
+        (receive (id p) (indexed-heap-pop-min! h)
+          (loop (cons (cons id p) r))))))
+
+  (let1 h (make-indexed-heap 10 'fixnum)
+    (test* "indexed-heap basic" '(#t 0 10 #t)
+           (list (indexed-heap? h) (indexed-heap-num-entries h)
+                 (indexed-heap-capacity h) (indexed-heap-empty? h)))
+    (test* "indexed-heap push!" '(5 (2 3) #t #f 30)
+           (begin
+             (for-each (^[id p] (indexed-heap-push! h id p))
+                       '(0 1 2 3 4) '(50 40 3 20 30))
+             (list (indexed-heap-num-entries h)
+                   (values->list (indexed-heap-find-min h))
+                   (indexed-heap-exists? h 4)
+                   (indexed-heap-exists? h 5)
+                   (indexed-heap-priority h 4))))
+    (test* "indexed-heap decrease-key!" '(0 . 1)
+           (begin
+             (indexed-heap-decrease-key! h 0 1)
+             (receive (id p) (indexed-heap-find-min h) (cons id p))))
+    (test* "indexed-heap decrease-key! (larger)" (test-error)
+           (indexed-heap-decrease-key! h 0 100))
+    (test* "indexed-heap decrease-key! (absent)" (test-error)
+           (indexed-heap-decrease-key! h 7 0))
+    (test* "indexed-heap push! (update)" '((2 . 3) (3 . 20) (4 . 30) (0 . 45))
+           (let1 h2 (make-indexed-heap 10 'fixnum)
+             (for-each (^[id p] (indexed-heap-push! h2 id p))
+                       '(0 1 2 3 4) '(1 40 3 20 30))
+             (indexed-heap-push! h2 0 45)
+             (indexed-heap-delete! h2 1)
+             (pop-all h2)))
+    (test* "indexed-heap delete!" '(#t #f ((0 . 1) (2 . 3) (4 . 30) (1 . 40)))
+           (list (indexed-heap-delete! h 3)
+                 (indexed-heap-delete! h 3)
+                 (pop-all h)))
+    (test* "indexed-heap priority (absent)" '(none (test-error))
+           (list (indexed-heap-priority h 0 'none)
+                 (guard (e [else '(test-error)])
+                   (indexed-heap-priority h 0))))
+    (test* "indexed-heap out of range" (test-error)
+           (indexed-heap-push! h 10 0))
+    (test* "indexed-heap fixnum type" (test-error)
+           (indexed-heap-push! h 0 1.5))
+    (test* "indexed-heap clear!" '(#t #f)
+           (begin
+             (indexed-heap-push! h 1 1)
+             (indexed-heap-clear! h)
+             (list (indexed-heap-empty? h) (indexed-heap-exists? h 1)))))
+
+  (let ([rs (make-random-source)]
+        [n 200])
+    (define prios (map (^_ (inexact (random-source-integer rs 1000))) (iota n)))
+    (define expected (sort prios))
+    (define (sorted-prios h) (map cdr (pop-all h)))
+    (test* "build-indexed-heap (vector)" expected
+           (sorted-prios (build-indexed-heap (list->vector prios))))
+    (test* "build-indexed-heap (f64vector)" expected
+           (sorted-prios (build-indexed-heap (list->f64vector prios))))
+    (test* "build-indexed-heap (s32vector, fixnum)" (map exact expected)
+           (sorted-prios (build-indexed-heap (list->s32vector (map exact prios))
+                                             'fixnum)))
+    (test* "indexed-heap decrease-key! (random)" #t
+           (let1 h (build-indexed-heap (list->vector prios))
+             (dotimes [i n]
+               (when (even? i)
+                 (indexed-heap-decrease-key! h i
+                                             (- (indexed-heap-priority h i)
+                                                (random-source-integer rs 500)))))
+             (let1 ps (sorted-prios h)
+               (and (= (length ps) n)
+                    (every <= ps (cdr ps))))))
+    ))
+
 ;;;========================================================================
 ;; ring-buffer
 (test-section "data.ring-buffer")
@@ -627,6 +867,195 @@
 (test-ring-buffer (make-vector 4))
 (test-ring-buffer (make-u8vector 5))
 
+(let ()
+  (define (rb->list rb)
+    (map (cut ring-buffer-ref rb <>) (iota (ring-buffer-num-entries rb))))
+  (define (test-bulk storage src)
+    (let1 rb (make-ring-buffer storage)
+      ;; move the head so that the copy wraps around
+      (ring-buffer-add-back! rb 9)
+      (ring-buffer-remove-front! rb)
+      (test* (format "ring-buffer-add-back!/multi ~s" (class-of storage))
+             '(1 2 3 4 5 6)
+             (begin (ring-buffer-add-back!/multi rb src 1 4)
+                    (ring-buffer-add-back!/multi rb src 4)
+                    (rb->list rb)))
+      (test* (format "ring-buffer-remove-front!/into ~s" (class-of storage))
+             '(4 (1 2 3 4) (5 6))
+             (let1 dest (make-u8vector 4 0)
+               (list (ring-buffer-remove-front!/into rb dest)
+                     (u8vector->list dest)
+                     (rb->list rb))))
+      (test* (format "ring-buffer-remove-front!/into (partial) ~s"
+                     (class-of storage))
+             '(2 #u8(0 5 6 0) #t)
+             (let1 dest (make-u8vector 4 0)
+               (list (ring-buffer-remove-front!/into rb dest 1)
+                     dest
+                     (ring-buffer-empty? rb))))))
+  (test-bulk (make-u8vector 4) '#u8(0 1 2 3 4 5 6))  ; extends the storage
+  (test-bulk (make-vector 4) '#u8(0 1 2 3 4 5 6))    ; element-wise
+
+  (let1 rb (make-ring-buffer (make-u8vector 3) :overflow-handler 'overwrite)
+    (test* "ring-buffer-add-back!/multi overwrite" '(3 4 5)
+           (begin (ring-buffer-add-back!/multi rb '#u8(1 2))
+                  (ring-buffer-add-back!/multi rb '#u8(3 4 5))
+                  (rb->list rb)))
+    (test* "ring-buffer-add-back!/multi overwrite (longer)" '(7 8 9)
+           (begin (ring-buffer-add-back!/multi rb '#u8(5 6 7 8 9))
+                  (rb->list rb))))
+  (let1 rb (make-ring-buffer (make-u8vector 3) :overflow-handler 'error)
+    (test* "ring-buffer-add-back!/multi error" (test-error)
+           (ring-buffer-add-back!/multi rb '#u8(1 2 3 4))))
+  )
+
+(let1 r (make-spsc-ring-buffer (make-s16vector 4))
+  (test* "spsc-ring-buffer basic" '(#t 4 0 #t #f)
+         (list (spsc-ring-buffer? r) (spsc-ring-buffer-capacity r)
+               (spsc-ring-buffer-num-entries r)
+               (spsc-ring-buffer-empty? r) (spsc-ring-buffer-full? r)))
+  (test* "spsc-ring-buffer add/remove" '(#t #t -1 2 none)
+         (list (spsc-ring-buffer-add-back! r -1)
+               (spsc-ring-buffer-add-back! r 2)
+               (spsc-ring-buffer-remove-front! r)
+               (spsc-ring-buffer-remove-front! r)
+               (spsc-ring-buffer-remove-front! r 'none)))
+  (test* "spsc-ring-buffer empty" (test-error)
+         (spsc-ring-buffer-remove-front! r))
+  (test* "spsc-ring-buffer bulk (wrap around)" '(3 #t 0 #s16(1 2 3 4 0 0))
+         (let1 dest (make-s16vector 6 0)
+           (list (spsc-ring-buffer-add-back!/multi r '#s16(1 2 3))
+                 (spsc-ring-buffer-add-back! r 4)
+                 (spsc-ring-buffer-add-back!/multi r '#s16(5 6))
+                 (begin (spsc-ring-buffer-remove-front!/into r dest)
+                        dest))))
+  (test* "spsc-ring-buffer type check" (test-error)
+         (spsc-ring-buffer-add-back!/multi r '#u8(1 2)))
+  )
+
+(cond-expand
+ [gauche.sys.threads
+  (use gauche.threads)
+  (test* "spsc-ring-buffer threads" #t
+         (let* ([n 100000]
+                [r (make-spsc-ring-buffer (make-u32vector 64))]
+                [producer
+                 (thread-start!
+                  (make-thread
+                   (^[]
+                     (let1 v (make-u32vector 16)
+                       (let loop ([i 0])
+                         (when (< i n)
+                           (dotimes [k 16] (u32vector-set! v k (+ i k)))
+                           (let1 m (spsc-ring-buffer-add-back!/multi
+                                    r v 0 (min 16 (- n i)))
+                             (when (zero? m) (thread-yield!))
+                             (loop (+ i m)))))))))]
+                [v (make-u32vector 10)])
+           (let loop ([i 0] [ok #t])
+             (if (= i n)
+               (begin (thread-join! producer) ok)
+               (let1 m (spsc-ring-buffer-remove-front!/into r v)
+                 (when (zero? m) (thread-yield!))
+                 (loop (+ i m)
+                       (and ok
+                            (every (^k (= (u32vector-ref v k) (+ i k)))
+                                   (iota m)))))))))]
+ [else])
+
+;;;========================================================================
+;; timer-wheel
+(test-section "data.timer-wheel")
+(use data.timer-wheel)
+(test-module 'data.timer-wheel)
+
+(let ()
+  ;; We use a fake clock, and small wheels so that cascading and overflow
+  ;; are exercised.
+  (define now 0)
+  (define (make-wheel)
+    (set! now 0)
+    (make-timer-wheel :resolution 1 :bits 2 :levels 2 :clock (^[] now)))
+  (define fired '())
+  (define (fire! x) (^[] (push! fired (cons x now))))
+  (define (advance! w t)
+    (set! now t)
+    (set! fired '())
+    (timer-wheel-advance! w)
+    (reverse fired))
+
+  (let1 w (make-wheel)
+    (test* "timer-wheel basic" '(#t #t 0)
+           (list (timer-wheel? w) (timer-wheel-empty? w)
+                 (timer-wheel-num-timers w)))
+    (test* "timer-wheel-next-timeout (empty)" #f
+           (timer-wheel-next-timeout w))
+    (let ([a (timer-wheel-add! w 3 (fire! 'a))]
+          [b (timer-wheel-add! w 1 (fire! 'b))]
+          [c (timer-wheel-add! w 7 (fire! 'c))]
+          [d (timer-wheel-add! w 30 (fire! 'd))]   ; overflow
+          [e (timer-wheel-add! w 5 (fire! 'e))])
+      (test* "timer-wheel-add!" '(5 #t)
+             (list (timer-wheel-num-timers w) (timer-active? a)))
+      (test* "timer-wheel-next-timeout" 1000000 (timer-wheel-next-timeout w))
+      (test* "timer-wheel-advance!" '((b . 2) (a . 3))
+             (append (advance! w 2) (advance! w 3)))
+      (test* "timer-wheel-cancel!" '(#t #f #f 2)
+             (list (timer-wheel-cancel! w e)
+                   (timer-wheel-cancel! w e)
+                   (timer-active? e)
+                   (timer-wheel-num-timers w)))
+      (test* "timer-wheel-cancel! (fired)" #f (timer-wheel-cancel! w a))
+      (test* "timer-wheel-reschedule!" '(() ((c . 9)))
+             (begin (timer-wheel-reschedule! w c 6)
+                    (list (advance! w 8) (advance! w 9))))
+      (test* "timer-wheel-advance! (overflow)" '((d . 40))
+             (advance! w 40))
+      (test* "timer-wheel-reschedule! (fired)" '(#t (a . 41))
+             (begin (timer-wheel-reschedule! w a 1)
+                    (list (timer-active? a) (car (advance! w 41)))))
+      (test* "timer-wheel-empty?" #t (timer-wheel-empty? w))))
+
+  (let1 w (make-wheel)
+    (test* "timer-wheel add in a thunk" '((a . 1) (b . 2))
+           (begin
+             (timer-wheel-add! w 1 (^[] ((fire! 'a))
+                                        (timer-wheel-add! w 0 (fire! 'b))))
+             (append (advance! w 1) (advance! w 2)))))
+
+  ;; Compare with a naive implementation on random operations.
+  (let ([w (make-wheel)]
+        [rs (make-random-source)]
+        [expected '()])                 ; ((id . expiry) ...)
+    (test* "timer-wheel random operations" #t
+           (let loop ([i 0] [timers '()] [ok #t])
+             (if (= i 500)
+               ok
+               (case (random-source-integer rs 3)
+                 [(0) (let* ([d (random-source-integer rs 40)]
+                             [t (timer-wheel-add! w d (fire! i))])
+                        (push! expected (cons i (+ now (max d 1))))
+                        (loop (+ i 1) (acons i t timers) ok))]
+                 [(1) (if (null? timers)
+                        (loop (+ i 1) timers ok)
+                        (let1 id (car (list-ref timers
+                                                (random-source-integer
+                                                 rs (length timers))))
+                          (timer-wheel-cancel! w (assv-ref timers id))
+                          (set! expected (alist-delete id expected))
+                          (loop (+ i 1) (alist-delete id timers) ok)))]
+                 [else
+                  (let* ([t (+ now (random-source-integer rs 20))]
+                         [r (advance! w t)]
+                         [x (filter (^p (<= (cdr p) t)) expected)])
+                    (set! expected (remove (^p (<= (cdr p) t)) expected))
+                    (loop (+ i 1)
+                          (remove (^p (assv (car p) r)) timers)
+                          (and ok
+                               (equal? (sort (map car r)) (sort (map car x)))
+                               (every (^p (= (cdr p) t)) r))))]))))
+    ))
+
 ;;;========================================================================
 ;; trie
 (test-section "data.trie")
@@ -830,4 +1259,70 @@
     )
   )
 
+;;;========================================================================
+;; da-trie
+(test-section "data.da-trie")
+(use data.da-trie)
+(test-module 'data.da-trie)
+
+(let* ([keys '("a" "ab" "abc" "b" "bcd" "")]
+       [t (make-da-trie keys)])
+  (test* "da-trie-num-entries" 6 (da-trie-num-entries t))
+  (test* "da-trie-get" '(0 1 2 3 4 5) (map (cut da-trie-get t <>) keys))
+  (test* "da-trie-get (fallback)" '(none none none)
+         (map (cut da-trie-get t <> 'none) '("bc" "abcd" "x")))
+  (test* "da-trie-get (error)" (test-error) (da-trie-get t "bc"))
+  (test* "da-trie-exists?" '(#t #f #t)
+         (map (cut da-trie-exists? t <>) '("bcd" "bc" "")))
+  (test* "da-trie-longest-match" '(("abc" . 2) ("b" . 3) ("" . 5))
+         (map (cut da-trie-longest-match t <>) '("abcde" "bx" "xyz")))
+  (test* "da-trie-prefixes" '(("" . 5) ("a" . 0) ("ab" . 1) ("abc" . 2))
+         (da-trie-prefixes t "abcd"))
+  (test* "da-trie-common-prefix-keys" '("ab" "abc")
+         (da-trie-common-prefix-keys t "ab"))
+  (test* "da-trie-common-prefix-keys" '()
+         (da-trie-common-prefix-keys t "abd"))
+  (test* "da-trie-common-prefix-fold" '(("bcd" . 4) ("b" . 3))
+         (da-trie-common-prefix-fold t "b" acons '()))
+  (test* "da-trie-keys" '("" "a" "ab" "abc" "b" "bcd") (da-trie-keys t))
+  (test* "dict-get" 4 (dict-get t "bcd"))
+  (test* "duplicate keys" (test-error) (make-da-trie '("a" "b" "a")))
+  (test* "mixed keys" (test-error) (make-da-trie '("a" #u8(1))))
+  )
+
+(test* "da-trie with values" '("one" "two" #f)
+       (let1 t (make-da-trie '("one" "two") '#("one" "two"))
+         (list (da-trie-get t "one") (da-trie-get t "two")
+               (da-trie-get t "three" #f))))
+
+(test* "da-trie with u8vector keys" '((#u8(0 255) . 1) (#u8() . 0))
+       (let1 t (make-da-trie '(#u8() #u8(0 255) #u8(255)))
+         (list (da-trie-longest-match t '#u8(0 255 3))
+               (da-trie-longest-match t '#u8(0 254)))))
+
+(let* ([strs (delete-duplicates
+              (map (^_ (list->string
+                        (map (^_ (integer->char (+ 97 (random-integer 5))))
+                             (iota (random-integer 8)))))
+                   (iota 500)))]
+       [t (make-da-trie strs)])
+  (test* "da-trie random keys" #t
+         (every (^[s i] (eqv? (da-trie-get t s) i))
+                strs (iota (length strs))))
+  (test* "da-trie random keys (absent)" #f
+         (any (^s (da-trie-exists? t (string-append s "z"))) strs))
+  (test* "da-trie random keys (order)" (sort strs) (da-trie-keys t))
+
+  (let1 file "test.o.datrie"
+    (sys-unlink file)
+    (save-da-trie t file)
+    (dolist [mmap '(#t #f)]
+      (test* #"save-da-trie/load-da-trie (mmap ~mmap)" strs
+             (let1 t2 (load-da-trie file :mmap mmap
+                                    :values (list->vector strs))
+               (map (cut da-trie-get t2 <>) strs))))
+    (test* "load-da-trie (values mismatch)" (test-error)
+           (load-da-trie file :values '#(1 2)))
+    (sys-unlink file)))
+
 (test-end)
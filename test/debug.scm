@@ -33,4 +33,43 @@
                      [_ #f])
                    (call/cc (^x (ra x) #f))))
 
+
+;;----------------------------------------------------------------
+(test-section "vm stats")
+
+(define (vm-stat key) (cadr (assq key (vm-stats))))
+
+(test* "vm-stats keys"
+       '(:calls :generic-dispatches :continuation-saves :stack-flushes
+         :reentries :allocated-bytes)
+       (map car (vm-stats)))
+
+(define (vs-loop n) (if (zero? n) 0 (+ 1 (vs-loop (- n 1)))))
+(define-method vs-generic ((x <integer>)) x)
+
+(test* "vm-stats-reset!" #t
+       (begin (vs-loop 100)
+              (vm-stats-reset!)
+              (< (vm-stat :calls) 100)))
+(test* "vm-stats calls" #t
+       (let1 c (vm-stat :calls)
+         (vs-loop 100)
+         (>= (- (vm-stat :calls) c) 100)))
+(test* "vm-stats generic-dispatches" #t
+       (let1 c (vm-stat :generic-dispatches)
+         (vs-generic 1)
+         (> (vm-stat :generic-dispatches) c)))
+(test* "vm-stats continuation-saves" #t
+       (let1 c (vm-stat :continuation-saves)
+         (call/cc (^k (k 1)))
+         (> (vm-stat :continuation-saves) c)))
+(test* "vm-stats allocated-bytes" #t
+       (let1 c (vm-stat :allocated-bytes)
+         (vm-stats-count-allocation! #t)
+         (make-vector 1000)
+         (vm-stats-count-allocation! #f)
+         (>= (- (vm-stat :allocated-bytes) c) 1000)))
+(test* "vm-stats of the current thread" (vm-stats) (vm-stats (current-thread))
+       (^[a b] (equal? (map car a) (map car b))))
+
 (test-end)
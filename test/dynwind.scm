@@ -526,6 +526,19 @@
         (^[] ((sprintf (^[] (fmt s))) "world")))
   )
 
+;; Partial continuation captured on top of in-stack frames; only the
+;; frames above reset are moved to the heap, so check the frames below
+;; are still intact.
+(let ()
+  (define (deep n thunk)
+    (if (= n 0) (thunk) (+ n (deep (- n 1) thunk))))
+  (test "shift over deep frames" 5071
+        (^[] (deep 100 (^[] (let1 x 10 (reset (+ x (shift k (k (k 1))))))))))
+  (test "shift over deep frames, env from below" 1295
+        (^[] (let1 y 5
+               (+ y (deep 50 (^[] (reset (+ y (shift k (k (k y)))))))))))
+  )
+
 ;; To be written:
 ;;  - tests for interactions of dynamic handlers and partial continuaions.
 ;;  - tests for interactions of partial and full continuations.
@@ -243,6 +243,14 @@
          (let1 x (guard (e (else aaa)) (foo))
            (list x aaa))))
 
+(test* "guard (no raise, multiple values)" '(1 2 3)
+       (receive r (guard (e (else 'oops)) (values 1 2 3)) r))
+
+(test* "guard (handler restored after many entries)" '(1000 caught)
+       (let loop ([i 0] [n 0])
+         (if (= i 1000)
+           (list n (guard (e (else 'caught)) (raise 'x)))
+           (loop (+ i 1) (guard (e (else n)) (+ n 1))))))
 
 ;;--------------------------------------------------------------------
 (test-section "unwind-protect")
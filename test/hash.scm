@@ -57,6 +57,23 @@
                         (hash (car p))))
               data)))
 
+(let ()
+  (define (deep n)
+    (let loop ([n n] [r '()])
+      (if (zero? n) r (loop (- n 1) (list n (vector r n))))))
+  (test* "default-hash deeply nested" #t
+         (= (default-hash (deep 30)) (default-hash (deep 30))))
+  (test* "portable-hash deeply nested" #t
+         (= (portable-hash (deep 30) 0) (portable-hash (deep 30) 0)))
+  (test* "default-hash very deeply nested" #t
+         (let1 d (let loop ([n 100000] [r '()])
+                   (if (zero? n) r (loop (- n 1) (list r))))
+           (integer? (default-hash d)))))
+
+(test* "default-hash uvector" '(#t #t)
+       (list (= (default-hash '#u8(1 2 3)) (default-hash '#u8(1 2 3)))
+             (= (default-hash '#s32(-1 2)) (default-hash '#s32(-1 2)))))
+
 ;;------------------------------------------------------------------
 (test-section "eq?-hash")
 
@@ -201,6 +218,13 @@
 (test* "copy" #t
        (lset= equal? (hash-table-values h-eqv-copied) '(8 "b" #\c -1 4 5 PI)))
 
+;; the copied table must keep working after it's extended
+(test* "copy and extend" '(8 "b" #\c -1 PI)
+       (let1 h (hash-table-copy h-eqv-copied)
+         (dotimes [i 100] (hash-table-put! h i i))
+         (map (cut hash-table-get h <> #f)
+              '(a b 2.0 87592876592374659237845692374523694756 377/120))))
+
 ;;------------------------------------------------------------------
 (test-section "equal?-hash")
 
@@ -370,6 +394,42 @@
          (map cdr x)
          (map (^p (hash-table-comparator (make-hash-table (car p)))) x)))
 
+;; Comparators with builtin equality and hash use builtin hash procedures,
+;; while the type test and the comparator are kept.
+(let* ([c (make-comparator symbol? eq? #f eq-hash)]
+       [h (make-hash-table c)])
+  (test* "builtin equivalence" '(general 1 #f)
+         (begin (hash-table-put! h 'a 1)
+                (list (hash-table-type h)
+                      (hash-table-get h 'a)
+                      (hash-table-get h 'b #f))))
+  (test* "builtin equivalence - comparator" c (hash-table-comparator h))
+  (test* "builtin equivalence - domain error" (test-error)
+         (hash-table-put! h "a" 2)))
+(let1 h (make-hash-table (make-comparator string? string=? #f default-hash))
+  (test* "builtin equivalence (string=?)" '(1 1)
+         (begin (hash-table-put! h "ab" 1)
+                (list (hash-table-get h "ab")
+                      (hash-table-get h (string-copy "ab"))))))
+
+;; Hash functions are called from C by Scm_ApplyRec.  Subrs with fixed
+;; arguments are called directly, so check the cases the VM has to
+;; take over.
+(let ([p (delay (+ 1 2))]
+      [h (make-hash-table (make-comparator #t eq? #f force))])
+  (test* "subr hash function running Scheme code" '(x 3)
+         (begin (hash-table-put! h p 'x)
+                (list (hash-table-get h p #f) (force p)))))
+(test* "subr hash function raising an error" (test-error)
+       (hash-table-put! (make-hash-table (make-comparator #t eqv? #f car))
+                        1 1))
+(test* "hash function recovering from an error" 'z
+       (let1 h (make-hash-table
+                (make-comparator #t eqv? #f
+                                 (^k (guard (e [else 0]) (car k)))))
+         (hash-table-put! h 1 'z)
+         (hash-table-get h 1)))
+
 ;;------------------------------------------------------------------
 (test-section "iterators")
 
@@ -411,6 +471,44 @@
          (list (assoc "a" a)
                (assoc "b" a))))
 
+;;------------------------------------------------------------------
+(test-section "reserve and compact")
+
+(define (num-buckets h) (get-keyword :num-buckets (hash-table-stat h)))
+
+(test* "hash-table-reserve!" '(#t #t)
+       (let* ([h (make-hash-table 'eqv?)]
+              [_ (hash-table-reserve! h 1000)]
+              [n (num-buckets h)])
+         (dotimes [i 1000] (hash-table-put! h i (* i i)))
+         (list (= n (num-buckets h))
+               (every (^i (eqv? (hash-table-get h i #f) (* i i)))
+                      (iota 1000)))))
+
+(test* "hash-table-reserve! (doesn't shrink)" #t
+       (let1 h (make-hash-table 'eq? 256)
+         (hash-table-reserve! h 1)
+         (= (num-buckets h) 256)))
+
+(test* "hash-table-compact!" '(#t 10 #t)
+       (let1 h (make-hash-table 'equal?)
+         (dotimes [i 1000] (hash-table-put! h (list i) i))
+         (let1 n (num-buckets h)
+           (dotimes [i 990] (hash-table-delete! h (list i)))
+           (hash-table-compact! h)
+           (list (< (num-buckets h) n)
+                 (hash-table-num-entries h)
+                 (every (^i (eqv? (hash-table-get h (list i) #f) i))
+                        (iota 10 990))))))
+
+(test* "hash-table-compact! (empty)" 0
+       (let1 h (make-hash-table 'string=?)
+         (dotimes [i 100] (hash-table-put! h (number->string i) i))
+         (hash-table-clear! h)
+         (hash-table-compact! h)
+         (hash-table-put! h "a" 0)
+         (hash-table-get h "a")))
+
 (test-module 'gauche.hashutil) ; autoloaded module
 
 (test-end)
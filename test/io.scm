@@ -36,6 +36,28 @@
          (close-input-port p)
          s))
 
+(test* "open-input-file :access-pattern" '(abcde abcde abcde)
+       (map (^[pat]
+              (let* ([p (open-input-file "tmp2.o" :access-pattern pat)]
+                     [s (read p)])
+                (close-input-port p)
+                s))
+            '(#f sequential random)))
+
+(test* "open-input-file :access-pattern (bad)" (test-error)
+       (open-input-file "tmp2.o" :access-pattern 'backward))
+
+(test* "open-input-file :buffer-size" '(#\a #\b bcde)
+       (let* ([p (open-input-file "tmp2.o" :buffer-size 1)]
+              [a (read-char p)]
+              [b (peek-char p)]
+              [s (read p)])
+         (close-input-port p)
+         (list a b s)))
+
+(test* "open-input-file :buffer-size (bad)" (test-error)
+       (open-input-file "tmp2.o" :buffer-size -1))
+
 (test* "open-output-file :if-exists :error" (test-error)
        (open-output-file "tmp2.o" :if-exists :error))
 
@@ -190,6 +212,214 @@
              (port-fd-dup! (open-input-string "") p1))))
   )) ; !gauche.os.windows
 
+;;-------------------------------------------------------------------
+(test-section "many buffered ports")
+
+;; Exercises extension of the active buffered port table.
+(sys-unlink "tmp1.o")
+(test* "flush-all-ports with many ports" '(200 400)
+       (let1 ps (map (^_ (open-output-file "tmp1.o" :if-exists :append))
+                     (iota 200))
+         (for-each (cut write-char #\x <>) ps)
+         (flush-all-ports)
+         (let1 n (string-length (call-with-input-file "tmp1.o" port->string))
+           (for-each (cut write-char #\y <>) ps)
+           (for-each close-output-port ps)
+           (flush-all-ports)
+           (list n (string-length
+                    (call-with-input-file "tmp1.o" port->string))))))
+
+;;-------------------------------------------------------------------
+(test-section "copy-port between files")
+
+(sys-unlink "tmp1.o")
+(with-output-to-file "tmp1.o"
+  (^[] (dotimes [i 10000] (format #t "~5d\n" i))))
+
+(let1 content (call-with-input-file "tmp1.o" port->string)
+  (test* "copy-port" (list 60000 content)
+         (let1 n (call-with-input-file "tmp1.o"
+                   (^i (call-with-output-file "tmp2.o"
+                         (^o (copy-port i o)))))
+           (list n (call-with-input-file "tmp2.o" port->string))))
+
+  (test* "copy-port (buffered data)"
+         (list 50000 (string-append "abc" (substring content 7 50007)))
+         (let1 n (call-with-input-file "tmp1.o"
+                   (^i (call-with-output-file "tmp2.o"
+                         (^o (read-block 7 i)
+                             (display "abc" o)
+                             (copy-port i o :size 50000)))))
+           (list n (call-with-input-file "tmp2.o" port->string))))
+
+  (test* "copy-port (after peek)"
+         (list 59999 (substring content 1 60000))
+         (let1 n (call-with-input-file "tmp1.o"
+                   (^i (call-with-output-file "tmp2.o"
+                         (^o (read-char i)
+                             (peek-char i)
+                             (copy-port i o :unit 'byte)))))
+           (list n (call-with-input-file "tmp2.o" port->string))))
+
+  (test* "copy-port (append)" (* 2 60000)
+         (begin
+           (call-with-input-file "tmp1.o"
+             (^i (call-with-output-file "tmp2.o" (^o (copy-port i o))
+                   :if-exists :supersede)))
+           (call-with-input-file "tmp1.o"
+             (^i (call-with-output-file "tmp2.o" (^o (copy-port i o))
+                   :if-exists :append)))
+           (string-length (call-with-input-file "tmp2.o" port->string))))
+  )
+
+;;-------------------------------------------------------------------
+(test-section "mmap file port")
+
+(cond-expand
+ (gauche.os.windows #f)
+ (else
+  (let1 content (call-with-input-file "tmp1.o" port->string)
+    (test* "open-input-mmap-file" content
+           (let1 p (open-input-mmap-file "tmp1.o")
+             (begin0 (port->string p)
+                     (close-input-port p))))
+    (test* "open-input-mmap-file read-line" '("    0" "    1" "    2")
+           (let1 p (open-input-mmap-file "tmp1.o")
+             (begin0 (list (read-line p) (read-line p) (read-line p))
+                     (close-input-port p))))
+    (test* "open-input-mmap-file seek" '(" 9999" 30000 "00" 60000)
+           (let1 p (open-input-mmap-file "tmp1.o")
+             (let* ([a (begin (port-seek p -6 SEEK_END) (read-line p))]
+                    [b (port-seek p 30000)]
+                    [c (begin (port-seek p 3 SEEK_CUR) (read-line p))]
+                    [d (port-tell (begin (port-seek p 0 SEEK_END) p))])
+               (close-input-port p)
+               (list a b c d))))
+    (test* "open-input-mmap-file get-remaining-input-string"
+           (substring content 59988 60000)
+           (let1 p (open-input-mmap-file "tmp1.o")
+             (port-seek p 59988)
+             (begin0 (get-remaining-input-string p)
+                     (close-input-port p))))
+    )
+  (test* "open-input-mmap-file (empty)" (eof-object)
+         (begin (with-output-to-file "tmp2.o" (cut display ""))
+                (call-with-port (open-input-mmap-file "tmp2.o") read-char)))
+  (test* "open-input-mmap-file (nonexistent)" #f
+         (begin (sys-unlink "tmp2.o")
+                (open-input-mmap-file "tmp2.o" :if-does-not-exist #f)))
+  (test* "open-input-mmap-file (nonexistent)" (test-error)
+         (open-input-mmap-file "tmp2.o"))
+  ))
+
+;;-------------------------------------------------------------------
+(test-section "write-gather")
+
+(test* "write-gather (string port)" "abcAB\x00;def"
+       (call-with-output-string
+         (^o (write-gather '("abc" #u8(65 66 0) "" "def") o))))
+
+(test* "write-gather (file port)" "xyzabcAB\x00;def"
+       (begin
+         (call-with-output-file "tmp2.o"
+           (^o (display "xyz" o)
+               (write-gather '("abc" #u8(65 66 0) "" "def") o)))
+         (call-with-input-file "tmp2.o" port->string)))
+
+(test* "write-gather (empty)" "xyz"
+       (begin
+         (call-with-output-file "tmp2.o"
+           (^o (display "xyz" o) (write-gather '() o)))
+         (call-with-input-file "tmp2.o" port->string)))
+
+(test* "write-gather (bad item)" (test-error)
+       (write-gather '("abc" abc) (open-output-string)))
+
+(let1 big (make-string 100000 #\z)
+  (test* "large write on buffered port" (string-append "abc" big "def")
+         (begin
+           (call-with-output-file "tmp2.o"
+             (^o (display "abc" o) (display big o) (display "def" o)))
+           (call-with-input-file "tmp2.o" port->string))))
+
+;; more items than IOV_MAX
+(test* "write-gather (many items)" (* 3000 7)
+       (begin
+         (call-with-output-file "tmp2.o"
+           (^o (write-gather (make-list 3000 "abcdefg") o)))
+         (string-length (call-with-input-file "tmp2.o" port->string))))
+
+;;-------------------------------------------------------------------
+(test-section "read-block-view")
+
+(test* "read-block-view (string port)" '(#u8(97 98) #u8(99 100 101) #t)
+       (let1 p (open-input-string "abcde")
+         (let* ([a (read-block-view 2 p)]
+                [b (read-block-view 10 p)])
+           (list a b (eof-object? (read-block-view 1 p))))))
+
+(test* "read-block-view (after peek)" '(#\a #u8(97) #u8(98 99))
+       (let1 p (open-input-string "abc")
+         (let1 c (peek-char p)
+           (list c (read-block-view 1 p) (read-block-view 5 p)))))
+
+;; Each view is only valid until the next read, so check it right away.
+(test* "read-block-view (file port)" '(#t #t #t)
+       (begin
+         (call-with-output-file "tmp2.o" (cut display "xyzabc" <>))
+         (call-with-input-file "tmp2.o"
+           (^p (let* ([a (equal? (read-block-view 4 p) #u8(120 121 122 97))]
+                      [b (equal? (read-block-view 4 p) #u8(98 99))])
+                 (list a b (eof-object? (read-block-view 4 p))))))))
+
+(test* "read-block-view (immutable)" #t
+       (uvector-immutable? (read-block-view 2 (open-input-string "abc"))))
+
+(test* "read-block-view (zero)" #u8()
+       (read-block-view 0 (open-input-string "abc")))
+
+;;-------------------------------------------------------------------
+(test-section "non-blocking ports")
+
+(test* "port-nonblocking? (string port)" #f
+       (port-nonblocking? (open-input-string "abc")))
+(test* "port-nonblocking? setter (string port)" (test-error)
+       (set! (port-nonblocking? (open-input-string "abc")) #t))
+
+(cond-expand
+ (gauche.os.windows #f)
+ (else
+  (define (would-block? thunk)
+    (guard (e [(and (condition-has-type? e <system-error>)
+                    (eqv? (condition-ref e 'errno) EAGAIN))
+               #t])
+      (thunk)
+      #f))
+
+  (receive (in out) (sys-pipe)
+    (test* "port-nonblocking? (pipe)" '(#f #t #f)
+           (let1 a (port-nonblocking? in)
+             (set! (port-nonblocking? in) #t)
+             (let1 b (port-nonblocking? in)
+               (set! (port-nonblocking? in) #f)
+               (list a b (port-nonblocking? in)))))
+    (set! (port-nonblocking? in) #t)
+    (test* "read from empty non-blocking pipe" #t
+           (would-block? (cut read-byte in)))
+    (test* "read from non-blocking pipe" '(# #)
+           (begin (display "ab" out) (flush out)
+                  (let1 c (read-char in) (list c (read-char in)))))
+    (test* "read from empty non-blocking pipe again" #t
+           (would-block? (cut read-char in)))
+    (set! (port-nonblocking? out) #t)
+    (test* "write to full non-blocking pipe" #t
+           (would-block? (^[] (dotimes [i 1000000]
+                                (display "abcdefghij" out)))))
+    ;; OUT still has pending output, which now gets EPIPE.
+    (close-port in)
+    (guard (e [else #f]) (close-port out)))
+  ))
+
 ;;-------------------------------------------------------------------
 (test-section "input ports")
 
@@ -281,6 +511,39 @@
                     [c3 (peek-char _)])
                (list l1 l2 l3 (eof-object? c3))))))
 
+(test* "read-line (mix, buffered)" '("a" "b" "c" #t)
+       (call-with-input-file "tmp1.o"
+         (^_ (let* ([l1 (read-line _)]
+                    [l2 (read-line _)]
+                    [l3 (read-line _)])
+               (list l1 l2 l3 (eof-object? (read-line _)))))))
+(test* "read-line (mix, string)" '("a" "b" "" "c" "" "d" #t)
+       (call-with-input-string "a\r\nb\n\rc\r\rd"
+         (^_ (let loop ([r '()])
+               (let1 l (read-line _)
+                 (if (eof-object? l)
+                   (reverse (cons #t r))
+                   (loop (cons l r))))))))
+
+;; lines longer than the port buffer
+(let* ([l1 (make-string 20000 #\a)]
+       [l2 (string-append (make-string 9000 #\b) "\r" (make-string 9000 #\c))]
+       [l3 (make-string 30000 #\あ)])
+  (with-output-to-file "tmp1.o"
+    (^[] (display l1) (newline) (display l2) (newline) (display l3)))
+  (test* "read-line (long lines)" `(,l1 ,(make-string 9000 #\b)
+                                    ,(make-string 9000 #\c) ,l3 #t)
+         (call-with-input-file "tmp1.o"
+           (^_ (let* ([a (read-line _)]
+                      [b (read-line _)]
+                      [c (read-line _)]
+                      [d (read-line _)])
+                 (list a b c d (eof-object? (read-line _)))))))
+  (test* "read-line (long lines, line count)" 4
+         (call-with-input-file "tmp1.o"
+           (^_ (read-line _) (read-line _) (read-line _) (read-line _)
+               (port-current-line _)))))
+
 (with-output-to-file "tmp1.o"
   (cut for-each write-byte '(#x80 #xff #x80 #xff #x80 #x0d #x0a #x0d #x0a)))
 (test* "read-line (bad sequence)" '(5 0)
@@ -781,6 +1044,25 @@
 ;; regression check for format/ss
 (test* "format/ss" "z  " (format/ss "~v,a" 3 'z))
 
+;; pre-compiled and cached formatters
+(let1 f (formatter "~a: ~s")
+  (test* "formatter" "x: \"y\"" (f #f 'x "y"))
+  (test* "formatter (reuse)" "1: 2" (f #f 1 2))
+  (test* "formatter (port)" "a: b"
+         (call-with-output-string (^p (f p 'a 'b))))
+  (test* "formatter (too few args)" (test-error) (f #f 1))
+  (test* "formatter (bad dest)" (test-error) (f "x" 1 2)))
+(test* "formatter (controls)" "(1 2 ...)"
+       ((formatter "~s" (make-write-controls :print-length 2)) #f '(1 2 3 4)))
+(test* "format (same literal)" '("0-0" "1-1" "2-2")
+       (map (^i (format #f "~a-~a" i i)) '(0 1 2)))
+(test* "format (mutable string)" '("<1>" "[2]")
+       (let1 s (string-copy "<~a>")
+         (let1 r1 (format #f s 1)
+           (string-set! s 0 #\[)
+           (string-set! s 3 #\])
+           (list r1 (format #f s 2)))))
+
 ;;-------------------------------------------------------------------
 (test-section "some corner cases in list reader")
 
@@ -157,6 +157,30 @@
 (test* "circular list involving abbrev syntax" "#0=((quote . #0#))"
        (write-to-string (cdr #0='#0#) write/ss))
 
+;; write (not write/ss) first checks for cycles without the walk pass.
+(test* "write acyclic" "((a b) (a b) #(\"x\" (a b)) . c)"
+       (let1 x '(a b)
+         (write-to-string (list* x x (vector "x" x) 'c))))
+(test* "write long acyclic list" (iota 100000)
+       (read-from-string (write-to-string (iota 100000))))
+(test* "write deeply nested acyclic list" 2000
+       (let1 x (fold (^[_ a] (list a)) 'z (iota 2000))
+         (let loop ([y (read-from-string (write-to-string x))] [n 0])
+           (if (pair? y) (loop (car y) (+ n 1)) n))))
+(test* "write circular (cdr)" "#0=(a b c . #0#)"
+       (write-to-string (circular-list 'a 'b 'c)))
+(test* "write circular (cdr, long)" #t
+       (let1 x (apply circular-list (iota 10000))
+         (boolean (#/^#0=\(0 1 2 .* 9999 \. #0#\)$/ (write-to-string x)))))
+(test* "write circular (car)" "(x #0=(a (b . #0#)))"
+       (let1 x (list 'a (list 'b 'c))
+         (set-cdr! (cadr x) x)
+         (write-to-string (list 'x x))))
+(test* "write circular (vector)" "#(1 #0=#(2 #0#))"
+       (let1 x (vector 2 #f)
+         (vector-set! x 1 x)
+         (write-to-string (vector 1 x))))
+
 (define-class <foo> ()
   ((a :init-keyword :a)
    (b :init-keyword :b)))
@@ -310,6 +334,35 @@
          [(or gauche.ces.eucjp gauche.ces.sjis) "\u3000a"]
          [else "a"])))
 
+;;===============================================================
+;; The reader scans the port buffer directly for simple tokens.
+;; Make sure tokens across buffer boundaries are read correctly.
+;;
+
+(test-section "reading from port buffer")
+
+(let ([data "(abc 123 -45 +6 \"str\"\n \"multi\nline\" ; comment\n\
+              1+ - 12. 4611686018427387904 \"esc\\n\\\"\" Abc |s y| x)"]
+      [expected '(abc 123 -45 6 "str" "multi\nline"
+                  1+ - 12.0 4611686018427387904 "esc\n\"" Abc |s y| x)])
+  (define (read-all p)
+    (let loop ([r '()])
+      (let1 x (read p)
+        (if (eof-object? x)
+          (list (reverse r) (port-current-line p))
+          (loop (cons x r))))))
+  (test* "string port" `((,expected) 4)
+         (call-with-input-string data read-all))
+  (test* "string port (sequence)" `(,expected 4)
+         (call-with-input-string (string-copy data 1
+                                              (- (string-length data) 1))
+           read-all))
+  (with-output-to-file "test.o" (cut display data))
+  (dolist [size '(1 2 3 5 7 16 4096)]
+    (test* #"file port (buffer-size ~size)" `((,expected) 4)
+           (call-with-input-file "test.o" read-all :buffer-size size)))
+  (sys-unlink "test.o"))
+
 ;;===============================================================
 ;; Interference between srfi-10 and shared structure
 ;;
@@ -233,6 +233,41 @@
 (test* "fold" 45 (fold + 0 (generator->lseq (giota 10))))
 (test* "equal?" #t (equal? '(0 1 2 3 4) (generator->lseq (giota 5))))
 
+(let ()
+  (define (chunks . cs)
+    (^[] (if (null? cs) (eof-object) (pop! cs))))
+  (test* "chunked-generator->lseq" '()
+         (chunked-generator->lseq (chunks)))
+  (test* "chunked-generator->lseq" '()
+         (chunked-generator->lseq (chunks '#() "")))
+  (test* "chunked-generator->lseq" '(0 1 2 #\a #\b 3 1.5 x)
+         (chunked-generator->lseq (chunks '#(0 1 2) "" "ab" '#u8(3)
+                                          '#() '#f64(1.5) '#(x))))
+  (test* "chunked-generator->lseq (lazyness)" '(a b)
+         (take (chunked-generator->lseq (^[] '#(a b))) 2))
+  (test* "chunked-generator->lseq (lazyness)" 'c
+         (caddr (chunked-generator->lseq
+                 (let1 cs (list '#(a b) '#(c))
+                   (^[] (if (null? cs) (error "oof") (pop! cs)))))))
+  (test* "chunked-generator->lseq (lazyness)" (test-error)
+         (cadddr (chunked-generator->lseq
+                  (let1 cs (list '#(a b) '#(c))
+                    (^[] (if (null? cs) (error "oof") (pop! cs)))))))
+  (test* "chunked-generator->lseq (bad chunk)" (test-error)
+         (length (chunked-generator->lseq (chunks '#(a) 'b))))
+  )
+
+(let ([s (string-append (make-string 100 #\x) "\u3042y")]
+      [ls (map (^i (number->string i)) (iota 200))])
+  (test* "port->char-lseq" (string->list s)
+         (port->char-lseq (open-input-string s)))
+  (test* "port->char-lseq" '() (port->char-lseq (open-input-string "")))
+  (test* "port->string-lseq" ls
+         (port->string-lseq (open-input-string
+                             (apply string-append
+                                    (map (cut string-append <> "\n") ls)))))
+  )
+
 (test* "liota" '(0 1 2 3 4) (liota 5))
 (test* "liota" '(0.0 1.0 2.0 3.0 4.0) (liota 5 0.0))
 (test* "liota" '(0 1 2 3 4) (take (liota) 5))
@@ -27,6 +27,38 @@
   (ensure-error "list-set!" (^k (list-set! (list 'a 'b 'c 'd 'e) k 0)))
   )
 
+;;--------------------------------------------------------------------------
+(test-section "construction")
+
+;; Lists with known length are allocated in blocks of pairs; check
+;; lengths around the block boundary, mutation and pair attributes.
+(dolist [n '(0 1 2 3 31 32 33 34 35 100)]
+  (test* #"vector->list, list-copy and make-list (~n)" `(,n ,n ,n #t #f)
+         (let* ([v (list->vector (iota n))]
+                [l (vector->list v)]
+                [c (list-copy l)]
+                [m (make-list n 'x)])
+           (list (length l) (length c) (length m)
+                 (and (equal? l (iota n)) (equal? c l)
+                      (every (cut eq? 'x <>) m))
+                 (let loop ([ps (list l c m)])
+                   (cond [(null? ps) #f]
+                         [(pair? (car ps))
+                          (or (extended-pair? (car ps))
+                              (loop (cons (cdar ps) (cdr ps))))]
+                         [else (loop (cdr ps))]))))))
+
+(test* "list-copy of dotted list" '((0 1 2 3 4 . z) #t)
+       (let* ([l '(0 1 2 3 4 . z)]
+              [c (list-copy l)])
+         (list c (not (eq? c l)))))
+
+(test* "mutating block-allocated list" '(0 1 (a) 40 . 50)
+       (rlet1 l (vector->list #(0 1 2 3 4 5 6))
+         (set-car! (cddr l) '(a))
+         (set-cdr! (cdddr l) 50)
+         (set-car! (cdddr l) 40)))
+
 ;;--------------------------------------------------------------------------
 (test-section "iota")
 
@@ -257,6 +289,25 @@
 (test* "delete-duplicates!" '("A" "b" "c" "d" "e")
        (delete-duplicates! '("A" "b" "a" "B" "c" "d" "a" "e") string-ci=?))
 
+;; Longer lists switch to hash tables internally.  The results must be
+;; the same as the linear search.
+(let ([data (append (map (^i (list (modulo i 17) (number->string (modulo i 13))))
+                         (iota 200))
+                    '(a b c "x" 1.0 1 a "x"))]
+      [linear (^[lis =] (delete-duplicates lis (^[a b] (= a b))))])
+  (test* "delete-duplicates (long, equal?)" (linear data equal?)
+         (delete-duplicates data))
+  (test* "delete-duplicates (long, eqv?)" (linear (map car data) eqv?)
+         (delete-duplicates (map car data) eqv?))
+  (test* "delete-duplicates! (long, equal?)" (linear data equal?)
+         (delete-duplicates! (list-copy data)))
+  (test* "delete-duplicates (long, with identifier)"
+         '(a 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20
+           21 22 23 24 25 26 27 28 29 30 31 32 33 34 35 36 37 38 39)
+         (delete-duplicates
+          (append '(a) (iota 40) (list ((with-module gauche.internal make-identifier)
+                                        'a (current-module) '()))))))
+
 (test* "any" #f (any even? '()))
 
 (test* "any" #f (any even? '(1 3)))
@@ -539,6 +590,21 @@
                  (cdr-cycle (car-cycle 1 2 3) (car-cycle 1 2 3 1 2 3 1))))
   )
 
+;; Nested structures, compared in C with an explicit stack until they
+;; get too large.
+(let ()
+  (define (deep n leaf)
+    (let loop ([n n] [r leaf])
+      (if (zero? n) r (loop (- n 1) (list r (vector n) n)))))
+  (test* "equal? nested" #t (equal? (deep 100 'a) (deep 100 'a)))
+  (test* "equal? nested" #f (equal? (deep 100 'a) (deep 100 'b)))
+  (test* "equal? nested" #f (equal? (deep 100 'a) (deep 99 'a)))
+  (test* "equal? deeply nested" #t (equal? (deep 100000 'a) (deep 100000 'a)))
+  (test* "equal? deeply nested" #f (equal? (deep 100000 'a) (deep 100000 'b)))
+  (test* "equal? improper tail" '(#t #f)
+         (list (equal? '(1 (2) . #(3 (4))) '(1 (2) . #(3 (4))))
+               (equal? '(1 (2) . #(3 (4))) '(1 (2) . #(3 (5)))))))
+
 ;;--------------------------------------------------------------------------
 
 (test-section "monotonic-merge")
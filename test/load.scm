@@ -78,6 +78,37 @@
           (eval '(require "test.o/d") (interaction-environment))
           (eval 'z m))))
 
+;;----------------------------------------------------------------
+(test-section "searching load paths")
+
+(rmrf "test.o")
+(sys-mkdir "test.o" #o777)
+(sys-mkdir "test.o/sub" #o777)
+(sys-mkdir "test.o/d.scm" #o777)
+(with-output-to-file "test.o/x.scm" (^[] (write '(define x 1))))
+(with-output-to-file "test.o/sub/y.sci" (^[] (write '(define y 1))))
+
+(let ([find (^[name] (cond [((with-module gauche.internal find-load-file)
+                             name '("test.o/nonexistent" "test.o")
+                             '(".sld" ".sci" ".scm"))
+                            => car]
+                           [else #f]))])
+  (test* "find file" "test.o/x.scm" (find "x"))
+  (test* "find file with exact name" "test.o/x.scm" (find "x.scm"))
+  (test* "find file in subdirectory" "test.o/sub/y.sci" (find "sub/y"))
+  (test* "skip directory" #f (find "d"))
+  (test* "nonexistent subdirectory" #f (find "bus/y"))
+  (test* "added file" "test.o/z.scm"
+         (begin
+           (with-output-to-file "test.o/z.scm" (^[] (write '(define z 1))))
+           (find "z")))
+  (test* "removed file" #f
+         (begin (sys-unlink "test.o/x.scm") (find "x")))
+  (test* "file added in subdirectory" "test.o/sub/w.scm"
+         (begin
+           (with-output-to-file "test.o/sub/w.scm" (^[] (write '(define w 1))))
+           (find "sub/w"))))
+
 ;; :environment arg -------------------------------------
 (test-section "load environment")
 
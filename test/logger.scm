@@ -12,6 +12,16 @@
 (when (file-exists? "../ext/syslog/syslog.scm")
   (add-load-path "../ext/syslog")
   (load "../ext/syslog/syslog"))
+;; The async drain uses gauche.threads and data.queue.
+(cond-expand
+ [gauche.sys.threads
+  (when (file-exists? "../ext/threads/threads.scm")
+    (add-load-path "../ext/threads")
+    (load "../ext/threads/threads"))
+  (when (file-exists? "../ext/data/queue.scm")
+    (add-load-path "../ext/data")
+    (load "../ext/data/queue"))]
+ [else])
 (test-start "logger")
 (use gauche.logger)
 (test-module 'gauche.logger)
@@ -79,4 +89,56 @@
       (lambda ()
         (call-with-input-file "test.o" port->string-list)))
 
+;;-------------------------------------------------------------------------
+(test-section "async drain")
+
+(cond-expand
+ [gauche.sys.threads
+  (define (read-log) (call-with-input-file "test.o" port->string-list))
+
+  (sys-system "rm -f test.o test1.o")
+
+  (let1 d (make <async-log-drain> :path "test.o" :prefix ""
+                :flush-interval 0.05)
+    (log-format d "async ~a" 1)
+    (log-format d "async ~a\nmulti" 2)
+    (log-drain-flush d)
+    (test* "async drain flush" '("async 1" "async 2" "multi") (read-log))
+
+    (dotimes [i 100] (log-format d "line ~a" i))
+    (sys-nanosleep #e2e8)
+    (test* "async drain flush-interval" 103 (length (read-log)))
+
+    (sys-rename "test.o" "test1.o")
+    (log-format d "rotated")
+    (log-drain-close d)
+    (test* "async drain reopen" '("rotated") (read-log))
+    (test* "async drain dropped" 0 (log-drain-dropped d))
+
+    (log-format d "after close")
+    (test* "async drain after close" '("rotated" "after close") (read-log)))
+
+  (sys-system "rm -f test.o test1.o")
+
+  (let1 d (make <async-log-drain> :path "test.o" :prefix ""
+                :flush-size 10 :flush-interval 100)
+    (log-format d "0123456789")
+    (sys-nanosleep #e2e8)
+    (test* "async drain flush-size" '("0123456789") (read-log))
+    (log-drain-close d))
+
+  (sys-system "rm -f test.o")
+
+  (log-open "test.o" :async #t :prefix "zz:")
+  (log-format "async log-open")
+  (test* "log-open :async" #t (is-a? (log-default-drain) <async-log-drain>))
+  (log-drain-close (log-default-drain))
+  (test* "log-open :async" '("zz:async log-open") (read-log))
+
+  (test* "overflow policy" (test-error)
+         (make <async-log-drain> :path "test.o" :overflow 'whatever))
+
+  (sys-system "rm -f test.o")]
+ [else])
+
 (test-end)
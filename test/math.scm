@@ -58,6 +58,38 @@
                    (loop (+ n 1))
                    `(disagreement at ,n with sample ,sample))))))))
 
+;; known pseudoprimes; the witnesses of naive tests are fooled by them
+(define *prime-test-pseudoprimes*
+  '(2047 3215031751 341550071728321 3825123056546413051 5777 10877))
+
+(test* "strong pseudoprimes" '()
+       (filter (^n (or (bpsw-prime? n) (small-prime? n)))
+               *prime-test-pseudoprimes*))
+
+(test* "bpsw test near 2^64" '(#t #f #t)
+       (map bpsw-prime? '(18446744073709551557 18446744073709551615
+                          618970019642690137449562111))) ; 2^89-1
+
+(test* "small-prime? at the bound" '(#t #f #f #f)
+       (map small-prime? `(341550071728289 ,*small-prime-bound* 1 -7)))
+
+(test* "primes-in-range" (take-while (cut < <> 10000) *primes*)
+       (primes-in-range 0 10000))
+(test* "primes-in-range (middle)"
+       (filter (cut <= 1000000 <> 2000000)
+               (take-while (cut < <> 2000001) *primes*))
+       (primes-in-range 1000000 2000001))
+(test* "primes-in-range (threads)"
+       (primes-in-range 999999 3000000)
+       (primes-in-range 999999 3000000 :num-threads 4))
+(test* "primes-in-range (edge)" '(() () (2) (2 3) (3) ())
+       (list (primes-in-range -10 2) (primes-in-range 10 10)
+             (primes-in-range 2 3) (primes-in-range 0 4)
+             (primes-in-range 3 5) (primes-in-range 24 29)))
+(test* "primes-in-range (large)"
+       (filter bpsw-prime? (iota 200 (- (expt 2 64) 200)))
+       (primes-in-range (- (expt 2 64) 200) (- (expt 2 64) 1)))
+
 (let1 results
     ;;(a n jacobi)
     '((0    1    1)
@@ -431,6 +431,49 @@
       (lambda ()
         (global-variable-ref 'U 'c 'huh? #t)))
 
+;; Lookup results are cached per module.  Make sure the cache sees
+;; bindings, exports, imports and inheritance added later.
+(define-module lookup-cache-A (export lc-x) (define lc-x 'x))
+(define-module lookup-cache-B (import lookup-cache-A))
+(define-module lookup-cache-C)
+
+(test* "lookup cache" '(x none none)
+       (let1 m (find-module 'lookup-cache-B)
+         (list (global-variable-ref m 'lc-x 'none)
+               (global-variable-ref m 'lc-y 'none)
+               (global-variable-ref m 'lc-z 'none))))
+
+(test* "lookup cache (new binding in imported module)" '(x y none)
+       (begin
+         (eval '(begin (export lc-y) (define lc-y 'y))
+               (find-module 'lookup-cache-A))
+         (let1 m (find-module 'lookup-cache-B)
+           (list (global-variable-ref m 'lc-x 'none)
+                 (global-variable-ref m 'lc-y 'none)
+                 (global-variable-ref m 'lc-z 'none)))))
+
+(test* "lookup cache (new import)" '(x y z)
+       (begin
+         (eval '(define lc-z 'z) (find-module 'lookup-cache-C))
+         (eval '(export-all) (find-module 'lookup-cache-C))
+         (eval '(import lookup-cache-C) (find-module 'lookup-cache-B))
+         (let1 m (find-module 'lookup-cache-B)
+           (list (global-variable-ref m 'lc-x 'none)
+                 (global-variable-ref m 'lc-y 'none)
+                 (global-variable-ref m 'lc-z 'none)))))
+
+(test* "lookup cache (own binding shadows)" 'own
+       (begin
+         (eval '(define lc-x 'own) (find-module 'lookup-cache-B))
+         (global-variable-ref (find-module 'lookup-cache-B) 'lc-x 'none)))
+
+(test* "lookup cache (extend)" '(none z)
+       (let1 m (make-module #f)
+         (list (global-variable-ref m 'lc-z 'none)
+               (begin
+                 (eval '(extend lookup-cache-C) m)
+                 (global-variable-ref m 'lc-z 'none)))))
+
 ;;------------------------------------------------------------------
 ;; mpl search bug in 0.9.1 reported by Ryo Akagi
 ;; http://sourceforge.jp/projects/gauche/lists/archive/devel-jp/2010-December/001909.html
@@ -366,6 +366,59 @@
 (test* "no integral part" -0.5 (read-from-string "-.5"))
 (test* "no integral part" 0.5 (read-from-string "+.5"))
 
+;; The reader takes a fast path for up to 19 significant digits.
+(let ()
+  (define (t str expected)
+    (test* #"flonum reader (fast path) ~str" expected (string->number str)))
+  (t "0.1" (/ 1.0 10.0))
+  (t "12345678901234567" 12345678901234568.0)
+  (t "9007199254740993" 9007199254740992.0) ; halfway, round to even
+  (t "9007199254740995" 9007199254740996.0) ; halfway, round to even
+  (t "123456789012345678e-10" 12345678.9012345678)
+  (t "1.7976931348623157e308" 1.7976931348623157e308)
+  (t "1.7976931348623159e308" +inf.0)
+  (t "2.2250738585072014e-308" (expt 2.0 -1022))
+  (t "4.9406564584124654e-324" (expt 2.0 -1074))
+  (t "2.4703282292062328e-324" (expt 2.0 -1074))
+  (t "2.4703282292062327e-324" 0.0)
+  (t "7.3177701707893310e15" 7317770170789331.0)
+  (t "1e23" (* 1e22 10.0)))
+
+;;------------------------------------------------------------------
+(test-section "flonum writer")
+
+(define (flonum-writer-test expected val)
+  (test* #"flonum writer ~expected" expected (number->string val)))
+
+(flonum-writer-test "1.0" 1.0)
+(flonum-writer-test "-1.5" -1.5)
+(flonum-writer-test "100.0" 100.0)
+(flonum-writer-test "0.1" 0.1)
+(flonum-writer-test "0.3" 0.3)
+(flonum-writer-test "0.001" 0.001)
+(flonum-writer-test "1.0e-4" 1.0e-4)
+(flonum-writer-test "123456789.0" 123456789.0)
+(flonum-writer-test "1.23456789e9" 1234567890.0)
+(flonum-writer-test "1.0e21" 1.0e21)
+(flonum-writer-test "5.0e-324" 5.0e-324)
+(flonum-writer-test "2.2250738585072014e-308" 2.2250738585072014e-308)
+(flonum-writer-test "1.7976931348623157e308" 1.7976931348623157e308)
+;; These need a fallback to the exact algorithm
+(flonum-writer-test "0.00372" 0.00372)
+(flonum-writer-test "0.09341" 0.09341)
+(flonum-writer-test "9.939528290642408e14" 993952829064240.8)
+(flonum-writer-test "4.768100213943282e16" 4.768100213943282e16)
+
+(test* "flonum writer roundtrip" '()
+       (let loop ([i 0] [x 1.0] [bad '()])
+         (if (= i 2000)
+           bad
+           (loop (+ i 1) (* x -1.0123456)
+                 (let1 y (* x (expt 10.0 (- (modulo i 600) 300)))
+                   (if (eqv? y (string->number (number->string y)))
+                     bad
+                     (cons y bad)))))))
+
 ;;------------------------------------------------------------------
 (test-section "exact fractional number")
 
@@ -1050,6 +1103,25 @@
 (test* "bignum / 1" x
        (apply / (list x 1)))
 
+;; Sum of lists accumulates bignums in place.
+(define (pairwise-sum lis) (fold (^[b a] (+ a b)) 0 lis))
+(let1 lis (list x 3 yy (expt 2 200) -5 z xx (- (expt 2 200)) 1.5)
+  (test* "sum of bignums" (pairwise-sum (drop-right lis 1))
+         (apply + (drop-right lis 1)))
+  (test* "sum of bignums (to fixnum)" 2 (apply + (list x y xx yy 2)))
+  (test* "sum of bignums (to zero)" 0 (apply + (list x xx y yy)))
+  (test* "sum of bignums (with flonum)" (pairwise-sum lis) (apply + lis))
+  (test* "sum of bignums (with ratnum)" (+ (pairwise-sum lis) -3/2 1/3)
+         (apply + (append lis '(-3/2 1/3))))
+  (test* "sum of bignums (carry)" (expt 2 1000)
+         (apply + (- (expt 2 1000) (* 20 (greatest-fixnum)))
+                (make-list 20 (greatest-fixnum))))
+  (test* "sum of bignums (borrow)" (- (expt 2 640))
+         (apply + 1 (- 1 (expt 2 640)) (make-list 2 -1)))
+  (test* "sum of bignums (least-fixnum)" (* 3 (least-fixnum))
+         (apply + (list (least-fixnum) (expt 2 100) (least-fixnum)
+                        (- (expt 2 100)) (least-fixnum)))))
+
 ;;------------------------------------------------------------------
 (test-section "small immediate integer constants")
 
@@ -1247,6 +1319,14 @@
 (test* "big[1]*big[1]->big[2]" (m-result 1345585795375391817)
       (m-tester 1194726677 1126270821))
 
+;; around the boundary of the fixnum shortcut in NUMMUL2
+(test* "fix*fix (half word)" (m-result 4611686014132420609)
+      (m-tester 2147483647 2147483647))
+(test* "fix*fix (half word)" (m-result 4611686016279904256)
+      (m-tester 2147483648 2147483647))
+(test* "fix*fix (half word)" (m-result 4611686018427387904)
+      (m-tester 2147483648 2147483648))
+
 ;; Large number multiplication test using Fermat's number
 ;; The decomposition of Fermat's number is taken from
 ;;   http://www.dd.iij4u.or.jp/~okuyamak/Information/Fermat.html
@@ -1273,6 +1353,62 @@
            173462447179147555430258970864309778377421844723664084649347019061363579192879108857591038330408837177983810868451546421940712978306134189864280826014542758708589243873685563973118948869399158545506611147420216132557017260564139394366945793220968665108959685482705388072645828554151936401912464931182546092879815733057795573358504982279280090942872567591518912118622751714319229788100979251036035496917279912663527358783236647193154777091427745377038294584918917590325110939381322486044298573971650711059244462177542540706913047034664643603491382441723306598834177
            ))
 
+;; Multiplication of large bignums uses Karatsuba method.  We compare
+;; the results with the one calculated by multiplying small integers.
+(let ()
+  (define (slow-mul a b)
+    (let loop ([b b] [shift 0] [acc 0])
+      (if (zero? b)
+        acc
+        (loop (ash b -16) (+ shift 16)
+              (+ acc (ash (* a (logand b #xffff)) shift))))))
+  (define (t name a b)
+    (test* #"karatsuba ~name" (slow-mul a b) (* a b)))
+  (let ([a (- (expt 7 3000) 1)]
+        [b (+ (expt 11 2500) 12345)]
+        [c (expt 13 9000)])
+    (t "balanced" a b)
+    (t "square" a a)
+    (t "unbalanced" c b)
+    (t "unbalanced (reversed)" b c)
+    (t "negative" (- a) c))
+  (let1 x (- (expt 2 8192) 1)
+    (test* "karatsuba carries" (+ (- (expt 2 16384) (expt 2 8193)) 1)
+           (* x x))))
+
+;; These exercise the subquadratic division and radix conversion.
+(let ([a (expt 10 30000)]
+      [b (expt 10 12000)])
+  (test* "large quotient" (expt 10 18000) (quotient a b))
+  (test* "large remainder" 12345
+         (remainder (+ (* (expt 3 30000) (expt 7 9000)) 12345) (expt 7 9000))))
+
+(let ([a (+ (* (expt 3 40000) (expt 11 3000)) (expt 5 9000))]
+      [b (+ (expt 11 9000) 1)])
+  (define (check a b)
+    (receive (q r) (quotient&remainder a b)
+      (and (= a (+ (* q b) r))
+           (< (abs r) (abs b))
+           (or (zero? r) (eqv? (negative? r) (negative? a))))))
+  (test* "large quotient&remainder" '(#t #t #t #t)
+         (list (check a b) (check (- a) b) (check a (- b)) (check (- a) (- b)))))
+
+(test* "large number->string" (string-append "1" (make-string 5000 #\0))
+       (number->string (expt 10 5000)))
+(test* "large number->string" (make-string 5000 #\9)
+       (number->string (- (expt 10 5000) 1)))
+(test* "large number->string (radix 16)"
+       (string-append "1" (make-string 10000 #\0))
+       (number->string (expt 2 40000) 16))
+(let1 x (expt 7 20000)
+  (test* "large string->number" x (string->number (number->string x)))
+  (test* "large string->number (negative)" (- x)
+         (string->number (number->string (- x))))
+  (test* "large string->number (radix 3)" x
+         (string->number (number->string x 3) 3)))
+(test* "large string->number" (expt 10 5000)
+       (string->number (string-append "1" (make-string 5000 #\0))))
+
 ;;------------------------------------------------------------------
 (test-section "multiplication short cuts")
 
@@ -133,6 +133,34 @@
 (test* "make <r> :a" '(9 5) (slot-values r2))
 (test* "make <r> :a :b" '(20 100) (slot-values r3))
 
+;; Classes without custom initialize take a fast construction path.
+;; Check that it behaves the same as the generic path.
+(define-class <r2> ()
+  ((a :init-keyword :a :init-value 1)
+   (b :init-keyword :b)
+   (c :init-value 3)
+   (d)))
+
+(define (r2-values obj)
+  (map (^s (and (slot-bound? obj s) (slot-ref obj s))) '(a b c d)))
+
+(test* "make <r2>" '(1 #f 3 #f) (r2-values (make <r2>)))
+(test* "make <r2> :b" '(1 2 3 #f) (r2-values (make <r2> :b 2)))
+(test* "make <r2> (first keyword wins)" '(x y 3 #f)
+       (r2-values (make <r2> :a 'x :b 'y :a 'z :c 'w)))
+(test* "make <r2> (bad initargs)" (test-error) (make <r2> :a))
+
+(define-method initialize ((obj <r2>) initargs)
+  (next-method)
+  (slot-set! obj 'd (length initargs)))
+
+(test* "make <r2> (initialize added)" '(1 2 3 2) (r2-values (make <r2> :b 2)))
+
+(define-class <r3> (<r2>) ())
+
+(test* "make <r3> (inherited initialize)" '(5 #f 3 2)
+       (r2-values (make <r3> :a 5)))
+
 ;;----------------------------------------------------------------
 (test-section "slot allocations")
 
@@ -241,6 +269,29 @@
               (list (slot-bound? s5 'v)
                     (slot-ref s5 'v))))
 
+;; Slot accessors are cached by (class, slot name).  The same call site
+;; sees objects of different classes with different slot layouts.
+(define-class <sc-1> () (a b c))
+(define-class <sc-2> () (c b a))
+(define-class <sc-3> (<sc-2>)
+  ((b :allocation :virtual
+      :slot-ref (^o 'virtual-b)
+      :slot-set! (^(o v) #f))))
+
+(test* "slot access cache" '((1 2 3) (1 2 3) (1 virtual-b 3))
+       (let ([ref-all (^o (list (slot-ref o 'a) (slot-ref o 'b)
+                                (slot-ref o 'c)))]
+             [set-all! (^o (slot-set! o 'a 1) (slot-set! o 'b 2)
+                           (slot-set! o 'c 3))])
+         (map (^k (let1 o (make k) (set-all! o) (ref-all o)))
+              (list <sc-1> <sc-2> <sc-3>))))
+
+(test* "slot access cache (missing slot)" (test-error)
+       (let loop ([os (list (make <sc-1>) (make <sc-2>) 'x)])
+         (unless (null? os)
+           (slot-set! (car os) 'a 0)
+           (loop (cdr os)))))
+
 ;;----------------------------------------------------------------
 (test-section "next method")
 
@@ -288,6 +339,56 @@
 (test* "method sorting" 2 (ms-1 "a" "a"))
 (test* "method sorting" 1 (ms-1 "a"))
 
+;;----------------------------------------------------------------
+(test-section "method dispatch cache")
+
+;; The sorted list of applicable methods is cached per generic function.
+;; Make sure the cache is invalidated properly.
+
+(define-method dc-1 ((x <number>)) 'number)
+(define-method dc-1 ((x <integer>)) (cons 'integer (next-method)))
+
+(test* "dispatch cache" '(integer . number) (dc-1 1))
+(test* "dispatch cache" 'number (dc-1 1.5))
+(test* "dispatch cache (repeat)" '((integer . number) number)
+       (list (dc-1 2) (dc-1 2.5)))
+
+(define-method dc-1 ((x <real>)) (cons 'real (next-method)))
+
+(test* "dispatch cache after adding method" '(integer real . number) (dc-1 1))
+(test* "dispatch cache after adding method" '(real . number) (dc-1 1.5))
+
+(define-method dc-1 ((x <real>)) (list 'real2 (next-method)))
+
+(test* "dispatch cache after replacing method" '(real2 number) (dc-1 1.5))
+
+(define-method dc-2 ((x <string>) :optional (y 0)) (list 'string y))
+(define-method dc-2 ((x <string>) (y <string>)) (list 'string2 y))
+
+(test* "dispatch cache with different argc" '(string 0) (dc-2 "a"))
+(test* "dispatch cache with different argc" '(string2 "b") (dc-2 "a" "b"))
+(test* "dispatch cache with different argc" '(string 1) (dc-2 "a" 1))
+(test* "dispatch cache with different argc" '(string 0) (dc-2 "a"))
+
+(define-method dc-3 (a b c d e f) 'top)
+(define-method dc-3 ((a <integer>) b c d e (f <integer>)) 'int)
+
+(test* "dispatch with many args" '(int top)
+       (list (dc-3 1 2 3 4 5 6) (dc-3 1 2 3 4 5 'x)))
+
+(define-class <dc-a> () ())
+(define-class <dc-b> () ())
+(define-class <dc-c> (<dc-a>) ())
+(define-method dc-4 ((x <dc-a>)) 'a)
+(define-method dc-4 ((x <dc-b>)) 'b)
+(define-method dc-4 (x) 'top)
+
+(test* "dispatch cache before redefinition" 'a (dc-4 (make <dc-c>)))
+
+(define-class <dc-c> (<dc-b>) ())
+
+(test* "dispatch cache after redefinition" 'b (dc-4 (make <dc-c>)))
+
 
 ;;----------------------------------------------------------------
 (test-section "setter method definition")
@@ -1441,5 +1542,77 @@
 
 (atest* #/a/ [() => #f] [(<string>) => #t] [(<integer>) => #f])
 
-(test-end)
+;;----------------------------------------------------------------
+(test-section "record types")
+
+(use gauche.record)
+
+(define-record-type rpoint #t #t (x) y)
+(define-record-type (rpoint3 rpoint) #t #t (z))
+(define-record-type (vpoint (pseudo-rtd <vector>)) #t #t (x) (y))
+
+(test* "record accessors" '(1 2 #t)
+       (let1 p (make-rpoint 1 2)
+         (list (rpoint-x p) (rpoint-y p) (rpoint? p))))
+(test* "record modifiers" '(3 4)
+       (let1 p (make-rpoint 1 2)
+         (rpoint-x-set! p 3)
+         (let1 a (rpoint-x p)
+           (set! (rpoint-x p) 4)
+           (list a (rpoint-x p)))))
+(test* "record accessors (inherited)" '(1 2 5)
+       (let1 p (make-rpoint3 1 2 3)
+         (rpoint3-z-set! p 5)
+         (list (rpoint-x p) (rpoint-y p) (rpoint3-z p))))
+(test* "record accessors (type check)" (test-error)
+       (rpoint-x (make-vpoint 1 2)))
+(test* "record accessors (type check)" (test-error)
+       (rpoint3-z (make-rpoint 1 2)))
+(test* "pseudo record accessors" '(#(5 2) 5)
+       (let1 p (make-vpoint 1 2)
+         (vpoint-x-set! p 5)
+         (list p (vpoint-x p))))
+
+(define-record-type particle #t #t
+  ((x flonum) particle-x set-particle-x!)
+  ((n fixnum))
+  ((c u8) particle-c)
+  ((m flonum)))
+(define-record-type (charged particle) #t #t
+  ((q flonum) charged-q charged-q-set!))
+
+(test* "typed fields" '(1.0 2 3 0.5)
+       (let1 p (make-particle 1 2 3 0.5)
+         (list (particle-x p) (particle-n p) (particle-c p) (particle-m p))))
+(test* "typed fields (flonum)" '(2.5 4.0 4.0)
+       (let1 p (make-particle 1.0 2 3 0.5)
+         (set-particle-x! p 2.5)
+         (let1 a (particle-x p)
+           (set! (particle-m p) 4)
+           (list a (particle-m p) (slot-ref p 'm)))))
+(test* "typed fields (fixnum)" (test-error)
+       (particle-n-set! (make-particle 1.0 2 3 0.5) 1.5))
+(test* "typed fields (fixnum)" (test-error)
+       (make-particle 1.0 'a 3 0.5))
+(test* "typed fields (u8)" (test-error)
+       (make-particle 1.0 2 256 0.5))
+(test* "typed fields (slot-set!)" (test-error)
+       (slot-set! (make-particle 1.0 2 3 0.5) 'n "a"))
+(test* "typed fields (inherited)" '(3.0 0.5 -2.0)
+       (let1 p (make-charged 1 2 3 0.5 -1)
+         (set-particle-x! p 3)
+         (charged-q-set! p -2)
+         (list (particle-x p) (particle-m p) (charged-q p))))
+(test* "typed fields (rtd-accessor)" '(0.5 -1.0)
+       (let1 p (make-charged 1 2 3 0.5 -1)
+         (list ((rtd-accessor charged 'm) p)
+               ((rtd-accessor charged 'q) p))))
+(test* "typed fields (make-rtd)" '(1.0 2.0)
+       (let* ([rtd (make-rtd 'pt '#((mutable x flonum) (immutable y flonum)))]
+              [p ((rtd-constructor rtd) 3 2)])
+         ((rtd-mutator rtd 'x) p 1)
+         (list ((rtd-accessor rtd 'x) p) ((rtd-accessor rtd 'y) p))))
+(test* "typed fields (pseudo record)" (test-error)
+       (make-rtd 'pt '#((mutable x flonum)) (pseudo-rtd <vector>)))
 
+(test-end)
@@ -41,6 +41,23 @@
 (test* "inlining add4 + constant folding" '(((CONSTI 9)) ((RET)))
        (proc->insn/split (^[] (+ (add4 2) 3))))
 
+;; Small procedures in a sealed module are inlined into other modules.
+(define-module optimize.sealed
+  (export sealed-add1 sealed-big))
+(select-module optimize.sealed)
+(seal-module)
+(define (sealed-add1 x) (+ x 1))
+(define (sealed-big x)
+  (list (+ x 1) (+ x 2) (+ x 3) (+ x 4) (+ x 5) (+ x 6) (+ x 7) (+ x 8)))
+(select-module user)
+(import optimize.sealed)
+
+(test* "inlining small procedure in sealed module" '()
+       (filter-insn (^[x] (sealed-add1 x)) 'GREF-TAIL-CALL))
+(test* "inlined procedure in sealed module" 3 ((^[x] (sealed-add1 x)) 2))
+(test* "not inlining big procedure in sealed module" 1
+       (length (filter-insn (^[x] (sealed-big x)) 'GREF-TAIL-CALL)))
+
 (test-section "lambda lifting")
 
 ;; bug reported by teppey
@@ -103,6 +120,42 @@
 (test* "make sure define-inline'd procs be optimized" '()
        (filter-insn foo 'LOCAL-ENV-CLOSURES))
 
+;; map, for-each etc. with a literal lambda are expanded into a loop,
+;; so the lambda isn't closed even if it has free variables.
+(test-section "higher-order procedure inlining")
+
+(test* "inlined map makes no closure" '()
+       (filter-insn (^(xs n) (map (^k (+ k n)) xs)) 'CLOSURE))
+(test* "inlined for-each makes no closure" '()
+       (filter-insn (^(xs v) (for-each (^k (vector-set! v k k)) xs)) 'CLOSURE))
+(test* "inlined fold makes no closure" '()
+       (filter-insn (^(xs n) (fold (^[k s] (+ k s n)) 0 xs)) 'CLOSURE))
+(test* "inlined filter makes no closure" '()
+       (filter-insn (^(xs n) (filter (^k (< k n)) xs)) 'CLOSURE))
+
+(let ([n 10])
+  (define (add-n k) (+ k n))
+  (test* "inlined map" '(11 12 13) (map (^k (+ k n)) '(1 2 3)))
+  (test* "inlined map (empty)" '() (map (^k (+ k n)) '()))
+  (test* "inlined map (improper)" (test-error) (map (^k (+ k n)) '(1 2 . 3)))
+  (test* "inlined map (local proc)" '(11 12) (map add-n '(1 2)))
+  (test* "map with two lists" '(11 22) (map (^[a b] (+ a b)) '(1 2) '(10 20)))
+  (test* "map with wrong arity" (test-error) (map (^[a b] a) '(1 2)))
+  (test* "inlined for-each" '(13 12 11)
+         (let1 r '() (for-each (^k (push! r (+ k n))) '(1 2 3)) r))
+  (test* "inlined for-each (improper)" (test-error) (for-each (^k k) 3))
+  (test* "inlined fold" '(3 2 1 . 10) (fold (^[k s] (cons k s)) n '(1 2 3)))
+  (test* "inlined fold (improper)" (test-error) (fold (^[k s] s) n '(1 . 2)))
+  (test* "inlined filter" '(1 3 5) (filter (^k (odd? k)) '(1 2 3 4 5)))
+  (test* "inlined any" 12 (any (^k (and (> k 1) (+ k n))) '(1 2 3)))
+  (test* "inlined any (none)" #f (any (^k (> k n)) '(1 2 3)))
+  (test* "inlined any (empty)" #f (any (^k #t) '()))
+  (test* "inlined every" 13 (every (^k (and (> k 0) (+ k n))) '(1 2 3)))
+  (test* "inlined every (fail)" #f (every (^k (< k 2)) '(1 2 3)))
+  (test* "inlined every (empty)" #t (every (^k #f) '()))
+  (test* "inlined every (improper)" (test-error) (every (^k #t) '(1 . 2)))
+  )
+
 (test-section "eta reduction")
 
 ;; This is actually to check when eta reductino isn't done
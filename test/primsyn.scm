@@ -52,6 +52,34 @@
 (prim-test "case (srfi-87)" 6 (lambda () (case (+ 2 3) ((1 3 5) => (cut + 1 <>)) (else => values))))
 (prim-test "case (srfi-87)" 5 (lambda () (case (+ 2 3) ((2 4 6) 0) (else => values))))
 
+;; case with many clauses is compiled into CASE-INDEX dispatch
+(define (case-dense x)
+  (case x
+    [(0) 'a] [(1 2) 'b] [(3) 'c] [(4) 'd] [(5 1) 'e] [(6) 'f]
+    [(7) 'g] [(8) 'h] [(10) 'i] [else 'z]))
+(define (case-sparse x)
+  (case x
+    [(-1000000) 'a] [(7) 'b] [(300000) 'c] [(42 43) 'd]
+    [(#\a #\x3bb) 'e] [(foo) 'f] [(bar baz) 'g] [(:key) 'h] [() 'i]
+    [(foo 7) 'j]))
+(define (case-arrow x)
+  (case x
+    [(a) 0] [(b) 1] [(c) 2] [(d) 3] [(e) 4] [(f) 5] [(g) 6]
+    [(h i) => (cut list 'hi <>)]
+    [else => (cut list 'else <>)]))
+
+(prim-test "case (dispatch)" '(a b b c d e f g h z i z z z z)
+           (lambda ()
+             (map case-dense '(0 1 2 3 4 5 6 7 8 9 10 11 -1 1.0 a))))
+(prim-test "case (dispatch)" '(a b c d d e e f g g h #t #t #t #t #t)
+           (lambda ()
+             (map (^x (let1 r (case-sparse x) (if (undefined? r) #t r)))
+                  '(-1000000 7 300000 42 43 #\a #\x3bb foo bar baz :key
+                    8 #\b qux "foo" 7.0))))
+(prim-test "case (dispatch)" '(0 6 (hi h) (hi i) (else j) (else 1))
+           (lambda ()
+             (map case-arrow '(a g h i j 1))))
+
 ;;----------------------------------------------------------------
 (test-section "binding")
 
@@ -312,6 +340,33 @@
       (lambda ()  (call-with-values (lambda () (values 1 2 3)) list)))
 (prim-test "call-with-values" '()
       (lambda ()  (call-with-values (lambda () (values)) list)))
+(prim-test "call-with-values (lambda consumer)" '(1 2 (3))
+      (lambda ()  (call-with-values (lambda () (values 1 2 3))
+                    (lambda (a b . c) (list a b c)))))
+(prim-test "call-with-values (lambda consumer, optional)" '(1 #f)
+      (lambda ()  (call-with-values (lambda () 1)
+                    (lambda (a :optional (b #f)) (list a b)))))
+
+;; More values than the VM's value registers
+(let1 big (iota 50)
+  (prim-test "many values" big
+        (lambda () (receive x (apply values big) x)))
+  (prim-test "many values (fixed formals)" '(0 29 49)
+        (lambda ()
+          (receive (a0 a1 a2 a3 a4 a5 a6 a7 a8 a9
+                    b0 b1 b2 b3 b4 b5 b6 b7 b8 b9
+                    c0 c1 c2 c3 c4 c5 c6 c7 c8 c9 . rest)
+              (apply values big)
+            (list a0 c9 (last rest)))))
+  (prim-test "many values (literal)" 30
+        (lambda ()
+          (receive x (values 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15
+                             16 17 18 19 20 21 22 23 24 25 26 27 28 29 30)
+            (length x))))
+  (prim-test "many values through dynamic-wind" big
+        (lambda ()
+          (receive x (dynamic-wind (^[] #f) (^[] (apply values big)) (^[] #f))
+            x))))
 
 ;; This is not 'right' in R5RS sense---for now, I just tolerate it
 ;; by CommonLisp way, i.e. if more than one value is passed to an
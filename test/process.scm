@@ -210,6 +210,17 @@
               )
          (equal? s s1)))
 
+(test* "run-process (directory)" '(0 "hello")
+       (begin
+         (sys-mkdir "test1.o" #o755)
+         (with-output-to-file "test1.o/x" (cut display "hello"))
+         (let* ([p (run-process (cmd cat "x") :output :pipe
+                                :directory "test1.o")]
+                [s (port->string (process-output p))])
+           (process-wait p)
+           (rmrf "test1.o")
+           (list (process-exit-status p) s))))
+
 ;; NB: how to test :wait and :fork?
 
 (test* "process-kill" SIGKILL
@@ -285,6 +296,31 @@
                                         :input "test.o" :output :pipe)
            (begin0 (port->string (process-output (last ps)))
              (for-each process-wait ps))))  
+
+  (test* "run-pipeline" '(#t "banana\ncabara\n" (0 0 0))
+         (let1 pl (run-pipeline `(,(cmd cat)
+                                  ,(cmd grep "-v" "ta")
+                                  ,(cmd grep "-v" "ha"))
+                                :input "test.o" :output :pipe)
+           (list (pipeline? pl)
+                 (port->string (pipeline-output pl))
+                 (pipeline-wait pl))))
+
+  (test* "run-pipeline (per-stage status)" '(#f 0 1)
+         (let1 pl (run-pipeline `(,(cmd cat "test.o")
+                                  ,(cmd grep "NoSuchString"))
+                                :output *nulldev* :wait #t)
+           (cons (boolean (memq #f (pipeline-status pl))) ;all waited
+                 (map sys-wait-exit-status (pipeline-status pl)))))
+
+  (test* "run-pipeline (input pipe)" "habana\n"
+         (let1 pl (run-pipeline `(,(cmd cat) ,(cmd grep "hab"))
+                                :input :pipe :output :pipe)
+           (display (call-with-input-file "test.o" port->string)
+                    (pipeline-input pl))
+           (close-output-port (pipeline-input pl))
+           (begin0 (port->string (pipeline-output pl))
+             (pipeline-wait pl))))
   )
 
 ;;-------------------------------
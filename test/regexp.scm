@@ -5,6 +5,7 @@
 (use gauche.test)
 (use srfi-1)
 (use srfi-14)
+(use gauche.uvector)
 
 (test-start "regexp")
 
@@ -955,4 +956,186 @@
                                               (seq #\a #\b)))
                         "abc"))
 
+;;-------------------------------------------------------------------------
+(test-section "matching without backtracking")
+
+;; Regexps without backreferences or lookaround are run by automata.
+;; They must find the same match as the backtracking matcher.
+
+(test* "exponential pattern" #f
+       (rxmatch #/(?:a|aa)*b/ (make-string 100 #\a)))
+(test* "exponential pattern" '(0 101)
+       (let1 m (rxmatch #/(?:a|aa)*b/ (string-append (make-string 100 #\a) "b"))
+         (list (rxmatch-start m) (rxmatch-end m))))
+(test* "exponential pattern with group" 101
+       (rxmatch-end (rxmatch #/(a|aa)*b/
+                             (string-append (make-string 100 #\a) "b"))))
+(test* "long input" '(10000 10003)
+       (let1 m (rxmatch #/a[bc]+/ (string-append (make-string 10000 #\x) "abc"))
+         (list (rxmatch-start m) (rxmatch-end m))))
+
+(define (test-leftmost rx str expected)
+  (test* (format "~s ~s" rx str) expected
+         (cond [(rx str) => (^m (list (rxmatch-start m) (rxmatch-end m)))]
+               [else #f])))
+
+(test-leftmost #/a|ab/ "xab" '(1 2))
+(test-leftmost #/ab|a/ "xab" '(1 3))
+(test-leftmost #/(?:a|ab)c/ "xabc" '(1 4))
+(test-leftmost #/a+?/ "aaa" '(0 1))
+(test-leftmost #/a*?b/ "xaab" '(1 4))
+(test-leftmost #/a{2,3}/ "aaaaa" '(0 3))
+(test-leftmost #/a{2,3}?/ "aaaaa" '(0 2))
+(test-leftmost #/b+/ "abbbc" '(1 4))
+(test-leftmost #/x*/ "abc" '(0 0))
+(test-leftmost #/\bfoo\b/ "foofoo foo" '(7 10))
+(test-leftmost #/\Boo/ "oo foo" '(4 6))
+(test-leftmost #/foo$/ "foofoo" '(3 6))
+(test-leftmost #/^foo/ "xfoo" #f)
+(test-leftmost #/(?i:ab)+/ "xAbaBc" '(1 5))
+(test-leftmost #/[^a]*a/ "bbba" '(0 4))
+(test-leftmost #/\s*foo/ "  foo" '(0 5))
+(test-leftmost #/.*c/ "abcabc" '(0 6))
+(test-leftmost #/[あ-ん]+/ "abcあいうdef" '(3 6))
+(test-leftmost #/う.$/ "あいうえ" '(2 4))
+
+(test* "submatches" '("123-4567" "123" "4567")
+       (let1 m (#/(\d+)-(\d+)/ "tel 123-4567 ext")
+         (list (m 0) (m 1) (m 2))))
+(test* "submatches" '("abab" "ab")
+       (let1 m (#/(ab)+/ "xababx")
+         (list (m 0) (m 1))))
+
+;;-------------------------------------------------------------------------
+(test-section "required literal")
+
+;; A literal string every match must contain is used to reject the input
+;; or to skip to the candidate positions.  Backreferences and lookaround
+;; make sure the backtracking matcher runs.
+
+(test-leftmost #/GET (\w)\1/ "GET xy GET zz" '(7 13))
+(test-leftmost #/GET (\w)\1/ "GET xy GET zy" #f)
+(test-leftmost #/\bfoo(?=!)/ "xfoo! foo!" '(6 9))
+(test-leftmost #/(?<=a)bc/ "bcxbcabc" '(6 8))
+(test-leftmost #/aab(?!c)/ "aaabcaaab" '(6 9))
+(test-leftmost #/(\d)\1 ERROR/ "11 WARN" #f)
+(test-leftmost #/(\d)\1 ERROR/ "12 ERROR 22 ERROR" '(9 17))
+(test-leftmost #/(.)\1ERROR/ "xxERRO" #f)
+(test-leftmost #/いう(?!え)/ "いうえ いうお" '(4 6))
+(test-leftmost #/(?i:get)(?=\s)/ "GeT /" '(0 3))
+(test-leftmost #/a(?:bc)+(?=d)/ "abcbcabcd" '(5 8))
+(test-leftmost #/ERROR/ (string-append (make-string 10000 #\E) "RROR") '(9999 10004))
+
+;;-------------------------------------------------------------------------
+(test-section "matching without match objects")
+
+(test* "regexp-match?" '(#t #f #t #f #t)
+       (map (cut regexp-match? <> "abc xyz")
+            (list #/b./ #/^x/ #/(\w)\1|z$/ #/(?<=c)x/ #/(?i:XY)/)))
+(test* "regexp-match?" #t
+       (regexp-match? #/(?:a|aa)*b/ (string-append (make-string 100 #\a) "b")))
+
+(let ([v (make-s32vector 6 99)])
+  (test* "regexp-match-positions!" '(3 #s32(4 11 4 6 7 11))
+         (list (regexp-match-positions! #/(\d+)-(\d+)/ "tel 03-1234" v) v))
+  (test* "regexp-match-positions! no match" '(#f #s32(4 11 4 6 7 11))
+         (list (regexp-match-positions! #/(\d+)-(\d+)/ "tel" v) v))
+  (test* "regexp-match-positions! unmatched group" '(2 #s32(1 2 -1 -1 7 11))
+         (list (regexp-match-positions! #/(a)?b/ "xb" v) v))
+  (test* "regexp-match-positions! multibyte" '(3 #s32(2 5 2 3 4 5))
+         (list (regexp-match-positions! #/(う)え(お)/ "あいうえお" v) v))
+  )
+(let ([v (make-s32vector 3 99)])
+  (test* "regexp-match-positions! short vector" '(1 #s32(1 4 99))
+         (list (regexp-match-positions! #/(b)(c)(d)/ "abcd" v) v)))
+(test* "regexp-match-positions! immutable" (test-error)
+       (regexp-match-positions! #/a/ "a" '#s32(0 0)))
+(test* "regexp-match-positions! many groups" '(20 0 20 18 19)
+       (let* ([rx (string->regexp (apply string-append
+                                         (make-list 20 "(.)")))]
+              [v (make-s32vector 40)])
+         (list (regexp-match-positions! rx (make-string 20 #\a) v)
+               (s32vector-ref v 0) (s32vector-ref v 1)
+               (s32vector-ref v 38) (s32vector-ref v 39))))
+
+;;-------------------------------------------------------------------------
+(test-section "searching ports")
+
+(define (test-search-port rx str expected)
+  (test* #"regexp-search-port ~rx ~|str|" expected
+         (let* ([r '()]
+                [n (call-with-input-string str
+                     (^p (regexp-search-port rx p
+                           (^[off m] (push! r (list off (m)))))))])
+           (cons n (reverse r)))))
+
+(test-search-port #/ERROR (\w)/ "ERROR a\nok\nERROR b\n"
+                  '(2 (0 "ERROR a") (11 "ERROR b")))
+(test-search-port #/^a/ "aaa" '(1 (0 "a")))
+(test-search-port #/a*/ "baac" '(4 (0 "") (1 "aa") (3 "") (4 "")))
+(test-search-port #/\bfoo\b/ "foo xfoo foo" '(2 (0 "foo") (9 "foo")))
+(test-search-port #/x$/ "xx" '(1 (1 "x")))
+(test-search-port #/い+/ "あいいうい" '(2 (3 "いい") (12 "い")))
+(test-search-port #/(\w)\1/ "abbcdd" '(2 (1 "bb") (4 "dd")))
+(test-search-port #/nomatch/ "" '(0))
+
+(test* "regexp-search-port submatches" '((0 "12:34" "12" "34" 0 3))
+       (let1 r '()
+         (call-with-input-string "12:34"
+           (^p (regexp-search-port #/(\d+):(\d+)/ p
+                 (^[off m] (push! r (list off (m) (m 1) (m 2)
+                                          (rxmatch-start m 1)
+                                          (rxmatch-start m 2)))))))
+         r))
+
+;; A match across chunk boundaries, and the offsets of a long input
+(test* "regexp-search-port long input"
+       '(3 (10000 "abc") (30003 "abbbc") (60008 "ac"))
+       (let ([r '()]
+             [str (string-append (make-string 10000 #\x) "abc"
+                                 (make-string 20000 #\y) "abbbc"
+                                 (make-string 30000 #\z) "ac")])
+         (let1 n (call-with-input-string str
+                   (^p (regexp-search-port #/ab*c/ p
+                         (^[off m] (push! r (list off (m)))))))
+           (cons n (reverse r)))))
+
+;;-------------------------------------------------------------------------
+(test-section "regexp set")
+
+(define *rxset* (make-regexp-set
+                 `(#/^GET / #/\.html?\b/ "(\\w+)=\\1" #/(?i:host:)/
+                   #/x*/ #/a$/ #/(?<=\d)px/ #/あ+い/)))
+
+(test* "regexp-set?" '(#t #f) (list (regexp-set? *rxset*) (regexp-set? #/a/)))
+(test* "regexp-set-regexps" 8 (length (regexp-set-regexps *rxset*)))
+(test* "regexp-set-regexps" #t
+       (every regexp? (regexp-set-regexps *rxset*)))
+
+(define (test-rxset str)
+  (test* #"regexp-set-matches ~|str|"
+         (filter-map (^[rx i] (and (rxmatch rx str) i))
+                     (regexp-set-regexps *rxset*) (iota 8))
+         (regexp-set-matches *rxset* str)))
+
+(test-rxset "")
+(test-rxset "GET /index.html HTTP/1.1")
+(test-rxset "POST /index.htmlx")
+(test-rxset "HOST: a=a")
+(test-rxset "x GET / 12px")
+(test-rxset "ppx a")
+(test-rxset "ああい")
+(test-rxset "a\nb")
+(test-rxset "xa")
+
+(test* "regexp-set-matches" '(0 4 5)
+       (regexp-set-matches *rxset* "GET a"))
+(test* "regexp-set-matches, empty set" '()
+       (regexp-set-matches (make-regexp-set '()) "abc"))
+(test* "regexp-set-matches, long input" '(1 3)
+       (regexp-set-matches (make-regexp-set '(#/a/ #/b/ #/c/ #/z$/))
+                           (string-append (make-string 10000 #\b) "z")))
+(test* "make-regexp-set" (test-error)
+       (make-regexp-set '(#/a/ b)))
+
 (test-end)
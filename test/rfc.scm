@@ -14,6 +14,7 @@
 ;;--------------------------------------------------------------------
 (test-section "rfc.base64")
 (use rfc.base64)
+(use gauche.uvector)
 (test-module 'rfc.base64)
 
 (test* "encode" "" (base64-encode-string ""))
@@ -80,6 +81,52 @@
 (test* "url-safe encode" "YTA-YTA_" (base64-encode-string "a0>a0?" :url-safe #t))
 (test* "url-safe decode" "a0>a0?" (base64-decode-string "YTA-YTA_" :url-safe #t))
 
+;; Long enough to go through the vectorized paths
+(let ([bytes (list->u8vector (iota 256))]
+      [encoded (string-append
+                "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8gISIjJCUmJygpKiss"
+                "LS4vMDEyMzQ1Njc4OTo7PD0+P0BBQkNERUZHSElKS0xNTk9QUVJTVFVWV1hZ"
+                "WltcXV5fYGFiY2RlZmdoaWprbG1ub3BxcnN0dXZ3eHl6e3x9fn+AgYKDhIWG"
+                "h4iJiouMjY6PkJGSk5SVlpeYmZqbnJ2en6ChoqOkpaanqKmqq6ytrq+wsbKz"
+                "tLW2t7i5uru8vb6/wMHCw8TFxsfIycrLzM3Oz9DR0tPU1dbX2Nna29zd3t/g"
+                "4eLj5OXm5+jp6uvs7e7v8PHy8/T19vf4+fr7/P3+/w==")])
+  (test* "encode bytevector" encoded
+         (base64-encode-bytevector bytes :line-width #f))
+  (test* "encode bytevector w/ line width (default)"
+         (regexp-replace-all #/.{76}/ encoded "\\0\n")
+         (base64-encode-bytevector bytes))
+  (test* "encode port w/ line width 10"
+         (regexp-replace-all #/.{10}/ encoded "\\0\n")
+         (with-input-from-string (u8vector->string bytes)
+           (cut with-output-to-string (cut base64-encode :line-width 10))))
+  (test* "decode bytevector" bytes
+         (base64-decode-bytevector encoded))
+  (test* "decode bytevector w/ line breaks" bytes
+         (base64-decode-bytevector
+          (regexp-replace-all #/.{76}/ encoded "\\0\r\n")))
+  (test* "decode string" (u8vector->string bytes)
+         (base64-decode-string encoded))
+  (test* "url-safe encode bytevector"
+         (string-append
+          "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8gISIjJCUmJygpKiss"
+          "LS4vMDEyMzQ1Njc4OTo7PD0-P0BBQkNERUZHSElKS0xNTk9QUVJTVFVWV1hZ"
+          "WltcXV5fYGFiYw==")
+         (base64-encode-bytevector (u8vector-copy bytes 0 100)
+                                   :line-width #f :url-safe #t))
+  (test* "roundtrip" #t
+         (every (^n (let1 v (u8vector-copy bytes 0 n)
+                      (and (equal? v (base64-decode-bytevector
+                                      (base64-encode-bytevector v)))
+                           (equal? v (base64-decode-bytevector
+                                      (base64-encode-bytevector v :url-safe #t)
+                                      :url-safe #t)))))
+                (iota 100 0 2))))
+
+(test* "decode port stops at =" '("a0>a0?" "rest")
+       (with-input-from-string "YTA+YTA/=rest"
+         (^[] (let1 s (with-output-to-string base64-decode)
+                (list s (read-line))))))
+
 ;;--------------------------------------------------------------------
 (test-section "rfc.quoted-printable")
 (use rfc.quoted-printable)
@@ -268,6 +315,19 @@
 (test* "decode" "a%y"  (uri-decode-string "a%y"))
 (test* "decode" "a%ay" (uri-decode-string "a%ay"))
 (test* "decode" ""     (uri-decode-string ""))
+(test* "decode" "%4A"  (uri-decode-string "%4%41"))
+(test* "decode (port)" "a b+c\x00;"
+       (with-input-from-string "a%20b+c%00"
+         (cut with-output-to-string uri-decode)))
+;; '%' escape straddling the chunk boundary of the port decoder
+(test* "decode (port, long)" (string-append (make-string 4095 #\a) "AB")
+       (with-input-from-string (string-append (make-string 4095 #\a) "%41%42")
+         (cut with-output-to-string uri-decode)))
+(test* "encode (port)" "a%20b%2B~"
+       (with-input-from-string "a b+~"
+         (cut with-output-to-string uri-encode)))
+(test* "encode (noescape, custom)" "a+b%2Fc"
+       (uri-encode-string "a+b/c" :noescape #[a-z+]))
 
 (test* "uri-scheme&specific" '("http" "//practical-scheme.net/gauche/")
        (receive r
@@ -332,6 +392,14 @@
        (receive r (uri-decompose-authority "[::1]:8080") r))
 (test* "uri-decompose-authority" '("foo:bar" "::1" #f)
        (receive r (uri-decompose-authority "foo:bar@[::1]") r))
+(test* "uri-decompose-authority" '(#f "[ab]" "80")
+       (receive r (uri-decompose-authority "[ab]:80") r))
+(test* "uri-decompose-authority" '("a" "b@c" #f)
+       (receive r (uri-decompose-authority "a@b@c") r))
+(test* "uri-decompose-authority" '(#f #f #f)
+       (receive r (uri-decompose-authority "u@h:x") r))
+(test* "uri-decompose-authority" '(#f #f #f)
+       (receive r (uri-decompose-authority #f) r))
 
 (test* "uri-parse" '("https" "shiro" "www.example.com" 443 "/login" "abc" "def")
        (receive r (uri-parse "https://shiro@www.example.com:443/login?abc#def")
@@ -347,6 +415,10 @@
        (receive r (uri-parse "/usr/local/lib") r))
 (test* "uri-parse" '("mailto" #f #f #f "shiro@example.com" #f #f)
        (receive r (uri-parse "mailto:shiro@example.com") r))
+(test* "uri-parse" '("http" #f #f #f "/" "" "")
+       (receive r (uri-parse "HTTP://:/?#") r))
+(test* "uri-parse" '("http" #f "\u3042.example" 80 "/\u3044" "q" #f)
+       (receive r (uri-parse "http://\u3042.example:80/\u3044?q") r))
 
 (let ([base0 "http://a/b/c/d;p?q"])
   (define (t base rel expect) 
@@ -524,36 +596,46 @@
                            "Content-length: 9\n\nNot found"))
         ht))
 
+    ;; "/keep-alive" replies with a content-length and keeps the
+    ;; connection; the body is the number of requests served on it.
     (define (http-server socket)
       (let loop ()
         (let* ([client (socket-accept socket)]
                [in  (socket-input-port client)]
-               [out (socket-output-port client)]
-               [request-line (read-line in)])
-          (rxmatch-if (#/^(\S+) (\S+) HTTP\/1\.1$/ request-line)
-              (#f method request-uri)
-            (let* ([headers (rfc822-read-headers in)]
-                   [bodylen
-                    (cond [(assoc-ref headers "content-length")
-                           => (^e (string->number (car e)))]
-                          [else 0])]
-                   [body (read-block bodylen in)])
-              (cond
-               [(equal? request-uri "/exit")
-                (socket-close client)
-                (sys-exit 0)]
-               [(hash-table-get %predefined-contents request-uri #f)
-                => (cut for-each (cut display <> out) <>)]
-               [else
-                (display "HTTP/1.x 200 OK\nContent-Type: text/plain\n\n" out)
-                (write `(("method" ,method)
-                         ("request-uri" ,request-uri)
-                         ("request-body" ,(string-incomplete->complete body))
-                         ,@headers)
-                       out)])
-              (socket-close client)
-              (loop))
-            (error "malformed request line:" request-line)))))
+               [out (socket-output-port client)])
+          (let serve ([nreq 1])
+            (let1 request-line (read-line in)
+              (if (eof-object? request-line)
+                (begin (socket-close client) (loop))
+                (rxmatch-if (#/^(\S+) (\S+) HTTP\/1\.1$/ request-line)
+                    (#f method request-uri)
+                  (let* ([headers (rfc822-read-headers in)]
+                         [bodylen
+                          (cond [(assoc-ref headers "content-length")
+                                 => (^e (string->number (car e)))]
+                                [else 0])]
+                         [body (read-block bodylen in)])
+                    (cond
+                     [(equal? request-uri "/exit")
+                      (socket-close client)
+                      (sys-exit 0)]
+                     [(equal? request-uri "/keep-alive")
+                      (let1 n (number->string nreq)
+                        (display #"HTTP/1.1 200 OK\nContent-Length: ~(string-length n)\n\n~n" out)
+                        (flush out)
+                        (serve (+ nreq 1)))]
+                     [(hash-table-get %predefined-contents request-uri #f)
+                      => (cut for-each (cut display <> out) <>)]
+                     [else
+                      (display "HTTP/1.x 200 OK\nContent-Type: text/plain\n\n" out)
+                      (write `(("method" ,method)
+                               ("request-uri" ,request-uri)
+                               ("request-body" ,(string-incomplete->complete body))
+                               ,@headers)
+                             out)])
+                    (socket-close client)
+                    (loop))
+                  (error "malformed request line:" request-line))))))))
 
     (define (main args)
       (let1 socket (make-server-socket 'inet *http-port* :reuse-addr? #t)
@@ -755,6 +837,38 @@
                        '(("a" "b") ("c" "d")))))
   )
 
+(test* "http-get (without pool)" '("1" "1")
+       (list (values-ref (http-get #"localhost:~*http-port*" "/keep-alive") 2)
+             (values-ref (http-get #"localhost:~*http-port*" "/keep-alive") 2)))
+
+(test* "http-get (persistent connection)" '("1" "2" "3")
+       (let1 conn (make-http-connection #"localhost:~*http-port*")
+         (begin0 (map (^_ (values-ref (http-get conn "/keep-alive") 2))
+                      (iota 3))
+           (reset-http-connection conn))))
+
+(let1 pool (make-http-connection-pool :max-per-host 2 :idle-timeout 10)
+  (test* "http-get (connection pool)" '("1" "2" "3")
+         (parameterize ([http-connection-pool pool])
+           (map (^_ (values-ref (http-get #"localhost:~*http-port*"
+                                          "/keep-alive")
+                                2))
+                (iota 3))))
+  (test* "http-get (connection pool, non-reusable reply)" '("4" "redirect" "1")
+         (parameterize ([http-connection-pool pool])
+           (list (values-ref (http-get #"localhost:~*http-port*"
+                                       "/keep-alive")
+                             2)
+                 ;; the server closes the connection after this one, so
+                 ;; the next request needs a new connection
+                 (and (http-get #"localhost:~*http-port*" "/redirect11"
+                                :redirect-handler #f)
+                      "redirect")
+                 (values-ref (http-get #"localhost:~*http-port*"
+                                       "/keep-alive")
+                             2))))
+  (http-connection-pool-shutdown! pool))
+
 (test* "<http-error>" #t
        (guard (e (else (is-a? e <http-error>)))
          (http-request 'GET #"localhost:~*http-port*" "/exit")))
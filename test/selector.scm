@@ -97,4 +97,87 @@
          (selector-select *sel* 0)
          (list *x* *y*)))
 
+;; start over with fresh pipes
+(set!-values (*p0* *p1*) (sys-pipe))
+(set!-values (*q0* *q1*) (sys-pipe))
+(set! *x* #f)
+(set! *y* #f)
+
+(cond-expand
+ [gauche.sys.poller
+  (test* "sys-poller" '(() #t)
+         (receive (in out) (sys-pipe)
+           (let* ([poller (make-sys-poller)]
+                  [fd (port-file-number in)])
+             (sys-poller-set! poller in '(r))
+             (let1 a (sys-poller-wait poller 0)
+               (display "a" out) (flush out)
+               (let1 b (sys-poller-wait poller 0)
+                 (sys-poller-close poller)
+                 (close-port in) (close-port out)
+                 (list a (equal? (assv fd b) (list fd 'r))))))))
+
+  (test* "make (poller)" 'poller
+         (begin (set! *sel* (make <selector> :backend 'poller))
+                (slot-ref *sel* 'backend)))
+
+  (test* "selector-select (poller)" '((foo) (bar baz))
+         (begin
+           (selector-add! *sel* *p0* set-x '(r))
+           (selector-add! *sel* *q0* set-y '(r))
+           (write '(foo) *p1*) (flush *p1*)
+           (write '(bar baz) *q1*) (flush *q1*)
+           (selector-select *sel* '(1 0))
+           (list *x* *y*)))
+
+  (test* "selector-select (poller, timeout)" 0
+         (selector-select *sel* 0))
+
+  (test* "selector-delete! (poller, by port)" '(foo)
+         (begin
+           (selector-delete! *sel* *p0* #f #f)
+           (write '(zzz) *p1*) (flush *p1*)
+           (selector-select *sel* 0)
+           *x*))
+
+  (test* "selector-delete! (poller, by proc)" '(bar baz)
+         (begin
+           (selector-delete! *sel* #f set-y #f)
+           (write '(yyy) *q1*) (flush *q1*)
+           (selector-select *sel* 0)
+           *y*))
+
+  (test* "selector-select (poller, flags)" '(((zzz) (yyy))
+                                             ((xxx) (yyy)))
+         (begin
+           (selector-add! *sel* *p0* set-x '(r))
+           (selector-add! *sel* *q0* set-y '(r))
+           (selector-add! *sel* *p1* set-x '(w))
+           (selector-add! *sel* *q1* set-y '(w))
+           (selector-select *sel*)
+           (let ((a (list *x* *y*)))
+             (selector-select *sel*)
+             (selector-select *sel* 0)
+             (list a (list *x* *y*)))))
+
+  (test* "selector (edge trigger)" '(1 0)
+         (receive (in out) (sys-pipe)
+           (let ([sel (make <selector> :backend 'poller :trigger 'edge)]
+                 [count 0])
+             (selector-add! sel in (^[p f] (inc! count)) '(r))
+             (display "abc" out) (flush out)
+             (selector-select sel 0)
+             (let1 a count
+               ;; the data remains unread, but it's not reported again
+               (selector-select sel 0)
+               (close-port in) (close-port out)
+               (list a (- count a))))))
+  ]
+ [else
+  (test* "make (poller)" (test-error)
+         (make <selector> :backend 'poller))])
+
+(test* "make (edge trigger with select)" (test-error)
+       (make <selector> :trigger 'edge))
+
 (test-end)
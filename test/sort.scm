@@ -169,4 +169,55 @@
  boolean<?
  '((1 3 1 2 4 2) (1 3 1 2 4 2)))
 
+;; Without a comparator, keys are extracted once and sorted natively.
+(sort-by-nocmp
+ (^p (exact->inexact (car p)))
+ '(((3 . a) (-0.5 . b) (2 . c) (3 . d) (-1 . e))
+   ((-1 . e) (-0.5 . b) (2 . c) (3 . a) (3 . d))))
+
+(sort-by-nocmp
+ car
+ '(((-3 . a) (12345678901 . b) (0 . c) (-3 . d) (-98765432109 . e))
+   ((-98765432109 . e) (-3 . a) (-3 . d) (0 . c) (12345678901 . b))))
+
+(sort-by-nocmp
+ car
+ '((("b" . 0) ("a" . 1) ("c" . 2) ("a" . 3) ("b" . 4))
+   (("a" . 1) ("a" . 3) ("b" . 0) ("b" . 4) ("c" . 2))))
+
+(test* "stable-sort-by - mixed keys" '((1 . a) (1.5 . b) (2 . c) (2 . d))
+       (stable-sort-by '((2 . c) (1.5 . b) (2 . d) (1 . a)) car))
+
+(let1 v (list-tabulate 1000 (^i (cons (modulo (* i 7919) 37) i)))
+  (test* "stable-sort-by - many keys" #t
+         (let1 r (stable-sort-by v car)
+           (every (^[a b] (or (< (car a) (car b))
+                              (and (= (car a) (car b)) (< (cdr a) (cdr b)))))
+                  r (cdr r)))))
+
+(test* "stable-sort with default-comparator" '((1 1.0 2) (1.0 1 2))
+       (list (stable-sort '(2 1 1.0) default-comparator)
+             (stable-sort '(2 1.0 1) default-comparator)))
+(test* "sort with string-comparator" '#("a" "b" "c")
+       (sort '#("c" "a" "b") string-comparator))
+(test* "sort with string-comparator (type check)" (test-error)
+       (sort '("a" b) string-comparator))
+(test* "sort with default-comparator and key" '((1 . b) (2 . a) (2 . c))
+       (sort '((2 . a) (1 . b) (2 . c)) default-comparator car))
+
+(test-section "uvectors")
+
+(test* "sort u8vector" '#u8(0 1 3 3 255)
+       (sort '#u8(3 255 0 3 1)))
+(test* "sort s16vector" '#s16(-32768 -2 0 5 32767)
+       (sort '#s16(5 32767 -2 -32768 0)))
+(test* "sort! s32vector" '#s32(-7 -1 0 4 9)
+       (rlet1 v (s32vector 9 -1 4 -7 0) (sort! v)))
+(test* "sort s64vector" '#s64(-9223372036854775808 -1 0 9223372036854775807)
+       (sort '#s64(0 9223372036854775807 -1 -9223372036854775808)))
+(test* "stable-sort f64vector" '#f64(-inf.0 -2.5 0.0 1.0 +inf.0)
+       (stable-sort '#f64(1.0 +inf.0 -2.5 0.0 -inf.0)))
+(test* "sort with comparator" '#u8(5 3 1)
+       (sort '#u8(1 5 3) >))
+
 (test-end)
@@ -32,6 +32,42 @@
 (test* "cond-expand (library)" 0
        (cond-expand [(library (gauche time)) 0] [else 1]))
 
+;;-----------------------------------------------------------------------
+(test-section "srfi-1")
+(use srfi-1 :prefix srfi-1:)
+;; Most of srfi-1 is built in and tested in list.scm.  Here we test
+;; lset operations on longer lists, which use hash tables internally;
+;; the results must be the same as with a (non-builtin) predicate.
+
+(let* ([xs (map (^i (format "k~a" (modulo (* i 7) 60))) (iota 50))]
+       [ys (map (^i (format "k~a" (modulo (* i 11) 70))) (iota 50))]
+       [zs (map (^i (format "k~a" (* i 3))) (iota 30))]
+       [my= (^[a b] (string=? a b))]
+       [test-lset
+        (^[name proc]
+          (test* #"~name (equal?)" (proc my= xs ys zs) (proc equal? xs ys zs))
+          (test* #"~name (string=?)" (proc my= xs ys zs)
+                 (proc string=? xs ys zs)))])
+  (test-lset "lset-union" srfi-1:lset-union)
+  (test-lset "lset-union!"
+             (^[= . ls] (apply srfi-1:lset-union! =
+                               (map list-copy ls))))
+  (test-lset "lset-intersection" srfi-1:lset-intersection)
+  (test-lset "lset-intersection!"
+             (^[= . ls] (apply srfi-1:lset-intersection! =
+                               (map list-copy ls))))
+  (test-lset "lset-difference" srfi-1:lset-difference)
+  (test-lset "lset-difference!"
+             (^[= . ls] (apply srfi-1:lset-difference! =
+                               (map list-copy ls))))
+  (test-lset "lset-diff+intersection"
+             (^[= . ls] (values->list
+                         (apply srfi-1:lset-diff+intersection
+                                = ls))))
+  (test* "lset-union (mixed)" '(#(1) 1 "a" x)
+         (srfi-1:lset-union equal?
+          '(1 "a" x) (append (make-list 40 'x) '(#(1))))))
+
 ;;-----------------------------------------------------------------------
 (test-section "srfi-2")
 (use srfi-2)
@@ -524,6 +560,29 @@
 (test* "char-set object-apply" '(#t #f)
        (list (#[a-z] #\a) (#[a-z] #\A)))
 
+;; Repeated lookups switch to the bitmap table; modification discards it.
+(let* ([ranges '((#x3040 . #x30ff) (#x4e00 . #x9fbf) (#x10000 . #x2ffff)
+                 (#x30100 . #x30100))]
+       [cs (fold (^[r cs] (char-set-union cs (ucs-range->char-set (car r)
+                                                                  (+ (cdr r) 1))))
+                 (char-set) ranges)]
+       [probes '(#x80 #x303f #x3040 #x30ff #x3100 #x4dff #x4e00 #x7000
+                 #x9fbf #x9fc0 #xffff #x10000 #x1ffff #x2ffff #x300ff
+                 #x30100 #x30101 #x10ffff)]
+       [expected (^[c] (boolean (any (^r (<= (car r) c (cdr r))) ranges)))])
+  (test* "char-set-contains? (large)" (map expected probes)
+         (let loop ([n 0] [r #f])
+           (if (= n 10)
+             r
+             (loop (+ n 1)
+                   (map (^c (char-set-contains? cs (integer->char c)))
+                        probes)))))
+  (char-set-adjoin! cs (integer->char #x3100) (integer->char #x10ffff))
+  (test* "char-set-contains? (large, modified)"
+         (map (^c (boolean (or (expected c) (memv c '(#x3100 #x10ffff)))))
+              probes)
+         (map (^c (char-set-contains? cs (integer->char c))) probes)))
+
 ;;-----------------------------------------------------------------------
 ;; srfi-16 case-lambda : moved to procedure.scm (builtin)
 
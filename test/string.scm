@@ -38,6 +38,16 @@
          (list y (eq? x y))))
 (test* "string-copy" "cde" (string-copy "abcde" 2))
 (test* "string-copy" "cd"  (string-copy "abcde" 2 4))
+(test* "string-copy-detached" '("abcde" "cd" #f)
+       (let* ((x "abcde") (y (string-copy-detached x)))
+         (list y (string-copy-detached x 2 4) (string-immutable? y))))
+(test* "string-compact!" '("bcd" #t)
+       (let* ((x (substring "abcde" 1 4)) (y (string-compact! x)))
+         (list y (eq? x y))))
+(test* "string-compact!" '("\u3042z" #t)
+       (let1 x "\u3042z"
+         (string-compact! x)
+         (list x (string-immutable? x))))
 
 (test* "string-ref" #\b (string-ref "abc" 1))
 (define x (string-copy "abcde"))
@@ -171,6 +181,113 @@
   (test-string-scan2 #*"abcd" #*"fghi" #*"abcdefghi" #\e 'both)
   )
 
+;;-------------------------------------------------------------------
+(test-section "string matcher")
+
+(let ()
+  (define (scan strings s)
+    (receive r (string-matcher-scan (make-string-matcher strings) s) r))
+
+  (test* "string-matcher?" '(#t #f)
+         (list (string-matcher? (make-string-matcher '("a")))
+               (string-matcher? "a")))
+  (test* "leftmost" '(1 "ab") (scan '("cad" "ab") "xabracadabra"))
+  (test* "leftmost, then longest" '(1 "abra")
+         (scan '("cad" "ab" "abra" "abr") "xabracadabra"))
+  (test* "overlapping" '(3 "bcd") (scan '("bcd" "abcx") "ababcd"))
+  (test* "suffix of another" '(3 "c") (scan '("abcd" "c") "abxc"))
+  (test* "no match" '(#f #f) (scan '("foo" "bar") "bazquux"))
+  (test* "no strings" '(#f #f) (scan '() "abc"))
+  (test* "empty text" '(#f #f) (scan '("a") ""))
+  (test* "empty string" '(0 "") (scan '("" "x") "abc"))
+  (test* "empty string, longer one at 0" '(0 "ab") (scan '("" "ab") "abc"))
+  (test* "reuse" '((0 "ab") (2 "cd") (#f #f))
+         (let1 m (make-string-matcher '("ab" "cd"))
+           (map (^s (receive r (string-matcher-scan m s) r))
+                '("abcd" "xxcdab" "xyz"))))
+  (test* "long text" (list 1000 "needle")
+         (scan '("needle" "pin")
+               (string-append (make-string 1000 #\n) "needle")))
+  (let* ([mb (string (integer->char #x3042))]
+         [txt (string-append mb mb "abc" mb "d")])
+    (test* "multibyte" `(2 "abc") (scan '("abc" "bcd") txt))
+    (test* "multibyte needle" `(5 ,(string-append mb "d"))
+           (scan (list (string-append mb "d") "cd") txt)))
+  (test* "incomplete" '(3 #*"de") (scan '(#*"de") "abcdef"))
+  (test* "bad element" (test-error) (make-string-matcher '("a" b)))
+  )
+
+;;-------------------------------------------------------------------
+(test-section "indexed access to long strings")
+
+;; Long multibyte strings get an offset table on the first indexed
+;; access; make sure every position agrees with sequential access.
+(unless (eq? (gauche-character-encoding) 'none)
+  (let* ([chars (map (^i (if (odd? (quotient i 3))
+                           (integer->char (+ #x3041 (modulo i 80)))
+                           (integer->char (+ #x61 (modulo i 26)))))
+                     (iota 1000))]
+         [s (list->string chars)]
+         [v (list->vector chars)])
+    (test* "string-ref" #t
+           (every (^i (eqv? (string-ref s i) (vector-ref v i)))
+                  (iota 1000)))
+    (test* "string-ref (reverse)" #t
+           (every (^i (eqv? (string-ref s i) (vector-ref v i)))
+                  (reverse (iota 1000))))
+    (test* "substring" #t
+           (every (^[b e] (equal? (substring s b e)
+                                  (list->string (take (drop chars b) (- e b)))))
+                  '(0 63 64 65 127 128 500 999 0)
+                  '(64 64 200 129 128 1000 999 1000 1000)))
+    (test* "string-pointer" #t
+           (every (^i (eqv? (string-pointer-next! (make-string-pointer s i))
+                            (vector-ref v i)))
+                  '(0 63 64 65 500 999)))
+    ))
+
+(unless (eq? (gauche-character-encoding) 'none)
+  ;; ASCII runs are skipped a word at a time when we count the length.
+  (let* ([mb (string (integer->char #x3042))]
+         [s (string-append (make-string 37 #\a) mb (make-string 20 #\b) mb)]
+         [ic (string-complete->incomplete s)])
+    (test* "length of long string" 59 (string-length s))
+    (test* "length of long string (from incomplete)" 59
+           (string-length (string-incomplete->complete ic)))
+    (test* "length of long string (broken)" #f
+           (string-incomplete->complete
+            (substring ic 0 (- (string-size ic) 1))))
+    ))
+
+;;-------------------------------------------------------------------
+(test-section "string builder")
+
+(let1 sb (make-string-builder)
+  (test* "string-builder?" '(#t #f) (list (string-builder? sb)
+                                         (string-builder? "")))
+  (test* "empty" '("" 0 0) (list (string-builder->string sb)
+                                  (string-builder-length sb)
+                                  (string-builder-size sb)))
+  (test* "add!" "abc-d"
+         (begin (string-builder-add! sb "abc" #\- "d")
+                (string-builder->string sb)))
+  (test* "add! (error)" (test-error) (string-builder-add! sb 'x))
+  (test* "long" '(10005 10005)
+         (begin (dotimes [i 1000] (string-builder-add! sb "0123456789"))
+                (list (string-length (string-builder->string sb))
+                      (string-builder-length sb))))
+  (test* "content" #t
+         (string=? (string-builder->string sb)
+                   (apply string-append "abc-d"
+                          (make-list 1000 "0123456789"))))
+  (test* "clear!" "" (begin (string-builder-clear! sb)
+                            (string-builder->string sb)))
+  (test* "incomplete" '(#f #t)
+         (begin (string-builder-add! sb #*"ab")
+                (list (string-builder-length sb)
+                      (string-incomplete? (string-builder->string sb)))))
+  )
+
 ;;-------------------------------------------------------------------
 (test-section "string-split")
 
@@ -621,6 +738,20 @@
                    (* *dstr-init-size* (+ *dstr-incr-factor* 1))
                    )
 
+;; The result of get-output-string may share the port's buffer; writing
+;; to the port afterwards must not change it.
+(let* ([p #f]
+       [s (call-with-output-string (^o (set! p o) (display "abc" o)))])
+  (display "def" p)
+  (test* "string-port (shared result)" '("abc" "abcdef")
+         (list s (get-output-string p))))
+
+(test* "string-port (huge)" '(300000 #t)
+       (let1 s (with-output-to-string
+                 (^[] (dotimes [i 30000] (display "0123456789"))))
+         (list (string-length s)
+               (string=? (substring s 299990 300000) "0123456789"))))
+
 ;;-------------------------------------------------------------------
 (test-section "string interpolation")
 
@@ -20,6 +20,19 @@
 (test* "interned?" #t (symbol-interned? (string->symbol "foofoo")))
 (test* "interned?" #f (symbol-interned? (gensym "foofoo")))
 
+(test* "string->symbol copies the name" "abc"
+       (let* ([str (string-copy "abc")]
+              [sym (string->symbol str)])
+         (string-set! str 0 #\z)
+         (symbol->string sym)))
+
+;; Interning enough symbols makes the symbol table grow.
+(test* "symbol table growth" '(#t #t)
+       (let* ([names (map (^i (format "symtab-test-~d" i)) (iota 20000))]
+              [syms (map string->symbol names)])
+         (list (every (^[n s] (eq? s (string->symbol n))) names syms)
+               (eq? 'foo (string->symbol "foo")))))
+
 (test* "symbol=?" '(#t #t #f #f)
        (list (symbol=? 'a 'a)
              (symbol=? 'a 'a 'a)
@@ -413,6 +413,17 @@
          (set! (ref t'nanosecond) 4)
          t))
 
+(test* "monotonic-ns" #t
+       (let* ([a (monotonic-ns)]
+              [b (begin (sys-nanosleep 1000000) (monotonic-ns))])
+         (or (not a)
+             (and (exact-integer? a) (>= (- b a) 1000000)))))
+(test* "cpu-time-ns" #t
+       (let1 a (cpu-time-ns)
+         (or (not a)
+             (and (exact-integer? a)
+                  (begin (dotimes [i 100000]) (>= (cpu-time-ns) a))))))
+
 ;;-------------------------------------------------------------------
 (test-section "stat")
 
@@ -966,6 +977,22 @@
     ]
    [else]) ; (not (and gauche.sys.sigwait (not gauche.os.cygwin)))
 
+  ;; signal notification fd
+  (let ([got '()]
+        [fd (sys-signal-notification-fd)])
+    (set-signal-handler! SIGUSR1 (^n (push! got n)))
+    (test* "signal notification fd" `(() (,SIGUSR1) #t (,SIGUSR1) ())
+           (let* ([before (sys-signal-notification-drain)]
+                  [_ (sys-kill (sys-getpid) SIGUSR1)]
+                  [handled got])
+             (receive (n r w e) (sys-select (sys-fdset fd) #f #f 0)
+               (list before handled (= n 1)
+                     (sys-signal-notification-drain)
+                     (sys-signal-notification-drain)))))
+    (test* "signal notification fd (same fd)" fd
+           (sys-signal-notification-fd))
+    (set-signal-handler! SIGUSR1 #f))
+
   ] 
  [else]) ; gauche.os.windows
 
@@ -50,6 +50,36 @@
        (eof-object?
         (call-with-input-string "" (make-csv-reader #\,))))
 
+(test* "csv-reader (tab, crlf)" '(("a b" "c") ("" "d"))
+       (call-with-input-string "a b\tc\r\n\t\"d\"\r\n"
+         (^p (let1 r (make-csv-reader #\tab)
+               (list (r p) (r p))))))
+
+(test* "csv-reader (long field)"
+       (list (make-string 10000 #\x) "\u00e9 \u00e9")
+       (call-with-input-string
+           (string-append (make-string 10000 #\x) ", \u00e9 \u00e9 \n")
+         (make-csv-reader #\,)))
+
+(let ()
+  (define data
+    (string-append "a,\"b\nc\",d\n"
+                   "\"e\"\"f\" , g\n"
+                   "h,i\"j,k\n"
+                   "\n"
+                   "\"l,\nm\"x,n"))
+  (define expected
+    '(("a" "b\nc" "d") ("e\"f" "g") ("h" "i\"j" "k") ("") ("l,\nm" "n")))
+  (test* "port->csv-rows" expected
+         (call-with-input-string data (cut port->csv-rows <> #\,)))
+  (cond-expand
+   [gauche.sys.threads
+    (dolist [size '(1 3 7 100)]
+      (test* #"port->csv-rows (parallel, chunk-size ~size)" expected
+             (call-with-input-string data
+               (cut port->csv-rows <> #\, :parallel #t :chunk-size size))))]
+   [else]))
+
 (test* "csv-writer"
        "abc,def,123,\"what's up?\",\"he said, \"\"nothing new.\"\"\"\n"
        (call-with-output-string
@@ -337,6 +367,27 @@ fuga
          (flatten (html:img :src "foo" :alt "bar baz")))
   )
 
+(test* "html-escape" "&lt;&amp;\u3042&quot;&gt;"
+       (with-string-io "<&\u3042\">" html-escape))
+
+;; Calls with constant arguments are rendered at compile time; the
+;; results must be the same as the runtime ones.
+(let ([x "<x>"] [f #f] [kw :id])
+  (test* "html elements (constant)"
+         "<p class=\"a&amp;b\"><b>B</b\n>1<br /></p\n>"
+         (html:p :class "a&b" (html:b "B") 1 (html:br)))
+  (test* "html elements (partially constant)"
+         (tree->string (apply html:p (list :class x :id f :title "t"
+                                           (html:i x) x)))
+         (tree->string (html:p :class x :id f :title "t" (html:i x) x)))
+  (test* "html elements (keyword given at runtime)"
+         "<p id=\"v\">c</p\n>"
+         (tree->string (html:p kw "v" "c")))
+  (test* "html elements (empty element with content)"
+         (test-error)
+         (html:br "x"))
+  )
+
 ;;-------------------------------------------------------------------
 (test-section "parse")
 (use text.parse)
@@ -635,6 +686,14 @@ fuga
        (if (symbol? :b) "A:b" "Ab") ; transient during symbol-keyword integration
        (tree->string '(|A| . :b)))
 
+(define-class <tree-test-node> () ((s :init-keyword :s)))
+(define-method write-tree ((n <tree-test-node>) out)
+  (write-tree `("[" ,(~ n's) "]") out))
+(test* "write-tree (custom node)" "a[b[c]]d"
+       (tree->string
+        `("a" ,(make <tree-test-node>
+                 :s `("b" ,(make <tree-test-node> :s "c"))) "d")))
+
 ;;-------------------------------------------------------------------
 (test-section "unicode.ucd")
 (use text.unicode.ucd)
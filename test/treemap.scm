@@ -446,5 +446,142 @@
          (tree-map-put! tmap 3 'z))
   )
 
+(let1 tmap (make-tree-map default-comparator)
+  (test* "default comparator" '(("x" . e) (-5 . a) (0 . b) (2.5 . c)
+                                (10000000000000000000 . d))
+         (begin
+           (dolist [p '((0 . b) (10000000000000000000 . d) (-5 . a)
+                        ("x" . e) (2.5 . c))]
+             (tree-map-put! tmap (car p) (cdr p)))
+           (tree-map->alist tmap)))
+  (test* "default comparator (comparator)" default-comparator
+         (tree-map-comparator tmap))
+  )
+
+;;
+;; B+-tree variant
+;;
+
+(do-tree-map (cut make-btree-map = <))
+(do-tree-map (cut make-btree-map))
+
+;; Enough entries to split and merge nodes at several levels
+(let ([tree (make-btree-map)]
+      [ref  (make-hash-table 'eqv?)]
+      [seed 1])
+  (define (rand n)
+    (set! seed (modulo (+ (* seed 1103515245) 12345) 2147483648))
+    (modulo (quotient seed 65536) n))
+  (define (sorted-keys) (sort (hash-table-keys ref)))
+
+  (test* "btree-map insertion" #t
+         (begin
+           (dotimes [i 5000]
+             (let1 k (rand 10000)
+               (tree-map-put! tree k (- k))
+               (hash-table-put! ref k (- k))))
+           (%tree-map-check-consistency tree)
+           (equal? (tree-map-keys tree) (sorted-keys))))
+  (test* "btree-map fold-right" (reverse (sorted-keys))
+         (tree-map-fold tree (^[k v r] (cons k r)) '()))
+  (test* "btree-map deletion" #t
+         (begin
+           (dotimes [i 8000]
+             (let1 k (rand 10000)
+               (tree-map-delete! tree k)
+               (hash-table-delete! ref k)))
+           (%tree-map-check-consistency tree)
+           (and (equal? (tree-map-keys tree) (sorted-keys))
+                (= (tree-map-num-entries tree) (hash-table-num-entries ref)))))
+  (test* "btree-map floor/ceiling" #t
+         (let1 keys (sorted-keys)
+           (every (^k (and (eqv? (tree-map-floor-key tree k)
+                                 (find (cut <= <> k) (reverse keys)))
+                           (eqv? (tree-map-ceiling-key tree k)
+                                 (find (cut >= <> k) keys))))
+                  (iota 200 -5 53))))
+  (test* "btree-map copy" #t
+         (let1 new (tree-map-copy tree)
+           (%tree-map-check-consistency new)
+           (tree-map-put! tree -1 1)
+           (and (equal? (tree-map->alist new)
+                        (map (^k (cons k (- k))) (sorted-keys)))
+                (not (tree-map-exists? new -1)))))
+  (test* "btree-map pop-min!/pop-max!" '(#t 0)
+         (let loop ([prev-min -inf.0] [prev-max +inf.0] [ok #t])
+           (if (tree-map-empty? tree)
+             (list ok (tree-map-num-entries tree))
+             (let* ([mn (tree-map-pop-min! tree)]
+                    [mx (tree-map-pop-max! tree)])
+               (loop (car mn) (if mx (car mx) prev-max)
+                     (and ok (< prev-min (car mn))
+                          (or (not mx) (> prev-max (car mx)))))))))
+  )
+
+;;
+;; Order statistics and range operations
+;;
+
+(define (test-range-ops name ctor)
+  (define (make-tm keys)
+    (rlet1 tm (ctor)
+      (dolist [k keys] (tree-map-put! tm k (* k k)))))
+  (define keys (iota 1000 0 2))         ;0, 2, ..., 1998
+
+  (test* #"~name tree-map-nth" '((0 . 0) (10 . 100) (1998 . 3992004) #f #f)
+         (let1 tm (make-tm keys)
+           (map (cut tree-map-nth tm <>) '(0 5 999 1000 -1))))
+  (test* #"~name tree-map-count-range" '(1000 5 0 0 500 1)
+         (let1 tm (make-tm keys)
+           (list (tree-map-count-range tm -1 2000)
+                 (tree-map-count-range tm 10 20)
+                 (tree-map-count-range tm 20 10)
+                 (tree-map-count-range tm 11 12)
+                 (tree-map-count-range tm 999 5000)
+                 (tree-map-count-range tm 1998 1999))))
+  (test* #"~name tree-map-delete-range!" '(50 950 (98 200) #t)
+         (let* ([tm (make-tm keys)]
+                [n (tree-map-delete-range! tm 100 200)])
+           (%tree-map-check-consistency tm)
+           (list n (tree-map-num-entries tm)
+                 (list (tree-map-predecessor-key tm 150)
+                       (tree-map-successor-key tm 150))
+                 (equal? (tree-map-keys tm)
+                         (remove (^k (<= 100 k 199)) keys)))))
+  (test* #"~name tree-map-delete-range! (out of range)" '(0 0 1000)
+         (let* ([tm (make-tm keys)])
+           (list (tree-map-delete-range! tm 3000 4000)
+                 (tree-map-delete-range! tm 200 100)
+                 (tree-map-num-entries tm))))
+  (test* #"~name tree-map-delete-range! (all)" '(1000 0)
+         (let* ([tm (make-tm keys)]
+                [n (tree-map-delete-range! tm -10 10000)])
+           (list n (tree-map-num-entries tm))))
+  (test* #"~name tree-map-split!" '(300 700 598 600 #t)
+         (let* ([tm (make-tm keys)]
+                [hi (tree-map-split! tm 599)])
+           (%tree-map-check-consistency tm)
+           (%tree-map-check-consistency hi)
+           (list (tree-map-num-entries tm)
+                 (tree-map-num-entries hi)
+                 (car (tree-map-max tm))
+                 (car (tree-map-min hi))
+                 (eq? (tree-map-comparator tm) (tree-map-comparator hi)))))
+  (test* #"~name tree-map-split! and tree-map-join!" #t
+         (let* ([tm (make-tm keys)]
+                [parts (map (^k (tree-map-split! tm k)) '(1500 1000 20 0))])
+           (dolist [p (reverse parts)] (tree-map-join! tm p))
+           (%tree-map-check-consistency tm)
+           (and (equal? (tree-map-keys tm) keys)
+                (every tree-map-empty? parts))))
+  (test* #"~name tree-map-join! (overlapping keys)" (test-error)
+         (tree-map-join! (make-tm '(1 2 3)) (make-tm '(3 4 5))))
+  (test* #"~name tree-map-join! (different comparators)" (test-error)
+         (tree-map-join! (make-tm '(1 2 3)) (make-tree-map = <)))
+  )
+
+(test-range-ops "rbtree" (cut make-tree-map))
+(test-range-ops "btree" (cut make-btree-map))
+
 (test-end)
 
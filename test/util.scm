@@ -21,6 +21,35 @@
        '(1 2 3)
        (match '#(1 2 3) (`#(,a ...) a) (_ #f)))
 
+(let ()
+  (define (classify x)
+    (match x
+      [('add a b) `(+ ,a ,b)]
+      [('sub a b) `(- ,a ,b)]
+      [('neg a)   `(- ,a)]
+      [(':kw . r) `(kw ,@r)]
+      [(#\c n)    `(char ,n)]
+      [(1 n)      `(one ,n)]
+      [(1.5 n)    `(flo ,n)]
+      [(12345678901234567890 n) `(big ,n)]
+      [("str" n)  `(str ,n)]
+      [(#t n)     `(true ,n)]
+      [('() n)    `(nil ,n)]
+      [('(a b) n) `(list ,n)]
+      [#(x y)     `(vec2 ,x ,y)]
+      [#(x y z)   `(vec3 ,x ,y ,z)]
+      [(x . y)    `(other ,x)]
+      [_          'none]))
+  (test* "match (many clauses)"
+         '((+ 1 2) (- 1 2) (- 3) (kw 1 2) (char 0) (one 0) (other 1.0)
+           (flo 0) (big 0) (str 0) (true 0) (nil 0) (list 0) (other (a c))
+           (vec2 1 2) (vec3 1 2 3) none (other add) none)
+         (map classify
+              `((add 1 2) (sub 1 2) (neg 3) (:kw 1 2) (#\c 0) (1 0) (1.0 0)
+                (1.5 0) (12345678901234567890 0) (,(string #\s #\t #\r) 0)
+                (#t 0) (() 0) ((a b) 0) ((a c) 0)
+                #(1 2) #(1 2 3) #(1 2 3 4) (add 1) add))))
+
 ;;-----------------------------------------------
 (test-section "util.combinations")
 (use util.combinations)
@@ -411,6 +440,12 @@
        '(6 ((a 0 0) (x 1 4) (b 2 5) (y 3 6) (c 4 7) (z 5 8)))
        (lcs-with-positions '(a x b y c z p d q) '(a b c a x b y c z)))
 
+(test* "lcs custom equality" '(2 ((#\A 0 1) (#\b 2 2)))
+       (lcs-with-positions '(#\A #\x #\b) '(#\y #\a #\B) char-ci=?))
+(test* "lcs eqv" '("a" 1)
+       (let1 s "a"
+         (lcs (list s 1) (list (string-copy s) s 1) eqv?)))
+
 (let1 z (iota 200)
   (test* "lcs (long, same)" #t (equal? z (lcs z z)))
   (test* "lcs (long, none)" '(199) (lcs (reverse z) z))
@@ -50,7 +50,33 @@
 
   (test-algo "Levenshtein" l-distances cadr)
   (test-algo "Restricted edit" re-distances caddr)
-  (test-algo "Damerau-Levenshtein" dl-distances cadddr))
+  (test-algo "Damerau-Levenshtein" dl-distances cadddr)
+
+  ;; The sequences other than strings, and the custom elt=, are handled
+  ;; by the generic DP.  Compare them with the bit-parallel one.
+  (let ([slow= (^[a b] (char=? a b))]
+        [sets `(("ab" "ba" "abc" "")
+                ("\u3042\u3044\u3046" "\u3044\u3042\u3046" "\u3046")
+                (,(make-string 70 #\a)
+                 ,(string-append (make-string 69 #\a) "b")
+                 ,(string-append "b" (make-string 68 #\a) "ba")
+                 ,(make-string 130 #\a)
+                 ,(apply string (map (^i (integer->char (+ 97 (modulo (* i 7) 3))))
+                                     (iota 150)))))])
+    (dolist [set sets]
+      (dolist [c '(#f 0 1 5 100)]
+        (test* #"Levenshtein fast path ~(string-length (car set)) ~c"
+               (l-distances (car set) (cdr set) :elt= slow= :cutoff c)
+               (l-distances (car set) (cdr set) :cutoff c))
+        (test* #"Levenshtein list ~(string-length (car set)) ~c"
+               (l-distances (car set) (cdr set) :cutoff c)
+               (l-distances (string->list (car set)) (map string->list (cdr set))
+                            :cutoff c))
+        (test* #"Restricted edit fast path ~(string-length (car set)) ~c"
+               (re-distances (car set) (cdr set) :elt= slow= :cutoff c)
+               (re-distances (car set) (cdr set) :cutoff c)))))
+  (test* "Restricted edit (transposition at the head)" '(1 2)
+         (re-distances "ab" '("ba" "bac"))))
 
 
 (test-end)
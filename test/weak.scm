@@ -121,6 +121,50 @@
 ;        (list (weak-hash-table-keys x)
 ;              (weak-hash-table-values x)))
 
+;;-------------------------------------------------------------------
+(test-section "gc telemetry")
+
+(test* "gc-recent-events" '(:gc-no :wall-time :cpu-time :heap-before
+                            :heap-after :reclaimed :finalizers-run)
+       (begin (gc)
+              (map car (last (gc-recent-events)))))
+
+(test* "gc-pause-histogram" #t
+       (let ([h (gc-pause-histogram)]
+             [n (cadr (assq :gc-count (gc-event-stat)))])
+         (and (= (fold (^[p s] (+ (cdr p) s)) 0 h) n)
+              (eqv? (car (last h)) +inf.0))))
+
+(test* "set-gc-event-handler!" #t
+       (let1 seen #f
+         (set-gc-event-handler! (^[ev] (set! seen #t)))
+         (dotimes [n 3] (gc))
+         (dotimes [n 1000] (list n))  ; reach the safe point
+         (set-gc-event-handler! #f)
+         seen))
+
+(test* "gc-stat" #t
+       (let1 n (cadr (assq :heap-sections (gc-stat)))
+         (and (exact-integer? n) (> n 0))))
+
+(test* "gc-configuration" '(:markers :incremental :free-space-divisor
+                             :max-pause :full-frequency :huge-pages)
+       (map car (gc-configuration)))
+
+(test* "gc-configure!" 5
+       (let1 d (cadr (assq :free-space-divisor (gc-configuration)))
+         (gc-configure! :free-space-divisor 5)
+         (begin0 (cadr (assq :free-space-divisor (gc-configuration)))
+           (gc-configure! :free-space-divisor d))))
+
+(test* "gc-configure! (huge-pages)" 'thp
+       (let1 h (cadr (assq :huge-pages (gc-configuration)))
+         (gc-configure! :huge-pages 'thp)
+         (begin0 (cadr (assq :huge-pages (gc-configuration)))
+           (gc-configure! :huge-pages h))))
+(test* "gc-configure! (huge-pages)" (test-error)
+       (gc-configure! :huge-pages 'big))
+
 (test-end)
 
 
@@ -377,6 +377,200 @@ Content-Disposition: form-data; name=bbb
 
 (run-css-parser-test)
 
+;;------------------------------------------------
+(test-section "www.server")
+(use www.server)
+(test-module 'www.server)
+
+(cond-expand
+ [gauche.sys.threads
+  (use gauche.threads)
+  (use gauche.net)
+  (use rfc.http)
+
+  (with-output-to-file "test.o" (cut display "static content\n"))
+
+  (let* ([server
+          (make-http-server
+           (^[req]
+             (let1 path (http-request-path req)
+               (cond
+                [(equal? path "/hello")
+                 (http-respond req 200 '(("content-type" "text/plain"))
+                               #"hello ~(http-request-method req)")]
+                [(equal? path "/echo")
+                 (http-respond req 200 '() (port->string (http-request-body req)))]
+                [(equal? path "/chunked")
+                 (http-respond-chunked req 200 '()
+                                       (^[out] (display "abc" out)
+                                               (flush out)
+                                               (display "def" out)))]
+                [(equal? path "/file") (http-respond-file req "test.o")]
+                [(equal? path "/cgi")
+                 ((http-server-cgi-handler
+                   (^[params]
+                     `(,(cgi-header :content-type "text/plain")
+                       ,(cgi-get-parameter "x" params))))
+                  req)]
+                [(equal? path "/error") (error "oops")]
+                [else
+                 (http-respond req 404 '() "not found")])))
+           :host "localhost" :port 0 :num-workers 2)]
+         [th (thread-start! (make-thread (^[] (http-server-start! server))))]
+         [host #"localhost:~(http-server-port server)"])
+    (define (get path . opts)
+      (receive (code hdrs body) (apply http-get host path opts)
+        (list code body)))
+
+    (test* "http server get" '("200" "hello GET") (get "/hello"))
+    (test* "http server head" '("200" #f)
+           (receive (code hdrs body) (http-head host "/hello")
+             (list code body)))
+    (test* "http server post" '("200" "some data")
+           (receive (code hdrs body) (http-post host "/echo" "some data")
+             (list code body)))
+    (test* "http server chunked" '("200" "abcdef") (get "/chunked"))
+    (test* "http server file" '("200" "static content\n") (get "/file"))
+    (test* "http server cgi handler" '("200" "foo") (get "/cgi?x=foo"))
+    (test* "http server 404" '("404" "not found") (get "/nowhere"))
+    (test* "http server error" "500"
+           (car (get "/error")))
+    (test* "http server keep-alive" '(("200" "hello GET") ("200" "hello GET")
+                                      ("200" "abcdef"))
+           (let1 conn (make-http-connection host)
+             (begin0 (map (^p (receive (code hdrs body) (http-get conn p)
+                                (list code body)))
+                          '("/hello" "/hello" "/chunked"))
+               (reset-http-connection conn))))
+    (test* "http server bad request" #t
+           (call-with-client-socket (make-client-socket 'inet "localhost"
+                                                        (http-server-port server))
+             (^[in out]
+               (display "garbage\r\n\r\n" out)
+               (flush out)
+               (boolean (#/^HTTP\/1\.1 400/ (read-line in))))))
+    (http-server-stop! server)
+    (test* "http server stop" 'stopped
+           (begin (thread-join! th) 'stopped)))
+  (sys-unlink "test.o")]
+ [else])
+
+;;------------------------------------------------
+(test-section "www.fastcgi")
+(use www.fastcgi)
+(test-module 'www.fastcgi)
+
+(cond-expand
+ [gauche.sys.threads
+  (use gauche.threads)
+  (use gauche.net)
+  (use gauche.uvector)
+
+  (define *fcgi-path* "test.o.sock")
+  (sys-unlink *fcgi-path*)
+
+  ;; A minimal FastCGI client
+  (define (fcgi-record type id content)
+    (let1 len (u8vector-length content)
+      (u8vector-append (u8vector 1 type (ash id -8) (logand id 255)
+                                 (ash len -8) (logand len 255) 0 0)
+                       content)))
+  (define (fcgi-params alist)
+    (apply u8vector-append '#u8()
+           (map (^p (let ([n (string->u8vector (car p))]
+                          [v (string->u8vector (cadr p))])
+                      (u8vector-append (u8vector (u8vector-length n)
+                                                 (u8vector-length v))
+                                       n v)))
+                alist)))
+  (define (fcgi-begin id) (fcgi-record 1 id (u8vector 0 1 1 0 0 0 0 0)))
+  (define (fcgi-send out . records)
+    (for-each (cut write-uvector <> out) records)
+    (flush out))
+  (define (fcgi-read-record in)
+    (let* ([h (read-uvector <u8vector> 8 in)]
+           [len (+ (* 256 (u8vector-ref h 4)) (u8vector-ref h 5))]
+           [content (if (zero? len) '#u8() (read-uvector <u8vector> len in))])
+      (unless (zero? (u8vector-ref h 6))
+        (read-uvector <u8vector> (u8vector-ref h 6) in))
+      (values (u8vector-ref h 1) (u8vector-ref h 3) content)))
+  ;; Reads records until END_REQUEST of all IDS, and returns the
+  ;; stdout of each request in the order of IDS.
+  (define (fcgi-responses in ids)
+    (let loop ([pending ids] [outs '()])
+      (if (null? pending)
+        (map (^[id] (u8vector->string
+                     (apply u8vector-append '#u8()
+                            (reverse (assv-ref outs id '())))))
+             ids)
+        (receive (type id content) (fcgi-read-record in)
+          (cond [(= type 3) (loop (delete id pending) outs)]
+                [(= type 6)
+                 (loop pending
+                       (acons id (cons content (assv-ref outs id '()))
+                              (alist-delete id outs)))]
+                [else (loop pending outs)])))))
+  (define (cgi-body s)
+    (cond [(#/\r\n\r\n/ s) => (cut <> 'after)] [else s]))
+
+  (let1 th (thread-start!
+            (make-thread
+             (^[]
+               (fastcgi-main (^[params]
+                               `(,(cgi-header :content-type "text/plain")
+                                 ,(cgi-get-parameter "x" params)))
+                             :path *fcgi-path* :num-workers 2
+                             :max-requests 3))))
+    ;; wait for the server to listen
+    (let loop ([n 0])
+      (when (and (< n 100) (not (file-exists? *fcgi-path*)))
+        (sys-nanosleep #e1e7)
+        (loop (+ n 1))))
+    (call-with-client-socket (make-client-socket 'unix *fcgi-path*)
+      (^[in out]
+        (test* "fastcgi request" '("foo")
+               (begin
+                 (fcgi-send out
+                            (fcgi-begin 1)
+                            (fcgi-record 4 1 (fcgi-params
+                                              '(("REQUEST_METHOD" "GET")
+                                                ("QUERY_STRING" "x=foo"))))
+                            (fcgi-record 4 1 '#u8())
+                            (fcgi-record 5 1 '#u8()))
+                 (map cgi-body (fcgi-responses in '(1)))))
+        (test* "fastcgi multiplexed requests" '("bar" "baz")
+               (begin
+                 (fcgi-send out
+                            (fcgi-begin 2)
+                            (fcgi-begin 3)
+                            (fcgi-record 4 3 (fcgi-params
+                                              '(("REQUEST_METHOD" "POST")
+                                                ("CONTENT_TYPE"
+                                                 "application/x-www-form-urlencoded")
+                                                ("CONTENT_LENGTH" "5"))))
+                            (fcgi-record 4 2 (fcgi-params
+                                              '(("REQUEST_METHOD" "GET")
+                                                ("QUERY_STRING" "x=bar"))))
+                            (fcgi-record 4 3 '#u8())
+                            (fcgi-record 4 2 '#u8())
+                            (fcgi-record 5 3 (string->u8vector "x=baz"))
+                            (fcgi-record 5 3 '#u8())
+                            (fcgi-record 5 2 '#u8()))
+                 (map cgi-body (fcgi-responses in '(2 3)))))
+        (test* "fastcgi get values" '(10 "FCGI_MPXS_CONNS" "1")
+               (begin
+                 (fcgi-send out (fcgi-record 9 0 (fcgi-params
+                                                  '(("FCGI_MPXS_CONNS" "")))))
+                 (receive (type id c) (fcgi-read-record in)
+                   (let ([nl (u8vector-ref c 0)]
+                         [vl (u8vector-ref c 1)])
+                     (list type
+                           (u8vector->string c 2 (+ 2 nl))
+                           (u8vector->string c (+ 2 nl) (+ 2 nl vl)))))))))
+    (test* "fastcgi max-requests" 0 (thread-join! th)))
+  (sys-unlink *fcgi-path*)]
+ [else])
+
 (test-end)
 
 